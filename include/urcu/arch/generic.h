@@ -30,8 +30,12 @@ extern "C" {
 #endif
 
 #ifndef CAA_CACHE_LINE_SIZE
+#ifdef CONFIG_RCU_CACHE_LINE_SIZE
+#define CAA_CACHE_LINE_SIZE	CONFIG_RCU_CACHE_LINE_SIZE
+#else
 #define CAA_CACHE_LINE_SIZE	64
 #endif
+#endif
 
 #if !defined(cmm_mc) && !defined(cmm_rmc) && !defined(cmm_wmc)
 #define CONFIG_HAVE_MEM_COHERENCY
@@ -32,7 +32,11 @@ extern "C" {
 #endif
 
 /* Include size of POWER5+ L3 cache lines: 256 bytes */
+#ifdef CONFIG_RCU_CACHE_LINE_SIZE
+#define CAA_CACHE_LINE_SIZE	CONFIG_RCU_CACHE_LINE_SIZE
+#else
 #define CAA_CACHE_LINE_SIZE	256
+#endif
 
 #ifdef __NO_LWSYNC__
 #define LWSYNC_OPCODE	"sync\n"
@@ -37,7 +37,11 @@
 extern "C" {
 #endif
 
+#ifdef CONFIG_RCU_CACHE_LINE_SIZE
+#define CAA_CACHE_LINE_SIZE	CONFIG_RCU_CACHE_LINE_SIZE
+#else
 #define CAA_CACHE_LINE_SIZE	128
+#endif
 
 #define cmm_mb()    __asm__ __volatile__("bcr 15,0" : : : "memory")
 
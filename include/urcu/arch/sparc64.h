@@ -38,7 +38,11 @@ extern "C" {
 #define __NR_membarrier		351
 #endif
 
+#ifdef CONFIG_RCU_CACHE_LINE_SIZE
+#define CAA_CACHE_LINE_SIZE	CONFIG_RCU_CACHE_LINE_SIZE
+#else
 #define CAA_CACHE_LINE_SIZE	256
+#endif
 
 /*
  * Inspired from the Linux kernel. Workaround Spitfire bug #51.
@@ -0,0 +1,99 @@
+#ifndef _URCU_ASYMMETRIC_FENCE_H
+#define _URCU_ASYMMETRIC_FENCE_H
+
+/*
+ * urcu/asymmetric-fence.h
+ *
+ * Userspace RCU library - Asymmetric memory fences
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+#include <stdbool.h>
+#include <urcu/config.h>
+#include <urcu/compiler.h>
+#include <urcu/arch.h>
+#include <urcu/system.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*
+ * Pair of fences for algorithms whose fast side runs much more often
+ * than their slow side, such as biased locks and hazard pointers: a
+ * light fence in one thread and a heavy fence in another order their
+ * memory accesses as two cmm_smp_mb() would.
+ *
+ * The heavy fence issues the membarrier system call, which runs a
+ * memory barrier on all CPUs running threads of the process, so that
+ * the light fence is a compiler barrier. The process is registered for
+ * MEMBARRIER_CMD_PRIVATE_EXPEDITED by cmm_asymmetric_fence_init(), or
+ * the first heavy fence, falling back on MEMBARRIER_CMD_SHARED. Without
+ * membarrier, both fences are memory barriers, and so are the light
+ * fences issued before the registration.
+ *
+ * The pair ordering is detailed as (O: ordered, X: not ordered) :
+ *               light  heavy
+ *        light    X      O
+ *        heavy    O      O
+ */
+
+#ifdef CONFIG_RCU_FORCE_SYS_MEMBARRIER
+#define cmm_asymmetric_fence_sys_membarrier	1
+#else
+extern int cmm_asymmetric_fence_sys_membarrier;
+#endif
+
+/*
+ * cmm_asymmetric_fence_init - register the process for membarrier.
+ *
+ * Optional: the first heavy fence does it. Calling it at startup makes
+ * the light fences compiler barriers from then on. Return whether the
+ * light fences are compiler barriers.
+ */
+extern
+bool cmm_asymmetric_fence_init(void);
+
+/*
+ * cmm_asymmetric_fence_light - fast side fence.
+ */
+static inline
+void cmm_asymmetric_fence_light(void)
+{
+#ifdef CONFIG_RCU_FORCE_SYS_MEMBARRIER
+	cmm_barrier();
+#else
+	if (caa_likely(CMM_LOAD_SHARED(cmm_asymmetric_fence_sys_membarrier)))
+		cmm_barrier();
+	else
+		cmm_smp_mb();
+#endif
+}
+
+/*
+ * cmm_asymmetric_fence_heavy - slow side fence.
+ *
+ * Costs a system call, of the order of microseconds, and an
+ * interruption of the CPUs running other threads of the process.
+ */
+extern
+void cmm_asymmetric_fence_heavy(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* _URCU_ASYMMETRIC_FENCE_H */
@@ -0,0 +1,86 @@
+#ifndef _URCU_BRLOCK_H
+#define _URCU_BRLOCK_H
+
+/*
+ * urcu/brlock.h
+ *
+ * Userspace RCU library - Per-CPU reader-writer lock
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*
+ * Reader-writer lock for data updated in place, where readers must
+ * exclude writers rather than read an older version as with RCU.
+ *
+ * Readers count their lock and unlock operations on counters of their
+ * CPU, each on its own cache line, ordered by the light side of the
+ * urcu/asymmetric-fence.h fences: without writer, a read-side lock or
+ * unlock is an uncontended per-CPU addition, without memory barrier,
+ * and readers of different CPUs share no written cache line. With
+ * rseq, the additions are per-CPU commits rather than atomic
+ * operations.
+ *
+ * A writer flags the lock, issues heavy fences, and waits until the
+ * per-CPU counts of unlocks match those of locks. Readers which find
+ * the flag back off until the writer releases the lock, so writers
+ * are not starved, and readers wait for writers. Writers are
+ * serialized by a mutex. Each write-side lock costs a few membarrier
+ * system calls: this lock suits data read much more often than
+ * written.
+ *
+ * The lock is not recursive, and a read-side lock does not nest
+ * within a write-side lock of the same lock. This lock does _not_
+ * specifically rely on RCU.
+ *
+ * Note that struct cds_brlock is opaque to callers.
+ */
+struct cds_brlock;
+
+/*
+ * cds_brlock_new - allocate a reader-writer lock.
+ * @nr_cpus: number of per-CPU counters, rounded up to a power of two,
+ *           or 0 for the number of configured CPUs.
+ *
+ * Return NULL on error.
+ */
+extern
+struct cds_brlock *cds_brlock_new(unsigned long nr_cpus);
+
+/*
+ * cds_brlock_destroy - free a lock, which must not be held.
+ */
+extern
+void cds_brlock_destroy(struct cds_brlock *lock);
+
+extern
+void cds_brlock_read_lock(struct cds_brlock *lock);
+extern
+void cds_brlock_read_unlock(struct cds_brlock *lock);
+
+extern
+void cds_brlock_write_lock(struct cds_brlock *lock);
+extern
+void cds_brlock_write_unlock(struct cds_brlock *lock);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* _URCU_BRLOCK_H */
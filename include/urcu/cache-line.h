@@ -0,0 +1,66 @@
+#ifndef _URCU_CACHE_LINE_H
+#define _URCU_CACHE_LINE_H
+
+/*
+ * urcu/cache-line.h
+ *
+ * Userspace RCU library - Runtime cache line size
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+#include <stddef.h>
+#include <urcu/arch.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*
+ * CAA_CACHE_LINE_SIZE is fixed at build time, from the architecture or
+ * from --with-cache-line-size, and sets the alignment of the static and
+ * thread-local structures. Parts of a same architecture differ, so that
+ * objects allocated at runtime are aligned to the size detected on the
+ * running machine when it is larger.
+ */
+
+/*
+ * caa_get_cache_line_size - destructive interference size of the machine.
+ *
+ * The smallest distance, in bytes, between two variables written by
+ * different CPUs for them not to share a cache line: the coherency
+ * granule on aarch64, twice the cache line size on x86, whose spatial
+ * prefetcher fetches lines in pairs, and the L1 data cache line size
+ * elsewhere. Returns CAA_CACHE_LINE_SIZE when it cannot be detected.
+ */
+extern
+unsigned int caa_get_cache_line_size(void);
+
+/*
+ * caa_cache_line_alloc - allocate a cache line aligned object.
+ *
+ * Allocate @size bytes aligned on, and rounded up to, the larger of
+ * caa_get_cache_line_size() and CAA_CACHE_LINE_SIZE, so that the object
+ * shares no cache line with another. Free it with free(). Returns NULL
+ * and sets errno on failure.
+ */
+extern
+void *caa_cache_line_alloc(size_t size);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* _URCU_CACHE_LINE_H */
@@ -31,6 +31,8 @@
 #include <pthread.h>
 
 #include <urcu/wfcqueue.h>
+#include <urcu/wfcqueue-prio.h>
+#include <urcu/stats.h>
 
 #ifdef __cplusplus
 extern "C" {
@@ -48,6 +50,26 @@ struct call_rcu_data;
 #define URCU_CALL_RCU_STOPPED	(1U << 3)
 #define URCU_CALL_RCU_PAUSE	(1U << 4)
 #define URCU_CALL_RCU_PAUSED	(1U << 5)
+/*
+ * For create_all_cpu_call_rcu_data(): idle call_rcu threads invoke the
+ * callbacks of siblings of the same NUMA node once their grace period
+ * has elapsed.
+ */
+#define URCU_CALL_RCU_STEAL	(1U << 6)
+/*
+ * call_rcu(), call_rcu_lazy() and call_rcu_prio() queue the callbacks
+ * of an rcu_head placed on the memory of another NUMA node to a
+ * per-CPU call_rcu thread of that node, so that objects are freed
+ * where they were allocated.
+ */
+#define URCU_CALL_RCU_NUMA	(1U << 7)
+
+/*
+ * Priorities of call_rcu_prio(), from CALL_RCU_PRIO_NORMAL, the priority
+ * of call_rcu(), to CALL_RCU_PRIO_HIGH.
+ */
+#define CALL_RCU_PRIO_NORMAL	CDS_WFCQ_PRIO_NORMAL
+#define CALL_RCU_PRIO_HIGH	CDS_WFCQ_PRIO_HIGH
 
 /*
  * The rcu_head data structure is placed in the structure to be freed
@@ -59,6 +81,118 @@ struct rcu_head {
 	void (*func)(struct rcu_head *head);
 };
 
+/*
+ * Head of the objects freed via call_rcu_sized(), whose size is
+ * accounted for in call_rcu_pending_bytes until their callback runs.
+ * Fields are private.
+ */
+struct rcu_head_sized {
+	struct rcu_head head;
+	void (*func)(struct rcu_head *head);
+	size_t size;
+};
+
+/*
+ * Single-pointer head of the objects freed via call_rcu_typed(). The
+ * function is shared by all objects of a reclaim class, and invoked
+ * once per grace period on the list of objects ready to be reclaimed.
+ */
+struct rcu_head_compact {
+	struct cds_wfcq_node next;
+};
+
+/*
+ * Reclaim class, initialized by call_rcu_class_init(). Fields are
+ * private.
+ */
+struct call_rcu_class {
+	void (*func)(struct rcu_head_compact *list);
+	struct cds_wfcq_head pending_head;	/* queued by call_rcu_typed() */
+	struct cds_wfcq_tail pending_tail;
+	struct cds_wfcq_head ready_head;	/* waiting for engine_head */
+	struct cds_wfcq_tail ready_tail;
+	struct rcu_head engine_head;
+	int armed;
+	unsigned long nr_queued;
+	unsigned long nr_done;
+};
+
+/*
+ * Next object of a list passed to the function of a reclaim class, or
+ * NULL at the end of the list.
+ */
+static inline
+struct rcu_head_compact *rcu_head_compact_next(struct rcu_head_compact *head)
+{
+	struct cds_wfcq_node *next = head->next.next;
+
+	return next ? caa_container_of(next, struct rcu_head_compact, next) :
+		NULL;
+}
+
+/*
+ * Iterate on a list passed to the function of a reclaim class, safe
+ * against the reclamation of pos.
+ */
+#define rcu_head_compact_for_each_safe(list, pos, p)			\
+	for (pos = (list), p = pos ? rcu_head_compact_next(pos) : NULL;	\
+		pos;							\
+		pos = p, p = pos ? rcu_head_compact_next(pos) : NULL)
+
+/*
+ * Batching policy of a call_rcu thread, passed to
+ * create_call_rcu_data_attr(). Zero fields select the default.
+ *
+ * The delay between two batches of callbacks shrinks towards
+ * min_delay_ms while callbacks keep being queued, and grows back to
+ * max_delay_ms when the queue drains. Reaching qlen_high_watermark
+ * pending callbacks starts the next grace period immediately. A zero
+ * qlen_high_watermark disables it.
+ *
+ * Callbacks queued by call_rcu_lazy() start a grace period of their own
+ * only once lazy_qlen_max of them are pending, or lazy_delay_ms after
+ * the first of them was queued.
+ *
+ * URCU_CALL_RCU_RT threads with a non-zero poll_interval_us check their
+ * queue every poll_interval_us instead, busy-waiting intervals below a
+ * millisecond. They sleep until the next call_rcu() once their queue
+ * has been empty for 100 ms.
+ *
+ * The call_rcu thread is created with sched_policy and sched_priority,
+ * e.g. SCHED_FIFO, unless sched_policy is SCHED_OTHER, and with a
+ * stack of stack_size bytes. It runs on the CPUs of cpuset, a cpu_set_t
+ * of cpuset_size bytes, which overrides the cpu_affinity argument.
+ *
+ * With a non-zero nr_helpers, batches of more than parallel_threshold
+ * callbacks (65536 by default) are invoked in parallel by the call_rcu
+ * thread and up to nr_helpers helper threads, one per parallel_threshold
+ * callbacks, which run on any CPU. Callbacks queued before an
+ * rcu_barrier() are still invoked before it completes.
+ *
+ * With a non-zero qlen_limit, producers finding qlen_limit callbacks
+ * pending expedite the next batches, then wait for at most limit_wait_ms
+ * (10 ms by default) for the backlog to drop below the limit before
+ * queuing, or return -EAGAIN from call_rcu_try(). Producers within a
+ * read-side critical section, such as online QSBR threads, do not wait.
+ */
+struct call_rcu_attr {
+	unsigned int min_delay_ms;
+	unsigned int max_delay_ms;
+	unsigned long qlen_high_watermark;
+	unsigned int lazy_delay_ms;
+	unsigned long lazy_qlen_max;
+	unsigned int poll_interval_us;
+	int sched_policy;
+	int sched_priority;
+	const void *cpuset;
+	size_t cpuset_size;
+	size_t stack_size;
+	unsigned long parallel_threshold;
+	unsigned int nr_helpers;
+	unsigned long qlen_limit;
+	unsigned int limit_wait_ms;
+};
+
 /*
  * Exported functions
  *
@@ -69,9 +203,34 @@ struct rcu_head {
 
 void call_rcu(struct rcu_head *head,
 	      void (*func)(struct rcu_head *head));
+void call_rcu_lazy(struct rcu_head *head,
+	      void (*func)(struct rcu_head *head));
+void call_rcu_prio(struct rcu_head *head,
+	      void (*func)(struct rcu_head *head), unsigned int prio);
+void call_rcu_node(struct rcu_head *head,
+	      void (*func)(struct rcu_head *head), int node);
+int call_rcu_try(struct rcu_head *head,
+	      void (*func)(struct rcu_head *head));
+void call_rcu_sized(struct rcu_head_sized *head,
+	      void (*func)(struct rcu_head *head), size_t size);
+
+void call_rcu_class_init(struct call_rcu_class *cls,
+		void (*func)(struct rcu_head_compact *list));
+void call_rcu_typed(struct call_rcu_class *cls,
+		struct rcu_head_compact *head);
+void rcu_barrier_class(struct call_rcu_class *cls);
+
+void call_rcu_bulk(void (*func)(void *ptr), void **ptrs, unsigned long nr);
+void free_rcu(void *ptr);
+void free_rcu_flush(void);
+
+int set_thread_call_rcu_batch(unsigned long nr);
+void call_rcu_flush(void);
 
 struct call_rcu_data *create_call_rcu_data(unsigned long flags,
 					   int cpu_affinity);
+struct call_rcu_data *create_call_rcu_data_attr(unsigned long flags,
+		int cpu_affinity, const struct call_rcu_attr *attr);
 void call_rcu_data_free(struct call_rcu_data *crdp);
 
 struct call_rcu_data *get_default_call_rcu_data(void);
@@ -89,8 +248,32 @@ void free_all_cpu_call_rcu_data(void);
 void call_rcu_before_fork(void);
 void call_rcu_after_fork_parent(void);
 void call_rcu_after_fork_child(void);
+void call_rcu_set_fork_lazy(int lazy);
 
 void rcu_barrier(void);
+void rcu_barrier_crdp(struct call_rcu_data *crdp);
+void rcu_barrier_crdp_set(struct call_rcu_data **crdps, unsigned long nr);
+
+void rcu_get_stats(struct urcu_stats *stats);
+void rcu_get_mem_stats(struct urcu_mem_stats *stats);
+void call_rcu_data_get_stats(struct call_rcu_data *crdp,
+		struct urcu_call_rcu_stats *stats);
+void call_rcu_data_set_qlen_limit(struct call_rcu_data *crdp,
+		unsigned long qlen_limit, unsigned int limit_wait_ms);
+void call_rcu_set_func_sample_period(unsigned long period);
+void call_rcu_for_each_func_stats(void (*func)(
+			void (*cb)(struct rcu_head *head),
+			const struct urcu_call_rcu_func_stats *stats,
+			void *priv),
+		void *priv);
+
+unsigned long start_poll_synchronize_rcu(void);
+int start_poll_synchronize_rcu_fd(int fd, unsigned long *cookie);
+
+void rcu_reclaim_urgent(void);
+int rcu_reclaim_monitor_start(const char *path, unsigned int stall_us,
+		unsigned int window_us);
+void rcu_reclaim_monitor_stop(void);
 
 #ifdef __cplusplus
 }
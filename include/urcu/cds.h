@@ -23,6 +23,7 @@
  * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
  */
 
+#include <urcu/hash.h>
 #include <urcu/hlist.h>
 #include <urcu/list.h>
 #include <urcu/rcuhlist.h>
@@ -30,9 +31,30 @@
 #include <urcu/rculfqueue.h>
 #include <urcu/rculfstack.h>
 #include <urcu/rculfhash.h>
+#include <urcu/rculfhash-sharded.h>
+#include <urcu/rculfhash-cache.h>
+#include <urcu/rculfhash-expiry.h>
+#include <urcu/rculfhash-filter.h>
+#include <urcu/rculfhash-combine.h>
+#include <urcu/rcuoaht.h>
+#include <urcu/rcuskiplist.h>
+#include <urcu/rcuja.h>
+#include <urcu/rcupool.h>
+#include <urcu/rcuarray.h>
+#include <urcu/percpu-ref.h>
+#include <urcu/hazptr.h>
+#include <urcu/shm-domain.h>
+#include <urcu/shm-hash.h>
 #include <urcu/wfqueue.h>
 #include <urcu/wfcqueue.h>
+#include <urcu/wfcqueue-sharded.h>
+#include <urcu/wfcqueue-prio.h>
+#include <urcu/pipeline.h>
 #include <urcu/wfstack.h>
 #include <urcu/lfstack.h>
+#include <urcu/mpmcring.h>
+#include <urcu/spscring.h>
+#include <urcu/split-counter.h>
+#include <urcu/brlock.h>
 
 #endif /* _URCU_CDS_H */
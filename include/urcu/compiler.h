@@ -26,6 +26,12 @@
 
 #define	cmm_barrier()	__asm__ __volatile__ ("" : : : "memory")
 
+/*
+ * Hint the CPU to fetch the cache line holding addr for reading. Never
+ * faults, so addr may be invalid.
+ */
+#define caa_prefetch(addr)	__builtin_prefetch(addr)
+
 /*
  * Instruct the compiler to perform only a single access to a variable
  * (prohibits merging and refetching). The compiler is also forbidden to reorder
@@ -0,0 +1,198 @@
+#ifndef _URCU_CORO_HPP
+#define _URCU_CORO_HPP
+
+/*
+ * urcu/coro.hpp
+ *
+ * Userspace RCU library - C++20 coroutine awaitables for grace periods
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ *
+ * Awaitables work with any flavor, through its struct rcu_flavor_struct.
+ * For use with URCU_API_MAP (API mapping of liburcu), include this file
+ * _after_ including your URCU flavor: the flavor arguments then default
+ * to the current flavor. Read-side guards are in urcu/rcu.hpp.
+ */
+
+#if !defined(__cplusplus) || __cplusplus < 202002L
+#error "urcu/coro.hpp requires C++20."
+#endif
+
+#include <coroutine>
+#include <thread>
+#include <urcu/rcu.hpp>
+
+namespace urcu {
+
+/*
+ * How an awaiting coroutine is resumed once its wait is over. By default
+ * (fn is nullptr), it is resumed inline, from the thread which completed
+ * the wait: the call_rcu worker thread of the flavor for grace periods,
+ * or a helper thread for barriers. An event loop or thread pool provides
+ * fn to schedule the coroutine on one of its own threads instead, e.g. by
+ * queuing the handle and waking the loop.
+ */
+struct resumer {
+	void (*fn)(std::coroutine_handle<> handle, void *arg) = nullptr;
+	void *arg = nullptr;
+
+	void operator()(std::coroutine_handle<> handle) const
+	{
+		if (fn)
+			fn(handle, arg);
+		else
+			handle.resume();
+	}
+};
+
+/*
+ * Awaitable completing after a grace period of flavor has elapsed, as
+ * synchronize_rcu() does, without blocking the awaiting thread.
+ *
+ * The wait is a call_rcu() of an rcu_head stored in the coroutine frame,
+ * so awaiting needs no allocation. As for call_rcu(), the awaiting
+ * thread needs to be a registered RCU read-side thread. A coroutine
+ * resumed inline runs on the call_rcu worker thread, and delays the
+ * callbacks which follow it: it must not call rcu_barrier(), and should
+ * hand long work over to another thread.
+ *
+ * When given a cookie from the get_state_synchronize_rcu() or
+ * start_poll_synchronize_rcu() of flavor, the coroutine does not suspend
+ * at all if the grace period of cookie is already over.
+ */
+class grace_period_awaiter {
+public:
+	explicit grace_period_awaiter(const rcu_flavor_struct &flavor,
+			resumer resume = resumer())
+		: flavor_(flavor), resume_(resume), cookie_(0),
+		  has_cookie_(false)
+	{
+	}
+
+	grace_period_awaiter(const rcu_flavor_struct &flavor,
+			unsigned long cookie, resumer resume = resumer())
+		: flavor_(flavor), resume_(resume), cookie_(cookie),
+		  has_cookie_(true)
+	{
+	}
+
+	bool await_ready() const
+	{
+		return has_cookie_
+			&& flavor_.update_poll_state_synchronize_rcu(cookie_);
+	}
+
+	void await_suspend(std::coroutine_handle<> handle)
+	{
+		wait_.awaiter = this;
+		handle_ = handle;
+		flavor_.update_call_rcu(&wait_.head, complete);
+	}
+
+	void await_resume() const
+	{
+	}
+
+private:
+	/* Standard-layout, so head can be converted back to the wait. */
+	struct wait {
+		struct rcu_head head;
+		grace_period_awaiter *awaiter;
+	};
+
+	static void complete(struct rcu_head *head)
+	{
+		grace_period_awaiter *self =
+			reinterpret_cast<struct wait *>(head)->awaiter;
+
+		self->resume_(self->handle_);
+	}
+
+	const rcu_flavor_struct &flavor_;
+	resumer resume_;
+	unsigned long cookie_;
+	bool has_cookie_;
+	struct wait wait_;
+	std::coroutine_handle<> handle_;
+};
+
+/*
+ * Awaitable completing once all call_rcu() callbacks of flavor queued
+ * before the await have been invoked, as rcu_barrier() does.
+ *
+ * rcu_barrier() cannot be called from call_rcu worker threads, so the
+ * wait runs on a short-lived helper thread, which also resumes the
+ * coroutine by default. Barriers are meant for teardown paths, where the
+ * cost of a thread does not matter.
+ */
+class barrier_awaiter {
+public:
+	explicit barrier_awaiter(const rcu_flavor_struct &flavor,
+			resumer resume = resumer())
+		: flavor_(flavor), resume_(resume)
+	{
+	}
+
+	bool await_ready() const
+	{
+		return false;
+	}
+
+	void await_suspend(std::coroutine_handle<> handle)
+	{
+		const rcu_flavor_struct *flavor = &flavor_;
+		resumer resume = resume_;
+
+		/* The awaiter may be gone once the coroutine is resumed. */
+		std::thread([flavor, resume, handle]() {
+			flavor->barrier();
+			resume(handle);
+		}).detach();
+	}
+
+	void await_resume() const
+	{
+	}
+
+private:
+	const rcu_flavor_struct &flavor_;
+	resumer resume_;
+};
+
+#ifdef URCU_API_MAP
+/*
+ * Shortcuts for the current flavor, which must be included before this
+ * header.
+ */
+inline grace_period_awaiter grace_period(resumer resume = resumer())
+{
+	return grace_period_awaiter(rcu_flavor, resume);
+}
+
+inline grace_period_awaiter grace_period(unsigned long cookie,
+		resumer resume = resumer())
+{
+	return grace_period_awaiter(rcu_flavor, cookie, resume);
+}
+
+inline barrier_awaiter barrier(resumer resume = resumer())
+{
+	return barrier_awaiter(rcu_flavor, resume);
+}
+#endif /* URCU_API_MAP */
+
+} /* namespace urcu */
+
+#endif /* _URCU_CORO_HPP */
@@ -0,0 +1,58 @@
+#ifndef _URCU_CS_SAMPLE_H
+#define _URCU_CS_SAMPLE_H
+
+/*
+ * urcu/cs-sample.h
+ *
+ * Userspace RCU header - read-side critical-section duration sampling
+ *
+ * This header is meant to be included indirectly through a liburcu
+ * flavor header.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+#include <pthread.h>
+#include <urcu/stats.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*
+ * With --enable-rcu-cs-sampling, the memb, mb and signal flavors time
+ * one outermost read-side critical section every period, per reader,
+ * and add its duration to the statistics of the reader. A zero period,
+ * the default, disables sampling. Returns -ENOSYS if the library is
+ * built without sampling support.
+ */
+int rcu_set_cs_sample_period(unsigned long period);
+
+/*
+ * Invoke func with a snapshot of the critical-section statistics of
+ * each registered reader. Statistics of unregistered readers are lost.
+ * func is invoked with the reader registry lock held: it must not
+ * register or unregister threads, nor wait for grace periods. Returns
+ * -ENOSYS if the library is built without sampling support.
+ */
+int rcu_for_each_reader_cs_stats(void (*func)(pthread_t tid,
+			const struct urcu_cs_stats *stats, void *priv),
+		void *priv);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* _URCU_CS_SAMPLE_H */
@@ -30,6 +30,14 @@
 #include <stdlib.h>
 #include <pthread.h>
 
+#endif /* _URCU_DEFER_H */
+
+/*
+ * The functions below are declared each time a flavor header includes
+ * this header, under the names of its flavor, so that a program can
+ * use deferred reclamation with several flavors, e.g. QSBR and bp.
+ */
+
 #ifdef __cplusplus
 extern "C" {
 #endif
@@ -44,8 +52,10 @@ extern "C" {
  * rcu_defer_register_thread(). rcu_defer_unregister_thread() should be
  * called before the thread exits.
  *
- * *NEVER* use defer_rcu() within a RCU read-side critical section, because this
- * primitive need to call synchronize_rcu() if the thread queue is full.
+ * When the thread queue is full, defer_rcu() queues the callback with
+ * call_rcu() instead, so it does not wait for a grace period. Only if this
+ * allocation fails does it call synchronize_rcu() to empty the queue: to be
+ * safe, *NEVER* use defer_rcu() within a RCU read-side critical section.
  */
 
 extern void defer_rcu(void (*fct)(void *p), void *p);
@@ -58,8 +68,33 @@ extern void rcu_defer_unregister_thread(void);
 extern void rcu_defer_barrier(void);
 extern void rcu_defer_barrier_thread(void);
 
+/*
+ * rcu_defer_register_thread_size - register a thread with a queue size.
+ * @size: number of entries of the thread queue, power of 2, at least 8.
+ *
+ * Each callback takes one entry, or up to three when its function differs
+ * from that of the previous callback. rcu_defer_register_thread() uses
+ * 4096 entries. Return 0 on success, -EINVAL if size is invalid, or
+ * -ENOMEM.
+ */
+extern int rcu_defer_register_thread_size(unsigned long size);
+
+struct call_rcu_attr;
+
+/*
+ * rcu_defer_set_attr - set the batching policy of deferred callbacks.
+ * @attr: the policy, or NULL for the default.
+ *
+ * Deferred callbacks are executed by the default call_rcu thread, along
+ * with call_rcu() callbacks, after the same grace periods. The delays of
+ * attr become those of that thread, as set by create_call_rcu_data_attr():
+ * they also apply to the call_rcu() callbacks it executes. A thread queue
+ * reaching qlen_high_watermark entries ends the delay, so that memory is
+ * reclaimed immediately. A zero qlen_high_watermark selects half the size
+ * of each queue. The policy applies from the next batch.
+ */
+extern void rcu_defer_set_attr(const struct call_rcu_attr *attr);
+
 #ifdef __cplusplus
 }
 #endif
-
-#endif /* _URCU_DEFER_H */
@@ -23,6 +23,8 @@
  * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
  */
 
+#include <urcu/stats.h>
+
 #ifdef __cplusplus
 extern "C" {
 #endif
@@ -58,8 +60,27 @@ struct rcu_flavor_struct {
 
 	void (*register_rculfhash_atfork)(struct urcu_atfork *atfork);
 	void (*unregister_rculfhash_atfork)(struct urcu_atfork *atfork);
+
+	unsigned long (*update_get_state_synchronize_rcu)(void);
+	unsigned long (*update_start_poll_synchronize_rcu)(void);
+	int (*update_poll_state_synchronize_rcu)(unsigned long cookie);
+	void (*update_cond_synchronize_rcu)(unsigned long cookie);
+
+	void (*get_stats)(struct urcu_stats *stats);
+
+	/* Returns -ENOSYS if the flavor cannot skip isolated readers. */
+	int (*register_thread_isolated)(void);
 };
 
+/*
+ * Wait for a grace period of each of the nr flavors, with the grace
+ * periods running concurrently. The calling thread must be registered
+ * with each of the flavors, and not be within a read-side critical
+ * section of any of them.
+ */
+void urcu_synchronize_rcu_flavors(const struct rcu_flavor_struct * const *flavors,
+		unsigned int nr);
+
 #define DEFINE_RCU_FLAVOR(x)				\
 const struct rcu_flavor_struct x = {			\
 	.read_lock		= rcu_read_lock,	\
@@ -76,6 +97,12 @@ const struct rcu_flavor_struct x = {			\
 	.barrier		= rcu_barrier,		\
 	.register_rculfhash_atfork = urcu_register_rculfhash_atfork,	\
 	.unregister_rculfhash_atfork = urcu_unregister_rculfhash_atfork,\
+	.update_get_state_synchronize_rcu = get_state_synchronize_rcu,	\
+	.update_start_poll_synchronize_rcu = start_poll_synchronize_rcu,\
+	.update_poll_state_synchronize_rcu = poll_state_synchronize_rcu,\
+	.update_cond_synchronize_rcu = cond_synchronize_rcu,		\
+	.get_stats		= rcu_get_stats,	\
+	.register_thread_isolated = rcu_register_thread_isolated,	\
 }
 
 #define DEFINE_RCU_FLAVOR_ALIAS(x, y) _DEFINE_RCU_FLAVOR_ALIAS(x, y)
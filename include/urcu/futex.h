@@ -34,6 +34,32 @@ extern "C" {
 #define FUTEX_WAIT		0
 #define FUTEX_WAKE		1
 
+/*
+ * Process-private futex operations spare the kernel the lookup of the
+ * backing object of the futex address. The waiters and the wakers of a
+ * given futex must all agree on the flag, which is why it is only used
+ * on futexes private to the library code, never on futexes woken by
+ * inline functions of the public headers.
+ */
+#ifndef FUTEX_PRIVATE_FLAG
+#define FUTEX_PRIVATE_FLAG	128
+#endif
+#define FUTEX_WAIT_PRIVATE	(FUTEX_WAIT | FUTEX_PRIVATE_FLAG)
+#define FUTEX_WAKE_PRIVATE	(FUTEX_WAKE | FUTEX_PRIVATE_FLAG)
+
+/*
+ * Maximum number of futexes futex_waitv_async() can wait on.
+ */
+#define URCU_FUTEX_WAITV_MAX	128
+
+/*
+ * A futex for futex_waitv_async() to wait on, while *uaddr is val.
+ */
+struct urcu_futex_waiter {
+	int32_t *uaddr;
+	int32_t val;
+};
+
 /*
  * sys_futex compatibility header.
  * Use *only* *either of* futex_noasync OR futex_async on a given address.
@@ -52,6 +78,8 @@ extern int compat_futex_noasync(int32_t *uaddr, int op, int32_t val,
 		const struct timespec *timeout, int32_t *uaddr2, int32_t val3);
 extern int compat_futex_async(int32_t *uaddr, int op, int32_t val,
 		const struct timespec *timeout, int32_t *uaddr2, int32_t val3);
+extern int compat_futex_waitv_async(const struct urcu_futex_waiter *waiters,
+		unsigned int nr, int op, const struct timespec *timeout);
 
 #ifdef CONFIG_RCU_HAVE_FUTEX
 
@@ -103,6 +131,60 @@ static inline int futex_async(int32_t *uaddr, int op, int32_t val,
 	return ret;
 }
 
+/*
+ * Wait until one of the nr futexes of waiters is woken up, for at most the
+ * relative timeout if non-NULL. op is FUTEX_WAIT or FUTEX_WAIT_PRIVATE,
+ * matching the wake operation used on all of them. Returns the index of a
+ * futex woken up, or -1 with errno set to EWOULDBLOCK if a futex value
+ * already differs, ETIMEDOUT or EINTR. Uses futex_waitv(2) when
+ * available, and polls otherwise, as compat_futex_async() does.
+ */
+static inline int futex_waitv_async(const struct urcu_futex_waiter *waiters,
+		unsigned int nr, int op, const struct timespec *timeout)
+{
+#if defined(__NR_futex_waitv) && defined(CONFIG_RCU_HAVE_CLOCK_GETTIME)
+	struct {
+		uint64_t val;
+		uint64_t uaddr;
+		uint32_t flags;
+		uint32_t __reserved;
+	} kwaiters[URCU_FUTEX_WAITV_MAX];
+	struct timespec abs_timeout;
+	unsigned int i;
+	int ret;
+
+	if (nr > URCU_FUTEX_WAITV_MAX) {
+		errno = EINVAL;
+		return -1;
+	}
+	for (i = 0; i < nr; i++) {
+		kwaiters[i].val = (uint32_t) waiters[i].val;
+		kwaiters[i].uaddr = (uintptr_t) waiters[i].uaddr;
+		/* FUTEX2_SIZE_U32, and FUTEX2_PRIVATE shares its value. */
+		kwaiters[i].flags = 0x02 | (op & FUTEX_PRIVATE_FLAG);
+		kwaiters[i].__reserved = 0;
+	}
+	if (timeout) {
+		/* futex_waitv(2) expects an absolute monotonic timeout. */
+		if (clock_gettime(CLOCK_MONOTONIC, &abs_timeout))
+			return -1;
+		abs_timeout.tv_sec += timeout->tv_sec;
+		abs_timeout.tv_nsec += timeout->tv_nsec;
+		if (abs_timeout.tv_nsec >= 1000000000L) {
+			abs_timeout.tv_sec++;
+			abs_timeout.tv_nsec -= 1000000000L;
+		}
+	}
+	ret = syscall(__NR_futex_waitv, kwaiters, nr, 0,
+			timeout ? &abs_timeout : NULL, CLOCK_MONOTONIC);
+	if (caa_unlikely(ret < 0 && errno == ENOSYS))
+		return compat_futex_waitv_async(waiters, nr, op, timeout);
+	return ret;
+#else
+	return compat_futex_waitv_async(waiters, nr, op, timeout);
+#endif
+}
+
 #elif defined(__CYGWIN__)
 
 /*
@@ -122,6 +204,12 @@ static inline int futex_async(int32_t *uaddr, int op, int32_t val,
 	return compat_futex_async(uaddr, op, val, timeout, uaddr2, val3);
 }
 
+static inline int futex_waitv_async(const struct urcu_futex_waiter *waiters,
+		unsigned int nr, int op, const struct timespec *timeout)
+{
+	return compat_futex_waitv_async(waiters, nr, op, timeout);
+}
+
 #else
 
 static inline int futex_noasync(int32_t *uaddr, int op, int32_t val,
@@ -136,6 +224,12 @@ static inline int futex_async(int32_t *uaddr, int op, int32_t val,
 	return compat_futex_async(uaddr, op, val, timeout, uaddr2, val3);
 }
 
+static inline int futex_waitv_async(const struct urcu_futex_waiter *waiters,
+		unsigned int nr, int op, const struct timespec *timeout)
+{
+	return compat_futex_waitv_async(waiters, nr, op, timeout);
+}
+
 #endif
 
 #ifdef __cplusplus
@@ -0,0 +1,64 @@
+#ifndef _URCU_GP_THREAD_H
+#define _URCU_GP_THREAD_H
+
+/*
+ * urcu/gp-thread.h
+ *
+ * Userspace RCU header - dedicated grace-period thread
+ *
+ * This header is meant to be included indirectly through a liburcu
+ * flavor header.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*
+ * Start a thread performing the grace periods of synchronize_rcu() for
+ * the memb, mb, signal and qsbr flavors, pinned to cpu_affinity, or not
+ * pinned if it is -1. While it runs, callers of synchronize_rcu() only
+ * queue themselves and sleep, and it runs grace periods back to back
+ * for as long as callers queue. Returns 0 on success, -EBUSY if the
+ * thread is already running, or a negative error from pthread_create().
+ */
+int rcu_gp_thread_start(int cpu_affinity);
+
+/*
+ * Stop the grace-period thread, once the callers of synchronize_rcu()
+ * it saw queued are woken. Returns 0 on success, -EINVAL if the thread
+ * is not running. The thread is not re-created in the child of fork():
+ * stop it before forking, and start it again afterwards.
+ */
+int rcu_gp_thread_stop(void);
+
+/*
+ * Hold the start of each grace period of synchronize_rcu() for up to
+ * delay_us microseconds, or until nr_waiters callers are queued if
+ * nr_waiters is not 0, so that more callers share it. This raises the
+ * latency of synchronize_rcu() by up to delay_us for fewer grace
+ * periods under many concurrent callers. A delay_us of 0, the default,
+ * disables it. Returns 0 on success, -EINVAL if delay_us is above one
+ * second.
+ */
+int rcu_set_gp_coalesce(unsigned long delay_us, unsigned long nr_waiters);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* _URCU_GP_THREAD_H */
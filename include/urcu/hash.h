@@ -0,0 +1,277 @@
+#ifndef _URCU_HASH_H
+#define _URCU_HASH_H
+
+/*
+ * urcu/hash.h
+ *
+ * Userspace RCU library - Hash functions for hash tables
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+#include <urcu/compiler.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*
+ * Hash functions suitable for cds_lfht and the other hash tables of the
+ * library, which index buckets with the low bits of the hash and order
+ * chains by its reverse: all bits of the hash must be well mixed.
+ *
+ * - urcu_hash_u64(): integer keys, such as pointers or identifiers.
+ * - urcu_hash_bytes(): fast hash of byte strings, derived from wyhash
+ *   (final version 4).
+ * - urcu_hash_siphash24(): SipHash-2-4, keyed with a secret: for keys
+ *   chosen by an adversary, which could otherwise craft collisions.
+ * - urcu_hash_crc32c(): CRC32C, computed with the SSE4.2 or ARMv8 CRC
+ *   instructions when the CPU supports them. Checksum rather than hash:
+ *   32-bit only, and weaker mixing. Mix it with urcu_hash_u64() before
+ *   use as a table hash.
+ *
+ * Results are the same on all architectures, for a given seed or key.
+ */
+
+/* Read little-endian words from unaligned memory. */
+static inline
+uint64_t _urcu_hash_read64(const uint8_t *p)
+{
+	uint64_t v;
+
+	memcpy(&v, p, sizeof(v));
+#if defined(__BYTE_ORDER__) && (__BYTE_ORDER__ == __ORDER_BIG_ENDIAN__)
+	v = __builtin_bswap64(v);
+#endif
+	return v;
+}
+
+static inline
+uint64_t _urcu_hash_read32(const uint8_t *p)
+{
+	uint32_t v;
+
+	memcpy(&v, p, sizeof(v));
+#if defined(__BYTE_ORDER__) && (__BYTE_ORDER__ == __ORDER_BIG_ENDIAN__)
+	v = __builtin_bswap32(v);
+#endif
+	return v;
+}
+
+static inline
+uint64_t _urcu_hash_rotl64(uint64_t v, unsigned int shift)
+{
+	return (v << shift) | (v >> (64 - shift));
+}
+
+/*
+ * urcu_hash_u64 - hash a 64-bit integer key.
+ * @key: the key.
+ * @seed: hash seed.
+ *
+ * Bijective for a given seed: distinct keys never collide on the full
+ * 64-bit value. Uses the finalizer of MurmurHash3.
+ */
+static inline
+uint64_t urcu_hash_u64(uint64_t key, uint64_t seed)
+{
+	key ^= seed;
+	key ^= key >> 33;
+	key *= 0xff51afd7ed558ccdULL;
+	key ^= key >> 33;
+	key *= 0xc4ceb9fe1a85ec53ULL;
+	key ^= key >> 33;
+	return key;
+}
+
+/* 64x64 -> 128-bit multiply: low half in *a, high half in *b. */
+static inline
+void _urcu_hash_mum(uint64_t *a, uint64_t *b)
+{
+#ifdef __SIZEOF_INT128__
+	__uint128_t r = (__uint128_t) *a * *b;
+
+	*a = (uint64_t) r;
+	*b = (uint64_t) (r >> 64);
+#else
+	uint64_t ha = *a >> 32, hb = *b >> 32;
+	uint64_t la = (uint32_t) *a, lb = (uint32_t) *b;
+	uint64_t rh = ha * hb, rm0 = ha * lb, rm1 = hb * la, rl = la * lb;
+	uint64_t t = rl + (rm0 << 32), lo, c = t < rl;
+
+	lo = t + (rm1 << 32);
+	c += lo < t;
+	*a = lo;
+	*b = rh + (rm0 >> 32) + (rm1 >> 32) + c;
+#endif
+}
+
+static inline
+uint64_t _urcu_hash_mix(uint64_t a, uint64_t b)
+{
+	_urcu_hash_mum(&a, &b);
+	return a ^ b;
+}
+
+/*
+ * urcu_hash_bytes - hash a byte string.
+ * @key: the key bytes.
+ * @len: length of the key, in bytes.
+ * @seed: hash seed.
+ *
+ * Reads each byte of the key once, 48 bytes per iteration for long
+ * keys. Not resistant to collisions crafted by an adversary who knows
+ * the algorithm: use urcu_hash_siphash24() for such keys.
+ */
+static inline
+uint64_t urcu_hash_bytes(const void *key, size_t len, uint64_t seed)
+{
+	static const uint64_t secret[4] = {
+		0x2d358dccaa6c78a5ULL, 0x8bb84b93962eacc9ULL,
+		0x4b33a62ed433d4a3ULL, 0x4d5a2da51de1aa47ULL,
+	};
+	const uint8_t *p = (const uint8_t *) key;
+	uint64_t a, b;
+
+	seed ^= _urcu_hash_mix(seed ^ secret[0], secret[1]);
+	if (caa_likely(len <= 16)) {
+		if (caa_likely(len >= 4)) {
+			a = (_urcu_hash_read32(p) << 32)
+				| _urcu_hash_read32(p + ((len >> 3) << 2));
+			b = (_urcu_hash_read32(p + len - 4) << 32)
+				| _urcu_hash_read32(p + len - 4
+					- ((len >> 3) << 2));
+		} else if (caa_likely(len > 0)) {
+			a = ((uint64_t) p[0] << 16)
+				| ((uint64_t) p[len >> 1] << 8) | p[len - 1];
+			b = 0;
+		} else {
+			a = b = 0;
+		}
+	} else {
+		size_t i = len;
+
+		if (caa_unlikely(i >= 48)) {
+			uint64_t see1 = seed, see2 = seed;
+
+			do {
+				seed = _urcu_hash_mix(_urcu_hash_read64(p)
+						^ secret[1],
+					_urcu_hash_read64(p + 8) ^ seed);
+				see1 = _urcu_hash_mix(_urcu_hash_read64(p + 16)
+						^ secret[2],
+					_urcu_hash_read64(p + 24) ^ see1);
+				see2 = _urcu_hash_mix(_urcu_hash_read64(p + 32)
+						^ secret[3],
+					_urcu_hash_read64(p + 40) ^ see2);
+				p += 48;
+				i -= 48;
+			} while (caa_likely(i >= 48));
+			seed ^= see1 ^ see2;
+		}
+		while (caa_unlikely(i > 16)) {
+			seed = _urcu_hash_mix(_urcu_hash_read64(p) ^ secret[1],
+					_urcu_hash_read64(p + 8) ^ seed);
+			i -= 16;
+			p += 16;
+		}
+		a = _urcu_hash_read64(p + i - 16);
+		b = _urcu_hash_read64(p + i - 8);
+	}
+	a ^= secret[1];
+	b ^= seed;
+	_urcu_hash_mum(&a, &b);
+	return _urcu_hash_mix(a ^ secret[0] ^ len, b ^ secret[1]);
+}
+
+#define _URCU_SIPROUND(v0, v1, v2, v3)				\
+	do {							\
+		v0 += v1; v1 = _urcu_hash_rotl64(v1, 13);	\
+		v1 ^= v0; v0 = _urcu_hash_rotl64(v0, 32);	\
+		v2 += v3; v3 = _urcu_hash_rotl64(v3, 16);	\
+		v3 ^= v2;					\
+		v0 += v3; v3 = _urcu_hash_rotl64(v3, 21);	\
+		v3 ^= v0;					\
+		v2 += v1; v1 = _urcu_hash_rotl64(v1, 17);	\
+		v1 ^= v2; v2 = _urcu_hash_rotl64(v2, 32);	\
+	} while (0)
+
+/*
+ * urcu_hash_siphash24 - SipHash-2-4 of a byte string.
+ * @key: the key bytes.
+ * @len: length of the key, in bytes.
+ * @secret: 16-byte secret, to be chosen randomly and kept private.
+ *
+ * Keyed pseudo-random function: without the secret, an adversary
+ * cannot craft keys which collide, even knowing some hash values.
+ * Slower than urcu_hash_bytes().
+ */
+static inline
+uint64_t urcu_hash_siphash24(const void *key, size_t len,
+		const uint8_t secret[16])
+{
+	const uint8_t *p = (const uint8_t *) key;
+	uint64_t k0 = _urcu_hash_read64(secret);
+	uint64_t k1 = _urcu_hash_read64(secret + 8);
+	uint64_t v0 = k0 ^ 0x736f6d6570736575ULL;
+	uint64_t v1 = k1 ^ 0x646f72616e646f6dULL;
+	uint64_t v2 = k0 ^ 0x6c7967656e657261ULL;
+	uint64_t v3 = k1 ^ 0x7465646279746573ULL;
+	uint64_t m, last = (uint64_t) len << 56;
+	size_t i, tail = len & 7;
+
+	for (i = 0; i + 8 <= len; i += 8) {
+		m = _urcu_hash_read64(p + i);
+		v3 ^= m;
+		_URCU_SIPROUND(v0, v1, v2, v3);
+		_URCU_SIPROUND(v0, v1, v2, v3);
+		v0 ^= m;
+	}
+	while (tail--)
+		last |= (uint64_t) p[i + tail] << (8 * tail);
+	v3 ^= last;
+	_URCU_SIPROUND(v0, v1, v2, v3);
+	_URCU_SIPROUND(v0, v1, v2, v3);
+	v0 ^= last;
+	v2 ^= 0xff;
+	_URCU_SIPROUND(v0, v1, v2, v3);
+	_URCU_SIPROUND(v0, v1, v2, v3);
+	_URCU_SIPROUND(v0, v1, v2, v3);
+	_URCU_SIPROUND(v0, v1, v2, v3);
+	return v0 ^ v1 ^ v2 ^ v3;
+}
+
+/*
+ * urcu_hash_crc32c - compute the CRC32C (Castagnoli) of a buffer.
+ * @crc: CRC of the preceding data, 0 to start.
+ * @buf: the data.
+ * @len: length of the data, in bytes.
+ *
+ * Return the updated CRC: urcu_hash_crc32c(urcu_hash_crc32c(0, a, la),
+ * b, lb) is the CRC of the concatenation of a and b. Uses the SSE4.2
+ * crc32 instruction on x86-64 and the CRC32 extension on ARMv8 when the
+ * CPU supports them, as detected on first use, and a table otherwise.
+ */
+extern
+uint32_t urcu_hash_crc32c(uint32_t crc, const void *buf, size_t len);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* _URCU_HASH_H */
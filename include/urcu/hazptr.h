@@ -0,0 +1,197 @@
+#ifndef _URCU_HAZPTR_H
+#define _URCU_HAZPTR_H
+
+/*
+ * urcu/hazptr.h
+ *
+ * Userspace RCU library - Hazard-pointer memory reclamation
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+#include <urcu/compiler.h>
+#include <urcu/arch.h>
+#include <urcu/system.h>
+#include <urcu/uatomic.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*
+ * Hazard pointers, an alternative to RCU when the memory waiting for
+ * reclamation must stay bounded even if a reader stalls.
+ *
+ * A thread protects an object by publishing its address in one of the
+ * hazard slots of its record, and checking that the object is still
+ * reachable. Unlinked objects are retired to the record of the thread
+ * which unlinked them, and reclaimed by a scan of all hazard slots of
+ * the domain once the record holds enough retired objects: a stalled
+ * reader only keeps the objects it protects.
+ *
+ * Each record holds at most the scan threshold plus the number of slots
+ * of the domain retired objects. Records of exited threads are reused
+ * by threads created later, along with their remaining retired objects.
+ *
+ * Protecting an object costs a store, a memory barrier and a load. With
+ * URCU_HAZPTR_SYS_MEMBARRIER, the memory barrier becomes a compiler
+ * barrier, and each scan issues a membarrier system call instead.
+ *
+ * A record is used by the thread which got it only. Operations on a
+ * record, including scans, may run concurrently with operations on
+ * other records of the domain.
+ */
+
+/* Number of hazard slots of each record. */
+#define URCU_HAZPTR_NR_SLOTS		4
+
+/* Flags of urcu_hazptr_domain_create(). */
+#define URCU_HAZPTR_SYS_MEMBARRIER	(1U << 0)
+
+struct urcu_hazptr_domain;
+
+/*
+ * Embed struct urcu_hazptr_head in objects reclaimed through hazard
+ * pointers, as struct rcu_head for call_rcu().
+ */
+struct urcu_hazptr_head {
+	struct urcu_hazptr_head *next;
+	void *ptr;
+	void (*func)(struct urcu_hazptr_head *head);
+};
+
+/* Hazard slots of a thread. */
+struct urcu_hazptr_rec {
+	void *slots[URCU_HAZPTR_NR_SLOTS];
+	int sys_membarrier;		/* Read-only. */
+	struct urcu_hazptr_domain *domain;
+};
+
+/*
+ * urcu_hazptr_domain_create - create a hazard-pointer domain.
+ * @scan_threshold: number of retired objects of a record above which
+ *                  its retire scans the domain. 0 chooses a default.
+ * @flags: 0, or URCU_HAZPTR_SYS_MEMBARRIER to use asymmetric fences.
+ *
+ * When the membarrier system call is not supported, the domain falls
+ * back to memory barriers. Return NULL on allocation failure.
+ */
+extern
+struct urcu_hazptr_domain *urcu_hazptr_domain_create(
+		unsigned long scan_threshold, unsigned int flags);
+
+/*
+ * urcu_hazptr_domain_destroy - reclaim all retired objects, and free
+ * the domain and its records.
+ *
+ * No thread may use the domain or its records anymore.
+ */
+extern
+void urcu_hazptr_domain_destroy(struct urcu_hazptr_domain *domain);
+
+/*
+ * urcu_hazptr_rec_get - get the record of the calling thread.
+ *
+ * The record is allocated on first call from a thread, and released
+ * when the thread exits: callers may keep it for the lifetime of the
+ * thread. Aborts on allocation failure.
+ */
+extern
+struct urcu_hazptr_rec *urcu_hazptr_rec_get(struct urcu_hazptr_domain *domain);
+
+/*
+ * urcu_hazptr_retire - reclaim an object once no hazard slot holds it.
+ * @rec: record of the calling thread.
+ * @head: struct urcu_hazptr_head embedded in the object.
+ * @ptr: address protected by readers of the object.
+ * @func: reclaims the object.
+ *
+ * The object must be unlinked already: readers must not be able to
+ * reach it anymore. May call @func for retired objects of @rec from
+ * the calling thread.
+ */
+extern
+void urcu_hazptr_retire(struct urcu_hazptr_rec *rec,
+		struct urcu_hazptr_head *head, void *ptr,
+		void (*func)(struct urcu_hazptr_head *head));
+
+/*
+ * urcu_hazptr_reclaim - scan the domain now, and reclaim the retired
+ * objects of @rec which no hazard slot holds.
+ *
+ * Return the number of objects still retired to @rec.
+ */
+extern
+unsigned long urcu_hazptr_reclaim(struct urcu_hazptr_rec *rec);
+
+/*
+ * Slave side of the asymmetric fence: a compiler barrier when scans
+ * issue membarrier, a memory barrier otherwise.
+ */
+static inline
+void _urcu_hazptr_smp_mb_slave(struct urcu_hazptr_rec *rec)
+{
+	if (caa_likely(rec->sys_membarrier))
+		cmm_barrier();
+	else
+		cmm_smp_mb();
+}
+
+/*
+ * urcu_hazptr_protect - load a pointer and protect its target.
+ * @rec: record of the calling thread.
+ * @slot: hazard slot, below URCU_HAZPTR_NR_SLOTS.
+ * @pptr: pointer to a pointer to objects reclaimed through the domain.
+ *
+ * Return the value of *@pptr, published in @slot: the object it points
+ * to is not reclaimed until the slot is cleared or reused, even if it is
+ * unlinked meanwhile. Replaces the previous content of the slot.
+ */
+static inline
+void *urcu_hazptr_protect(struct urcu_hazptr_rec *rec, unsigned int slot,
+		void **pptr)
+{
+	void *p, *q;
+
+	p = CMM_LOAD_SHARED(*pptr);
+	for (;;) {
+		CMM_STORE_SHARED(rec->slots[slot], p);
+		/* Publish the slot before checking that p is still linked. */
+		_urcu_hazptr_smp_mb_slave(rec);
+		q = CMM_LOAD_SHARED(*pptr);
+		if (caa_likely(q == p))
+			break;
+		p = q;
+	}
+	cmm_smp_read_barrier_depends();
+	return p;
+}
+
+/*
+ * urcu_hazptr_clear - stop protecting the object of a hazard slot.
+ *
+ * Orders prior accesses to the object before the slot is cleared.
+ */
+static inline
+void urcu_hazptr_clear(struct urcu_hazptr_rec *rec, unsigned int slot)
+{
+	uatomic_store_release(&rec->slots[slot], NULL);
+}
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* _URCU_HAZPTR_H */
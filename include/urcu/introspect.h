@@ -0,0 +1,137 @@
+#ifndef _URCU_INTROSPECT_H
+#define _URCU_INTROSPECT_H
+
+/*
+ * urcu/introspect.h
+ *
+ * Userspace RCU header - runtime introspection of the flavor registries
+ *
+ * This header is meant to be included indirectly through a liburcu
+ * flavor header.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+#include <pthread.h>
+#include <urcu/stats.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*
+ * State of a registered reader. An active reader with an old snapshot
+ * is blocking the grace period in progress; with the current snapshot,
+ * it only blocks the grace periods starting after it. For QSBR, online
+ * readers are active, with the current snapshot once they reported a
+ * quiescent state for the grace period in progress.
+ */
+enum urcu_reader_info_state {
+	URCU_READER_INFO_INACTIVE = 0,
+	URCU_READER_INFO_ACTIVE_CURRENT,
+	URCU_READER_INFO_ACTIVE_OLD,
+};
+
+struct urcu_reader_info {
+	pthread_t tid;			/* Registering thread. */
+	enum urcu_reader_info_state state;
+	int detached;			/* Reader context (urcu/reader-ctx.h). */
+};
+
+struct call_rcu_data;
+
+struct urcu_call_rcu_info {
+	pthread_t tid;			/* call_rcu thread. */
+	int cpu_affinity;		/* -1 if not bound to a CPU. */
+	int numa_node;			/* -1 if unknown. */
+	unsigned long flags;		/* URCU_CALL_RCU_* flags. */
+	struct urcu_call_rcu_stats stats;
+};
+
+struct urcu_defer_queue_info {
+	pthread_t tid;			/* Registered thread. */
+	unsigned long fill;		/* Entries in use. */
+	unsigned long size;		/* Entries of the queue. */
+};
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* _URCU_INTROSPECT_H */
+
+/*
+ * The functions below are declared each time a flavor header includes
+ * this header, under the names of its flavor.
+ */
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*
+ * Invoke func for each registered reader, with its state at the time
+ * of the call. func is invoked with the reader registry lock held: it
+ * must not register or unregister threads, nor wait for grace periods.
+ * Returns -ENOSYS for the percpu flavor, which has no reader registry.
+ */
+int rcu_for_each_reader(void (*func)(const struct urcu_reader_info *info,
+			void *priv),
+		void *priv);
+
+/*
+ * Invoke func for each call_rcu_data, with a snapshot of its
+ * statistics. func is invoked with the call_rcu lock held: it must not
+ * create nor free call_rcu_data, nor wait for callbacks.
+ */
+void rcu_for_each_call_rcu_data(void (*func)(struct call_rcu_data *crdp,
+			const struct urcu_call_rcu_info *info, void *priv),
+		void *priv);
+
+/*
+ * Invoke func for each thread registered with rcu_defer_register_thread(),
+ * with the fill level of its queue. func is invoked with the defer lock
+ * held: it must not register or unregister threads for deferred
+ * reclamation, nor call rcu_defer_barrier().
+ */
+void rcu_for_each_defer_queue(void (*func)(
+			const struct urcu_defer_queue_info *info, void *priv),
+		void *priv);
+
+/*
+ * Write the readers, call_rcu_data and defer queues of the flavor to
+ * fd, one per line, as text. The locks are released before writing.
+ * Returns 0 on success, or a negative error number.
+ */
+int rcu_introspect_dump(int fd);
+
+/*
+ * Call rcu_introspect_dump(fd) from a dump thread each time the process
+ * receives signo, e.g. SIGUSR2: the signal handler only wakes up the
+ * thread. Returns 0 on success, -EBUSY if a dump thread is already
+ * running, -EINVAL if signo is invalid or used by the flavor, or a
+ * negative error number.
+ */
+int rcu_introspect_signal_start(int signo, int fd);
+
+/*
+ * Stop the dump thread started by rcu_introspect_signal_start(), if
+ * any, and restore the previous action of its signal.
+ */
+void rcu_introspect_signal_stop(void);
+
+#ifdef __cplusplus
+}
+#endif
@@ -29,6 +29,10 @@ extern "C" {
 
 #include <stdbool.h>
 #include <pthread.h>
+#include <urcu/compiler.h>
+#include <urcu/arch.h>
+
+struct urcu_hazptr_rec;
 
 /*
  * Lock-free stack.
@@ -89,6 +93,23 @@ typedef union {
 	struct cds_lfs_stack *s;
 } __attribute__((__transparent_union__)) cds_lfs_stack_ptr_t;
 
+/*
+ * Elimination array, optionally used alongside a stack by
+ * cds_lfs_push_elim() and __cds_lfs_pop_elim(). When a push and a pop
+ * both fail their cmpxchg on the stack head, the pushed node is handed
+ * over to the pop through a slot of the array, without touching the
+ * head. Slots are on separate cache-lines.
+ */
+#define CDS_LFS_ELIM_SLOTS	8
+
+struct cds_lfs_elim_slot {
+	struct cds_lfs_node *node;
+} __attribute__((aligned(CAA_CACHE_LINE_SIZE)));
+
+struct cds_lfs_elim {
+	struct cds_lfs_elim_slot slots[CDS_LFS_ELIM_SLOTS];
+};
+
 #ifdef _LGPL_SOURCE
 
 #include <urcu/static/lfstack.h>
@@ -99,6 +120,8 @@ typedef union {
 #define __cds_lfs_init			___cds_lfs_init
 #define cds_lfs_empty			_cds_lfs_empty
 #define cds_lfs_push			_cds_lfs_push
+#define cds_lfs_elim_init		_cds_lfs_elim_init
+#define cds_lfs_push_elim		_cds_lfs_push_elim
 
 /* Locking performed internally */
 #define cds_lfs_pop_blocking		_cds_lfs_pop_blocking
@@ -111,6 +134,9 @@ typedef union {
 /* Synchronization ensured by the caller. See synchronization table. */
 #define __cds_lfs_pop			___cds_lfs_pop
 #define __cds_lfs_pop_all		___cds_lfs_pop_all
+#define __cds_lfs_pop_elim		___cds_lfs_pop_elim
+#define __cds_lfs_pop_hazptr		___cds_lfs_pop_hazptr
+#define cds_lfs_pop_elim_blocking	_cds_lfs_pop_elim_blocking
 
 #else /* !_LGPL_SOURCE */
 
@@ -155,6 +181,30 @@ extern bool cds_lfs_empty(cds_lfs_stack_ptr_t s);
 extern bool cds_lfs_push(cds_lfs_stack_ptr_t s,
 			struct cds_lfs_node *node);
 
+/*
+ * cds_lfs_elim_init: initialize an elimination array.
+ */
+extern void cds_lfs_elim_init(struct cds_lfs_elim *elim);
+
+/*
+ * cds_lfs_push_elim: push a node into the stack, with elimination.
+ *
+ * Same as cds_lfs_push(), but may hand @node over to a concurrent
+ * __cds_lfs_pop_elim() through @elim under contention. The node is then
+ * never on the stack, and true is returned.
+ */
+extern bool cds_lfs_push_elim(cds_lfs_stack_ptr_t s,
+			struct cds_lfs_elim *elim,
+			struct cds_lfs_node *node);
+
+/*
+ * cds_lfs_pop_elim_blocking: pop a node from the stack, with elimination.
+ *
+ * Calls __cds_lfs_pop_elim with an internal pop mutex held.
+ */
+extern struct cds_lfs_node *cds_lfs_pop_elim_blocking(struct cds_lfs_stack *s,
+			struct cds_lfs_elim *elim);
+
 /*
  * cds_lfs_pop_blocking: pop a node from the stack.
  *
@@ -221,6 +271,29 @@ extern struct cds_lfs_node *__cds_lfs_pop(cds_lfs_stack_ptr_t s);
  */
 extern struct cds_lfs_head *__cds_lfs_pop_all(cds_lfs_stack_ptr_t s);
 
+/*
+ * __cds_lfs_pop_elim: pop a node from the stack, with elimination.
+ *
+ * Same as __cds_lfs_pop(), with the same synchronization requirements,
+ * but may take a node from a concurrent cds_lfs_push_elim() through
+ * @elim under contention.
+ */
+extern struct cds_lfs_node *__cds_lfs_pop_elim(cds_lfs_stack_ptr_t s,
+			struct cds_lfs_elim *elim);
+
+/*
+ * __cds_lfs_pop_hazptr: pop a node from the stack, protected by a
+ * hazard pointer.
+ *
+ * No synchronization is needed with other __cds_lfs_pop_hazptr callers
+ * nor with __cds_lfs_pop_all callers which retire the nodes they pop
+ * likewise: the returned node must be retired to the domain of @rec
+ * with urcu_hazptr_retire() before being freed or pushed back into the
+ * stack. Uses hazard slot 0 of @rec, cleared on return.
+ */
+extern struct cds_lfs_node *__cds_lfs_pop_hazptr(cds_lfs_stack_ptr_t s,
+			struct urcu_hazptr_rec *rec);
+
 #endif /* !_LGPL_SOURCE */
 
 /*
@@ -41,15 +41,40 @@
 #undef rcu_thread_online
 #undef rcu_register_thread
 #undef rcu_unregister_thread
+#undef rcu_register_thread_isolated
 #undef rcu_init
 #undef rcu_exit
 #undef synchronize_rcu
+#undef synchronize_rcu_expedited
+#undef rcu_gp_step_start
+#undef rcu_gp_step
+
+#undef srcu_domain_create
+#undef srcu_domain_destroy
+#undef srcu_register_thread
+#undef srcu_unregister_thread
+#undef srcu_read_lock
+#undef srcu_read_unlock
+#undef srcu_read_ongoing
+#undef synchronize_srcu
+#undef get_state_synchronize_srcu
+#undef poll_state_synchronize_srcu
+#undef cond_synchronize_srcu
+#undef srcu_get_stats
+#undef call_srcu
+#undef defer_srcu
+#undef srcu_barrier
+#undef get_state_synchronize_rcu
+#undef poll_state_synchronize_rcu
+#undef cond_synchronize_rcu
 #undef rcu_reader
 #undef rcu_gp
+#undef rcu_cs_sample_period
 
 #undef get_cpu_call_rcu_data
 #undef get_call_rcu_thread
 #undef create_call_rcu_data
+#undef create_call_rcu_data_attr
 #undef set_cpu_call_rcu_data
 #undef get_default_call_rcu_data
 #undef get_call_rcu_data
@@ -58,19 +83,66 @@
 #undef create_all_cpu_call_rcu_data
 #undef free_all_cpu_call_rcu_data
 #undef call_rcu
+#undef call_rcu_bulk
+#undef call_rcu_lazy
+#undef call_rcu_prio
+#undef call_rcu_node
+#undef call_rcu_try
+#undef call_rcu_class_init
+#undef call_rcu_typed
+#undef call_rcu_sized
+#undef rcu_barrier_class
+#undef free_rcu
+#undef free_rcu_flush
+#undef call_rcu_flush
+#undef set_thread_call_rcu_batch
 #undef call_rcu_data_free
 #undef call_rcu_before_fork
 #undef call_rcu_after_fork_parent
 #undef call_rcu_after_fork_child
+#undef call_rcu_set_fork_lazy
 #undef rcu_barrier
+#undef rcu_barrier_crdp
+#undef rcu_barrier_crdp_set
+#undef rcu_get_stats
+#undef rcu_get_mem_stats
+#undef rcu_set_stall_watchdog
+#undef rcu_set_reader_boost
+#undef rcu_set_cs_sample_period
+#undef rcu_for_each_reader_cs_stats
+#undef rcu_gp_thread_start
+#undef rcu_gp_thread_stop
+#undef rcu_set_gp_coalesce
+#undef rcu_reader_ctx_create
+#undef rcu_reader_ctx_destroy
+#undef rcu_read_lock_ctx
+#undef rcu_read_unlock_ctx
+#undef rcu_read_ongoing_ctx
+#undef call_rcu_data_get_stats
+#undef call_rcu_set_func_sample_period
+#undef call_rcu_for_each_func_stats
+#undef call_rcu_data_set_qlen_limit
+#undef rcu_for_each_reader
+#undef rcu_for_each_call_rcu_data
+#undef rcu_for_each_defer_queue
+#undef rcu_introspect_dump
+#undef rcu_introspect_signal_start
+#undef rcu_introspect_signal_stop
+#undef start_poll_synchronize_rcu
+#undef start_poll_synchronize_rcu_fd
+#undef rcu_reclaim_urgent
+#undef rcu_reclaim_monitor_start
+#undef rcu_reclaim_monitor_stop
 
 #undef defer_rcu
 #undef rcu_defer_register_thread
+#undef rcu_defer_register_thread_size
 #undef rcu_defer_unregister_thread
 #undef rcu_defer_barrier
 
 #undef rcu_defer_barrier_thread
 #undef rcu_defer_exit
+#undef rcu_defer_set_attr
 
 #undef rcu_flavor
 
@@ -43,15 +43,20 @@
 #define rcu_thread_online		urcu_bp_thread_online
 #define rcu_register_thread		urcu_bp_register_thread
 #define rcu_unregister_thread		urcu_bp_unregister_thread
+#define rcu_register_thread_isolated	urcu_bp_register_thread_isolated
 #define rcu_init			urcu_bp_init
 #define rcu_exit			urcu_bp_exit
 #define synchronize_rcu			urcu_bp_synchronize_rcu
+#define get_state_synchronize_rcu	urcu_bp_get_state_synchronize_rcu
+#define poll_state_synchronize_rcu	urcu_bp_poll_state_synchronize_rcu
+#define cond_synchronize_rcu		urcu_bp_cond_synchronize_rcu
 #define rcu_reader			urcu_bp_reader
 #define rcu_gp				urcu_bp_gp
 
 #define get_cpu_call_rcu_data		urcu_bp_get_cpu_call_rcu_data
 #define get_call_rcu_thread		urcu_bp_get_call_rcu_thread
 #define create_call_rcu_data		urcu_bp_create_call_rcu_data
+#define create_call_rcu_data_attr	urcu_bp_create_call_rcu_data_attr
 #define set_cpu_call_rcu_data		urcu_bp_set_cpu_call_rcu_data
 #define get_default_call_rcu_data	urcu_bp_get_default_call_rcu_data
 #define get_call_rcu_data		urcu_bp_get_call_rcu_data
@@ -60,18 +65,55 @@
 #define create_all_cpu_call_rcu_data	urcu_bp_create_all_cpu_call_rcu_data
 #define free_all_cpu_call_rcu_data	urcu_bp_free_all_cpu_call_rcu_data
 #define call_rcu			urcu_bp_call_rcu
+#define call_rcu_bulk			urcu_bp_call_rcu_bulk
+#define call_rcu_lazy			urcu_bp_call_rcu_lazy
+#define call_rcu_prio			urcu_bp_call_rcu_prio
+#define call_rcu_node			urcu_bp_call_rcu_node
+#define call_rcu_try			urcu_bp_call_rcu_try
+#define call_rcu_class_init		urcu_bp_call_rcu_class_init
+#define call_rcu_typed			urcu_bp_call_rcu_typed
+#define call_rcu_sized			urcu_bp_call_rcu_sized
+#define rcu_barrier_class		urcu_bp_barrier_class
+#define free_rcu			urcu_bp_free_rcu
+#define free_rcu_flush			urcu_bp_free_rcu_flush
+#define call_rcu_flush			urcu_bp_call_rcu_flush
+#define set_thread_call_rcu_batch	urcu_bp_set_thread_call_rcu_batch
 #define call_rcu_data_free		urcu_bp_call_rcu_data_free
 #define call_rcu_before_fork		urcu_bp_call_rcu_before_fork
 #define call_rcu_after_fork_parent	urcu_bp_call_rcu_after_fork_parent
 #define call_rcu_after_fork_child	urcu_bp_call_rcu_after_fork_child
+#define call_rcu_set_fork_lazy		urcu_bp_call_rcu_set_fork_lazy
 #define rcu_barrier			urcu_bp_barrier
+#define rcu_barrier_crdp		urcu_bp_barrier_crdp
+#define rcu_barrier_crdp_set		urcu_bp_barrier_crdp_set
+#define rcu_get_stats			urcu_bp_get_stats
+#define rcu_get_mem_stats		urcu_bp_get_mem_stats
+#define rcu_set_stall_watchdog		urcu_bp_set_stall_watchdog
+#define call_rcu_data_get_stats		urcu_bp_call_rcu_data_get_stats
+#define call_rcu_set_func_sample_period	\
+		urcu_bp_call_rcu_set_func_sample_period
+#define call_rcu_for_each_func_stats	urcu_bp_call_rcu_for_each_func_stats
+#define call_rcu_data_set_qlen_limit	urcu_bp_call_rcu_data_set_qlen_limit
+#define rcu_for_each_reader		urcu_bp_for_each_reader
+#define rcu_for_each_call_rcu_data	urcu_bp_for_each_call_rcu_data
+#define rcu_for_each_defer_queue	urcu_bp_for_each_defer_queue
+#define rcu_introspect_dump		urcu_bp_introspect_dump
+#define rcu_introspect_signal_start	urcu_bp_introspect_signal_start
+#define rcu_introspect_signal_stop	urcu_bp_introspect_signal_stop
+#define start_poll_synchronize_rcu	urcu_bp_start_poll_synchronize_rcu
+#define start_poll_synchronize_rcu_fd	urcu_bp_start_poll_synchronize_rcu_fd
+#define rcu_reclaim_urgent		urcu_bp_reclaim_urgent
+#define rcu_reclaim_monitor_start	urcu_bp_reclaim_monitor_start
+#define rcu_reclaim_monitor_stop	urcu_bp_reclaim_monitor_stop
 
 #define defer_rcu			urcu_bp_defer_rcu
 #define rcu_defer_register_thread	urcu_bp_defer_register_thread
+#define rcu_defer_register_thread_size	urcu_bp_defer_register_thread_size
 #define rcu_defer_unregister_thread	urcu_bp_defer_unregister_thread
 #define rcu_defer_barrier		urcu_bp_defer_barrier
 #define rcu_defer_barrier_thread	urcu_bp_defer_barrier_thread
 #define rcu_defer_exit			urcu_bp_defer_exit
+#define rcu_defer_set_attr		urcu_bp_defer_set_attr
 
 #define rcu_flavor			urcu_bp_flavor
 
@@ -41,15 +41,41 @@
 #define rcu_thread_online		urcu_memb_thread_online
 #define rcu_register_thread		urcu_memb_register_thread
 #define rcu_unregister_thread		urcu_memb_unregister_thread
+#define rcu_register_thread_isolated	urcu_memb_register_thread_isolated
 #define rcu_init			urcu_memb_init
 #define rcu_exit			urcu_memb_exit
 #define synchronize_rcu			urcu_memb_synchronize_rcu
+#define synchronize_rcu_expedited	urcu_memb_synchronize_rcu_expedited
+#define rcu_gp_step_start		urcu_memb_gp_step_start
+#define rcu_gp_step			urcu_memb_gp_step
+
+#define srcu_domain_create		urcu_memb_srcu_domain_create
+#define srcu_domain_destroy		urcu_memb_srcu_domain_destroy
+#define srcu_register_thread		urcu_memb_srcu_register_thread
+#define srcu_unregister_thread		urcu_memb_srcu_unregister_thread
+#define srcu_read_lock			urcu_memb_srcu_read_lock
+#define srcu_read_unlock		urcu_memb_srcu_read_unlock
+#define srcu_read_ongoing		urcu_memb_srcu_read_ongoing
+#define synchronize_srcu		urcu_memb_synchronize_srcu
+#define get_state_synchronize_srcu	urcu_memb_get_state_synchronize_srcu
+#define poll_state_synchronize_srcu	urcu_memb_poll_state_synchronize_srcu
+#define cond_synchronize_srcu		urcu_memb_cond_synchronize_srcu
+#define srcu_get_stats			urcu_memb_srcu_get_stats
+#define call_srcu			urcu_memb_call_srcu
+#define defer_srcu			urcu_memb_defer_srcu
+#define srcu_barrier			urcu_memb_srcu_barrier
+
+#define get_state_synchronize_rcu	urcu_memb_get_state_synchronize_rcu
+#define poll_state_synchronize_rcu	urcu_memb_poll_state_synchronize_rcu
+#define cond_synchronize_rcu		urcu_memb_cond_synchronize_rcu
 #define rcu_reader			urcu_memb_reader
 #define rcu_gp				urcu_memb_gp
+#define rcu_cs_sample_period		urcu_memb_cs_sample_period
 
 #define get_cpu_call_rcu_data		urcu_memb_get_cpu_call_rcu_data
 #define get_call_rcu_thread		urcu_memb_get_call_rcu_thread
 #define create_call_rcu_data		urcu_memb_create_call_rcu_data
+#define create_call_rcu_data_attr	urcu_memb_create_call_rcu_data_attr
 #define set_cpu_call_rcu_data		urcu_memb_set_cpu_call_rcu_data
 #define get_default_call_rcu_data	urcu_memb_get_default_call_rcu_data
 #define get_call_rcu_data		urcu_memb_get_call_rcu_data
@@ -58,18 +84,66 @@
 #define create_all_cpu_call_rcu_data	urcu_memb_create_all_cpu_call_rcu_data
 #define free_all_cpu_call_rcu_data	urcu_memb_free_all_cpu_call_rcu_data
 #define call_rcu			urcu_memb_call_rcu
+#define call_rcu_bulk			urcu_memb_call_rcu_bulk
+#define call_rcu_lazy			urcu_memb_call_rcu_lazy
+#define call_rcu_prio			urcu_memb_call_rcu_prio
+#define call_rcu_node			urcu_memb_call_rcu_node
+#define call_rcu_try			urcu_memb_call_rcu_try
+#define call_rcu_class_init		urcu_memb_call_rcu_class_init
+#define call_rcu_typed			urcu_memb_call_rcu_typed
+#define call_rcu_sized			urcu_memb_call_rcu_sized
+#define rcu_barrier_class		urcu_memb_barrier_class
+#define free_rcu			urcu_memb_free_rcu
+#define free_rcu_flush			urcu_memb_free_rcu_flush
+#define call_rcu_flush			urcu_memb_call_rcu_flush
+#define set_thread_call_rcu_batch	urcu_memb_set_thread_call_rcu_batch
 #define call_rcu_data_free		urcu_memb_call_rcu_data_free
 #define call_rcu_before_fork		urcu_memb_call_rcu_before_fork
 #define call_rcu_after_fork_parent	urcu_memb_call_rcu_after_fork_parent
 #define call_rcu_after_fork_child	urcu_memb_call_rcu_after_fork_child
+#define call_rcu_set_fork_lazy		urcu_memb_call_rcu_set_fork_lazy
 #define rcu_barrier			urcu_memb_barrier
+#define rcu_barrier_crdp		urcu_memb_barrier_crdp
+#define rcu_barrier_crdp_set		urcu_memb_barrier_crdp_set
+#define rcu_get_stats			urcu_memb_get_stats
+#define rcu_get_mem_stats		urcu_memb_get_mem_stats
+#define rcu_set_stall_watchdog		urcu_memb_set_stall_watchdog
+#define rcu_set_reader_boost		urcu_memb_set_reader_boost
+#define rcu_set_cs_sample_period	urcu_memb_set_cs_sample_period
+#define rcu_for_each_reader_cs_stats	urcu_memb_for_each_reader_cs_stats
+#define rcu_gp_thread_start		urcu_memb_gp_thread_start
+#define rcu_gp_thread_stop		urcu_memb_gp_thread_stop
+#define rcu_set_gp_coalesce		urcu_memb_set_gp_coalesce
+#define rcu_reader_ctx_create		urcu_memb_reader_ctx_create
+#define rcu_reader_ctx_destroy		urcu_memb_reader_ctx_destroy
+#define rcu_read_lock_ctx		urcu_memb_read_lock_ctx
+#define rcu_read_unlock_ctx		urcu_memb_read_unlock_ctx
+#define rcu_read_ongoing_ctx		urcu_memb_read_ongoing_ctx
+#define call_rcu_data_get_stats		urcu_memb_call_rcu_data_get_stats
+#define call_rcu_set_func_sample_period	\
+		urcu_memb_call_rcu_set_func_sample_period
+#define call_rcu_for_each_func_stats	urcu_memb_call_rcu_for_each_func_stats
+#define call_rcu_data_set_qlen_limit	urcu_memb_call_rcu_data_set_qlen_limit
+#define rcu_for_each_reader		urcu_memb_for_each_reader
+#define rcu_for_each_call_rcu_data	urcu_memb_for_each_call_rcu_data
+#define rcu_for_each_defer_queue	urcu_memb_for_each_defer_queue
+#define rcu_introspect_dump		urcu_memb_introspect_dump
+#define rcu_introspect_signal_start	urcu_memb_introspect_signal_start
+#define rcu_introspect_signal_stop	urcu_memb_introspect_signal_stop
+#define start_poll_synchronize_rcu	urcu_memb_start_poll_synchronize_rcu
+#define start_poll_synchronize_rcu_fd	urcu_memb_start_poll_synchronize_rcu_fd
+#define rcu_reclaim_urgent		urcu_memb_reclaim_urgent
+#define rcu_reclaim_monitor_start	urcu_memb_reclaim_monitor_start
+#define rcu_reclaim_monitor_stop	urcu_memb_reclaim_monitor_stop
 
 #define defer_rcu			urcu_memb_defer_rcu
 #define rcu_defer_register_thread	urcu_memb_defer_register_thread
+#define rcu_defer_register_thread_size	urcu_memb_defer_register_thread_size
 #define rcu_defer_unregister_thread	urcu_memb_defer_unregister_thread
 #define rcu_defer_barrier		urcu_memb_defer_barrier
 #define rcu_defer_barrier_thread	urcu_memb_defer_barrier_thread
 #define rcu_defer_exit			urcu_memb_defer_exit
+#define rcu_defer_set_attr		urcu_memb_defer_set_attr
 
 #define rcu_flavor			urcu_memb_flavor
 
@@ -0,0 +1,115 @@
+/*
+ * urcu/map/urcu-percpu.h
+ *
+ * Userspace RCU header -- name mapping to allow multiple flavors to be
+ * used in the same executable.
+ *
+ * LGPL-compatible code should include this header with :
+ *
+ * #define _LGPL_SOURCE
+ * #include <urcu/urcu-percpu.h>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+#define rcu_read_lock			urcu_percpu_read_lock
+#define _rcu_read_lock			_urcu_percpu_read_lock
+#define rcu_read_unlock			urcu_percpu_read_unlock
+#define _rcu_read_unlock		_urcu_percpu_read_unlock
+#define rcu_read_ongoing		urcu_percpu_read_ongoing
+#define _rcu_read_ongoing		_urcu_percpu_read_ongoing
+#define rcu_quiescent_state		urcu_percpu_quiescent_state
+#define _rcu_quiescent_state		_urcu_percpu_quiescent_state
+#define rcu_thread_offline		urcu_percpu_thread_offline
+#define rcu_thread_online		urcu_percpu_thread_online
+#define rcu_register_thread		urcu_percpu_register_thread
+#define rcu_unregister_thread		urcu_percpu_unregister_thread
+#define rcu_register_thread_isolated	urcu_percpu_register_thread_isolated
+#define rcu_init			urcu_percpu_init
+#define rcu_exit			urcu_percpu_exit
+#define synchronize_rcu			urcu_percpu_synchronize_rcu
+#define get_state_synchronize_rcu	urcu_percpu_get_state_synchronize_rcu
+#define poll_state_synchronize_rcu	urcu_percpu_poll_state_synchronize_rcu
+#define cond_synchronize_rcu		urcu_percpu_cond_synchronize_rcu
+#define rcu_reader			urcu_percpu_reader
+#define rcu_gp				urcu_percpu_gp
+
+#define get_cpu_call_rcu_data		urcu_percpu_get_cpu_call_rcu_data
+#define get_call_rcu_thread		urcu_percpu_get_call_rcu_thread
+#define create_call_rcu_data		urcu_percpu_create_call_rcu_data
+#define create_call_rcu_data_attr	urcu_percpu_create_call_rcu_data_attr
+#define set_cpu_call_rcu_data		urcu_percpu_set_cpu_call_rcu_data
+#define get_default_call_rcu_data	urcu_percpu_get_default_call_rcu_data
+#define get_call_rcu_data		urcu_percpu_get_call_rcu_data
+#define get_thread_call_rcu_data	urcu_percpu_get_thread_call_rcu_data
+#define set_thread_call_rcu_data	urcu_percpu_set_thread_call_rcu_data
+#define create_all_cpu_call_rcu_data	urcu_percpu_create_all_cpu_call_rcu_data
+#define free_all_cpu_call_rcu_data	urcu_percpu_free_all_cpu_call_rcu_data
+#define call_rcu			urcu_percpu_call_rcu
+#define call_rcu_bulk			urcu_percpu_call_rcu_bulk
+#define call_rcu_lazy			urcu_percpu_call_rcu_lazy
+#define call_rcu_prio			urcu_percpu_call_rcu_prio
+#define call_rcu_node			urcu_percpu_call_rcu_node
+#define call_rcu_try			urcu_percpu_call_rcu_try
+#define call_rcu_class_init		urcu_percpu_call_rcu_class_init
+#define call_rcu_typed			urcu_percpu_call_rcu_typed
+#define call_rcu_sized			urcu_percpu_call_rcu_sized
+#define rcu_barrier_class		urcu_percpu_barrier_class
+#define free_rcu			urcu_percpu_free_rcu
+#define free_rcu_flush			urcu_percpu_free_rcu_flush
+#define call_rcu_flush			urcu_percpu_call_rcu_flush
+#define set_thread_call_rcu_batch	urcu_percpu_set_thread_call_rcu_batch
+#define call_rcu_data_free		urcu_percpu_call_rcu_data_free
+#define call_rcu_before_fork		urcu_percpu_call_rcu_before_fork
+#define call_rcu_after_fork_parent	urcu_percpu_call_rcu_after_fork_parent
+#define call_rcu_after_fork_child	urcu_percpu_call_rcu_after_fork_child
+#define call_rcu_set_fork_lazy		urcu_percpu_call_rcu_set_fork_lazy
+#define rcu_barrier			urcu_percpu_barrier
+#define rcu_barrier_crdp		urcu_percpu_barrier_crdp
+#define rcu_barrier_crdp_set		urcu_percpu_barrier_crdp_set
+#define rcu_get_stats			urcu_percpu_get_stats
+#define rcu_get_mem_stats		urcu_percpu_get_mem_stats
+#define call_rcu_data_get_stats		urcu_percpu_call_rcu_data_get_stats
+#define call_rcu_set_func_sample_period	\
+		urcu_percpu_call_rcu_set_func_sample_period
+#define call_rcu_for_each_func_stats	urcu_percpu_call_rcu_for_each_func_stats
+#define call_rcu_data_set_qlen_limit	urcu_percpu_call_rcu_data_set_qlen_limit
+#define rcu_for_each_reader		urcu_percpu_for_each_reader
+#define rcu_for_each_call_rcu_data	urcu_percpu_for_each_call_rcu_data
+#define rcu_for_each_defer_queue	urcu_percpu_for_each_defer_queue
+#define rcu_introspect_dump		urcu_percpu_introspect_dump
+#define rcu_introspect_signal_start	urcu_percpu_introspect_signal_start
+#define rcu_introspect_signal_stop	urcu_percpu_introspect_signal_stop
+#define start_poll_synchronize_rcu	urcu_percpu_start_poll_synchronize_rcu
+#define start_poll_synchronize_rcu_fd	urcu_percpu_start_poll_synchronize_rcu_fd
+#define rcu_reclaim_urgent		urcu_percpu_reclaim_urgent
+#define rcu_reclaim_monitor_start	urcu_percpu_reclaim_monitor_start
+#define rcu_reclaim_monitor_stop	urcu_percpu_reclaim_monitor_stop
+
+#define defer_rcu			urcu_percpu_defer_rcu
+#define rcu_defer_register_thread	urcu_percpu_defer_register_thread
+#define rcu_defer_register_thread_size	urcu_percpu_defer_register_thread_size
+#define rcu_defer_unregister_thread	urcu_percpu_defer_unregister_thread
+#define rcu_defer_barrier		urcu_percpu_defer_barrier
+#define rcu_defer_barrier_thread	urcu_percpu_defer_barrier_thread
+#define rcu_defer_exit			urcu_percpu_defer_exit
+#define rcu_defer_set_attr		urcu_percpu_defer_set_attr
+
+#define rcu_flavor			urcu_percpu_flavor
+
+#define urcu_register_rculfhash_atfork	\
+		urcu_percpu_register_rculfhash_atfork
+#define urcu_unregister_rculfhash_atfork	\
+		urcu_percpu_unregister_rculfhash_atfork
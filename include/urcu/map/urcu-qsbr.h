@@ -41,14 +41,19 @@
 #define rcu_thread_online		urcu_qsbr_thread_online
 #define rcu_register_thread		urcu_qsbr_register_thread
 #define rcu_unregister_thread		urcu_qsbr_unregister_thread
+#define rcu_register_thread_isolated	urcu_qsbr_register_thread_isolated
 #define rcu_exit			urcu_qsbr_exit
 #define synchronize_rcu			urcu_qsbr_synchronize_rcu
+#define get_state_synchronize_rcu	urcu_qsbr_get_state_synchronize_rcu
+#define poll_state_synchronize_rcu	urcu_qsbr_poll_state_synchronize_rcu
+#define cond_synchronize_rcu		urcu_qsbr_cond_synchronize_rcu
 #define rcu_reader			urcu_qsbr_reader
 #define rcu_gp				urcu_qsbr_gp
 
 #define get_cpu_call_rcu_data		urcu_qsbr_get_cpu_call_rcu_data
 #define get_call_rcu_thread		urcu_qsbr_get_call_rcu_thread
 #define create_call_rcu_data		urcu_qsbr_create_call_rcu_data
+#define create_call_rcu_data_attr	urcu_qsbr_create_call_rcu_data_attr
 #define set_cpu_call_rcu_data		urcu_qsbr_set_cpu_call_rcu_data
 #define get_default_call_rcu_data	urcu_qsbr_get_default_call_rcu_data
 #define get_call_rcu_data		urcu_qsbr_get_call_rcu_data
@@ -57,18 +62,59 @@
 #define create_all_cpu_call_rcu_data	urcu_qsbr_create_all_cpu_call_rcu_data
 #define free_all_cpu_call_rcu_data	urcu_qsbr_free_all_cpu_call_rcu_data
 #define call_rcu			urcu_qsbr_call_rcu
+#define call_rcu_bulk			urcu_qsbr_call_rcu_bulk
+#define call_rcu_lazy			urcu_qsbr_call_rcu_lazy
+#define call_rcu_prio			urcu_qsbr_call_rcu_prio
+#define call_rcu_node			urcu_qsbr_call_rcu_node
+#define call_rcu_try			urcu_qsbr_call_rcu_try
+#define call_rcu_class_init		urcu_qsbr_call_rcu_class_init
+#define call_rcu_typed			urcu_qsbr_call_rcu_typed
+#define call_rcu_sized			urcu_qsbr_call_rcu_sized
+#define rcu_barrier_class		urcu_qsbr_barrier_class
+#define free_rcu			urcu_qsbr_free_rcu
+#define free_rcu_flush			urcu_qsbr_free_rcu_flush
+#define call_rcu_flush			urcu_qsbr_call_rcu_flush
+#define set_thread_call_rcu_batch	urcu_qsbr_set_thread_call_rcu_batch
 #define call_rcu_data_free		urcu_qsbr_call_rcu_data_free
 #define call_rcu_before_fork		urcu_qsbr_call_rcu_before_fork
 #define call_rcu_after_fork_parent	urcu_qsbr_call_rcu_after_fork_parent
 #define call_rcu_after_fork_child	urcu_qsbr_call_rcu_after_fork_child
+#define call_rcu_set_fork_lazy		urcu_qsbr_call_rcu_set_fork_lazy
 #define rcu_barrier			urcu_qsbr_barrier
+#define rcu_barrier_crdp		urcu_qsbr_barrier_crdp
+#define rcu_barrier_crdp_set		urcu_qsbr_barrier_crdp_set
+#define rcu_get_stats			urcu_qsbr_get_stats
+#define rcu_get_mem_stats		urcu_qsbr_get_mem_stats
+#define rcu_set_stall_watchdog		urcu_qsbr_set_stall_watchdog
+#define rcu_set_reader_boost		urcu_qsbr_set_reader_boost
+#define rcu_gp_thread_start		urcu_qsbr_gp_thread_start
+#define rcu_gp_thread_stop		urcu_qsbr_gp_thread_stop
+#define rcu_set_gp_coalesce		urcu_qsbr_set_gp_coalesce
+#define call_rcu_data_get_stats		urcu_qsbr_call_rcu_data_get_stats
+#define call_rcu_set_func_sample_period	\
+		urcu_qsbr_call_rcu_set_func_sample_period
+#define call_rcu_for_each_func_stats	urcu_qsbr_call_rcu_for_each_func_stats
+#define call_rcu_data_set_qlen_limit	urcu_qsbr_call_rcu_data_set_qlen_limit
+#define rcu_for_each_reader		urcu_qsbr_for_each_reader
+#define rcu_for_each_call_rcu_data	urcu_qsbr_for_each_call_rcu_data
+#define rcu_for_each_defer_queue	urcu_qsbr_for_each_defer_queue
+#define rcu_introspect_dump		urcu_qsbr_introspect_dump
+#define rcu_introspect_signal_start	urcu_qsbr_introspect_signal_start
+#define rcu_introspect_signal_stop	urcu_qsbr_introspect_signal_stop
+#define start_poll_synchronize_rcu	urcu_qsbr_start_poll_synchronize_rcu
+#define start_poll_synchronize_rcu_fd	urcu_qsbr_start_poll_synchronize_rcu_fd
+#define rcu_reclaim_urgent		urcu_qsbr_reclaim_urgent
+#define rcu_reclaim_monitor_start	urcu_qsbr_reclaim_monitor_start
+#define rcu_reclaim_monitor_stop	urcu_qsbr_reclaim_monitor_stop
 
 #define defer_rcu			urcu_qsbr_defer_rcu
 #define rcu_defer_register_thread	urcu_qsbr_defer_register_thread
+#define rcu_defer_register_thread_size	urcu_qsbr_defer_register_thread_size
 #define rcu_defer_unregister_thread	urcu_qsbr_defer_unregister_thread
 #define	rcu_defer_barrier		urcu_qsbr_defer_barrier
 #define rcu_defer_barrier_thread	urcu_qsbr_defer_barrier_thread
 #define rcu_defer_exit			urcu_qsbr_defer_exit
+#define rcu_defer_set_attr		urcu_qsbr_defer_set_attr
 
 #define rcu_flavor			urcu_qsbr_flavor
 
@@ -0,0 +1,133 @@
+#ifndef _URCU_MPMCRING_H
+#define _URCU_MPMCRING_H
+
+/*
+ * urcu/mpmcring.h
+ *
+ * Userspace RCU library - Bounded Lock-Free Multi-Producer/Multi-Consumer Ring
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+#include <stdbool.h>
+#include <urcu/compiler.h>
+#include <urcu/arch.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*
+ * Bounded array-based queue with lock-free enqueue and dequeue, after
+ * Dmitry Vyukov's bounded MPMC queue.
+ *
+ * Each slot holds a sequence number telling which position may use it
+ * next: a position equal to the slot sequence may be enqueued, and a
+ * sequence one past the position may be dequeued. Producers and
+ * consumers claim positions with a cmpxchg on their own counter, so no
+ * node allocation is needed and only one cache line per element is
+ * touched.
+ *
+ * All cds_mpmc_ring_* operations can be called concurrently from any
+ * number of threads without external synchronization. This ring does
+ * _not_ specifically rely on RCU.
+ */
+
+struct cds_mpmc_ring_slot {
+	unsigned long seq;
+	void *data;
+};
+
+/*
+ * Keep enqueue and dequeue positions on separate cache-lines to
+ * eliminate false-sharing between producers and consumers.
+ */
+struct cds_mpmc_ring {
+	unsigned long enqueue_pos __attribute__((aligned(CAA_CACHE_LINE_SIZE)));
+	unsigned long dequeue_pos __attribute__((aligned(CAA_CACHE_LINE_SIZE)));
+	unsigned long mask __attribute__((aligned(CAA_CACHE_LINE_SIZE)));
+	struct cds_mpmc_ring_slot *slots;
+};
+
+#ifdef _LGPL_SOURCE
+
+#include <urcu/static/mpmcring.h>
+
+#define cds_mpmc_ring_init		_cds_mpmc_ring_init
+#define cds_mpmc_ring_try_enqueue	_cds_mpmc_ring_try_enqueue
+#define cds_mpmc_ring_try_dequeue	_cds_mpmc_ring_try_dequeue
+#define cds_mpmc_ring_enqueue_bulk	_cds_mpmc_ring_enqueue_bulk
+#define cds_mpmc_ring_dequeue_bulk	_cds_mpmc_ring_dequeue_bulk
+
+#else /* !_LGPL_SOURCE */
+
+/*
+ * cds_mpmc_ring_init: initialize an empty ring.
+ * @ring: ring to initialize.
+ * @slots: array of @capacity slots, owned by the caller until the ring
+ *         is no longer used.
+ * @capacity: number of slots, a power of two of at least 2.
+ *
+ * Returns 0 on success, -EINVAL if @capacity is not a power of two of
+ * at least 2.
+ */
+extern int cds_mpmc_ring_init(struct cds_mpmc_ring *ring,
+		struct cds_mpmc_ring_slot *slots, unsigned long capacity);
+
+/*
+ * cds_mpmc_ring_try_enqueue: enqueue @data into the ring.
+ *
+ * Returns false without waiting if the ring is full.
+ * Issues a full memory barrier before enqueue.
+ */
+extern bool cds_mpmc_ring_try_enqueue(struct cds_mpmc_ring *ring,
+		void *data);
+
+/*
+ * cds_mpmc_ring_try_dequeue: dequeue the oldest element into @data.
+ *
+ * Returns false without waiting if the ring is empty, or if the oldest
+ * position was claimed by a producer which has not published it yet.
+ * Issues a full memory barrier after dequeue.
+ */
+extern bool cds_mpmc_ring_try_dequeue(struct cds_mpmc_ring *ring,
+		void **data);
+
+/*
+ * cds_mpmc_ring_enqueue_bulk: enqueue up to @n elements from @data.
+ *
+ * Claims a contiguous range of positions at once, so elements of a
+ * batch stay in order. Returns the number of elements enqueued, which
+ * is less than @n when the ring fills up, and 0 when it is full.
+ */
+extern unsigned long cds_mpmc_ring_enqueue_bulk(struct cds_mpmc_ring *ring,
+		void **data, unsigned long n);
+
+/*
+ * cds_mpmc_ring_dequeue_bulk: dequeue up to @n elements into @data.
+ *
+ * Returns the number of elements dequeued, in ring order. Returns 0
+ * when no element is ready.
+ */
+extern unsigned long cds_mpmc_ring_dequeue_bulk(struct cds_mpmc_ring *ring,
+		void **data, unsigned long n);
+
+#endif /* !_LGPL_SOURCE */
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* _URCU_MPMCRING_H */
@@ -0,0 +1,155 @@
+#ifndef _URCU_PERCPU_REF_H
+#define _URCU_PERCPU_REF_H
+
+/*
+ * urcu/percpu-ref.h
+ *
+ * Userspace RCU library - Per-CPU reference counter
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ *
+ * For use with URCU_API_MAP (API mapping of liburcu), include this file
+ * _after_ including your URCU flavor.
+ */
+
+#include <stdbool.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+struct rcu_flavor_struct;
+struct urcu_percpu_ref_data;
+
+/*
+ * Reference counter for objects taken and released from many CPUs,
+ * modeled on the percpu_ref of the Linux kernel.
+ *
+ * While alive, gets and puts update a counter of the current CPU, in
+ * its own cache line: unlike struct urcu_ref, they do not bounce a
+ * shared cache line between CPUs, but the count is unknown. Killing
+ * the reference drops the initial reference and switches to a shared
+ * atomic counter, after a grace period of the flavor during which
+ * concurrent gets and puts switch over. The release callback is then
+ * invoked exactly once, by the last put, or by the call_rcu worker
+ * thread of the flavor if the count reached zero before the switch.
+ *
+ * Gets and puts are RCU read-side critical sections of the flavor:
+ * they must be called from registered reader threads, online for QSBR,
+ * and may be called within read-side critical sections.
+ *
+ * Each reference uses one cache line per configured CPU.
+ */
+struct urcu_percpu_ref {
+	unsigned long percpu_ptr;	/* Per-CPU counters | dead flag. */
+	struct urcu_percpu_ref_data *data;
+};
+
+/*
+ * urcu_percpu_ref_init_flavor - initialize a reference, holding one
+ * reference.
+ * @release: called once the count reaches zero after the kill.
+ * @flavor: RCU flavor of the gets, puts and kill.
+ *
+ * Return 0 on success, -ENOMEM on allocation failure.
+ */
+extern
+int urcu_percpu_ref_init_flavor(struct urcu_percpu_ref *ref,
+		void (*release)(struct urcu_percpu_ref *ref),
+		const struct rcu_flavor_struct *flavor);
+
+/*
+ * urcu_percpu_ref_exit - free the memory of a reference.
+ *
+ * Called from the release callback, or on a reference never killed
+ * and not used by other threads anymore.
+ */
+extern
+void urcu_percpu_ref_exit(struct urcu_percpu_ref *ref);
+
+/*
+ * urcu_percpu_ref_get - take a reference.
+ *
+ * The caller must hold a reference already, or otherwise ensure that
+ * the count is not zero: use urcu_percpu_ref_tryget() otherwise.
+ */
+extern
+void urcu_percpu_ref_get(struct urcu_percpu_ref *ref);
+
+/*
+ * urcu_percpu_ref_tryget - take a reference unless the count is zero.
+ *
+ * The reference must still exist, e.g. be protected by RCU. Returns
+ * true if the reference is taken.
+ */
+extern
+bool urcu_percpu_ref_tryget(struct urcu_percpu_ref *ref);
+
+/*
+ * urcu_percpu_ref_tryget_live - take a reference unless it is killed.
+ *
+ * Fails as soon as urcu_percpu_ref_kill() is called, even if the count
+ * is not zero yet. Returns true if the reference is taken.
+ */
+extern
+bool urcu_percpu_ref_tryget_live(struct urcu_percpu_ref *ref);
+
+/*
+ * urcu_percpu_ref_put - release a reference.
+ *
+ * Invokes the release callback if this was the last reference of a
+ * killed reference counter.
+ */
+extern
+void urcu_percpu_ref_put(struct urcu_percpu_ref *ref);
+
+/*
+ * urcu_percpu_ref_kill - drop the initial reference, and switch to
+ * exact counting.
+ *
+ * Once called, urcu_percpu_ref_tryget_live() fails. Must be called
+ * once, by a thread holding the initial reference. Does not wait for
+ * the grace period: the switch completes from the call_rcu worker
+ * thread of the flavor.
+ */
+extern
+void urcu_percpu_ref_kill(struct urcu_percpu_ref *ref);
+
+/*
+ * urcu_percpu_ref_is_zero - whether the count of a killed reference
+ * counter reached zero.
+ */
+extern
+bool urcu_percpu_ref_is_zero(struct urcu_percpu_ref *ref);
+
+#ifdef URCU_API_MAP
+/*
+ * urcu_percpu_ref_init - initialize a reference for the current flavor.
+ *
+ * Note: the RCU flavor must be already included before this header.
+ */
+static inline
+int urcu_percpu_ref_init(struct urcu_percpu_ref *ref,
+		void (*release)(struct urcu_percpu_ref *ref))
+{
+	return urcu_percpu_ref_init_flavor(ref, release, &rcu_flavor);
+}
+#endif /* URCU_API_MAP */
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* _URCU_PERCPU_REF_H */
@@ -0,0 +1,147 @@
+#ifndef _URCU_PIPELINE_H
+#define _URCU_PIPELINE_H
+
+/*
+ * urcu/pipeline.h
+ *
+ * Userspace RCU library - Multi-stage pipeline over wfcqueue
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+#include <stdint.h>
+#include <urcu/wfcqueue.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*
+ * A pipeline passes nodes, embedded in the objects of the caller,
+ * through a sequence of stages. Each stage has its own pool of worker
+ * threads and input queue: a worker takes all the nodes queued to its
+ * stage at once with a splice, invokes the function of the stage on
+ * each of them, and splices the nodes it forwards to the input queue of
+ * the next stage at once. Nodes are never copied, and ownership of a
+ * node moves with it from stage to stage.
+ *
+ * A node leaves the pipeline when a stage function returns
+ * CDS_PIPELINE_CONSUMED, or after the last stage: the function of the
+ * stage owns it from then on. Nodes of a stage are processed in order
+ * with a single worker, and may be reordered with more.
+ *
+ * Note that struct cds_pipeline is opaque to callers.
+ */
+struct cds_pipeline;
+
+struct cds_pipeline_node {
+	struct cds_wfcq_node node;
+	uint64_t enqueue_ns;	/* Time of arrival in the current stage. */
+};
+
+/* Return values of stage functions. */
+#define CDS_PIPELINE_FORWARD	0	/* Pass the node to the next stage. */
+#define CDS_PIPELINE_CONSUMED	1	/* The node leaves the pipeline. */
+
+/*
+ * Statistics of a stage, cumulative since its creation, and read
+ * without synchronization with its workers. Throughput follows from
+ * nodes and busy_ns, latency from wait_sum_ns and busy_ns / batches.
+ */
+struct cds_pipeline_stage_stats {
+	unsigned long nodes;		/* Nodes processed. */
+	unsigned long batches;		/* Splices from the input queue. */
+	uint64_t busy_ns;		/* Time spent processing batches. */
+	/* Time from the arrival of nodes to the start of their batch. */
+	uint64_t wait_sum_ns;
+	uint64_t wait_max_ns;
+};
+
+/*
+ * cds_pipeline_create - create a pipeline without stages.
+ * @max_in_flight: maximum number of nodes in the pipeline, past which
+ *                 submitters wait, or 0 for no limit.
+ *
+ * Return NULL on allocation failure.
+ */
+extern
+struct cds_pipeline *cds_pipeline_create(unsigned long max_in_flight);
+
+/*
+ * cds_pipeline_add_stage - append a stage to a pipeline.
+ * @nr_workers: number of worker threads of the stage, at least 1.
+ * @fn: function invoked on each node of the stage, from its workers,
+ *      returning CDS_PIPELINE_FORWARD or CDS_PIPELINE_CONSUMED.
+ * @priv: passed to fn.
+ *
+ * Stages must all be added before the first node is submitted. Return
+ * the index of the stage, -EINVAL if nr_workers is 0, or -ENOMEM.
+ */
+extern
+int cds_pipeline_add_stage(struct cds_pipeline *pipeline,
+		unsigned int nr_workers,
+		int (*fn)(struct cds_pipeline_node *node, void *priv),
+		void *priv);
+
+/*
+ * cds_pipeline_try_submit - pass a node to the first stage.
+ *
+ * Return 0 if the node is submitted, -EAGAIN if the pipeline holds
+ * max_in_flight nodes. Wait-free when there is room.
+ */
+extern
+int cds_pipeline_try_submit(struct cds_pipeline *pipeline,
+		struct cds_pipeline_node *node);
+
+/*
+ * cds_pipeline_submit - pass a node to the first stage, waiting for
+ * the pipeline to hold less than max_in_flight nodes.
+ *
+ * Must not be called from stage functions of the same pipeline.
+ */
+extern
+void cds_pipeline_submit(struct cds_pipeline *pipeline,
+		struct cds_pipeline_node *node);
+
+/*
+ * cds_pipeline_drain - wait for all nodes submitted to leave the
+ * pipeline.
+ */
+extern
+void cds_pipeline_drain(struct cds_pipeline *pipeline);
+
+/*
+ * cds_pipeline_get_stage_stats - get the statistics of a stage.
+ * @stage: index of the stage, returned by cds_pipeline_add_stage().
+ *
+ * Return 0 on success, -EINVAL if there is no such stage.
+ */
+extern
+int cds_pipeline_get_stage_stats(struct cds_pipeline *pipeline,
+		unsigned int stage, struct cds_pipeline_stage_stats *stats);
+
+/*
+ * cds_pipeline_destroy - drain a pipeline, stop its workers and free it.
+ *
+ * Must not be called concurrently with submissions.
+ */
+extern
+void cds_pipeline_destroy(struct cds_pipeline *pipeline);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* _URCU_PIPELINE_H */
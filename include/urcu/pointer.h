@@ -122,6 +122,75 @@ extern void *rcu_set_pointer_sym(void **p, void *v);
  */
 #define rcu_assign_pointer(p, v)	rcu_set_pointer((&p), (v))
 
+/*
+ * Sequence counter, for consistent reads of several RCU-protected
+ * pointers, or of a pointer and other fields, without publishing them
+ * together in a newly allocated structure.
+ *
+ * Writers, serialized by the caller, update the fields between
+ * rcu_seqcount_write_begin() and rcu_seqcount_write_end(). Readers read
+ * them between rcu_seqcount_read_begin() and rcu_seqcount_read_retry(),
+ * and retry if a write happened meanwhile. Unlike with a plain seqlock,
+ * the pointers read by an attempt which is retried remain valid, as long
+ * as the reader stays within its RCU read-side critical section.
+ *
+ * The sequence value returned by rcu_seqcount_read_begin() is even, and
+ * increases by 2 with each write: it can serve as generation of the
+ * values read.
+ */
+struct rcu_seqcount {
+	unsigned long seq;
+};
+
+#define RCU_SEQCOUNT_INIT	{ 0 }
+
+static inline
+void rcu_seqcount_init(struct rcu_seqcount *s)
+{
+	s->seq = 0;
+}
+
+static inline
+void rcu_seqcount_write_begin(struct rcu_seqcount *s)
+{
+	CMM_ACCESS_ONCE(s->seq) = s->seq + 1;
+	/* Order the odd sequence before the updates. */
+	cmm_smp_wmb();
+}
+
+static inline
+void rcu_seqcount_write_end(struct rcu_seqcount *s)
+{
+	/* Order the updates before the even sequence. */
+	cmm_smp_wmb();
+	CMM_ACCESS_ONCE(s->seq) = s->seq + 1;
+	cmm_smp_wmc();
+}
+
+static inline
+unsigned long rcu_seqcount_read_begin(struct rcu_seqcount *s)
+{
+	unsigned long seq;
+
+	while ((seq = uatomic_read(&s->seq)) & 1)
+		caa_cpu_relax();
+	/* Order the sequence before the reads of the fields. */
+	cmm_smp_rmb();
+	return seq;
+}
+
+/*
+ * Return whether a write happened since rcu_seqcount_read_begin()
+ * returned @seq: the values read must then be read again.
+ */
+static inline
+int rcu_seqcount_read_retry(struct rcu_seqcount *s, unsigned long seq)
+{
+	/* Order the reads of the fields before the sequence. */
+	cmm_smp_rmb();
+	return uatomic_read(&s->seq) != seq;
+}
+
 #ifdef __cplusplus
 }
 #endif
@@ -0,0 +1,125 @@
+#ifndef _URCU_QSBR_BLOCK_H
+#define _URCU_QSBR_BLOCK_H
+
+/*
+ * urcu/qsbr-block.h
+ *
+ * Userspace RCU QSBR header - blocking calls in extended quiescent state
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ *
+ * Include this file _after_ including urcu/urcu-qsbr.h.
+ */
+
+#include <urcu/urcu-qsbr.h>
+
+#ifdef __linux__
+#include <signal.h>
+#include <sys/epoll.h>
+#endif
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*
+ * Event-loop threads of the QSBR flavor spend their idle time in
+ * blocking system calls. Putting them offline around these calls lets
+ * grace periods complete without waiting for the next event: the
+ * thread is in an extended quiescent state while it blocks.
+ *
+ * Going offline and back online stores the reader counter, and checks
+ * whether a grace period waits on the thread to wake it up. The memory
+ * barriers around these stores become compiler barriers once
+ * urcu_qsbr_enable_sys_membarrier() succeeded: a loop iteration then
+ * costs two stores and a few loads of the reader state, whether or not
+ * grace periods happen.
+ *
+ * The helpers nest: a thread already offline stays offline, and the
+ * errno of the blocking call is preserved.
+ */
+
+/*
+ * urcu_qsbr_blocking_begin - enter an extended quiescent state before
+ * a blocking call.
+ *
+ * Must be called outside of read-side critical sections, for a
+ * registered thread. Returns whether the thread was online, to be
+ * passed to urcu_qsbr_blocking_end().
+ */
+static inline int urcu_qsbr_blocking_begin(void)
+{
+	if (!urcu_qsbr_read_ongoing())
+		return 0;
+	urcu_qsbr_thread_offline();
+	return 1;
+}
+
+/*
+ * urcu_qsbr_blocking_end - leave the extended quiescent state entered by
+ * urcu_qsbr_blocking_begin(), once the blocking call returned.
+ */
+static inline void urcu_qsbr_blocking_end(int was_online)
+{
+	if (was_online)
+		urcu_qsbr_thread_online();
+}
+
+/*
+ * URCU_QSBR_BLOCKING_CALL - evaluate a blocking call in an extended
+ * quiescent state, and return its value. For instance, with liburing:
+ *
+ *	ret = URCU_QSBR_BLOCKING_CALL(io_uring_submit_and_wait(&ring, 1));
+ */
+#define URCU_QSBR_BLOCKING_CALL(call)					\
+	__extension__							\
+	({								\
+		int _was_online = urcu_qsbr_blocking_begin();		\
+		__typeof__(call) _ret = (call);				\
+		urcu_qsbr_blocking_end(_was_online);			\
+		_ret;							\
+	})
+
+#ifdef __linux__
+/*
+ * urcu_qsbr_epoll_wait - epoll_wait(2) in an extended quiescent state.
+ * urcu_qsbr_epoll_pwait - epoll_pwait(2) in an extended quiescent state.
+ *
+ * A zero timeout does not block: the thread then stays online.
+ */
+static inline int urcu_qsbr_epoll_wait(int epfd, struct epoll_event *events,
+		int maxevents, int timeout)
+{
+	if (!timeout)
+		return epoll_wait(epfd, events, maxevents, 0);
+	return URCU_QSBR_BLOCKING_CALL(epoll_wait(epfd, events, maxevents,
+			timeout));
+}
+
+static inline int urcu_qsbr_epoll_pwait(int epfd, struct epoll_event *events,
+		int maxevents, int timeout, const sigset_t *sigmask)
+{
+	if (!timeout)
+		return epoll_pwait(epfd, events, maxevents, 0, sigmask);
+	return URCU_QSBR_BLOCKING_CALL(epoll_pwait(epfd, events, maxevents,
+			timeout, sigmask));
+}
+#endif /* __linux__ */
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* _URCU_QSBR_BLOCK_H */
@@ -0,0 +1,101 @@
+#ifndef _URCU_QSBR_DQ_H
+#define _URCU_QSBR_DQ_H
+
+/*
+ * urcu/qsbr-dq.h
+ *
+ * Userspace RCU QSBR header - inline reclamation defer queue
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ *
+ * Include this file _after_ including urcu/urcu-qsbr.h.
+ */
+
+#include <urcu/urcu-qsbr.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*
+ * Bounded queue of objects removed by a writer, each tagged with a
+ * grace-period token, and freed by the writer itself once their token
+ * is reached, without call_rcu() worker thread nor blocking on
+ * synchronize_rcu(). Enqueuing reclaims the objects already safe to
+ * free when the queue fills up, and so does urcu_qsbr_dq_reclaim(),
+ * for instance from the writer event loop: reader threads reporting
+ * quiescent states often enough keep the queue from filling up.
+ *
+ * A queue belongs to one writer at a time: its callers serialize its
+ * use, for instance with the lock protecting the updates. They must be
+ * outside of read-side critical sections.
+ */
+struct urcu_qsbr_dq;
+
+/*
+ * urcu_qsbr_dq_create - allocate a defer queue.
+ *
+ * @size: number of objects the queue holds.
+ * @trigger_reclaim_limit: number of queued objects from which
+ *                         urcu_qsbr_dq_enqueue() reclaims.
+ * @max_reclaim_size: maximum number of objects freed by each of these
+ *                    reclamations, to bound the writer latency. 0 means
+ *                    no maximum.
+ * @free_func: function freeing an object, called with @priv.
+ *
+ * Returns NULL on allocation failure, or if @size is 0.
+ */
+extern
+struct urcu_qsbr_dq *urcu_qsbr_dq_create(unsigned long size,
+		unsigned long trigger_reclaim_limit,
+		unsigned long max_reclaim_size,
+		void (*free_func)(void *ptr, void *priv), void *priv);
+
+/*
+ * urcu_qsbr_dq_destroy - free a defer queue.
+ *
+ * Reclaims the queued objects first. Returns 0 on success, or -EAGAIN,
+ * leaving the queue in place, if some of them cannot be freed yet.
+ */
+extern
+int urcu_qsbr_dq_destroy(struct urcu_qsbr_dq *dq);
+
+/*
+ * urcu_qsbr_dq_enqueue - queue an object removed from RCU structures,
+ * to be freed once readers cannot reference it anymore.
+ *
+ * Returns 0 on success, or -ENOSPC if the queue is still full after
+ * reclaiming: the caller then has to free the object itself, after
+ * synchronize_rcu().
+ */
+extern
+int urcu_qsbr_dq_enqueue(struct urcu_qsbr_dq *dq, void *ptr);
+
+/*
+ * urcu_qsbr_dq_reclaim - free up to @max queued objects (0 for all)
+ * whose token is reached, oldest first.
+ *
+ * Returns the number of objects freed, and stores the number of objects
+ * left in the queue in *@pending if it is not NULL.
+ */
+extern
+unsigned long urcu_qsbr_dq_reclaim(struct urcu_qsbr_dq *dq,
+		unsigned long max, unsigned long *pending);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* _URCU_QSBR_DQ_H */
@@ -0,0 +1,214 @@
+#ifndef _URCU_RCU_HPP
+#define _URCU_RCU_HPP
+
+/*
+ * urcu/rcu.hpp
+ *
+ * Userspace RCU library - C++ flavor traits, read-side guards and rcu_ptr
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ *
+ * For use with URCU_API_MAP (API mapping of liburcu), include this file
+ * _after_ including your URCU flavor: urcu::default_flavor is then the
+ * current flavor.
+ */
+
+#if !defined(__cplusplus) || __cplusplus < 201103L
+#error "urcu/rcu.hpp requires C++11."
+#endif
+
+#include <urcu/pointer.h>
+#include <urcu/flavor.h>
+
+/*
+ * URCU_DEFINE_FLAVOR_TRAITS(name, fl) defines the flavor traits class
+ * name, calling the functions of the flavor prefixed by fl, e.g.
+ * urcu_qsbr, whose header must be included. Templates taking flavor
+ * traits pick the flavor at compile time: their calls are direct, and
+ * inlined for flavors built with _LGPL_SOURCE.
+ */
+#define URCU_DEFINE_FLAVOR_TRAITS(name, fl)				\
+struct name {								\
+	static void read_lock() { fl##_read_lock(); }			\
+	static void read_unlock() { fl##_read_unlock(); }		\
+	static void call(struct rcu_head *head,				\
+			void (*func)(struct rcu_head *head))		\
+	{								\
+		fl##_call_rcu(head, func);				\
+	}								\
+	static void synchronize() { fl##_synchronize_rcu(); }		\
+	static void barrier() { fl##_barrier(); }			\
+	static void class_init(struct call_rcu_class *cls,		\
+			void (*func)(struct rcu_head_compact *list))	\
+	{								\
+		fl##_call_rcu_class_init(cls, func);			\
+	}								\
+	static void call_typed(struct call_rcu_class *cls,		\
+			struct rcu_head_compact *head)			\
+	{								\
+		fl##_call_rcu_typed(cls, head);				\
+	}								\
+	static void barrier_class(struct call_rcu_class *cls)		\
+	{								\
+		fl##_barrier_class(cls);				\
+	}								\
+	static const struct rcu_flavor_struct &flavor()		\
+	{								\
+		return fl##_flavor;					\
+	}								\
+}
+
+namespace urcu {
+
+/*
+ * Traits of the flavor included before this header, only defined with
+ * URCU_API_MAP.
+ */
+struct default_flavor;
+
+#ifdef URCU_API_MAP
+struct default_flavor {
+	static void read_lock() { rcu_read_lock(); }
+	static void read_unlock() { rcu_read_unlock(); }
+	static void call(struct rcu_head *head,
+			void (*func)(struct rcu_head *head))
+	{
+		call_rcu(head, func);
+	}
+	static void synchronize() { synchronize_rcu(); }
+	static void barrier() { rcu_barrier(); }
+	static void class_init(struct call_rcu_class *cls,
+			void (*func)(struct rcu_head_compact *list))
+	{
+		call_rcu_class_init(cls, func);
+	}
+	static void call_typed(struct call_rcu_class *cls,
+			struct rcu_head_compact *head)
+	{
+		call_rcu_typed(cls, head);
+	}
+	static void barrier_class(struct call_rcu_class *cls)
+	{
+		rcu_barrier_class(cls);
+	}
+	static const struct rcu_flavor_struct &flavor()
+	{
+		return rcu_flavor;
+	}
+};
+#endif /* URCU_API_MAP */
+
+/*
+ * RAII read-side critical section of the Flavor traits. Note that a
+ * read-side critical section must begin and end on the same thread.
+ */
+template<class Flavor = default_flavor>
+class read_guard {
+public:
+	read_guard()
+	{
+		Flavor::read_lock();
+	}
+
+	~read_guard()
+	{
+		Flavor::read_unlock();
+	}
+
+	read_guard(const read_guard &) = delete;
+	read_guard &operator=(const read_guard &) = delete;
+};
+
+/*
+ * RAII read-side critical section of a flavor chosen at runtime, e.g.
+ * the DEFINE_SRCU_FLAVOR of a domain.
+ */
+class flavor_read_guard {
+public:
+	explicit flavor_read_guard(const struct rcu_flavor_struct &flavor)
+		: flavor_(flavor)
+	{
+		flavor_.read_lock();
+	}
+
+	~flavor_read_guard()
+	{
+		flavor_.read_unlock();
+	}
+
+	flavor_read_guard(const flavor_read_guard &) = delete;
+	flavor_read_guard &operator=(const flavor_read_guard &) = delete;
+
+private:
+	const struct rcu_flavor_struct &flavor_;
+};
+
+/*
+ * RCU-protected pointer to T. Readers load() it within a read-side
+ * critical section, with the ordering of rcu_dereference(). Updaters
+ * publish a new object with store() or exchange(), with the ordering of
+ * rcu_assign_pointer(), and reclaim the previous one after a grace
+ * period. rcu_ptr does not own the object it points to.
+ */
+template<class T>
+class rcu_ptr {
+public:
+	rcu_ptr() : ptr_(nullptr)
+	{
+	}
+
+	explicit rcu_ptr(T *ptr) : ptr_(ptr)
+	{
+	}
+
+	rcu_ptr(const rcu_ptr &) = delete;
+	rcu_ptr &operator=(const rcu_ptr &) = delete;
+
+	T *load() const
+	{
+		return rcu_dereference(ptr_);
+	}
+
+	void store(T *ptr)
+	{
+		rcu_assign_pointer(ptr_, ptr);
+	}
+
+	T *exchange(T *ptr)
+	{
+		return rcu_xchg_pointer(&ptr_, ptr);
+	}
+
+	/*
+	 * Publish desired if the pointer is expected. Otherwise, load the
+	 * current pointer in expected.
+	 */
+	bool compare_exchange(T *&expected, T *desired)
+	{
+		T *old = rcu_cmpxchg_pointer(&ptr_, expected, desired);
+
+		if (old == expected)
+			return true;
+		expected = old;
+		return false;
+	}
+
+private:
+	T *ptr_;
+};
+
+} /* namespace urcu */
+
+#endif /* _URCU_RCU_HPP */
@@ -0,0 +1,245 @@
+#ifndef _URCU_RCUAHT_H
+#define _URCU_RCUAHT_H
+
+/*
+ * urcu/rcuaht.h
+ *
+ * Userspace RCU library - RCU hash table of 32-bit indexed arena nodes
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ *
+ * For use with URCU_API_MAP (API mapping of liburcu), include this file
+ * _after_ including your URCU flavor.
+ */
+
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+struct rcu_flavor_struct;
+
+/*
+ * cds_aht is a split-ordered hash table like cds_lfht, whose nodes
+ * come from an arena of fixed-size objects managed by the table, and
+ * link to each other with 32-bit indices into the arena rather than
+ * pointers. With the reverse hash truncated to 32 bits, a node is 8
+ * bytes instead of 16 on 64-bit, which matters for tables of hundreds
+ * of millions of small objects. Lookups translate indices with the
+ * base address of the arena, which is reserved for the maximum number
+ * of objects at creation, and populated as objects are allocated.
+ *
+ * Lookups and iterations are lock-free. Updates are serialized by a
+ * mutex of the table, so that links do not need the flags of the
+ * lock-free cds_lfht removal. The table doubles its number of buckets
+ * when it holds more objects than buckets, and never shrinks.
+ *
+ * Removed objects return to the arena after a grace period: they are
+ * batched, and reclaimed with a single call_rcu() per batch.
+ *
+ * Note that struct cds_aht is opaque to callers.
+ */
+struct cds_aht;
+
+/*
+ * cds_aht_node: node of a table, embedded in an object of its arena.
+ *
+ * Node content is private to the table.
+ */
+struct cds_aht_node {
+	uint32_t next;			/* Index link, BUCKET flag. */
+	uint32_t reverse_hash;		/* Of the low 32 bits of the hash. */
+};
+
+/* Indexes, and the bucket link flag, fit in 32 bits. */
+#define CDS_AHT_MAX_NODES	((1UL << 31) - 1)
+
+/*
+ * cds_aht_match_fct - compare the key of a node with a key.
+ *
+ * Return non-zero if the key of @node is @key. Called on the nodes of
+ * the same low 32 bits of hash as the key looked up.
+ */
+typedef int (*cds_aht_match_fct)(struct cds_aht_node *node, const void *key);
+
+/*
+ * cds_aht_new_flavor - allocate a hash table and its arena.
+ * @obj_size: size of the objects of the arena, a multiple of 4 bytes.
+ * @node_offset: offset of the struct cds_aht_node within the objects.
+ * @max_nodes: number of objects of the arena, at most CDS_AHT_MAX_NODES.
+ * @init_size: initial number of buckets.
+ * @flavor: RCU flavor of the readers of the table.
+ *
+ * Reserves the address space of @max_nodes objects and of as many
+ * buckets. Objects are aligned on @obj_size within the arena, which is
+ * page-aligned. Return NULL on error.
+ */
+extern
+struct cds_aht *cds_aht_new_flavor(size_t obj_size, size_t node_offset,
+		unsigned long max_nodes, unsigned long init_size,
+		const struct rcu_flavor_struct *flavor);
+
+/*
+ * cds_aht_destroy - destroy a hash table and its arena.
+ * @ht: the hash table.
+ *
+ * Waits for the pending reclaims of removed objects, and frees the
+ * table along with the objects it holds. Must not be called
+ * concurrently with other operations on the table, nor from within a
+ * read-side critical section or a call_rcu() callback.
+ */
+extern
+void cds_aht_destroy(struct cds_aht *ht);
+
+/*
+ * cds_aht_alloc - allocate a zeroed object from the arena.
+ * @ht: the hash table.
+ *
+ * When the arena is full, waits for a grace period to reclaim the
+ * objects removed and not yet reclaimed, if any. Return NULL if the
+ * arena is full. Must not be called from within a read-side critical
+ * section.
+ */
+extern
+void *cds_aht_alloc(struct cds_aht *ht);
+
+/*
+ * cds_aht_free - return an object to the arena at once.
+ * @ht: the hash table.
+ * @obj: object from cds_aht_alloc(), which was never added to the table.
+ */
+extern
+void cds_aht_free(struct cds_aht *ht, void *obj);
+
+/*
+ * cds_aht_lookup - lookup a key.
+ * @ht: the hash table.
+ * @hash: hash of the key, whose low 32 bits are used.
+ * @match: key match function.
+ * @key: the key.
+ *
+ * Return the node of key, or NULL if key is not in the table.
+ * Call with rcu_read_lock held.
+ * Threads calling this API need to be registered RCU read-side threads.
+ */
+extern
+struct cds_aht_node *cds_aht_lookup(struct cds_aht *ht, unsigned long hash,
+		cds_aht_match_fct match, const void *key);
+
+/*
+ * cds_aht_add_unique - add a node if its key is not in the table.
+ * @ht: the hash table.
+ * @hash: hash of the key.
+ * @node: node of an object from cds_aht_alloc().
+ * @match: key match function.
+ * @key: key of the node.
+ *
+ * Return 0 on success, -EEXIST if key is already in the table.
+ * Threads calling this API need to be registered RCU read-side threads.
+ */
+extern
+int cds_aht_add_unique(struct cds_aht *ht, unsigned long hash,
+		struct cds_aht_node *node, cds_aht_match_fct match,
+		const void *key);
+
+/*
+ * cds_aht_add_replace - add a node, replacing the node of the same key.
+ * @ht: the hash table.
+ * @hash: hash of the key.
+ * @node: node of an object from cds_aht_alloc().
+ * @match: key match function.
+ * @key: key of the node.
+ *
+ * Concurrent lookups see either the replaced or the new node. The
+ * replaced object returns to the arena after a grace period. Return 0
+ * if the node was added, 1 if it replaced a node.
+ * Threads calling this API need to be registered RCU read-side threads.
+ */
+extern
+int cds_aht_add_replace(struct cds_aht *ht, unsigned long hash,
+		struct cds_aht_node *node, cds_aht_match_fct match,
+		const void *key);
+
+/*
+ * cds_aht_del - remove a node.
+ * @ht: the hash table.
+ * @node: the node.
+ *
+ * The object returns to the arena after a grace period, until which
+ * concurrent readers may still access it. Return 0 on success, -ENOENT
+ * if the node is not in the table.
+ * Threads calling this API need to be registered RCU read-side threads.
+ */
+extern
+int cds_aht_del(struct cds_aht *ht, struct cds_aht_node *node);
+
+/*
+ * cds_aht_first - get the first node of a table.
+ * @ht: the hash table.
+ *
+ * Return NULL if the table is empty.
+ * Call with rcu_read_lock held.
+ */
+extern
+struct cds_aht_node *cds_aht_first(struct cds_aht *ht);
+
+/*
+ * cds_aht_next - get the node following a node of a table.
+ * @ht: the hash table.
+ * @node: the node, possibly removed concurrently.
+ *
+ * Return NULL at the end of the table.
+ * Call with rcu_read_lock held.
+ */
+extern
+struct cds_aht_node *cds_aht_next(struct cds_aht *ht,
+		struct cds_aht_node *node);
+
+#define cds_aht_for_each(ht, node)					\
+	for (node = cds_aht_first(ht); node != NULL;			\
+		node = cds_aht_next(ht, node))
+
+/*
+ * cds_aht_count - number of nodes in the table.
+ * @ht: the hash table.
+ *
+ * The count may be outdated by concurrent updates.
+ */
+extern
+unsigned long cds_aht_count(struct cds_aht *ht);
+
+#ifdef URCU_API_MAP
+/*
+ * cds_aht_new - allocate a hash table for the current flavor.
+ *
+ * Note: the RCU flavor must be already included before the hash table
+ * header.
+ */
+static inline
+struct cds_aht *cds_aht_new(size_t obj_size, size_t node_offset,
+		unsigned long max_nodes, unsigned long init_size)
+{
+	return cds_aht_new_flavor(obj_size, node_offset, max_nodes,
+		init_size, &rcu_flavor);
+}
+#endif /* URCU_API_MAP */
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* _URCU_RCUAHT_H */
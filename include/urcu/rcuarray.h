@@ -0,0 +1,215 @@
+#ifndef _URCU_RCUARRAY_H
+#define _URCU_RCUARRAY_H
+
+/*
+ * urcu/rcuarray.h
+ *
+ * Userspace RCU library - RCU copy-on-write array
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ *
+ * For use with URCU_API_MAP (API mapping of liburcu), include this file
+ * _after_ including your URCU flavor.
+ */
+
+#include <stddef.h>
+#include <pthread.h>
+#include <urcu/compiler.h>
+#include <urcu/uatomic.h>
+#include <urcu/call-rcu.h>
+#include <urcu/pointer.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+struct rcu_flavor_struct;
+
+/*
+ * Array of fixed-size elements, read within RCU read-side critical
+ * sections and updated by copy: readers access a published version in
+ * place, while updaters modify a private copy, publish it, and free the
+ * previous version after a grace period.
+ *
+ * Updates are batched: between cds_rcu_array_update_begin() and
+ * cds_rcu_array_update_commit(), any number of modifications apply to a
+ * single copy, published once, and the previous version is freed with a
+ * single call_rcu(). Updaters are serialized by a mutex of the array.
+ *
+ * Versions have spare capacity, doubled on each copy which grows the
+ * array: cds_rcu_array_append() fills it in place, without copy, as the
+ * length of a version is only increased once the new element is
+ * written.
+ */
+struct cds_rcu_array_data {
+	size_t len;			/* ATOMIC: number of elements. */
+	size_t capacity;
+	size_t elem_size;
+	struct rcu_head head;
+	char elems[] __attribute__((aligned(16)));
+};
+
+struct cds_rcu_array {
+	struct cds_rcu_array_data *data;	/* RCU-protected. */
+	struct cds_rcu_array_data *copy;	/* Update in progress. */
+	size_t elem_size;
+	const struct rcu_flavor_struct *flavor;
+	pthread_mutex_t lock;
+};
+
+/*
+ * cds_rcu_array_read - get the current version of an array.
+ *
+ * Must be called within a read-side critical section, which the version
+ * must not be used outside of.
+ */
+static inline
+const struct cds_rcu_array_data *cds_rcu_array_read(struct cds_rcu_array *array)
+{
+	return rcu_dereference(array->data);
+}
+
+/*
+ * cds_rcu_array_len - number of elements of a version.
+ *
+ * Appends may increase it concurrently: read it once, and only access
+ * the elements below the value read.
+ */
+static inline
+size_t cds_rcu_array_len(const struct cds_rcu_array_data *data)
+{
+	return uatomic_load_acquire(&data->len);
+}
+
+/* cds_rcu_array_entry - element @i of a version, read-only. */
+static inline
+const void *cds_rcu_array_entry(const struct cds_rcu_array_data *data,
+		size_t i)
+{
+	return data->elems + i * data->elem_size;
+}
+
+/*
+ * cds_rcu_array_init_flavor - initialize an empty array.
+ * @elem_size: size of the elements, in bytes.
+ * @flavor: RCU flavor of the readers.
+ *
+ * Elements are aligned on 16 bytes at most. Return 0 on success,
+ * -ENOMEM on allocation failure.
+ */
+extern
+int cds_rcu_array_init_flavor(struct cds_rcu_array *array, size_t elem_size,
+		const struct rcu_flavor_struct *flavor);
+
+/*
+ * cds_rcu_array_destroy - free the current version of an array.
+ *
+ * Readers must not access the array anymore, e.g. after a grace period
+ * following its unpublication.
+ */
+extern
+void cds_rcu_array_destroy(struct cds_rcu_array *array);
+
+/*
+ * cds_rcu_array_update_begin - start a batch of modifications.
+ *
+ * Locks the array and copies its current version. Return 0 on success,
+ * -ENOMEM on allocation failure, in which case the array is not locked.
+ */
+extern
+int cds_rcu_array_update_begin(struct cds_rcu_array *array);
+
+/* cds_rcu_array_update_len - number of elements of the copy. */
+static inline
+size_t cds_rcu_array_update_len(struct cds_rcu_array *array)
+{
+	return array->copy->len;
+}
+
+/* cds_rcu_array_update_entry - element @i of the copy, for writing. */
+static inline
+void *cds_rcu_array_update_entry(struct cds_rcu_array *array, size_t i)
+{
+	return array->copy->elems + i * array->elem_size;
+}
+
+/*
+ * cds_rcu_array_update_resize - set the number of elements of the copy.
+ *
+ * New elements are zeroed. Return 0 on success, -ENOMEM on allocation
+ * failure, in which case the copy is unchanged.
+ */
+extern
+int cds_rcu_array_update_resize(struct cds_rcu_array *array, size_t len);
+
+/*
+ * cds_rcu_array_update_insert - insert an element in the copy at
+ * index @i, moving the following elements.
+ *
+ * Return 0 on success, -ENOMEM on allocation failure.
+ */
+extern
+int cds_rcu_array_update_insert(struct cds_rcu_array *array, size_t i,
+		const void *elem);
+
+/*
+ * cds_rcu_array_update_remove - remove element @i of the copy, moving
+ * the following elements.
+ */
+extern
+void cds_rcu_array_update_remove(struct cds_rcu_array *array, size_t i);
+
+/*
+ * cds_rcu_array_update_commit - publish the copy, free the previous
+ * version after a grace period, and unlock the array.
+ */
+extern
+void cds_rcu_array_update_commit(struct cds_rcu_array *array);
+
+/*
+ * cds_rcu_array_update_abort - discard the copy, and unlock the array.
+ */
+extern
+void cds_rcu_array_update_abort(struct cds_rcu_array *array);
+
+/*
+ * cds_rcu_array_append - append an element to an array.
+ *
+ * Writes the element in place if the current version has spare
+ * capacity, and copies it to a version of twice the capacity otherwise.
+ * Must not be called within a batch of modifications. Return 0 on
+ * success, -ENOMEM on allocation failure.
+ */
+extern
+int cds_rcu_array_append(struct cds_rcu_array *array, const void *elem);
+
+#ifdef URCU_API_MAP
+/*
+ * cds_rcu_array_init - initialize an empty array for the current flavor.
+ *
+ * Note: the RCU flavor must be already included before this header.
+ */
+static inline
+int cds_rcu_array_init(struct cds_rcu_array *array, size_t elem_size)
+{
+	return cds_rcu_array_init_flavor(array, elem_size, &rcu_flavor);
+}
+#endif /* URCU_API_MAP */
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* _URCU_RCUARRAY_H */
@@ -0,0 +1,303 @@
+#ifndef _URCU_RCUHAMT_H
+#define _URCU_RCUHAMT_H
+
+/*
+ * urcu/rcuhamt.h
+ *
+ * Userspace RCU library - RCU persistent hash array mapped trie
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ *
+ * For use with URCU_API_MAP (API mapping of liburcu), include this file
+ * _after_ including your URCU flavor.
+ */
+
+#include <pthread.h>
+#include <urcu/compiler.h>
+#include <urcu/pointer.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+struct rcu_flavor_struct;
+
+/*
+ * Persistent hash array mapped trie: a map keyed by the hash of its
+ * nodes, read within RCU read-side critical sections and updated by
+ * path copy. Each interior node indexes 5 bits of the hash with a
+ * bitmap of its 32 possible children, and only stores the children
+ * present. Nodes whose hash is entirely equal share a collision node at
+ * the bottom of the trie.
+ *
+ * A version of the trie is never modified once published: updaters copy
+ * the interior nodes on the path from the root to the node they add or
+ * remove, and publish a new root, so that readers see a consistent
+ * snapshot of the whole map for as long as they hold its root.
+ * Unmodified subtrees are shared between versions.
+ *
+ * Updates are batched: between cds_hamt_update_begin() and
+ * cds_hamt_update_commit(), interior nodes are copied once, and later
+ * modifications of the batch write in place into the copies. The new
+ * root is published once, and the interior nodes it replaces are freed,
+ * along with the removed nodes, with a single call_rcu(). Updaters are
+ * serialized by a mutex of the trie.
+ */
+
+/*
+ * cds_hamt_node: node of a trie, embedded in the structure of the
+ * caller and found with caa_container_of().
+ *
+ * The hash is set by the caller before adding the node, and must not
+ * change while the node is in the trie. The other fields are private to
+ * the trie.
+ */
+struct cds_hamt_node {
+	unsigned long hash;
+	struct cds_hamt_node *next_removed;
+};
+
+/*
+ * Note that struct cds_hamt_inode, the interior node, is opaque to
+ * callers. The root identifies a version of the trie.
+ */
+struct cds_hamt_inode;
+
+/* Interior levels, plus the collision level. */
+#define CDS_HAMT_MAX_DEPTH	((CAA_BITS_PER_LONG + 4) / 5 + 1)
+
+/*
+ * cds_hamt_match_fct - compare the key of a node with a key.
+ *
+ * Return non-zero if the key of @node is @key. Only called on nodes of
+ * the hash looked up.
+ */
+typedef int (*cds_hamt_match_fct)(struct cds_hamt_node *node,
+		const void *key);
+
+/*
+ * cds_hamt_free_fct - free a node removed from the trie.
+ *
+ * Called after a grace period, from call_rcu() context.
+ */
+typedef void (*cds_hamt_free_fct)(struct cds_hamt_node *node);
+
+struct cds_hamt_retired;
+
+struct cds_hamt {
+	struct cds_hamt_inode *root;		/* RCU-protected. */
+	/* Update in progress. */
+	struct cds_hamt_inode *new_root;
+	struct cds_hamt_retired *retired;
+	unsigned long new_count;
+	unsigned long gen;
+	cds_hamt_free_fct free_node;
+	const struct rcu_flavor_struct *flavor;
+	pthread_mutex_t lock;
+};
+
+/*
+ * cds_hamt_iter: position of an iteration over a version.
+ *
+ * Stack of the interior nodes from the root to the current node, and
+ * of the index of the current child within each.
+ */
+struct cds_hamt_iter {
+	const struct cds_hamt_inode *inode[CDS_HAMT_MAX_DEPTH];
+	unsigned int pos[CDS_HAMT_MAX_DEPTH];
+	int depth;
+	struct cds_hamt_node *node;
+};
+
+/*
+ * cds_hamt_read - get the current version of a trie.
+ *
+ * Must be called within a read-side critical section, which the version
+ * must not be used outside of. All lookups and iterations within the
+ * version see the same snapshot of the map, whatever the updates
+ * committed meanwhile.
+ */
+static inline
+const struct cds_hamt_inode *cds_hamt_read(struct cds_hamt *hamt)
+{
+	return rcu_dereference(hamt->root);
+}
+
+/*
+ * cds_hamt_lookup - lookup a key in a version.
+ * @root: version of the trie.
+ * @hash: hash of the key.
+ * @match: key match function.
+ * @key: the key.
+ *
+ * Return the node of key, or NULL if key is not in the version. Walks at
+ * most CDS_HAMT_MAX_DEPTH interior nodes.
+ */
+extern
+struct cds_hamt_node *cds_hamt_lookup(const struct cds_hamt_inode *root,
+		unsigned long hash, cds_hamt_match_fct match, const void *key);
+
+/* cds_hamt_count - number of nodes of a version. */
+extern
+unsigned long cds_hamt_count(const struct cds_hamt_inode *root);
+
+/*
+ * cds_hamt_first - position an iterator on the first node of a version.
+ *
+ * Nodes are visited once each, in the order of the 5-bit digits of
+ * their hash from the least significant. The node is NULL if the
+ * version is empty.
+ */
+extern
+void cds_hamt_first(const struct cds_hamt_inode *root,
+		struct cds_hamt_iter *iter);
+
+/*
+ * cds_hamt_next - move an iterator to the next node of its version.
+ *
+ * The node is NULL at the end of the version.
+ */
+extern
+void cds_hamt_next(struct cds_hamt_iter *iter);
+
+static inline
+struct cds_hamt_node *cds_hamt_iter_get_node(struct cds_hamt_iter *iter)
+{
+	return iter->node;
+}
+
+#define cds_hamt_for_each(root, iter, node)				\
+	for (cds_hamt_first(root, iter),				\
+			node = cds_hamt_iter_get_node(iter);		\
+		node != NULL;						\
+		cds_hamt_next(iter), node = cds_hamt_iter_get_node(iter))
+
+/*
+ * cds_hamt_init_flavor - initialize an empty trie.
+ * @free_node: called on the nodes removed or replaced by an update,
+ *             after a grace period, or NULL if the caller frees them.
+ * @flavor: RCU flavor of the readers.
+ *
+ * Return 0 on success, -ENOMEM on allocation failure.
+ */
+extern
+int cds_hamt_init_flavor(struct cds_hamt *hamt, cds_hamt_free_fct free_node,
+		const struct rcu_flavor_struct *flavor);
+
+/*
+ * cds_hamt_destroy - free the current version of a trie.
+ *
+ * Calls free_node on the nodes of the version, if set. Readers must not
+ * access the trie anymore, e.g. after a grace period following its
+ * unpublication, and the callbacks of the previous updates must have
+ * run, e.g. after rcu_barrier().
+ */
+extern
+void cds_hamt_destroy(struct cds_hamt *hamt);
+
+/*
+ * cds_hamt_update_begin - start a batch of modifications.
+ *
+ * Locks the trie. Return 0 on success, -ENOMEM on allocation failure,
+ * in which case the trie is not locked.
+ */
+extern
+int cds_hamt_update_begin(struct cds_hamt *hamt);
+
+/*
+ * cds_hamt_update_lookup - lookup a key in the version being updated.
+ *
+ * Sees the modifications of the batch. Readers do not need to be
+ * excluded.
+ */
+extern
+struct cds_hamt_node *cds_hamt_update_lookup(struct cds_hamt *hamt,
+		unsigned long hash, cds_hamt_match_fct match, const void *key);
+
+/*
+ * cds_hamt_update_add_unique - add a node whose key is not in the trie.
+ * @node: the node, with its hash set.
+ * @match: key match function.
+ * @key: key of the node.
+ *
+ * Return 0 on success, -EEXIST if the key is already in the version
+ * being updated, -ENOMEM on allocation failure. On failure, the version
+ * is unchanged.
+ */
+extern
+int cds_hamt_update_add_unique(struct cds_hamt *hamt,
+		struct cds_hamt_node *node, cds_hamt_match_fct match,
+		const void *key);
+
+/*
+ * cds_hamt_update_add_replace - add a node, replacing the node of the
+ * same key if any.
+ *
+ * The replaced node is freed as a removed node once the batch is
+ * committed. Return 0 on success, -ENOMEM on allocation failure, in
+ * which case the version is unchanged.
+ */
+extern
+int cds_hamt_update_add_replace(struct cds_hamt *hamt,
+		struct cds_hamt_node *node, cds_hamt_match_fct match,
+		const void *key);
+
+/*
+ * cds_hamt_update_del - remove the node of a key.
+ *
+ * The node is freed once the batch is committed, and must not be added
+ * again until then. Return 0 on success, -ENOENT if the key is not in
+ * the version being updated, -ENOMEM on allocation failure, in which
+ * case the version is unchanged.
+ */
+extern
+int cds_hamt_update_del(struct cds_hamt *hamt, unsigned long hash,
+		cds_hamt_match_fct match, const void *key);
+
+/*
+ * cds_hamt_update_commit - publish the version being updated, free the
+ * interior nodes it replaces and the removed nodes after a grace
+ * period, and unlock the trie.
+ */
+extern
+void cds_hamt_update_commit(struct cds_hamt *hamt);
+
+/*
+ * cds_hamt_update_abort - discard the modifications of the batch, and
+ * unlock the trie.
+ *
+ * The nodes added by the batch are not freed.
+ */
+extern
+void cds_hamt_update_abort(struct cds_hamt *hamt);
+
+#ifdef URCU_API_MAP
+/*
+ * cds_hamt_init - initialize an empty trie for the current flavor.
+ *
+ * Note: the RCU flavor must be already included before this header.
+ */
+static inline
+int cds_hamt_init(struct cds_hamt *hamt, cds_hamt_free_fct free_node)
+{
+	return cds_hamt_init_flavor(hamt, free_node, &rcu_flavor);
+}
+#endif /* URCU_API_MAP */
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* _URCU_RCUHAMT_H */
@@ -25,8 +25,10 @@
 #ifndef _URCU_RCUHLIST_H
 #define _URCU_RCUHLIST_H
 
+#include <errno.h>
 #include <urcu/hlist.h>
 #include <urcu/arch.h>
+#include <urcu/uatomic.h>
 #include <urcu-pointer.h>
 
 /* Add new element at the head of the list. */
@@ -78,4 +80,201 @@ void cds_hlist_del_rcu(struct cds_hlist_node *elem)
 		entry = cds_hlist_entry(rcu_dereference(entry->member.next), \
 			__typeof__(*entry), member))
 
+/* Prefetch the node following @pos, if any, and return @pos. */
+static inline
+struct cds_hlist_node *_cds_hlist_prefetch_next_rcu(struct cds_hlist_node *pos)
+{
+	if (pos)
+		caa_prefetch(CMM_LOAD_SHARED(pos->next));
+	return pos;
+}
+
+/*
+ * Iterate through elements of the list, prefetching the next node while
+ * the current one is processed, which overlaps its cache miss with the
+ * loop body.
+ * This must be done while rcu_read_lock() is held.
+ */
+#define cds_hlist_for_each_entry_rcu_prefetch(entry, pos, head, member) \
+	for (pos = _cds_hlist_prefetch_next_rcu(rcu_dereference((head)->next)), \
+			entry = cds_hlist_entry(pos, __typeof__(*entry), member); \
+		pos != NULL; \
+		pos = _cds_hlist_prefetch_next_rcu(rcu_dereference(pos->next)), \
+			entry = cds_hlist_entry(pos, __typeof__(*entry), member))
+
+/*
+ * Lock-free updates.
+ *
+ * Lists updated with the _lf_rcu operations below need no lock around
+ * updaters: insertions and removals use cmpxchg on the next pointers,
+ * and removal first sets CDS_HLIST_REMOVED_FLAG in the next pointer of
+ * the removed node, as cds_lfht does, so that concurrent insertions
+ * after it fail and concurrent removals of its neighbours cannot lose
+ * it. The prev pointers are not maintained: such lists must only be
+ * updated with the _lf_rcu operations, and traversed with the _lf_rcu
+ * iterators, which skip the nodes being removed and clear the flag.
+ *
+ * Updaters must be within RCU read-side critical sections, and nodes
+ * may be freed after a grace period once cds_hlist_del_lf_rcu()
+ * returned. Removal scans the list from its head: these lists suit
+ * short chains, such as hash buckets.
+ */
+#define CDS_HLIST_REMOVED_FLAG		(1UL << 0)
+
+static inline
+struct cds_hlist_node *_cds_hlist_lf_clear_flag(struct cds_hlist_node *node)
+{
+	return (struct cds_hlist_node *)
+		(((unsigned long) node) & ~CDS_HLIST_REMOVED_FLAG);
+}
+
+static inline
+int _cds_hlist_lf_is_flagged(struct cds_hlist_node *node)
+{
+	return ((unsigned long) node) & CDS_HLIST_REMOVED_FLAG;
+}
+
+/* Whether removal of @node started. */
+static inline
+int cds_hlist_is_removed_lf_rcu(struct cds_hlist_node *node)
+{
+	return _cds_hlist_lf_is_flagged(CMM_LOAD_SHARED(node->next));
+}
+
+/* Return the first node from @node which is not being removed. */
+static inline
+struct cds_hlist_node *_cds_hlist_lf_skip_removed(struct cds_hlist_node *node)
+{
+	struct cds_hlist_node *next;
+
+	while (node) {
+		next = rcu_dereference(node->next);
+		if (!_cds_hlist_lf_is_flagged(next))
+			break;
+		node = _cds_hlist_lf_clear_flag(next);
+	}
+	return node;
+}
+
+/* Link @newp to *@link if it still points to @next. */
+static inline
+int _cds_hlist_lf_link(struct cds_hlist_node **link,
+		struct cds_hlist_node *next, struct cds_hlist_node *newp)
+{
+	newp->next = next;
+	newp->prev = NULL;
+	/* Implicit memory barrier orders the node content before. */
+	return uatomic_cmpxchg(link, next, newp) == next;
+}
+
+/* Add new element at the head of the list, without lock. */
+static inline
+void cds_hlist_add_head_lf_rcu(struct cds_hlist_node *newp,
+		struct cds_hlist_head *head)
+{
+	while (!_cds_hlist_lf_link(&head->next,
+			CMM_LOAD_SHARED(head->next), newp))
+		caa_cpu_relax();
+}
+
+/*
+ * Add new element after @prev, without lock.
+ *
+ * Return 0 on success, or -ENOENT if @prev is being removed.
+ */
+static inline
+int cds_hlist_add_after_lf_rcu(struct cds_hlist_node *newp,
+		struct cds_hlist_node *prev)
+{
+	struct cds_hlist_node *next;
+
+	for (;;) {
+		next = CMM_LOAD_SHARED(prev->next);
+		if (_cds_hlist_lf_is_flagged(next))
+			return -ENOENT;
+		if (_cds_hlist_lf_link(&prev->next, next, newp))
+			return 0;
+		caa_cpu_relax();
+	}
+}
+
+/*
+ * Unlink all nodes being removed from the list, until @elem is not
+ * reachable anymore. A node is only skipped by unlinking it, so that
+ * the traversal always follows live nodes.
+ */
+static inline
+void _cds_hlist_lf_unlink(struct cds_hlist_head *head,
+		struct cds_hlist_node *elem)
+{
+	struct cds_hlist_node **link, *iter, *next;
+
+retry:
+	link = &head->next;
+	for (;;) {
+		iter = rcu_dereference(*link);
+		if (_cds_hlist_lf_is_flagged(iter))
+			goto retry;	/* The predecessor is being removed. */
+		if (!iter)
+			return;		/* Unlinked by a concurrent removal. */
+		next = rcu_dereference(iter->next);
+		if (!_cds_hlist_lf_is_flagged(next)) {
+			link = &iter->next;
+			continue;
+		}
+		if (uatomic_cmpxchg(link, iter,
+				_cds_hlist_lf_clear_flag(next)) != iter)
+			goto retry;
+		if (iter == elem)
+			return;
+	}
+}
+
+/*
+ * Remove element from list, without lock.
+ *
+ * Return 0 if this call removed @elem, or -ENOENT if its removal was
+ * started by another call. On success, @elem is not reachable from
+ * @head anymore on return.
+ */
+static inline
+int cds_hlist_del_lf_rcu(struct cds_hlist_node *elem,
+		struct cds_hlist_head *head)
+{
+	struct cds_hlist_node *next, *old;
+
+	next = CMM_LOAD_SHARED(elem->next);
+	for (;;) {
+		if (_cds_hlist_lf_is_flagged(next))
+			return -ENOENT;
+		old = uatomic_cmpxchg(&elem->next, next,
+			(struct cds_hlist_node *)
+				((unsigned long) next | CDS_HLIST_REMOVED_FLAG));
+		if (old == next)
+			break;
+		next = old;
+	}
+	_cds_hlist_lf_unlink(head, elem);
+	return 0;
+}
+
+/*
+ * Iterate through the elements of a list updated without lock,
+ * skipping those being removed.
+ * This must be done while rcu_read_lock() is held.
+ */
+#define cds_hlist_for_each_lf_rcu(pos, head) \
+	for (pos = _cds_hlist_lf_skip_removed(rcu_dereference((head)->next)); \
+		pos != NULL; \
+		pos = _cds_hlist_lf_skip_removed(_cds_hlist_lf_clear_flag( \
+			rcu_dereference(pos->next))))
+
+#define cds_hlist_for_each_entry_lf_rcu(entry, pos, head, member) \
+	for (pos = _cds_hlist_lf_skip_removed(rcu_dereference((head)->next)), \
+			entry = cds_hlist_entry(pos, __typeof__(*entry), member); \
+		pos != NULL; \
+		pos = _cds_hlist_lf_skip_removed(_cds_hlist_lf_clear_flag( \
+			rcu_dereference(pos->next))), \
+			entry = cds_hlist_entry(pos, __typeof__(*entry), member))
+
 #endif	/* _URCU_RCUHLIST_H */
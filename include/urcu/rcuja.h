@@ -0,0 +1,140 @@
+#ifndef _URCU_RCUJA_H
+#define _URCU_RCUJA_H
+
+/*
+ * urcu/rcuja.h
+ *
+ * Userspace RCU library - RCU Judy array
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ *
+ * For use with URCU_API_MAP (API mapping of liburcu), include this file
+ * _after_ including your URCU flavor.
+ */
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*
+ * A Judy array is a radix tree indexing unsigned long keys one byte at
+ * a time, from the most significant byte used by the keys: the tree is
+ * only as high as needed for the greatest key added, e.g. 3 levels for
+ * keys below 2^24. Interior nodes adapt their size to their number of
+ * children: up to 4 or 16 children are stored as lists of key bytes
+ * along with child pointers, and more in arrays of 256 pointers.
+ * Nodes left empty by removals are freed, so memory use follows the
+ * density of keys.
+ *
+ * Lookups are lock-free. Updates lock the node they modify and its
+ * parent, so updates of distinct nodes proceed in parallel. Nodes which
+ * are resized or freed are replaced in their parent, and reclaimed after
+ * a grace period.
+ *
+ * Note that struct cds_ja is opaque to callers.
+ */
+struct cds_ja;
+
+/*
+ * cds_ja_node: node of a Judy array, embedded in the structure of the
+ * caller and found with caa_container_of().
+ */
+struct cds_ja_node {
+	unsigned long key;		/* Set by cds_ja_add(). */
+};
+
+struct rcu_flavor_struct;
+
+/*
+ * cds_ja_new_flavor - allocate a Judy array.
+ * @flavor: RCU flavor of the readers of the array.
+ *
+ * Return NULL on error.
+ */
+extern
+struct cds_ja *cds_ja_new_flavor(const struct rcu_flavor_struct *flavor);
+
+#ifdef URCU_API_MAP
+/*
+ * cds_ja_new - allocate a Judy array for the current flavor.
+ *
+ * Note: the RCU flavor must be already included before the Judy array
+ * header.
+ */
+static inline
+struct cds_ja *cds_ja_new(void)
+{
+	return cds_ja_new_flavor(&rcu_flavor);
+}
+#endif /* URCU_API_MAP */
+
+/*
+ * cds_ja_destroy - destroy a Judy array.
+ * @ja: the Judy array, which must be empty.
+ *
+ * Waits for a grace period before freeing the array. Return 0 on
+ * success, -EPERM if the array is not empty. Must not be called
+ * concurrently with other operations on the array, nor from within a
+ * read-side critical section.
+ */
+extern
+int cds_ja_destroy(struct cds_ja *ja);
+
+/*
+ * cds_ja_lookup - lookup a key.
+ * @ja: the Judy array.
+ * @key: the key.
+ *
+ * Return the node of key, or NULL if key is not in the array.
+ * Call with rcu_read_lock held.
+ * Threads calling this API need to be registered RCU read-side threads.
+ */
+extern
+struct cds_ja_node *cds_ja_lookup(struct cds_ja *ja, unsigned long key);
+
+/*
+ * cds_ja_add - add a node if its key is not in the array.
+ * @ja: the Judy array.
+ * @key: the key.
+ * @node: the node to add.
+ *
+ * Return 0 on success, -EEXIST if key is already in the array, -ENOMEM
+ * on allocation failure.
+ * Call with rcu_read_lock held.
+ * Threads calling this API need to be registered RCU read-side threads.
+ */
+extern
+int cds_ja_add(struct cds_ja *ja, unsigned long key,
+		struct cds_ja_node *node);
+
+/*
+ * cds_ja_del - remove a key.
+ * @ja: the Judy array.
+ * @key: the key.
+ *
+ * Return the removed node, or NULL if key is not in the array. Only one
+ * of concurrent removals of a key returns its node. The node must only
+ * be freed after a grace period, e.g. with call_rcu().
+ * Call with rcu_read_lock held.
+ * Threads calling this API need to be registered RCU read-side threads.
+ */
+extern
+struct cds_ja_node *cds_ja_del(struct cds_ja *ja, unsigned long key);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* _URCU_RCUJA_H */
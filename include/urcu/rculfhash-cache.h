@@ -0,0 +1,163 @@
+#ifndef _URCU_RCULFHASH_CACHE_H
+#define _URCU_RCULFHASH_CACHE_H
+
+/*
+ * urcu/rculfhash-cache.h
+ *
+ * Userspace RCU library - RCU cache with CLOCK eviction on cds_lfht
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ *
+ * For use with URCU_API_MAP (API mapping of liburcu), include this file
+ * _after_ including your URCU flavor.
+ */
+
+#include <urcu/list.h>
+#include <urcu/call-rcu.h>
+#include <urcu/rculfhash.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*
+ * Cache of entries indexed by a cds_lfht, holding up to a capacity in
+ * bytes, and evicting entries with the CLOCK algorithm: each entry has
+ * a reference bit, set by the lookups which hit it, and an eviction
+ * clears the bits of the entries the clock hand passes until it finds
+ * one which was not referenced since the last pass.
+ *
+ * Lookups take no lock and perform no atomic read-modify-write: a hit
+ * only stores to the reference bit when it is clear. Entries are split
+ * into shards by hash, each with its own CLOCK ring, share of the
+ * capacity and mutex, taken by additions and deletions of the shard.
+ * Evicted and deleted entries are passed to the free function of the
+ * cache after a grace period, with the call_rcu of the flavor.
+ *
+ * All functions but cds_lfht_cache_destroy() must be called within a
+ * read-side critical section of the flavor, and entries found may be
+ * used until its end.
+ *
+ * Note that struct cds_lfht_cache is opaque to callers.
+ */
+struct cds_lfht_cache;
+
+/* Entry of a cache, embedded in the user object. */
+struct cds_lfht_cache_node {
+	struct cds_lfht_node node;
+	struct cds_list_head clock;	/* CLOCK ring of the shard. */
+	struct rcu_head rcu_head;	/* Passed to the free function. */
+	unsigned long size;		/* Bytes charged to the capacity. */
+	int referenced;
+};
+
+struct rcu_flavor_struct;
+
+/*
+ * cds_lfht_cache_new_flavor - allocate a cache.
+ * @capacity: bytes of the entries the cache holds, split evenly
+ *            between the shards.
+ * @nr_shards: number of shards. Must be power of two.
+ * @free_node: invoked on the rcu_head of the evicted and deleted
+ *             entries, after a grace period.
+ * @flavor: RCU flavor of the users of the cache.
+ *
+ * Return NULL on error.
+ */
+extern
+struct cds_lfht_cache *cds_lfht_cache_new_flavor(unsigned long capacity,
+		unsigned long nr_shards,
+		void (*free_node)(struct rcu_head *head),
+		const struct rcu_flavor_struct *flavor);
+
+#ifdef URCU_API_MAP
+/*
+ * cds_lfht_cache_new - allocate a cache tied to the RCU flavor included
+ * before this header. See cds_lfht_cache_new_flavor.
+ */
+static inline
+struct cds_lfht_cache *cds_lfht_cache_new(unsigned long capacity,
+		unsigned long nr_shards,
+		void (*free_node)(struct rcu_head *head))
+{
+	return cds_lfht_cache_new_flavor(capacity, nr_shards, free_node,
+			&rcu_flavor);
+}
+#endif /* URCU_API_MAP */
+
+/*
+ * cds_lfht_cache_destroy - destroy a cache.
+ *
+ * Passes the remaining entries to the free function after a grace
+ * period. Must not be called concurrently with other operations on the
+ * cache, nor from within a read-side critical section. Return 0 on
+ * success, or the error of cds_lfht_destroy().
+ */
+extern
+int cds_lfht_cache_destroy(struct cds_lfht_cache *cache);
+
+/*
+ * cds_lfht_cache_lookup - find the entry of a key, and mark it
+ * referenced.
+ *
+ * Return NULL if the key is not cached.
+ */
+extern
+struct cds_lfht_cache_node *cds_lfht_cache_lookup(
+		struct cds_lfht_cache *cache, unsigned long hash,
+		cds_lfht_match_fct match, const void *key);
+
+/*
+ * cds_lfht_cache_add - add an entry if its key is not cached.
+ * @size: bytes charged to the capacity for the entry.
+ *
+ * Evicts entries of the shard of @hash until @node fits in its share of
+ * the capacity, or the shard is empty. Return @node if it was added, or
+ * the entry already caching the key, in which case @node was not added
+ * and may be freed straight away.
+ */
+extern
+struct cds_lfht_cache_node *cds_lfht_cache_add(struct cds_lfht_cache *cache,
+		unsigned long hash, cds_lfht_match_fct match, const void *key,
+		struct cds_lfht_cache_node *node, unsigned long size);
+
+/*
+ * cds_lfht_cache_del - delete an entry.
+ *
+ * The entry is passed to the free function after a grace period.
+ * Return 0 on success, -ENOENT if it was already evicted or deleted.
+ */
+extern
+int cds_lfht_cache_del(struct cds_lfht_cache *cache,
+		struct cds_lfht_cache_node *node);
+
+/*
+ * cds_lfht_cache_used - bytes charged by the entries of the cache.
+ */
+extern
+unsigned long cds_lfht_cache_used(struct cds_lfht_cache *cache);
+
+/*
+ * cds_lfht_cache_ht - hash table indexing the entries, e.g. to iterate
+ * on them. It must not be updated directly.
+ */
+extern
+struct cds_lfht *cds_lfht_cache_ht(struct cds_lfht_cache *cache);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* _URCU_RCULFHASH_CACHE_H */
@@ -0,0 +1,179 @@
+#ifndef _URCU_RCULFHASH_COMBINE_H
+#define _URCU_RCULFHASH_COMBINE_H
+
+/*
+ * urcu/rculfhash-combine.h
+ *
+ * Userspace RCU library - flat-combining updates of cds_lfht entries
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ *
+ * For use with URCU_API_MAP (API mapping of liburcu), include this file
+ * _after_ including your URCU flavor.
+ */
+
+#include <urcu/call-rcu.h>
+#include <urcu/rculfhash.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*
+ * Flat-combining updates of the entries of a cds_lfht, for keys which
+ * many threads update at once, such as counters. Each update is a
+ * request published in the slot of its hash, and the thread which
+ * takes the mutex of the slot, the combiner, applies all requests
+ * published there to a private copy of the entry of each key, and
+ * publishes the copy with one cds_lfht_replace() and one call_rcu
+ * freeing the entry it replaces. The other threads wait for their
+ * request to be applied, instead of retrying replacements which fail
+ * against each other, and a batch of updates of a key leaves a single
+ * entry to free rather than one per update.
+ *
+ * The entries of the keys updated this way embed a
+ * struct cds_lfht_combine_node, and the callbacks of the combiner copy
+ * and modify them. Other updates of the table, such as deletions and
+ * cds_lfht_add_replace(), may run concurrently: the combiner retries
+ * its publication when they win a race with it.
+ *
+ * All functions but cds_lfht_combine_new_flavor() and
+ * cds_lfht_combine_destroy() must be called within a read-side
+ * critical section of the flavor of the table, by registered threads.
+ *
+ * Note that struct cds_lfht_combine is opaque to callers.
+ */
+struct cds_lfht_combine;
+
+/* Entry of a table updated by combining, embedded in the user object. */
+struct cds_lfht_combine_node {
+	struct cds_lfht_node node;
+	struct rcu_head rcu_head;	/* Passed to the free function. */
+};
+
+struct cds_lfht_combine_ops {
+	/*
+	 * Return a copy of @node, which is not visible to other threads,
+	 * or a new entry for @key if @node is NULL, holding a copy of the
+	 * key, since @key may be freed once the update returns. The copy
+	 * must hash and match as @node. Return NULL on error.
+	 */
+	struct cds_lfht_combine_node *(*copy)(
+			struct cds_lfht_combine_node *node, const void *key,
+			void *priv);
+	/* Apply the update @arg to the private copy @node. */
+	void (*apply)(struct cds_lfht_combine_node *node, void *arg,
+			void *priv);
+	/*
+	 * Invoked on the rcu_head of the replaced entries after a grace
+	 * period, and right away on the copies which could not be
+	 * published.
+	 */
+	void (*free_node)(struct rcu_head *head);
+};
+
+struct cds_lfht_combine_stats {
+	unsigned long requests;		/* Updates applied or failed. */
+	unsigned long batches;		/* Passes of combiners. */
+	unsigned long publications;	/* Entries added or replaced. */
+	unsigned long retries;		/* Publications lost to races. */
+};
+
+struct rcu_flavor_struct;
+
+/*
+ * cds_lfht_combine_new_flavor - allocate a combiner.
+ * @ht: table of the entries, which must use @flavor. Tables created
+ *      with CDS_LFHT_NODE_TAG are not supported.
+ * @nr_slots: number of slots where requests are published, chosen by
+ *            hash. Must be power of two.
+ * @ops: callbacks copying and updating entries.
+ * @priv: passed to the @ops callbacks.
+ * @flavor: RCU flavor of the table.
+ *
+ * Return NULL on error.
+ */
+extern
+struct cds_lfht_combine *cds_lfht_combine_new_flavor(struct cds_lfht *ht,
+		unsigned long nr_slots, const struct cds_lfht_combine_ops *ops,
+		void *priv, const struct rcu_flavor_struct *flavor);
+
+#ifdef URCU_API_MAP
+/*
+ * cds_lfht_combine_new - allocate a combiner tied to the RCU flavor
+ * included before this header. See cds_lfht_combine_new_flavor.
+ */
+static inline
+struct cds_lfht_combine *cds_lfht_combine_new(struct cds_lfht *ht,
+		unsigned long nr_slots, const struct cds_lfht_combine_ops *ops,
+		void *priv)
+{
+	return cds_lfht_combine_new_flavor(ht, nr_slots, ops, priv,
+			&rcu_flavor);
+}
+#endif /* URCU_API_MAP */
+
+/*
+ * cds_lfht_combine_destroy - free a combiner.
+ *
+ * Must not be called concurrently with other operations on the
+ * combiner. The entries stay in the table.
+ */
+extern
+void cds_lfht_combine_destroy(struct cds_lfht_combine *comb);
+
+/*
+ * cds_lfht_combine_upsert - apply an update to the entry of a key,
+ * adding the entry if the key is not present.
+ * @arg: update passed to the apply callback.
+ *
+ * Wait until a combiner applied the update, possibly the caller, and
+ * published the resulting entry. Updates of a key by a batch are
+ * applied in an arbitrary order. Return 0 on success, or -ENOMEM if
+ * the copy callback failed.
+ */
+extern
+int cds_lfht_combine_upsert(struct cds_lfht_combine *comb,
+		unsigned long hash, cds_lfht_match_fct match,
+		const void *key, void *arg);
+
+/*
+ * cds_lfht_combine_update - apply an update to the entry of a key, if
+ * present.
+ *
+ * Same as cds_lfht_combine_upsert(), but return -ENOENT without
+ * applying the update if the key is not present, which replaces the
+ * cds_lfht_lookup() and cds_lfht_replace() pair of updates.
+ */
+extern
+int cds_lfht_combine_update(struct cds_lfht_combine *comb,
+		unsigned long hash, cds_lfht_match_fct match,
+		const void *key, void *arg);
+
+/*
+ * cds_lfht_combine_get_stats - sum the counters of all slots.
+ *
+ * The ratio of requests to publications is the number of updates
+ * applied per entry published, and freed.
+ */
+extern
+void cds_lfht_combine_get_stats(struct cds_lfht_combine *comb,
+		struct cds_lfht_combine_stats *stats);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* _URCU_RCULFHASH_COMBINE_H */
@@ -0,0 +1,146 @@
+#ifndef _URCU_RCULFHASH_DUMP_H
+#define _URCU_RCULFHASH_DUMP_H
+
+/*
+ * urcu/rculfhash-dump.h
+ *
+ * Userspace RCU library - Warm-restart dumps of cds_lfht tables
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ *
+ * For use with URCU_API_MAP (API mapping of liburcu), include this file
+ * _after_ including your URCU flavor.
+ */
+
+#include <sys/types.h>
+#include <pthread.h>
+#include <urcu/rculfhash.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*
+ * Dumps of the nodes of a cds_lfht to a flat file, restored at startup
+ * instead of adding each node again: a restore maps the file, creates
+ * the table with the number of buckets and configuration it had when
+ * dumped, and adds the nodes with cds_lfht_add_bulk(). The records are
+ * written in list (reverse hash) order, so that the bulk additions link
+ * each node after the previous one of its bucket without sorting them,
+ * and the restore is bound by the reads of the file.
+ *
+ * Each record holds the hash of a node and the bytes the dump function
+ * of the caller serializes for it, which the restore function of the
+ * caller turns back into a node. The file layout is that of the
+ * architecture which wrote it, and only restored by the same library
+ * version on the same architecture. A dump left incomplete, by an error
+ * or a crash, is rejected by the restore.
+ */
+
+struct rcu_flavor_struct;
+
+/*
+ * cds_lfht_dump_fct - serialize a node.
+ * @node: node to serialize.
+ * @buf: buffer of @len bytes receiving the record.
+ * @priv: private data of the caller.
+ *
+ * Return the length of the record, which must be written to @buf if it
+ * fits: the function is called again with a buffer large enough
+ * otherwise. A negative return value aborts the dump.
+ */
+typedef ssize_t (*cds_lfht_dump_fct)(struct cds_lfht_node *node,
+		void *buf, size_t len, void *priv);
+
+/*
+ * cds_lfht_restore_fct - allocate the node of a record.
+ * @data: record of @len bytes, in the mapping of the file. 8-byte
+ *        aligned, and only valid during the call.
+ * @hash: hash of the node.
+ * @priv: private data of the caller.
+ *
+ * Return the node, or NULL to skip the record.
+ */
+typedef struct cds_lfht_node *(*cds_lfht_restore_fct)(const void *data,
+		size_t len, unsigned long hash, void *priv);
+
+/*
+ * cds_lfht_dump - write the nodes of a table to a file.
+ * @ht: the hash table.
+ * @path: file created, or truncated.
+ * @dump: serializes each node.
+ * @priv: passed to @dump.
+ *
+ * The nodes added and removed concurrently may or may not be dumped:
+ * quiesce the updaters first for an exact dump. The nodes are walked in
+ * a single read-side critical section, which delays grace periods for
+ * the duration of the dump. Writing to a temporary file, and renaming
+ * it over the previous dump once complete, keeps the previous dump
+ * valid until then.
+ *
+ * Threads calling this API need to be registered RCU read-side threads,
+ * and must not be in a read-side critical section. Return the number of
+ * nodes dumped, or a negative error value: -errno for I/O errors, or
+ * the error returned by @dump.
+ */
+extern
+long cds_lfht_dump(struct cds_lfht *ht, const char *path,
+		cds_lfht_dump_fct dump, void *priv);
+
+/*
+ * cds_lfht_restore_flavor - create a table from a dump.
+ * @path: file written by cds_lfht_dump().
+ * @restore: allocates the node of each record.
+ * @priv: passed to @restore.
+ * @flavor: flavor of the table, as for cds_lfht_new_flavor().
+ * @attr: resize thread attributes, as for cds_lfht_new_flavor().
+ *
+ * The table is created with the flags, minimum and maximum number of
+ * buckets of the dumped table, and its number of buckets at the time of
+ * the dump, then filled before being returned, so that it can be
+ * published to readers once complete.
+ *
+ * Threads calling this API need to be registered RCU read-side threads,
+ * and must not be in a read-side critical section. Return NULL on
+ * error, with errno set: EINVAL for an invalid or incomplete dump, or
+ * the error of opening or mapping the file. No node is allocated for
+ * an invalid dump.
+ */
+extern
+struct cds_lfht *cds_lfht_restore_flavor(const char *path,
+		cds_lfht_restore_fct restore, void *priv,
+		const struct rcu_flavor_struct *flavor,
+		pthread_attr_t *attr);
+
+#ifdef URCU_API_MAP
+/*
+ * cds_lfht_restore - create a table tied to the RCU flavor included
+ * before this header, from a dump. See cds_lfht_restore_flavor.
+ */
+static inline
+struct cds_lfht *cds_lfht_restore(const char *path,
+		cds_lfht_restore_fct restore, void *priv,
+		pthread_attr_t *attr)
+{
+	return cds_lfht_restore_flavor(path, restore, priv, &rcu_flavor,
+			attr);
+}
+#endif /* URCU_API_MAP */
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* _URCU_RCULFHASH_DUMP_H */
@@ -0,0 +1,170 @@
+#ifndef _URCU_RCULFHASH_EXPIRY_H
+#define _URCU_RCULFHASH_EXPIRY_H
+
+/*
+ * urcu/rculfhash-expiry.h
+ *
+ * Userspace RCU library - timer wheel expiring cds_lfht entries
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ *
+ * For use with URCU_API_MAP (API mapping of liburcu), include this file
+ * _after_ including your URCU flavor.
+ */
+
+#include <stdint.h>
+#include <urcu/list.h>
+#include <urcu/call-rcu.h>
+#include <urcu/rculfhash.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*
+ * Expiry index of the entries of a cds_lfht: each armed entry has a
+ * deadline, in ticks of a clock chosen by the caller (e.g.
+ * milliseconds), and cds_lfht_expiry_advance() deletes the entries
+ * whose deadline passed from the table, passing them to the free
+ * function of the index after a grace period, with one call_rcu per
+ * batch of expired entries.
+ *
+ * Deadlines are kept in hierarchical timer wheels, one per shard of
+ * entries by hash, each with its own mutex: arming an entry costs O(1),
+ * and advancing costs O(1) per tick elapsed and expired entry, and an
+ * amortized O(1) per entry for the deadlines far in the future, rather
+ * than a walk of the whole table.
+ *
+ * All functions but cds_lfht_expiry_new_flavor() and
+ * cds_lfht_expiry_destroy() must be called within a read-side critical
+ * section of the flavor of the table.
+ *
+ * Note that struct cds_lfht_expiry is opaque to callers.
+ */
+struct cds_lfht_expiry;
+
+/*
+ * Entry of a table with an expiry index, embedded in the user object,
+ * whose node is the one added to the table.
+ */
+struct cds_lfht_expiry_node {
+	struct cds_lfht_node node;
+	struct cds_list_head link;	/* Slot of the wheel. */
+	uint64_t deadline;
+	int state;
+	struct rcu_head rcu_head;	/* Passed to the free function. */
+};
+
+struct rcu_flavor_struct;
+
+/*
+ * cds_lfht_expiry_new_flavor - allocate an expiry index.
+ * @ht: table of the entries, which must use @flavor.
+ * @nr_shards: number of shards. Must be power of two.
+ * @now: current tick.
+ * @free_node: invoked on the rcu_head of the expired and deleted
+ *             entries, after a grace period.
+ * @flavor: RCU flavor of the table.
+ *
+ * Return NULL on error.
+ */
+extern
+struct cds_lfht_expiry *cds_lfht_expiry_new_flavor(struct cds_lfht *ht,
+		unsigned long nr_shards, uint64_t now,
+		void (*free_node)(struct rcu_head *head),
+		const struct rcu_flavor_struct *flavor);
+
+#ifdef URCU_API_MAP
+/*
+ * cds_lfht_expiry_new - allocate an expiry index tied to the RCU flavor
+ * included before this header. See cds_lfht_expiry_new_flavor.
+ */
+static inline
+struct cds_lfht_expiry *cds_lfht_expiry_new(struct cds_lfht *ht,
+		unsigned long nr_shards, uint64_t now,
+		void (*free_node)(struct rcu_head *head))
+{
+	return cds_lfht_expiry_new_flavor(ht, nr_shards, now, free_node,
+			&rcu_flavor);
+}
+#endif /* URCU_API_MAP */
+
+/*
+ * cds_lfht_expiry_destroy - free an expiry index.
+ *
+ * The entries stay in the table, disarmed. Must not be called
+ * concurrently with other operations on the index.
+ */
+extern
+void cds_lfht_expiry_destroy(struct cds_lfht_expiry *exp);
+
+/*
+ * cds_lfht_expiry_node_init - initialize an entry, disarmed.
+ */
+static inline
+void cds_lfht_expiry_node_init(struct cds_lfht_expiry_node *node)
+{
+	node->state = 0;
+}
+
+/*
+ * cds_lfht_expiry_arm - set the deadline of an entry of the table.
+ *
+ * The entry must have been added to the table. Arming an armed entry
+ * moves its deadline, and a deadline already passed expires it on the
+ * next advance. Return 0 on success, -ENOENT if the entry is expiring.
+ */
+extern
+int cds_lfht_expiry_arm(struct cds_lfht_expiry *exp,
+		struct cds_lfht_expiry_node *node, uint64_t deadline);
+
+/*
+ * cds_lfht_expiry_disarm - cancel the deadline of an entry.
+ *
+ * Return 0 on success, -ENOENT if the entry is not armed.
+ */
+extern
+int cds_lfht_expiry_disarm(struct cds_lfht_expiry *exp,
+		struct cds_lfht_expiry_node *node);
+
+/*
+ * cds_lfht_expiry_del - delete an entry from the table before it
+ * expires.
+ *
+ * Disarms the entry, and passes it to the free function after a grace
+ * period. Entries of an index must be deleted from their table through
+ * this function. Return 0 on success, -ENOENT if the entry was already
+ * deleted or expired.
+ */
+extern
+int cds_lfht_expiry_del(struct cds_lfht_expiry *exp,
+		struct cds_lfht_expiry_node *node);
+
+/*
+ * cds_lfht_expiry_advance - expire the entries whose deadline is @now
+ * or earlier.
+ *
+ * @now must not be lower than in the previous call. Return the number
+ * of entries expired.
+ */
+extern
+unsigned long cds_lfht_expiry_advance(struct cds_lfht_expiry *exp,
+		uint64_t now);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* _URCU_RCULFHASH_EXPIRY_H */
@@ -0,0 +1,157 @@
+#ifndef _URCU_RCULFHASH_FILTER_H
+#define _URCU_RCULFHASH_FILTER_H
+
+/*
+ * urcu/rculfhash-filter.h
+ *
+ * Userspace RCU library - Bloom filter front for cds_lfht lookups
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ *
+ * For use with URCU_API_MAP (API mapping of liburcu), include this file
+ * _after_ including your URCU flavor.
+ */
+
+#include <urcu/rculfhash.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*
+ * Approximate membership filter of the hashes of a cds_lfht, answering
+ * most lookups of absent keys without walking a bucket chain. It is a
+ * blocked Bloom filter: the bits of a hash are all in one cache line,
+ * so a negative lookup reads a single cache line of the filter.
+ *
+ * Additions set the bits of the hash with atomic or before adding the
+ * node to the table. Bits cannot be cleared, so once the deletions
+ * since the last build reach half of the capacity of the filter, or the
+ * entries exceed it, a new filter is built from the table by a call_rcu
+ * callback and published with rcu_assign_pointer(), and the previous
+ * one is freed after a grace period. Additions made during the build
+ * set the bits of both filters.
+ *
+ * Nodes of a filtered table must be added and deleted through the
+ * functions below. cds_lfht_replace() and cds_lfht_add_replace() keep
+ * the key, hence the hash, and may be used directly. All functions but
+ * cds_lfht_filter_new_flavor() and cds_lfht_filter_destroy() must be
+ * called within a read-side critical section of the flavor of the
+ * table.
+ *
+ * Note that struct cds_lfht_filter is opaque to callers.
+ */
+struct cds_lfht_filter;
+
+struct rcu_flavor_struct;
+
+/*
+ * cds_lfht_filter_new_flavor - allocate a filter for a table.
+ * @ht: table, which must use @flavor and be empty.
+ * @capacity: number of entries the filter is sized for initially. The
+ *            filter grows past it, and never shrinks below.
+ * @flavor: RCU flavor of the table.
+ *
+ * Return NULL on error.
+ */
+extern
+struct cds_lfht_filter *cds_lfht_filter_new_flavor(struct cds_lfht *ht,
+		unsigned long capacity,
+		const struct rcu_flavor_struct *flavor);
+
+#ifdef URCU_API_MAP
+/*
+ * cds_lfht_filter_new - allocate a filter tied to the RCU flavor
+ * included before this header. See cds_lfht_filter_new_flavor.
+ */
+static inline
+struct cds_lfht_filter *cds_lfht_filter_new(struct cds_lfht *ht,
+		unsigned long capacity)
+{
+	return cds_lfht_filter_new_flavor(ht, capacity, &rcu_flavor);
+}
+#endif /* URCU_API_MAP */
+
+/*
+ * cds_lfht_filter_destroy - free a filter.
+ *
+ * Waits for a pending build. The table is left to the caller. Must not
+ * be called concurrently with other operations on the filter, nor from
+ * within a read-side critical section, nor from a call_rcu thread.
+ */
+extern
+void cds_lfht_filter_destroy(struct cds_lfht_filter *filter);
+
+/*
+ * cds_lfht_filter_may_contain - whether the table may hold a key of
+ * this hash.
+ *
+ * Return 0 if no node of the table has this hash, 1 if one may.
+ */
+extern
+int cds_lfht_filter_may_contain(struct cds_lfht_filter *filter,
+		unsigned long hash);
+
+/*
+ * cds_lfht_filter_lookup - cds_lfht_lookup() skipping the table when
+ * the filter rules the key out.
+ *
+ * The iterator then has no node, as after an unsuccessful
+ * cds_lfht_lookup().
+ */
+extern
+void cds_lfht_filter_lookup(struct cds_lfht_filter *filter,
+		unsigned long hash, cds_lfht_match_fct match, const void *key,
+		struct cds_lfht_iter *iter);
+
+/*
+ * cds_lfht_filter_add - cds_lfht_add() to a filtered table.
+ */
+extern
+void cds_lfht_filter_add(struct cds_lfht_filter *filter, unsigned long hash,
+		struct cds_lfht_node *node);
+
+/*
+ * cds_lfht_filter_add_unique - cds_lfht_add_unique() to a filtered
+ * table.
+ */
+extern
+struct cds_lfht_node *cds_lfht_filter_add_unique(
+		struct cds_lfht_filter *filter, unsigned long hash,
+		cds_lfht_match_fct match, const void *key,
+		struct cds_lfht_node *node);
+
+/*
+ * cds_lfht_filter_del - cds_lfht_del() from a filtered table.
+ *
+ * May start the build of a new filter. Return 0 on success, -ENOENT if
+ * the node was already deleted.
+ */
+extern
+int cds_lfht_filter_del(struct cds_lfht_filter *filter,
+		struct cds_lfht_node *node);
+
+/*
+ * cds_lfht_filter_capacity - number of entries the current filter is
+ * sized for.
+ */
+extern
+unsigned long cds_lfht_filter_capacity(struct cds_lfht_filter *filter);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* _URCU_RCULFHASH_FILTER_H */
@@ -0,0 +1,191 @@
+#ifndef _URCU_RCULFHASH_INTERN_H
+#define _URCU_RCULFHASH_INTERN_H
+
+/*
+ * urcu/rculfhash-intern.h
+ *
+ * Userspace RCU library - String interning on top of cds_lfht
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ *
+ * For use with URCU_API_MAP (API mapping of liburcu), include this file
+ * _after_ including your URCU flavor.
+ */
+
+#include <stddef.h>
+#include <urcu/ref.h>
+#include <urcu/call-rcu.h>
+#include <urcu/rculfhash.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*
+ * Table of unique copies of strings, such as metric names, handed out
+ * as reference-counted handles: the handles of equal strings are the
+ * same pointer while they are held, so that interned strings compare
+ * and hash by address.
+ *
+ * The strings are nodes of a cds_lfht created with CDS_LFHT_NODE_TAG,
+ * whose tag mixes the 64-bit hash of the string with its length, so
+ * that lookups only compare the bytes of strings with the same hash,
+ * tag and length. cds_lfht_intern() of a present string takes no lock
+ * and allocates nothing: it is a lookup, and a reference taken with
+ * urcu_ref_get_unless_zero(). Missing strings are added with
+ * cds_lfht_add_unique(). The last cds_lfht_intern_put() of a string
+ * deletes it from the table, and its memory is reclaimed by call_rcu:
+ * an interning racing with the deletion sees the reference count at 0,
+ * and adds a new copy of the string.
+ *
+ * The strings are packed in arenas of CDS_LFHT_INTERN_ARENA_LEN bytes,
+ * carved with a cmpxchg, instead of one malloc per string. An arena is
+ * freed once all its strings are reclaimed, and it is not the arena
+ * strings are carved from anymore. Strings longer than a quarter of an
+ * arena are given an arena of their own.
+ *
+ * All functions but cds_lfht_intern_create_flavor() and
+ * cds_lfht_intern_destroy() must be called by threads registered with
+ * the flavor of the table, outside of its read-side critical sections.
+ *
+ * Note that struct cds_lfht_intern is opaque to callers.
+ */
+struct cds_lfht_intern;
+struct cds_lfht_intern_arena;
+
+#define CDS_LFHT_INTERN_ARENA_LEN	(64UL * 1024)
+
+/* Interned string. Fields are private, see the accessors below. */
+struct cds_lfht_intern_str {
+	struct cds_lfht_tag_node tnode;
+	struct urcu_ref ref;
+	struct cds_lfht_intern_arena *arena;
+	struct rcu_head head;
+	size_t len;
+	char str[];			/* NUL-terminated */
+};
+
+struct cds_lfht_intern_stats {
+	unsigned long nr_strings;	/* In the table. */
+	unsigned long nr_arenas;
+	size_t arena_bytes;		/* Allocated for the arenas. */
+};
+
+struct rcu_flavor_struct;
+
+/*
+ * cds_lfht_intern_create_flavor - create a string interning table.
+ * @init_size: initial number of buckets of the table, power of 2. The
+ *             table is resized automatically.
+ * @flavor: RCU flavor protecting the table.
+ *
+ * Return NULL on error.
+ */
+extern
+struct cds_lfht_intern *cds_lfht_intern_create_flavor(unsigned long init_size,
+		const struct rcu_flavor_struct *flavor);
+
+#ifdef URCU_API_MAP
+/*
+ * cds_lfht_intern_create - create a string interning table tied to the
+ * RCU flavor included before this header. See
+ * cds_lfht_intern_create_flavor.
+ */
+static inline
+struct cds_lfht_intern *cds_lfht_intern_create(unsigned long init_size)
+{
+	return cds_lfht_intern_create_flavor(init_size, &rcu_flavor);
+}
+#endif /* URCU_API_MAP */
+
+/*
+ * cds_lfht_intern_destroy - free a string interning table.
+ *
+ * Return 0 on success, or -EBUSY if handles are still held. Waits for
+ * the strings being reclaimed. Must not be called concurrently with
+ * other operations on the table, nor from within a read-side critical
+ * section, nor from a call_rcu thread.
+ */
+extern
+int cds_lfht_intern_destroy(struct cds_lfht_intern *intern);
+
+/*
+ * cds_lfht_intern - get a handle of a string, interning it if missing.
+ * @str: string of @len bytes, which may contain NUL bytes.
+ *
+ * Return a handle holding a reference, to release with
+ * cds_lfht_intern_put(), or NULL on allocation error.
+ */
+extern
+struct cds_lfht_intern_str *cds_lfht_intern(struct cds_lfht_intern *intern,
+		const char *str, size_t len);
+
+/*
+ * cds_lfht_intern_find - get a handle of a string, if interned.
+ *
+ * Return a handle holding a reference, or NULL if the string is not
+ * interned.
+ */
+extern
+struct cds_lfht_intern_str *cds_lfht_intern_find(
+		struct cds_lfht_intern *intern, const char *str, size_t len);
+
+/*
+ * cds_lfht_intern_get - take another reference on a handle.
+ *
+ * The caller must already hold a reference.
+ */
+static inline
+void cds_lfht_intern_get(struct cds_lfht_intern_str *s)
+{
+	urcu_ref_get(&s->ref);
+}
+
+/*
+ * cds_lfht_intern_put - release a reference on a handle.
+ *
+ * Releasing the last reference of a string deletes it from the table.
+ */
+extern
+void cds_lfht_intern_put(struct cds_lfht_intern_str *s);
+
+/* cds_lfht_intern_str - the NUL-terminated bytes of an interned string. */
+static inline
+const char *cds_lfht_intern_str(const struct cds_lfht_intern_str *s)
+{
+	return s->str;
+}
+
+/* cds_lfht_intern_len - the length of an interned string. */
+static inline
+size_t cds_lfht_intern_len(const struct cds_lfht_intern_str *s)
+{
+	return s->len;
+}
+
+/*
+ * cds_lfht_intern_get_stats - get the counts of a table.
+ *
+ * The counts are approximate while the table is updated.
+ */
+extern
+void cds_lfht_intern_get_stats(struct cds_lfht_intern *intern,
+		struct cds_lfht_intern_stats *stats);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* _URCU_RCULFHASH_INTERN_H */
@@ -0,0 +1,301 @@
+#ifndef _URCU_RCULFHASH_SHARDED_H
+#define _URCU_RCULFHASH_SHARDED_H
+
+/*
+ * urcu/rculfhash-sharded.h
+ *
+ * Userspace RCU library - Sharded Lock-Free RCU Hash Table
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ *
+ * Include this file _after_ including your URCU flavor.
+ */
+
+#include <urcu/rculfhash.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*
+ * Set of independent cds_lfht shards, each holding the keys whose hash
+ * has given top bits. The buckets of each shard are indexed by the low
+ * bits of the hash, as for a single table.
+ *
+ * Each shard has its own size, resize mutex and split counters: a shard
+ * resizes on its own, pausing resizes of that shard only. Operations on
+ * a key are those of cds_lfht on the shard of its hash, with the same
+ * RCU requirements. Counting and iteration visit the shards in turn.
+ *
+ * Note that struct cds_lfht_sharded is opaque to callers.
+ */
+struct cds_lfht_sharded;
+
+/*
+ * cds_lfht_sharded_iter: iterator over all shards. Only used through
+ * the API below.
+ */
+struct cds_lfht_sharded_iter {
+	struct cds_lfht_iter iter;
+	unsigned long shard;
+};
+
+/*
+ * _cds_lfht_sharded_new - API used by cds_lfht_sharded_new wrappers. Do
+ * not use directly.
+ */
+extern
+struct cds_lfht_sharded *_cds_lfht_sharded_new(unsigned long nr_shards,
+			unsigned long init_size,
+			unsigned long min_nr_alloc_buckets,
+			unsigned long max_nr_buckets,
+			int flags,
+			const struct cds_lfht_mm_type *mm,
+			const struct rcu_flavor_struct *flavor,
+			pthread_attr_t *attr);
+
+/*
+ * cds_lfht_sharded_new_flavor - allocate a sharded hash table.
+ * @nr_shards: number of shards. Must be power of two.
+ * @init_size, @min_nr_alloc_buckets, @max_nr_buckets, @flags, @flavor,
+ * @attr: as for cds_lfht_new_flavor(), for each shard. All shards share
+ *        the resize threads created with @attr.
+ *
+ * Return NULL on error.
+ */
+static inline
+struct cds_lfht_sharded *cds_lfht_sharded_new_flavor(unsigned long nr_shards,
+			unsigned long init_size,
+			unsigned long min_nr_alloc_buckets,
+			unsigned long max_nr_buckets,
+			int flags,
+			const struct rcu_flavor_struct *flavor,
+			pthread_attr_t *attr)
+{
+	return _cds_lfht_sharded_new(nr_shards, init_size,
+			min_nr_alloc_buckets, max_nr_buckets, flags, NULL,
+			flavor, attr);
+}
+
+#ifdef URCU_API_MAP
+/*
+ * cds_lfht_sharded_new - allocate a sharded hash table tied to the RCU
+ * flavor included before this header. See cds_lfht_sharded_new_flavor.
+ */
+static inline
+struct cds_lfht_sharded *cds_lfht_sharded_new(unsigned long nr_shards,
+			unsigned long init_size,
+			unsigned long min_nr_alloc_buckets,
+			unsigned long max_nr_buckets,
+			int flags,
+			pthread_attr_t *attr)
+{
+	return _cds_lfht_sharded_new(nr_shards, init_size,
+			min_nr_alloc_buckets, max_nr_buckets, flags, NULL,
+			&rcu_flavor, attr);
+}
+#endif /* URCU_API_MAP */
+
+/*
+ * cds_lfht_sharded_destroy - destroy a sharded hash table.
+ * @sht: the sharded hash table to destroy.
+ * @attr: (output) resize worker thread attributes, as received by
+ *        cds_lfht_sharded_new. Can be NULL.
+ *
+ * Destroys each shard as cds_lfht_destroy() does. On error, the shards
+ * already destroyed are not used anymore, and destroy can be called
+ * again once the others are empty.
+ *
+ * Return 0 on success, negative error value on error.
+ */
+extern
+int cds_lfht_sharded_destroy(struct cds_lfht_sharded *sht,
+		pthread_attr_t **attr);
+
+/*
+ * cds_lfht_sharded_nr_shards - number of shards of a sharded table.
+ */
+extern
+unsigned long cds_lfht_sharded_nr_shards(struct cds_lfht_sharded *sht);
+
+/*
+ * cds_lfht_sharded_shard_at - get a shard by index.
+ * @index: shard index, lower than cds_lfht_sharded_nr_shards().
+ *
+ * The shard can be used with the cds_lfht API, for keys of its hashes
+ * only.
+ */
+extern
+struct cds_lfht *cds_lfht_sharded_shard_at(struct cds_lfht_sharded *sht,
+		unsigned long index);
+
+/*
+ * cds_lfht_sharded_shard - get the shard holding a hash value.
+ */
+extern
+struct cds_lfht *cds_lfht_sharded_shard(struct cds_lfht_sharded *sht,
+		unsigned long hash);
+
+/*
+ * cds_lfht_sharded_node_shard - get the shard a node was added to.
+ */
+extern
+struct cds_lfht *cds_lfht_sharded_node_shard(struct cds_lfht_sharded *sht,
+		struct cds_lfht_node *node);
+
+/*
+ * cds_lfht_sharded_lookup - lookup a node by key in its shard.
+ *
+ * Same as cds_lfht_lookup(). Further duplicates are iterated with
+ * cds_lfht_next_duplicate() on cds_lfht_sharded_shard(sht, hash).
+ */
+extern
+void cds_lfht_sharded_lookup(struct cds_lfht_sharded *sht,
+		unsigned long hash, cds_lfht_match_fct match, const void *key,
+		struct cds_lfht_iter *iter);
+
+/*
+ * cds_lfht_sharded_add - add a node to its shard.
+ *
+ * Same as cds_lfht_add().
+ */
+extern
+void cds_lfht_sharded_add(struct cds_lfht_sharded *sht, unsigned long hash,
+		struct cds_lfht_node *node);
+
+/*
+ * cds_lfht_sharded_add_unique - add a node to its shard, if key is not
+ * present.
+ *
+ * Same as cds_lfht_add_unique().
+ */
+extern
+struct cds_lfht_node *cds_lfht_sharded_add_unique(
+		struct cds_lfht_sharded *sht, unsigned long hash,
+		cds_lfht_match_fct match, const void *key,
+		struct cds_lfht_node *node);
+
+/*
+ * cds_lfht_sharded_lookup_or_add - get the node of a key in its shard,
+ * adding it if missing.
+ *
+ * Same as cds_lfht_lookup_or_add().
+ */
+extern
+struct cds_lfht_node *cds_lfht_sharded_lookup_or_add(
+		struct cds_lfht_sharded *sht, unsigned long hash,
+		cds_lfht_match_fct match, const void *key,
+		struct cds_lfht_node *(*ctor)(void *arg),
+		void (*dtor)(struct cds_lfht_node *node, void *arg),
+		void *arg);
+
+/*
+ * cds_lfht_sharded_add_replace - replace or add a node within its shard.
+ *
+ * Same as cds_lfht_add_replace().
+ */
+extern
+struct cds_lfht_node *cds_lfht_sharded_add_replace(
+		struct cds_lfht_sharded *sht, unsigned long hash,
+		cds_lfht_match_fct match, const void *key,
+		struct cds_lfht_node *node);
+
+/*
+ * cds_lfht_sharded_replace - replace a node looked up in its shard.
+ *
+ * Same as cds_lfht_replace(), @old_iter coming from a lookup of @hash.
+ */
+extern
+int cds_lfht_sharded_replace(struct cds_lfht_sharded *sht,
+		struct cds_lfht_iter *old_iter, unsigned long hash,
+		cds_lfht_match_fct match, const void *key,
+		struct cds_lfht_node *new_node);
+
+/*
+ * cds_lfht_sharded_del - remove a node from its shard.
+ *
+ * Same as cds_lfht_del(). The shard is found from the node hash.
+ */
+extern
+int cds_lfht_sharded_del(struct cds_lfht_sharded *sht,
+		struct cds_lfht_node *node);
+
+/*
+ * cds_lfht_sharded_count_nodes - count the nodes of all shards.
+ *
+ * Same as cds_lfht_count_nodes(), summed over the shards.
+ */
+extern
+void cds_lfht_sharded_count_nodes(struct cds_lfht_sharded *sht,
+		long *split_count_before,
+		unsigned long *count,
+		long *split_count_after);
+
+/*
+ * cds_lfht_sharded_resize - force each shard to a new size.
+ * @new_size: the new size of each shard, in buckets.
+ *
+ * Same as cds_lfht_resize(), for each shard in turn.
+ */
+extern
+void cds_lfht_sharded_resize(struct cds_lfht_sharded *sht,
+		unsigned long new_size);
+
+/*
+ * cds_lfht_sharded_first - get the first node of the first non-empty
+ * shard.
+ * cds_lfht_sharded_next - get the next node, moving on to the next
+ * shards at the end of each shard.
+ *
+ * Same as cds_lfht_first() and cds_lfht_next(), over all shards. The
+ * node is NULL once all shards have been visited. Call under
+ * rcu_read_lock.
+ */
+extern
+void cds_lfht_sharded_first(struct cds_lfht_sharded *sht,
+		struct cds_lfht_sharded_iter *iter);
+
+extern
+void cds_lfht_sharded_next(struct cds_lfht_sharded *sht,
+		struct cds_lfht_sharded_iter *iter);
+
+static inline
+struct cds_lfht_node *cds_lfht_sharded_iter_get_node(
+		struct cds_lfht_sharded_iter *iter)
+{
+	return cds_lfht_iter_get_node(&iter->iter);
+}
+
+#define cds_lfht_sharded_for_each(sht, iter, node)			\
+	for (cds_lfht_sharded_first(sht, iter),				\
+			node = cds_lfht_sharded_iter_get_node(iter);	\
+		node != NULL;						\
+		cds_lfht_sharded_next(sht, iter),			\
+			node = cds_lfht_sharded_iter_get_node(iter))
+
+#define cds_lfht_sharded_for_each_entry(sht, iter, pos, member)	\
+	for (cds_lfht_sharded_first(sht, iter),				\
+			pos = caa_container_of(cds_lfht_sharded_iter_get_node(iter), \
+					__typeof__(*(pos)), member);	\
+		cds_lfht_sharded_iter_get_node(iter) != NULL;		\
+		cds_lfht_sharded_next(sht, iter),			\
+			pos = caa_container_of(cds_lfht_sharded_iter_get_node(iter), \
+					__typeof__(*(pos)), member))
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* _URCU_RCULFHASH_SHARDED_H */
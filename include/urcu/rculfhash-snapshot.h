@@ -0,0 +1,236 @@
+#ifndef _URCU_RCULFHASH_SNAPSHOT_H
+#define _URCU_RCULFHASH_SNAPSHOT_H
+
+/*
+ * urcu/rculfhash-snapshot.h
+ *
+ * Userspace RCU library - point-in-time snapshots of a cds_lfht
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ *
+ * For use with URCU_API_MAP (API mapping of liburcu), include this file
+ * _after_ including your URCU flavor.
+ */
+
+#include <limits.h>
+#include <stdbool.h>
+#include <urcu/list.h>
+#include <urcu/system.h>
+#include <urcu/call-rcu.h>
+#include <urcu/rculfhash.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*
+ * Point-in-time snapshots of a cds_lfht, for consistent scans of the
+ * table while it is updated, without copying it.
+ *
+ * Each entry carries the epoch of its addition and of its deletion.
+ * Taking a snapshot closes the current epoch: the snapshot sees the
+ * entries added in that epoch or before, and not deleted by then.
+ * Deleting an entry only stamps its deletion epoch while a snapshot
+ * which sees it is open, and it stays in the table, hidden from the
+ * live view. Closing the oldest snapshot deletes the entries no open
+ * snapshot sees any more from the table, and passes them to the free
+ * function of the snapshot index after a grace period.
+ *
+ * Entries of a table with a snapshot index must be added and deleted
+ * through the functions below. A snapshot sees the updates stamped
+ * with its epoch or an earlier one: cds_lfht_snap_replace() stamps the
+ * deletion of the old entry and the addition of the new one with the
+ * same epoch, so that each snapshot sees exactly one of them.
+ *
+ * cds_lfht_snap_take() waits for a grace period, and must be called
+ * outside of any read-side critical section. All other functions but
+ * cds_lfht_snap_new_flavor() and cds_lfht_snap_destroy() must be called
+ * within a read-side critical section of the flavor of the table.
+ *
+ * Note that struct cds_lfht_snap is opaque to callers.
+ */
+struct cds_lfht_snap;
+
+/* Epoch of the live view of the table, which sees all entries. */
+#define CDS_LFHT_SNAP_LIVE	ULONG_MAX
+
+/*
+ * Entry of a table with a snapshot index, embedded in the user object,
+ * whose node is the one added to the table.
+ */
+struct cds_lfht_snap_node {
+	struct cds_lfht_node node;
+	unsigned long add_epoch;
+	unsigned long del_epoch;	/* 0 until deleted. */
+	struct cds_list_head link;	/* Deleted, seen by a snapshot. */
+	struct rcu_head rcu_head;	/* Passed to the free function. */
+};
+
+/*
+ * Open snapshot, owned by the caller until cds_lfht_snap_close().
+ */
+struct cds_lfht_snapshot {
+	unsigned long epoch;
+	struct cds_list_head link;
+};
+
+struct rcu_flavor_struct;
+
+/*
+ * cds_lfht_snap_new_flavor - allocate a snapshot index.
+ * @ht: table of the entries, which must use @flavor.
+ * @free_node: invoked on the rcu_head of the deleted entries, once no
+ *             open snapshot sees them, after a grace period.
+ * @flavor: RCU flavor of the table.
+ *
+ * Return NULL on error.
+ */
+extern
+struct cds_lfht_snap *cds_lfht_snap_new_flavor(struct cds_lfht *ht,
+		void (*free_node)(struct rcu_head *head),
+		const struct rcu_flavor_struct *flavor);
+
+#ifdef URCU_API_MAP
+/*
+ * cds_lfht_snap_new - allocate a snapshot index tied to the RCU flavor
+ * included before this header. See cds_lfht_snap_new_flavor.
+ */
+static inline
+struct cds_lfht_snap *cds_lfht_snap_new(struct cds_lfht *ht,
+		void (*free_node)(struct rcu_head *head))
+{
+	return cds_lfht_snap_new_flavor(ht, free_node, &rcu_flavor);
+}
+#endif /* URCU_API_MAP */
+
+/*
+ * cds_lfht_snap_destroy - free a snapshot index.
+ *
+ * The live entries stay in the table. Must not be called concurrently
+ * with other operations on the index. Return 0 on success, -EBUSY if
+ * snapshots are open.
+ */
+extern
+int cds_lfht_snap_destroy(struct cds_lfht_snap *snap);
+
+/*
+ * cds_lfht_snap_node_visible - whether a snapshot of @epoch, or the
+ * live view if @epoch is CDS_LFHT_SNAP_LIVE, sees an entry.
+ */
+static inline
+bool cds_lfht_snap_node_visible(struct cds_lfht_snap_node *node,
+		unsigned long epoch)
+{
+	unsigned long del_epoch = CMM_LOAD_SHARED(node->del_epoch);
+
+	return node->add_epoch <= epoch && (!del_epoch || del_epoch > epoch);
+}
+
+/*
+ * cds_lfht_snap_add - add an entry to the table.
+ *
+ * Snapshots taken before are not affected.
+ */
+extern
+void cds_lfht_snap_add(struct cds_lfht_snap *snap, unsigned long hash,
+		struct cds_lfht_snap_node *node);
+
+/*
+ * cds_lfht_snap_add_unique - add an entry if no live entry matches.
+ *
+ * Return @node if it was added, or the live entry matching @key.
+ */
+extern
+struct cds_lfht_snap_node *cds_lfht_snap_add_unique(struct cds_lfht_snap *snap,
+		unsigned long hash, cds_lfht_match_fct match, const void *key,
+		struct cds_lfht_snap_node *node);
+
+/*
+ * cds_lfht_snap_del - delete an entry.
+ *
+ * The open snapshots which see the entry keep seeing it until they are
+ * closed. Return 0 on success, -ENOENT if the entry was already
+ * deleted.
+ */
+extern
+int cds_lfht_snap_del(struct cds_lfht_snap *snap,
+		struct cds_lfht_snap_node *node);
+
+/*
+ * cds_lfht_snap_replace - replace an entry by a new one, of @hash.
+ *
+ * The open snapshots which see @old_node keep seeing it, and not
+ * @new_node, until they are closed. The live view may briefly see
+ * neither. Return 0 on success, -ENOENT if @old_node was already
+ * deleted, in which case @new_node is not added.
+ */
+extern
+int cds_lfht_snap_replace(struct cds_lfht_snap *snap, unsigned long hash,
+		struct cds_lfht_snap_node *old_node,
+		struct cds_lfht_snap_node *new_node);
+
+/*
+ * cds_lfht_snap_lookup - find the entry matching @key seen by a
+ * snapshot of @epoch, or by the live view if @epoch is
+ * CDS_LFHT_SNAP_LIVE.
+ *
+ * Return NULL if not found.
+ */
+extern
+struct cds_lfht_snap_node *cds_lfht_snap_lookup(struct cds_lfht_snap *snap,
+		unsigned long epoch, unsigned long hash,
+		cds_lfht_match_fct match, const void *key);
+
+/*
+ * cds_lfht_snap_take - open a snapshot of the table.
+ *
+ * Waits for the additions and deletions in progress to complete, so
+ * that the snapshot sees a table which does not change under it.
+ * Must be called outside of any read-side critical section.
+ */
+extern
+void cds_lfht_snap_take(struct cds_lfht_snap *snap,
+		struct cds_lfht_snapshot *snapshot);
+
+/*
+ * cds_lfht_snap_close - close a snapshot.
+ *
+ * The entries deleted since it was taken and not seen by an older open
+ * snapshot are deleted from the table, and passed to the free function
+ * after a grace period. Return the number of entries reclaimed.
+ */
+extern
+unsigned long cds_lfht_snap_close(struct cds_lfht_snap *snap,
+		struct cds_lfht_snapshot *snapshot);
+
+/*
+ * cds_lfht_snap_for_each_entry - iterate over the entries of the table
+ * seen by a snapshot of @epoch, or by the live view if @epoch is
+ * CDS_LFHT_SNAP_LIVE.
+ * @ht: the hash table.
+ * @epoch: the epoch of the snapshot.
+ * @iter: struct cds_lfht_iter used for iteration.
+ * @pos: the type * to use as a loop cursor.
+ * @member: the name of the cds_lfht_snap_node within the struct.
+ */
+#define cds_lfht_snap_for_each_entry(ht, epoch, iter, pos, member)	\
+	cds_lfht_for_each_entry(ht, iter, pos, member.node)		\
+		if (!cds_lfht_snap_node_visible(&(pos)->member, epoch)) {} else
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* _URCU_RCULFHASH_SNAPSHOT_H */
@@ -31,6 +31,7 @@
 #include <stdint.h>
 #include <pthread.h>
 #include <urcu/compiler.h>
+#include <urcu/stats.h>
 
 #ifdef __cplusplus
 extern "C" {
@@ -65,6 +66,21 @@ struct cds_lfht_node {
 	unsigned long reverse_hash;
 } __attribute__((aligned(8)));
 
+/*
+ * struct cds_lfht_tag_node: hash table node carrying a tag, a
+ * fingerprint of the key chosen by the caller (e.g. other bits of the
+ * key hash, or a short key inlined). Tables created with
+ * CDS_LFHT_NODE_TAG must only contain struct cds_lfht_tag_node, which
+ * is embedded instead of struct cds_lfht_node, and nodes with the same
+ * key must have the same tag. Lookups compare the tag before calling
+ * the match function, so nodes of a chain with a different key are
+ * skipped without accessing the structure embedding them.
+ */
+struct cds_lfht_tag_node {
+	struct cds_lfht_node node;
+	unsigned long tag;
+};
+
 /* cds_lfht_iter: Used to track state while traversing a hash chain. */
 struct cds_lfht_iter {
 	struct cds_lfht_node *node, *next;
@@ -88,6 +104,44 @@ struct cds_lfht_node *cds_lfht_iter_get_node(struct cds_lfht_iter *iter)
 	return iter->node;
 }
 
+/*
+ * Position of a traversal kept across read-side critical sections, see
+ * cds_lfht_cursor_resume(). Fields are private.
+ */
+struct cds_lfht_cursor {
+	unsigned long reverse_hash;	/* of the last node visited */
+	struct cds_lfht_node *node;	/* last node visited, never dereferenced */
+	unsigned long index;		/* of node among its reverse hash */
+	int state;
+};
+
+enum cds_lfht_cursor_state {
+	CDS_LFHT_CURSOR_START = 0,
+	CDS_LFHT_CURSOR_SAVED,
+	CDS_LFHT_CURSOR_END,
+};
+
+/*
+ * cds_lfht_cursor_init - initialize a cursor to the start of the table.
+ */
+static inline
+void cds_lfht_cursor_init(struct cds_lfht_cursor *cursor)
+{
+	cursor->reverse_hash = 0;
+	cursor->node = NULL;
+	cursor->index = 0;
+	cursor->state = CDS_LFHT_CURSOR_START;
+}
+
+/*
+ * cds_lfht_cursor_done - whether the traversal reached the end of the table.
+ */
+static inline
+int cds_lfht_cursor_done(struct cds_lfht_cursor *cursor)
+{
+	return cursor->state == CDS_LFHT_CURSOR_END;
+}
+
 struct rcu_flavor_struct;
 
 /*
@@ -109,12 +163,28 @@ void cds_lfht_node_init(struct cds_lfht_node *node)
 {
 }
 
+/*
+ * cds_lfht_tag_node_init - initialize a tagged hash table node
+ * @tnode: the node to initialize.
+ * @tag: the node tag, which must not change while the node is in a table.
+ */
+static inline
+void cds_lfht_tag_node_init(struct cds_lfht_tag_node *tnode,
+		unsigned long tag)
+{
+	cds_lfht_node_init(&tnode->node);
+	tnode->tag = tag;
+}
+
 /*
  * Hash table creation flags.
  */
 enum {
 	CDS_LFHT_AUTO_RESIZE = (1U << 0),
 	CDS_LFHT_ACCOUNTING = (1U << 1),
+	CDS_LFHT_NODE_TAG = (1U << 2),
+	CDS_LFHT_SINGLE_WRITER = (1U << 3),
+	CDS_LFHT_PREALLOC = (1U << 4),
 };
 
 struct cds_lfht_mm_type {
@@ -128,7 +198,152 @@ struct cds_lfht_mm_type {
 
 extern const struct cds_lfht_mm_type cds_lfht_mm_order;
 extern const struct cds_lfht_mm_type cds_lfht_mm_chunk;
+/*
+ * cds_lfht_mm_mmap reserves the address space of the largest table at
+ * once, populating it as the table grows. It is the default on 64-bit
+ * architectures up to 2^40 buckets, and for unbounded tables, which get
+ * 2^36 buckets. Reservations above 2^32 buckets are halved until they
+ * fit in the address space available; if the default cannot reserve
+ * its table, cds_lfht_mm_order is used.
+ */
 extern const struct cds_lfht_mm_type cds_lfht_mm_mmap;
+/*
+ * cds_lfht_mm_hugepage backs the bucket table of large tables with huge
+ * pages (explicit or transparent). cds_lfht_mm_hugepage_interleave also
+ * interleaves it over the NUMA nodes allowed to the process, and the
+ * resize threads processing a partition of such a table run on the node
+ * holding its buckets. Select them by passing them to _cds_lfht_new().
+ */
+extern const struct cds_lfht_mm_type cds_lfht_mm_hugepage;
+extern const struct cds_lfht_mm_type cds_lfht_mm_hugepage_interleave;
+/*
+ * cds_lfht_mm_mmap_compact lays out the bucket table as cds_lfht_mm_mmap
+ * does, but each bucket only holds its next pointer, its reverse hash
+ * being computed from its index: the bucket table is half the size on
+ * 64-bit architectures. Select it by passing it to _cds_lfht_new().
+ */
+extern const struct cds_lfht_mm_type cds_lfht_mm_mmap_compact;
+
+/*
+ * Automatic resize policy, see cds_lfht_new_policy().
+ *
+ * @target_load: number of nodes per bucket aimed at by automatic
+ *               resizes (>= 1).
+ * @grow_load: with CDS_LFHT_ACCOUNTING, the table grows once it holds
+ *             grow_load nodes per bucket (>= target_load). The ratio
+ *             grow_load / target_load is the grow hysteresis.
+ * @grow_chain_len: a small table, or a table without accounting, grows
+ *                  once an addition walks a chain of grow_chain_len
+ *                  nodes (>= 1).
+ * @shrink_div: with CDS_LFHT_ACCOUNTING, the table only shrinks to a
+ *              size at least shrink_div times smaller (the shrink
+ *              hysteresis). 0 never shrinks.
+ * @min_shrink_interval_ms: minimum time between the end of a resize
+ *                          and an automatic shrink. 0 for no minimum.
+ * @allow_resize: optional callback, called before an automatic resize
+ *                from size to new_size buckets is queued; returning 0
+ *                vetoes it. Called from updater threads within
+ *                read-side critical sections: must not block nor
+ *                update the table.
+ * @priv: passed to allow_resize.
+ *
+ * Tables created without a policy use target_load 1, grow_load 8,
+ * grow_chain_len 3 and shrink_div 1.
+ */
+struct cds_lfht_resize_policy {
+	unsigned long target_load;
+	unsigned long grow_load;
+	unsigned long grow_chain_len;
+	unsigned long shrink_div;
+	unsigned long min_shrink_interval_ms;
+	int (*allow_resize)(struct cds_lfht *ht, unsigned long size,
+			unsigned long new_size, void *priv);
+	void *priv;
+};
+
+/*
+ * Resize instrumentation, see cds_lfht_get_resize_stats() and
+ * cds_lfht_set_resize_hook().
+ *
+ * A resize event covers one grow or shrink pass of the resize worker,
+ * from old_size to new_size buckets (the target size at start, the size
+ * reached at end, as the pass stops early if the target changes).
+ * Tables are split-ordered lists: resizes do not move nodes, but link
+ * (grow) or unlink (shrink) nr_buckets bucket nodes, with nr_threads
+ * partition threads, and shrinks wait for nr_gp_waits grace periods.
+ */
+struct cds_lfht_resize_event {
+	unsigned long old_size;
+	unsigned long new_size;
+	uint64_t duration_ns;		/* Only valid at end. */
+	unsigned long nr_buckets;	/* Only valid at end. */
+	unsigned long nr_threads;	/* Only valid at end. */
+	unsigned long nr_gp_waits;	/* Only valid at end. */
+};
+
+enum cds_lfht_resize_event_type {
+	CDS_LFHT_RESIZE_START,
+	CDS_LFHT_RESIZE_END,
+};
+
+struct cds_lfht_resize_stats {
+	int in_progress;		/* Resize pass ongoing. */
+	struct cds_lfht_resize_event current;	/* Ongoing pass, at start. */
+	struct cds_lfht_resize_event last;	/* Last completed pass. */
+	unsigned long nr_grow;
+	unsigned long nr_shrink;
+	uint64_t total_duration_ns;
+	uint64_t max_duration_ns;
+	unsigned long nr_buckets;
+	unsigned long nr_threads;
+	unsigned long nr_gp_waits;
+	struct urcu_lock_stats resize_lock;	/* Contention on resizes. */
+};
+
+/*
+ * Memory used by a table, see cds_lfht_get_mem_stats(). Nodes are
+ * allocated by the caller, and not accounted for.
+ */
+struct cds_lfht_mem_stats {
+	size_t table_bytes;		/* struct cds_lfht and its chunk index. */
+	size_t bucket_bytes;		/* Bucket tables populated or retained. */
+	size_t split_count_bytes;	/* Per-CPU item counters. */
+};
+
+/*
+ * Snapshot of a live table, see cds_lfht_for_each_table(). count is the
+ * number of nodes of tables created with CDS_LFHT_ACCOUNTING, 0 for the
+ * others.
+ */
+struct cds_lfht_info {
+	unsigned long size;		/* Number of buckets. */
+	long count;
+	int flags;			/* CDS_LFHT_* creation flags. */
+};
+
+/*
+ * Hash quality diagnostics, see cds_lfht_diag_scan(). Counts accumulate
+ * over the scanned buckets: zero-initialize before the first scan.
+ *
+ * The chain of a bucket holds the nodes between its bucket node and the
+ * next one. chain_len_hist[i] counts the chains of i nodes, the last
+ * entry counting the longer ones too. nr_dup_reverse_hash counts nodes
+ * with the same reverse hash as the previous node of their chain, i.e.
+ * full hash collisions: over nr_nodes, the fraction of duplicates. The
+ * bucket fill ratio is 1 - nr_empty_buckets / nr_buckets_scanned.
+ * nr_removed counts nodes logically removed but not yet unlinked.
+ */
+#define CDS_LFHT_DIAG_HIST_LEN	16
+
+struct cds_lfht_diag {
+	unsigned long nr_buckets_scanned;
+	unsigned long nr_empty_buckets;
+	unsigned long nr_nodes;
+	unsigned long nr_dup_reverse_hash;
+	unsigned long nr_removed;
+	unsigned long max_chain_len;
+	unsigned long chain_len_hist[CDS_LFHT_DIAG_HIST_LEN];
+};
 
 /*
  * _cds_lfht_new - API used by cds_lfht_new wrapper. Do not use directly.
@@ -142,6 +357,20 @@ struct cds_lfht *_cds_lfht_new(unsigned long init_size,
 			const struct rcu_flavor_struct *flavor,
 			pthread_attr_t *attr);
 
+/*
+ * _cds_lfht_new_policy - API used by cds_lfht_new_policy wrapper. Do not
+ * use directly. A NULL policy selects the default policy.
+ */
+extern
+struct cds_lfht *_cds_lfht_new_policy(unsigned long init_size,
+			unsigned long min_nr_alloc_buckets,
+			unsigned long max_nr_buckets,
+			int flags,
+			const struct cds_lfht_mm_type *mm,
+			const struct rcu_flavor_struct *flavor,
+			pthread_attr_t *attr,
+			const struct cds_lfht_resize_policy *policy);
+
 /*
  * cds_lfht_new_flavor - allocate a hash table tied to a RCU flavor.
  * @init_size: number of buckets to allocate initially. Must be power of two.
@@ -149,17 +378,33 @@ struct cds_lfht *_cds_lfht_new(unsigned long init_size,
  *                        (must be power of two)
  * @max_nr_buckets: the maximum number of hash table buckets allowed.
  *                  (must be power of two, 0 is accepted, means
- *                  "infinite")
+ *                  "infinite": on 64-bit architectures, 2^36 buckets
+ *                  of reserved address space, see cds_lfht_mm_mmap)
  * @flavor: flavor of liburcu to use to synchronize the hash table
  * @flags: hash table creation flags (can be combined with bitwise or: '|').
  *           0: no flags.
  *           CDS_LFHT_AUTO_RESIZE: automatically resize hash table.
  *           CDS_LFHT_ACCOUNTING: count the number of node addition
  *                                and removal in the table
+ *           CDS_LFHT_NODE_TAG: nodes are struct cds_lfht_tag_node,
+ *                              see cds_lfht_lookup_tag()
+ *           CDS_LFHT_SINGLE_WRITER: the caller guarantees that add,
+ *                                   del and replace operations are
+ *                                   never concurrent: they link nodes
+ *                                   with plain stores, except while a
+ *                                   resize is in progress
+ *           CDS_LFHT_PREALLOC: create the resize threads along with the
+ *                              table rather than on the first
+ *                              partitioned resize
  * @attr: optional resize worker thread attributes. NULL for default.
+ *        Resize threads are created on demand and shared by the tables
+ *        created with the same @attr, which must stay valid until the
+ *        last of them is destroyed.
  *
  * Return NULL on error.
  * Note: the RCU flavor must be already included before the hash table header.
+ * The flavor-specialized builds of the library, liburcu-cds-qsbr and
+ * liburcu-cds-memb, return NULL for tables of another flavor.
  *
  * The programmer is responsible for ensuring that resize operation has a
  * priority equal to hash table updater threads. It should be performed by
@@ -193,16 +438,29 @@ struct cds_lfht *cds_lfht_new_flavor(unsigned long init_size,
  *                        (must be power of two)
  * @max_nr_buckets: the maximum number of hash table buckets allowed.
  *                  (must be power of two, 0 is accepted, means
- *                  "infinite")
+ *                  "infinite": on 64-bit architectures, 2^36 buckets
+ *                  of reserved address space, see cds_lfht_mm_mmap)
  * @flags: hash table creation flags (can be combined with bitwise or: '|').
  *           0: no flags.
  *           CDS_LFHT_AUTO_RESIZE: automatically resize hash table.
  *           CDS_LFHT_ACCOUNTING: count the number of node addition
  *                                and removal in the table
+ *           CDS_LFHT_NODE_TAG: nodes are struct cds_lfht_tag_node,
+ *                              see cds_lfht_lookup_tag()
+ *           CDS_LFHT_SINGLE_WRITER: the caller guarantees that add,
+ *                                   del and replace operations are
+ *                                   never concurrent: they link nodes
+ *                                   with plain stores, except while a
+ *                                   resize is in progress
+ *           CDS_LFHT_PREALLOC: create the resize threads along with the
+ *                              table rather than on the first
+ *                              partitioned resize
  * @attr: optional resize worker thread attributes. NULL for default.
  *
  * Return NULL on error.
  * Note: the RCU flavor must be already included before the hash table header.
+ * The flavor-specialized builds of the library, liburcu-cds-qsbr and
+ * liburcu-cds-memb, return NULL for tables of another flavor.
  *
  * The programmer is responsible for ensuring that resize operation has a
  * priority equal to hash table updater threads. It should be performed by
@@ -225,6 +483,26 @@ struct cds_lfht *cds_lfht_new(unsigned long init_size,
 	return _cds_lfht_new(init_size, min_nr_alloc_buckets, max_nr_buckets,
 			flags, NULL, &rcu_flavor, attr);
 }
+
+/*
+ * cds_lfht_new_policy - allocate a hash table with a resize policy.
+ * @policy: automatic resize policy, copied into the table.
+ *
+ * Same as cds_lfht_new(), with a policy controlling when
+ * CDS_LFHT_AUTO_RESIZE grows and shrinks the table. Return NULL on error,
+ * including invalid policies.
+ */
+static inline
+struct cds_lfht *cds_lfht_new_policy(unsigned long init_size,
+			unsigned long min_nr_alloc_buckets,
+			unsigned long max_nr_buckets,
+			int flags,
+			const struct cds_lfht_resize_policy *policy,
+			pthread_attr_t *attr)
+{
+	return _cds_lfht_new_policy(init_size, min_nr_alloc_buckets,
+			max_nr_buckets, flags, NULL, &rcu_flavor, attr, policy);
+}
 #endif /* URCU_API_MAP */
 
 /*
@@ -251,6 +529,56 @@ struct cds_lfht *cds_lfht_new(unsigned long init_size,
 extern
 int cds_lfht_destroy(struct cds_lfht *ht, pthread_attr_t **attr);
 
+/*
+ * cds_lfht_destroy_async - destroy a hash table in the background.
+ * @ht: the hash table to destroy.
+ * @free_node: called for each node of the table, after a grace period
+ *             following its removal. Can be NULL.
+ * @done: called once the table is destroyed, with the return value of
+ *        cds_lfht_destroy() and the resize worker thread attributes, as
+ *        received by cds_lfht_new. Can be NULL.
+ * @priv: argument passed to @free_node and @done.
+ *
+ * Returns immediately: resizes are cancelled, and the nodes are removed
+ * and the table freed from the call_rcu worker thread of the table RCU
+ * flavor. Readers which already hold a reference to the table can keep
+ * using it until the end of their read-side critical section, but no
+ * reader may look the table up anew, nor updater modify it, once this
+ * function is called.
+ *
+ * Call from a registered RCU read-side thread, without rcu_read_lock
+ * held. Return 0 on success, -ENOMEM on error, in which case the table
+ * is left untouched.
+ */
+extern
+int cds_lfht_destroy_async(struct cds_lfht *ht,
+		void (*free_node)(struct cds_lfht_node *node, void *priv),
+		void (*done)(int ret, pthread_attr_t *attr, void *priv),
+		void *priv);
+
+/*
+ * cds_lfht_publish - publish a table built offline, replacing another.
+ * @ptr: the pointer through which readers look the table up.
+ * @ht: the table to publish, filled with cds_lfht_add_offline() or
+ *      cds_lfht_add_unique_offline().
+ * @free_node, @done, @priv: passed to cds_lfht_destroy_async() for the
+ *                           table previously pointed to by @ptr.
+ *
+ * Exchanges *@ptr and @ht with rcu_xchg_pointer(), which orders the
+ * stores of the offline build before publication, then destroys the
+ * previous table, if any, as cds_lfht_destroy_async() does. @ht is a
+ * regular table from then on.
+ *
+ * Call from a registered RCU read-side thread, without rcu_read_lock
+ * held. Return 0 on success, -ENOMEM on error, in which case nothing
+ * is published.
+ */
+extern
+int cds_lfht_publish(struct cds_lfht **ptr, struct cds_lfht *ht,
+		void (*free_node)(struct cds_lfht_node *node, void *priv),
+		void (*done)(int ret, pthread_attr_t *attr, void *priv),
+		void *priv);
+
 /*
  * cds_lfht_count_nodes - count the number of nodes in the hash table.
  * @ht: the hash table.
@@ -267,6 +595,59 @@ void cds_lfht_count_nodes(struct cds_lfht *ht,
 		unsigned long *count,
 		long *split_count_after);
 
+/*
+ * cds_lfht_count_split - sum the node count split-counters.
+ * @ht: the hash table, created with CDS_LFHT_ACCOUNTING.
+ * @count: number of nodes added minus number of nodes removed (output).
+ *
+ * Sums one add/remove counter pair per CPU, without traversing the
+ * table. The count is exact when no add or removal runs concurrently,
+ * and otherwise may miss or include each of the concurrent operations.
+ * Returns 0 on success, -EINVAL if the table has no node accounting.
+ * Does not need to be called with rcu_read_lock held.
+ */
+extern
+int cds_lfht_count_split(struct cds_lfht *ht, long *count);
+
+/*
+ * cds_lfht_count_global - read the node count global counter.
+ * @ht: the hash table, created with CDS_LFHT_ACCOUNTING.
+ * @count: approximate number of nodes in the table (output).
+ * @max_error: bound on the error of *count (output), or NULL.
+ *
+ * Reads the global counter, to which each split-counter commits every
+ * batch of adds or removals: *count is within *max_error of the count
+ * returned by cds_lfht_count_split(), in a single load.
+ * Returns 0 on success, -EINVAL if the table has no node accounting.
+ * Does not need to be called with rcu_read_lock held.
+ */
+extern
+int cds_lfht_count_global(struct cds_lfht *ht, long *count,
+		unsigned long *max_error);
+
+/*
+ * cds_lfht_diag_scan - gather hash quality diagnostics on buckets.
+ * @ht: the hash table.
+ * @first: index of the first bucket to scan.
+ * @nr: number of buckets to scan.
+ * @diag: diagnostics, accumulated over the scanned buckets (output).
+ *
+ * Scans buckets [@first, @first + @nr) of the current table size, and
+ * adds their chains to @diag. Short scans can be run one after the
+ * other, e.g. from a background thread, starting from the returned
+ * index, to cover the table incrementally; or at sampled indexes. The
+ * results are approximate if the table is updated or resized
+ * meanwhile.
+ *
+ * Return the index of the next bucket to scan, 0 once the last bucket
+ * was scanned.
+ * Call with rcu_read_lock held.
+ * Threads calling this API need to be registered RCU read-side threads.
+ */
+extern
+unsigned long cds_lfht_diag_scan(struct cds_lfht *ht, unsigned long first,
+		unsigned long nr, struct cds_lfht_diag *diag);
+
 /*
  * cds_lfht_lookup - lookup a node by key.
  * @ht: the hash table.
@@ -284,6 +665,51 @@ void cds_lfht_lookup(struct cds_lfht *ht, unsigned long hash,
 		cds_lfht_match_fct match, const void *key,
 		struct cds_lfht_iter *iter);
 
+/*
+ * cds_lfht_lookup_tag - lookup a node by key and tag.
+ * @ht: the hash table, created with CDS_LFHT_NODE_TAG.
+ * @hash: the key hash.
+ * @tag: the key tag.
+ * @match: the key match function.
+ * @key: the current node key.
+ * @iter: node, if found (output). *iter->node set to NULL if not found.
+ *
+ * Same as cds_lfht_lookup(), but match is only called for nodes whose
+ * tag is @tag.
+ *
+ * Call with rcu_read_lock held.
+ * Threads calling this API need to be registered RCU read-side threads.
+ * This function acts as a rcu_dereference() to read the node pointer.
+ */
+extern
+void cds_lfht_lookup_tag(struct cds_lfht *ht, unsigned long hash,
+		unsigned long tag, cds_lfht_match_fct match, const void *key,
+		struct cds_lfht_iter *iter);
+
+/*
+ * cds_lfht_lookup_batch - lookup nodes by key, for several keys.
+ * @ht: the hash table.
+ * @nr: number of keys.
+ * @hashes: array of nr key hashes.
+ * @match: the key match function.
+ * @keys: array of nr keys.
+ * @iters: array of nr iterators (output). iters[i] is set as
+ *         cds_lfht_lookup() would for hashes[i] and keys[i].
+ *
+ * Same as calling cds_lfht_lookup() for each key, but the lookups are
+ * interleaved: the bucket nodes of a group of keys are prefetched, then
+ * the first node of their chains, before their chains are walked, which
+ * overlaps the cache misses of the lookups.
+ *
+ * Call with rcu_read_lock held.
+ * Threads calling this API need to be registered RCU read-side threads.
+ * This function acts as a rcu_dereference() to read the node pointers.
+ */
+extern
+void cds_lfht_lookup_batch(struct cds_lfht *ht, unsigned long nr,
+		const unsigned long *hashes, cds_lfht_match_fct match,
+		const void * const *keys, struct cds_lfht_iter *iters);
+
 /*
  * cds_lfht_next_duplicate - get the next item with same key, after iterator.
  * @ht: the hash table.
@@ -309,6 +735,23 @@ void cds_lfht_next_duplicate(struct cds_lfht *ht,
 		cds_lfht_match_fct match, const void *key,
 		struct cds_lfht_iter *iter);
 
+/*
+ * cds_lfht_next_duplicate_tag - get the next item with same key and tag.
+ * @ht: the hash table, created with CDS_LFHT_NODE_TAG.
+ * @tag: the key tag.
+ * @match: the key match function.
+ * @key: the current node key.
+ * @iter: input: current iterator.
+ *        output: node, if found. *iter->node set to NULL if not found.
+ *
+ * Same as cds_lfht_next_duplicate(), but match is only called for nodes
+ * whose tag is @tag.
+ */
+extern
+void cds_lfht_next_duplicate_tag(struct cds_lfht *ht, unsigned long tag,
+		cds_lfht_match_fct match, const void *key,
+		struct cds_lfht_iter *iter);
+
 /*
  * cds_lfht_first - get the first node in the table.
  * @ht: the hash table.
@@ -337,6 +780,160 @@ void cds_lfht_first(struct cds_lfht *ht, struct cds_lfht_iter *iter);
 extern
 void cds_lfht_next(struct cds_lfht *ht, struct cds_lfht_iter *iter);
 
+/*
+ * Range traversals.
+ *
+ * Table nodes are kept sorted by reverse hash (the bit-reversed key
+ * hash, stored in struct cds_lfht_node reverse_hash), so the nodes whose
+ * reverse hash is within [first, last] form a contiguous part of the
+ * table, and disjoint ranges can be traversed independently, e.g. by
+ * several threads. Nodes with the same key are always within the same
+ * range. cds_lfht_range_split() computes such ranges.
+ */
+
+/*
+ * cds_lfht_iter_from - get the first node with reverse hash >= first.
+ * @ht: the hash table.
+ * @first: first reverse hash of the traversal.
+ * @iter: First node, if exists (output). *iter->node set to NULL if not found.
+ *
+ * The lookup starts from the bucket covering @first, so its cost does
+ * not depend on the position of @first in the table. cds_lfht_next()
+ * then continues the traversal in reverse hash order.
+ * Call with rcu_read_lock held.
+ * Threads calling this API need to be registered RCU read-side threads.
+ * This function acts as a rcu_dereference() to read the node pointer.
+ */
+extern
+void cds_lfht_iter_from(struct cds_lfht *ht, unsigned long first,
+		struct cds_lfht_iter *iter);
+
+/*
+ * cds_lfht_first_range - get the first node with reverse hash in [first, last].
+ * @ht: the hash table.
+ * @first: first reverse hash of the range.
+ * @last: last reverse hash of the range (inclusive).
+ * @iter: First node, if exists (output). *iter->node set to NULL if not found.
+ *
+ * Call with rcu_read_lock held.
+ * Threads calling this API need to be registered RCU read-side threads.
+ * This function acts as a rcu_dereference() to read the node pointer.
+ */
+extern
+void cds_lfht_first_range(struct cds_lfht *ht, unsigned long first,
+		unsigned long last, struct cds_lfht_iter *iter);
+
+/*
+ * cds_lfht_next_range - get the next node with reverse hash <= last.
+ * @ht: the hash table.
+ * @last: last reverse hash of the range (inclusive).
+ * @iter: input: current iterator.
+ *        output: next node, if exists. *iter->node set to NULL if the
+ *        next node is past @last.
+ *
+ * Call with rcu_read_lock held.
+ * Threads calling this API need to be registered RCU read-side threads.
+ * This function acts as a rcu_dereference() to read the node pointer.
+ */
+extern
+void cds_lfht_next_range(struct cds_lfht *ht, unsigned long last,
+		struct cds_lfht_iter *iter);
+
+/*
+ * cds_lfht_cursor_resume - get the first node not visited by a cursor.
+ * @ht: the hash table.
+ * @cursor: position saved by cds_lfht_cursor_save(), or initialized.
+ * @iter: Next node, if exists (output). *iter->node set to NULL if the
+ *        traversal is over.
+ *
+ * Long traversals can release the read-side lock, e.g. every few
+ * thousand nodes, so as not to delay grace periods:
+ *
+ *	cds_lfht_cursor_init(&cursor);
+ *	while (!cds_lfht_cursor_done(&cursor)) {
+ *		rcu_read_lock();
+ *		n = 0;
+ *		cds_lfht_for_each_resume(ht, &cursor, &iter, node) {
+ *			...
+ *			if (++n == 4096)
+ *				break;
+ *		}
+ *		cds_lfht_cursor_save(ht, &cursor, &iter);
+ *		rcu_read_unlock();
+ *	}
+ *
+ * The traversal continues in reverse hash order, which resizes do not
+ * change, after the last node visited. If that node was removed, or
+ * moved among the nodes of the same reverse hash, while the lock was
+ * released, it continues at the first node with the same reverse hash
+ * instead, so nodes present during the whole traversal are visited at
+ * least once. Nodes added or removed concurrently may or may not be
+ * visited.
+ * Call with rcu_read_lock held.
+ * Threads calling this API need to be registered RCU read-side threads.
+ * This function acts as a rcu_dereference() to read the node pointer.
+ */
+extern
+void cds_lfht_cursor_resume(struct cds_lfht *ht,
+		struct cds_lfht_cursor *cursor, struct cds_lfht_iter *iter);
+
+/*
+ * cds_lfht_cursor_save - record the position of a traversal.
+ * @ht: the hash table.
+ * @cursor: the cursor.
+ * @iter: current iterator: its node is the last visited, or NULL at the
+ *        end of the table.
+ *
+ * Call with rcu_read_lock held, before releasing it.
+ */
+extern
+void cds_lfht_cursor_save(struct cds_lfht *ht, struct cds_lfht_cursor *cursor,
+		struct cds_lfht_iter *iter);
+
+/*
+ * cds_lfht_for_each_parallel - traverse the table with several threads.
+ * @ht: the hash table.
+ * @nr_threads: maximum number of threads (rounded down to a power of 2).
+ *              0 means the number of CPUs.
+ * @fn: function called for each node, possibly concurrently from several
+ *      threads, within a read-side critical section.
+ * @arg: argument passed to @fn.
+ *
+ * The buckets of the table are split in partitions, as done for resize,
+ * each traversed by a thread registered to the table RCU flavor. Small
+ * tables are traversed by the caller. The read-side critical section is
+ * released between buckets, so @fn must not keep node pointers after it
+ * returns without other protection. Nodes added or removed concurrently
+ * may or may not be visited. Returns once all nodes have been visited.
+ *
+ * Call from a registered RCU read-side thread, without rcu_read_lock
+ * held.
+ */
+extern
+void cds_lfht_for_each_parallel(struct cds_lfht *ht, unsigned long nr_threads,
+		void (*fn)(struct cds_lfht *ht, struct cds_lfht_node *node,
+			void *arg),
+		void *arg);
+
+/*
+ * cds_lfht_range_split - split the reverse hash space in nr ranges.
+ * @nr: number of ranges (> 0).
+ * @i: index of the range, [0, nr).
+ * @first: first reverse hash of range @i (output).
+ * @last: last reverse hash of range @i (output).
+ *
+ * The nr ranges are disjoint and cover the whole table.
+ */
+static inline
+void cds_lfht_range_split(unsigned long nr, unsigned long i,
+		unsigned long *first, unsigned long *last)
+{
+	unsigned long step = ~0UL / nr + (~0UL % nr == nr - 1);
+
+	*first = i * step;
+	*last = (i == nr - 1) ? ~0UL : (i + 1) * step - 1;
+}
+
 /*
  * cds_lfht_add - add a node to the hash table.
  * @ht: the hash table.
@@ -353,6 +950,29 @@ extern
 void cds_lfht_add(struct cds_lfht *ht, unsigned long hash,
 		struct cds_lfht_node *node);
 
+/*
+ * cds_lfht_add_bulk - add an array of nodes to the hash table.
+ * @ht: the hash table.
+ * @nodes: array of nr nodes to add. Sorted in place by the call.
+ * @hashes: array of nr key hashes, hashes[i] being the hash of nodes[i].
+ * @nr: number of nodes.
+ *
+ * Same as calling cds_lfht_add() for each node, meant for loading large
+ * tables. A table created with CDS_LFHT_AUTO_RESIZE is grown once, up
+ * front, to the size required by the added nodes, instead of being
+ * resized several times while they are added. The nodes are then sorted
+ * in list order and linked one after the other into each bucket chain,
+ * and node accounting is updated once for the whole batch.
+ *
+ * Threads calling this API need to be registered RCU read-side threads.
+ * cds_lfht_add_bulk should *not* be called from a RCU read-side critical
+ * section: it takes the RCU read-side lock itself. This function issues
+ * a full memory barrier before and after each node atomic commit.
+ */
+extern
+void cds_lfht_add_bulk(struct cds_lfht *ht, struct cds_lfht_node **nodes,
+		const unsigned long *hashes, unsigned long nr);
+
 /*
  * cds_lfht_add_unique - add a node to hash table, if key is not present.
  * @ht: the hash table.
@@ -372,7 +992,9 @@ void cds_lfht_add(struct cds_lfht *ht, unsigned long hash,
  * The semantic of this function is that if only this function is used
  * to add keys into the table, no duplicated keys should ever be
  * observable in the table. The same guarantee apply for combination of
- * add_unique and add_replace (see below).
+ * add_unique and add_replace (see below). In tables created with
+ * CDS_LFHT_NODE_TAG, match is only called for nodes having the tag of
+ * @node, for both add_unique and add_replace.
  *
  * Upon success, this function issues a full memory barrier before and
  * after its atomic commit. Upon failure, this function acts like a
@@ -387,6 +1009,71 @@ struct cds_lfht_node *cds_lfht_add_unique(struct cds_lfht *ht,
 		const void *key,
 		struct cds_lfht_node *node);
 
+/*
+ * cds_lfht_add_offline - add a node to a table not yet published.
+ * @ht: the hash table, which no other thread may access.
+ * @hash: the key hash.
+ * @node: the node to add.
+ *
+ * Same as cds_lfht_add(), for building a table before publishing it
+ * with cds_lfht_publish(): the node is linked with plain stores, without
+ * RCU read-side lock, atomic operation nor memory barrier, and the
+ * table is never resized. Create the table with its final size as
+ * init_size. Can be called from any thread, registered or not, as long
+ * as no other thread uses @ht concurrently.
+ */
+extern
+void cds_lfht_add_offline(struct cds_lfht *ht, unsigned long hash,
+		struct cds_lfht_node *node);
+
+/*
+ * cds_lfht_add_unique_offline - add a node to a table not yet
+ * published, if key is not present.
+ *
+ * Same as cds_lfht_add_unique(), with the requirements of
+ * cds_lfht_add_offline(). If the key is present, the node already in
+ * the table is returned, and the node passed as parameter can be freed
+ * or re-used right away.
+ */
+extern
+struct cds_lfht_node *cds_lfht_add_unique_offline(struct cds_lfht *ht,
+		unsigned long hash,
+		cds_lfht_match_fct match,
+		const void *key,
+		struct cds_lfht_node *node);
+
+/*
+ * cds_lfht_lookup_or_add - get the node of a key, adding it if missing.
+ * @ht: the hash table.
+ * @hash: the key's hash.
+ * @match: the key match function.
+ * @key: the key.
+ * @ctor: called to allocate and initialize the node of key, only if key
+ *        is not present. Returns NULL on error.
+ * @dtor: called with a node returned by @ctor which could not be added,
+ *        because key was added concurrently. Can be NULL. The node was
+ *        never visible to other threads: it can be freed right away.
+ * @arg: argument passed to @ctor and @dtor.
+ *
+ * Same semantic as cds_lfht_add_unique(), with a single traversal of
+ * the bucket chain: @ctor is called at the position where the node is
+ * then linked. Return the node added, or the unique node already
+ * present, or NULL if @ctor fails.
+ * Call with rcu_read_lock held: @ctor and @dtor are called within the
+ * read-side critical section.
+ * Threads calling this API need to be registered RCU read-side threads.
+ * Not supported for tables created with CDS_LFHT_NODE_TAG, for which
+ * NULL is returned.
+ */
+extern
+struct cds_lfht_node *cds_lfht_lookup_or_add(struct cds_lfht *ht,
+		unsigned long hash,
+		cds_lfht_match_fct match,
+		const void *key,
+		struct cds_lfht_node *(*ctor)(void *arg),
+		void (*dtor)(struct cds_lfht_node *node, void *arg),
+		void *arg);
+
 /*
  * cds_lfht_add_replace - replace or add a node within hash table.
  * @ht: the hash table.
@@ -485,6 +1172,30 @@ int cds_lfht_replace(struct cds_lfht *ht,
 extern
 int cds_lfht_del(struct cds_lfht *ht, struct cds_lfht_node *node);
 
+/*
+ * cds_lfht_del_bulk - remove an array of nodes from the hash table.
+ * @ht: the hash table.
+ * @nodes: array of nr nodes to remove. Sorted in place by the call.
+ * @nr: number of nodes.
+ *
+ * Same as calling cds_lfht_del() for each node, but all nodes are
+ * logically removed in a single pass before being unlinked, with one
+ * garbage collection walk per bucket chain, and node accounting is
+ * updated once for the whole batch.
+ * Return the number of nodes removed by this call. On return, nodes
+ * holds the removed nodes, which should be reclaimed after a grace
+ * period, and NULL in place of NULL input entries and of nodes which
+ * had already been removed, or whose removal a concurrent cds_lfht_del
+ * won.
+ * Call with rcu_read_lock held.
+ * Threads calling this API need to be registered RCU read-side threads.
+ * This function issues a full memory barrier before and after its
+ * atomic commits.
+ */
+extern
+unsigned long cds_lfht_del_bulk(struct cds_lfht *ht,
+		struct cds_lfht_node **nodes, unsigned long nr);
+
 /*
  * cds_lfht_is_node_deleted - query whether a node is removed from hash table.
  *
@@ -501,6 +1212,65 @@ int cds_lfht_del(struct cds_lfht *ht, struct cds_lfht_node *node);
 extern
 int cds_lfht_is_node_deleted(struct cds_lfht_node *node);
 
+/*
+ * cds_lfht_get_resize_stats - get resize statistics of a table.
+ * @ht: the hash table.
+ * @stats: resize statistics (output), since the table creation.
+ *
+ * Does not wait for an ongoing resize to complete.
+ */
+extern
+void cds_lfht_get_resize_stats(struct cds_lfht *ht,
+		struct cds_lfht_resize_stats *stats);
+
+/*
+ * cds_lfht_get_mem_stats - get the memory used by a table.
+ * @ht: the hash table.
+ * @stats: memory used (output), including the bucket table memory kept
+ *         by cds_lfht_set_mm_retention().
+ *
+ * Does not wait for an ongoing resize to complete.
+ */
+extern
+void cds_lfht_get_mem_stats(struct cds_lfht *ht,
+		struct cds_lfht_mem_stats *stats);
+
+/*
+ * cds_lfht_set_resize_hook - set a function called on resize events.
+ * @ht: the hash table.
+ * @hook: called at the start and end of each resize pass. NULL to
+ *        remove the hook.
+ * @priv: passed to hook.
+ *
+ * The hook is called by the thread resizing the table, with the table
+ * resize mutex held: it must not resize the table, nor destroy it.
+ * Should *not* be called from a RCU read-side critical section.
+ */
+extern
+void cds_lfht_set_resize_hook(struct cds_lfht *ht,
+		void (*hook)(struct cds_lfht *ht,
+			enum cds_lfht_resize_event_type type,
+			const struct cds_lfht_resize_event *event, void *priv),
+		void *priv);
+
+/*
+ * cds_lfht_set_mm_retention - keep the bucket table memory freed by shrinks.
+ * @ht: the hash table.
+ * @max_len: bytes of bucket table above the table size which stay
+ *           populated after a shrink, so that a later grow reuses them
+ *           without page faults. 0 releases the memory at once (default).
+ * @max_ms: a shrink releases the memory retained by the previous one if
+ *          it happened at least max_ms before. 0 for no time limit.
+ *
+ * Applies to the cds_lfht_mm_mmap, cds_lfht_mm_mmap_compact and
+ * cds_lfht_mm_chunk plugins. The mmap plugins release retained memory
+ * with MADV_FREE, keeping it mapped, and pre-fault the memory of grows.
+ * Should *not* be called from a RCU read-side critical section.
+ */
+extern
+void cds_lfht_set_mm_retention(struct cds_lfht *ht, size_t max_len,
+		unsigned long max_ms);
+
 /*
  * cds_lfht_resize - Force a hash table resize
  * @ht: the hash table.
@@ -514,6 +1284,32 @@ int cds_lfht_is_node_deleted(struct cds_lfht_node *node);
 extern
 void cds_lfht_resize(struct cds_lfht *ht, unsigned long new_size);
 
+/*
+ * cds_lfht_for_each_table - invoke a function for each live table.
+ * @func: called with each table, and a snapshot of its size and count.
+ * @priv: passed to func.
+ *
+ * Tables are live from their creation until cds_lfht_destroy() returns
+ * successfully. func is called with the table list lock held: it must
+ * not create nor destroy tables.
+ * Does not need to be called with rcu_read_lock held.
+ */
+extern
+void cds_lfht_for_each_table(void (*func)(struct cds_lfht *ht,
+			const struct cds_lfht_info *info, void *priv),
+		void *priv);
+
+/*
+ * cds_lfht_introspect_dump - write the live tables to a file descriptor.
+ * @fd: file descriptor.
+ *
+ * Writes one line of text per table, with its size and count, without
+ * holding the table list lock. Returns 0 on success, or a negative
+ * error number.
+ */
+extern
+int cds_lfht_introspect_dump(int fd);
+
 /*
  * Note: it is safe to perform element removal (del), replacement, or
  * any hash table update operation during any of the following hash
@@ -527,6 +1323,20 @@ void cds_lfht_resize(struct cds_lfht *ht, unsigned long new_size);
 		cds_lfht_next(ht, iter),				\
 			node = cds_lfht_iter_get_node(iter))
 
+#define cds_lfht_for_each_range(ht, first, last, iter, node)		\
+	for (cds_lfht_first_range(ht, first, last, iter),		\
+			node = cds_lfht_iter_get_node(iter);		\
+		node != NULL;						\
+		cds_lfht_next_range(ht, last, iter),			\
+			node = cds_lfht_iter_get_node(iter))
+
+#define cds_lfht_for_each_resume(ht, cursor, iter, node)		\
+	for (cds_lfht_cursor_resume(ht, cursor, iter),			\
+			node = cds_lfht_iter_get_node(iter);		\
+		node != NULL;						\
+		cds_lfht_next(ht, iter),				\
+			node = cds_lfht_iter_get_node(iter))
+
 #define cds_lfht_for_each_duplicate(ht, hash, match, key, iter, node)	\
 	for (cds_lfht_lookup(ht, hash, match, key, iter),		\
 			node = cds_lfht_iter_get_node(iter);		\
@@ -543,6 +1353,30 @@ void cds_lfht_resize(struct cds_lfht *ht, unsigned long new_size);
 			pos = caa_container_of(cds_lfht_iter_get_node(iter), \
 					__typeof__(*(pos)), member))
 
+/*
+ * Same as cds_lfht_for_each_entry(), but prefetches the node following
+ * the current one, which cds_lfht_next() already read, while the loop
+ * body runs. This is the bucket node of the next bucket when the
+ * current node ends its bucket.
+ */
+#define cds_lfht_for_each_entry_prefetch(ht, iter, pos, member)		\
+	for (cds_lfht_first(ht, iter), caa_prefetch((iter)->next),	\
+			pos = caa_container_of(cds_lfht_iter_get_node(iter), \
+					__typeof__(*(pos)), member);	\
+		cds_lfht_iter_get_node(iter) != NULL;			\
+		cds_lfht_next(ht, iter), caa_prefetch((iter)->next),	\
+			pos = caa_container_of(cds_lfht_iter_get_node(iter), \
+					__typeof__(*(pos)), member))
+
+#define cds_lfht_for_each_entry_range(ht, first, last, iter, pos, member) \
+	for (cds_lfht_first_range(ht, first, last, iter),		\
+			pos = caa_container_of(cds_lfht_iter_get_node(iter), \
+					__typeof__(*(pos)), member);	\
+		cds_lfht_iter_get_node(iter) != NULL;			\
+		cds_lfht_next_range(ht, last, iter),			\
+			pos = caa_container_of(cds_lfht_iter_get_node(iter), \
+					__typeof__(*(pos)), member))
+
 #define cds_lfht_for_each_entry_duplicate(ht, hash, match, key,		\
 				iter, pos, member)			\
 	for (cds_lfht_lookup(ht, hash, match, key, iter),		\
@@ -557,4 +1391,16 @@ void cds_lfht_resize(struct cds_lfht *ht, unsigned long new_size);
 }
 #endif
 
+#ifdef _LGPL_SOURCE
+/*
+ * LGPL-compatible code looks up nodes with inline versions of the lookup
+ * functions, which depend on the layout of struct cds_lfht: it must be
+ * rebuilt along with the library.
+ */
+#include <urcu/static/rculfhash.h>
+
+#define cds_lfht_lookup			_cds_lfht_lookup
+#define cds_lfht_next_duplicate		_cds_lfht_next_duplicate
+#endif /* _LGPL_SOURCE */
+
 #endif /* _URCU_RCULFHASH_H */
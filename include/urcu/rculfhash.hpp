@@ -0,0 +1,242 @@
+#ifndef _URCU_RCULFHASH_HPP
+#define _URCU_RCULFHASH_HPP
+
+/*
+ * urcu/rculfhash.hpp
+ *
+ * Userspace RCU library - C++ typed wrapper of the Lock-Free RCU Hash Table
+ *
+ * TO BE INCLUDED ONLY IN LGPL-COMPATIBLE CODE: lookups are inlined from
+ * urcu/static/rculfhash.h.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ *
+ * For use with URCU_API_MAP (API mapping of liburcu), include this file
+ * _after_ including your URCU flavor.
+ */
+
+#include <functional>
+#include <new>
+#include <utility>
+#include <urcu/rcu.hpp>
+#include <urcu/rculfhash.h>
+#include <urcu/static/rculfhash.h>
+
+namespace urcu {
+
+/*
+ * Hash table mapping keys of type K to values of type V, stored in nodes
+ * allocated by the table. Hash and KeyEq are default-constructible
+ * function objects, and Flavor the traits of the RCU flavor of the table
+ * (see URCU_DEFINE_FLAVOR_TRAITS).
+ *
+ * find() walks the hash chain inline, comparing keys with KeyEq without
+ * any indirect call: it must be called within a read-side critical
+ * section of Flavor, e.g. held by a urcu::read_guard<Flavor>. Updates
+ * take a read-side critical section themselves, and free the nodes they
+ * remove after a grace period, with the call_rcu of Flavor.
+ *
+ * Caution: the threads using the table need to be registered RCU
+ * read-side threads of Flavor, as for cds_lfht.
+ */
+template<class K, class V, class Hash = std::hash<K>,
+	class KeyEq = std::equal_to<K>, class Flavor = default_flavor>
+class lfht {
+public:
+	explicit lfht(unsigned long init_size = 1,
+			unsigned long min_nr_alloc_buckets = 1,
+			unsigned long max_nr_buckets = 0,
+			int flags = CDS_LFHT_AUTO_RESIZE | CDS_LFHT_ACCOUNTING,
+			pthread_attr_t *attr = nullptr)
+	{
+		ht_ = cds_lfht_new_flavor(init_size, min_nr_alloc_buckets,
+				max_nr_buckets, flags, &Flavor::flavor(), attr);
+		if (!ht_)
+			throw std::bad_alloc();
+	}
+
+	/*
+	 * Must not be called concurrently with other operations on the
+	 * table, nor from within a read-side critical section.
+	 */
+	~lfht()
+	{
+		struct cds_lfht_iter iter;
+		struct cds_lfht_node *n;
+
+		{
+			read_guard<Flavor> guard;
+
+			cds_lfht_for_each(ht_, &iter, n) {
+				if (!cds_lfht_del(ht_, n))
+					Flavor::call(to_node(n), free_node);
+			}
+		}
+		(void) cds_lfht_destroy(ht_, nullptr);
+	}
+
+	lfht(const lfht &) = delete;
+	lfht &operator=(const lfht &) = delete;
+
+	/*
+	 * Return the value of key, or nullptr. The value may be accessed
+	 * until the end of the read-side critical section.
+	 */
+	V *find(const K &key) const
+	{
+		node *n = lookup(key, hash(key));
+
+		return n ? &n->value : nullptr;
+	}
+
+	/* Add key if it is not in the table. Return whether it was added. */
+	bool insert(const K &key, const V &value)
+	{
+		node *n = new node(key, value);
+		struct cds_lfht_node *ret;
+
+		{
+			read_guard<Flavor> guard;
+
+			ret = cds_lfht_add_unique(ht_, hash(key), match,
+					&n->key, n);
+		}
+		if (ret != n) {
+			/* Never published: no reader can see it. */
+			delete n;
+			return false;
+		}
+		return true;
+	}
+
+	/*
+	 * Add key, or replace the node of key. Return whether key was
+	 * added. Readers see either the previous or the new value.
+	 */
+	bool insert_or_assign(const K &key, const V &value)
+	{
+		node *n = new node(key, value);
+		struct cds_lfht_node *old;
+
+		{
+			read_guard<Flavor> guard;
+
+			old = cds_lfht_add_replace(ht_, hash(key), match,
+					&n->key, n);
+		}
+		if (old)
+			Flavor::call(to_node(old), free_node);
+		return !old;
+	}
+
+	/* Remove key. Return whether this call removed it. */
+	bool erase(const K &key)
+	{
+		node *n;
+
+		{
+			read_guard<Flavor> guard;
+
+			n = lookup(key, hash(key));
+			if (!n || cds_lfht_del(ht_, n))
+				return false;
+		}
+		Flavor::call(n, free_node);
+		return true;
+	}
+
+	/*
+	 * Call fn(key, value) for each node. Must be called within a
+	 * read-side critical section of Flavor.
+	 */
+	template<class Fn>
+	void for_each(Fn fn) const
+	{
+		struct cds_lfht_iter iter;
+		struct cds_lfht_node *n;
+
+		cds_lfht_for_each(ht_, &iter, n) {
+			node *entry = to_node(n);
+
+			fn(static_cast<const K &>(entry->key), entry->value);
+		}
+	}
+
+	/* The underlying table, e.g. for cds_lfht_resize(). */
+	struct cds_lfht *native_handle() const
+	{
+		return ht_;
+	}
+
+private:
+	/* Bases, rather than members, so conversions need no offsetof. */
+	struct node : cds_lfht_node, rcu_head {
+		node(const K &k, const V &v) : key(k), value(v)
+		{
+		}
+
+		K key;
+		V value;
+	};
+
+	static node *to_node(struct cds_lfht_node *n)
+	{
+		return static_cast<node *>(n);
+	}
+
+	static unsigned long hash(const K &key)
+	{
+		return Hash()(key);
+	}
+
+	/* Used by the library on update paths only. */
+	static int match(struct cds_lfht_node *n, const void *key)
+	{
+		return KeyEq()(to_node(n)->key, *static_cast<const K *>(key));
+	}
+
+	static void free_node(struct rcu_head *head)
+	{
+		delete static_cast<node *>(head);
+	}
+
+	/* Chain walk of cds_lfht_lookup(), with match inlined. */
+	node *lookup(const K &key, unsigned long hash) const
+	{
+		unsigned long reverse_hash = _cds_lfht_bit_reverse_ulong(hash);
+		struct cds_lfht_node *n, *next;
+
+		n = _cds_lfht_lookup_first(ht_, hash);
+		for (;;) {
+			if (caa_unlikely(_cds_lfht_is_end(n)))
+				return nullptr;
+			if (caa_unlikely(n->reverse_hash > reverse_hash))
+				return nullptr;
+			next = rcu_dereference(n->next);
+			if (caa_likely(!_cds_lfht_is_removed(next))
+			    && !_cds_lfht_is_bucket(next)
+			    && n->reverse_hash == reverse_hash
+			    && caa_likely(KeyEq()(to_node(n)->key, key)))
+				return to_node(n);
+			n = _cds_lfht_clear_flag(next);
+		}
+	}
+
+	struct cds_lfht *ht_;
+};
+
+} /* namespace urcu */
+
+#endif /* _URCU_RCULFHASH_HPP */
@@ -30,7 +30,10 @@ extern "C" {
 #endif
 
 struct cds_lfq_queue_rcu;
+struct cds_lfq_dummy_pool;
 struct rcu_head;
+struct rcu_flavor_struct;
+struct urcu_hazptr_rec;
 
 struct cds_lfq_node_rcu {
 	struct cds_lfq_node_rcu *next;
@@ -41,17 +44,26 @@ struct cds_lfq_queue_rcu {
 	struct cds_lfq_node_rcu *head, *tail;
 	void (*queue_call_rcu)(struct rcu_head *head,
 		void (*func)(struct rcu_head *head));
+	struct cds_lfq_dummy_pool *dummy_pool;	/* NULL if not recycled */
 };
 
+/* Default number of recycled dummy nodes of cds_lfq_init_rcu_flavor(). */
+#define CDS_LFQ_DEFAULT_DUMMY_POOL	64
+
 #ifdef _LGPL_SOURCE
 
 #include <urcu/static/rculfqueue.h>
 
 #define cds_lfq_node_init_rcu		_cds_lfq_node_init_rcu
 #define cds_lfq_init_rcu		_cds_lfq_init_rcu
+#define cds_lfq_init_rcu_flavor		_cds_lfq_init_rcu_flavor
 #define cds_lfq_destroy_rcu		_cds_lfq_destroy_rcu
 #define cds_lfq_enqueue_rcu		_cds_lfq_enqueue_rcu
 #define cds_lfq_dequeue_rcu		_cds_lfq_dequeue_rcu
+#define cds_lfq_dequeue_batch_rcu	_cds_lfq_dequeue_batch_rcu
+#define cds_lfq_init_hazptr		_cds_lfq_init_hazptr
+#define cds_lfq_enqueue_hazptr		_cds_lfq_enqueue_hazptr
+#define cds_lfq_dequeue_hazptr		_cds_lfq_dequeue_hazptr
 
 #else /* !_LGPL_SOURCE */
 
@@ -59,6 +71,20 @@ extern void cds_lfq_node_init_rcu(struct cds_lfq_node_rcu *node);
 extern void cds_lfq_init_rcu(struct cds_lfq_queue_rcu *q,
 			     void queue_call_rcu(struct rcu_head *head,
 					void (*func)(struct rcu_head *head)));
+/*
+ * Initialize a queue recycling its dummy nodes: the dummy nodes
+ * dequeued are kept in a pool of pool_size nodes (0 for
+ * CDS_LFQ_DEFAULT_DUMMY_POOL), and reused once a grace period of
+ * @flavor has elapsed, polled without call_rcu(). The pool is filled
+ * with fresh dummy nodes at initialization. A queue going
+ * through empty states thus only allocates and frees dummy nodes when
+ * the pool is exhausted, i.e. when it drains more than pool_size times
+ * per grace period. Return 0 on success, -ENOMEM on allocation failure.
+ */
+extern int cds_lfq_init_rcu_flavor(struct cds_lfq_queue_rcu *q,
+				   const struct rcu_flavor_struct *flavor,
+				   unsigned long pool_size);
+
 /*
  * The queue should be emptied before calling destroy.
  *
@@ -82,6 +108,45 @@ extern void cds_lfq_enqueue_rcu(struct cds_lfq_queue_rcu *q,
 extern
 struct cds_lfq_node_rcu *cds_lfq_dequeue_rcu(struct cds_lfq_queue_rcu *q);
 
+/*
+ * Should be called under rcu read lock critical section.
+ *
+ * Dequeue up to max consecutive nodes with a single move of the queue
+ * head, storing them in order into nodes[]. Returns their number, 0 if
+ * queue is empty. The caller must wait for a grace period to pass
+ * before freeing the returned nodes or modifying their cds_lfq_node_rcu
+ * structure.
+ */
+extern
+unsigned long cds_lfq_dequeue_batch_rcu(struct cds_lfq_queue_rcu *q,
+		struct cds_lfq_node_rcu **nodes, unsigned long max);
+
+/*
+ * Initialize a queue used with the hazard-pointer variants only.
+ * Destroy it with cds_lfq_destroy_rcu().
+ */
+extern void cds_lfq_init_hazptr(struct cds_lfq_queue_rcu *q);
+
+/*
+ * Enqueue with the tail protected by hazard slot 2 of @rec, cleared on
+ * return. No RCU read-side critical section is needed.
+ */
+extern void cds_lfq_enqueue_hazptr(struct cds_lfq_queue_rcu *q,
+				   struct cds_lfq_node_rcu *node,
+				   struct urcu_hazptr_rec *rec);
+
+/*
+ * Dequeue with hazard slots 0 and 2 of @rec, cleared on return.
+ *
+ * The caller must retire the returned node to the domain of @rec with
+ * urcu_hazptr_retire() before freeing it or modifying the
+ * cds_lfq_node_rcu structure.
+ * Returns NULL if queue is empty.
+ */
+extern
+struct cds_lfq_node_rcu *cds_lfq_dequeue_hazptr(struct cds_lfq_queue_rcu *q,
+		struct urcu_hazptr_rec *rec);
+
 #endif /* !_LGPL_SOURCE */
 
 #ifdef __cplusplus
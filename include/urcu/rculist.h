@@ -89,4 +89,25 @@ void cds_list_del_rcu(struct cds_list_head *elem)
 		&pos->member != (head); \
 		pos = cds_list_entry(rcu_dereference(pos->member.next), __typeof__(*pos), member))
 
+/* Prefetch the element following @pos, and return @pos. */
+static inline
+struct cds_list_head *_cds_list_prefetch_next_rcu(struct cds_list_head *pos)
+{
+	caa_prefetch(CMM_LOAD_SHARED(pos->next));
+	return pos;
+}
+
+/*
+ * Iterate through elements of the list, prefetching the next element
+ * while the current one is processed, which overlaps its cache miss
+ * with the loop body. Prefetching further ahead would need the next
+ * pointer of the element being prefetched, thus wait for its miss.
+ */
+#define cds_list_for_each_entry_rcu_prefetch(pos, head, member) \
+	for (pos = cds_list_entry(_cds_list_prefetch_next_rcu( \
+			rcu_dereference((head)->next)), __typeof__(*pos), member); \
+		&pos->member != (head); \
+		pos = cds_list_entry(_cds_list_prefetch_next_rcu( \
+			rcu_dereference(pos->member.next)), __typeof__(*pos), member))
+
 #endif	/* _URCU_RCULIST_H */
@@ -0,0 +1,280 @@
+#ifndef _URCU_RCULPM_H
+#define _URCU_RCULPM_H
+
+/*
+ * urcu/rculpm.h
+ *
+ * Userspace RCU library - RCU longest prefix match trie
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ *
+ * For use with URCU_API_MAP (API mapping of liburcu), include this file
+ * _after_ including your URCU flavor.
+ */
+
+#include <stdint.h>
+#include <pthread.h>
+#include <urcu/compiler.h>
+#include <urcu/pointer.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+struct rcu_flavor_struct;
+
+/*
+ * Longest prefix match trie, such as a routing table or an access
+ * control list keyed by address prefix, read within RCU read-side
+ * critical sections and updated by path copy.
+ *
+ * Each interior node indexes 6 bits of the key, in the layout of
+ * poptrie: a 64-bit bitmap of its children, which are stored
+ * contiguously, and a 64-bit bitmap of the runs of equal leaves over
+ * its 64 indexes, one leaf stored for each run. The leaf of an index is
+ * the longest prefix ending within the node and covering it. A lookup
+ * thus loads the node and its slots for each 6 bits of the key, finding
+ * the slots with a population count, without comparing keys.
+ *
+ * A version of the trie is never modified once published: updaters
+ * rebuild the interior nodes on the path from the root to the node
+ * where the prefix they add or remove ends, and publish a new root.
+ * The subtrees below, and beside, are shared between versions, so that
+ * an update costs one interior node per 6 bits of its prefix, whatever
+ * the number of more specific prefixes.
+ *
+ * Updates are batched: between cds_lpm_update_begin() and
+ * cds_lpm_update_commit(), interior nodes built by the batch are freed
+ * right away when a later modification of the batch replaces them. The
+ * new root is published once, and the interior nodes it replaces are
+ * freed, along with the removed nodes, with a single call_rcu().
+ * Updaters are serialized by a mutex of the trie.
+ */
+
+/* Longest prefix, e.g. of an IPv6 address. */
+#define CDS_LPM_MAX_KEY_BITS	128
+
+/*
+ * cds_lpm_node: prefix of a trie, embedded in the structure of the
+ * caller and found with caa_container_of().
+ *
+ * The key is in network byte order, with the most significant bit of
+ * the first byte first, as in struct in_addr and struct in6_addr. Set
+ * with cds_lpm_node_init(), and not changed while the node is in the
+ * trie. The other fields are private to the trie.
+ */
+struct cds_lpm_node {
+	uint8_t key[CDS_LPM_MAX_KEY_BITS / 8];
+	unsigned int len;		/* Prefix length, in bits. */
+	struct cds_lpm_node *next_removed;
+};
+
+/*
+ * Note that struct cds_lpm_inode, the interior node, is opaque to
+ * callers. The root identifies a version of the trie.
+ */
+struct cds_lpm_inode;
+
+/*
+ * cds_lpm_free_fct - free a node removed from the trie.
+ *
+ * Called after a grace period, from call_rcu() context.
+ */
+typedef void (*cds_lpm_free_fct)(struct cds_lpm_node *node);
+
+struct cds_lpm_retired;
+
+struct cds_lpm {
+	struct cds_lpm_inode *root;		/* RCU-protected. */
+	/* Update in progress. */
+	struct cds_lpm_inode *new_root;
+	struct cds_lpm_retired *retired;
+	unsigned long gen;
+	unsigned int key_bits;
+	cds_lpm_free_fct free_node;
+	const struct rcu_flavor_struct *flavor;
+	pthread_mutex_t lock;
+};
+
+/*
+ * cds_lpm_node_init - set the prefix of a node.
+ * @key: prefix, of at least @len bits. Bits beyond @len are ignored.
+ * @len: prefix length, in bits, at most the key length of the trie.
+ */
+extern
+void cds_lpm_node_init(struct cds_lpm_node *node, const void *key,
+		unsigned int len);
+
+/*
+ * cds_lpm_read - get the current version of a trie.
+ *
+ * Must be called within a read-side critical section, which the version
+ * must not be used outside of. All lookups within the version see the
+ * same snapshot of the trie, whatever the updates committed meanwhile.
+ */
+static inline
+const struct cds_lpm_inode *cds_lpm_read(struct cds_lpm *lpm)
+{
+	return rcu_dereference(lpm->root);
+}
+
+/*
+ * cds_lpm_lookup - find the longest prefix matching a key.
+ * @root: version of the trie.
+ * @key: the key, of the key length of the trie.
+ *
+ * Return the node of the longest prefix of @key in the version, or
+ * NULL if none matches. Walks at most one interior node per 6 bits of
+ * the key.
+ */
+extern
+struct cds_lpm_node *cds_lpm_lookup(const struct cds_lpm_inode *root,
+		const void *key);
+
+/*
+ * cds_lpm_lookup_exact - find a prefix.
+ *
+ * Return the node of prefix @key/@len in the version, or NULL if it is
+ * not in the version.
+ */
+extern
+struct cds_lpm_node *cds_lpm_lookup_exact(const struct cds_lpm_inode *root,
+		const void *key, unsigned int len);
+
+/* cds_lpm_count - number of prefixes of a version. */
+extern
+unsigned long cds_lpm_count(const struct cds_lpm_inode *root);
+
+/*
+ * cds_lpm_init_flavor - initialize an empty trie.
+ * @key_bits: key length, e.g. 32 for IPv4 and 128 for IPv6, at most
+ *            CDS_LPM_MAX_KEY_BITS.
+ * @free_node: called on the nodes removed or replaced by an update,
+ *             after a grace period, or NULL if the caller frees them.
+ * @flavor: RCU flavor of the readers.
+ *
+ * Return 0 on success, -EINVAL if @key_bits is invalid, -ENOMEM on
+ * allocation failure.
+ */
+extern
+int cds_lpm_init_flavor(struct cds_lpm *lpm, unsigned int key_bits,
+		cds_lpm_free_fct free_node,
+		const struct rcu_flavor_struct *flavor);
+
+/*
+ * cds_lpm_destroy - free the current version of a trie.
+ *
+ * Calls free_node on the nodes of the version, if set. Readers must not
+ * access the trie anymore, e.g. after a grace period following its
+ * unpublication, and the callbacks of the previous updates must have
+ * run, e.g. after rcu_barrier().
+ */
+extern
+void cds_lpm_destroy(struct cds_lpm *lpm);
+
+/*
+ * cds_lpm_update_begin - start a batch of modifications.
+ *
+ * Locks the trie. Return 0 on success, -ENOMEM on allocation failure,
+ * in which case the trie is not locked.
+ */
+extern
+int cds_lpm_update_begin(struct cds_lpm *lpm);
+
+/*
+ * cds_lpm_update_lookup_exact - find a prefix in the version being
+ * updated.
+ *
+ * Sees the modifications of the batch. Readers do not need to be
+ * excluded.
+ */
+extern
+struct cds_lpm_node *cds_lpm_update_lookup_exact(struct cds_lpm *lpm,
+		const void *key, unsigned int len);
+
+/*
+ * cds_lpm_update_add_unique - add a node whose prefix is not in the
+ * trie.
+ *
+ * Return 0 on success, -EEXIST if the prefix is already in the version
+ * being updated, -EINVAL if it is longer than the key length of the
+ * trie, -ENOMEM on allocation failure. On failure, the version is
+ * unchanged.
+ */
+extern
+int cds_lpm_update_add_unique(struct cds_lpm *lpm,
+		struct cds_lpm_node *node);
+
+/*
+ * cds_lpm_update_add_replace - add a node, replacing the node of the
+ * same prefix if any.
+ *
+ * The replaced node is freed as a removed node once the batch is
+ * committed. Return 0 on success, -EINVAL if the prefix is longer than
+ * the key length of the trie, -ENOMEM on allocation failure, in which
+ * case the version is unchanged.
+ */
+extern
+int cds_lpm_update_add_replace(struct cds_lpm *lpm,
+		struct cds_lpm_node *node);
+
+/*
+ * cds_lpm_update_del - remove the node of a prefix.
+ *
+ * The node is freed once the batch is committed, and must not be added
+ * again until then. Return 0 on success, -ENOENT if the prefix is not
+ * in the version being updated, -ENOMEM on allocation failure, in
+ * which case the version is unchanged.
+ */
+extern
+int cds_lpm_update_del(struct cds_lpm *lpm, const void *key,
+		unsigned int len);
+
+/*
+ * cds_lpm_update_commit - publish the version being updated, free the
+ * interior nodes it replaces and the removed nodes after a grace
+ * period, and unlock the trie.
+ */
+extern
+void cds_lpm_update_commit(struct cds_lpm *lpm);
+
+/*
+ * cds_lpm_update_abort - discard the modifications of the batch, and
+ * unlock the trie.
+ *
+ * The nodes added by the batch are not freed.
+ */
+extern
+void cds_lpm_update_abort(struct cds_lpm *lpm);
+
+#ifdef URCU_API_MAP
+/*
+ * cds_lpm_init - initialize an empty trie for the current flavor.
+ *
+ * Note: the RCU flavor must be already included before this header.
+ */
+static inline
+int cds_lpm_init(struct cds_lpm *lpm, unsigned int key_bits,
+		cds_lpm_free_fct free_node)
+{
+	return cds_lpm_init_flavor(lpm, key_bits, free_node, &rcu_flavor);
+}
+#endif /* URCU_API_MAP */
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* _URCU_RCULPM_H */
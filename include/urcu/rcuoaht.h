@@ -0,0 +1,154 @@
+#ifndef _URCU_RCUOAHT_H
+#define _URCU_RCUOAHT_H
+
+/*
+ * urcu/rcuoaht.h
+ *
+ * Userspace RCU library - Open-addressing RCU hash table
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ *
+ * For use with URCU_API_MAP (API mapping of liburcu), include this file
+ * _after_ including your URCU flavor.
+ */
+
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+struct rcu_flavor_struct;
+
+/*
+ * cds_oaht maps 64-bit keys to 64-bit values, stored in the table itself
+ * rather than in nodes: a lookup loads a group of slots and compares
+ * their one-byte key fingerprints at once (with SSE2 when available),
+ * then only compares the keys whose fingerprint matches. It suits
+ * read-mostly tables, for which cds_lfht would cost a node per item and
+ * a pointer chase per chain node.
+ *
+ * Lookups are wait-free, and never observe a partial update: updates
+ * replace a copy of the group they modify, and the whole table when it
+ * grows, freeing the replaced memory after a grace period. Updates are
+ * serialized by a mutex of the table. Groups which were never used are
+ * not allocated. Tables grow, but never shrink.
+ *
+ * Note that struct cds_oaht is opaque to callers.
+ */
+struct cds_oaht;
+
+/*
+ * cds_oaht_new_flavor - allocate an open-addressing hash table.
+ * @init_size: number of items the table holds before growing.
+ * @flavor: RCU flavor of the readers of the table.
+ *
+ * Return NULL on error.
+ */
+extern
+struct cds_oaht *cds_oaht_new_flavor(unsigned long init_size,
+		const struct rcu_flavor_struct *flavor);
+
+/*
+ * cds_oaht_destroy - destroy a hash table.
+ * @ht: the hash table.
+ *
+ * Waits for a grace period, and frees the table. Must not be called
+ * concurrently with other operations on the table, nor from within a
+ * read-side critical section.
+ */
+extern
+void cds_oaht_destroy(struct cds_oaht *ht);
+
+/*
+ * cds_oaht_lookup - lookup the value of a key.
+ * @ht: the hash table.
+ * @key: the key.
+ * @value: the value of key, on success.
+ *
+ * Return 0 on success, -ENOENT if key is not in the table.
+ * Call with rcu_read_lock held.
+ * Threads calling this API need to be registered RCU read-side threads.
+ */
+extern
+int cds_oaht_lookup(struct cds_oaht *ht, uint64_t key, uint64_t *value);
+
+/*
+ * cds_oaht_add - add a key if it is not in the table.
+ * @ht: the hash table.
+ * @key: the key.
+ * @value: the value of key.
+ *
+ * Return 0 on success, -EEXIST if key is already in the table, -ENOMEM
+ * on allocation failure.
+ * Threads calling this API need to be registered RCU read-side threads.
+ */
+extern
+int cds_oaht_add(struct cds_oaht *ht, uint64_t key, uint64_t value);
+
+/*
+ * cds_oaht_add_replace - add a key, or replace its value.
+ * @ht: the hash table.
+ * @key: the key.
+ * @value: the value of key.
+ *
+ * Concurrent lookups see either the previous or the new value.
+ * Return 0 if key was added, 1 if its value was replaced, -ENOMEM on
+ * allocation failure.
+ * Threads calling this API need to be registered RCU read-side threads.
+ */
+extern
+int cds_oaht_add_replace(struct cds_oaht *ht, uint64_t key, uint64_t value);
+
+/*
+ * cds_oaht_del - remove a key.
+ * @ht: the hash table.
+ * @key: the key.
+ *
+ * Return 0 on success, -ENOENT if key is not in the table, -ENOMEM on
+ * allocation failure.
+ * Threads calling this API need to be registered RCU read-side threads.
+ */
+extern
+int cds_oaht_del(struct cds_oaht *ht, uint64_t key);
+
+/*
+ * cds_oaht_count - number of keys in the table.
+ * @ht: the hash table.
+ *
+ * The count may be outdated by concurrent updates.
+ */
+extern
+unsigned long cds_oaht_count(struct cds_oaht *ht);
+
+#ifdef URCU_API_MAP
+/*
+ * cds_oaht_new - allocate a hash table for the current flavor.
+ *
+ * Note: the RCU flavor must be already included before the hash table
+ * header.
+ */
+static inline
+struct cds_oaht *cds_oaht_new(unsigned long init_size)
+{
+	return cds_oaht_new_flavor(init_size, &rcu_flavor);
+}
+#endif /* URCU_API_MAP */
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* _URCU_RCUOAHT_H */
@@ -0,0 +1,120 @@
+#ifndef _URCU_RCUPOOL_H
+#define _URCU_RCUPOOL_H
+
+/*
+ * urcu/rcupool.h
+ *
+ * Userspace RCU library - Object pool with grace-period deferred reuse
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ *
+ * For use with URCU_API_MAP (API mapping of liburcu), include this file
+ * _after_ including your URCU flavor.
+ */
+
+#include <stddef.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+struct rcu_flavor_struct;
+
+/*
+ * A pool hands out fixed-size objects carved from large pages. An
+ * object freed with cds_rcu_pool_free() is only handed out again once a
+ * grace period has elapsed since it was freed, so it can replace
+ * call_rcu() followed by free() for objects removed from RCU data
+ * structures, e.g. cds_lfht nodes or cds_lfq_node_rcu, without any
+ * per-object call_rcu or malloc.
+ *
+ * Objects move in magazines of a few tens of objects between per-CPU
+ * caches and depots shared by all CPUs, whose lock-free stacks are only
+ * touched once per magazine. Grace periods are tracked per magazine of
+ * freed objects, which are reused in priority by the CPU which freed
+ * them, while they are still cache-hot. Pages are type-stable: they are
+ * only returned to the system when the pool is destroyed, after a grace
+ * period.
+ *
+ * Note that struct cds_rcu_pool is opaque to callers.
+ */
+struct cds_rcu_pool;
+
+/*
+ * cds_rcu_pool_create_flavor - create an object pool.
+ * @obj_size: size of the objects, in bytes.
+ * @obj_align: alignment of the objects, power of 2, or 0 for the
+ *             alignment of malloc().
+ * @flavor: RCU flavor whose grace periods delay the reuse of objects.
+ *
+ * Return NULL on error.
+ */
+extern
+struct cds_rcu_pool *cds_rcu_pool_create_flavor(size_t obj_size,
+		size_t obj_align, const struct rcu_flavor_struct *flavor);
+
+/*
+ * cds_rcu_pool_destroy - destroy an object pool.
+ * @pool: the pool, with no object in use.
+ *
+ * Waits for a grace period, and frees all pages of the pool. Must not be
+ * called concurrently with other operations on the pool, nor from within
+ * a read-side critical section.
+ */
+extern
+void cds_rcu_pool_destroy(struct cds_rcu_pool *pool);
+
+/*
+ * cds_rcu_pool_alloc - allocate an object.
+ * @pool: the pool.
+ *
+ * Return NULL on error. The object content is undefined.
+ * Threads calling this API need to be registered RCU read-side threads.
+ */
+extern
+void *cds_rcu_pool_alloc(struct cds_rcu_pool *pool);
+
+/*
+ * cds_rcu_pool_free - free an object after a grace period.
+ * @pool: the pool the object was allocated from.
+ * @obj: the object, which RCU readers may still be accessing.
+ *
+ * The object content is left untouched, and the object is only reused
+ * after readers that may have a reference to it are done: this can be
+ * called from within a read-side critical section, e.g. right after
+ * removing the object from a data structure.
+ * Threads calling this API need to be registered RCU read-side threads.
+ */
+extern
+void cds_rcu_pool_free(struct cds_rcu_pool *pool, void *obj);
+
+#ifdef URCU_API_MAP
+/*
+ * cds_rcu_pool_create - create an object pool for the current flavor.
+ *
+ * Note: the RCU flavor must be already included before the pool header.
+ */
+static inline
+struct cds_rcu_pool *cds_rcu_pool_create(size_t obj_size, size_t obj_align)
+{
+	return cds_rcu_pool_create_flavor(obj_size, obj_align, &rcu_flavor);
+}
+#endif /* URCU_API_MAP */
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* _URCU_RCUPOOL_H */
@@ -0,0 +1,170 @@
+#ifndef _URCU_RCUREPLICA_H
+#define _URCU_RCUREPLICA_H
+
+/*
+ * urcu/rcureplica.h
+ *
+ * Userspace RCU library - RCU NUMA node replicas
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ *
+ * For use with URCU_API_MAP (API mapping of liburcu), include this file
+ * _after_ including your URCU flavor.
+ */
+
+#include <pthread.h>
+#include <urcu/compiler.h>
+#include <urcu/call-rcu.h>
+#include <urcu/pointer.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+struct rcu_flavor_struct;
+
+/*
+ * Read-mostly object replicated on each NUMA node: an update builds one
+ * replica per node with a copy callback, which allocates it from the
+ * memory of that node, and publishes all the replicas at once. Readers
+ * dereference the replica of the node of their CPU, so that the cache
+ * lines they read come from local memory. The replicas of the previous
+ * version are freed with a single call_rcu().
+ *
+ * The CPU is read from the rseq area of the thread when available, and
+ * its node from a map built from sysfs on first use. Without NUMA
+ * topology, there is a single node, 0. Concurrent updates build their
+ * replicas in parallel, and publish them one at a time.
+ */
+
+/*
+ * cds_rcu_replica_copy_fct - build the replica of an object for a node.
+ *
+ * Return the replica, or NULL on allocation failure.
+ */
+typedef void *(*cds_rcu_replica_copy_fct)(const void *obj, int node,
+		void *priv);
+
+/*
+ * cds_rcu_replica_free_fct - free the replica of a node.
+ *
+ * Called after a grace period, from call_rcu() context.
+ */
+typedef void (*cds_rcu_replica_free_fct)(void *replica, int node,
+		void *priv);
+
+struct cds_rcu_replica_set {
+	struct rcu_head head;
+	cds_rcu_replica_free_fct free_replica;
+	void *priv;
+	int nr_nodes;
+	void *replica[];
+};
+
+struct cds_rcu_replica {
+	struct cds_rcu_replica_set *set;	/* RCU-protected. */
+	cds_rcu_replica_copy_fct copy;
+	cds_rcu_replica_free_fct free_replica;
+	void *priv;
+	const struct rcu_flavor_struct *flavor;
+	pthread_mutex_t lock;
+};
+
+/*
+ * cds_rcu_replica_current_node - NUMA node of the CPU of the caller.
+ *
+ * Return a node lower than cds_rcu_replica_nr_nodes(), 0 if unknown.
+ */
+extern
+int cds_rcu_replica_current_node(void);
+
+/* cds_rcu_replica_nr_nodes - number of NUMA nodes replicated to. */
+extern
+int cds_rcu_replica_nr_nodes(void);
+
+/*
+ * rcu_dereference_replica - replica of the current node.
+ *
+ * Return NULL before the first update. Must be called within a
+ * read-side critical section, which the replica must not be used
+ * outside of.
+ */
+static inline
+void *rcu_dereference_replica(struct cds_rcu_replica *replica)
+{
+	struct cds_rcu_replica_set *set = rcu_dereference(replica->set);
+
+	if (caa_unlikely(!set))
+		return NULL;
+	return set->replica[cds_rcu_replica_current_node()];
+}
+
+/*
+ * cds_rcu_replica_init_flavor - initialize a replicated object without
+ * replicas.
+ * @copy: builds the replica of a node.
+ * @free_replica: frees the replica of a node.
+ * @priv: private data of the callbacks.
+ * @flavor: RCU flavor of the readers.
+ */
+extern
+void cds_rcu_replica_init_flavor(struct cds_rcu_replica *replica,
+		cds_rcu_replica_copy_fct copy,
+		cds_rcu_replica_free_fct free_replica, void *priv,
+		const struct rcu_flavor_struct *flavor);
+
+/*
+ * cds_rcu_replica_destroy - free the current replicas.
+ *
+ * Readers must not access the object anymore, e.g. after a grace period
+ * following its unpublication.
+ */
+extern
+void cds_rcu_replica_destroy(struct cds_rcu_replica *replica);
+
+/*
+ * cds_rcu_replica_update - publish the replicas of a new version.
+ * @obj: the new version, copied to each node, and still owned by the
+ *       caller on return.
+ *
+ * The replicas of the previous version are freed after a grace period.
+ * Return 0 on success, -ENOMEM if a copy failed, in which case the
+ * previous version stays published.
+ */
+extern
+int cds_rcu_replica_update(struct cds_rcu_replica *replica, const void *obj);
+
+#ifdef URCU_API_MAP
+/*
+ * cds_rcu_replica_init - initialize a replicated object for the current
+ * flavor.
+ *
+ * Note: the RCU flavor must be already included before this header.
+ */
+static inline
+void cds_rcu_replica_init(struct cds_rcu_replica *replica,
+		cds_rcu_replica_copy_fct copy,
+		cds_rcu_replica_free_fct free_replica, void *priv)
+{
+	cds_rcu_replica_init_flavor(replica, copy, free_replica, priv,
+		&rcu_flavor);
+}
+#endif /* URCU_API_MAP */
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* _URCU_RCUREPLICA_H */
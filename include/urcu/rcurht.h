@@ -0,0 +1,358 @@
+#ifndef _URCU_RCURHT_H
+#define _URCU_RCURHT_H
+
+/*
+ * urcu/rcurht.h
+ *
+ * Userspace RCU library - Relativistic hash table with per-bucket locks
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ *
+ * For use with URCU_API_MAP (API mapping of liburcu), include this file
+ * _after_ including your URCU flavor.
+ */
+
+#include <stddef.h>
+#include <urcu/compiler.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+struct rcu_flavor_struct;
+
+/*
+ * cds_rht is a chained hash table with the API of cds_lfht, for
+ * update-heavy workloads: updates lock one of CDS_RHT_NR_LOCKS stripes
+ * of buckets, chosen by the low bits of the hash, so that updates of
+ * different stripes run in parallel, and never retry. Lookups and
+ * iterations are lock-free, as in cds_lfht.
+ *
+ * Resizes follow the relativistic hash tables of Triplett, McKenney and
+ * Walpole: growing publishes a table of up to 16 times as many buckets,
+ * each pointing to the first node of its hash within the chain of the
+ * old bucket, so that the chains of the new buckets are first zipped
+ * together, then unzipped one link per chain and per grace period.
+ * Shrinking appends the chains of the buckets merged, then publishes
+ * the smaller table. Lookups thus never miss a node. Resizes lock all
+ * the stripes while they publish a table, and only one stripe at a time
+ * when they unzip. Unzipping waits for about as many grace periods as
+ * there were nodes per bucket: tables filled much faster than grace
+ * periods complete are better created with a large enough @init_size.
+ *
+ * Note that struct cds_rht is opaque to callers.
+ */
+struct cds_rht;
+struct cds_rht_table;
+
+/* Stripes of bucket locks, the minimum number of buckets. */
+#define CDS_RHT_NR_LOCKS	64
+
+/*
+ * cds_rht_node: node of a table, embedded in the structure of a key.
+ *
+ * Node content is private to the table.
+ */
+struct cds_rht_node {
+	struct cds_rht_node *next;
+	unsigned long hash;
+};
+
+/*
+ * cds_rht_iter: iterator over the nodes of a table.
+ *
+ * Iterator content is private to the table.
+ */
+struct cds_rht_iter {
+	struct cds_rht_node *node, *next;
+	struct cds_rht_table *table;
+	unsigned long bucket;
+};
+
+static inline
+struct cds_rht_node *cds_rht_iter_get_node(struct cds_rht_iter *iter)
+{
+	return iter->node;
+}
+
+/*
+ * cds_rht_match_fct - compare the key of a node with a key.
+ *
+ * Return non-zero if the key of @node is @key.
+ */
+typedef int (*cds_rht_match_fct)(struct cds_rht_node *node, const void *key);
+
+enum {
+	CDS_RHT_AUTO_RESIZE = (1U << 0),
+};
+
+/*
+ * cds_rht_node_init - initialize a hash table node.
+ * @node: the node to initialize.
+ *
+ * This function is kept to be eventually used for debugging purposes
+ * (detection of memory corruption).
+ */
+static inline
+void cds_rht_node_init(struct cds_rht_node *node __attribute__((unused)))
+{
+}
+
+/*
+ * cds_rht_new_flavor - allocate a hash table.
+ * @init_size: number of buckets to allocate initially.
+ * @min_nr_buckets: minimum number of buckets.
+ * @max_nr_buckets: maximum number of buckets, 0 for no limit.
+ * @flags: hash table creation flags (can be combined with bitwise or: '|').
+ *           0: no flags.
+ *           CDS_RHT_AUTO_RESIZE: automatically resize hash table.
+ * @flavor: RCU flavor of the readers of the table.
+ *
+ * Numbers of buckets are powers of two, of at least CDS_RHT_NR_LOCKS.
+ * Automatic resizes run on a worker thread of the table, registered
+ * with @flavor. Return NULL on error.
+ */
+extern
+struct cds_rht *cds_rht_new_flavor(unsigned long init_size,
+		unsigned long min_nr_buckets, unsigned long max_nr_buckets,
+		int flags, const struct rcu_flavor_struct *flavor);
+
+/*
+ * cds_rht_destroy - destroy a hash table.
+ * @ht: the hash table to destroy.
+ *
+ * Return 0 on success, negative error value on error. The table must
+ * be empty, otherwise -EPERM is returned. Must not be called
+ * concurrently with other operations on the table, nor from within a
+ * read-side critical section or a call_rcu() callback.
+ */
+extern
+int cds_rht_destroy(struct cds_rht *ht);
+
+/*
+ * cds_rht_count_nodes - count the number of nodes in the hash table.
+ * @ht: the hash table.
+ * @approx_before: node count approximation, before counting.
+ * @count: output node count, exact at the moment it is traversed.
+ * @approx_after: node count approximation, after counting.
+ *
+ * Call with rcu_read_lock held.
+ */
+extern
+void cds_rht_count_nodes(struct cds_rht *ht, long *approx_before,
+		unsigned long *count, long *approx_after);
+
+/*
+ * cds_rht_lookup - lookup a node by key.
+ * @ht: the hash table.
+ * @hash: the key hash.
+ * @match: the key match function.
+ * @key: the current node key.
+ * @iter: node, if found (output). *iter->node set to NULL if not found.
+ *
+ * Call with rcu_read_lock held.
+ */
+extern
+void cds_rht_lookup(struct cds_rht *ht, unsigned long hash,
+		cds_rht_match_fct match, const void *key,
+		struct cds_rht_iter *iter);
+
+/*
+ * cds_rht_next_duplicate - get the next item with same key, after iterator.
+ * @ht: the hash table.
+ * @match: the key match function.
+ * @key: the current node key.
+ * @iter: input: current iterator.
+ *        output: node, if found. *iter->node set to NULL if not found.
+ *
+ * Call with rcu_read_lock held.
+ */
+extern
+void cds_rht_next_duplicate(struct cds_rht *ht, cds_rht_match_fct match,
+		const void *key, struct cds_rht_iter *iter);
+
+/*
+ * cds_rht_first - get the first node in the table.
+ * @ht: the hash table.
+ * @iter: First node, if exists (output). *iter->node set to NULL if not found.
+ *
+ * Call with rcu_read_lock held.
+ */
+extern
+void cds_rht_first(struct cds_rht *ht, struct cds_rht_iter *iter);
+
+/*
+ * cds_rht_next - get the next node in the table.
+ * @ht: the hash table.
+ * @iter: input: current iterator.
+ *        output: next node, if exists. *iter->node set to NULL if not found.
+ *
+ * Each node present during the whole traversal is returned once.
+ * Call with rcu_read_lock held.
+ */
+extern
+void cds_rht_next(struct cds_rht *ht, struct cds_rht_iter *iter);
+
+/*
+ * cds_rht_add - add a node to the hash table.
+ * @ht: the hash table.
+ * @hash: the key hash.
+ * @node: the node to add.
+ *
+ * This function supports adding redundant keys into the table.
+ * Call with rcu_read_lock held.
+ * Threads calling this API need to be registered RCU read-side threads.
+ */
+extern
+void cds_rht_add(struct cds_rht *ht, unsigned long hash,
+		struct cds_rht_node *node);
+
+/*
+ * cds_rht_add_unique - add a node to hash table, if key is not present.
+ * @ht: the hash table.
+ * @hash: the node's hash.
+ * @match: the key match function.
+ * @key: the node's key.
+ * @node: the node to try adding.
+ *
+ * Return the node added upon success, or the node of the same key
+ * found in the table otherwise.
+ * Call with rcu_read_lock held.
+ * Threads calling this API need to be registered RCU read-side threads.
+ */
+extern
+struct cds_rht_node *cds_rht_add_unique(struct cds_rht *ht,
+		unsigned long hash, cds_rht_match_fct match,
+		const void *key, struct cds_rht_node *node);
+
+/*
+ * cds_rht_add_replace - replace or add a node within hash table.
+ * @ht: the hash table.
+ * @hash: the node's hash.
+ * @match: the key match function.
+ * @key: the node's key.
+ * @node: the node to add.
+ *
+ * Return the node replaced upon success, or NULL if no node matching
+ * the key was present, in which case @node is added. Concurrent lookups
+ * see either the replaced or the new node. The replaced node may be
+ * freed after a grace period.
+ * Call with rcu_read_lock held.
+ * Threads calling this API need to be registered RCU read-side threads.
+ */
+extern
+struct cds_rht_node *cds_rht_add_replace(struct cds_rht *ht,
+		unsigned long hash, cds_rht_match_fct match,
+		const void *key, struct cds_rht_node *node);
+
+/*
+ * cds_rht_del - remove node from the hash table.
+ * @ht: the hash table.
+ * @node: the node to delete.
+ *
+ * Return 0 if the node is successfully removed, -ENOENT if the node is
+ * NULL or not in the table. The node may be freed after a grace period.
+ * Call with rcu_read_lock held.
+ * Threads calling this API need to be registered RCU read-side threads.
+ */
+extern
+int cds_rht_del(struct cds_rht *ht, struct cds_rht_node *node);
+
+/*
+ * cds_rht_resize - Force a hash table resize.
+ * @ht: the hash table.
+ * @new_size: update to this hash table size, rounded to a power of two.
+ *
+ * Threads calling this API need to be registered RCU read-side threads.
+ * This function does not (necessarily) return immediately, waiting for
+ * grace periods. Must not be called from within a read-side critical
+ * section or a call_rcu() callback.
+ */
+extern
+void cds_rht_resize(struct cds_rht *ht, unsigned long new_size);
+
+/*
+ * cds_rht_for_each - iterate over all nodes in the hash table.
+ * @ht: the hash table.
+ * @iter: the iterator.
+ * @node: the current node.
+ *
+ * Call with rcu_read_lock held.
+ */
+#define cds_rht_for_each(ht, iter, node)				\
+	for (cds_rht_first(ht, iter),					\
+			node = cds_rht_iter_get_node(iter);		\
+		node != NULL;						\
+		cds_rht_next(ht, iter),					\
+			node = cds_rht_iter_get_node(iter))
+
+/*
+ * cds_rht_for_each_duplicate - iterate over all nodes of a key.
+ * @ht: the hash table.
+ * @hash: the key hash.
+ * @match: the key match function.
+ * @key: the key.
+ * @iter: the iterator.
+ * @node: the current node.
+ *
+ * Call with rcu_read_lock held.
+ */
+#define cds_rht_for_each_duplicate(ht, hash, match, key, iter, node)	\
+	for (cds_rht_lookup(ht, hash, match, key, iter),		\
+			node = cds_rht_iter_get_node(iter);		\
+		node != NULL;						\
+		cds_rht_next_duplicate(ht, match, key, iter),		\
+			node = cds_rht_iter_get_node(iter))
+
+/*
+ * cds_rht_for_each_entry - iterate over all entries in the hash table.
+ * @ht: the hash table.
+ * @iter: the iterator.
+ * @pos: the type * to use as a loop cursor.
+ * @member: the name of the cds_rht_node within the struct.
+ *
+ * Call with rcu_read_lock held.
+ */
+#define cds_rht_for_each_entry(ht, iter, pos, member)			\
+	for (cds_rht_first(ht, iter),					\
+			pos = caa_container_of(cds_rht_iter_get_node(iter), \
+					__typeof__(*(pos)), member);	\
+		cds_rht_iter_get_node(iter) != NULL;			\
+		cds_rht_next(ht, iter),					\
+			pos = caa_container_of(cds_rht_iter_get_node(iter), \
+					__typeof__(*(pos)), member))
+
+#ifdef URCU_API_MAP
+/*
+ * cds_rht_new - allocate a hash table for the current flavor.
+ *
+ * Note: the RCU flavor must be already included before the hash table
+ * header.
+ */
+static inline
+struct cds_rht *cds_rht_new(unsigned long init_size,
+		unsigned long min_nr_buckets, unsigned long max_nr_buckets,
+		int flags)
+{
+	return cds_rht_new_flavor(init_size, min_nr_buckets, max_nr_buckets,
+		flags, &rcu_flavor);
+}
+#endif /* URCU_API_MAP */
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* _URCU_RCURHT_H */
@@ -0,0 +1,261 @@
+#ifndef _URCU_RCUSKIPLIST_H
+#define _URCU_RCUSKIPLIST_H
+
+/*
+ * urcu/rcuskiplist.h
+ *
+ * Userspace RCU library - RCU ordered map (skiplist)
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ *
+ * For use with URCU_API_MAP (API mapping of liburcu), include this file
+ * _after_ including your URCU flavor.
+ */
+
+#include <pthread.h>
+#include <urcu/compiler.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*
+ * Each level holds about a quarter of the nodes of the level below, so
+ * lookups stay logarithmic up to about 4^CDS_SKIPLIST_MAX_LEVEL nodes.
+ */
+#define CDS_SKIPLIST_MAX_LEVEL	16
+
+/*
+ * cds_skiplist_node: node of a skiplist, embedded in the structure of
+ * the caller and found with caa_container_of().
+ *
+ * The skiplist is a lazy skiplist: writers lock the nodes preceding the
+ * node they add or remove, at each of its levels, and only then check
+ * that those nodes are still linked to each other. A node is removed
+ * logically by marking it, then unlinked from the top level down.
+ * Readers never take locks: they skip marked nodes, and nodes which are
+ * not yet linked at all their levels.
+ *
+ * Node content is private to the skiplist.
+ */
+struct cds_skiplist_node {
+	struct cds_skiplist_node *next[CDS_SKIPLIST_MAX_LEVEL];
+	unsigned int level;		/* Number of levels linked. */
+	int marked;			/* Removed. */
+	int fully_linked;		/* Linked at all levels. */
+	pthread_mutex_t lock;
+};
+
+struct rcu_flavor_struct;
+
+/*
+ * cds_skiplist_cmp_fct - compare the key of a node with a key.
+ *
+ * Return a negative value, 0, or a positive value if the key of node is
+ * respectively lower than, equal to, or greater than key.
+ */
+typedef int (*cds_skiplist_cmp_fct)(struct cds_skiplist_node *node,
+		const void *key);
+
+/*
+ * Note that struct cds_skiplist is opaque to callers.
+ */
+struct cds_skiplist;
+
+/*
+ * cds_skiplist_new_flavor - allocate an ordered map.
+ * @cmp: key comparison function.
+ * @flavor: RCU flavor of the readers of the skiplist.
+ *
+ * Keys are unique. Return NULL on error.
+ */
+extern
+struct cds_skiplist *cds_skiplist_new_flavor(cds_skiplist_cmp_fct cmp,
+		const struct rcu_flavor_struct *flavor);
+
+#ifdef URCU_API_MAP
+/*
+ * cds_skiplist_new - allocate an ordered map for the current flavor.
+ *
+ * Note: the RCU flavor must be already included before the skiplist
+ * header.
+ */
+static inline
+struct cds_skiplist *cds_skiplist_new(cds_skiplist_cmp_fct cmp)
+{
+	return cds_skiplist_new_flavor(cmp, &rcu_flavor);
+}
+#endif /* URCU_API_MAP */
+
+/*
+ * cds_skiplist_destroy - destroy an ordered map.
+ * @sl: the skiplist, which must be empty.
+ *
+ * Waits for a grace period before freeing the skiplist. Return 0 on
+ * success, -EPERM if the skiplist is not empty. Must not be called
+ * concurrently with other operations on the skiplist, nor from within
+ * a read-side critical section.
+ */
+extern
+int cds_skiplist_destroy(struct cds_skiplist *sl);
+
+/*
+ * cds_skiplist_lookup - lookup a key.
+ * @sl: the skiplist.
+ * @key: the key.
+ *
+ * Return the node of key, or NULL if key is not in the skiplist.
+ * Call with rcu_read_lock held.
+ * Threads calling this API need to be registered RCU read-side threads.
+ */
+extern
+struct cds_skiplist_node *cds_skiplist_lookup(struct cds_skiplist *sl,
+		const void *key);
+
+/*
+ * cds_skiplist_lower_bound - lookup the first key not lower than a key.
+ * @sl: the skiplist.
+ * @key: the key.
+ *
+ * Return the node of the lowest key greater than or equal to key, or
+ * NULL if there is none.
+ * Call with rcu_read_lock held.
+ * Threads calling this API need to be registered RCU read-side threads.
+ */
+extern
+struct cds_skiplist_node *cds_skiplist_lower_bound(struct cds_skiplist *sl,
+		const void *key);
+
+/*
+ * cds_skiplist_first - get the node of the lowest key.
+ * @sl: the skiplist.
+ *
+ * Return NULL if the skiplist is empty.
+ * Call with rcu_read_lock held.
+ * Threads calling this API need to be registered RCU read-side threads.
+ */
+extern
+struct cds_skiplist_node *cds_skiplist_first(struct cds_skiplist *sl);
+
+/*
+ * cds_skiplist_next - get the node of the next key.
+ * @sl: the skiplist.
+ * @node: a node of the skiplist, which may have been removed since it
+ *        was returned within the current read-side critical section.
+ *
+ * Return NULL if node has the greatest key. Keys which are added or
+ * removed concurrently may or may not be seen, but keys are always
+ * seen in increasing order.
+ * Call with rcu_read_lock held.
+ * Threads calling this API need to be registered RCU read-side threads.
+ */
+extern
+struct cds_skiplist_node *cds_skiplist_next(struct cds_skiplist *sl,
+		struct cds_skiplist_node *node);
+
+/*
+ * cds_skiplist_add_unique - add a node if its key is not in the skiplist.
+ * @sl: the skiplist.
+ * @key: the key of node.
+ * @node: the node to add.
+ *
+ * Return node if it was added, otherwise the node already holding key.
+ * Call with rcu_read_lock held.
+ * Threads calling this API need to be registered RCU read-side threads.
+ */
+extern
+struct cds_skiplist_node *cds_skiplist_add_unique(struct cds_skiplist *sl,
+		const void *key, struct cds_skiplist_node *node);
+
+/*
+ * cds_skiplist_del - remove a key.
+ * @sl: the skiplist.
+ * @key: the key.
+ *
+ * Return the removed node, or NULL if key is not in the skiplist. Only
+ * one of concurrent removals of a key returns its node. The node must
+ * only be freed after a grace period, e.g. with call_rcu().
+ * Call with rcu_read_lock held.
+ * Threads calling this API need to be registered RCU read-side threads.
+ */
+extern
+struct cds_skiplist_node *cds_skiplist_del(struct cds_skiplist *sl,
+		const void *key);
+
+/*
+ * cds_skiplist_for_each - iterate over the nodes of a skiplist.
+ * @sl: the skiplist.
+ * @node: the node cursor.
+ *
+ * Call with rcu_read_lock held.
+ */
+#define cds_skiplist_for_each(sl, node)					\
+	for (node = cds_skiplist_first(sl);				\
+		node != NULL;						\
+		node = cds_skiplist_next(sl, node))
+
+/*
+ * cds_skiplist_for_each_from - iterate from the first key not lower than
+ * a key.
+ * @sl: the skiplist.
+ * @key: the first key of the range.
+ * @node: the node cursor.
+ *
+ * Call with rcu_read_lock held.
+ */
+#define cds_skiplist_for_each_from(sl, key, node)			\
+	for (node = cds_skiplist_lower_bound(sl, key);			\
+		node != NULL;						\
+		node = cds_skiplist_next(sl, node))
+
+/*
+ * cds_skiplist_for_each_entry - iterate over the entries of a skiplist.
+ * @sl: the skiplist.
+ * @node: the node cursor.
+ * @pos: the type * to use as a cursor.
+ * @member: the name of the cds_skiplist_node within the struct.
+ *
+ * Call with rcu_read_lock held.
+ */
+#define cds_skiplist_for_each_entry(sl, node, pos, member)		\
+	for (node = cds_skiplist_first(sl),				\
+			pos = caa_container_of(node, __typeof__(*(pos)), member); \
+		node != NULL;						\
+		node = cds_skiplist_next(sl, node),			\
+			pos = caa_container_of(node, __typeof__(*(pos)), member))
+
+/*
+ * cds_skiplist_for_each_entry_from - iterate over the entries from the
+ * first key not lower than a key.
+ * @sl: the skiplist.
+ * @key: the first key of the range.
+ * @node: the node cursor.
+ * @pos: the type * to use as a cursor.
+ * @member: the name of the cds_skiplist_node within the struct.
+ *
+ * Call with rcu_read_lock held.
+ */
+#define cds_skiplist_for_each_entry_from(sl, key, node, pos, member)	\
+	for (node = cds_skiplist_lower_bound(sl, key),			\
+			pos = caa_container_of(node, __typeof__(*(pos)), member); \
+		node != NULL;						\
+		node = cds_skiplist_next(sl, node),			\
+			pos = caa_container_of(node, __typeof__(*(pos)), member))
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* _URCU_RCUSKIPLIST_H */
@@ -0,0 +1,72 @@
+#ifndef _URCU_READER_CTX_H
+#define _URCU_READER_CTX_H
+
+/*
+ * urcu/reader-ctx.h
+ *
+ * Userspace RCU header - reader contexts detached from threads
+ *
+ * This header is meant to be included indirectly through a liburcu
+ * flavor header.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*
+ * A reader context is registered on its own rather than by a thread, and
+ * grace periods of the memb, mb and signal flavors wait for its
+ * read-side critical sections like for those of registered threads.
+ * It lets a fiber or coroutine migrated between threads by a user-level
+ * scheduler hold a read-side critical section across a context switch:
+ * the fiber enters and leaves its critical sections through its own
+ * context, from whichever thread it runs on, which need not be
+ * registered.
+ *
+ * A context is used by one thread at a time, the scheduler ordering its
+ * uses from different threads, and never from signal handlers.
+ */
+struct urcu_reader;
+
+/*
+ * Allocate and register a reader context. Returns NULL if out of memory.
+ */
+struct urcu_reader *rcu_reader_ctx_create(void);
+
+/*
+ * Unregister and free a reader context, outside of any of its read-side
+ * critical sections.
+ */
+void rcu_reader_ctx_destroy(struct urcu_reader *ctx);
+
+/*
+ * Enter and leave a read-side critical section of the context, which
+ * may be nested, and may be left from another thread than the one which
+ * entered it.
+ */
+void rcu_read_lock_ctx(struct urcu_reader *ctx);
+void rcu_read_unlock_ctx(struct urcu_reader *ctx);
+
+/* Returns whether within a read-side critical section of the context. */
+int rcu_read_ongoing_ctx(struct urcu_reader *ctx);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* _URCU_READER_CTX_H */
@@ -0,0 +1,170 @@
+#ifndef _URCU_SHM_DOMAIN_H
+#define _URCU_SHM_DOMAIN_H
+
+/*
+ * urcu/shm-domain.h
+ *
+ * Userspace RCU library - RCU domain shared between processes
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+#include <stddef.h>
+#include <stdint.h>
+#include <pthread.h>
+#include <urcu/compiler.h>
+#include <urcu/arch.h>
+#include <urcu/system.h>
+#include <urcu/uatomic.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*
+ * A shared-memory RCU domain lets threads of several processes read
+ * data structures laid out in memory shared between them, such as a
+ * memfd or POSIX shared memory mapping, while any of them waits for
+ * grace periods before reclaiming what it unlinked.
+ *
+ * The domain lives in caller-provided shared memory, which may be
+ * mapped at different addresses in each process: a grace-period
+ * counter, a robust process-shared mutex serializing grace periods,
+ * and a fixed number of reader slots, one per registered reader
+ * thread. A grace period advances the counter and waits for each
+ * slot to be either outside of a read-side critical section or in one
+ * started after the advance. Slots of readers whose process died,
+ * even within a critical section, are reclaimed by grace periods and
+ * registrations, so a crashed reader does not block the domain.
+ *
+ * The read side costs a store and a memory barrier, as the memory
+ * barriers of other processes cannot be forced. Only the reader state
+ * is shared: callbacks such as call_rcu() remain per process.
+ *
+ * All processes must use the same liburcu build and architecture.
+ */
+
+/* Reader slot, in shared memory. */
+struct urcu_shm_slot {
+	unsigned long ctr;	/* 0 outside of read-side critical sections. */
+	int32_t pid;		/* Owner process, 0 if free. */
+} __attribute__((aligned(CAA_CACHE_LINE_SIZE)));
+
+/* Domain header, at the start of the shared memory. */
+struct urcu_shm_domain {
+	uint32_t magic;		/* Set once the domain is initialized. */
+	uint32_t header_size;
+	uint32_t slot_size;
+	uint32_t nr_slots;
+	pthread_mutex_t gp_lock;
+	unsigned long gp_ctr __attribute__((aligned(CAA_CACHE_LINE_SIZE)));
+	struct urcu_shm_slot slots[];
+};
+
+/* Reader thread of a domain, in memory private to its process. */
+struct urcu_shm_reader {
+	struct urcu_shm_domain *domain;
+	struct urcu_shm_slot *slot;
+	unsigned long nesting;
+};
+
+/*
+ * urcu_shm_domain_size - size of a domain with @nr_slots reader slots.
+ */
+extern
+size_t urcu_shm_domain_size(unsigned int nr_slots);
+
+/*
+ * urcu_shm_domain_init - lay out a domain in shared memory.
+ * @mem: shared memory, aligned on CAA_CACHE_LINE_SIZE.
+ * @len: length of @mem, at least urcu_shm_domain_size(@nr_slots).
+ * @nr_slots: maximum number of registered reader threads.
+ *
+ * Called by a single process, before the others attach to @mem.
+ * Return the domain, or NULL if @mem is too small or misaligned, or
+ * @nr_slots is 0.
+ */
+extern
+struct urcu_shm_domain *urcu_shm_domain_init(void *mem, size_t len,
+		unsigned int nr_slots);
+
+/*
+ * urcu_shm_domain_attach - use a domain laid out by another process.
+ *
+ * Return the domain, or NULL if @mem does not hold an initialized
+ * domain fitting in @len bytes, built for the same layout.
+ */
+extern
+struct urcu_shm_domain *urcu_shm_domain_attach(void *mem, size_t len);
+
+/*
+ * urcu_shm_register_reader - get a reader slot for the calling thread.
+ *
+ * Return 0 on success, -ENOSPC if all slots are used by live
+ * processes. @reader is used by the calling thread only, and must be
+ * unregistered before the thread exits. A child process created with
+ * fork() registers its own readers.
+ */
+extern
+int urcu_shm_register_reader(struct urcu_shm_domain *domain,
+		struct urcu_shm_reader *reader);
+
+/*
+ * urcu_shm_unregister_reader - release the slot of a reader, outside
+ * of read-side critical sections.
+ */
+extern
+void urcu_shm_unregister_reader(struct urcu_shm_reader *reader);
+
+/*
+ * urcu_shm_synchronize - wait for all read-side critical sections of
+ * the domain started before the call, in any process, to complete.
+ *
+ * Must not be called from a read-side critical section of the domain.
+ */
+extern
+void urcu_shm_synchronize(struct urcu_shm_domain *domain);
+
+/*
+ * urcu_shm_read_lock - enter a read-side critical section. Nests.
+ */
+static inline
+void urcu_shm_read_lock(struct urcu_shm_reader *reader)
+{
+	if (reader->nesting++)
+		return;
+	CMM_STORE_SHARED(reader->slot->ctr,
+		CMM_LOAD_SHARED(reader->domain->gp_ctr));
+	/* Publish the slot before reading shared data. */
+	cmm_smp_mb();
+}
+
+/*
+ * urcu_shm_read_unlock - exit a read-side critical section.
+ */
+static inline
+void urcu_shm_read_unlock(struct urcu_shm_reader *reader)
+{
+	if (--reader->nesting)
+		return;
+	/* Order reads of shared data before clearing the slot. */
+	uatomic_store_release(&reader->slot->ctr, 0);
+}
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* _URCU_SHM_DOMAIN_H */
@@ -0,0 +1,182 @@
+#ifndef _URCU_SHM_HASH_H
+#define _URCU_SHM_HASH_H
+
+/*
+ * urcu/shm-hash.h
+ *
+ * Userspace RCU library - position-independent hash table in shared memory
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+#include <stddef.h>
+#include <pthread.h>
+#include <urcu/compiler.h>
+#include <urcu/arch.h>
+#include <urcu/system.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*
+ * A hash table laid out in shared memory, which processes may map at
+ * different addresses: buckets and nodes link to each other with
+ * offsets from the start of the table rather than pointers. Nodes are
+ * allocated from an arena of fixed-size nodes following the bucket
+ * array, in the same mapping.
+ *
+ * Lookups run within read-side critical sections of a shared-memory RCU
+ * domain (see urcu/shm-domain.h), from any process, concurrently with
+ * updates. Updates from all processes are serialized by a robust
+ * process-shared mutex of the table. A deleted node is freed after a
+ * grace period of the domain.
+ *
+ * The bucket array has a fixed size, chosen at initialization.
+ */
+
+/* No node. */
+#define URCU_SHM_HT_NULL	0UL
+
+/* Header of nodes, embedded at the start of the objects of the table. */
+struct urcu_shm_ht_node {
+	unsigned long next;	/* Offset of the next node of the bucket. */
+	unsigned long hash;
+};
+
+/* Table header, at the start of the shared memory. */
+struct urcu_shm_ht {
+	unsigned int magic;	/* Set once the table is initialized. */
+	unsigned int header_size;
+	unsigned long nr_buckets;	/* Power of two. */
+	unsigned long node_size;
+	unsigned long nodes;	/* Offset of the node arena. */
+	unsigned long end;	/* End of the node arena. */
+	unsigned long bump;	/* Offset of the first never-used node. */
+	unsigned long free;	/* Free node list. */
+	unsigned long count;	/* Nodes in the table. */
+	pthread_mutex_t lock;	/* Serializes updates. */
+	unsigned long buckets[] __attribute__((aligned(CAA_CACHE_LINE_SIZE)));
+};
+
+/*
+ * urcu_shm_ht_size - size of a table.
+ * @nr_buckets: number of buckets, a power of two.
+ * @nr_nodes: number of nodes in the arena.
+ * @node_size: size of objects embedding struct urcu_shm_ht_node.
+ */
+extern
+size_t urcu_shm_ht_size(unsigned long nr_buckets, unsigned long nr_nodes,
+		size_t node_size);
+
+/*
+ * urcu_shm_ht_init - lay out an empty table in shared memory.
+ * @mem: shared memory, aligned on CAA_CACHE_LINE_SIZE.
+ * @len: length of @mem: the arena holds as many nodes as fit after the
+ *       buckets.
+ *
+ * Called by a single process, before the others attach to @mem.
+ * Return the table, or NULL if @nr_buckets is not a power of two,
+ * @node_size is smaller than struct urcu_shm_ht_node, or @mem is
+ * misaligned or has no room for a node.
+ */
+extern
+struct urcu_shm_ht *urcu_shm_ht_init(void *mem, size_t len,
+		unsigned long nr_buckets, size_t node_size);
+
+/*
+ * urcu_shm_ht_attach - use a table laid out by another process.
+ *
+ * Return the table, or NULL if @mem does not hold an initialized table
+ * fitting in @len bytes, built for the same layout.
+ */
+extern
+struct urcu_shm_ht *urcu_shm_ht_attach(void *mem, size_t len);
+
+/*
+ * urcu_shm_ht_alloc_node - allocate a node from the arena.
+ *
+ * Return NULL if the arena is exhausted.
+ */
+extern
+struct urcu_shm_ht_node *urcu_shm_ht_alloc_node(struct urcu_shm_ht *ht);
+
+/*
+ * urcu_shm_ht_free_node - return a node to the arena.
+ *
+ * The node must not be in the table, and if it was, a grace period of
+ * the domain of the readers must have elapsed since its deletion.
+ */
+extern
+void urcu_shm_ht_free_node(struct urcu_shm_ht *ht,
+		struct urcu_shm_ht_node *node);
+
+/*
+ * urcu_shm_ht_add - add a node, allowing duplicate keys.
+ *
+ * The content of the node must be initialized: it is published with
+ * the node.
+ */
+extern
+void urcu_shm_ht_add(struct urcu_shm_ht *ht, unsigned long hash,
+		struct urcu_shm_ht_node *node);
+
+/*
+ * urcu_shm_ht_del - delete a node from the table.
+ *
+ * Readers may still see the node until a grace period of their domain
+ * has elapsed. Return 0 on success, -ENOENT if the node is not in the
+ * table.
+ */
+extern
+int urcu_shm_ht_del(struct urcu_shm_ht *ht, struct urcu_shm_ht_node *node);
+
+/*
+ * urcu_shm_ht_lookup - find the first node matching a key.
+ * @match: returns non-zero if @node matches @key.
+ *
+ * Called within a read-side critical section of the domain of the
+ * readers. Return NULL if no node matches.
+ */
+extern
+struct urcu_shm_ht_node *urcu_shm_ht_lookup(struct urcu_shm_ht *ht,
+		unsigned long hash,
+		int (*match)(struct urcu_shm_ht_node *node, const void *key),
+		const void *key);
+
+/* Convert between offsets and addresses in the mapping of the caller. */
+static inline
+struct urcu_shm_ht_node *urcu_shm_ht_node_at(struct urcu_shm_ht *ht,
+		unsigned long offset)
+{
+	if (offset == URCU_SHM_HT_NULL)
+		return NULL;
+	return (struct urcu_shm_ht_node *) ((char *) ht + offset);
+}
+
+static inline
+unsigned long urcu_shm_ht_offset_of(struct urcu_shm_ht *ht,
+		struct urcu_shm_ht_node *node)
+{
+	if (!node)
+		return URCU_SHM_HT_NULL;
+	return (unsigned long) ((char *) node - (char *) ht);
+}
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* _URCU_SHM_HASH_H */
@@ -0,0 +1,114 @@
+#ifndef _URCU_SPLIT_COUNTER_H
+#define _URCU_SPLIT_COUNTER_H
+
+/*
+ * urcu/split-counter.h
+ *
+ * Userspace RCU library - Per-CPU split counter
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*
+ * Counter updated by many threads without contending on a cache line,
+ * as the rculfhash accounting does: each CPU adds to its own
+ * cache-line-aligned free-running counter, and commits to the global
+ * counter each time its counter crosses a multiple of 2^commit_order.
+ *
+ * The CPU is read from the rseq area of the thread when the C library
+ * registers one, else with sched_getcpu(). Threads of an unknown CPU
+ * are spread over the per-CPU counters. The per-CPU additions stay
+ * atomic, since a thread can migrate between picking a counter and
+ * adding to it: they are uncontended in the common case.
+ *
+ * cds_split_counter_read() reads the global counter: one cache line,
+ * and the sum of the committed additions, within
+ * cds_split_counter_max_error() below the exact value.
+ * cds_split_counter_read_exact() sums the per-CPU counters, and is
+ * exact for the additions which completed before it. This counter does
+ * _not_ specifically rely on RCU.
+ *
+ * Note that struct cds_split_counter is opaque to callers.
+ */
+struct cds_split_counter;
+
+/*
+ * cds_split_counter_new - allocate a split counter, set to 0.
+ * @commit_order: per-CPU additions are committed to the global counter
+ *                by multiples of 2^commit_order, lower than
+ *                CAA_BITS_PER_LONG.
+ * @nr_cpus: number of per-CPU counters, rounded up to a power of two,
+ *           or 0 for the number of configured CPUs.
+ *
+ * Return NULL on error.
+ */
+extern
+struct cds_split_counter *cds_split_counter_new(unsigned int commit_order,
+		unsigned long nr_cpus);
+
+/*
+ * cds_split_counter_destroy - free a split counter.
+ */
+extern
+void cds_split_counter_destroy(struct cds_split_counter *counter);
+
+/*
+ * cds_split_counter_add - add @v to the counter.
+ */
+extern
+void cds_split_counter_add(struct cds_split_counter *counter, long v);
+
+static inline
+void cds_split_counter_inc(struct cds_split_counter *counter)
+{
+	cds_split_counter_add(counter, 1);
+}
+
+static inline
+void cds_split_counter_dec(struct cds_split_counter *counter)
+{
+	cds_split_counter_add(counter, -1);
+}
+
+/*
+ * cds_split_counter_read - approximate value of the counter.
+ */
+extern
+long cds_split_counter_read(struct cds_split_counter *counter);
+
+/*
+ * cds_split_counter_read_exact - exact value of the counter, reading
+ * every per-CPU counter.
+ */
+extern
+long cds_split_counter_read_exact(struct cds_split_counter *counter);
+
+/*
+ * cds_split_counter_max_error - bound on the difference between the
+ * exact and the approximate values, once additions completed: the
+ * number of per-CPU counters times 2^commit_order.
+ */
+extern
+unsigned long cds_split_counter_max_error(struct cds_split_counter *counter);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* _URCU_SPLIT_COUNTER_H */
@@ -0,0 +1,138 @@
+#ifndef _URCU_SPSCRING_H
+#define _URCU_SPSCRING_H
+
+/*
+ * urcu/spscring.h
+ *
+ * Userspace RCU library - Bounded Wait-Free Single-Producer/Single-Consumer Ring
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+#include <stdbool.h>
+#include <urcu/compiler.h>
+#include <urcu/arch.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*
+ * Bounded array-based queue between exactly one producer thread and one
+ * consumer thread, with wait-free enqueue and dequeue.
+ *
+ * Each side owns its position, which only it writes, so no atomic
+ * read-modify-write instruction is needed: elements are published by a
+ * store-release of the enqueue position, and slots are handed back by a
+ * store-release of the dequeue position. Each side also keeps a cached
+ * copy of the position of the other side on its own cache line, and
+ * only reloads it when the cached copy says the ring is full (producer)
+ * or empty (consumer), so the cache line of the other side is seldom
+ * transferred. The bulk operations publish or consume a whole batch
+ * with a single position update.
+ *
+ * Enqueue operations must be serialized (one producer, or external
+ * mutual exclusion between producers), and so must dequeue operations.
+ * An enqueue and a dequeue can be called concurrently. This ring does
+ * _not_ specifically rely on RCU.
+ */
+
+/*
+ * Keep the producer and consumer state on separate cache-lines to
+ * eliminate false-sharing between them.
+ */
+struct cds_spsc_ring {
+	/* Producer state. */
+	unsigned long enqueue_pos __attribute__((aligned(CAA_CACHE_LINE_SIZE)));
+	unsigned long dequeue_pos_cache;
+	/* Consumer state. */
+	unsigned long dequeue_pos __attribute__((aligned(CAA_CACHE_LINE_SIZE)));
+	unsigned long enqueue_pos_cache;
+	/* Read-only after init. */
+	unsigned long mask __attribute__((aligned(CAA_CACHE_LINE_SIZE)));
+	void **slots;
+};
+
+#ifdef _LGPL_SOURCE
+
+#include <urcu/static/spscring.h>
+
+#define cds_spsc_ring_init		_cds_spsc_ring_init
+#define cds_spsc_ring_try_enqueue	_cds_spsc_ring_try_enqueue
+#define cds_spsc_ring_try_dequeue	_cds_spsc_ring_try_dequeue
+#define cds_spsc_ring_enqueue_bulk	_cds_spsc_ring_enqueue_bulk
+#define cds_spsc_ring_dequeue_bulk	_cds_spsc_ring_dequeue_bulk
+
+#else /* !_LGPL_SOURCE */
+
+/*
+ * cds_spsc_ring_init: initialize an empty ring.
+ * @ring: ring to initialize.
+ * @slots: array of @capacity elements, owned by the caller until the
+ *         ring is no longer used.
+ * @capacity: number of slots, a power of two of at least 2.
+ *
+ * Returns 0 on success, -EINVAL if @capacity is not a power of two of
+ * at least 2.
+ */
+extern int cds_spsc_ring_init(struct cds_spsc_ring *ring,
+		void **slots, unsigned long capacity);
+
+/*
+ * cds_spsc_ring_try_enqueue: enqueue @data into the ring.
+ *
+ * Returns false without waiting if the ring is full. Stores issued
+ * before enqueue are visible to the consumer of @data.
+ * Producer only.
+ */
+extern bool cds_spsc_ring_try_enqueue(struct cds_spsc_ring *ring,
+		void *data);
+
+/*
+ * cds_spsc_ring_try_dequeue: dequeue the oldest element into @data.
+ *
+ * Returns false without waiting if the ring is empty.
+ * Consumer only.
+ */
+extern bool cds_spsc_ring_try_dequeue(struct cds_spsc_ring *ring,
+		void **data);
+
+/*
+ * cds_spsc_ring_enqueue_bulk: enqueue up to @n elements from @data.
+ *
+ * The elements are published at once. Returns the number of elements
+ * enqueued, which is less than @n when the ring fills up, and 0 when it
+ * is full. Producer only.
+ */
+extern unsigned long cds_spsc_ring_enqueue_bulk(struct cds_spsc_ring *ring,
+		void **data, unsigned long n);
+
+/*
+ * cds_spsc_ring_dequeue_bulk: dequeue up to @n elements into @data.
+ *
+ * The slots are handed back to the producer at once. Returns the number
+ * of elements dequeued, in ring order, and 0 when the ring is empty.
+ * Consumer only.
+ */
+extern unsigned long cds_spsc_ring_dequeue_bulk(struct cds_spsc_ring *ring,
+		void **data, unsigned long n);
+
+#endif /* !_LGPL_SOURCE */
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* _URCU_SPSCRING_H */
@@ -0,0 +1,198 @@
+#ifndef _URCU_SRCU_H
+#define _URCU_SRCU_H
+
+/*
+ * urcu/srcu.h
+ *
+ * Userspace RCU header - RCU domains with independent grace periods
+ *
+ * This header is meant to be included indirectly through a liburcu
+ * flavor header.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+#include <errno.h>
+#include <urcu/flavor.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*
+ * Note that struct srcu_domain is opaque to callers.
+ *
+ * A domain has its own grace periods: synchronize_srcu() only waits for
+ * the readers of the domain it is given. Each thread entering read-side
+ * critical sections of a domain must be registered to that domain with
+ * srcu_register_thread(), in addition to the flavor registration.
+ */
+struct srcu_domain;
+
+struct srcu_domain *srcu_domain_create(void);
+void srcu_domain_destroy(struct srcu_domain *domain);
+
+void srcu_register_thread(struct srcu_domain *domain);
+void srcu_unregister_thread(struct srcu_domain *domain);
+
+void srcu_read_lock(struct srcu_domain *domain);
+void srcu_read_unlock(struct srcu_domain *domain);
+int srcu_read_ongoing(struct srcu_domain *domain);
+
+void synchronize_srcu(struct srcu_domain *domain);
+
+unsigned long get_state_synchronize_srcu(struct srcu_domain *domain);
+int poll_state_synchronize_srcu(struct srcu_domain *domain,
+		unsigned long cookie);
+void cond_synchronize_srcu(struct srcu_domain *domain, unsigned long cookie);
+
+/*
+ * Callbacks of a domain are invoked by a worker thread of the domain,
+ * created by the first call_srcu(), after a grace period of the domain.
+ * call_srcu() never waits, and may be used within read-side critical
+ * sections of the domain. srcu_barrier() waits for the callbacks queued
+ * before it to be invoked.
+ */
+void call_srcu(struct srcu_domain *domain, struct rcu_head *head,
+		void (*func)(struct rcu_head *head));
+void defer_srcu(struct srcu_domain *domain, void (*fct)(void *p), void *p);
+void srcu_barrier(struct srcu_domain *domain);
+
+/*
+ * Grace-period statistics of the domain. The call_rcu part of stats
+ * only has the qlen, invoked, batches and batch_max counters of the
+ * domain worker.
+ */
+void srcu_get_stats(struct srcu_domain *domain, struct urcu_stats *stats);
+
+/*
+ * DEFINE_SRCU_FLAVOR(x, fl, domain) defines x, a struct rcu_flavor_struct
+ * bound to the struct srcu_domain pointer expression domain, e.g. for
+ * cds_lfht_new_flavor(). fl is the prefix of the flavor the domain
+ * belongs to: urcu_memb, urcu_mb or urcu_signal.
+ *
+ * The update_call_rcu, update_defer_rcu and barrier operations of x are
+ * call_srcu(), defer_srcu() and srcu_barrier() on the domain.
+ * update_start_poll_synchronize_rcu completes a grace period before
+ * returning its cookie.
+ */
+#define DEFINE_SRCU_FLAVOR(x, fl, domain)				\
+static void x##_read_lock(void)						\
+{									\
+	fl##_srcu_read_lock(domain);					\
+}									\
+static void x##_read_unlock(void)					\
+{									\
+	fl##_srcu_read_unlock(domain);					\
+}									\
+static int x##_read_ongoing(void)					\
+{									\
+	return fl##_srcu_read_ongoing(domain);				\
+}									\
+static void x##_quiescent_state(void)					\
+{									\
+	fl##_quiescent_state();						\
+}									\
+static void x##_synchronize(void)					\
+{									\
+	fl##_synchronize_srcu(domain);					\
+}									\
+static void x##_call(struct rcu_head *head,				\
+		void (*func)(struct rcu_head *head))			\
+{									\
+	fl##_call_srcu(domain, head, func);				\
+}									\
+static void x##_defer(void (*fct)(void *p), void *p)			\
+{									\
+	fl##_defer_srcu(domain, fct, p);				\
+}									\
+static void x##_thread_offline(void)					\
+{									\
+	fl##_thread_offline();						\
+}									\
+static void x##_thread_online(void)					\
+{									\
+	fl##_thread_online();						\
+}									\
+static void x##_register_thread(void)					\
+{									\
+	fl##_register_thread();						\
+	fl##_srcu_register_thread(domain);				\
+}									\
+static int x##_register_thread_isolated(void)				\
+{									\
+	return -ENOSYS;							\
+}									\
+static void x##_unregister_thread(void)					\
+{									\
+	fl##_srcu_unregister_thread(domain);				\
+	fl##_unregister_thread();					\
+}									\
+static void x##_barrier(void)						\
+{									\
+	fl##_srcu_barrier(domain);					\
+}									\
+static unsigned long x##_get_state(void)				\
+{									\
+	return fl##_get_state_synchronize_srcu(domain);			\
+}									\
+static unsigned long x##_start_poll(void)				\
+{									\
+	unsigned long cookie;						\
+									\
+	cookie = fl##_get_state_synchronize_srcu(domain);		\
+	fl##_cond_synchronize_srcu(domain, cookie);			\
+	return cookie;							\
+}									\
+static int x##_poll_state(unsigned long cookie)				\
+{									\
+	return fl##_poll_state_synchronize_srcu(domain, cookie);	\
+}									\
+static void x##_cond(unsigned long cookie)				\
+{									\
+	fl##_cond_synchronize_srcu(domain, cookie);			\
+}									\
+static void x##_get_stats(struct urcu_stats *stats)			\
+{									\
+	fl##_srcu_get_stats(domain, stats);				\
+}									\
+const struct rcu_flavor_struct x = {					\
+	.read_lock		= x##_read_lock,			\
+	.read_unlock		= x##_read_unlock,			\
+	.read_ongoing		= x##_read_ongoing,			\
+	.read_quiescent_state	= x##_quiescent_state,			\
+	.update_call_rcu	= x##_call,				\
+	.update_synchronize_rcu	= x##_synchronize,			\
+	.update_defer_rcu	= x##_defer,				\
+	.thread_offline		= x##_thread_offline,			\
+	.thread_online		= x##_thread_online,			\
+	.register_thread	= x##_register_thread,			\
+	.unregister_thread	= x##_unregister_thread,		\
+	.barrier		= x##_barrier,				\
+	.register_rculfhash_atfork = fl##_register_rculfhash_atfork,	\
+	.unregister_rculfhash_atfork = fl##_unregister_rculfhash_atfork,\
+	.update_get_state_synchronize_rcu = x##_get_state,		\
+	.update_start_poll_synchronize_rcu = x##_start_poll,		\
+	.update_poll_state_synchronize_rcu = x##_poll_state,		\
+	.update_cond_synchronize_rcu = x##_cond,			\
+	.get_stats		= x##_get_stats,			\
+	.register_thread_isolated = x##_register_thread_isolated,	\
+}
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* _URCU_SRCU_H */
@@ -0,0 +1,74 @@
+#ifndef _URCU_STALL_H
+#define _URCU_STALL_H
+
+/*
+ * urcu/stall.h
+ *
+ * Userspace RCU header - reader stall watchdog
+ *
+ * This header is meant to be included indirectly through a liburcu
+ * flavor header.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+#include <pthread.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*
+ * Once a grace period has been waiting for pre-existing readers for
+ * threshold_ms milliseconds, func is invoked for each registered reader
+ * still blocking it, with the reader thread identifier and a lower
+ * bound of the time it has spent in its current read-side critical
+ * section (for QSBR, since its last quiescent state), in nanoseconds.
+ * Reports are repeated every threshold_ms while the readers stall.
+ *
+ * func is invoked by the thread performing the grace period, with the
+ * reader registry lock held: it must not register or unregister
+ * threads, nor wait for grace periods. A zero threshold_ms disables the
+ * watchdog. rcu_set_stall_watchdog() waits for the current grace
+ * period, if any, to complete, and must therefore not be called from
+ * func nor from within a read-side critical section.
+ */
+void rcu_set_stall_watchdog(unsigned long threshold_ms,
+		void (*func)(pthread_t tid, uint64_t active_ns, void *priv),
+		void *priv);
+
+/*
+ * Once a grace period has been waiting for pre-existing readers for
+ * threshold_ms milliseconds, the registered reader threads still
+ * blocking it are raised to the scheduling policy and priority given,
+ * then restored to their own when the grace period stops waiting for
+ * readers, or when they unregister. Readers boosted already keep their
+ * priority, and so do readers which cannot be boosted, for lack of
+ * privilege, reader contexts, and readers beyond the first 32 of a
+ * grace period.
+ *
+ * A zero threshold_ms disables boosting. Returns 0, or -EINVAL if
+ * priority is not valid for policy. Only available for the memb, mb,
+ * signal and qsbr flavors; same constraints on callers as
+ * rcu_set_stall_watchdog().
+ */
+int rcu_set_reader_boost(unsigned long threshold_ms, int policy, int priority);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* _URCU_STALL_H */
@@ -27,10 +27,12 @@
  */
 
 #include <stdbool.h>
+#include <stdint.h>
 #include <pthread.h>
 #include <assert.h>
 #include <urcu/uatomic.h>
 #include <urcu-pointer.h>
+#include <urcu/hazptr.h>
 
 #ifdef __cplusplus
 extern "C" {
@@ -174,6 +176,110 @@ bool _cds_lfs_push(cds_lfs_stack_ptr_t u_s,
 	return !___cds_lfs_empty_head(head);
 }
 
+/*
+ * Number of cpu_relax loops a push waits for a pop to take its node
+ * from the elimination array.
+ */
+#define CDS_LFS_ELIM_SPIN	128
+
+/*
+ * cds_lfs_elim_init: initialize an elimination array.
+ */
+static inline
+void _cds_lfs_elim_init(struct cds_lfs_elim *elim)
+{
+	int i;
+
+	for (i = 0; i < CDS_LFS_ELIM_SLOTS; i++)
+		elim->slots[i].node = NULL;
+}
+
+/*
+ * Offer node in a slot of the elimination array, and wait for a pop to
+ * take it. Returns true if the node was taken, false if it must be
+ * pushed on the stack.
+ */
+static inline
+bool ___cds_lfs_elim_push(struct cds_lfs_elim *elim,
+		struct cds_lfs_node *node)
+{
+	struct cds_lfs_elim_slot *slot;
+	int i;
+
+	slot = &elim->slots[((uintptr_t) node / sizeof(*node))
+			% CDS_LFS_ELIM_SLOTS];
+	/*
+	 * uatomic_cmpxchg() implicit memory barrier orders earlier
+	 * stores to node before publication.
+	 */
+	if (uatomic_cmpxchg(&slot->node, NULL, node) != NULL)
+		return false;	/* Slot busy. */
+	for (i = 0; i < CDS_LFS_ELIM_SPIN; i++) {
+		if (CMM_LOAD_SHARED(slot->node) != node)
+			return true;
+		caa_cpu_relax();
+	}
+	/* Withdraw the node, unless a pop took it meanwhile. */
+	return uatomic_cmpxchg(&slot->node, node, NULL) != node;
+}
+
+/*
+ * Take a node offered in the elimination array, or return NULL.
+ */
+static inline
+struct cds_lfs_node *___cds_lfs_elim_pop(struct cds_lfs_elim *elim)
+{
+	struct cds_lfs_node *node;
+	int i;
+
+	for (i = 0; i < CDS_LFS_ELIM_SLOTS; i++) {
+		node = CMM_LOAD_SHARED(elim->slots[i].node);
+		/*
+		 * uatomic_cmpxchg() implicit memory barrier orders the
+		 * take before reading node content.
+		 */
+		if (node && uatomic_cmpxchg(&elim->slots[i].node,
+				node, NULL) == node)
+			return node;
+	}
+	return NULL;
+}
+
+/*
+ * cds_lfs_push_elim: push a node into the stack, with elimination.
+ *
+ * Same as cds_lfs_push(), but once a cmpxchg on the stack head fails
+ * against a head value read earlier, offers @node to concurrent
+ * __cds_lfs_pop_elim() callers through @elim before retrying. An
+ * eliminated node is never on the stack, and true is returned, as
+ * there is no need to wake up a consumer for it.
+ */
+static inline
+bool _cds_lfs_push_elim(cds_lfs_stack_ptr_t u_s,
+		  struct cds_lfs_elim *elim,
+		  struct cds_lfs_node *node)
+{
+	struct __cds_lfs_stack *s = u_s._s;
+	struct cds_lfs_head *head = NULL;
+	struct cds_lfs_head *new_head =
+		caa_container_of(node, struct cds_lfs_head, node);
+	bool contended = false;
+
+	for (;;) {
+		struct cds_lfs_head *old_head = head;
+
+		node->next = &head->node;
+		head = uatomic_cmpxchg(&s->head, old_head, new_head);
+		if (old_head == head)
+			break;
+		/* The first failure only reads a non-empty head. */
+		if (contended && ___cds_lfs_elim_push(elim, node))
+			return true;
+		contended = true;
+	}
+	return !___cds_lfs_empty_head(head);
+}
+
 /*
  * __cds_lfs_pop: pop a node from the stack.
  *
@@ -222,6 +328,73 @@ struct cds_lfs_node *___cds_lfs_pop(cds_lfs_stack_ptr_t u_s)
 	}
 }
 
+/*
+ * __cds_lfs_pop_elim: pop a node from the stack, with elimination.
+ *
+ * Same as __cds_lfs_pop(), with the same synchronization requirements,
+ * but takes a node offered by a concurrent cds_lfs_push_elim() through
+ * @elim when the cmpxchg on the stack head fails.
+ */
+static inline
+struct cds_lfs_node *___cds_lfs_pop_elim(cds_lfs_stack_ptr_t u_s,
+		struct cds_lfs_elim *elim)
+{
+	struct __cds_lfs_stack *s = u_s._s;
+
+	for (;;) {
+		struct cds_lfs_head *head, *next_head;
+		struct cds_lfs_node *next;
+
+		head = _CMM_LOAD_SHARED(s->head);
+		if (___cds_lfs_empty_head(head))
+			return NULL;	/* Empty stack */
+
+		/* Read head before head->next. */
+		cmm_smp_read_barrier_depends();
+		next = _CMM_LOAD_SHARED(head->node.next);
+		next_head = caa_container_of(next,
+				struct cds_lfs_head, node);
+		if (uatomic_cmpxchg(&s->head, head, next_head) == head)
+			return &head->node;
+		next = ___cds_lfs_elim_pop(elim);
+		if (next)
+			return next;
+	}
+}
+
+/*
+ * __cds_lfs_pop_hazptr: pop a node from the stack, protected by a
+ * hazard pointer.
+ *
+ * Hazard slot 0 of @rec protects the head while its next pointer is
+ * read: it cannot be freed nor pushed back, which would make the
+ * cmpxchg succeed with a stale next pointer, until the slot is cleared.
+ * The returned node must be retired to the domain of @rec with
+ * urcu_hazptr_retire() before being freed or pushed back.
+ */
+static inline
+struct cds_lfs_node *___cds_lfs_pop_hazptr(cds_lfs_stack_ptr_t u_s,
+		struct urcu_hazptr_rec *rec)
+{
+	struct __cds_lfs_stack *s = u_s._s;
+	struct cds_lfs_head *head, *next_head;
+	struct cds_lfs_node *next;
+
+	for (;;) {
+		head = (struct cds_lfs_head *) urcu_hazptr_protect(rec, 0,
+				(void **) &s->head);
+		if (___cds_lfs_empty_head(head))
+			break;	/* Empty stack */
+		next = _CMM_LOAD_SHARED(head->node.next);
+		next_head = caa_container_of(next,
+				struct cds_lfs_head, node);
+		if (uatomic_cmpxchg(&s->head, head, next_head) == head)
+			break;
+	}
+	urcu_hazptr_clear(rec, 0);
+	return head ? &head->node : NULL;
+}
+
 /*
  * __cds_lfs_pop_all: pop all nodes from a stack.
  *
@@ -311,6 +484,22 @@ _cds_lfs_pop_all_blocking(struct cds_lfs_stack *s)
 	return rethead;
 }
 
+/*
+ * Call __cds_lfs_pop_elim with an internal pop mutex held.
+ */
+static inline
+struct cds_lfs_node *
+_cds_lfs_pop_elim_blocking(struct cds_lfs_stack *s,
+		struct cds_lfs_elim *elim)
+{
+	struct cds_lfs_node *retnode;
+
+	_cds_lfs_pop_lock(s);
+	retnode = ___cds_lfs_pop_elim(s, elim);
+	_cds_lfs_pop_unlock(s);
+	return retnode;
+}
+
 #ifdef __cplusplus
 }
 #endif
@@ -0,0 +1,159 @@
+#ifndef _URCU_MPMCRING_STATIC_H
+#define _URCU_MPMCRING_STATIC_H
+
+/*
+ * urcu/static/mpmcring.h
+ *
+ * Userspace RCU library - Bounded Lock-Free Multi-Producer/Multi-Consumer Ring
+ *
+ * TO BE INCLUDED ONLY IN LGPL-COMPATIBLE CODE. See urcu/mpmcring.h for
+ * linking dynamically with the userspace rcu library.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+#include <errno.h>
+#include <stdbool.h>
+#include <urcu/compiler.h>
+#include <urcu/uatomic.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*
+ * Positions and sequences are free-running counters, compared with
+ * signed differences so they can wrap around.
+ *
+ * A producer claims position pos once slot (pos & mask) has sequence
+ * pos, and publishes it by setting the sequence to pos + 1. A consumer
+ * claims position pos once the sequence is pos + 1, and hands the slot
+ * back to the producer of the next lap by setting it to pos + mask + 1.
+ *
+ * The uatomic_cmpxchg() claiming a range orders the sequence loads
+ * before the accesses to the slot data.
+ */
+
+static inline
+int _cds_mpmc_ring_init(struct cds_mpmc_ring *ring,
+		struct cds_mpmc_ring_slot *slots, unsigned long capacity)
+{
+	unsigned long i;
+
+	if (capacity < 2 || (capacity & (capacity - 1)))
+		return -EINVAL;
+	for (i = 0; i < capacity; i++) {
+		slots[i].seq = i;
+		slots[i].data = NULL;
+	}
+	ring->slots = slots;
+	ring->mask = capacity - 1;
+	ring->enqueue_pos = 0;
+	ring->dequeue_pos = 0;
+	cmm_smp_mb();
+	return 0;
+}
+
+/*
+ * Claim up to @n consecutive positions from *@pos_p, whose slots have a
+ * sequence of their position plus @ready. Returns the number of claimed
+ * positions, the first one being stored into *@first.
+ */
+static inline
+unsigned long ___cds_mpmc_ring_claim(struct cds_mpmc_ring *ring,
+		unsigned long *pos_p, unsigned long ready,
+		unsigned long n, unsigned long *first)
+{
+	unsigned long pos, old, k;
+	long dif;
+
+	if (!n)
+		return 0;
+	pos = CMM_LOAD_SHARED(*pos_p);
+	for (;;) {
+		for (k = 0; k < n; k++) {
+			dif = (long) (CMM_LOAD_SHARED(
+				ring->slots[(pos + k) & ring->mask].seq)
+					- (pos + k + ready));
+			if (dif)
+				break;
+		}
+		if (!k) {
+			if (dif < 0)
+				return 0;	/* Full or empty. */
+			/* Position moved on, retry. */
+			pos = CMM_LOAD_SHARED(*pos_p);
+			continue;
+		}
+		old = uatomic_cmpxchg(pos_p, pos, pos + k);
+		if (old == pos)
+			break;
+		pos = old;
+	}
+	*first = pos;
+	return k;
+}
+
+static inline
+unsigned long _cds_mpmc_ring_enqueue_bulk(struct cds_mpmc_ring *ring,
+		void **data, unsigned long n)
+{
+	unsigned long pos, k, i;
+	struct cds_mpmc_ring_slot *slot;
+
+	k = ___cds_mpmc_ring_claim(ring, &ring->enqueue_pos, 0, n, &pos);
+	for (i = 0; i < k; i++) {
+		slot = &ring->slots[(pos + i) & ring->mask];
+		CMM_STORE_SHARED(slot->data, data[i]);
+		cmm_smp_wmb();	/* Store data before publishing slot. */
+		CMM_STORE_SHARED(slot->seq, pos + i + 1);
+	}
+	return k;
+}
+
+static inline
+unsigned long _cds_mpmc_ring_dequeue_bulk(struct cds_mpmc_ring *ring,
+		void **data, unsigned long n)
+{
+	unsigned long pos, k, i;
+	struct cds_mpmc_ring_slot *slot;
+
+	k = ___cds_mpmc_ring_claim(ring, &ring->dequeue_pos, 1, n, &pos);
+	for (i = 0; i < k; i++) {
+		slot = &ring->slots[(pos + i) & ring->mask];
+		data[i] = CMM_LOAD_SHARED(slot->data);
+		cmm_smp_mb();	/* Load data before handing back slot. */
+		CMM_STORE_SHARED(slot->seq, pos + i + ring->mask + 1);
+	}
+	return k;
+}
+
+static inline
+bool _cds_mpmc_ring_try_enqueue(struct cds_mpmc_ring *ring, void *data)
+{
+	return _cds_mpmc_ring_enqueue_bulk(ring, &data, 1);
+}
+
+static inline
+bool _cds_mpmc_ring_try_dequeue(struct cds_mpmc_ring *ring, void **data)
+{
+	return _cds_mpmc_ring_dequeue_bulk(ring, data, 1);
+}
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* _URCU_MPMCRING_STATIC_H */
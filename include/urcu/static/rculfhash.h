@@ -0,0 +1,618 @@
+#ifndef _URCU_RCULFHASH_STATIC_H
+#define _URCU_RCULFHASH_STATIC_H
+
+/*
+ * urcu/static/rculfhash.h
+ *
+ * Userspace RCU library - Lock-Free RCU Hash Table lookup fast path
+ *
+ * TO BE INCLUDED ONLY IN LGPL-COMPATIBLE CODE. See urcu/rculfhash.h for
+ * linking dynamically with the userspace rcu library.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+#include <stdint.h>
+#include <assert.h>
+#include <pthread.h>
+#include <urcu/compiler.h>
+#include <urcu/pointer.h>
+#include <urcu/list.h>
+#include <urcu/rculfhash.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#if (CAA_BITS_PER_LONG == 32)
+#define CDS_LFHT_MAX_TABLE_ORDER	32
+#else
+#define CDS_LFHT_MAX_TABLE_ORDER	64
+#endif
+
+/*
+ * The removed flag needs to be updated atomically with the pointer.
+ * It indicates that no node must attach to the node scheduled for
+ * removal, and that node garbage collection must be performed.
+ * The bucket flag does not require to be updated atomically with the
+ * pointer, but it is added as a pointer low bit flag to save space.
+ * The "removal owner" flag is used to detect which of the "del"
+ * operation that has set the "removed flag" gets to return the removed
+ * node to its caller. Note that the replace operation does not need to
+ * iteract with the "removal owner" flag, because it validates that
+ * the "removed" flag is not set before performing its cmpxchg.
+ */
+#define CDS_LFHT_REMOVED_FLAG		(1UL << 0)
+#define CDS_LFHT_BUCKET_FLAG		(1UL << 1)
+#define CDS_LFHT_REMOVAL_OWNER_FLAG	(1UL << 2)
+#define CDS_LFHT_FLAGS_MASK		((1UL << 3) - 1)
+
+/* Value of the end pointer. Should not interact with flags. */
+#define CDS_LFHT_END_VALUE		NULL
+
+struct ht_items_count;
+struct cds_lfht_resize_pool;
+
+/*
+ * Bucket node of cds_lfht_mm_mmap_compact: only the next pointer, with
+ * the alignment required by the pointer flags. The reverse hash of a
+ * bucket is that of its index.
+ */
+struct cds_lfht_compact_bucket {
+	struct cds_lfht_node *next;
+} __attribute__((aligned(8)));
+
+/*
+ * Bucket table memory retention of the mm plugins, see
+ * cds_lfht_set_mm_retention(). Orders above the table size up to
+ * populated_order keep their memory populated, and the mmap plugins
+ * keep the orders up to mapped_order mapped.
+ */
+struct cds_lfht_mm_retention {
+	size_t max_len;
+	unsigned long max_ms;
+	unsigned long populated_order;
+	unsigned long mapped_order;
+	uint64_t shrink_ns;		/* last shrink, monotonic clock */
+};
+
+/*
+ * cds_lfht: Top-level data structure representing a lock-free hash
+ * table. Its layout is only exposed for the inline lookup fast path of
+ * LGPL-compatible code, which must be built against the same library
+ * version: callers must otherwise treat it as an opaque cookie.
+ *
+ * The fields used in fast-paths are placed near the end of the
+ * structure, because we need to have a variable-sized union to contain
+ * the mm plugin fields, which are used in the fast path.
+ */
+struct cds_lfht {
+	/* Initial configuration items */
+	unsigned long max_nr_buckets;
+	const struct cds_lfht_mm_type *mm;	/* memory management plugin */
+	const struct rcu_flavor_struct *flavor;	/* RCU flavor */
+	struct cds_lfht_resize_policy policy;	/* automatic resize policy */
+	uint64_t last_resize_ns;	/* end of last resize, monotonic clock */
+
+	long count;			/* global approximate item count */
+
+	/*
+	 * We need to put the work threads offline (QSBR) when taking this
+	 * mutex, because we use synchronize_rcu within this mutex critical
+	 * section, which waits on read-side critical sections, and could
+	 * therefore cause grace-period deadlock if we hold off RCU G.P.
+	 * completion.
+	 */
+	pthread_mutex_t resize_mutex;	/* resize mutex: add/del mutex */
+	struct urcu_lock_stats resize_lock_stats;	/* of resize_mutex */
+	pthread_attr_t *resize_attr;	/* Resize threads attributes */
+	struct cds_lfht_resize_pool *resize_pool;	/* Resize threads */
+	unsigned int in_progress_destroy;
+	unsigned long resize_target;
+	int resize_initiated;
+
+	/*
+	 * Resize instrumentation. resize_event and resize_hook are
+	 * accessed with resize_mutex held, resize_stats with
+	 * resize_stats_mutex held.
+	 */
+	struct cds_lfht_resize_event resize_event;
+	uint64_t resize_start_ns;
+	void (*resize_hook)(struct cds_lfht *ht,
+			enum cds_lfht_resize_event_type type,
+			const struct cds_lfht_resize_event *event, void *priv);
+	void *resize_hook_priv;
+	pthread_mutex_t resize_stats_mutex;
+	struct cds_lfht_resize_stats resize_stats;
+
+	/* Accessed with resize_mutex held. */
+	struct cds_lfht_mm_retention mm_retention;
+
+	/* Memory accounting, updated with resize_mutex held. */
+	unsigned long alloc_len;	/* Length of this structure. */
+	unsigned long bucket_bytes;	/* see cds_lfht_mm_account() */
+
+	/* Live tables, see cds_lfht_for_each_table(). */
+	struct cds_list_head table_node;
+
+	/*
+	 * Variables needed for add and remove fast-paths.
+	 */
+	int flags;
+	int compact_buckets;	/* struct cds_lfht_compact_bucket table */
+	int resize_links;	/* resize linking nodes, see CDS_LFHT_SINGLE_WRITER */
+	unsigned long min_alloc_buckets_order;
+	unsigned long min_nr_alloc_buckets;
+	struct ht_items_count *split_count;	/* split item count */
+
+	/*
+	 * Variables needed for the lookup, add and remove fast-paths.
+	 */
+	unsigned long size;	/* always a power of 2, shared (RCU) */
+	/*
+	 * bucket_at pointer is kept here to skip the extra level of
+	 * dereference needed to get to "mm" (this is a fast-path).
+	 */
+	struct cds_lfht_node *(*bucket_at)(struct cds_lfht *ht,
+			unsigned long index);
+	/*
+	 * Dynamic length "tbl_chunk" needs to be at the end of
+	 * cds_lfht.
+	 */
+	union {
+		/*
+		 * Contains the per order-index-level bucket node table.
+		 * The size of each bucket node table is half the number
+		 * of hashes contained in this order (except for order 0).
+		 * The minimum allocation buckets size parameter allows
+		 * combining the bucket node arrays of the lowermost
+		 * levels to improve cache locality for small index orders.
+		 */
+		struct cds_lfht_node *tbl_order[CDS_LFHT_MAX_TABLE_ORDER];
+
+		/*
+		 * Contains the bucket node chunks. The size of each
+		 * bucket node chunk is ->min_alloc_size (we avoid to
+		 * allocate chunks with different size). Chunks improve
+		 * cache locality for small index orders, and are more
+		 * friendly with environments where allocation of large
+		 * contiguous memory areas is challenging due to memory
+		 * fragmentation concerns or inability to use virtual
+		 * memory addressing.
+		 */
+		struct cds_lfht_node *tbl_chunk[0];
+
+		/*
+		 * Memory mapping with room for all possible buckets.
+		 * Their memory is allocated when needed.
+		 */
+		struct cds_lfht_node *tbl_mmap;
+
+		/*
+		 * Huge page backed memory mapping, as tbl_mmap, followed
+		 * by the length of the mapping.
+		 */
+		struct {
+			struct cds_lfht_node *tbl_hugepage;
+			unsigned long hugepage_len;
+		};
+
+		/*
+		 * Memory mapping as tbl_mmap, holding compact bucket
+		 * nodes.
+		 */
+		struct cds_lfht_compact_bucket *tbl_compact;
+	};
+	/*
+	 * End of variables needed for the lookup, add and remove
+	 * fast-paths.
+	 */
+};
+
+/*
+ * Algorithm to reverse bits in a word by lookup table.
+ * Source:
+ * http://graphics.stanford.edu/~seander/bithacks.html#BitReverseTable
+ * Originally from Public Domain.
+ */
+
+static const uint8_t _cds_lfht_bit_reverse_table[256] =
+{
+#define R2(n) (n),   (n) + 2*64,     (n) + 1*64,     (n) + 3*64
+#define R4(n) R2(n), R2((n) + 2*16), R2((n) + 1*16), R2((n) + 3*16)
+#define R6(n) R4(n), R4((n) + 2*4 ), R4((n) + 1*4 ), R4((n) + 3*4 )
+	R6(0), R6(2), R6(1), R6(3)
+};
+#undef R2
+#undef R4
+#undef R6
+
+static inline
+uint8_t _cds_lfht_bit_reverse_u8(uint8_t v)
+{
+	return _cds_lfht_bit_reverse_table[v];
+}
+
+/*
+ * Words are reversed on every lookup and update, chosen at build time:
+ * with the compiler builtin when it has one, the rbit instruction on
+ * ARM, the GF2P8AFFINEQB instruction when the build targets GFNI, and
+ * otherwise by swapping ever larger groups of bits with masks, which
+ * the compiler turns into a byte swap for the last steps, and needs no
+ * table.
+ */
+#if defined(__has_builtin)
+#if __has_builtin(__builtin_bitreverse32) && __has_builtin(__builtin_bitreverse64)
+#define _CDS_LFHT_BIT_REVERSE_BUILTIN
+#endif
+#endif
+
+#if defined(_CDS_LFHT_BIT_REVERSE_BUILTIN)
+static inline
+uint32_t _cds_lfht_bit_reverse_u32(uint32_t v)
+{
+	return __builtin_bitreverse32(v);
+}
+
+static inline
+uint64_t _cds_lfht_bit_reverse_u64(uint64_t v)
+{
+	return __builtin_bitreverse64(v);
+}
+#elif defined(__aarch64__)
+static inline
+uint32_t _cds_lfht_bit_reverse_u32(uint32_t v)
+{
+	uint32_t r;
+
+	__asm__ ("rbit %w0, %w1" : "=r" (r) : "r" (v));
+	return r;
+}
+
+static inline
+uint64_t _cds_lfht_bit_reverse_u64(uint64_t v)
+{
+	uint64_t r;
+
+	__asm__ ("rbit %0, %1" : "=r" (r) : "r" (v));
+	return r;
+}
+#elif defined(__arm__) && defined(__ARM_ARCH) && (__ARM_ARCH >= 7) \
+	&& (!defined(__thumb__) || defined(__thumb2__))
+static inline
+uint32_t _cds_lfht_bit_reverse_u32(uint32_t v)
+{
+	uint32_t r;
+
+	__asm__ ("rbit %0, %1" : "=r" (r) : "r" (v));
+	return r;
+}
+
+static inline
+uint64_t _cds_lfht_bit_reverse_u64(uint64_t v)
+{
+	return ((uint64_t) _cds_lfht_bit_reverse_u32(v) << 32) |
+		_cds_lfht_bit_reverse_u32(v >> 32);
+}
+#elif defined(__GFNI__) && defined(__SSE2__) && defined(__x86_64__)
+#include <immintrin.h>
+
+/* The affine matrix reverses the bits of each byte. */
+static inline
+uint64_t _cds_lfht_bit_reverse_u64(uint64_t v)
+{
+	__m128i x = _mm_cvtsi64_si128((long long) v);
+
+	x = _mm_gf2p8affine_epi64_epi8(x,
+		_mm_set1_epi64x(0x8040201008040201LL), 0);
+	return __builtin_bswap64((uint64_t) _mm_cvtsi128_si64(x));
+}
+
+static inline
+uint32_t _cds_lfht_bit_reverse_u32(uint32_t v)
+{
+	return (uint32_t) (_cds_lfht_bit_reverse_u64(v) >> 32);
+}
+#else
+static inline
+uint32_t _cds_lfht_bit_reverse_u32(uint32_t v)
+{
+	v = ((v >> 1) & 0x55555555U) | ((v & 0x55555555U) << 1);
+	v = ((v >> 2) & 0x33333333U) | ((v & 0x33333333U) << 2);
+	v = ((v >> 4) & 0x0F0F0F0FU) | ((v & 0x0F0F0F0FU) << 4);
+	v = ((v >> 8) & 0x00FF00FFU) | ((v & 0x00FF00FFU) << 8);
+	return (v >> 16) | (v << 16);
+}
+
+static inline
+uint64_t _cds_lfht_bit_reverse_u64(uint64_t v)
+{
+	v = ((v >> 1) & 0x5555555555555555ULL)
+		| ((v & 0x5555555555555555ULL) << 1);
+	v = ((v >> 2) & 0x3333333333333333ULL)
+		| ((v & 0x3333333333333333ULL) << 2);
+	v = ((v >> 4) & 0x0F0F0F0F0F0F0F0FULL)
+		| ((v & 0x0F0F0F0F0F0F0F0FULL) << 4);
+	v = ((v >> 8) & 0x00FF00FF00FF00FFULL)
+		| ((v & 0x00FF00FF00FF00FFULL) << 8);
+	v = ((v >> 16) & 0x0000FFFF0000FFFFULL)
+		| ((v & 0x0000FFFF0000FFFFULL) << 16);
+	return (v >> 32) | (v << 32);
+}
+#endif
+
+static inline
+unsigned long _cds_lfht_bit_reverse_ulong(unsigned long v)
+{
+#if (CAA_BITS_PER_LONG == 32)
+	return _cds_lfht_bit_reverse_u32(v);
+#else
+	return _cds_lfht_bit_reverse_u64(v);
+#endif
+}
+
+static inline
+struct cds_lfht_node *_cds_lfht_clear_flag(struct cds_lfht_node *node)
+{
+	return (struct cds_lfht_node *)
+		(((unsigned long) node) & ~CDS_LFHT_FLAGS_MASK);
+}
+
+static inline
+int _cds_lfht_is_removed(struct cds_lfht_node *node)
+{
+	return ((unsigned long) node) & CDS_LFHT_REMOVED_FLAG;
+}
+
+static inline
+int _cds_lfht_is_bucket(struct cds_lfht_node *node)
+{
+	return ((unsigned long) node) & CDS_LFHT_BUCKET_FLAG;
+}
+
+static inline
+int _cds_lfht_is_end(struct cds_lfht_node *node)
+{
+	return _cds_lfht_clear_flag(node)
+		== (struct cds_lfht_node *) CDS_LFHT_END_VALUE;
+}
+
+/*
+ * Compare the tag of node before calling the match function, so that
+ * nodes with a different tag are rejected without accessing the
+ * structure embedding them. A NULL tag matches all nodes.
+ */
+static inline
+int _cds_lfht_tag_match(struct cds_lfht_node *node, const unsigned long *tag)
+{
+	return !tag
+		|| caa_container_of(node, struct cds_lfht_tag_node, node)->tag
+			== *tag;
+}
+
+/* Bucket node of index in the bucket table layout of cds_lfht_mm_order. */
+static inline
+struct cds_lfht_node *_cds_lfht_bucket_at_order(struct cds_lfht *ht,
+		unsigned long index)
+{
+	unsigned long order;
+
+	if (index < ht->min_nr_alloc_buckets)
+		return &ht->tbl_order[0][index];
+	/* Position of the most significant bit, index is not 0. */
+	order = CAA_BITS_PER_LONG - __builtin_clzl(index);
+	return &ht->tbl_order[order][index & ((1UL << (order - 1)) - 1)];
+}
+
+/* Bucket node of index in the bucket table layout of cds_lfht_mm_chunk. */
+static inline
+struct cds_lfht_node *_cds_lfht_bucket_at_chunk(struct cds_lfht *ht,
+		unsigned long index)
+{
+	unsigned long chunk, offset;
+
+	chunk = index >> ht->min_alloc_buckets_order;
+	offset = index & (ht->min_nr_alloc_buckets - 1);
+	return &ht->tbl_chunk[chunk][offset];
+}
+
+/*
+ * Bucket node of index in the bucket table layout of cds_lfht_mm_mmap,
+ * cds_lfht_mm_hugepage and cds_lfht_mm_hugepage_interleave.
+ */
+static inline
+struct cds_lfht_node *_cds_lfht_bucket_at_mmap(struct cds_lfht *ht,
+		unsigned long index)
+{
+	return &ht->tbl_mmap[index];
+}
+
+/*
+ * Bucket node of index, computed inline for the memory management
+ * plugins of the library. The plugin is recognized by its bucket_at
+ * function, which shares the cache line of the table size, rather than
+ * by ht->mm. Other plugins are called through bucket_at.
+ */
+static inline
+struct cds_lfht_node *_cds_lfht_bucket_at(struct cds_lfht *ht,
+		unsigned long index)
+{
+	struct cds_lfht_node *(*bucket_at)(struct cds_lfht *ht,
+			unsigned long index) = ht->bucket_at;
+
+	if (caa_likely(bucket_at == cds_lfht_mm_order.bucket_at))
+		return _cds_lfht_bucket_at_order(ht, index);
+	if (bucket_at == cds_lfht_mm_chunk.bucket_at)
+		return _cds_lfht_bucket_at_chunk(ht, index);
+	if (bucket_at == cds_lfht_mm_mmap.bucket_at
+			|| bucket_at == cds_lfht_mm_hugepage.bucket_at)
+		return _cds_lfht_bucket_at_mmap(ht, index);
+	if (bucket_at == cds_lfht_mm_mmap_compact.bucket_at)
+		return (struct cds_lfht_node *) &ht->tbl_compact[index];
+	return bucket_at(ht, index);
+}
+
+/*
+ * Reverse hash of node, next being the value of node->next. Only the
+ * nodes of a compact bucket table do not hold their reverse hash: the
+ * bucket flag of next tells them apart.
+ */
+static inline
+unsigned long _cds_lfht_node_reverse_hash(struct cds_lfht *ht,
+		struct cds_lfht_node *node, struct cds_lfht_node *next)
+{
+	if (caa_unlikely(_cds_lfht_is_bucket(next)) && ht->compact_buckets)
+		return _cds_lfht_bit_reverse_ulong((unsigned long)
+			((struct cds_lfht_compact_bucket *) node
+				- ht->tbl_compact));
+	return node->reverse_hash;
+}
+
+/*
+ * _cds_lfht_lookup_first - first node of the chain of a hash.
+ *
+ * Return the node following the bucket node of hash, with its flags
+ * cleared, from which the chain walk of a lookup starts. Must be called
+ * within a read-side critical section.
+ */
+static inline
+struct cds_lfht_node *_cds_lfht_lookup_first(struct cds_lfht *ht,
+		unsigned long hash)
+{
+	unsigned long size;
+	struct cds_lfht_node *bucket;
+
+	size = rcu_dereference(ht->size);
+	bucket = _cds_lfht_bucket_at(ht, hash & (size - 1));
+	/* We can always skip the bucket node initially */
+	return _cds_lfht_clear_flag(rcu_dereference(bucket->next));
+}
+
+/*
+ * Walk a bucket chain from node, the first node following the bucket
+ * node, looking for a node matching reverse_hash, tag (unless NULL) and
+ * key.
+ */
+static inline
+void __cds_lfht_lookup_chain(struct cds_lfht *ht, struct cds_lfht_node *node,
+		unsigned long reverse_hash, cds_lfht_match_fct match,
+		const void *key, const unsigned long *tag,
+		struct cds_lfht_iter *iter)
+{
+	struct cds_lfht_node *next;
+
+	for (;;) {
+		if (caa_unlikely(_cds_lfht_is_end(node))) {
+			node = next = NULL;
+			break;
+		}
+		next = rcu_dereference(node->next);
+		if (caa_unlikely(_cds_lfht_node_reverse_hash(ht, node, next)
+				> reverse_hash)) {
+			node = next = NULL;
+			break;
+		}
+		assert(node == _cds_lfht_clear_flag(node));
+		if (caa_likely(!_cds_lfht_is_removed(next))
+		    && !_cds_lfht_is_bucket(next)
+		    && node->reverse_hash == reverse_hash
+		    && _cds_lfht_tag_match(node, tag)
+		    && caa_likely(match(node, key))) {
+				break;
+		}
+		node = _cds_lfht_clear_flag(next);
+	}
+	assert(!node || !_cds_lfht_is_bucket(CMM_LOAD_SHARED(node->next)));
+	iter->node = node;
+	iter->next = next;
+}
+
+/*
+ * Walk the rest of the chain of iter, looking for a node matching the
+ * reverse hash of iter, tag (unless NULL) and key.
+ */
+static inline
+void __cds_lfht_next_duplicate(struct cds_lfht *ht, cds_lfht_match_fct match,
+		const void *key, const unsigned long *tag,
+		struct cds_lfht_iter *iter)
+{
+	struct cds_lfht_node *node, *next;
+	unsigned long reverse_hash;
+
+#ifdef CONFIG_CDS_LFHT_ITER_DEBUG
+	assert(ht == iter->lfht);
+#endif
+	node = iter->node;
+	reverse_hash = node->reverse_hash;
+	next = iter->next;
+	node = _cds_lfht_clear_flag(next);
+
+	for (;;) {
+		if (caa_unlikely(_cds_lfht_is_end(node))) {
+			node = next = NULL;
+			break;
+		}
+		next = rcu_dereference(node->next);
+		if (caa_unlikely(_cds_lfht_node_reverse_hash(ht, node, next)
+				> reverse_hash)) {
+			node = next = NULL;
+			break;
+		}
+		if (caa_likely(!_cds_lfht_is_removed(next))
+		    && !_cds_lfht_is_bucket(next)
+		    && _cds_lfht_tag_match(node, tag)
+		    && caa_likely(match(node, key))) {
+				break;
+		}
+		node = _cds_lfht_clear_flag(next);
+	}
+	assert(!node || !_cds_lfht_is_bucket(CMM_LOAD_SHARED(node->next)));
+	iter->node = node;
+	iter->next = next;
+}
+
+/*
+ * Inline versions of cds_lfht_lookup() and cds_lfht_next_duplicate(),
+ * with the same semantic: the bucket node is computed without calling
+ * into the library, and match is inlined by the compiler when it is a
+ * known function.
+ */
+static inline
+void _cds_lfht_lookup(struct cds_lfht *ht, unsigned long hash,
+		cds_lfht_match_fct match, const void *key,
+		struct cds_lfht_iter *iter)
+{
+	struct cds_lfht_node *node;
+
+#ifdef CONFIG_CDS_LFHT_ITER_DEBUG
+	iter->lfht = ht;
+#endif
+	node = _cds_lfht_lookup_first(ht, hash);
+	__cds_lfht_lookup_chain(ht, node, _cds_lfht_bit_reverse_ulong(hash),
+			match, key, NULL, iter);
+}
+
+static inline
+void _cds_lfht_next_duplicate(struct cds_lfht *ht, cds_lfht_match_fct match,
+		const void *key, struct cds_lfht_iter *iter)
+{
+	__cds_lfht_next_duplicate(ht, match, key, NULL, iter);
+}
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* _URCU_RCULFHASH_STATIC_H */
@@ -29,6 +29,8 @@
 #include <urcu-call-rcu.h>
 #include <urcu/uatomic.h>
 #include <urcu-pointer.h>
+#include <urcu/hazptr.h>
+#include <urcu/flavor.h>
 #include <assert.h>
 #include <errno.h>
 
@@ -39,7 +41,24 @@ extern "C" {
 struct cds_lfq_node_rcu_dummy {
 	struct cds_lfq_node_rcu parent;
 	struct rcu_head head;
-	struct cds_lfq_queue_rcu *q;
+	struct urcu_hazptr_head hazptr_head;
+	struct cds_lfq_queue_rcu *q;	/* NULL until first enqueued */
+	unsigned long gp_cookie;	/* Dequeued before this grace period */
+};
+
+/*
+ * Dummy nodes dequeued from a queue initialized with
+ * cds_lfq_init_rcu_flavor(), each tagged with a grace-period cookie of
+ * the flavor. A slot is filled by the dequeuer owning the dummy node,
+ * and emptied by the enqueuer claiming it, with cmpxchg. The pool is
+ * filled with fresh dummy nodes at initialization, which readers never
+ * saw, and which are reused without waiting for a grace period. With the
+ * dummy node of the queue, there are then as many as slots.
+ */
+struct cds_lfq_dummy_pool {
+	const struct rcu_flavor_struct *flavor;
+	unsigned long nr_slots;
+	struct cds_lfq_node_rcu_dummy *slots[];
 };
 
 /*
@@ -57,39 +76,135 @@ struct cds_lfq_node_rcu_dummy {
  *
  * In the dequeue operation, we internally reallocate the dummy node
  * upon dequeue/requeue and use call_rcu to free the old one after a
- * grace period.
+ * grace period. Queues initialized with cds_lfq_init_rcu_flavor()
+ * instead keep the old dummy nodes in a pool, and reuse them once a
+ * grace period has elapsed since their dequeue.
+ *
+ * The hazard-pointer variants protect the head or tail node they
+ * access with a hazard slot instead, and retire the old dummy nodes to
+ * the hazard-pointer domain. Their dequeue never moves the head past
+ * the tail: it first helps moving the tail, so that the tail never
+ * points to a node which may be reclaimed. A queue must use either the
+ * RCU or the hazard-pointer variants.
+ */
+
+/* Put a dequeued dummy node in the pool. Return 0 if full. */
+static inline
+int dummy_pool_put(struct cds_lfq_dummy_pool *pool,
+		   struct cds_lfq_node_rcu_dummy *dummy)
+{
+	unsigned long i;
+
+	for (i = 0; i < pool->nr_slots; i++) {
+		if (CMM_LOAD_SHARED(pool->slots[i]))
+			continue;
+		if (uatomic_cmpxchg(&pool->slots[i], NULL, dummy) == NULL)
+			return 1;
+	}
+	return 0;
+}
+
+/*
+ * Claim a dummy node of the pool whose grace period has elapsed, or
+ * return NULL. Should be called under rcu read lock critical section:
+ * the dummy nodes of the pool which are claimed concurrently may be
+ * freed with call_rcu().
  */
+static inline
+void free_dummy_cb(struct rcu_head *head)
+{
+	struct cds_lfq_node_rcu_dummy *dummy =
+		caa_container_of(head, struct cds_lfq_node_rcu_dummy, head);
+	free(dummy);
+}
+
+static inline
+struct cds_lfq_node_rcu_dummy *dummy_pool_get(struct cds_lfq_dummy_pool *pool)
+{
+	struct cds_lfq_node_rcu_dummy *dummy;
+	unsigned long i;
+
+	for (i = 0; i < pool->nr_slots; i++) {
+		dummy = CMM_LOAD_SHARED(pool->slots[i]);
+		if (!dummy || (CMM_LOAD_SHARED(dummy->q)
+				&& !pool->flavor->update_poll_state_synchronize_rcu(
+					CMM_LOAD_SHARED(dummy->gp_cookie))))
+			continue;
+		if (uatomic_cmpxchg(&pool->slots[i], dummy, NULL) != dummy)
+			continue;
+		/*
+		 * The dummy node may have been claimed, enqueued and
+		 * dequeued again since its cookie was read: check again
+		 * now that we own it.
+		 */
+		if (!dummy->q || pool->flavor->update_poll_state_synchronize_rcu(
+				dummy->gp_cookie))
+			return dummy;
+		if (!dummy_pool_put(pool, dummy))
+			dummy->q->queue_call_rcu(&dummy->head, free_dummy_cb);
+	}
+	return NULL;
+}
 
 static inline
 struct cds_lfq_node_rcu *make_dummy(struct cds_lfq_queue_rcu *q,
 				    struct cds_lfq_node_rcu *next)
 {
-	struct cds_lfq_node_rcu_dummy *dummy;
+	struct cds_lfq_node_rcu_dummy *dummy = NULL;
 
-	dummy = malloc(sizeof(struct cds_lfq_node_rcu_dummy));
-	assert(dummy);
+	if (q->dummy_pool)
+		dummy = dummy_pool_get(q->dummy_pool);
+	if (!dummy) {
+		dummy = malloc(sizeof(struct cds_lfq_node_rcu_dummy));
+		assert(dummy);
+	}
 	dummy->parent.next = next;
 	dummy->parent.dummy = 1;
 	dummy->q = q;
 	return &dummy->parent;
 }
 
+/*
+ * Free a dequeued dummy node after a grace period, or put it back in
+ * the pool to be reused after a grace period.
+ */
 static inline
-void free_dummy_cb(struct rcu_head *head)
+void rcu_free_dummy(struct cds_lfq_node_rcu *node)
+{
+	struct cds_lfq_node_rcu_dummy *dummy;
+	struct cds_lfq_dummy_pool *pool;
+
+	assert(node->dummy);
+	dummy = caa_container_of(node, struct cds_lfq_node_rcu_dummy, parent);
+	pool = dummy->q->dummy_pool;
+	if (pool) {
+		dummy->gp_cookie =
+			pool->flavor->update_start_poll_synchronize_rcu();
+		if (dummy_pool_put(pool, dummy))
+			return;
+	}
+	dummy->q->queue_call_rcu(&dummy->head, free_dummy_cb);
+}
+
+static inline
+void free_dummy_hazptr_cb(struct urcu_hazptr_head *head)
 {
 	struct cds_lfq_node_rcu_dummy *dummy =
-		caa_container_of(head, struct cds_lfq_node_rcu_dummy, head);
+		caa_container_of(head, struct cds_lfq_node_rcu_dummy,
+				hazptr_head);
 	free(dummy);
 }
 
 static inline
-void rcu_free_dummy(struct cds_lfq_node_rcu *node)
+void hazptr_free_dummy(struct urcu_hazptr_rec *rec,
+		       struct cds_lfq_node_rcu *node)
 {
 	struct cds_lfq_node_rcu_dummy *dummy;
 
 	assert(node->dummy);
 	dummy = caa_container_of(node, struct cds_lfq_node_rcu_dummy, parent);
-	dummy->q->queue_call_rcu(&dummy->head, free_dummy_cb);
+	urcu_hazptr_retire(rec, &dummy->hazptr_head, node,
+			free_dummy_hazptr_cb);
 }
 
 static inline
@@ -114,11 +229,51 @@ void _cds_lfq_init_rcu(struct cds_lfq_queue_rcu *q,
 		       void queue_call_rcu(struct rcu_head *head,
 				void (*func)(struct rcu_head *head)))
 {
+	q->dummy_pool = NULL;
 	q->tail = make_dummy(q, NULL);
 	q->head = q->tail;
 	q->queue_call_rcu = queue_call_rcu;
 }
 
+static inline
+int _cds_lfq_init_rcu_flavor(struct cds_lfq_queue_rcu *q,
+			     const struct rcu_flavor_struct *flavor,
+			     unsigned long pool_size)
+{
+	struct cds_lfq_dummy_pool *pool;
+	unsigned long i;
+
+	if (!pool_size)
+		pool_size = CDS_LFQ_DEFAULT_DUMMY_POOL;
+	pool = calloc(1, sizeof(*pool) + pool_size * sizeof(pool->slots[0]));
+	if (!pool)
+		return -ENOMEM;
+	pool->flavor = flavor;
+	pool->nr_slots = pool_size;
+	/*
+	 * Reserve the dummy nodes up front, leaving a slot for the initial
+	 * dummy node of the queue.
+	 */
+	for (i = 0; i < pool_size - 1; i++) {
+		pool->slots[i] = calloc(1, sizeof(*pool->slots[i]));
+		if (!pool->slots[i]) {
+			while (i--)
+				free(pool->slots[i]);
+			free(pool);
+			return -ENOMEM;
+		}
+	}
+	_cds_lfq_init_rcu(q, flavor->update_call_rcu);
+	q->dummy_pool = pool;
+	return 0;
+}
+
+static inline
+void _cds_lfq_init_hazptr(struct cds_lfq_queue_rcu *q)
+{
+	_cds_lfq_init_rcu(q, NULL);
+}
+
 /*
  * The queue should be emptied before calling destroy.
  *
@@ -133,6 +288,14 @@ int _cds_lfq_destroy_rcu(struct cds_lfq_queue_rcu *q)
 	if (!(head->dummy && head->next == NULL))
 		return -EPERM;	/* not empty */
 	free_dummy(head);
+	if (q->dummy_pool) {
+		unsigned long i;
+
+		for (i = 0; i < q->dummy_pool->nr_slots; i++)
+			free(q->dummy_pool->slots[i]);
+		free(q->dummy_pool);
+		q->dummy_pool = NULL;
+	}
 	return 0;
 }
 
@@ -177,7 +340,10 @@ void enqueue_dummy(struct cds_lfq_queue_rcu *q)
 {
 	struct cds_lfq_node_rcu *node;
 
-	/* We need to reallocate to protect from ABA. */
+	/*
+	 * We need a dummy node dequeued before a grace period, or a new
+	 * one, to protect from ABA.
+	 */
 	node = make_dummy(q, NULL);
 	_cds_lfq_enqueue_rcu(q, node);
 }
@@ -221,6 +387,130 @@ struct cds_lfq_node_rcu *_cds_lfq_dequeue_rcu(struct cds_lfq_queue_rcu *q)
 	}
 }
 
+/*
+ * Should be called under rcu read lock critical section.
+ *
+ * Dequeue up to max consecutive nodes with a single move of the queue
+ * head, storing them in order into nodes[]. Returns their number, 0 if
+ * queue is empty. The caller must wait for a grace period to pass
+ * before freeing the returned nodes or modifying their cds_lfq_node_rcu
+ * structure.
+ */
+static inline
+unsigned long _cds_lfq_dequeue_batch_rcu(struct cds_lfq_queue_rcu *q,
+		struct cds_lfq_node_rcu **nodes, unsigned long max)
+{
+	if (!max)
+		return 0;
+	for (;;) {
+		struct cds_lfq_node_rcu *head, *node, *next, *new_head = NULL;
+		unsigned long nr = 0;
+
+		/*
+		 * Walk from the head to the node following the last one
+		 * dequeued, which becomes the new head. As in
+		 * _cds_lfq_dequeue_rcu(), a dummy node is enqueued
+		 * rather than dequeuing the last node of the queue.
+		 */
+		head = rcu_dereference(q->head);
+		for (node = head;; node = next) {
+			next = rcu_dereference(node->next);
+			if (!next) {
+				if (node->dummy)
+					break;
+				enqueue_dummy(q);
+				next = rcu_dereference(node->next);
+			}
+			new_head = next;
+			if (!node->dummy && ++nr == max)
+				break;
+		}
+		if (!new_head)
+			return 0;	/* empty */
+		if (uatomic_cmpxchg(&q->head, head, new_head) != head)
+			continue;	/* Concurrently pushed. */
+		nr = 0;
+		for (node = head; node != new_head; node = next) {
+			next = CMM_LOAD_SHARED(node->next);
+			if (node->dummy)
+				rcu_free_dummy(node);	/* After grace period. */
+			else
+				nodes[nr++] = node;
+		}
+		if (nr)
+			return nr;
+		/* Only dequeued dummy nodes: try again. */
+	}
+}
+
+/*
+ * Enqueue with the tail protected by hazard slot 2 of @rec, cleared on
+ * return.
+ */
+static inline
+void _cds_lfq_enqueue_hazptr(struct cds_lfq_queue_rcu *q,
+			     struct cds_lfq_node_rcu *node,
+			     struct urcu_hazptr_rec *rec)
+{
+	for (;;) {
+		struct cds_lfq_node_rcu *tail, *next;
+
+		tail = (struct cds_lfq_node_rcu *) urcu_hazptr_protect(rec, 2,
+				(void **) &q->tail);
+		next = uatomic_cmpxchg(&tail->next, NULL, node);
+		if (next == NULL) {
+			(void) uatomic_cmpxchg(&q->tail, tail, node);
+			break;
+		}
+		(void) uatomic_cmpxchg(&q->tail, tail, next);
+	}
+	urcu_hazptr_clear(rec, 2);
+}
+
+/*
+ * Dequeue with the head protected by hazard slot 0 of @rec, and slot 2
+ * when enqueueing a dummy node. The slots are cleared on return.
+ *
+ * The caller must retire the returned node to the domain of @rec with
+ * urcu_hazptr_retire() before freeing it or modifying the
+ * cds_lfq_node_rcu structure.
+ * Returns NULL if queue is empty.
+ */
+static inline
+struct cds_lfq_node_rcu *_cds_lfq_dequeue_hazptr(struct cds_lfq_queue_rcu *q,
+		struct urcu_hazptr_rec *rec)
+{
+	struct cds_lfq_node_rcu *head, *next;
+
+	for (;;) {
+		head = (struct cds_lfq_node_rcu *) urcu_hazptr_protect(rec, 0,
+				(void **) &q->head);
+		next = CMM_LOAD_SHARED(head->next);
+		if (head->dummy && next == NULL) {
+			head = NULL;	/* empty */
+			break;
+		}
+		if (!next) {
+			_cds_lfq_enqueue_hazptr(q, make_dummy(q, NULL), rec);
+			continue;
+		}
+		if (CMM_LOAD_SHARED(q->tail) == head) {
+			/* Move the tail past the head before dequeuing it. */
+			(void) uatomic_cmpxchg(&q->tail, head, next);
+			continue;
+		}
+		if (uatomic_cmpxchg(&q->head, head, next) != head)
+			continue;	/* Concurrently pushed. */
+		if (head->dummy) {
+			hazptr_free_dummy(rec, head);
+			continue;	/* try again */
+		}
+		break;
+	}
+	urcu_hazptr_clear(rec, 0);
+	return head;
+}
+
 #ifdef __cplusplus
 }
 #endif
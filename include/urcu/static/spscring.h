@@ -0,0 +1,126 @@
+#ifndef _URCU_SPSCRING_STATIC_H
+#define _URCU_SPSCRING_STATIC_H
+
+/*
+ * urcu/static/spscring.h
+ *
+ * Userspace RCU library - Bounded Wait-Free Single-Producer/Single-Consumer Ring
+ *
+ * TO BE INCLUDED ONLY IN LGPL-COMPATIBLE CODE. See urcu/spscring.h for
+ * linking dynamically with the userspace rcu library.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+#include <errno.h>
+#include <stdbool.h>
+#include <urcu/compiler.h>
+#include <urcu/uatomic.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*
+ * Positions are free-running counters: the ring holds the elements from
+ * dequeue_pos to enqueue_pos, and their difference never exceeds the
+ * capacity, so it stays correct when they wrap around.
+ *
+ * The store-release of enqueue_pos orders the stores to the slots
+ * before it, and pairs with the load-acquire of the consumer, which
+ * orders it before the loads of the slots. Likewise, the store-release
+ * of dequeue_pos orders the loads of the slots before the producer can
+ * see them free, through its load-acquire, and overwrite them.
+ */
+
+static inline
+int _cds_spsc_ring_init(struct cds_spsc_ring *ring,
+		void **slots, unsigned long capacity)
+{
+	if (capacity < 2 || (capacity & (capacity - 1)))
+		return -EINVAL;
+	ring->slots = slots;
+	ring->mask = capacity - 1;
+	ring->enqueue_pos = 0;
+	ring->dequeue_pos_cache = 0;
+	ring->dequeue_pos = 0;
+	ring->enqueue_pos_cache = 0;
+	cmm_smp_mb();
+	return 0;
+}
+
+static inline
+unsigned long _cds_spsc_ring_enqueue_bulk(struct cds_spsc_ring *ring,
+		void **data, unsigned long n)
+{
+	unsigned long pos = ring->enqueue_pos, capacity = ring->mask + 1;
+	unsigned long i, room;
+
+	room = capacity - (pos - ring->dequeue_pos_cache);
+	if (room < n) {
+		/* Looks full: reload the consumer position. */
+		ring->dequeue_pos_cache = uatomic_load_acquire(&ring->dequeue_pos);
+		room = capacity - (pos - ring->dequeue_pos_cache);
+		if (room < n)
+			n = room;
+		if (!n)
+			return 0;
+	}
+	for (i = 0; i < n; i++)
+		ring->slots[(pos + i) & ring->mask] = data[i];
+	uatomic_store_release(&ring->enqueue_pos, pos + n);
+	return n;
+}
+
+static inline
+unsigned long _cds_spsc_ring_dequeue_bulk(struct cds_spsc_ring *ring,
+		void **data, unsigned long n)
+{
+	unsigned long pos = ring->dequeue_pos;
+	unsigned long i, avail;
+
+	avail = ring->enqueue_pos_cache - pos;
+	if (avail < n) {
+		/* Looks empty: reload the producer position. */
+		ring->enqueue_pos_cache = uatomic_load_acquire(&ring->enqueue_pos);
+		avail = ring->enqueue_pos_cache - pos;
+		if (avail < n)
+			n = avail;
+		if (!n)
+			return 0;
+	}
+	for (i = 0; i < n; i++)
+		data[i] = ring->slots[(pos + i) & ring->mask];
+	uatomic_store_release(&ring->dequeue_pos, pos + n);
+	return n;
+}
+
+static inline
+bool _cds_spsc_ring_try_enqueue(struct cds_spsc_ring *ring, void *data)
+{
+	return _cds_spsc_ring_enqueue_bulk(ring, &data, 1);
+}
+
+static inline
+bool _cds_spsc_ring_try_dequeue(struct cds_spsc_ring *ring, void **data)
+{
+	return _cds_spsc_ring_dequeue_bulk(ring, data, 1);
+}
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* _URCU_SPSCRING_STATIC_H */
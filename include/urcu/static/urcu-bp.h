@@ -83,6 +83,14 @@ struct urcu_bp_gp {
 	 * Read by both writer and readers.
 	 */
 	unsigned long ctr;
+
+	/*
+	 * Grace-period sequence counter, incremented at the beginning
+	 * and at the end of each grace period.
+	 * Written to only by writer with mutex taken.
+	 * Read by the grace-period polling API.
+	 */
+	unsigned long seq;
 } __attribute__((aligned(CAA_CACHE_LINE_SIZE)));
 
 extern struct urcu_bp_gp urcu_bp_gp;
@@ -91,9 +99,7 @@ struct urcu_bp_reader {
 	/* Data used by both reader and urcu_bp_synchronize_rcu() */
 	unsigned long ctr;
 	/* Data used for registry */
-	struct cds_list_head node __attribute__((aligned(CAA_CACHE_LINE_SIZE)));
-	pthread_t tid;
-	int alloc;	/* registry entry allocated */
+	pthread_t tid __attribute__((aligned(CAA_CACHE_LINE_SIZE)));
 };
 
 /*
@@ -101,7 +107,7 @@ struct urcu_bp_reader {
  * Adds a pointer dereference on the read-side, but won't require to unregister
  * the reader thread.
  */
-extern DECLARE_URCU_TLS(struct urcu_bp_reader *, urcu_bp_reader);
+extern DECLARE_URCU_TLS_IE(struct urcu_bp_reader *, urcu_bp_reader);
 
 #ifdef CONFIG_RCU_FORCE_SYS_MEMBARRIER
 #define urcu_bp_has_sys_membarrier	1
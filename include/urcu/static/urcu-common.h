@@ -33,6 +33,7 @@
 #include <pthread.h>
 #include <unistd.h>
 #include <stdint.h>
+#include <time.h>
 
 #include <urcu/config.h>
 #include <urcu/compiler.h>
@@ -43,6 +44,7 @@
 #include <urcu/futex.h>
 #include <urcu/tls-compat.h>
 #include <urcu/debug.h>
+#include <urcu/stats.h>
 
 #ifdef __cplusplus
 extern "C" {
@@ -75,17 +77,76 @@ struct urcu_gp {
 	unsigned long ctr;
 
 	int32_t futex;
+
+	/*
+	 * Grace-period sequence counter, incremented at the beginning
+	 * and at the end of each grace period.
+	 * Written to only by writer with mutex taken.
+	 * Read by the grace-period polling API.
+	 */
+	unsigned long seq;
+} __attribute__((aligned(CAA_CACHE_LINE_SIZE)));
+
+#ifdef CONFIG_RCU_READER_ARRAY
+/*
+ * Reader state of the memb, mb and qsbr flavors read by synchronize_rcu(),
+ * kept in a library-owned array with one cache line per reader instead of
+ * the thread-local reader structure, so that grace periods scan readers
+ * sequentially.
+ */
+struct urcu_reader_slot {
+	unsigned long ctr;
+	int waiting;	/* qsbr flavor only. */
+	int detached;	/* reader context, see urcu/reader-ctx.h */
+	pthread_t tid;
 } __attribute__((aligned(CAA_CACHE_LINE_SIZE)));
 
+#define URCU_READER_SHARED(reader)	(*(reader).slot)
+#else
+#define URCU_READER_SHARED(reader)	(reader)
+#endif
+
 struct urcu_reader {
 	/* Data used by both reader and synchronize_rcu() */
 	unsigned long ctr;
 	char need_mb;
+#ifdef CONFIG_RCU_READER_ARRAY
+	/* ctr used instead by the memb and mb flavors, set at registration. */
+	struct urcu_reader_slot *slot;
+#endif
+#ifdef CONFIG_RCU_CS_SAMPLING
+	/* Outermost critical sections since the last sample. */
+	unsigned long cs_count;
+	/* Start of the sampled critical section in progress, or 0. */
+	uint64_t cs_start_ns;
+#endif
 	/* Data used for registry */
 	struct cds_list_head node __attribute__((aligned(CAA_CACHE_LINE_SIZE)));
 	pthread_t tid;
 	/* Reader registered flag, for internal checks. */
 	unsigned int registered:1;
+	/* Reader context not bound to a thread (urcu/reader-ctx.h). */
+	unsigned int detached:1;
+#ifdef CONFIG_RCU_CS_SAMPLING
+	/* Written by the reader, collected by rcu_for_each_reader_cs_stats(). */
+	struct urcu_cs_stats cs_stats;
+#endif
+	/*
+	 * Read-side nesting of the memb and mb flavors, private to the
+	 * reader and kept off the cache lines read by synchronize_rcu().
+	 */
+	unsigned long nesting __attribute__((aligned(CAA_CACHE_LINE_SIZE)));
+	/*
+	 * One plus the CPU of a reader registered as isolated, whose read
+	 * side issues full memory barriers instead of being sent IPIs or
+	 * signals by grace periods, or 0.
+	 */
+	unsigned int isolated;
+	/*
+	 * Node in the list of the other registered threads, whose CPU
+	 * affinity grace periods check before skipping isolated CPUs.
+	 */
+	struct cds_list_head shared_cpu_node;
 };
 
 /*
@@ -105,6 +166,57 @@ static inline void urcu_common_wake_up_gp(struct urcu_gp *gp)
 	}
 }
 
+#ifdef CONFIG_RCU_CS_SAMPLING
+static inline uint64_t urcu_common_cs_now_ns(void)
+{
+	struct timespec ts;
+
+	if (clock_gettime(CLOCK_MONOTONIC, &ts))
+		return 0;
+	return (uint64_t) ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+/*
+ * Called by the outermost read lock. Starts timing one critical section
+ * every period; a zero period disables sampling.
+ */
+static inline void urcu_common_cs_sample_lock(struct urcu_reader *reader,
+		unsigned long period)
+{
+	if (caa_likely(!period || ++reader->cs_count < period))
+		return;
+	reader->cs_count = 0;
+	reader->cs_start_ns = urcu_common_cs_now_ns();
+}
+
+static inline void urcu_common_cs_sample_record(struct urcu_cs_stats *stats,
+		uint64_t duration)
+{
+	uint64_t us = duration / 1000;
+	unsigned int bucket = 0;
+
+	while (us && bucket < URCU_STATS_CS_HIST_BUCKETS - 1) {
+		us >>= 1;
+		bucket++;
+	}
+	CMM_STORE_SHARED(stats->duration_hist[bucket],
+		stats->duration_hist[bucket] + 1);
+	if (duration > stats->duration_max_ns)
+		CMM_STORE_SHARED(stats->duration_max_ns, duration);
+	CMM_STORE_SHARED(stats->samples, stats->samples + 1);
+}
+
+/* Called by the outermost read unlock. */
+static inline void urcu_common_cs_sample_unlock(struct urcu_reader *reader)
+{
+	if (caa_likely(!reader->cs_start_ns))
+		return;
+	urcu_common_cs_sample_record(&reader->cs_stats,
+		urcu_common_cs_now_ns() - reader->cs_start_ns);
+	reader->cs_start_ns = 0;
+}
+#endif
+
 static inline enum urcu_state urcu_common_reader_state(struct urcu_gp *gp,
 		unsigned long *ctr)
 {
@@ -72,39 +72,59 @@ extern "C" {
 extern int urcu_memb_has_sys_membarrier;
 #endif
 
+extern struct urcu_gp urcu_memb_gp;
+
+extern DECLARE_URCU_TLS_IE(struct urcu_reader, urcu_memb_reader);
+
+/*
+ * Readers registered as isolated are skipped by membarrier, and issue
+ * full barriers themselves.
+ */
 static inline void urcu_memb_smp_mb_slave(void)
 {
-	if (caa_likely(urcu_memb_has_sys_membarrier))
+	if (caa_likely(urcu_memb_has_sys_membarrier)
+			&& caa_likely(!URCU_TLS(urcu_memb_reader).isolated))
 		cmm_barrier();
 	else
 		cmm_smp_mb();
 }
 
-extern struct urcu_gp urcu_memb_gp;
-
-extern DECLARE_URCU_TLS(struct urcu_reader, urcu_memb_reader);
+#ifdef CONFIG_RCU_CS_SAMPLING
+extern unsigned long urcu_memb_cs_sample_period;
+#endif
 
 /*
  * Helper for _rcu_read_lock().  The format of urcu_memb_gp.ctr (as well as
- * the per-thread rcu_reader.ctr) has the upper bits containing a count of
- * _rcu_read_lock() nesting, and a lower-order bit that contains either zero
- * or URCU_GP_CTR_PHASE.  The smp_mb_slave() ensures that the accesses in
- * _rcu_read_lock() happen before the subsequent read-side critical section.
+ * the per-thread rcu_reader.ctr) has the upper bits containing a
+ * URCU_GP_COUNT of one, and a lower-order bit that contains either zero or
+ * URCU_GP_CTR_PHASE.  The nesting of _rcu_read_lock() is counted in the
+ * thread-private rcu_reader.nesting instead: only the outermost lock
+ * writes to rcu_reader.ctr, whose cache line synchronize_rcu() polls.  A
+ * nested lock also writes it if it interrupted the outermost one, from a
+ * signal handler, before the store.  The smp_mb_slave() ensures that the
+ * accesses in _rcu_read_lock() happen before the subsequent read-side
+ * critical section.
  */
 static inline void _urcu_memb_read_lock_update(unsigned long tmp)
 {
-	if (caa_likely(!(tmp & URCU_GP_CTR_NEST_MASK))) {
-		_CMM_STORE_SHARED(URCU_TLS(urcu_memb_reader).ctr, _CMM_LOAD_SHARED(urcu_memb_gp.ctr));
+	unsigned long *ctr = &URCU_READER_SHARED(URCU_TLS(urcu_memb_reader)).ctr;
+
+	if (caa_likely(!tmp) || caa_unlikely(!(_CMM_LOAD_SHARED(*ctr) & URCU_GP_CTR_NEST_MASK))) {
+		_CMM_STORE_SHARED(*ctr, _CMM_LOAD_SHARED(urcu_memb_gp.ctr));
 		urcu_memb_smp_mb_slave();
-	} else
-		_CMM_STORE_SHARED(URCU_TLS(urcu_memb_reader).ctr, tmp + URCU_GP_COUNT);
+#ifdef CONFIG_RCU_CS_SAMPLING
+		urcu_common_cs_sample_lock(&URCU_TLS(urcu_memb_reader),
+			_CMM_LOAD_SHARED(urcu_memb_cs_sample_period));
+#endif
+	}
 }
 
 /*
  * Enter an RCU read-side critical section.
  *
  * The first cmm_barrier() call ensures that the compiler does not reorder
- * the body of _rcu_read_lock() with a mutex.
+ * the body of _rcu_read_lock() with a mutex. The second one counts the
+ * nesting before rcu_reader.ctr is written, for signal handlers.
  *
  * This function and its helper are both less than 10 lines long.  The
  * intent is that this function meets the 10-line criterion in LGPL,
@@ -116,8 +136,9 @@ static inline void _urcu_memb_read_lock(void)
 
 	urcu_assert(URCU_TLS(urcu_memb_reader).registered);
 	cmm_barrier();
-	tmp = URCU_TLS(urcu_memb_reader).ctr;
-	urcu_assert((tmp & URCU_GP_CTR_NEST_MASK) != URCU_GP_CTR_NEST_MASK);
+	tmp = URCU_TLS(urcu_memb_reader).nesting;
+	URCU_TLS(urcu_memb_reader).nesting = tmp + 1;
+	cmm_barrier();
 	_urcu_memb_read_lock_update(tmp);
 }
 
@@ -131,27 +152,35 @@ static inline void _urcu_memb_read_lock(void)
  */
 static inline void _urcu_memb_read_unlock_update_and_wakeup(unsigned long tmp)
 {
-	if (caa_likely((tmp & URCU_GP_CTR_NEST_MASK) == URCU_GP_COUNT)) {
+	if (caa_likely(tmp == 1)) {
+#ifdef CONFIG_RCU_CS_SAMPLING
+		urcu_common_cs_sample_unlock(&URCU_TLS(urcu_memb_reader));
+#endif
 		urcu_memb_smp_mb_slave();
-		_CMM_STORE_SHARED(URCU_TLS(urcu_memb_reader).ctr, tmp - URCU_GP_COUNT);
+		_CMM_STORE_SHARED(URCU_READER_SHARED(URCU_TLS(urcu_memb_reader)).ctr, 0);
 		urcu_memb_smp_mb_slave();
 		urcu_common_wake_up_gp(&urcu_memb_gp);
-	} else
-		_CMM_STORE_SHARED(URCU_TLS(urcu_memb_reader).ctr, tmp - URCU_GP_COUNT);
+	}
 }
 
 /*
  * Exit an RCU read-side crtical section.  Both this function and its
  * helper are smaller than 10 lines of code, and are intended to be
  * usable by non-LGPL code, as called out in LGPL.
+ *
+ * The nesting is decremented before rcu_reader.ctr is cleared: a signal
+ * handler interrupting in between behaves as an outermost lock.
  */
 static inline void _urcu_memb_read_unlock(void)
 {
 	unsigned long tmp;
 
 	urcu_assert(URCU_TLS(urcu_memb_reader).registered);
-	tmp = URCU_TLS(urcu_memb_reader).ctr;
-	urcu_assert(tmp & URCU_GP_CTR_NEST_MASK);
+	cmm_barrier();
+	tmp = URCU_TLS(urcu_memb_reader).nesting;
+	urcu_assert(tmp);
+	URCU_TLS(urcu_memb_reader).nesting = tmp - 1;
+	cmm_barrier();
 	_urcu_memb_read_unlock_update_and_wakeup(tmp);
 	cmm_barrier();	/* Ensure the compiler does not reorder us with mutex */
 }
@@ -165,7 +194,7 @@ static inline void _urcu_memb_read_unlock(void)
  */
 static inline int _urcu_memb_read_ongoing(void)
 {
-	return URCU_TLS(urcu_memb_reader).ctr & URCU_GP_CTR_NEST_MASK;
+	return URCU_TLS(urcu_memb_reader).nesting;
 }
 
 #ifdef __cplusplus
@@ -0,0 +1,186 @@
+#ifndef _URCU_PERCPU_STATIC_H
+#define _URCU_PERCPU_STATIC_H
+
+/*
+ * urcu-percpu-static.h
+ *
+ * Userspace RCU header, per-CPU counters version.
+ *
+ * TO BE INCLUDED ONLY IN CODE THAT IS TO BE RECOMPILED ON EACH LIBURCU
+ * RELEASE. See urcu-percpu.h for linking dynamically with the userspace
+ * rcu library.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+#include <stdlib.h>
+#include <pthread.h>
+#include <unistd.h>
+#include <stdint.h>
+
+#include <urcu/config.h>
+#include <urcu/compiler.h>
+#include <urcu/arch.h>
+#include <urcu/system.h>
+#include <urcu/uatomic.h>
+#include <urcu/futex.h>
+#include <urcu/tls-compat.h>
+#include <urcu/debug.h>
+#include <urcu/static/urcu-common.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*
+ * This code section can only be included in LGPL 2.1 compatible source code.
+ * See below for the function call wrappers which can be used in code meant to
+ * be only linked with the Userspace RCU library. This comes with a small
+ * performance degradation on the read-side due to the added function calls.
+ * This is required to permit relinking with newer versions of the library.
+ */
+
+/*
+ * Readers increment the lock counter of the current CPU for the index
+ * selected by the low-order bit of urcu_percpu_gp.ctr when entering the
+ * outermost read-side critical section, and the unlock counter for the
+ * same index, on whichever CPU they run, when leaving it. The writer
+ * flips the index and waits for the sums of lock and unlock counters of
+ * the old index over all CPUs to match. Readers are therefore not
+ * tracked individually, and need no registration.
+ *
+ * The per-thread urcu_percpu_reader word holds the nesting count in its
+ * upper bits and the index in its low-order bit, so it is updated with a
+ * single store, which keeps nesting from signal handlers consistent.
+ */
+#define URCU_PERCPU_IDX_MASK	(1UL << 0)
+#define URCU_PERCPU_COUNT	(1UL << 1)
+
+struct urcu_percpu_ctr {
+	unsigned long lock[2];
+	unsigned long unlock[2];
+} __attribute__((aligned(CAA_CACHE_LINE_SIZE)));
+
+/*
+ * urcu_percpu_gp.ctr only counts index flips. The futex and seq fields
+ * have the same meaning as for the other flavors.
+ */
+extern struct urcu_gp urcu_percpu_gp;
+
+extern DECLARE_URCU_TLS_IE(unsigned long, urcu_percpu_reader);
+
+/*
+ * Counters of the urcu_percpu_nr_cpus configured CPUs, allocated once by
+ * the library constructor.
+ */
+extern struct urcu_percpu_ctr *urcu_percpu_ctrs;
+extern unsigned int urcu_percpu_nr_cpus;
+
+/*
+ * Points to the CPU number field of the rseq area of the thread, kept
+ * current by the kernel. Set by the first urcu_percpu_this_cpu_ctr()
+ * call of the thread, and left NULL without rseq.
+ */
+extern DECLARE_URCU_TLS_IE(uint32_t *, urcu_percpu_cpu_id);
+
+/*
+ * Returns the counters of the CPU the caller is running on. Also
+ * initializes the library and urcu_percpu_cpu_id if needed.
+ */
+extern struct urcu_percpu_ctr *urcu_percpu_this_cpu_ctr(void);
+
+/*
+ * The CPU number only selects which counters are updated: a reader
+ * migrated after reading it still updates valid counters, and the
+ * writer sums the counters of all CPUs. A thread which set its
+ * urcu_percpu_cpu_id has seen the library initialized.
+ */
+static inline struct urcu_percpu_ctr *_urcu_percpu_this_cpu_ctr(void)
+{
+	uint32_t *cpu_id = URCU_TLS(urcu_percpu_cpu_id);
+	uint32_t cpu;
+
+	if (caa_likely(cpu_id)) {
+		cpu = CMM_LOAD_SHARED(*cpu_id);
+		if (caa_likely(cpu < urcu_percpu_nr_cpus))
+			return &urcu_percpu_ctrs[cpu];
+	}
+	return urcu_percpu_this_cpu_ctr();
+}
+
+/*
+ * Enter an RCU read-side critical section.
+ *
+ * The uatomic_inc() is followed by a memory barrier, which ensures that
+ * the counter update happens before the subsequent read-side critical
+ * section.
+ */
+static inline void _urcu_percpu_read_lock(void)
+{
+	unsigned long tmp, idx;
+
+	cmm_barrier();
+	tmp = URCU_TLS(urcu_percpu_reader);
+	if (caa_likely(!tmp)) {
+		idx = CMM_LOAD_SHARED(urcu_percpu_gp.ctr) & URCU_PERCPU_IDX_MASK;
+		uatomic_inc(&_urcu_percpu_this_cpu_ctr()->lock[idx]);
+		cmm_smp_mb__after_uatomic_inc();
+		_CMM_STORE_SHARED(URCU_TLS(urcu_percpu_reader),
+			URCU_PERCPU_COUNT | idx);
+	} else
+		_CMM_STORE_SHARED(URCU_TLS(urcu_percpu_reader),
+			tmp + URCU_PERCPU_COUNT);
+}
+
+/*
+ * Exit an RCU read-side critical section.
+ *
+ * The per-thread word is cleared before the unlock counter update, so a
+ * signal handler running in between starts its own critical section.
+ * The release ensures that the critical section is seen to precede the
+ * unlock counter update, and the memory barrier that the counter is
+ * updated before reading the update-side futex.
+ */
+static inline void _urcu_percpu_read_unlock(void)
+{
+	unsigned long tmp;
+
+	tmp = URCU_TLS(urcu_percpu_reader);
+	urcu_assert(tmp >= URCU_PERCPU_COUNT);
+	if (caa_likely((tmp & ~URCU_PERCPU_IDX_MASK) == URCU_PERCPU_COUNT)) {
+		_CMM_STORE_SHARED(URCU_TLS(urcu_percpu_reader), 0);
+		cmm_barrier();
+		uatomic_inc_release(&_urcu_percpu_this_cpu_ctr()->unlock[tmp & URCU_PERCPU_IDX_MASK]);
+		cmm_smp_mb__after_uatomic_inc();
+		urcu_common_wake_up_gp(&urcu_percpu_gp);
+	} else
+		_CMM_STORE_SHARED(URCU_TLS(urcu_percpu_reader),
+			tmp - URCU_PERCPU_COUNT);
+	cmm_barrier();	/* Ensure the compiler does not reorder us with mutex */
+}
+
+/*
+ * Returns whether within a RCU read-side critical section.
+ */
+static inline int _urcu_percpu_read_ongoing(void)
+{
+	return URCU_TLS(urcu_percpu_reader) != 0;
+}
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* _URCU_PERCPU_STATIC_H */
@@ -65,6 +65,10 @@ extern struct urcu_gp urcu_qsbr_gp;
 struct urcu_qsbr_reader {
 	/* Data used by both reader and synchronize_rcu() */
 	unsigned long ctr;
+#ifdef CONFIG_RCU_READER_ARRAY
+	/* ctr and waiting used instead, set at registration. */
+	struct urcu_reader_slot *slot;
+#endif
 	/* Data used for registry */
 	struct cds_list_head node __attribute__((aligned(CAA_CACHE_LINE_SIZE)));
 	int waiting;
@@ -73,15 +77,30 @@ struct urcu_qsbr_reader {
 	unsigned int registered:1;
 };
 
-extern DECLARE_URCU_TLS(struct urcu_qsbr_reader, urcu_qsbr_reader);
+extern DECLARE_URCU_TLS_IE(struct urcu_qsbr_reader, urcu_qsbr_reader);
+
+/*
+ * Set by urcu_qsbr_enable_sys_membarrier(): grace periods then issue
+ * membarrier(2) in place of the memory barriers of the readers, which
+ * only need compiler barriers to report quiescent states.
+ */
+extern int urcu_qsbr_has_sys_membarrier;
+
+static inline void urcu_qsbr_smp_mb_slave(void)
+{
+	if (caa_likely(urcu_qsbr_has_sys_membarrier))
+		cmm_barrier();
+	else
+		cmm_smp_mb();
+}
 
 /*
  * Wake-up waiting synchronize_rcu(). Called from many concurrent threads.
  */
 static inline void urcu_qsbr_wake_up_gp(void)
 {
-	if (caa_unlikely(_CMM_LOAD_SHARED(URCU_TLS(urcu_qsbr_reader).waiting))) {
-		_CMM_STORE_SHARED(URCU_TLS(urcu_qsbr_reader).waiting, 0);
+	if (caa_unlikely(_CMM_LOAD_SHARED(URCU_READER_SHARED(URCU_TLS(urcu_qsbr_reader)).waiting))) {
+		_CMM_STORE_SHARED(URCU_READER_SHARED(URCU_TLS(urcu_qsbr_reader)).waiting, 0);
 		cmm_smp_mb();
 		if (uatomic_read(&urcu_qsbr_gp.futex) != -1)
 			return;
@@ -117,7 +136,7 @@ static inline enum urcu_state urcu_qsbr_reader_state(unsigned long *ctr)
  */
 static inline void _urcu_qsbr_read_lock(void)
 {
-	urcu_assert(URCU_TLS(urcu_qsbr_reader).ctr);
+	urcu_assert(URCU_READER_SHARED(URCU_TLS(urcu_qsbr_reader)).ctr);
 }
 
 /*
@@ -129,7 +148,7 @@ static inline void _urcu_qsbr_read_lock(void)
  */
 static inline void _urcu_qsbr_read_unlock(void)
 {
-	urcu_assert(URCU_TLS(urcu_qsbr_reader).ctr);
+	urcu_assert(URCU_READER_SHARED(URCU_TLS(urcu_qsbr_reader)).ctr);
 }
 
 /*
@@ -141,25 +160,30 @@ static inline void _urcu_qsbr_read_unlock(void)
  */
 static inline int _urcu_qsbr_read_ongoing(void)
 {
-	return URCU_TLS(urcu_qsbr_reader).ctr;
+#ifdef CONFIG_RCU_READER_ARRAY
+	if (!URCU_TLS(urcu_qsbr_reader).slot)
+		return 0;	/* Not registered. */
+#endif
+	return URCU_READER_SHARED(URCU_TLS(urcu_qsbr_reader)).ctr;
 }
 
 /*
  * This is a helper function for _rcu_quiescent_state().
- * The first cmm_smp_mb() ensures memory accesses in the prior read-side
+ * The first barrier ensures memory accesses in the prior read-side
  * critical sections are not reordered with store to
- * URCU_TLS(urcu_qsbr_reader).ctr, and ensures that mutexes held within an
+ * URCU_READER_SHARED(URCU_TLS(urcu_qsbr_reader)).ctr, and ensures that mutexes held within an
  * offline section that would happen to end with this
  * urcu_qsbr_quiescent_state() call are not reordered with
- * store to URCU_TLS(urcu_qsbr_reader).ctr.
+ * store to URCU_READER_SHARED(URCU_TLS(urcu_qsbr_reader)).ctr.
+ * These are compiler barriers once sys_membarrier is enabled.
  */
 static inline void _urcu_qsbr_quiescent_state_update_and_wakeup(unsigned long gp_ctr)
 {
-	cmm_smp_mb();
-	_CMM_STORE_SHARED(URCU_TLS(urcu_qsbr_reader).ctr, gp_ctr);
-	cmm_smp_mb();	/* write URCU_TLS(urcu_qsbr_reader).ctr before read futex */
+	urcu_qsbr_smp_mb_slave();
+	_CMM_STORE_SHARED(URCU_READER_SHARED(URCU_TLS(urcu_qsbr_reader)).ctr, gp_ctr);
+	urcu_qsbr_smp_mb_slave();	/* write URCU_READER_SHARED(URCU_TLS(urcu_qsbr_reader)).ctr before read futex */
 	urcu_qsbr_wake_up_gp();
-	cmm_smp_mb();
+	urcu_qsbr_smp_mb_slave();
 }
 
 /*
@@ -179,7 +203,7 @@ static inline void _urcu_qsbr_quiescent_state(void)
 	unsigned long gp_ctr;
 
 	urcu_assert(URCU_TLS(urcu_qsbr_reader).registered);
-	if ((gp_ctr = CMM_LOAD_SHARED(urcu_qsbr_gp.ctr)) == URCU_TLS(urcu_qsbr_reader).ctr)
+	if ((gp_ctr = CMM_LOAD_SHARED(urcu_qsbr_gp.ctr)) == URCU_READER_SHARED(URCU_TLS(urcu_qsbr_reader)).ctr)
 		return;
 	_urcu_qsbr_quiescent_state_update_and_wakeup(gp_ctr);
 }
@@ -195,9 +219,9 @@ static inline void _urcu_qsbr_quiescent_state(void)
 static inline void _urcu_qsbr_thread_offline(void)
 {
 	urcu_assert(URCU_TLS(urcu_qsbr_reader).registered);
-	cmm_smp_mb();
-	CMM_STORE_SHARED(URCU_TLS(urcu_qsbr_reader).ctr, 0);
-	cmm_smp_mb();	/* write URCU_TLS(urcu_qsbr_reader).ctr before read futex */
+	urcu_qsbr_smp_mb_slave();
+	CMM_STORE_SHARED(URCU_READER_SHARED(URCU_TLS(urcu_qsbr_reader)).ctr, 0);
+	urcu_qsbr_smp_mb_slave();	/* write URCU_READER_SHARED(URCU_TLS(urcu_qsbr_reader)).ctr before read futex */
 	urcu_qsbr_wake_up_gp();
 	cmm_barrier();	/* Ensure the compiler does not reorder us with mutex */
 }
@@ -214,8 +238,8 @@ static inline void _urcu_qsbr_thread_online(void)
 {
 	urcu_assert(URCU_TLS(urcu_qsbr_reader).registered);
 	cmm_barrier();	/* Ensure the compiler does not reorder us with mutex */
-	_CMM_STORE_SHARED(URCU_TLS(urcu_qsbr_reader).ctr, CMM_LOAD_SHARED(urcu_qsbr_gp.ctr));
-	cmm_smp_mb();
+	_CMM_STORE_SHARED(URCU_READER_SHARED(URCU_TLS(urcu_qsbr_reader)).ctr, CMM_LOAD_SHARED(urcu_qsbr_gp.ctr));
+	urcu_qsbr_smp_mb_slave();
 }
 
 #ifdef __cplusplus
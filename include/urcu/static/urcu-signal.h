@@ -72,20 +72,41 @@ extern "C" {
 
 extern struct urcu_gp urcu_signal_gp;
 
-extern DECLARE_URCU_TLS(struct urcu_reader, urcu_signal_reader);
+extern DECLARE_URCU_TLS_IE(struct urcu_reader, urcu_signal_reader);
+
+#ifdef CONFIG_RCU_CS_SAMPLING
+extern unsigned long urcu_signal_cs_sample_period;
+#endif
+
+/*
+ * Compiler barrier promoted to a memory barrier by the grace periods,
+ * except for readers registered as isolated, which are not signaled
+ * and issue full barriers themselves.
+ */
+static inline void urcu_signal_smp_mb_slave(void)
+{
+	if (caa_likely(!URCU_TLS(urcu_signal_reader).isolated))
+		cmm_barrier();
+	else
+		cmm_smp_mb();
+}
 
 /*
  * Helper for _rcu_read_lock().  The format of urcu_signal_gp.ctr (as well as
  * the per-thread rcu_reader.ctr) has the upper bits containing a count of
  * _rcu_read_lock() nesting, and a lower-order bit that contains either zero
- * or URCU_GP_CTR_PHASE.  The cmm_barrier() ensures that the accesses in
+ * or URCU_GP_CTR_PHASE.  The smp_mb_slave() ensures that the accesses in
  * _rcu_read_lock() happen before the subsequent read-side critical section.
  */
 static inline void _urcu_signal_read_lock_update(unsigned long tmp)
 {
 	if (caa_likely(!(tmp & URCU_GP_CTR_NEST_MASK))) {
 		_CMM_STORE_SHARED(URCU_TLS(urcu_signal_reader).ctr, _CMM_LOAD_SHARED(urcu_signal_gp.ctr));
-		cmm_barrier();
+		urcu_signal_smp_mb_slave();
+#ifdef CONFIG_RCU_CS_SAMPLING
+		urcu_common_cs_sample_lock(&URCU_TLS(urcu_signal_reader),
+			_CMM_LOAD_SHARED(urcu_signal_cs_sample_period));
+#endif
 	} else
 		_CMM_STORE_SHARED(URCU_TLS(urcu_signal_reader).ctr, tmp + URCU_GP_COUNT);
 }
@@ -114,17 +135,20 @@ static inline void _urcu_signal_read_lock(void)
 /*
  * This is a helper function for _rcu_read_unlock().
  *
- * The first cmm_barrier() call ensures that the critical section is
+ * The first smp_mb_slave() call ensures that the critical section is
  * seen to precede the store to rcu_reader.ctr.
- * The second cmm_barrier() call ensures that we write to rcu_reader.ctr
+ * The second smp_mb_slave() call ensures that we write to rcu_reader.ctr
  * before reading the update-side futex.
  */
 static inline void _urcu_signal_read_unlock_update_and_wakeup(unsigned long tmp)
 {
 	if (caa_likely((tmp & URCU_GP_CTR_NEST_MASK) == URCU_GP_COUNT)) {
-		cmm_barrier();
+#ifdef CONFIG_RCU_CS_SAMPLING
+		urcu_common_cs_sample_unlock(&URCU_TLS(urcu_signal_reader));
+#endif
+		urcu_signal_smp_mb_slave();
 		_CMM_STORE_SHARED(URCU_TLS(urcu_signal_reader).ctr, tmp - URCU_GP_COUNT);
-		cmm_barrier();
+		urcu_signal_smp_mb_slave();
 		urcu_common_wake_up_gp(&urcu_signal_gp);
 	} else
 		_CMM_STORE_SHARED(URCU_TLS(urcu_signal_reader).ctr, tmp - URCU_GP_COUNT);
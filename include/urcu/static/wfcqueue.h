@@ -30,9 +30,15 @@
 #include <pthread.h>
 #include <assert.h>
 #include <poll.h>
+#include <limits.h>
 #include <stdbool.h>
+#include <stdint.h>
+#include <errno.h>
+#include <time.h>
+#include <sched.h>
 #include <urcu/compiler.h>
 #include <urcu/uatomic.h>
+#include <urcu/futex.h>
 
 #ifdef __cplusplus
 extern "C" {
@@ -83,6 +89,29 @@ extern "C" {
 #define WFCQ_ADAPT_ATTEMPTS		10	/* Retry if being set */
 #define WFCQ_WAIT			10	/* Wait 10 ms if being set */
 
+/*
+ * Consumers finding an enqueue in progress, between the tail xchg and
+ * the store to the previous node's next pointer, first spin
+ * CDS_WFCQ_SPIN_ATTEMPTS times, then call sched_yield()
+ * CDS_WFCQ_YIELD_ATTEMPTS times, and then sleep, starting with
+ * CDS_WFCQ_SLEEP_MIN_NS and doubling up to CDS_WFCQ_SLEEP_MAX_NS. Within
+ * cds_wfcq_dequeue_timeout(), the sleeps are futex waits on the waiter,
+ * which cds_wfcq_enqueue_wake() ends as soon as the enqueue completes.
+ * LGPL users may #define these before including wfcqueue.h.
+ */
+#ifndef CDS_WFCQ_SPIN_ATTEMPTS
+#define CDS_WFCQ_SPIN_ATTEMPTS		WFCQ_ADAPT_ATTEMPTS
+#endif
+#ifndef CDS_WFCQ_YIELD_ATTEMPTS
+#define CDS_WFCQ_YIELD_ATTEMPTS		4
+#endif
+#ifndef CDS_WFCQ_SLEEP_MIN_NS
+#define CDS_WFCQ_SLEEP_MIN_NS		1000L		/* 1 us */
+#endif
+#ifndef CDS_WFCQ_SLEEP_MAX_NS
+#define CDS_WFCQ_SLEEP_MAX_NS		1000000L	/* 1 ms */
+#endif
+
 /*
  * cds_wfcq_node_init: initialize wait-free queue node.
  */
@@ -223,6 +252,115 @@ static inline bool _cds_wfcq_enqueue(cds_wfcq_head_ptr_t head,
 	return ___cds_wfcq_append(head, tail, new_tail, new_tail);
 }
 
+/*
+ * cds_wfcq_enqueue_batch: enqueue a chain of nodes into a wait-free queue.
+ *
+ * @first to @last must be linked through their next pointers by the
+ * caller, with @last->next set to NULL. The whole chain is published
+ * with a single xchg on the tail, so it appears atomically and in order
+ * to dequeuers.
+ *
+ * Issues a full memory barrier before enqueue. No mutual exclusion is
+ * required.
+ *
+ * Returns false if the queue was empty prior to adding the nodes.
+ * Returns true otherwise.
+ */
+static inline bool _cds_wfcq_enqueue_batch(cds_wfcq_head_ptr_t head,
+		struct cds_wfcq_tail *tail,
+		struct cds_wfcq_node *first,
+		struct cds_wfcq_node *last)
+{
+	assert(!last->next);
+	return ___cds_wfcq_append(head, tail, first, last);
+}
+
+/*
+ * cds_wfcq_waiter_init: initialize the waiter of a wait-free queue.
+ */
+static inline void _cds_wfcq_waiter_init(struct cds_wfcq_waiter *waiter)
+{
+	waiter->futex = 0;
+	waiter->nr_waiters = 0;
+	waiter->nr_sync_waiters = 0;
+	waiter->stats.busy_waits = 0;
+	waiter->stats.yields = 0;
+	waiter->stats.futex_waits = 0;
+	waiter->stats.wakeups = 0;
+}
+
+/*
+ * cds_wfcq_waiter_get_stats: read the wait statistics of a waiter.
+ */
+static inline void _cds_wfcq_waiter_get_stats(struct cds_wfcq_waiter *waiter,
+		struct cds_wfcq_wait_stats *stats)
+{
+	stats->busy_waits = uatomic_read(&waiter->stats.busy_waits);
+	stats->yields = uatomic_read(&waiter->stats.yields);
+	stats->futex_waits = uatomic_read(&waiter->stats.futex_waits);
+	stats->wakeups = uatomic_read(&waiter->stats.wakeups);
+}
+
+/*
+ * Wake up to @nr consumers waiting in cds_wfcq_dequeue_timeout(). Only
+ * issues a system call if a consumer is waiting. A consumer waiting for
+ * an enqueue to complete may be any of them, so all are woken up then.
+ */
+static inline void ___cds_wfcq_wake(struct cds_wfcq_waiter *waiter, int nr)
+{
+	int ret;
+
+	/* Write tail->p and next pointer before reading the waiter counts. */
+	cmm_smp_mb();
+	if (caa_likely(!CMM_LOAD_SHARED(waiter->nr_waiters)
+			&& !CMM_LOAD_SHARED(waiter->nr_sync_waiters)))
+		return;
+	if (CMM_LOAD_SHARED(waiter->nr_sync_waiters))
+		nr = INT_MAX;
+	uatomic_inc(&waiter->futex);
+	ret = futex_async(&waiter->futex, FUTEX_WAKE, nr, NULL, NULL, 0);
+	assert(ret >= 0);
+	(void) ret;
+	uatomic_inc(&waiter->stats.wakeups);
+}
+
+/*
+ * cds_wfcq_enqueue_wake: enqueue a node and wake up a waiting consumer.
+ *
+ * Same as cds_wfcq_enqueue(), waking up one consumer waiting on
+ * @waiter in cds_wfcq_dequeue_timeout(), if any.
+ */
+static inline bool _cds_wfcq_enqueue_wake(cds_wfcq_head_ptr_t head,
+		struct cds_wfcq_tail *tail,
+		struct cds_wfcq_waiter *waiter,
+		struct cds_wfcq_node *new_tail)
+{
+	bool ret;
+
+	ret = _cds_wfcq_enqueue(head, tail, new_tail);
+	___cds_wfcq_wake(waiter, 1);
+	return ret;
+}
+
+/*
+ * cds_wfcq_enqueue_batch_wake: enqueue a chain and wake up consumers.
+ *
+ * Same as cds_wfcq_enqueue_batch(), waking up all consumers waiting on
+ * @waiter in cds_wfcq_dequeue_timeout().
+ */
+static inline bool _cds_wfcq_enqueue_batch_wake(cds_wfcq_head_ptr_t head,
+		struct cds_wfcq_tail *tail,
+		struct cds_wfcq_waiter *waiter,
+		struct cds_wfcq_node *first,
+		struct cds_wfcq_node *last)
+{
+	bool ret;
+
+	ret = _cds_wfcq_enqueue_batch(head, tail, first, last);
+	___cds_wfcq_wake(waiter, INT_MAX);
+	return ret;
+}
+
 /*
  * CDS_WFCQ_WAIT_SLEEP:
  *
@@ -241,29 +379,122 @@ static inline void ___cds_wfcq_wait_sleep(int msec)
 }
 
 /*
- * ___cds_wfcq_busy_wait: adaptative busy-wait.
+ * CDS_WFCQ_WAIT_NANOSLEEP:
+ *
+ * Sleep stage of the wait for an enqueue in progress. By default, this
+ * sleeps for the given @nsec nanoseconds, or calls CDS_WFCQ_WAIT_SLEEP
+ * with the duration rounded up to milliseconds if it is defined. LGPL
+ * users may #define it themselves before including wfcqueue.h.
+ */
+#ifndef CDS_WFCQ_WAIT_NANOSLEEP
+#ifdef CDS_WFCQ_WAIT_SLEEP
+#define CDS_WFCQ_WAIT_NANOSLEEP(nsec) \
+	CDS_WFCQ_WAIT_SLEEP((int) (((nsec) + 999999) / 1000000))
+#else
+#define CDS_WFCQ_WAIT_NANOSLEEP(nsec) ___cds_wfcq_wait_nanosleep(nsec)
+#endif
+#endif
+
+static inline void ___cds_wfcq_wait_nanosleep(long nsec)
+{
+	struct timespec ts;
+
+	ts.tv_sec = nsec / 1000000000L;
+	ts.tv_nsec = nsec % 1000000000L;
+	(void) clock_nanosleep(CLOCK_MONOTONIC, 0, &ts, NULL);
+}
+
+/*
+ * Sleep for at most @nsec nanoseconds on @waiter while *@p is NULL,
+ * woken up by the enqueuer storing it with cds_wfcq_enqueue_wake().
+ */
+static inline void ___cds_wfcq_wait_enqueue(struct cds_wfcq_waiter *waiter,
+		struct cds_wfcq_node **p, long nsec)
+{
+	struct timespec ts;
+	int32_t seq;
+
+	ts.tv_sec = nsec / 1000000000L;
+	ts.tv_nsec = nsec % 1000000000L;
+	uatomic_inc(&waiter->nr_sync_waiters);
+	/* Write nr_sync_waiters before reading futex and *p. */
+	cmm_smp_mb();
+	seq = uatomic_read(&waiter->futex);
+	cmm_smp_mb();
+	if (!CMM_LOAD_SHARED(*p)) {
+		uatomic_inc(&waiter->stats.futex_waits);
+		if (futex_async(&waiter->futex, FUTEX_WAIT, seq, &ts, NULL, 0))
+			assert(errno == ETIMEDOUT || errno == EWOULDBLOCK
+				|| errno == EINTR);
+	}
+	uatomic_dec(&waiter->nr_sync_waiters);
+}
+
+/*
+ * ___cds_wfcq_busy_wait_waiter: adaptative wait for *@p to be set.
+ *
+ * Spins, yields, and then sleeps, on @waiter if not NULL, which also
+ * accounts the wait. @attempt is zero on the first call of each wait.
  *
  * Returns 1 if nonblocking and needs to block, 0 otherwise.
  */
 static inline bool
-___cds_wfcq_busy_wait(int *attempt, int blocking)
+___cds_wfcq_busy_wait_waiter(int *attempt, int blocking,
+		struct cds_wfcq_waiter *waiter, struct cds_wfcq_node **p)
 {
+	long nsec = CDS_WFCQ_SLEEP_MIN_NS;
+	int stage;
+
 	if (!blocking)
 		return 1;
-	if (++(*attempt) >= WFCQ_ADAPT_ATTEMPTS) {
-		CDS_WFCQ_WAIT_SLEEP(WFCQ_WAIT);		/* Wait for 10ms */
-		*attempt = 0;
-	} else {
+	stage = (*attempt)++;
+	if (stage < CDS_WFCQ_SPIN_ATTEMPTS) {
+		if (!stage && waiter)
+			uatomic_inc(&waiter->stats.busy_waits);
 		caa_cpu_relax();
+		return 0;
+	}
+	stage -= CDS_WFCQ_SPIN_ATTEMPTS;
+	if (stage < CDS_WFCQ_YIELD_ATTEMPTS) {
+		if (waiter)
+			uatomic_inc(&waiter->stats.yields);
+		(void) sched_yield();
+		return 0;
 	}
+	for (stage -= CDS_WFCQ_YIELD_ATTEMPTS; stage > 0; stage--) {
+		if (nsec >= CDS_WFCQ_SLEEP_MAX_NS / 2) {
+			nsec = CDS_WFCQ_SLEEP_MAX_NS;
+			/* Stop counting once the sleep stops growing. */
+			(*attempt)--;
+			break;
+		}
+		nsec <<= 1;
+	}
+	if (waiter)
+		___cds_wfcq_wait_enqueue(waiter, p, nsec);
+	else
+		CDS_WFCQ_WAIT_NANOSLEEP(nsec);
 	return 0;
 }
 
 /*
- * Waiting for enqueuer to complete enqueue and return the next node.
+ * ___cds_wfcq_busy_wait: adaptative busy-wait.
+ *
+ * Returns 1 if nonblocking and needs to block, 0 otherwise.
+ */
+static inline bool
+___cds_wfcq_busy_wait(int *attempt, int blocking)
+{
+	return ___cds_wfcq_busy_wait_waiter(attempt, blocking, NULL, NULL);
+}
+
+/*
+ * Waiting for enqueuer to complete enqueue and return the next node,
+ * sleeping on @waiter if not NULL.
  */
 static inline struct cds_wfcq_node *
-___cds_wfcq_node_sync_next(struct cds_wfcq_node *node, int blocking)
+___cds_wfcq_node_sync_next_waiter(struct cds_wfcq_node *node, int blocking,
+		struct cds_wfcq_waiter *waiter)
 {
 	struct cds_wfcq_node *next;
 	int attempt = 0;
@@ -272,13 +503,23 @@ ___cds_wfcq_node_sync_next(struct cds_wfcq_node *node, int blocking)
 	 * Adaptative busy-looping waiting for enqueuer to complete enqueue.
 	 */
 	while ((next = CMM_LOAD_SHARED(node->next)) == NULL) {
-		if (___cds_wfcq_busy_wait(&attempt, blocking))
+		if (___cds_wfcq_busy_wait_waiter(&attempt, blocking,
+				waiter, &node->next))
 			return CDS_WFCQ_WOULDBLOCK;
 	}
 
 	return next;
 }
 
+/*
+ * Waiting for enqueuer to complete enqueue and return the next node.
+ */
+static inline struct cds_wfcq_node *
+___cds_wfcq_node_sync_next(struct cds_wfcq_node *node, int blocking)
+{
+	return ___cds_wfcq_node_sync_next_waiter(node, blocking, NULL);
+}
+
 static inline struct cds_wfcq_node *
 ___cds_wfcq_first(cds_wfcq_head_ptr_t u_head,
 		struct cds_wfcq_tail *tail,
@@ -394,10 +635,11 @@ ___cds_wfcq_next_nonblocking(cds_wfcq_head_ptr_t head,
 }
 
 static inline struct cds_wfcq_node *
-___cds_wfcq_dequeue_with_state(cds_wfcq_head_ptr_t u_head,
+___cds_wfcq_dequeue_with_state_waiter(cds_wfcq_head_ptr_t u_head,
 		struct cds_wfcq_tail *tail,
 		int *state,
-		int blocking)
+		int blocking,
+		struct cds_wfcq_waiter *waiter)
 {
 	struct __cds_wfcq_head *head = u_head._h;
 	struct cds_wfcq_node *node, *next;
@@ -409,7 +651,7 @@ ___cds_wfcq_dequeue_with_state(cds_wfcq_head_ptr_t u_head,
 		return NULL;
 	}
 
-	node = ___cds_wfcq_node_sync_next(&head->node, blocking);
+	node = ___cds_wfcq_node_sync_next_waiter(&head->node, blocking, waiter);
 	if (!blocking && node == CDS_WFCQ_WOULDBLOCK) {
 		return CDS_WFCQ_WOULDBLOCK;
 	}
@@ -435,7 +677,7 @@ ___cds_wfcq_dequeue_with_state(cds_wfcq_head_ptr_t u_head,
 				*state |= CDS_WFCQ_STATE_LAST;
 			return node;
 		}
-		next = ___cds_wfcq_node_sync_next(node, blocking);
+		next = ___cds_wfcq_node_sync_next_waiter(node, blocking, waiter);
 		/*
 		 * In nonblocking mode, if we would need to block to
 		 * get node's next, set the head next node pointer
@@ -457,6 +699,16 @@ ___cds_wfcq_dequeue_with_state(cds_wfcq_head_ptr_t u_head,
 	return node;
 }
 
+static inline struct cds_wfcq_node *
+___cds_wfcq_dequeue_with_state(cds_wfcq_head_ptr_t head,
+		struct cds_wfcq_tail *tail,
+		int *state,
+		int blocking)
+{
+	return ___cds_wfcq_dequeue_with_state_waiter(head, tail, state,
+			blocking, NULL);
+}
+
 /*
  * __cds_wfcq_dequeue_with_state_blocking: dequeue node from queue, with state.
  *
@@ -486,6 +738,61 @@ ___cds_wfcq_dequeue_blocking(cds_wfcq_head_ptr_t head,
 	return ___cds_wfcq_dequeue_with_state_blocking(head, tail, NULL);
 }
 
+/*
+ * __cds_wfcq_dequeue_batch_blocking: dequeue up to max nodes from queue.
+ *
+ * Stores the dequeued nodes in order into nodes[], and returns their
+ * number, 0 if the queue is empty. The queue head is moved once past
+ * the nodes dequeued, and the tail only accessed if they include the
+ * last node of the queue. Same guarantees as
+ * __cds_wfcq_dequeue_blocking otherwise.
+ */
+static inline unsigned long
+___cds_wfcq_dequeue_batch_blocking(cds_wfcq_head_ptr_t u_head,
+		struct cds_wfcq_tail *tail,
+		struct cds_wfcq_node **nodes,
+		unsigned long max)
+{
+	struct __cds_wfcq_head *head = u_head._h;
+	struct cds_wfcq_node *node, *next;
+	unsigned long nr = 0;
+
+	if (!max || _cds_wfcq_empty(__cds_wfcq_head_cast(head), tail))
+		return 0;
+
+	node = ___cds_wfcq_node_sync_next(&head->node, 1);
+	for (;;) {
+		nodes[nr++] = node;
+		next = CMM_LOAD_SHARED(node->next);
+		if (!next || nr == max)
+			break;
+		/* Load node->next before loading next's content. */
+		cmm_smp_read_barrier_depends();
+		node = next;
+	}
+
+	if (!next) {
+		/*
+		 * @node is probably the last node of the queue: try to
+		 * move the tail to &q->head, as in
+		 * ___cds_wfcq_dequeue_with_state().
+		 */
+		_cds_wfcq_node_init(&head->node);
+		if (uatomic_cmpxchg(&tail->p, node, &head->node) == node)
+			return nr;
+		next = ___cds_wfcq_node_sync_next(node, 1);
+	}
+
+	/*
+	 * Move queue head forward.
+	 */
+	head->node.next = next;
+
+	/* Load q->head.next before loading node's content */
+	cmm_smp_read_barrier_depends();
+	return nr;
+}
+
 /*
  * __cds_wfcq_dequeue_with_state_nonblocking: dequeue node, with state.
  *
@@ -648,6 +955,28 @@ _cds_wfcq_dequeue_blocking(struct cds_wfcq_head *head,
 	return _cds_wfcq_dequeue_with_state_blocking(head, tail, NULL);
 }
 
+/*
+ * cds_wfcq_dequeue_batch_blocking: dequeue up to max nodes from a
+ * wait-free queue.
+ *
+ * Same as __cds_wfcq_dequeue_batch_blocking, with the dequeue lock
+ * taken once for all nodes.
+ */
+static inline unsigned long
+_cds_wfcq_dequeue_batch_blocking(struct cds_wfcq_head *head,
+		struct cds_wfcq_tail *tail,
+		struct cds_wfcq_node **nodes,
+		unsigned long max)
+{
+	unsigned long nr;
+
+	_cds_wfcq_dequeue_lock(head, tail);
+	nr = ___cds_wfcq_dequeue_batch_blocking(cds_wfcq_head_cast(head),
+			tail, nodes, max);
+	_cds_wfcq_dequeue_unlock(head, tail);
+	return nr;
+}
+
 /*
  * cds_wfcq_splice_blocking: enqueue all src_q nodes at the end of dest_q.
  *
@@ -676,6 +1005,78 @@ _cds_wfcq_splice_blocking(
 	return ret;
 }
 
+static inline uint64_t ___cds_wfcq_now_ms(void)
+{
+	struct timespec ts;
+	int ret;
+
+	ret = clock_gettime(CLOCK_MONOTONIC, &ts);
+	assert(!ret);
+	(void) ret;
+	return (uint64_t) ts.tv_sec * 1000 + ts.tv_nsec / 1000000;
+}
+
+/*
+ * cds_wfcq_dequeue_timeout: dequeue a node, waiting while queue is empty.
+ *
+ * Waits on @waiter until a node is enqueued with cds_wfcq_enqueue_wake()
+ * or cds_wfcq_enqueue_batch_wake(), or until @timeout_ms milliseconds
+ * have elapsed. A negative @timeout_ms waits forever, and 0 does not
+ * wait at all. Waiting consumers sleep in the kernel rather than
+ * busy-waiting.
+ *
+ * Returns NULL on timeout. Takes the dequeue lock only while dequeuing,
+ * so several consumers can wait on the same queue. While an enqueue is
+ * in progress, sleeps on @waiter until the enqueuer wakes it up.
+ * Issues a full memory barrier after dequeue.
+ */
+static inline struct cds_wfcq_node *
+_cds_wfcq_dequeue_timeout(struct cds_wfcq_head *head,
+		struct cds_wfcq_tail *tail,
+		struct cds_wfcq_waiter *waiter,
+		int timeout_ms)
+{
+	struct cds_wfcq_node *node;
+	struct timespec ts, *pts = NULL;
+	uint64_t deadline = 0, now;
+	int32_t seq;
+	bool timedout = false;
+
+	if (timeout_ms > 0)
+		deadline = ___cds_wfcq_now_ms() + timeout_ms;
+	for (;;) {
+		_cds_wfcq_dequeue_lock(head, tail);
+		node = ___cds_wfcq_dequeue_with_state_waiter(cds_wfcq_head_cast(head),
+				tail, NULL, 1, waiter);
+		_cds_wfcq_dequeue_unlock(head, tail);
+		if (node || !timeout_ms || timedout)
+			return node;
+		if (timeout_ms > 0) {
+			now = ___cds_wfcq_now_ms();
+			if (now >= deadline)
+				return NULL;
+			ts.tv_sec = (deadline - now) / 1000;
+			ts.tv_nsec = ((deadline - now) % 1000) * 1000000;
+			pts = &ts;
+		}
+		uatomic_inc(&waiter->nr_waiters);
+		/* Write nr_waiters before reading futex and tail->p. */
+		cmm_smp_mb();
+		seq = uatomic_read(&waiter->futex);
+		cmm_smp_mb();
+		if (_cds_wfcq_empty(cds_wfcq_head_cast(head), tail)
+				&& futex_async(&waiter->futex, FUTEX_WAIT, seq,
+					pts, NULL, 0)) {
+			/* Retry dequeue once more after a timeout. */
+			if (errno == ETIMEDOUT)
+				timedout = true;
+			else
+				assert(errno == EWOULDBLOCK || errno == EINTR);
+		}
+		uatomic_dec(&waiter->nr_waiters);
+	}
+}
+
 #ifdef __cplusplus
 }
 #endif
@@ -29,7 +29,9 @@
 #include <pthread.h>
 #include <assert.h>
 #include <poll.h>
+#include <sched.h>
 #include <stdbool.h>
+#include <time.h>
 #include <urcu/compiler.h>
 #include <urcu/uatomic.h>
 
@@ -41,6 +43,27 @@ extern "C" {
 #define CDS_WFS_ADAPT_ATTEMPTS		10	/* Retry if being set */
 #define CDS_WFS_WAIT			10	/* Wait 10 ms if being set */
 
+/*
+ * Poppers finding a push in progress, between the head xchg and the
+ * store to the next pointer, first spin CDS_WFS_SPIN_ATTEMPTS times,
+ * then call sched_yield() CDS_WFS_YIELD_ATTEMPTS times, and then
+ * sleep, starting with CDS_WFS_SLEEP_MIN_NS and doubling up to
+ * CDS_WFS_SLEEP_MAX_NS. LGPL users may #define these before including
+ * wfstack.h.
+ */
+#ifndef CDS_WFS_SPIN_ATTEMPTS
+#define CDS_WFS_SPIN_ATTEMPTS		CDS_WFS_ADAPT_ATTEMPTS
+#endif
+#ifndef CDS_WFS_YIELD_ATTEMPTS
+#define CDS_WFS_YIELD_ATTEMPTS		4
+#endif
+#ifndef CDS_WFS_SLEEP_MIN_NS
+#define CDS_WFS_SLEEP_MIN_NS		1000L		/* 1 us */
+#endif
+#ifndef CDS_WFS_SLEEP_MAX_NS
+#define CDS_WFS_SLEEP_MAX_NS		1000000L	/* 1 ms */
+#endif
+
 /*
  * Stack with wait-free push, blocking traversal.
  *
@@ -157,6 +180,72 @@ int _cds_wfs_push(cds_wfs_stack_ptr_t u_stack, struct cds_wfs_node *node)
 	return !___cds_wfs_end(old_head);
 }
 
+/*
+ * cds_wfs_push_batch: push a chain of nodes into the stack.
+ *
+ * @first to @last must be linked through their next pointers, with
+ * @last->next NULL: the chain is pushed with a single exchange, @first
+ * ending up on top of the stack. Issues a full memory barrier before
+ * push. No mutual exclusion is required.
+ *
+ * Returns 0 if the stack was empty prior to adding the nodes.
+ * Returns non-zero otherwise.
+ */
+static inline
+int _cds_wfs_push_batch(cds_wfs_stack_ptr_t u_stack,
+		struct cds_wfs_node *first, struct cds_wfs_node *last)
+{
+	struct __cds_wfs_stack *s = u_stack._s;
+	struct cds_wfs_head *old_head, *new_head;
+
+	assert(last->next == NULL);
+	new_head = caa_container_of(first, struct cds_wfs_head, node);
+	/*
+	 * uatomic_xchg() implicit memory barrier orders earlier stores
+	 * to the chain before publication.
+	 */
+	old_head = uatomic_xchg(&s->head, new_head);
+	/*
+	 * Dequeuers reaching @last busy-wait until its next pointer is
+	 * set to old_head, as for a single node.
+	 */
+	CMM_STORE_SHARED(last->next, &old_head->node);
+	return !___cds_wfs_end(old_head);
+}
+
+/*
+ * Adaptative wait for a push to complete: spins, yields, and then
+ * sleeps. @attempt is zero on the first call of each wait.
+ */
+static inline void ___cds_wfs_busy_wait(int *attempt)
+{
+	struct timespec ts;
+	long nsec = CDS_WFS_SLEEP_MIN_NS;
+	int stage = (*attempt)++;
+
+	if (stage < CDS_WFS_SPIN_ATTEMPTS) {
+		caa_cpu_relax();
+		return;
+	}
+	stage -= CDS_WFS_SPIN_ATTEMPTS;
+	if (stage < CDS_WFS_YIELD_ATTEMPTS) {
+		(void) sched_yield();
+		return;
+	}
+	for (stage -= CDS_WFS_YIELD_ATTEMPTS; stage > 0; stage--) {
+		if (nsec >= CDS_WFS_SLEEP_MAX_NS / 2) {
+			nsec = CDS_WFS_SLEEP_MAX_NS;
+			/* Stop counting once the sleep stops growing. */
+			(*attempt)--;
+			break;
+		}
+		nsec <<= 1;
+	}
+	ts.tv_sec = nsec / 1000000000L;
+	ts.tv_nsec = nsec % 1000000000L;
+	(void) clock_nanosleep(CLOCK_MONOTONIC, 0, &ts, NULL);
+}
+
 /*
  * Waiting for push to complete enqueue and return the next node.
  */
@@ -172,12 +261,7 @@ ___cds_wfs_node_sync_next(struct cds_wfs_node *node, int blocking)
 	while ((next = CMM_LOAD_SHARED(node->next)) == NULL) {
 		if (!blocking)
 			return CDS_WFS_WOULDBLOCK;
-		if (++attempt >= CDS_WFS_ADAPT_ATTEMPTS) {
-			(void) poll(NULL, 0, CDS_WFS_WAIT);	/* Wait for 10ms */
-			attempt = 0;
-		} else {
-			caa_cpu_relax();
-		}
+		___cds_wfs_busy_wait(&attempt);
 	}
 
 	return next;
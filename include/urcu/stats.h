@@ -0,0 +1,132 @@
+#ifndef _URCU_STATS_H
+#define _URCU_STATS_H
+
+/*
+ * urcu/stats.h
+ *
+ * Userspace RCU header - grace-period, call_rcu and read-side statistics
+ *
+ * This header is meant to be included indirectly through a liburcu
+ * flavor header.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*
+ * Grace-period duration histogram: bucket 0 counts grace periods
+ * shorter than 1 microsecond, bucket i counts grace periods lasting
+ * from 2^(i-1) to 2^i microseconds, and the last bucket counts all
+ * longer grace periods.
+ */
+#define URCU_STATS_GP_HIST_BUCKETS	24
+
+/*
+ * Read-side critical-section duration histogram, with the buckets of
+ * the grace-period histogram.
+ */
+#define URCU_STATS_CS_HIST_BUCKETS	URCU_STATS_GP_HIST_BUCKETS
+
+struct urcu_call_rcu_stats {
+	unsigned long qlen;		/* Callbacks queued, not invoked yet. */
+	unsigned long invoked;		/* Callbacks invoked. */
+	unsigned long batches;		/* Batches of callbacks invoked. */
+	unsigned long batch_max;	/* Largest batch. */
+	unsigned long stolen;		/* Of invoked, stolen from siblings. */
+	unsigned long throttled;	/* Producers waiting at qlen_limit. */
+	unsigned long rejected;		/* call_rcu_try() over qlen_limit. */
+	unsigned long gp_skipped;	/* Batches whose grace period had elapsed. */
+};
+
+/*
+ * Sampled invocations of one call_rcu() callback function, see
+ * call_rcu_set_func_sample_period().
+ */
+struct urcu_call_rcu_func_stats {
+	unsigned long samples;		/* Sampled invocations. */
+	uint64_t total_ns;		/* Their total duration. */
+	uint64_t max_ns;		/* Longest sampled. */
+};
+
+/*
+ * Contention on a mutex: acquisitions which found it locked, and the
+ * time they waited for it.
+ */
+struct urcu_lock_stats {
+	unsigned long acquisitions;
+	unsigned long contended;	/* Of acquisitions, had to wait. */
+	uint64_t wait_ns;		/* Total wait time. */
+	uint64_t wait_max_ns;		/* Longest wait. */
+};
+
+/*
+ * Snapshot of the statistics of a flavor. Counters are cumulative since
+ * the library was loaded, and are read without synchronization with
+ * the threads updating them.
+ */
+struct urcu_stats {
+	unsigned long gp_count;		/* Grace periods completed. */
+	unsigned long gp_expedited_count;	/* Of which expedited. */
+	unsigned long gp_futex_wait_count;	/* Sleeps waiting for readers. */
+	unsigned long gp_duration_hist[URCU_STATS_GP_HIST_BUCKETS];
+	/* Longest grace period, i.e. longest wait for pre-existing readers. */
+	uint64_t reader_wait_max_ns;
+	/* Summed over all call_rcu_data, batch_max is the largest one. */
+	struct urcu_call_rcu_stats call_rcu;
+	/*
+	 * Internal mutexes of the flavor: grace periods, reader registry,
+	 * call_rcu threads and defer_rcu queues.
+	 */
+	struct urcu_lock_stats gp_lock;
+	struct urcu_lock_stats registry_lock;
+	struct urcu_lock_stats call_rcu_lock;
+	struct urcu_lock_stats defer_lock;
+};
+
+/*
+ * Memory used by a flavor, see rcu_get_mem_stats(). Objects queued with
+ * call_rcu() and defer_rcu() are only accounted for in call_rcu_pending
+ * and defer_pending, except for the sizes given to call_rcu_sized().
+ */
+struct urcu_mem_stats {
+	size_t registry_bytes;		/* Reader registry on the heap. */
+	size_t call_rcu_bytes;		/* call_rcu_data and barriers. */
+	unsigned long call_rcu_pending;	/* Callbacks queued. */
+	size_t call_rcu_pending_bytes;	/* Of which sized, their sizes. */
+	size_t defer_bytes;		/* defer_rcu() thread queues. */
+	unsigned long defer_pending;	/* Entries in these queues. */
+};
+
+/*
+ * Sampled durations of the outermost read-side critical sections of a
+ * reader, see rcu_set_cs_sample_period().
+ */
+struct urcu_cs_stats {
+	unsigned long samples;		/* Sampled critical sections. */
+	unsigned long duration_hist[URCU_STATS_CS_HIST_BUCKETS];
+	uint64_t duration_max_ns;	/* Longest sampled. */
+};
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* _URCU_STATS_H */
@@ -0,0 +1,330 @@
+#ifndef _URCU_STD_RCU_HPP
+#define _URCU_STD_RCU_HPP
+
+/*
+ * urcu/std-rcu.hpp
+ *
+ * Userspace RCU library - C++ interface of the standard RCU (P2545)
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ *
+ * For use with URCU_API_MAP (API mapping of liburcu), include this file
+ * _after_ including your URCU flavor: urcu::rcu_default_domain() is
+ * then the domain of the current flavor. Note that the flavor maps
+ * rcu_barrier to its own name, which urcu::rcu_barrier follows.
+ */
+
+#if !defined(__cplusplus) || __cplusplus < 201402L
+#error "urcu/std-rcu.hpp requires C++14."
+#endif
+
+#include <atomic>
+#include <memory>
+#include <new>
+#include <type_traits>
+#include <utility>
+#include <urcu/rcu.hpp>
+
+namespace urcu {
+
+namespace detail {
+
+/*
+ * Head of the retired objects, queued on the reclaim class of their
+ * type with call_rcu_typed(): a single pointer.
+ */
+struct retire_node {
+	struct rcu_head_compact head;
+
+	static retire_node *from_head(struct rcu_head_compact *head)
+	{
+		/* Standard layout: head is at the address of the node. */
+		return reinterpret_cast<retire_node *>(head);
+	}
+};
+
+/* Reclaim class of a type retired in a domain, never freed. */
+struct retire_class {
+	struct call_rcu_class cls;
+	retire_class *next;
+};
+
+/*
+ * Deleter of a retired rcu_obj_base, stored from retire() to its
+ * invocation. Empty default-constructible deleters take no room: they
+ * are constructed again at invocation.
+ */
+template<class D, bool = std::is_empty<D>::value
+	&& std::is_default_constructible<D>::value>
+class deleter_slot {
+protected:
+	void store_deleter(D &&d) noexcept
+	{
+		new (&buf_) D(std::move(d));
+	}
+
+	D take_deleter() noexcept
+	{
+		D *p = reinterpret_cast<D *>(&buf_);
+		D d(std::move(*p));
+
+		p->~D();
+		return d;
+	}
+
+private:
+	typename std::aligned_storage<sizeof(D), alignof(D)>::type buf_;
+};
+
+template<class D>
+class deleter_slot<D, true> {
+protected:
+	void store_deleter(D &&) noexcept
+	{
+	}
+
+	D take_deleter() noexcept
+	{
+		return D();
+	}
+};
+
+/* Retired pointer not embedding a head, allocated by rcu_retire(). */
+template<class T, class D>
+struct retire_holder : retire_node {
+	retire_holder(T *p, D &&d) : ptr(p), deleter(std::move(d))
+	{
+	}
+
+	static void reclaim(struct rcu_head_compact *list)
+	{
+		struct rcu_head_compact *pos, *p;
+
+		rcu_head_compact_for_each_safe(list, pos, p) {
+			retire_holder *holder = static_cast<retire_holder *>(
+					retire_node::from_head(pos));
+
+			holder->deleter(holder->ptr);
+			delete holder;
+		}
+	}
+
+	T *ptr;
+	D deleter;
+};
+
+} /* namespace detail */
+
+/*
+ * RCU domain of the Flavor traits, a Lockable type whose lock() and
+ * unlock() enter and leave a read-side critical section, e.g. held by a
+ * std::lock_guard. There is one domain per flavor, returned by
+ * rcu_flavor_domain<Flavor>(), or rcu_default_domain() for the current
+ * flavor.
+ *
+ * Objects retired in the domain are queued with call_rcu_typed() on a
+ * reclaim class per type, created on first use: they carry a single
+ * pointer rather than a struct rcu_head, and each class needs a single
+ * call_rcu() callback per grace period. rcu_barrier() waits for the
+ * reclaim classes of the domain.
+ */
+template<class Flavor>
+class basic_rcu_domain {
+public:
+	basic_rcu_domain(const basic_rcu_domain &) = delete;
+	basic_rcu_domain &operator=(const basic_rcu_domain &) = delete;
+
+	void lock() noexcept
+	{
+		Flavor::read_lock();
+	}
+
+	bool try_lock() noexcept
+	{
+		lock();
+		return true;
+	}
+
+	void unlock() noexcept
+	{
+		Flavor::read_unlock();
+	}
+
+	/* Reclaim class of the objects reclaimed by Func. */
+	template<void (*Func)(struct rcu_head_compact *list)>
+	struct call_rcu_class *retire_class()
+	{
+		static detail::retire_class *cls = add_class(Func);
+
+		return &cls->cls;
+	}
+
+	/* Wait for the objects retired in the domain before the call. */
+	void barrier() noexcept
+	{
+		detail::retire_class *cls;
+
+		/*
+		 * Classes are never removed, and those added meanwhile
+		 * only hold objects retired after the call.
+		 */
+		for (cls = classes_.load(std::memory_order_acquire); cls;
+				cls = cls->next)
+			Flavor::barrier_class(&cls->cls);
+	}
+
+	static basic_rcu_domain &instance() noexcept
+	{
+		static basic_rcu_domain domain;
+
+		return domain;
+	}
+
+private:
+	basic_rcu_domain() : classes_(nullptr)
+	{
+	}
+
+	detail::retire_class *add_class(
+			void (*func)(struct rcu_head_compact *list))
+	{
+		detail::retire_class *cls = new detail::retire_class;
+
+		Flavor::class_init(&cls->cls, func);
+		cls->next = classes_.load(std::memory_order_relaxed);
+		while (!classes_.compare_exchange_weak(cls->next, cls,
+				std::memory_order_release,
+				std::memory_order_relaxed))
+			;
+		return cls;
+	}
+
+	std::atomic<detail::retire_class *> classes_;
+};
+
+template<class Flavor>
+basic_rcu_domain<Flavor> &rcu_flavor_domain() noexcept
+{
+	return basic_rcu_domain<Flavor>::instance();
+}
+
+/*
+ * Base of the objects of type T retired with retire(), which invokes
+ * the deleter D on the object after a grace period. The base only holds
+ * the head queued on the reclaim class of T: a pointer, and the deleter
+ * if D is not an empty default-constructible type.
+ */
+template<class T, class D = std::default_delete<T>>
+class rcu_obj_base : private detail::retire_node,
+		private detail::deleter_slot<D> {
+public:
+	template<class Flavor>
+	void retire(D d, basic_rcu_domain<Flavor> &dom) noexcept
+	{
+		this->store_deleter(std::move(d));
+		Flavor::call_typed(dom.template retire_class<reclaim>(),
+			&static_cast<detail::retire_node *>(this)->head);
+	}
+
+#ifdef URCU_API_MAP
+	void retire(D d = D()) noexcept
+	{
+		retire(std::move(d), rcu_flavor_domain<default_flavor>());
+	}
+#endif
+
+protected:
+	rcu_obj_base() = default;
+	rcu_obj_base(const rcu_obj_base &) = default;
+	rcu_obj_base(rcu_obj_base &&) = default;
+	rcu_obj_base &operator=(const rcu_obj_base &) = default;
+	rcu_obj_base &operator=(rcu_obj_base &&) = default;
+	~rcu_obj_base() = default;
+
+private:
+	static void reclaim(struct rcu_head_compact *list)
+	{
+		struct rcu_head_compact *pos, *p;
+
+		rcu_head_compact_for_each_safe(list, pos, p) {
+			rcu_obj_base *obj = static_cast<rcu_obj_base *>(
+					detail::retire_node::from_head(pos));
+			D d(obj->take_deleter());
+
+			d(static_cast<T *>(obj));
+		}
+	}
+};
+
+/* Wait for a grace period of the domain. */
+template<class Flavor>
+void rcu_synchronize(basic_rcu_domain<Flavor> &) noexcept
+{
+	Flavor::synchronize();
+}
+
+/*
+ * Wait for the invocation of the deleters of the objects retired in the
+ * domain before the call, from any thread.
+ */
+template<class Flavor>
+void rcu_barrier(basic_rcu_domain<Flavor> &dom) noexcept
+{
+	dom.barrier();
+}
+
+/*
+ * Invoke the deleter d on p after a grace period of the domain. The
+ * pointer is queued in a holder allocated with new: throws
+ * std::bad_alloc if allocation fails.
+ */
+template<class T, class D, class Flavor>
+void rcu_retire(T *p, D d, basic_rcu_domain<Flavor> &dom)
+{
+	typedef detail::retire_holder<T, D> holder;
+	holder *h = new holder(p, std::move(d));
+
+	Flavor::call_typed(dom.template retire_class<holder::reclaim>(),
+		&h->head);
+}
+
+#ifdef URCU_API_MAP
+typedef basic_rcu_domain<default_flavor> rcu_domain;
+
+inline rcu_domain &rcu_default_domain() noexcept
+{
+	return rcu_flavor_domain<default_flavor>();
+}
+
+inline void rcu_synchronize() noexcept
+{
+	rcu_synchronize(rcu_default_domain());
+}
+
+inline void rcu_barrier() noexcept
+{
+	rcu_barrier(rcu_default_domain());
+}
+
+template<class T, class D = std::default_delete<T>>
+void rcu_retire(T *p, D d = D())
+{
+	rcu_retire(p, std::move(d), rcu_default_domain());
+}
+#endif /* URCU_API_MAP */
+
+} /* namespace urcu */
+
+#endif /* _URCU_STD_RCU_HPP */
@@ -64,14 +64,46 @@ extern "C" {
  * handlers setup with with sigaltstack(2).
  */
 
+/*
+ * CONFIG_RCU_TLS is detected with the C compiler, and may be the C11
+ * _Thread_local, which C++ does not have: C++ uses the equivalent GNU
+ * storage class instead.
+ */
+# ifdef __cplusplus
+#  define URCU_TLS_STORAGE_CLASS	__thread
+# else
+#  define URCU_TLS_STORAGE_CLASS	CONFIG_RCU_TLS
+# endif
+
 # define DECLARE_URCU_TLS(type, name)	\
-	CONFIG_RCU_TLS type name
+	URCU_TLS_STORAGE_CLASS type name
 
 # define DEFINE_URCU_TLS(type, name)	\
-	CONFIG_RCU_TLS type name
+	URCU_TLS_STORAGE_CLASS type name
 
 # define URCU_TLS(name)		(name)
 
+/*
+ * Reader state touched by every read-side critical section. With
+ * CONFIG_RCU_TLS_INITIAL_EXEC, it uses the initial-exec TLS model, so
+ * accesses from shared objects, liburcu included, are a fixed offset
+ * from the thread pointer rather than a __tls_get_addr() call. Shared
+ * objects defining such variables then have to be loaded at program
+ * startup, or dlopen() may fail to find room in the static TLS block.
+ */
+# ifdef CONFIG_RCU_TLS_INITIAL_EXEC
+#  define URCU_TLS_MODEL_INITIAL_EXEC	\
+	__attribute__((tls_model("initial-exec")))
+# else
+#  define URCU_TLS_MODEL_INITIAL_EXEC
+# endif
+
+# define DECLARE_URCU_TLS_IE(type, name)	\
+	URCU_TLS_STORAGE_CLASS type name URCU_TLS_MODEL_INITIAL_EXEC
+
+# define DEFINE_URCU_TLS_IE(type, name)	\
+	URCU_TLS_STORAGE_CLASS type name URCU_TLS_MODEL_INITIAL_EXEC
+
 #else /* #ifndef CONFIG_RCU_TLS */
 
 /*
@@ -127,6 +159,12 @@ struct urcu_tls {
 # define DEFINE_URCU_TLS(type, name)				\
 	DEFINE_URCU_TLS_1(type, name)
 
+/* The TLS model only applies to compiler TLS. */
+# define DECLARE_URCU_TLS_IE(type, name)			\
+	DECLARE_URCU_TLS(type, name)
+# define DEFINE_URCU_TLS_IE(type, name)				\
+	DEFINE_URCU_TLS(type, name)
+
 # define URCU_TLS_1(name)	(*__tls_access_ ## name())
 
 # define URCU_TLS(name)		URCU_TLS_1(name)
@@ -22,6 +22,7 @@
  * Boehm-Demers-Weiser conservative garbage collector.
  */
 
+#include <stdint.h>
 #include <urcu/compiler.h>
 #include <urcu/system.h>
 
@@ -32,6 +33,364 @@ extern "C" {
 #define UATOMIC_HAS_ATOMIC_BYTE
 #define UATOMIC_HAS_ATOMIC_SHORT
 
+/*
+ * ARMv8.1 LSE atomics (cas, swp, ldadd, ldclr, ldset) scale better than
+ * LL/SC loops on contended cache lines. They are used unconditionally when
+ * the compiler targets them, otherwise when the kernel reports them in
+ * HWCAP, as detected by compat_arch_aarch64.c. The LL/SC fallback is used
+ * until detection has run: both kinds of atomics can be mixed on the same
+ * memory location.
+ *
+ * The acquire-release (al) forms are fully ordered, as the LL/SC
+ * fallback which is followed by a dmb.
+ */
+#ifdef __ARM_FEATURE_ATOMICS
+#define URCU_ARM64_LSE_AVAIL	1
+#else
+extern int __urcu_arm64_lse_avail;
+#define URCU_ARM64_LSE_AVAIL	caa_likely(__urcu_arm64_lse_avail > 0)
+#endif
+
+#define URCU_ARM64_LSE_PREAMBLE	".arch_extension lse\n\t"
+
+/* insn Ws, Wt, [Xn]: store op(v) into *addr, return the old value. */
+#define __uatomic_lse_rmw(insn, w, type, addr, v)			\
+	__extension__							\
+	({								\
+		type __old;						\
+									\
+		__asm__ __volatile__(					\
+			URCU_ARM64_LSE_PREAMBLE				\
+			insn " %" w "2, %" w "0, %1"			\
+			: "=&r" (__old), "+Q" (*(type *) (addr))	\
+			: "r" ((type) (v))				\
+			: "memory");					\
+		__old;							\
+	})
+
+#define __uatomic_lse_cas(insn, w, type, addr, old, _new)		\
+	__extension__							\
+	({								\
+		type __old = (type) (old);				\
+									\
+		__asm__ __volatile__(					\
+			URCU_ARM64_LSE_PREAMBLE				\
+			insn " %" w "0, %" w "2, %1"			\
+			: "+r" (__old), "+Q" (*(type *) (addr))		\
+			: "r" ((type) (_new))				\
+			: "memory");					\
+		__old;							\
+	})
+
+/* cmpxchg */
+
+static inline __attribute__((always_inline))
+unsigned long _uatomic_cmpxchg(void *addr, unsigned long old,
+			      unsigned long _new, int len)
+{
+	if (URCU_ARM64_LSE_AVAIL) {
+		switch (len) {
+		case 1:
+			return __uatomic_lse_cas("casalb", "w", uint8_t,
+					addr, old, _new);
+		case 2:
+			return __uatomic_lse_cas("casalh", "w", uint16_t,
+					addr, old, _new);
+		case 4:
+			return __uatomic_lse_cas("casal", "w", uint32_t,
+					addr, old, _new);
+#if (CAA_BITS_PER_LONG == 64)
+		case 8:
+			return __uatomic_lse_cas("casal", "x", uint64_t,
+					addr, old, _new);
+#endif
+		}
+	}
+	switch (len) {
+	case 1:
+		return __sync_val_compare_and_swap_1((uint8_t *) addr, old,
+				_new);
+	case 2:
+		return __sync_val_compare_and_swap_2((uint16_t *) addr, old,
+				_new);
+	case 4:
+		return __sync_val_compare_and_swap_4((uint32_t *) addr, old,
+				_new);
+#if (CAA_BITS_PER_LONG == 64)
+	case 8:
+		return __sync_val_compare_and_swap_8((uint64_t *) addr, old,
+				_new);
+#endif
+	}
+	__builtin_trap();
+	return 0;
+}
+
+#define uatomic_cmpxchg(addr, old, _new)				      \
+	((__typeof__(*(addr))) _uatomic_cmpxchg((addr),			      \
+						caa_cast_long_keep_sign(old), \
+						caa_cast_long_keep_sign(_new),\
+						sizeof(*(addr))))
+
+/* xchg */
+
+static inline __attribute__((always_inline))
+unsigned long _uatomic_exchange(void *addr, unsigned long val, int len)
+{
+	unsigned long old;
+
+	if (URCU_ARM64_LSE_AVAIL) {
+		switch (len) {
+		case 1:
+			return __uatomic_lse_rmw("swpalb", "w", uint8_t,
+					addr, val);
+		case 2:
+			return __uatomic_lse_rmw("swpalh", "w", uint16_t,
+					addr, val);
+		case 4:
+			return __uatomic_lse_rmw("swpal", "w", uint32_t,
+					addr, val);
+#if (CAA_BITS_PER_LONG == 64)
+		case 8:
+			return __uatomic_lse_rmw("swpal", "x", uint64_t,
+					addr, val);
+#endif
+		}
+	}
+	do {
+		switch (len) {
+		case 1:
+			old = CMM_LOAD_SHARED(*(uint8_t *) addr);
+			break;
+		case 2:
+			old = CMM_LOAD_SHARED(*(uint16_t *) addr);
+			break;
+		case 4:
+			old = CMM_LOAD_SHARED(*(uint32_t *) addr);
+			break;
+#if (CAA_BITS_PER_LONG == 64)
+		case 8:
+			old = CMM_LOAD_SHARED(*(uint64_t *) addr);
+			break;
+#endif
+		default:
+			__builtin_trap();
+		}
+	} while (_uatomic_cmpxchg(addr, old, val, len) != old);
+	return old;
+}
+
+#define uatomic_xchg(addr, v)						    \
+	((__typeof__(*(addr))) _uatomic_exchange((addr),		    \
+						caa_cast_long_keep_sign(v), \
+						sizeof(*(addr))))
+
+/* uatomic_and */
+
+static inline __attribute__((always_inline))
+void _uatomic_and(void *addr, unsigned long val, int len)
+{
+	if (URCU_ARM64_LSE_AVAIL) {
+		switch (len) {
+		case 1:
+			(void) __uatomic_lse_rmw("ldclralb", "w", uint8_t,
+					addr, ~val);
+			return;
+		case 2:
+			(void) __uatomic_lse_rmw("ldclralh", "w", uint16_t,
+					addr, ~val);
+			return;
+		case 4:
+			(void) __uatomic_lse_rmw("ldclral", "w", uint32_t,
+					addr, ~val);
+			return;
+#if (CAA_BITS_PER_LONG == 64)
+		case 8:
+			(void) __uatomic_lse_rmw("ldclral", "x", uint64_t,
+					addr, ~val);
+			return;
+#endif
+		}
+	}
+	switch (len) {
+	case 1:
+		__sync_and_and_fetch_1((uint8_t *) addr, val);
+		return;
+	case 2:
+		__sync_and_and_fetch_2((uint16_t *) addr, val);
+		return;
+	case 4:
+		__sync_and_and_fetch_4((uint32_t *) addr, val);
+		return;
+#if (CAA_BITS_PER_LONG == 64)
+	case 8:
+		__sync_and_and_fetch_8((uint64_t *) addr, val);
+		return;
+#endif
+	}
+	__builtin_trap();
+}
+
+#define uatomic_and(addr, v)			\
+	(_uatomic_and((addr),			\
+		caa_cast_long_keep_sign(v),	\
+		sizeof(*(addr))))
+#define cmm_smp_mb__before_uatomic_and()	cmm_barrier()
+#define cmm_smp_mb__after_uatomic_and()		cmm_barrier()
+
+/* uatomic_or */
+
+static inline __attribute__((always_inline))
+void _uatomic_or(void *addr, unsigned long val, int len)
+{
+	if (URCU_ARM64_LSE_AVAIL) {
+		switch (len) {
+		case 1:
+			(void) __uatomic_lse_rmw("ldsetalb", "w", uint8_t,
+					addr, val);
+			return;
+		case 2:
+			(void) __uatomic_lse_rmw("ldsetalh", "w", uint16_t,
+					addr, val);
+			return;
+		case 4:
+			(void) __uatomic_lse_rmw("ldsetal", "w", uint32_t,
+					addr, val);
+			return;
+#if (CAA_BITS_PER_LONG == 64)
+		case 8:
+			(void) __uatomic_lse_rmw("ldsetal", "x", uint64_t,
+					addr, val);
+			return;
+#endif
+		}
+	}
+	switch (len) {
+	case 1:
+		__sync_or_and_fetch_1((uint8_t *) addr, val);
+		return;
+	case 2:
+		__sync_or_and_fetch_2((uint16_t *) addr, val);
+		return;
+	case 4:
+		__sync_or_and_fetch_4((uint32_t *) addr, val);
+		return;
+#if (CAA_BITS_PER_LONG == 64)
+	case 8:
+		__sync_or_and_fetch_8((uint64_t *) addr, val);
+		return;
+#endif
+	}
+	__builtin_trap();
+}
+
+#define uatomic_or(addr, v)			\
+	(_uatomic_or((addr),			\
+		caa_cast_long_keep_sign(v),	\
+		sizeof(*(addr))))
+#define cmm_smp_mb__before_uatomic_or()		cmm_barrier()
+#define cmm_smp_mb__after_uatomic_or()		cmm_barrier()
+
+/* uatomic_add_return */
+
+static inline __attribute__((always_inline))
+unsigned long _uatomic_add_return(void *addr, unsigned long val, int len)
+{
+	if (URCU_ARM64_LSE_AVAIL) {
+		switch (len) {
+		case 1:
+			return (uint8_t) (__uatomic_lse_rmw("ldaddalb", "w",
+					uint8_t, addr, val) + val);
+		case 2:
+			return (uint16_t) (__uatomic_lse_rmw("ldaddalh", "w",
+					uint16_t, addr, val) + val);
+		case 4:
+			return (uint32_t) (__uatomic_lse_rmw("ldaddal", "w",
+					uint32_t, addr, val) + val);
+#if (CAA_BITS_PER_LONG == 64)
+		case 8:
+			return __uatomic_lse_rmw("ldaddal", "x", uint64_t,
+					addr, val) + val;
+#endif
+		}
+	}
+	switch (len) {
+	case 1:
+		return __sync_add_and_fetch_1((uint8_t *) addr, val);
+	case 2:
+		return __sync_add_and_fetch_2((uint16_t *) addr, val);
+	case 4:
+		return __sync_add_and_fetch_4((uint32_t *) addr, val);
+#if (CAA_BITS_PER_LONG == 64)
+	case 8:
+		return __sync_add_and_fetch_8((uint64_t *) addr, val);
+#endif
+	}
+	__builtin_trap();
+	return 0;
+}
+
+#define uatomic_add_return(addr, v)					    \
+	((__typeof__(*(addr))) _uatomic_add_return((addr),		    \
+						caa_cast_long_keep_sign(v), \
+						sizeof(*(addr))))
+
+#if (CAA_BITS_PER_LONG == 64)
+/* Double-word cmpxchg */
+#define UATOMIC_HAS_ATOMIC_DOUBLE
+
+static inline __attribute__((always_inline))
+int _uatomic_cmpxchg_double(void *addr, unsigned long *old,
+			    unsigned long new_lo, unsigned long new_hi)
+{
+	unsigned long lo, hi;
+	unsigned int tmp;
+
+	if (URCU_ARM64_LSE_AVAIL) {
+		/* casp needs consecutive even-numbered register pairs. */
+		register unsigned long x0 __asm__("x0") = old[0];
+		register unsigned long x1 __asm__("x1") = old[1];
+		register unsigned long x2 __asm__("x2") = new_lo;
+		register unsigned long x3 __asm__("x3") = new_hi;
+
+		__asm__ __volatile__(
+			URCU_ARM64_LSE_PREAMBLE
+			"caspal %0, %1, %3, %4, %2"
+			: "+r" (x0), "+r" (x1), "+Q" (*(__uint128_t *) addr)
+			: "r" (x2), "r" (x3)
+			: "memory");
+		lo = x0;
+		hi = x1;
+	} else {
+		unsigned long tlo, thi;
+
+		/*
+		 * Store back the value read on mismatch, so the value
+		 * returned is read atomically.
+		 */
+		__asm__ __volatile__(
+			"1:	ldxp	%0, %1, %5\n\t"
+			"	cmp	%0, %6\n\t"
+			"	ccmp	%1, %7, #0, eq\n\t"
+			"	csel	%2, %8, %0, eq\n\t"
+			"	csel	%3, %9, %1, eq\n\t"
+			"	stlxp	%w4, %2, %3, %5\n\t"
+			"	cbnz	%w4, 1b\n\t"
+			"	dmb	ish"
+			: "=&r" (lo), "=&r" (hi), "=&r" (tlo), "=&r" (thi),
+			  "=&r" (tmp), "+Q" (*(__uint128_t *) addr)
+			: "r" (old[0]), "r" (old[1]),
+			  "r" (new_lo), "r" (new_hi)
+			: "cc", "memory");
+	}
+	if (lo == old[0] && hi == old[1])
+		return 1;
+	old[0] = lo;
+	old[1] = hi;
+	return 0;
+}
+#endif
+
 #ifdef __cplusplus
 }
 #endif
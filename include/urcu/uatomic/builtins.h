@@ -0,0 +1,153 @@
+#ifndef _URCU_UATOMIC_BUILTINS_H
+#define _URCU_UATOMIC_BUILTINS_H
+
+/*
+ * urcu/uatomic/builtins.h
+ *
+ * Atomic operations implemented with the compiler __atomic builtins.
+ * Selected by configure with --enable-compiler-atomic-builtins.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+#include <urcu/compiler.h>
+#include <urcu/system.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define UATOMIC_HAS_ATOMIC_BYTE
+#define UATOMIC_HAS_ATOMIC_SHORT
+
+/*
+ * A sequentially consistent read-modify-write does not order the
+ * surrounding plain accesses on every architecture, while the uatomic
+ * API promises a full barrier around cmpxchg, xchg and add_return.
+ * Locked instructions already are full barriers on x86.
+ */
+#if defined(__i386__) || defined(__x86_64__)
+#define _uatomic_rmw_fence()	cmm_barrier()
+#else
+#define _uatomic_rmw_fence()	__atomic_thread_fence(__ATOMIC_SEQ_CST)
+#endif
+
+#define uatomic_load_acquire(addr)					\
+	__atomic_load_n((addr), __ATOMIC_ACQUIRE)
+#define uatomic_store_release(addr, v)					\
+	__atomic_store_n((addr), (v), __ATOMIC_RELEASE)
+
+/* cmpxchg */
+
+#define _uatomic_cmpxchg_mo(addr, old, _new, mos, mof)			\
+	__extension__							\
+	({								\
+		__typeof__(*(addr)) __old =				\
+			(__typeof__(*(addr))) (old);			\
+									\
+		(void) __atomic_compare_exchange_n((addr), &__old,	\
+				(_new), 0, (mos), (mof));		\
+		__old;							\
+	})
+
+#define uatomic_cmpxchg(addr, old, _new)				\
+	__extension__							\
+	({								\
+		__typeof__(*(addr)) __ret = _uatomic_cmpxchg_mo(addr,	\
+				old, _new, __ATOMIC_SEQ_CST,		\
+				__ATOMIC_SEQ_CST);			\
+		_uatomic_rmw_fence();					\
+		__ret;							\
+	})
+#define uatomic_cmpxchg_relaxed(addr, old, _new)			\
+	_uatomic_cmpxchg_mo(addr, old, _new, __ATOMIC_RELAXED,		\
+			__ATOMIC_RELAXED)
+#define uatomic_cmpxchg_acquire(addr, old, _new)			\
+	_uatomic_cmpxchg_mo(addr, old, _new, __ATOMIC_ACQUIRE,		\
+			__ATOMIC_ACQUIRE)
+#define uatomic_cmpxchg_release(addr, old, _new)			\
+	_uatomic_cmpxchg_mo(addr, old, _new, __ATOMIC_RELEASE,		\
+			__ATOMIC_RELAXED)
+
+/* xchg */
+
+#define uatomic_xchg(addr, v)						\
+	__extension__							\
+	({								\
+		__typeof__(*(addr)) __ret = __atomic_exchange_n((addr),	\
+				(v), __ATOMIC_SEQ_CST);			\
+		_uatomic_rmw_fence();					\
+		__ret;							\
+	})
+#define uatomic_xchg_relaxed(addr, v)					\
+	__atomic_exchange_n((addr), (v), __ATOMIC_RELAXED)
+#define uatomic_xchg_acquire(addr, v)					\
+	__atomic_exchange_n((addr), (v), __ATOMIC_ACQUIRE)
+#define uatomic_xchg_release(addr, v)					\
+	__atomic_exchange_n((addr), (v), __ATOMIC_RELEASE)
+
+/* add_return */
+
+#define uatomic_add_return(addr, v)					\
+	__extension__							\
+	({								\
+		__typeof__(*(addr)) __ret = __atomic_add_fetch((addr),	\
+				(v), __ATOMIC_SEQ_CST);			\
+		_uatomic_rmw_fence();					\
+		__ret;							\
+	})
+#define uatomic_add_return_relaxed(addr, v)				\
+	__atomic_add_fetch((addr), (v), __ATOMIC_RELAXED)
+#define uatomic_add_return_acquire(addr, v)				\
+	__atomic_add_fetch((addr), (v), __ATOMIC_ACQUIRE)
+#define uatomic_add_return_release(addr, v)				\
+	__atomic_add_fetch((addr), (v), __ATOMIC_RELEASE)
+
+/* and, or, add: no barrier unless explicitly requested. */
+
+#define uatomic_and(addr, v)						\
+	((void) __atomic_and_fetch((addr), (v), __ATOMIC_RELAXED))
+#define uatomic_and_acquire(addr, v)					\
+	((void) __atomic_and_fetch((addr), (v), __ATOMIC_ACQUIRE))
+#define uatomic_and_release(addr, v)					\
+	((void) __atomic_and_fetch((addr), (v), __ATOMIC_RELEASE))
+#define cmm_smp_mb__before_uatomic_and()	_uatomic_rmw_fence()
+#define cmm_smp_mb__after_uatomic_and()		_uatomic_rmw_fence()
+
+#define uatomic_or(addr, v)						\
+	((void) __atomic_or_fetch((addr), (v), __ATOMIC_RELAXED))
+#define uatomic_or_acquire(addr, v)					\
+	((void) __atomic_or_fetch((addr), (v), __ATOMIC_ACQUIRE))
+#define uatomic_or_release(addr, v)					\
+	((void) __atomic_or_fetch((addr), (v), __ATOMIC_RELEASE))
+#define cmm_smp_mb__before_uatomic_or()		_uatomic_rmw_fence()
+#define cmm_smp_mb__after_uatomic_or()		_uatomic_rmw_fence()
+
+#define uatomic_add(addr, v)						\
+	((void) __atomic_add_fetch((addr), (v), __ATOMIC_RELAXED))
+#define uatomic_add_acquire(addr, v)					\
+	((void) __atomic_add_fetch((addr), (v), __ATOMIC_ACQUIRE))
+#define uatomic_add_release(addr, v)					\
+	((void) __atomic_add_fetch((addr), (v), __ATOMIC_RELEASE))
+#define cmm_smp_mb__before_uatomic_add()	_uatomic_rmw_fence()
+#define cmm_smp_mb__after_uatomic_add()		_uatomic_rmw_fence()
+
+#ifdef __cplusplus
+}
+#endif
+
+#include <urcu/uatomic/generic.h>
+
+#endif /* _URCU_UATOMIC_BUILTINS_H */
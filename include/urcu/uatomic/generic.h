@@ -606,6 +606,133 @@ unsigned long _uatomic_exchange(void *addr, unsigned long val, int len)
 #define cmm_smp_mb__after_uatomic_dec()		cmm_smp_mb__after_uatomic_add()
 #endif
 
+/*
+ * Double-word cmpxchg. Compare the two words at addr with *old and
+ * replace them by *_new if they are equal. Return 1 on success. Otherwise
+ * return 0 and update *old with the content of addr. Implies a full
+ * memory barrier before and after the operation.
+ *
+ * Architectures without a double-word cmpxchg instruction fall back to
+ * a hashed lock: there, the words of a struct uatomic_double must only
+ * be modified with uatomic_cmpxchg_double().
+ */
+struct uatomic_double {
+	unsigned long lo, hi;
+} __attribute__((aligned(2 * sizeof(unsigned long))));
+
+extern int _compat_uatomic_cmpxchg_double(void *addr, unsigned long *old,
+		unsigned long new_lo, unsigned long new_hi);
+
+#ifndef UATOMIC_HAS_ATOMIC_DOUBLE
+#define _uatomic_cmpxchg_double		_compat_uatomic_cmpxchg_double
+#endif
+
+#define uatomic_cmpxchg_double(addr, old, _new)				\
+	_uatomic_cmpxchg_double(&(addr)->lo, &(old)->lo,		\
+			(_new)->lo, (_new)->hi)
+
+/*
+ * Memory-order variants. _relaxed implies no barrier, _acquire orders the
+ * operation before subsequent accesses, and _release orders prior accesses
+ * before the operation. Backends lacking a weaker primitive fall back to
+ * the full-barrier operation or to the explicit barriers above.
+ */
+
+#ifndef uatomic_load_acquire
+#define uatomic_load_acquire(addr)					\
+	__extension__							\
+	({								\
+		__typeof__(*(addr)) __v = uatomic_read(addr);		\
+									\
+		cmm_smp_mb();						\
+		__v;							\
+	})
+#endif
+
+#ifndef uatomic_store_release
+#define uatomic_store_release(addr, v)					\
+	do {								\
+		cmm_smp_mb();						\
+		uatomic_set((addr), (v));				\
+	} while (0)
+#endif
+
+#ifndef uatomic_cmpxchg_relaxed
+#define uatomic_cmpxchg_relaxed(addr, old, _new)			\
+	uatomic_cmpxchg((addr), (old), (_new))
+#define uatomic_cmpxchg_acquire(addr, old, _new)			\
+	uatomic_cmpxchg((addr), (old), (_new))
+#define uatomic_cmpxchg_release(addr, old, _new)			\
+	uatomic_cmpxchg((addr), (old), (_new))
+#endif
+
+#ifndef uatomic_xchg_relaxed
+#define uatomic_xchg_relaxed(addr, v)	uatomic_xchg((addr), (v))
+#define uatomic_xchg_acquire(addr, v)	uatomic_xchg((addr), (v))
+#define uatomic_xchg_release(addr, v)	uatomic_xchg((addr), (v))
+#endif
+
+#ifndef uatomic_add_return_relaxed
+#define uatomic_add_return_relaxed(addr, v)	uatomic_add_return((addr), (v))
+#define uatomic_add_return_acquire(addr, v)	uatomic_add_return((addr), (v))
+#define uatomic_add_return_release(addr, v)	uatomic_add_return((addr), (v))
+#endif
+
+#define uatomic_sub_return_relaxed(addr, v)	\
+	uatomic_add_return_relaxed((addr), -(caa_cast_long_keep_sign(v)))
+#define uatomic_sub_return_acquire(addr, v)	\
+	uatomic_add_return_acquire((addr), -(caa_cast_long_keep_sign(v)))
+#define uatomic_sub_return_release(addr, v)	\
+	uatomic_add_return_release((addr), -(caa_cast_long_keep_sign(v)))
+
+#ifndef uatomic_and_acquire
+#define uatomic_and_acquire(addr, v)					\
+	do {								\
+		uatomic_and((addr), (v));				\
+		cmm_smp_mb__after_uatomic_and();			\
+	} while (0)
+#define uatomic_and_release(addr, v)					\
+	do {								\
+		cmm_smp_mb__before_uatomic_and();			\
+		uatomic_and((addr), (v));				\
+	} while (0)
+#endif
+
+#ifndef uatomic_or_acquire
+#define uatomic_or_acquire(addr, v)					\
+	do {								\
+		uatomic_or((addr), (v));				\
+		cmm_smp_mb__after_uatomic_or();				\
+	} while (0)
+#define uatomic_or_release(addr, v)					\
+	do {								\
+		cmm_smp_mb__before_uatomic_or();			\
+		uatomic_or((addr), (v));				\
+	} while (0)
+#endif
+
+#ifndef uatomic_add_acquire
+#define uatomic_add_acquire(addr, v)					\
+	do {								\
+		uatomic_add((addr), (v));				\
+		cmm_smp_mb__after_uatomic_add();			\
+	} while (0)
+#define uatomic_add_release(addr, v)					\
+	do {								\
+		cmm_smp_mb__before_uatomic_add();			\
+		uatomic_add((addr), (v));				\
+	} while (0)
+#endif
+
+#define uatomic_sub_acquire(addr, v)		\
+	uatomic_add_acquire((addr), -(caa_cast_long_keep_sign(v)))
+#define uatomic_sub_release(addr, v)		\
+	uatomic_add_release((addr), -(caa_cast_long_keep_sign(v)))
+#define uatomic_inc_acquire(addr)	uatomic_add_acquire((addr), 1)
+#define uatomic_inc_release(addr)	uatomic_add_release((addr), 1)
+#define uatomic_dec_acquire(addr)	uatomic_add_acquire((addr), -1)
+#define uatomic_dec_release(addr)	uatomic_add_release((addr), -1)
+
 #ifdef __cplusplus
 }
 #endif
@@ -109,6 +109,30 @@ unsigned long __uatomic_cmpxchg(void *addr, unsigned long old,
 						caa_cast_long_keep_sign(_new),\
 						sizeof(*(addr))))
 
+#if (CAA_BITS_PER_LONG == 64)
+/*
+ * Double-word cmpxchg. cmpxchg16b is missing only from the earliest
+ * x86-64 processors.
+ */
+#define UATOMIC_HAS_ATOMIC_DOUBLE
+
+static inline __attribute__((always_inline))
+int _uatomic_cmpxchg_double(void *addr, unsigned long *old,
+			    unsigned long new_lo, unsigned long new_hi)
+{
+	unsigned char result;
+
+	__asm__ __volatile__(
+	"lock; cmpxchg16b %0\n\t"
+	"sete %1"
+		: "+m"(*__hp(addr)), "=q"(result),
+		  "+a"(old[0]), "+d"(old[1])
+		: "b"(new_lo), "c"(new_hi)
+		: "memory", "cc");
+	return result;
+}
+#endif
+
 /* xchg */
 
 static inline __attribute__((always_inline))
@@ -620,6 +644,21 @@ extern unsigned long _compat_uatomic_add_return(void *addr,
 #define cmm_smp_mb__before_uatomic_dec()	cmm_barrier()
 #define cmm_smp_mb__after_uatomic_dec()		cmm_barrier()
 
+/* x86 is TSO: plain loads have acquire and plain stores release semantics. */
+#define uatomic_load_acquire(addr)					\
+	__extension__							\
+	({								\
+		__typeof__(*(addr)) __v = CMM_LOAD_SHARED(*(addr));	\
+									\
+		cmm_barrier();						\
+		__v;							\
+	})
+#define uatomic_store_release(addr, v)					\
+	do {								\
+		cmm_barrier();						\
+		uatomic_set((addr), (v));				\
+	} while (0)
+
 #ifdef __cplusplus
 }
 #endif
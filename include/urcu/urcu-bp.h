@@ -36,6 +36,7 @@
 
 #include <stdlib.h>
 #include <pthread.h>
+#include <errno.h>
 
 #ifdef __cplusplus
 extern "C" {
@@ -140,6 +141,16 @@ extern void *urcu_bp_set_pointer_sym(void **p, void *v);
 
 extern void urcu_bp_synchronize_rcu(void);
 
+/*
+ * Grace-period polling: get_state_synchronize_rcu() returns a cookie,
+ * poll_state_synchronize_rcu() returns non-zero once a full grace period
+ * has elapsed since the cookie was taken, and cond_synchronize_rcu()
+ * only waits for a grace period if none has elapsed yet.
+ */
+extern unsigned long urcu_bp_get_state_synchronize_rcu(void);
+extern int urcu_bp_poll_state_synchronize_rcu(unsigned long cookie);
+extern void urcu_bp_cond_synchronize_rcu(unsigned long cookie);
+
 /*
  * urcu_bp_before_fork, urcu_bp_after_fork_parent and urcu_bp_after_fork_child
  * should be called around fork() system calls when the child process is not
@@ -161,6 +172,12 @@ static inline void urcu_bp_unregister_thread(void)
 {
 }
 
+/* Grace periods of this flavor cannot skip readers. */
+static inline int urcu_bp_register_thread_isolated(void)
+{
+	return -ENOSYS;
+}
+
 static inline void urcu_bp_init(void)
 {
 }
@@ -180,13 +197,22 @@ static inline void urcu_bp_thread_online(void)
 {
 }
 
+/*
+ * Flavor structure, declared under its own name for programs including
+ * several flavors.
+ */
+struct rcu_flavor_struct;
+extern const struct rcu_flavor_struct urcu_bp_flavor;
+
 #ifdef __cplusplus
 }
 #endif
 
 #include <urcu/call-rcu.h>
 #include <urcu/defer.h>
+#include <urcu/introspect.h>
 #include <urcu/flavor.h>
+#include <urcu/stall.h>
 
 #ifndef URCU_API_MAP
 #include <urcu/map/clear.h>
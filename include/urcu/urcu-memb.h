@@ -90,12 +90,45 @@ extern int urcu_memb_read_ongoing(void);
 
 extern void urcu_memb_synchronize_rcu(void);
 
+/*
+ * Expedited grace period, busy-waiting for readers instead of sleeping.
+ */
+extern void urcu_memb_synchronize_rcu_expedited(void);
+
+/*
+ * Grace period driven in steps, without blocking: gp_step_start()
+ * starts it, and each gp_step() checks at most max_readers readers (0
+ * for all), or switches the phase, until it returns 1 once the grace
+ * period has elapsed. Returns -EBUSY if a grace period is in progress.
+ */
+extern int urcu_memb_gp_step_start(void);
+extern int urcu_memb_gp_step(unsigned int max_readers);
+
+/*
+ * Grace-period polling: get_state_synchronize_rcu() returns a cookie,
+ * poll_state_synchronize_rcu() returns non-zero once a full grace period
+ * has elapsed since the cookie was taken, and cond_synchronize_rcu()
+ * only waits for a grace period if none has elapsed yet.
+ */
+extern unsigned long urcu_memb_get_state_synchronize_rcu(void);
+extern int urcu_memb_poll_state_synchronize_rcu(unsigned long cookie);
+extern void urcu_memb_cond_synchronize_rcu(unsigned long cookie);
+
 /*
  * Reader thread registration.
  */
 extern void urcu_memb_register_thread(void);
 extern void urcu_memb_unregister_thread(void);
 
+/*
+ * Register a reader pinned to one CPU, typically an isolated nohz_full
+ * CPU, which grace periods must not interrupt: its read side issues
+ * full memory barriers, and grace periods skip its CPU in their
+ * membarrier or signals. Returns -EINVAL if the thread may run on
+ * several CPUs, or -ENOSYS if the CPU affinity is unknown.
+ */
+extern int urcu_memb_register_thread_isolated(void);
+
 /*
  * Explicit rcu initialization, for "early" use within library constructors.
  */
@@ -116,13 +149,26 @@ static inline void urcu_memb_thread_online(void)
 {
 }
 
+/*
+ * Flavor structure, declared under its own name for programs including
+ * several flavors.
+ */
+struct rcu_flavor_struct;
+extern const struct rcu_flavor_struct urcu_memb_flavor;
+
 #ifdef __cplusplus
 }
 #endif
 
 #include <urcu/call-rcu.h>
 #include <urcu/defer.h>
+#include <urcu/introspect.h>
 #include <urcu/flavor.h>
+#include <urcu/srcu.h>
+#include <urcu/stall.h>
+#include <urcu/cs-sample.h>
+#include <urcu/gp-thread.h>
+#include <urcu/reader-ctx.h>
 
 #ifndef URCU_API_MAP
 #include <urcu/map/clear.h>
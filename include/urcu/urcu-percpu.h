@@ -0,0 +1,149 @@
+#ifndef _URCU_PERCPU_H
+#define _URCU_PERCPU_H
+
+/*
+ * urcu-percpu.h
+ *
+ * Userspace RCU header, per-CPU counters version.
+ *
+ * Readers update per-CPU lock and unlock counters, and do not require
+ * thread registration nor unregistration.
+ *
+ * LGPL-compatible code should include this header with :
+ *
+ * #define _LGPL_SOURCE
+ * #include <urcu/urcu-percpu.h>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+#include <stdlib.h>
+#include <pthread.h>
+#include <errno.h>
+
+/*
+ * See urcu/pointer.h and urcu/static/pointer.h for pointer
+ * publication headers.
+ */
+#include <urcu/pointer.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <urcu/map/urcu-percpu.h>
+
+#ifdef _LGPL_SOURCE
+
+#include <urcu/static/urcu-percpu.h>
+
+/*
+ * Mappings for static use of the userspace RCU library.
+ * Should only be used in LGPL-compatible code.
+ */
+
+/*
+ * rcu_read_lock()
+ * rcu_read_unlock()
+ *
+ * Mark the beginning and end of a read-side critical section.
+ */
+#define urcu_percpu_read_lock		_urcu_percpu_read_lock
+#define urcu_percpu_read_unlock		_urcu_percpu_read_unlock
+#define urcu_percpu_read_ongoing	_urcu_percpu_read_ongoing
+
+#else /* !_LGPL_SOURCE */
+
+/*
+ * library wrappers to be used by non-LGPL compatible source code.
+ * See LGPL-only urcu/static/pointer.h for documentation.
+ */
+
+extern void urcu_percpu_read_lock(void);
+extern void urcu_percpu_read_unlock(void);
+extern int urcu_percpu_read_ongoing(void);
+
+#endif /* !_LGPL_SOURCE */
+
+extern void urcu_percpu_synchronize_rcu(void);
+
+/*
+ * Grace-period polling: get_state_synchronize_rcu() returns a cookie,
+ * poll_state_synchronize_rcu() returns non-zero once a full grace period
+ * has elapsed since the cookie was taken, and cond_synchronize_rcu()
+ * only waits for a grace period if none has elapsed yet.
+ */
+extern unsigned long urcu_percpu_get_state_synchronize_rcu(void);
+extern int urcu_percpu_poll_state_synchronize_rcu(unsigned long cookie);
+extern void urcu_percpu_cond_synchronize_rcu(unsigned long cookie);
+
+/*
+ * Explicit rcu initialization, for "early" use within library constructors.
+ */
+extern void urcu_percpu_init(void);
+
+/*
+ * In the per-CPU counters version, the following functions are no-ops.
+ */
+static inline void urcu_percpu_register_thread(void)
+{
+}
+
+static inline void urcu_percpu_unregister_thread(void)
+{
+}
+
+/* Grace periods of this flavor cannot skip readers. */
+static inline int urcu_percpu_register_thread_isolated(void)
+{
+	return -ENOSYS;
+}
+
+/*
+ * Q.S. reporting are no-ops for these URCU flavors.
+ */
+static inline void urcu_percpu_quiescent_state(void)
+{
+}
+
+static inline void urcu_percpu_thread_offline(void)
+{
+}
+
+static inline void urcu_percpu_thread_online(void)
+{
+}
+
+/*
+ * Flavor structure, declared under its own name for programs including
+ * several flavors.
+ */
+struct rcu_flavor_struct;
+extern const struct rcu_flavor_struct urcu_percpu_flavor;
+
+#ifdef __cplusplus
+}
+#endif
+
+#include <urcu/call-rcu.h>
+#include <urcu/defer.h>
+#include <urcu/introspect.h>
+#include <urcu/flavor.h>
+
+#ifndef URCU_API_MAP
+#include <urcu/map/clear.h>
+#endif
+
+#endif /* _URCU_PERCPU_H */
@@ -123,19 +123,74 @@ extern void urcu_qsbr_thread_online(void);
 
 extern void urcu_qsbr_synchronize_rcu(void);
 
+/*
+ * Grace-period polling: get_state_synchronize_rcu() returns a cookie,
+ * poll_state_synchronize_rcu() returns non-zero once a full grace period
+ * has elapsed since the cookie was taken, and cond_synchronize_rcu()
+ * only waits for a grace period if none has elapsed yet.
+ */
+extern unsigned long urcu_qsbr_get_state_synchronize_rcu(void);
+extern int urcu_qsbr_poll_state_synchronize_rcu(unsigned long cookie);
+extern void urcu_qsbr_cond_synchronize_rcu(unsigned long cookie);
+
+/*
+ * Grace-period tokens, for writers reclaiming inline without blocking,
+ * as urcu/qsbr-dq.h does: urcu_qsbr_token_start() returns a token after
+ * objects were removed, and urcu_qsbr_token_check() returns non-zero
+ * once every other reader went through a quiescent state since, or was
+ * offline. The check does not wait: it scans the registered readers,
+ * and advances the grace-period counter if no grace period is in
+ * progress, for readers to report their next quiescent state. Both must
+ * be called outside of read-side critical sections. Tokens are compared
+ * with wrap-around safe arithmetic: a check succeeding for a token
+ * succeeds for all tokens taken before. On 32-bit architectures, tokens
+ * are polling cookies, only reached by grace periods.
+ */
+extern unsigned long urcu_qsbr_token_start(void);
+extern int urcu_qsbr_token_check(unsigned long token);
+
+/*
+ * Use membarrier(2) for the grace periods: quiescent states, and
+ * threads going online or offline, then only use compiler barriers,
+ * the grace periods issuing MEMBARRIER_CMD_PRIVATE_EXPEDITED in place
+ * of the memory barriers of the readers. Faster when readers report
+ * quiescent states much more often than grace periods happen. Cannot
+ * be disabled once enabled. Returns 0 on success, -ENOSYS when the
+ * kernel does not support it.
+ */
+extern int urcu_qsbr_enable_sys_membarrier(void);
+
 /*
  * Reader thread registration.
  */
 extern void urcu_qsbr_register_thread(void);
 extern void urcu_qsbr_unregister_thread(void);
 
+/*
+ * Register a reader on a CPU which grace periods must not interrupt.
+ * QSBR grace periods only send IPIs once urcu_qsbr_enable_sys_membarrier()
+ * was called: returns -ENOSYS if it was, and registers the reader
+ * otherwise.
+ */
+extern int urcu_qsbr_register_thread_isolated(void);
+
+/*
+ * Flavor structure, declared under its own name for programs including
+ * several flavors.
+ */
+struct rcu_flavor_struct;
+extern const struct rcu_flavor_struct urcu_qsbr_flavor;
+
 #ifdef __cplusplus
 }
 #endif
 
 #include <urcu/call-rcu.h>
 #include <urcu/defer.h>
+#include <urcu/introspect.h>
 #include <urcu/flavor.h>
+#include <urcu/stall.h>
+#include <urcu/gp-thread.h>
 
 #ifndef URCU_API_MAP
 #include <urcu/map/clear.h>
@@ -0,0 +1,279 @@
+#ifndef _URCU_WFCQUEUE_PRIO_H
+#define _URCU_WFCQUEUE_PRIO_H
+
+/*
+ * urcu/wfcqueue-prio.h
+ *
+ * Userspace RCU library - Multi-Level Priority Concurrent Queue with
+ * Wait-Free Enqueue/Blocking Dequeue
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+#include <stdbool.h>
+#include <urcu/wfcqueue.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*
+ * Set of CDS_WFCQ_PRIO_LEVELS wfcqueues, one per priority band.
+ * Producers enqueue into the band of their priority, from
+ * CDS_WFCQ_PRIO_NORMAL to CDS_WFCQ_PRIO_HIGH, with the wait-free
+ * enqueue of wfcqueue. Consumers dequeue from the highest non-empty
+ * band, and splice all bands into a single queue in priority order, so
+ * urgent nodes do not wait behind a backlog of normal ones.
+ *
+ * Nodes of a band are dequeued in FIFO order. A node enqueued into a
+ * higher band may be dequeued before nodes enqueued earlier into lower
+ * bands, but never after a node of a lower band enqueued after it: a
+ * node of the normal band is only dequeued once all nodes enqueued
+ * before it, into any band, are dequeued, which lets completions and
+ * barriers be queued into the normal band.
+ *
+ * Enqueue requires no mutual exclusion. The bands share a single
+ * dequeue lock, held by cds_wfcq_prio_dequeue_blocking() and
+ * cds_wfcq_prio_splice_blocking(), or by the caller of the __
+ * variants, unless there is a single consumer.
+ */
+
+#define CDS_WFCQ_PRIO_LEVELS	4
+#define CDS_WFCQ_PRIO_NORMAL	0
+#define CDS_WFCQ_PRIO_HIGH	(CDS_WFCQ_PRIO_LEVELS - 1)
+
+struct cds_wfcq_prio {
+	struct {
+		struct cds_wfcq_tail tail;
+		struct cds_wfcq_head head;
+	} level[CDS_WFCQ_PRIO_LEVELS];
+};
+
+/* Band of a priority: priorities above CDS_WFCQ_PRIO_HIGH are clamped. */
+static inline unsigned int cds_wfcq_prio_level(unsigned int prio)
+{
+	return prio < CDS_WFCQ_PRIO_LEVELS ? prio : CDS_WFCQ_PRIO_HIGH;
+}
+
+/*
+ * cds_wfcq_prio_head, cds_wfcq_prio_tail: queue of the band of @prio,
+ * for use with the wfcqueue API by producers, e.g. to enqueue a batch
+ * or splice a queue into that band.
+ */
+static inline struct cds_wfcq_head *cds_wfcq_prio_head(
+		struct cds_wfcq_prio *q, unsigned int prio)
+{
+	return &q->level[cds_wfcq_prio_level(prio)].head;
+}
+
+static inline struct cds_wfcq_tail *cds_wfcq_prio_tail(
+		struct cds_wfcq_prio *q, unsigned int prio)
+{
+	return &q->level[cds_wfcq_prio_level(prio)].tail;
+}
+
+static inline void cds_wfcq_prio_init(struct cds_wfcq_prio *q)
+{
+	unsigned int i;
+
+	for (i = 0; i < CDS_WFCQ_PRIO_LEVELS; i++)
+		cds_wfcq_init(&q->level[i].head, &q->level[i].tail);
+}
+
+static inline void cds_wfcq_prio_destroy(struct cds_wfcq_prio *q)
+{
+	unsigned int i;
+
+	for (i = 0; i < CDS_WFCQ_PRIO_LEVELS; i++)
+		cds_wfcq_destroy(&q->level[i].head, &q->level[i].tail);
+}
+
+/*
+ * cds_wfcq_prio_empty: return whether all bands are empty.
+ *
+ * No memory barrier is issued. No mutual exclusion is required.
+ */
+static inline bool cds_wfcq_prio_empty(struct cds_wfcq_prio *q)
+{
+	unsigned int i;
+
+	for (i = 0; i < CDS_WFCQ_PRIO_LEVELS; i++) {
+		if (!cds_wfcq_empty(cds_wfcq_head_cast(&q->level[i].head),
+				&q->level[i].tail))
+			return false;
+	}
+	return true;
+}
+
+static inline void cds_wfcq_prio_dequeue_lock(struct cds_wfcq_prio *q)
+{
+	cds_wfcq_dequeue_lock(&q->level[0].head, &q->level[0].tail);
+}
+
+static inline void cds_wfcq_prio_dequeue_unlock(struct cds_wfcq_prio *q)
+{
+	cds_wfcq_dequeue_unlock(&q->level[0].head, &q->level[0].tail);
+}
+
+/*
+ * cds_wfcq_prio_enqueue: enqueue a node into the band of @prio.
+ *
+ * Issues a full memory barrier before enqueue. No mutual exclusion is
+ * required.
+ *
+ * Returns false if the band was empty prior to adding the node.
+ * Returns true otherwise.
+ */
+static inline bool cds_wfcq_prio_enqueue(struct cds_wfcq_prio *q,
+		struct cds_wfcq_node *node, unsigned int prio)
+{
+	return cds_wfcq_enqueue(cds_wfcq_head_cast(cds_wfcq_prio_head(q, prio)),
+			cds_wfcq_prio_tail(q, prio), node);
+}
+
+/*
+ * __cds_wfcq_prio_dequeue_blocking: dequeue a node from the highest
+ * non-empty band.
+ *
+ * Returns NULL if all bands are empty.
+ * Issues a full memory barrier after dequeue.
+ * Mutual exclusion with other dequeue and splice operations is
+ * required, e.g. by holding cds_wfcq_prio_dequeue_lock().
+ */
+static inline struct cds_wfcq_node *__cds_wfcq_prio_dequeue_blocking(
+		struct cds_wfcq_prio *q)
+{
+	int i, j;
+
+	for (i = CDS_WFCQ_PRIO_HIGH; i >= 0; i--) {
+		if (cds_wfcq_empty(cds_wfcq_head_cast(&q->level[i].head),
+				&q->level[i].tail))
+			continue;
+		/*
+		 * Nodes enqueued into higher bands before the first node of
+		 * band i were missed if they were enqueued after the scan of
+		 * their band: they are visible now.
+		 */
+		cmm_smp_mb();
+		for (j = CDS_WFCQ_PRIO_HIGH; j > i; j--) {
+			if (!cds_wfcq_empty(cds_wfcq_head_cast(&q->level[j].head),
+					&q->level[j].tail))
+				break;
+		}
+		if (j > i) {
+			i = j + 1;	/* Check band j again. */
+			continue;
+		}
+		return __cds_wfcq_dequeue_blocking(
+				cds_wfcq_head_cast(&q->level[i].head),
+				&q->level[i].tail);
+	}
+	return NULL;
+}
+
+/*
+ * __cds_wfcq_prio_splice_blocking: move all nodes into a queue.
+ *
+ * Splices the bands into the dest queue from the highest to the
+ * normal one, so that dest holds the nodes in priority order, FIFO
+ * within each band. Dest queue requires no mutual exclusion. Mutual
+ * exclusion with other dequeue and splice operations of @q is required.
+ *
+ * Returns enum cds_wfcq_ret which indicates the state of the dest
+ * queue before the first node was moved, or CDS_WFCQ_RET_SRC_EMPTY if
+ * all bands were empty.
+ */
+static inline enum cds_wfcq_ret __cds_wfcq_prio_splice_blocking(
+		cds_wfcq_head_ptr_t dest_q_head,
+		struct cds_wfcq_tail *dest_q_tail,
+		struct cds_wfcq_prio *q)
+{
+	enum cds_wfcq_ret ret = CDS_WFCQ_RET_SRC_EMPTY, level_ret;
+	struct __cds_wfcq_head tmp_head[CDS_WFCQ_PRIO_LEVELS];
+	struct cds_wfcq_tail tmp_tail[CDS_WFCQ_PRIO_LEVELS];
+	int i;
+
+	/*
+	 * Take the bands from the normal one up, so that nodes enqueued
+	 * into higher bands before those taken from a lower band are
+	 * taken too, then append them to dest from the highest band.
+	 */
+	for (i = 0; i < CDS_WFCQ_PRIO_LEVELS; i++) {
+		__cds_wfcq_init(&tmp_head[i], &tmp_tail[i]);
+		(void) __cds_wfcq_splice_blocking(
+				__cds_wfcq_head_cast(&tmp_head[i]), &tmp_tail[i],
+				cds_wfcq_head_cast(&q->level[i].head),
+				&q->level[i].tail);
+	}
+	for (i = CDS_WFCQ_PRIO_HIGH; i >= 0; i--) {
+		level_ret = __cds_wfcq_splice_blocking(dest_q_head,
+				dest_q_tail, __cds_wfcq_head_cast(&tmp_head[i]),
+				&tmp_tail[i]);
+		if (ret == CDS_WFCQ_RET_SRC_EMPTY)
+			ret = level_ret;
+	}
+	return ret;
+}
+
+/*
+ * __cds_wfcq_prio_move_blocking: move all nodes of @src into the same
+ * bands of @dest.
+ *
+ * Dest queue requires no mutual exclusion. Mutual exclusion with other
+ * dequeue and splice operations of @src is required.
+ */
+static inline void __cds_wfcq_prio_move_blocking(struct cds_wfcq_prio *dest,
+		struct cds_wfcq_prio *src)
+{
+	unsigned int i;
+
+	for (i = 0; i < CDS_WFCQ_PRIO_LEVELS; i++)
+		(void) __cds_wfcq_splice_blocking(
+				cds_wfcq_head_cast(&dest->level[i].head),
+				&dest->level[i].tail,
+				cds_wfcq_head_cast(&src->level[i].head),
+				&src->level[i].tail);
+}
+
+/* Same as the __ variants, holding the dequeue lock of @q. */
+static inline struct cds_wfcq_node *cds_wfcq_prio_dequeue_blocking(
+		struct cds_wfcq_prio *q)
+{
+	struct cds_wfcq_node *node;
+
+	cds_wfcq_prio_dequeue_lock(q);
+	node = __cds_wfcq_prio_dequeue_blocking(q);
+	cds_wfcq_prio_dequeue_unlock(q);
+	return node;
+}
+
+static inline enum cds_wfcq_ret cds_wfcq_prio_splice_blocking(
+		cds_wfcq_head_ptr_t dest_q_head,
+		struct cds_wfcq_tail *dest_q_tail,
+		struct cds_wfcq_prio *q)
+{
+	enum cds_wfcq_ret ret;
+
+	cds_wfcq_prio_dequeue_lock(q);
+	ret = __cds_wfcq_prio_splice_blocking(dest_q_head, dest_q_tail, q);
+	cds_wfcq_prio_dequeue_unlock(q);
+	return ret;
+}
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* _URCU_WFCQUEUE_PRIO_H */
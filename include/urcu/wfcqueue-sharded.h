@@ -0,0 +1,128 @@
+#ifndef _URCU_WFCQUEUE_SHARDED_H
+#define _URCU_WFCQUEUE_SHARDED_H
+
+/*
+ * urcu/wfcqueue-sharded.h
+ *
+ * Userspace RCU library - Per-CPU Sharded Concurrent Queue with Wait-Free
+ * Enqueue/Blocking Dequeue
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+#include <stdbool.h>
+#include <urcu/wfcqueue.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*
+ * Set of wfcqueue shards. Producers enqueue into the shard of the CPU
+ * they run on, so that producers on different CPUs do not share a
+ * queue tail. Consumers dequeue or splice from all shards, visiting
+ * them round-robin.
+ *
+ * Ordering is relaxed: nodes enqueued into the same shard are dequeued
+ * in FIFO order, which includes nodes enqueued by a thread which does
+ * not migrate between CPUs. There is no ordering between shards.
+ *
+ * Enqueue requires no mutual exclusion. Dequeue and splice hold the
+ * dequeue lock of each shard they visit, and can be called
+ * concurrently.
+ */
+struct cds_wfcq_sharded;
+
+/*
+ * cds_wfcq_sharded_new: allocate a sharded queue.
+ * @nr_shards: number of shards, rounded up to a power of two. 0 uses
+ *             one shard per configured CPU.
+ *
+ * Returns NULL on allocation failure.
+ */
+extern struct cds_wfcq_sharded *cds_wfcq_sharded_new(unsigned long nr_shards);
+
+/*
+ * cds_wfcq_sharded_destroy: free an empty sharded queue.
+ */
+extern void cds_wfcq_sharded_destroy(struct cds_wfcq_sharded *q);
+
+/*
+ * cds_wfcq_sharded_nr_shards: number of shards of a sharded queue.
+ */
+extern unsigned long cds_wfcq_sharded_nr_shards(struct cds_wfcq_sharded *q);
+
+/*
+ * cds_wfcq_sharded_empty: return whether all shards are empty.
+ *
+ * No memory barrier is issued. No mutual exclusion is required.
+ */
+extern bool cds_wfcq_sharded_empty(struct cds_wfcq_sharded *q);
+
+/*
+ * cds_wfcq_sharded_enqueue: enqueue a node into the current CPU shard.
+ *
+ * Issues a full memory barrier before enqueue. No mutual exclusion is
+ * required.
+ *
+ * Returns false if the shard was empty prior to adding the node.
+ * Returns true otherwise.
+ */
+extern bool cds_wfcq_sharded_enqueue(struct cds_wfcq_sharded *q,
+		struct cds_wfcq_node *node);
+
+/*
+ * cds_wfcq_sharded_enqueue_batch: enqueue a chain into the current CPU
+ * shard.
+ *
+ * Same as cds_wfcq_enqueue_batch(): @first to @last must be linked by
+ * the caller, with @last->next set to NULL.
+ */
+extern bool cds_wfcq_sharded_enqueue_batch(struct cds_wfcq_sharded *q,
+		struct cds_wfcq_node *first,
+		struct cds_wfcq_node *last);
+
+/*
+ * cds_wfcq_sharded_dequeue_blocking: dequeue a node from any shard.
+ *
+ * Visits the shards round-robin, starting after the shard of the last
+ * dequeue, and holds the dequeue lock of each shard it dequeues from.
+ * Returns NULL if all shards are empty.
+ * Issues a full memory barrier after dequeue.
+ */
+extern struct cds_wfcq_node *cds_wfcq_sharded_dequeue_blocking(
+		struct cds_wfcq_sharded *q);
+
+/*
+ * cds_wfcq_sharded_splice_blocking: move all nodes into a queue.
+ *
+ * Splices each shard into the dest queue in turn, holding the dequeue
+ * lock of that shard. Nodes of each shard stay in order in dest.
+ * Dest queue requires no mutual exclusion.
+ *
+ * Returns enum cds_wfcq_ret which indicates the state of the dest
+ * queue before the first node was moved, or CDS_WFCQ_RET_SRC_EMPTY if
+ * all shards were empty.
+ */
+extern enum cds_wfcq_ret cds_wfcq_sharded_splice_blocking(
+		struct cds_wfcq_head *dest_q_head,
+		struct cds_wfcq_tail *dest_q_tail,
+		struct cds_wfcq_sharded *q);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* _URCU_WFCQUEUE_SHARDED_H */
@@ -27,6 +27,7 @@
 #include <pthread.h>
 #include <assert.h>
 #include <stdbool.h>
+#include <stdint.h>
 #include <urcu/compiler.h>
 #include <urcu/arch.h>
 
@@ -128,6 +129,29 @@ struct cds_wfcq_tail {
 	struct cds_wfcq_node *p;
 };
 
+/*
+ * Waits of consumers for an enqueue in progress, between the tail xchg
+ * and the store to the previous node's next pointer.
+ */
+struct cds_wfcq_wait_stats {
+	unsigned long busy_waits;	/* Enqueues found in progress. */
+	unsigned long yields;		/* sched_yield() calls. */
+	unsigned long futex_waits;	/* Sleeps on the waiter futex. */
+	unsigned long wakeups;		/* FUTEX_WAKE issued by enqueuers. */
+};
+
+/*
+ * Lets consumers sleep while the queue is empty, and while an enqueue
+ * is in progress. Keep it away from the queue head and tail cache-lines
+ * if possible.
+ */
+struct cds_wfcq_waiter {
+	int32_t futex;		/* Incremented before each wakeup. */
+	int32_t nr_waiters;	/* Consumers waiting or about to wait. */
+	int32_t nr_sync_waiters;	/* Consumers waiting for an enqueue. */
+	struct cds_wfcq_wait_stats stats;
+};
+
 #ifdef _LGPL_SOURCE
 
 #include <urcu/static/wfcqueue.h>
@@ -138,6 +162,14 @@ struct cds_wfcq_tail {
 #define cds_wfcq_destroy		_cds_wfcq_destroy
 #define cds_wfcq_empty			_cds_wfcq_empty
 #define cds_wfcq_enqueue		_cds_wfcq_enqueue
+#define cds_wfcq_enqueue_batch		_cds_wfcq_enqueue_batch
+
+/* Sleeping consumers */
+#define cds_wfcq_waiter_init		_cds_wfcq_waiter_init
+#define cds_wfcq_waiter_get_stats	_cds_wfcq_waiter_get_stats
+#define cds_wfcq_enqueue_wake		_cds_wfcq_enqueue_wake
+#define cds_wfcq_enqueue_batch_wake	_cds_wfcq_enqueue_batch_wake
+#define cds_wfcq_dequeue_timeout	_cds_wfcq_dequeue_timeout
 
 /* Dequeue locking */
 #define cds_wfcq_dequeue_lock		_cds_wfcq_dequeue_lock
@@ -147,6 +179,7 @@ struct cds_wfcq_tail {
 #define cds_wfcq_dequeue_blocking	_cds_wfcq_dequeue_blocking
 #define cds_wfcq_dequeue_with_state_blocking	\
 					_cds_wfcq_dequeue_with_state_blocking
+#define cds_wfcq_dequeue_batch_blocking	_cds_wfcq_dequeue_batch_blocking
 #define cds_wfcq_splice_blocking	_cds_wfcq_splice_blocking
 #define cds_wfcq_first_blocking		_cds_wfcq_first_blocking
 #define cds_wfcq_next_blocking		_cds_wfcq_next_blocking
@@ -155,6 +188,8 @@ struct cds_wfcq_tail {
 #define __cds_wfcq_dequeue_blocking	___cds_wfcq_dequeue_blocking
 #define __cds_wfcq_dequeue_with_state_blocking	\
 					___cds_wfcq_dequeue_with_state_blocking
+#define __cds_wfcq_dequeue_batch_blocking	\
+					___cds_wfcq_dequeue_batch_blocking
 #define __cds_wfcq_splice_blocking	___cds_wfcq_splice_blocking
 #define __cds_wfcq_first_blocking	___cds_wfcq_first_blocking
 #define __cds_wfcq_next_blocking	___cds_wfcq_next_blocking
@@ -185,7 +220,7 @@ struct cds_wfcq_tail {
  * Legend:
  * [1] cds_wfcq_enqueue
  * [2] __cds_wfcq_splice (destination queue)
- * [3] __cds_wfcq_dequeue
+ * [3] __cds_wfcq_dequeue, __cds_wfcq_dequeue_batch
  * [4] __cds_wfcq_splice (source queue)
  * [5] __cds_wfcq_first
  * [6] __cds_wfcq_next
@@ -200,8 +235,9 @@ struct cds_wfcq_tail {
  *
  * Mutual exclusion can be ensured by holding cds_wfcq_dequeue_lock().
  *
- * For convenience, cds_wfcq_dequeue_blocking() and
- * cds_wfcq_splice_blocking() hold the dequeue lock.
+ * For convenience, cds_wfcq_dequeue_blocking(),
+ * cds_wfcq_dequeue_batch_blocking() and cds_wfcq_splice_blocking() hold
+ * the dequeue lock.
  *
  * Besides locking, mutual exclusion of dequeue, splice and iteration
  * can be ensured by performing all of those operations from a single
@@ -267,6 +303,85 @@ extern bool cds_wfcq_enqueue(cds_wfcq_head_ptr_t head,
 		struct cds_wfcq_tail *tail,
 		struct cds_wfcq_node *node);
 
+/*
+ * cds_wfcq_enqueue_batch: enqueue a chain of nodes into a wait-free queue.
+ *
+ * @first to @last must be linked through their next pointers by the
+ * caller, with @last->next set to NULL. The whole chain is published
+ * with a single xchg on the tail, so it appears atomically and in order
+ * to dequeuers.
+ *
+ * Issues a full memory barrier before enqueue. No mutual exclusion is
+ * required.
+ *
+ * Returns false if the queue was empty prior to adding the nodes.
+ * Returns true otherwise.
+ */
+extern bool cds_wfcq_enqueue_batch(cds_wfcq_head_ptr_t head,
+		struct cds_wfcq_tail *tail,
+		struct cds_wfcq_node *first,
+		struct cds_wfcq_node *last);
+
+/*
+ * cds_wfcq_waiter_init: initialize the waiter of a wait-free queue.
+ */
+extern void cds_wfcq_waiter_init(struct cds_wfcq_waiter *waiter);
+
+/*
+ * cds_wfcq_waiter_get_stats: read the wait statistics of a waiter.
+ *
+ * Counts the waits of cds_wfcq_dequeue_timeout() for enqueues in
+ * progress on queues using @waiter, and the wakeups issued by their
+ * enqueuers.
+ */
+extern void cds_wfcq_waiter_get_stats(struct cds_wfcq_waiter *waiter,
+		struct cds_wfcq_wait_stats *stats);
+
+/*
+ * cds_wfcq_enqueue_wake: enqueue a node and wake up a waiting consumer.
+ *
+ * Same as cds_wfcq_enqueue(), waking up one consumer waiting on
+ * @waiter in cds_wfcq_dequeue_timeout(), if any. Only issues a system
+ * call if a consumer is waiting.
+ */
+extern bool cds_wfcq_enqueue_wake(cds_wfcq_head_ptr_t head,
+		struct cds_wfcq_tail *tail,
+		struct cds_wfcq_waiter *waiter,
+		struct cds_wfcq_node *node);
+
+/*
+ * cds_wfcq_enqueue_batch_wake: enqueue a chain and wake up consumers.
+ *
+ * Same as cds_wfcq_enqueue_batch(), waking up all consumers waiting on
+ * @waiter in cds_wfcq_dequeue_timeout(). Only issues a system call if
+ * a consumer is waiting.
+ */
+extern bool cds_wfcq_enqueue_batch_wake(cds_wfcq_head_ptr_t head,
+		struct cds_wfcq_tail *tail,
+		struct cds_wfcq_waiter *waiter,
+		struct cds_wfcq_node *first,
+		struct cds_wfcq_node *last);
+
+/*
+ * cds_wfcq_dequeue_timeout: dequeue a node, waiting while queue is empty.
+ *
+ * Waits on @waiter until a node is enqueued with cds_wfcq_enqueue_wake()
+ * or cds_wfcq_enqueue_batch_wake(), or until @timeout_ms milliseconds
+ * have elapsed. A negative @timeout_ms waits forever, and 0 does not
+ * wait at all. Waiting consumers sleep in the kernel rather than
+ * busy-waiting.
+ *
+ * Returns NULL on timeout. Takes the dequeue lock only while dequeuing,
+ * so several consumers can wait on the same queue. While an enqueue is
+ * in progress, sleeps on @waiter until the enqueuer wakes it up.
+ * Issues a full memory barrier after dequeue.
+ */
+extern struct cds_wfcq_node *cds_wfcq_dequeue_timeout(
+		struct cds_wfcq_head *head,
+		struct cds_wfcq_tail *tail,
+		struct cds_wfcq_waiter *waiter,
+		int timeout_ms);
+
 /*
  * cds_wfcq_dequeue_blocking: dequeue a node from a wait-free queue.
  *
@@ -291,6 +406,19 @@ extern struct cds_wfcq_node *cds_wfcq_dequeue_with_state_blocking(
 		struct cds_wfcq_tail *tail,
 		int *state);
 
+/*
+ * cds_wfcq_dequeue_batch_blocking: dequeue up to max nodes from a
+ * wait-free queue.
+ *
+ * Same as __cds_wfcq_dequeue_batch_blocking, with the dequeue lock
+ * taken once for all nodes.
+ */
+extern unsigned long cds_wfcq_dequeue_batch_blocking(
+		struct cds_wfcq_head *head,
+		struct cds_wfcq_tail *tail,
+		struct cds_wfcq_node **nodes,
+		unsigned long max);
+
 /*
  * cds_wfcq_splice_blocking: enqueue all src_q nodes at the end of dest_q.
  *
@@ -334,6 +462,24 @@ extern struct cds_wfcq_node *__cds_wfcq_dequeue_with_state_blocking(
 		struct cds_wfcq_tail *tail,
 		int *state);
 
+/*
+ * __cds_wfcq_dequeue_batch_blocking: dequeue up to max nodes from a
+ * wait-free queue.
+ *
+ * Stores the dequeued nodes in order into nodes[], and returns their
+ * number, 0 if the queue is empty. The queue head is moved once past
+ * the nodes dequeued, and the tail only accessed if they include the
+ * last node of the queue, instead of splicing the whole queue.
+ * It is valid to reuse and free the dequeued nodes immediately.
+ * Dequeue/splice/iteration mutual exclusion should be ensured by the
+ * caller.
+ */
+extern unsigned long __cds_wfcq_dequeue_batch_blocking(
+		cds_wfcq_head_ptr_t head,
+		struct cds_wfcq_tail *tail,
+		struct cds_wfcq_node **nodes,
+		unsigned long max);
+
 /*
  * __cds_wfcq_dequeue_nonblocking: dequeue a node from a wait-free queue.
  *
@@ -112,6 +112,7 @@ typedef union {
 #define __cds_wfs_init			___cds_wfs_init
 #define cds_wfs_empty			_cds_wfs_empty
 #define cds_wfs_push			_cds_wfs_push
+#define cds_wfs_push_batch		_cds_wfs_push_batch
 
 /* Locking performed internally */
 #define cds_wfs_pop_blocking		_cds_wfs_pop_blocking
@@ -182,6 +183,20 @@ extern bool cds_wfs_empty(cds_wfs_stack_ptr_t u_stack);
  */
 extern int cds_wfs_push(cds_wfs_stack_ptr_t u_stack, struct cds_wfs_node *node);
 
+/*
+ * cds_wfs_push_batch: push a chain of nodes into the stack.
+ *
+ * @first to @last must be linked through their next pointers, with
+ * @last->next NULL: the chain is pushed with a single exchange, @first
+ * ending up on top of the stack. Issues a full memory barrier before
+ * push. No mutual exclusion is required.
+ *
+ * Returns 0 if the stack was empty prior to adding the nodes.
+ * Returns non-zero otherwise.
+ */
+extern int cds_wfs_push_batch(cds_wfs_stack_ptr_t u_stack,
+		struct cds_wfs_node *first, struct cds_wfs_node *last);
+
 /*
  * cds_wfs_pop_blocking: pop a node from the stack.
  *
@@ -354,4 +369,25 @@ extern struct cds_wfs_head *__cds_wfs_pop_all(cds_wfs_stack_ptr_t u_stack);
 		node != NULL;						   \
 		node = n, n = (node ? cds_wfs_next_blocking(node) : NULL))
 
+/*
+ * cds_wfs_for_each_blocking_prefetch_safe: Iterate over all nodes
+ * returned by __cds_wfs_pop_all(), prefetching the next node while the
+ * current one is processed. Safe against deletion.
+ * @head: head of the queue (struct cds_wfs_head pointer).
+ * @node: iterator (struct cds_wfs_node pointer).
+ * @n: struct cds_wfs_node pointer holding the next pointer (used
+ *     internally).
+ *
+ * Walking a long list popped at once otherwise takes a cache miss per
+ * node. Content written into each node before enqueue is guaranteed to
+ * be consistent, but no other memory ordering is ensured.
+ */
+#define cds_wfs_for_each_blocking_prefetch_safe(head, node, n)		   \
+	for (node = cds_wfs_first(head),				   \
+			n = (node ? cds_wfs_next_blocking(node) : NULL),   \
+			caa_prefetch(n);				   \
+		node != NULL;						   \
+		node = n, n = (node ? cds_wfs_next_blocking(node) : NULL), \
+			caa_prefetch(n))
+
 #endif /* _URCU_WFSTACK_H */
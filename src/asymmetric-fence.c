@@ -0,0 +1,119 @@
+/*
+ * asymmetric-fence.c
+ *
+ * Userspace RCU library - Asymmetric memory fences
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+#define _LGPL_SOURCE
+#include <stdlib.h>
+#include <errno.h>
+#include <pthread.h>
+#include <unistd.h>
+#include <sys/syscall.h>
+
+#include <urcu/asymmetric-fence.h>
+
+#include "urcu-die.h"
+
+/* If the headers do not support membarrier system call, fall back smp_mb. */
+#ifdef __NR_membarrier
+# define membarrier(...)		syscall(__NR_membarrier, __VA_ARGS__)
+#else
+# define membarrier(...)		-ENOSYS
+#endif
+
+enum membarrier_cmd {
+	MEMBARRIER_CMD_QUERY				= 0,
+	MEMBARRIER_CMD_SHARED				= (1 << 0),
+	/* reserved for MEMBARRIER_CMD_SHARED_EXPEDITED (1 << 1) */
+	/* reserved for MEMBARRIER_CMD_PRIVATE (1 << 2) */
+	MEMBARRIER_CMD_PRIVATE_EXPEDITED		= (1 << 3),
+	MEMBARRIER_CMD_REGISTER_PRIVATE_EXPEDITED	= (1 << 4),
+};
+
+#ifndef CONFIG_RCU_FORCE_SYS_MEMBARRIER
+/*
+ * Set once the process is registered: light fences issued before then
+ * are memory barriers.
+ */
+int cmm_asymmetric_fence_sys_membarrier;
+#endif
+
+/* Written before cmm_asymmetric_fence_sys_membarrier. */
+static int sys_membarrier, sys_membarrier_private_expedited;
+
+static pthread_once_t init_once = PTHREAD_ONCE_INIT;
+
+#ifdef CONFIG_RCU_FORCE_SYS_MEMBARRIER
+static
+void asymmetric_fence_status(bool available)
+{
+	if (!available)
+		abort();
+}
+#else
+static
+void asymmetric_fence_status(bool available)
+{
+	if (!available)
+		return;
+	CMM_STORE_SHARED(cmm_asymmetric_fence_sys_membarrier, 1);
+}
+#endif
+
+static
+void asymmetric_fence_init(void)
+{
+	bool available = false;
+	int mask;
+
+	mask = membarrier(MEMBARRIER_CMD_QUERY, 0);
+	if (mask >= 0) {
+		if (mask & MEMBARRIER_CMD_PRIVATE_EXPEDITED) {
+			if (membarrier(MEMBARRIER_CMD_REGISTER_PRIVATE_EXPEDITED, 0))
+				urcu_die(errno);
+			sys_membarrier_private_expedited = 1;
+			available = true;
+		} else if (mask & MEMBARRIER_CMD_SHARED) {
+			available = true;
+		}
+	}
+	sys_membarrier = available;
+	asymmetric_fence_status(available);
+}
+
+bool cmm_asymmetric_fence_init(void)
+{
+	int ret;
+
+	ret = pthread_once(&init_once, asymmetric_fence_init);
+	if (ret)
+		urcu_die(ret);
+	return sys_membarrier;
+}
+
+void cmm_asymmetric_fence_heavy(void)
+{
+	if (caa_likely(cmm_asymmetric_fence_init())) {
+		if (membarrier(sys_membarrier_private_expedited ?
+				MEMBARRIER_CMD_PRIVATE_EXPEDITED :
+				MEMBARRIER_CMD_SHARED, 0))
+			urcu_die(errno);
+	} else {
+		cmm_smp_mb();
+	}
+}
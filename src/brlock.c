@@ -0,0 +1,276 @@
+/*
+ * brlock.c
+ *
+ * Userspace RCU library - Per-CPU reader-writer lock
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+#define _LGPL_SOURCE
+#include <stdlib.h>
+#include <errno.h>
+#include <limits.h>
+#include <pthread.h>
+#include <unistd.h>
+
+#include <urcu/arch.h>
+#include <urcu/compiler.h>
+#include <urcu/uatomic.h>
+#include <urcu/futex.h>
+#include <urcu/tls-compat.h>
+#include <urcu/asymmetric-fence.h>
+#include <urcu/brlock.h>
+
+#include "compat-getcpu.h"
+#include "urcu-die.h"
+#include "urcu-rseq.h"
+
+/*
+ * Free-running counts of read-side locks and unlocks. A reader may
+ * unlock on another CPU than it locked on: only the sums over all CPUs
+ * are meaningful.
+ */
+struct brlock_cpu {
+	unsigned long lock_count;
+	unsigned long unlock_count;
+} __attribute__((aligned(CAA_CACHE_LINE_SIZE)));
+
+/*
+ * writer is 0 when no writer holds or waits for the lock, 1 when one
+ * does, and -1 when readers also wait for it to be released. drain is
+ * -1 when the writer waits for readers to unlock.
+ */
+struct cds_brlock {
+	int32_t writer __attribute__((aligned(CAA_CACHE_LINE_SIZE)));
+	int32_t drain;
+	unsigned long mask;		/* Number of per-CPU counters - 1. */
+	int percpu;			/* One counter per possible CPU. */
+	struct brlock_cpu *cpus;
+	pthread_mutex_t writer_mutex;
+} __attribute__((aligned(CAA_CACHE_LINE_SIZE)));
+
+/*
+ * Counters of threads for which the current CPU is unknown: each thread
+ * picks one on first use, spreading threads over the counters.
+ */
+static DEFINE_URCU_TLS(unsigned long, thread_slot);
+static unsigned long next_thread_slot;
+
+static struct brlock_cpu *get_cpu_counters(struct cds_brlock *lock)
+{
+	int cpu;
+
+	cpu = urcu_sched_getcpu();
+	if (caa_likely(cpu >= 0))
+		return &lock->cpus[cpu & lock->mask];
+	if (caa_unlikely(!URCU_TLS(thread_slot)))
+		URCU_TLS(thread_slot) =
+			uatomic_add_return(&next_thread_slot, 1);
+	return &lock->cpus[URCU_TLS(thread_slot) & lock->mask];
+}
+
+/*
+ * Add one to the lock or unlock count of the current CPU: with one
+ * counter per possible CPU, with an rseq commit rather than an atomic
+ * operation.
+ */
+static void brlock_count(struct cds_brlock *lock, int unlock)
+{
+	struct brlock_cpu *cpu;
+	int cpu_id;
+
+	while (lock->percpu) {
+		cpu_id = urcu_rseq_current_cpu();
+		if (caa_unlikely(cpu_id < 0
+				|| (unsigned long) cpu_id > lock->mask))
+			break;
+		cpu = &lock->cpus[cpu_id];
+		if (caa_likely(!urcu_rseq_addv(unlock ?
+				(intptr_t *) &cpu->unlock_count :
+				(intptr_t *) &cpu->lock_count, 1, cpu_id)))
+			return;
+	}
+	cpu = get_cpu_counters(lock);
+	if (unlock)
+		uatomic_inc(&cpu->unlock_count);
+	else
+		uatomic_inc(&cpu->lock_count);
+}
+
+struct cds_brlock *cds_brlock_new(unsigned long nr_cpus)
+{
+	struct cds_brlock *lock;
+	unsigned long nr = 1, i;
+	long nr_conf;
+
+	nr_conf = sysconf(_SC_NPROCESSORS_CONF);
+	if (!nr_cpus)
+		nr_cpus = nr_conf > 0 ? nr_conf : 1;
+	while (nr < nr_cpus)
+		nr <<= 1;
+
+	if (posix_memalign((void **) &lock, CAA_CACHE_LINE_SIZE,
+			sizeof(*lock)))
+		return NULL;
+	if (posix_memalign((void **) &lock->cpus, CAA_CACHE_LINE_SIZE,
+			nr * sizeof(*lock->cpus))) {
+		free(lock);
+		return NULL;
+	}
+	if (pthread_mutex_init(&lock->writer_mutex, NULL)) {
+		free(lock->cpus);
+		free(lock);
+		return NULL;
+	}
+	lock->writer = 0;
+	lock->drain = 0;
+	lock->mask = nr - 1;
+#ifdef URCU_RSEQ_COMMIT
+	lock->percpu = nr_conf > 0 && nr >= (unsigned long) nr_conf;
+#else
+	lock->percpu = 0;
+#endif
+	for (i = 0; i < nr; i++) {
+		lock->cpus[i].lock_count = 0;
+		lock->cpus[i].unlock_count = 0;
+	}
+	/* Have the light fences of readers be compiler barriers. */
+	(void) cmm_asymmetric_fence_init();
+	return lock;
+}
+
+void cds_brlock_destroy(struct cds_brlock *lock)
+{
+	(void) pthread_mutex_destroy(&lock->writer_mutex);
+	free(lock->cpus);
+	free(lock);
+}
+
+/* Wait for the writer to release the lock. */
+static void brlock_wait_writer(struct cds_brlock *lock)
+{
+	int32_t writer;
+
+	while ((writer = uatomic_read(&lock->writer)) != 0) {
+		if (writer == 1
+				&& uatomic_cmpxchg(&lock->writer, 1, -1) != 1)
+			continue;
+		if (futex_async(&lock->writer, FUTEX_WAIT_PRIVATE, -1,
+				NULL, NULL, 0)) {
+			switch (errno) {
+			case EWOULDBLOCK:
+			case EINTR:
+				break;
+			default:
+				/* Unexpected error. */
+				urcu_die(errno);
+			}
+		}
+	}
+}
+
+void cds_brlock_read_unlock(struct cds_brlock *lock)
+{
+	/* The writer orders the critical section with a heavy fence. */
+	cmm_asymmetric_fence_light();
+	brlock_count(lock, 1);
+	/* Count the unlock before reading drain. */
+	cmm_asymmetric_fence_light();
+	if (caa_unlikely(uatomic_read(&lock->drain) == -1)) {
+		uatomic_set(&lock->drain, 0);
+		if (futex_async(&lock->drain, FUTEX_WAKE_PRIVATE, INT_MAX,
+				NULL, NULL, 0) < 0)
+			urcu_die(errno);
+	}
+}
+
+void cds_brlock_read_lock(struct cds_brlock *lock)
+{
+	for (;;) {
+		brlock_count(lock, 0);
+		/* Count the lock before reading writer. */
+		cmm_asymmetric_fence_light();
+		/* Acquire the critical sections of previous writers. */
+		if (caa_likely(!uatomic_load_acquire(&lock->writer)))
+			return;
+		/* A writer holds or waits for the lock: back off. */
+		cds_brlock_read_unlock(lock);
+		brlock_wait_writer(lock);
+	}
+}
+
+/*
+ * Whether all readers which locked before seeing the writer flag have
+ * unlocked. Unlocks are summed first: the heavy fence orders the reads
+ * of the lock counts after the lock, and the critical section, of each
+ * reader whose unlock was counted, so that the sums only match without
+ * such reader within its critical section. Readers which lock later
+ * see the writer flag and back off.
+ */
+static int brlock_readers_drained(struct cds_brlock *lock)
+{
+	unsigned long i, locks = 0, unlocks = 0;
+
+	for (i = 0; i <= lock->mask; i++)
+		unlocks += CMM_LOAD_SHARED(lock->cpus[i].unlock_count);
+	cmm_asymmetric_fence_heavy();
+	for (i = 0; i <= lock->mask; i++)
+		locks += CMM_LOAD_SHARED(lock->cpus[i].lock_count);
+	return locks == unlocks;
+}
+
+void cds_brlock_write_lock(struct cds_brlock *lock)
+{
+	int ret;
+
+	ret = pthread_mutex_lock(&lock->writer_mutex);
+	if (ret)
+		urcu_die(ret);
+	uatomic_set(&lock->writer, 1);
+	for (;;) {
+		uatomic_set(&lock->drain, -1);
+		/* Write writer and drain before reading the counts. */
+		cmm_asymmetric_fence_heavy();
+		if (brlock_readers_drained(lock))
+			break;
+		if (futex_async(&lock->drain, FUTEX_WAIT_PRIVATE, -1,
+				NULL, NULL, 0)) {
+			switch (errno) {
+			case EWOULDBLOCK:
+			case EINTR:
+				break;
+			default:
+				/* Unexpected error. */
+				urcu_die(errno);
+			}
+		}
+	}
+	uatomic_set(&lock->drain, 0);
+}
+
+void cds_brlock_write_unlock(struct cds_brlock *lock)
+{
+	int ret;
+
+	/* Order the critical section before the release. */
+	if (uatomic_xchg(&lock->writer, 0) == -1) {
+		if (futex_async(&lock->writer, FUTEX_WAKE_PRIVATE, INT_MAX,
+				NULL, NULL, 0) < 0)
+			urcu_die(errno);
+	}
+	ret = pthread_mutex_unlock(&lock->writer_mutex);
+	if (ret)
+		urcu_die(ret);
+}
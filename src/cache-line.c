@@ -0,0 +1,137 @@
+/*
+ * cache-line.c
+ *
+ * Userspace RCU library - Runtime cache line size
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <errno.h>
+#include <stdint.h>
+#include <unistd.h>
+
+#include <urcu/system.h>
+#include <urcu/cache-line.h>
+
+#define CACHE_LINE_SIZE_MIN	16
+#define CACHE_LINE_SIZE_MAX	4096
+
+#define CACHE_LINE_SIZE_SYSFS	\
+	"/sys/devices/system/cpu/cpu0/cache/index0/coherency_line_size"
+
+static unsigned int cache_line_size;
+
+static
+int valid_size(long size)
+{
+	return size >= CACHE_LINE_SIZE_MIN && size <= CACHE_LINE_SIZE_MAX
+		&& !(size & (size - 1));
+}
+
+#ifdef __aarch64__
+/*
+ * CTR_EL0.CWG is the log2 of the cache writeback granule in words,
+ * which bounds the size of the lines of all the caches.
+ */
+static
+long arch_cache_line_size(void)
+{
+	unsigned long ctr;
+	unsigned int cwg;
+
+	__asm__ ("mrs %0, ctr_el0" : "=r" (ctr));
+	cwg = (ctr >> 24) & 0xf;
+	if (!cwg)
+		return 0;
+	return 4L << cwg;
+}
+#else
+static
+long arch_cache_line_size(void)
+{
+	return 0;
+}
+#endif
+
+static
+long sysfs_cache_line_size(void)
+{
+	FILE *fp;
+	long size;
+
+	fp = fopen(CACHE_LINE_SIZE_SYSFS, "r");
+	if (!fp)
+		return 0;
+	if (fscanf(fp, "%ld", &size) != 1)
+		size = 0;
+	fclose(fp);
+	return size;
+}
+
+static
+unsigned int detect_cache_line_size(void)
+{
+	long size;
+
+	size = arch_cache_line_size();
+	if (valid_size(size))
+		return size;
+#ifdef _SC_LEVEL1_DCACHE_LINESIZE
+	size = sysconf(_SC_LEVEL1_DCACHE_LINESIZE);
+	if (!valid_size(size))
+#endif
+		size = sysfs_cache_line_size();
+	if (!valid_size(size))
+		return CAA_CACHE_LINE_SIZE;
+#if defined(__i386__) || defined(__x86_64__)
+	/* The spatial prefetcher fetches cache lines in pairs. */
+	size *= 2;
+#endif
+	return size;
+}
+
+unsigned int caa_get_cache_line_size(void)
+{
+	unsigned int size = CMM_LOAD_SHARED(cache_line_size);
+
+	/* Concurrent first calls detect the same size. */
+	if (caa_unlikely(!size)) {
+		size = detect_cache_line_size();
+		CMM_STORE_SHARED(cache_line_size, size);
+	}
+	return size;
+}
+
+void *caa_cache_line_alloc(size_t size)
+{
+	size_t align = caa_max((size_t) caa_get_cache_line_size(),
+			(size_t) CAA_CACHE_LINE_SIZE);
+	void *p;
+	int ret;
+
+	if (size > SIZE_MAX - align) {
+		errno = ENOMEM;
+		return NULL;
+	}
+	size = (size + align - 1) & ~(align - 1);
+	ret = posix_memalign(&p, align, size ? size : align);
+	if (ret) {
+		errno = ret;
+		return NULL;
+	}
+	return p;
+}
@@ -21,7 +21,30 @@
  * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
  */
 
-#if defined(HAVE_SCHED_GETCPU)
+#if defined(HAVE_RSEQ_CPU_ID) || defined(HAVE_LINUX_RSEQ_H)
+#include <sched.h>
+#include "urcu-rseq.h"
+
+/*
+ * The cpu_id field of the rseq area of the thread, registered by glibc
+ * or by the library, is kept current by the kernel, and is read with a
+ * plain TLS load. Fall back on sched_getcpu() without rseq.
+ */
+static inline
+int urcu_sched_getcpu(void)
+{
+	int cpu;
+
+	cpu = urcu_rseq_current_cpu();
+	if (caa_likely(cpu >= 0))
+		return cpu;
+#ifdef HAVE_SCHED_GETCPU
+	return sched_getcpu();
+#else
+	return -1;
+#endif
+}
+#elif defined(HAVE_SCHED_GETCPU)
 #include <sched.h>
 
 static inline
@@ -0,0 +1,140 @@
+#ifndef _COMPAT_NUMA_H
+#define _COMPAT_NUMA_H
+
+/*
+ * compat-numa.h
+ *
+ * Userspace RCU library - CPU to NUMA node lookup
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+#include <stddef.h>
+#include "compat-getcpu.h"
+
+#ifdef __linux__
+#include <dirent.h>
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <sys/syscall.h>
+
+/*
+ * Return the NUMA node of a CPU, as found in sysfs, or -1 if unknown.
+ * This reads the file system: not meant for fast paths.
+ */
+static inline
+int urcu_numa_node_of_cpu(int cpu)
+{
+	char path[64];
+	struct dirent *entry;
+	DIR *dir;
+	int node = -1;
+
+	if (cpu < 0)
+		return -1;
+	snprintf(path, sizeof(path), "/sys/devices/system/cpu/cpu%d", cpu);
+	dir = opendir(path);
+	if (!dir)
+		return -1;
+	while ((entry = readdir(dir)) != NULL) {
+		if (!strncmp(entry->d_name, "node", 4)
+				&& entry->d_name[4] >= '0'
+				&& entry->d_name[4] <= '9') {
+			node = atoi(&entry->d_name[4]);
+			break;
+		}
+	}
+	(void) closedir(dir);
+	return node;
+}
+#else
+static inline
+int urcu_numa_node_of_cpu(int cpu)
+{
+	return -1;
+}
+#endif
+
+#if defined(__linux__) && defined(SYS_get_mempolicy)
+/* From <linux/mempolicy.h>, not available in all libc headers. */
+#define URCU_MPOL_F_NODE	(1 << 0)
+#define URCU_MPOL_F_ADDR	(1 << 1)
+
+/*
+ * Return the NUMA node of the page holding addr, or -1 if unknown. The
+ * page must be faulted in: the node of an untouched anonymous page is
+ * that of the zero page.
+ */
+static inline
+int urcu_numa_node_of_addr(void *addr)
+{
+	int node;
+
+	if (syscall(SYS_get_mempolicy, &node, NULL, 0, addr,
+			URCU_MPOL_F_NODE | URCU_MPOL_F_ADDR))
+		return -1;
+	return node;
+}
+#else
+static inline
+int urcu_numa_node_of_addr(void *addr)
+{
+	return -1;
+}
+#endif
+
+#if defined(__linux__) && defined(SYS_mbind)
+/* From <linux/mempolicy.h>, not available in all libc headers. */
+#define URCU_MPOL_PREFERRED	1
+#define URCU_MPOL_MAX_NODES	1024
+
+/*
+ * Allocate the pages of a mapping from a NUMA node when they are first
+ * touched, falling back on other nodes when it is out of memory. Failure
+ * only loses the placement optimization.
+ */
+static inline
+void urcu_numa_prefer_node(void *addr, size_t len, int node)
+{
+	unsigned long nodemask[URCU_MPOL_MAX_NODES / (sizeof(long) * 8)] = { 0 };
+	const unsigned int bits = sizeof(long) * 8;
+
+	/* The kernel ignores the last bit of the mask. */
+	if (node < 0 || node >= URCU_MPOL_MAX_NODES - 1)
+		return;
+	nodemask[node / bits] = 1UL << (node % bits);
+	(void) syscall(SYS_mbind, addr, len, URCU_MPOL_PREFERRED, nodemask,
+			URCU_MPOL_MAX_NODES, 0);
+}
+#else
+static inline
+void urcu_numa_prefer_node(void *addr, size_t len, int node)
+{
+}
+#endif
+
+/*
+ * Return the NUMA node of the CPU the caller currently runs on, or -1 if
+ * unknown.
+ */
+static inline
+int urcu_numa_current_node(void)
+{
+	return urcu_numa_node_of_cpu(urcu_sched_getcpu());
+}
+
+#endif /* _COMPAT_NUMA_H */
@@ -0,0 +1,65 @@
+/*
+ * compat_arch_aarch64.c
+ *
+ * Userspace RCU library - aarch64 LSE atomics detection
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+#ifdef __linux__
+#include <sys/auxv.h>
+#endif
+#include <urcu/uatomic.h>
+
+#ifndef HWCAP_ATOMICS
+#define HWCAP_ATOMICS	(1 << 8)
+#endif
+
+/*
+ * Using attribute "weak" for __urcu_arm64_lse_avail. It is globally
+ * visible by the entire program, even though many shared objects may
+ * have their own version. The first version that gets loaded will be
+ * used by the entire program (executable and all shared objects).
+ */
+
+/*
+ * It does not matter if the constructor is called before using the
+ * library: the LL/SC atomics are used until detection has run.
+ */
+int __attribute__((constructor)) __urcu_arm64_lse_init(void);
+
+/*
+ * -1: unknown
+ *  1: available
+ *  0: unavailable
+ */
+__attribute__((weak))
+int __urcu_arm64_lse_avail = -1;
+
+static int lse_is_available(void)
+{
+#ifdef __linux__
+	return !!(getauxval(AT_HWCAP) & HWCAP_ATOMICS);
+#else
+	return 0;
+#endif
+}
+
+int __urcu_arm64_lse_init(void)
+{
+	if (__urcu_arm64_lse_avail < 0)
+		__urcu_arm64_lse_avail = lse_is_available();
+	return __urcu_arm64_lse_avail;
+}
@@ -32,6 +32,84 @@
 #include <urcu/futex.h>
 #include <urcu/system.h>
 
+#if defined(__FreeBSD__)
+#include <limits.h>
+#include <sys/types.h>
+#include <sys/umtx.h>
+#define URCU_NATIVE_FUTEX
+#elif defined(__APPLE__)
+#include <limits.h>
+#define URCU_NATIVE_FUTEX
+
+/*
+ * Darwin wait-on-address primitives, used by the system libraries since
+ * macOS 10.12 and not declared in the SDK headers.
+ */
+#define UL_COMPARE_AND_WAIT	1
+#define ULF_WAKE_ALL		0x00000100
+
+extern int __ulock_wait(uint32_t operation, void *addr, uint64_t value,
+		uint32_t timeout_us);
+extern int __ulock_wake(uint32_t operation, void *addr, uint64_t wake_value);
+#endif
+
+#ifdef URCU_NATIVE_FUTEX
+/*
+ * _ASYNC SIGNAL-SAFE_.
+ * Wait and wake-up with the kernel wait queues keyed by address of the
+ * operating system, so that waiters on distinct futexes do not share a
+ * lock nor get woken up by each other. Unlike sys_futex, a wait on a
+ * futex which value already differs from val returns 0 rather than
+ * failing with EWOULDBLOCK, which callers re-checking the futex value
+ * handle the same way.
+ */
+static int native_futex(int32_t *uaddr, int op, int32_t val,
+	const struct timespec *timeout)
+{
+#if defined(__FreeBSD__)
+	int private = op & FUTEX_PRIVATE_FLAG;
+
+	switch (op & ~FUTEX_PRIVATE_FLAG) {
+	case FUTEX_WAIT:
+		/* A NULL size makes the last argument a relative timespec. */
+		return _umtx_op(uaddr, private ? UMTX_OP_WAIT_UINT_PRIVATE
+				: UMTX_OP_WAIT_UINT,
+			(u_long) (uint32_t) val, NULL, (void *) timeout);
+	case FUTEX_WAKE:
+		return _umtx_op(uaddr, private ? UMTX_OP_WAKE_PRIVATE
+				: UMTX_OP_WAKE,
+			val, NULL, NULL);
+	}
+#elif defined(__APPLE__)
+	uint32_t timeout_us = 0;	/* No timeout. */
+	uint64_t us;
+	int ret;
+
+	switch (op & ~FUTEX_PRIVATE_FLAG) {
+	case FUTEX_WAIT:
+		if (timeout) {
+			us = (uint64_t) timeout->tv_sec * 1000000
+				+ (timeout->tv_nsec + 999) / 1000;
+			timeout_us = us > UINT32_MAX ? UINT32_MAX :
+				(us ? us : 1);
+		}
+		ret = __ulock_wait(UL_COMPARE_AND_WAIT, uaddr,
+			(uint32_t) val, timeout_us);
+		return ret < 0 ? -1 : 0;
+	case FUTEX_WAKE:
+		ret = __ulock_wake(UL_COMPARE_AND_WAIT
+				| (val > 1 ? ULF_WAKE_ALL : 0), uaddr, 0);
+		/* ENOENT tells there was no waiter to wake up. */
+		if (ret < 0 && errno != ENOENT)
+			return -1;
+		return 0;
+	}
+#endif
+	errno = EINVAL;
+	return -1;
+}
+#endif /* URCU_NATIVE_FUTEX */
+
 /*
  * Using attribute "weak" for __urcu_compat_futex_lock and
  * __urcu_compat_futex_cond. Those are globally visible by the entire
@@ -49,6 +127,7 @@ pthread_cond_t __urcu_compat_futex_cond = PTHREAD_COND_INITIALIZER;
  * _NOT SIGNAL-SAFE_. pthread_cond is not signal-safe anyway. Though.
  * For now, timeout, uaddr2 and val3 are unused.
  * Waiter will relinquish the CPU until woken up.
+ * On FreeBSD and macOS, the native wait primitives are used instead.
  */
 
 int compat_futex_noasync(int32_t *uaddr, int op, int32_t val,
@@ -69,13 +148,17 @@ int compat_futex_noasync(int32_t *uaddr, int op, int32_t val,
 	 */
 	cmm_smp_mb();
 
+#ifdef URCU_NATIVE_FUTEX
+	return native_futex(uaddr, op, val, timeout);
+#endif
+
 	lockret = pthread_mutex_lock(&__urcu_compat_futex_lock);
 	if (lockret) {
 		errno = lockret;
 		ret = -1;
 		goto end;
 	}
-	switch (op) {
+	switch (op & ~FUTEX_PRIVATE_FLAG) {
 	case FUTEX_WAIT:
 		/*
 		 * Wait until *uaddr is changed to something else than "val".
@@ -109,8 +192,10 @@ end:
 
 /*
  * _ASYNC SIGNAL-SAFE_.
- * For now, timeout, uaddr2 and val3 are unused.
- * Waiter will busy-loop trying to read the condition.
+ * For now, uaddr2 and val3 are unused. A FUTEX_WAIT timeout is relative,
+ * and is only accurate to the polling period.
+ * Waiter will busy-loop trying to read the condition, except on FreeBSD
+ * and macOS where it sleeps in the native wait primitives.
  * It is OK to use compat_futex_async() on a futex address on which
  * futex() WAKE operations are also performed.
  */
@@ -118,25 +203,44 @@ end:
 int compat_futex_async(int32_t *uaddr, int op, int32_t val,
 	const struct timespec *timeout, int32_t *uaddr2, int32_t val3)
 {
-	int ret = 0;
+	int ret = 0, period;
+	long remain_ms = -1;
 
 	/*
 	 * Check if NULL. Don't let users expect that they are taken into
 	 * account.
 	 */
-	assert(!timeout);
 	assert(!uaddr2);
 	assert(!val3);
 
+#ifdef URCU_NATIVE_FUTEX
+	cmm_smp_mb();
+	return native_futex(uaddr, op, val, timeout);
+#endif
+
+	if (timeout)
+		remain_ms = timeout->tv_sec * 1000L
+			+ (timeout->tv_nsec + 999999) / 1000000;
+
 	/*
 	 * Ensure previous memory operations on uaddr have completed.
 	 */
 	cmm_smp_mb();
 
-	switch (op) {
+	switch (op & ~FUTEX_PRIVATE_FLAG) {
 	case FUTEX_WAIT:
 		while (CMM_LOAD_SHARED(*uaddr) == val) {
-			if (poll(NULL, 0, 10) < 0) {
+			if (!remain_ms) {
+				errno = ETIMEDOUT;
+				ret = -1;
+				goto end;
+			}
+			period = 10;
+			if (remain_ms >= 0 && remain_ms < period)
+				period = remain_ms;
+			if (remain_ms > 0)
+				remain_ms -= period;
+			if (poll(NULL, 0, period) < 0) {
 				ret = -1;
 				/* Keep poll errno. Caller handles EINTR. */
 				goto end;
@@ -152,3 +256,57 @@ int compat_futex_async(int32_t *uaddr, int op, int32_t val,
 end:
 	return ret;
 }
+
+/*
+ * _ASYNC SIGNAL-SAFE_.
+ * Polling implementation of futex_waitv_async(), with the same accuracy
+ * as compat_futex_async().
+ */
+
+int compat_futex_waitv_async(const struct urcu_futex_waiter *waiters,
+	unsigned int nr, int op, const struct timespec *timeout)
+{
+	long remain_ms = -1;
+	unsigned int i;
+	int period;
+
+	if ((op & ~FUTEX_PRIVATE_FLAG) != FUTEX_WAIT
+			|| nr > URCU_FUTEX_WAITV_MAX) {
+		errno = EINVAL;
+		return -1;
+	}
+	if (timeout)
+		remain_ms = timeout->tv_sec * 1000L
+			+ (timeout->tv_nsec + 999999) / 1000000;
+
+	/*
+	 * Ensure previous memory operations on the futexes have completed.
+	 */
+	cmm_smp_mb();
+
+	for (i = 0; i < nr; i++) {
+		if (CMM_LOAD_SHARED(*waiters[i].uaddr) != waiters[i].val) {
+			errno = EWOULDBLOCK;
+			return -1;
+		}
+	}
+	for (;;) {
+		if (!remain_ms) {
+			errno = ETIMEDOUT;
+			return -1;
+		}
+		period = 10;
+		if (remain_ms >= 0 && remain_ms < period)
+			period = remain_ms;
+		if (remain_ms > 0)
+			remain_ms -= period;
+		if (poll(NULL, 0, period) < 0) {
+			/* Keep poll errno. Caller handles EINTR. */
+			return -1;
+		}
+		for (i = 0; i < nr; i++) {
+			if (CMM_LOAD_SHARED(*waiters[i].uaddr) != waiters[i].val)
+				return i;
+		}
+	}
+}
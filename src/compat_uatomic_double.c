@@ -0,0 +1,77 @@
+/*
+ * compat_uatomic_double.c
+ *
+ * Userspace RCU library - lock-based double-word cmpxchg
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+#include <stdint.h>
+#include <pthread.h>
+#include <signal.h>
+#include <assert.h>
+#include <urcu/uatomic.h>
+
+#define NR_DOUBLE_LOCKS	64
+
+/*
+ * Using attribute "weak" for __urcu_uatomic_double_locks. It is globally
+ * visible by the entire program, even though many shared objects may
+ * have their own version. The first version that gets loaded will be
+ * used by the entire program (executable and all shared objects).
+ */
+__attribute__((weak))
+pthread_mutex_t __urcu_uatomic_double_locks[NR_DOUBLE_LOCKS] = {
+	[0 ... NR_DOUBLE_LOCKS - 1] = PTHREAD_MUTEX_INITIALIZER,
+};
+
+static pthread_mutex_t *double_lock(void *addr)
+{
+	uintptr_t v = (uintptr_t) addr / sizeof(struct uatomic_double);
+
+	return &__urcu_uatomic_double_locks[(v ^ (v >> 6))
+			& (NR_DOUBLE_LOCKS - 1)];
+}
+
+/* Signals are blocked so that handlers may use the primitive too. */
+int _compat_uatomic_cmpxchg_double(void *addr, unsigned long *old,
+		unsigned long new_lo, unsigned long new_hi)
+{
+	pthread_mutex_t *lock = double_lock(addr);
+	unsigned long *p = addr;
+	sigset_t newmask, oldmask;
+	int ret, success;
+
+	ret = sigfillset(&newmask);
+	assert(!ret);
+	ret = pthread_sigmask(SIG_BLOCK, &newmask, &oldmask);
+	assert(!ret);
+	ret = pthread_mutex_lock(lock);
+	assert(!ret);
+	if (p[0] == old[0] && p[1] == old[1]) {
+		CMM_STORE_SHARED(p[0], new_lo);
+		CMM_STORE_SHARED(p[1], new_hi);
+		success = 1;
+	} else {
+		old[0] = p[0];
+		old[1] = p[1];
+		success = 0;
+	}
+	ret = pthread_mutex_unlock(lock);
+	assert(!ret);
+	ret = pthread_sigmask(SIG_SETMASK, &oldmask, NULL);
+	assert(!ret);
+	return success;
+}
@@ -89,3 +89,32 @@ struct cds_lfs_head *__cds_lfs_pop_all(cds_lfs_stack_ptr_t s)
 {
 	return ___cds_lfs_pop_all(s);
 }
+
+void cds_lfs_elim_init(struct cds_lfs_elim *elim)
+{
+	_cds_lfs_elim_init(elim);
+}
+
+bool cds_lfs_push_elim(cds_lfs_stack_ptr_t s, struct cds_lfs_elim *elim,
+		struct cds_lfs_node *node)
+{
+	return _cds_lfs_push_elim(s, elim, node);
+}
+
+struct cds_lfs_node *cds_lfs_pop_elim_blocking(struct cds_lfs_stack *s,
+		struct cds_lfs_elim *elim)
+{
+	return _cds_lfs_pop_elim_blocking(s, elim);
+}
+
+struct cds_lfs_node *__cds_lfs_pop_elim(cds_lfs_stack_ptr_t s,
+		struct cds_lfs_elim *elim)
+{
+	return ___cds_lfs_pop_elim(s, elim);
+}
+
+struct cds_lfs_node *__cds_lfs_pop_hazptr(cds_lfs_stack_ptr_t s,
+		struct urcu_hazptr_rec *rec)
+{
+	return ___cds_lfs_pop_hazptr(s, rec);
+}
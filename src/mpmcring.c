@@ -0,0 +1,55 @@
+/*
+ * mpmcring.c
+ *
+ * Userspace RCU library - Bounded Lock-Free Multi-Producer/Multi-Consumer Ring
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+/* Do not #define _LGPL_SOURCE to ensure we can emit the wrapper symbols */
+#include "urcu/mpmcring.h"
+#include "urcu/static/mpmcring.h"
+
+/*
+ * library wrappers to be used by non-LGPL compatible source code.
+ */
+
+int cds_mpmc_ring_init(struct cds_mpmc_ring *ring,
+		struct cds_mpmc_ring_slot *slots, unsigned long capacity)
+{
+	return _cds_mpmc_ring_init(ring, slots, capacity);
+}
+
+bool cds_mpmc_ring_try_enqueue(struct cds_mpmc_ring *ring, void *data)
+{
+	return _cds_mpmc_ring_try_enqueue(ring, data);
+}
+
+bool cds_mpmc_ring_try_dequeue(struct cds_mpmc_ring *ring, void **data)
+{
+	return _cds_mpmc_ring_try_dequeue(ring, data);
+}
+
+unsigned long cds_mpmc_ring_enqueue_bulk(struct cds_mpmc_ring *ring,
+		void **data, unsigned long n)
+{
+	return _cds_mpmc_ring_enqueue_bulk(ring, data, n);
+}
+
+unsigned long cds_mpmc_ring_dequeue_bulk(struct cds_mpmc_ring *ring,
+		void **data, unsigned long n)
+{
+	return _cds_mpmc_ring_dequeue_bulk(ring, data, n);
+}
@@ -0,0 +1,318 @@
+/*
+ * pipeline.c
+ *
+ * Userspace RCU library - Multi-stage pipeline over wfcqueue
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+/*
+ * Each stage runs on a workqueue with one worker per worker of the
+ * stage, and has a single work item, queued with URCU_WORK_COALESCE
+ * whenever nodes are queued to the stage: queueing it again while it
+ * runs has another worker run it concurrently, so a stage uses as many
+ * workers as it has batches of nodes in progress, and workers only
+ * sleep, on their workqueue futex, once their stage is empty.
+ */
+
+#define _LGPL_SOURCE
+#include <stdlib.h>
+#include <errno.h>
+#include <limits.h>
+#include <pthread.h>
+
+#include <urcu/compiler.h>
+#include <urcu/uatomic.h>
+#include <urcu/futex.h>
+#include <urcu/wfcqueue.h>
+#include <urcu/pipeline.h>
+
+#include "urcu-die.h"
+#include "urcu-stats.h"
+#include "workqueue.h"
+
+struct pipeline_stage {
+	struct cds_wfcq_head head;	/* Input queue. */
+	struct cds_wfcq_tail tail;
+	struct urcu_work work;		/* Drains the input queue. */
+	struct cds_pipeline *pipeline;
+	struct pipeline_stage *next;
+	struct urcu_workqueue *workqueue;
+	int (*fn)(struct cds_pipeline_node *node, void *priv);
+	void *priv;
+
+	pthread_mutex_t stats_lock;	/* Protects stats. */
+	struct cds_pipeline_stage_stats stats;
+};
+
+struct cds_pipeline {
+	unsigned long max_in_flight;
+	unsigned long in_flight;
+	int32_t futex;			/* -1 while submitters wait. */
+	unsigned int nr_stages;
+	struct pipeline_stage **stages;
+};
+
+static void mutex_lock(pthread_mutex_t *mutex)
+{
+	int ret;
+
+	ret = pthread_mutex_lock(mutex);
+	if (ret)
+		urcu_die(ret);
+}
+
+static void mutex_unlock(pthread_mutex_t *mutex)
+{
+	int ret;
+
+	ret = pthread_mutex_unlock(mutex);
+	if (ret)
+		urcu_die(ret);
+}
+
+/* Wait for the pipeline to hold less than limit nodes. */
+static void pipeline_wait(struct cds_pipeline *pipeline, unsigned long limit)
+{
+	for (;;) {
+		uatomic_set(&pipeline->futex, -1);
+		/* Write futex before reading in_flight. */
+		cmm_smp_mb();
+		if (uatomic_read(&pipeline->in_flight) < limit)
+			return;
+		if (futex_async(&pipeline->futex, FUTEX_WAIT_PRIVATE, -1,
+				NULL, NULL, 0)) {
+			switch (errno) {
+			case EWOULDBLOCK:
+			case EINTR:
+				break;
+			default:
+				/* Unexpected error. */
+				urcu_die(errno);
+			}
+		}
+	}
+}
+
+/* Account for nr nodes leaving the pipeline, and wake waiters. */
+static void pipeline_release(struct cds_pipeline *pipeline, unsigned long nr)
+{
+	uatomic_sub(&pipeline->in_flight, nr);
+	/* Write in_flight before reading futex. */
+	cmm_smp_mb();
+	if (caa_unlikely(uatomic_read(&pipeline->futex) == -1)) {
+		uatomic_set(&pipeline->futex, 0);
+		if (futex_async(&pipeline->futex, FUTEX_WAKE_PRIVATE, INT_MAX,
+				NULL, NULL, 0) < 0)
+			urcu_die(errno);
+	}
+}
+
+static void stage_drain(struct urcu_work *work);
+
+/* Have a worker of stage drain its input queue. */
+static void stage_kick(struct pipeline_stage *stage)
+{
+	(void) urcu_workqueue_queue_delayed_work(stage->workqueue,
+			&stage->work, stage_drain, 0, URCU_WORK_COALESCE);
+}
+
+static void stage_drain(struct urcu_work *work)
+{
+	struct pipeline_stage *stage =
+		caa_container_of(work, struct pipeline_stage, work);
+	struct __cds_wfcq_head batch_head, out_head;
+	struct cds_wfcq_tail batch_tail, out_tail;
+	struct cds_wfcq_node *node, *n;
+	struct cds_pipeline_node *pnode;
+	unsigned long nr = 0, nr_out = 0;
+	uint64_t start_ns, end_ns, wait_ns, wait_sum_ns = 0, wait_max_ns = 0;
+	enum cds_wfcq_ret splice_ret;
+
+	/*
+	 * The work is no longer pending: read the input queue after
+	 * clearing pending, so nodes queued by producers which saw it
+	 * pending are in the batch.
+	 */
+	cmm_smp_mb();
+	__cds_wfcq_init(&batch_head, &batch_tail);
+	__cds_wfcq_init(&out_head, &out_tail);
+	cds_wfcq_dequeue_lock(&stage->head, &stage->tail);
+	splice_ret = __cds_wfcq_splice_blocking(&batch_head, &batch_tail,
+			&stage->head, &stage->tail);
+	cds_wfcq_dequeue_unlock(&stage->head, &stage->tail);
+	if (splice_ret == CDS_WFCQ_RET_SRC_EMPTY)
+		return;
+
+	start_ns = urcu_stats_now_ns();
+	__cds_wfcq_for_each_blocking_safe(&batch_head, &batch_tail, node, n) {
+		pnode = caa_container_of(node, struct cds_pipeline_node, node);
+		wait_ns = start_ns - pnode->enqueue_ns;
+		wait_sum_ns += wait_ns;
+		wait_max_ns = caa_max(wait_max_ns, wait_ns);
+		nr++;
+		if (stage->fn(pnode, stage->priv) == CDS_PIPELINE_FORWARD
+				&& stage->next) {
+			cds_wfcq_node_init(node);
+			(void) cds_wfcq_enqueue(&out_head, &out_tail, node);
+			nr_out++;
+		}
+	}
+	end_ns = urcu_stats_now_ns();
+
+	if (nr_out) {
+		__cds_wfcq_for_each_blocking(&out_head, &out_tail, node) {
+			pnode = caa_container_of(node,
+					struct cds_pipeline_node, node);
+			pnode->enqueue_ns = end_ns;
+		}
+		(void) __cds_wfcq_splice_blocking(&stage->next->head,
+				&stage->next->tail, &out_head, &out_tail);
+		stage_kick(stage->next);
+	}
+	if (nr != nr_out)
+		pipeline_release(stage->pipeline, nr - nr_out);
+
+	mutex_lock(&stage->stats_lock);
+	CMM_STORE_SHARED(stage->stats.nodes, stage->stats.nodes + nr);
+	CMM_STORE_SHARED(stage->stats.batches, stage->stats.batches + 1);
+	CMM_STORE_SHARED(stage->stats.busy_ns,
+		stage->stats.busy_ns + end_ns - start_ns);
+	CMM_STORE_SHARED(stage->stats.wait_sum_ns,
+		stage->stats.wait_sum_ns + wait_sum_ns);
+	if (wait_max_ns > stage->stats.wait_max_ns)
+		CMM_STORE_SHARED(stage->stats.wait_max_ns, wait_max_ns);
+	mutex_unlock(&stage->stats_lock);
+}
+
+struct cds_pipeline *cds_pipeline_create(unsigned long max_in_flight)
+{
+	struct cds_pipeline *pipeline;
+
+	pipeline = calloc(1, sizeof(*pipeline));
+	if (!pipeline)
+		return NULL;
+	pipeline->max_in_flight = max_in_flight ? max_in_flight : ULONG_MAX;
+	return pipeline;
+}
+
+int cds_pipeline_add_stage(struct cds_pipeline *pipeline,
+		unsigned int nr_workers,
+		int (*fn)(struct cds_pipeline_node *node, void *priv),
+		void *priv)
+{
+	struct pipeline_stage *stage, **stages;
+	int ret;
+
+	if (!nr_workers)
+		return -EINVAL;
+	stages = realloc(pipeline->stages,
+			(pipeline->nr_stages + 1) * sizeof(*stages));
+	if (!stages)
+		return -ENOMEM;
+	pipeline->stages = stages;
+	stage = calloc(1, sizeof(*stage));
+	if (!stage)
+		return -ENOMEM;
+	cds_wfcq_init(&stage->head, &stage->tail);
+	stage->pipeline = pipeline;
+	stage->fn = fn;
+	stage->priv = priv;
+	ret = pthread_mutex_init(&stage->stats_lock, NULL);
+	if (ret)
+		urcu_die(ret);
+	stage->workqueue = urcu_workqueue_create_nr(0, -1, nr_workers, NULL,
+			NULL, NULL, NULL, NULL, NULL, NULL, NULL);
+	if (!stage->workqueue) {
+		ret = pthread_mutex_destroy(&stage->stats_lock);
+		if (ret)
+			urcu_die(ret);
+		cds_wfcq_destroy(&stage->head, &stage->tail);
+		free(stage);
+		return -ENOMEM;
+	}
+	if (pipeline->nr_stages)
+		stages[pipeline->nr_stages - 1]->next = stage;
+	stages[pipeline->nr_stages] = stage;
+	return pipeline->nr_stages++;
+}
+
+int cds_pipeline_try_submit(struct cds_pipeline *pipeline,
+		struct cds_pipeline_node *node)
+{
+	struct pipeline_stage *stage = pipeline->stages[0];
+
+	if (uatomic_add_return(&pipeline->in_flight, 1)
+			> pipeline->max_in_flight) {
+		pipeline_release(pipeline, 1);
+		return -EAGAIN;
+	}
+	node->enqueue_ns = urcu_stats_now_ns();
+	cds_wfcq_node_init(&node->node);
+	(void) cds_wfcq_enqueue(&stage->head, &stage->tail, &node->node);
+	stage_kick(stage);
+	return 0;
+}
+
+void cds_pipeline_submit(struct cds_pipeline *pipeline,
+		struct cds_pipeline_node *node)
+{
+	while (cds_pipeline_try_submit(pipeline, node))
+		pipeline_wait(pipeline, pipeline->max_in_flight);
+}
+
+void cds_pipeline_drain(struct cds_pipeline *pipeline)
+{
+	pipeline_wait(pipeline, 1);
+}
+
+int cds_pipeline_get_stage_stats(struct cds_pipeline *pipeline,
+		unsigned int stage, struct cds_pipeline_stage_stats *stats)
+{
+	struct pipeline_stage *s;
+
+	if (stage >= pipeline->nr_stages)
+		return -EINVAL;
+	s = pipeline->stages[stage];
+	mutex_lock(&s->stats_lock);
+	*stats = s->stats;
+	mutex_unlock(&s->stats_lock);
+	return 0;
+}
+
+void cds_pipeline_destroy(struct cds_pipeline *pipeline)
+{
+	struct pipeline_stage *stage;
+	unsigned int i;
+	int ret;
+
+	cds_pipeline_drain(pipeline);
+	/* Stages may still kick the next one: stop them in order. */
+	for (i = 0; i < pipeline->nr_stages; i++) {
+		stage = pipeline->stages[i];
+		urcu_workqueue_flush_queued_work(stage->workqueue);
+		urcu_workqueue_destroy(stage->workqueue);
+	}
+	for (i = 0; i < pipeline->nr_stages; i++) {
+		stage = pipeline->stages[i];
+		ret = pthread_mutex_destroy(&stage->stats_lock);
+		if (ret)
+			urcu_die(ret);
+		cds_wfcq_destroy(&stage->head, &stage->tail);
+		free(stage);
+	}
+	free(pipeline->stages);
+	free(pipeline);
+}
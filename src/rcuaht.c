@@ -0,0 +1,530 @@
+/*
+ * rcuaht.c
+ *
+ * Userspace RCU library - RCU hash table of 32-bit indexed arena nodes
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+/*
+ * Nodes and buckets form a single list sorted by reverse hash, as in
+ * cds_lfht, where a bucket precedes the nodes of the same reverse hash.
+ * A link is 0 at the end of the list, the index of a bucket shifted by
+ * one and flagged, or the index of an object plus one, shifted by one.
+ * The arena and the buckets are each a single mapping reserved at
+ * creation, whose pages are populated when first written, so that they
+ * never move and readers translate links without synchronization.
+ *
+ * Readers follow the links of removed nodes, which are not modified
+ * until the object is reclaimed, after a grace period. Free objects
+ * link to each other through the same field, in a list protected by
+ * the mutex of the table.
+ */
+
+#define _LGPL_SOURCE
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <errno.h>
+#include <pthread.h>
+#include <sys/mman.h>
+
+#include <urcu/compiler.h>
+#include <urcu/arch.h>
+#include <urcu/uatomic.h>
+#include <urcu/call-rcu.h>
+#include <urcu/flavor.h>
+#include <urcu/static/rculfhash.h>
+#include <urcu/rcuaht.h>
+
+#include "urcu-die.h"
+
+#ifndef MAP_ANONYMOUS
+#define MAP_ANONYMOUS		MAP_ANON
+#endif
+
+#ifndef MAP_NORESERVE
+#define MAP_NORESERVE		0
+#endif
+
+#define AHT_BUCKET_LINK		1U
+#define AHT_END_LINK		0U
+
+/* Removed objects reclaimed by each call_rcu(). */
+#define AHT_RECLAIM_BATCH	64
+
+struct aht_reclaim {
+	struct rcu_head head;
+	struct cds_aht *ht;
+	unsigned int nr;
+	uint32_t index[AHT_RECLAIM_BATCH];
+};
+
+struct cds_aht {
+	char *arena;
+	struct cds_aht_node *buckets;
+	size_t obj_size;
+	size_t node_offset;
+	unsigned long max_nodes;
+	unsigned long max_buckets;
+	unsigned long size;		/* ATOMIC: number of buckets. */
+	unsigned long count;		/* ATOMIC */
+	/* Protected by lock. */
+	unsigned long nr_used;		/* Objects ever allocated. */
+	uint32_t free_head;		/* Index plus one, or 0. */
+	struct aht_reclaim *reclaim;	/* Batch being filled. */
+	const struct rcu_flavor_struct *flavor;
+	pthread_mutex_t lock;
+};
+
+static void mutex_lock(pthread_mutex_t *mutex)
+{
+	int ret;
+
+	ret = pthread_mutex_lock(mutex);
+	if (ret)
+		urcu_die(ret);
+}
+
+static void mutex_unlock(pthread_mutex_t *mutex)
+{
+	int ret;
+
+	ret = pthread_mutex_unlock(mutex);
+	if (ret)
+		urcu_die(ret);
+}
+
+static inline
+uint32_t reverse_hash(unsigned long hash)
+{
+	return _cds_lfht_bit_reverse_u32((uint32_t) hash);
+}
+
+static inline
+struct cds_aht_node *obj_node(const struct cds_aht *ht, uint32_t index)
+{
+	return (struct cds_aht_node *) (ht->arena + index * ht->obj_size
+		+ ht->node_offset);
+}
+
+static inline
+uint32_t node_index(const struct cds_aht *ht, const struct cds_aht_node *node)
+{
+	return ((const char *) node - ht->node_offset - ht->arena)
+		/ ht->obj_size;
+}
+
+static inline
+uint32_t node_link(uint32_t index)
+{
+	return (index + 1) << 1;
+}
+
+static inline
+uint32_t bucket_link(unsigned long bucket)
+{
+	return ((uint32_t) bucket << 1) | AHT_BUCKET_LINK;
+}
+
+static inline
+int is_bucket_link(uint32_t link)
+{
+	return link & AHT_BUCKET_LINK;
+}
+
+static inline
+struct cds_aht_node *link_node(const struct cds_aht *ht, uint32_t link)
+{
+	if (is_bucket_link(link))
+		return &ht->buckets[link >> 1];
+	return obj_node(ht, (link >> 1) - 1);
+}
+
+/* The node content is written before the link is published. */
+static inline
+uint32_t load_link(const struct cds_aht_node *node)
+{
+	uint32_t link = CMM_LOAD_SHARED(node->next);
+
+	cmm_smp_read_barrier_depends();
+	return link;
+}
+
+static inline
+struct cds_aht_node *bucket_of(const struct cds_aht *ht, unsigned long hash,
+		unsigned long size)
+{
+	return &ht->buckets[hash & (size - 1)];
+}
+
+static
+void *memory_map(size_t length)
+{
+	void *ptr;
+
+	ptr = mmap(NULL, length, PROT_READ | PROT_WRITE,
+		MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+	return ptr == MAP_FAILED ? NULL : ptr;
+}
+
+static
+void memory_unmap(void *ptr, size_t length)
+{
+	if (munmap(ptr, length))
+		urcu_die(errno);
+}
+
+/*
+ * Link bucket @bucket after the nodes of its parent bucket, the bucket
+ * of its index without its most significant bit, of a lower reverse
+ * hash.
+ */
+static
+void link_bucket(struct cds_aht *ht, unsigned long bucket)
+{
+	struct cds_aht_node *pred, *node, *new = &ht->buckets[bucket];
+	uint32_t rhash = reverse_hash(bucket), link;
+	unsigned long parent;
+
+	parent = bucket & ~(1UL << (CAA_BITS_PER_LONG - 1
+		- __builtin_clzl(bucket)));
+	pred = &ht->buckets[parent];
+	for (;;) {
+		link = pred->next;
+		if (link == AHT_END_LINK)
+			break;
+		node = link_node(ht, link);
+		if (node->reverse_hash >= rhash)
+			break;
+		pred = node;
+	}
+	new->reverse_hash = rhash;
+	new->next = link;
+	uatomic_store_release(&pred->next, bucket_link(bucket));
+}
+
+/* Link the buckets up to @size, then let readers use them. */
+static
+void set_size(struct cds_aht *ht, unsigned long size)
+{
+	unsigned long bucket;
+
+	for (bucket = ht->size; bucket < size; bucket++)
+		link_bucket(ht, bucket);
+	uatomic_store_release(&ht->size, size);
+}
+
+/*
+ * Find the node of a key, and the node it follows. Without match, the
+ * predecessor is the last node of a lower or equal reverse hash, after
+ * which a node of the hash goes.
+ */
+static
+struct cds_aht_node *find(struct cds_aht *ht, unsigned long hash,
+		cds_aht_match_fct match, const void *key,
+		struct cds_aht_node **pred_ret)
+{
+	struct cds_aht_node *pred, *node;
+	uint32_t rhash = reverse_hash(hash), link;
+
+	pred = bucket_of(ht, hash, ht->size);
+	for (;;) {
+		link = pred->next;
+		if (link == AHT_END_LINK)
+			break;
+		node = link_node(ht, link);
+		if (node->reverse_hash > rhash)
+			break;
+		if (!is_bucket_link(link) && node->reverse_hash == rhash
+				&& match(node, key)) {
+			*pred_ret = pred;
+			return node;
+		}
+		pred = node;
+	}
+	*pred_ret = pred;
+	return NULL;
+}
+
+static
+void push_free(struct cds_aht *ht, uint32_t index)
+{
+	obj_node(ht, index)->next = ht->free_head;
+	ht->free_head = index + 1;
+}
+
+static
+void reclaim_batch(struct rcu_head *head)
+{
+	struct aht_reclaim *reclaim =
+		caa_container_of(head, struct aht_reclaim, head);
+	struct cds_aht *ht = reclaim->ht;
+	unsigned int i;
+
+	mutex_lock(&ht->lock);
+	for (i = 0; i < reclaim->nr; i++)
+		push_free(ht, reclaim->index[i]);
+	mutex_unlock(&ht->lock);
+	free(reclaim);
+}
+
+/* Reclaim the object of @node after a grace period. */
+static
+void retire(struct cds_aht *ht, struct cds_aht_node *node)
+{
+	struct aht_reclaim *reclaim = ht->reclaim;
+
+	if (!reclaim) {
+		reclaim = malloc(sizeof(*reclaim));
+		if (!reclaim) {
+			ht->flavor->update_synchronize_rcu();
+			push_free(ht, node_index(ht, node));
+			return;
+		}
+		reclaim->ht = ht;
+		reclaim->nr = 0;
+		ht->reclaim = reclaim;
+	}
+	reclaim->index[reclaim->nr++] = node_index(ht, node);
+	if (reclaim->nr == AHT_RECLAIM_BATCH) {
+		ht->reclaim = NULL;
+		ht->flavor->update_call_rcu(&reclaim->head, reclaim_batch);
+	}
+}
+
+struct cds_aht *cds_aht_new_flavor(size_t obj_size, size_t node_offset,
+		unsigned long max_nodes, unsigned long init_size,
+		const struct rcu_flavor_struct *flavor)
+{
+	struct cds_aht *ht;
+	unsigned long size = 1;
+	int ret;
+
+	if (obj_size % sizeof(uint32_t) || node_offset % sizeof(uint32_t)
+			|| node_offset > obj_size
+			|| obj_size - node_offset < sizeof(struct cds_aht_node)
+			|| !max_nodes || max_nodes > CDS_AHT_MAX_NODES
+			|| max_nodes > SIZE_MAX / obj_size)
+		return NULL;
+	ht = calloc(1, sizeof(*ht));
+	if (!ht)
+		return NULL;
+	ht->obj_size = obj_size;
+	ht->node_offset = node_offset;
+	ht->max_nodes = max_nodes;
+	ht->max_buckets = 1;
+	while (ht->max_buckets < max_nodes)
+		ht->max_buckets <<= 1;
+	if (ht->max_buckets > SIZE_MAX / sizeof(struct cds_aht_node))
+		goto error;
+	ht->arena = memory_map(max_nodes * obj_size);
+	if (!ht->arena)
+		goto error;
+	ht->buckets = memory_map(ht->max_buckets * sizeof(struct cds_aht_node));
+	if (!ht->buckets) {
+		memory_unmap(ht->arena, max_nodes * obj_size);
+		goto error;
+	}
+	ht->flavor = flavor;
+	ret = pthread_mutex_init(&ht->lock, NULL);
+	if (ret)
+		urcu_die(ret);
+	/* Bucket 0 heads the list. */
+	ht->size = 1;
+	while (size < init_size && size < ht->max_buckets)
+		size <<= 1;
+	set_size(ht, size);
+	return ht;
+
+error:
+	free(ht);
+	return NULL;
+}
+
+void cds_aht_destroy(struct cds_aht *ht)
+{
+	int ret;
+
+	/* Wait for readers and the reclaims of removed objects. */
+	ht->flavor->update_synchronize_rcu();
+	ht->flavor->barrier();
+	free(ht->reclaim);
+	memory_unmap(ht->arena, ht->max_nodes * ht->obj_size);
+	memory_unmap(ht->buckets,
+		ht->max_buckets * sizeof(struct cds_aht_node));
+	ret = pthread_mutex_destroy(&ht->lock);
+	if (ret)
+		urcu_die(ret);
+	free(ht);
+}
+
+void *cds_aht_alloc(struct cds_aht *ht)
+{
+	struct aht_reclaim *reclaim;
+	uint32_t index;
+	char *obj;
+	unsigned int i;
+
+	mutex_lock(&ht->lock);
+	if (!ht->free_head && ht->nr_used == ht->max_nodes && ht->reclaim) {
+		/* Reclaim the batch being filled at once. */
+		reclaim = ht->reclaim;
+		ht->reclaim = NULL;
+		ht->flavor->update_synchronize_rcu();
+		for (i = 0; i < reclaim->nr; i++)
+			push_free(ht, reclaim->index[i]);
+		free(reclaim);
+	}
+	if (ht->free_head) {
+		index = ht->free_head - 1;
+		ht->free_head = obj_node(ht, index)->next;
+		obj = ht->arena + index * ht->obj_size;
+		memset(obj, 0, ht->obj_size);
+	} else if (ht->nr_used < ht->max_nodes) {
+		/* Pages never written are zeroed. */
+		obj = ht->arena + ht->nr_used++ * ht->obj_size;
+	} else {
+		obj = NULL;
+	}
+	mutex_unlock(&ht->lock);
+	return obj;
+}
+
+void cds_aht_free(struct cds_aht *ht, void *obj)
+{
+	mutex_lock(&ht->lock);
+	push_free(ht, ((char *) obj - ht->arena) / ht->obj_size);
+	mutex_unlock(&ht->lock);
+}
+
+struct cds_aht_node *cds_aht_lookup(struct cds_aht *ht, unsigned long hash,
+		cds_aht_match_fct match, const void *key)
+{
+	struct cds_aht_node *node;
+	uint32_t rhash = reverse_hash(hash), link;
+
+	node = bucket_of(ht, hash, uatomic_load_acquire(&ht->size));
+	for (;;) {
+		link = load_link(node);
+		if (link == AHT_END_LINK)
+			return NULL;
+		node = link_node(ht, link);
+		if (node->reverse_hash > rhash)
+			return NULL;
+		if (!is_bucket_link(link) && node->reverse_hash == rhash
+				&& match(node, key))
+			return node;
+	}
+}
+
+static
+int aht_add(struct cds_aht *ht, unsigned long hash, struct cds_aht_node *node,
+		cds_aht_match_fct match, const void *key, int replace)
+{
+	struct cds_aht_node *pred, *old;
+	unsigned long count;
+
+	mutex_lock(&ht->lock);
+	old = find(ht, hash, match, key, &pred);
+	if (old && !replace) {
+		mutex_unlock(&ht->lock);
+		return -EEXIST;
+	}
+	node->reverse_hash = reverse_hash(hash);
+	if (old) {
+		node->next = old->next;
+		uatomic_store_release(&pred->next,
+			node_link(node_index(ht, node)));
+		retire(ht, old);
+		mutex_unlock(&ht->lock);
+		return 1;
+	}
+	node->next = pred->next;
+	uatomic_store_release(&pred->next, node_link(node_index(ht, node)));
+	count = uatomic_add_return(&ht->count, 1);
+	if (count > ht->size && ht->size < ht->max_buckets)
+		set_size(ht, ht->size << 1);
+	mutex_unlock(&ht->lock);
+	return 0;
+}
+
+int cds_aht_add_unique(struct cds_aht *ht, unsigned long hash,
+		struct cds_aht_node *node, cds_aht_match_fct match,
+		const void *key)
+{
+	return aht_add(ht, hash, node, match, key, 0);
+}
+
+int cds_aht_add_replace(struct cds_aht *ht, unsigned long hash,
+		struct cds_aht_node *node, cds_aht_match_fct match,
+		const void *key)
+{
+	return aht_add(ht, hash, node, match, key, 1);
+}
+
+int cds_aht_del(struct cds_aht *ht, struct cds_aht_node *node)
+{
+	struct cds_aht_node *pred, *next;
+	uint32_t link, target = node_link(node_index(ht, node));
+
+	mutex_lock(&ht->lock);
+	/* The low bits of the hash are those of the reverse hash. */
+	pred = bucket_of(ht, _cds_lfht_bit_reverse_u32(node->reverse_hash),
+		ht->size);
+	for (;;) {
+		link = pred->next;
+		if (link == AHT_END_LINK)
+			break;
+		next = link_node(ht, link);
+		if (link == target) {
+			CMM_STORE_SHARED(pred->next, node->next);
+			uatomic_dec(&ht->count);
+			retire(ht, node);
+			mutex_unlock(&ht->lock);
+			return 0;
+		}
+		if (next->reverse_hash > node->reverse_hash)
+			break;
+		pred = next;
+	}
+	mutex_unlock(&ht->lock);
+	return -ENOENT;
+}
+
+struct cds_aht_node *cds_aht_next(struct cds_aht *ht,
+		struct cds_aht_node *node)
+{
+	uint32_t link;
+
+	for (;;) {
+		link = load_link(node);
+		if (link == AHT_END_LINK)
+			return NULL;
+		node = link_node(ht, link);
+		if (!is_bucket_link(link))
+			return node;
+	}
+}
+
+struct cds_aht_node *cds_aht_first(struct cds_aht *ht)
+{
+	return cds_aht_next(ht, &ht->buckets[0]);
+}
+
+unsigned long cds_aht_count(struct cds_aht *ht)
+{
+	return uatomic_read(&ht->count);
+}
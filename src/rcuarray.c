@@ -0,0 +1,251 @@
+/*
+ * rcuarray.c
+ *
+ * Userspace RCU library - RCU copy-on-write array
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+#define _LGPL_SOURCE
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <errno.h>
+#include <assert.h>
+#include <pthread.h>
+
+#include <urcu/compiler.h>
+#include <urcu/pointer.h>
+#include <urcu/call-rcu.h>
+#include <urcu/flavor.h>
+#include <urcu/rcuarray.h>
+
+#include "urcu-die.h"
+
+#define RCU_ARRAY_MIN_CAPACITY	4
+
+static void mutex_lock(pthread_mutex_t *mutex)
+{
+	int ret;
+
+	ret = pthread_mutex_lock(mutex);
+	if (ret)
+		urcu_die(ret);
+}
+
+static void mutex_unlock(pthread_mutex_t *mutex)
+{
+	int ret;
+
+	ret = pthread_mutex_unlock(mutex);
+	if (ret)
+		urcu_die(ret);
+}
+
+static
+struct cds_rcu_array_data *alloc_data(size_t elem_size, size_t capacity)
+{
+	struct cds_rcu_array_data *data;
+
+	if (capacity > (SIZE_MAX - sizeof(*data)) / (elem_size ? : 1))
+		return NULL;
+	data = malloc(sizeof(*data) + capacity * elem_size);
+	if (!data)
+		return NULL;
+	data->len = 0;
+	data->capacity = capacity;
+	data->elem_size = elem_size;
+	return data;
+}
+
+static
+void free_data(struct rcu_head *head)
+{
+	free(caa_container_of(head, struct cds_rcu_array_data, head));
+}
+
+/* Copy of @data with room for @capacity elements, at least its length. */
+static
+struct cds_rcu_array_data *copy_data(const struct cds_rcu_array_data *data,
+		size_t capacity)
+{
+	struct cds_rcu_array_data *copy;
+
+	copy = alloc_data(data->elem_size, capacity);
+	if (!copy)
+		return NULL;
+	copy->len = data->len;
+	memcpy(copy->elems, data->elems, data->len * data->elem_size);
+	return copy;
+}
+
+/* Make room for @len elements in the copy of an update. */
+static
+int reserve_copy(struct cds_rcu_array *array, size_t len)
+{
+	struct cds_rcu_array_data *copy = array->copy, *new_copy;
+	size_t capacity = copy->capacity;
+
+	if (len <= capacity)
+		return 0;
+	while (capacity < len) {
+		if (capacity > SIZE_MAX / 2)
+			return -ENOMEM;
+		capacity *= 2;
+	}
+	new_copy = copy_data(copy, capacity);
+	if (!new_copy)
+		return -ENOMEM;
+	free(copy);
+	array->copy = new_copy;
+	return 0;
+}
+
+/* Publish @data, and free the previous version after a grace period. */
+static
+void publish(struct cds_rcu_array *array, struct cds_rcu_array_data *data)
+{
+	struct cds_rcu_array_data *old = array->data;
+
+	rcu_set_pointer(&array->data, data);
+	array->flavor->update_call_rcu(&old->head, free_data);
+}
+
+int cds_rcu_array_init_flavor(struct cds_rcu_array *array, size_t elem_size,
+		const struct rcu_flavor_struct *flavor)
+{
+	int ret;
+
+	array->data = alloc_data(elem_size, RCU_ARRAY_MIN_CAPACITY);
+	if (!array->data)
+		return -ENOMEM;
+	array->copy = NULL;
+	array->elem_size = elem_size;
+	array->flavor = flavor;
+	ret = pthread_mutex_init(&array->lock, NULL);
+	if (ret)
+		urcu_die(ret);
+	return 0;
+}
+
+void cds_rcu_array_destroy(struct cds_rcu_array *array)
+{
+	int ret;
+
+	assert(!array->copy);
+	free(array->data);
+	array->data = NULL;
+	ret = pthread_mutex_destroy(&array->lock);
+	if (ret)
+		urcu_die(ret);
+}
+
+int cds_rcu_array_update_begin(struct cds_rcu_array *array)
+{
+	struct cds_rcu_array_data *data;
+
+	mutex_lock(&array->lock);
+	data = array->data;
+	array->copy = copy_data(data, data->capacity);
+	if (!array->copy) {
+		mutex_unlock(&array->lock);
+		return -ENOMEM;
+	}
+	return 0;
+}
+
+int cds_rcu_array_update_resize(struct cds_rcu_array *array, size_t len)
+{
+	struct cds_rcu_array_data *copy;
+
+	if (reserve_copy(array, len))
+		return -ENOMEM;
+	copy = array->copy;
+	if (len > copy->len)
+		memset(copy->elems + copy->len * copy->elem_size, 0,
+			(len - copy->len) * copy->elem_size);
+	copy->len = len;
+	return 0;
+}
+
+int cds_rcu_array_update_insert(struct cds_rcu_array *array, size_t i,
+		const void *elem)
+{
+	struct cds_rcu_array_data *copy;
+	size_t elem_size = array->elem_size;
+
+	assert(i <= array->copy->len);
+	if (reserve_copy(array, array->copy->len + 1))
+		return -ENOMEM;
+	copy = array->copy;
+	memmove(copy->elems + (i + 1) * elem_size, copy->elems + i * elem_size,
+		(copy->len - i) * elem_size);
+	memcpy(copy->elems + i * elem_size, elem, elem_size);
+	copy->len++;
+	return 0;
+}
+
+void cds_rcu_array_update_remove(struct cds_rcu_array *array, size_t i)
+{
+	struct cds_rcu_array_data *copy = array->copy;
+	size_t elem_size = array->elem_size;
+
+	assert(i < copy->len);
+	memmove(copy->elems + i * elem_size, copy->elems + (i + 1) * elem_size,
+		(copy->len - i - 1) * elem_size);
+	copy->len--;
+}
+
+void cds_rcu_array_update_commit(struct cds_rcu_array *array)
+{
+	publish(array, array->copy);
+	array->copy = NULL;
+	mutex_unlock(&array->lock);
+}
+
+void cds_rcu_array_update_abort(struct cds_rcu_array *array)
+{
+	free(array->copy);
+	array->copy = NULL;
+	mutex_unlock(&array->lock);
+}
+
+int cds_rcu_array_append(struct cds_rcu_array *array, const void *elem)
+{
+	struct cds_rcu_array_data *data, *copy;
+	size_t elem_size = array->elem_size;
+
+	mutex_lock(&array->lock);
+	assert(!array->copy);
+	data = array->data;
+	if (data->len < data->capacity) {
+		/* Readers do not access elements beyond the length. */
+		memcpy(data->elems + data->len * elem_size, elem, elem_size);
+		uatomic_store_release(&data->len, data->len + 1);
+		mutex_unlock(&array->lock);
+		return 0;
+	}
+	copy = data->capacity <= SIZE_MAX / 2 ?
+		copy_data(data, 2 * data->capacity) : NULL;
+	if (!copy) {
+		mutex_unlock(&array->lock);
+		return -ENOMEM;
+	}
+	memcpy(copy->elems + copy->len * elem_size, elem, elem_size);
+	copy->len++;
+	publish(array, copy);
+	mutex_unlock(&array->lock);
+	return 0;
+}
@@ -0,0 +1,651 @@
+/*
+ * rcuhamt.c
+ *
+ * Userspace RCU library - RCU persistent hash array mapped trie
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+#define _LGPL_SOURCE
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <errno.h>
+#include <assert.h>
+#include <pthread.h>
+
+#include <urcu/compiler.h>
+#include <urcu/pointer.h>
+#include <urcu/call-rcu.h>
+#include <urcu/flavor.h>
+#include <urcu/rcuhamt.h>
+
+#include "urcu-die.h"
+
+#define HAMT_BITS	5
+#define HAMT_FANOUT	(1U << HAMT_BITS)
+/* Levels indexing the hash. Nodes below the last share their hash. */
+#define HAMT_NR_LEVELS	((CAA_BITS_PER_LONG + HAMT_BITS - 1) / HAMT_BITS)
+
+/* Children which are nodes of the caller are tagged, inodes are not. */
+#define HAMT_LEAF	1UL
+
+/*
+ * Interior node. Published inodes are never modified: the updater
+ * copies them on the first modification of a batch, and marks the copy
+ * with the generation of the batch, so that later modifications of the
+ * same batch write into it in place.
+ */
+struct cds_hamt_inode {
+	uint32_t bitmap;		/* Hash indexes of the children. */
+	uint32_t collision;		/* Children share their hash. */
+	unsigned int nr;		/* Number of children. */
+	unsigned int capacity;
+	unsigned long gen;		/* Batch which created the inode. */
+	unsigned long count;		/* Root only: number of nodes. */
+	struct cds_hamt_inode *next_retired;
+	void *child[];
+};
+
+/* Interior nodes and nodes replaced by a batch, freed at once. */
+struct cds_hamt_retired {
+	struct rcu_head head;
+	struct cds_hamt_inode *inodes;
+	struct cds_hamt_node *nodes;
+	cds_hamt_free_fct free_node;
+};
+
+static void mutex_lock(pthread_mutex_t *mutex)
+{
+	int ret;
+
+	ret = pthread_mutex_lock(mutex);
+	if (ret)
+		urcu_die(ret);
+}
+
+static void mutex_unlock(pthread_mutex_t *mutex)
+{
+	int ret;
+
+	ret = pthread_mutex_unlock(mutex);
+	if (ret)
+		urcu_die(ret);
+}
+
+static inline
+int is_leaf(const void *child)
+{
+	return (uintptr_t) child & HAMT_LEAF;
+}
+
+static inline
+struct cds_hamt_node *to_leaf(const void *child)
+{
+	return (struct cds_hamt_node *) ((uintptr_t) child & ~HAMT_LEAF);
+}
+
+static inline
+void *leaf_child(struct cds_hamt_node *node)
+{
+	return (void *) ((uintptr_t) node | HAMT_LEAF);
+}
+
+static inline
+unsigned int hash_index(unsigned long hash, unsigned int level)
+{
+	return (hash >> (level * HAMT_BITS)) & (HAMT_FANOUT - 1);
+}
+
+/* Position of the child of index @index among the children present. */
+static inline
+unsigned int child_pos(uint32_t bitmap, unsigned int index)
+{
+	return __builtin_popcount(bitmap & ((1U << index) - 1));
+}
+
+static inline
+int leaf_match(struct cds_hamt_node *leaf, unsigned long hash,
+		cds_hamt_match_fct match, const void *key)
+{
+	return leaf->hash == hash && match(leaf, key);
+}
+
+static
+struct cds_hamt_inode *alloc_inode(unsigned long gen, unsigned int capacity)
+{
+	struct cds_hamt_inode *inode;
+
+	inode = malloc(sizeof(*inode) + capacity * sizeof(inode->child[0]));
+	if (!inode)
+		return NULL;
+	inode->bitmap = 0;
+	inode->collision = 0;
+	inode->nr = 0;
+	inode->capacity = capacity;
+	inode->gen = gen;
+	inode->count = 0;
+	inode->next_retired = NULL;
+	return inode;
+}
+
+/*
+ * Free the inodes of a subtree, and call @free_node on its nodes if
+ * set. With @fresh_only, only free the inodes of the current batch:
+ * the subtrees of the other inodes are still published.
+ */
+static
+void free_tree(struct cds_hamt *hamt, struct cds_hamt_inode *inode,
+		int fresh_only, cds_hamt_free_fct free_node)
+{
+	unsigned int i;
+
+	if (fresh_only && inode->gen != hamt->gen)
+		return;
+	for (i = 0; i < inode->nr; i++) {
+		void *child = inode->child[i];
+
+		if (!is_leaf(child))
+			free_tree(hamt, child, fresh_only, free_node);
+		else if (free_node)
+			free_node(to_leaf(child));
+	}
+	free(inode);
+}
+
+static
+void free_retired(struct rcu_head *head)
+{
+	struct cds_hamt_retired *retired =
+		caa_container_of(head, struct cds_hamt_retired, head);
+	struct cds_hamt_inode *inode, *next_inode;
+	struct cds_hamt_node *node, *next_node;
+
+	for (inode = retired->inodes; inode; inode = next_inode) {
+		next_inode = inode->next_retired;
+		free(inode);
+	}
+	for (node = retired->nodes; node; node = next_node) {
+		next_node = node->next_removed;
+		if (retired->free_node)
+			retired->free_node(node);
+	}
+	free(retired);
+}
+
+/*
+ * Unlink @inode from the version being updated: free it if it belongs
+ * to the batch, and after the commit otherwise.
+ */
+static
+void drop_inode(struct cds_hamt *hamt, struct cds_hamt_inode *inode)
+{
+	if (inode->gen == hamt->gen) {
+		free(inode);
+		return;
+	}
+	inode->next_retired = hamt->retired->inodes;
+	hamt->retired->inodes = inode;
+}
+
+static
+void retire_leaf(struct cds_hamt *hamt, struct cds_hamt_node *node)
+{
+	node->next_removed = hamt->retired->nodes;
+	hamt->retired->nodes = node;
+}
+
+/*
+ * Make the inode of @slot belong to the batch, with room for @extra
+ * more children. Published inodes are copied to their exact size, and
+ * inodes of the batch grow by doubling. Return NULL on allocation
+ * failure, in which case @slot is unchanged.
+ */
+static
+struct cds_hamt_inode *own_inode(struct cds_hamt *hamt, void **slot,
+		unsigned int extra)
+{
+	struct cds_hamt_inode *inode = *slot, *copy;
+	unsigned int capacity = inode->nr + extra;
+
+	if (inode->gen == hamt->gen) {
+		if (capacity <= inode->capacity)
+			return inode;
+		if (capacity < 2 * inode->capacity)
+			capacity = 2 * inode->capacity;
+		if (!inode->collision && capacity > HAMT_FANOUT)
+			capacity = HAMT_FANOUT;
+	}
+	copy = alloc_inode(hamt->gen, capacity);
+	if (!copy)
+		return NULL;
+	copy->bitmap = inode->bitmap;
+	copy->collision = inode->collision;
+	copy->nr = inode->nr;
+	copy->count = inode->count;
+	memcpy(copy->child, inode->child, inode->nr * sizeof(inode->child[0]));
+	drop_inode(hamt, inode);
+	*slot = copy;
+	return copy;
+}
+
+/*
+ * Subtree of @level holding two nodes, whose hashes are equal up to
+ * that level. Return NULL on allocation failure.
+ */
+static
+struct cds_hamt_inode *new_pair(struct cds_hamt *hamt, unsigned int level,
+		struct cds_hamt_node *a, struct cds_hamt_node *b)
+{
+	struct cds_hamt_inode *inode, *sub;
+	unsigned int ia, ib;
+
+	if (level == HAMT_NR_LEVELS) {
+		inode = alloc_inode(hamt->gen, 2);
+		if (!inode)
+			return NULL;
+		inode->collision = 1;
+		inode->nr = 2;
+		inode->child[0] = leaf_child(a);
+		inode->child[1] = leaf_child(b);
+		return inode;
+	}
+	ia = hash_index(a->hash, level);
+	ib = hash_index(b->hash, level);
+	if (ia == ib) {
+		sub = new_pair(hamt, level + 1, a, b);
+		if (!sub)
+			return NULL;
+		inode = alloc_inode(hamt->gen, 1);
+		if (!inode) {
+			free_tree(hamt, sub, 1, NULL);
+			return NULL;
+		}
+		inode->bitmap = 1U << ia;
+		inode->nr = 1;
+		inode->child[0] = sub;
+		return inode;
+	}
+	inode = alloc_inode(hamt->gen, 2);
+	if (!inode)
+		return NULL;
+	inode->bitmap = (1U << ia) | (1U << ib);
+	inode->nr = 2;
+	inode->child[ia < ib ? 0 : 1] = leaf_child(a);
+	inode->child[ia < ib ? 1 : 0] = leaf_child(b);
+	return inode;
+}
+
+/*
+ * Add @node to the subtree of @slot, copying the inodes on its path.
+ * Inodes copied before an allocation failure hold the same children as
+ * the originals, so that the version is unchanged.
+ */
+static
+int insert(struct cds_hamt *hamt, void **slot, unsigned int level,
+		struct cds_hamt_node *node, cds_hamt_match_fct match,
+		const void *key, int replace)
+{
+	struct cds_hamt_inode *inode = *slot, *sub;
+	struct cds_hamt_node *leaf;
+	unsigned int i, index, pos;
+	uint32_t bit;
+	void *child;
+
+	if (inode->collision) {
+		for (i = 0; i < inode->nr; i++) {
+			leaf = to_leaf(inode->child[i]);
+			if (leaf_match(leaf, node->hash, match, key))
+				goto replace;
+		}
+		inode = own_inode(hamt, slot, 1);
+		if (!inode)
+			return -ENOMEM;
+		inode->child[inode->nr++] = leaf_child(node);
+		hamt->new_count++;
+		return 0;
+	}
+	index = hash_index(node->hash, level);
+	bit = 1U << index;
+	i = pos = child_pos(inode->bitmap, index);
+	if (!(inode->bitmap & bit)) {
+		inode = own_inode(hamt, slot, 1);
+		if (!inode)
+			return -ENOMEM;
+		memmove(&inode->child[pos + 1], &inode->child[pos],
+			(inode->nr - pos) * sizeof(inode->child[0]));
+		inode->child[pos] = leaf_child(node);
+		inode->nr++;
+		inode->bitmap |= bit;
+		hamt->new_count++;
+		return 0;
+	}
+	child = inode->child[pos];
+	if (!is_leaf(child)) {
+		inode = own_inode(hamt, slot, 0);
+		if (!inode)
+			return -ENOMEM;
+		return insert(hamt, &inode->child[pos], level + 1, node,
+			match, key, replace);
+	}
+	leaf = to_leaf(child);
+	if (leaf_match(leaf, node->hash, match, key))
+		goto replace;
+	inode = own_inode(hamt, slot, 0);
+	if (!inode)
+		return -ENOMEM;
+	sub = new_pair(hamt, level + 1, leaf, node);
+	if (!sub)
+		return -ENOMEM;
+	inode->child[pos] = sub;
+	hamt->new_count++;
+	return 0;
+
+replace:
+	if (!replace)
+		return -EEXIST;
+	if (leaf == node)
+		return 0;
+	inode = own_inode(hamt, slot, 0);
+	if (!inode)
+		return -ENOMEM;
+	inode->child[i] = leaf_child(node);
+	retire_leaf(hamt, leaf);
+	return 0;
+}
+
+/*
+ * Remove the node of a key from the subtree of @slot. Inodes other
+ * than the root left with a single node are replaced by that node, as
+ * lookups compare the whole hash of the nodes they reach.
+ */
+static
+int delete(struct cds_hamt *hamt, void **slot, unsigned int level,
+		int is_root, unsigned long hash, cds_hamt_match_fct match,
+		const void *key)
+{
+	struct cds_hamt_inode *inode = *slot;
+	struct cds_hamt_node *leaf;
+	unsigned int i, index, pos;
+	uint32_t bit;
+	void *child;
+	int ret;
+
+	if (inode->collision) {
+		for (i = 0; i < inode->nr; i++) {
+			leaf = to_leaf(inode->child[i]);
+			if (leaf_match(leaf, hash, match, key))
+				break;
+		}
+		if (i == inode->nr)
+			return -ENOENT;
+		if (inode->nr == 2) {
+			*slot = inode->child[1 - i];
+			drop_inode(hamt, inode);
+			goto removed;
+		}
+		inode = own_inode(hamt, slot, 0);
+		if (!inode)
+			return -ENOMEM;
+		memmove(&inode->child[i], &inode->child[i + 1],
+			(inode->nr - i - 1) * sizeof(inode->child[0]));
+		inode->nr--;
+		goto removed;
+	}
+	index = hash_index(hash, level);
+	bit = 1U << index;
+	if (!(inode->bitmap & bit))
+		return -ENOENT;
+	pos = child_pos(inode->bitmap, index);
+	child = inode->child[pos];
+	if (!is_leaf(child)) {
+		inode = own_inode(hamt, slot, 0);
+		if (!inode)
+			return -ENOMEM;
+		ret = delete(hamt, &inode->child[pos], level + 1, 0, hash,
+			match, key);
+		if (ret)
+			return ret;
+		if (!is_root && inode->nr == 1 && is_leaf(inode->child[0])) {
+			*slot = inode->child[0];
+			drop_inode(hamt, inode);
+		}
+		return 0;
+	}
+	leaf = to_leaf(child);
+	if (!leaf_match(leaf, hash, match, key))
+		return -ENOENT;
+	if (!is_root && inode->nr == 2 && is_leaf(inode->child[1 - pos])) {
+		*slot = inode->child[1 - pos];
+		drop_inode(hamt, inode);
+		goto removed;
+	}
+	inode = own_inode(hamt, slot, 0);
+	if (!inode)
+		return -ENOMEM;
+	memmove(&inode->child[pos], &inode->child[pos + 1],
+		(inode->nr - pos - 1) * sizeof(inode->child[0]));
+	inode->nr--;
+	inode->bitmap &= ~bit;
+
+removed:
+	retire_leaf(hamt, leaf);
+	hamt->new_count--;
+	return 0;
+}
+
+struct cds_hamt_node *cds_hamt_lookup(const struct cds_hamt_inode *root,
+		unsigned long hash, cds_hamt_match_fct match, const void *key)
+{
+	const struct cds_hamt_inode *inode = root;
+	struct cds_hamt_node *leaf;
+	unsigned int i, index, level;
+	void *child;
+
+	for (level = 0; ; level++) {
+		if (inode->collision) {
+			for (i = 0; i < inode->nr; i++) {
+				leaf = to_leaf(inode->child[i]);
+				if (leaf_match(leaf, hash, match, key))
+					return leaf;
+			}
+			return NULL;
+		}
+		index = hash_index(hash, level);
+		if (!(inode->bitmap & (1U << index)))
+			return NULL;
+		child = inode->child[child_pos(inode->bitmap, index)];
+		if (is_leaf(child)) {
+			leaf = to_leaf(child);
+			return leaf_match(leaf, hash, match, key) ? leaf : NULL;
+		}
+		inode = child;
+	}
+}
+
+unsigned long cds_hamt_count(const struct cds_hamt_inode *root)
+{
+	return root->count;
+}
+
+/* Move to the first node from the current position, depth first. */
+static
+void iter_advance(struct cds_hamt_iter *iter)
+{
+	const struct cds_hamt_inode *inode;
+	void *child;
+
+	for (;;) {
+		inode = iter->inode[iter->depth];
+		if (iter->pos[iter->depth] >= inode->nr) {
+			if (!iter->depth) {
+				iter->node = NULL;
+				return;
+			}
+			iter->pos[--iter->depth]++;
+			continue;
+		}
+		child = inode->child[iter->pos[iter->depth]];
+		if (is_leaf(child)) {
+			iter->node = to_leaf(child);
+			return;
+		}
+		assert(iter->depth + 1 < CDS_HAMT_MAX_DEPTH);
+		iter->inode[++iter->depth] = child;
+		iter->pos[iter->depth] = 0;
+	}
+}
+
+void cds_hamt_first(const struct cds_hamt_inode *root,
+		struct cds_hamt_iter *iter)
+{
+	iter->depth = 0;
+	iter->inode[0] = root;
+	iter->pos[0] = 0;
+	iter_advance(iter);
+}
+
+void cds_hamt_next(struct cds_hamt_iter *iter)
+{
+	iter->pos[iter->depth]++;
+	iter_advance(iter);
+}
+
+int cds_hamt_init_flavor(struct cds_hamt *hamt, cds_hamt_free_fct free_node,
+		const struct rcu_flavor_struct *flavor)
+{
+	int ret;
+
+	hamt->gen = 0;
+	hamt->root = alloc_inode(hamt->gen, 0);
+	if (!hamt->root)
+		return -ENOMEM;
+	hamt->new_root = NULL;
+	hamt->retired = NULL;
+	hamt->new_count = 0;
+	hamt->free_node = free_node;
+	hamt->flavor = flavor;
+	ret = pthread_mutex_init(&hamt->lock, NULL);
+	if (ret)
+		urcu_die(ret);
+	return 0;
+}
+
+void cds_hamt_destroy(struct cds_hamt *hamt)
+{
+	int ret;
+
+	assert(!hamt->retired);
+	free_tree(hamt, hamt->root, 0, hamt->free_node);
+	hamt->root = NULL;
+	ret = pthread_mutex_destroy(&hamt->lock);
+	if (ret)
+		urcu_die(ret);
+}
+
+int cds_hamt_update_begin(struct cds_hamt *hamt)
+{
+	struct cds_hamt_retired *retired;
+
+	mutex_lock(&hamt->lock);
+	retired = malloc(sizeof(*retired));
+	if (!retired) {
+		mutex_unlock(&hamt->lock);
+		return -ENOMEM;
+	}
+	retired->inodes = NULL;
+	retired->nodes = NULL;
+	retired->free_node = hamt->free_node;
+	hamt->retired = retired;
+	hamt->gen++;
+	hamt->new_root = hamt->root;
+	hamt->new_count = hamt->root->count;
+	return 0;
+}
+
+struct cds_hamt_node *cds_hamt_update_lookup(struct cds_hamt *hamt,
+		unsigned long hash, cds_hamt_match_fct match, const void *key)
+{
+	return cds_hamt_lookup(hamt->new_root, hash, match, key);
+}
+
+static
+int update_insert(struct cds_hamt *hamt, struct cds_hamt_node *node,
+		cds_hamt_match_fct match, const void *key, int replace)
+{
+	void *root = hamt->new_root;
+	int ret;
+
+	ret = insert(hamt, &root, 0, node, match, key, replace);
+	hamt->new_root = root;
+	return ret;
+}
+
+int cds_hamt_update_add_unique(struct cds_hamt *hamt,
+		struct cds_hamt_node *node, cds_hamt_match_fct match,
+		const void *key)
+{
+	/* Do not copy the path of a key already present. */
+	if (cds_hamt_lookup(hamt->new_root, node->hash, match, key))
+		return -EEXIST;
+	return update_insert(hamt, node, match, key, 0);
+}
+
+int cds_hamt_update_add_replace(struct cds_hamt *hamt,
+		struct cds_hamt_node *node, cds_hamt_match_fct match,
+		const void *key)
+{
+	return update_insert(hamt, node, match, key, 1);
+}
+
+int cds_hamt_update_del(struct cds_hamt *hamt, unsigned long hash,
+		cds_hamt_match_fct match, const void *key)
+{
+	void *root = hamt->new_root;
+	int ret;
+
+	/* Do not copy the path of a key not present. */
+	if (!cds_hamt_lookup(root, hash, match, key))
+		return -ENOENT;
+	ret = delete(hamt, &root, 0, 1, hash, match, key);
+	hamt->new_root = root;
+	return ret;
+}
+
+void cds_hamt_update_commit(struct cds_hamt *hamt)
+{
+	struct cds_hamt_retired *retired = hamt->retired;
+
+	hamt->retired = NULL;
+	if (hamt->new_root == hamt->root) {
+		assert(!retired->inodes && !retired->nodes);
+		free(retired);
+	} else {
+		hamt->new_root->count = hamt->new_count;
+		rcu_set_pointer(&hamt->root, hamt->new_root);
+		hamt->flavor->update_call_rcu(&retired->head, free_retired);
+	}
+	hamt->new_root = NULL;
+	mutex_unlock(&hamt->lock);
+}
+
+void cds_hamt_update_abort(struct cds_hamt *hamt)
+{
+	free_tree(hamt, hamt->new_root, 1, NULL);
+	free(hamt->retired);
+	hamt->retired = NULL;
+	hamt->new_root = NULL;
+	mutex_unlock(&hamt->lock);
+}
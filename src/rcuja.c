@@ -0,0 +1,633 @@
+/*
+ * rcuja.c
+ *
+ * Userspace RCU library - RCU Judy array
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+/*
+ * Each interior node indexes its children with the key byte at its
+ * shift. Children of nodes of shift 0 are the cds_ja_node of the keys.
+ *
+ * Linear nodes store the key byte and child pointer of each child in a
+ * slot. Readers only scan the slots published by nr_slots, which only
+ * grows: a slot is written before being published, and is never reused.
+ * Removing a child clears its pointer, leaving a hole. When the slots
+ * are exhausted, the node is replaced by a copy without holes, of the
+ * next size if needed. Full nodes index children directly. Nodes are
+ * also replaced by a copy of the previous size when most of their
+ * children are removed, and removed from their parent once empty.
+ *
+ * Updaters lock the parent of the node they modify, or the root lock
+ * for the top node, then the node, top-down, and check that neither
+ * was replaced since they were found. Replaced nodes are marked dead,
+ * and freed after a grace period.
+ */
+
+#define _LGPL_SOURCE
+#include <stdlib.h>
+#include <stdint.h>
+#include <limits.h>
+#include <errno.h>
+#include <pthread.h>
+
+#include <urcu/compiler.h>
+#include <urcu/arch.h>
+#include <urcu/pointer.h>
+#include <urcu/call-rcu.h>
+#include <urcu/flavor.h>
+#include <urcu/rcuja.h>
+
+#include "urcu-die.h"
+
+#define JA_BITS			8
+#define JA_KEY_BITS		(sizeof(unsigned long) * CHAR_BIT)
+#define JA_LINEAR_MAX		16
+
+enum ja_type {
+	JA_LINEAR_4,
+	JA_LINEAR_16,
+	JA_FULL,
+	NR_JA_TYPES,
+};
+
+static const unsigned int ja_capacity[NR_JA_TYPES] = { 4, 16, 256 };
+
+/* Number of children below which nodes shrink to the previous type. */
+static const unsigned int ja_shrink[NR_JA_TYPES] = { 0, 2, 8 };
+
+struct ja_inode {
+	pthread_mutex_t lock;		/* Protects updates of the node. */
+	struct rcu_head head;
+	unsigned int type;
+	unsigned int shift;		/* Of the key byte indexing children. */
+	unsigned int nr_slots;		/* Linear: slots visible to readers. */
+	unsigned int nr_child;		/* Children, under lock. */
+	int dead;			/* Replaced or removed, under lock. */
+	uint8_t key[JA_LINEAR_MAX];	/* Linear: key byte of each slot. */
+	void *child[];
+};
+
+struct cds_ja {
+	struct ja_inode *root;		/* RCU-protected. */
+	pthread_mutex_t lock;		/* Protects updates of root. */
+	const struct rcu_flavor_struct *flavor;
+};
+
+static void mutex_lock(pthread_mutex_t *mutex)
+{
+	int ret;
+
+	ret = pthread_mutex_lock(mutex);
+	if (ret)
+		urcu_die(ret);
+}
+
+static void mutex_unlock(pthread_mutex_t *mutex)
+{
+	int ret;
+
+	ret = pthread_mutex_unlock(mutex);
+	if (ret)
+		urcu_die(ret);
+}
+
+static inline
+unsigned int key_byte(unsigned long key, unsigned int shift)
+{
+	return (key >> shift) & ((1U << JA_BITS) - 1);
+}
+
+/* Whether key is within the range of keys indexed by node. */
+static inline
+int key_in_range(struct ja_inode *node, unsigned long key)
+{
+	return node->shift + JA_BITS >= JA_KEY_BITS
+		|| !(key >> (node->shift + JA_BITS));
+}
+
+/* Shift of the top node of a tree holding key. */
+static
+unsigned int key_shift(unsigned long key)
+{
+	unsigned int shift = 0;
+
+	while (shift + JA_BITS < JA_KEY_BITS && (key >> (shift + JA_BITS)))
+		shift += JA_BITS;
+	return shift;
+}
+
+static
+struct ja_inode *node_alloc(unsigned int type, unsigned int shift)
+{
+	struct ja_inode *node;
+	int ret;
+
+	node = calloc(1, sizeof(*node)
+			+ ja_capacity[type] * sizeof(node->child[0]));
+	if (!node)
+		return NULL;
+	ret = pthread_mutex_init(&node->lock, NULL);
+	if (ret)
+		urcu_die(ret);
+	node->type = type;
+	node->shift = shift;
+	return node;
+}
+
+static
+void node_free(struct ja_inode *node)
+{
+	int ret;
+
+	ret = pthread_mutex_destroy(&node->lock);
+	if (ret)
+		urcu_die(ret);
+	free(node);
+}
+
+static
+void free_node_rcu(struct rcu_head *head)
+{
+	node_free(caa_container_of(head, struct ja_inode, head));
+}
+
+static inline
+void *node_get(struct ja_inode *node, unsigned int byte)
+{
+	unsigned int i, nr_slots;
+
+	if (node->type == JA_FULL)
+		return rcu_dereference(node->child[byte]);
+	nr_slots = CMM_LOAD_SHARED(node->nr_slots);
+	cmm_smp_rmb();	/* Read nr_slots before slots. */
+	for (i = 0; i < nr_slots; i++) {
+		if (node->key[i] == byte) {
+			void *child = rcu_dereference(node->child[i]);
+
+			/* Removed children leave holes. */
+			if (child)
+				return child;
+		}
+	}
+	return NULL;
+}
+
+/* Slot of the child of node at byte. Called with node locked. */
+static
+void **node_slot(struct ja_inode *node, unsigned int byte)
+{
+	unsigned int i;
+
+	if (node->type == JA_FULL)
+		return node->child[byte] ? &node->child[byte] : NULL;
+	for (i = 0; i < node->nr_slots; i++) {
+		if (node->key[i] == byte && node->child[i])
+			return &node->child[i];
+	}
+	return NULL;
+}
+
+/* Add a child to a node not visible to readers yet. */
+static
+void node_put_private(struct ja_inode *node, unsigned int byte, void *child)
+{
+	if (node->type == JA_FULL) {
+		node->child[byte] = child;
+	} else {
+		node->key[node->nr_slots] = byte;
+		node->child[node->nr_slots++] = child;
+	}
+	node->nr_child++;
+}
+
+/* Copy the children of node into a new node of a given type. */
+static
+struct ja_inode *node_copy(struct ja_inode *node, unsigned int type)
+{
+	struct ja_inode *copy;
+	unsigned int i;
+
+	copy = node_alloc(type, node->shift);
+	if (!copy)
+		return NULL;
+	if (node->type == JA_FULL) {
+		for (i = 0; i < ja_capacity[JA_FULL]; i++) {
+			if (node->child[i])
+				node_put_private(copy, i, node->child[i]);
+		}
+	} else {
+		for (i = 0; i < node->nr_slots; i++) {
+			if (node->child[i])
+				node_put_private(copy, node->key[i],
+					node->child[i]);
+		}
+	}
+	return copy;
+}
+
+/*
+ * Replace node by copy in its parent, or as root if parent is NULL.
+ * Called with the parent and node locked.
+ */
+static
+void node_replace(struct cds_ja *ja, struct ja_inode *parent,
+		unsigned int pbyte, struct ja_inode *node,
+		struct ja_inode *copy)
+{
+	if (parent)
+		rcu_set_pointer(node_slot(parent, pbyte), copy);
+	else
+		rcu_set_pointer(&ja->root, copy);
+	node->dead = 1;
+	ja->flavor->update_call_rcu(&node->head, free_node_rcu);
+}
+
+/*
+ * Add a child to node at byte, which must have none. Called with the
+ * parent and node locked. Return 0 on success, -ENOMEM on error.
+ */
+static
+int node_add(struct cds_ja *ja, struct ja_inode *parent, unsigned int pbyte,
+		struct ja_inode *node, unsigned int byte, void *child)
+{
+	struct ja_inode *copy;
+	unsigned int type = node->type;
+
+	if (type == JA_FULL) {
+		rcu_set_pointer(&node->child[byte], child);
+		node->nr_child++;
+		return 0;
+	}
+	if (node->nr_slots < ja_capacity[type]) {
+		node->key[node->nr_slots] = byte;
+		node->child[node->nr_slots] = child;
+		cmm_smp_wmb();	/* Write slot before publishing it. */
+		CMM_STORE_SHARED(node->nr_slots, node->nr_slots + 1);
+		node->nr_child++;
+		return 0;
+	}
+	/* Out of slots: compact, or grow if there are no holes. */
+	if (node->nr_child == ja_capacity[type])
+		type++;
+	copy = node_copy(node, type);
+	if (!copy)
+		return -ENOMEM;
+	node_put_private(copy, byte, child);
+	node_replace(ja, parent, pbyte, node, copy);
+	return 0;
+}
+
+/*
+ * Remove the child of node at byte. Called with the parent and node
+ * locked. Return the number of children left.
+ */
+static
+unsigned int node_remove(struct cds_ja *ja, struct ja_inode *parent,
+		unsigned int pbyte, struct ja_inode *node, unsigned int byte)
+{
+	struct ja_inode *copy;
+
+	CMM_STORE_SHARED(*node_slot(node, byte), NULL);
+	node->nr_child--;
+	if (node->nr_child && node->nr_child <= ja_shrink[node->type]) {
+		/* Shrinking is an optimization: keep node on error. */
+		copy = node_copy(node, node->type - 1);
+		if (copy)
+			node_replace(ja, parent, pbyte, node, copy);
+	}
+	return node->nr_child;
+}
+
+/*
+ * Lock the parent of node, or the root lock if it is NULL, and node.
+ * Return 1 with both locked if node is still the child of parent at
+ * pbyte, otherwise 0 with none locked.
+ */
+static
+int lock_path(struct cds_ja *ja, struct ja_inode *parent, unsigned int pbyte,
+		struct ja_inode *node)
+{
+	pthread_mutex_t *plock = parent ? &parent->lock : &ja->lock;
+	int valid;
+
+	mutex_lock(plock);
+	mutex_lock(&node->lock);
+	if (parent)
+		valid = !parent->dead && node_get(parent, pbyte) == node;
+	else
+		valid = ja->root == node;
+	if (valid && !node->dead)
+		return 1;
+	mutex_unlock(&node->lock);
+	mutex_unlock(plock);
+	return 0;
+}
+
+static
+void unlock_path(struct cds_ja *ja, struct ja_inode *parent,
+		struct ja_inode *node)
+{
+	mutex_unlock(&node->lock);
+	mutex_unlock(parent ? &parent->lock : &ja->lock);
+}
+
+/*
+ * Find the node of shift on the path of key, and its parent. Return 0
+ * if there is none.
+ */
+static
+int find_node(struct cds_ja *ja, unsigned long key, unsigned int shift,
+		struct ja_inode **parent, unsigned int *pbyte,
+		struct ja_inode **node)
+{
+	struct ja_inode *curr = rcu_dereference(ja->root);
+
+	*parent = NULL;
+	if (!curr || !key_in_range(curr, key) || curr->shift < shift)
+		return 0;
+	while (curr->shift > shift) {
+		struct ja_inode *child;
+
+		*pbyte = key_byte(key, curr->shift);
+		child = node_get(curr, *pbyte);
+		if (!child)
+			return 0;
+		*parent = curr;
+		curr = child;
+	}
+	*node = curr;
+	return 1;
+}
+
+/*
+ * Free a chain of private nodes leading to a cds_ja_node, whose top is
+ * child of a node of shift.
+ */
+static
+void chain_free(void *child, unsigned int shift)
+{
+	while (shift) {
+		struct ja_inode *node = child;
+
+		child = node->child[0];
+		shift -= JA_BITS;
+		node_free(node);
+	}
+}
+
+/*
+ * Allocate the nodes leading to jnode below a node of shift. Return the
+ * top of the chain, or NULL on error.
+ */
+static
+void *chain_alloc(unsigned long key, unsigned int shift,
+		struct cds_ja_node *jnode)
+{
+	void *child = jnode;
+	unsigned int s;
+
+	for (s = 0; s < shift; s += JA_BITS) {
+		struct ja_inode *node = node_alloc(JA_LINEAR_4, s);
+
+		if (!node) {
+			chain_free(child, s);
+			return NULL;
+		}
+		node_put_private(node, key_byte(key, s), child);
+		child = node;
+	}
+	return child;
+}
+
+/*
+ * Make the tree high enough for key, when root is the top node, or
+ * NULL. Return 0 on success, or if root was replaced, -ENOMEM on error.
+ */
+static
+int grow_root(struct cds_ja *ja, struct ja_inode *root, unsigned long key)
+{
+	struct ja_inode *node;
+	int ret = 0;
+
+	mutex_lock(&ja->lock);
+	if (ja->root != root)
+		goto end;
+	if (!root) {
+		node = node_alloc(JA_LINEAR_4, key_shift(key));
+	} else {
+		node = node_alloc(JA_LINEAR_4, root->shift + JA_BITS);
+		if (node)
+			node_put_private(node, 0, root);
+	}
+	if (!node) {
+		ret = -ENOMEM;
+		goto end;
+	}
+	rcu_set_pointer(&ja->root, node);
+end:
+	mutex_unlock(&ja->lock);
+	return ret;
+}
+
+/*
+ * Remove the empty node of shift on the path of key from its parent,
+ * and the parent in turn if this leaves it empty.
+ */
+static
+void prune(struct cds_ja *ja, unsigned long key, unsigned int shift)
+{
+	for (;;) {
+		struct ja_inode *gparent, *parent, *node;
+		unsigned int gbyte, byte, left;
+
+		if (!find_node(ja, key, shift + JA_BITS, &gparent, &gbyte,
+				&parent))
+			return;
+		byte = key_byte(key, parent->shift);
+		node = node_get(parent, byte);
+		if (!node)
+			return;
+		if (!lock_path(ja, gparent, gbyte, parent))
+			continue;
+		mutex_lock(&node->lock);
+		if (node->dead || node->nr_child
+				|| node_get(parent, byte) != node) {
+			/* Refilled, or handled by another updater. */
+			mutex_unlock(&node->lock);
+			unlock_path(ja, gparent, parent);
+			return;
+		}
+		node->dead = 1;
+		left = node_remove(ja, gparent, gbyte, parent, byte);
+		mutex_unlock(&node->lock);
+		ja->flavor->update_call_rcu(&node->head, free_node_rcu);
+		unlock_path(ja, gparent, parent);
+		if (left || !gparent)
+			return;
+		shift += JA_BITS;
+	}
+}
+
+struct cds_ja_node *cds_ja_lookup(struct cds_ja *ja, unsigned long key)
+{
+	struct ja_inode *node = rcu_dereference(ja->root);
+
+	if (!node || !key_in_range(node, key))
+		return NULL;
+	for (;;) {
+		void *child = node_get(node, key_byte(key, node->shift));
+
+		if (!child || !node->shift)
+			return child;
+		node = child;
+	}
+}
+
+int cds_ja_add(struct cds_ja *ja, unsigned long key,
+		struct cds_ja_node *jnode)
+{
+	jnode->key = key;
+	for (;;) {
+		struct ja_inode *root, *parent = NULL, *node;
+		unsigned int pbyte = 0, byte;
+		void *child;
+		int ret;
+
+		root = rcu_dereference(ja->root);
+		if (!root || !key_in_range(root, key)) {
+			ret = grow_root(ja, root, key);
+			if (ret)
+				return ret;
+			continue;
+		}
+		/* Find the lowest node on the path of key. */
+		node = root;
+		for (;;) {
+			byte = key_byte(key, node->shift);
+			child = node_get(node, byte);
+			if (!child)
+				break;
+			if (!node->shift)
+				return -EEXIST;
+			parent = node;
+			pbyte = byte;
+			node = child;
+		}
+		if (!lock_path(ja, parent, pbyte, node))
+			continue;
+		if (node_get(node, byte)) {
+			/* Concurrently added. */
+			unlock_path(ja, parent, node);
+			continue;
+		}
+		child = chain_alloc(key, node->shift, jnode);
+		if (!child) {
+			ret = -ENOMEM;
+		} else {
+			ret = node_add(ja, parent, pbyte, node, byte, child);
+			if (ret)
+				chain_free(child, node->shift);
+		}
+		unlock_path(ja, parent, node);
+		return ret;
+	}
+}
+
+struct cds_ja_node *cds_ja_del(struct cds_ja *ja, unsigned long key)
+{
+	for (;;) {
+		struct ja_inode *parent, *node;
+		struct cds_ja_node *jnode;
+		unsigned int pbyte = 0, byte = key_byte(key, 0), left;
+
+		if (!find_node(ja, key, 0, &parent, &pbyte, &node)
+				|| !node_get(node, byte))
+			return NULL;
+		if (!lock_path(ja, parent, pbyte, node))
+			continue;
+		jnode = node_get(node, byte);
+		if (!jnode) {
+			unlock_path(ja, parent, node);
+			return NULL;
+		}
+		left = node_remove(ja, parent, pbyte, node, byte);
+		unlock_path(ja, parent, node);
+		if (!left && parent)
+			prune(ja, key, 0);
+		return jnode;
+	}
+}
+
+struct cds_ja *cds_ja_new_flavor(const struct rcu_flavor_struct *flavor)
+{
+	struct cds_ja *ja;
+	int ret;
+
+	ja = calloc(1, sizeof(*ja));
+	if (!ja)
+		return NULL;
+	ret = pthread_mutex_init(&ja->lock, NULL);
+	if (ret)
+		urcu_die(ret);
+	ja->flavor = flavor;
+	return ja;
+}
+
+static
+int tree_has_keys(struct ja_inode *node)
+{
+	unsigned int i, nr = node->type == JA_FULL ?
+		ja_capacity[JA_FULL] : node->nr_slots;
+
+	for (i = 0; i < nr; i++) {
+		if (!node->child[i])
+			continue;
+		if (!node->shift || tree_has_keys(node->child[i]))
+			return 1;
+	}
+	return 0;
+}
+
+static
+void tree_free(struct ja_inode *node)
+{
+	unsigned int i, nr = node->type == JA_FULL ?
+		ja_capacity[JA_FULL] : node->nr_slots;
+
+	for (i = 0; node->shift && i < nr; i++) {
+		if (node->child[i])
+			tree_free(node->child[i]);
+	}
+	node_free(node);
+}
+
+int cds_ja_destroy(struct cds_ja *ja)
+{
+	int ret;
+
+	if (ja->root && tree_has_keys(ja->root))
+		return -EPERM;
+	/* Wait for readers of the nodes left. */
+	ja->flavor->update_synchronize_rcu();
+	if (ja->root)
+		tree_free(ja->root);
+	ret = pthread_mutex_destroy(&ja->lock);
+	if (ret)
+		urcu_die(ret);
+	free(ja);
+	return 0;
+}
@@ -0,0 +1,274 @@
+/*
+ * rculfhash-cache.c
+ *
+ * Userspace RCU library - RCU cache with CLOCK eviction on cds_lfht
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+/*
+ * An entry is in the table exactly when it is in the CLOCK ring of its
+ * shard: both are updated together under the shard mutex, so that the
+ * thread whose cds_lfht_del() succeeds is the one unlinking the entry
+ * from the ring and freeing it.
+ *
+ * The clock hand is the last ring element it passed, or the ring head:
+ * the next element examined follows it. New entries are inserted
+ * before the hand, to be examined once the hand went around the ring.
+ */
+
+#define _LGPL_SOURCE
+#include <stdlib.h>
+#include <errno.h>
+#include <pthread.h>
+
+#include <urcu/compiler.h>
+#include <urcu/arch.h>
+#include <urcu/flavor.h>
+#include <urcu/rculfhash.h>
+#include <urcu/rculfhash-cache.h>
+
+#include "urcu-die.h"
+
+struct cache_shard {
+	pthread_mutex_t lock;		/* Protects the fields below. */
+	struct cds_list_head ring;
+	struct cds_list_head *hand;
+	unsigned long used;
+	unsigned long capacity;
+} __attribute__((aligned(CAA_CACHE_LINE_SIZE)));
+
+struct cds_lfht_cache {
+	struct cds_lfht *ht;
+	void (*free_node)(struct rcu_head *head);
+	const struct rcu_flavor_struct *flavor;
+	unsigned long nr_shards;
+	struct cache_shard *shards;
+};
+
+static void mutex_lock(pthread_mutex_t *mutex)
+{
+	int ret;
+
+	ret = pthread_mutex_lock(mutex);
+	if (ret)
+		urcu_die(ret);
+}
+
+static void mutex_unlock(pthread_mutex_t *mutex)
+{
+	int ret;
+
+	ret = pthread_mutex_unlock(mutex);
+	if (ret)
+		urcu_die(ret);
+}
+
+/*
+ * The shard index is made of the top bits of the hash, which are the
+ * low bits of the reverse hash kept in each node.
+ */
+static inline
+struct cache_shard *shard_of_reverse_hash(struct cds_lfht_cache *cache,
+		unsigned long reverse_hash)
+{
+	return &cache->shards[reverse_hash & (cache->nr_shards - 1)];
+}
+
+/*
+ * Unlink an entry deleted from the table from its ring, and free it
+ * after a grace period. Called with the shard mutex held.
+ */
+static void shard_unlink(struct cds_lfht_cache *cache,
+		struct cache_shard *shard, struct cds_lfht_cache_node *node)
+{
+	if (shard->hand == &node->clock)
+		shard->hand = node->clock.prev;
+	cds_list_del(&node->clock);
+	shard->used -= node->size;
+	cache->flavor->update_call_rcu(&node->rcu_head, cache->free_node);
+}
+
+/*
+ * Evict entries until size more bytes fit in the shard, or it is empty.
+ * Called with the shard mutex held.
+ */
+static void shard_evict(struct cds_lfht_cache *cache,
+		struct cache_shard *shard, unsigned long size)
+{
+	struct cds_lfht_cache_node *node;
+	struct cds_list_head *pos;
+
+	while (shard->used + size > shard->capacity
+			&& !cds_list_empty(&shard->ring)) {
+		pos = shard->hand->next;
+		if (pos == &shard->ring)
+			pos = pos->next;
+		node = caa_container_of(pos, struct cds_lfht_cache_node, clock);
+		if (CMM_LOAD_SHARED(node->referenced)) {
+			/* Second chance. */
+			CMM_STORE_SHARED(node->referenced, 0);
+			shard->hand = pos;
+			continue;
+		}
+		if (cds_lfht_del(cache->ht, &node->node))
+			urcu_die(ENOENT);
+		shard_unlink(cache, shard, node);
+	}
+}
+
+struct cds_lfht_cache *cds_lfht_cache_new_flavor(unsigned long capacity,
+		unsigned long nr_shards,
+		void (*free_node)(struct rcu_head *head),
+		const struct rcu_flavor_struct *flavor)
+{
+	struct cds_lfht_cache *cache;
+	unsigned long i;
+	int ret;
+
+	/* nr_shards must be power of two */
+	if (!nr_shards || (nr_shards & (nr_shards - 1)))
+		return NULL;
+	cache = calloc(1, sizeof(*cache));
+	if (!cache)
+		return NULL;
+	if (posix_memalign((void **) &cache->shards, CAA_CACHE_LINE_SIZE,
+			nr_shards * sizeof(*cache->shards)))
+		goto error;
+	cache->ht = cds_lfht_new_flavor(1, 1, 0,
+			CDS_LFHT_AUTO_RESIZE | CDS_LFHT_ACCOUNTING, flavor,
+			NULL);
+	if (!cache->ht)
+		goto error;
+	cache->free_node = free_node;
+	cache->flavor = flavor;
+	cache->nr_shards = nr_shards;
+	for (i = 0; i < nr_shards; i++) {
+		struct cache_shard *shard = &cache->shards[i];
+
+		ret = pthread_mutex_init(&shard->lock, NULL);
+		if (ret)
+			urcu_die(ret);
+		CDS_INIT_LIST_HEAD(&shard->ring);
+		shard->hand = &shard->ring;
+		shard->used = 0;
+		shard->capacity = capacity / nr_shards;
+	}
+	return cache;
+
+error:
+	free(cache->shards);
+	free(cache);
+	return NULL;
+}
+
+int cds_lfht_cache_destroy(struct cds_lfht_cache *cache)
+{
+	struct cds_lfht_cache_node *node, *tmp;
+	unsigned long i;
+	int ret;
+
+	cache->flavor->read_lock();
+	for (i = 0; i < cache->nr_shards; i++) {
+		struct cache_shard *shard = &cache->shards[i];
+
+		cds_list_for_each_entry_safe(node, tmp, &shard->ring, clock) {
+			if (cds_lfht_del(cache->ht, &node->node))
+				urcu_die(ENOENT);
+			shard_unlink(cache, shard, node);
+		}
+	}
+	cache->flavor->read_unlock();
+	ret = cds_lfht_destroy(cache->ht, NULL);
+	if (ret)
+		return ret;
+	for (i = 0; i < cache->nr_shards; i++) {
+		ret = pthread_mutex_destroy(&cache->shards[i].lock);
+		if (ret)
+			urcu_die(ret);
+	}
+	free(cache->shards);
+	free(cache);
+	return 0;
+}
+
+struct cds_lfht_cache_node *cds_lfht_cache_lookup(
+		struct cds_lfht_cache *cache, unsigned long hash,
+		cds_lfht_match_fct match, const void *key)
+{
+	struct cds_lfht_cache_node *node;
+	struct cds_lfht_iter iter;
+	struct cds_lfht_node *ht_node;
+
+	cds_lfht_lookup(cache->ht, hash, match, key, &iter);
+	ht_node = cds_lfht_iter_get_node(&iter);
+	if (!ht_node)
+		return NULL;
+	node = caa_container_of(ht_node, struct cds_lfht_cache_node, node);
+	/* Keep the cache line clean once referenced. */
+	if (!CMM_LOAD_SHARED(node->referenced))
+		CMM_STORE_SHARED(node->referenced, 1);
+	return node;
+}
+
+struct cds_lfht_cache_node *cds_lfht_cache_add(struct cds_lfht_cache *cache,
+		unsigned long hash, cds_lfht_match_fct match, const void *key,
+		struct cds_lfht_cache_node *node, unsigned long size)
+{
+	struct cache_shard *shard = shard_of_reverse_hash(cache,
+			_cds_lfht_bit_reverse_ulong(hash));
+	struct cds_lfht_node *ret;
+
+	node->size = size;
+	node->referenced = 0;
+	mutex_lock(&shard->lock);
+	ret = cds_lfht_add_unique(cache->ht, hash, match, key, &node->node);
+	if (ret == &node->node) {
+		shard_evict(cache, shard, size);
+		cds_list_add_tail(&node->clock, shard->hand);
+		shard->used += size;
+	}
+	mutex_unlock(&shard->lock);
+	return caa_container_of(ret, struct cds_lfht_cache_node, node);
+}
+
+int cds_lfht_cache_del(struct cds_lfht_cache *cache,
+		struct cds_lfht_cache_node *node)
+{
+	struct cache_shard *shard = shard_of_reverse_hash(cache,
+			node->node.reverse_hash);
+	int ret;
+
+	mutex_lock(&shard->lock);
+	ret = cds_lfht_del(cache->ht, &node->node);
+	if (!ret)
+		shard_unlink(cache, shard, node);
+	mutex_unlock(&shard->lock);
+	return ret;
+}
+
+unsigned long cds_lfht_cache_used(struct cds_lfht_cache *cache)
+{
+	unsigned long i, used = 0;
+
+	for (i = 0; i < cache->nr_shards; i++)
+		used += CMM_LOAD_SHARED(cache->shards[i].used);
+	return used;
+}
+
+struct cds_lfht *cds_lfht_cache_ht(struct cds_lfht_cache *cache)
+{
+	return cache->ht;
+}
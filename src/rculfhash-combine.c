@@ -0,0 +1,354 @@
+/*
+ * rculfhash-combine.c
+ *
+ * Userspace RCU library - flat-combining updates of cds_lfht entries
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301
+ * USA
+ */
+
+/*
+ * A request stays in the stack of its slot until a combiner pops it,
+ * under the slot mutex, and the combiner marks all requests it popped
+ * done before releasing the mutex. A thread whose request is not done
+ * once it holds the mutex thus finds it in the stack, and combines it
+ * itself. Requests live on the stack of the waiting threads: combiners
+ * do not access them anymore once they are marked done.
+ */
+
+#define _LGPL_SOURCE
+#include <stdlib.h>
+#include <errno.h>
+#include <pthread.h>
+
+#include <urcu/compiler.h>
+#include <urcu/arch.h>
+#include <urcu/flavor.h>
+#include <urcu/lfstack.h>
+#include <urcu/rculfhash.h>
+#include <urcu/rculfhash-combine.h>
+
+#include "urcu-die.h"
+
+/* Attempts to take the slot mutex before blocking on it. */
+#define COMBINE_SPIN_ATTEMPTS	100
+
+struct combine_slot {
+	struct __cds_lfs_stack requests;
+	pthread_mutex_t lock;		/* Protects the fields below. */
+	unsigned long nr_requests;
+	unsigned long nr_batches;
+	unsigned long nr_publications;
+	unsigned long nr_retries;
+} __attribute__((aligned(CAA_CACHE_LINE_SIZE)));
+
+struct cds_lfht_combine {
+	struct cds_lfht *ht;
+	const struct cds_lfht_combine_ops *ops;
+	void *priv;
+	const struct rcu_flavor_struct *flavor;
+	unsigned long nr_slots;
+	struct combine_slot *slots;
+};
+
+struct combine_req {
+	struct cds_lfs_node node;	/* Stack of the slot. */
+	unsigned long hash;
+	cds_lfht_match_fct match;
+	const void *key;
+	void *arg;
+	int upsert;
+	int ret;
+	int done;
+	/* Fields below are owned by the combiner. */
+	struct combine_req *next;	/* Batch, in arrival order. */
+	struct combine_req *leader;	/* Request combined with. */
+};
+
+static void mutex_lock(pthread_mutex_t *mutex)
+{
+	int ret;
+
+	ret = pthread_mutex_lock(mutex);
+	if (ret)
+		urcu_die(ret);
+}
+
+static void mutex_unlock(pthread_mutex_t *mutex)
+{
+	int ret;
+
+	ret = pthread_mutex_unlock(mutex);
+	if (ret)
+		urcu_die(ret);
+}
+
+static int mutex_trylock(pthread_mutex_t *mutex)
+{
+	int ret;
+
+	ret = pthread_mutex_trylock(mutex);
+	if (ret && ret != EBUSY)
+		urcu_die(ret);
+	return ret;
+}
+
+/*
+ * Publish the copy built from @cur, or add it if @cur is NULL. Return 0
+ * on success, -EAGAIN if a concurrent update won, or the error of
+ * cds_lfht_replace().
+ */
+static int combine_publish(struct cds_lfht_combine *comb,
+		struct combine_req *leader, struct cds_lfht_iter *iter,
+		struct cds_lfht_combine_node *cur,
+		struct cds_lfht_combine_node *copy)
+{
+	int ret;
+
+	if (!cur) {
+		if (cds_lfht_add_unique(comb->ht, leader->hash, leader->match,
+				leader->key, &copy->node) != &copy->node)
+			return -EAGAIN;
+		return 0;
+	}
+	ret = cds_lfht_replace(comb->ht, iter, leader->hash, leader->match,
+			leader->key, &copy->node);
+	if (ret == -ENOENT)
+		return -EAGAIN;
+	if (!ret)
+		comb->flavor->update_call_rcu(&cur->rcu_head,
+				comb->ops->free_node);
+	return ret;
+}
+
+/*
+ * Apply the requests of the batch following @leader for the same key
+ * to the entry of the key, with one publication. On error, release
+ * them, to be combined on their own.
+ */
+static void combine_key(struct cds_lfht_combine *comb,
+		struct combine_slot *slot, struct combine_req *leader)
+{
+	struct cds_lfht_combine_node *cur, *copy;
+	struct cds_lfht_node *ht_node;
+	struct combine_req *req;
+	struct cds_lfht_iter iter;
+	int grouped = 0, ret;
+
+	leader->leader = leader;
+	for (;;) {
+		cds_lfht_lookup(comb->ht, leader->hash, leader->match,
+				leader->key, &iter);
+		ht_node = cds_lfht_iter_get_node(&iter);
+		cur = ht_node ? caa_container_of(ht_node,
+				struct cds_lfht_combine_node, node) : NULL;
+		if (!cur && !leader->upsert) {
+			ret = -ENOENT;
+			break;
+		}
+		copy = comb->ops->copy(cur, leader->key, comb->priv);
+		if (!copy) {
+			ret = -ENOMEM;
+			break;
+		}
+		comb->ops->apply(copy, leader->arg, comb->priv);
+		for (req = leader->next; req; req = req->next) {
+			if (grouped) {
+				if (req->leader != leader)
+					continue;
+			} else {
+				if (req->leader || req->hash != leader->hash
+				    || req->match != leader->match
+				    || !leader->match(&copy->node, req->key))
+					continue;
+				req->leader = leader;
+			}
+			comb->ops->apply(copy, req->arg, comb->priv);
+		}
+		grouped = 1;
+		ret = combine_publish(comb, leader, &iter, cur, copy);
+		if (!ret) {
+			slot->nr_publications++;
+			break;
+		}
+		/* The copy was never visible. */
+		comb->ops->free_node(&copy->rcu_head);
+		if (ret != -EAGAIN)
+			break;
+		slot->nr_retries++;
+	}
+	for (req = leader; req; req = req->next) {
+		if (req->leader != leader)
+			continue;
+		if (ret && req != leader)
+			req->leader = NULL;
+		else
+			req->ret = ret;
+	}
+}
+
+/* Combine the requests of the slot. Called with the slot mutex held. */
+static void combine_slot(struct cds_lfht_combine *comb,
+		struct combine_slot *slot)
+{
+	struct cds_lfs_head *head;
+	struct cds_lfs_node *node, *n;
+	struct combine_req *batch = NULL, *req, *next;
+
+	head = __cds_lfs_pop_all(&slot->requests);
+	if (!head)
+		return;
+	/* The stack pops the latest request first. */
+	cds_lfs_for_each_safe(head, node, n) {
+		req = caa_container_of(node, struct combine_req, node);
+		req->next = batch;
+		req->leader = NULL;
+		batch = req;
+	}
+	for (req = batch; req; req = req->next) {
+		if (!req->leader)
+			combine_key(comb, slot, req);
+		slot->nr_requests++;
+	}
+	slot->nr_batches++;
+	/* Make the results and publications visible before done. */
+	cmm_smp_mb();
+	for (req = batch; req; req = next) {
+		next = req->next;
+		CMM_STORE_SHARED(req->done, 1);
+	}
+}
+
+static int combine_request(struct cds_lfht_combine *comb,
+		unsigned long hash, cds_lfht_match_fct match,
+		const void *key, void *arg, int upsert)
+{
+	struct combine_slot *slot = &comb->slots[hash & (comb->nr_slots - 1)];
+	struct combine_req req = {
+		.hash = hash,
+		.match = match,
+		.key = key,
+		.arg = arg,
+		.upsert = upsert,
+	};
+	unsigned long attempt = 0;
+
+	cds_lfs_node_init(&req.node);
+	(void) cds_lfs_push(&slot->requests, &req.node);
+	while (!CMM_LOAD_SHARED(req.done)) {
+		if (attempt++ < COMBINE_SPIN_ATTEMPTS) {
+			if (mutex_trylock(&slot->lock)) {
+				caa_cpu_relax();
+				continue;
+			}
+		} else {
+			mutex_lock(&slot->lock);
+		}
+		if (!CMM_LOAD_SHARED(req.done))
+			combine_slot(comb, slot);
+		mutex_unlock(&slot->lock);
+	}
+	/* Read the result after done. */
+	cmm_smp_mb();
+	return req.ret;
+}
+
+struct cds_lfht_combine *cds_lfht_combine_new_flavor(struct cds_lfht *ht,
+		unsigned long nr_slots, const struct cds_lfht_combine_ops *ops,
+		void *priv, const struct rcu_flavor_struct *flavor)
+{
+	struct cds_lfht_combine *comb;
+	unsigned long i;
+	int ret;
+
+	/* nr_slots must be power of two */
+	if (!nr_slots || (nr_slots & (nr_slots - 1)))
+		return NULL;
+	comb = calloc(1, sizeof(*comb));
+	if (!comb)
+		return NULL;
+	if (posix_memalign((void **) &comb->slots, CAA_CACHE_LINE_SIZE,
+			nr_slots * sizeof(*comb->slots))) {
+		free(comb);
+		return NULL;
+	}
+	comb->ht = ht;
+	comb->ops = ops;
+	comb->priv = priv;
+	comb->flavor = flavor;
+	comb->nr_slots = nr_slots;
+	for (i = 0; i < nr_slots; i++) {
+		struct combine_slot *slot = &comb->slots[i];
+
+		__cds_lfs_init(&slot->requests);
+		ret = pthread_mutex_init(&slot->lock, NULL);
+		if (ret)
+			urcu_die(ret);
+		slot->nr_requests = 0;
+		slot->nr_batches = 0;
+		slot->nr_publications = 0;
+		slot->nr_retries = 0;
+	}
+	return comb;
+}
+
+void cds_lfht_combine_destroy(struct cds_lfht_combine *comb)
+{
+	unsigned long i;
+	int ret;
+
+	for (i = 0; i < comb->nr_slots; i++) {
+		ret = pthread_mutex_destroy(&comb->slots[i].lock);
+		if (ret)
+			urcu_die(ret);
+	}
+	free(comb->slots);
+	free(comb);
+}
+
+int cds_lfht_combine_upsert(struct cds_lfht_combine *comb,
+		unsigned long hash, cds_lfht_match_fct match,
+		const void *key, void *arg)
+{
+	return combine_request(comb, hash, match, key, arg, 1);
+}
+
+int cds_lfht_combine_update(struct cds_lfht_combine *comb,
+		unsigned long hash, cds_lfht_match_fct match,
+		const void *key, void *arg)
+{
+	return combine_request(comb, hash, match, key, arg, 0);
+}
+
+void cds_lfht_combine_get_stats(struct cds_lfht_combine *comb,
+		struct cds_lfht_combine_stats *stats)
+{
+	unsigned long i;
+
+	stats->requests = 0;
+	stats->batches = 0;
+	stats->publications = 0;
+	stats->retries = 0;
+	for (i = 0; i < comb->nr_slots; i++) {
+		struct combine_slot *slot = &comb->slots[i];
+
+		mutex_lock(&slot->lock);
+		stats->requests += slot->nr_requests;
+		stats->batches += slot->nr_batches;
+		stats->publications += slot->nr_publications;
+		stats->retries += slot->nr_retries;
+		mutex_unlock(&slot->lock);
+	}
+}
@@ -0,0 +1,291 @@
+/*
+ * rculfhash-dump.c
+ *
+ * Userspace RCU library - Warm-restart dumps of cds_lfht tables
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301
+ * USA
+ */
+
+/*
+ * A dump is a header followed by the records, each one a record header
+ * and the serialized node, padded to 8 bytes. The header is written
+ * last, so that an incomplete dump has no valid magic number, and the
+ * restore checks the bounds of all records before allocating nodes.
+ */
+
+#define _LGPL_SOURCE
+#include <stdlib.h>
+#include <stdio.h>
+#include <stdint.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include <urcu/compiler.h>
+#include <urcu/system.h>
+#include <urcu/flavor.h>
+#include <urcu/rculfhash.h>
+#include <urcu/rculfhash-dump.h>
+
+#define DUMP_MAGIC		0x504d55445448464cULL	/* "LFHTDUMP" */
+#define DUMP_VERSION		1
+#define DUMP_ALIGN		8
+#define DUMP_BUF_LEN		256
+#define DUMP_STDIO_BUF_LEN	(1UL << 20)
+#define RESTORE_BATCH		4096
+
+struct dump_header {
+	uint64_t magic;
+	uint32_t version;
+	uint32_t long_size;
+	uint64_t nr_nodes;
+	uint64_t size;
+	uint64_t min_nr_alloc_buckets;
+	uint64_t max_nr_buckets;
+	uint64_t data_len;		/* Bytes of records. */
+	int32_t flags;
+	uint32_t pad;
+};
+
+struct dump_record {
+	uint64_t hash;
+	uint64_t len;
+};
+
+static inline
+uint64_t dump_align(uint64_t len)
+{
+	return (len + DUMP_ALIGN - 1) & ~(uint64_t) (DUMP_ALIGN - 1);
+}
+
+static
+int dump_write(FILE *f, const void *buf, size_t len)
+{
+	if (fwrite(buf, 1, len, f) != len)
+		return -(errno ? errno : EIO);
+	return 0;
+}
+
+static
+long dump_nodes(struct cds_lfht *ht, FILE *f, cds_lfht_dump_fct dump,
+		void *priv, struct dump_header *header)
+{
+	static const char pad[DUMP_ALIGN];
+	struct cds_lfht_iter iter;
+	struct cds_lfht_node *node;
+	struct dump_record rec;
+	size_t buf_len = DUMP_BUF_LEN;
+	ssize_t len;
+	void *buf;
+	long ret = 0;
+
+	buf = malloc(buf_len);
+	if (!buf)
+		return -ENOMEM;
+	ht->flavor->read_lock();
+	cds_lfht_for_each(ht, &iter, node) {
+		for (;;) {
+			len = dump(node, buf, buf_len, priv);
+			if (len < 0 || (size_t) len <= buf_len)
+				break;
+			free(buf);
+			buf_len = len;
+			buf = malloc(buf_len);
+			if (!buf) {
+				ret = -ENOMEM;
+				goto end;
+			}
+		}
+		if (len < 0) {
+			ret = len;
+			goto end;
+		}
+		rec.hash = _cds_lfht_bit_reverse_ulong(node->reverse_hash);
+		rec.len = len;
+		ret = dump_write(f, &rec, sizeof(rec));
+		if (!ret)
+			ret = dump_write(f, buf, len);
+		if (!ret)
+			ret = dump_write(f, pad, dump_align(len) - len);
+		if (ret)
+			goto end;
+		header->nr_nodes++;
+		header->data_len += sizeof(rec) + dump_align(len);
+	}
+end:
+	ht->flavor->read_unlock();
+	free(buf);
+	return ret;
+}
+
+long cds_lfht_dump(struct cds_lfht *ht, const char *path,
+		cds_lfht_dump_fct dump, void *priv)
+{
+	struct dump_header header;
+	FILE *f;
+	long ret;
+
+	f = fopen(path, "w");
+	if (!f)
+		return -errno;
+	(void) setvbuf(f, NULL, _IOFBF, DUMP_STDIO_BUF_LEN);
+	memset(&header, 0, sizeof(header));
+	header.version = DUMP_VERSION;
+	header.long_size = sizeof(unsigned long);
+	header.size = CMM_LOAD_SHARED(ht->size);
+	header.min_nr_alloc_buckets = ht->min_nr_alloc_buckets;
+	header.max_nr_buckets = ht->max_nr_buckets;
+	header.flags = ht->flags;
+	/* Room for the header, written once the records are. */
+	ret = dump_write(f, &header, sizeof(header));
+	if (!ret)
+		ret = dump_nodes(ht, f, dump, priv, &header);
+	if (!ret && fflush(f))
+		ret = -errno;
+	if (!ret && fsync(fileno(f)))
+		ret = -errno;
+	if (!ret) {
+		header.magic = DUMP_MAGIC;
+		if (fseek(f, 0, SEEK_SET))
+			ret = -errno;
+		else
+			ret = dump_write(f, &header, sizeof(header));
+	}
+	if (!ret && (fflush(f) || fsync(fileno(f))))
+		ret = -errno;
+	if (fclose(f) && !ret)
+		ret = -errno;
+	if (ret)
+		return ret;
+	return header.nr_nodes;
+}
+
+/* Check the header and the bounds of all records. */
+static
+int restore_check(const char *map, size_t map_len)
+{
+	const struct dump_header *header = (const struct dump_header *) map;
+	const struct dump_record *rec;
+	uint64_t offset, nr_nodes = 0;
+
+	if (map_len < sizeof(*header)
+			|| header->magic != DUMP_MAGIC
+			|| header->version != DUMP_VERSION
+			|| header->long_size != sizeof(unsigned long)
+			|| header->data_len != map_len - sizeof(*header))
+		return -EINVAL;
+	for (offset = sizeof(*header); offset < map_len;
+			offset += sizeof(*rec) + dump_align(rec->len)) {
+		rec = (const struct dump_record *) (map + offset);
+		if (map_len - offset < sizeof(*rec)
+				|| rec->len > map_len - offset - sizeof(*rec)
+				|| dump_align(rec->len)
+					> map_len - offset - sizeof(*rec))
+			return -EINVAL;
+		nr_nodes++;
+	}
+	if (nr_nodes != header->nr_nodes)
+		return -EINVAL;
+	return 0;
+}
+
+static
+void restore_nodes(struct cds_lfht *ht, const char *map, size_t map_len,
+		cds_lfht_restore_fct restore, void *priv,
+		struct cds_lfht_node **nodes, unsigned long *hashes)
+{
+	const struct dump_record *rec;
+	struct cds_lfht_node *node;
+	unsigned long nr = 0;
+	uint64_t offset;
+
+	for (offset = sizeof(struct dump_header); offset < map_len;
+			offset += sizeof(*rec) + dump_align(rec->len)) {
+		rec = (const struct dump_record *) (map + offset);
+		node = restore(rec + 1, rec->len, rec->hash, priv);
+		if (!node)
+			continue;
+		nodes[nr] = node;
+		hashes[nr] = rec->hash;
+		if (++nr == RESTORE_BATCH) {
+			cds_lfht_add_bulk(ht, nodes, hashes, nr);
+			nr = 0;
+		}
+	}
+	cds_lfht_add_bulk(ht, nodes, hashes, nr);
+}
+
+struct cds_lfht *cds_lfht_restore_flavor(const char *path,
+		cds_lfht_restore_fct restore, void *priv,
+		const struct rcu_flavor_struct *flavor,
+		pthread_attr_t *attr)
+{
+	const struct dump_header *header;
+	struct cds_lfht_node **nodes = NULL;
+	unsigned long *hashes = NULL;
+	struct cds_lfht *ht = NULL;
+	struct stat st;
+	char *map = MAP_FAILED;
+	int fd, ret;
+
+	fd = open(path, O_RDONLY);
+	if (fd < 0)
+		return NULL;
+	if (fstat(fd, &st)) {
+		ret = errno;
+		goto end;
+	}
+	if ((size_t) st.st_size < sizeof(*header)) {
+		ret = EINVAL;
+		goto end;
+	}
+	map = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+	if (map == MAP_FAILED) {
+		ret = errno;
+		goto end;
+	}
+	(void) madvise(map, st.st_size, MADV_SEQUENTIAL);
+	(void) madvise(map, st.st_size, MADV_WILLNEED);
+	ret = -restore_check(map, st.st_size);
+	if (ret)
+		goto end;
+	header = (const struct dump_header *) map;
+	nodes = malloc(RESTORE_BATCH * sizeof(*nodes));
+	hashes = malloc(RESTORE_BATCH * sizeof(*hashes));
+	if (!nodes || !hashes) {
+		ret = ENOMEM;
+		goto end;
+	}
+	ht = cds_lfht_new_flavor(header->size, header->min_nr_alloc_buckets,
+			header->max_nr_buckets, header->flags, flavor, attr);
+	if (!ht) {
+		ret = ENOMEM;
+		goto end;
+	}
+	restore_nodes(ht, map, st.st_size, restore, priv, nodes, hashes);
+end:
+	free(hashes);
+	free(nodes);
+	if (map != MAP_FAILED)
+		(void) munmap(map, st.st_size);
+	(void) close(fd);
+	if (!ht)
+		errno = ret;
+	return ht;
+}
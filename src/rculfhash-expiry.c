@@ -0,0 +1,374 @@
+/*
+ * rculfhash-expiry.c
+ *
+ * Userspace RCU library - timer wheel expiring cds_lfht entries
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301
+ * USA
+ */
+
+/*
+ * Level l of a wheel has WHEEL_SLOTS slots of WHEEL_SLOTS^l ticks. An
+ * entry due in less than WHEEL_SLOTS^(l+1) ticks is in the level l slot
+ * of its deadline, which cascades to the lower levels when the wheel
+ * reaches the start of the slot, and level 0 slots expire their entries
+ * when the wheel reaches them. Deadlines beyond the span of the wheel
+ * are parked at its end, and cascade back to the top level.
+ *
+ * Expiring entries are unlinked from the wheel under the shard mutex,
+ * then deleted from the table outside of it: the thread whose
+ * cds_lfht_del() succeeds, expiry or cds_lfht_expiry_del(), frees the
+ * entry.
+ */
+
+#define _LGPL_SOURCE
+#include <stdlib.h>
+#include <errno.h>
+#include <pthread.h>
+
+#include <urcu/compiler.h>
+#include <urcu/arch.h>
+#include <urcu/flavor.h>
+#include <urcu/rculfhash.h>
+#include <urcu/rculfhash-expiry.h>
+
+#include "urcu-die.h"
+
+#define WHEEL_SLOT_BITS		6
+#define WHEEL_SLOTS		(1U << WHEEL_SLOT_BITS)
+#define WHEEL_LEVELS		4
+#define WHEEL_SPAN		(1ULL << (WHEEL_SLOT_BITS * WHEEL_LEVELS))
+
+enum node_state {
+	NODE_IDLE = 0,
+	NODE_ARMED,
+	NODE_EXPIRING,
+	NODE_DELETED,
+};
+
+struct expiry_shard {
+	pthread_mutex_t lock;		/* Protects the fields below. */
+	uint64_t now;
+	unsigned long nr_armed;
+	struct cds_list_head slots[WHEEL_LEVELS][WHEEL_SLOTS];
+} __attribute__((aligned(CAA_CACHE_LINE_SIZE)));
+
+struct cds_lfht_expiry {
+	struct cds_lfht *ht;
+	void (*free_node)(struct rcu_head *head);
+	const struct rcu_flavor_struct *flavor;
+	unsigned long nr_shards;
+	struct expiry_shard *shards;
+};
+
+/* Expired entries freed by a single call_rcu callback. */
+struct expiry_batch {
+	struct rcu_head head;
+	void (*free_node)(struct rcu_head *head);
+	struct cds_list_head nodes;
+};
+
+static void mutex_lock(pthread_mutex_t *mutex)
+{
+	int ret;
+
+	ret = pthread_mutex_lock(mutex);
+	if (ret)
+		urcu_die(ret);
+}
+
+static void mutex_unlock(pthread_mutex_t *mutex)
+{
+	int ret;
+
+	ret = pthread_mutex_unlock(mutex);
+	if (ret)
+		urcu_die(ret);
+}
+
+static inline
+struct expiry_shard *shard_of(struct cds_lfht_expiry *exp,
+		struct cds_lfht_expiry_node *node)
+{
+	return &exp->shards[node->node.reverse_hash & (exp->nr_shards - 1)];
+}
+
+/* Insert an armed entry due after the current tick of the wheel. */
+static void wheel_insert(struct expiry_shard *shard,
+		struct cds_lfht_expiry_node *node, uint64_t deadline)
+{
+	uint64_t delta = deadline - shard->now;
+	unsigned int level = 0;
+
+	if (delta >= WHEEL_SPAN) {
+		delta = WHEEL_SPAN - 1;
+		deadline = shard->now + delta;
+	}
+	while (delta >= 1ULL << (WHEEL_SLOT_BITS * (level + 1)))
+		level++;
+	cds_list_add_tail(&node->link, &shard->slots[level]
+		[(deadline >> (WHEEL_SLOT_BITS * level)) & (WHEEL_SLOTS - 1)]);
+}
+
+/* Queue an entry unlinked from the wheel for expiry. */
+static void wheel_expire(struct expiry_shard *shard,
+		struct cds_lfht_expiry_node *node, struct cds_list_head *expired)
+{
+	node->state = NODE_EXPIRING;
+	shard->nr_armed--;
+	cds_list_add_tail(&node->link, expired);
+}
+
+/* Insert again, or expire, the entries of a slot list. */
+static void wheel_reinsert(struct expiry_shard *shard,
+		struct cds_list_head *list, struct cds_list_head *expired)
+{
+	struct cds_lfht_expiry_node *node, *tmp;
+
+	cds_list_for_each_entry_safe(node, tmp, list, link) {
+		if (node->deadline <= shard->now)
+			wheel_expire(shard, node, expired);
+		else
+			wheel_insert(shard, node, node->deadline);
+	}
+}
+
+/*
+ * Advance the wheel of a shard to now, queueing the entries due on
+ * expired. Called with the shard mutex held.
+ */
+static void shard_advance(struct expiry_shard *shard, uint64_t now,
+		struct cds_list_head *expired)
+{
+	struct cds_lfht_expiry_node *node, *tmp;
+	struct cds_list_head list;
+	unsigned int level, slot;
+
+	if (!shard->nr_armed || now - shard->now >= WHEEL_SPAN) {
+		/* Cheaper to insert all entries again than to tick. */
+		CDS_INIT_LIST_HEAD(&list);
+		for (level = 0; level < WHEEL_LEVELS; level++) {
+			for (slot = 0; slot < WHEEL_SLOTS; slot++)
+				cds_list_splice(&shard->slots[level][slot],
+					&list);
+			for (slot = 0; slot < WHEEL_SLOTS; slot++)
+				CDS_INIT_LIST_HEAD(&shard->slots[level][slot]);
+		}
+		shard->now = now;
+		wheel_reinsert(shard, &list, expired);
+		return;
+	}
+	while (shard->now < now) {
+		shard->now++;
+		for (level = WHEEL_LEVELS - 1; level > 0; level--) {
+			if (shard->now & ((1ULL << (WHEEL_SLOT_BITS * level)) - 1))
+				continue;
+			slot = (shard->now >> (WHEEL_SLOT_BITS * level))
+				& (WHEEL_SLOTS - 1);
+			CDS_INIT_LIST_HEAD(&list);
+			cds_list_splice(&shard->slots[level][slot], &list);
+			CDS_INIT_LIST_HEAD(&shard->slots[level][slot]);
+			wheel_reinsert(shard, &list, expired);
+		}
+		slot = shard->now & (WHEEL_SLOTS - 1);
+		cds_list_for_each_entry_safe(node, tmp, &shard->slots[0][slot],
+				link)
+			wheel_expire(shard, node, expired);
+		CDS_INIT_LIST_HEAD(&shard->slots[0][slot]);
+	}
+}
+
+static void free_batch(struct rcu_head *head)
+{
+	struct expiry_batch *batch =
+		caa_container_of(head, struct expiry_batch, head);
+	struct cds_lfht_expiry_node *node, *tmp;
+
+	cds_list_for_each_entry_safe(node, tmp, &batch->nodes, link)
+		batch->free_node(&node->rcu_head);
+	free(batch);
+}
+
+struct cds_lfht_expiry *cds_lfht_expiry_new_flavor(struct cds_lfht *ht,
+		unsigned long nr_shards, uint64_t now,
+		void (*free_node)(struct rcu_head *head),
+		const struct rcu_flavor_struct *flavor)
+{
+	struct cds_lfht_expiry *exp;
+	unsigned long i;
+	unsigned int level, slot;
+	int ret;
+
+	/* nr_shards must be power of two */
+	if (!nr_shards || (nr_shards & (nr_shards - 1)))
+		return NULL;
+	exp = malloc(sizeof(*exp));
+	if (!exp)
+		return NULL;
+	if (posix_memalign((void **) &exp->shards, CAA_CACHE_LINE_SIZE,
+			nr_shards * sizeof(*exp->shards))) {
+		free(exp);
+		return NULL;
+	}
+	exp->ht = ht;
+	exp->free_node = free_node;
+	exp->flavor = flavor;
+	exp->nr_shards = nr_shards;
+	for (i = 0; i < nr_shards; i++) {
+		struct expiry_shard *shard = &exp->shards[i];
+
+		ret = pthread_mutex_init(&shard->lock, NULL);
+		if (ret)
+			urcu_die(ret);
+		shard->now = now;
+		shard->nr_armed = 0;
+		for (level = 0; level < WHEEL_LEVELS; level++) {
+			for (slot = 0; slot < WHEEL_SLOTS; slot++)
+				CDS_INIT_LIST_HEAD(&shard->slots[level][slot]);
+		}
+	}
+	return exp;
+}
+
+void cds_lfht_expiry_destroy(struct cds_lfht_expiry *exp)
+{
+	struct cds_lfht_expiry_node *node, *tmp;
+	unsigned long i;
+	unsigned int level, slot;
+	int ret;
+
+	for (i = 0; i < exp->nr_shards; i++) {
+		struct expiry_shard *shard = &exp->shards[i];
+
+		for (level = 0; level < WHEEL_LEVELS; level++) {
+			for (slot = 0; slot < WHEEL_SLOTS; slot++) {
+				cds_list_for_each_entry_safe(node, tmp,
+						&shard->slots[level][slot], link)
+					node->state = NODE_IDLE;
+			}
+		}
+		ret = pthread_mutex_destroy(&shard->lock);
+		if (ret)
+			urcu_die(ret);
+	}
+	free(exp->shards);
+	free(exp);
+}
+
+int cds_lfht_expiry_arm(struct cds_lfht_expiry *exp,
+		struct cds_lfht_expiry_node *node, uint64_t deadline)
+{
+	struct expiry_shard *shard = shard_of(exp, node);
+	int ret = 0;
+
+	mutex_lock(&shard->lock);
+	switch (node->state) {
+	case NODE_ARMED:
+		cds_list_del(&node->link);
+		break;
+	case NODE_IDLE:
+		shard->nr_armed++;
+		break;
+	default:
+		ret = -ENOENT;
+		goto end;
+	}
+	node->state = NODE_ARMED;
+	node->deadline = deadline;
+	/* Passed deadlines expire on the next tick. */
+	wheel_insert(shard, node, deadline > shard->now ?
+			deadline : shard->now + 1);
+end:
+	mutex_unlock(&shard->lock);
+	return ret;
+}
+
+int cds_lfht_expiry_disarm(struct cds_lfht_expiry *exp,
+		struct cds_lfht_expiry_node *node)
+{
+	struct expiry_shard *shard = shard_of(exp, node);
+	int ret = -ENOENT;
+
+	mutex_lock(&shard->lock);
+	if (node->state == NODE_ARMED) {
+		cds_list_del(&node->link);
+		shard->nr_armed--;
+		node->state = NODE_IDLE;
+		ret = 0;
+	}
+	mutex_unlock(&shard->lock);
+	return ret;
+}
+
+int cds_lfht_expiry_del(struct cds_lfht_expiry *exp,
+		struct cds_lfht_expiry_node *node)
+{
+	struct expiry_shard *shard = shard_of(exp, node);
+	int ret;
+
+	mutex_lock(&shard->lock);
+	if (node->state == NODE_ARMED) {
+		cds_list_del(&node->link);
+		shard->nr_armed--;
+	}
+	/* Expiry owns the link of expiring entries. */
+	if (node->state != NODE_EXPIRING)
+		node->state = NODE_DELETED;
+	mutex_unlock(&shard->lock);
+	ret = cds_lfht_del(exp->ht, &node->node);
+	if (!ret)
+		exp->flavor->update_call_rcu(&node->rcu_head, exp->free_node);
+	return ret;
+}
+
+unsigned long cds_lfht_expiry_advance(struct cds_lfht_expiry *exp,
+		uint64_t now)
+{
+	struct cds_lfht_expiry_node *node, *tmp;
+	struct expiry_batch *batch = NULL;
+	struct cds_list_head expired;
+	unsigned long i, nr = 0;
+
+	CDS_INIT_LIST_HEAD(&expired);
+	for (i = 0; i < exp->nr_shards; i++) {
+		struct expiry_shard *shard = &exp->shards[i];
+
+		mutex_lock(&shard->lock);
+		shard_advance(shard, now, &expired);
+		mutex_unlock(&shard->lock);
+	}
+	cds_list_for_each_entry_safe(node, tmp, &expired, link) {
+		/* Deleted meanwhile by cds_lfht_expiry_del(). */
+		if (cds_lfht_del(exp->ht, &node->node))
+			continue;
+		nr++;
+		if (!batch) {
+			batch = malloc(sizeof(*batch));
+			if (batch) {
+				batch->free_node = exp->free_node;
+				CDS_INIT_LIST_HEAD(&batch->nodes);
+			}
+		}
+		if (caa_unlikely(!batch)) {
+			exp->flavor->update_call_rcu(&node->rcu_head,
+					exp->free_node);
+			continue;
+		}
+		cds_list_move(&node->link, &batch->nodes);
+	}
+	if (batch)
+		exp->flavor->update_call_rcu(&batch->head, free_batch);
+	return nr;
+}
@@ -0,0 +1,323 @@
+/*
+ * rculfhash-filter.c
+ *
+ * Userspace RCU library - Bloom filter front for cds_lfht lookups
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301
+ * USA
+ */
+
+/*
+ * A build publishes the new filter as "building" before walking the
+ * table, and walks it a grace period later: additions which did not
+ * see it have then completed, and their nodes are in the walk. The new
+ * filter then becomes "current" before "building" is cleared, and
+ * additions read "building" before "current", so that an addition
+ * which did not set the bits of the new filter set those of the
+ * current one.
+ */
+
+#define _LGPL_SOURCE
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <limits.h>
+
+#include <urcu/compiler.h>
+#include <urcu/arch.h>
+#include <urcu/uatomic.h>
+#include <urcu/call-rcu.h>
+#include <urcu/flavor.h>
+#include <urcu/rculfhash.h>
+#include <urcu/rculfhash-filter.h>
+#include <urcu/static/pointer.h>
+
+/* Bits of the filter per entry of its capacity: ~0.1% false positives. */
+#define FILTER_BITS_PER_ENTRY	16
+#define FILTER_NR_PROBES	8
+#define FILTER_BLOCK_WORDS	(CAA_CACHE_LINE_SIZE / sizeof(unsigned long))
+#define FILTER_BLOCK_BITS	(CAA_CACHE_LINE_SIZE * CHAR_BIT)
+
+struct filter_bits {
+	struct rcu_head head;
+	unsigned long block_mask;
+	unsigned long capacity;
+	unsigned long *words;		/* Cache line aligned blocks. */
+};
+
+struct cds_lfht_filter {
+	struct cds_lfht *ht;
+	const struct rcu_flavor_struct *flavor;
+	struct filter_bits *current;	/* RCU */
+	struct filter_bits *building;	/* RCU, NULL unless building. */
+	struct rcu_head build_head;
+	unsigned long build_dels;	/* Deletions the build accounts. */
+
+	/* Updated by all additions and deletions. */
+	long nr_items __attribute__((aligned(CAA_CACHE_LINE_SIZE)));
+	unsigned long nr_dels;		/* Since the last build. */
+	int build_pending;
+} __attribute__((aligned(CAA_CACHE_LINE_SIZE)));
+
+static inline
+uint64_t filter_mix(uint64_t h)
+{
+	h ^= h >> 33;
+	h *= 0xff51afd7ed558ccdULL;
+	h ^= h >> 33;
+	h *= 0xc4ceb9fe1a85ec53ULL;
+	h ^= h >> 33;
+	return h;
+}
+
+/*
+ * Find the block of a hash, and the bits of each of its words the hash
+ * sets. Probes use double hashing within the block.
+ */
+static inline
+unsigned long *filter_probe(struct filter_bits *bits, unsigned long hash,
+		unsigned long *mask)
+{
+	uint64_t h = filter_mix(hash), g = filter_mix(h);
+	uint32_t pos = (uint32_t) g, step = (uint32_t) (g >> 32) | 1;
+	unsigned int i;
+
+	for (i = 0; i < FILTER_BLOCK_WORDS; i++)
+		mask[i] = 0;
+	for (i = 0; i < FILTER_NR_PROBES; i++) {
+		unsigned int bit = pos & (FILTER_BLOCK_BITS - 1);
+
+		mask[bit / CAA_BITS_PER_LONG] |= 1UL << (bit % CAA_BITS_PER_LONG);
+		pos += step;
+	}
+	return &bits->words[(h & bits->block_mask) * FILTER_BLOCK_WORDS];
+}
+
+static
+int filter_bits_test(struct filter_bits *bits, unsigned long hash)
+{
+	unsigned long mask[FILTER_BLOCK_WORDS];
+	unsigned long *block = filter_probe(bits, hash, mask);
+	unsigned long miss = 0;
+	unsigned int i;
+
+	/* Branch-free over the cache line. */
+	for (i = 0; i < FILTER_BLOCK_WORDS; i++)
+		miss |= mask[i] & ~CMM_LOAD_SHARED(block[i]);
+	return !miss;
+}
+
+static
+void filter_bits_set(struct filter_bits *bits, unsigned long hash)
+{
+	unsigned long mask[FILTER_BLOCK_WORDS];
+	unsigned long *block = filter_probe(bits, hash, mask);
+	unsigned int i;
+
+	for (i = 0; i < FILTER_BLOCK_WORDS; i++) {
+		if (mask[i] & ~CMM_LOAD_SHARED(block[i]))
+			uatomic_or(&block[i], mask[i]);
+	}
+}
+
+static
+struct filter_bits *filter_bits_alloc(unsigned long capacity)
+{
+	struct filter_bits *bits;
+	unsigned long nr_blocks = 1;
+
+	while (nr_blocks * FILTER_BLOCK_BITS
+			< capacity * FILTER_BITS_PER_ENTRY) {
+		if (nr_blocks > ULONG_MAX / (2 * CAA_CACHE_LINE_SIZE))
+			return NULL;
+		nr_blocks <<= 1;
+	}
+	bits = malloc(sizeof(*bits));
+	if (!bits)
+		return NULL;
+	if (posix_memalign((void **) &bits->words, CAA_CACHE_LINE_SIZE,
+			nr_blocks * CAA_CACHE_LINE_SIZE)) {
+		free(bits);
+		return NULL;
+	}
+	memset(bits->words, 0, nr_blocks * CAA_CACHE_LINE_SIZE);
+	bits->block_mask = nr_blocks - 1;
+	bits->capacity = nr_blocks * FILTER_BLOCK_BITS / FILTER_BITS_PER_ENTRY;
+	return bits;
+}
+
+static
+void filter_bits_free(struct filter_bits *bits)
+{
+	free(bits->words);
+	free(bits);
+}
+
+static
+void filter_bits_free_rcu(struct rcu_head *head)
+{
+	filter_bits_free(caa_container_of(head, struct filter_bits, head));
+}
+
+/* Walk the table into the filter being built, and publish it. */
+static
+void filter_build(struct rcu_head *head)
+{
+	struct cds_lfht_filter *filter =
+		caa_container_of(head, struct cds_lfht_filter, build_head);
+	struct filter_bits *bits = filter->building, *old = filter->current;
+	struct cds_lfht_iter iter;
+	struct cds_lfht_node *node;
+
+	filter->flavor->read_lock();
+	cds_lfht_for_each(filter->ht, &iter, node)
+		filter_bits_set(bits,
+			_cds_lfht_bit_reverse_ulong(node->reverse_hash));
+	filter->flavor->read_unlock();
+	rcu_set_pointer(&filter->current, bits);
+	rcu_set_pointer(&filter->building, NULL);
+	uatomic_add(&filter->nr_dels, -filter->build_dels);
+	uatomic_set(&filter->build_pending, 0);
+	filter->flavor->update_call_rcu(&old->head, filter_bits_free_rcu);
+}
+
+/*
+ * Start a build once the deletions reached half of the capacity of the
+ * filter, or the entries exceed it.
+ */
+static
+void filter_maybe_build(struct cds_lfht_filter *filter)
+{
+	struct filter_bits *bits = rcu_dereference(filter->current);
+	unsigned long capacity = bits->capacity, nr_dels;
+	long nr_items;
+
+	nr_items = uatomic_read(&filter->nr_items);
+	nr_dels = uatomic_read(&filter->nr_dels);
+	if (nr_items <= (long) capacity && nr_dels < capacity / 2)
+		return;
+	if (uatomic_cmpxchg(&filter->build_pending, 0, 1))
+		return;
+	while (nr_items > (long) capacity && capacity <= ULONG_MAX / 2)
+		capacity <<= 1;
+	bits = filter_bits_alloc(capacity);
+	if (!bits) {
+		uatomic_set(&filter->build_pending, 0);
+		return;
+	}
+	filter->build_dels = nr_dels;
+	rcu_set_pointer(&filter->building, bits);
+	filter->flavor->update_call_rcu(&filter->build_head, filter_build);
+}
+
+static
+void filter_set(struct cds_lfht_filter *filter, unsigned long hash)
+{
+	struct filter_bits *bits;
+
+	bits = rcu_dereference(filter->building);
+	if (bits)
+		filter_bits_set(bits, hash);
+	cmm_smp_rmb();
+	filter_bits_set(rcu_dereference(filter->current), hash);
+}
+
+struct cds_lfht_filter *cds_lfht_filter_new_flavor(struct cds_lfht *ht,
+		unsigned long capacity,
+		const struct rcu_flavor_struct *flavor)
+{
+	struct cds_lfht_filter *filter;
+
+	if (posix_memalign((void **) &filter, CAA_CACHE_LINE_SIZE,
+			sizeof(*filter)))
+		return NULL;
+	memset(filter, 0, sizeof(*filter));
+	filter->current = filter_bits_alloc(capacity);
+	if (!filter->current) {
+		free(filter);
+		return NULL;
+	}
+	filter->ht = ht;
+	filter->flavor = flavor;
+	return filter;
+}
+
+void cds_lfht_filter_destroy(struct cds_lfht_filter *filter)
+{
+	filter->flavor->barrier();
+	filter_bits_free(filter->current);
+	free(filter);
+}
+
+int cds_lfht_filter_may_contain(struct cds_lfht_filter *filter,
+		unsigned long hash)
+{
+	return filter_bits_test(rcu_dereference(filter->current), hash);
+}
+
+void cds_lfht_filter_lookup(struct cds_lfht_filter *filter,
+		unsigned long hash, cds_lfht_match_fct match, const void *key,
+		struct cds_lfht_iter *iter)
+{
+	if (!cds_lfht_filter_may_contain(filter, hash)) {
+		iter->node = iter->next = NULL;
+		return;
+	}
+	cds_lfht_lookup(filter->ht, hash, match, key, iter);
+}
+
+void cds_lfht_filter_add(struct cds_lfht_filter *filter, unsigned long hash,
+		struct cds_lfht_node *node)
+{
+	filter_set(filter, hash);
+	cds_lfht_add(filter->ht, hash, node);
+	uatomic_inc(&filter->nr_items);
+	filter_maybe_build(filter);
+}
+
+struct cds_lfht_node *cds_lfht_filter_add_unique(
+		struct cds_lfht_filter *filter, unsigned long hash,
+		cds_lfht_match_fct match, const void *key,
+		struct cds_lfht_node *node)
+{
+	struct cds_lfht_node *ret;
+
+	filter_set(filter, hash);
+	ret = cds_lfht_add_unique(filter->ht, hash, match, key, node);
+	if (ret == node) {
+		uatomic_inc(&filter->nr_items);
+		filter_maybe_build(filter);
+	}
+	return ret;
+}
+
+int cds_lfht_filter_del(struct cds_lfht_filter *filter,
+		struct cds_lfht_node *node)
+{
+	int ret;
+
+	ret = cds_lfht_del(filter->ht, node);
+	if (ret)
+		return ret;
+	uatomic_dec(&filter->nr_items);
+	uatomic_inc(&filter->nr_dels);
+	filter_maybe_build(filter);
+	return 0;
+}
+
+unsigned long cds_lfht_filter_capacity(struct cds_lfht_filter *filter)
+{
+	return rcu_dereference(filter->current)->capacity;
+}
@@ -0,0 +1,377 @@
+/*
+ * rculfhash-intern.c
+ *
+ * Userspace RCU library - String interning on top of cds_lfht
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301
+ * USA
+ */
+
+/*
+ * A string holds a reference on its arena from its carving until it is
+ * reclaimed, and the current arena holds one more, dropped by the
+ * thread replacing it. Strings are carved within a read-side critical
+ * section, and arenas are freed a grace period after their last
+ * reference is dropped, so that a thread which read the current arena
+ * pointer can still try to take a reference on it.
+ */
+
+#define _LGPL_SOURCE
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <errno.h>
+
+#include <urcu/compiler.h>
+#include <urcu/arch.h>
+#include <urcu/uatomic.h>
+#include <urcu/ref.h>
+#include <urcu/call-rcu.h>
+#include <urcu/flavor.h>
+#include <urcu/hash.h>
+#include <urcu/rculfhash.h>
+#include <urcu/rculfhash-intern.h>
+#include <urcu/static/pointer.h>
+
+#define INTERN_ALIGN		8
+#define INTERN_HASH_SEED	0x9e3779b97f4a7c15ULL
+
+struct cds_lfht_intern_arena {
+	struct cds_lfht_intern *intern;
+	struct urcu_ref ref;
+	struct rcu_head head;
+	size_t len;
+	unsigned long offset;		/* Carved bytes, by cmpxchg. */
+	char data[] __attribute__((aligned(INTERN_ALIGN)));
+};
+
+struct cds_lfht_intern {
+	struct cds_lfht *ht;
+	const struct rcu_flavor_struct *flavor;
+	struct cds_lfht_intern_arena *current;	/* RCU */
+	unsigned long nr_strings;
+	unsigned long nr_arenas;
+	unsigned long arena_bytes;
+};
+
+struct intern_key {
+	const char *str;
+	size_t len;
+};
+
+static
+struct cds_lfht_intern_arena *arena_new(struct cds_lfht_intern *intern,
+		size_t len)
+{
+	struct cds_lfht_intern_arena *arena;
+
+	arena = malloc(sizeof(*arena) + len);
+	if (!arena)
+		return NULL;
+	arena->intern = intern;
+	urcu_ref_init(&arena->ref);
+	arena->len = len;
+	arena->offset = 0;
+	uatomic_inc(&intern->nr_arenas);
+	uatomic_add(&intern->arena_bytes, sizeof(*arena) + len);
+	return arena;
+}
+
+static
+void arena_free(struct cds_lfht_intern_arena *arena)
+{
+	struct cds_lfht_intern *intern = arena->intern;
+
+	uatomic_dec(&intern->nr_arenas);
+	uatomic_sub(&intern->arena_bytes, sizeof(*arena) + arena->len);
+	free(arena);
+}
+
+static
+void arena_free_rcu(struct rcu_head *head)
+{
+	arena_free(caa_container_of(head, struct cds_lfht_intern_arena,
+			head));
+}
+
+static
+void arena_release(struct urcu_ref *ref)
+{
+	struct cds_lfht_intern_arena *arena =
+		caa_container_of(ref, struct cds_lfht_intern_arena, ref);
+
+	arena->intern->flavor->update_call_rcu(&arena->head, arena_free_rcu);
+}
+
+static
+void arena_put(struct cds_lfht_intern_arena *arena)
+{
+	urcu_ref_put(&arena->ref, arena_release);
+}
+
+/* Carve size bytes from an arena of which a reference is held. */
+static
+void *arena_carve(struct cds_lfht_intern_arena *arena, size_t size)
+{
+	unsigned long offset, old;
+
+	offset = uatomic_read(&arena->offset);
+	while (offset + size <= arena->len) {
+		old = uatomic_cmpxchg(&arena->offset, offset, offset + size);
+		if (old == offset)
+			return arena->data + offset;
+		offset = old;
+	}
+	return NULL;
+}
+
+/*
+ * Allocate a string, with a reference on its arena. Call within a
+ * read-side critical section.
+ */
+static
+struct cds_lfht_intern_str *str_alloc(struct cds_lfht_intern *intern,
+		size_t len)
+{
+	struct cds_lfht_intern_arena *arena, *new_arena;
+	struct cds_lfht_intern_str *s;
+	size_t size;
+
+	size = (sizeof(*s) + len + 1 + INTERN_ALIGN - 1)
+		& ~(size_t) (INTERN_ALIGN - 1);
+	if (size > CDS_LFHT_INTERN_ARENA_LEN / 4) {
+		arena = arena_new(intern, size);
+		if (!arena)
+			return NULL;
+		s = arena_carve(arena, size);
+		s->arena = arena;
+		return s;
+	}
+	for (;;) {
+		arena = rcu_dereference(intern->current);
+		if (urcu_ref_get_unless_zero(&arena->ref)) {
+			s = arena_carve(arena, size);
+			if (s) {
+				s->arena = arena;
+				return s;
+			}
+			arena_put(arena);
+		}
+		/* Full, or already replaced: replace it. */
+		new_arena = arena_new(intern, CDS_LFHT_INTERN_ARENA_LEN);
+		if (!new_arena)
+			return NULL;
+		if (rcu_cmpxchg_pointer(&intern->current, arena, new_arena)
+				== arena)
+			arena_put(arena);
+		else
+			arena_free(new_arena);	/* Never visible. */
+	}
+}
+
+static
+void str_free_rcu(struct rcu_head *head)
+{
+	struct cds_lfht_intern_str *s =
+		caa_container_of(head, struct cds_lfht_intern_str, head);
+
+	arena_put(s->arena);
+}
+
+/* Delete a string from the table, by its releaser or by a helper. */
+static
+void str_del(struct cds_lfht_intern *intern, struct cds_lfht_intern_str *s)
+{
+	if (!cds_lfht_del(intern->ht, &s->tnode.node))
+		uatomic_dec(&intern->nr_strings);
+}
+
+static
+void str_release(struct urcu_ref *ref)
+{
+	struct cds_lfht_intern_str *s =
+		caa_container_of(ref, struct cds_lfht_intern_str, ref);
+	struct cds_lfht_intern *intern = s->arena->intern;
+
+	intern->flavor->read_lock();
+	str_del(intern, s);
+	intern->flavor->read_unlock();
+	intern->flavor->update_call_rcu(&s->head, str_free_rcu);
+}
+
+static
+int intern_match(struct cds_lfht_node *node, const void *key)
+{
+	struct cds_lfht_intern_str *s = caa_container_of(node,
+			struct cds_lfht_intern_str, tnode.node);
+	const struct intern_key *k = key;
+
+	return s->len == k->len && !memcmp(s->str, k->str, k->len);
+}
+
+static
+void intern_hash(const struct intern_key *key, unsigned long *hash,
+		unsigned long *tag)
+{
+	uint64_t h = urcu_hash_bytes(key->str, key->len, INTERN_HASH_SEED);
+
+	*hash = (unsigned long) h;
+	*tag = (unsigned long) urcu_hash_u64(h, key->len);
+}
+
+/*
+ * Get a reference on the node of a string, if present. A string whose
+ * last reference is being released is deleted, as its releaser would,
+ * so that a new copy can be added. Call within a read-side critical
+ * section.
+ */
+static
+struct cds_lfht_intern_str *intern_lookup(struct cds_lfht_intern *intern,
+		const struct intern_key *key, unsigned long hash,
+		unsigned long tag)
+{
+	struct cds_lfht_intern_str *s;
+	struct cds_lfht_iter iter;
+	struct cds_lfht_node *node;
+
+	for (;;) {
+		cds_lfht_lookup_tag(intern->ht, hash, tag, intern_match, key,
+				&iter);
+		node = cds_lfht_iter_get_node(&iter);
+		if (!node)
+			return NULL;
+		s = caa_container_of(node, struct cds_lfht_intern_str,
+				tnode.node);
+		if (urcu_ref_get_unless_zero(&s->ref))
+			return s;
+		str_del(intern, s);
+	}
+}
+
+struct cds_lfht_intern *cds_lfht_intern_create_flavor(unsigned long init_size,
+		const struct rcu_flavor_struct *flavor)
+{
+	struct cds_lfht_intern *intern;
+
+	intern = calloc(1, sizeof(*intern));
+	if (!intern)
+		return NULL;
+	intern->flavor = flavor;
+	intern->current = arena_new(intern, CDS_LFHT_INTERN_ARENA_LEN);
+	if (!intern->current)
+		goto error;
+	intern->ht = cds_lfht_new_flavor(init_size, 1, 0,
+			CDS_LFHT_AUTO_RESIZE | CDS_LFHT_ACCOUNTING
+			| CDS_LFHT_NODE_TAG, flavor, NULL);
+	if (!intern->ht)
+		goto error;
+	return intern;
+
+error:
+	if (intern->current)
+		arena_free(intern->current);
+	free(intern);
+	return NULL;
+}
+
+int cds_lfht_intern_destroy(struct cds_lfht_intern *intern)
+{
+	int ret;
+
+	if (uatomic_read(&intern->nr_strings))
+		return -EBUSY;
+	/* Reclaim the strings, then the arenas they release. */
+	intern->flavor->barrier();
+	arena_put(intern->current);
+	intern->flavor->barrier();
+	ret = cds_lfht_destroy(intern->ht, NULL);
+	if (ret)
+		return ret;
+	free(intern);
+	return 0;
+}
+
+struct cds_lfht_intern_str *cds_lfht_intern(struct cds_lfht_intern *intern,
+		const char *str, size_t len)
+{
+	struct intern_key key = { .str = str, .len = len };
+	struct cds_lfht_intern_str *s, *new_s = NULL;
+	struct cds_lfht_node *node;
+	unsigned long hash, tag;
+
+	intern_hash(&key, &hash, &tag);
+	intern->flavor->read_lock();
+	for (;;) {
+		s = intern_lookup(intern, &key, hash, tag);
+		if (s)
+			break;
+		if (!new_s) {
+			new_s = str_alloc(intern, len);
+			if (!new_s)
+				break;
+			cds_lfht_node_init(&new_s->tnode.node);
+			new_s->tnode.tag = tag;
+			urcu_ref_init(&new_s->ref);
+			new_s->len = len;
+			memcpy(new_s->str, str, len);
+			new_s->str[len] = '\0';
+		}
+		node = cds_lfht_add_unique(intern->ht, hash, intern_match,
+				&key, &new_s->tnode.node);
+		if (node == &new_s->tnode.node) {
+			uatomic_inc(&intern->nr_strings);
+			s = new_s;
+			new_s = NULL;
+			break;
+		}
+		s = caa_container_of(node, struct cds_lfht_intern_str,
+				tnode.node);
+		if (urcu_ref_get_unless_zero(&s->ref))
+			break;
+		str_del(intern, s);
+	}
+	intern->flavor->read_unlock();
+	/* Lost a race with the addition of the string. */
+	if (new_s)
+		arena_put(new_s->arena);
+	return s;
+}
+
+struct cds_lfht_intern_str *cds_lfht_intern_find(
+		struct cds_lfht_intern *intern, const char *str, size_t len)
+{
+	struct intern_key key = { .str = str, .len = len };
+	struct cds_lfht_intern_str *s;
+	unsigned long hash, tag;
+
+	intern_hash(&key, &hash, &tag);
+	intern->flavor->read_lock();
+	s = intern_lookup(intern, &key, hash, tag);
+	intern->flavor->read_unlock();
+	return s;
+}
+
+void cds_lfht_intern_put(struct cds_lfht_intern_str *s)
+{
+	urcu_ref_put(&s->ref, str_release);
+}
+
+void cds_lfht_intern_get_stats(struct cds_lfht_intern *intern,
+		struct cds_lfht_intern_stats *stats)
+{
+	stats->nr_strings = uatomic_read(&intern->nr_strings);
+	stats->nr_arenas = uatomic_read(&intern->nr_arenas);
+	stats->arena_bytes = uatomic_read(&intern->arena_bytes);
+}
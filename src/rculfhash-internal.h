@@ -25,9 +25,13 @@
  */
 
 #include <urcu/rculfhash.h>
+#include <urcu/static/rculfhash.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <assert.h>
+#include <stdint.h>
+
+#include "urcu-stats.h"
 
 #ifdef DEBUG
 #define dbg_printf(fmt, args...)     printf("[debug rculfhash] " fmt, ## args)
@@ -40,14 +44,22 @@ do {								\
 } while (0)
 #endif
 
-#if (CAA_BITS_PER_LONG == 32)
-#define MAX_TABLE_ORDER			32
-#else
-#define MAX_TABLE_ORDER			64
-#endif
-
+#define MAX_TABLE_ORDER			CDS_LFHT_MAX_TABLE_ORDER
 #define MAX_CHUNK_TABLE			(1UL << 10)
 
+#if (CAA_BITS_PER_LONG > 32)
+/*
+ * Largest table of the mmap plugins, 16 TiB of address space with
+ * struct cds_lfht_node buckets, and maximum size of their unbounded
+ * tables, 1 TiB. Tables above MMAP_RESERVE_MIN_NR_BUCKETS get the
+ * address space available, halving their maximum size until it can be
+ * reserved.
+ */
+#define MMAP_MAX_NR_BUCKETS		(1UL << 40)
+#define MMAP_UNBOUNDED_NR_BUCKETS	(1UL << 36)
+#define MMAP_RESERVE_MIN_NR_BUCKETS	(1UL << 32)
+#endif
+
 #ifndef min
 #define min(a, b)	((a) < (b) ? (a) : (b))
 #endif
@@ -56,95 +68,6 @@ do {								\
 #define max(a, b)	((a) > (b) ? (a) : (b))
 #endif
 
-struct ht_items_count;
-
-/*
- * cds_lfht: Top-level data structure representing a lock-free hash
- * table. Defined in the implementation file to make it be an opaque
- * cookie to users.
- *
- * The fields used in fast-paths are placed near the end of the
- * structure, because we need to have a variable-sized union to contain
- * the mm plugin fields, which are used in the fast path.
- */
-struct cds_lfht {
-	/* Initial configuration items */
-	unsigned long max_nr_buckets;
-	const struct cds_lfht_mm_type *mm;	/* memory management plugin */
-	const struct rcu_flavor_struct *flavor;	/* RCU flavor */
-
-	long count;			/* global approximate item count */
-
-	/*
-	 * We need to put the work threads offline (QSBR) when taking this
-	 * mutex, because we use synchronize_rcu within this mutex critical
-	 * section, which waits on read-side critical sections, and could
-	 * therefore cause grace-period deadlock if we hold off RCU G.P.
-	 * completion.
-	 */
-	pthread_mutex_t resize_mutex;	/* resize mutex: add/del mutex */
-	pthread_attr_t *resize_attr;	/* Resize threads attributes */
-	unsigned int in_progress_destroy;
-	unsigned long resize_target;
-	int resize_initiated;
-
-	/*
-	 * Variables needed for add and remove fast-paths.
-	 */
-	int flags;
-	unsigned long min_alloc_buckets_order;
-	unsigned long min_nr_alloc_buckets;
-	struct ht_items_count *split_count;	/* split item count */
-
-	/*
-	 * Variables needed for the lookup, add and remove fast-paths.
-	 */
-	unsigned long size;	/* always a power of 2, shared (RCU) */
-	/*
-	 * bucket_at pointer is kept here to skip the extra level of
-	 * dereference needed to get to "mm" (this is a fast-path).
-	 */
-	struct cds_lfht_node *(*bucket_at)(struct cds_lfht *ht,
-			unsigned long index);
-	/*
-	 * Dynamic length "tbl_chunk" needs to be at the end of
-	 * cds_lfht.
-	 */
-	union {
-		/*
-		 * Contains the per order-index-level bucket node table.
-		 * The size of each bucket node table is half the number
-		 * of hashes contained in this order (except for order 0).
-		 * The minimum allocation buckets size parameter allows
-		 * combining the bucket node arrays of the lowermost
-		 * levels to improve cache locality for small index orders.
-		 */
-		struct cds_lfht_node *tbl_order[MAX_TABLE_ORDER];
-
-		/*
-		 * Contains the bucket node chunks. The size of each
-		 * bucket node chunk is ->min_alloc_size (we avoid to
-		 * allocate chunks with different size). Chunks improve
-		 * cache locality for small index orders, and are more
-		 * friendly with environments where allocation of large
-		 * contiguous memory areas is challenging due to memory
-		 * fragmentation concerns or inability to use virtual
-		 * memory addressing.
-		 */
-		struct cds_lfht_node *tbl_chunk[0];
-
-		/*
-		 * Memory mapping with room for all possible buckets.
-		 * Their memory is allocated when needed.
-		 */
-		struct cds_lfht_node *tbl_mmap;
-	};
-	/*
-	 * End of variables needed for the lookup, add and remove
-	 * fast-paths.
-	 */
-};
-
 extern unsigned int cds_lfht_fls_ulong(unsigned long x);
 extern int cds_lfht_get_count_order_ulong(unsigned long x);
 
@@ -160,6 +83,45 @@ extern int cds_lfht_get_count_order_ulong(unsigned long x);
 #define poison_free(ptr)	free(ptr)
 #endif
 
+/*
+ * Account delta bytes of bucket table to the table, for
+ * cds_lfht_get_mem_stats(): the mm plugins account the memory they
+ * allocate or populate, and later free or release by madvise.
+ */
+static inline
+void cds_lfht_mm_account(struct cds_lfht *ht, long delta)
+{
+	CMM_STORE_SHARED(ht->bucket_bytes, ht->bucket_bytes + delta);
+}
+
+/*
+ * Called when the bucket table shrinks to size_order, freeing order
+ * size_order + 1: return the highest order which stays populated,
+ * releasing the highest orders first. The caller releases the orders
+ * above it, up to populated_order.
+ */
+static inline
+unsigned long cds_lfht_mm_retained_order(struct cds_lfht *ht,
+		unsigned long size_order, size_t bucket_size)
+{
+	struct cds_lfht_mm_retention *retention = &ht->mm_retention;
+	unsigned long order = retention->populated_order;
+	uint64_t now_ns = urcu_stats_now_ns();
+
+	size_order = max(size_order, ht->min_alloc_buckets_order);
+	if (!retention->max_len)
+		return size_order;
+	/* Release what the previous shrink retained for too long. */
+	if (retention->max_ms && now_ns - retention->shrink_ns
+			>= (uint64_t) retention->max_ms * 1000000)
+		order = min(order, size_order + 1);
+	retention->shrink_ns = now_ns;
+	while (order > size_order && ((1UL << order) - (1UL << size_order))
+			* bucket_size > retention->max_len)
+		order--;
+	return order;
+}
+
 static inline
 struct cds_lfht *__default_alloc_cds_lfht(
 		const struct cds_lfht_mm_type *mm,
@@ -172,6 +134,7 @@ struct cds_lfht *__default_alloc_cds_lfht(
 	ht = calloc(1, cds_lfht_size);
 	assert(ht);
 
+	ht->alloc_len = cds_lfht_size;
 	ht->mm = mm;
 	ht->bucket_at = mm->bucket_at;
 	ht->min_nr_alloc_buckets = min_nr_alloc_buckets;
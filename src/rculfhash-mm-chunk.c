@@ -26,37 +26,73 @@
 static
 void cds_lfht_alloc_bucket_table(struct cds_lfht *ht, unsigned long order)
 {
+	struct cds_lfht_mm_retention *retention = &ht->mm_retention;
+
 	if (order == 0) {
 		ht->tbl_chunk[0] = calloc(ht->min_nr_alloc_buckets,
 			sizeof(struct cds_lfht_node));
 		assert(ht->tbl_chunk[0]);
+		cds_lfht_mm_account(ht, ht->min_nr_alloc_buckets
+				* sizeof(struct cds_lfht_node));
+		retention->populated_order = ht->min_alloc_buckets_order;
 	} else if (order > ht->min_alloc_buckets_order) {
 		unsigned long i, len = 1UL << (order - 1 - ht->min_alloc_buckets_order);
 
+		/* Reuse the chunks retained since a shrink. */
 		for (i = len; i < 2 * len; i++) {
+			if (ht->tbl_chunk[i])
+				continue;
 			ht->tbl_chunk[i] = calloc(ht->min_nr_alloc_buckets,
 				sizeof(struct cds_lfht_node));
 			assert(ht->tbl_chunk[i]);
+			cds_lfht_mm_account(ht, ht->min_nr_alloc_buckets
+					* sizeof(struct cds_lfht_node));
 		}
+		retention->populated_order = max(retention->populated_order,
+				order);
 	}
 	/* Nothing to do for 0 < order && order <= ht->min_alloc_buckets_order */
 }
 
+static
+void free_chunks(struct cds_lfht *ht, unsigned long order)
+{
+	unsigned long i, len = 1UL << (order - 1 - ht->min_alloc_buckets_order);
+
+	for (i = len; i < 2 * len; i++) {
+		if (ht->tbl_chunk[i])
+			cds_lfht_mm_account(ht, -(long) (ht->min_nr_alloc_buckets
+					* sizeof(struct cds_lfht_node)));
+		poison_free(ht->tbl_chunk[i]);
+		ht->tbl_chunk[i] = NULL;
+	}
+}
+
 /*
  * cds_lfht_free_bucket_table() should be called with decreasing order.
  * When cds_lfht_free_bucket_table(0) is called, it means the whole
  * lfht is destroyed.
+ *
+ * With memory retention, the chunks freed are kept for reuse, within
+ * the retention limits.
  */
 static
 void cds_lfht_free_bucket_table(struct cds_lfht *ht, unsigned long order)
 {
-	if (order == 0)
-		poison_free(ht->tbl_chunk[0]);
-	else if (order > ht->min_alloc_buckets_order) {
-		unsigned long i, len = 1UL << (order - 1 - ht->min_alloc_buckets_order);
+	struct cds_lfht_mm_retention *retention = &ht->mm_retention;
+	unsigned long i, keep;
 
-		for (i = len; i < 2 * len; i++)
-			poison_free(ht->tbl_chunk[i]);
+	if (order == 0) {
+		for (i = retention->populated_order;
+				i > ht->min_alloc_buckets_order; i--)
+			free_chunks(ht, i);
+		poison_free(ht->tbl_chunk[0]);
+	} else if (order > ht->min_alloc_buckets_order) {
+		keep = cds_lfht_mm_retained_order(ht, order - 1,
+				sizeof(struct cds_lfht_node));
+		for (i = retention->populated_order; i > keep; i--)
+			free_chunks(ht, i);
+		retention->populated_order = keep;
 	}
 	/* Nothing to do for 0 < order && order <= ht->min_alloc_buckets_order */
 }
@@ -0,0 +1,320 @@
+/*
+ * rculfhash-mm-hugepage.c
+ *
+ * Huge page backed memory management for Lock-Free RCU Hash Table
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+#include <unistd.h>
+#include <stdio.h>
+#include <errno.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include "rculfhash-internal.h"
+#include "urcu-hugepage.h"
+
+#ifndef MAP_ANONYMOUS
+#define MAP_ANONYMOUS		MAP_ANON
+#endif
+
+/*
+ * Like the mmap plugin, the bucket table of large tables is a single
+ * reservation of max_nr_buckets nodes, populated as the table grows, so
+ * bucket_at() is a plain array access. The reservation is aligned on the
+ * huge page size, and backed by:
+ *
+ * - explicit huge pages (MAP_HUGETLB) when the huge page pool can
+ *   reserve the whole table. Populating and discarding are then done
+ *   with mprotect(), and pages are only freed with the table.
+ * - otherwise, regular pages populated as in the mmap plugin, and advised
+ *   with MADV_HUGEPAGE so transparent huge pages back the table once it
+ *   spans whole huge pages.
+ *
+ * cds_lfht_mm_hugepage keeps the NUMA policy of the process (e.g. set by
+ * numactl --membind to bind the table to some nodes).
+ * cds_lfht_mm_hugepage_interleave interleaves the pages of the table
+ * over all nodes allowed to the process, so lookups from all nodes share
+ * the memory bandwidth instead of hitting the node which happened to
+ * first touch the table.
+ *
+ * On systems without huge page or NUMA support, these behave as the mmap
+ * plugin.
+ */
+
+/* From <linux/mempolicy.h>, not available in all libc headers. */
+#define HUGEPAGE_MPOL_INTERLEAVE	3
+#define HUGEPAGE_MPOL_MAX_NODES		1024
+
+#if defined(__linux__) && defined(MAP_HUGETLB)
+#define HUGEPAGE_HAVE_HUGETLB
+#endif
+
+#if defined(__linux__) && defined(SYS_mbind)
+#define HUGEPAGE_HAVE_MBIND
+#endif
+
+/*
+ * Huge page reservations are told apart by setting the low-order bit of
+ * ht->hugepage_len, the reservation length, which is otherwise a
+ * multiple of the huge page size.
+ */
+#define HUGETLB_FLAG		1UL
+
+static
+size_t table_len(struct cds_lfht *ht)
+{
+	size_t len = ht->max_nr_buckets * sizeof(*ht->tbl_hugepage);
+	size_t hpage = urcu_hugepage_size();
+
+	return (len + hpage - 1) & ~(hpage - 1);
+}
+
+static
+void memory_interleave(struct cds_lfht *ht, void *ptr, size_t length)
+{
+#ifdef HUGEPAGE_HAVE_MBIND
+	unsigned long nodemask[HUGEPAGE_MPOL_MAX_NODES / CAA_BITS_PER_LONG];
+	unsigned int i;
+
+	if (ht->mm != &cds_lfht_mm_hugepage_interleave)
+		return;
+	/*
+	 * The kernel restricts the mask to the nodes allowed to the
+	 * process. Failure only loses the placement optimization.
+	 */
+	for (i = 0; i < CAA_ARRAY_SIZE(nodemask); i++)
+		nodemask[i] = ~0UL;
+	(void) syscall(SYS_mbind, ptr, length, HUGEPAGE_MPOL_INTERLEAVE,
+			nodemask, HUGEPAGE_MPOL_MAX_NODES, 0);
+#endif
+}
+
+/*
+ * Reserve inaccessible memory space aligned on the huge page size,
+ * without allocating it. Returns whether it is backed by huge pages.
+ */
+static
+int memory_map(struct cds_lfht *ht, size_t length)
+{
+	size_t hpage = urcu_hugepage_size();
+	char *ptr, *aligned;
+
+#ifdef HUGEPAGE_HAVE_HUGETLB
+	ptr = mmap(NULL, length, PROT_NONE,
+		MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+	if (ptr != MAP_FAILED) {
+		ht->tbl_hugepage = (struct cds_lfht_node *) ptr;
+		return 1;
+	}
+#endif
+	ptr = mmap(NULL, length + hpage, PROT_NONE,
+		MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+	if (ptr == MAP_FAILED) {
+		perror("mmap");
+		abort();
+	}
+	aligned = (char *) (((uintptr_t) ptr + hpage - 1) & ~(hpage - 1));
+	if (aligned != ptr && munmap(ptr, aligned - ptr)) {
+		perror("munmap");
+		abort();
+	}
+	if (munmap(aligned + length, ptr + hpage - aligned)) {
+		perror("munmap");
+		abort();
+	}
+	ht->tbl_hugepage = (struct cds_lfht_node *) aligned;
+	return 0;
+}
+
+static
+void memory_unmap(void *ptr, size_t length)
+{
+	if (munmap(ptr, length)) {
+		perror("munmap");
+		abort();
+	}
+}
+
+static
+void memory_populate(struct cds_lfht *ht, int hugetlb, void *ptr,
+		size_t length)
+{
+	if (hugetlb) {
+		if (mprotect(ptr, length, PROT_READ | PROT_WRITE)) {
+			perror("mprotect");
+			abort();
+		}
+		return;
+	}
+	if (mmap(ptr, length, PROT_READ | PROT_WRITE,
+			MAP_FIXED | MAP_PRIVATE | MAP_ANONYMOUS,
+			-1, 0) != ptr) {
+		perror("mmap");
+		abort();
+	}
+	memory_interleave(ht, ptr, length);
+#ifdef MADV_HUGEPAGE
+	/* Transparent huge pages may be disabled: ignore errors. */
+	(void) madvise(ptr, length, MADV_HUGEPAGE);
+#endif
+}
+
+/*
+ * Discard garbage memory and avoid system save it when try to swap it out.
+ * Make it still reserved, inaccessible.
+ */
+static
+void memory_discard(int hugetlb, void *ptr, size_t length)
+{
+	if (hugetlb) {
+		if (mprotect(ptr, length, PROT_NONE)) {
+			perror("mprotect");
+			abort();
+		}
+		return;
+	}
+	if (mmap(ptr, length, PROT_NONE,
+			MAP_FIXED | MAP_PRIVATE | MAP_ANONYMOUS,
+			-1, 0) != ptr) {
+		perror("mmap");
+		abort();
+	}
+}
+
+static
+void cds_lfht_alloc_bucket_table(struct cds_lfht *ht, unsigned long order)
+{
+	int hugetlb;
+
+	if (order == 0) {
+		if (ht->min_nr_alloc_buckets == ht->max_nr_buckets) {
+			/* small table */
+			ht->tbl_hugepage = calloc(ht->max_nr_buckets,
+					sizeof(*ht->tbl_hugepage));
+			assert(ht->tbl_hugepage);
+			cds_lfht_mm_account(ht, ht->max_nr_buckets
+					* sizeof(*ht->tbl_hugepage));
+			return;
+		}
+		/* large table */
+		hugetlb = memory_map(ht, table_len(ht));
+		if (hugetlb)
+			memory_interleave(ht, ht->tbl_hugepage, table_len(ht));
+		ht->hugepage_len = table_len(ht) | (hugetlb ? HUGETLB_FLAG : 0);
+		memory_populate(ht, hugetlb, ht->tbl_hugepage,
+			ht->min_nr_alloc_buckets * sizeof(*ht->tbl_hugepage));
+		cds_lfht_mm_account(ht, ht->min_nr_alloc_buckets
+				* sizeof(*ht->tbl_hugepage));
+	} else if (order > ht->min_alloc_buckets_order) {
+		/* large table */
+		unsigned long len = 1UL << (order - 1);
+
+		assert(ht->min_nr_alloc_buckets < ht->max_nr_buckets);
+		hugetlb = ht->hugepage_len & HUGETLB_FLAG;
+		memory_populate(ht, hugetlb, ht->tbl_hugepage + len,
+				len * sizeof(*ht->tbl_hugepage));
+		cds_lfht_mm_account(ht, len * sizeof(*ht->tbl_hugepage));
+	}
+	/* Nothing to do for 0 < order && order <= ht->min_alloc_buckets_order */
+}
+
+/*
+ * cds_lfht_free_bucket_table() should be called with decreasing order.
+ * When cds_lfht_free_bucket_table(0) is called, it means the whole
+ * lfht is destroyed.
+ */
+static
+void cds_lfht_free_bucket_table(struct cds_lfht *ht, unsigned long order)
+{
+	if (order == 0) {
+		if (ht->min_nr_alloc_buckets == ht->max_nr_buckets) {
+			/* small table */
+			poison_free(ht->tbl_hugepage);
+			return;
+		}
+		/* large table */
+		memory_unmap(ht->tbl_hugepage, ht->hugepage_len & ~HUGETLB_FLAG);
+	} else if (order > ht->min_alloc_buckets_order) {
+		/* large table */
+		unsigned long len = 1UL << (order - 1);
+
+		assert(ht->min_nr_alloc_buckets < ht->max_nr_buckets);
+		memory_discard(ht->hugepage_len & HUGETLB_FLAG,
+			ht->tbl_hugepage + len, len * sizeof(*ht->tbl_hugepage));
+		cds_lfht_mm_account(ht, -(long) (len * sizeof(*ht->tbl_hugepage)));
+	}
+	/* Nothing to do for 0 < order && order <= ht->min_alloc_buckets_order */
+}
+
+static
+struct cds_lfht_node *bucket_at(struct cds_lfht *ht, unsigned long index)
+{
+	return &ht->tbl_hugepage[index];
+}
+
+static
+struct cds_lfht *alloc_cds_lfht(const struct cds_lfht_mm_type *mm,
+		unsigned long min_nr_alloc_buckets,
+		unsigned long max_nr_buckets)
+{
+	unsigned long page_bucket_size;
+
+	page_bucket_size = getpagesize() / sizeof(struct cds_lfht_node);
+	if (max_nr_buckets <= page_bucket_size) {
+		/* small table */
+		min_nr_alloc_buckets = max_nr_buckets;
+	} else {
+		/* large table */
+		min_nr_alloc_buckets = max(min_nr_alloc_buckets,
+					page_bucket_size);
+	}
+
+	return __default_alloc_cds_lfht(
+			mm, sizeof(struct cds_lfht),
+			min_nr_alloc_buckets, max_nr_buckets);
+}
+
+static
+struct cds_lfht *alloc_cds_lfht_local(unsigned long min_nr_alloc_buckets,
+		unsigned long max_nr_buckets)
+{
+	return alloc_cds_lfht(&cds_lfht_mm_hugepage, min_nr_alloc_buckets,
+			max_nr_buckets);
+}
+
+static
+struct cds_lfht *alloc_cds_lfht_interleave(unsigned long min_nr_alloc_buckets,
+		unsigned long max_nr_buckets)
+{
+	return alloc_cds_lfht(&cds_lfht_mm_hugepage_interleave,
+			min_nr_alloc_buckets, max_nr_buckets);
+}
+
+const struct cds_lfht_mm_type cds_lfht_mm_hugepage = {
+	.alloc_cds_lfht = alloc_cds_lfht_local,
+	.alloc_bucket_table = cds_lfht_alloc_bucket_table,
+	.free_bucket_table = cds_lfht_free_bucket_table,
+	.bucket_at = bucket_at,
+};
+
+const struct cds_lfht_mm_type cds_lfht_mm_hugepage_interleave = {
+	.alloc_cds_lfht = alloc_cds_lfht_interleave,
+	.alloc_bucket_table = cds_lfht_alloc_bucket_table,
+	.free_bucket_table = cds_lfht_free_bucket_table,
+	.bucket_at = bucket_at,
+};
@@ -31,6 +31,20 @@
 #define MAP_ANONYMOUS		MAP_ANON
 #endif
 
+/* Reserve address space without accounting it against overcommit. */
+#ifdef MAP_NORESERVE
+#define MMAP_NORESERVE_FLAGS	MAP_NORESERVE
+#else
+#define MMAP_NORESERVE_FLAGS	0
+#endif
+
+/* Fault the pages of populated chunks in at once where supported. */
+#ifdef MAP_POPULATE
+#define MMAP_POPULATE_FLAGS	MAP_POPULATE
+#else
+#define MMAP_POPULATE_FLAGS	0
+#endif
+
 /*
  * The allocation scheme used by the mmap based RCU hash table is to make a
  * large unaccessible mapping to reserve memory without allocating it.
@@ -52,17 +66,20 @@
  */
 
 
-/* Reserve inaccessible memory space without allocating it */
+/*
+ * Reserve inaccessible memory space without allocating it. Return NULL
+ * if the address space is not available.
+ */
 static
 void *memory_map(size_t length)
 {
 	void *ret;
 
-	ret = mmap(NULL, length, PROT_NONE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
-	if (ret == MAP_FAILED) {
-		perror("mmap");
-		abort();
-	}
+	ret = mmap(NULL, length, PROT_NONE,
+			MAP_PRIVATE | MAP_ANONYMOUS | MMAP_NORESERVE_FLAGS,
+			-1, 0);
+	if (ret == MAP_FAILED)
+		return NULL;
 	return ret;
 }
 
@@ -102,7 +119,8 @@ static
 void memory_populate(void *ptr, size_t length)
 {
 	if (mmap(ptr, length, PROT_READ | PROT_WRITE,
-			MAP_FIXED | MAP_PRIVATE | MAP_ANONYMOUS,
+			MAP_FIXED | MAP_PRIVATE | MAP_ANONYMOUS
+			| MMAP_POPULATE_FLAGS,
 			-1, 0) != ptr) {
 		perror("mmap");
 		abort();
@@ -125,73 +143,167 @@ void memory_discard(void *ptr, size_t length)
 }
 #endif /* __CYGWIN__ */
 
+/*
+ * Let the system reclaim the pages of a chunk which stays mapped: they
+ * are either left as is, or zero-filled on next access.
+ */
+static
+void memory_advise_free(void *ptr, size_t length)
+{
+#ifdef MADV_FREE
+	if (!madvise(ptr, length, MADV_FREE))
+		return;
+#endif
+#ifdef MADV_DONTNEED
+	(void) madvise(ptr, length, MADV_DONTNEED);
+#endif
+}
+
+/* Fault in the pages of a mapped chunk, if supported. */
 static
-void cds_lfht_alloc_bucket_table(struct cds_lfht *ht, unsigned long order)
+void memory_prefault(void *ptr, size_t length)
 {
+#ifdef MADV_POPULATE_WRITE
+	(void) madvise(ptr, length, MADV_POPULATE_WRITE);
+#endif
+}
+
+/*
+ * The bucket table is an array of bucket_size entries, struct
+ * cds_lfht_node for cds_lfht_mm_mmap and struct cds_lfht_compact_bucket
+ * for cds_lfht_mm_mmap_compact. Return the table, allocated for order 0.
+ */
+static
+void *mmap_alloc_bucket_table(struct cds_lfht *ht, char *tbl,
+		unsigned long order, size_t bucket_size)
+{
+	struct cds_lfht_mm_retention *retention = &ht->mm_retention;
+
 	if (order == 0) {
 		if (ht->min_nr_alloc_buckets == ht->max_nr_buckets) {
 			/* small table */
-			ht->tbl_mmap = calloc(ht->max_nr_buckets,
-					sizeof(*ht->tbl_mmap));
-			assert(ht->tbl_mmap);
-			return;
+			tbl = calloc(ht->max_nr_buckets, bucket_size);
+			assert(tbl);
+			cds_lfht_mm_account(ht, ht->max_nr_buckets * bucket_size);
+			return tbl;
 		}
-		/* large table */
-		ht->tbl_mmap = memory_map(ht->max_nr_buckets
-			* sizeof(*ht->tbl_mmap));
-		memory_populate(ht->tbl_mmap,
-			ht->min_nr_alloc_buckets * sizeof(*ht->tbl_mmap));
+		/* large table, reserved by mmap_alloc_cds_lfht() */
+		memory_populate(tbl, ht->min_nr_alloc_buckets * bucket_size);
+		cds_lfht_mm_account(ht, ht->min_nr_alloc_buckets * bucket_size);
+		retention->populated_order = ht->min_alloc_buckets_order;
+		retention->mapped_order = ht->min_alloc_buckets_order;
 	} else if (order > ht->min_alloc_buckets_order) {
 		/* large table */
 		unsigned long len = 1UL << (order - 1);
+		char *chunk = tbl + len * bucket_size;
 
 		assert(ht->min_nr_alloc_buckets < ht->max_nr_buckets);
-		memory_populate(ht->tbl_mmap + len,
-				len * sizeof(*ht->tbl_mmap));
+		/* Reuse the memory retained since a shrink. */
+		if (order > retention->mapped_order) {
+			memory_populate(chunk, len * bucket_size);
+			retention->mapped_order = order;
+		} else if (order > retention->populated_order) {
+			memory_prefault(chunk, len * bucket_size);
+		}
+		if (order > retention->populated_order)
+			cds_lfht_mm_account(ht, len * bucket_size);
+		retention->populated_order = max(retention->populated_order,
+				order);
 	}
 	/* Nothing to do for 0 < order && order <= ht->min_alloc_buckets_order */
+	return tbl;
 }
 
 /*
- * cds_lfht_free_bucket_table() should be called with decreasing order.
- * When cds_lfht_free_bucket_table(0) is called, it means the whole
+ * mmap_free_bucket_table() should be called with decreasing order.
+ * When mmap_free_bucket_table(0) is called, it means the whole
  * lfht is destroyed.
+ *
+ * With memory retention, the chunks freed stay mapped and populated,
+ * within the retention limits, and are then advised free. Otherwise,
+ * they are discarded along with any retained chunk.
  */
 static
-void cds_lfht_free_bucket_table(struct cds_lfht *ht, unsigned long order)
+void mmap_free_bucket_table(struct cds_lfht *ht, char *tbl,
+		unsigned long order, size_t bucket_size)
 {
+	struct cds_lfht_mm_retention *retention = &ht->mm_retention;
+
 	if (order == 0) {
 		if (ht->min_nr_alloc_buckets == ht->max_nr_buckets) {
 			/* small table */
-			poison_free(ht->tbl_mmap);
+			free(tbl);
 			return;
 		}
 		/* large table */
-		memory_unmap(ht->tbl_mmap,
-			ht->max_nr_buckets * sizeof(*ht->tbl_mmap));
+		memory_unmap(tbl, ht->max_nr_buckets * bucket_size);
 	} else if (order > ht->min_alloc_buckets_order) {
 		/* large table */
 		unsigned long len = 1UL << (order - 1);
+		unsigned long i, keep;
 
 		assert(ht->min_nr_alloc_buckets < ht->max_nr_buckets);
-		memory_discard(ht->tbl_mmap + len, len * sizeof(*ht->tbl_mmap));
+		if (!retention->max_len) {
+			if (retention->populated_order >= order)
+				cds_lfht_mm_account(ht, -(long) (((1UL
+					<< retention->populated_order) - len)
+						* bucket_size));
+			memory_discard(tbl + len * bucket_size,
+				((1UL << retention->mapped_order) - len)
+					* bucket_size);
+			retention->populated_order = order - 1;
+			retention->mapped_order = order - 1;
+			return;
+		}
+		keep = cds_lfht_mm_retained_order(ht, order - 1, bucket_size);
+		for (i = retention->populated_order; i > keep; i--) {
+			len = 1UL << (i - 1);
+			memory_advise_free(tbl + len * bucket_size,
+				len * bucket_size);
+			cds_lfht_mm_account(ht, -(long) (len * bucket_size));
+		}
+		retention->populated_order = keep;
 	}
 	/* Nothing to do for 0 < order && order <= ht->min_alloc_buckets_order */
 }
 
+/*
+ * Reserve the address space of a large table, only populated as the
+ * table grows. Tables above MMAP_RESERVE_MIN_NR_BUCKETS get their
+ * maximum size halved until the reservation succeeds. Return NULL if
+ * the address space is not available.
+ */
 static
-struct cds_lfht_node *bucket_at(struct cds_lfht *ht, unsigned long index)
+void *mmap_reserve_bucket_table(struct cds_lfht *ht, size_t bucket_size)
 {
-	return &ht->tbl_mmap[index];
+	void *tbl;
+
+	for (;;) {
+		tbl = memory_map(ht->max_nr_buckets * bucket_size);
+		if (tbl)
+			return tbl;
+#ifdef MMAP_RESERVE_MIN_NR_BUCKETS
+		if (ht->max_nr_buckets > MMAP_RESERVE_MIN_NR_BUCKETS
+				&& ht->max_nr_buckets / 2
+					> ht->min_nr_alloc_buckets) {
+			ht->max_nr_buckets >>= 1;
+			continue;
+		}
+#endif
+		return NULL;
+	}
 }
 
 static
-struct cds_lfht *alloc_cds_lfht(unsigned long min_nr_alloc_buckets,
-		unsigned long max_nr_buckets)
+struct cds_lfht *mmap_alloc_cds_lfht(const struct cds_lfht_mm_type *mm,
+		unsigned long min_nr_alloc_buckets,
+		unsigned long max_nr_buckets, size_t bucket_size)
 {
+	struct cds_lfht *ht;
 	unsigned long page_bucket_size;
+	void *tbl;
 
-	page_bucket_size = getpagesize() / sizeof(struct cds_lfht_node);
+	page_bucket_size = getpagesize() / bucket_size;
 	if (max_nr_buckets <= page_bucket_size) {
 		/* small table */
 		min_nr_alloc_buckets = max_nr_buckets;
@@ -201,9 +313,49 @@ struct cds_lfht *alloc_cds_lfht(unsigned long min_nr_alloc_buckets,
 					page_bucket_size);
 	}
 
-	return __default_alloc_cds_lfht(
-			&cds_lfht_mm_mmap, sizeof(struct cds_lfht),
+	ht = __default_alloc_cds_lfht(mm, sizeof(struct cds_lfht),
 			min_nr_alloc_buckets, max_nr_buckets);
+	if (min_nr_alloc_buckets < max_nr_buckets) {
+		/* large table */
+		tbl = mmap_reserve_bucket_table(ht, bucket_size);
+		if (!tbl) {
+			free(ht);
+			return NULL;
+		}
+		if (mm == &cds_lfht_mm_mmap_compact)
+			ht->tbl_compact = tbl;
+		else
+			ht->tbl_mmap = tbl;
+	}
+	return ht;
+}
+
+static
+void cds_lfht_alloc_bucket_table(struct cds_lfht *ht, unsigned long order)
+{
+	ht->tbl_mmap = mmap_alloc_bucket_table(ht, (char *) ht->tbl_mmap,
+			order, sizeof(*ht->tbl_mmap));
+}
+
+static
+void cds_lfht_free_bucket_table(struct cds_lfht *ht, unsigned long order)
+{
+	mmap_free_bucket_table(ht, (char *) ht->tbl_mmap, order,
+			sizeof(*ht->tbl_mmap));
+}
+
+static
+struct cds_lfht_node *bucket_at(struct cds_lfht *ht, unsigned long index)
+{
+	return &ht->tbl_mmap[index];
+}
+
+static
+struct cds_lfht *alloc_cds_lfht(unsigned long min_nr_alloc_buckets,
+		unsigned long max_nr_buckets)
+{
+	return mmap_alloc_cds_lfht(&cds_lfht_mm_mmap, min_nr_alloc_buckets,
+			max_nr_buckets, sizeof(struct cds_lfht_node));
 }
 
 const struct cds_lfht_mm_type cds_lfht_mm_mmap = {
@@ -212,3 +364,50 @@ const struct cds_lfht_mm_type cds_lfht_mm_mmap = {
 	.free_bucket_table = cds_lfht_free_bucket_table,
 	.bucket_at = bucket_at,
 };
+
+/*
+ * Compact layout: each bucket only holds the next pointer, its reverse
+ * hash being computed from its index when needed (see
+ * _cds_lfht_node_reverse_hash()).
+ */
+static
+void compact_alloc_bucket_table(struct cds_lfht *ht, unsigned long order)
+{
+	ht->tbl_compact = mmap_alloc_bucket_table(ht,
+			(char *) ht->tbl_compact, order,
+			sizeof(*ht->tbl_compact));
+}
+
+static
+void compact_free_bucket_table(struct cds_lfht *ht, unsigned long order)
+{
+	mmap_free_bucket_table(ht, (char *) ht->tbl_compact, order,
+			sizeof(*ht->tbl_compact));
+}
+
+static
+struct cds_lfht_node *compact_bucket_at(struct cds_lfht *ht,
+		unsigned long index)
+{
+	return (struct cds_lfht_node *) &ht->tbl_compact[index];
+}
+
+static
+struct cds_lfht *compact_alloc_cds_lfht(unsigned long min_nr_alloc_buckets,
+		unsigned long max_nr_buckets)
+{
+	struct cds_lfht *ht;
+
+	ht = mmap_alloc_cds_lfht(&cds_lfht_mm_mmap_compact,
+			min_nr_alloc_buckets, max_nr_buckets,
+			sizeof(struct cds_lfht_compact_bucket));
+	ht->compact_buckets = 1;
+	return ht;
+}
+
+const struct cds_lfht_mm_type cds_lfht_mm_mmap_compact = {
+	.alloc_cds_lfht = compact_alloc_cds_lfht,
+	.alloc_bucket_table = compact_alloc_bucket_table,
+	.free_bucket_table = compact_free_bucket_table,
+	.bucket_at = compact_bucket_at,
+};
@@ -30,10 +30,14 @@ void cds_lfht_alloc_bucket_table(struct cds_lfht *ht, unsigned long order)
 		ht->tbl_order[0] = calloc(ht->min_nr_alloc_buckets,
 			sizeof(struct cds_lfht_node));
 		assert(ht->tbl_order[0]);
+		cds_lfht_mm_account(ht, ht->min_nr_alloc_buckets
+				* sizeof(struct cds_lfht_node));
 	} else if (order > ht->min_alloc_buckets_order) {
 		ht->tbl_order[order] = calloc(1UL << (order -1),
 			sizeof(struct cds_lfht_node));
 		assert(ht->tbl_order[order]);
+		cds_lfht_mm_account(ht, (1UL << (order - 1))
+				* sizeof(struct cds_lfht_node));
 	}
 	/* Nothing to do for 0 < order && order <= ht->min_alloc_buckets_order */
 }
@@ -48,8 +52,11 @@ void cds_lfht_free_bucket_table(struct cds_lfht *ht, unsigned long order)
 {
 	if (order == 0)
 		poison_free(ht->tbl_order[0]);
-	else if (order > ht->min_alloc_buckets_order)
+	else if (order > ht->min_alloc_buckets_order) {
 		poison_free(ht->tbl_order[order]);
+		cds_lfht_mm_account(ht, -(long) ((1UL << (order - 1))
+				* sizeof(struct cds_lfht_node)));
+	}
 	/* Nothing to do for 0 < order && order <= ht->min_alloc_buckets_order */
 }
 
@@ -0,0 +1,241 @@
+/*
+ * rculfhash-sharded.c
+ *
+ * Userspace RCU library - Sharded Lock-Free RCU Hash Table
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+#define _LGPL_SOURCE
+#include <stdlib.h>
+#include <assert.h>
+
+#include <urcu/compiler.h>
+#include <urcu/rculfhash.h>
+#include <urcu/rculfhash-sharded.h>
+
+struct cds_lfht_sharded {
+	unsigned long mask;		/* Number of shards - 1. */
+	pthread_attr_t *attr;
+	struct cds_lfht *shards[];
+};
+
+/*
+ * The shard index is made of the top bits of the hash, which are the
+ * low bits of the reverse hash kept in each node.
+ */
+static inline
+struct cds_lfht *shard_of_reverse_hash(struct cds_lfht_sharded *sht,
+		unsigned long reverse_hash)
+{
+	return sht->shards[reverse_hash & sht->mask];
+}
+
+struct cds_lfht_sharded *_cds_lfht_sharded_new(unsigned long nr_shards,
+			unsigned long init_size,
+			unsigned long min_nr_alloc_buckets,
+			unsigned long max_nr_buckets,
+			int flags,
+			const struct cds_lfht_mm_type *mm,
+			const struct rcu_flavor_struct *flavor,
+			pthread_attr_t *attr)
+{
+	struct cds_lfht_sharded *sht;
+	unsigned long i;
+
+	/* nr_shards must be power of two */
+	if (!nr_shards || (nr_shards & (nr_shards - 1)))
+		return NULL;
+	sht = calloc(1, sizeof(*sht) + nr_shards * sizeof(sht->shards[0]));
+	if (!sht)
+		return NULL;
+	sht->mask = nr_shards - 1;
+	sht->attr = attr;
+	for (i = 0; i < nr_shards; i++) {
+		sht->shards[i] = _cds_lfht_new(init_size,
+				min_nr_alloc_buckets, max_nr_buckets,
+				flags, mm, flavor, attr);
+		if (!sht->shards[i])
+			goto error;
+	}
+	return sht;
+
+error:
+	while (i-- > 0) {
+		int ret;
+
+		ret = cds_lfht_destroy(sht->shards[i], NULL);
+		assert(!ret);
+	}
+	free(sht);
+	return NULL;
+}
+
+int cds_lfht_sharded_destroy(struct cds_lfht_sharded *sht,
+		pthread_attr_t **attr)
+{
+	unsigned long i;
+	int ret;
+
+	for (i = 0; i <= sht->mask; i++) {
+		if (!sht->shards[i])
+			continue;
+		ret = cds_lfht_destroy(sht->shards[i], NULL);
+		if (ret)
+			return ret;
+		sht->shards[i] = NULL;
+	}
+	if (attr)
+		*attr = sht->attr;
+	free(sht);
+	return 0;
+}
+
+unsigned long cds_lfht_sharded_nr_shards(struct cds_lfht_sharded *sht)
+{
+	return sht->mask + 1;
+}
+
+struct cds_lfht *cds_lfht_sharded_shard_at(struct cds_lfht_sharded *sht,
+		unsigned long index)
+{
+	assert(index <= sht->mask);
+	return sht->shards[index];
+}
+
+struct cds_lfht *cds_lfht_sharded_shard(struct cds_lfht_sharded *sht,
+		unsigned long hash)
+{
+	return shard_of_reverse_hash(sht, _cds_lfht_bit_reverse_ulong(hash));
+}
+
+struct cds_lfht *cds_lfht_sharded_node_shard(struct cds_lfht_sharded *sht,
+		struct cds_lfht_node *node)
+{
+	return shard_of_reverse_hash(sht, node->reverse_hash);
+}
+
+void cds_lfht_sharded_lookup(struct cds_lfht_sharded *sht,
+		unsigned long hash, cds_lfht_match_fct match, const void *key,
+		struct cds_lfht_iter *iter)
+{
+	cds_lfht_lookup(cds_lfht_sharded_shard(sht, hash), hash, match, key,
+			iter);
+}
+
+void cds_lfht_sharded_add(struct cds_lfht_sharded *sht, unsigned long hash,
+		struct cds_lfht_node *node)
+{
+	cds_lfht_add(cds_lfht_sharded_shard(sht, hash), hash, node);
+}
+
+struct cds_lfht_node *cds_lfht_sharded_add_unique(
+		struct cds_lfht_sharded *sht, unsigned long hash,
+		cds_lfht_match_fct match, const void *key,
+		struct cds_lfht_node *node)
+{
+	return cds_lfht_add_unique(cds_lfht_sharded_shard(sht, hash), hash,
+			match, key, node);
+}
+
+struct cds_lfht_node *cds_lfht_sharded_lookup_or_add(
+		struct cds_lfht_sharded *sht, unsigned long hash,
+		cds_lfht_match_fct match, const void *key,
+		struct cds_lfht_node *(*ctor)(void *arg),
+		void (*dtor)(struct cds_lfht_node *node, void *arg),
+		void *arg)
+{
+	return cds_lfht_lookup_or_add(cds_lfht_sharded_shard(sht, hash), hash,
+			match, key, ctor, dtor, arg);
+}
+
+struct cds_lfht_node *cds_lfht_sharded_add_replace(
+		struct cds_lfht_sharded *sht, unsigned long hash,
+		cds_lfht_match_fct match, const void *key,
+		struct cds_lfht_node *node)
+{
+	return cds_lfht_add_replace(cds_lfht_sharded_shard(sht, hash), hash,
+			match, key, node);
+}
+
+int cds_lfht_sharded_replace(struct cds_lfht_sharded *sht,
+		struct cds_lfht_iter *old_iter, unsigned long hash,
+		cds_lfht_match_fct match, const void *key,
+		struct cds_lfht_node *new_node)
+{
+	return cds_lfht_replace(cds_lfht_sharded_shard(sht, hash), old_iter,
+			hash, match, key, new_node);
+}
+
+int cds_lfht_sharded_del(struct cds_lfht_sharded *sht,
+		struct cds_lfht_node *node)
+{
+	return cds_lfht_del(cds_lfht_sharded_node_shard(sht, node), node);
+}
+
+void cds_lfht_sharded_count_nodes(struct cds_lfht_sharded *sht,
+		long *split_count_before,
+		unsigned long *count,
+		long *split_count_after)
+{
+	long before, after;
+	unsigned long i, nr;
+
+	*split_count_before = 0;
+	*count = 0;
+	*split_count_after = 0;
+	for (i = 0; i <= sht->mask; i++) {
+		cds_lfht_count_nodes(sht->shards[i], &before, &nr, &after);
+		*split_count_before += before;
+		*count += nr;
+		*split_count_after += after;
+	}
+}
+
+void cds_lfht_sharded_resize(struct cds_lfht_sharded *sht,
+		unsigned long new_size)
+{
+	unsigned long i;
+
+	for (i = 0; i <= sht->mask; i++)
+		cds_lfht_resize(sht->shards[i], new_size);
+}
+
+/* Move on to the first node of the next non-empty shards, if needed. */
+static
+void sharded_iter_skip_empty(struct cds_lfht_sharded *sht,
+		struct cds_lfht_sharded_iter *iter)
+{
+	while (!cds_lfht_iter_get_node(&iter->iter)
+			&& iter->shard < sht->mask) {
+		iter->shard++;
+		cds_lfht_first(sht->shards[iter->shard], &iter->iter);
+	}
+}
+
+void cds_lfht_sharded_first(struct cds_lfht_sharded *sht,
+		struct cds_lfht_sharded_iter *iter)
+{
+	iter->shard = 0;
+	cds_lfht_first(sht->shards[0], &iter->iter);
+	sharded_iter_skip_empty(sht, iter);
+}
+
+void cds_lfht_sharded_next(struct cds_lfht_sharded *sht,
+		struct cds_lfht_sharded_iter *iter)
+{
+	cds_lfht_next(sht->shards[iter->shard], &iter->iter);
+	sharded_iter_skip_empty(sht, iter);
+}
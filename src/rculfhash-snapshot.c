@@ -0,0 +1,291 @@
+/*
+ * rculfhash-snapshot.c
+ *
+ * Userspace RCU library - point-in-time snapshots of a cds_lfht
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301
+ * USA
+ */
+
+/*
+ * Taking a snapshot advances the epoch, then waits for a grace period:
+ * additions and deletions stamp the epoch within a read-side critical
+ * section, so that those which read the epoch of the snapshot have
+ * completed by the time it is returned, and later ones stamp a newer
+ * epoch, which the snapshot ignores.
+ *
+ * A deletion reads the epoch before taking the mutex, and a snapshot
+ * advances it with the mutex held, so that the deletion finds the open
+ * snapshots which see its entry. Entries deleted while such a snapshot
+ * is open are queued by deletion epoch, and deleted from the table by
+ * the close which leaves no open snapshot older than their deletion.
+ */
+
+#define _LGPL_SOURCE
+#include <stdlib.h>
+#include <assert.h>
+#include <errno.h>
+#include <pthread.h>
+
+#include <urcu/compiler.h>
+#include <urcu/arch.h>
+#include <urcu/uatomic.h>
+#include <urcu/flavor.h>
+#include <urcu/rculfhash.h>
+#include <urcu/rculfhash-snapshot.h>
+
+#include "urcu-die.h"
+
+struct cds_lfht_snap {
+	struct cds_lfht *ht;
+	void (*free_node)(struct rcu_head *head);
+	const struct rcu_flavor_struct *flavor;
+	unsigned long epoch;		/* Stamped by updates. */
+	pthread_mutex_t lock;		/* Protects the lists, and epoch. */
+	struct cds_list_head snapshots;	/* Open snapshots, oldest first. */
+	struct cds_list_head deleted;	/* By deletion epoch. */
+};
+
+struct snap_match_key {
+	cds_lfht_match_fct match;
+	const void *key;
+	unsigned long epoch;
+};
+
+static void mutex_lock(pthread_mutex_t *mutex)
+{
+	int ret;
+
+	ret = pthread_mutex_lock(mutex);
+	if (ret)
+		urcu_die(ret);
+}
+
+static void mutex_unlock(pthread_mutex_t *mutex)
+{
+	int ret;
+
+	ret = pthread_mutex_unlock(mutex);
+	if (ret)
+		urcu_die(ret);
+}
+
+static inline
+struct cds_lfht_snap_node *to_snap_node(struct cds_lfht_node *node)
+{
+	return caa_container_of(node, struct cds_lfht_snap_node, node);
+}
+
+static int snap_match(struct cds_lfht_node *node, const void *key)
+{
+	const struct snap_match_key *snap_key = key;
+
+	return cds_lfht_snap_node_visible(to_snap_node(node), snap_key->epoch)
+		&& snap_key->match(node, snap_key->key);
+}
+
+static void reclaim_node(struct cds_lfht_snap *snap,
+		struct cds_lfht_snap_node *node)
+{
+	int ret;
+
+	/* The deletion epoch makes the caller the only deleter. */
+	ret = cds_lfht_del(snap->ht, &node->node);
+	assert(!ret);
+	(void) ret;
+	snap->flavor->update_call_rcu(&node->rcu_head, snap->free_node);
+}
+
+/* Queue a deleted entry seen by an open snapshot. Called with the mutex held. */
+static void queue_deleted(struct cds_lfht_snap *snap,
+		struct cds_lfht_snap_node *node)
+{
+	struct cds_list_head *pos = snap->deleted.prev;
+
+	/* Deletions mostly come in epoch order. */
+	while (pos != &snap->deleted && caa_container_of(pos,
+			struct cds_lfht_snap_node, link)->del_epoch
+				> node->del_epoch)
+		pos = pos->prev;
+	cds_list_add(&node->link, pos);
+}
+
+struct cds_lfht_snap *cds_lfht_snap_new_flavor(struct cds_lfht *ht,
+		void (*free_node)(struct rcu_head *head),
+		const struct rcu_flavor_struct *flavor)
+{
+	struct cds_lfht_snap *snap;
+	int ret;
+
+	snap = malloc(sizeof(*snap));
+	if (!snap)
+		return NULL;
+	snap->ht = ht;
+	snap->free_node = free_node;
+	snap->flavor = flavor;
+	/* Deletion epochs are never 0. */
+	snap->epoch = 1;
+	ret = pthread_mutex_init(&snap->lock, NULL);
+	if (ret)
+		urcu_die(ret);
+	CDS_INIT_LIST_HEAD(&snap->snapshots);
+	CDS_INIT_LIST_HEAD(&snap->deleted);
+	return snap;
+}
+
+int cds_lfht_snap_destroy(struct cds_lfht_snap *snap)
+{
+	int ret;
+
+	if (!cds_list_empty(&snap->snapshots))
+		return -EBUSY;
+	/* Closing the last snapshot reclaimed the deleted entries. */
+	assert(cds_list_empty(&snap->deleted));
+	ret = pthread_mutex_destroy(&snap->lock);
+	if (ret)
+		urcu_die(ret);
+	free(snap);
+	return 0;
+}
+
+void cds_lfht_snap_add(struct cds_lfht_snap *snap, unsigned long hash,
+		struct cds_lfht_snap_node *node)
+{
+	node->add_epoch = uatomic_read(&snap->epoch);
+	node->del_epoch = 0;
+	cds_lfht_add(snap->ht, hash, &node->node);
+}
+
+struct cds_lfht_snap_node *cds_lfht_snap_add_unique(struct cds_lfht_snap *snap,
+		unsigned long hash, cds_lfht_match_fct match, const void *key,
+		struct cds_lfht_snap_node *node)
+{
+	struct snap_match_key snap_key = {
+		.match = match,
+		.key = key,
+		.epoch = CDS_LFHT_SNAP_LIVE,
+	};
+
+	node->add_epoch = uatomic_read(&snap->epoch);
+	node->del_epoch = 0;
+	return to_snap_node(cds_lfht_add_unique(snap->ht, hash, snap_match,
+			&snap_key, &node->node));
+}
+
+/*
+ * Queue or reclaim an entry whose deletion epoch the caller stamped.
+ */
+static void deleted_node(struct cds_lfht_snap *snap,
+		struct cds_lfht_snap_node *node, unsigned long epoch)
+{
+	struct cds_lfht_snapshot *oldest;
+
+	mutex_lock(&snap->lock);
+	if (!cds_list_empty(&snap->snapshots)) {
+		oldest = cds_list_first_entry(&snap->snapshots,
+				struct cds_lfht_snapshot, link);
+		if (oldest->epoch < epoch) {
+			queue_deleted(snap, node);
+			mutex_unlock(&snap->lock);
+			return;
+		}
+	}
+	mutex_unlock(&snap->lock);
+	reclaim_node(snap, node);
+}
+
+int cds_lfht_snap_del(struct cds_lfht_snap *snap,
+		struct cds_lfht_snap_node *node)
+{
+	unsigned long epoch = uatomic_read(&snap->epoch);
+
+	if (uatomic_cmpxchg(&node->del_epoch, 0, epoch) != 0)
+		return -ENOENT;
+	deleted_node(snap, node, epoch);
+	return 0;
+}
+
+int cds_lfht_snap_replace(struct cds_lfht_snap *snap, unsigned long hash,
+		struct cds_lfht_snap_node *old_node,
+		struct cds_lfht_snap_node *new_node)
+{
+	unsigned long epoch = uatomic_read(&snap->epoch);
+
+	/* Both in the same epoch: a snapshot sees one or the other. */
+	if (uatomic_cmpxchg(&old_node->del_epoch, 0, epoch) != 0)
+		return -ENOENT;
+	new_node->add_epoch = epoch;
+	new_node->del_epoch = 0;
+	cds_lfht_add(snap->ht, hash, &new_node->node);
+	deleted_node(snap, old_node, epoch);
+	return 0;
+}
+
+struct cds_lfht_snap_node *cds_lfht_snap_lookup(struct cds_lfht_snap *snap,
+		unsigned long epoch, unsigned long hash,
+		cds_lfht_match_fct match, const void *key)
+{
+	struct snap_match_key snap_key = {
+		.match = match,
+		.key = key,
+		.epoch = epoch,
+	};
+	struct cds_lfht_node *node;
+	struct cds_lfht_iter iter;
+
+	cds_lfht_lookup(snap->ht, hash, snap_match, &snap_key, &iter);
+	node = cds_lfht_iter_get_node(&iter);
+	return node ? to_snap_node(node) : NULL;
+}
+
+void cds_lfht_snap_take(struct cds_lfht_snap *snap,
+		struct cds_lfht_snapshot *snapshot)
+{
+	mutex_lock(&snap->lock);
+	snapshot->epoch = snap->epoch;
+	uatomic_set(&snap->epoch, snapshot->epoch + 1);
+	cds_list_add_tail(&snapshot->link, &snap->snapshots);
+	mutex_unlock(&snap->lock);
+	/* Wait for the updates which read the epoch of the snapshot. */
+	snap->flavor->update_synchronize_rcu();
+}
+
+unsigned long cds_lfht_snap_close(struct cds_lfht_snap *snap,
+		struct cds_lfht_snapshot *snapshot)
+{
+	struct cds_lfht_snap_node *node, *tmp;
+	unsigned long oldest_epoch = CDS_LFHT_SNAP_LIVE, nr = 0;
+	struct cds_list_head reclaim;
+
+	CDS_INIT_LIST_HEAD(&reclaim);
+	mutex_lock(&snap->lock);
+	cds_list_del(&snapshot->link);
+	if (!cds_list_empty(&snap->snapshots))
+		oldest_epoch = cds_list_first_entry(&snap->snapshots,
+				struct cds_lfht_snapshot, link)->epoch;
+	/* No open snapshot sees the entries deleted in its epoch or before. */
+	cds_list_for_each_entry_safe(node, tmp, &snap->deleted, link) {
+		if (node->del_epoch > oldest_epoch)
+			break;
+		cds_list_del(&node->link);
+		cds_list_add_tail(&node->link, &reclaim);
+	}
+	mutex_unlock(&snap->lock);
+	cds_list_for_each_entry_safe(node, tmp, &reclaim, link) {
+		reclaim_node(snap, node);
+		nr++;
+	}
+	return nr;
+}
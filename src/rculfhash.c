@@ -256,6 +256,24 @@
  */
 
 #define _LGPL_SOURCE
+
+/*
+ * The flavor-specialized builds of the library, such as
+ * liburcu-cds-qsbr, call their flavor directly: the read-side
+ * primitives are inlined in the resize and partition loops instead of
+ * being called through the flavor of each table. Such builds only
+ * accept tables of their flavor.
+ */
+#if defined(CDS_LFHT_FLAVOR_QSBR)
+#define URCU_API_MAP
+#include <urcu/urcu-qsbr.h>
+#define CDS_LFHT_FLAVOR_DIRECT
+#elif defined(CDS_LFHT_FLAVOR_MEMB)
+#define URCU_API_MAP
+#include <urcu/urcu-memb.h>
+#define CDS_LFHT_FLAVOR_DIRECT
+#endif
+
 #include <stdlib.h>
 #include <errno.h>
 #include <assert.h>
@@ -264,14 +282,22 @@
 #include <string.h>
 #include <sched.h>
 #include <unistd.h>
+#include <sys/mman.h>
+
+#if defined(__x86_64__) && defined(__GNUC__) && (CAA_BITS_PER_LONG == 64)
+#define CDS_LFHT_BIT_REVERSE_X86
+#include <immintrin.h>
+#endif
 
 #include "compat-getcpu.h"
+#include "compat-numa.h"
 #include <urcu/pointer.h>
 #include <urcu/call-rcu.h>
 #include <urcu/flavor.h>
 #include <urcu/arch.h>
 #include <urcu/uatomic.h>
 #include <urcu/compiler.h>
+#include <urcu/list.h>
 #include <urcu/rculfhash.h>
 #include <rculfhash-internal.h>
 #include <stdio.h>
@@ -280,6 +306,31 @@
 #include "workqueue.h"
 #include "urcu-die.h"
 #include "urcu-utils.h"
+#include "urcu-stats.h"
+#include "urcu-mutex.h"
+#include "urcu-tp.h"
+
+/* Emit the library symbols of the functions mapped to their inline versions. */
+#undef cds_lfht_lookup
+#undef cds_lfht_next_duplicate
+
+#ifdef CDS_LFHT_FLAVOR_DIRECT
+#define lfht_read_lock(ht)		rcu_read_lock()
+#define lfht_read_unlock(ht)		rcu_read_unlock()
+#define lfht_quiescent_state(ht)	rcu_quiescent_state()
+#define lfht_synchronize_rcu(ht)	synchronize_rcu()
+#define lfht_call_rcu(ht, head, func)	call_rcu(head, func)
+#define lfht_register_thread(ht)	rcu_register_thread()
+#define lfht_unregister_thread(ht)	rcu_unregister_thread()
+#else
+#define lfht_read_lock(ht)		((ht)->flavor->read_lock())
+#define lfht_read_unlock(ht)		((ht)->flavor->read_unlock())
+#define lfht_quiescent_state(ht)	((ht)->flavor->read_quiescent_state())
+#define lfht_synchronize_rcu(ht)	((ht)->flavor->update_synchronize_rcu())
+#define lfht_call_rcu(ht, head, func)	((ht)->flavor->update_call_rcu(head, func))
+#define lfht_register_thread(ht)	((ht)->flavor->register_thread())
+#define lfht_unregister_thread(ht)	((ht)->flavor->unregister_thread())
+#endif
 
 /*
  * Split-counters lazily update the global counter each 1024
@@ -292,6 +343,16 @@
 #define CHAIN_LEN_TARGET		1
 #define CHAIN_LEN_RESIZE_THRESHOLD	3
 
+/*
+ * Resize policy of tables created without one.
+ */
+static const struct cds_lfht_resize_policy default_resize_policy = {
+	.target_load = CHAIN_LEN_TARGET,
+	.grow_load = 1UL << CHAIN_LEN_RESIZE_THRESHOLD,
+	.grow_chain_len = CHAIN_LEN_RESIZE_THRESHOLD,
+	.shrink_div = 1,
+};
+
 /*
  * Define the minimum table size.
  */
@@ -305,24 +366,29 @@
 #define MIN_PARTITION_PER_THREAD	(1UL << MIN_PARTITION_PER_THREAD_ORDER)
 
 /*
- * The removed flag needs to be updated atomically with the pointer.
- * It indicates that no node must attach to the node scheduled for
- * removal, and that node garbage collection must be performed.
- * The bucket flag does not require to be updated atomically with the
- * pointer, but it is added as a pointer low bit flag to save space.
- * The "removal owner" flag is used to detect which of the "del"
- * operation that has set the "removed flag" gets to return the removed
- * node to its caller. Note that the replace operation does not need to
- * iteract with the "removal owner" flag, because it validates that
- * the "removed" flag is not set before performing its cmpxchg.
+ * Number of lookups cds_lfht_lookup_batch() interleaves: enough
+ * outstanding prefetches to cover memory latency.
+ */
+#define LOOKUP_BATCH_SIZE		16
+
+/*
+ * Maximum number of threads running lazy resizes, so that resizes of
+ * independent tables proceed in parallel.
  */
-#define REMOVED_FLAG		(1UL << 0)
-#define BUCKET_FLAG		(1UL << 1)
-#define REMOVAL_OWNER_FLAG	(1UL << 2)
-#define FLAGS_MASK		((1UL << 3) - 1)
+#define MAX_RESIZE_WORKERS		4
 
-/* Value of the end pointer. Should not interact with flags. */
-#define END_VALUE		NULL
+/*
+ * Delay of lazy resizes, so that the resize target reached by a burst
+ * of updates is covered by a single resize.
+ */
+#define RESIZE_LAZY_DELAY_MS		1
+
+#define REMOVED_FLAG		CDS_LFHT_REMOVED_FLAG
+#define BUCKET_FLAG		CDS_LFHT_BUCKET_FLAG
+#define REMOVAL_OWNER_FLAG	CDS_LFHT_REMOVAL_OWNER_FLAG
+#define FLAGS_MASK		CDS_LFHT_FLAGS_MASK
+
+#define END_VALUE		CDS_LFHT_END_VALUE
 
 /*
  * ht_items_count: Split-counters counting the number of node addition
@@ -348,24 +414,61 @@ struct resize_work {
 };
 
 /*
- * partition_resize_work: Contains arguments passed to worker threads
- * executing the hash table resize on partitions of the hash table
- * assigned to each processor's worker thread.
+ * partition_resize_work: A table resize (or parallel traversal) order
+ * split in nr_parts partitions of len buckets, processed by the threads
+ * of a resize pool and by the thread submitting it. Partitions are
+ * claimed in order with the pool lock held.
  */
 struct partition_resize_work {
-	pthread_t thread_id;
+	struct cds_list_head node;	/* resize_pool->work */
 	struct cds_lfht *ht;
-	unsigned long i, start, len;
+	unsigned long i, base, len;	/* base: first bucket of partition 0 */
+	unsigned long nr_parts, next_part, nr_done;
+	void *priv;
 	void (*fct)(struct cds_lfht *ht, unsigned long i,
-		    unsigned long start, unsigned long len);
+		    unsigned long start, unsigned long len, void *priv);
+};
+
+/*
+ * cds_lfht_resize_pool: Long-lived threads processing resize
+ * partitions, shared by the tables created with the same resize thread
+ * attributes. Threads are created on demand, with those attributes, and
+ * joined when the last table using the pool is destroyed.
+ */
+struct cds_lfht_resize_pool {
+	struct cds_list_head node;	/* cds_lfht_resize_pools */
+	pthread_attr_t *attr;
+	unsigned long refcount;		/* Tables using the pool */
+	pthread_mutex_t lock;
+	pthread_cond_t work_cond;	/* Partitions to claim, or stop */
+	pthread_cond_t done_cond;	/* Partition completed */
+	struct cds_list_head work;	/* Works with unclaimed partitions */
+	pthread_t *threads;
+	unsigned long nr_threads, max_threads;
+	int stop;
 };
 
+/* Protected by cds_lfht_fork_mutex. */
+static CDS_LIST_HEAD(cds_lfht_resize_pools);
+
 static struct urcu_workqueue *cds_lfht_workqueue;
 static unsigned long cds_lfht_workqueue_user_count;
 
+/* Live tables, protected by cds_lfht_tables_mutex. */
+static CDS_LIST_HEAD(cds_lfht_tables);
+static pthread_mutex_t cds_lfht_tables_mutex = PTHREAD_MUTEX_INITIALIZER;
+
+/*
+ * Set in the child of a fork: the workqueue has no worker thread until
+ * its first use, see cds_lfht_get_workqueue(). Protected by
+ * cds_lfht_fork_mutex.
+ */
+static int cds_lfht_workqueue_forked;
+
 /*
- * Mutex ensuring mutual exclusion between workqueue initialization and
- * fork handlers. cds_lfht_fork_mutex nests inside call_rcu_mutex.
+ * Mutex ensuring mutual exclusion between workqueue and resize pool
+ * initialization and fork handlers. cds_lfht_fork_mutex nests inside
+ * call_rcu_mutex.
  */
 static pthread_mutex_t cds_lfht_fork_mutex = PTHREAD_MUTEX_INITIALIZER;
 
@@ -380,6 +483,10 @@ static int cds_lfht_workqueue_atfork_nesting;
 
 static void cds_lfht_init_worker(const struct rcu_flavor_struct *flavor);
 static void cds_lfht_fini_worker(const struct rcu_flavor_struct *flavor);
+static struct cds_lfht_resize_pool *cds_lfht_get_resize_pool(
+		const struct rcu_flavor_struct *flavor, pthread_attr_t *attr);
+static void cds_lfht_put_resize_pool(const struct rcu_flavor_struct *flavor,
+		struct cds_lfht_resize_pool *pool);
 
 #ifdef CONFIG_CDS_LFHT_ITER_DEBUG
 
@@ -402,63 +509,123 @@ void cds_lfht_iter_debug_set_ht(struct cds_lfht *ht, struct cds_lfht_iter *iter)
 
 #endif
 
+static
+unsigned long bit_reverse_ulong(unsigned long v)
+{
+	return _cds_lfht_bit_reverse_ulong(v);
+}
+
 /*
- * Algorithm to reverse bits in a word by lookup table, extended to
- * 64-bit words.
- * Source:
- * http://graphics.stanford.edu/~seander/bithacks.html#BitReverseTable
- * Originally from Public Domain.
+ * Reverse the hashes of a lookup batch at once, with the widest vector
+ * instructions the CPU supports.
  */
-
-static const uint8_t BitReverseTable256[256] =
-{
-#define R2(n) (n),   (n) + 2*64,     (n) + 1*64,     (n) + 3*64
-#define R4(n) R2(n), R2((n) + 2*16), R2((n) + 1*16), R2((n) + 3*16)
-#define R6(n) R4(n), R4((n) + 2*4 ), R4((n) + 1*4 ), R4((n) + 3*4 )
-	R6(0), R6(2), R6(1), R6(3)
-};
-#undef R2
-#undef R4
-#undef R6
+typedef void (*bit_reverse_batch_fct)(unsigned long *rev,
+		const unsigned long *v, unsigned long nr);
 
 static
-uint8_t bit_reverse_u8(uint8_t v)
+void bit_reverse_batch_sw(unsigned long *rev, const unsigned long *v,
+		unsigned long nr)
 {
-	return BitReverseTable256[v];
+	unsigned long i;
+
+	for (i = 0; i < nr; i++)
+		rev[i] = bit_reverse_ulong(v[i]);
+}
+
+#ifdef CDS_LFHT_BIT_REVERSE_X86
+/*
+ * GF2P8AFFINEQB with this matrix reverses the bits of each byte, and the
+ * shuffle then reverses the bytes of each 64-bit lane.
+ */
+static __attribute__((target("gfni,avx2")))
+void bit_reverse_batch_gfni(unsigned long *rev, const unsigned long *v,
+		unsigned long nr)
+{
+	const __m256i matrix = _mm256_set1_epi64x(0x8040201008040201LL);
+	const __m256i bswap = _mm256_set_epi8(
+		8, 9, 10, 11, 12, 13, 14, 15, 0, 1, 2, 3, 4, 5, 6, 7,
+		8, 9, 10, 11, 12, 13, 14, 15, 0, 1, 2, 3, 4, 5, 6, 7);
+	unsigned long i;
+
+	for (i = 0; i + 4 <= nr; i += 4) {
+		__m256i x = _mm256_loadu_si256((const __m256i *) &v[i]);
+
+		x = _mm256_gf2p8affine_epi64_epi8(x, matrix, 0);
+		x = _mm256_shuffle_epi8(x, bswap);
+		_mm256_storeu_si256((__m256i *) &rev[i], x);
+	}
+	bit_reverse_batch_sw(&rev[i], &v[i], nr - i);
+}
+
+/*
+ * Reverse each nibble with a table lookup, swap the nibbles of each
+ * byte, and reverse the bytes of each 64-bit lane.
+ */
+static __attribute__((target("ssse3")))
+void bit_reverse_batch_ssse3(unsigned long *rev, const unsigned long *v,
+		unsigned long nr)
+{
+	const __m128i rev4 = _mm_setr_epi8(0x0, 0x8, 0x4, 0xc, 0x2, 0xa,
+		0x6, 0xe, 0x1, 0x9, 0x5, 0xd, 0x3, 0xb, 0x7, 0xf);
+	const __m128i bswap = _mm_set_epi8(8, 9, 10, 11, 12, 13, 14, 15,
+		0, 1, 2, 3, 4, 5, 6, 7);
+	const __m128i mask = _mm_set1_epi8(0x0f);
+	unsigned long i;
+
+	for (i = 0; i + 2 <= nr; i += 2) {
+		__m128i x = _mm_loadu_si128((const __m128i *) &v[i]);
+		__m128i lo, hi;
+
+		lo = _mm_shuffle_epi8(rev4, _mm_and_si128(x, mask));
+		hi = _mm_shuffle_epi8(rev4,
+			_mm_and_si128(_mm_srli_epi16(x, 4), mask));
+		x = _mm_or_si128(_mm_slli_epi16(lo, 4), hi);
+		x = _mm_shuffle_epi8(x, bswap);
+		_mm_storeu_si128((__m128i *) &rev[i], x);
+	}
+	bit_reverse_batch_sw(&rev[i], &v[i], nr - i);
 }
 
-#if (CAA_BITS_PER_LONG == 32)
 static
-uint32_t bit_reverse_u32(uint32_t v)
+bit_reverse_batch_fct bit_reverse_batch_select(void)
 {
-	return ((uint32_t) bit_reverse_u8(v) << 24) |
-		((uint32_t) bit_reverse_u8(v >> 8) << 16) |
-		((uint32_t) bit_reverse_u8(v >> 16) << 8) |
-		((uint32_t) bit_reverse_u8(v >> 24));
+	__builtin_cpu_init();
+	if (__builtin_cpu_supports("gfni") && __builtin_cpu_supports("avx2"))
+		return bit_reverse_batch_gfni;
+	if (__builtin_cpu_supports("ssse3"))
+		return bit_reverse_batch_ssse3;
+	return bit_reverse_batch_sw;
 }
 #else
 static
-uint64_t bit_reverse_u64(uint64_t v)
+bit_reverse_batch_fct bit_reverse_batch_select(void)
 {
-	return ((uint64_t) bit_reverse_u8(v) << 56) |
-		((uint64_t) bit_reverse_u8(v >> 8)  << 48) |
-		((uint64_t) bit_reverse_u8(v >> 16) << 40) |
-		((uint64_t) bit_reverse_u8(v >> 24) << 32) |
-		((uint64_t) bit_reverse_u8(v >> 32) << 24) |
-		((uint64_t) bit_reverse_u8(v >> 40) << 16) |
-		((uint64_t) bit_reverse_u8(v >> 48) << 8) |
-		((uint64_t) bit_reverse_u8(v >> 56));
+	return bit_reverse_batch_sw;
 }
 #endif
 
+/*
+ * Selected once by the constructor, or on first use if called before
+ * it. Concurrent first uses select the same function.
+ */
+static bit_reverse_batch_fct bit_reverse_batch_impl;
+
+static void __attribute__((constructor)) cds_lfht_bit_reverse_init(void)
+{
+	CMM_STORE_SHARED(bit_reverse_batch_impl, bit_reverse_batch_select());
+}
+
 static
-unsigned long bit_reverse_ulong(unsigned long v)
+void bit_reverse_batch(unsigned long *rev, const unsigned long *v,
+		unsigned long nr)
 {
-#if (CAA_BITS_PER_LONG == 32)
-	return bit_reverse_u32(v);
-#else
-	return bit_reverse_u64(v);
-#endif
+	bit_reverse_batch_fct fct = CMM_LOAD_SHARED(bit_reverse_batch_impl);
+
+	if (caa_unlikely(!fct)) {
+		fct = bit_reverse_batch_select();
+		CMM_STORE_SHARED(bit_reverse_batch_impl, fct);
+	}
+	fct(rev, v, nr);
 }
 
 /*
@@ -607,28 +774,64 @@ static
 void cds_lfht_resize_lazy_count(struct cds_lfht *ht, unsigned long size,
 				unsigned long count);
 
-static void mutex_lock(pthread_mutex_t *mutex)
+static
+void cds_lfht_resize_grow(struct cds_lfht *ht, unsigned long count);
+
+/*
+ * Number of buckets for count nodes at the target load of the table
+ * resize policy, as a power of 2.
+ */
+static
+unsigned long policy_target_size(struct cds_lfht *ht, unsigned long count)
 {
-	int ret;
+	count /= ht->policy.target_load;
+	if (count <= 1)
+		return 1;
+	return 1UL << cds_lfht_get_count_order_ulong(count);
+}
+
+/*
+ * Whether the resize policy allows an automatic resize from size to
+ * new_size buckets. Shrinking is subject to the shrink hysteresis and
+ * minimum interval, any resize to the policy callback.
+ */
+static
+int policy_allow_resize(struct cds_lfht *ht, unsigned long size,
+		unsigned long new_size)
+{
+	const struct cds_lfht_resize_policy *policy = &ht->policy;
+
+	if (new_size < size) {
+		if (!policy->shrink_div
+				|| new_size > size / policy->shrink_div)
+			return 0;
+		if (policy->min_shrink_interval_ms
+				&& urcu_stats_now_ns()
+					< CMM_LOAD_SHARED(ht->last_resize_ns)
+					+ policy->min_shrink_interval_ms
+						* 1000000ULL)
+			return 0;
+	}
+	if (policy->allow_resize)
+		return policy->allow_resize(ht, size, new_size, policy->priv);
+	return 1;
+}
 
+static void mutex_lock_stats(pthread_mutex_t *mutex,
+		struct urcu_lock_stats *stats)
+{
 #ifndef DISTRUST_SIGNALS_EXTREME
-	ret = pthread_mutex_lock(mutex);
-	if (ret)
-		urcu_die(ret);
+	urcu_mutex_lock(mutex, stats);
 #else /* #ifndef DISTRUST_SIGNALS_EXTREME */
-	while ((ret = pthread_mutex_trylock(mutex)) != 0) {
-		if (ret != EBUSY && ret != EINTR)
-			urcu_die(ret);
-		if (CMM_LOAD_SHARED(URCU_TLS(rcu_reader).need_mb)) {
-			cmm_smp_mb();
-			_CMM_STORE_SHARED(URCU_TLS(rcu_reader).need_mb, 0);
-			cmm_smp_mb();
-		}
-		(void) poll(NULL, 0, 10);
-	}
+	urcu_mutex_lock_poll(mutex, stats, NULL);
 #endif /* #else #ifndef DISTRUST_SIGNALS_EXTREME */
 }
 
+static void mutex_lock(pthread_mutex_t *mutex)
+{
+	mutex_lock_stats(mutex, NULL);
+}
+
 static void mutex_unlock(pthread_mutex_t *mutex)
 {
 	int ret;
@@ -638,6 +841,24 @@ static void mutex_unlock(pthread_mutex_t *mutex)
 		urcu_die(ret);
 }
 
+/*
+ * Get the resize workqueue, creating its worker threads if they did not
+ * survive a fork yet: children which never resize lazily nor destroy
+ * auto-resize tables do not pay for them.
+ */
+static struct urcu_workqueue *cds_lfht_get_workqueue(void)
+{
+	if (caa_unlikely(CMM_LOAD_SHARED(cds_lfht_workqueue_forked))) {
+		mutex_lock(&cds_lfht_fork_mutex);
+		if (cds_lfht_workqueue_forked) {
+			urcu_workqueue_create_worker(cds_lfht_workqueue);
+			cds_lfht_workqueue_forked = 0;
+		}
+		mutex_unlock(&cds_lfht_fork_mutex);
+	}
+	return cds_lfht_workqueue;
+}
+
 static long nr_cpus_mask = -1;
 static long split_count_mask = -1;
 static int split_count_order = -1;
@@ -696,6 +917,13 @@ void free_split_items_count(struct cds_lfht *ht)
 	poison_free(ht->split_count);
 }
 
+/*
+ * Each CPU updates its own cache line of split counters: the current
+ * CPU number is read from the rseq area when available (see
+ * compat-getcpu.h). The increments stay atomic, since the thread can be
+ * migrated between choosing the counter and updating it; they are
+ * uncontended in the common case.
+ */
 static
 int ht_get_split_count_index(unsigned long hash)
 {
@@ -730,11 +958,10 @@ void ht_count_add(struct cds_lfht *ht, unsigned long size, unsigned long hash)
 		return;
 	/* Only if global count is power of 2 */
 
-	if ((count >> CHAIN_LEN_RESIZE_THRESHOLD) < size)
+	if (count / ht->policy.grow_load < size)
 		return;
 	dbg_printf("add set global %lu\n", count);
-	cds_lfht_resize_lazy_count(ht, size,
-		count >> (CHAIN_LEN_TARGET - 1));
+	cds_lfht_resize_lazy_count(ht, size, policy_target_size(ht, count));
 }
 
 static
@@ -758,7 +985,7 @@ void ht_count_del(struct cds_lfht *ht, unsigned long size, unsigned long hash)
 		return;
 	/* Only if global count is power of 2 */
 
-	if ((count >> CHAIN_LEN_RESIZE_THRESHOLD) >= size)
+	if (count / ht->policy.grow_load >= size)
 		return;
 	dbg_printf("del set global %ld\n", count);
 	/*
@@ -767,8 +994,84 @@ void ht_count_del(struct cds_lfht *ht, unsigned long size, unsigned long hash)
 	 */
 	if (count < (1UL << COUNT_COMMIT_ORDER) * (split_count_mask + 1))
 		return;
-	cds_lfht_resize_lazy_count(ht, size,
-		count >> (CHAIN_LEN_TARGET - 1));
+	cds_lfht_resize_lazy_count(ht, size, policy_target_size(ht, count));
+}
+
+/*
+ * Account for nr adds at once: commit each multiple of
+ * 1UL << COUNT_COMMIT_ORDER crossed by the split counter, and check
+ * whether the table needs to grow against the resulting global count.
+ */
+static
+void ht_count_add_bulk(struct cds_lfht *ht, unsigned long size,
+		unsigned long hash, unsigned long nr)
+{
+	unsigned long split_count, commit, count;
+	int index;
+
+	if (caa_unlikely(!ht->split_count))
+		return;
+	index = ht_get_split_count_index(hash);
+	split_count = uatomic_add_return(&ht->split_count[index].add, nr);
+	commit = (split_count >> COUNT_COMMIT_ORDER)
+		- ((split_count - nr) >> COUNT_COMMIT_ORDER);
+	if (!commit)
+		return;
+
+	count = uatomic_add_return(&ht->count, commit << COUNT_COMMIT_ORDER);
+	if (count / ht->policy.grow_load < size)
+		return;
+	dbg_printf("bulk add set global %lu\n", count);
+	cds_lfht_resize_lazy_count(ht, size, policy_target_size(ht, count));
+}
+
+/*
+ * Account for nr deletions at once, see ht_count_add_bulk().
+ */
+static
+void ht_count_del_bulk(struct cds_lfht *ht, unsigned long size,
+		unsigned long hash, unsigned long nr)
+{
+	unsigned long split_count, commit, count;
+	int index;
+
+	if (caa_unlikely(!ht->split_count))
+		return;
+	index = ht_get_split_count_index(hash);
+	split_count = uatomic_add_return(&ht->split_count[index].del, nr);
+	commit = (split_count >> COUNT_COMMIT_ORDER)
+		- ((split_count - nr) >> COUNT_COMMIT_ORDER);
+	if (!commit)
+		return;
+
+	count = uatomic_add_return(&ht->count,
+				   -(commit << COUNT_COMMIT_ORDER));
+	if (count / ht->policy.grow_load >= size)
+		return;
+	dbg_printf("bulk del set global %ld\n", count);
+	/*
+	 * Don't shrink table if the number of nodes is below a
+	 * certain threshold.
+	 */
+	if (count < (1UL << COUNT_COMMIT_ORDER) * (split_count_mask + 1))
+		return;
+	cds_lfht_resize_lazy_count(ht, size, policy_target_size(ht, count));
+}
+
+/*
+ * Account for an add to a table which is not published yet: plain
+ * updates, committed as ht_count_add() does, without resize.
+ */
+static
+void ht_count_add_offline(struct cds_lfht *ht, unsigned long hash)
+{
+	unsigned long *split_count;
+
+	if (caa_unlikely(!ht->split_count))
+		return;
+	split_count = &ht->split_count[hash & split_count_mask].add;
+	if (!(++*split_count & ((1UL << COUNT_COMMIT_ORDER) - 1)))
+		ht->count += 1UL << COUNT_COMMIT_ORDER;
 }
 
 static
@@ -788,14 +1091,18 @@ void check_resize(struct cds_lfht *ht, unsigned long size, uint32_t chain_len)
 	if (chain_len > 100)
 		dbg_printf("WARNING: large chain length: %u.\n",
 			   chain_len);
-	if (chain_len >= CHAIN_LEN_RESIZE_THRESHOLD) {
+	if (chain_len >= ht->policy.grow_chain_len) {
 		int growth;
 
 		/*
 		 * Ideal growth calculated based on chain length.
 		 */
+		if (chain_len < ht->policy.target_load)
+			return;
 		growth = cds_lfht_get_count_order_u32(chain_len
-				- (CHAIN_LEN_TARGET - 1));
+				/ ht->policy.target_load);
+		if (growth <= 0)
+			return;
 		if ((ht->flags & CDS_LFHT_ACCOUNTING)
 				&& (size << growth)
 					>= (1UL << (COUNT_COMMIT_ORDER
@@ -818,22 +1125,39 @@ void check_resize(struct cds_lfht *ht, unsigned long size, uint32_t chain_len)
 	}
 }
 
+/*
+ * Tag of node in a CDS_LFHT_NODE_TAG table, NULL otherwise.
+ */
+static inline
+const unsigned long *node_tag(struct cds_lfht *ht, struct cds_lfht_node *node)
+{
+	if (!(ht->flags & CDS_LFHT_NODE_TAG))
+		return NULL;
+	return &caa_container_of(node, struct cds_lfht_tag_node, node)->tag;
+}
+
+static inline
+int tag_match(struct cds_lfht_node *node, const unsigned long *tag)
+{
+	return _cds_lfht_tag_match(node, tag);
+}
+
 static
 struct cds_lfht_node *clear_flag(struct cds_lfht_node *node)
 {
-	return (struct cds_lfht_node *) (((unsigned long) node) & ~FLAGS_MASK);
+	return _cds_lfht_clear_flag(node);
 }
 
 static
 int is_removed(struct cds_lfht_node *node)
 {
-	return ((unsigned long) node) & REMOVED_FLAG;
+	return _cds_lfht_is_removed(node);
 }
 
 static
 int is_bucket(struct cds_lfht_node *node)
 {
-	return ((unsigned long) node) & BUCKET_FLAG;
+	return _cds_lfht_is_bucket(node);
 }
 
 static
@@ -869,7 +1193,7 @@ struct cds_lfht_node *get_end(void)
 static
 int is_end(struct cds_lfht_node *node)
 {
-	return clear_flag(node) == (struct cds_lfht_node *) END_VALUE;
+	return _cds_lfht_is_end(node);
 }
 
 static
@@ -918,13 +1242,62 @@ struct cds_lfht_node *lookup_bucket(struct cds_lfht *ht, unsigned long size,
 	return bucket_at(ht, hash & (size - 1));
 }
 
+/* Reverse hash of a bucket or regular node, see _cds_lfht_node_reverse_hash. */
+static inline
+unsigned long node_reverse_hash(struct cds_lfht *ht, struct cds_lfht_node *node)
+{
+	return _cds_lfht_node_reverse_hash(ht, node, CMM_LOAD_SHARED(node->next));
+}
+
+/*
+ * Updates of tables created with CDS_LFHT_SINGLE_WRITER cannot race
+ * with one another, and change links with plain stores. Resizes link
+ * and unlink bucket nodes among the nodes of the table concurrently
+ * with the updater: they set resize_links and wait for a grace period
+ * before changing links, so that updates, which run within read-side
+ * critical sections, use atomic operations until the resize is done.
+ */
+static inline
+int lfht_plain_links(struct cds_lfht *ht)
+{
+	if (!(ht->flags & CDS_LFHT_SINGLE_WRITER))
+		return 0;
+	if (CMM_LOAD_SHARED(ht->resize_links))
+		return 0;
+	/* Read resize_links before the links the last resize changed. */
+	cmm_smp_rmb();
+	return 1;
+}
+
+static
+void resize_links_begin(struct cds_lfht *ht)
+{
+	if (!(ht->flags & CDS_LFHT_SINGLE_WRITER))
+		return;
+	CMM_STORE_SHARED(ht->resize_links, 1);
+	lfht_synchronize_rcu(ht);
+}
+
+static
+void resize_links_end(struct cds_lfht *ht)
+{
+	if (!(ht->flags & CDS_LFHT_SINGLE_WRITER))
+		return;
+	/* Write the links before resize_links. */
+	cmm_smp_wmb();
+	CMM_STORE_SHARED(ht->resize_links, 0);
+}
+
 /*
  * Remove all logically deleted nodes from a bucket up to a certain node key.
+ * plain unlinks them with stores, see lfht_plain_links().
  */
 static
-void _cds_lfht_gc_bucket(struct cds_lfht_node *bucket, struct cds_lfht_node *node)
+void _cds_lfht_gc_bucket(struct cds_lfht *ht, struct cds_lfht_node *bucket,
+		struct cds_lfht_node *node, int plain)
 {
 	struct cds_lfht_node *iter_prev, *iter, *next, *new_next;
+	unsigned long node_rh = node_reverse_hash(ht, node);
 
 	assert(!is_bucket(bucket));
 	assert(!is_removed(bucket));
@@ -938,7 +1311,7 @@ void _cds_lfht_gc_bucket(struct cds_lfht_node *bucket, struct cds_lfht_node *nod
 		iter = rcu_dereference(iter_prev->next);
 		assert(!is_removed(iter));
 		assert(!is_removal_owner(iter));
-		assert(iter_prev->reverse_hash <= node->reverse_hash);
+		assert(_cds_lfht_node_reverse_hash(ht, iter_prev, iter) <= node_rh);
 		/*
 		 * We should never be called with bucket (start of chain)
 		 * and logically removed node (end of path compression
@@ -949,9 +1322,10 @@ void _cds_lfht_gc_bucket(struct cds_lfht_node *bucket, struct cds_lfht_node *nod
 		for (;;) {
 			if (caa_unlikely(is_end(iter)))
 				return;
-			if (caa_likely(clear_flag(iter)->reverse_hash > node->reverse_hash))
-				return;
 			next = rcu_dereference(clear_flag(iter)->next);
+			if (caa_likely(_cds_lfht_node_reverse_hash(ht,
+					clear_flag(iter), next) > node_rh))
+				return;
 			if (caa_likely(is_removed(next)))
 				break;
 			iter_prev = clear_flag(iter);
@@ -963,7 +1337,10 @@ void _cds_lfht_gc_bucket(struct cds_lfht_node *bucket, struct cds_lfht_node *nod
 			new_next = flag_bucket(clear_flag(next));
 		else
 			new_next = clear_flag(next);
-		(void) uatomic_cmpxchg(&iter_prev->next, iter, new_next);
+		if (plain)
+			CMM_STORE_SHARED(iter_prev->next, new_next);
+		else
+			(void) uatomic_cmpxchg(&iter_prev->next, iter, new_next);
 	}
 }
 
@@ -974,6 +1351,7 @@ int _cds_lfht_replace(struct cds_lfht *ht, unsigned long size,
 		struct cds_lfht_node *new_node)
 {
 	struct cds_lfht_node *bucket, *ret_next;
+	int plain;
 
 	if (!old_node)	/* Return -ENOENT if asked to replace NULL node */
 		return -ENOENT;
@@ -985,6 +1363,7 @@ int _cds_lfht_replace(struct cds_lfht *ht, unsigned long size,
 	assert(!is_removal_owner(new_node));
 	assert(!is_bucket(new_node));
 	assert(new_node != old_node);
+	plain = lfht_plain_links(ht);
 	for (;;) {
 		/* Insert after node to be replaced */
 		if (is_removed(old_next)) {
@@ -1018,6 +1397,11 @@ int _cds_lfht_replace(struct cds_lfht *ht, unsigned long size,
 		 * REMOVED and REMOVAL_OWNER flags atomically so we own
 		 * the node after successful cmpxchg.
 		 */
+		if (plain) {
+			rcu_assign_pointer(old_node->next,
+				flag_removed_or_removal_owner(new_node));
+			break;
+		}
 		ret_next = uatomic_cmpxchg(&old_node->next,
 			old_next, flag_removed_or_removal_owner(new_node));
 		if (ret_next == old_next)
@@ -1031,15 +1415,34 @@ int _cds_lfht_replace(struct cds_lfht *ht, unsigned long size,
 	 * logically removed node) if found.
 	 */
 	bucket = lookup_bucket(ht, size, bit_reverse_ulong(old_node->reverse_hash));
-	_cds_lfht_gc_bucket(bucket, new_node);
+	_cds_lfht_gc_bucket(ht, bucket, new_node, plain);
 
 	assert(is_removed(CMM_LOAD_SHARED(old_node->next)));
 	return 0;
 }
 
+/*
+ * lfht_node_ctor: Lazy construction of the node added by "add unique"
+ * mode. The node passed to _cds_lfht_add() is then a probe only holding
+ * the reverse hash, and fct is called once the key is known to be
+ * missing, at the insert position.
+ */
+struct lfht_node_ctor {
+	struct cds_lfht_node *(*fct)(void *arg);
+	void *arg;
+	struct cds_lfht_node *node;	/* Constructed node, NULL until then */
+};
+
 /*
  * A non-NULL unique_ret pointer uses the "add unique" (or uniquify) add
  * mode. A NULL unique_ret allows creation of duplicate keys.
+ *
+ * A non-NULL hint is a node of the same bucket chain with a reverse hash
+ * lower or equal to the one of node: the insert position is searched
+ * from it instead of from the bucket node, as long as it is not removed.
+ *
+ * A non-NULL ctor, only used in "add unique" mode, constructs the node
+ * to add. unique_ret->node is NULL if the constructor fails.
  */
 static
 void _cds_lfht_add(struct cds_lfht *ht,
@@ -1049,15 +1452,23 @@ void _cds_lfht_add(struct cds_lfht *ht,
 		unsigned long size,
 		struct cds_lfht_node *node,
 		struct cds_lfht_iter *unique_ret,
-		int bucket_flag)
+		int bucket_flag,
+		struct cds_lfht_node *hint,
+		struct lfht_node_ctor *ctor)
 {
 	struct cds_lfht_node *iter_prev, *iter, *next, *new_node, *new_next,
 			*return_node;
 	struct cds_lfht_node *bucket;
+	unsigned long node_rh, iter_prev_rh, iter_rh;
+	int plain;
 
 	assert(!is_bucket(node));
 	assert(!is_removed(node));
 	assert(!is_removal_owner(node));
+	/* Resizes link bucket nodes concurrently with the updater. */
+	plain = !bucket_flag && lfht_plain_links(ht);
+	/* Compact bucket nodes do not hold their reverse hash. */
+	node_rh = bucket_flag ? bit_reverse_ulong(hash) : node->reverse_hash;
 	bucket = lookup_bucket(ht, size, hash);
 	for (;;) {
 		uint32_t chain_len = 0;
@@ -1066,28 +1477,40 @@ void _cds_lfht_add(struct cds_lfht *ht,
 		 * iter_prev points to the non-removed node prior to the
 		 * insert location.
 		 */
-		iter_prev = bucket;
-		/* We can always skip the bucket node initially */
-		iter = rcu_dereference(iter_prev->next);
-		assert(iter_prev->reverse_hash <= node->reverse_hash);
+		if (hint) {
+			iter = rcu_dereference(hint->next);
+			if (caa_likely(!is_removed(iter)))
+				iter_prev = hint;
+			else
+				hint = NULL;
+		}
+		if (!hint) {
+			iter_prev = bucket;
+			/* We can always skip the bucket node initially */
+			iter = rcu_dereference(iter_prev->next);
+		}
+		iter_prev_rh = _cds_lfht_node_reverse_hash(ht, iter_prev, iter);
+		assert(iter_prev_rh <= node_rh);
 		for (;;) {
 			if (caa_unlikely(is_end(iter)))
 				goto insert;
-			if (caa_likely(clear_flag(iter)->reverse_hash > node->reverse_hash))
+			next = rcu_dereference(clear_flag(iter)->next);
+			iter_rh = _cds_lfht_node_reverse_hash(ht, clear_flag(iter),
+					next);
+			if (caa_likely(iter_rh > node_rh))
 				goto insert;
 
 			/* bucket node is the first node of the identical-hash-value chain */
-			if (bucket_flag && clear_flag(iter)->reverse_hash == node->reverse_hash)
+			if (bucket_flag && iter_rh == node_rh)
 				goto insert;
 
-			next = rcu_dereference(clear_flag(iter)->next);
 			if (caa_unlikely(is_removed(next)))
 				goto gc_node;
 
 			/* uniquely add */
 			if (unique_ret
 			    && !is_bucket(next)
-			    && clear_flag(iter)->reverse_hash == node->reverse_hash) {
+			    && iter_rh == node_rh) {
 				struct cds_lfht_iter d_iter = {
 					.node = node,
 					.next = iter,
@@ -1105,7 +1528,8 @@ void _cds_lfht_add(struct cds_lfht *ht,
 				 * (including traversing the table node by
 				 * node by forward iterations)
 				 */
-				cds_lfht_next_duplicate(ht, match, key, &d_iter);
+				__cds_lfht_next_duplicate(ht, match, key,
+					node_tag(ht, node), &d_iter);
 				if (!d_iter.node)
 					goto insert;
 
@@ -1114,14 +1538,23 @@ void _cds_lfht_add(struct cds_lfht *ht,
 			}
 
 			/* Only account for identical reverse hash once */
-			if (iter_prev->reverse_hash != clear_flag(iter)->reverse_hash
-			    && !is_bucket(next))
+			if (iter_prev_rh != iter_rh && !is_bucket(next))
 				check_resize(ht, size, ++chain_len);
 			iter_prev = clear_flag(iter);
+			iter_prev_rh = iter_rh;
 			iter = next;
 		}
 
 	insert:
+		if (ctor && !ctor->node) {
+			ctor->node = ctor->fct(ctor->arg);
+			if (!ctor->node) {
+				unique_ret->node = NULL;
+				return;
+			}
+			ctor->node->reverse_hash = node->reverse_hash;
+			node = ctor->node;
+		}
 		assert(node != clear_flag(iter));
 		assert(!is_removed(iter_prev));
 		assert(!is_removal_owner(iter_prev));
@@ -1136,13 +1569,14 @@ void _cds_lfht_add(struct cds_lfht *ht,
 			new_node = flag_bucket(node);
 		else
 			new_node = node;
-		if (uatomic_cmpxchg(&iter_prev->next, iter,
+		if (plain) {
+			rcu_assign_pointer(iter_prev->next, new_node);
+		} else if (uatomic_cmpxchg(&iter_prev->next, iter,
 				    new_node) != iter) {
 			continue;	/* retry */
-		} else {
-			return_node = node;
-			goto end;
 		}
+		return_node = node;
+		goto end;
 
 	gc_node:
 		assert(!is_removed(iter));
@@ -1151,7 +1585,10 @@ void _cds_lfht_add(struct cds_lfht *ht,
 			new_next = flag_bucket(clear_flag(next));
 		else
 			new_next = clear_flag(next);
-		(void) uatomic_cmpxchg(&iter_prev->next, iter, new_next);
+		if (plain)
+			CMM_STORE_SHARED(iter_prev->next, new_next);
+		else
+			(void) uatomic_cmpxchg(&iter_prev->next, iter, new_next);
 		/* retry */
 	}
 end:
@@ -1166,6 +1603,7 @@ int _cds_lfht_del(struct cds_lfht *ht, unsigned long size,
 		struct cds_lfht_node *node)
 {
 	struct cds_lfht_node *bucket, *next;
+	int plain;
 
 	if (!node)	/* Return -ENOENT if asked to delete NULL node */
 		return -ENOENT;
@@ -1185,6 +1623,7 @@ int _cds_lfht_del(struct cds_lfht *ht, unsigned long size,
 	if (caa_unlikely(is_removed(next)))
 		return -ENOENT;
 	assert(!is_bucket(next));
+	plain = lfht_plain_links(ht);
 	/*
 	 * The del operation semantic guarantees a full memory barrier
 	 * before the uatomic_or atomic commit of the deletion flag.
@@ -1205,9 +1644,14 @@ int _cds_lfht_del(struct cds_lfht *ht, unsigned long size,
 	 * if found.
 	 */
 	bucket = lookup_bucket(ht, size, bit_reverse_ulong(node->reverse_hash));
-	_cds_lfht_gc_bucket(bucket, node);
+	_cds_lfht_gc_bucket(ht, bucket, node, plain);
 
 	assert(is_removed(CMM_LOAD_SHARED(node->next)));
+	/* Without concurrent del or replace, we own the node. */
+	if (plain) {
+		CMM_STORE_SHARED(node->next, flag_removal_owner(node->next));
+		return 0;
+	}
 	/*
 	 * Last phase: atomically exchange node->next with a version
 	 * having "REMOVAL_OWNER_FLAG" set. If the returned node->next
@@ -1227,116 +1671,359 @@ int _cds_lfht_del(struct cds_lfht *ht, unsigned long size,
 		return -ENOENT;
 }
 
+/* Block all signals to ensure we don't disturb the application. */
 static
-void *partition_resize_thread(void *arg)
+void block_all_signals(void)
 {
-	struct partition_resize_work *work = arg;
+	int ret;
+	sigset_t mask;
 
-	work->ht->flavor->register_thread();
-	work->fct(work->ht, work->i, work->start, work->len);
-	work->ht->flavor->unregister_thread();
-	return NULL;
+	/* Block signal for entire process, so only our thread processes it. */
+	ret = sigfillset(&mask);
+	if (ret)
+		urcu_die(errno);
+	ret = pthread_sigmask(SIG_BLOCK, &mask, NULL);
+	if (ret)
+		urcu_die(ret);
 }
 
+/*
+ * Claim the next partition of work. Called with the pool lock held, on
+ * a work with unclaimed partitions, which leaves the pool work list
+ * once its last partition is claimed.
+ */
 static
-void partition_resize_helper(struct cds_lfht *ht, unsigned long i,
-		unsigned long len,
-		void (*fct)(struct cds_lfht *ht, unsigned long i,
-			unsigned long start, unsigned long len))
+unsigned long partition_claim(struct partition_resize_work *work)
 {
-	unsigned long partition_len, start = 0;
-	struct partition_resize_work *work;
-	int ret;
-	unsigned long thread, nr_threads;
-
-	assert(nr_cpus_mask != -1);
-	if (nr_cpus_mask < 0 || len < 2 * MIN_PARTITION_PER_THREAD)
-		goto fallback;
-
-	/*
-	 * Note: nr_cpus_mask + 1 is always power of 2.
-	 * We spawn just the number of threads we need to satisfy the minimum
-	 * partition size, up to the number of CPUs in the system.
-	 */
-	if (nr_cpus_mask > 0) {
-		nr_threads = min_t(unsigned long, nr_cpus_mask + 1,
-				 len >> MIN_PARTITION_PER_THREAD_ORDER);
-	} else {
-		nr_threads = 1;
-	}
-	partition_len = len >> cds_lfht_get_count_order_ulong(nr_threads);
-	work = calloc(nr_threads, sizeof(*work));
-	if (!work) {
-		dbg_printf("error allocating for resize, single-threading\n");
-		goto fallback;
-	}
-	for (thread = 0; thread < nr_threads; thread++) {
-		work[thread].ht = ht;
-		work[thread].i = i;
-		work[thread].len = partition_len;
-		work[thread].start = thread * partition_len;
-		work[thread].fct = fct;
-		ret = pthread_create(&(work[thread].thread_id), ht->resize_attr,
-			partition_resize_thread, &work[thread]);
-		if (ret == EAGAIN) {
-			/*
-			 * Out of resources: wait and join the threads
-			 * we've created, then handle leftovers.
-			 */
-			dbg_printf("error spawning for resize, single-threading\n");
-			start = work[thread].start;
-			len -= start;
-			nr_threads = thread;
-			break;
-		}
-		assert(!ret);
-	}
-	for (thread = 0; thread < nr_threads; thread++) {
-		ret = pthread_join(work[thread].thread_id, NULL);
-		assert(!ret);
-	}
-	free(work);
+	unsigned long part = work->next_part++;
 
-	/*
-	 * A pthread_create failure above will either lead in us having
-	 * no threads to join or starting at a non-zero offset,
-	 * fallback to single thread processing of leftovers.
-	 */
-	if (start == 0 && nr_threads > 0)
-		return;
-fallback:
-	fct(ht, i, start, len);
+	if (work->next_part == work->nr_parts)
+		cds_list_del(&work->node);
+	return part;
 }
 
+#if defined(HAVE_SCHED_SETAFFINITY) && SCHED_SETAFFINITY_ARGS == 3 \
+	&& defined(MADV_POPULATE_WRITE)
 /*
- * Holding RCU read lock to protect _cds_lfht_add against memory
- * reclaim that could be performed by other worker threads (ABA
- * problem).
- *
- * When we reach a certain length, we can split this population phase over
- * many worker threads, based on the number of CPUs available in the system.
- * This should therefore take care of not having the expand lagging behind too
- * many concurrent insertion threads by using the scheduler's ability to
- * schedule bucket node population fairly with insertions.
+ * Pool threads processing partitions of a table whose mm plugin spreads
+ * the bucket table over NUMA nodes pin themselves to the CPUs of the
+ * node holding the first bucket of each partition, so its buckets are
+ * node-local. Threads are unpinned when processing partitions of other
+ * tables. The submitting thread keeps its own affinity.
+ */
+struct partition_numa {
+	cpu_set_t allowed;	/* Affinity of the thread at creation */
+	int *cpu_node;		/* Node of the allowed CPUs, on first use */
+	int node;		/* Node the thread is pinned to, or -1 */
+};
+
+static
+int partition_numa_table(struct cds_lfht *ht)
+{
+	return ht->mm == &cds_lfht_mm_hugepage_interleave;
+}
+
+static
+void partition_numa_init(struct partition_numa *numa)
+{
+	numa->cpu_node = NULL;
+	numa->node = -1;
+	if (sched_getaffinity(0, sizeof(numa->allowed), &numa->allowed))
+		CPU_ZERO(&numa->allowed);
+}
+
+static
+void partition_numa_fini(struct partition_numa *numa)
+{
+	free(numa->cpu_node);
+}
+
+/* Node of the first bucket of a partition, -1 if unknown. */
+static
+int partition_numa_node(struct partition_resize_work *work,
+		unsigned long part)
+{
+	uintptr_t page_mask = ~((uintptr_t) getpagesize() - 1);
+	void *page;
+
+	page = (void *) ((uintptr_t) bucket_at(work->ht,
+			work->base + part * work->len) & page_mask);
+	/*
+	 * The buckets of a grow are not touched yet: fault the page in
+	 * for writing, which places it as the table memory policy says
+	 * whichever thread faults it, rather than reading the node of
+	 * the zero page.
+	 */
+	if (madvise(page, getpagesize(), MADV_POPULATE_WRITE))
+		return -1;
+	return urcu_numa_node_of_addr(page);
+}
+
+/*
+ * Pin the thread to the allowed CPUs of a node, or restore its
+ * affinity for node -1. Failure only loses the placement optimization.
+ */
+static
+void partition_numa_pin(struct partition_numa *numa, int node)
+{
+	cpu_set_t mask;
+	int cpu;
+
+	if (node == numa->node)
+		return;
+	if (node >= 0 && !numa->cpu_node) {
+		numa->cpu_node = malloc(CPU_SETSIZE * sizeof(*numa->cpu_node));
+		if (!numa->cpu_node)
+			return;
+		for (cpu = 0; cpu < CPU_SETSIZE; cpu++) {
+			numa->cpu_node[cpu] = CPU_ISSET(cpu, &numa->allowed) ?
+				urcu_numa_node_of_cpu(cpu) : -1;
+		}
+	}
+	CPU_ZERO(&mask);
+	for (cpu = 0; node >= 0 && cpu < CPU_SETSIZE; cpu++) {
+		if (numa->cpu_node[cpu] == node)
+			CPU_SET(cpu, &mask);
+	}
+	if (!CPU_COUNT(&mask)) {
+		/* No allowed CPU on that node. */
+		if (numa->node < 0)
+			return;
+		node = -1;
+		mask = numa->allowed;
+	}
+	if (!sched_setaffinity(0, sizeof(mask), &mask))
+		numa->node = node;
+}
+
+static
+void partition_numa_place(struct partition_numa *numa,
+		struct partition_resize_work *work, unsigned long part)
+{
+	partition_numa_pin(numa, partition_numa_table(work->ht) ?
+			partition_numa_node(work, part) : -1);
+}
+#else
+struct partition_numa {
+	int node;
+};
+
+static
+void partition_numa_init(struct partition_numa *numa)
+{
+}
+
+static
+void partition_numa_fini(struct partition_numa *numa)
+{
+}
+
+static
+void partition_numa_place(struct partition_numa *numa,
+		struct partition_resize_work *work, unsigned long part)
+{
+}
+#endif
+
+static
+void *partition_resize_thread(void *arg)
+{
+	struct cds_lfht_resize_pool *pool = arg;
+	struct partition_resize_work *work;
+	struct partition_numa numa;
+	struct cds_lfht *ht;
+	unsigned long part;
+	int ret;
+
+	block_all_signals();
+	partition_numa_init(&numa);
+	mutex_lock(&pool->lock);
+	for (;;) {
+		while (cds_list_empty(&pool->work) && !pool->stop) {
+			ret = pthread_cond_wait(&pool->work_cond, &pool->lock);
+			if (ret)
+				urcu_die(ret);
+		}
+		if (pool->stop)
+			break;
+		work = cds_list_first_entry(&pool->work,
+				struct partition_resize_work, node);
+		part = partition_claim(work);
+		mutex_unlock(&pool->lock);
+
+		/*
+		 * Pool threads are shared by tables of all flavors:
+		 * register to the flavor of the table for the duration
+		 * of the partition only.
+		 */
+		ht = work->ht;
+		partition_numa_place(&numa, work, part);
+		lfht_register_thread(ht);
+		work->fct(ht, work->i, part * work->len, work->len,
+			work->priv);
+		lfht_unregister_thread(ht);
+
+		mutex_lock(&pool->lock);
+		if (++work->nr_done == work->nr_parts) {
+			ret = pthread_cond_broadcast(&pool->done_cond);
+			if (ret)
+				urcu_die(ret);
+		}
+	}
+	mutex_unlock(&pool->lock);
+	partition_numa_fini(&numa);
+	return NULL;
+}
+
+/*
+ * Grow the pool up to nr_threads threads. Called with the pool lock
+ * held. Running out of threads is not an error: the partitions are then
+ * processed by fewer threads, down to the submitting thread alone.
+ */
+static
+void resize_pool_spawn(struct cds_lfht_resize_pool *pool,
+		unsigned long nr_threads)
+{
+	int ret;
+
+	while (pool->nr_threads < nr_threads) {
+		if (pool->nr_threads == pool->max_threads) {
+			unsigned long max_threads;
+			pthread_t *threads;
+
+			max_threads = max(2 * pool->max_threads, 1UL);
+			threads = realloc(pool->threads,
+				max_threads * sizeof(*threads));
+			if (!threads)
+				break;
+			pool->threads = threads;
+			pool->max_threads = max_threads;
+		}
+		ret = pthread_create(&pool->threads[pool->nr_threads],
+			pool->attr, partition_resize_thread, pool);
+		if (ret) {
+			dbg_printf("error spawning resize thread, %lu in pool\n",
+				pool->nr_threads);
+			break;
+		}
+		pool->nr_threads++;
+	}
+}
+
+/*
+ * Split [0, len) in partitions processed by up to max_threads threads
+ * (a power of 2), each calling fct on its partition. Partitions cover
+ * the buckets from base. The threads of the table resize pool and the
+ * caller process the partitions. Returns the number of partitions.
+ */
+static
+unsigned long partition_helper(struct cds_lfht *ht, unsigned long i,
+		unsigned long base, unsigned long len, unsigned long max_threads,
+		void (*fct)(struct cds_lfht *ht, unsigned long i,
+			unsigned long start, unsigned long len, void *priv),
+		void *priv)
+{
+	struct cds_lfht_resize_pool *pool = ht->resize_pool;
+	struct partition_resize_work work;
+	unsigned long part;
+	int ret;
+
+	if (!pool || max_threads < 1 || len < 2 * MIN_PARTITION_PER_THREAD)
+		goto fallback;
+
+	if (max_threads == 1) {
+		fct(ht, i, 0, len, priv);
+		return 1;
+	}
+	/*
+	 * We split in just the number of partitions we need to satisfy
+	 * the minimum partition size, up to max_threads.
+	 */
+	memset(&work, 0, sizeof(work));
+	work.ht = ht;
+	work.i = i;
+	work.base = base;
+	work.priv = priv;
+	work.fct = fct;
+	work.nr_parts = min_t(unsigned long, max_threads,
+			len >> MIN_PARTITION_PER_THREAD_ORDER);
+	work.len = len >> cds_lfht_get_count_order_ulong(work.nr_parts);
+
+	mutex_lock(&pool->lock);
+	resize_pool_spawn(pool, work.nr_parts - 1);
+	cds_list_add_tail(&work.node, &pool->work);
+	ret = pthread_cond_broadcast(&pool->work_cond);
+	if (ret)
+		urcu_die(ret);
+	/* Process partitions along with the pool threads. */
+	while (work.next_part < work.nr_parts) {
+		part = partition_claim(&work);
+		mutex_unlock(&pool->lock);
+		fct(ht, i, part * work.len, work.len, priv);
+		mutex_lock(&pool->lock);
+		work.nr_done++;
+	}
+	/* Wait for the partitions claimed by pool threads. */
+	while (work.nr_done < work.nr_parts) {
+		ret = pthread_cond_wait(&pool->done_cond, &pool->lock);
+		if (ret)
+			urcu_die(ret);
+	}
+	mutex_unlock(&pool->lock);
+	return work.nr_parts;
+
+fallback:
+	fct(ht, i, 0, len, priv);
+	return 0;
+}
+
+static
+void partition_resize_helper(struct cds_lfht *ht, unsigned long i,
+		unsigned long len,
+		void (*fct)(struct cds_lfht *ht, unsigned long i,
+			unsigned long start, unsigned long len, void *priv))
+{
+	assert(nr_cpus_mask != -1);
+	/* Note: nr_cpus_mask + 1 is always power of 2. */
+	ht->resize_event.nr_threads +=
+		partition_helper(ht, i, 1UL << (i - 1), len, nr_cpus_mask + 1,
+			fct, NULL);
+	ht->resize_event.nr_buckets += len;
+}
+
+/*
+ * Holding RCU read lock to protect _cds_lfht_add against memory
+ * reclaim that could be performed by other worker threads (ABA
+ * problem).
+ *
+ * When we reach a certain length, we can split this population phase over
+ * many worker threads, based on the number of CPUs available in the system.
+ * This should therefore take care of not having the expand lagging behind too
+ * many concurrent insertion threads by using the scheduler's ability to
+ * schedule bucket node population fairly with insertions.
  */
 static
 void init_table_populate_partition(struct cds_lfht *ht, unsigned long i,
-				   unsigned long start, unsigned long len)
+				   unsigned long start, unsigned long len,
+				   void *priv)
 {
 	unsigned long j, size = 1UL << (i - 1);
 
 	assert(i > MIN_TABLE_ORDER);
-	ht->flavor->read_lock();
+	urcu_tp4(lfht_resize_partition, ht, i, start, len);
+	lfht_read_lock(ht);
 	for (j = size + start; j < size + start + len; j++) {
 		struct cds_lfht_node *new_node = bucket_at(ht, j);
 
 		assert(j >= size && j < (size << 1));
 		dbg_printf("init populate: order %lu index %lu hash %lu\n",
 			   i, j, j);
-		new_node->reverse_hash = bit_reverse_ulong(j);
-		_cds_lfht_add(ht, j, NULL, NULL, size, new_node, NULL, 1);
+		if (!ht->compact_buckets)
+			new_node->reverse_hash = bit_reverse_ulong(j);
+		_cds_lfht_add(ht, j, NULL, NULL, size, new_node, NULL, 1, NULL,
+				NULL);
 	}
-	ht->flavor->read_unlock();
+	lfht_read_unlock(ht);
 }
 
 static
@@ -1413,12 +2100,14 @@ void init_table(struct cds_lfht *ht,
  */
 static
 void remove_table_partition(struct cds_lfht *ht, unsigned long i,
-			    unsigned long start, unsigned long len)
+			    unsigned long start, unsigned long len,
+			    void *priv)
 {
 	unsigned long j, size = 1UL << (i - 1);
 
 	assert(i > MIN_TABLE_ORDER);
-	ht->flavor->read_lock();
+	urcu_tp4(lfht_resize_partition, ht, i, start, len);
+	lfht_read_lock(ht);
 	for (j = size + start; j < size + start + len; j++) {
 		struct cds_lfht_node *fini_bucket = bucket_at(ht, j);
 		struct cds_lfht_node *parent_bucket = bucket_at(ht, j - size);
@@ -1428,9 +2117,9 @@ void remove_table_partition(struct cds_lfht *ht, unsigned long i,
 			   i, j, j);
 		/* Set the REMOVED_FLAG to freeze the ->next for gc */
 		uatomic_or(&fini_bucket->next, REMOVED_FLAG);
-		_cds_lfht_gc_bucket(parent_bucket, fini_bucket);
+		_cds_lfht_gc_bucket(ht, parent_bucket, fini_bucket, 0);
 	}
-	ht->flavor->read_unlock();
+	lfht_read_unlock(ht);
 }
 
 static
@@ -1440,61 +2129,63 @@ void remove_table(struct cds_lfht *ht, unsigned long i, unsigned long len)
 }
 
 /*
- * fini_table() is never called for first_order == 0, which is why
- * free_by_rcu_order == 0 can be used as criterion to know if free must
- * be called.
+ * Shrink by removing orders [first_order, last_order] in one batch, so
+ * the shrink waits for two grace periods whatever the number of orders:
+ * the smallest size is published first, and all bucket nodes of the
+ * removed orders are unlinked before their tables are freed together.
+ * Removal proceeds from the highest order down, so each bucket node is
+ * garbage collected from a parent bucket which is not removed yet.
  */
 static
 void fini_table(struct cds_lfht *ht,
 		unsigned long first_order, unsigned long last_order)
 {
-	unsigned long free_by_rcu_order = 0, i;
+	unsigned long i;
 
 	dbg_printf("fini table: first_order %lu last_order %lu\n",
 		   first_order, last_order);
 	assert(first_order > MIN_TABLE_ORDER);
-	for (i = last_order; i >= first_order; i--) {
-		unsigned long len;
-
-		len = 1UL << (i - 1);
-		dbg_printf("fini order %ld len: %lu\n", i, len);
 
-		/* Stop shrink if the resize target changes under us */
+	/* Stop shrink at the resize target if it changes under us */
+	for (i = last_order; i >= first_order; i--) {
 		if (CMM_LOAD_SHARED(ht->resize_target) > (1UL << (i - 1)))
 			break;
+	}
+	first_order = i + 1;
+	if (first_order > last_order
+			|| CMM_LOAD_SHARED(ht->in_progress_destroy))
+		return;
 
-		cmm_smp_wmb();	/* populate data before RCU size */
-		CMM_STORE_SHARED(ht->size, 1UL << (i - 1));
-
-		/*
-		 * We need to wait for all add operations to reach Q.S. (and
-		 * thus use the new table for lookups) before we can start
-		 * releasing the old bucket nodes. Otherwise their lookup will
-		 * return a logically removed node as insert position.
-		 */
-		ht->flavor->update_synchronize_rcu();
-		if (free_by_rcu_order)
-			cds_lfht_free_bucket_table(ht, free_by_rcu_order);
+	cmm_smp_wmb();	/* populate data before RCU size */
+	CMM_STORE_SHARED(ht->size, 1UL << (first_order - 1));
+	dbg_printf("fini new size: %lu\n", 1UL << (first_order - 1));
 
-		/*
-		 * Set "removed" flag in bucket nodes about to be removed.
-		 * Unlink all now-logically-removed bucket node pointers.
-		 * Concurrent add/remove operation are helping us doing
-		 * the gc.
-		 */
-		remove_table(ht, i, len);
-
-		free_by_rcu_order = i;
+	/*
+	 * We need to wait for all add operations to reach Q.S. (and
+	 * thus use the new table for lookups) before we can start
+	 * releasing the old bucket nodes. Otherwise their lookup will
+	 * return a logically removed node as insert position.
+	 */
+	lfht_synchronize_rcu(ht);
+	ht->resize_event.nr_gp_waits++;
 
-		dbg_printf("fini new size: %lu\n", 1UL << i);
-		if (CMM_LOAD_SHARED(ht->in_progress_destroy))
-			break;
+	/*
+	 * Set "removed" flag in bucket nodes about to be removed.
+	 * Unlink all now-logically-removed bucket node pointers.
+	 * Concurrent add/remove operation are helping us doing
+	 * the gc. The published size no longer covers these orders,
+	 * so the removal completes even if a destroy is in progress.
+	 */
+	for (i = last_order; i >= first_order; i--) {
+		dbg_printf("fini order %lu len: %lu\n", i, 1UL << (i - 1));
+		remove_table(ht, i, 1UL << (i - 1));
 	}
 
-	if (free_by_rcu_order) {
-		ht->flavor->update_synchronize_rcu();
-		cds_lfht_free_bucket_table(ht, free_by_rcu_order);
-	}
+	/* Wait for readers of the unlinked bucket nodes. */
+	lfht_synchronize_rcu(ht);
+	ht->resize_event.nr_gp_waits++;
+	for (i = last_order; i >= first_order; i--)
+		cds_lfht_free_bucket_table(ht, i);
 }
 
 /*
@@ -1512,7 +2203,8 @@ void cds_lfht_create_bucket(struct cds_lfht *ht, unsigned long size)
 	dbg_printf("create bucket: order 0 index 0 hash 0\n");
 	node = bucket_at(ht, 0);
 	node->next = flag_bucket(get_end());
-	node->reverse_hash = 0;
+	if (!ht->compact_buckets)
+		node->reverse_hash = 0;
 
 	bucket_order = cds_lfht_get_count_order_ulong(size);
 	assert(bucket_order >= 0);
@@ -1538,7 +2230,8 @@ void cds_lfht_create_bucket(struct cds_lfht *ht, unsigned long size)
 
 			dbg_printf("create bucket: order %lu index %lu hash %lu\n",
 				   order, len + i, len + i);
-			node->reverse_hash = bit_reverse_ulong(len + i);
+			if (!ht->compact_buckets)
+				node->reverse_hash = bit_reverse_ulong(len + i);
 
 			/* insert after prev */
 			assert(is_bucket(prev->next));
@@ -1551,14 +2244,15 @@ void cds_lfht_create_bucket(struct cds_lfht *ht, unsigned long size)
 #if (CAA_BITS_PER_LONG > 32)
 /*
  * For 64-bit architectures, with max number of buckets small enough not to
- * use the entire 64-bit memory mapping space (and allowing a fair number of
- * hash table instances), use the mmap allocator, which is faster. Otherwise,
- * fallback to the order allocator.
+ * use the entire 64-bit memory mapping space, use the mmap allocator, which
+ * is faster. Unbounded tables reserve MMAP_UNBOUNDED_NR_BUCKETS, without
+ * committing memory until the table grows. Otherwise, or if the address
+ * space cannot be reserved, fallback to the order allocator.
  */
 static
 const struct cds_lfht_mm_type *get_mm_type(unsigned long max_nr_buckets)
 {
-	if (max_nr_buckets && max_nr_buckets <= (1ULL << 32))
+	if (max_nr_buckets <= MMAP_MAX_NR_BUCKETS)
 		return &cds_lfht_mm_mmap;
 	else
 		return &cds_lfht_mm_order;
@@ -1581,9 +2275,31 @@ struct cds_lfht *_cds_lfht_new(unsigned long init_size,
 			const struct cds_lfht_mm_type *mm,
 			const struct rcu_flavor_struct *flavor,
 			pthread_attr_t *attr)
+{
+	return _cds_lfht_new_policy(init_size, min_nr_alloc_buckets,
+			max_nr_buckets, flags, mm, flavor, attr, NULL);
+}
+
+struct cds_lfht *_cds_lfht_new_policy(unsigned long init_size,
+			unsigned long min_nr_alloc_buckets,
+			unsigned long max_nr_buckets,
+			int flags,
+			const struct cds_lfht_mm_type *mm,
+			const struct rcu_flavor_struct *flavor,
+			pthread_attr_t *attr,
+			const struct cds_lfht_resize_policy *policy)
 {
 	struct cds_lfht *ht;
 	unsigned long order;
+#if (CAA_BITS_PER_LONG > 32)
+	int default_mm = !mm;
+#endif
+
+	if (!policy)
+		policy = &default_resize_policy;
+	if (!policy->target_load || policy->grow_load < policy->target_load
+			|| !policy->grow_chain_len)
+		return NULL;
 
 	/* min_nr_alloc_buckets must be power of two */
 	if (!min_nr_alloc_buckets || (min_nr_alloc_buckets & (min_nr_alloc_buckets - 1)))
@@ -1599,16 +2315,25 @@ struct cds_lfht *_cds_lfht_new(unsigned long init_size,
 	if (!mm)
 		mm = get_mm_type(max_nr_buckets);
 
+retry:
 	/* max_nr_buckets == 0 for order based mm means infinite */
 	if (mm == &cds_lfht_mm_order && !max_nr_buckets)
 		max_nr_buckets = 1UL << (MAX_TABLE_ORDER - 1);
+#if (CAA_BITS_PER_LONG > 32)
+	/* and for the mmap based mm, as large as their address space allows */
+	if ((mm == &cds_lfht_mm_mmap || mm == &cds_lfht_mm_mmap_compact)
+			&& !max_nr_buckets)
+		max_nr_buckets = MMAP_UNBOUNDED_NR_BUCKETS;
+#endif
 
 	/* max_nr_buckets must be power of two */
 	if (!max_nr_buckets || (max_nr_buckets & (max_nr_buckets - 1)))
 		return NULL;
 
-	if (flags & CDS_LFHT_AUTO_RESIZE)
-		cds_lfht_init_worker(flavor);
+#ifdef CDS_LFHT_FLAVOR_DIRECT
+	if (flavor != &rcu_flavor)
+		return NULL;
+#endif
 
 	min_nr_alloc_buckets = max(min_nr_alloc_buckets, MIN_TABLE_SIZE);
 	init_size = max(init_size, MIN_TABLE_SIZE);
@@ -1616,20 +2341,49 @@ struct cds_lfht *_cds_lfht_new(unsigned long init_size,
 	init_size = min(init_size, max_nr_buckets);
 
 	ht = mm->alloc_cds_lfht(min_nr_alloc_buckets, max_nr_buckets);
-	assert(ht);
+	if (!ht) {
+#if (CAA_BITS_PER_LONG > 32)
+		/* Out of address space for the default mmap based mm. */
+		if (default_mm && mm != &cds_lfht_mm_order) {
+			mm = &cds_lfht_mm_order;
+			if (max_nr_buckets == MMAP_UNBOUNDED_NR_BUCKETS)
+				max_nr_buckets = 0;
+			goto retry;
+		}
+#endif
+		return NULL;
+	}
 	assert(ht->mm == mm);
 	assert(ht->bucket_at == mm->bucket_at);
+	/* The plugin may lower the maximum to the memory it could reserve. */
+	init_size = min(init_size, ht->max_nr_buckets);
+
+	if (flags & CDS_LFHT_AUTO_RESIZE)
+		cds_lfht_init_worker(flavor);
 
 	ht->flags = flags;
 	ht->flavor = flavor;
+	ht->policy = *policy;
 	ht->resize_attr = attr;
+	ht->resize_pool = cds_lfht_get_resize_pool(flavor, attr);
 	alloc_split_items_count(ht);
+	/* Resizes then do not create threads, up to one per CPU. */
+	if ((flags & CDS_LFHT_PREALLOC) && ht->resize_pool
+			&& nr_cpus_mask > 0) {
+		mutex_lock(&ht->resize_pool->lock);
+		resize_pool_spawn(ht->resize_pool, nr_cpus_mask);
+		mutex_unlock(&ht->resize_pool->lock);
+	}
 	/* this mutex should not nest in read-side C.S. */
 	pthread_mutex_init(&ht->resize_mutex, NULL);
+	pthread_mutex_init(&ht->resize_stats_mutex, NULL);
 	order = cds_lfht_get_count_order_ulong(init_size);
 	ht->resize_target = 1UL << order;
 	cds_lfht_create_bucket(ht, 1UL << order);
 	ht->size = 1UL << order;
+	mutex_lock(&cds_lfht_tables_mutex);
+	cds_list_add_tail(&ht->table_node, &cds_lfht_tables);
+	mutex_unlock(&cds_lfht_tables_mutex);
 	return ht;
 }
 
@@ -1637,74 +2391,85 @@ void cds_lfht_lookup(struct cds_lfht *ht, unsigned long hash,
 		cds_lfht_match_fct match, const void *key,
 		struct cds_lfht_iter *iter)
 {
-	struct cds_lfht_node *node, *next, *bucket;
-	unsigned long reverse_hash, size;
+	struct cds_lfht_node *node, *bucket;
+	unsigned long size;
 
 	cds_lfht_iter_debug_set_ht(ht, iter);
 
-	reverse_hash = bit_reverse_ulong(hash);
+	size = rcu_dereference(ht->size);
+	bucket = lookup_bucket(ht, size, hash);
+	/* We can always skip the bucket node initially */
+	node = rcu_dereference(bucket->next);
+	node = clear_flag(node);
+	__cds_lfht_lookup_chain(ht, node, bit_reverse_ulong(hash), match, key,
+			NULL, iter);
+}
+
+void cds_lfht_lookup_tag(struct cds_lfht *ht, unsigned long hash,
+		unsigned long tag, cds_lfht_match_fct match, const void *key,
+		struct cds_lfht_iter *iter)
+{
+	struct cds_lfht_node *node, *bucket;
+	unsigned long size;
+
+	assert(ht->flags & CDS_LFHT_NODE_TAG);
+	cds_lfht_iter_debug_set_ht(ht, iter);
 
 	size = rcu_dereference(ht->size);
 	bucket = lookup_bucket(ht, size, hash);
 	/* We can always skip the bucket node initially */
 	node = rcu_dereference(bucket->next);
 	node = clear_flag(node);
-	for (;;) {
-		if (caa_unlikely(is_end(node))) {
-			node = next = NULL;
-			break;
+	__cds_lfht_lookup_chain(ht, node, bit_reverse_ulong(hash), match, key,
+			&tag, iter);
+}
+
+void cds_lfht_lookup_batch(struct cds_lfht *ht, unsigned long nr,
+		const unsigned long *hashes, cds_lfht_match_fct match,
+		const void * const *keys, struct cds_lfht_iter *iters)
+{
+	struct cds_lfht_node *nodes[LOOKUP_BATCH_SIZE];
+	unsigned long rev[LOOKUP_BATCH_SIZE];
+	unsigned long i, j, batch, size;
+
+	size = rcu_dereference(ht->size);
+	for (i = 0; i < nr; i += batch) {
+		batch = caa_min(nr - i, (unsigned long) LOOKUP_BATCH_SIZE);
+
+		/* Stage 1: locate and prefetch the bucket nodes. */
+		for (j = 0; j < batch; j++) {
+			nodes[j] = lookup_bucket(ht, size, hashes[i + j]);
+			caa_prefetch(nodes[j]);
 		}
-		if (caa_unlikely(node->reverse_hash > reverse_hash)) {
-			node = next = NULL;
-			break;
+		bit_reverse_batch(rev, &hashes[i], batch);
+		/* Stage 2: prefetch the first node of each chain. */
+		for (j = 0; j < batch; j++) {
+			/* We can always skip the bucket node initially */
+			nodes[j] = clear_flag(rcu_dereference(nodes[j]->next));
+			if (!is_end(nodes[j]))
+				caa_prefetch(nodes[j]);
 		}
-		next = rcu_dereference(node->next);
-		assert(node == clear_flag(node));
-		if (caa_likely(!is_removed(next))
-		    && !is_bucket(next)
-		    && node->reverse_hash == reverse_hash
-		    && caa_likely(match(node, key))) {
-				break;
+		/* Stage 3: walk the chains. */
+		for (j = 0; j < batch; j++) {
+			cds_lfht_iter_debug_set_ht(ht, &iters[i + j]);
+			__cds_lfht_lookup_chain(ht, nodes[j], rev[j],
+				match, keys[i + j], NULL, &iters[i + j]);
 		}
-		node = clear_flag(next);
 	}
-	assert(!node || !is_bucket(CMM_LOAD_SHARED(node->next)));
-	iter->node = node;
-	iter->next = next;
 }
 
 void cds_lfht_next_duplicate(struct cds_lfht *ht, cds_lfht_match_fct match,
 		const void *key, struct cds_lfht_iter *iter)
 {
-	struct cds_lfht_node *node, *next;
-	unsigned long reverse_hash;
-
-	cds_lfht_iter_debug_assert(ht == iter->lfht);
-	node = iter->node;
-	reverse_hash = node->reverse_hash;
-	next = iter->next;
-	node = clear_flag(next);
+	__cds_lfht_next_duplicate(ht, match, key, NULL, iter);
+}
 
-	for (;;) {
-		if (caa_unlikely(is_end(node))) {
-			node = next = NULL;
-			break;
-		}
-		if (caa_unlikely(node->reverse_hash > reverse_hash)) {
-			node = next = NULL;
-			break;
-		}
-		next = rcu_dereference(node->next);
-		if (caa_likely(!is_removed(next))
-		    && !is_bucket(next)
-		    && caa_likely(match(node, key))) {
-				break;
-		}
-		node = clear_flag(next);
-	}
-	assert(!node || !is_bucket(CMM_LOAD_SHARED(node->next)));
-	iter->node = node;
-	iter->next = next;
+void cds_lfht_next_duplicate_tag(struct cds_lfht *ht, unsigned long tag,
+		cds_lfht_match_fct match, const void *key,
+		struct cds_lfht_iter *iter)
+{
+	assert(ht->flags & CDS_LFHT_NODE_TAG);
+	__cds_lfht_next_duplicate(ht, match, key, &tag, iter);
 }
 
 void cds_lfht_next(struct cds_lfht *ht, struct cds_lfht_iter *iter)
@@ -1741,32 +2506,355 @@ void cds_lfht_first(struct cds_lfht *ht, struct cds_lfht_iter *iter)
 	cds_lfht_next(ht, iter);
 }
 
-void cds_lfht_add(struct cds_lfht *ht, unsigned long hash,
+void cds_lfht_iter_from(struct cds_lfht *ht, unsigned long first,
+		struct cds_lfht_iter *iter)
+{
+	struct cds_lfht_node *bucket;
+	unsigned long size;
+
+	cds_lfht_iter_debug_set_ht(ht, iter);
+	/*
+	 * The bucket covering first has a reverse hash lower or equal to
+	 * first, and the nodes following it are sorted by reverse hash.
+	 */
+	size = rcu_dereference(ht->size);
+	bucket = lookup_bucket(ht, size, bit_reverse_ulong(first));
+	iter->next = rcu_dereference(bucket->next);
+	do {
+		cds_lfht_next(ht, iter);
+	} while (iter->node && iter->node->reverse_hash < first);
+}
+
+/*
+ * Ends the traversal if the current node is past last.
+ */
+static
+void cds_lfht_range_end(unsigned long last, struct cds_lfht_iter *iter)
+{
+	if (iter->node && iter->node->reverse_hash > last)
+		iter->node = iter->next = NULL;
+}
+
+void cds_lfht_first_range(struct cds_lfht *ht, unsigned long first,
+		unsigned long last, struct cds_lfht_iter *iter)
+{
+	cds_lfht_iter_from(ht, first, iter);
+	cds_lfht_range_end(last, iter);
+}
+
+void cds_lfht_next_range(struct cds_lfht *ht, unsigned long last,
+		struct cds_lfht_iter *iter)
+{
+	cds_lfht_next(ht, iter);
+	cds_lfht_range_end(last, iter);
+}
+
+void cds_lfht_cursor_resume(struct cds_lfht *ht,
+		struct cds_lfht_cursor *cursor, struct cds_lfht_iter *iter)
+{
+	struct cds_lfht_iter first;
+	unsigned long index = 0;
+
+	switch (cursor->state) {
+	case CDS_LFHT_CURSOR_START:
+		cds_lfht_first(ht, iter);
+		return;
+	case CDS_LFHT_CURSOR_END:
+		cds_lfht_iter_debug_set_ht(ht, iter);
+		iter->node = iter->next = NULL;
+		return;
+	}
+	/*
+	 * Skip the nodes sharing the reverse hash of the last visited
+	 * node, up to it, if it is still at the same index among them.
+	 * Only its address is compared: it may have been freed, or
+	 * removed and added again, since.
+	 */
+	cds_lfht_iter_from(ht, cursor->reverse_hash, iter);
+	first = *iter;
+	while (iter->node && iter->node->reverse_hash == cursor->reverse_hash
+			&& index <= cursor->index) {
+		if (iter->node == cursor->node && index == cursor->index) {
+			cds_lfht_next(ht, iter);
+			return;
+		}
+		cds_lfht_next(ht, iter);
+		index++;
+	}
+	*iter = first;
+}
+
+void cds_lfht_cursor_save(struct cds_lfht *ht, struct cds_lfht_cursor *cursor,
+		struct cds_lfht_iter *iter)
+{
+	struct cds_lfht_node *node = cds_lfht_iter_get_node(iter);
+	struct cds_lfht_iter pos;
+
+	if (!node) {
+		cursor->state = CDS_LFHT_CURSOR_END;
+		return;
+	}
+	cursor->reverse_hash = node->reverse_hash;
+	cursor->node = node;
+	cursor->index = 0;
+	cds_lfht_iter_from(ht, node->reverse_hash, &pos);
+	while (pos.node && pos.node != node) {
+		cds_lfht_next(ht, &pos);
+		cursor->index++;
+	}
+	cursor->state = CDS_LFHT_CURSOR_SAVED;
+}
+
+struct for_each_parallel_arg {
+	void (*fn)(struct cds_lfht *ht, struct cds_lfht_node *node, void *arg);
+	void *arg;
+};
+
+/*
+ * Partition [start, start + len) of the 2^i buckets of the table. The
+ * nodes belonging to bucket j form the reverse hash range starting at
+ * bit_reverse_ulong(j), so the traversal is not affected by concurrent
+ * resizes. The read-side lock is released between buckets.
+ */
+static
+void for_each_parallel_partition(struct cds_lfht *ht, unsigned long i,
+		unsigned long start, unsigned long len, void *priv)
+{
+	struct for_each_parallel_arg *fe = priv;
+	unsigned long j, first, last, mask = ~0UL >> i;
+	struct cds_lfht_iter iter;
+	struct cds_lfht_node *node;
+
+	for (j = start; j < start + len; j++) {
+		first = bit_reverse_ulong(j);
+		last = first | mask;
+		lfht_read_lock(ht);
+		cds_lfht_for_each_range(ht, first, last, &iter, node)
+			fe->fn(ht, node, fe->arg);
+		lfht_read_unlock(ht);
+		lfht_quiescent_state(ht);
+	}
+}
+
+void cds_lfht_for_each_parallel(struct cds_lfht *ht, unsigned long nr_threads,
+		void (*fn)(struct cds_lfht *ht, struct cds_lfht_node *node,
+			void *arg),
+		void *arg)
+{
+	struct for_each_parallel_arg fe = {
+		.fn = fn,
+		.arg = arg,
+	};
+	unsigned long size, order;
+
+	if (!nr_threads) {
+		assert(nr_cpus_mask != -1);
+		nr_threads = nr_cpus_mask < 0 ? 1 : nr_cpus_mask + 1;
+	}
+	/* Round down to a power of 2. */
+	nr_threads = 1UL << (cds_lfht_fls_ulong(nr_threads) - 1);
+	size = CMM_LOAD_SHARED(ht->size);
+	order = cds_lfht_get_count_order_ulong(size);
+	partition_helper(ht, order, 0, size, nr_threads,
+			for_each_parallel_partition, &fe);
+}
+
+void cds_lfht_add(struct cds_lfht *ht, unsigned long hash,
+		struct cds_lfht_node *node)
+{
+	unsigned long size;
+
+	node->reverse_hash = bit_reverse_ulong(hash);
+	size = rcu_dereference(ht->size);
+	_cds_lfht_add(ht, hash, NULL, NULL, size, node, NULL, 0, NULL, NULL);
+	ht_count_add(ht, size, hash);
+}
+
+/*
+ * Sort node pointers by increasing reverse hash, NULL entries first.
+ */
+static
+int cmp_node_reverse_hash(const void *a, const void *b)
+{
+	const struct cds_lfht_node *node_a = *(struct cds_lfht_node * const *) a;
+	const struct cds_lfht_node *node_b = *(struct cds_lfht_node * const *) b;
+
+	if (!node_a || !node_b)
+		return (node_b == NULL) - (node_a == NULL);
+	if (node_a->reverse_hash < node_b->reverse_hash)
+		return -1;
+	return node_a->reverse_hash > node_b->reverse_hash;
+}
+
+void cds_lfht_add_bulk(struct cds_lfht *ht, struct cds_lfht_node **nodes,
+		const unsigned long *hashes, unsigned long nr)
+{
+	struct cds_lfht_node *bucket, *prev_bucket = NULL, *hint = NULL;
+	unsigned long i, size, hash;
+	int sorted = 1;
+
+	if (!nr)
+		return;
+	for (i = 0; i < nr; i++) {
+		nodes[i]->reverse_hash = bit_reverse_ulong(hashes[i]);
+		if (i && nodes[i]->reverse_hash < nodes[i - 1]->reverse_hash)
+			sorted = 0;
+	}
+	/* Nodes restored from a dump already come in list order. */
+	if (!sorted)
+		qsort(nodes, nr, sizeof(*nodes), cmp_node_reverse_hash);
+
+	/* Grow once for the whole batch rather than as it is added. */
+	if (ht->flags & CDS_LFHT_AUTO_RESIZE)
+		cds_lfht_resize_grow(ht, (uatomic_read(&ht->count) + nr)
+				/ ht->policy.target_load);
+
+	lfht_read_lock(ht);
+	size = rcu_dereference(ht->size);
+	for (i = 0; i < nr; i++) {
+		hash = bit_reverse_ulong(nodes[i]->reverse_hash);
+		bucket = lookup_bucket(ht, size, hash);
+		/*
+		 * Nodes of a bucket come in chain order: link each one
+		 * after the previous one.
+		 */
+		if (bucket != prev_bucket)
+			hint = NULL;
+		_cds_lfht_add(ht, hash, NULL, NULL, size, nodes[i], NULL, 0,
+				hint, NULL);
+		prev_bucket = bucket;
+		hint = nodes[i];
+	}
+	ht_count_add_bulk(ht, size, hash, nr);
+	lfht_read_unlock(ht);
+}
+
+struct cds_lfht_node *cds_lfht_add_unique(struct cds_lfht *ht,
+				unsigned long hash,
+				cds_lfht_match_fct match,
+				const void *key,
+				struct cds_lfht_node *node)
+{
+	unsigned long size;
+	struct cds_lfht_iter iter;
+
+	node->reverse_hash = bit_reverse_ulong(hash);
+	size = rcu_dereference(ht->size);
+	_cds_lfht_add(ht, hash, match, key, size, node, &iter, 0, NULL, NULL);
+	if (iter.node == node)
+		ht_count_add(ht, size, hash);
+	return iter.node;
+}
+
+struct cds_lfht_node *cds_lfht_lookup_or_add(struct cds_lfht *ht,
+				unsigned long hash,
+				cds_lfht_match_fct match,
+				const void *key,
+				struct cds_lfht_node *(*ctor)(void *arg),
+				void (*dtor)(struct cds_lfht_node *node, void *arg),
+				void *arg)
+{
+	struct lfht_node_ctor node_ctor = {
+		.fct = ctor,
+		.arg = arg,
+	};
+	struct cds_lfht_node probe = {
+		.reverse_hash = bit_reverse_ulong(hash),
+	};
+	unsigned long size;
+	struct cds_lfht_iter iter;
+
+	if (ht->flags & CDS_LFHT_NODE_TAG)
+		return NULL;
+	size = rcu_dereference(ht->size);
+	_cds_lfht_add(ht, hash, match, key, size, &probe, &iter, 0, NULL,
+			&node_ctor);
+	if (iter.node && iter.node == node_ctor.node) {
+		ht_count_add(ht, size, hash);
+	} else if (node_ctor.node && dtor) {
+		/* Lost a race with a concurrent add of the key. */
+		dtor(node_ctor.node, arg);
+	}
+	return iter.node;
+}
+
+/*
+ * Add to a table no other thread can access: the chain is walked and
+ * the node linked with plain stores, without chain length accounting.
+ * Return the node already present for unique adds, else the node added.
+ */
+static
+struct cds_lfht_node *_cds_lfht_add_offline(struct cds_lfht *ht,
+		unsigned long hash,
+		cds_lfht_match_fct match,
+		const void *key,
+		struct cds_lfht_node *node,
+		int unique)
+{
+	struct cds_lfht_node *iter_prev, *iter, *next;
+	unsigned long iter_rh;
+
+	assert(!is_bucket(node));
+	node->reverse_hash = bit_reverse_ulong(hash);
+	iter_prev = lookup_bucket(ht, ht->size, hash);
+	iter = iter_prev->next;
+	for (;;) {
+		if (is_end(iter))
+			break;
+		next = clear_flag(iter)->next;
+		iter_rh = _cds_lfht_node_reverse_hash(ht, clear_flag(iter), next);
+		if (iter_rh > node->reverse_hash)
+			break;
+		if (caa_unlikely(is_removed(next))) {
+			/* Unlink nodes deleted before publication. */
+			if (is_bucket(iter))
+				iter = flag_bucket(clear_flag(next));
+			else
+				iter = clear_flag(next);
+			iter_prev->next = iter;
+			continue;
+		}
+		if (unique && !is_bucket(next)
+		    && iter_rh == node->reverse_hash) {
+			struct cds_lfht_iter d_iter = {
+				.node = node,
+				.next = iter,
+#ifdef CONFIG_CDS_LFHT_ITER_DEBUG
+				.lfht = ht,
+#endif
+			};
+
+			__cds_lfht_next_duplicate(ht, match, key,
+				node_tag(ht, node), &d_iter);
+			if (d_iter.node)
+				return d_iter.node;
+			break;
+		}
+		iter_prev = clear_flag(iter);
+		iter = next;
+	}
+	node->next = clear_flag(iter);
+	if (is_bucket(iter))
+		iter_prev->next = flag_bucket(node);
+	else
+		iter_prev->next = node;
+	ht_count_add_offline(ht, hash);
+	return node;
+}
+
+void cds_lfht_add_offline(struct cds_lfht *ht, unsigned long hash,
 		struct cds_lfht_node *node)
 {
-	unsigned long size;
-
-	node->reverse_hash = bit_reverse_ulong(hash);
-	size = rcu_dereference(ht->size);
-	_cds_lfht_add(ht, hash, NULL, NULL, size, node, NULL, 0);
-	ht_count_add(ht, size, hash);
+	(void) _cds_lfht_add_offline(ht, hash, NULL, NULL, node, 0);
 }
 
-struct cds_lfht_node *cds_lfht_add_unique(struct cds_lfht *ht,
+struct cds_lfht_node *cds_lfht_add_unique_offline(struct cds_lfht *ht,
 				unsigned long hash,
 				cds_lfht_match_fct match,
 				const void *key,
 				struct cds_lfht_node *node)
 {
-	unsigned long size;
-	struct cds_lfht_iter iter;
-
-	node->reverse_hash = bit_reverse_ulong(hash);
-	size = rcu_dereference(ht->size);
-	_cds_lfht_add(ht, hash, match, key, size, node, &iter, 0);
-	if (iter.node == node)
-		ht_count_add(ht, size, hash);
-	return iter.node;
+	return _cds_lfht_add_offline(ht, hash, match, key, node, 1);
 }
 
 struct cds_lfht_node *cds_lfht_add_replace(struct cds_lfht *ht,
@@ -1781,7 +2869,8 @@ struct cds_lfht_node *cds_lfht_add_replace(struct cds_lfht *ht,
 	node->reverse_hash = bit_reverse_ulong(hash);
 	size = rcu_dereference(ht->size);
 	for (;;) {
-		_cds_lfht_add(ht, hash, match, key, size, node, &iter, 0);
+		_cds_lfht_add(ht, hash, match, key, size, node, &iter, 0, NULL,
+				NULL);
 		if (iter.node == node) {
 			ht_count_add(ht, size, hash);
 			return NULL;
@@ -1806,6 +2895,8 @@ int cds_lfht_replace(struct cds_lfht *ht,
 		return -ENOENT;
 	if (caa_unlikely(old_iter->node->reverse_hash != new_node->reverse_hash))
 		return -EINVAL;
+	if (caa_unlikely(!tag_match(old_iter->node, node_tag(ht, new_node))))
+		return -EINVAL;
 	if (caa_unlikely(!match(old_iter->node, key)))
 		return -EINVAL;
 	size = rcu_dereference(ht->size);
@@ -1829,6 +2920,83 @@ int cds_lfht_del(struct cds_lfht *ht, struct cds_lfht_node *node)
 	return ret;
 }
 
+unsigned long cds_lfht_del_bulk(struct cds_lfht *ht,
+		struct cds_lfht_node **nodes, unsigned long nr)
+{
+	struct cds_lfht_node *bucket, *next;
+	unsigned long i, j, size, hash = 0, count = 0;
+	int plain;
+
+	qsort(nodes, nr, sizeof(*nodes), cmp_node_reverse_hash);
+	size = rcu_dereference(ht->size);
+	plain = lfht_plain_links(ht);
+
+	/*
+	 * Logically delete all nodes first. See _cds_lfht_del() for the
+	 * removal protocol.
+	 */
+	cmm_smp_mb__before_uatomic_or();
+	for (i = 0; i < nr; i++) {
+		if (!nodes[i])
+			continue;
+		assert(!is_bucket(nodes[i]));
+		assert(!is_removed(nodes[i]));
+		assert(!is_removal_owner(nodes[i]));
+		next = CMM_LOAD_SHARED(nodes[i]->next);
+		if (caa_unlikely(is_removed(next))) {
+			nodes[i] = NULL;
+			continue;
+		}
+		assert(!is_bucket(next));
+		uatomic_or(&nodes[i]->next, REMOVED_FLAG);
+	}
+
+	/*
+	 * Unlink them: a single garbage collection up to the last node
+	 * of each bucket removes all the nodes of the batch it holds.
+	 */
+	for (i = 0; i < nr; i = j) {
+		struct cds_lfht_node *last;
+
+		j = i + 1;
+		last = nodes[i];
+		if (!last)
+			continue;
+		bucket = lookup_bucket(ht, size,
+				bit_reverse_ulong(last->reverse_hash));
+		for (; j < nr; j++) {
+			if (!nodes[j])
+				continue;
+			if (lookup_bucket(ht, size,
+				bit_reverse_ulong(nodes[j]->reverse_hash))
+					!= bucket)
+				break;
+			last = nodes[j];
+		}
+		_cds_lfht_gc_bucket(ht, bucket, last, plain);
+	}
+
+	/* Take ownership of the removals, as _cds_lfht_del() does. */
+	for (i = 0; i < nr; i++) {
+		if (!nodes[i])
+			continue;
+		assert(is_removed(CMM_LOAD_SHARED(nodes[i]->next)));
+		if (plain) {
+			CMM_STORE_SHARED(nodes[i]->next,
+				flag_removal_owner(nodes[i]->next));
+		} else if (is_removal_owner(uatomic_xchg(&nodes[i]->next,
+				flag_removal_owner(nodes[i]->next)))) {
+			nodes[i] = NULL;
+			continue;
+		}
+		hash = bit_reverse_ulong(nodes[i]->reverse_hash);
+		count++;
+	}
+	if (count)
+		ht_count_del_bulk(ht, size, hash, count);
+	return count;
+}
+
 int cds_lfht_is_node_deleted(struct cds_lfht_node *node)
 {
 	return is_removed(CMM_LOAD_SHARED(node->next));
@@ -1858,7 +3026,7 @@ int cds_lfht_delete_bucket(struct cds_lfht *ht)
 	for (i = 0; i < size; i++) {
 		node = bucket_at(ht, i);
 		dbg_printf("delete bucket: index %lu expected hash %lu hash %lu\n",
-			i, i, bit_reverse_ulong(node->reverse_hash));
+			i, i, bit_reverse_ulong(node_reverse_hash(ht, node)));
 		assert(is_bucket(node->next));
 	}
 
@@ -1880,23 +3048,279 @@ int cds_lfht_destroy(struct cds_lfht *ht, pthread_attr_t **attr)
 		/* Cancel ongoing resize operations. */
 		_CMM_STORE_SHARED(ht->in_progress_destroy, 1);
 		/* Wait for in-flight resize operations to complete */
-		urcu_workqueue_flush_queued_work(cds_lfht_workqueue);
+		urcu_workqueue_flush_queued_work(cds_lfht_get_workqueue());
 	}
 	ret = cds_lfht_delete_bucket(ht);
 	if (ret)
 		return ret;
+	mutex_lock(&cds_lfht_tables_mutex);
+	cds_list_del(&ht->table_node);
+	mutex_unlock(&cds_lfht_tables_mutex);
 	free_split_items_count(ht);
 	if (attr)
 		*attr = ht->resize_attr;
 	ret = pthread_mutex_destroy(&ht->resize_mutex);
 	if (ret)
 		ret = -EBUSY;
+	if (pthread_mutex_destroy(&ht->resize_stats_mutex))
+		ret = -EBUSY;
 	if (ht->flags & CDS_LFHT_AUTO_RESIZE)
 		cds_lfht_fini_worker(ht->flavor);
+	cds_lfht_put_resize_pool(ht->flavor, ht->resize_pool);
 	poison_free(ht);
 	return ret;
 }
 
+/*
+ * destroy_async_work: State of cds_lfht_destroy_async(), carried from
+ * the node removal to the table destruction by call_rcu.
+ */
+struct destroy_async_work {
+	struct rcu_head head;
+	struct cds_lfht *ht;
+	struct cds_lfht_node **nodes;	/* Removed, awaiting free_node */
+	unsigned long nr_nodes, max_nodes;
+	void (*free_node)(struct cds_lfht_node *node, void *priv);
+	void (*done)(int ret, pthread_attr_t *attr, void *priv);
+	void *priv;
+};
+
+static
+void destroy_async_free_nodes(struct destroy_async_work *work)
+{
+	unsigned long i;
+
+	if (work->free_node) {
+		for (i = 0; i < work->nr_nodes; i++)
+			work->free_node(work->nodes[i], work->priv);
+	}
+	work->nr_nodes = 0;
+}
+
+/*
+ * Keep a removed node until a grace period has elapsed. If out of
+ * memory, wait for the grace period right away to free the nodes kept
+ * so far, and this one, instead.
+ */
+static
+void destroy_async_keep_node(struct destroy_async_work *work,
+		struct cds_lfht_node *node)
+{
+	if (work->nr_nodes == work->max_nodes) {
+		unsigned long max_nodes;
+		struct cds_lfht_node **nodes;
+
+		max_nodes = max(2 * work->max_nodes, 64UL);
+		nodes = realloc(work->nodes, max_nodes * sizeof(*nodes));
+		if (!nodes) {
+			lfht_read_unlock(work->ht);
+			lfht_synchronize_rcu(work->ht);
+			destroy_async_free_nodes(work);
+			if (work->free_node)
+				work->free_node(node, work->priv);
+			lfht_read_lock(work->ht);
+			return;
+		}
+		work->nodes = nodes;
+		work->max_nodes = max_nodes;
+	}
+	work->nodes[work->nr_nodes++] = node;
+}
+
+/* Second stage, after a grace period: free the nodes and the table. */
+static
+void destroy_async_free_cb(struct rcu_head *head)
+{
+	struct destroy_async_work *work =
+		caa_container_of(head, struct destroy_async_work, head);
+	pthread_attr_t *attr = NULL;
+	int ret;
+
+	destroy_async_free_nodes(work);
+	ret = cds_lfht_destroy(work->ht, &attr);
+	if (work->done)
+		work->done(ret, attr, work->priv);
+	free(work->nodes);
+	poison_free(work);
+}
+
+/* First stage, from the call_rcu worker thread: remove all nodes. */
+static
+void destroy_async_remove_cb(struct rcu_head *head)
+{
+	struct destroy_async_work *work =
+		caa_container_of(head, struct destroy_async_work, head);
+	struct cds_lfht *ht = work->ht;
+	struct cds_lfht_iter iter;
+	struct cds_lfht_node *node;
+
+	lfht_read_lock(ht);
+	cds_lfht_for_each(ht, &iter, node) {
+		if (!cds_lfht_del(ht, node))
+			destroy_async_keep_node(work, node);
+	}
+	lfht_read_unlock(ht);
+	lfht_call_rcu(ht, &work->head, destroy_async_free_cb);
+}
+
+static
+struct destroy_async_work *destroy_async_alloc(
+		void (*free_node)(struct cds_lfht_node *node, void *priv),
+		void (*done)(int ret, pthread_attr_t *attr, void *priv),
+		void *priv)
+{
+	struct destroy_async_work *work;
+
+	work = calloc(1, sizeof(*work));
+	if (!work)
+		return NULL;
+	work->free_node = free_node;
+	work->done = done;
+	work->priv = priv;
+	return work;
+}
+
+static
+void destroy_async_start(struct cds_lfht *ht, struct destroy_async_work *work)
+{
+	work->ht = ht;
+	/* Cancel ongoing resize operations. */
+	_CMM_STORE_SHARED(ht->in_progress_destroy, 1);
+	lfht_call_rcu(ht, &work->head, destroy_async_remove_cb);
+}
+
+int cds_lfht_destroy_async(struct cds_lfht *ht,
+		void (*free_node)(struct cds_lfht_node *node, void *priv),
+		void (*done)(int ret, pthread_attr_t *attr, void *priv),
+		void *priv)
+{
+	struct destroy_async_work *work;
+
+	work = destroy_async_alloc(free_node, done, priv);
+	if (!work)
+		return -ENOMEM;
+	destroy_async_start(ht, work);
+	return 0;
+}
+
+int cds_lfht_publish(struct cds_lfht **ptr, struct cds_lfht *ht,
+		void (*free_node)(struct cds_lfht_node *node, void *priv),
+		void (*done)(int ret, pthread_attr_t *attr, void *priv),
+		void *priv)
+{
+	struct destroy_async_work *work;
+	struct cds_lfht *old;
+
+	/* Allocate first: once published, there is no going back. */
+	work = destroy_async_alloc(free_node, done, priv);
+	if (!work)
+		return -ENOMEM;
+	/* The exchange orders the offline stores before publication. */
+	old = rcu_xchg_pointer(ptr, ht);
+	if (old)
+		destroy_async_start(old, work);
+	else
+		free(work);
+	return 0;
+}
+
+static
+long split_count_sum(struct cds_lfht *ht)
+{
+	long count = 0;
+	int i;
+
+	if (!ht->split_count)
+		return 0;
+	for (i = 0; i < split_count_mask + 1; i++) {
+		count += uatomic_read(&ht->split_count[i].add);
+		count -= uatomic_read(&ht->split_count[i].del);
+	}
+	return count;
+}
+
+int cds_lfht_count_split(struct cds_lfht *ht, long *count)
+{
+	if (!ht->split_count)
+		return -EINVAL;
+	*count = split_count_sum(ht);
+	return 0;
+}
+
+/*
+ * Each split-counter commits its adds and its removals separately, in
+ * batches of 1UL << COUNT_COMMIT_ORDER: the global counter lags the sum
+ * of each add/remove pair by less than one batch.
+ */
+int cds_lfht_count_global(struct cds_lfht *ht, long *count,
+		unsigned long *max_error)
+{
+	if (!ht->split_count)
+		return -EINVAL;
+	*count = (long) uatomic_read(&ht->count);
+	if (max_error)
+		*max_error = (split_count_mask + 1)
+			* ((1UL << COUNT_COMMIT_ORDER) - 1);
+	return 0;
+}
+
+void cds_lfht_for_each_table(void (*func)(struct cds_lfht *ht,
+			const struct cds_lfht_info *info, void *priv),
+		void *priv)
+{
+	struct cds_lfht *ht;
+	struct cds_lfht_info info;
+
+	mutex_lock(&cds_lfht_tables_mutex);
+	cds_list_for_each_entry(ht, &cds_lfht_tables, table_node) {
+		info.size = CMM_LOAD_SHARED(ht->size);
+		info.count = split_count_sum(ht);
+		info.flags = ht->flags;
+		func(ht, &info, priv);
+	}
+	mutex_unlock(&cds_lfht_tables_mutex);
+}
+
+static
+void introspect_dump_table(struct cds_lfht *ht,
+		const struct cds_lfht_info *info, void *priv)
+{
+	fprintf(priv, "cds_lfht ht=%p size=%lu count=%ld flags=%#x\n",
+		(void *) ht, info->size, info->count, info->flags);
+}
+
+/* Formatted in memory, not to write with the table list lock held. */
+int cds_lfht_introspect_dump(int fd)
+{
+	char *buf = NULL;
+	size_t len = 0, done;
+	ssize_t ret;
+	FILE *f;
+
+	f = open_memstream(&buf, &len);
+	if (!f)
+		return -errno;
+	cds_lfht_for_each_table(introspect_dump_table, f);
+	if (fclose(f)) {
+		free(buf);
+		return -ENOMEM;
+	}
+	for (done = 0; done < len; done += ret) {
+		ret = write(fd, buf + done, len - done);
+		if (ret < 0) {
+			if (errno == EINTR) {
+				ret = 0;
+				continue;
+			}
+			ret = -errno;
+			free(buf);
+			return ret;
+		}
+	}
+	free(buf);
+	return 0;
+}
+
 void cds_lfht_count_nodes(struct cds_lfht *ht,
 		long *approx_before,
 		unsigned long *count,
@@ -1905,15 +3329,7 @@ void cds_lfht_count_nodes(struct cds_lfht *ht,
 	struct cds_lfht_node *node, *next;
 	unsigned long nr_bucket = 0, nr_removed = 0;
 
-	*approx_before = 0;
-	if (ht->split_count) {
-		int i;
-
-		for (i = 0; i < split_count_mask + 1; i++) {
-			*approx_before += uatomic_read(&ht->split_count[i].add);
-			*approx_before -= uatomic_read(&ht->split_count[i].del);
-		}
-	}
+	*approx_before = split_count_sum(ht);
 
 	*count = 0;
 
@@ -1934,15 +3350,52 @@ void cds_lfht_count_nodes(struct cds_lfht *ht,
 	} while (!is_end(node));
 	dbg_printf("number of logically removed nodes: %lu\n", nr_removed);
 	dbg_printf("number of bucket nodes: %lu\n", nr_bucket);
-	*approx_after = 0;
-	if (ht->split_count) {
-		int i;
+	*approx_after = split_count_sum(ht);
+}
+
+static
+void diag_scan_bucket(struct cds_lfht_node *bucket,
+		struct cds_lfht_diag *diag)
+{
+	struct cds_lfht_node *node, *next, *prev = NULL;
+	unsigned long len = 0;
 
-		for (i = 0; i < split_count_mask + 1; i++) {
-			*approx_after += uatomic_read(&ht->split_count[i].add);
-			*approx_after -= uatomic_read(&ht->split_count[i].del);
+	node = clear_flag(rcu_dereference(bucket->next));
+	while (!is_end(node)) {
+		next = rcu_dereference(node->next);
+		if (is_bucket(next))
+			break;
+		if (is_removed(next)) {
+			diag->nr_removed++;
+		} else {
+			if (prev && prev->reverse_hash == node->reverse_hash)
+				diag->nr_dup_reverse_hash++;
+			prev = node;
+			len++;
 		}
+		node = clear_flag(next);
 	}
+	diag->nr_buckets_scanned++;
+	diag->nr_nodes += len;
+	if (!len)
+		diag->nr_empty_buckets++;
+	diag->max_chain_len = max(diag->max_chain_len, len);
+	diag->chain_len_hist[min_t(unsigned long, len,
+			CDS_LFHT_DIAG_HIST_LEN - 1)]++;
+}
+
+unsigned long cds_lfht_diag_scan(struct cds_lfht *ht, unsigned long first,
+		unsigned long nr, struct cds_lfht_diag *diag)
+{
+	unsigned long size, i, last;
+
+	size = rcu_dereference(ht->size);
+	if (first >= size)
+		return 0;
+	last = first + min(nr, size - first);
+	for (i = first; i < last; i++)
+		diag_scan_bucket(bucket_at(ht, i), diag);
+	return last < size ? last : 0;
 }
 
 /* called with resize mutex held */
@@ -1979,6 +3432,56 @@ void _do_cds_lfht_shrink(struct cds_lfht *ht,
 }
 
 
+/* called with resize mutex held */
+static
+void resize_event_start(struct cds_lfht *ht, unsigned long old_size,
+		unsigned long new_size)
+{
+	memset(&ht->resize_event, 0, sizeof(ht->resize_event));
+	ht->resize_event.old_size = old_size;
+	ht->resize_event.new_size = new_size;
+	ht->resize_start_ns = urcu_stats_now_ns();
+	urcu_tp3(lfht_resize_start, ht, old_size, new_size);
+	mutex_lock(&ht->resize_stats_mutex);
+	ht->resize_stats.in_progress = 1;
+	ht->resize_stats.current = ht->resize_event;
+	mutex_unlock(&ht->resize_stats_mutex);
+	if (ht->resize_hook)
+		ht->resize_hook(ht, CDS_LFHT_RESIZE_START, &ht->resize_event,
+				ht->resize_hook_priv);
+}
+
+/* called with resize mutex held */
+static
+void resize_event_end(struct cds_lfht *ht)
+{
+	struct cds_lfht_resize_event *event = &ht->resize_event;
+	struct cds_lfht_resize_stats *stats = &ht->resize_stats;
+
+	/* The resize may stop early if its target changes. */
+	event->new_size = ht->size;
+	event->duration_ns = urcu_stats_now_ns() - ht->resize_start_ns;
+	urcu_tp4(lfht_resize_end, ht, event->old_size, event->new_size,
+		event->duration_ns);
+	mutex_lock(&ht->resize_stats_mutex);
+	stats->in_progress = 0;
+	if (event->new_size > event->old_size)
+		stats->nr_grow++;
+	else if (event->new_size < event->old_size)
+		stats->nr_shrink++;
+	stats->total_duration_ns += event->duration_ns;
+	stats->max_duration_ns = max(stats->max_duration_ns,
+			event->duration_ns);
+	stats->nr_buckets += event->nr_buckets;
+	stats->nr_gp_waits += event->nr_gp_waits;
+	stats->nr_threads += event->nr_threads;
+	stats->last = *event;
+	mutex_unlock(&ht->resize_stats_mutex);
+	if (ht->resize_hook)
+		ht->resize_hook(ht, CDS_LFHT_RESIZE_END, event,
+				ht->resize_hook_priv);
+}
+
 /* called with resize mutex held */
 static
 void _do_cds_lfht_resize(struct cds_lfht *ht)
@@ -1994,14 +3497,64 @@ void _do_cds_lfht_resize(struct cds_lfht *ht)
 		ht->resize_initiated = 1;
 		old_size = ht->size;
 		new_size = CMM_LOAD_SHARED(ht->resize_target);
-		if (old_size < new_size)
+		if (old_size < new_size) {
+			resize_links_begin(ht);
+			resize_event_start(ht, old_size, new_size);
 			_do_cds_lfht_grow(ht, old_size, new_size);
-		else if (old_size > new_size)
+			resize_event_end(ht);
+			resize_links_end(ht);
+		} else if (old_size > new_size) {
+			resize_links_begin(ht);
+			resize_event_start(ht, old_size, new_size);
 			_do_cds_lfht_shrink(ht, old_size, new_size);
+			resize_event_end(ht);
+			resize_links_end(ht);
+		}
 		ht->resize_initiated = 0;
 		/* write resize_initiated before read resize_target */
 		cmm_smp_mb();
 	} while (ht->size != CMM_LOAD_SHARED(ht->resize_target));
+	/* Only read to rate-limit shrinks: tearing is harmless. */
+	CMM_STORE_SHARED(ht->last_resize_ns, urcu_stats_now_ns());
+}
+
+void cds_lfht_set_resize_hook(struct cds_lfht *ht,
+		void (*hook)(struct cds_lfht *ht,
+			enum cds_lfht_resize_event_type type,
+			const struct cds_lfht_resize_event *event, void *priv),
+		void *priv)
+{
+	mutex_lock_stats(&ht->resize_mutex, &ht->resize_lock_stats);
+	ht->resize_hook = hook;
+	ht->resize_hook_priv = priv;
+	mutex_unlock(&ht->resize_mutex);
+}
+
+void cds_lfht_set_mm_retention(struct cds_lfht *ht, size_t max_len,
+		unsigned long max_ms)
+{
+	mutex_lock_stats(&ht->resize_mutex, &ht->resize_lock_stats);
+	ht->mm_retention.max_len = max_len;
+	ht->mm_retention.max_ms = max_ms;
+	mutex_unlock(&ht->resize_mutex);
+}
+
+void cds_lfht_get_mem_stats(struct cds_lfht *ht,
+		struct cds_lfht_mem_stats *stats)
+{
+	stats->table_bytes = ht->alloc_len;
+	stats->bucket_bytes = CMM_LOAD_SHARED(ht->bucket_bytes);
+	stats->split_count_bytes = ht->split_count ?
+		(split_count_mask + 1) * sizeof(struct ht_items_count) : 0;
+}
+
+void cds_lfht_get_resize_stats(struct cds_lfht *ht,
+		struct cds_lfht_resize_stats *stats)
+{
+	mutex_lock(&ht->resize_stats_mutex);
+	*stats = ht->resize_stats;
+	urcu_stats_lock_snapshot(&ht->resize_lock_stats, &stats->resize_lock);
+	mutex_unlock(&ht->resize_stats_mutex);
 }
 
 static
@@ -2023,7 +3576,26 @@ void cds_lfht_resize(struct cds_lfht *ht, unsigned long new_size)
 {
 	resize_target_update_count(ht, new_size);
 	CMM_STORE_SHARED(ht->resize_initiated, 1);
-	mutex_lock(&ht->resize_mutex);
+	mutex_lock_stats(&ht->resize_mutex, &ht->resize_lock_stats);
+	_do_cds_lfht_resize(ht);
+	mutex_unlock(&ht->resize_mutex);
+}
+
+/*
+ * Synchronously grow the table to hold count nodes, never shrink it.
+ */
+static
+void cds_lfht_resize_grow(struct cds_lfht *ht, unsigned long count)
+{
+	count = max(count, MIN_TABLE_SIZE);
+	count = min(count, ht->max_nr_buckets);
+	count = 1UL << cds_lfht_get_count_order_ulong(count);
+	if (CMM_LOAD_SHARED(ht->size) >= count)
+		return;
+	if (resize_target_grow(ht, count) >= count)
+		return;
+	CMM_STORE_SHARED(ht->resize_initiated, 1);
+	mutex_lock_stats(&ht->resize_mutex, &ht->resize_lock_stats);
 	_do_cds_lfht_resize(ht);
 	mutex_unlock(&ht->resize_mutex);
 }
@@ -2035,11 +3607,11 @@ void do_resize_cb(struct urcu_work *work)
 		caa_container_of(work, struct resize_work, work);
 	struct cds_lfht *ht = resize_work->ht;
 
-	ht->flavor->register_thread();
-	mutex_lock(&ht->resize_mutex);
+	lfht_register_thread(ht);
+	mutex_lock_stats(&ht->resize_mutex, &ht->resize_lock_stats);
 	_do_cds_lfht_resize(ht);
 	mutex_unlock(&ht->resize_mutex);
-	ht->flavor->unregister_thread();
+	lfht_unregister_thread(ht);
 	poison_free(work);
 }
 
@@ -2047,7 +3619,10 @@ static
 void __cds_lfht_resize_lazy_launch(struct cds_lfht *ht)
 {
 	struct resize_work *work;
+	struct urcu_workqueue *workqueue;
 
+	/* A resize initiated before fork resumes in the child. */
+	workqueue = cds_lfht_get_workqueue();
 	/* Store resize_target before read resize_initiated */
 	cmm_smp_mb();
 	if (!CMM_LOAD_SHARED(ht->resize_initiated)) {
@@ -2060,9 +3635,15 @@ void __cds_lfht_resize_lazy_launch(struct cds_lfht *ht)
 			return;
 		}
 		work->ht = ht;
-		urcu_workqueue_queue_work(cds_lfht_workqueue,
-			&work->work, do_resize_cb);
+		/*
+		 * Set resize_initiated before queueing the work: the worker
+		 * clears it when done, and setting it afterwards could
+		 * leave it set with no resize queued, blocking all further
+		 * lazy resizes.
+		 */
 		CMM_STORE_SHARED(ht->resize_initiated, 1);
+		(void) urcu_workqueue_queue_delayed_work(workqueue,
+			&work->work, do_resize_cb, RESIZE_LAZY_DELAY_MS, 0);
 	}
 }
 
@@ -2072,6 +3653,10 @@ void cds_lfht_resize_lazy_grow(struct cds_lfht *ht, unsigned long size, int grow
 	unsigned long target_size = size << growth;
 
 	target_size = min(target_size, ht->max_nr_buckets);
+	if (CMM_LOAD_SHARED(ht->resize_target) >= target_size)
+		return;
+	if (!policy_allow_resize(ht, size, target_size))
+		return;
 	if (resize_target_grow(ht, target_size) >= target_size)
 		return;
 
@@ -2093,6 +3678,8 @@ void cds_lfht_resize_lazy_count(struct cds_lfht *ht, unsigned long size,
 	count = min(count, ht->max_nr_buckets);
 	if (count == size)
 		return;		/* Already the right size, no resize needed */
+	if (!policy_allow_resize(ht, size, count))
+		return;
 	if (count > size) {	/* lazy grow */
 		if (resize_target_grow(ht, count) >= count)
 			return;
@@ -2115,33 +3702,50 @@ void cds_lfht_resize_lazy_count(struct cds_lfht *ht, unsigned long size,
 
 static void cds_lfht_before_fork(void *priv)
 {
+	struct cds_lfht_resize_pool *pool;
+
 	if (cds_lfht_workqueue_atfork_nesting++)
 		return;
 	mutex_lock(&cds_lfht_fork_mutex);
-	if (!cds_lfht_workqueue)
-		return;
-	urcu_workqueue_pause_worker(cds_lfht_workqueue);
+	if (cds_lfht_workqueue && !cds_lfht_workqueue_forked)
+		urcu_workqueue_pause_worker(cds_lfht_workqueue);
+	cds_list_for_each_entry(pool, &cds_lfht_resize_pools, node)
+		mutex_lock(&pool->lock);
 }
 
 static void cds_lfht_after_fork_parent(void *priv)
 {
+	struct cds_lfht_resize_pool *pool;
+
 	if (--cds_lfht_workqueue_atfork_nesting)
 		return;
-	if (!cds_lfht_workqueue)
-		goto end;
-	urcu_workqueue_resume_worker(cds_lfht_workqueue);
-end:
+	cds_list_for_each_entry(pool, &cds_lfht_resize_pools, node)
+		mutex_unlock(&pool->lock);
+	if (cds_lfht_workqueue && !cds_lfht_workqueue_forked)
+		urcu_workqueue_resume_worker(cds_lfht_workqueue);
 	mutex_unlock(&cds_lfht_fork_mutex);
 }
 
 static void cds_lfht_after_fork_child(void *priv)
 {
+	struct cds_lfht_resize_pool *pool;
+
 	if (--cds_lfht_workqueue_atfork_nesting)
 		return;
-	if (!cds_lfht_workqueue)
-		goto end;
-	urcu_workqueue_create_worker(cds_lfht_workqueue);
-end:
+	/*
+	 * Resize pool and workqueue threads do not survive fork: they are
+	 * created again in the child when needed. Works in progress belong
+	 * to threads which do not exist in the child either.
+	 */
+	cds_list_for_each_entry(pool, &cds_lfht_resize_pools, node) {
+		pool->nr_threads = 0;
+		CDS_INIT_LIST_HEAD(&pool->work);
+		pthread_cond_init(&pool->work_cond, NULL);
+		pthread_cond_init(&pool->done_cond, NULL);
+		mutex_unlock(&pool->lock);
+	}
+	if (cds_lfht_workqueue)
+		cds_lfht_workqueue_forked = 1;
 	mutex_unlock(&cds_lfht_fork_mutex);
 }
 
@@ -2151,20 +3755,20 @@ static struct urcu_atfork cds_lfht_atfork = {
 	.after_fork_child = cds_lfht_after_fork_child,
 };
 
-/* Block all signals to ensure we don't disturb the application. */
 static void cds_lfht_worker_init(struct urcu_workqueue *workqueue,
 		void *priv)
 {
-	int ret;
-	sigset_t mask;
+	block_all_signals();
+}
 
-	/* Block signal for entire process, so only our thread processes it. */
-	ret = sigfillset(&mask);
-	if (ret)
-		urcu_die(errno);
-	ret = pthread_sigmask(SIG_BLOCK, &mask, NULL);
-	if (ret)
-		urcu_die(ret);
+/* One resize worker per online CPU, up to MAX_RESIZE_WORKERS. */
+static unsigned int nr_resize_workers(void)
+{
+	long nr_cpus = sysconf(_SC_NPROCESSORS_ONLN);
+
+	if (nr_cpus <= 0)
+		return 1;
+	return min(nr_cpus, MAX_RESIZE_WORKERS);
 }
 
 static void cds_lfht_init_worker(const struct rcu_flavor_struct *flavor)
@@ -2174,7 +3778,8 @@ static void cds_lfht_init_worker(const struct rcu_flavor_struct *flavor)
 	mutex_lock(&cds_lfht_fork_mutex);
 	if (cds_lfht_workqueue_user_count++)
 		goto end;
-	cds_lfht_workqueue = urcu_workqueue_create(0, -1, NULL,
+	cds_lfht_workqueue = urcu_workqueue_create_nr(0, -1,
+		nr_resize_workers(), NULL,
 		NULL, cds_lfht_worker_init, NULL, NULL, NULL, NULL, NULL);
 end:
 	mutex_unlock(&cds_lfht_fork_mutex);
@@ -2185,6 +3790,11 @@ static void cds_lfht_fini_worker(const struct rcu_flavor_struct *flavor)
 	mutex_lock(&cds_lfht_fork_mutex);
 	if (--cds_lfht_workqueue_user_count)
 		goto end;
+	/* Destroying the workqueue stops its worker threads. */
+	if (cds_lfht_workqueue_forked) {
+		urcu_workqueue_create_worker(cds_lfht_workqueue);
+		cds_lfht_workqueue_forked = 0;
+	}
 	urcu_workqueue_destroy(cds_lfht_workqueue);
 	cds_lfht_workqueue = NULL;
 end:
@@ -2192,3 +3802,72 @@ end:
 
 	flavor->unregister_rculfhash_atfork(&cds_lfht_atfork);
 }
+
+/*
+ * Get the resize pool of the tables created with attr, which has no
+ * thread until the first partitioned resize. Returns NULL if out of
+ * memory: resizes are then single-threaded.
+ */
+static struct cds_lfht_resize_pool *cds_lfht_get_resize_pool(
+		const struct rcu_flavor_struct *flavor, pthread_attr_t *attr)
+{
+	struct cds_lfht_resize_pool *pool;
+
+	flavor->register_rculfhash_atfork(&cds_lfht_atfork);
+
+	mutex_lock(&cds_lfht_fork_mutex);
+	cds_list_for_each_entry(pool, &cds_lfht_resize_pools, node) {
+		if (pool->attr == attr) {
+			pool->refcount++;
+			goto end;
+		}
+	}
+	pool = calloc(1, sizeof(*pool));
+	if (!pool)
+		goto end;
+	pool->attr = attr;
+	pool->refcount = 1;
+	pthread_mutex_init(&pool->lock, NULL);
+	pthread_cond_init(&pool->work_cond, NULL);
+	pthread_cond_init(&pool->done_cond, NULL);
+	CDS_INIT_LIST_HEAD(&pool->work);
+	cds_list_add(&pool->node, &cds_lfht_resize_pools);
+end:
+	mutex_unlock(&cds_lfht_fork_mutex);
+	return pool;
+}
+
+static void cds_lfht_put_resize_pool(const struct rcu_flavor_struct *flavor,
+		struct cds_lfht_resize_pool *pool)
+{
+	unsigned long thread;
+	int ret;
+
+	mutex_lock(&cds_lfht_fork_mutex);
+	if (!pool || --pool->refcount)
+		goto end;
+	cds_list_del(&pool->node);
+	mutex_lock(&pool->lock);
+	pool->stop = 1;
+	ret = pthread_cond_broadcast(&pool->work_cond);
+	if (ret)
+		urcu_die(ret);
+	mutex_unlock(&pool->lock);
+	for (thread = 0; thread < pool->nr_threads; thread++) {
+		ret = pthread_join(pool->threads[thread], NULL);
+		if (ret)
+			urcu_die(ret);
+	}
+	ret = pthread_cond_destroy(&pool->done_cond);
+	assert(!ret);
+	ret = pthread_cond_destroy(&pool->work_cond);
+	assert(!ret);
+	ret = pthread_mutex_destroy(&pool->lock);
+	assert(!ret);
+	free(pool->threads);
+	poison_free(pool);
+end:
+	mutex_unlock(&cds_lfht_fork_mutex);
+
+	flavor->unregister_rculfhash_atfork(&cds_lfht_atfork);
+}
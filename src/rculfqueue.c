@@ -42,6 +42,13 @@ void cds_lfq_init_rcu(struct cds_lfq_queue_rcu *q,
 	_cds_lfq_init_rcu(q, queue_call_rcu);
 }
 
+int cds_lfq_init_rcu_flavor(struct cds_lfq_queue_rcu *q,
+			    const struct rcu_flavor_struct *flavor,
+			    unsigned long pool_size)
+{
+	return _cds_lfq_init_rcu_flavor(q, flavor, pool_size);
+}
+
 int cds_lfq_destroy_rcu(struct cds_lfq_queue_rcu *q)
 {
 	return _cds_lfq_destroy_rcu(q);
@@ -57,3 +64,27 @@ cds_lfq_dequeue_rcu(struct cds_lfq_queue_rcu *q)
 {
 	return _cds_lfq_dequeue_rcu(q);
 }
+
+unsigned long cds_lfq_dequeue_batch_rcu(struct cds_lfq_queue_rcu *q,
+		struct cds_lfq_node_rcu **nodes, unsigned long max)
+{
+	return _cds_lfq_dequeue_batch_rcu(q, nodes, max);
+}
+
+void cds_lfq_init_hazptr(struct cds_lfq_queue_rcu *q)
+{
+	_cds_lfq_init_hazptr(q);
+}
+
+void cds_lfq_enqueue_hazptr(struct cds_lfq_queue_rcu *q,
+		struct cds_lfq_node_rcu *node, struct urcu_hazptr_rec *rec)
+{
+	_cds_lfq_enqueue_hazptr(q, node, rec);
+}
+
+struct cds_lfq_node_rcu *
+cds_lfq_dequeue_hazptr(struct cds_lfq_queue_rcu *q,
+		struct urcu_hazptr_rec *rec)
+{
+	return _cds_lfq_dequeue_hazptr(q, rec);
+}
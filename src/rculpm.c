@@ -0,0 +1,596 @@
+/*
+ * rculpm.c
+ *
+ * Userspace RCU library - RCU longest prefix match trie
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+#define _LGPL_SOURCE
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <errno.h>
+#include <assert.h>
+#include <pthread.h>
+
+#include <urcu/compiler.h>
+#include <urcu/pointer.h>
+#include <urcu/call-rcu.h>
+#include <urcu/flavor.h>
+#include <urcu/rculpm.h>
+
+#include "urcu-die.h"
+
+#define LPM_BITS	6
+#define LPM_FANOUT	(1U << LPM_BITS)
+/* Prefixes ending within a node: 2 + 4 + ... + LPM_FANOUT. */
+#define LPM_MAX_PREFIXES	(2 * LPM_FANOUT - 2)
+#define LPM_MAX_LEVELS	((CDS_LPM_MAX_KEY_BITS + LPM_BITS - 1) / LPM_BITS)
+#define LPM_KEY_BYTES	(CDS_LPM_MAX_KEY_BITS / 8)
+
+/*
+ * Interior node. A prefix of length len > 0 ends within the node of
+ * level (len - 1) / LPM_BITS on its path, where it covers the indexes
+ * sharing its remaining 1 to LPM_BITS bits. Published inodes are never
+ * modified: the updater builds a new inode for each modification,
+ * marked with the generation of the batch, so that it can be freed
+ * right away if a later modification of the same batch replaces it.
+ */
+struct cds_lpm_inode {
+	uint64_t vector;		/* Indexes with a child. */
+	uint64_t leafvec;		/* Indexes starting a run of leaves. */
+	unsigned int nr_prefixes;
+	unsigned int key_bits;		/* Root only: key length. */
+	unsigned long gen;		/* Batch which created the inode. */
+	unsigned long count;		/* Root only: number of prefixes. */
+	struct cds_lpm_node *def;	/* Root only: zero-length prefix. */
+	struct cds_lpm_inode *next_retired;
+	/*
+	 * Children, then one leaf per run, which may be NULL, then the
+	 * prefixes ending within the node, which the leaves are computed
+	 * from.
+	 */
+	void *slot[];
+};
+
+/* Interior nodes and nodes replaced by a batch, freed at once. */
+struct cds_lpm_retired {
+	struct rcu_head head;
+	struct cds_lpm_inode *inodes;
+	struct cds_lpm_node *nodes;
+	cds_lpm_free_fct free_node;
+};
+
+static void mutex_lock(pthread_mutex_t *mutex)
+{
+	int ret;
+
+	ret = pthread_mutex_lock(mutex);
+	if (ret)
+		urcu_die(ret);
+}
+
+static void mutex_unlock(pthread_mutex_t *mutex)
+{
+	int ret;
+
+	ret = pthread_mutex_unlock(mutex);
+	if (ret)
+		urcu_die(ret);
+}
+
+/* Index of @key within the node of @level, for a key of @key_bytes. */
+static inline
+unsigned int key_index(const uint8_t *key, unsigned int key_bytes,
+		unsigned int level)
+{
+	unsigned int bit = level * LPM_BITS, byte = bit / 8, v;
+
+	v = (unsigned int) key[byte] << 8;
+	if (byte + 1 < key_bytes)
+		v |= key[byte + 1];
+	return (v >> (16 - LPM_BITS - bit % 8)) & (LPM_FANOUT - 1);
+}
+
+static inline
+unsigned int nr_children(const struct cds_lpm_inode *inode)
+{
+	return __builtin_popcountll(inode->vector);
+}
+
+static inline
+unsigned int nr_leaves(const struct cds_lpm_inode *inode)
+{
+	return __builtin_popcountll(inode->leafvec);
+}
+
+static inline
+struct cds_lpm_node **inode_prefixes(const struct cds_lpm_inode *inode)
+{
+	return (struct cds_lpm_node **) &inode->slot[nr_children(inode)
+			+ nr_leaves(inode)];
+}
+
+/* Copy of the first @len bits of @key, zero-padded. */
+static
+void key_mask(uint8_t *dst, const void *key, unsigned int len)
+{
+	if (len > CDS_LPM_MAX_KEY_BITS)
+		len = CDS_LPM_MAX_KEY_BITS;
+	memset(dst, 0, LPM_KEY_BYTES);
+	memcpy(dst, key, (len + 7) / 8);
+	if (len % 8)
+		dst[len / 8] &= 0xff << (8 - len % 8);
+}
+
+static
+struct cds_lpm_inode *alloc_inode(unsigned long gen, unsigned int nr_slots)
+{
+	struct cds_lpm_inode *inode;
+
+	inode = malloc(sizeof(*inode) + nr_slots * sizeof(inode->slot[0]));
+	if (!inode)
+		return NULL;
+	inode->vector = 0;
+	inode->leafvec = 0;
+	inode->nr_prefixes = 0;
+	inode->key_bits = 0;
+	inode->gen = gen;
+	inode->count = 0;
+	inode->def = NULL;
+	inode->next_retired = NULL;
+	return inode;
+}
+
+/*
+ * Build the inode of @level replacing @old, or a new inode if @old is
+ * NULL: the child of @index is set to @child if @set_child, removed if
+ * @child is NULL, and prefix @del is replaced by @add, either of which
+ * may be NULL. Return NULL on allocation failure.
+ */
+static
+struct cds_lpm_inode *build_inode(struct cds_lpm *lpm,
+		const struct cds_lpm_inode *old, unsigned int level,
+		int set_child, unsigned int index, struct cds_lpm_inode *child,
+		struct cds_lpm_node *del, struct cds_lpm_node *add)
+{
+	struct cds_lpm_node *prefixes[LPM_MAX_PREFIXES], *best[LPM_FANOUT], *p;
+	void *children[LPM_FANOUT];
+	unsigned int nc = 0, nl = 0, np = 0, i, j, start, span, pos;
+	struct cds_lpm_inode *inode;
+	uint64_t vector = 0, leafvec = 0, bit;
+
+	if (old) {
+		struct cds_lpm_node **old_prefixes = inode_prefixes(old);
+
+		vector = old->vector;
+		nc = nr_children(old);
+		memcpy(children, old->slot, nc * sizeof(children[0]));
+		for (i = 0; i < old->nr_prefixes; i++) {
+			if (old_prefixes[i] != del)
+				prefixes[np++] = old_prefixes[i];
+		}
+	}
+	if (add)
+		prefixes[np++] = add;
+	if (set_child) {
+		bit = UINT64_C(1) << index;
+		pos = __builtin_popcountll(vector & (bit - 1));
+		if (vector & bit) {
+			if (child) {
+				children[pos] = child;
+			} else {
+				memmove(&children[pos], &children[pos + 1],
+					(nc - pos - 1) * sizeof(children[0]));
+				nc--;
+				vector &= ~bit;
+			}
+		} else if (child) {
+			memmove(&children[pos + 1], &children[pos],
+				(nc - pos) * sizeof(children[0]));
+			children[pos] = child;
+			nc++;
+			vector |= bit;
+		}
+	}
+
+	/* Longest prefix covering each index, compressed in runs. */
+	memset(best, 0, sizeof(best));
+	for (i = 0; i < np; i++) {
+		p = prefixes[i];
+		start = key_index(p->key, LPM_KEY_BYTES, level);
+		span = 1U << (LPM_BITS - (p->len - level * LPM_BITS));
+		for (j = start; j < start + span; j++) {
+			if (!best[j] || best[j]->len < p->len)
+				best[j] = p;
+		}
+	}
+	for (i = 0; i < LPM_FANOUT; i++) {
+		if (!i || best[i] != best[i - 1]) {
+			leafvec |= UINT64_C(1) << i;
+			nl++;
+		}
+	}
+
+	inode = alloc_inode(lpm->gen, nc + nl + np);
+	if (!inode)
+		return NULL;
+	if (old) {
+		inode->key_bits = old->key_bits;
+		inode->count = old->count;
+		inode->def = old->def;
+	}
+	inode->vector = vector;
+	inode->leafvec = leafvec;
+	inode->nr_prefixes = np;
+	memcpy(inode->slot, children, nc * sizeof(children[0]));
+	for (i = 0, j = nc; i < LPM_FANOUT; i++) {
+		if (leafvec & (UINT64_C(1) << i))
+			inode->slot[j++] = best[i];
+	}
+	memcpy(&inode->slot[j], prefixes, np * sizeof(prefixes[0]));
+	return inode;
+}
+
+/*
+ * Free the inodes of a subtree, and call @free_node on its prefixes if
+ * set. With @fresh_only, only free the inodes of the current batch:
+ * the subtrees of the other inodes are still published.
+ */
+static
+void free_tree(struct cds_lpm *lpm, struct cds_lpm_inode *inode,
+		int fresh_only, cds_lpm_free_fct free_node)
+{
+	struct cds_lpm_node **prefixes = inode_prefixes(inode);
+	unsigned int i;
+
+	if (fresh_only && inode->gen != lpm->gen)
+		return;
+	for (i = 0; i < nr_children(inode); i++)
+		free_tree(lpm, inode->slot[i], fresh_only, free_node);
+	if (free_node) {
+		for (i = 0; i < inode->nr_prefixes; i++)
+			free_node(prefixes[i]);
+		if (inode->def)
+			free_node(inode->def);
+	}
+	free(inode);
+}
+
+static
+void free_retired(struct rcu_head *head)
+{
+	struct cds_lpm_retired *retired =
+		caa_container_of(head, struct cds_lpm_retired, head);
+	struct cds_lpm_inode *inode, *next_inode;
+	struct cds_lpm_node *node, *next_node;
+
+	for (inode = retired->inodes; inode; inode = next_inode) {
+		next_inode = inode->next_retired;
+		free(inode);
+	}
+	for (node = retired->nodes; node; node = next_node) {
+		next_node = node->next_removed;
+		if (retired->free_node)
+			retired->free_node(node);
+	}
+	free(retired);
+}
+
+/*
+ * Unlink @inode from the version being updated: free it if it belongs
+ * to the batch, and after the commit otherwise.
+ */
+static
+void drop_inode(struct cds_lpm *lpm, struct cds_lpm_inode *inode)
+{
+	if (inode->gen == lpm->gen) {
+		free(inode);
+		return;
+	}
+	inode->next_retired = lpm->retired->inodes;
+	lpm->retired->inodes = inode;
+}
+
+static
+void retire_leaf(struct cds_lpm *lpm, struct cds_lpm_node *node)
+{
+	node->next_removed = lpm->retired->nodes;
+	lpm->retired->nodes = node;
+}
+
+static
+struct cds_lpm_node *find_prefix(const struct cds_lpm_inode *inode,
+		const uint8_t *key, unsigned int len)
+{
+	struct cds_lpm_node **prefixes = inode_prefixes(inode);
+	unsigned int i;
+
+	for (i = 0; i < inode->nr_prefixes; i++) {
+		if (prefixes[i]->len == len
+		    && !memcmp(prefixes[i]->key, key, LPM_KEY_BYTES))
+			return prefixes[i];
+	}
+	return NULL;
+}
+
+/*
+ * Rebuild the path of the masked prefix @key/@len, of non-zero length,
+ * replacing prefix @del by @add. Interior nodes left without children
+ * nor prefixes are removed, but the root. The replaced inodes are only
+ * unlinked once the whole path is built, so that the version is
+ * unchanged on allocation failure.
+ */
+static
+int update_path(struct cds_lpm *lpm, const uint8_t *key, unsigned int len,
+		struct cds_lpm_node *del, struct cds_lpm_node *add)
+{
+	struct cds_lpm_inode *path[LPM_MAX_LEVELS], *fresh[LPM_MAX_LEVELS];
+	struct cds_lpm_inode *sub = NULL, *inode;
+	unsigned int index[LPM_MAX_LEVELS], end = (len - 1) / LPM_BITS;
+	unsigned int level;
+	uint64_t bit;
+	int i;
+
+	path[0] = lpm->new_root;
+	for (level = 0; level < end; level++) {
+		inode = path[level];
+		index[level] = key_index(key, LPM_KEY_BYTES, level);
+		bit = UINT64_C(1) << index[level];
+		if (inode && (inode->vector & bit))
+			path[level + 1] = inode->slot[
+				__builtin_popcountll(inode->vector & (bit - 1))];
+		else
+			path[level + 1] = NULL;
+	}
+	for (i = end; i >= 0; i--) {
+		if (i == (int) end)
+			inode = build_inode(lpm, path[i], i, 0, 0, NULL,
+					del, add);
+		else
+			inode = build_inode(lpm, path[i], i, 1, index[i], sub,
+					NULL, NULL);
+		if (!inode)
+			goto error;
+		if (i && !inode->vector && !inode->nr_prefixes) {
+			free(inode);
+			inode = NULL;
+		}
+		fresh[i] = inode;
+		sub = inode;
+	}
+	for (level = 0; level <= end; level++) {
+		if (path[level])
+			drop_inode(lpm, path[level]);
+	}
+	lpm->new_root = fresh[0];
+	return 0;
+
+error:
+	while (++i <= (int) end)
+		free(fresh[i]);
+	return -ENOMEM;
+}
+
+/* Replace the masked prefix @del by @add, either of which may be NULL. */
+static
+int update(struct cds_lpm *lpm, const uint8_t *key, unsigned int len,
+		struct cds_lpm_node *del, struct cds_lpm_node *add)
+{
+	struct cds_lpm_inode *root;
+	int ret;
+
+	if (!len) {
+		root = build_inode(lpm, lpm->new_root, 0, 0, 0, NULL,
+				NULL, NULL);
+		if (!root)
+			return -ENOMEM;
+		root->def = add;
+		drop_inode(lpm, lpm->new_root);
+		lpm->new_root = root;
+	} else {
+		ret = update_path(lpm, key, len, del, add);
+		if (ret)
+			return ret;
+	}
+	if (del)
+		retire_leaf(lpm, del);
+	if (add && !del)
+		lpm->new_root->count++;
+	else if (del && !add)
+		lpm->new_root->count--;
+	return 0;
+}
+
+void cds_lpm_node_init(struct cds_lpm_node *node, const void *key,
+		unsigned int len)
+{
+	key_mask(node->key, key, len);
+	node->len = len;
+	node->next_removed = NULL;
+}
+
+struct cds_lpm_node *cds_lpm_lookup(const struct cds_lpm_inode *root,
+		const void *key)
+{
+	const struct cds_lpm_inode *inode = root;
+	struct cds_lpm_node *best = root->def, *leaf;
+	unsigned int key_bytes = (root->key_bits + 7) / 8, level, nc;
+	uint64_t bit;
+
+	for (level = 0; ; level++) {
+		bit = UINT64_C(1) << key_index(key, key_bytes, level);
+		nc = __builtin_popcountll(inode->vector);
+		/* The leaf of the run the index is in. */
+		leaf = inode->slot[nc - 1
+			+ __builtin_popcountll(inode->leafvec & (bit | (bit - 1)))];
+		if (leaf)
+			best = leaf;
+		if (!(inode->vector & bit))
+			return best;
+		inode = inode->slot[__builtin_popcountll(inode->vector
+				& (bit - 1))];
+	}
+}
+
+struct cds_lpm_node *cds_lpm_lookup_exact(const struct cds_lpm_inode *root,
+		const void *key, unsigned int len)
+{
+	const struct cds_lpm_inode *inode = root;
+	uint8_t masked[LPM_KEY_BYTES];
+	unsigned int level;
+	uint64_t bit;
+
+	if (len > root->key_bits)
+		return NULL;
+	if (!len)
+		return root->def;
+	key_mask(masked, key, len);
+	for (level = 0; level < (len - 1) / LPM_BITS; level++) {
+		bit = UINT64_C(1) << key_index(masked, LPM_KEY_BYTES, level);
+		if (!(inode->vector & bit))
+			return NULL;
+		inode = inode->slot[__builtin_popcountll(inode->vector
+				& (bit - 1))];
+	}
+	return find_prefix(inode, masked, len);
+}
+
+unsigned long cds_lpm_count(const struct cds_lpm_inode *root)
+{
+	return root->count;
+}
+
+int cds_lpm_init_flavor(struct cds_lpm *lpm, unsigned int key_bits,
+		cds_lpm_free_fct free_node,
+		const struct rcu_flavor_struct *flavor)
+{
+	int ret;
+
+	if (!key_bits || key_bits > CDS_LPM_MAX_KEY_BITS)
+		return -EINVAL;
+	lpm->gen = 0;
+	lpm->root = build_inode(lpm, NULL, 0, 0, 0, NULL, NULL, NULL);
+	if (!lpm->root)
+		return -ENOMEM;
+	lpm->root->key_bits = key_bits;
+	lpm->new_root = NULL;
+	lpm->retired = NULL;
+	lpm->key_bits = key_bits;
+	lpm->free_node = free_node;
+	lpm->flavor = flavor;
+	ret = pthread_mutex_init(&lpm->lock, NULL);
+	if (ret)
+		urcu_die(ret);
+	return 0;
+}
+
+void cds_lpm_destroy(struct cds_lpm *lpm)
+{
+	int ret;
+
+	assert(!lpm->retired);
+	free_tree(lpm, lpm->root, 0, lpm->free_node);
+	lpm->root = NULL;
+	ret = pthread_mutex_destroy(&lpm->lock);
+	if (ret)
+		urcu_die(ret);
+}
+
+int cds_lpm_update_begin(struct cds_lpm *lpm)
+{
+	struct cds_lpm_retired *retired;
+
+	mutex_lock(&lpm->lock);
+	retired = malloc(sizeof(*retired));
+	if (!retired) {
+		mutex_unlock(&lpm->lock);
+		return -ENOMEM;
+	}
+	retired->inodes = NULL;
+	retired->nodes = NULL;
+	retired->free_node = lpm->free_node;
+	lpm->retired = retired;
+	lpm->gen++;
+	lpm->new_root = lpm->root;
+	return 0;
+}
+
+struct cds_lpm_node *cds_lpm_update_lookup_exact(struct cds_lpm *lpm,
+		const void *key, unsigned int len)
+{
+	return cds_lpm_lookup_exact(lpm->new_root, key, len);
+}
+
+int cds_lpm_update_add_unique(struct cds_lpm *lpm,
+		struct cds_lpm_node *node)
+{
+	if (node->len > lpm->key_bits)
+		return -EINVAL;
+	/* Do not rebuild the path of a prefix already present. */
+	if (cds_lpm_lookup_exact(lpm->new_root, node->key, node->len))
+		return -EEXIST;
+	return update(lpm, node->key, node->len, NULL, node);
+}
+
+int cds_lpm_update_add_replace(struct cds_lpm *lpm,
+		struct cds_lpm_node *node)
+{
+	if (node->len > lpm->key_bits)
+		return -EINVAL;
+	return update(lpm, node->key, node->len,
+		cds_lpm_lookup_exact(lpm->new_root, node->key, node->len),
+		node);
+}
+
+int cds_lpm_update_del(struct cds_lpm *lpm, const void *key,
+		unsigned int len)
+{
+	uint8_t masked[LPM_KEY_BYTES];
+	struct cds_lpm_node *node;
+
+	/* Do not rebuild the path of a prefix not present. */
+	node = cds_lpm_lookup_exact(lpm->new_root, key, len);
+	if (!node)
+		return -ENOENT;
+	key_mask(masked, key, len);
+	return update(lpm, masked, len, node, NULL);
+}
+
+void cds_lpm_update_commit(struct cds_lpm *lpm)
+{
+	struct cds_lpm_retired *retired = lpm->retired;
+
+	lpm->retired = NULL;
+	if (lpm->new_root == lpm->root) {
+		assert(!retired->inodes && !retired->nodes);
+		free(retired);
+	} else {
+		rcu_set_pointer(&lpm->root, lpm->new_root);
+		lpm->flavor->update_call_rcu(&retired->head, free_retired);
+	}
+	lpm->new_root = NULL;
+	mutex_unlock(&lpm->lock);
+}
+
+void cds_lpm_update_abort(struct cds_lpm *lpm)
+{
+	free_tree(lpm, lpm->new_root, 1, NULL);
+	free(lpm->retired);
+	lpm->retired = NULL;
+	lpm->new_root = NULL;
+	mutex_unlock(&lpm->lock);
+}
@@ -0,0 +1,542 @@
+/*
+ * rcuoaht.c
+ *
+ * Userspace RCU library - Open-addressing RCU hash table
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+/*
+ * The table is an array of pointers to groups of GROUP_SLOTS slots. Each
+ * slot has a control byte, which is either EMPTY, DELETED (a tombstone),
+ * or the low 7 bits of the hash of the key it holds. The other bits of
+ * the hash select the first group of the probe sequence, which then
+ * visits groups in triangular order until one of them has an EMPTY slot.
+ *
+ * Published groups are never modified: updates publish a modified copy
+ * of the group, and free the previous one after a grace period. A NULL
+ * group is a group of EMPTY slots. A group which has an EMPTY slot was
+ * never full since the table was built, so no probe sequence went past
+ * it: removing a key from such a group leaves an EMPTY slot rather than
+ * a tombstone, and a full group only gets tombstones.
+ *
+ * When entries and tombstones exceed 7/8 of the slots, the table is
+ * rebuilt, twice as large unless tombstones take most of the room, and
+ * the new table replaces the old one, which is freed after a grace
+ * period along with its groups.
+ */
+
+#define _LGPL_SOURCE
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <errno.h>
+#include <pthread.h>
+
+#include <urcu/compiler.h>
+#include <urcu/arch.h>
+#include <urcu/pointer.h>
+#include <urcu/call-rcu.h>
+#include <urcu/flavor.h>
+#include <urcu/rcuoaht.h>
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+#include "urcu-die.h"
+
+#define GROUP_SLOTS		14
+#define GROUP_CTRL		16	/* Control bytes, padded with DELETED. */
+
+#define CTRL_EMPTY		0x80
+#define CTRL_DELETED		0xFE
+
+#define MIN_NR_GROUPS		1UL
+
+struct oaht_entry {
+	uint64_t key;
+	uint64_t value;
+};
+
+struct oaht_group {
+	uint8_t ctrl[GROUP_CTRL];
+	struct oaht_entry entries[GROUP_SLOTS];
+	struct rcu_head head;
+};
+
+struct oaht_table {
+	unsigned long mask;		/* Number of groups - 1. */
+	const struct rcu_flavor_struct *flavor;
+	struct rcu_head head;
+	struct oaht_group *groups[];
+};
+
+struct cds_oaht {
+	struct oaht_table *tbl;		/* RCU-protected. */
+	const struct rcu_flavor_struct *flavor;
+
+	pthread_mutex_t lock;		/* Protects the fields below. */
+	unsigned long count;		/* Keys. */
+	unsigned long used;		/* Keys and tombstones. */
+};
+
+static void mutex_lock(pthread_mutex_t *mutex)
+{
+	int ret;
+
+	ret = pthread_mutex_lock(mutex);
+	if (ret)
+		urcu_die(ret);
+}
+
+static void mutex_unlock(pthread_mutex_t *mutex)
+{
+	int ret;
+
+	ret = pthread_mutex_unlock(mutex);
+	if (ret)
+		urcu_die(ret);
+}
+
+/* Finalizer of MurmurHash3, mixing all key bits into the low bits. */
+static inline
+uint64_t oaht_hash(uint64_t key)
+{
+	key ^= key >> 33;
+	key *= 0xff51afd7ed558ccdULL;
+	key ^= key >> 33;
+	key *= 0xc4ceb9fe1a85ec53ULL;
+	key ^= key >> 33;
+	return key;
+}
+
+static inline
+uint8_t hash_ctrl(uint64_t hash)
+{
+	return hash & 0x7F;
+}
+
+static inline
+unsigned long hash_group(uint64_t hash, unsigned long mask)
+{
+	return (unsigned long) (hash >> 7) & mask;
+}
+
+/* Bit mask of the slots of group whose control byte is ctrl. */
+#ifdef __SSE2__
+static inline
+unsigned int group_match(const struct oaht_group *group, uint8_t ctrl)
+{
+	__m128i bytes = _mm_loadu_si128((const __m128i *) group->ctrl);
+
+	return _mm_movemask_epi8(_mm_cmpeq_epi8(bytes,
+			_mm_set1_epi8((char) ctrl)));
+}
+#else
+static inline
+unsigned int group_match(const struct oaht_group *group, uint8_t ctrl)
+{
+	unsigned int i, mask = 0;
+
+	for (i = 0; i < GROUP_CTRL; i++)
+		mask |= (unsigned int) (group->ctrl[i] == ctrl) << i;
+	return mask;
+}
+#endif
+
+static
+unsigned long capacity(unsigned long nr_groups)
+{
+	return nr_groups * GROUP_SLOTS;
+}
+
+static
+unsigned long max_used(unsigned long nr_groups)
+{
+	return capacity(nr_groups) - capacity(nr_groups) / 8;
+}
+
+static
+struct oaht_group *group_alloc(const struct oaht_group *from)
+{
+	struct oaht_group *group;
+
+	if (posix_memalign((void **) &group, CAA_CACHE_LINE_SIZE,
+			sizeof(*group)))
+		return NULL;
+	if (from) {
+		memcpy(group, from, sizeof(*group));
+	} else {
+		memset(group->ctrl, CTRL_EMPTY, GROUP_SLOTS);
+		memset(group->ctrl + GROUP_SLOTS, CTRL_DELETED,
+			GROUP_CTRL - GROUP_SLOTS);
+	}
+	return group;
+}
+
+static
+void free_group(struct rcu_head *head)
+{
+	free(caa_container_of(head, struct oaht_group, head));
+}
+
+static
+struct oaht_table *table_alloc(unsigned long nr_groups,
+		const struct rcu_flavor_struct *flavor)
+{
+	struct oaht_table *tbl;
+
+	tbl = calloc(1, sizeof(*tbl) + nr_groups * sizeof(tbl->groups[0]));
+	if (!tbl)
+		return NULL;
+	tbl->mask = nr_groups - 1;
+	tbl->flavor = flavor;
+	return tbl;
+}
+
+static
+void table_free(struct oaht_table *tbl)
+{
+	unsigned long i;
+
+	for (i = 0; i <= tbl->mask; i++)
+		free(tbl->groups[i]);
+	free(tbl);
+}
+
+static
+void free_table(struct rcu_head *head)
+{
+	table_free(caa_container_of(head, struct oaht_table, head));
+}
+
+/* Replace group index of tbl, freeing the previous one after a GP. */
+static
+void group_publish(struct oaht_table *tbl, unsigned long index,
+		struct oaht_group *group)
+{
+	struct oaht_group *old = tbl->groups[index];
+
+	rcu_set_pointer(&tbl->groups[index], group);
+	if (old)
+		tbl->flavor->update_call_rcu(&old->head, free_group);
+}
+
+struct oaht_pos {
+	unsigned long group;
+	unsigned int slot;
+};
+
+/*
+ * Find key in tbl. Return 1 and its position in pos if found, otherwise
+ * return 0 and, in free_pos, the first EMPTY or DELETED slot of the probe
+ * sequence of key (the group is then -1UL if the table has none).
+ */
+static
+int table_find(struct oaht_table *tbl, uint64_t key, uint64_t hash,
+		struct oaht_pos *pos, struct oaht_pos *free_pos)
+{
+	unsigned long index = hash_group(hash, tbl->mask), probe;
+	uint8_t ctrl = hash_ctrl(hash);
+
+	free_pos->group = -1UL;
+	for (probe = 0; probe <= tbl->mask; probe++) {
+		struct oaht_group *group = rcu_dereference(tbl->groups[index]);
+		unsigned int match, free_slots;
+
+		if (!group) {
+			if (free_pos->group == -1UL) {
+				free_pos->group = index;
+				free_pos->slot = 0;
+			}
+			return 0;
+		}
+		match = group_match(group, ctrl);
+		while (match) {
+			unsigned int slot = __builtin_ctz(match);
+
+			if (group->entries[slot].key == key) {
+				pos->group = index;
+				pos->slot = slot;
+				return 1;
+			}
+			match &= match - 1;
+		}
+		free_slots = group_match(group, CTRL_EMPTY);
+		if (free_pos->group == -1UL) {
+			unsigned int deleted = group_match(group, CTRL_DELETED)
+				& ((1U << GROUP_SLOTS) - 1);
+
+			if (free_slots | deleted) {
+				free_pos->group = index;
+				free_pos->slot = __builtin_ctz(free_slots | deleted);
+			}
+		}
+		if (free_slots)
+			return 0;
+		index = (index + probe + 1) & tbl->mask;
+	}
+	return 0;
+}
+
+int cds_oaht_lookup(struct cds_oaht *ht, uint64_t key, uint64_t *value)
+{
+	struct oaht_table *tbl = rcu_dereference(ht->tbl);
+	uint64_t hash = oaht_hash(key);
+	unsigned long index = hash_group(hash, tbl->mask), probe;
+	uint8_t ctrl = hash_ctrl(hash);
+
+	for (probe = 0; probe <= tbl->mask; probe++) {
+		struct oaht_group *group = rcu_dereference(tbl->groups[index]);
+		unsigned int match;
+
+		if (!group)
+			return -ENOENT;
+		match = group_match(group, ctrl);
+		while (match) {
+			unsigned int slot = __builtin_ctz(match);
+
+			if (caa_likely(group->entries[slot].key == key)) {
+				*value = group->entries[slot].value;
+				return 0;
+			}
+			match &= match - 1;
+		}
+		if (group_match(group, CTRL_EMPTY))
+			return -ENOENT;
+		index = (index + probe + 1) & tbl->mask;
+	}
+	return -ENOENT;
+}
+
+/* Insert a key known to be absent in an unpublished table. */
+static
+int table_insert_new(struct oaht_table *tbl, uint64_t key, uint64_t value)
+{
+	uint64_t hash = oaht_hash(key);
+	struct oaht_pos pos, free_pos;
+	struct oaht_group *group;
+
+	(void) table_find(tbl, key, hash, &pos, &free_pos);
+	group = tbl->groups[free_pos.group];
+	if (!group) {
+		group = group_alloc(NULL);
+		if (!group)
+			return -ENOMEM;
+		tbl->groups[free_pos.group] = group;
+	}
+	group->ctrl[free_pos.slot] = hash_ctrl(hash);
+	group->entries[free_pos.slot].key = key;
+	group->entries[free_pos.slot].value = value;
+	return 0;
+}
+
+/*
+ * Replace the table with a table of nr_groups groups holding its keys.
+ * Called with ht->lock held.
+ */
+static
+int table_rebuild(struct cds_oaht *ht, unsigned long nr_groups)
+{
+	struct oaht_table *old = ht->tbl, *tbl;
+	unsigned long i;
+	unsigned int slot;
+
+	tbl = table_alloc(nr_groups, ht->flavor);
+	if (!tbl)
+		return -ENOMEM;
+	for (i = 0; i <= old->mask; i++) {
+		struct oaht_group *group = old->groups[i];
+
+		if (!group)
+			continue;
+		for (slot = 0; slot < GROUP_SLOTS; slot++) {
+			if (group->ctrl[slot] & CTRL_EMPTY)
+				continue;
+			if (table_insert_new(tbl, group->entries[slot].key,
+					group->entries[slot].value)) {
+				table_free(tbl);
+				return -ENOMEM;
+			}
+		}
+	}
+	rcu_set_pointer(&ht->tbl, tbl);
+	ht->used = ht->count;
+	ht->flavor->update_call_rcu(&old->head, free_table);
+	return 0;
+}
+
+/* Make room for one more key. Called with ht->lock held. */
+static
+int table_reserve(struct cds_oaht *ht)
+{
+	unsigned long nr_groups = ht->tbl->mask + 1;
+
+	if (ht->used + 1 <= max_used(nr_groups))
+		return 0;
+	/* Grow if keys, not tombstones, fill more than half the table. */
+	if (ht->count + 1 > max_used(nr_groups) / 2)
+		nr_groups <<= 1;
+	return table_rebuild(ht, nr_groups);
+}
+
+static
+int oaht_add(struct cds_oaht *ht, uint64_t key, uint64_t value, int replace)
+{
+	uint64_t hash = oaht_hash(key);
+	struct oaht_pos pos, free_pos;
+	struct oaht_group *group;
+	struct oaht_table *tbl;
+	int ret;
+
+	mutex_lock(&ht->lock);
+	if (table_find(ht->tbl, key, hash, &pos, &free_pos)) {
+		if (!replace) {
+			ret = -EEXIST;
+			goto end;
+		}
+		tbl = ht->tbl;
+		group = group_alloc(tbl->groups[pos.group]);
+		if (!group) {
+			ret = -ENOMEM;
+			goto end;
+		}
+		group->entries[pos.slot].value = value;
+		group_publish(tbl, pos.group, group);
+		ret = 1;
+		goto end;
+	}
+	if (free_pos.group == -1UL
+			|| ht->used + 1 > max_used(ht->tbl->mask + 1)) {
+		ret = table_reserve(ht);
+		if (ret)
+			goto end;
+		(void) table_find(ht->tbl, key, hash, &pos, &free_pos);
+	}
+	tbl = ht->tbl;
+	group = group_alloc(tbl->groups[free_pos.group]);
+	if (!group) {
+		ret = -ENOMEM;
+		goto end;
+	}
+	if (group->ctrl[free_pos.slot] == CTRL_EMPTY)
+		ht->used++;
+	group->ctrl[free_pos.slot] = hash_ctrl(hash);
+	group->entries[free_pos.slot].key = key;
+	group->entries[free_pos.slot].value = value;
+	group_publish(tbl, free_pos.group, group);
+	CMM_STORE_SHARED(ht->count, ht->count + 1);
+	ret = 0;
+end:
+	mutex_unlock(&ht->lock);
+	return ret;
+}
+
+int cds_oaht_add(struct cds_oaht *ht, uint64_t key, uint64_t value)
+{
+	return oaht_add(ht, key, value, 0);
+}
+
+int cds_oaht_add_replace(struct cds_oaht *ht, uint64_t key, uint64_t value)
+{
+	return oaht_add(ht, key, value, 1);
+}
+
+int cds_oaht_del(struct cds_oaht *ht, uint64_t key)
+{
+	uint64_t hash = oaht_hash(key);
+	struct oaht_pos pos, free_pos;
+	struct oaht_group *old, *group;
+	struct oaht_table *tbl;
+	int ret = 0;
+
+	mutex_lock(&ht->lock);
+	tbl = ht->tbl;
+	if (!table_find(tbl, key, hash, &pos, &free_pos)) {
+		ret = -ENOENT;
+		goto end;
+	}
+	old = tbl->groups[pos.group];
+	if (group_match(old, CTRL_EMPTY)) {
+		/* Never full: no probe sequence goes past this group. */
+		if (group_match(old, CTRL_EMPTY) == (((1U << GROUP_SLOTS) - 1)
+				& ~(1U << pos.slot))) {
+			group = NULL;
+		} else {
+			group = group_alloc(old);
+			if (!group) {
+				ret = -ENOMEM;
+				goto end;
+			}
+			group->ctrl[pos.slot] = CTRL_EMPTY;
+		}
+		ht->used--;
+	} else {
+		group = group_alloc(old);
+		if (!group) {
+			ret = -ENOMEM;
+			goto end;
+		}
+		group->ctrl[pos.slot] = CTRL_DELETED;
+	}
+	group_publish(tbl, pos.group, group);
+	CMM_STORE_SHARED(ht->count, ht->count - 1);
+end:
+	mutex_unlock(&ht->lock);
+	return ret;
+}
+
+unsigned long cds_oaht_count(struct cds_oaht *ht)
+{
+	return CMM_LOAD_SHARED(ht->count);
+}
+
+struct cds_oaht *cds_oaht_new_flavor(unsigned long init_size,
+		const struct rcu_flavor_struct *flavor)
+{
+	struct cds_oaht *ht;
+	unsigned long nr_groups = MIN_NR_GROUPS;
+	int ret;
+
+	while (max_used(nr_groups) < init_size)
+		nr_groups <<= 1;
+	ht = calloc(1, sizeof(*ht));
+	if (!ht)
+		return NULL;
+	ht->flavor = flavor;
+	ht->tbl = table_alloc(nr_groups, flavor);
+	if (!ht->tbl) {
+		free(ht);
+		return NULL;
+	}
+	ret = pthread_mutex_init(&ht->lock, NULL);
+	if (ret)
+		urcu_die(ret);
+	return ht;
+}
+
+void cds_oaht_destroy(struct cds_oaht *ht)
+{
+	int ret;
+
+	/* Wait for readers of the current table. */
+	ht->flavor->update_synchronize_rcu();
+	table_free(ht->tbl);
+	ret = pthread_mutex_destroy(&ht->lock);
+	if (ret)
+		urcu_die(ret);
+	free(ht);
+}
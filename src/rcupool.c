@@ -0,0 +1,469 @@
+/*
+ * rcupool.c
+ *
+ * Userspace RCU library - Object pool with grace-period deferred reuse
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+/*
+ * Objects are handed out and freed in magazines: arrays of up to
+ * POOL_MAG_SIZE object pointers, so freeing an object never writes to
+ * the object itself, which readers may still be accessing. Each CPU has
+ * a cache of the pool, protected by a mutex which is only contended
+ * when threads migrate, holding:
+ *
+ * - an alloc magazine, of objects ready to be reused.
+ * - a free magazine, filled by cds_rcu_pool_free(), and tagged with the
+ *   grace period state at the time of its last free.
+ * - pending magazines, full free magazines waiting for their grace
+ *   period, oldest first. Only the head of the list needs to be polled.
+ *
+ * The grace period is thus tracked per magazine instead of per object,
+ * and the thread freeing objects starts a grace period with the polling
+ * API at most once per grace period. Past their grace period, the
+ * objects a CPU freed are reused in priority by that CPU, while they are
+ * still cache-hot.
+ *
+ * Caches exchange whole magazines with depots shared by all CPUs: a
+ * lock-free stack of ready magazines, refilled with new pages, one of
+ * empty magazines, and a queue of the pending magazines exceeding
+ * POOL_CPU_PENDING per CPU, so that objects freed on a CPU which does
+ * not allocate are eventually reused by the others.
+ */
+
+#define _LGPL_SOURCE
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <unistd.h>
+#include <errno.h>
+#include <pthread.h>
+
+#include <urcu/compiler.h>
+#include <urcu/uatomic.h>
+#include <urcu/tls-compat.h>
+#include <urcu/lfstack.h>
+#include <urcu/wfcqueue.h>
+#include <urcu/flavor.h>
+#include <urcu/rcupool.h>
+
+#include "compat-getcpu.h"
+#include "urcu-die.h"
+
+/* Page size, grown for large objects to hold at least POOL_MIN_SLOTS. */
+#define POOL_PAGE_SIZE		(64UL << 10)
+#define POOL_MIN_SLOTS		16
+
+/*
+ * Objects per magazine, and number of full free magazines a CPU keeps
+ * for itself before handing them over to the depot.
+ */
+#define POOL_MAG_SIZE		64
+#define POOL_CPU_PENDING	4
+
+struct pool_mag {
+	struct cds_lfs_node lfs_node;	/* Node in a depot stack. */
+	struct cds_wfcq_node wfcq_node;	/* Node in the pending queue. */
+	struct pool_mag *next;		/* Next pending magazine of a CPU. */
+	struct pool_mag *all_next;	/* Next in pool->mags. */
+	unsigned long cookie;	/* Grace period state of the last free. */
+	unsigned int nr;
+	void *objs[POOL_MAG_SIZE];
+};
+
+struct pool_page {
+	struct pool_page *next;
+};
+
+struct pool_cpu {
+	pthread_mutex_t lock;
+	struct pool_mag *alloc;		/* Ready objects, or NULL. */
+	struct pool_mag *free;		/* Objects being freed, or NULL. */
+	struct pool_mag *pending_head, *pending_tail;	/* Oldest first. */
+	unsigned int nr_pending;
+	unsigned long poll_cookie;	/* Last grace period started. */
+	int poll_started;
+} __attribute__((aligned(CAA_CACHE_LINE_SIZE)));
+
+struct cds_rcu_pool {
+	const struct rcu_flavor_struct *flavor;
+	size_t slot_size;
+	size_t page_size;
+	size_t page_align;
+	size_t first_slot;		/* From page start to first slot. */
+	unsigned long nr_cpus;
+	struct pool_cpu *cpus;
+
+	struct cds_lfs_stack full;	/* Ready magazines. */
+	struct cds_lfs_stack empty;	/* Empty magazines. */
+	/* Pending magazines, in the order they were handed over. */
+	struct __cds_wfcq_head pending_head;
+	struct cds_wfcq_tail pending_tail;
+
+	pthread_mutex_t lock;		/* Protects the fields below. */
+	struct pool_page *pages;
+	struct pool_mag *mags;		/* All magazines. */
+};
+
+/*
+ * Cache of threads for which the current CPU is unknown: each thread
+ * picks one on first use, spreading threads over the caches.
+ */
+static DEFINE_URCU_TLS(unsigned long, thread_cpu);
+static unsigned long next_thread_cpu;
+
+static void mutex_lock(pthread_mutex_t *mutex)
+{
+	int ret;
+
+	ret = pthread_mutex_lock(mutex);
+	if (ret)
+		urcu_die(ret);
+}
+
+static void mutex_unlock(pthread_mutex_t *mutex)
+{
+	int ret;
+
+	ret = pthread_mutex_unlock(mutex);
+	if (ret)
+		urcu_die(ret);
+}
+
+static
+size_t align_up(size_t size, size_t align)
+{
+	return (size + align - 1) & ~(align - 1);
+}
+
+static
+struct pool_cpu *get_cpu(struct cds_rcu_pool *pool)
+{
+	int cpu;
+
+	cpu = urcu_sched_getcpu();
+	if (caa_likely(cpu >= 0))
+		return &pool->cpus[cpu % pool->nr_cpus];
+	if (caa_unlikely(!URCU_TLS(thread_cpu)))
+		URCU_TLS(thread_cpu) =
+			uatomic_add_return(&next_thread_cpu, 1);
+	return &pool->cpus[URCU_TLS(thread_cpu) % pool->nr_cpus];
+}
+
+static
+int mag_ready(struct cds_rcu_pool *pool, struct pool_mag *mag)
+{
+	return pool->flavor->update_poll_state_synchronize_rcu(mag->cookie);
+}
+
+/* Get an empty magazine from the depot, or allocate a new one. */
+static
+struct pool_mag *mag_get_empty(struct cds_rcu_pool *pool)
+{
+	struct cds_lfs_node *node;
+	struct pool_mag *mag;
+
+	node = cds_lfs_pop_blocking(&pool->empty);
+	if (node)
+		return caa_container_of(node, struct pool_mag, lfs_node);
+	mag = malloc(sizeof(*mag));
+	if (!mag)
+		return NULL;
+	mag->nr = 0;
+	mutex_lock(&pool->lock);
+	mag->all_next = pool->mags;
+	pool->mags = mag;
+	mutex_unlock(&pool->lock);
+	return mag;
+}
+
+/* Give a magazine back to the depot of its state. */
+static
+void mag_put(struct cds_rcu_pool *pool, struct pool_mag *mag)
+{
+	cds_lfs_node_init(&mag->lfs_node);
+	if (mag->nr)
+		cds_lfs_push(&pool->full, &mag->lfs_node);
+	else
+		cds_lfs_push(&pool->empty, &mag->lfs_node);
+}
+
+/*
+ * Carve a new page into ready magazines: return the first one, and push
+ * the others to the depot. Return NULL on allocation failure.
+ */
+static
+struct pool_mag *pool_grow(struct cds_rcu_pool *pool)
+{
+	struct pool_mag *mag, *first = NULL;
+	struct pool_page *page;
+	char *pos;
+
+	if (posix_memalign((void **) &page, pool->page_align,
+			pool->page_size))
+		return NULL;
+	mutex_lock(&pool->lock);
+	page->next = pool->pages;
+	pool->pages = page;
+	mutex_unlock(&pool->lock);
+
+	mag = NULL;
+	for (pos = (char *) page + pool->first_slot;
+			pos + pool->slot_size <= (char *) page + pool->page_size;
+			pos += pool->slot_size) {
+		if (!mag) {
+			mag = mag_get_empty(pool);
+			if (!mag)
+				break;
+		}
+		mag->objs[mag->nr++] = pos;
+		if (mag->nr == POOL_MAG_SIZE) {
+			if (first)
+				mag_put(pool, mag);
+			else
+				first = mag;
+			mag = NULL;
+		}
+	}
+	if (mag) {
+		if (first)
+			mag_put(pool, mag);
+		else
+			first = mag;
+	}
+	/*
+	 * Slots left without a magazine on allocation failure are only
+	 * freed with the page.
+	 */
+	return first;
+}
+
+/*
+ * Get a ready magazine for cpu, preferring the objects it freed, then
+ * the objects other CPUs handed over, then the depot, and a new page.
+ */
+static
+struct pool_mag *cpu_get_ready(struct cds_rcu_pool *pool,
+		struct pool_cpu *cpu)
+{
+	struct cds_lfs_node *lfs_node;
+	struct cds_wfcq_node *wfcq_node;
+	struct pool_mag *mag = NULL;
+
+	if (cpu->free && cpu->free->nr && mag_ready(pool, cpu->free)) {
+		mag = cpu->free;
+		cpu->free = NULL;
+		return mag;
+	}
+	/*
+	 * The pending queue is only roughly sorted by grace period state,
+	 * as CPUs hand magazines over concurrently: polling its head only
+	 * may delay the reuse of the magazines behind it, never hasten it.
+	 */
+	if (!cds_wfcq_empty(&pool->pending_head, &pool->pending_tail)) {
+		mutex_lock(&pool->lock);
+		wfcq_node = __cds_wfcq_first_blocking(&pool->pending_head,
+				&pool->pending_tail);
+		if (wfcq_node) {
+			mag = caa_container_of(wfcq_node, struct pool_mag,
+					wfcq_node);
+			if (mag_ready(pool, mag))
+				(void) __cds_wfcq_dequeue_blocking(
+					&pool->pending_head,
+					&pool->pending_tail);
+			else
+				mag = NULL;
+		}
+		mutex_unlock(&pool->lock);
+		if (mag)
+			return mag;
+	}
+	lfs_node = cds_lfs_pop_blocking(&pool->full);
+	if (lfs_node)
+		return caa_container_of(lfs_node, struct pool_mag, lfs_node);
+	return pool_grow(pool);
+}
+
+/* Replace the alloc magazine of cpu, giving the previous one back. */
+static
+void cpu_load(struct cds_rcu_pool *pool, struct pool_cpu *cpu,
+		struct pool_mag *mag)
+{
+	if (cpu->alloc)
+		mag_put(pool, cpu->alloc);
+	cpu->alloc = mag;
+}
+
+/*
+ * Queue the full free magazine of cpu as pending, handing the oldest
+ * pending magazine of cpu over to the depot beyond POOL_CPU_PENDING.
+ */
+static
+void cpu_retire_free(struct cds_rcu_pool *pool, struct pool_cpu *cpu)
+{
+	struct pool_mag *mag = cpu->free;
+
+	cpu->free = NULL;
+	mag->next = NULL;
+	if (cpu->pending_tail)
+		cpu->pending_tail->next = mag;
+	else
+		cpu->pending_head = mag;
+	cpu->pending_tail = mag;
+	if (++cpu->nr_pending <= POOL_CPU_PENDING)
+		return;
+	mag = cpu->pending_head;
+	cpu->pending_head = mag->next;
+	cpu->nr_pending--;
+	cds_wfcq_node_init(&mag->wfcq_node);
+	(void) cds_wfcq_enqueue(&pool->pending_head, &pool->pending_tail,
+			&mag->wfcq_node);
+}
+
+struct cds_rcu_pool *cds_rcu_pool_create_flavor(size_t obj_size,
+		size_t obj_align, const struct rcu_flavor_struct *flavor)
+{
+	struct cds_rcu_pool *pool;
+	unsigned long i;
+	long nr_cpus;
+	int ret;
+
+	if (!obj_align)
+		obj_align = 2 * sizeof(void *);
+	if (!obj_size || (obj_align & (obj_align - 1)))
+		return NULL;
+	obj_align = caa_max(obj_align, sizeof(void *));
+
+	pool = calloc(1, sizeof(*pool));
+	if (!pool)
+		return NULL;
+	nr_cpus = sysconf(_SC_NPROCESSORS_CONF);
+	pool->nr_cpus = nr_cpus > 0 ? nr_cpus : 1;
+	if (posix_memalign((void **) &pool->cpus, CAA_CACHE_LINE_SIZE,
+			pool->nr_cpus * sizeof(*pool->cpus))) {
+		free(pool);
+		return NULL;
+	}
+	memset(pool->cpus, 0, pool->nr_cpus * sizeof(*pool->cpus));
+	for (i = 0; i < pool->nr_cpus; i++) {
+		ret = pthread_mutex_init(&pool->cpus[i].lock, NULL);
+		if (ret)
+			urcu_die(ret);
+	}
+	pool->flavor = flavor;
+	pool->slot_size = align_up(obj_size, obj_align);
+	pool->first_slot = align_up(sizeof(struct pool_page), obj_align);
+	pool->page_align = obj_align;
+	pool->page_size = caa_max(POOL_PAGE_SIZE,
+			pool->first_slot + POOL_MIN_SLOTS * pool->slot_size);
+	cds_lfs_init(&pool->full);
+	cds_lfs_init(&pool->empty);
+	__cds_wfcq_init(&pool->pending_head, &pool->pending_tail);
+	ret = pthread_mutex_init(&pool->lock, NULL);
+	if (ret)
+		urcu_die(ret);
+	return pool;
+}
+
+void cds_rcu_pool_destroy(struct cds_rcu_pool *pool)
+{
+	struct pool_page *page;
+	struct pool_mag *mag;
+	unsigned long i;
+	int ret;
+
+	/* Wait for readers of the objects freed last. */
+	pool->flavor->update_synchronize_rcu();
+	for (i = 0; i < pool->nr_cpus; i++) {
+		ret = pthread_mutex_destroy(&pool->cpus[i].lock);
+		if (ret)
+			urcu_die(ret);
+	}
+	free(pool->cpus);
+	while ((mag = pool->mags) != NULL) {
+		pool->mags = mag->all_next;
+		free(mag);
+	}
+	while ((page = pool->pages) != NULL) {
+		pool->pages = page->next;
+		free(page);
+	}
+	cds_lfs_destroy(&pool->full);
+	cds_lfs_destroy(&pool->empty);
+	ret = pthread_mutex_destroy(&pool->lock);
+	if (ret)
+		urcu_die(ret);
+	free(pool);
+}
+
+void *cds_rcu_pool_alloc(struct cds_rcu_pool *pool)
+{
+	struct pool_cpu *cpu;
+	struct pool_mag *mag;
+	void *obj;
+
+	cpu = get_cpu(pool);
+	mutex_lock(&cpu->lock);
+	/* Reuse the oldest objects freed on this CPU while cache-hot. */
+	mag = cpu->pending_head;
+	if (mag && mag_ready(pool, mag)) {
+		cpu->pending_head = mag->next;
+		if (!cpu->pending_head)
+			cpu->pending_tail = NULL;
+		cpu->nr_pending--;
+		cpu_load(pool, cpu, mag);
+	} else if (caa_unlikely(!cpu->alloc || !cpu->alloc->nr)) {
+		mag = cpu_get_ready(pool, cpu);
+		if (caa_unlikely(!mag)) {
+			mutex_unlock(&cpu->lock);
+			return NULL;
+		}
+		cpu_load(pool, cpu, mag);
+	}
+	mag = cpu->alloc;
+	obj = mag->objs[--mag->nr];
+	mutex_unlock(&cpu->lock);
+	return obj;
+}
+
+void cds_rcu_pool_free(struct cds_rcu_pool *pool, void *obj)
+{
+	const struct rcu_flavor_struct *flavor = pool->flavor;
+	struct pool_cpu *cpu;
+	struct pool_mag *mag;
+	unsigned long cookie;
+
+	cpu = get_cpu(pool);
+	mutex_lock(&cpu->lock);
+	if (caa_unlikely(!cpu->free || cpu->free->nr == POOL_MAG_SIZE)) {
+		if (cpu->free)
+			cpu_retire_free(pool, cpu);
+		cpu->free = mag_get_empty(pool);
+		if (caa_unlikely(!cpu->free))
+			urcu_die(ENOMEM);
+	}
+	mag = cpu->free;
+	cookie = flavor->update_get_state_synchronize_rcu();
+	if (!cpu->poll_started || cookie != cpu->poll_cookie) {
+		/* One grace period request covers all objects freed meanwhile. */
+		cookie = flavor->update_start_poll_synchronize_rcu();
+		cpu->poll_cookie = cookie;
+		cpu->poll_started = 1;
+	}
+	mag->cookie = cookie;
+	mag->objs[mag->nr++] = obj;
+	mutex_unlock(&cpu->lock);
+}
@@ -0,0 +1,188 @@
+/*
+ * rcureplica.c
+ *
+ * Userspace RCU library - RCU NUMA node replicas
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+#define _LGPL_SOURCE
+#include <stdlib.h>
+#include <errno.h>
+#include <pthread.h>
+#include <unistd.h>
+
+#include <urcu/compiler.h>
+#include <urcu/pointer.h>
+#include <urcu/uatomic.h>
+#include <urcu/call-rcu.h>
+#include <urcu/flavor.h>
+#include <urcu/rcureplica.h>
+
+#include "compat-getcpu.h"
+#include "compat-numa.h"
+#include "urcu-die.h"
+
+/* Node of each configured CPU, built once. */
+static int *replica_cpu_node;
+static long replica_nr_cpus;
+static int replica_nr_nodes = 1;
+static pthread_once_t replica_map_once = PTHREAD_ONCE_INIT;
+
+static void mutex_lock(pthread_mutex_t *mutex)
+{
+	int ret;
+
+	ret = pthread_mutex_lock(mutex);
+	if (ret)
+		urcu_die(ret);
+}
+
+static void mutex_unlock(pthread_mutex_t *mutex)
+{
+	int ret;
+
+	ret = pthread_mutex_unlock(mutex);
+	if (ret)
+		urcu_die(ret);
+}
+
+/* CPUs of unknown node map to node 0. */
+static
+void replica_map_init(void)
+{
+	long nr_cpus, cpu;
+	int *cpu_node, node, nr_nodes = 1;
+
+	nr_cpus = sysconf(_SC_NPROCESSORS_CONF);
+	if (nr_cpus <= 0)
+		return;
+	cpu_node = malloc(nr_cpus * sizeof(*cpu_node));
+	if (!cpu_node)
+		return;
+	for (cpu = 0; cpu < nr_cpus; cpu++) {
+		node = urcu_numa_node_of_cpu(cpu);
+		if (node < 0)
+			node = 0;
+		cpu_node[cpu] = node;
+		if (node >= nr_nodes)
+			nr_nodes = node + 1;
+	}
+	replica_cpu_node = cpu_node;
+	replica_nr_nodes = nr_nodes;
+	uatomic_store_release(&replica_nr_cpus, nr_cpus);
+}
+
+static
+void replica_map_get(void)
+{
+	int ret;
+
+	ret = pthread_once(&replica_map_once, replica_map_init);
+	if (ret)
+		urcu_die(ret);
+}
+
+int cds_rcu_replica_nr_nodes(void)
+{
+	replica_map_get();
+	return replica_nr_nodes;
+}
+
+/*
+ * The first update builds the map. Before, all CPUs are of unknown
+ * node.
+ */
+int cds_rcu_replica_current_node(void)
+{
+	long nr_cpus = uatomic_load_acquire(&replica_nr_cpus);
+	int cpu = urcu_sched_getcpu();
+
+	if (caa_unlikely(cpu < 0 || cpu >= nr_cpus))
+		return 0;
+	return replica_cpu_node[cpu];
+}
+
+static
+void free_set(struct rcu_head *head)
+{
+	struct cds_rcu_replica_set *set =
+		caa_container_of(head, struct cds_rcu_replica_set, head);
+	int node;
+
+	for (node = 0; node < set->nr_nodes; node++)
+		set->free_replica(set->replica[node], node, set->priv);
+	free(set);
+}
+
+void cds_rcu_replica_init_flavor(struct cds_rcu_replica *replica,
+		cds_rcu_replica_copy_fct copy,
+		cds_rcu_replica_free_fct free_replica, void *priv,
+		const struct rcu_flavor_struct *flavor)
+{
+	int ret;
+
+	replica->set = NULL;
+	replica->copy = copy;
+	replica->free_replica = free_replica;
+	replica->priv = priv;
+	replica->flavor = flavor;
+	ret = pthread_mutex_init(&replica->lock, NULL);
+	if (ret)
+		urcu_die(ret);
+}
+
+void cds_rcu_replica_destroy(struct cds_rcu_replica *replica)
+{
+	int ret;
+
+	if (replica->set)
+		free_set(&replica->set->head);
+	replica->set = NULL;
+	ret = pthread_mutex_destroy(&replica->lock);
+	if (ret)
+		urcu_die(ret);
+}
+
+int cds_rcu_replica_update(struct cds_rcu_replica *replica, const void *obj)
+{
+	struct cds_rcu_replica_set *set, *old;
+	int node, nr_nodes = cds_rcu_replica_nr_nodes();
+
+	set = malloc(sizeof(*set) + nr_nodes * sizeof(set->replica[0]));
+	if (!set)
+		return -ENOMEM;
+	set->free_replica = replica->free_replica;
+	set->priv = replica->priv;
+	set->nr_nodes = nr_nodes;
+	for (node = 0; node < nr_nodes; node++) {
+		set->replica[node] = replica->copy(obj, node, replica->priv);
+		if (!set->replica[node])
+			goto error;
+	}
+	mutex_lock(&replica->lock);
+	old = replica->set;
+	rcu_set_pointer(&replica->set, set);
+	mutex_unlock(&replica->lock);
+	if (old)
+		replica->flavor->update_call_rcu(&old->head, free_set);
+	return 0;
+
+error:
+	while (node-- > 0)
+		set->free_replica(set->replica[node], node, set->priv);
+	free(set);
+	return -ENOMEM;
+}
@@ -0,0 +1,727 @@
+/*
+ * rcurht.c
+ *
+ * Userspace RCU library - Relativistic hash table with per-bucket locks
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+/*
+ * A grow multiplies the number of buckets by up to 1 << RHT_GROW_SHIFT
+ * at once, so that the chain of an old bucket is zipped with the chains
+ * of as many new buckets, its siblings, of the same index modulo the
+ * old size. A sibling has about as many nodes as the load factor, which
+ * bounds the number of grace periods of the unzip.
+ *
+ * Chains are singly linked: while siblings are zipped, a node may be
+ * linked by a node of each, and the links to a node are found by
+ * walking the chains of all siblings, which share a stripe lock. Nodes
+ * keep their hash, so that lookups and iterations skip the nodes of the
+ * other siblings of a zipped chain.
+ *
+ * A chain is unzipped by cutting the first link from a node of its
+ * bucket, or its head, to a node of another bucket: the link is set to
+ * the next node of its bucket. A link may only be cut if its node is
+ * not reachable from the other siblings, whose readers would otherwise
+ * skip the nodes of their bucket following it. Links are cut at most
+ * one per chain and per grace period, once the readers of the previous
+ * state are done, and one of the chains of zipped siblings always has a
+ * link to cut.
+ */
+
+#define _LGPL_SOURCE
+#include <stdlib.h>
+#include <errno.h>
+#include <pthread.h>
+
+#include <urcu/compiler.h>
+#include <urcu/arch.h>
+#include <urcu/uatomic.h>
+#include <urcu/pointer.h>
+#include <urcu/flavor.h>
+#include <urcu/rcurht.h>
+
+#include "urcu-die.h"
+#include "workqueue.h"
+
+/* Delay of automatic resizes, covering bursts of updates. */
+#define RHT_RESIZE_DELAY_MS	1
+
+/* Largest grow factor, as a shift. */
+#define RHT_GROW_SHIFT		4
+
+/* Average chain length triggering a grow, and inverse for a shrink. */
+#define RHT_GROW_LOAD		2
+#define RHT_SHRINK_LOAD		8
+
+struct rht_stripe {
+	pthread_mutex_t lock;
+	long count;			/* ATOMIC: nodes of the stripe. */
+} __attribute__((aligned(CAA_CACHE_LINE_SIZE)));
+
+struct cds_rht_table {
+	unsigned long size;
+	unsigned long zip_size;		/* ATOMIC: size zipped from, or 0. */
+	struct cds_rht_node *bucket[];
+};
+
+struct cds_rht {
+	struct cds_rht_table *table;	/* RCU, changed with all stripes. */
+	unsigned long min_nr_buckets;
+	unsigned long max_nr_buckets;
+	int flags;
+	int in_progress_destroy;
+	const struct rcu_flavor_struct *flavor;
+	struct urcu_workqueue *workqueue;
+	struct urcu_work resize_work;
+	pthread_mutex_t resize_mutex;
+	struct rht_stripe *stripe;
+};
+
+static void mutex_lock(pthread_mutex_t *mutex)
+{
+	int ret;
+
+	ret = pthread_mutex_lock(mutex);
+	if (ret)
+		urcu_die(ret);
+}
+
+static void mutex_unlock(pthread_mutex_t *mutex)
+{
+	int ret;
+
+	ret = pthread_mutex_unlock(mutex);
+	if (ret)
+		urcu_die(ret);
+}
+
+static inline
+struct rht_stripe *stripe_of(struct cds_rht *ht, unsigned long hash)
+{
+	return &ht->stripe[hash & (CDS_RHT_NR_LOCKS - 1)];
+}
+
+static
+void lock_all(struct cds_rht *ht)
+{
+	int i;
+
+	for (i = 0; i < CDS_RHT_NR_LOCKS; i++)
+		mutex_lock(&ht->stripe[i].lock);
+}
+
+static
+void unlock_all(struct cds_rht *ht)
+{
+	int i;
+
+	for (i = 0; i < CDS_RHT_NR_LOCKS; i++)
+		mutex_unlock(&ht->stripe[i].lock);
+}
+
+static
+long approx_count(struct cds_rht *ht)
+{
+	long count = 0;
+	int i;
+
+	for (i = 0; i < CDS_RHT_NR_LOCKS; i++)
+		count += uatomic_read(&ht->stripe[i].count);
+	return count;
+}
+
+static inline
+unsigned long bucket_index(const struct cds_rht_table *table,
+		unsigned long hash)
+{
+	return hash & (table->size - 1);
+}
+
+static
+unsigned long round_size(struct cds_rht *ht, unsigned long size)
+{
+	unsigned long rounded = ht->min_nr_buckets;
+
+	while (rounded < size && rounded < ht->max_nr_buckets)
+		rounded <<= 1;
+	return rounded;
+}
+
+static
+struct cds_rht_table *alloc_table(unsigned long size)
+{
+	struct cds_rht_table *table;
+
+	if (size > (~0UL - sizeof(*table)) / sizeof(table->bucket[0]))
+		return NULL;
+	table = calloc(1, sizeof(*table) + size * sizeof(table->bucket[0]));
+	if (!table)
+		return NULL;
+	table->size = size;
+	return table;
+}
+
+/* Lookups and iterations. */
+
+static
+struct cds_rht_node *find_hash(struct cds_rht_node *node, unsigned long hash,
+		cds_rht_match_fct match, const void *key)
+{
+	for (; node; node = rcu_dereference(node->next)) {
+		if (node->hash == hash && match(node, key))
+			break;
+	}
+	return node;
+}
+
+static
+void set_iter(struct cds_rht_iter *iter, struct cds_rht_node *node)
+{
+	iter->node = node;
+	iter->next = node ? rcu_dereference(node->next) : NULL;
+}
+
+void cds_rht_lookup(struct cds_rht *ht, unsigned long hash,
+		cds_rht_match_fct match, const void *key,
+		struct cds_rht_iter *iter)
+{
+	struct cds_rht_table *table = rcu_dereference(ht->table);
+
+	iter->table = table;
+	iter->bucket = bucket_index(table, hash);
+	set_iter(iter, find_hash(rcu_dereference(table->bucket[iter->bucket]),
+		hash, match, key));
+}
+
+void cds_rht_next_duplicate(struct cds_rht *ht, cds_rht_match_fct match,
+		const void *key, struct cds_rht_iter *iter)
+{
+	set_iter(iter, find_hash(iter->next, iter->node->hash, match, key));
+}
+
+/* Return the first node of the bucket of @iter from @node on, or after. */
+static
+void scan_buckets(struct cds_rht_iter *iter, struct cds_rht_node *node)
+{
+	struct cds_rht_table *table = iter->table;
+
+	for (;;) {
+		for (; node; node = rcu_dereference(node->next)) {
+			if (bucket_index(table, node->hash) == iter->bucket) {
+				set_iter(iter, node);
+				return;
+			}
+		}
+		if (++iter->bucket == table->size)
+			break;
+		node = rcu_dereference(table->bucket[iter->bucket]);
+	}
+	set_iter(iter, NULL);
+}
+
+void cds_rht_first(struct cds_rht *ht, struct cds_rht_iter *iter)
+{
+	struct cds_rht_table *table = rcu_dereference(ht->table);
+
+	iter->table = table;
+	iter->bucket = 0;
+	scan_buckets(iter, rcu_dereference(table->bucket[0]));
+}
+
+void cds_rht_next(struct cds_rht *ht, struct cds_rht_iter *iter)
+{
+	scan_buckets(iter, iter->next);
+}
+
+void cds_rht_count_nodes(struct cds_rht *ht, long *approx_before,
+		unsigned long *count, long *approx_after)
+{
+	struct cds_rht_iter iter;
+	struct cds_rht_node *node;
+
+	*approx_before = approx_count(ht);
+	*count = 0;
+	cds_rht_for_each(ht, &iter, node)
+		(*count)++;
+	*approx_after = approx_count(ht);
+}
+
+/* Updates, with the stripe of the bucket locked. */
+
+static
+struct cds_rht_node *find_locked(struct cds_rht_table *table,
+		unsigned long hash, cds_rht_match_fct match, const void *key)
+{
+	struct cds_rht_node *node;
+
+	for (node = table->bucket[bucket_index(table, hash)]; node;
+			node = node->next) {
+		if (node->hash == hash && match(node, key))
+			break;
+	}
+	return node;
+}
+
+/* Link to @new the links to @old of the chain of @link. */
+static
+int relink_chain(struct cds_rht_node **link, struct cds_rht_node *old,
+		struct cds_rht_node *new)
+{
+	for (; *link; link = &(*link)->next) {
+		if (*link == old) {
+			rcu_set_pointer(link, new);
+			return 1;
+		}
+	}
+	return 0;
+}
+
+/*
+ * Link to @new all the links to @old, node of @bucket. Return whether
+ * @old was linked.
+ */
+static
+int relink(struct cds_rht_table *table, unsigned long bucket,
+		struct cds_rht_node *old, struct cds_rht_node *new)
+{
+	unsigned long zip_size = CMM_LOAD_SHARED(table->zip_size);
+	int found = 0;
+
+	if (!zip_size)
+		return relink_chain(&table->bucket[bucket], old, new);
+	for (bucket &= zip_size - 1; bucket < table->size; bucket += zip_size)
+		found |= relink_chain(&table->bucket[bucket], old, new);
+	return found;
+}
+
+static
+void link_head(struct cds_rht_table *table, unsigned long hash,
+		struct cds_rht_node *node)
+{
+	struct cds_rht_node **head = &table->bucket[bucket_index(table, hash)];
+
+	node->hash = hash;
+	node->next = *head;
+	rcu_set_pointer(head, node);
+}
+
+static
+void do_resize_work(struct urcu_work *work);
+
+static
+void queue_resize(struct cds_rht *ht)
+{
+	if (CMM_LOAD_SHARED(ht->in_progress_destroy))
+		return;
+	(void) urcu_workqueue_queue_delayed_work(ht->workqueue,
+		&ht->resize_work, do_resize_work, RHT_RESIZE_DELAY_MS,
+		URCU_WORK_COALESCE);
+}
+
+static
+void added(struct cds_rht *ht, struct rht_stripe *stripe,
+		struct cds_rht_table *table)
+{
+	long count = stripe->count + 1;
+
+	uatomic_set(&stripe->count, count);
+	if ((ht->flags & CDS_RHT_AUTO_RESIZE) && table->size < ht->max_nr_buckets
+			&& count > RHT_GROW_LOAD
+				* (long) (table->size / CDS_RHT_NR_LOCKS))
+		queue_resize(ht);
+}
+
+static
+void removed(struct cds_rht *ht, struct rht_stripe *stripe,
+		struct cds_rht_table *table)
+{
+	long count = stripe->count - 1;
+
+	uatomic_set(&stripe->count, count);
+	if ((ht->flags & CDS_RHT_AUTO_RESIZE)
+			&& table->size > ht->min_nr_buckets
+			&& count < (long) (table->size / CDS_RHT_NR_LOCKS)
+				/ RHT_SHRINK_LOAD)
+		queue_resize(ht);
+}
+
+void cds_rht_add(struct cds_rht *ht, unsigned long hash,
+		struct cds_rht_node *node)
+{
+	struct rht_stripe *stripe = stripe_of(ht, hash);
+	struct cds_rht_table *table;
+
+	mutex_lock(&stripe->lock);
+	table = ht->table;
+	link_head(table, hash, node);
+	added(ht, stripe, table);
+	mutex_unlock(&stripe->lock);
+}
+
+struct cds_rht_node *cds_rht_add_unique(struct cds_rht *ht,
+		unsigned long hash, cds_rht_match_fct match,
+		const void *key, struct cds_rht_node *node)
+{
+	struct rht_stripe *stripe = stripe_of(ht, hash);
+	struct cds_rht_table *table;
+	struct cds_rht_node *found;
+
+	mutex_lock(&stripe->lock);
+	table = ht->table;
+	found = find_locked(table, hash, match, key);
+	if (!found) {
+		link_head(table, hash, node);
+		added(ht, stripe, table);
+	}
+	mutex_unlock(&stripe->lock);
+	return found ? found : node;
+}
+
+struct cds_rht_node *cds_rht_add_replace(struct cds_rht *ht,
+		unsigned long hash, cds_rht_match_fct match,
+		const void *key, struct cds_rht_node *node)
+{
+	struct rht_stripe *stripe = stripe_of(ht, hash);
+	struct cds_rht_table *table;
+	struct cds_rht_node *old;
+
+	mutex_lock(&stripe->lock);
+	table = ht->table;
+	old = find_locked(table, hash, match, key);
+	if (old) {
+		node->hash = hash;
+		node->next = old->next;
+		(void) relink(table, bucket_index(table, hash), old, node);
+	} else {
+		link_head(table, hash, node);
+		added(ht, stripe, table);
+	}
+	mutex_unlock(&stripe->lock);
+	return old;
+}
+
+int cds_rht_del(struct cds_rht *ht, struct cds_rht_node *node)
+{
+	struct rht_stripe *stripe;
+	struct cds_rht_table *table;
+	int found;
+
+	if (!node)
+		return -ENOENT;
+	stripe = stripe_of(ht, node->hash);
+	mutex_lock(&stripe->lock);
+	table = ht->table;
+	found = relink(table, bucket_index(table, node->hash), node,
+		node->next);
+	if (found)
+		removed(ht, stripe, table);
+	mutex_unlock(&stripe->lock);
+	return found ? 0 : -ENOENT;
+}
+
+/* Resizes, with the resize mutex held. */
+
+/*
+ * Return whether @node is reachable from @link.
+ */
+static
+int reachable(struct cds_rht_node *link, struct cds_rht_node *node)
+{
+	for (; link; link = link->next) {
+		if (link == node)
+			return 1;
+	}
+	return 0;
+}
+
+/* Return whether @node is reachable from a sibling of @bucket. */
+static
+int reachable_sibling(struct cds_rht_table *table, unsigned long bucket,
+		struct cds_rht_node *node)
+{
+	unsigned long sibling;
+
+	for (sibling = bucket & (table->zip_size - 1); sibling < table->size;
+			sibling += table->zip_size) {
+		if (sibling != bucket
+				&& reachable(table->bucket[sibling], node))
+			return 1;
+	}
+	return 0;
+}
+
+/*
+ * Find the first link of the chain of @bucket to a node of another
+ * bucket, and the link to cut it to into *@cut, or NULL if it may not
+ * be cut yet. Return whether the chain has such a link.
+ */
+static
+int find_zip(struct cds_rht_table *table, unsigned long bucket,
+		struct cds_rht_node ***cut, struct cds_rht_node **to)
+{
+	struct cds_rht_node **link = &table->bucket[bucket], *node;
+
+	*cut = NULL;
+	while (*link && bucket_index(table, (*link)->hash) == bucket)
+		link = &(*link)->next;
+	if (!*link)
+		return 0;
+	if (link != &table->bucket[bucket]
+			&& reachable_sibling(table, bucket,
+				caa_container_of(link, struct cds_rht_node,
+					next)))
+		return 1;
+	for (node = *link; node && bucket_index(table, node->hash) != bucket;
+			node = node->next)
+		;
+	*cut = link;
+	*to = node;
+	return 1;
+}
+
+/*
+ * Cut a link of each chain of the siblings of @bucket, if allowed. All
+ * are found before cutting any, so that the readers of the other
+ * siblings following a cut link are done before the next cut. Return
+ * whether the chains were still zipped.
+ */
+static
+int unzip_siblings(struct cds_rht_table *table, unsigned long bucket)
+{
+	struct cds_rht_node **cut[1UL << RHT_GROW_SHIFT];
+	struct cds_rht_node *to[1UL << RHT_GROW_SHIFT];
+	unsigned long nr = table->size / table->zip_size, i;
+	int zipped = 0;
+
+	for (i = 0; i < nr; i++)
+		zipped |= find_zip(table, bucket + i * table->zip_size,
+			&cut[i], &to[i]);
+	for (i = 0; i < nr; i++) {
+		if (cut[i])
+			rcu_set_pointer(cut[i], to[i]);
+	}
+	return zipped;
+}
+
+static
+void unzip(struct cds_rht *ht, struct cds_rht_table *table)
+{
+	unsigned long bucket;
+	int zipped, i;
+
+	for (;;) {
+		zipped = 0;
+		for (i = 0; i < CDS_RHT_NR_LOCKS; i++) {
+			mutex_lock(&ht->stripe[i].lock);
+			for (bucket = i; bucket < table->zip_size;
+					bucket += CDS_RHT_NR_LOCKS)
+				zipped |= unzip_siblings(table, bucket);
+			mutex_unlock(&ht->stripe[i].lock);
+		}
+		if (!zipped)
+			break;
+		ht->flavor->update_synchronize_rcu();
+	}
+	CMM_STORE_SHARED(table->zip_size, 0);
+}
+
+/*
+ * Multiply the number of buckets by 1 << @shift. Each stripe locks all
+ * the siblings of its buckets, as the table has at least
+ * CDS_RHT_NR_LOCKS buckets.
+ */
+static
+int grow(struct cds_rht *ht, unsigned int shift)
+{
+	struct cds_rht_table *old = ht->table, *table;
+	struct cds_rht_node *node;
+	unsigned long bucket;
+
+	table = alloc_table(old->size << shift);
+	if (!table)
+		return -ENOMEM;
+	table->zip_size = old->size;
+	lock_all(ht);
+	for (bucket = 0; bucket < table->size; bucket++) {
+		for (node = old->bucket[bucket & (old->size - 1)]; node;
+				node = node->next) {
+			if (bucket_index(table, node->hash) == bucket)
+				break;
+		}
+		table->bucket[bucket] = node;
+	}
+	rcu_set_pointer(&ht->table, table);
+	unlock_all(ht);
+	/* The chains of the old table must not be cut under its readers. */
+	ht->flavor->update_synchronize_rcu();
+	free(old);
+	unzip(ht, table);
+	return 0;
+}
+
+/*
+ * Divide the number of buckets, appending the chains of the old buckets
+ * of the same index modulo @size.
+ */
+static
+int shrink(struct cds_rht *ht, unsigned long size)
+{
+	struct cds_rht_table *old = ht->table, *table;
+	struct cds_rht_node **link;
+	unsigned long bucket, from;
+
+	table = alloc_table(size);
+	if (!table)
+		return -ENOMEM;
+	lock_all(ht);
+	for (bucket = 0; bucket < size; bucket++) {
+		link = &old->bucket[bucket];
+		for (from = bucket + size; from < old->size; from += size) {
+			while (*link)
+				link = &(*link)->next;
+			rcu_set_pointer(link, old->bucket[from]);
+		}
+		table->bucket[bucket] = old->bucket[bucket];
+	}
+	rcu_set_pointer(&ht->table, table);
+	unlock_all(ht);
+	ht->flavor->update_synchronize_rcu();
+	free(old);
+	return 0;
+}
+
+static
+void do_resize(struct cds_rht *ht, unsigned long size)
+{
+	unsigned int shift;
+
+	size = round_size(ht, size);
+	while (ht->table->size < size) {
+		for (shift = 1; shift < RHT_GROW_SHIFT
+				&& ht->table->size << shift < size; shift++)
+			;
+		if (grow(ht, shift))
+			return;
+	}
+	if (ht->table->size > size)
+		(void) shrink(ht, size);
+}
+
+void cds_rht_resize(struct cds_rht *ht, unsigned long new_size)
+{
+	mutex_lock(&ht->resize_mutex);
+	do_resize(ht, new_size);
+	mutex_unlock(&ht->resize_mutex);
+}
+
+static
+void do_resize_work(struct urcu_work *work)
+{
+	struct cds_rht *ht = caa_container_of(work, struct cds_rht,
+		resize_work);
+	unsigned long size, count;
+
+	ht->flavor->register_thread();
+	mutex_lock(&ht->resize_mutex);
+	size = ht->table->size;
+	count = (unsigned long) approx_count(ht);
+	if (count > size)
+		do_resize(ht, count);
+	else if (count < size / RHT_SHRINK_LOAD)
+		do_resize(ht, count << 1);
+	mutex_unlock(&ht->resize_mutex);
+	ht->flavor->unregister_thread();
+}
+
+struct cds_rht *cds_rht_new_flavor(unsigned long init_size,
+		unsigned long min_nr_buckets, unsigned long max_nr_buckets,
+		int flags, const struct rcu_flavor_struct *flavor)
+{
+	struct cds_rht *ht;
+	int ret, i;
+
+	if (!max_nr_buckets)
+		max_nr_buckets = 1UL << (CAA_BITS_PER_LONG - 1);
+	if ((min_nr_buckets & (min_nr_buckets - 1))
+			|| (max_nr_buckets & (max_nr_buckets - 1))
+			|| (init_size & (init_size - 1))
+			|| max_nr_buckets < min_nr_buckets
+			|| max_nr_buckets < CDS_RHT_NR_LOCKS)
+		return NULL;
+	ht = calloc(1, sizeof(*ht));
+	if (!ht)
+		return NULL;
+	ht->min_nr_buckets = caa_max(min_nr_buckets,
+		(unsigned long) CDS_RHT_NR_LOCKS);
+	ht->max_nr_buckets = max_nr_buckets;
+	ht->flags = flags;
+	ht->flavor = flavor;
+	ht->table = alloc_table(round_size(ht, init_size));
+	if (!ht->table)
+		goto error;
+	if (posix_memalign((void **) &ht->stripe, CAA_CACHE_LINE_SIZE,
+			CDS_RHT_NR_LOCKS * sizeof(*ht->stripe)))
+		goto error_table;
+	if (flags & CDS_RHT_AUTO_RESIZE) {
+		ht->workqueue = urcu_workqueue_create(0, -1, NULL, NULL,
+			NULL, NULL, NULL, NULL, NULL, NULL);
+		if (!ht->workqueue)
+			goto error_stripe;
+	}
+	for (i = 0; i < CDS_RHT_NR_LOCKS; i++) {
+		ret = pthread_mutex_init(&ht->stripe[i].lock, NULL);
+		if (ret)
+			urcu_die(ret);
+		ht->stripe[i].count = 0;
+	}
+	ret = pthread_mutex_init(&ht->resize_mutex, NULL);
+	if (ret)
+		urcu_die(ret);
+	return ht;
+
+error_stripe:
+	free(ht->stripe);
+error_table:
+	free(ht->table);
+error:
+	free(ht);
+	return NULL;
+}
+
+int cds_rht_destroy(struct cds_rht *ht)
+{
+	int ret, i;
+
+	if (approx_count(ht))
+		return -EPERM;
+	if (ht->workqueue) {
+		CMM_STORE_SHARED(ht->in_progress_destroy, 1);
+		urcu_workqueue_flush_queued_work(ht->workqueue);
+		urcu_workqueue_destroy(ht->workqueue);
+	}
+	for (i = 0; i < CDS_RHT_NR_LOCKS; i++) {
+		ret = pthread_mutex_destroy(&ht->stripe[i].lock);
+		if (ret)
+			urcu_die(ret);
+	}
+	ret = pthread_mutex_destroy(&ht->resize_mutex);
+	if (ret)
+		urcu_die(ret);
+	free(ht->stripe);
+	free(ht->table);
+	free(ht);
+	return 0;
+}
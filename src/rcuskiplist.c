@@ -0,0 +1,345 @@
+/*
+ * rcuskiplist.c
+ *
+ * Userspace RCU library - RCU ordered map (skiplist)
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+/*
+ * Lazy skiplist, from "A Simple Optimistic Skiplist Algorithm", Herlihy,
+ * Lev, Luchangco and Shavit, 2007, with RCU providing the existence
+ * guarantees of removed nodes instead of garbage collection.
+ *
+ * Writers search the predecessors and successors of a key at each
+ * level without locks, then lock the distinct predecessors of the node
+ * they add or remove, bottom-up, and check that they are neither marked
+ * nor linked to another successor since. A node is added bottom-up and
+ * only becomes visible to lookups once linked at all its levels. It is
+ * removed by marking it under its own lock, which also prevents nodes
+ * from being added after it, and unlinked top-down.
+ */
+
+#define _LGPL_SOURCE
+#include <stdlib.h>
+#include <stdint.h>
+#include <errno.h>
+#include <pthread.h>
+
+#include <urcu/compiler.h>
+#include <urcu/arch.h>
+#include <urcu/pointer.h>
+#include <urcu/flavor.h>
+#include <urcu/tls-compat.h>
+#include <urcu/rcuskiplist.h>
+
+#include "urcu-die.h"
+
+struct cds_skiplist {
+	struct cds_skiplist_node head;	/* Lower than all keys. */
+	cds_skiplist_cmp_fct cmp;
+	const struct rcu_flavor_struct *flavor;
+};
+
+static DEFINE_URCU_TLS(uint32_t, level_seed);
+
+static void mutex_lock(pthread_mutex_t *mutex)
+{
+	int ret;
+
+	ret = pthread_mutex_lock(mutex);
+	if (ret)
+		urcu_die(ret);
+}
+
+static void mutex_unlock(pthread_mutex_t *mutex)
+{
+	int ret;
+
+	ret = pthread_mutex_unlock(mutex);
+	if (ret)
+		urcu_die(ret);
+}
+
+/* Number of levels of a new node: n with probability 3 / 4^n. */
+static
+unsigned int random_level(void)
+{
+	uint32_t x = URCU_TLS(level_seed);
+	unsigned int level = 1;
+
+	if (caa_unlikely(!x))
+		x = (uint32_t) (uintptr_t) &URCU_TLS(level_seed) | 1;
+	/* xorshift32 */
+	x ^= x << 13;
+	x ^= x >> 17;
+	x ^= x << 5;
+	URCU_TLS(level_seed) = x;
+	while (level < CDS_SKIPLIST_MAX_LEVEL && !(x & 3)) {
+		level++;
+		x >>= 2;
+	}
+	return level;
+}
+
+/*
+ * Find the predecessors and successors of key at each level: succs[l] is
+ * the first node whose key is not lower than key at level l. Return the
+ * highest level at which succs[l] holds key, or -1.
+ */
+static
+int sl_find(struct cds_skiplist *sl, const void *key,
+		struct cds_skiplist_node **preds,
+		struct cds_skiplist_node **succs)
+{
+	struct cds_skiplist_node *pred = &sl->head, *curr;
+	int level, found = -1;
+
+	for (level = CDS_SKIPLIST_MAX_LEVEL - 1; level >= 0; level--) {
+		int cmp = 1;
+
+		curr = rcu_dereference(pred->next[level]);
+		while (curr && (cmp = sl->cmp(curr, key)) < 0) {
+			pred = curr;
+			curr = rcu_dereference(pred->next[level]);
+		}
+		if (found == -1 && curr && !cmp)
+			found = level;
+		preds[level] = pred;
+		succs[level] = curr;
+	}
+	return found;
+}
+
+static
+int node_visible(struct cds_skiplist_node *node)
+{
+	return CMM_LOAD_SHARED(node->fully_linked)
+		&& !CMM_LOAD_SHARED(node->marked);
+}
+
+/* Skip the nodes which are removed or not fully linked yet. */
+static
+struct cds_skiplist_node *skip_hidden(struct cds_skiplist_node *node)
+{
+	while (node && !node_visible(node))
+		node = rcu_dereference(node->next[0]);
+	return node;
+}
+
+/* Unlock the distinct predecessors locked, at levels below nr_levels. */
+static
+void unlock_preds(struct cds_skiplist_node **preds, int nr_levels)
+{
+	int level;
+
+	for (level = 0; level < nr_levels; level++) {
+		if (!level || preds[level] != preds[level - 1])
+			mutex_unlock(&preds[level]->lock);
+	}
+}
+
+/*
+ * Lock the predecessors of levels below nr_levels, and check that each
+ * of them is still followed by succs[level], or by succ if it is not
+ * NULL. Return 1 with the predecessors locked, 0 without.
+ */
+static
+int lock_preds(struct cds_skiplist_node **preds,
+		struct cds_skiplist_node **succs,
+		struct cds_skiplist_node *succ, int nr_levels)
+{
+	int level;
+
+	for (level = 0; level < nr_levels; level++) {
+		struct cds_skiplist_node *pred = preds[level];
+		struct cds_skiplist_node *expect = succ ? succ : succs[level];
+
+		if (!level || pred != preds[level - 1])
+			mutex_lock(&pred->lock);
+		if (pred->marked || pred->next[level] != expect
+				|| (!succ && expect && expect->marked)) {
+			unlock_preds(preds, level + 1);
+			return 0;
+		}
+	}
+	return 1;
+}
+
+struct cds_skiplist_node *cds_skiplist_lookup(struct cds_skiplist *sl,
+		const void *key)
+{
+	struct cds_skiplist_node *pred = &sl->head, *curr = NULL;
+	int level, cmp = 1;
+
+	for (level = CDS_SKIPLIST_MAX_LEVEL - 1; level >= 0; level--) {
+		curr = rcu_dereference(pred->next[level]);
+		while (curr && (cmp = sl->cmp(curr, key)) < 0) {
+			pred = curr;
+			curr = rcu_dereference(pred->next[level]);
+		}
+		if (curr && !cmp)
+			break;
+	}
+	if (!curr || cmp || !node_visible(curr))
+		return NULL;
+	return curr;
+}
+
+struct cds_skiplist_node *cds_skiplist_lower_bound(struct cds_skiplist *sl,
+		const void *key)
+{
+	struct cds_skiplist_node *pred = &sl->head, *curr = NULL;
+	int level;
+
+	for (level = CDS_SKIPLIST_MAX_LEVEL - 1; level >= 0; level--) {
+		curr = rcu_dereference(pred->next[level]);
+		while (curr && sl->cmp(curr, key) < 0) {
+			pred = curr;
+			curr = rcu_dereference(pred->next[level]);
+		}
+	}
+	return skip_hidden(curr);
+}
+
+struct cds_skiplist_node *cds_skiplist_first(struct cds_skiplist *sl)
+{
+	return skip_hidden(rcu_dereference(sl->head.next[0]));
+}
+
+struct cds_skiplist_node *cds_skiplist_next(struct cds_skiplist *sl,
+		struct cds_skiplist_node *node)
+{
+	return skip_hidden(rcu_dereference(node->next[0]));
+}
+
+struct cds_skiplist_node *cds_skiplist_add_unique(struct cds_skiplist *sl,
+		const void *key, struct cds_skiplist_node *node)
+{
+	struct cds_skiplist_node *preds[CDS_SKIPLIST_MAX_LEVEL];
+	struct cds_skiplist_node *succs[CDS_SKIPLIST_MAX_LEVEL];
+	unsigned int nr_levels = random_level(), level;
+	int ret;
+
+	ret = pthread_mutex_init(&node->lock, NULL);
+	if (ret)
+		urcu_die(ret);
+	node->level = nr_levels;
+	node->marked = 0;
+	node->fully_linked = 0;
+
+	for (;;) {
+		int found = sl_find(sl, key, preds, succs);
+
+		if (found != -1) {
+			struct cds_skiplist_node *dup = succs[found];
+
+			if (!CMM_LOAD_SHARED(dup->marked)) {
+				/* Wait for the concurrent add to complete. */
+				while (!CMM_LOAD_SHARED(dup->fully_linked))
+					caa_cpu_relax();
+				return dup;
+			}
+			/* Wait for the concurrent removal to unlink it. */
+			caa_cpu_relax();
+			continue;
+		}
+		if (!lock_preds(preds, succs, NULL, nr_levels))
+			continue;
+		for (level = 0; level < nr_levels; level++)
+			node->next[level] = succs[level];
+		for (level = 0; level < nr_levels; level++)
+			rcu_set_pointer(&preds[level]->next[level], node);
+		CMM_STORE_SHARED(node->fully_linked, 1);
+		unlock_preds(preds, nr_levels);
+		return node;
+	}
+}
+
+struct cds_skiplist_node *cds_skiplist_del(struct cds_skiplist *sl,
+		const void *key)
+{
+	struct cds_skiplist_node *preds[CDS_SKIPLIST_MAX_LEVEL];
+	struct cds_skiplist_node *succs[CDS_SKIPLIST_MAX_LEVEL];
+	struct cds_skiplist_node *victim = NULL;
+	int level, nr_levels = 0;
+
+	for (;;) {
+		int found = sl_find(sl, key, preds, succs);
+
+		if (!victim) {
+			struct cds_skiplist_node *node;
+
+			if (found == -1)
+				return NULL;
+			node = succs[found];
+			/* Only remove nodes found at their top level. */
+			if (!CMM_LOAD_SHARED(node->fully_linked)
+					|| node->level != (unsigned int) found + 1
+					|| CMM_LOAD_SHARED(node->marked))
+				return NULL;
+			mutex_lock(&node->lock);
+			if (node->marked) {
+				mutex_unlock(&node->lock);
+				return NULL;
+			}
+			CMM_STORE_SHARED(node->marked, 1);
+			victim = node;
+			nr_levels = node->level;
+		}
+		if (!lock_preds(preds, succs, victim, nr_levels))
+			continue;
+		for (level = nr_levels - 1; level >= 0; level--)
+			rcu_set_pointer(&preds[level]->next[level],
+				victim->next[level]);
+		mutex_unlock(&victim->lock);
+		unlock_preds(preds, nr_levels);
+		return victim;
+	}
+}
+
+struct cds_skiplist *cds_skiplist_new_flavor(cds_skiplist_cmp_fct cmp,
+		const struct rcu_flavor_struct *flavor)
+{
+	struct cds_skiplist *sl;
+	int ret;
+
+	sl = calloc(1, sizeof(*sl));
+	if (!sl)
+		return NULL;
+	ret = pthread_mutex_init(&sl->head.lock, NULL);
+	if (ret)
+		urcu_die(ret);
+	sl->head.level = CDS_SKIPLIST_MAX_LEVEL;
+	sl->head.fully_linked = 1;
+	sl->cmp = cmp;
+	sl->flavor = flavor;
+	return sl;
+}
+
+int cds_skiplist_destroy(struct cds_skiplist *sl)
+{
+	int ret;
+
+	if (sl->head.next[0])
+		return -EPERM;
+	/* Wait for readers which may still reference the head. */
+	sl->flavor->update_synchronize_rcu();
+	ret = pthread_mutex_destroy(&sl->head.lock);
+	if (ret)
+		urcu_die(ret);
+	free(sl);
+	return 0;
+}
@@ -0,0 +1,212 @@
+/*
+ * shm-hash.c
+ *
+ * Userspace RCU library - position-independent hash table in shared memory
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+/*
+ * Buckets are singly-linked lists of nodes, updated under the table
+ * lock only. A node is published by a release store of its offset to
+ * the head of its bucket, once its next offset and content are set,
+ * and deleted by a single store of its next offset to its predecessor:
+ * readers traversing the node meanwhile follow its next offset, which
+ * stays valid until the node is freed after a grace period.
+ *
+ * A process dying with the lock held leaves the table consistent, as
+ * each update is a single store, but may leak the node it was
+ * allocating or freeing.
+ */
+
+#define _LGPL_SOURCE
+#include <stdint.h>
+#include <errno.h>
+#include <string.h>
+#include <pthread.h>
+
+#include <urcu/compiler.h>
+#include <urcu/arch.h>
+#include <urcu/uatomic.h>
+#include <urcu/shm-hash.h>
+
+#include "urcu-die.h"
+
+#define SHM_HT_MAGIC	0x75726368	/* "urch" */
+
+static void ht_lock(struct urcu_shm_ht *ht)
+{
+	int ret;
+
+	ret = pthread_mutex_lock(&ht->lock);
+	if (ret == EOWNERDEAD)
+		ret = pthread_mutex_consistent(&ht->lock);
+	if (ret)
+		urcu_die(ret);
+}
+
+static void ht_unlock(struct urcu_shm_ht *ht)
+{
+	int ret;
+
+	ret = pthread_mutex_unlock(&ht->lock);
+	if (ret)
+		urcu_die(ret);
+}
+
+static unsigned long node_size_align(size_t node_size)
+{
+	return (node_size + sizeof(unsigned long) - 1)
+		& ~(sizeof(unsigned long) - 1);
+}
+
+static unsigned long *bucket_of(struct urcu_shm_ht *ht, unsigned long hash)
+{
+	return &ht->buckets[hash & (ht->nr_buckets - 1)];
+}
+
+size_t urcu_shm_ht_size(unsigned long nr_buckets, unsigned long nr_nodes,
+		size_t node_size)
+{
+	return sizeof(struct urcu_shm_ht) + nr_buckets * sizeof(unsigned long)
+		+ nr_nodes * node_size_align(node_size);
+}
+
+struct urcu_shm_ht *urcu_shm_ht_init(void *mem, size_t len,
+		unsigned long nr_buckets, size_t node_size)
+{
+	struct urcu_shm_ht *ht = mem;
+	pthread_mutexattr_t attr;
+	int ret;
+
+	if (!nr_buckets || (nr_buckets & (nr_buckets - 1))
+			|| node_size < sizeof(struct urcu_shm_ht_node)
+			|| ((uintptr_t) mem & (CAA_CACHE_LINE_SIZE - 1))
+			|| len < urcu_shm_ht_size(nr_buckets, 1, node_size))
+		return NULL;
+	memset(ht, 0, urcu_shm_ht_size(nr_buckets, 0, node_size));
+	ht->header_size = sizeof(struct urcu_shm_ht);
+	ht->nr_buckets = nr_buckets;
+	ht->node_size = node_size_align(node_size);
+	ht->nodes = urcu_shm_ht_size(nr_buckets, 0, node_size);
+	ht->end = ht->nodes + (len - ht->nodes) / ht->node_size * ht->node_size;
+	ht->bump = ht->nodes;
+	ret = pthread_mutexattr_init(&attr);
+	if (!ret)
+		ret = pthread_mutexattr_setpshared(&attr,
+				PTHREAD_PROCESS_SHARED);
+	if (!ret)
+		ret = pthread_mutexattr_setrobust(&attr, PTHREAD_MUTEX_ROBUST);
+	if (!ret)
+		ret = pthread_mutex_init(&ht->lock, &attr);
+	if (ret)
+		urcu_die(ret);
+	(void) pthread_mutexattr_destroy(&attr);
+	/* Lay out the table before attaching processes see it. */
+	uatomic_store_release(&ht->magic, SHM_HT_MAGIC);
+	return ht;
+}
+
+struct urcu_shm_ht *urcu_shm_ht_attach(void *mem, size_t len)
+{
+	struct urcu_shm_ht *ht = mem;
+
+	if (len < sizeof(*ht)
+			|| ((uintptr_t) mem & (CAA_CACHE_LINE_SIZE - 1))
+			|| uatomic_load_acquire(&ht->magic) != SHM_HT_MAGIC
+			|| ht->header_size != sizeof(struct urcu_shm_ht)
+			|| len < ht->end)
+		return NULL;
+	return ht;
+}
+
+struct urcu_shm_ht_node *urcu_shm_ht_alloc_node(struct urcu_shm_ht *ht)
+{
+	struct urcu_shm_ht_node *node = NULL;
+
+	ht_lock(ht);
+	if (ht->free != URCU_SHM_HT_NULL) {
+		node = urcu_shm_ht_node_at(ht, ht->free);
+		ht->free = node->next;
+	} else if (ht->bump < ht->end) {
+		node = urcu_shm_ht_node_at(ht, ht->bump);
+		ht->bump += ht->node_size;
+	}
+	ht_unlock(ht);
+	return node;
+}
+
+void urcu_shm_ht_free_node(struct urcu_shm_ht *ht,
+		struct urcu_shm_ht_node *node)
+{
+	ht_lock(ht);
+	node->next = ht->free;
+	ht->free = urcu_shm_ht_offset_of(ht, node);
+	ht_unlock(ht);
+}
+
+void urcu_shm_ht_add(struct urcu_shm_ht *ht, unsigned long hash,
+		struct urcu_shm_ht_node *node)
+{
+	unsigned long *bucket = bucket_of(ht, hash);
+
+	node->hash = hash;
+	ht_lock(ht);
+	node->next = *bucket;
+	/* Publish the node content before the node. */
+	uatomic_store_release(bucket, urcu_shm_ht_offset_of(ht, node));
+	ht->count++;
+	ht_unlock(ht);
+}
+
+int urcu_shm_ht_del(struct urcu_shm_ht *ht, struct urcu_shm_ht_node *node)
+{
+	unsigned long *prev = bucket_of(ht, node->hash);
+	unsigned long offset = urcu_shm_ht_offset_of(ht, node);
+	int ret = -ENOENT;
+
+	ht_lock(ht);
+	while (*prev != URCU_SHM_HT_NULL) {
+		if (*prev == offset) {
+			CMM_STORE_SHARED(*prev, node->next);
+			ht->count--;
+			ret = 0;
+			break;
+		}
+		prev = &urcu_shm_ht_node_at(ht, *prev)->next;
+	}
+	ht_unlock(ht);
+	return ret;
+}
+
+struct urcu_shm_ht_node *urcu_shm_ht_lookup(struct urcu_shm_ht *ht,
+		unsigned long hash,
+		int (*match)(struct urcu_shm_ht_node *node, const void *key),
+		const void *key)
+{
+	struct urcu_shm_ht_node *node;
+	unsigned long offset;
+
+	offset = CMM_LOAD_SHARED(*bucket_of(ht, hash));
+	while (offset != URCU_SHM_HT_NULL) {
+		/* Offsets carry the dependency of the node content. */
+		cmm_smp_read_barrier_depends();
+		node = urcu_shm_ht_node_at(ht, offset);
+		if (node->hash == hash && match(node, key))
+			return node;
+		offset = CMM_LOAD_SHARED(node->next);
+	}
+	return NULL;
+}
@@ -0,0 +1,169 @@
+/*
+ * split-counter.c
+ *
+ * Userspace RCU library - Per-CPU split counter
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+#define _LGPL_SOURCE
+#include <stdlib.h>
+#include <unistd.h>
+
+#include <urcu/arch.h>
+#include <urcu/compiler.h>
+#include <urcu/uatomic.h>
+#include <urcu/tls-compat.h>
+#include <urcu/split-counter.h>
+
+#include "compat-getcpu.h"
+#include "urcu-rseq.h"
+
+/*
+ * Counters are free-running unsigned values, so that commits stay
+ * consistent modulo 2^CAA_BITS_PER_LONG across overflow: an addition
+ * commits the multiples of 2^commit_order its per-CPU counter crossed.
+ */
+struct split_counter_cpu {
+	unsigned long count;
+} __attribute__((aligned(CAA_CACHE_LINE_SIZE)));
+
+struct cds_split_counter {
+	unsigned long global __attribute__((aligned(CAA_CACHE_LINE_SIZE)));
+	unsigned int commit_order;
+	unsigned long mask;		/* Number of per-CPU counters - 1. */
+	int percpu;			/* One counter per possible CPU. */
+	struct split_counter_cpu *cpus;
+} __attribute__((aligned(CAA_CACHE_LINE_SIZE)));
+
+/*
+ * Counter of threads for which the current CPU is unknown: each thread
+ * picks one on first addition, spreading threads over the counters.
+ */
+static DEFINE_URCU_TLS(unsigned long, thread_slot);
+static unsigned long next_thread_slot;
+
+static struct split_counter_cpu *get_cpu_counter(
+		struct cds_split_counter *counter)
+{
+	int cpu;
+
+	cpu = urcu_sched_getcpu();
+	if (caa_likely(cpu >= 0))
+		return &counter->cpus[cpu & counter->mask];
+	if (caa_unlikely(!URCU_TLS(thread_slot)))
+		URCU_TLS(thread_slot) =
+			uatomic_add_return(&next_thread_slot, 1);
+	return &counter->cpus[URCU_TLS(thread_slot) & counter->mask];
+}
+
+/*
+ * With one counter per possible CPU, threads only add to the counter of
+ * their CPU, with an rseq commit rather than an atomic operation.
+ */
+static unsigned long cpu_counter_add(struct cds_split_counter *counter,
+		unsigned long v)
+{
+	struct split_counter_cpu *cpu;
+	unsigned long old;
+	int cpu_id;
+
+	while (counter->percpu) {
+		cpu_id = urcu_rseq_current_cpu();
+		if (caa_unlikely(cpu_id < 0
+				|| (unsigned long) cpu_id > counter->mask))
+			break;
+		cpu = &counter->cpus[cpu_id];
+		old = CMM_LOAD_SHARED(cpu->count);
+		if (caa_likely(!urcu_rseq_cmpeqv_storev((intptr_t *) &cpu->count,
+				(intptr_t) old, (intptr_t) (old + v), cpu_id)))
+			return old + v;
+	}
+	return uatomic_add_return(&get_cpu_counter(counter)->count, v);
+}
+
+struct cds_split_counter *cds_split_counter_new(unsigned int commit_order,
+		unsigned long nr_cpus)
+{
+	struct cds_split_counter *counter;
+	unsigned long nr = 1;
+	long nr_conf;
+
+	if (commit_order >= CAA_BITS_PER_LONG)
+		return NULL;
+	nr_conf = sysconf(_SC_NPROCESSORS_CONF);
+	if (!nr_cpus)
+		nr_cpus = nr_conf > 0 ? nr_conf : 1;
+	while (nr < nr_cpus)
+		nr <<= 1;
+
+	if (posix_memalign((void **) &counter, CAA_CACHE_LINE_SIZE,
+			sizeof(*counter)))
+		return NULL;
+	if (posix_memalign((void **) &counter->cpus, CAA_CACHE_LINE_SIZE,
+			nr * sizeof(*counter->cpus))) {
+		free(counter);
+		return NULL;
+	}
+	counter->global = 0;
+	counter->commit_order = commit_order;
+	counter->mask = nr - 1;
+#ifdef URCU_RSEQ_COMMIT
+	counter->percpu = nr_conf > 0 && nr >= (unsigned long) nr_conf;
+#else
+	counter->percpu = 0;
+#endif
+	for (nr_cpus = 0; nr_cpus < nr; nr_cpus++)
+		counter->cpus[nr_cpus].count = 0;
+	return counter;
+}
+
+void cds_split_counter_destroy(struct cds_split_counter *counter)
+{
+	free(counter->cpus);
+	free(counter);
+}
+
+void cds_split_counter_add(struct cds_split_counter *counter, long v)
+{
+	unsigned int order = counter->commit_order;
+	unsigned long count, commit;
+
+	count = cpu_counter_add(counter, (unsigned long) v);
+	commit = (count >> order) - ((count - (unsigned long) v) >> order);
+	if (caa_likely(!commit))
+		return;
+	/* Only if the counter crossed a multiple of 2^commit_order. */
+	uatomic_add(&counter->global, commit << order);
+}
+
+long cds_split_counter_read(struct cds_split_counter *counter)
+{
+	return (long) uatomic_read(&counter->global);
+}
+
+long cds_split_counter_read_exact(struct cds_split_counter *counter)
+{
+	unsigned long i, sum = 0;
+
+	for (i = 0; i <= counter->mask; i++)
+		sum += uatomic_read(&counter->cpus[i].count);
+	return (long) sum;
+}
+
+unsigned long cds_split_counter_max_error(struct cds_split_counter *counter)
+{
+	return (counter->mask + 1) << counter->commit_order;
+}
@@ -0,0 +1,55 @@
+/*
+ * spscring.c
+ *
+ * Userspace RCU library - Bounded Wait-Free Single-Producer/Single-Consumer Ring
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+/* Do not #define _LGPL_SOURCE to ensure we can emit the wrapper symbols */
+#include "urcu/spscring.h"
+#include "urcu/static/spscring.h"
+
+/*
+ * library wrappers to be used by non-LGPL compatible source code.
+ */
+
+int cds_spsc_ring_init(struct cds_spsc_ring *ring,
+		void **slots, unsigned long capacity)
+{
+	return _cds_spsc_ring_init(ring, slots, capacity);
+}
+
+bool cds_spsc_ring_try_enqueue(struct cds_spsc_ring *ring, void *data)
+{
+	return _cds_spsc_ring_try_enqueue(ring, data);
+}
+
+bool cds_spsc_ring_try_dequeue(struct cds_spsc_ring *ring, void **data)
+{
+	return _cds_spsc_ring_try_dequeue(ring, data);
+}
+
+unsigned long cds_spsc_ring_enqueue_bulk(struct cds_spsc_ring *ring,
+		void **data, unsigned long n)
+{
+	return _cds_spsc_ring_enqueue_bulk(ring, data, n);
+}
+
+unsigned long cds_spsc_ring_dequeue_bulk(struct cds_spsc_ring *ring,
+		void **data, unsigned long n)
+{
+	return _cds_spsc_ring_dequeue_bulk(ring, data, n);
+}
@@ -35,10 +35,13 @@
 #include <poll.h>
 #include <unistd.h>
 #include <stdbool.h>
+#include <stdint.h>
+#include <limits.h>
 #include <sys/mman.h>
 
 #include <urcu/arch.h>
 #include <urcu/wfcqueue.h>
+#include <urcu/rculist.h>
 #include <urcu/map/urcu-bp.h>
 #include <urcu/static/urcu-bp.h>
 #include <urcu/pointer.h>
@@ -46,6 +49,12 @@
 
 #include "urcu-die.h"
 #include "urcu-utils.h"
+#include "urcu-stats.h"
+#include "urcu-mutex.h"
+#include "urcu-stall.h"
+#include "urcu-gp-seq.h"
+#include "urcu-hugepage.h"
+#include "compat-numa.h"
 
 #define URCU_API_MAP
 /* Do not #define _LGPL_SOURCE to ensure we can emit the wrapper symbols */
@@ -57,38 +66,16 @@
 #define MAP_ANONYMOUS MAP_ANON
 #endif
 
-#ifdef __linux__
-static
-void *mremap_wrapper(void *old_address, size_t old_size,
-		size_t new_size, int flags)
-{
-	return mremap(old_address, old_size, new_size, flags);
-}
-#else
-
-#define MREMAP_MAYMOVE	1
-#define MREMAP_FIXED	2
-
-/*
- * mremap wrapper for non-Linux systems not allowing MAYMOVE.
- * This is not generic.
-*/
-static
-void *mremap_wrapper(void *old_address, size_t old_size,
-		size_t new_size, int flags)
-{
-	assert(!(flags & MREMAP_MAYMOVE));
-
-	return MAP_FAILED;
-}
-#endif
-
 /* Sleep delay in ms */
 #define RCU_SLEEP_DELAY_MS	10
 #define INIT_NR_THREADS		8
-#define ARENA_INIT_ALLOC		\
-	sizeof(struct registry_chunk)	\
-	+ INIT_NR_THREADS * sizeof(struct urcu_bp_reader)
+
+/*
+ * Readers register in the arena of the NUMA node they run on, nodes
+ * beyond NR_ARENAS sharing arenas, like the registry groups of the other
+ * flavors.
+ */
+#define NR_ARENAS		8
 
 /*
  * Active attempts to check for reader Q.S. before calling sleep().
@@ -115,9 +102,19 @@ enum membarrier_cmd {
 };
 
 static
-void __attribute__((constructor)) _urcu_bp_init(void);
+void URCU_ATTR_CONSTRUCTOR _urcu_bp_init(void);
+#ifdef CONFIG_RCU_LAZY_INIT
+static
+void urcu_bp_exit(void);
+static
+void __attribute__((destructor)) urcu_bp_lazy_exit(void);
+
+/* Whether the first use took the reference of the library constructor. */
+static int urcu_bp_lazy_ref;
+#else
 static
 void __attribute__((destructor)) urcu_bp_exit(void);
+#endif
 
 #ifndef CONFIG_RCU_FORCE_SYS_MEMBARRIER
 int urcu_bp_has_sys_membarrier;
@@ -129,18 +126,38 @@ int urcu_bp_has_sys_membarrier;
  */
 static pthread_mutex_t rcu_gp_lock = PTHREAD_MUTEX_INITIALIZER;
 /*
- * rcu_registry_lock ensures mutual exclusion between threads
- * registering and unregistering themselves to/from the registry, and
- * with threads reading that registry from synchronize_rcu(). However,
- * this lock is not held all the way through the completion of awaiting
- * for the grace period. It is sporadically released between iterations
- * on the registry.
+ * rcu_registry_lock ensures mutual exclusion between threads reading
+ * the registry from synchronize_rcu() and fork(). Threads register and
+ * unregister themselves without it, by claiming and releasing a slot in
+ * the allocation bitmap of a registry chunk. This lock is not held all
+ * the way through the completion of awaiting for the grace period. It
+ * is sporadically released between iterations on the registry.
  * rcu_registry_lock may nest inside rcu_gp_lock.
  */
 static pthread_mutex_t rcu_registry_lock = PTHREAD_MUTEX_INITIALIZER;
 
+/*
+ * rcu_arena_lock serializes the addition of registry chunks, when all
+ * slots are in use. It nests inside rcu_registry_lock.
+ */
+static pthread_mutex_t rcu_arena_lock = PTHREAD_MUTEX_INITIALIZER;
+
+/*
+ * Grace-period statistics. Written with rcu_gp_lock held.
+ */
+static struct urcu_gp_stats gp_stats;
+
+/*
+ * Contention on the internal mutexes, see rcu_get_stats().
+ */
+static struct urcu_flavor_lock_stats lock_stats;
+
+/*
+ * Reader stall watchdog. Accessed with rcu_gp_lock held.
+ */
+static struct urcu_stall_watchdog stall_watchdog;
+
 static pthread_mutex_t init_lock = PTHREAD_MUTEX_INITIALIZER;
-static int initialized;
 
 static pthread_key_t urcu_bp_key;
 
@@ -151,43 +168,95 @@ URCU_ATTR_ALIAS("urcu_bp_gp") extern struct urcu_bp_gp rcu_gp_bp;
  * Pointer to registry elements. Written to only by each individual reader. Read
  * by both the reader and the writers.
  */
-DEFINE_URCU_TLS(struct urcu_bp_reader *, urcu_bp_reader);
+DEFINE_URCU_TLS_IE(struct urcu_bp_reader *, urcu_bp_reader);
 DEFINE_URCU_TLS_ALIAS(struct urcu_bp_reader *, urcu_bp_reader, rcu_reader_bp);
 
-static CDS_LIST_HEAD(registry);
+/* Number of registered readers. */
+static unsigned long nr_registered;
+
+#define BITS_PER_ULONG		(sizeof(unsigned long) * CHAR_BIT)
 
+/*
+ * Registry chunks hold a fixed number of reader slots, followed by three
+ * bitmaps: used slots, claimed and released with atomic operations by
+ * registering and unregistering threads, then the readers awaited by
+ * synchronize_rcu() and those seen active in its first phase, written
+ * with rcu_registry_lock held.
+ */
 struct registry_chunk {
-	size_t data_len;		/* data length */
-	size_t used;			/* amount of data used */
+	size_t len;			/* Length of the mapping. */
+	size_t nr_slots;
+	unsigned long *used;
+	unsigned long *pending;
+	unsigned long *snap;
 	struct cds_list_head node;	/* chunk_list node */
-	char data[];
+	struct urcu_bp_reader readers[];
 };
 
 struct registry_arena {
 	struct cds_list_head chunk_list;
-};
+} __attribute__((aligned(CAA_CACHE_LINE_SIZE)));
+
+#define REGISTRY_ARENA_INIT(i)						\
+	[i] = { .chunk_list = CDS_LIST_HEAD_INIT(registry_arenas[i].chunk_list) }
 
-static struct registry_arena registry_arena = {
-	.chunk_list = CDS_LIST_HEAD_INIT(registry_arena.chunk_list),
+static struct registry_arena registry_arenas[NR_ARENAS] = {
+	REGISTRY_ARENA_INIT(0), REGISTRY_ARENA_INIT(1),
+	REGISTRY_ARENA_INIT(2), REGISTRY_ARENA_INIT(3),
+	REGISTRY_ARENA_INIT(4), REGISTRY_ARENA_INIT(5),
+	REGISTRY_ARENA_INIT(6), REGISTRY_ARENA_INIT(7),
 };
 
+/*
+ * NUMA node of the first MAX_NODE_CPUS CPUs, or -1 if unknown, read from
+ * sysfs at initialization, as registration may happen from a signal
+ * handler.
+ */
+#define MAX_NODE_CPUS		1024
+static short cpu_node[MAX_NODE_CPUS];
+
+static void cpu_node_init(void)
+{
+	long cpu, nr_cpus = sysconf(_SC_NPROCESSORS_CONF);
+
+	for (cpu = 0; cpu < MAX_NODE_CPUS; cpu++)
+		cpu_node[cpu] = cpu < nr_cpus ? urcu_numa_node_of_cpu(cpu) : -1;
+}
+
+/* NUMA node of the CPU the caller runs on, or -1 if unknown. */
+static int current_node(void)
+{
+	int cpu = urcu_sched_getcpu();
+
+	if (cpu < 0 || cpu >= MAX_NODE_CPUS)
+		return -1;
+	return CMM_LOAD_SHARED(cpu_node[cpu]);
+}
+
+/* Iterate on the chunks of all arenas. */
+#define registry_for_each_chunk(arena, chunk)				\
+	for ((arena) = registry_arenas;					\
+			(arena) < &registry_arenas[NR_ARENAS]; (arena)++)	\
+		cds_list_for_each_entry_rcu(chunk, &(arena)->chunk_list, node)
+
 /* Saved fork signal mask, protected by rcu_gp_lock */
 static sigset_t saved_fork_signal_mask;
 
-static void mutex_lock(pthread_mutex_t *mutex)
+static struct urcu_lock_stats *mutex_lock_stats(pthread_mutex_t *mutex)
 {
-	int ret;
+	if (mutex == &rcu_gp_lock)
+		return &lock_stats.gp;
+	if (mutex == &rcu_registry_lock)
+		return &lock_stats.registry;
+	return NULL;
+}
 
+static void mutex_lock(pthread_mutex_t *mutex)
+{
 #ifndef DISTRUST_SIGNALS_EXTREME
-	ret = pthread_mutex_lock(mutex);
-	if (ret)
-		urcu_die(ret);
+	urcu_mutex_lock(mutex, mutex_lock_stats(mutex));
 #else /* #ifndef DISTRUST_SIGNALS_EXTREME */
-	while ((ret = pthread_mutex_trylock(mutex)) != 0) {
-		if (ret != EBUSY && ret != EINTR)
-			urcu_die(ret);
-		poll(NULL,0,10);
-	}
+	urcu_mutex_lock_poll(mutex, mutex_lock_stats(mutex), NULL);
 #endif /* #else #ifndef DISTRUST_SIGNALS_EXTREME */
 }
 
@@ -210,69 +279,141 @@ static void smp_mb_master(void)
 	}
 }
 
+static size_t chunk_nr_words(struct registry_chunk *chunk)
+{
+	return chunk->nr_slots / BITS_PER_ULONG
+		+ !!(chunk->nr_slots % BITS_PER_ULONG);
+}
+
+/* Bits of word i of the chunk bitmaps that match an actual slot. */
+static unsigned long chunk_slot_mask(struct registry_chunk *chunk, size_t i)
+{
+	size_t rem = chunk->nr_slots - i * BITS_PER_ULONG;
+
+	if (rem >= BITS_PER_ULONG)
+		return ~0UL;
+	return (1UL << rem) - 1;
+}
+
+/*
+ * Mark the readers to wait for: in the first phase all registered
+ * readers, in the second one those seen active with the current snapshot
+ * in the first phase. Readers found idle by the first check are dropped,
+ * so the following checks only look at readers within a critical section.
+ */
+static void prepare_wait(bool first_phase)
+{
+	struct registry_arena *arena;
+	struct registry_chunk *chunk;
+	size_t i;
+
+	registry_for_each_chunk(arena, chunk) {
+		for (i = 0; i < chunk_nr_words(chunk); i++) {
+			if (first_phase) {
+				chunk->pending[i] = uatomic_read(&chunk->used[i])
+					& chunk_slot_mask(chunk, i);
+				chunk->snap[i] = 0;
+			} else {
+				chunk->pending[i] = chunk->snap[i];
+			}
+		}
+	}
+}
+
+/*
+ * Check the pending readers once, skipping words without any. In the
+ * first phase, record those active with the current snapshot for the
+ * second phase. Return whether some readers are still active with an old
+ * snapshot.
+ */
+static bool check_pending(bool first_phase, uint64_t active_ns)
+{
+	struct registry_arena *arena;
+	struct registry_chunk *chunk;
+	bool pending = false;
+	size_t i;
+
+	registry_for_each_chunk(arena, chunk) {
+		for (i = 0; i < chunk_nr_words(chunk); i++) {
+			unsigned long bits = chunk->pending[i];
+
+			if (!bits)
+				continue;
+
+			while (bits) {
+				unsigned long bit = bits & -bits;
+				struct urcu_bp_reader *reader = &chunk->readers[
+					i * BITS_PER_ULONG + __builtin_ctzl(bits)];
+
+				bits &= ~bit;
+				switch (urcu_bp_reader_state(&reader->ctr)) {
+				case URCU_BP_READER_ACTIVE_CURRENT:
+					if (first_phase)
+						chunk->snap[i] |= bit;
+					/* Fall-through */
+				case URCU_BP_READER_INACTIVE:
+					chunk->pending[i] &= ~bit;
+					break;
+				case URCU_BP_READER_ACTIVE_OLD:
+					/*
+					 * Old snapshot. Leaving the reader
+					 * pending will make us busy-loop until
+					 * the snapshot becomes current or the
+					 * reader becomes inactive.
+					 */
+					pending = true;
+					if (caa_unlikely(active_ns))
+						urcu_stall_report(&stall_watchdog,
+							reader->tid, active_ns);
+					break;
+				}
+			}
+		}
+	}
+	return pending;
+}
+
 /*
  * Always called with rcu_registry lock held. Releases this lock between
  * iterations and grabs it again. Holds the lock when it returns.
+ * Readers registered meanwhile are not waited for: they observe the
+ * current snapshot.
  */
-static void wait_for_readers(struct cds_list_head *input_readers,
-			struct cds_list_head *cur_snap_readers,
-			struct cds_list_head *qsreaders)
+static void wait_for_readers(bool first_phase)
 {
 	unsigned int wait_loops = 0;
-	struct urcu_bp_reader *index, *tmp;
+	uint64_t active_ns = 0;
 
 	/*
 	 * Wait for each thread URCU_TLS(urcu_bp_reader).ctr to either
 	 * indicate quiescence (not nested), or observe the current
 	 * rcu_gp.ctr value.
 	 */
+	prepare_wait(first_phase);
 	for (;;) {
 		if (wait_loops < RCU_QS_ACTIVE_ATTEMPTS)
 			wait_loops++;
 
-		cds_list_for_each_entry_safe(index, tmp, input_readers, node) {
-			switch (urcu_bp_reader_state(&index->ctr)) {
-			case URCU_BP_READER_ACTIVE_CURRENT:
-				if (cur_snap_readers) {
-					cds_list_move(&index->node,
-						cur_snap_readers);
-					break;
-				}
-				/* Fall-through */
-			case URCU_BP_READER_INACTIVE:
-				cds_list_move(&index->node, qsreaders);
-				break;
-			case URCU_BP_READER_ACTIVE_OLD:
-				/*
-				 * Old snapshot. Leaving node in
-				 * input_readers will make us busy-loop
-				 * until the snapshot becomes current or
-				 * the reader becomes inactive.
-				 */
-				break;
-			}
-		}
-
-		if (cds_list_empty(input_readers)) {
+		if (!check_pending(first_phase, active_ns))
 			break;
-		} else {
-			/* Temporarily unlock the registry lock. */
-			mutex_unlock(&rcu_registry_lock);
-			if (wait_loops >= RCU_QS_ACTIVE_ATTEMPTS)
-				(void) poll(NULL, 0, RCU_SLEEP_DELAY_MS);
-			else
-				caa_cpu_relax();
-			/* Re-lock the registry lock before the next loop. */
-			mutex_lock(&rcu_registry_lock);
-		}
+		active_ns = urcu_stall_report_due(&stall_watchdog);
+
+		/* Temporarily unlock the registry lock. */
+		mutex_unlock(&rcu_registry_lock);
+		if (wait_loops >= RCU_QS_ACTIVE_ATTEMPTS) {
+			urcu_stats_futex_wait(&gp_stats);
+			(void) poll(NULL, 0, RCU_SLEEP_DELAY_MS);
+		} else
+			caa_cpu_relax();
+		/* Re-lock the registry lock before the next loop. */
+		mutex_lock(&rcu_registry_lock);
 	}
 }
 
 void urcu_bp_synchronize_rcu(void)
 {
-	CDS_LIST_HEAD(cur_snap_readers);
-	CDS_LIST_HEAD(qsreaders);
 	sigset_t newmask, oldmask;
+	uint64_t gp_start;
 	int ret;
 
 	ret = sigfillset(&newmask);
@@ -282,9 +423,18 @@ void urcu_bp_synchronize_rcu(void)
 
 	mutex_lock(&rcu_gp_lock);
 
+	gp_start = urcu_stats_gp_start();
+	urcu_gp_seq_start(&rcu_gp.seq);
+
 	mutex_lock(&rcu_registry_lock);
 
-	if (cds_list_empty(&registry))
+	/*
+	 * Order prior updates before the read of the number of readers,
+	 * which registering readers increment with a full barrier before
+	 * their first read-side critical section.
+	 */
+	cmm_smp_mb();
+	if (!uatomic_read(&nr_registered))
 		goto out;
 
 	/* All threads should read qparity before accessing data structure
@@ -297,7 +447,8 @@ void urcu_bp_synchronize_rcu(void)
 	 * wait_for_readers() can release and grab again rcu_registry_lock
 	 * interally.
 	 */
-	wait_for_readers(&registry, &cur_snap_readers, &qsreaders);
+	urcu_stall_wait_start(&stall_watchdog);
+	wait_for_readers(true);
 
 	/*
 	 * Adding a cmm_smp_mb() which is _not_ formally required, but makes the
@@ -328,12 +479,8 @@ void urcu_bp_synchronize_rcu(void)
 	 * wait_for_readers() can release and grab again rcu_registry_lock
 	 * interally.
 	 */
-	wait_for_readers(&cur_snap_readers, NULL, &qsreaders);
-
-	/*
-	 * Put quiescent reader list back into registry.
-	 */
-	cds_list_splice(&qsreaders, &registry);
+	urcu_stall_wait_start(&stall_watchdog);
+	wait_for_readers(false);
 
 	/*
 	 * Finish waiting for reader threads before letting the old ptr being
@@ -341,6 +488,8 @@ void urcu_bp_synchronize_rcu(void)
 	 */
 	smp_mb_master();
 out:
+	urcu_gp_seq_end(&rcu_gp.seq);
+	urcu_stats_gp_end(&gp_stats, gp_start);
 	mutex_unlock(&rcu_registry_lock);
 	mutex_unlock(&rcu_gp_lock);
 	ret = pthread_sigmask(SIG_SETMASK, &oldmask, NULL);
@@ -348,6 +497,79 @@ out:
 }
 URCU_ATTR_ALIAS("urcu_bp_synchronize_rcu") void synchronize_rcu_bp();
 
+void urcu_bp_set_stall_watchdog(unsigned long threshold_ms,
+		void (*func)(pthread_t tid, uint64_t active_ns, void *priv),
+		void *priv)
+{
+	mutex_lock(&rcu_gp_lock);
+	urcu_stall_set(&stall_watchdog, threshold_ms, func, priv);
+	mutex_unlock(&rcu_gp_lock);
+}
+
+/*
+ * Threads register without lock: slots claimed but not filled in yet,
+ * with a zero tid, are skipped.
+ */
+int urcu_bp_for_each_reader(void (*func)(const struct urcu_reader_info *info,
+			void *priv),
+		void *priv)
+{
+	struct registry_arena *arena;
+	struct registry_chunk *chunk;
+	struct urcu_bp_reader *reader;
+	struct urcu_reader_info info;
+	size_t slot;
+
+	mutex_lock(&rcu_registry_lock);
+	registry_for_each_chunk(arena, chunk) {
+		for (slot = 0; slot < chunk->nr_slots; slot++) {
+			if (!(uatomic_read(&chunk->used[slot / BITS_PER_ULONG])
+					& (1UL << (slot % BITS_PER_ULONG))))
+				continue;
+			reader = &chunk->readers[slot];
+			info.tid = CMM_LOAD_SHARED(reader->tid);
+			if (!info.tid)
+				continue;
+			switch (urcu_bp_reader_state(&reader->ctr)) {
+			case URCU_BP_READER_ACTIVE_CURRENT:
+				info.state = URCU_READER_INFO_ACTIVE_CURRENT;
+				break;
+			case URCU_BP_READER_ACTIVE_OLD:
+				info.state = URCU_READER_INFO_ACTIVE_OLD;
+				break;
+			default:
+				info.state = URCU_READER_INFO_INACTIVE;
+				break;
+			}
+			info.detached = 0;
+			func(&info, priv);
+		}
+	}
+	mutex_unlock(&rcu_registry_lock);
+	return 0;
+}
+
+/*
+ * Grace-period polling. The cookie returned by
+ * urcu_bp_get_state_synchronize_rcu() is reached once a full grace
+ * period has elapsed after the call.
+ */
+unsigned long urcu_bp_get_state_synchronize_rcu(void)
+{
+	return urcu_gp_seq_snap(&rcu_gp.seq);
+}
+
+int urcu_bp_poll_state_synchronize_rcu(unsigned long cookie)
+{
+	return urcu_gp_seq_done(&rcu_gp.seq, cookie);
+}
+
+void urcu_bp_cond_synchronize_rcu(unsigned long cookie)
+{
+	if (!urcu_bp_poll_state_synchronize_rcu(cookie))
+		urcu_bp_synchronize_rcu();
+}
+
 /*
  * library wrappers to be used by non-LGPL compatible source code.
  */
@@ -371,204 +593,247 @@ int urcu_bp_read_ongoing(void)
 URCU_ATTR_ALIAS("urcu_bp_read_ongoing") int rcu_read_ongoing_bp();
 
 /*
- * Only grow for now. If empty, allocate a ARENA_INIT_ALLOC sized chunk.
- * Else, try expanding the last chunk. If this fails, allocate a new
- * chunk twice as big as the last chunk.
+ * Map memory for a chunk of at least *len bytes, allocated from the NUMA
+ * node, and update *len to the length mapped. Chunks of at least a huge
+ * page are aligned on the huge page size, and advised to be backed by
+ * transparent huge pages, so that synchronize_rcu() scans them with
+ * fewer TLB misses.
+ */
+static
+struct registry_chunk *map_chunk(size_t *len, int node)
+{
+	size_t hpage = urcu_hugepage_size();
+	char *ptr, *aligned;
+
+	if (*len < hpage) {
+		ptr = mmap(NULL, *len, PROT_READ | PROT_WRITE,
+			MAP_ANONYMOUS | MAP_PRIVATE, -1, 0);
+		if (ptr == MAP_FAILED)
+			abort();
+		urcu_numa_prefer_node(ptr, *len, node);
+		return (struct registry_chunk *) ptr;
+	}
+	*len = (*len + hpage - 1) & ~(hpage - 1);
+	ptr = mmap(NULL, *len + hpage, PROT_READ | PROT_WRITE,
+		MAP_ANONYMOUS | MAP_PRIVATE, -1, 0);
+	if (ptr == MAP_FAILED)
+		abort();
+	aligned = (char *) (((uintptr_t) ptr + hpage - 1) & ~(hpage - 1));
+	if (aligned != ptr && munmap(ptr, aligned - ptr))
+		abort();
+	if (munmap(aligned + *len, ptr + hpage - aligned))
+		abort();
+	urcu_numa_prefer_node(aligned, *len, node);
+#ifdef MADV_HUGEPAGE
+	/* Transparent huge pages may be disabled: ignore errors. */
+	(void) madvise(aligned, *len, MADV_HUGEPAGE);
+#endif
+	return (struct registry_chunk *) aligned;
+}
+
+/*
+ * Only grow for now. The first chunk of an arena holds INIT_NR_THREADS
+ * slots, each following one twice as many as the last chunk. Chunks are
+ * added with rcu_arena_lock held, and are published so that registering
+ * threads and synchronize_rcu() can walk the chunk list without lock.
  * Memory used by chunks _never_ moves. A chunk could theoretically be
  * freed when all "used" slots are released, but we don't do it at this
  * point.
  */
 static
-void expand_arena(struct registry_arena *arena)
+void expand_arena(struct registry_arena *arena, int node)
 {
 	struct registry_chunk *new_chunk, *last_chunk;
-	size_t old_chunk_len, new_chunk_len;
+	size_t nr_slots, nr_words, len;
+	unsigned long *bitmaps;
 
-	/* No chunk. */
 	if (cds_list_empty(&arena->chunk_list)) {
-		assert(ARENA_INIT_ALLOC >=
-			sizeof(struct registry_chunk)
-			+ sizeof(struct rcu_reader));
-		new_chunk_len = ARENA_INIT_ALLOC;
-		new_chunk = (struct registry_chunk *) mmap(NULL,
-			new_chunk_len,
-			PROT_READ | PROT_WRITE,
-			MAP_ANONYMOUS | MAP_PRIVATE,
-			-1, 0);
-		if (new_chunk == MAP_FAILED)
-			abort();
-		memset(new_chunk, 0, new_chunk_len);
-		new_chunk->data_len =
-			new_chunk_len - sizeof(struct registry_chunk);
-		cds_list_add_tail(&new_chunk->node, &arena->chunk_list);
-		return;		/* We're done. */
-	}
-
-	/* Try expanding last chunk. */
-	last_chunk = cds_list_entry(arena->chunk_list.prev,
-		struct registry_chunk, node);
-	old_chunk_len =
-		last_chunk->data_len + sizeof(struct registry_chunk);
-	new_chunk_len = old_chunk_len << 1;
-
-	/* Don't allow memory mapping to move, just expand. */
-	new_chunk = mremap_wrapper(last_chunk, old_chunk_len,
-		new_chunk_len, 0);
-	if (new_chunk != MAP_FAILED) {
-		/* Should not have moved. */
-		assert(new_chunk == last_chunk);
-		memset((char *) last_chunk + old_chunk_len, 0,
-			new_chunk_len - old_chunk_len);
-		last_chunk->data_len =
-			new_chunk_len - sizeof(struct registry_chunk);
-		return;		/* We're done. */
+		nr_slots = INIT_NR_THREADS;
+	} else {
+		last_chunk = cds_list_entry(arena->chunk_list.prev,
+			struct registry_chunk, node);
+		nr_slots = last_chunk->nr_slots << 1;
 	}
-
-	/* Remap did not succeed, we need to add a new chunk. */
-	new_chunk = (struct registry_chunk *) mmap(NULL,
-		new_chunk_len,
-		PROT_READ | PROT_WRITE,
-		MAP_ANONYMOUS | MAP_PRIVATE,
-		-1, 0);
-	if (new_chunk == MAP_FAILED)
-		abort();
-	memset(new_chunk, 0, new_chunk_len);
-	new_chunk->data_len =
-		new_chunk_len - sizeof(struct registry_chunk);
-	cds_list_add_tail(&new_chunk->node, &arena->chunk_list);
+	nr_words = (nr_slots + BITS_PER_ULONG - 1) / BITS_PER_ULONG;
+	len = sizeof(struct registry_chunk)
+		+ nr_slots * sizeof(struct urcu_bp_reader)
+		+ 3 * nr_words * sizeof(unsigned long);
+	new_chunk = map_chunk(&len, node);
+	/* Fault the chunk in from its node. */
+	memset(new_chunk, 0, len);
+	new_chunk->len = len;
+	new_chunk->nr_slots = nr_slots;
+	bitmaps = (unsigned long *) &new_chunk->readers[nr_slots];
+	new_chunk->used = bitmaps;
+	new_chunk->pending = bitmaps + nr_words;
+	new_chunk->snap = bitmaps + 2 * nr_words;
+	/* Bits past the last slot are never free. */
+	if (nr_slots % BITS_PER_ULONG)
+		new_chunk->used[nr_words - 1] =
+			~0UL << (nr_slots % BITS_PER_ULONG);
+	cds_list_add_tail_rcu(&new_chunk->node, &arena->chunk_list);
 }
 
+/* Claim a free slot in the allocation bitmaps, without lock. */
 static
-struct rcu_reader *arena_alloc(struct registry_arena *arena)
+struct urcu_bp_reader *arena_alloc(struct registry_arena *arena)
 {
 	struct registry_chunk *chunk;
-	struct rcu_reader *rcu_reader_reg;
-	int expand_done = 0;	/* Only allow to expand once per alloc */
-	size_t len = sizeof(struct rcu_reader);
-
-retry:
-	cds_list_for_each_entry(chunk, &arena->chunk_list, node) {
-		if (chunk->data_len - chunk->used < len)
-			continue;
-		/* Find spot */
-		for (rcu_reader_reg = (struct rcu_reader *) &chunk->data[0];
-				rcu_reader_reg < (struct rcu_reader *) &chunk->data[chunk->data_len];
-				rcu_reader_reg++) {
-			if (!rcu_reader_reg->alloc) {
-				rcu_reader_reg->alloc = 1;
-				chunk->used += len;
-				return rcu_reader_reg;
+	unsigned long bits, old;
+	size_t i;
+
+	cds_list_for_each_entry_rcu(chunk, &arena->chunk_list, node) {
+		for (i = 0; i < chunk_nr_words(chunk); i++) {
+			bits = uatomic_read(&chunk->used[i]);
+			while (~bits) {
+				unsigned long bit = ~bits & (bits + 1);
+
+				old = uatomic_cmpxchg(&chunk->used[i], bits,
+						bits | bit);
+				if (old == bits)
+					return &chunk->readers[i * BITS_PER_ULONG
+						+ __builtin_ctzl(bit)];
+				bits = old;
 			}
 		}
 	}
-
-	if (!expand_done) {
-		expand_arena(arena);
-		expand_done = 1;
-		goto retry;
-	}
-
 	return NULL;
 }
 
-/* Called with signals off and mutex locked */
+/*
+ * Grow the arena when all slots are in use. Signals are disabled so a
+ * handler registering its thread cannot deadlock on rcu_arena_lock.
+ */
 static
-void add_thread(void)
+struct urcu_bp_reader *arena_alloc_expand(struct registry_arena *arena,
+		int node)
 {
-	struct rcu_reader *rcu_reader_reg;
+	struct urcu_bp_reader *rcu_reader_reg;
+	sigset_t newmask, oldmask;
 	int ret;
 
-	rcu_reader_reg = arena_alloc(&registry_arena);
-	if (!rcu_reader_reg)
+	ret = sigfillset(&newmask);
+	if (ret)
 		abort();
-	ret = pthread_setspecific(urcu_bp_key, rcu_reader_reg);
+	ret = pthread_sigmask(SIG_BLOCK, &newmask, &oldmask);
 	if (ret)
 		abort();
-
-	/* Add to registry */
-	rcu_reader_reg->tid = pthread_self();
-	assert(rcu_reader_reg->ctr == 0);
-	cds_list_add(&rcu_reader_reg->node, &registry);
-	/*
-	 * Reader threads are pointing to the reader registry. This is
-	 * why its memory should never be relocated.
-	 */
-	URCU_TLS(urcu_bp_reader) = rcu_reader_reg;
-}
-
-/* Called with mutex locked */
-static
-void cleanup_thread(struct registry_chunk *chunk,
-		struct rcu_reader *rcu_reader_reg)
-{
-	rcu_reader_reg->ctr = 0;
-	cds_list_del(&rcu_reader_reg->node);
-	rcu_reader_reg->tid = 0;
-	rcu_reader_reg->alloc = 0;
-	chunk->used -= sizeof(struct rcu_reader);
+	mutex_lock(&rcu_arena_lock);
+	rcu_reader_reg = arena_alloc(arena);
+	if (!rcu_reader_reg) {
+		expand_arena(arena, node);
+		rcu_reader_reg = arena_alloc(arena);
+	}
+	mutex_unlock(&rcu_arena_lock);
+	ret = pthread_sigmask(SIG_SETMASK, &oldmask, NULL);
+	if (ret)
+		abort();
+	return rcu_reader_reg;
 }
 
 static
-struct registry_chunk *find_chunk(struct rcu_reader *rcu_reader_reg)
+struct registry_chunk *find_chunk(struct urcu_bp_reader *rcu_reader_reg)
 {
+	struct registry_arena *arena;
 	struct registry_chunk *chunk;
 
-	cds_list_for_each_entry(chunk, &registry_arena.chunk_list, node) {
-		if (rcu_reader_reg < (struct rcu_reader *) &chunk->data[0])
+	registry_for_each_chunk(arena, chunk) {
+		if (rcu_reader_reg < &chunk->readers[0])
 			continue;
-		if (rcu_reader_reg >= (struct rcu_reader *) &chunk->data[chunk->data_len])
+		if (rcu_reader_reg >= &chunk->readers[chunk->nr_slots])
 			continue;
 		return chunk;
 	}
 	return NULL;
 }
 
-/* Called with signals off and mutex locked */
+/* Release the slot of a reader, without lock. */
 static
-void remove_thread(struct rcu_reader *rcu_reader_reg)
+void cleanup_thread(struct registry_chunk *chunk,
+		struct urcu_bp_reader *rcu_reader_reg)
 {
-	cleanup_thread(find_chunk(rcu_reader_reg), rcu_reader_reg);
-	URCU_TLS(urcu_bp_reader) = NULL;
+	size_t slot = rcu_reader_reg - &chunk->readers[0];
+
+	uatomic_dec(&nr_registered);
+	rcu_reader_reg->ctr = 0;
+	rcu_reader_reg->tid = 0;
+	uatomic_and_release(&chunk->used[slot / BITS_PER_ULONG],
+		~(1UL << (slot % BITS_PER_ULONG)));
+}
+
+/*
+ * Take a reference on the library, without lock unless it has to be
+ * initialized.
+ */
+static
+void urcu_bp_get(void)
+{
+	int old, refcount = uatomic_read(&urcu_bp_refcount);
+
+	while (refcount > 0) {
+		old = uatomic_cmpxchg(&urcu_bp_refcount, refcount,
+				refcount + 1);
+		if (old == refcount)
+			return;
+		refcount = old;
+	}
+#ifdef CONFIG_RCU_LAZY_INIT
+	/* Without constructor, the first use takes its reference too. */
+	if (!uatomic_xchg(&urcu_bp_lazy_ref, 1))
+		_urcu_bp_init();
+#endif
+	/* Take care of early registration before urcu_bp constructor. */
+	_urcu_bp_init();
 }
 
-/* Disable signals, take mutex, add to registry */
+/*
+ * Lazily register the current thread. Lock-free unless the arena must
+ * grow. A signal handler may register the thread concurrently: the
+ * first to publish its slot in URCU_TLS(urcu_bp_reader) wins, the other
+ * one releases its slot.
+ */
 void urcu_bp_register(void)
 {
-	sigset_t newmask, oldmask;
-	int ret;
+	struct urcu_bp_reader *rcu_reader_reg;
+	struct registry_arena *arena;
+	int ret, node;
 
-	ret = sigfillset(&newmask);
-	if (ret)
-		abort();
-	ret = pthread_sigmask(SIG_BLOCK, &newmask, &oldmask);
-	if (ret)
-		abort();
+	urcu_bp_get();
 
+	node = current_node();
+	arena = &registry_arenas[(node < 0 ? 0 : node) % NR_ARENAS];
+	rcu_reader_reg = arena_alloc(arena);
+	if (!rcu_reader_reg)
+		rcu_reader_reg = arena_alloc_expand(arena, node);
+	if (!rcu_reader_reg)
+		abort();
+	assert(rcu_reader_reg->ctr == 0);
+	rcu_reader_reg->tid = pthread_self();
 	/*
-	 * Check if a signal concurrently registered our thread since
-	 * the check in rcu_read_lock().
+	 * Order the registration before the first read-side critical
+	 * section, see urcu_bp_synchronize_rcu().
 	 */
-	if (URCU_TLS(urcu_bp_reader))
-		goto end;
+	(void) uatomic_add_return(&nr_registered, 1);
 
 	/*
-	 * Take care of early registration before urcu_bp constructor.
+	 * Reader threads are pointing to the reader registry. This is
+	 * why its memory should never be relocated.
 	 */
-	_urcu_bp_init();
-
-	mutex_lock(&rcu_registry_lock);
-	add_thread();
-	mutex_unlock(&rcu_registry_lock);
-end:
-	ret = pthread_sigmask(SIG_SETMASK, &oldmask, NULL);
+	if (uatomic_cmpxchg(&URCU_TLS(urcu_bp_reader), NULL,
+			rcu_reader_reg)) {
+		cleanup_thread(find_chunk(rcu_reader_reg), rcu_reader_reg);
+		urcu_bp_exit();
+		return;
+	}
+	ret = pthread_setspecific(urcu_bp_key, rcu_reader_reg);
 	if (ret)
 		abort();
 }
 URCU_ATTR_ALIAS("urcu_bp_register") void rcu_bp_register();
 
-/* Disable signals, take mutex, remove from registry */
+/* Disable signals, remove from registry */
 static
-void urcu_bp_unregister(struct rcu_reader *rcu_reader_reg)
+void urcu_bp_unregister(struct urcu_bp_reader *rcu_reader_reg)
 {
 	sigset_t newmask, oldmask;
 	int ret;
@@ -580,9 +845,8 @@ void urcu_bp_unregister(struct rcu_reader *rcu_reader_reg)
 	if (ret)
 		abort();
 
-	mutex_lock(&rcu_registry_lock);
-	remove_thread(rcu_reader_reg);
-	mutex_unlock(&rcu_registry_lock);
+	URCU_TLS(urcu_bp_reader) = NULL;
+	cleanup_thread(find_chunk(rcu_reader_reg), rcu_reader_reg);
 	ret = pthread_sigmask(SIG_SETMASK, &oldmask, NULL);
 	if (ret)
 		abort();
@@ -637,7 +901,7 @@ static
 void _urcu_bp_init(void)
 {
 	mutex_lock(&init_lock);
-	if (!urcu_bp_refcount++) {
+	if (!uatomic_read(&urcu_bp_refcount)) {
 		int ret;
 
 		ret = pthread_key_create(&urcu_bp_key,
@@ -645,8 +909,10 @@ void _urcu_bp_init(void)
 		if (ret)
 			abort();
 		urcu_bp_sys_membarrier_init();
-		initialized = 1;
+		cpu_node_init();
 	}
+	/* Publish the initialization to urcu_bp_get(). */
+	(void) uatomic_add_return(&urcu_bp_refcount, 1);
 	mutex_unlock(&init_lock);
 }
 
@@ -654,16 +920,19 @@ static
 void urcu_bp_exit(void)
 {
 	mutex_lock(&init_lock);
-	if (!--urcu_bp_refcount) {
+	if (!uatomic_sub_return(&urcu_bp_refcount, 1)) {
+		struct registry_arena *arena;
 		struct registry_chunk *chunk, *tmp;
 		int ret;
 
-		cds_list_for_each_entry_safe(chunk, tmp,
-				&registry_arena.chunk_list, node) {
-			munmap((void *) chunk, chunk->data_len
-					+ sizeof(struct registry_chunk));
+		for (arena = registry_arenas;
+				arena < &registry_arenas[NR_ARENAS]; arena++) {
+			cds_list_for_each_entry_safe(chunk, tmp,
+					&arena->chunk_list, node) {
+				munmap((void *) chunk, chunk->len);
+			}
+			CDS_INIT_LIST_HEAD(&arena->chunk_list);
 		}
-		CDS_INIT_LIST_HEAD(&registry_arena.chunk_list);
 		ret = pthread_key_delete(urcu_bp_key);
 		if (ret)
 			abort();
@@ -671,10 +940,19 @@ void urcu_bp_exit(void)
 	mutex_unlock(&init_lock);
 }
 
+#ifdef CONFIG_RCU_LAZY_INIT
+static
+void urcu_bp_lazy_exit(void)
+{
+	if (uatomic_read(&urcu_bp_lazy_ref))
+		urcu_bp_exit();
+}
+#endif
+
 /*
- * Holding the rcu_gp_lock and rcu_registry_lock across fork will make
- * sure we fork() don't race with a concurrent thread executing with
- * any of those locks held. This ensures that the registry and data
+ * Holding the rcu_gp_lock, rcu_registry_lock and rcu_arena_lock across
+ * fork will make sure we fork() don't race with a concurrent thread
+ * executing with any of those locks held. This ensures that the registry and data
  * protected by rcu_gp_lock are in a coherent state in the child.
  */
 void urcu_bp_before_fork(void)
@@ -688,6 +966,7 @@ void urcu_bp_before_fork(void)
 	assert(!ret);
 	mutex_lock(&rcu_gp_lock);
 	mutex_lock(&rcu_registry_lock);
+	mutex_lock(&rcu_arena_lock);
 	saved_fork_signal_mask = oldmask;
 }
 URCU_ATTR_ALIAS("urcu_bp_before_fork") void rcu_bp_before_fork();
@@ -698,6 +977,7 @@ void urcu_bp_after_fork_parent(void)
 	int ret;
 
 	oldmask = saved_fork_signal_mask;
+	mutex_unlock(&rcu_arena_lock);
 	mutex_unlock(&rcu_registry_lock);
 	mutex_unlock(&rcu_gp_lock);
 	ret = pthread_sigmask(SIG_SETMASK, &oldmask, NULL);
@@ -708,21 +988,24 @@ void rcu_bp_after_fork_parent(void);
 
 /*
  * Prune all entries from registry except our own thread. Fits the Linux
- * fork behavior. Called with rcu_gp_lock and rcu_registry_lock held.
+ * fork behavior. Called with rcu_gp_lock, rcu_registry_lock and
+ * rcu_arena_lock held.
  */
 static
 void urcu_bp_prune_registry(void)
 {
+	struct registry_arena *arena;
 	struct registry_chunk *chunk;
 	struct urcu_bp_reader *rcu_reader_reg;
+	size_t slot;
 
-	cds_list_for_each_entry(chunk, &registry_arena.chunk_list, node) {
-		for (rcu_reader_reg = (struct urcu_bp_reader *) &chunk->data[0];
-				rcu_reader_reg < (struct urcu_bp_reader *) &chunk->data[chunk->data_len];
-				rcu_reader_reg++) {
-			if (!rcu_reader_reg->alloc)
+	registry_for_each_chunk(arena, chunk) {
+		for (slot = 0; slot < chunk->nr_slots; slot++) {
+			if (!(chunk->used[slot / BITS_PER_ULONG]
+					& (1UL << (slot % BITS_PER_ULONG))))
 				continue;
-			if (rcu_reader_reg->tid == pthread_self())
+			rcu_reader_reg = &chunk->readers[slot];
+			if (rcu_reader_reg == URCU_TLS(urcu_bp_reader))
 				continue;
 			cleanup_thread(chunk, rcu_reader_reg);
 		}
@@ -736,6 +1019,7 @@ void urcu_bp_after_fork_child(void)
 
 	urcu_bp_prune_registry();
 	oldmask = saved_fork_signal_mask;
+	mutex_unlock(&rcu_arena_lock);
 	mutex_unlock(&rcu_registry_lock);
 	mutex_unlock(&rcu_gp_lock);
 	ret = pthread_sigmask(SIG_SETMASK, &oldmask, NULL);
@@ -779,5 +1063,20 @@ void *rcu_cmpxchg_pointer_sym_bp();
 DEFINE_RCU_FLAVOR(rcu_flavor);
 DEFINE_RCU_FLAVOR_ALIAS(rcu_flavor, alias_rcu_flavor);
 
+/*
+ * Mappings of the reader registry, for rcu_get_mem_stats(). Chunks are
+ * never unlinked before exit, so that the walk needs no lock.
+ */
+static size_t rcu_registry_mem_bytes(void)
+{
+	struct registry_arena *arena;
+	struct registry_chunk *chunk;
+	size_t bytes = 0;
+
+	registry_for_each_chunk(arena, chunk)
+		bytes += chunk->len;
+	return bytes;
+}
+
 #include "urcu-call-rcu-impl.h"
 #include "urcu-defer-impl.h"
@@ -27,27 +27,102 @@
 #include <assert.h>
 #include <stdlib.h>
 #include <stdint.h>
+#include <limits.h>
 #include <string.h>
 #include <errno.h>
+#include <fcntl.h>
 #include <poll.h>
 #include <sys/time.h>
+#include <time.h>
 #include <unistd.h>
 #include <sched.h>
 
 #include "compat-getcpu.h"
+#include "compat-numa.h"
 #include <urcu/wfcqueue.h>
+#include <urcu/wfcqueue-prio.h>
 #include <urcu/call-rcu.h>
 #include <urcu/pointer.h>
 #include <urcu/list.h>
 #include <urcu/futex.h>
 #include <urcu/tls-compat.h>
 #include <urcu/ref.h>
+#include <urcu/cache-line.h>
+#include <urcu/asymmetric-fence.h>
 #include "urcu-die.h"
 #include "urcu-utils.h"
+#include "urcu-gp-seq.h"
+#include "urcu-spin.h"
 
 #define SET_AFFINITY_CHECK_PERIOD		(1U << 8)	/* 256 */
 #define SET_AFFINITY_CHECK_PERIOD_MASK		(SET_AFFINITY_CHECK_PERIOD - 1)
 
+/*
+ * Default batching policy: the delay between two batches starts at the
+ * maximum, is halved each time callbacks are already pending after a
+ * batch, and doubled each time the queue is found empty.
+ */
+#define CALL_RCU_DEFAULT_MIN_DELAY_MS		1
+#define CALL_RCU_DEFAULT_MAX_DELAY_MS		10
+
+/*
+ * Default lazy callback policy: lazy callbacks wait for the grace period
+ * of other callbacks, unless this many are pending or the oldest has
+ * waited this long.
+ */
+#define CALL_RCU_DEFAULT_LAZY_DELAY_MS		1000
+#define CALL_RCU_DEFAULT_LAZY_QLEN_MAX		10000
+
+/*
+ * Reclaim mode, see rcu_reclaim_urgent(): batches are started back to
+ * back until fewer than this many callbacks are pending.
+ */
+#define CALL_RCU_RECLAIM_QLEN_LOW		64
+
+/*
+ * Default time producers wait for the backlog of a call_rcu_data to
+ * drop below its qlen_limit, see struct call_rcu_attr.
+ */
+#define CALL_RCU_DEFAULT_LIMIT_WAIT_MS		10
+
+/*
+ * Polling intervals of URCU_CALL_RCU_RT threads below this are
+ * busy-waited, see call_rcu_poll().
+ */
+#define CALL_RCU_BUSY_POLL_MAX_US		1000
+
+/*
+ * URCU_CALL_RCU_RT threads finding their queue empty for this long stop
+ * polling, and sleep until call_rcu() wakes them, see call_rcu_park().
+ */
+#define CALL_RCU_RT_PARK_MS			100
+
+/*
+ * Default size above which a batch is invoked by helper threads as well,
+ * and maximum number of helper threads of a batch, see struct
+ * call_rcu_attr.
+ */
+#define CALL_RCU_DEFAULT_PARALLEL_THRESHOLD	65536
+#define CALL_RCU_HELPERS_MAX			64
+
+enum call_rcu_reclaim_state {
+	CALL_RCU_RECLAIM_OFF = 0,
+	CALL_RCU_RECLAIM_ON,		/* batch started since the request */
+	CALL_RCU_RECLAIM_REQUESTED,
+};
+
+/*
+ * Size of the per-thread blocks of pointers queued by call_rcu_bulk()
+ * and free_rcu().
+ */
+#define FREE_RCU_BLOCK_SIZE			4096
+
+/*
+ * Number of ready callbacks dequeued at once from a call_rcu_data in
+ * URCU_CALL_RCU_STEAL mode, by its own thread or a sibling.
+ */
+#define CALL_RCU_STEAL_CHUNK			64
+
 /* Data structure that identifies a call_rcu thread. */
 
 struct call_rcu_data {
@@ -56,28 +131,111 @@ struct call_rcu_data {
 	 * mainly because call_rcu callback-invocation threads use
 	 * batching ("splice") to get an entire list of callbacks, which
 	 * effectively empties the queue, and requires to touch the tail
-	 * anyway.
+	 * anyway. Callbacks are queued into the band of their priority,
+	 * and invoked highest priority first within each batch.
 	 */
-	struct cds_wfcq_tail cbs_tail;
-	struct cds_wfcq_head cbs_head;
+	struct cds_wfcq_prio cbs;
 	unsigned long flags;
 	int32_t futex;
+	unsigned int spin_attempts;	/* see urcu_consumer_spin() */
 	unsigned long qlen; /* maintained for debugging. */
 	pthread_t tid;
 	int cpu_affinity;
 	unsigned long gp_count;
+	/* Batching policy, see struct call_rcu_attr. */
+	unsigned int min_delay_ms;
+	unsigned int max_delay_ms;
+	unsigned int delay_ms;		/* current delay between batches */
+	unsigned long qlen_high_watermark;
+	int32_t delay_futex;		/* -1 while delaying between batches */
+	int32_t urgent;			/* next batch is due without delay */
+	int32_t reclaim;		/* enum call_rcu_reclaim_state */
+	/* Statistics, written by the call_rcu thread only. */
+	unsigned long nr_invoked;
+	unsigned long nr_batches;
+	unsigned long batch_max;
+	unsigned long nr_stolen;
+	unsigned long nr_gp_skipped;
+	/* Producer backpressure, see struct call_rcu_attr. */
+	unsigned long qlen_limit;
+	unsigned int limit_wait_ms;
+	unsigned long nr_throttled;	/* updated by producers */
+	unsigned long nr_rejected;
+	/*
+	 * URCU_CALL_RCU_STEAL mode: callbacks past their grace period,
+	 * dequeued in chunks by this call_rcu thread and idle siblings
+	 * of the same NUMA node. nr_running counts the chunks being
+	 * invoked.
+	 */
+	struct cds_wfcq_tail ready_tail;
+	struct cds_wfcq_head ready_head;
+	unsigned long nr_running;
+	int numa_node;
+	/*
+	 * Callbacks queued by call_rcu_lazy(), also counted in qlen. They
+	 * join the next batch of other callbacks, and only start a grace
+	 * period by themselves once lazy_qlen reaches lazy_qlen_max, or
+	 * lazy_delay_ms after the queue became non-empty at lazy_start_ms.
+	 */
+	struct cds_wfcq_tail lazy_tail;
+	struct cds_wfcq_head lazy_head;
+	unsigned long lazy_qlen;	/* queued since the last flush */
+	uint64_t lazy_start_ms;
+	unsigned int lazy_delay_ms;
+	unsigned long lazy_qlen_max;
+	unsigned int poll_interval_us;	/* URCU_CALL_RCU_RT only */
+	unsigned long parallel_threshold;
+	unsigned int nr_helpers;
+	void *cpuset;			/* cpu_set_t, overrides cpu_affinity */
+	size_t cpuset_size;
 	struct cds_list_head list;
 } __attribute__((aligned(CAA_CACHE_LINE_SIZE)));
 
+struct call_rcu_completion_work {
+	struct rcu_head head;
+	struct call_rcu_completion *completion;
+};
+
+/*
+ * Barrier completions embed one work item for each call_rcu_data they
+ * can wait for, and return to call_rcu_completion_pool when released.
+ */
 struct call_rcu_completion {
 	int barrier_count;
 	int32_t futex;
 	struct urcu_ref ref;
+	struct cds_list_head node;	/* in call_rcu_completion_pool */
+	int nr_works;
+	struct call_rcu_completion_work works[];
 };
 
-struct call_rcu_completion_work {
+/*
+ * Block of pointers released together after a single grace period.
+ */
+struct free_rcu_block {
 	struct rcu_head head;
-	struct call_rcu_completion *completion;
+	void (*func)(void *ptr);
+	unsigned long nr;
+	void *ptrs[];
+};
+
+#define FREE_RCU_BLOCK_NR_PTRS	\
+	((FREE_RCU_BLOCK_SIZE - sizeof(struct free_rcu_block)) / sizeof(void *))
+
+/*
+ * Per-thread batch of callbacks, enabled by set_thread_call_rcu_batch().
+ * The batched callbacks are appended to the queue of crdp at once,
+ * touching the shared queue tail and length once per batch. The
+ * lock is only contended by the functions flushing the batches of all
+ * threads: rcu_barrier(), call_rcu_data_free() and fork.
+ */
+struct call_rcu_batch {
+	pthread_mutex_t lock;
+	struct call_rcu_data *crdp;	/* Target of the batched callbacks. */
+	struct cds_wfcq_node *head, *tail;
+	unsigned long nr;
+	unsigned long nr_max;
+	struct cds_list_head list;	/* Node in call_rcu_batch_list. */
 };
 
 /*
@@ -91,18 +249,123 @@ static CDS_LIST_HEAD(call_rcu_data_list);
 
 static DEFINE_URCU_TLS(struct call_rcu_data *, thread_call_rcu_data);
 
+/* Set in call_rcu and helper threads, which never wait for their backlog. */
+
+static DEFINE_URCU_TLS(int, thread_call_rcu_worker);
+
+/*
+ * Producers waiting for a call_rcu_data backlog to drop below its
+ * qlen_limit, woken up by call_rcu threads after each batch.
+ */
+
+static int32_t call_rcu_limit_futex;
+static int32_t call_rcu_limit_waiters;
+
+/* Block being filled by call_rcu_bulk() and free_rcu() in this thread. */
+
+static DEFINE_URCU_TLS(struct free_rcu_block *, thread_free_rcu_block);
+static pthread_key_t free_rcu_block_key;
+static pthread_once_t free_rcu_block_key_once = PTHREAD_ONCE_INIT;
+
+/*
+ * Callback batch of this thread, and list of the batches of all threads,
+ * protected by call_rcu_mutex.
+ */
+
+static DEFINE_URCU_TLS(struct call_rcu_batch *, thread_call_rcu_batch);
+static CDS_LIST_HEAD(call_rcu_batch_list);
+static pthread_key_t call_rcu_batch_key;
+static pthread_once_t call_rcu_batch_key_once = PTHREAD_ONCE_INIT;
+
 /*
  * Guard call_rcu thread creation and atfork handlers.
  */
 static pthread_mutex_t call_rcu_mutex = PTHREAD_MUTEX_INITIALIZER;
 
+/*
+ * Released barrier completions, kept for the next barriers so that they
+ * do not allocate memory: the creation of each call_rcu_data reserves
+ * two completions large enough for all of them, one for a barrier and
+ * one for the previous barrier, which call_rcu threads may still hold
+ * for a moment after the barrier caller returns. Protected by
+ * call_rcu_completion_mutex, taken after call_rcu_mutex when both are.
+ */
+#define CALL_RCU_COMPLETION_POOL_MAX	4
+#define CALL_RCU_COMPLETION_RESERVE	2
+
+static CDS_LIST_HEAD(call_rcu_completion_pool);
+static unsigned int call_rcu_completion_pool_len;
+static pthread_mutex_t call_rcu_completion_mutex = PTHREAD_MUTEX_INITIALIZER;
+
+/* Sizes of the objects queued by call_rcu_sized(), pending their callback. */
+
+static unsigned long call_rcu_pending_bytes;
+
+/* Provided by the flavor and by urcu-defer-impl.h to rcu_get_mem_stats(). */
+
+static size_t rcu_registry_mem_bytes(void);
+static void rcu_defer_get_mem_stats(struct urcu_mem_stats *stats);
+
 /* If a given thread does not have its own call_rcu thread, this is default. */
 
 static struct call_rcu_data *default_call_rcu_data;
 
+/*
+ * rcu_barrier() passes started and completed, and whether one is in
+ * flight. Protected by call_rcu_mutex.
+ */
+static unsigned long rcu_barrier_started, rcu_barrier_completed;
+static int rcu_barrier_running;
+static pthread_cond_t rcu_barrier_cond = PTHREAD_COND_INITIALIZER;
+
+/*
+ * Lazy fork mode, see call_rcu_set_fork_lazy(): the callbacks inherited
+ * by a fork child wait in the orphan queue for the creation of its
+ * default call_rcu_data. Protected by call_rcu_mutex.
+ */
+static int call_rcu_fork_lazy;
+static struct {
+	struct cds_wfcq_head head;
+	struct cds_wfcq_tail tail;
+	unsigned long qlen;
+	int pending;		/* ATOMIC: the queue is initialized. */
+} fork_orphans;
+
 static struct urcu_atfork *registered_rculfhash_atfork;
+
+/*
+ * Memory pressure monitor, see rcu_reclaim_monitor_start(). Protected
+ * by call_rcu_mutex.
+ */
+static struct reclaim_monitor {
+	int running;
+	int psi;		/* fd holds a PSI trigger */
+	int fd;
+	int stop_pipe[2];
+	pthread_t tid;
+} reclaim_monitor;
+
+/*
+ * Signal-triggered dump thread, see rcu_introspect_signal_start().
+ * Protected by call_rcu_mutex.
+ */
+static struct introspect_signal {
+	int running;
+	int signo;
+	int fd;			/* dump output */
+	int signal_pipe[2];	/* written by the signal handler */
+	int stop_pipe[2];
+	struct sigaction old_action;
+	pthread_t tid;
+} introspect_signal;
+
+/* Write end of introspect_signal.signal_pipe, for the signal handler. */
+static int introspect_signal_wfd = -1;
 static unsigned long registered_rculfhash_atfork_refcount;
 
+static void _rcu_barrier_complete(struct rcu_head *head);
+static void wake_call_rcu_thread(struct call_rcu_data *crdp);
+
 /*
  * If the sched_getcpu() and sysconf(_SC_NPROCESSORS_CONF) calls are
  * available, then we can have call_rcu threads assigned to individual
@@ -152,6 +415,85 @@ static void alloc_cpu_call_rcu_data(void)
 	}
 }
 
+/*
+ * CPUs of each NUMA node, for call_rcu_node() and URCU_CALL_RCU_NUMA:
+ * those of node n are cpus[start[n]] to cpus[start[n + 1] - 1]. Built
+ * once by create_all_cpu_call_rcu_data(), under call_rcu_mutex, and
+ * never freed, as the nodes of the CPUs do not change.
+ */
+struct call_rcu_numa_map {
+	int nr_nodes;
+	long *start;
+	int cpus[];
+};
+
+static struct call_rcu_numa_map *call_rcu_numa_map;
+
+static void alloc_call_rcu_numa_map(void)
+{
+	struct call_rcu_numa_map *map;
+	int *cpu_node;
+	long cpu, pos;
+	int node, nr_nodes = 0;
+
+	if (call_rcu_numa_map || maxcpus <= 0)
+		return;
+	cpu_node = malloc(maxcpus * sizeof(*cpu_node));
+	if (!cpu_node)
+		return;
+	for (cpu = 0; cpu < maxcpus; cpu++) {
+		cpu_node[cpu] = urcu_numa_node_of_cpu(cpu);
+		if (cpu_node[cpu] >= nr_nodes)
+			nr_nodes = cpu_node[cpu] + 1;
+	}
+	if (!nr_nodes)
+		goto end;	/* Unknown topology. */
+	map = malloc(sizeof(*map) + maxcpus * sizeof(map->cpus[0]));
+	if (!map)
+		goto end;
+	map->start = calloc(nr_nodes + 1, sizeof(*map->start));
+	if (!map->start) {
+		free(map);
+		goto end;
+	}
+	map->nr_nodes = nr_nodes;
+	pos = 0;
+	for (node = 0; node < nr_nodes; node++) {
+		map->start[node] = pos;
+		for (cpu = 0; cpu < maxcpus; cpu++) {
+			if (cpu_node[cpu] == node)
+				map->cpus[pos++] = cpu;
+		}
+	}
+	map->start[nr_nodes] = pos;
+	rcu_set_pointer(&call_rcu_numa_map, map);
+end:
+	free(cpu_node);
+}
+
+/*
+ * Return a per-CPU call_rcu_data of node, or NULL. The callers of the
+ * CPUs of other nodes spread over the CPUs of node. Caller must be
+ * within a RCU read-side critical section.
+ */
+static struct call_rcu_data *get_node_call_rcu_data(int node)
+{
+	struct call_rcu_numa_map *map;
+	long nr;
+	int cpu;
+
+	map = rcu_dereference(call_rcu_numa_map);
+	if (!map || node < 0 || node >= map->nr_nodes)
+		return NULL;
+	nr = map->start[node + 1] - map->start[node];
+	if (!nr)
+		return NULL;
+	cpu = urcu_sched_getcpu();
+	if (cpu < 0)
+		cpu = 0;
+	return get_cpu_call_rcu_data(map->cpus[map->start[node] + cpu % nr]);
+}
+
 #else /* #if defined(HAVE_SYSCONF) && defined(HAVE_SCHED_GETCPU) */
 
 /*
@@ -170,17 +512,22 @@ static void alloc_cpu_call_rcu_data(void)
 {
 }
 
+static void alloc_call_rcu_numa_map(void)
+{
+}
+
+static struct call_rcu_data *get_node_call_rcu_data(int node)
+{
+	return NULL;
+}
+
 #endif /* #else #if defined(HAVE_SYSCONF) && defined(HAVE_SCHED_GETCPU) */
 
 /* Acquire the specified pthread mutex. */
 
 static void call_rcu_lock(pthread_mutex_t *pmp)
 {
-	int ret;
-
-	ret = pthread_mutex_lock(pmp);
-	if (ret)
-		urcu_die(ret);
+	urcu_mutex_lock(pmp, pmp == &call_rcu_mutex ? &lock_stats.call_rcu : NULL);
 }
 
 /* Release the specified pthread mutex. */
@@ -206,6 +553,17 @@ int set_thread_cpu_affinity(struct call_rcu_data *crdp)
 	cpu_set_t mask;
 	int ret;
 
+	if (crdp->cpuset) {
+		/* Applied once: the thread may migrate within the set. */
+		if (crdp->gp_count++)
+			return 0;
+#if SCHED_SETAFFINITY_ARGS == 2
+		ret = sched_setaffinity(0, crdp->cpuset);
+#else
+		ret = sched_setaffinity(0, crdp->cpuset_size, crdp->cpuset);
+#endif
+		goto end;
+	}
 	if (crdp->cpu_affinity < 0)
 		return 0;
 	if (++crdp->gp_count & SET_AFFINITY_CHECK_PERIOD_MASK)
@@ -220,6 +578,7 @@ int set_thread_cpu_affinity(struct call_rcu_data *crdp)
 #else
 	ret = sched_setaffinity(0, sizeof(mask), &mask);
 #endif
+end:
 	/*
 	 * EINVAL is fine: can be caused by hotunplugged CPUs, or by
 	 * cpuset(7). This is why we should always retry if we detect
@@ -239,14 +598,96 @@ int set_thread_cpu_affinity(struct call_rcu_data *crdp)
 }
 #endif
 
+static uint64_t call_rcu_now_us(void)
+{
+	struct timespec ts;
+
+	if (clock_gettime(CLOCK_MONOTONIC, &ts))
+		urcu_die(errno);
+	return (uint64_t) ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+}
+
+static uint64_t call_rcu_now_ms(void)
+{
+	return call_rcu_now_us() / 1000;
+}
+
+/*
+ * Return 0 if the lazy callbacks of crdp are due for a grace period of
+ * their own, otherwise the delay in ms until they are, or UINT_MAX if
+ * there are none.
+ */
+static unsigned int call_rcu_lazy_wait_ms(struct call_rcu_data *crdp)
+{
+	uint64_t age;
+
+	if (cds_wfcq_empty(&crdp->lazy_head, &crdp->lazy_tail))
+		return UINT_MAX;
+	if (uatomic_read(&crdp->urgent) || uatomic_read(&crdp->reclaim)
+			|| uatomic_read(&crdp->lazy_qlen) >= crdp->lazy_qlen_max)
+		return 0;
+	age = call_rcu_now_ms() - CMM_LOAD_SHARED(crdp->lazy_start_ms);
+	if (age >= crdp->lazy_delay_ms)
+		return 0;
+	return crdp->lazy_delay_ms - (unsigned int) age;
+}
+
+/*
+ * Move the lazy callbacks of crdp ahead of the callbacks queued in
+ * head and tail, if a grace period is starting for those anyway, or if
+ * the lazy callbacks are due. Lazy callbacks queued before a
+ * rcu_barrier() callback are then invoked before it. Returns whether
+ * lazy callbacks were moved. Called by the call_rcu thread only.
+ */
+static int call_rcu_lazy_take(struct call_rcu_data *crdp,
+		struct cds_wfcq_head *head, struct cds_wfcq_tail *tail,
+		int force)
+{
+	struct cds_wfcq_head lazy_head;
+	struct cds_wfcq_tail lazy_tail;
+
+	if (!force && call_rcu_lazy_wait_ms(crdp))
+		return 0;
+	if (cds_wfcq_empty(&crdp->lazy_head, &crdp->lazy_tail))
+		return 0;
+	uatomic_set(&crdp->lazy_qlen, 0);
+	cds_wfcq_init(&lazy_head, &lazy_tail);
+	(void) __cds_wfcq_splice_blocking(&lazy_head, &lazy_tail,
+		&crdp->lazy_head, &crdp->lazy_tail);
+	(void) __cds_wfcq_splice_blocking(&lazy_head, &lazy_tail, head, tail);
+	(void) __cds_wfcq_splice_blocking(head, tail, &lazy_head, &lazy_tail);
+	return 1;
+}
+
+/*
+ * Wait for callbacks to be queued, or for the pending lazy callbacks to
+ * be due.
+ */
 static void call_rcu_wait(struct call_rcu_data *crdp)
 {
+	struct timespec timeout, *ptimeout = NULL;
+	unsigned int lazy_ms;
+
 	/* Read call_rcu list before read futex */
 	cmm_smp_mb();
 	if (uatomic_read(&crdp->futex) != -1)
 		return;
-	while (futex_async(&crdp->futex, FUTEX_WAIT, -1,
-			NULL, NULL, 0)) {
+	lazy_ms = call_rcu_lazy_wait_ms(crdp);
+	if (lazy_ms != UINT_MAX) {
+#ifdef CONFIG_RCU_HAVE_FUTEX
+		timeout.tv_sec = lazy_ms / 1000;
+		timeout.tv_nsec = (lazy_ms % 1000) * 1000000L;
+		ptimeout = &timeout;
+#else
+		/* Compatibility futexes ignore the timeout. */
+		(void) poll(NULL, 0, lazy_ms);
+		goto timedout;
+#endif
+		if (!lazy_ms)
+			goto timedout;
+	}
+	while (futex_async(&crdp->futex, FUTEX_WAIT_PRIVATE, -1,
+			ptimeout, NULL, 0)) {
 		switch (errno) {
 		case EWOULDBLOCK:
 			/* Value already changed. */
@@ -254,32 +695,243 @@ static void call_rcu_wait(struct call_rcu_data *crdp)
 		case EINTR:
 			/* Retry if interrupted by signal. */
 			break;	/* Get out of switch. */
+		case ETIMEDOUT:
+			goto timedout;
 		default:
 			/* Unexpected error. */
 			urcu_die(errno);
 		}
 	}
+	return;
+
+timedout:
+	/* As if woken up: the call_rcu thread decrements it again. */
+	uatomic_set(&crdp->futex, 0);
 }
 
-static void call_rcu_wake_up(struct call_rcu_data *crdp)
+/* Called after the write to the call_rcu list is ordered before. */
+static void call_rcu_wake_up_sleeping(struct call_rcu_data *crdp)
 {
-	/* Write to call_rcu list before reading/writing futex */
-	cmm_smp_mb();
 	if (caa_unlikely(uatomic_read(&crdp->futex) == -1)) {
 		uatomic_set(&crdp->futex, 0);
-		if (futex_async(&crdp->futex, FUTEX_WAKE, 1,
+		if (futex_async(&crdp->futex, FUTEX_WAKE_PRIVATE, 1,
 				NULL, NULL, 0) < 0)
 			urcu_die(errno);
 	}
 }
 
+static void call_rcu_wake_up(struct call_rcu_data *crdp)
+{
+	/* Write to call_rcu list before reading/writing futex */
+	cmm_smp_mb();
+	call_rcu_wake_up_sleeping(crdp);
+}
+
+static int call_rcu_above_high_watermark(struct call_rcu_data *crdp)
+{
+	return crdp->qlen_high_watermark
+		&& uatomic_read(&crdp->qlen) >= crdp->qlen_high_watermark;
+}
+
+static int call_rcu_batch_due(struct call_rcu_data *crdp)
+{
+	return uatomic_read(&crdp->urgent) || uatomic_read(&crdp->reclaim)
+		|| call_rcu_above_high_watermark(crdp);
+}
+
+/*
+ * Wait for the grace period of a batch, expedited in reclaim mode when
+ * the flavor supports it.
+ */
+static void call_rcu_synchronize(struct call_rcu_data *crdp)
+{
+#ifdef synchronize_rcu_expedited
+	if (uatomic_read(&crdp->reclaim)) {
+		synchronize_rcu_expedited();
+		return;
+	}
+#endif
+	synchronize_rcu();
+}
+
+/*
+ * Leave reclaim mode once the backlog is below the low watermark, unless
+ * reclaim was requested again since the last batch started.
+ */
+static void call_rcu_reclaim_update(struct call_rcu_data *crdp)
+{
+	if (uatomic_read(&crdp->reclaim) == CALL_RCU_RECLAIM_ON
+			&& uatomic_read(&crdp->qlen) < CALL_RCU_RECLAIM_QLEN_LOW)
+		(void) uatomic_cmpxchg(&crdp->reclaim, CALL_RCU_RECLAIM_ON,
+			CALL_RCU_RECLAIM_OFF);
+}
+
+/*
+ * Wait between two batches, to let callbacks accumulate. The wait is
+ * cut short by enqueuers when the queue length reaches the high
+ * watermark, or when they hurry the next batch.
+ */
+static void call_rcu_delay_us(struct call_rcu_data *crdp, uint64_t delay_us)
+{
+	struct timespec timeout;
+
+	if (!delay_us)
+		return;
+	timeout.tv_sec = delay_us / 1000000;
+	timeout.tv_nsec = (delay_us % 1000000) * 1000L;
+#ifdef CONFIG_RCU_HAVE_FUTEX
+	uatomic_set(&crdp->delay_futex, -1);
+	/* Write futex before read queue length and urgent */
+	cmm_smp_mb();
+	if (!call_rcu_batch_due(crdp)) {
+		/* Timeout and wakeup both end the delay. */
+		if (futex(&crdp->delay_futex, FUTEX_WAIT_PRIVATE, -1, &timeout,
+				NULL, 0) && errno == ENOSYS)
+			(void) nanosleep(&timeout, NULL);
+	}
+	uatomic_set(&crdp->delay_futex, 0);
+#else
+	if (!call_rcu_batch_due(crdp))
+		(void) nanosleep(&timeout, NULL);
+#endif
+}
+
+static void call_rcu_delay(struct call_rcu_data *crdp, unsigned int delay_ms)
+{
+	call_rcu_delay_us(crdp, (uint64_t) delay_ms * 1000);
+}
+
+/*
+ * Wait poll_interval_us between two checks of the queue of a
+ * URCU_CALL_RCU_RT thread, instead of the delays between batches.
+ * Intervals too short to sleep are busy-waited. Batches due without
+ * delay end the wait.
+ */
+static void call_rcu_poll(struct call_rcu_data *crdp)
+{
+	unsigned int interval_us = crdp->poll_interval_us;
+	uint64_t deadline;
+
+	if (interval_us >= CALL_RCU_BUSY_POLL_MAX_US) {
+		call_rcu_delay_us(crdp, interval_us);
+		return;
+	}
+	deadline = call_rcu_now_us() + interval_us;
+	while (call_rcu_now_us() < deadline && !call_rcu_batch_due(crdp))
+		caa_cpu_relax();
+}
+
+/*
+ * Sleep until callbacks are queued, or lazy callbacks are due, once a
+ * URCU_CALL_RCU_RT thread has been idle for CALL_RCU_RT_PARK_MS, so
+ * that idle processes are not woken up by polling. call_rcu() only
+ * issues a compiler barrier on its side, paired with the heavy fence,
+ * and a FUTEX_WAKE for the first callback queued after the thread has
+ * parked.
+ */
+static void call_rcu_park(struct call_rcu_data *crdp)
+{
+	uatomic_set(&crdp->futex, -1);
+	/* Write futex before reading call_rcu list and flags */
+	cmm_asymmetric_fence_heavy();
+	if (cds_wfcq_prio_empty(&crdp->cbs)
+			&& !(uatomic_read(&crdp->flags)
+				& (URCU_CALL_RCU_STOP | URCU_CALL_RCU_PAUSE)))
+		call_rcu_wait(crdp);
+	uatomic_set(&crdp->futex, 0);
+}
+
+/*
+ * Whether a URCU_CALL_RCU_RT thread finding its queue empty has been
+ * idle long enough to park, idle_start_ms being 0 if it was not idle.
+ */
+static int call_rcu_rt_idle(uint64_t *idle_start_ms)
+{
+	uint64_t now = call_rcu_now_ms();
+
+	if (!*idle_start_ms) {
+		*idle_start_ms = now ? now : 1;
+		return 0;
+	}
+	return now - *idle_start_ms >= CALL_RCU_RT_PARK_MS;
+}
+
+/*
+ * Adapt the delay between batches: shrink it while callbacks keep
+ * being queued, grow it back when the queue drains. No delay at all
+ * when the high watermark is reached or the batch is hurried.
+ */
+static unsigned int call_rcu_next_delay(struct call_rcu_data *crdp, int pending)
+{
+	unsigned int min_delay_ms = CMM_LOAD_SHARED(crdp->min_delay_ms);
+	unsigned int max_delay_ms = CMM_LOAD_SHARED(crdp->max_delay_ms);
+
+	if (call_rcu_batch_due(crdp))
+		return 0;
+	if (pending)
+		crdp->delay_ms = max_t(unsigned int, crdp->delay_ms >> 1,
+				min_delay_ms);
+	else
+		crdp->delay_ms = crdp->delay_ms << 1;
+	/* The policy may have changed since the last batch. */
+	crdp->delay_ms = min_t(unsigned int, crdp->delay_ms, max_delay_ms);
+	return crdp->delay_ms;
+}
+
+static void call_rcu_wake_up_delay(struct call_rcu_data *crdp)
+{
+	if (caa_unlikely(uatomic_read(&crdp->delay_futex) == -1)) {
+		uatomic_set(&crdp->delay_futex, 0);
+#ifdef CONFIG_RCU_HAVE_FUTEX
+		(void) futex(&crdp->delay_futex, FUTEX_WAKE_PRIVATE, 1,
+				NULL, NULL, 0);
+#endif
+	}
+}
+
+/*
+ * Have the next batch of crdp start without delay, e.g. because its
+ * callbacks are waited for. Called from many concurrent threads.
+ */
+static void call_rcu_hurry(struct call_rcu_data *crdp)
+{
+	uatomic_set(&crdp->urgent, 1);
+	/* Write urgent before read futex */
+	cmm_smp_mb();
+	call_rcu_wake_up_delay(crdp);
+}
+
+/*
+ * Set the delays between batches of crdp, from attr or the defaults.
+ * They apply from the next batch, which starts over from the maximum
+ * delay.
+ */
+static void call_rcu_data_set_delays(struct call_rcu_data *crdp,
+		const struct call_rcu_attr *attr)
+{
+	unsigned int min_delay_ms = CALL_RCU_DEFAULT_MIN_DELAY_MS;
+	unsigned int max_delay_ms = CALL_RCU_DEFAULT_MAX_DELAY_MS;
+
+	if (attr) {
+		if (attr->min_delay_ms)
+			min_delay_ms = attr->min_delay_ms;
+		if (attr->max_delay_ms)
+			max_delay_ms = attr->max_delay_ms;
+	}
+	if (min_delay_ms > max_delay_ms)
+		min_delay_ms = max_delay_ms;
+	CMM_STORE_SHARED(crdp->min_delay_ms, min_delay_ms);
+	CMM_STORE_SHARED(crdp->max_delay_ms, max_delay_ms);
+	CMM_STORE_SHARED(crdp->delay_ms, max_delay_ms);
+}
+
 static void call_rcu_completion_wait(struct call_rcu_completion *completion)
 {
 	/* Read completion barrier count before read futex */
 	cmm_smp_mb();
 	if (uatomic_read(&completion->futex) != -1)
 		return;
-	while (futex_async(&completion->futex, FUTEX_WAIT, -1,
+	while (futex_async(&completion->futex, FUTEX_WAIT_PRIVATE, -1,
 			NULL, NULL, 0)) {
 		switch (errno) {
 		case EWOULDBLOCK:
@@ -301,19 +953,460 @@ static void call_rcu_completion_wake_up(struct call_rcu_completion *completion)
 	cmm_smp_mb();
 	if (caa_unlikely(uatomic_read(&completion->futex) == -1)) {
 		uatomic_set(&completion->futex, 0);
-		if (futex_async(&completion->futex, FUTEX_WAKE, 1,
+		if (futex_async(&completion->futex, FUTEX_WAKE_PRIVATE, 1,
 				NULL, NULL, 0) < 0)
 			urcu_die(errno);
 	}
 }
 
-/* This is the code run by each call_rcu thread. */
-
-static void *call_rcu_thread(void *arg)
+static
+struct call_rcu_completion *call_rcu_completion_new(int count)
 {
-	unsigned long cbcount;
+	struct call_rcu_completion *completion;
+
+	completion = calloc(sizeof(*completion)
+			+ count * sizeof(completion->works[0]), 1);
+	if (!completion)
+		urcu_die(errno);
+	completion->nr_works = count;
+	return completion;
+}
+
+/*
+ * Take a completion with room for count work items from the pool, or
+ * allocate one. Called with call_rcu_completion_mutex held.
+ */
+static
+struct call_rcu_completion *call_rcu_completion_pool_take(int count)
+{
+	struct call_rcu_completion *completion;
+
+	cds_list_for_each_entry(completion, &call_rcu_completion_pool, node) {
+		if (completion->nr_works >= count) {
+			cds_list_del(&completion->node);
+			call_rcu_completion_pool_len--;
+			return completion;
+		}
+	}
+	return call_rcu_completion_new(count);
+}
+
+/*
+ * Ensure the pool holds CALL_RCU_COMPLETION_RESERVE completions for a
+ * barrier on count call_rcu_data, freeing the smaller ones. Called with
+ * call_rcu_mutex held.
+ */
+static
+void call_rcu_completion_reserve(int count)
+{
+	struct call_rcu_completion *completion, *tmp;
+	int nr_fit = 0;
+
+	call_rcu_lock(&call_rcu_completion_mutex);
+	cds_list_for_each_entry_safe(completion, tmp,
+			&call_rcu_completion_pool, node) {
+		if (completion->nr_works >= count) {
+			nr_fit++;
+			continue;
+		}
+		cds_list_del(&completion->node);
+		call_rcu_completion_pool_len--;
+		free(completion);
+	}
+	for (; nr_fit < CALL_RCU_COMPLETION_RESERVE; nr_fit++) {
+		completion = call_rcu_completion_new(count);
+		cds_list_add(&completion->node, &call_rcu_completion_pool);
+		call_rcu_completion_pool_len++;
+	}
+	call_rcu_unlock(&call_rcu_completion_mutex);
+}
+
+static int call_rcu_is_sibling(struct call_rcu_data *self,
+		struct call_rcu_data *crdp)
+{
+	return crdp && crdp != self
+		&& (uatomic_read(&crdp->flags) & URCU_CALL_RCU_STEAL)
+		&& crdp->numa_node == self->numa_node;
+}
+
+/* Wake a sibling waiting for callbacks, to steal some of ours. */
+static void call_rcu_wake_sibling(struct call_rcu_data *self)
+{
+	struct call_rcu_data **pcpu_crdp, *crdp;
+	long cpu;
+
+	_rcu_read_lock();
+	pcpu_crdp = rcu_dereference(per_cpu_call_rcu_data);
+	for (cpu = 0; pcpu_crdp && cpu < maxcpus; cpu++) {
+		crdp = rcu_dereference(pcpu_crdp[cpu]);
+		if (call_rcu_is_sibling(self, crdp)
+				&& uatomic_read(&crdp->futex) == -1) {
+			call_rcu_wake_up(crdp);
+			break;
+		}
+	}
+	_rcu_read_unlock();
+}
+
+/*
+ * Dequeue a chunk of ready callbacks of crdp into chunk. A rcu_barrier()
+ * callback is dequeued alone, so it can wait for the callbacks dequeued
+ * before it by other threads. Returns the number of callbacks dequeued.
+ */
+static unsigned long call_rcu_take_chunk(struct call_rcu_data *crdp,
+		struct rcu_head **chunk, int *barrier)
+{
+	struct cds_wfcq_node *node;
+	struct rcu_head *rhp;
+	unsigned long nr = 0;
+
+	*barrier = 0;
+	cds_wfcq_dequeue_lock(&crdp->ready_head, &crdp->ready_tail);
+	while (nr < CALL_RCU_STEAL_CHUNK) {
+		node = __cds_wfcq_first_blocking(&crdp->ready_head,
+				&crdp->ready_tail);
+		if (!node)
+			break;
+		rhp = caa_container_of(node, struct rcu_head, next);
+		if (rhp->func == _rcu_barrier_complete) {
+			if (nr)
+				break;
+			*barrier = 1;
+		}
+		node = __cds_wfcq_dequeue_blocking(&crdp->ready_head,
+				&crdp->ready_tail);
+		chunk[nr++] = caa_container_of(node, struct rcu_head, next);
+		if (*barrier)
+			break;
+	}
+	if (nr)
+		uatomic_inc(&crdp->nr_running);
+	cds_wfcq_dequeue_unlock(&crdp->ready_head, &crdp->ready_tail);
+	return nr;
+}
+
+/*
+ * Account for nr invoked callbacks, and wake up the producers waiting
+ * for a backlog to drain, if any.
+ */
+static void call_rcu_qlen_sub(struct call_rcu_data *crdp, unsigned long nr)
+{
+	uatomic_sub(&crdp->qlen, nr);
+	/* Write qlen before reading call_rcu_limit_waiters. */
+	cmm_smp_mb();
+	if (caa_unlikely(uatomic_read(&call_rcu_limit_waiters))) {
+		uatomic_inc(&call_rcu_limit_futex);
+		(void) futex_async(&call_rcu_limit_futex, FUTEX_WAKE_PRIVATE,
+				INT_MAX, NULL, NULL, 0);
+	}
+}
+
+/*
+ * Per-function callback statistics, see
+ * call_rcu_set_func_sample_period(). Each thread invoking callbacks
+ * times one of every call_rcu_func_sample_period, and accounts it to
+ * the entry of its function, claimed by address in an open-addressing
+ * table. Only sampled callbacks take call_rcu_func_stats_mutex.
+ */
+#define CALL_RCU_FUNC_STATS_SIZE	256
+
+struct call_rcu_func_entry {
+	void (*func)(struct rcu_head *head);
+	struct urcu_call_rcu_func_stats stats;
+};
+
+static unsigned long call_rcu_func_sample_period;
+static DEFINE_URCU_TLS(unsigned long, thread_call_rcu_func_sample);
+static pthread_mutex_t call_rcu_func_stats_mutex = PTHREAD_MUTEX_INITIALIZER;
+static struct call_rcu_func_entry call_rcu_func_stats[CALL_RCU_FUNC_STATS_SIZE];
+/* Samples of the functions which found the table full. */
+static struct urcu_call_rcu_func_stats call_rcu_func_stats_overflow;
+
+static void call_rcu_func_record(void (*func)(struct rcu_head *head),
+		uint64_t duration)
+{
+	struct urcu_call_rcu_func_stats *stats = &call_rcu_func_stats_overflow;
+	struct call_rcu_func_entry *entry;
+	unsigned long i, hash;
+
+	hash = (unsigned long) ((uintptr_t) func >> 4);
+	call_rcu_lock(&call_rcu_func_stats_mutex);
+	for (i = 0; i < CALL_RCU_FUNC_STATS_SIZE; i++) {
+		entry = &call_rcu_func_stats[(hash + i)
+				% CALL_RCU_FUNC_STATS_SIZE];
+		if (!entry->func)
+			entry->func = func;
+		if (entry->func == func) {
+			stats = &entry->stats;
+			break;
+		}
+	}
+	stats->samples++;
+	stats->total_ns += duration;
+	if (duration > stats->max_ns)
+		stats->max_ns = duration;
+	call_rcu_unlock(&call_rcu_func_stats_mutex);
+}
+
+static void call_rcu_invoke_sampled(struct rcu_head *rhp)
+{
+	/* The callback may free rhp. */
+	void (*func)(struct rcu_head *head) = rhp->func;
+	uint64_t start;
+
+	if (++URCU_TLS(thread_call_rcu_func_sample)
+			< CMM_LOAD_SHARED(call_rcu_func_sample_period)) {
+		func(rhp);
+		return;
+	}
+	URCU_TLS(thread_call_rcu_func_sample) = 0;
+	start = urcu_stats_now_ns();
+	func(rhp);
+	call_rcu_func_record(func, urcu_stats_now_ns() - start);
+}
+
+static inline void call_rcu_invoke(struct rcu_head *rhp)
+{
+	if (caa_unlikely(CMM_LOAD_SHARED(call_rcu_func_sample_period)))
+		call_rcu_invoke_sampled(rhp);
+	else
+		rhp->func(rhp);
+}
+
+static void call_rcu_invoke_chunk(struct call_rcu_data *crdp,
+		struct rcu_head **chunk, unsigned long nr, int barrier)
+{
+	unsigned long i;
+
+	if (barrier) {
+		/* Wait for the other chunks dequeued before the barrier. */
+		while (uatomic_read(&crdp->nr_running) > 1)
+			(void) poll(NULL, 0, 1);
+		/* Read nr_running before invoking the barrier callback. */
+		cmm_smp_mb();
+	}
+	for (i = 0; i < nr; i++)
+		call_rcu_invoke(chunk[i]);
+	call_rcu_qlen_sub(crdp, nr);
+	/* Invoke callbacks before decrementing nr_running. */
+	cmm_smp_mb();
+	uatomic_dec(&crdp->nr_running);
+}
+
+/*
+ * Invoke the ready callbacks of crdp, from its own call_rcu thread.
+ * Wake an idle sibling once if callbacks remain after the first chunk.
+ */
+static unsigned long call_rcu_invoke_ready(struct call_rcu_data *crdp)
+{
+	struct rcu_head *chunk[CALL_RCU_STEAL_CHUNK];
+	unsigned long nr, cbcount = 0;
+	int barrier, woken = 0;
+
+	while ((nr = call_rcu_take_chunk(crdp, chunk, &barrier)) != 0) {
+		if (!woken && !cds_wfcq_empty(&crdp->ready_head,
+				&crdp->ready_tail)) {
+			call_rcu_wake_sibling(crdp);
+			woken = 1;
+		}
+		call_rcu_invoke_chunk(crdp, chunk, nr, barrier);
+		cbcount += nr;
+	}
+	return cbcount;
+}
+
+/*
+ * Invoke a chunk of ready callbacks of a sibling. The chunk is invoked
+ * outside of the read-side critical section: nr_running keeps the
+ * sibling from being freed meanwhile. Returns the number of callbacks
+ * invoked.
+ */
+static unsigned long call_rcu_steal(struct call_rcu_data *self)
+{
+	struct rcu_head *chunk[CALL_RCU_STEAL_CHUNK];
+	struct call_rcu_data **pcpu_crdp, *crdp = NULL;
+	unsigned long nr = 0;
+	int barrier;
+	long cpu;
+
+	_rcu_read_lock();
+	pcpu_crdp = rcu_dereference(per_cpu_call_rcu_data);
+	for (cpu = 0; pcpu_crdp && cpu < maxcpus; cpu++) {
+		crdp = rcu_dereference(pcpu_crdp[cpu]);
+		if (!call_rcu_is_sibling(self, crdp)
+				|| cds_wfcq_empty(&crdp->ready_head,
+					&crdp->ready_tail))
+			continue;
+		nr = call_rcu_take_chunk(crdp, chunk, &barrier);
+		if (nr)
+			break;
+	}
+	_rcu_read_unlock();
+	if (!nr)
+		return 0;
+	urcu_tp3(call_rcu_steal, self, crdp, nr);
+	call_rcu_invoke_chunk(crdp, chunk, nr, barrier);
+	CMM_STORE_SHARED(self->nr_invoked, self->nr_invoked + nr);
+	CMM_STORE_SHARED(self->nr_stolen, self->nr_stolen + nr);
+	return nr;
+}
+
+/* Thread invoking the ready callbacks of a large batch. */
+struct call_rcu_helper {
+	struct call_rcu_data *crdp;
+	pthread_t tid;
+	unsigned long cbcount;
+};
+
+/* Helpers run on any CPU, rather than on those of the call_rcu thread. */
+#if HAVE_SCHED_SETAFFINITY
+static void call_rcu_helper_set_affinity(struct call_rcu_data *crdp)
+{
+	cpu_set_t mask;
+	int cpu;
+
+	if (!crdp->cpuset && crdp->cpu_affinity < 0)
+		return;
+	CPU_ZERO(&mask);
+	for (cpu = 0; cpu < CPU_SETSIZE; cpu++)
+		CPU_SET(cpu, &mask);
+	/* The kernel restricts the mask to the CPUs of our cpuset(7). */
+#if SCHED_SETAFFINITY_ARGS == 2
+	(void) sched_setaffinity(0, &mask);
+#else
+	(void) sched_setaffinity(0, sizeof(mask), &mask);
+#endif
+}
+#else
+static void call_rcu_helper_set_affinity(struct call_rcu_data *crdp)
+{
+}
+#endif
+
+static void *call_rcu_helper_thread(void *arg)
+{
+	struct call_rcu_helper *helper = arg;
+	struct call_rcu_data *crdp = helper->crdp;
+	struct rcu_head *chunk[CALL_RCU_STEAL_CHUNK];
+	unsigned long nr;
+	int barrier;
+
+	call_rcu_helper_set_affinity(crdp);
+	rcu_register_thread();
+	URCU_TLS(thread_call_rcu_data) = crdp;
+	URCU_TLS(thread_call_rcu_worker) = 1;
+	while ((nr = call_rcu_take_chunk(crdp, chunk, &barrier)) != 0) {
+		call_rcu_invoke_chunk(crdp, chunk, nr, barrier);
+		helper->cbcount += nr;
+	}
+	rcu_unregister_thread();
+	return NULL;
+}
+
+/*
+ * Number of helper threads for the batch just spliced: one per
+ * parallel_threshold callbacks beyond the first ones. The queue length
+ * also counts the callbacks queued after the splice.
+ */
+static unsigned int call_rcu_nr_batch_helpers(struct call_rcu_data *crdp)
+{
+	unsigned long qlen;
+
+	if (!crdp->nr_helpers)
+		return 0;
+	qlen = uatomic_read(&crdp->qlen);
+	if (qlen <= crdp->parallel_threshold)
+		return 0;
+	return caa_min(qlen / crdp->parallel_threshold,
+		(unsigned long) crdp->nr_helpers);
+}
+
+/*
+ * Invoke a large batch with helper threads, created for the batch and
+ * joined once it is invoked: they dequeue chunks of the ready callbacks
+ * as the call_rcu thread does in URCU_CALL_RCU_STEAL mode, which keeps
+ * rcu_barrier() callbacks behind the callbacks queued before them.
+ * Returns the number of callbacks invoked.
+ */
+static unsigned long call_rcu_invoke_parallel(struct call_rcu_data *crdp,
+		struct cds_wfcq_head *head, struct cds_wfcq_tail *tail,
+		unsigned int nr_helpers)
+{
+	struct call_rcu_helper helpers[CALL_RCU_HELPERS_MAX];
+	unsigned long cbcount;
+	unsigned int i, nr = 0;
+	int ret;
+
+	(void) __cds_wfcq_splice_blocking(&crdp->ready_head,
+		&crdp->ready_tail, head, tail);
+	for (i = 0; i < nr_helpers; i++) {
+		helpers[nr].crdp = crdp;
+		helpers[nr].cbcount = 0;
+		/* Fewer helpers if threads cannot be created. */
+		if (pthread_create(&helpers[nr].tid, NULL,
+				call_rcu_helper_thread, &helpers[nr]))
+			break;
+		nr++;
+	}
+	urcu_tp2(call_rcu_parallel, crdp, nr);
+	cbcount = call_rcu_invoke_ready(crdp);
+	for (i = 0; i < nr; i++) {
+		ret = pthread_join(helpers[i].tid, NULL);
+		if (ret)
+			urcu_die(ret);
+		cbcount += helpers[i].cbcount;
+	}
+	return cbcount;
+}
+
+static bool call_rcu_has_cbs(void *priv)
+{
+	struct call_rcu_data *crdp = priv;
+
+	return !cds_wfcq_prio_empty(&crdp->cbs);
+}
+
+/*
+ * Append the queued callbacks of crdp to head and tail, lazy ones
+ * included if a grace period is starting anyway (force) or if they are
+ * due. Returns whether callbacks were taken.
+ */
+static int call_rcu_take_cbs(struct call_rcu_data *crdp,
+		struct cds_wfcq_head *head, struct cds_wfcq_tail *tail,
+		int force)
+{
+	enum cds_wfcq_ret splice_ret;
+	int lazy;
+
+	/*
+	 * Lazy callbacks join the normal priority ones, ahead of
+	 * them, before the splice orders the batch by priority.
+	 */
+	lazy = call_rcu_lazy_take(crdp,
+		cds_wfcq_prio_head(&crdp->cbs, CDS_WFCQ_PRIO_NORMAL),
+		cds_wfcq_prio_tail(&crdp->cbs, CDS_WFCQ_PRIO_NORMAL),
+		force || !cds_wfcq_prio_empty(&crdp->cbs));
+	splice_ret = __cds_wfcq_prio_splice_blocking(head, tail, &crdp->cbs);
+	assert(splice_ret != CDS_WFCQ_RET_WOULDBLOCK);
+	return lazy || splice_ret != CDS_WFCQ_RET_SRC_EMPTY;
+}
+
+/* This is the code run by each call_rcu thread. */
+
+static void *call_rcu_thread(void *arg)
+{
+	unsigned long cbcount;
 	struct call_rcu_data *crdp = (struct call_rcu_data *) arg;
 	int rt = !!(uatomic_read(&crdp->flags) & URCU_CALL_RCU_RT);
+	int steal = !!(uatomic_read(&crdp->flags) & URCU_CALL_RCU_STEAL);
+	uint64_t idle_start_ms = 0;
+	/*
+	 * Next batch: callbacks queued during the grace period of the
+	 * current one, taken before it is invoked along with next_cookie.
+	 */
+	struct cds_wfcq_head next_head;
+	struct cds_wfcq_tail next_tail;
+	unsigned long next_cookie = 0;
 
 	if (set_thread_cpu_affinity(crdp))
 		urcu_die(errno);
@@ -324,21 +1417,27 @@ static void *call_rcu_thread(void *arg)
 	rcu_register_thread();
 
 	URCU_TLS(thread_call_rcu_data) = crdp;
+	URCU_TLS(thread_call_rcu_worker) = 1;
 	if (!rt) {
 		uatomic_dec(&crdp->futex);
 		/* Decrement futex before reading call_rcu list */
 		cmm_smp_mb();
 	}
+	cds_wfcq_init(&next_head, &next_tail);
 	for (;;) {
 		struct cds_wfcq_head cbs_tmp_head;
 		struct cds_wfcq_tail cbs_tmp_tail;
 		struct cds_wfcq_node *cbs, *cbs_tmp_n;
-		enum cds_wfcq_ret splice_ret;
+		unsigned long cookie;
+		unsigned int nr_helpers;
+		int taken, pending;
 
 		if (set_thread_cpu_affinity(crdp))
 			urcu_die(errno);
 
-		if (uatomic_read(&crdp->flags) & URCU_CALL_RCU_PAUSE) {
+		/* A next batch taken before the pause request comes first. */
+		if ((uatomic_read(&crdp->flags) & URCU_CALL_RCU_PAUSE)
+				&& cds_wfcq_empty(&next_head, &next_tail)) {
 			/*
 			 * Pause requested. Become quiescent: remove
 			 * ourself from all global lists, and don't
@@ -356,32 +1455,88 @@ static void *call_rcu_thread(void *arg)
 		}
 
 		cds_wfcq_init(&cbs_tmp_head, &cbs_tmp_tail);
-		splice_ret = __cds_wfcq_splice_blocking(&cbs_tmp_head,
-			&cbs_tmp_tail, &crdp->cbs_head, &crdp->cbs_tail);
-		assert(splice_ret != CDS_WFCQ_RET_WOULDBLOCK);
-		assert(splice_ret != CDS_WFCQ_RET_DEST_NON_EMPTY);
-		if (splice_ret != CDS_WFCQ_RET_SRC_EMPTY) {
-			synchronize_rcu();
+		pending = !cds_wfcq_empty(&next_head, &next_tail);
+		if (pending)
+			(void) __cds_wfcq_splice_blocking(&cbs_tmp_head,
+				&cbs_tmp_tail, &next_head, &next_tail);
+		taken = call_rcu_take_cbs(crdp, &cbs_tmp_head, &cbs_tmp_tail,
+				pending);
+		(void) uatomic_cmpxchg(&crdp->reclaim,
+			CALL_RCU_RECLAIM_REQUESTED, CALL_RCU_RECLAIM_ON);
+		if (pending || taken) {
+			idle_start_ms = 0;
+			/* The hurried callbacks are in this batch. */
+			uatomic_set(&crdp->urgent, 0);
+			/*
+			 * A cookie taken after the splice covers the whole
+			 * batch. Skip our own grace period if another one
+			 * has elapsed since, which may happen to a next batch
+			 * while the previous one was invoked.
+			 */
+			cookie = taken ? get_state_synchronize_rcu() : next_cookie;
+			if (poll_state_synchronize_rcu(cookie))
+				CMM_STORE_SHARED(crdp->nr_gp_skipped,
+					crdp->nr_gp_skipped + 1);
+			else
+				call_rcu_synchronize(crdp);
+			if (!(uatomic_read(&crdp->flags)
+					& (URCU_CALL_RCU_STOP | URCU_CALL_RCU_PAUSE))
+					&& call_rcu_take_cbs(crdp, &next_head,
+						&next_tail, 0))
+				next_cookie = get_state_synchronize_rcu();
+			urcu_tp1(call_rcu_batch_start, crdp);
 			cbcount = 0;
-			__cds_wfcq_for_each_blocking_safe(&cbs_tmp_head,
-					&cbs_tmp_tail, cbs, cbs_tmp_n) {
-				struct rcu_head *rhp;
-
-				rhp = caa_container_of(cbs,
-					struct rcu_head, next);
-				rhp->func(rhp);
-				cbcount++;
+			nr_helpers = call_rcu_nr_batch_helpers(crdp);
+			if (nr_helpers) {
+				cbcount = call_rcu_invoke_parallel(crdp,
+					&cbs_tmp_head, &cbs_tmp_tail,
+					nr_helpers);
+			} else if (steal) {
+				(void) __cds_wfcq_splice_blocking(
+					&crdp->ready_head, &crdp->ready_tail,
+					&cbs_tmp_head, &cbs_tmp_tail);
+				cbcount = call_rcu_invoke_ready(crdp);
+			} else {
+				__cds_wfcq_for_each_blocking_safe(&cbs_tmp_head,
+						&cbs_tmp_tail, cbs, cbs_tmp_n) {
+					struct rcu_head *rhp;
+
+					rhp = caa_container_of(cbs,
+						struct rcu_head, next);
+					call_rcu_invoke(rhp);
+					cbcount++;
+				}
+				call_rcu_qlen_sub(crdp, cbcount);
 			}
-			uatomic_sub(&crdp->qlen, cbcount);
+			CMM_STORE_SHARED(crdp->nr_invoked,
+				crdp->nr_invoked + cbcount);
+			CMM_STORE_SHARED(crdp->nr_batches,
+				crdp->nr_batches + 1);
+			if (cbcount > crdp->batch_max)
+				CMM_STORE_SHARED(crdp->batch_max, cbcount);
+			urcu_tp2(call_rcu_batch_end, crdp, cbcount);
 		}
-		if (uatomic_read(&crdp->flags) & URCU_CALL_RCU_STOP)
+		call_rcu_reclaim_update(crdp);
+		pending = !cds_wfcq_empty(&next_head, &next_tail);
+		if ((uatomic_read(&crdp->flags) & URCU_CALL_RCU_STOP) && !pending)
 			break;
+		pending |= !cds_wfcq_prio_empty(&crdp->cbs);
+		if (steal && !pending) {
+			while (call_rcu_steal(crdp))
+				;
+		}
 		rcu_thread_offline();
 		if (!rt) {
-			if (cds_wfcq_empty(&crdp->cbs_head,
-					&crdp->cbs_tail)) {
+			/*
+			 * Callbacks queued while spinning are taken without
+			 * a wake-up, sparing call_rcu() the FUTEX_WAKE.
+			 */
+			if (!pending && !urcu_consumer_spin(&crdp->futex,
+					&crdp->spin_attempts,
+					call_rcu_has_cbs, crdp)) {
 				call_rcu_wait(crdp);
-				(void) poll(NULL, 0, 10);
+				call_rcu_delay(crdp,
+					call_rcu_next_delay(crdp, 0));
 				uatomic_dec(&crdp->futex);
 				/*
 				 * Decrement futex before reading
@@ -389,10 +1544,16 @@ static void *call_rcu_thread(void *arg)
 				 */
 				cmm_smp_mb();
 			} else {
-				(void) poll(NULL, 0, 10);
+				call_rcu_delay(crdp,
+					call_rcu_next_delay(crdp, 1));
 			}
+		} else if (!pending && call_rcu_rt_idle(&idle_start_ms)) {
+			call_rcu_park(crdp);
+			idle_start_ms = 0;
+		} else if (crdp->poll_interval_us) {
+			call_rcu_poll(crdp);
 		} else {
-			(void) poll(NULL, 0, 10);
+			call_rcu_delay(crdp, call_rcu_next_delay(crdp, pending));
 		}
 		rcu_thread_online();
 	}
@@ -408,35 +1569,124 @@ static void *call_rcu_thread(void *arg)
 	return NULL;
 }
 
+/*
+ * Create the call_rcu thread of crdp, with the scheduling policy and
+ * stack size of attr. Returns 0 or an error number.
+ */
+static int call_rcu_thread_create(struct call_rcu_data *crdp,
+		const struct call_rcu_attr *attr)
+{
+	struct sched_param param;
+	pthread_attr_t thread_attr;
+	int ret;
+
+	if (!attr || (attr->sched_policy == SCHED_OTHER && !attr->stack_size))
+		return pthread_create(&crdp->tid, NULL, call_rcu_thread, crdp);
+	ret = pthread_attr_init(&thread_attr);
+	if (ret)
+		return ret;
+	if (attr->stack_size) {
+		ret = pthread_attr_setstacksize(&thread_attr, attr->stack_size);
+		if (ret)
+			goto end;
+	}
+	if (attr->sched_policy != SCHED_OTHER) {
+		memset(&param, 0, sizeof(param));
+		param.sched_priority = attr->sched_priority;
+		ret = pthread_attr_setinheritsched(&thread_attr,
+				PTHREAD_EXPLICIT_SCHED);
+		if (!ret)
+			ret = pthread_attr_setschedpolicy(&thread_attr,
+					attr->sched_policy);
+		if (!ret)
+			ret = pthread_attr_setschedparam(&thread_attr, &param);
+		if (ret)
+			goto end;
+	}
+	ret = pthread_create(&crdp->tid, &thread_attr, call_rcu_thread, crdp);
+end:
+	(void) pthread_attr_destroy(&thread_attr);
+	return ret;
+}
+
 /*
  * Create both a call_rcu thread and the corresponding call_rcu_data
  * structure, linking the structure in as specified.  Caller must hold
- * call_rcu_mutex.
+ * call_rcu_mutex. Returns 0, or an error number if the thread cannot be
+ * created with the attributes of a non-NULL attr. Other errors are
+ * fatal.
  */
 
-static void call_rcu_data_init(struct call_rcu_data **crdpp,
+static int call_rcu_data_init(struct call_rcu_data **crdpp,
 			       unsigned long flags,
-			       int cpu_affinity)
+			       int cpu_affinity,
+			       const struct call_rcu_attr *attr)
 {
-	struct call_rcu_data *crdp;
-	int ret;
+	struct call_rcu_data *crdp, *pos;
+	int nr_crdps, ret;
 
-	crdp = malloc(sizeof(*crdp));
+	crdp = caa_cache_line_alloc(sizeof(*crdp));
 	if (crdp == NULL)
 		urcu_die(errno);
 	memset(crdp, '\0', sizeof(*crdp));
-	cds_wfcq_init(&crdp->cbs_head, &crdp->cbs_tail);
+	cds_wfcq_prio_init(&crdp->cbs);
+	cds_wfcq_init(&crdp->ready_head, &crdp->ready_tail);
+	cds_wfcq_init(&crdp->lazy_head, &crdp->lazy_tail);
+	crdp->numa_node = urcu_numa_node_of_cpu(cpu_affinity);
 	crdp->qlen = 0;
 	crdp->futex = 0;
+	crdp->spin_attempts = urcu_consumer_spin_init();
 	crdp->flags = flags;
 	cds_list_add(&crdp->list, &call_rcu_data_list);
+	nr_crdps = 0;
+	cds_list_for_each_entry(pos, &call_rcu_data_list, list)
+		nr_crdps++;
+	/* Barriers then wait for all of them without allocating. */
+	call_rcu_completion_reserve(nr_crdps);
 	crdp->cpu_affinity = cpu_affinity;
 	crdp->gp_count = 0;
+	call_rcu_data_set_delays(crdp, attr);
+	crdp->lazy_delay_ms = CALL_RCU_DEFAULT_LAZY_DELAY_MS;
+	crdp->lazy_qlen_max = CALL_RCU_DEFAULT_LAZY_QLEN_MAX;
+	crdp->parallel_threshold = CALL_RCU_DEFAULT_PARALLEL_THRESHOLD;
+	crdp->limit_wait_ms = CALL_RCU_DEFAULT_LIMIT_WAIT_MS;
+	if (attr) {
+		crdp->qlen_high_watermark = attr->qlen_high_watermark;
+		crdp->qlen_limit = attr->qlen_limit;
+		if (attr->limit_wait_ms)
+			crdp->limit_wait_ms = attr->limit_wait_ms;
+		if (attr->lazy_delay_ms)
+			crdp->lazy_delay_ms = attr->lazy_delay_ms;
+		if (attr->lazy_qlen_max)
+			crdp->lazy_qlen_max = attr->lazy_qlen_max;
+		crdp->poll_interval_us = attr->poll_interval_us;
+		if (attr->parallel_threshold)
+			crdp->parallel_threshold = attr->parallel_threshold;
+		crdp->nr_helpers = caa_min(attr->nr_helpers,
+			(unsigned int) CALL_RCU_HELPERS_MAX);
+#ifdef HAVE_SCHED_SETAFFINITY
+		if (attr->cpuset && attr->cpuset_size) {
+			crdp->cpuset_size = max_t(size_t, attr->cpuset_size,
+					sizeof(cpu_set_t));
+			crdp->cpuset = calloc(1, crdp->cpuset_size);
+			if (!crdp->cpuset)
+				urcu_die(errno);
+			memcpy(crdp->cpuset, attr->cpuset, attr->cpuset_size);
+		}
+#endif
+	}
 	cmm_smp_mb();  /* Structure initialized before pointer is planted. */
 	*crdpp = crdp;
-	ret = pthread_create(&crdp->tid, NULL, call_rcu_thread, crdp);
-	if (ret)
-		urcu_die(ret);
+	ret = call_rcu_thread_create(crdp, attr);
+	if (ret) {
+		if (!attr)
+			urcu_die(ret);
+		*crdpp = NULL;
+		cds_list_del(&crdp->list);
+		free(crdp->cpuset);
+		free(crdp);
+	}
+	return ret;
 }
 
 /*
@@ -485,11 +1735,15 @@ pthread_t alias_get_call_rcu_thread();
  */
 
 static struct call_rcu_data *__create_call_rcu_data(unsigned long flags,
-						    int cpu_affinity)
+						    int cpu_affinity,
+						    const struct call_rcu_attr *attr)
 {
 	struct call_rcu_data *crdp;
+	int ret;
 
-	call_rcu_data_init(&crdp, flags, cpu_affinity);
+	ret = call_rcu_data_init(&crdp, flags, cpu_affinity, attr);
+	if (ret)
+		errno = ret;
 	return crdp;
 }
 
@@ -501,7 +1755,25 @@ struct call_rcu_data *create_call_rcu_data(unsigned long flags,
 	struct call_rcu_data *crdp;
 
 	call_rcu_lock(&call_rcu_mutex);
-	crdp = __create_call_rcu_data(flags, cpu_affinity);
+	crdp = __create_call_rcu_data(flags, cpu_affinity, NULL);
+	call_rcu_unlock(&call_rcu_mutex);
+	return crdp;
+}
+
+/*
+ * Same as create_call_rcu_data(), with a batching policy and thread
+ * attributes. A NULL attr, or zeroed fields, select the defaults.
+ * Returns NULL with errno set if the thread cannot be created with the
+ * attributes of attr, e.g. EPERM for a real-time scheduling policy
+ * without the privilege to use it.
+ */
+struct call_rcu_data *create_call_rcu_data_attr(unsigned long flags,
+		int cpu_affinity, const struct call_rcu_attr *attr)
+{
+	struct call_rcu_data *crdp;
+
+	call_rcu_lock(&call_rcu_mutex);
+	crdp = __create_call_rcu_data(flags, cpu_affinity, attr);
 	call_rcu_unlock(&call_rcu_mutex);
 	return crdp;
 }
@@ -554,6 +1826,23 @@ int set_cpu_call_rcu_data(int cpu, struct call_rcu_data *crdp)
 URCU_ATTR_ALIAS(urcu_stringify(set_cpu_call_rcu_data))
 int alias_set_cpu_call_rcu_data();
 
+/*
+ * Move the callbacks inherited by a fork child to crdp, in a single
+ * batch. Called with call_rcu_mutex held.
+ */
+static void call_rcu_adopt_fork_orphans(struct call_rcu_data *crdp)
+{
+	__cds_wfcq_splice_blocking(
+		cds_wfcq_prio_head(&crdp->cbs, CDS_WFCQ_PRIO_NORMAL),
+		cds_wfcq_prio_tail(&crdp->cbs, CDS_WFCQ_PRIO_NORMAL),
+		&fork_orphans.head, &fork_orphans.tail);
+	uatomic_add(&crdp->qlen, fork_orphans.qlen);
+	fork_orphans.qlen = 0;
+	cds_wfcq_destroy(&fork_orphans.head, &fork_orphans.tail);
+	uatomic_set(&fork_orphans.pending, 0);
+	wake_call_rcu_thread(crdp);
+}
+
 /*
  * Return a pointer to the default call_rcu_data structure, creating
  * one if need be.  Because we never free call_rcu_data structures,
@@ -569,7 +1858,9 @@ struct call_rcu_data *get_default_call_rcu_data(void)
 		call_rcu_unlock(&call_rcu_mutex);
 		return default_call_rcu_data;
 	}
-	call_rcu_data_init(&default_call_rcu_data, 0, -1);
+	(void) call_rcu_data_init(&default_call_rcu_data, 0, -1, NULL);
+	if (fork_orphans.pending)
+		call_rcu_adopt_fork_orphans(default_call_rcu_data);
 	call_rcu_unlock(&call_rcu_mutex);
 	return default_call_rcu_data;
 }
@@ -602,6 +1893,57 @@ struct call_rcu_data *get_call_rcu_data(void)
 
 	return get_default_call_rcu_data();
 }
+
+/*
+ * NUMA node of the memory regions of the last objects routed by this
+ * thread, as one get_mempolicy() call per call_rcu() would cost more
+ * than the remote free it saves. Regions of 2MB are assumed to be on
+ * a single node, which holds for huge pages and is otherwise likely
+ * for allocator arenas: a wrong node only costs locality.
+ */
+#define NUMA_NODE_CACHE_SIZE	64
+#define NUMA_NODE_CACHE_SHIFT	21
+
+struct numa_node_cache {
+	uintptr_t region[NUMA_NODE_CACHE_SIZE];	/* region + 1, 0 if empty */
+	int node[NUMA_NODE_CACHE_SIZE];
+};
+
+static DEFINE_URCU_TLS(struct numa_node_cache, thread_numa_node_cache);
+
+static int numa_node_of_object(void *obj)
+{
+	struct numa_node_cache *cache = &URCU_TLS(thread_numa_node_cache);
+	uintptr_t region = ((uintptr_t) obj >> NUMA_NODE_CACHE_SHIFT) + 1;
+	unsigned int i = region % NUMA_NODE_CACHE_SIZE;
+
+	if (caa_unlikely(cache->region[i] != region)) {
+		cache->node[i] = urcu_numa_node_of_addr(obj);
+		cache->region[i] = region;
+	}
+	return cache->node[i];
+}
+
+/*
+ * Return the call_rcu_data for the callback of head: the one of
+ * get_call_rcu_data(), unless it has the URCU_CALL_RCU_NUMA flag and
+ * head is on the memory of another node which has per-CPU
+ * call_rcu_data. Same protection as get_call_rcu_data().
+ */
+static struct call_rcu_data *get_object_call_rcu_data(struct rcu_head *head)
+{
+	struct call_rcu_data *crdp, *node_crdp;
+	int node;
+
+	crdp = get_call_rcu_data();
+	if (caa_likely(!(uatomic_read(&crdp->flags) & URCU_CALL_RCU_NUMA)))
+		return crdp;
+	node = numa_node_of_object(head);
+	if (node < 0 || node == crdp->numa_node)
+		return crdp;
+	node_crdp = get_node_call_rcu_data(node);
+	return node_crdp ? node_crdp : crdp;
+}
 URCU_ATTR_ALIAS(urcu_stringify(get_call_rcu_data))
 struct call_rcu_data *alias_get_call_rcu_data();
 
@@ -642,14 +1984,58 @@ void alias_set_thread_call_rcu_data();
  * threads.
  */
 
+#if defined(HAVE_SCHED_SETAFFINITY) && SCHED_SETAFFINITY_ARGS == 3 \
+	&& defined(CPU_ALLOC)
+/*
+ * Return an array of maxcpus flags telling which CPUs the process may
+ * run on, as restricted by its affinity, its cpuset cgroup and CPU
+ * hotplug, or NULL if unknown.
+ */
+static unsigned char *alloc_allowed_cpus(void)
+{
+	unsigned char *allowed;
+	cpu_set_t *set;
+	size_t size;
+	int cpu;
+
+	set = CPU_ALLOC(maxcpus);
+	if (!set)
+		return NULL;
+	size = CPU_ALLOC_SIZE(maxcpus);
+	allowed = malloc(maxcpus);
+	if (allowed && sched_getaffinity(getpid(), size, set)) {
+		free(allowed);
+		allowed = NULL;
+	}
+	for (cpu = 0; allowed && cpu < maxcpus; cpu++)
+		allowed[cpu] = !!CPU_ISSET_S(cpu, size, set);
+	CPU_FREE(set);
+	return allowed;
+}
+#else
+static unsigned char *alloc_allowed_cpus(void)
+{
+	return NULL;
+}
+#endif
+
+static void free_cpu_call_rcu_data_except(const unsigned char *keep);
+
+/*
+ * Create a call_rcu thread for each CPU the process may run on, and
+ * free those of the CPUs it may not run on anymore. Meant to be called
+ * again when the allowed CPUs change.
+ */
 int create_all_cpu_call_rcu_data(unsigned long flags)
 {
 	int i;
 	struct call_rcu_data *crdp;
-	int ret;
+	unsigned char *allowed;
+	int ret = 0, nr_disallowed = 0;
 
 	call_rcu_lock(&call_rcu_mutex);
 	alloc_cpu_call_rcu_data();
+	alloc_call_rcu_numa_map();
 	call_rcu_unlock(&call_rcu_mutex);
 	if (maxcpus <= 0) {
 		errno = EINVAL;
@@ -659,30 +2045,44 @@ int create_all_cpu_call_rcu_data(unsigned long flags)
 		errno = ENOMEM;
 		return -ENOMEM;
 	}
+	allowed = alloc_allowed_cpus();
 	for (i = 0; i < maxcpus; i++) {
 		call_rcu_lock(&call_rcu_mutex);
 		if (get_cpu_call_rcu_data(i)) {
+			if (allowed && !allowed[i])
+				nr_disallowed++;
+			call_rcu_unlock(&call_rcu_mutex);
+			continue;
+		}
+		if (allowed && !allowed[i]) {
 			call_rcu_unlock(&call_rcu_mutex);
 			continue;
 		}
-		crdp = __create_call_rcu_data(flags, i);
+		crdp = __create_call_rcu_data(flags, i, NULL);
 		if (crdp == NULL) {
 			call_rcu_unlock(&call_rcu_mutex);
 			errno = ENOMEM;
-			return -ENOMEM;
+			ret = -ENOMEM;
+			goto end;
 		}
 		call_rcu_unlock(&call_rcu_mutex);
 		if ((ret = set_cpu_call_rcu_data(i, crdp)) != 0) {
 			call_rcu_data_free(crdp);
 
 			/* it has been created by other thread */
-			if (ret == -EEXIST)
+			if (ret == -EEXIST) {
+				ret = 0;
 				continue;
+			}
 
-			return ret;
+			goto end;
 		}
 	}
-	return 0;
+	if (nr_disallowed)
+		free_cpu_call_rcu_data_except(allowed);
+end:
+	free(allowed);
+	return ret;
 }
 URCU_ATTR_ALIAS(urcu_stringify(create_all_cpu_call_rcu_data))
 int alias_create_all_cpu_call_rcu_data();
@@ -693,19 +2093,204 @@ int alias_create_all_cpu_call_rcu_data();
  */
 static void wake_call_rcu_thread(struct call_rcu_data *crdp)
 {
-	if (!(_CMM_LOAD_SHARED(crdp->flags) & URCU_CALL_RCU_RT))
+	if (!(_CMM_LOAD_SHARED(crdp->flags) & URCU_CALL_RCU_RT)) {
 		call_rcu_wake_up(crdp);
+	} else {
+		/* Paired with the heavy fence of call_rcu_park(). */
+		cmm_asymmetric_fence_light();
+		call_rcu_wake_up_sleeping(crdp);
+	}
+}
+
+static void _call_rcu_prio(struct rcu_head *head,
+		void (*func)(struct rcu_head *head),
+		struct call_rcu_data *crdp, unsigned int prio)
+{
+	unsigned long qlen;
+
+	cds_wfcq_node_init(&head->next);
+	head->func = func;
+	cds_wfcq_prio_enqueue(&crdp->cbs, &head->next, prio);
+	qlen = uatomic_add_return(&crdp->qlen, 1);
+	urcu_tp4(call_rcu_enqueue, crdp, head, func, qlen);
+	if (caa_unlikely(qlen == crdp->qlen_high_watermark))
+		call_rcu_wake_up_delay(crdp);
+	else if (prio != CALL_RCU_PRIO_NORMAL)
+		call_rcu_hurry(crdp);
+	wake_call_rcu_thread(crdp);
 }
 
 static void _call_rcu(struct rcu_head *head,
 		      void (*func)(struct rcu_head *head),
 		      struct call_rcu_data *crdp)
 {
+	_call_rcu_prio(head, func, crdp, CALL_RCU_PRIO_NORMAL);
+}
+
+/*
+ * Queue a lazy callback. The call_rcu thread is only woken up when the
+ * lazy queue becomes non-empty, to arm its timeout, and when it reaches
+ * lazy_qlen_max.
+ */
+static void _call_rcu_lazy(struct rcu_head *head,
+		void (*func)(struct rcu_head *head),
+		struct call_rcu_data *crdp)
+{
+	unsigned long qlen, lazy_qlen;
+	int was_empty;
+
 	cds_wfcq_node_init(&head->next);
 	head->func = func;
-	cds_wfcq_enqueue(&crdp->cbs_head, &crdp->cbs_tail, &head->next);
-	uatomic_inc(&crdp->qlen);
+	was_empty = !cds_wfcq_enqueue(&crdp->lazy_head, &crdp->lazy_tail,
+			&head->next);
+	if (was_empty)
+		CMM_STORE_SHARED(crdp->lazy_start_ms, call_rcu_now_ms());
+	qlen = uatomic_add_return(&crdp->qlen, 1);
+	lazy_qlen = uatomic_add_return(&crdp->lazy_qlen, 1);
+	urcu_tp4(call_rcu_enqueue, crdp, head, func, qlen);
+	if (caa_unlikely(qlen == crdp->qlen_high_watermark))
+		call_rcu_wake_up_delay(crdp);
+	if (was_empty || lazy_qlen == crdp->lazy_qlen_max)
+		wake_call_rcu_thread(crdp);
+}
+
+/*
+ * Append the callbacks of batch to the queue of their call_rcu_data with
+ * a single enqueue. Caller must hold batch->lock.
+ */
+static void call_rcu_batch_flush(struct call_rcu_batch *batch)
+{
+	struct call_rcu_data *crdp = batch->crdp;
+	unsigned long qlen;
+
+	if (!batch->nr)
+		return;
+	cds_wfcq_enqueue_batch(
+			cds_wfcq_prio_head(&crdp->cbs, CDS_WFCQ_PRIO_NORMAL),
+			cds_wfcq_prio_tail(&crdp->cbs, CDS_WFCQ_PRIO_NORMAL),
+			batch->head, batch->tail);
+	qlen = uatomic_add_return(&crdp->qlen, batch->nr);
+	if (caa_unlikely(crdp->qlen_high_watermark
+			&& qlen >= crdp->qlen_high_watermark
+			&& qlen - batch->nr < crdp->qlen_high_watermark))
+		call_rcu_wake_up_delay(crdp);
 	wake_call_rcu_thread(crdp);
+	batch->head = batch->tail = NULL;
+	batch->nr = 0;
+}
+
+static void call_rcu_batch_add(struct call_rcu_batch *batch,
+		struct rcu_head *head, void (*func)(struct rcu_head *head),
+		struct call_rcu_data *crdp)
+{
+	cds_wfcq_node_init(&head->next);
+	head->func = func;
+	call_rcu_lock(&batch->lock);
+	if (batch->crdp != crdp) {
+		call_rcu_batch_flush(batch);
+		batch->crdp = crdp;
+	}
+	if (batch->tail)
+		batch->tail->next = &head->next;
+	else
+		batch->head = &head->next;
+	batch->tail = &head->next;
+	if (++batch->nr >= batch->nr_max)
+		call_rcu_batch_flush(batch);
+	call_rcu_unlock(&batch->lock);
+}
+
+/*
+ * Flush the callback batches of all threads targeting crdp, or all
+ * batches if crdp is NULL. Caller must hold call_rcu_mutex.
+ */
+static void call_rcu_batch_flush_all(struct call_rcu_data *crdp)
+{
+	struct call_rcu_batch *batch;
+
+	cds_list_for_each_entry(batch, &call_rcu_batch_list, list) {
+		call_rcu_lock(&batch->lock);
+		if (!crdp || batch->crdp == crdp)
+			call_rcu_batch_flush(batch);
+		call_rcu_unlock(&batch->lock);
+	}
+}
+
+static int call_rcu_over_limit(struct call_rcu_data *crdp)
+{
+	unsigned long limit = CMM_LOAD_SHARED(crdp->qlen_limit);
+
+	return limit && uatomic_read(&crdp->qlen) >= limit;
+}
+
+/*
+ * Return the call_rcu_data to queue head on, that of NUMA node if node
+ * is not negative, with the read-side lock held.
+ *
+ * Producers finding it over its qlen_limit first switch it to reclaim
+ * mode, which expedites its batches. They then wait for its backlog to
+ * drop below the limit, for at most its limit_wait_ms, outside of the
+ * read-side critical section so as not to hold the grace period back.
+ * Callers within a read-side critical section, which includes online
+ * QSBR threads, and call_rcu threads do not wait. Returns NULL, with
+ * the lock released, if nowait and over the limit.
+ */
+static struct call_rcu_data *call_rcu_enter(struct rcu_head *head,
+		int node, int nowait)
+{
+	struct call_rcu_data *crdp;
+	struct timespec timeout;
+	uint64_t deadline = 0, now;
+	int32_t seq;
+	int wait, over;
+
+	wait = !nowait && !_rcu_read_ongoing()
+		&& !URCU_TLS(thread_call_rcu_worker);
+	for (;;) {
+		_rcu_read_lock();
+		crdp = NULL;
+		if (node >= 0)
+			crdp = get_node_call_rcu_data(node);
+		if (!crdp)
+			crdp = get_object_call_rcu_data(head);
+		if (caa_likely(!call_rcu_over_limit(crdp)))
+			return crdp;
+		if (uatomic_read(&crdp->reclaim) == CALL_RCU_RECLAIM_OFF) {
+			uatomic_set(&crdp->reclaim, CALL_RCU_RECLAIM_REQUESTED);
+			call_rcu_hurry(crdp);
+			wake_call_rcu_thread(crdp);
+		}
+		if (nowait) {
+			uatomic_inc(&crdp->nr_rejected);
+			_rcu_read_unlock();
+			return NULL;
+		}
+		if (!wait)
+			return crdp;
+		now = call_rcu_now_us();
+		if (!deadline) {
+			deadline = now + (uint64_t) 1000
+				* CMM_LOAD_SHARED(crdp->limit_wait_ms);
+			uatomic_inc(&crdp->nr_throttled);
+		}
+		if (now >= deadline)
+			return crdp;
+		uatomic_inc(&call_rcu_limit_waiters);
+		/* Write call_rcu_limit_waiters before reading qlen. */
+		cmm_smp_mb();
+		seq = uatomic_read(&call_rcu_limit_futex);
+		cmm_smp_mb();
+		over = call_rcu_over_limit(crdp);
+		_rcu_read_unlock();
+		if (over) {
+			timeout.tv_sec = (deadline - now) / 1000000;
+			timeout.tv_nsec = ((deadline - now) % 1000000) * 1000L;
+			(void) futex_async(&call_rcu_limit_futex,
+					FUTEX_WAIT_PRIVATE, seq, &timeout,
+					NULL, 0);
+		}
+		uatomic_dec(&call_rcu_limit_waiters);
+	}
 }
 
 /*
@@ -727,213 +2312,1389 @@ void call_rcu(struct rcu_head *head,
 {
 	struct call_rcu_data *crdp;
 
+	struct call_rcu_batch *batch = URCU_TLS(thread_call_rcu_batch);
+
 	/* Holding rcu read-side lock across use of per-cpu crdp */
-	_rcu_read_lock();
-	crdp = get_call_rcu_data();
+	crdp = call_rcu_enter(head, -1, 0);
+	if (batch)
+		call_rcu_batch_add(batch, head, func, crdp);
+	else
+		_call_rcu(head, func, crdp);
+	_rcu_read_unlock();
+}
+URCU_ATTR_ALIAS(urcu_stringify(call_rcu)) void alias_call_rcu();
+
+/*
+ * Same as call_rcu(), but returns -EAGAIN without queuing the callback
+ * if its call_rcu_data has qlen_limit callbacks pending, instead of
+ * waiting for them. Returns 0 otherwise.
+ *
+ * call_rcu_try must be called by registered RCU read-side threads.
+ */
+int call_rcu_try(struct rcu_head *head,
+		void (*func)(struct rcu_head *head))
+{
+	struct call_rcu_data *crdp;
+	struct call_rcu_batch *batch = URCU_TLS(thread_call_rcu_batch);
+
+	/* Holding rcu read-side lock across use of per-cpu crdp */
+	crdp = call_rcu_enter(head, -1, 1);
+	if (!crdp)
+		return -EAGAIN;
+	if (batch)
+		call_rcu_batch_add(batch, head, func, crdp);
+	else
+		_call_rcu(head, func, crdp);
+	_rcu_read_unlock();
+	return 0;
+}
+
+static void call_rcu_sized_cb(struct rcu_head *head)
+{
+	struct rcu_head_sized *sized =
+		caa_container_of(head, struct rcu_head_sized, head);
+
+	uatomic_sub(&call_rcu_pending_bytes, sized->size);
+	sized->func(head);
+}
+
+/*
+ * Same as call_rcu(), accounting size bytes in call_rcu_pending_bytes
+ * of rcu_get_mem_stats() until func is invoked, typically the size of
+ * the object embedding head. func is passed &head->head.
+ *
+ * call_rcu_sized must be called by registered RCU read-side threads.
+ */
+void call_rcu_sized(struct rcu_head_sized *head,
+		void (*func)(struct rcu_head *head), size_t size)
+{
+	head->func = func;
+	head->size = size;
+	uatomic_add(&call_rcu_pending_bytes, size);
+	call_rcu(&head->head, call_rcu_sized_cb);
+}
+
+/*
+ * Schedule a function to be invoked after a following grace period,
+ * before the callbacks of lower priorities of the same batch. Callbacks
+ * of a priority above CALL_RCU_PRIO_NORMAL also have the next batch
+ * start without delay. rcu_barrier() still waits for them.
+ *
+ * call_rcu_prio must be called by registered RCU read-side threads.
+ */
+void call_rcu_prio(struct rcu_head *head,
+		void (*func)(struct rcu_head *head), unsigned int prio)
+{
+	struct call_rcu_data *crdp;
+
+	/* Holding rcu read-side lock across use of per-cpu crdp */
+	crdp = call_rcu_enter(head, -1, 0);
+	_call_rcu_prio(head, func, crdp, prio);
+	_rcu_read_unlock();
+}
+
+/*
+ * Schedule a function to be invoked after a following grace period by
+ * a per-CPU call_rcu thread of NUMA node, e.g. the node which allocated
+ * the object, or as call_rcu() does if node is negative or has no
+ * per-CPU call_rcu_data, see create_all_cpu_call_rcu_data().
+ *
+ * call_rcu_node must be called by registered RCU read-side threads.
+ */
+void call_rcu_node(struct rcu_head *head,
+		void (*func)(struct rcu_head *head), int node)
+{
+	struct call_rcu_data *crdp;
+
+	/* Holding rcu read-side lock across use of per-cpu crdp */
+	crdp = call_rcu_enter(head, node, 0);
 	_call_rcu(head, func, crdp);
 	_rcu_read_unlock();
 }
-URCU_ATTR_ALIAS(urcu_stringify(call_rcu)) void alias_call_rcu();
 
 /*
- * Free up the specified call_rcu_data structure, terminating the
- * associated call_rcu thread.  The caller must have previously
- * removed the call_rcu_data structure from per-thread or per-CPU
- * usage.  For example, set_cpu_call_rcu_data(cpu, NULL) for per-CPU
- * call_rcu_data structures or set_thread_call_rcu_data(NULL) for
- * per-thread call_rcu_data structures.
- *
- * We silently refuse to free up the default call_rcu_data structure
- * because that is where we put any leftover callbacks.  Note that
- * the possibility of self-spawning callbacks makes it impossible
- * to execute all the callbacks in finite time without putting any
- * newly spawned callbacks somewhere else.  The "somewhere else" of
- * last resort is the default call_rcu_data structure.
- *
- * We also silently refuse to free NULL pointers.  This simplifies
- * the calling code.
- *
- * The caller must wait for a grace-period to pass between return from
- * set_cpu_call_rcu_data() and call to call_rcu_data_free() passing the
- * previous call rcu data as argument.
- *
- * Note: introducing __cds_wfcq_splice_blocking() in this function fixed
- * a list corruption bug in the 0.7.x series. The equivalent fix
- * appeared in 0.6.8 for the stable-0.6 branch.
+ * Schedule a function to be invoked after a following grace period,
+ * without hurrying it: lazy callbacks wait for the grace period of
+ * other callbacks of their call_rcu thread, rcu_barrier(), or for the
+ * lazy thresholds of struct call_rcu_attr. Meant for callbacks which
+ * only free memory, to start fewer grace periods; callbacks which
+ * release locks or wake up waiters should use call_rcu().
+ *
+ * call_rcu_lazy must be called by registered RCU read-side threads.
+ */
+void call_rcu_lazy(struct rcu_head *head,
+		void (*func)(struct rcu_head *head))
+{
+	struct call_rcu_data *crdp;
+
+	/* Holding rcu read-side lock across use of per-cpu crdp */
+	crdp = call_rcu_enter(head, -1, 0);
+	_call_rcu_lazy(head, func, crdp);
+	_rcu_read_unlock();
+}
+
+/*
+ * Reclaim classes: objects queued by call_rcu_typed() wait on the
+ * pending queue of their class. The class is armed when its engine_head
+ * is queued with call_rcu(), after moving the pending objects to the
+ * ready queue, so that the grace period of engine_head covers them. Its
+ * callback hands the ready objects over to the class function, and
+ * arms the class again if objects were queued meanwhile. Only the
+ * holder of armed touches the ready queue.
+ */
+static void call_rcu_class_cb(struct rcu_head *head);
+
+static void call_rcu_class_arm(struct call_rcu_class *cls)
+{
+	if (uatomic_read(&cls->armed) || uatomic_cmpxchg(&cls->armed, 0, 1))
+		return;
+	(void) __cds_wfcq_splice_blocking(&cls->ready_head, &cls->ready_tail,
+		&cls->pending_head, &cls->pending_tail);
+	call_rcu(&cls->engine_head, call_rcu_class_cb);
+}
+
+static void call_rcu_class_cb(struct rcu_head *head)
+{
+	struct call_rcu_class *cls =
+		caa_container_of(head, struct call_rcu_class, engine_head);
+	struct cds_wfcq_head list_head;
+	struct cds_wfcq_tail list_tail;
+	struct cds_wfcq_node *node;
+	unsigned long nr = 0;
+
+	cds_wfcq_init(&list_head, &list_tail);
+	(void) __cds_wfcq_splice_blocking(&list_head, &list_tail,
+		&cls->ready_head, &cls->ready_tail);
+	/* Wait for all links: the class function walks them unlocked. */
+	__cds_wfcq_for_each_blocking(&list_head, &list_tail, node)
+		nr++;
+	node = __cds_wfcq_first_blocking(&list_head, &list_tail);
+	if (node)
+		cls->func(caa_container_of(node, struct rcu_head_compact, next));
+	cds_wfcq_destroy(&list_head, &list_tail);
+	uatomic_add(&cls->nr_done, nr);
+	uatomic_set(&cls->armed, 0);
+	/* Write armed before read pending queue */
+	cmm_smp_mb();
+	if (!cds_wfcq_empty(&cls->pending_head, &cls->pending_tail))
+		call_rcu_class_arm(cls);
+}
+
+void call_rcu_class_init(struct call_rcu_class *cls,
+		void (*func)(struct rcu_head_compact *list))
+{
+	memset(cls, 0, sizeof(*cls));
+	cls->func = func;
+	cds_wfcq_init(&cls->pending_head, &cls->pending_tail);
+	cds_wfcq_init(&cls->ready_head, &cls->ready_tail);
+}
+
+/*
+ * Queue an object of a reclaim class, for the class function to reclaim
+ * it after a following grace period. Within a class, objects are
+ * handed over in batches, at most one per grace period.
+ *
+ * call_rcu_typed must be called by registered RCU read-side threads.
+ */
+void call_rcu_typed(struct call_rcu_class *cls,
+		struct rcu_head_compact *head)
+{
+	cds_wfcq_node_init(&head->next);
+	uatomic_inc(&cls->nr_queued);
+	(void) cds_wfcq_enqueue(&cls->pending_head, &cls->pending_tail,
+		&head->next);
+	/* Enqueue before read armed */
+	cmm_smp_mb();
+	call_rcu_class_arm(cls);
+}
+
+static void call_rcu_batch_free(struct call_rcu_batch *batch)
+{
+	int ret;
+
+	ret = pthread_mutex_destroy(&batch->lock);
+	if (ret)
+		urcu_die(ret);
+	free(batch);
+}
+
+/*
+ * Thread exit: flush the batch of the exiting thread and free it. Hold
+ * call_rcu_mutex so the target call_rcu_data cannot be freed meanwhile.
+ */
+static void call_rcu_batch_destroy(void *arg)
+{
+	struct call_rcu_batch *batch = arg;
+
+	if (!batch)
+		return;
+	call_rcu_lock(&call_rcu_mutex);
+	cds_list_del(&batch->list);
+	call_rcu_lock(&batch->lock);
+	call_rcu_batch_flush(batch);
+	call_rcu_unlock(&batch->lock);
+	call_rcu_unlock(&call_rcu_mutex);
+	call_rcu_batch_free(batch);
+}
+
+static void call_rcu_batch_key_create(void)
+{
+	int ret;
+
+	ret = pthread_key_create(&call_rcu_batch_key, call_rcu_batch_destroy);
+	if (ret)
+		urcu_die(ret);
+}
+
+/*
+ * Batch the callbacks queued by call_rcu() from the current thread, and
+ * hand them over to the call_rcu thread nr at a time. A zero nr flushes
+ * the batch and disables batching. Partial batches are handed over by
+ * call_rcu_flush(), rcu_barrier() and when the thread exits.
+ * Returns 0 on success, -ENOMEM if the batch cannot be allocated.
+ */
+int set_thread_call_rcu_batch(unsigned long nr)
+{
+	struct call_rcu_batch *batch = URCU_TLS(thread_call_rcu_batch);
+	int ret;
+
+	(void) pthread_once(&call_rcu_batch_key_once,
+			call_rcu_batch_key_create);
+	if (!nr) {
+		if (!batch)
+			return 0;
+		URCU_TLS(thread_call_rcu_batch) = NULL;
+		ret = pthread_setspecific(call_rcu_batch_key, NULL);
+		if (ret)
+			urcu_die(ret);
+		call_rcu_batch_destroy(batch);
+		return 0;
+	}
+	if (!batch) {
+		batch = calloc(1, sizeof(*batch));
+		if (!batch)
+			return -ENOMEM;
+		ret = pthread_mutex_init(&batch->lock, NULL);
+		if (ret)
+			urcu_die(ret);
+		call_rcu_lock(&call_rcu_mutex);
+		cds_list_add(&batch->list, &call_rcu_batch_list);
+		call_rcu_unlock(&call_rcu_mutex);
+		URCU_TLS(thread_call_rcu_batch) = batch;
+		ret = pthread_setspecific(call_rcu_batch_key, batch);
+		if (ret)
+			urcu_die(ret);
+	}
+	call_rcu_lock(&batch->lock);
+	batch->nr_max = nr;
+	if (batch->nr >= nr)
+		call_rcu_batch_flush(batch);
+	call_rcu_unlock(&batch->lock);
+	return 0;
+}
+
+/*
+ * Hand the callback batch of the current thread over to its call_rcu
+ * thread, if any.
+ */
+void call_rcu_flush(void)
+{
+	struct call_rcu_batch *batch = URCU_TLS(thread_call_rcu_batch);
+
+	if (!batch)
+		return;
+	call_rcu_lock(&batch->lock);
+	call_rcu_batch_flush(batch);
+	call_rcu_unlock(&batch->lock);
+}
+
+static void free_rcu_block_func(struct rcu_head *head)
+{
+	struct free_rcu_block *block =
+		caa_container_of(head, struct free_rcu_block, head);
+	unsigned long i;
+
+	for (i = 0; i < block->nr; i++)
+		block->func(block->ptrs[i]);
+	free(block);
+}
+
+/*
+ * Thread exit: hand the partially filled block of the exiting thread
+ * over to the default call_rcu thread. The thread may not be registered
+ * anymore, so do not use the per-CPU call_rcu_data.
+ */
+static void free_rcu_block_destroy(void *arg)
+{
+	struct free_rcu_block *block = arg;
+
+	if (!block)
+		return;
+	_call_rcu(&block->head, free_rcu_block_func,
+		get_default_call_rcu_data());
+}
+
+static void free_rcu_block_key_create(void)
+{
+	int ret;
+
+	ret = pthread_key_create(&free_rcu_block_key, free_rcu_block_destroy);
+	if (ret)
+		urcu_die(ret);
+}
+
+static void free_rcu_block_set(struct free_rcu_block *block)
+{
+	int ret;
+
+	URCU_TLS(thread_free_rcu_block) = block;
+	ret = pthread_setspecific(free_rcu_block_key, block);
+	if (ret)
+		urcu_die(ret);
+}
+
+/*
+ * Hand the block of the current thread over to call_rcu, if any.
+ */
+void free_rcu_flush(void)
+{
+	struct free_rcu_block *block = URCU_TLS(thread_free_rcu_block);
+
+	if (!block)
+		return;
+	free_rcu_block_set(NULL);
+	call_rcu(&block->head, free_rcu_block_func);
+}
+
+/*
+ * Invoke func on each of the nr pointers after a grace period. Pointers
+ * are copied into per-thread blocks of FREE_RCU_BLOCK_SIZE bytes, and
+ * each block is handed to call_rcu once full, with a single rcu_head.
+ * A partially filled block is handed over by free_rcu_flush(), or when
+ * the thread exits: call free_rcu_flush() before rcu_barrier() to wait
+ * for the pointers queued by the current thread.
+ *
+ * If no block can be allocated, waits for a grace period and invokes
+ * func directly: must not be called from within a read-side critical
+ * section in that case.
+ *
+ * call_rcu_bulk must be called by registered RCU read-side threads.
+ */
+void call_rcu_bulk(void (*func)(void *ptr), void **ptrs, unsigned long nr)
+{
+	struct free_rcu_block *block;
+	unsigned long i;
+
+	(void) pthread_once(&free_rcu_block_key_once,
+			free_rcu_block_key_create);
+	for (i = 0; i < nr; i++) {
+		block = URCU_TLS(thread_free_rcu_block);
+		if (block && block->func != func) {
+			free_rcu_flush();
+			block = NULL;
+		}
+		if (!block) {
+			block = malloc(FREE_RCU_BLOCK_SIZE);
+			if (caa_unlikely(!block)) {
+				synchronize_rcu();
+				for (; i < nr; i++)
+					func(ptrs[i]);
+				return;
+			}
+			block->func = func;
+			block->nr = 0;
+			free_rcu_block_set(block);
+		}
+		block->ptrs[block->nr++] = ptrs[i];
+		if (block->nr == FREE_RCU_BLOCK_NR_PTRS)
+			free_rcu_flush();
+	}
+}
+
+static void free_rcu_free(void *ptr)
+{
+	free(ptr);
+}
+
+/*
+ * free() ptr after a grace period. See call_rcu_bulk().
+ */
+void free_rcu(void *ptr)
+{
+	call_rcu_bulk(free_rcu_free, &ptr, 1);
+}
+
+/*
+ * Grace periods requested through start_poll_synchronize_rcu() are
+ * driven by a single static rcu_head. While it is in flight, its
+ * callback re-queues it until the most recent requested cookie has
+ * been reached, so concurrent requests never need to allocate memory.
+ */
+static struct rcu_head poll_gp_head;
+static int poll_gp_pending;
+static unsigned long poll_gp_cookie;
+
+static void poll_gp_func(struct rcu_head *head);
+
+static void poll_gp_queue(void)
+{
+	if (uatomic_cmpxchg(&poll_gp_pending, 0, 1) == 0)
+		call_rcu(&poll_gp_head, poll_gp_func);
+}
+
+static void poll_gp_func(struct rcu_head *head)
+{
+	if (!poll_state_synchronize_rcu(uatomic_read(&poll_gp_cookie))) {
+		call_rcu(head, poll_gp_func);
+		return;
+	}
+	uatomic_set(&poll_gp_pending, 0);
+	/* Clear pending flag before reading the requested cookie. */
+	cmm_smp_mb();
+	if (!poll_state_synchronize_rcu(uatomic_read(&poll_gp_cookie)))
+		poll_gp_queue();
+}
+
+/*
+ * Return a grace-period cookie as get_state_synchronize_rcu() does,
+ * and make sure a grace period will be started without waiting for it.
+ * The cookie can be checked with poll_state_synchronize_rcu().
+ *
+ * start_poll_synchronize_rcu must be called by registered RCU read-side
+ * threads.
+ */
+unsigned long start_poll_synchronize_rcu(void)
+{
+	unsigned long cookie, old, prev;
+
+	cookie = get_state_synchronize_rcu();
+	old = uatomic_read(&poll_gp_cookie);
+	while (!URCU_GP_SEQ_GE(old, cookie)) {
+		prev = uatomic_cmpxchg(&poll_gp_cookie, old, cookie);
+		if (prev == old)
+			break;
+		old = prev;
+	}
+	/* Publish requested cookie before reading pending flag. */
+	cmm_smp_mb();
+	poll_gp_queue();
+	return cookie;
+}
+
+struct poll_gp_fd_work {
+	struct rcu_head head;
+	int fd;
+};
+
+static void poll_gp_fd_func(struct rcu_head *head)
+{
+	struct poll_gp_fd_work *work =
+		caa_container_of(head, struct poll_gp_fd_work, head);
+	uint64_t one = 1;
+	ssize_t ret;
+
+	do {
+		ret = write(work->fd, &one, sizeof(one));
+	} while (ret < 0 && errno == EINTR);
+	/* EAGAIN: a notification is already pending on the fd. */
+	free(work);
+}
+
+/*
+ * Start a grace period as start_poll_synchronize_rcu() does, and write
+ * the 64-bit integer 1 to fd once it has elapsed, e.g. to an eventfd or
+ * a pipe watched by an event loop. The write is done by a call_rcu
+ * thread: fd should be non-blocking. If cookie is non-NULL, it is set to
+ * a cookie for poll_state_synchronize_rcu(). Returns 0 on success, or
+ * -ENOMEM.
+ *
+ * start_poll_synchronize_rcu_fd must be called by registered RCU
+ * read-side threads.
+ */
+int start_poll_synchronize_rcu_fd(int fd, unsigned long *cookie)
+{
+	struct poll_gp_fd_work *work;
+
+	work = malloc(sizeof(*work));
+	if (!work)
+		return -ENOMEM;
+	work->fd = fd;
+	if (cookie)
+		*cookie = get_state_synchronize_rcu();
+	call_rcu(&work->head, poll_gp_fd_func);
+	return 0;
+}
+
+/*
+ * Free up the specified call_rcu_data structure, terminating the
+ * associated call_rcu thread.  The caller must have previously
+ * removed the call_rcu_data structure from per-thread or per-CPU
+ * usage.  For example, set_cpu_call_rcu_data(cpu, NULL) for per-CPU
+ * call_rcu_data structures or set_thread_call_rcu_data(NULL) for
+ * per-thread call_rcu_data structures.
+ *
+ * We silently refuse to free up the default call_rcu_data structure
+ * because that is where we put any leftover callbacks.  Note that
+ * the possibility of self-spawning callbacks makes it impossible
+ * to execute all the callbacks in finite time without putting any
+ * newly spawned callbacks somewhere else.  The "somewhere else" of
+ * last resort is the default call_rcu_data structure.
+ *
+ * We also silently refuse to free NULL pointers.  This simplifies
+ * the calling code.
+ *
+ * The caller must wait for a grace-period to pass between return from
+ * set_cpu_call_rcu_data() and call to call_rcu_data_free() passing the
+ * previous call rcu data as argument.
+ *
+ * Note: introducing __cds_wfcq_splice_blocking() in this function fixed
+ * a list corruption bug in the 0.7.x series. The equivalent fix
+ * appeared in 0.6.8 for the stable-0.6 branch.
+ */
+void call_rcu_data_free(struct call_rcu_data *crdp)
+{
+	if (crdp == NULL || crdp == default_call_rcu_data) {
+		return;
+	}
+	call_rcu_lock(&call_rcu_mutex);
+	call_rcu_batch_flush_all(crdp);
+	call_rcu_unlock(&call_rcu_mutex);
+	if ((uatomic_read(&crdp->flags) & URCU_CALL_RCU_STOPPED) == 0) {
+		uatomic_or(&crdp->flags, URCU_CALL_RCU_STOP);
+		wake_call_rcu_thread(crdp);
+		while ((uatomic_read(&crdp->flags) & URCU_CALL_RCU_STOPPED) == 0)
+			(void) poll(NULL, 0, 1);
+	}
+	/* Wait for siblings invoking callbacks stolen from crdp. */
+	while (uatomic_read(&crdp->nr_running))
+		(void) poll(NULL, 0, 1);
+	/* The call_rcu thread is stopped: move the lazy callbacks too. */
+	(void) call_rcu_lazy_take(crdp,
+		cds_wfcq_prio_head(&crdp->cbs, CDS_WFCQ_PRIO_NORMAL),
+		cds_wfcq_prio_tail(&crdp->cbs, CDS_WFCQ_PRIO_NORMAL), 1);
+	if (!cds_wfcq_prio_empty(&crdp->cbs)) {
+		/* Create default call rcu data if need be */
+		(void) get_default_call_rcu_data();
+		__cds_wfcq_prio_move_blocking(&default_call_rcu_data->cbs,
+			&crdp->cbs);
+		uatomic_add(&default_call_rcu_data->qlen,
+			    uatomic_read(&crdp->qlen));
+		wake_call_rcu_thread(default_call_rcu_data);
+	}
+
+	call_rcu_lock(&call_rcu_mutex);
+	cds_list_del(&crdp->list);
+	call_rcu_unlock(&call_rcu_mutex);
+
+	free(crdp->cpuset);
+	free(crdp);
+}
+URCU_ATTR_ALIAS(urcu_stringify(call_rcu_data_free))
+void alias_call_rcu_data_free();
+
+/*
+ * Clean up the per-CPU call_rcu threads of the CPUs which are not in
+ * keep, or all of them if keep is NULL.
+ */
+static void free_cpu_call_rcu_data_except(const unsigned char *keep)
+{
+	int cpu;
+	struct call_rcu_data **crdp;
+	static int warned = 0;
+
+	if (maxcpus <= 0)
+		return;
+
+	crdp = malloc(sizeof(*crdp) * maxcpus);
+	if (!crdp) {
+		if (!warned) {
+			fprintf(stderr, "[error] liburcu: unable to allocate per-CPU pointer array\n");
+		}
+		warned = 1;
+		return;
+	}
+
+	for (cpu = 0; cpu < maxcpus; cpu++) {
+		crdp[cpu] = get_cpu_call_rcu_data(cpu);
+		if (keep && keep[cpu])
+			crdp[cpu] = NULL;
+		if (crdp[cpu] == NULL)
+			continue;
+		set_cpu_call_rcu_data(cpu, NULL);
+	}
+	/*
+	 * Wait for call_rcu sites acting as RCU readers of the
+	 * call_rcu_data to become quiescent.
+	 */
+	synchronize_rcu();
+	for (cpu = 0; cpu < maxcpus; cpu++) {
+		if (crdp[cpu] == NULL)
+			continue;
+		call_rcu_data_free(crdp[cpu]);
+	}
+	free(crdp);
+}
+
+/*
+ * Clean up all the per-CPU call_rcu threads.
+ */
+void free_all_cpu_call_rcu_data(void)
+{
+	free_cpu_call_rcu_data_except(NULL);
+}
+#ifdef RCU_QSBR
+/* ABI6 has a non-namespaced free_all_cpu_call_rcu_data for qsbr */
+#undef free_all_cpu_call_rcu_data
+URCU_ATTR_ALIAS("urcu_qsbr_free_all_cpu_call_rcu_data")
+void free_all_cpu_call_rcu_data();
+#define free_all_cpu_call_rcu_data urcu_qsbr_free_all_cpu_call_rcu_data
+#else
+URCU_ATTR_ALIAS(urcu_stringify(free_all_cpu_call_rcu_data))
+void alias_free_all_cpu_call_rcu_data();
+#endif
+
+static
+void free_completion(struct urcu_ref *ref)
+{
+	struct call_rcu_completion *completion;
+
+	struct call_rcu_completion *victim;
+
+	completion = caa_container_of(ref, struct call_rcu_completion, ref);
+	call_rcu_lock(&call_rcu_completion_mutex);
+	if (call_rcu_completion_pool_len < CALL_RCU_COMPLETION_POOL_MAX) {
+		cds_list_add(&completion->node, &call_rcu_completion_pool);
+		call_rcu_completion_pool_len++;
+		completion = NULL;
+	} else {
+		/* A full pool keeps the largest completions. */
+		cds_list_for_each_entry(victim, &call_rcu_completion_pool,
+				node) {
+			if (victim->nr_works < completion->nr_works) {
+				cds_list_del(&victim->node);
+				cds_list_add(&completion->node,
+					&call_rcu_completion_pool);
+				completion = victim;
+				break;
+			}
+		}
+	}
+	call_rcu_unlock(&call_rcu_completion_mutex);
+	free(completion);
+}
+
+static
+void _rcu_barrier_complete(struct rcu_head *head)
+{
+	struct call_rcu_completion_work *work;
+	struct call_rcu_completion *completion;
+
+	work = caa_container_of(head, struct call_rcu_completion_work, head);
+	completion = work->completion;
+	if (!uatomic_sub_return(&completion->barrier_count, 1))
+		call_rcu_completion_wake_up(completion);
+	urcu_ref_put(&completion->ref, free_completion);
+}
+
+/*
+ * Put the caller in offline state in QSBR. Returns 0 on success, or -1
+ * if called from within a RCU read-side critical section, which is an
+ * error for all barrier primitives.
+ */
+static
+int _rcu_barrier_begin(const char *name, int *was_online)
+{
+	*was_online = _rcu_read_ongoing();
+	if (*was_online)
+		rcu_thread_offline();
+	if (_rcu_read_ongoing()) {
+		static int warned = 0;
+
+		if (!warned) {
+			fprintf(stderr, "[error] liburcu: %s() called from within RCU read-side critical section.\n", name);
+		}
+		warned = 1;
+		return -1;
+	}
+	return 0;
+}
+
+static
+void _rcu_barrier_end(int was_online)
+{
+	if (was_online)
+		rcu_thread_online();
+}
+
+static
+struct call_rcu_completion *_rcu_barrier_completion_alloc(int count)
+{
+	struct call_rcu_completion *completion;
+
+	call_rcu_lock(&call_rcu_completion_mutex);
+	completion = call_rcu_completion_pool_take(count);
+	call_rcu_unlock(&call_rcu_completion_mutex);
+	completion->futex = 0;
+	/* Referenced by the barrier caller and each call_rcu thread. */
+	urcu_ref_set(&completion->ref, count + 1);
+	completion->barrier_count = count;
+	urcu_tp2(rcu_barrier_start, completion, count);
+	return completion;
+}
+
+/*
+ * Use the i-th work item embedded in the completion, not reused before
+ * the completion is released.
+ */
+static
+void _rcu_barrier_queue(struct call_rcu_completion *completion, int i,
+		struct call_rcu_data *crdp)
+{
+	struct call_rcu_completion_work *work = &completion->works[i];
+
+	work->completion = completion;
+	_call_rcu(&work->head, _rcu_barrier_complete, crdp);
+	/* The barrier caller is waiting: do not delay it. */
+	call_rcu_hurry(crdp);
+}
+
+static
+void _rcu_barrier_wait(struct call_rcu_completion *completion)
+{
+	for (;;) {
+		uatomic_dec(&completion->futex);
+		/* Decrement futex before reading barrier_count */
+		cmm_smp_mb();
+		if (!uatomic_read(&completion->barrier_count))
+			break;
+		call_rcu_completion_wait(completion);
+	}
+
+	urcu_tp1(rcu_barrier_end, completion);
+	urcu_ref_put(&completion->ref, free_completion);
+}
+
+/*
+ * Wait for all in-flight call_rcu callbacks to complete execution.
+ *
+ * Concurrent callers share barrier passes: a caller returns once a pass
+ * started after its call has completed. The pass in flight at the time
+ * of the call, if any, started too early; the caller waits for it, and
+ * one of its waiters then leads the next pass for all of them.
+ */
+void rcu_barrier(void)
+{
+	struct call_rcu_data *crdp;
+	struct call_rcu_completion *completion;
+	unsigned long target, pass;
+	int count, i, ret;
+	int was_online;
+
+	if (_rcu_barrier_begin("rcu_barrier", &was_online))
+		goto online;
+
+	/* Wait for the callbacks inherited in lazy fork mode too. */
+	if (uatomic_read(&fork_orphans.pending))
+		(void) get_default_call_rcu_data();
+
+	call_rcu_lock(&call_rcu_mutex);
+	target = rcu_barrier_started + 1;
+	while ((long) (rcu_barrier_completed - target) < 0) {
+		if (rcu_barrier_running) {
+			ret = pthread_cond_wait(&rcu_barrier_cond,
+					&call_rcu_mutex);
+			if (ret)
+				urcu_die(ret);
+			continue;
+		}
+		pass = ++rcu_barrier_started;
+		rcu_barrier_running = 1;
+		call_rcu_batch_flush_all(NULL);
+		count = 0;
+		cds_list_for_each_entry(crdp, &call_rcu_data_list, list)
+			count++;
+
+		completion = _rcu_barrier_completion_alloc(count);
+
+		i = 0;
+		cds_list_for_each_entry(crdp, &call_rcu_data_list, list)
+			_rcu_barrier_queue(completion, i++, crdp);
+		call_rcu_unlock(&call_rcu_mutex);
+
+		/* Wait for them */
+		_rcu_barrier_wait(completion);
+
+		call_rcu_lock(&call_rcu_mutex);
+		rcu_barrier_completed = pass;
+		rcu_barrier_running = 0;
+		ret = pthread_cond_broadcast(&rcu_barrier_cond);
+		if (ret)
+			urcu_die(ret);
+	}
+	call_rcu_unlock(&call_rcu_mutex);
+
+online:
+	_rcu_barrier_end(was_online);
+}
+URCU_ATTR_ALIAS(urcu_stringify(rcu_barrier))
+void alias_rcu_barrier();
+
+/*
+ * Wait for the call_rcu callbacks queued on each of the nr call_rcu_data
+ * of the crdps array prior to this call to complete execution. NULL
+ * entries are ignored. The caller must ensure none of these call_rcu_data
+ * are freed concurrently.
+ */
+void rcu_barrier_crdp_set(struct call_rcu_data **crdps, unsigned long nr)
+{
+	struct call_rcu_completion *completion;
+	unsigned long i;
+	int count = 0;
+	int was_online;
+
+	if (_rcu_barrier_begin("rcu_barrier_crdp_set", &was_online))
+		goto online;
+
+	call_rcu_lock(&call_rcu_mutex);
+	for (i = 0; i < nr; i++) {
+		if (crdps[i])
+			call_rcu_batch_flush_all(crdps[i]);
+	}
+	call_rcu_unlock(&call_rcu_mutex);
+
+	for (i = 0; i < nr; i++) {
+		if (crdps[i])
+			count++;
+	}
+	if (!count)
+		goto online;
+
+	completion = _rcu_barrier_completion_alloc(count);
+	count = 0;
+	for (i = 0; i < nr; i++) {
+		if (crdps[i])
+			_rcu_barrier_queue(completion, count++, crdps[i]);
+	}
+
+	/* Wait for them */
+	_rcu_barrier_wait(completion);
+
+online:
+	_rcu_barrier_end(was_online);
+}
+
+/*
+ * Wait for the objects queued by call_rcu_typed() on cls prior to the
+ * call to be reclaimed. The class may be destroyed afterwards if no
+ * object is queued concurrently. Each iteration waits for one batch of
+ * the class.
+ */
+void rcu_barrier_class(struct call_rcu_class *cls)
+{
+	unsigned long target = uatomic_read(&cls->nr_queued);
+	int done;
+
+	do {
+		done = (long) (uatomic_read(&cls->nr_done) - target) >= 0
+			&& !uatomic_read(&cls->armed);
+		/* Also waits for a class callback clearing armed. */
+		rcu_barrier();
+	} while (!done);
+}
+
+/*
+ * Wait for the call_rcu callbacks queued on crdp prior to this call to
+ * complete execution. Callbacks queued on other call_rcu_data are not
+ * waited for.
+ */
+void rcu_barrier_crdp(struct call_rcu_data *crdp)
+{
+	rcu_barrier_crdp_set(&crdp, 1);
+}
+
+/*
+ * Get a snapshot of the statistics of crdp. The caller must ensure crdp
+ * is not freed concurrently.
+ */
+void call_rcu_data_get_stats(struct call_rcu_data *crdp,
+		struct urcu_call_rcu_stats *stats)
+{
+	stats->qlen = uatomic_read(&crdp->qlen);
+	stats->invoked = CMM_LOAD_SHARED(crdp->nr_invoked);
+	stats->batches = CMM_LOAD_SHARED(crdp->nr_batches);
+	stats->batch_max = CMM_LOAD_SHARED(crdp->batch_max);
+	stats->stolen = CMM_LOAD_SHARED(crdp->nr_stolen);
+	stats->gp_skipped = CMM_LOAD_SHARED(crdp->nr_gp_skipped);
+	stats->throttled = uatomic_read(&crdp->nr_throttled);
+	stats->rejected = uatomic_read(&crdp->nr_rejected);
+}
+
+/*
+ * Sample one callback every period invoked by each thread, 1 for all of
+ * them, and account its duration to its function. 0 disables sampling.
+ */
+void call_rcu_set_func_sample_period(unsigned long period)
+{
+	CMM_STORE_SHARED(call_rcu_func_sample_period, period);
+}
+
+/*
+ * Invoke func with a snapshot of the statistics of each sampled callback
+ * function, then, with a NULL function, of the samples of functions
+ * beyond the capacity of the table, if any. func is invoked with the
+ * statistics mutex held, and must not invoke callbacks.
+ */
+void call_rcu_for_each_func_stats(void (*func)(
+			void (*cb)(struct rcu_head *head),
+			const struct urcu_call_rcu_func_stats *stats,
+			void *priv),
+		void *priv)
+{
+	struct call_rcu_func_entry *entry;
+	unsigned long i;
+
+	call_rcu_lock(&call_rcu_func_stats_mutex);
+	for (i = 0; i < CALL_RCU_FUNC_STATS_SIZE; i++) {
+		entry = &call_rcu_func_stats[i];
+		if (entry->func)
+			func(entry->func, &entry->stats, priv);
+	}
+	if (call_rcu_func_stats_overflow.samples)
+		func(NULL, &call_rcu_func_stats_overflow, priv);
+	call_rcu_unlock(&call_rcu_func_stats_mutex);
+}
+
+/*
+ * Set the producer backpressure of crdp, see struct call_rcu_attr. A
+ * zero qlen_limit disables it, and a zero limit_wait_ms selects the
+ * default wait.
+ */
+void call_rcu_data_set_qlen_limit(struct call_rcu_data *crdp,
+		unsigned long qlen_limit, unsigned int limit_wait_ms)
+{
+	if (!limit_wait_ms)
+		limit_wait_ms = CALL_RCU_DEFAULT_LIMIT_WAIT_MS;
+	CMM_STORE_SHARED(crdp->limit_wait_ms, limit_wait_ms);
+	CMM_STORE_SHARED(crdp->qlen_limit, qlen_limit);
+}
+
+/*
+ * Get a snapshot of the grace-period statistics of the flavor, and of
+ * the statistics of all its call_rcu_data. Statistics of call_rcu_data
+ * freed earlier are not accounted for.
+ */
+void rcu_get_stats(struct urcu_stats *stats)
+{
+	struct call_rcu_data *crdp;
+
+	urcu_stats_snapshot(&gp_stats, stats);
+	urcu_stats_lock_snapshot(&lock_stats.gp, &stats->gp_lock);
+	urcu_stats_lock_snapshot(&lock_stats.registry, &stats->registry_lock);
+	urcu_stats_lock_snapshot(&lock_stats.call_rcu, &stats->call_rcu_lock);
+	urcu_stats_lock_snapshot(&lock_stats.defer, &stats->defer_lock);
+	call_rcu_lock(&call_rcu_mutex);
+	cds_list_for_each_entry(crdp, &call_rcu_data_list, list) {
+		struct urcu_call_rcu_stats crdp_stats;
+
+		call_rcu_data_get_stats(crdp, &crdp_stats);
+		stats->call_rcu.qlen += crdp_stats.qlen;
+		stats->call_rcu.invoked += crdp_stats.invoked;
+		stats->call_rcu.batches += crdp_stats.batches;
+		stats->call_rcu.stolen += crdp_stats.stolen;
+		stats->call_rcu.throttled += crdp_stats.throttled;
+		stats->call_rcu.rejected += crdp_stats.rejected;
+		stats->call_rcu.gp_skipped += crdp_stats.gp_skipped;
+		if (crdp_stats.batch_max > stats->call_rcu.batch_max)
+			stats->call_rcu.batch_max = crdp_stats.batch_max;
+	}
+	call_rcu_unlock(&call_rcu_mutex);
+}
+
+/*
+ * Get a snapshot of the memory used by the flavor: its reader registry,
+ * its call_rcu_data and barrier completions, its defer_rcu() queues, and
+ * the callbacks pending in them.
+ */
+void rcu_get_mem_stats(struct urcu_mem_stats *stats)
+{
+	struct call_rcu_data *crdp;
+	struct call_rcu_completion *completion;
+
+	memset(stats, 0, sizeof(*stats));
+	stats->registry_bytes = rcu_registry_mem_bytes();
+	call_rcu_lock(&call_rcu_mutex);
+	if (per_cpu_call_rcu_data)
+		stats->call_rcu_bytes += maxcpus * sizeof(*per_cpu_call_rcu_data);
+	cds_list_for_each_entry(crdp, &call_rcu_data_list, list) {
+		stats->call_rcu_bytes += sizeof(*crdp) + crdp->cpuset_size;
+		stats->call_rcu_pending += uatomic_read(&crdp->qlen);
+	}
+	call_rcu_lock(&call_rcu_completion_mutex);
+	cds_list_for_each_entry(completion, &call_rcu_completion_pool, node)
+		stats->call_rcu_bytes += sizeof(*completion)
+			+ completion->nr_works * sizeof(completion->works[0]);
+	call_rcu_unlock(&call_rcu_completion_mutex);
+	call_rcu_unlock(&call_rcu_mutex);
+	stats->call_rcu_pending_bytes = uatomic_read(&call_rcu_pending_bytes);
+	rcu_defer_get_mem_stats(stats);
+}
+
+/*
+ * Switch all call_rcu_data to reclaim mode: their batches start back to
+ * back, with expedited grace periods when the flavor supports them,
+ * until fewer than CALL_RCU_RECLAIM_QLEN_LOW callbacks are pending.
+ * Lazy callbacks and per-thread batches are flushed. The deferred
+ * callbacks of defer_rcu() are executed by callbacks of the default
+ * call_rcu_data, and are expedited as well.
+ */
+void rcu_reclaim_urgent(void)
+{
+	struct call_rcu_data *crdp;
+
+	call_rcu_lock(&call_rcu_mutex);
+	call_rcu_batch_flush_all(NULL);
+	cds_list_for_each_entry(crdp, &call_rcu_data_list, list) {
+		uatomic_set(&crdp->reclaim, CALL_RCU_RECLAIM_REQUESTED);
+		call_rcu_hurry(crdp);
+		wake_call_rcu_thread(crdp);
+	}
+	call_rcu_unlock(&call_rcu_mutex);
+}
+
+static void *reclaim_monitor_thread(void *arg)
+{
+	struct reclaim_monitor *monitor = arg;
+	struct pollfd fds[2];
+	char buf[256];
+
+	fds[0].fd = monitor->fd;
+	fds[0].events = POLLPRI;
+	fds[1].fd = monitor->stop_pipe[0];
+	fds[1].events = POLLIN;
+	for (;;) {
+		if (poll(fds, 2, -1) < 0) {
+			if (errno == EINTR)
+				continue;
+			urcu_die(errno);
+		}
+		if (fds[1].revents)
+			break;
+		/* The cgroup of a PSI trigger was removed. */
+		if (monitor->psi && (fds[0].revents & POLLERR))
+			break;
+		if (!(fds[0].revents & POLLPRI))
+			continue;
+		/* Reading a kernfs file acknowledges its change. */
+		if (!monitor->psi)
+			(void) pread(monitor->fd, buf, sizeof(buf), 0);
+		rcu_reclaim_urgent();
+	}
+	return NULL;
+}
+
+static void reclaim_monitor_close(struct reclaim_monitor *monitor)
+{
+	(void) close(monitor->fd);
+	(void) close(monitor->stop_pipe[0]);
+	(void) close(monitor->stop_pipe[1]);
+}
+
+/*
+ * Call rcu_reclaim_urgent() on memory pressure events, from a monitor
+ * thread. With a non-zero stall_us, path is a PSI file, by default
+ * /proc/pressure/memory, or the memory.pressure file of a cgroup, and
+ * events are stalls of at least stall_us within window_us. Otherwise,
+ * events are the changes of path, e.g. the memory.events file of a
+ * cgroup. Returns 0 on success, -EBUSY if a monitor is already running,
+ * or a negative error number if the file cannot be opened or the
+ * trigger is refused.
  */
-void call_rcu_data_free(struct call_rcu_data *crdp)
+int rcu_reclaim_monitor_start(const char *path, unsigned int stall_us,
+		unsigned int window_us)
 {
-	if (crdp == NULL || crdp == default_call_rcu_data) {
-		return;
+	struct reclaim_monitor *monitor = &reclaim_monitor;
+	char trigger[64];
+	int ret = 0, len;
+
+	if (!path)
+		path = "/proc/pressure/memory";
+	call_rcu_lock(&call_rcu_mutex);
+	if (monitor->running) {
+		ret = -EBUSY;
+		goto end;
 	}
-	if ((uatomic_read(&crdp->flags) & URCU_CALL_RCU_STOPPED) == 0) {
-		uatomic_or(&crdp->flags, URCU_CALL_RCU_STOP);
-		wake_call_rcu_thread(crdp);
-		while ((uatomic_read(&crdp->flags) & URCU_CALL_RCU_STOPPED) == 0)
-			(void) poll(NULL, 0, 1);
+	monitor->psi = !!stall_us;
+	monitor->fd = open(path, (stall_us ? O_RDWR | O_NONBLOCK : O_RDONLY)
+			| O_CLOEXEC);
+	if (monitor->fd < 0) {
+		ret = -errno;
+		goto end;
 	}
-	if (!cds_wfcq_empty(&crdp->cbs_head, &crdp->cbs_tail)) {
-		/* Create default call rcu data if need be */
-		(void) get_default_call_rcu_data();
-		__cds_wfcq_splice_blocking(&default_call_rcu_data->cbs_head,
-			&default_call_rcu_data->cbs_tail,
-			&crdp->cbs_head, &crdp->cbs_tail);
-		uatomic_add(&default_call_rcu_data->qlen,
-			    uatomic_read(&crdp->qlen));
-		wake_call_rcu_thread(default_call_rcu_data);
+	if (pipe(monitor->stop_pipe)) {
+		ret = -errno;
+		(void) close(monitor->fd);
+		goto end;
 	}
-
-	call_rcu_lock(&call_rcu_mutex);
-	cds_list_del(&crdp->list);
+	if (stall_us) {
+		len = snprintf(trigger, sizeof(trigger), "some %u %u",
+			stall_us, window_us);
+		if (write(monitor->fd, trigger, len + 1) < 0) {
+			ret = -errno;
+			reclaim_monitor_close(monitor);
+			goto end;
+		}
+	}
+	ret = -pthread_create(&monitor->tid, NULL, reclaim_monitor_thread,
+			monitor);
+	if (ret) {
+		reclaim_monitor_close(monitor);
+		goto end;
+	}
+	monitor->running = 1;
+end:
 	call_rcu_unlock(&call_rcu_mutex);
-
-	free(crdp);
+	return ret;
 }
-URCU_ATTR_ALIAS(urcu_stringify(call_rcu_data_free))
-void alias_call_rcu_data_free();
 
 /*
- * Clean up all the per-CPU call_rcu threads.
+ * Stop the monitor thread started by rcu_reclaim_monitor_start(), if
+ * any.
  */
-void free_all_cpu_call_rcu_data(void)
+void rcu_reclaim_monitor_stop(void)
 {
-	int cpu;
-	struct call_rcu_data **crdp;
-	static int warned = 0;
+	struct reclaim_monitor monitor;
+	int ret;
 
-	if (maxcpus <= 0)
+	call_rcu_lock(&call_rcu_mutex);
+	monitor = reclaim_monitor;
+	reclaim_monitor.running = 0;
+	call_rcu_unlock(&call_rcu_mutex);
+	if (!monitor.running)
 		return;
+	/* The monitor thread takes call_rcu_mutex: join it unlocked. */
+	if (write(monitor.stop_pipe[1], "", 1) < 0)
+		urcu_die(errno);
+	ret = pthread_join(monitor.tid, NULL);
+	if (ret)
+		urcu_die(ret);
+	reclaim_monitor_close(&monitor);
+}
 
-	crdp = malloc(sizeof(*crdp) * maxcpus);
-	if (!crdp) {
-		if (!warned) {
-			fprintf(stderr, "[error] liburcu: unable to allocate per-CPU pointer array\n");
-		}
-		warned = 1;
-		return;
-	}
+void rcu_for_each_call_rcu_data(void (*func)(struct call_rcu_data *crdp,
+			const struct urcu_call_rcu_info *info, void *priv),
+		void *priv)
+{
+	struct call_rcu_data *crdp;
+	struct urcu_call_rcu_info info;
 
-	for (cpu = 0; cpu < maxcpus; cpu++) {
-		crdp[cpu] = get_cpu_call_rcu_data(cpu);
-		if (crdp[cpu] == NULL)
-			continue;
-		set_cpu_call_rcu_data(cpu, NULL);
-	}
-	/*
-	 * Wait for call_rcu sites acting as RCU readers of the
-	 * call_rcu_data to become quiescent.
-	 */
-	synchronize_rcu();
-	for (cpu = 0; cpu < maxcpus; cpu++) {
-		if (crdp[cpu] == NULL)
-			continue;
-		call_rcu_data_free(crdp[cpu]);
+	call_rcu_lock(&call_rcu_mutex);
+	cds_list_for_each_entry(crdp, &call_rcu_data_list, list) {
+		info.tid = crdp->tid;
+		info.cpu_affinity = crdp->cpu_affinity;
+		info.numa_node = crdp->numa_node;
+		info.flags = CMM_LOAD_SHARED(crdp->flags);
+		call_rcu_data_get_stats(crdp, &info.stats);
+		func(crdp, &info, priv);
 	}
-	free(crdp);
+	call_rcu_unlock(&call_rcu_mutex);
 }
-#ifdef RCU_QSBR
-/* ABI6 has a non-namespaced free_all_cpu_call_rcu_data for qsbr */
-#undef free_all_cpu_call_rcu_data
-URCU_ATTR_ALIAS("urcu_qsbr_free_all_cpu_call_rcu_data")
-void free_all_cpu_call_rcu_data();
-#define free_all_cpu_call_rcu_data urcu_qsbr_free_all_cpu_call_rcu_data
-#else
-URCU_ATTR_ALIAS(urcu_stringify(free_all_cpu_call_rcu_data))
-void alias_free_all_cpu_call_rcu_data();
-#endif
 
-static
-void free_completion(struct urcu_ref *ref)
+static const char *introspect_reader_state_str(
+		enum urcu_reader_info_state state)
 {
-	struct call_rcu_completion *completion;
+	switch (state) {
+	case URCU_READER_INFO_ACTIVE_CURRENT:
+		return "active-current";
+	case URCU_READER_INFO_ACTIVE_OLD:
+		return "active-old";
+	default:
+		return "inactive";
+	}
+}
 
-	completion = caa_container_of(ref, struct call_rcu_completion, ref);
-	free(completion);
+static void introspect_dump_reader(const struct urcu_reader_info *info,
+		void *priv)
+{
+	fprintf(priv, "reader tid=%#lx state=%s%s\n",
+		(unsigned long) info->tid,
+		introspect_reader_state_str(info->state),
+		info->detached ? " detached" : "");
 }
 
-static
-void _rcu_barrier_complete(struct rcu_head *head)
+static void introspect_dump_call_rcu_data(struct call_rcu_data *crdp,
+		const struct urcu_call_rcu_info *info, void *priv)
 {
-	struct call_rcu_completion_work *work;
-	struct call_rcu_completion *completion;
+	fprintf(priv, "call_rcu tid=%#lx cpu=%d node=%d flags=%#lx "
+		"qlen=%lu invoked=%lu batches=%lu batch_max=%lu stolen=%lu\n",
+		(unsigned long) info->tid, info->cpu_affinity,
+		info->numa_node, info->flags, info->stats.qlen,
+		info->stats.invoked, info->stats.batches,
+		info->stats.batch_max, info->stats.stolen);
+}
 
-	work = caa_container_of(head, struct call_rcu_completion_work, head);
-	completion = work->completion;
-	if (!uatomic_sub_return(&completion->barrier_count, 1))
-		call_rcu_completion_wake_up(completion);
-	urcu_ref_put(&completion->ref, free_completion);
-	free(work);
+static void introspect_dump_defer_queue(
+		const struct urcu_defer_queue_info *info, void *priv)
+{
+	fprintf(priv, "defer tid=%#lx fill=%lu size=%lu\n",
+		(unsigned long) info->tid, info->fill, info->size);
 }
 
 /*
- * Wait for all in-flight call_rcu callbacks to complete execution.
+ * The dump is formatted in memory, so that the registry locks are not
+ * held while writing to fd.
  */
-void rcu_barrier(void)
+int rcu_introspect_dump(int fd)
 {
-	struct call_rcu_data *crdp;
-	struct call_rcu_completion *completion;
-	int count = 0;
-	int was_online;
-
-	/* Put in offline state in QSBR. */
-	was_online = _rcu_read_ongoing();
-	if (was_online)
-		rcu_thread_offline();
-	/*
-	 * Calling a rcu_barrier() within a RCU read-side critical
-	 * section is an error.
-	 */
-	if (_rcu_read_ongoing()) {
-		static int warned = 0;
-
-		if (!warned) {
-			fprintf(stderr, "[error] liburcu: rcu_barrier() called from within RCU read-side critical section.\n");
+	char *buf = NULL;
+	size_t len = 0, done;
+	ssize_t ret;
+	FILE *f;
+
+	f = open_memstream(&buf, &len);
+	if (!f)
+		return -errno;
+	(void) rcu_for_each_reader(introspect_dump_reader, f);
+	rcu_for_each_call_rcu_data(introspect_dump_call_rcu_data, f);
+	rcu_for_each_defer_queue(introspect_dump_defer_queue, f);
+	if (fclose(f)) {
+		free(buf);
+		return -ENOMEM;
+	}
+	for (done = 0; done < len; done += ret) {
+		ret = write(fd, buf + done, len - done);
+		if (ret < 0) {
+			if (errno == EINTR) {
+				ret = 0;
+				continue;
+			}
+			ret = -errno;
+			free(buf);
+			return ret;
 		}
-		warned = 1;
-		goto online;
 	}
+	free(buf);
+	return 0;
+}
 
-	completion = calloc(sizeof(*completion), 1);
-	if (!completion)
-		urcu_die(errno);
+static void introspect_signal_handler(int signo)
+{
+	int saved_errno = errno;
 
-	call_rcu_lock(&call_rcu_mutex);
-	cds_list_for_each_entry(crdp, &call_rcu_data_list, list)
-		count++;
+	(void) write(CMM_LOAD_SHARED(introspect_signal_wfd), "", 1);
+	errno = saved_errno;
+}
 
-	/* Referenced by rcu_barrier() and each call_rcu thread. */
-	urcu_ref_set(&completion->ref, count + 1);
-	completion->barrier_count = count;
+static void *introspect_signal_thread(void *arg)
+{
+	struct introspect_signal *dump = arg;
+	struct pollfd fds[2];
+	char buf[64];
+
+	fds[0].fd = dump->signal_pipe[0];
+	fds[0].events = POLLIN;
+	fds[1].fd = dump->stop_pipe[0];
+	fds[1].events = POLLIN;
+	for (;;) {
+		if (poll(fds, 2, -1) < 0) {
+			if (errno == EINTR)
+				continue;
+			urcu_die(errno);
+		}
+		if (fds[1].revents)
+			break;
+		if (!(fds[0].revents & POLLIN))
+			continue;
+		/* Signals received meanwhile are covered by one dump. */
+		while (read(dump->signal_pipe[0], buf, sizeof(buf)) > 0)
+			;
+		(void) rcu_introspect_dump(dump->fd);
+	}
+	return NULL;
+}
 
-	cds_list_for_each_entry(crdp, &call_rcu_data_list, list) {
-		struct call_rcu_completion_work *work;
+static void introspect_signal_close(struct introspect_signal *dump)
+{
+	(void) close(dump->signal_pipe[0]);
+	(void) close(dump->signal_pipe[1]);
+	(void) close(dump->stop_pipe[0]);
+	(void) close(dump->stop_pipe[1]);
+}
+
+int rcu_introspect_signal_start(int signo, int fd)
+{
+	struct introspect_signal *dump = &introspect_signal;
+	struct sigaction act;
+	int ret = 0;
 
-		work = calloc(sizeof(*work), 1);
-		if (!work)
+#ifdef RCU_SIGNAL
+	if (signo == SIGRCU)
+		return -EINVAL;
+#endif
+	call_rcu_lock(&call_rcu_mutex);
+	if (dump->running) {
+		ret = -EBUSY;
+		goto end;
+	}
+	if (pipe2(dump->signal_pipe, O_CLOEXEC | O_NONBLOCK)) {
+		ret = -errno;
+		goto end;
+	}
+	if (pipe2(dump->stop_pipe, O_CLOEXEC)) {
+		ret = -errno;
+		(void) close(dump->signal_pipe[0]);
+		(void) close(dump->signal_pipe[1]);
+		goto end;
+	}
+	dump->signo = signo;
+	dump->fd = fd;
+	CMM_STORE_SHARED(introspect_signal_wfd, dump->signal_pipe[1]);
+	ret = -pthread_create(&dump->tid, NULL, introspect_signal_thread,
+			dump);
+	if (ret) {
+		introspect_signal_close(dump);
+		goto end;
+	}
+	memset(&act, 0, sizeof(act));
+	act.sa_handler = introspect_signal_handler;
+	act.sa_flags = SA_RESTART;
+	sigemptyset(&act.sa_mask);
+	if (sigaction(signo, &act, &dump->old_action)) {
+		ret = -errno;
+		if (write(dump->stop_pipe[1], "", 1) < 0)
 			urcu_die(errno);
-		work->completion = completion;
-		_call_rcu(&work->head, _rcu_barrier_complete, crdp);
+		(void) pthread_join(dump->tid, NULL);
+		introspect_signal_close(dump);
+		goto end;
 	}
+	dump->running = 1;
+end:
 	call_rcu_unlock(&call_rcu_mutex);
+	return ret;
+}
 
-	/* Wait for them */
-	for (;;) {
-		uatomic_dec(&completion->futex);
-		/* Decrement futex before reading barrier_count */
-		cmm_smp_mb();
-		if (!uatomic_read(&completion->barrier_count))
-			break;
-		call_rcu_completion_wait(completion);
-	}
-
-	urcu_ref_put(&completion->ref, free_completion);
+void rcu_introspect_signal_stop(void)
+{
+	struct introspect_signal dump;
+	int ret;
 
-online:
-	if (was_online)
-		rcu_thread_online();
+	call_rcu_lock(&call_rcu_mutex);
+	dump = introspect_signal;
+	if (dump.running
+			&& sigaction(dump.signo, &dump.old_action, NULL))
+		urcu_die(errno);
+	CMM_STORE_SHARED(introspect_signal_wfd, -1);
+	introspect_signal.running = 0;
+	call_rcu_unlock(&call_rcu_mutex);
+	if (!dump.running)
+		return;
+	/* The dump thread takes call_rcu_mutex: join it unlocked. */
+	if (write(dump.stop_pipe[1], "", 1) < 0)
+		urcu_die(errno);
+	ret = pthread_join(dump.tid, NULL);
+	if (ret)
+		urcu_die(ret);
+	introspect_signal_close(&dump);
 }
-URCU_ATTR_ALIAS(urcu_stringify(rcu_barrier))
-void alias_rcu_barrier();
 
 /*
  * Acquire the call_rcu_mutex in order to ensure that the child sees
@@ -948,6 +3709,9 @@ void call_rcu_before_fork(void)
 
 	call_rcu_lock(&call_rcu_mutex);
 
+	/* The child inherits no batched callbacks. */
+	call_rcu_batch_flush_all(NULL);
+
 	atfork = registered_rculfhash_atfork;
 	if (atfork)
 		atfork->before_fork(atfork->priv);
@@ -961,6 +3725,8 @@ void call_rcu_before_fork(void)
 		while ((uatomic_read(&crdp->flags) & URCU_CALL_RCU_PAUSED) == 0)
 			(void) poll(NULL, 0, 1);
 	}
+	/* Released barrier completions return to the pool. */
+	call_rcu_lock(&call_rcu_completion_mutex);
 }
 URCU_ATTR_ALIAS(urcu_stringify(call_rcu_before_fork))
 void alias_call_rcu_before_fork();
@@ -975,6 +3741,7 @@ void call_rcu_after_fork_parent(void)
 	struct call_rcu_data *crdp;
 	struct urcu_atfork *atfork;
 
+	call_rcu_unlock(&call_rcu_completion_mutex);
 	cds_list_for_each_entry(crdp, &call_rcu_data_list, list)
 		uatomic_and(&crdp->flags, ~URCU_CALL_RCU_PAUSE);
 	cds_list_for_each_entry(crdp, &call_rcu_data_list, list) {
@@ -989,6 +3756,23 @@ void call_rcu_after_fork_parent(void)
 URCU_ATTR_ALIAS(urcu_stringify(call_rcu_after_fork_parent))
 void alias_call_rcu_after_fork_parent();
 
+/*
+ * Free a call_rcu_data structure whose thread did not survive fork,
+ * moving its callbacks to the orphan queue.
+ */
+static void call_rcu_data_orphan(struct call_rcu_data *crdp)
+{
+	(void) call_rcu_lazy_take(crdp,
+		cds_wfcq_prio_head(&crdp->cbs, CDS_WFCQ_PRIO_NORMAL),
+		cds_wfcq_prio_tail(&crdp->cbs, CDS_WFCQ_PRIO_NORMAL), 1);
+	(void) __cds_wfcq_prio_splice_blocking(&fork_orphans.head,
+		&fork_orphans.tail, &crdp->cbs);
+	fork_orphans.qlen += uatomic_read(&crdp->qlen);
+	cds_list_del(&crdp->list);
+	free(crdp->cpuset);
+	free(crdp);
+}
+
 /*
  * Clean up call_rcu data structures in the child of a successful fork()
  * that is not followed by exec().  Suitable for pthread_atfork() and
@@ -997,8 +3781,36 @@ void alias_call_rcu_after_fork_parent();
 void call_rcu_after_fork_child(void)
 {
 	struct call_rcu_data *crdp, *next;
+	struct call_rcu_batch *batch;
 	struct urcu_atfork *atfork;
 
+	/*
+	 * Only the batch of the current thread survives in the child. It
+	 * was flushed before fork, and may target a call_rcu_data freed
+	 * below.
+	 */
+	CDS_INIT_LIST_HEAD(&call_rcu_batch_list);
+	batch = URCU_TLS(thread_call_rcu_batch);
+	if (batch) {
+		assert(!batch->nr);
+		batch->crdp = NULL;
+		cds_list_add(&batch->list, &call_rcu_batch_list);
+	}
+
+	/* Neither does the leader of a rcu_barrier() pass, nor its waiters. */
+	rcu_barrier_completed = rcu_barrier_started;
+	rcu_barrier_running = 0;
+	(void) pthread_cond_init(&rcu_barrier_cond, NULL);
+	/* Another thread may have been reading the callback statistics. */
+	(void) pthread_mutex_init(&call_rcu_func_stats_mutex, NULL);
+	call_rcu_unlock(&call_rcu_completion_mutex);
+
+	/* The memory pressure monitor thread does not survive either. */
+	if (reclaim_monitor.running) {
+		reclaim_monitor_close(&reclaim_monitor);
+		reclaim_monitor.running = 0;
+	}
+
 	/* Release the mutex. */
 	call_rcu_unlock(&call_rcu_mutex);
 
@@ -1010,19 +3822,38 @@ void call_rcu_after_fork_child(void)
 	if (cds_list_empty(&call_rcu_data_list))
 		return;
 
-	/*
-	 * Allocate a new default call_rcu_data structure in order
-	 * to get a working call_rcu thread to go with it.
-	 */
-	default_call_rcu_data = NULL;
-	(void)get_default_call_rcu_data();
-
 	/* Cleanup call_rcu_data pointers before use */
+	default_call_rcu_data = NULL;
 	maxcpus_reset();
 	free(per_cpu_call_rcu_data);
 	rcu_set_pointer(&per_cpu_call_rcu_data, NULL);
 	URCU_TLS(thread_call_rcu_data) = NULL;
 
+	/*
+	 * In lazy fork mode, keep the leftover callbacks aside until the
+	 * first use of call_rcu in the child creates its default call_rcu
+	 * thread.
+	 */
+	if (call_rcu_fork_lazy) {
+		if (!fork_orphans.pending) {
+			cds_wfcq_init(&fork_orphans.head, &fork_orphans.tail);
+		}
+		cds_list_for_each_entry_safe(crdp, next, &call_rcu_data_list,
+				list)
+			call_rcu_data_orphan(crdp);
+		if (!cds_wfcq_empty(&fork_orphans.head, &fork_orphans.tail))
+			fork_orphans.pending = 1;
+		else if (!fork_orphans.pending)
+			cds_wfcq_destroy(&fork_orphans.head, &fork_orphans.tail);
+		return;
+	}
+
+	/*
+	 * Allocate a new default call_rcu_data structure in order
+	 * to get a working call_rcu thread to go with it.
+	 */
+	(void)get_default_call_rcu_data();
+
 	/*
 	 * Dispose of all of the rest of the call_rcu_data structures.
 	 * Leftover call_rcu callbacks will be merged into the new
@@ -1038,6 +3869,17 @@ void call_rcu_after_fork_child(void)
 URCU_ATTR_ALIAS(urcu_stringify(call_rcu_after_fork_child))
 void alias_call_rcu_after_fork_child();
 
+/*
+ * Select whether fork children create their call_rcu threads at once,
+ * or only on their first use of call_rcu: see call_rcu_after_fork_child().
+ */
+void call_rcu_set_fork_lazy(int lazy)
+{
+	call_rcu_lock(&call_rcu_mutex);
+	call_rcu_fork_lazy = !!lazy;
+	call_rcu_unlock(&call_rcu_mutex);
+}
+
 void urcu_register_rculfhash_atfork(struct urcu_atfork *atfork)
 {
 	call_rcu_lock(&call_rcu_mutex);
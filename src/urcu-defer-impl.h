@@ -53,10 +53,15 @@
 #include "urcu-utils.h"
 
 /*
- * Number of entries in the per-thread defer queue. Must be power of 2.
+ * Default number of entries in the per-thread defer queue. Must be power of 2.
  */
 #define DEFER_QUEUE_SIZE	(1 << 12)
-#define DEFER_QUEUE_MASK	(DEFER_QUEUE_SIZE - 1)
+
+/*
+ * Smallest queue: room for a callback with its function encoded (3 entries),
+ * with 2 entries always kept free.
+ */
+#define DEFER_QUEUE_MIN_SIZE	(1 << 3)
 
 /*
  * Typically, data is aligned at least on the architecture size.
@@ -102,9 +107,15 @@ struct defer_queue {
 	unsigned long tail;	/* next element to remove at tail */
 	void *last_fct_out;	/* last fct pointer encoded */
 	void **q;
+	unsigned long mask;	/* number of entries in q - 1 */
 	/* registry information */
 	unsigned long last_head;
 	struct cds_list_head list;	/* list of thread queues */
+	pthread_t tid;			/* for rcu_for_each_defer_queue() */
+	/* reclamation engine, see defer_engine_arm() */
+	struct rcu_head engine_head;
+	unsigned long armed_head;	/* entries covered by engine_head */
+	int armed;
 };
 
 /* Do not #define _LGPL_SOURCE to ensure we can emit the wrapper symbols */
@@ -114,14 +125,10 @@ void __attribute__((destructor)) rcu_defer_exit(void);
 
 extern void synchronize_rcu(void);
 
-/*
- * rcu_defer_mutex nests inside defer_thread_mutex.
- */
 static pthread_mutex_t rcu_defer_mutex = PTHREAD_MUTEX_INITIALIZER;
-static pthread_mutex_t defer_thread_mutex = PTHREAD_MUTEX_INITIALIZER;
 
-static int32_t defer_thread_futex;
-static int32_t defer_thread_stop;
+/* High watermark of the thread queues, see rcu_defer_set_attr(). */
+static unsigned long defer_qlen_high_watermark;
 
 /*
  * Written to only by each individual deferer. Read by both the deferer and
@@ -129,88 +136,35 @@ static int32_t defer_thread_stop;
  */
 static DEFINE_URCU_TLS(struct defer_queue, defer_queue);
 static CDS_LIST_HEAD(registry_defer);
-static pthread_t tid_defer;
+
+/*
+ * Callback queued with call_rcu() rather than in the defer queue of its
+ * thread because the queue was full, so that defer_rcu() does not wait
+ * for a grace period.
+ */
+struct defer_spill {
+	struct rcu_head head;
+	void (*fct)(void *p);
+	void *p;
+};
+
+/* Spilled callbacks not executed yet. */
+static unsigned long defer_spill_count;
 
 static void mutex_lock_defer(pthread_mutex_t *mutex)
 {
-	int ret;
-
 #ifndef DISTRUST_SIGNALS_EXTREME
-	ret = pthread_mutex_lock(mutex);
-	if (ret)
-		urcu_die(ret);
+	urcu_mutex_lock(mutex, &lock_stats.defer);
 #else /* #ifndef DISTRUST_SIGNALS_EXTREME */
-	while ((ret = pthread_mutex_trylock(mutex)) != 0) {
-		if (ret != EBUSY && ret != EINTR)
-			urcu_die(ret);
-		(void) poll(NULL,0,10);
-	}
+	urcu_mutex_lock_poll(mutex, &lock_stats.defer, NULL);
 #endif /* #else #ifndef DISTRUST_SIGNALS_EXTREME */
 }
 
-/*
- * Wake-up any waiting defer thread. Called from many concurrent threads.
- */
-static void wake_up_defer(void)
+static unsigned long defer_high_watermark(struct defer_queue *queue)
 {
-	if (caa_unlikely(uatomic_read(&defer_thread_futex) == -1)) {
-		uatomic_set(&defer_thread_futex, 0);
-		if (futex_noasync(&defer_thread_futex, FUTEX_WAKE, 1,
-				NULL, NULL, 0) < 0)
-			urcu_die(errno);
-	}
-}
-
-static unsigned long rcu_defer_num_callbacks(void)
-{
-	unsigned long num_items = 0, head;
-	struct defer_queue *index;
+	unsigned long watermark = CMM_LOAD_SHARED(defer_qlen_high_watermark);
 
-	mutex_lock_defer(&rcu_defer_mutex);
-	cds_list_for_each_entry(index, &registry_defer, list) {
-		head = CMM_LOAD_SHARED(index->head);
-		num_items += head - index->tail;
-	}
-	mutex_unlock(&rcu_defer_mutex);
-	return num_items;
-}
-
-/*
- * Defer thread waiting. Single thread.
- */
-static void wait_defer(void)
-{
-	uatomic_dec(&defer_thread_futex);
-	/* Write futex before read queue */
-	/* Write futex before read defer_thread_stop */
-	cmm_smp_mb();
-	if (_CMM_LOAD_SHARED(defer_thread_stop)) {
-		uatomic_set(&defer_thread_futex, 0);
-		pthread_exit(0);
-	}
-	if (rcu_defer_num_callbacks()) {
-		cmm_smp_mb();	/* Read queue before write futex */
-		/* Callbacks are queued, don't wait. */
-		uatomic_set(&defer_thread_futex, 0);
-	} else {
-		cmm_smp_rmb();	/* Read queue before read futex */
-		if (uatomic_read(&defer_thread_futex) != -1)
-			return;
-		while (futex_noasync(&defer_thread_futex, FUTEX_WAIT, -1,
-				NULL, NULL, 0)) {
-			switch (errno) {
-			case EWOULDBLOCK:
-				/* Value already changed. */
-				return;
-			case EINTR:
-				/* Retry if interrupted by signal. */
-				break;	/* Get out of switch. */
-			default:
-				/* Unexpected error. */
-				urcu_die(errno);
-			}
-		}
-	}
+	return watermark ? watermark : (queue->mask + 1) >> 1;
 }
 
 /*
@@ -230,15 +184,15 @@ static void rcu_defer_barrier_queue(struct defer_queue *queue,
 
 	for (i = queue->tail; i != head;) {
 		cmm_smp_rmb();       /* read head before q[]. */
-		p = CMM_LOAD_SHARED(queue->q[i++ & DEFER_QUEUE_MASK]);
+		p = CMM_LOAD_SHARED(queue->q[i++ & queue->mask]);
 		if (caa_unlikely(DQ_IS_FCT_BIT(p))) {
 			DQ_CLEAR_FCT_BIT(p);
 			queue->last_fct_out = p;
-			p = CMM_LOAD_SHARED(queue->q[i++ & DEFER_QUEUE_MASK]);
+			p = CMM_LOAD_SHARED(queue->q[i++ & queue->mask]);
 		} else if (caa_unlikely(p == DQ_FCT_MARK)) {
-			p = CMM_LOAD_SHARED(queue->q[i++ & DEFER_QUEUE_MASK]);
+			p = CMM_LOAD_SHARED(queue->q[i++ & queue->mask]);
 			queue->last_fct_out = p;
-			p = CMM_LOAD_SHARED(queue->q[i++ & DEFER_QUEUE_MASK]);
+			p = CMM_LOAD_SHARED(queue->q[i++ & queue->mask]);
 		}
 		fct = queue->last_fct_out;
 		fct(p);
@@ -259,11 +213,111 @@ static void _rcu_defer_barrier_thread(void)
 	rcu_defer_barrier_queue(&URCU_TLS(defer_queue), head);
 }
 
+static void defer_spill_cb(struct rcu_head *head)
+{
+	struct defer_spill *spill =
+		caa_container_of(head, struct defer_spill, head);
+
+	spill->fct(spill->p);
+	free(spill);
+	uatomic_dec_release(&defer_spill_count);
+}
+
+/*
+ * Queue a callback with call_rcu(). Return 0 on success, -ENOMEM on error.
+ */
+static int defer_spill(void (*fct)(void *p), void *p)
+{
+	struct defer_spill *spill;
+
+	spill = malloc(sizeof(*spill));
+	if (!spill)
+		return -ENOMEM;
+	spill->fct = fct;
+	spill->p = p;
+	uatomic_inc(&defer_spill_count);
+	call_rcu(&spill->head, defer_spill_cb);
+	return 0;
+}
+
+/*
+ * Wait for spilled callbacks. They are few, so rather than tracking those
+ * of each thread, wait for all call_rcu() callbacks.
+ */
+static void defer_spill_barrier(void)
+{
+	if (caa_unlikely(uatomic_read(&defer_spill_count)))
+		rcu_barrier();
+}
+
+/*
+ * Reclamation engine. Deferred callbacks are executed by the default
+ * call_rcu thread of the flavor rather than by a thread of their own, so
+ * that a single grace period covers the call_rcu() and defer_rcu()
+ * callbacks queued meanwhile, under one batching policy.
+ *
+ * A thread queue holding callbacks is armed: its engine_head is queued
+ * with call_rcu(), and covers the entries up to armed_head, all queued
+ * before. The engine callback executes them, and arms the queue again if
+ * more were queued meanwhile.
+ */
+static void defer_engine_cb(struct rcu_head *head);
+
+static void defer_engine_arm(struct defer_queue *queue)
+{
+	if (uatomic_cmpxchg(&queue->armed, 0, 1))
+		return;
+	queue->armed_head = CMM_LOAD_SHARED(queue->head);
+	_call_rcu(&queue->engine_head, defer_engine_cb,
+		get_default_call_rcu_data());
+}
+
+/*
+ * End the delay of the engine. Called from many concurrent threads.
+ */
+static void defer_engine_hurry(void)
+{
+	call_rcu_hurry(get_default_call_rcu_data());
+}
+
+static void defer_engine_cb(struct rcu_head *head)
+{
+	struct defer_queue *queue =
+		caa_container_of(head, struct defer_queue, engine_head);
+	unsigned long pending;
+
+	/*
+	 * The holder of rcu_defer_mutex may be waiting for a grace period
+	 * which needs this thread: retry after the next one rather than
+	 * waiting for the mutex.
+	 */
+	if (urcu_mutex_trylock(&rcu_defer_mutex)) {
+		_call_rcu(head, defer_engine_cb, get_default_call_rcu_data());
+		return;
+	}
+	urcu_mutex_acquired(&lock_stats.defer, 0, 0);
+	/* A barrier may have executed these entries already. */
+	if ((long) (queue->armed_head - queue->tail) > 0)
+		rcu_defer_barrier_queue(queue, queue->armed_head);
+	uatomic_set(&queue->armed, 0);
+	/* Write armed before read queue head */
+	cmm_smp_mb();
+	pending = CMM_LOAD_SHARED(queue->head) - queue->tail;
+	if (pending) {
+		defer_engine_arm(queue);
+		if (pending >= defer_high_watermark(queue))
+			defer_engine_hurry();
+	}
+	/* The queue may be freed once unlocked and disarmed. */
+	mutex_unlock(&rcu_defer_mutex);
+}
+
 void rcu_defer_barrier_thread(void)
 {
 	mutex_lock_defer(&rcu_defer_mutex);
 	_rcu_defer_barrier_thread();
 	mutex_unlock(&rcu_defer_mutex);
+	defer_spill_barrier();
 }
 URCU_ATTR_ALIAS(urcu_stringify(rcu_defer_barrier_thread))
 void alias_rcu_defer_barrier_thread();
@@ -287,7 +341,7 @@ void rcu_defer_barrier(void)
 	unsigned long num_items = 0;
 
 	if (cds_list_empty(&registry_defer))
-		return;
+		goto spill;
 
 	mutex_lock_defer(&rcu_defer_mutex);
 	cds_list_for_each_entry(index, &registry_defer, list) {
@@ -306,6 +360,8 @@ void rcu_defer_barrier(void)
 		rcu_defer_barrier_queue(index, index->last_head);
 end:
 	mutex_unlock(&rcu_defer_mutex);
+spill:
+	defer_spill_barrier();
 }
 URCU_ATTR_ALIAS(urcu_stringify(rcu_defer_barrier))
 void alias_rcu_defer_barrier();
@@ -315,7 +371,7 @@ void alias_rcu_defer_barrier();
  */
 static void _defer_rcu(void (*fct)(void *p), void *p)
 {
-	unsigned long head, tail;
+	unsigned long head, tail, mask, start, watermark;
 
 	/*
 	 * Head is only modified by ourself. Tail can be modified by reclamation
@@ -323,16 +379,26 @@ static void _defer_rcu(void (*fct)(void *p), void *p)
 	 */
 	head = URCU_TLS(defer_queue).head;
 	tail = CMM_LOAD_SHARED(URCU_TLS(defer_queue).tail);
+	mask = URCU_TLS(defer_queue).mask;
 
 	/*
-	 * If queue is full, or reached threshold. Empty queue ourself.
+	 * If queue is full, or reached threshold, queue the callback with
+	 * call_rcu() rather than waiting for a grace period, and only empty
+	 * the queue ourself if out of memory.
 	 * Worse-case: must allow 2 supplementary entries for fct pointer.
 	 */
-	if (caa_unlikely(head - tail >= DEFER_QUEUE_SIZE - 2)) {
-		assert(head - tail <= DEFER_QUEUE_SIZE);
-		rcu_defer_barrier_thread();
+	if (caa_unlikely(head - tail >= mask - 1)) {
+		assert(head - tail <= mask + 1);
+		defer_engine_hurry();
+		if (caa_likely(!defer_spill(fct, p)))
+			return;
+		mutex_lock_defer(&rcu_defer_mutex);
+		_rcu_defer_barrier_thread();
+		mutex_unlock(&rcu_defer_mutex);
 		assert(head - CMM_LOAD_SHARED(URCU_TLS(defer_queue).tail) == 0);
+		tail = head;
 	}
+	start = head;
 
 	/*
 	 * Encode:
@@ -355,42 +421,31 @@ static void _defer_rcu(void (*fct)(void *p), void *p)
 			|| p == DQ_FCT_MARK)) {
 		URCU_TLS(defer_queue).last_fct_in = fct;
 		if (caa_unlikely(DQ_IS_FCT_BIT(fct) || fct == DQ_FCT_MARK)) {
-			_CMM_STORE_SHARED(URCU_TLS(defer_queue).q[head++ & DEFER_QUEUE_MASK],
+			_CMM_STORE_SHARED(URCU_TLS(defer_queue).q[head++ & mask],
 				      DQ_FCT_MARK);
-			_CMM_STORE_SHARED(URCU_TLS(defer_queue).q[head++ & DEFER_QUEUE_MASK],
+			_CMM_STORE_SHARED(URCU_TLS(defer_queue).q[head++ & mask],
 				      fct);
 		} else {
 			DQ_SET_FCT_BIT(fct);
-			_CMM_STORE_SHARED(URCU_TLS(defer_queue).q[head++ & DEFER_QUEUE_MASK],
+			_CMM_STORE_SHARED(URCU_TLS(defer_queue).q[head++ & mask],
 				      fct);
 		}
 	}
-	_CMM_STORE_SHARED(URCU_TLS(defer_queue).q[head++ & DEFER_QUEUE_MASK], p);
+	_CMM_STORE_SHARED(URCU_TLS(defer_queue).q[head++ & mask], p);
 	cmm_smp_wmb();	/* Publish new pointer before head */
 			/* Write q[] before head. */
 	CMM_STORE_SHARED(URCU_TLS(defer_queue).head, head);
-	cmm_smp_mb();	/* Write queue head before read futex */
+	cmm_smp_mb();	/* Write queue head before read armed */
 	/*
-	 * Wake-up any waiting defer thread.
+	 * Arm the queue if the engine does not cover it yet, and end the
+	 * delay of the engine when crossing the high watermark.
 	 */
-	wake_up_defer();
-}
-
-static void *thr_defer(void *args)
-{
-	for (;;) {
-		/*
-		 * "Be green". Don't wake up the CPU if there is no RCU work
-		 * to perform whatsoever. Aims at saving laptop battery life by
-		 * leaving the processor in sleep state when idle.
-		 */
-		wait_defer();
-		/* Sleeping after wait_defer to let many callbacks enqueue */
-		(void) poll(NULL,0,100);	/* wait for 100ms */
-		rcu_defer_barrier();
-	}
-
-	return NULL;
+	if (!uatomic_read(&URCU_TLS(defer_queue).armed))
+		defer_engine_arm(&URCU_TLS(defer_queue));
+	watermark = defer_high_watermark(&URCU_TLS(defer_queue));
+	if (caa_unlikely(head - tail >= watermark
+			&& start - tail < watermark))
+		defer_engine_hurry();
 }
 
 /*
@@ -403,76 +458,86 @@ void defer_rcu(void (*fct)(void *p), void *p)
 }
 URCU_ATTR_ALIAS(urcu_stringify(defer_rcu)) void alias_defer_rcu();
 
-static void start_defer_thread(void)
-{
-	int ret;
-
-	ret = pthread_create(&tid_defer, NULL, thr_defer, NULL);
-	assert(!ret);
-}
-
-static void stop_defer_thread(void)
-{
-	int ret;
-	void *tret;
-
-	_CMM_STORE_SHARED(defer_thread_stop, 1);
-	/* Store defer_thread_stop before testing futex */
-	cmm_smp_mb();
-	wake_up_defer();
-
-	ret = pthread_join(tid_defer, &tret);
-	assert(!ret);
-
-	CMM_STORE_SHARED(defer_thread_stop, 0);
-	/* defer thread should always exit when futex value is 0 */
-	assert(uatomic_read(&defer_thread_futex) == 0);
-}
-
-int rcu_defer_register_thread(void)
+int rcu_defer_register_thread_size(unsigned long size)
 {
-	int was_empty;
-
+	if (size < DEFER_QUEUE_MIN_SIZE || (size & (size - 1)))
+		return -EINVAL;
 	assert(URCU_TLS(defer_queue).last_head == 0);
 	assert(URCU_TLS(defer_queue).q == NULL);
-	URCU_TLS(defer_queue).q = malloc(sizeof(void *) * DEFER_QUEUE_SIZE);
+	URCU_TLS(defer_queue).q = malloc(sizeof(void *) * size);
 	if (!URCU_TLS(defer_queue).q)
 		return -ENOMEM;
+	URCU_TLS(defer_queue).mask = size - 1;
+	URCU_TLS(defer_queue).tid = pthread_self();
 
-	mutex_lock_defer(&defer_thread_mutex);
 	mutex_lock_defer(&rcu_defer_mutex);
-	was_empty = cds_list_empty(&registry_defer);
 	cds_list_add(&URCU_TLS(defer_queue).list, &registry_defer);
 	mutex_unlock(&rcu_defer_mutex);
-
-	if (was_empty)
-		start_defer_thread();
-	mutex_unlock(&defer_thread_mutex);
 	return 0;
 }
+
+int rcu_defer_register_thread(void)
+{
+	return rcu_defer_register_thread_size(DEFER_QUEUE_SIZE);
+}
+
+void rcu_defer_set_attr(const struct call_rcu_attr *attr)
+{
+	call_rcu_data_set_delays(get_default_call_rcu_data(), attr);
+	CMM_STORE_SHARED(defer_qlen_high_watermark,
+		attr ? attr->qlen_high_watermark : 0);
+}
 URCU_ATTR_ALIAS(urcu_stringify(rcu_defer_register_thread))
 int alias_rcu_defer_register_thread();
 
 void rcu_defer_unregister_thread(void)
 {
-	int is_empty;
-
-	mutex_lock_defer(&defer_thread_mutex);
 	mutex_lock_defer(&rcu_defer_mutex);
 	cds_list_del(&URCU_TLS(defer_queue).list);
 	_rcu_defer_barrier_thread();
+	mutex_unlock(&rcu_defer_mutex);
+
+	/* Wait for the engine to let go of the queue. */
+	while (uatomic_read(&URCU_TLS(defer_queue).armed))
+		rcu_barrier();
+	mutex_lock_defer(&rcu_defer_mutex);
 	free(URCU_TLS(defer_queue).q);
 	URCU_TLS(defer_queue).q = NULL;
-	is_empty = cds_list_empty(&registry_defer);
 	mutex_unlock(&rcu_defer_mutex);
-
-	if (is_empty)
-		stop_defer_thread();
-	mutex_unlock(&defer_thread_mutex);
 }
 URCU_ATTR_ALIAS(urcu_stringify(rcu_defer_unregister_thread))
 void alias_rcu_defer_unregister_thread();
 
+void rcu_for_each_defer_queue(void (*func)(
+			const struct urcu_defer_queue_info *info, void *priv),
+		void *priv)
+{
+	struct defer_queue *index;
+	struct urcu_defer_queue_info info;
+
+	mutex_lock_defer(&rcu_defer_mutex);
+	cds_list_for_each_entry(index, &registry_defer, list) {
+		info.tid = index->tid;
+		info.fill = CMM_LOAD_SHARED(index->head) - index->tail;
+		info.size = index->mask + 1;
+		func(&info, priv);
+	}
+	mutex_unlock(&rcu_defer_mutex);
+}
+
+/* Account the queues of the registered threads, for rcu_get_mem_stats(). */
+static void rcu_defer_get_mem_stats(struct urcu_mem_stats *stats)
+{
+	struct defer_queue *index;
+
+	mutex_lock_defer(&rcu_defer_mutex);
+	cds_list_for_each_entry(index, &registry_defer, list) {
+		stats->defer_bytes += (index->mask + 1) * sizeof(*index->q);
+		stats->defer_pending += CMM_LOAD_SHARED(index->head) - index->tail;
+	}
+	mutex_unlock(&rcu_defer_mutex);
+}
+
 void rcu_defer_exit(void)
 {
 	assert(cds_list_empty(&registry_defer));
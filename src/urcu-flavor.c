@@ -0,0 +1,79 @@
+/*
+ * urcu-flavor.c
+ *
+ * Userspace RCU library - grace periods across several flavors
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+#include <poll.h>
+
+#include <urcu/arch.h>
+#include <urcu/flavor.h>
+
+/* Flavors handled at once, and busy-loop attempts before sleeping. */
+#define SYNC_FLAVORS_BATCH	8
+#define SYNC_FLAVORS_ATTEMPTS	1000
+#define SYNC_FLAVORS_WAIT	1	/* Wait 1ms before polling again. */
+
+static void sync_flavors(const struct rcu_flavor_struct * const *flavors,
+		unsigned int nr)
+{
+	unsigned long cookies[SYNC_FLAVORS_BATCH];
+	int was_online[SYNC_FLAVORS_BATCH];
+	unsigned int i, attempt = 0;
+
+	/*
+	 * The call_rcu worker threads of the other flavors run their
+	 * grace periods while this thread runs the one of the first.
+	 */
+	for (i = 1; i < nr; i++)
+		cookies[i] = flavors[i]->update_start_poll_synchronize_rcu();
+	/*
+	 * Stay offline for QSBR flavors until all grace periods are over:
+	 * this thread would otherwise hold the concurrent ones back.
+	 */
+	for (i = 0; i < nr; i++) {
+		was_online[i] = flavors[i]->read_ongoing();
+		if (was_online[i])
+			flavors[i]->thread_offline();
+	}
+	flavors[0]->update_synchronize_rcu();
+	for (i = 1; i < nr; i++) {
+		while (!flavors[i]->update_poll_state_synchronize_rcu(cookies[i])) {
+			if (++attempt >= SYNC_FLAVORS_ATTEMPTS) {
+				(void) poll(NULL, 0, SYNC_FLAVORS_WAIT);
+				attempt = 0;
+			} else {
+				caa_cpu_relax();
+			}
+		}
+	}
+	for (i = nr; i > 0; i--) {
+		if (was_online[i - 1])
+			flavors[i - 1]->thread_online();
+	}
+}
+
+void urcu_synchronize_rcu_flavors(const struct rcu_flavor_struct * const *flavors,
+		unsigned int nr)
+{
+	unsigned int n;
+
+	for (; nr; flavors += n, nr -= n) {
+		n = nr < SYNC_FLAVORS_BATCH ? nr : SYNC_FLAVORS_BATCH;
+		sync_flavors(flavors, n);
+	}
+}
@@ -0,0 +1,140 @@
+#ifndef _URCU_GP_COALESCE_H
+#define _URCU_GP_COALESCE_H
+
+/*
+ * urcu-gp-coalesce.h
+ *
+ * Userspace RCU library - grace-period coalescing window
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+/*
+ * Under a storm of synchronize_rcu() callers, the callers which queue
+ * just after a grace period has started wait for that one and for the
+ * next. Holding the start of each grace period for a short window lets
+ * more callers share it, trading their latency for fewer grace periods.
+ *
+ * Every caller counts itself after queuing its wait node. The thread
+ * about to perform the grace period, leader or grace-period thread,
+ * waits until the window has elapsed since it started waiting, or
+ * until enough callers are counted, whichever comes first. The count
+ * is reset before the queued callers are moved, so that callers queued
+ * in between can only start the next grace period earlier.
+ */
+
+#include <errno.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <time.h>
+#include <urcu/uatomic.h>
+#include <urcu/futex.h>
+#include "urcu-die.h"
+#include "urcu-stats.h"
+
+/* Longest coalescing window, in microseconds. */
+#define URCU_GP_COALESCE_MAX_DELAY_US	1000000UL
+
+struct urcu_gp_coalesce {
+	unsigned long delay_us;		/* 0: disabled. */
+	unsigned long nr_waiters;	/* 0: wait for the whole window. */
+	unsigned long nr_queued;
+	int32_t futex;			/* -1 while the leader waits. */
+};
+
+static inline
+int urcu_gp_coalesce_set(struct urcu_gp_coalesce *coalesce,
+		unsigned long delay_us, unsigned long nr_waiters)
+{
+	if (delay_us > URCU_GP_COALESCE_MAX_DELAY_US)
+		return -EINVAL;
+	uatomic_set(&coalesce->nr_waiters, nr_waiters);
+	uatomic_set(&coalesce->nr_queued, 0);
+	uatomic_set(&coalesce->delay_us, delay_us);
+	return 0;
+}
+
+static inline
+bool urcu_gp_coalesce_full(struct urcu_gp_coalesce *coalesce)
+{
+	unsigned long nr_waiters = uatomic_read(&coalesce->nr_waiters);
+
+	return nr_waiters && uatomic_read(&coalesce->nr_queued) >= nr_waiters;
+}
+
+/*
+ * Called by every caller after adding itself to the queue.
+ */
+static inline
+void urcu_gp_coalesce_arrive(struct urcu_gp_coalesce *coalesce)
+{
+	if (caa_likely(!uatomic_read(&coalesce->delay_us)))
+		return;
+	uatomic_inc(&coalesce->nr_queued);
+	/* The increment is ordered before reading futex. */
+	cmm_smp_mb();
+	if (urcu_gp_coalesce_full(coalesce)
+			&& uatomic_read(&coalesce->futex) == -1) {
+		uatomic_set(&coalesce->futex, 0);
+		if (futex_async(&coalesce->futex, FUTEX_WAKE_PRIVATE, 1,
+				NULL, NULL, 0) < 0)
+			urcu_die(errno);
+	}
+}
+
+/*
+ * Called before moving the queued callers, without holding the
+ * grace-period lock, so that callers queuing meanwhile join the batch.
+ */
+static inline
+void urcu_gp_coalesce_wait(struct urcu_gp_coalesce *coalesce)
+{
+	unsigned long delay_us = uatomic_read(&coalesce->delay_us);
+	uint64_t now, deadline;
+	struct timespec timeout;
+
+	if (caa_likely(!delay_us))
+		return;
+	now = urcu_stats_now_ns();
+	deadline = now + (uint64_t) delay_us * 1000;
+	while (now < deadline) {
+		uatomic_set(&coalesce->futex, -1);
+		/* Write futex before reading the count. */
+		cmm_smp_mb();
+		if (urcu_gp_coalesce_full(coalesce))
+			break;
+		timeout.tv_sec = (deadline - now) / 1000000000ULL;
+		timeout.tv_nsec = (deadline - now) % 1000000000ULL;
+		if (futex_async(&coalesce->futex, FUTEX_WAIT_PRIVATE, -1,
+				&timeout, NULL, 0)) {
+			switch (errno) {
+			case EWOULDBLOCK:
+				/* Value already changed. */
+			case EINTR:
+				/* Retry if interrupted by signal. */
+			case ETIMEDOUT:
+				break;	/* Get out of switch. */
+			default:
+				/* Unexpected error. */
+				urcu_die(errno);
+			}
+		}
+		now = urcu_stats_now_ns();
+	}
+	uatomic_set(&coalesce->futex, 0);
+	uatomic_set(&coalesce->nr_queued, 0);
+}
+
+#endif /* _URCU_GP_COALESCE_H */
@@ -0,0 +1,91 @@
+#ifndef _URCU_GP_SEQ_H
+#define _URCU_GP_SEQ_H
+
+/*
+ * urcu-gp-seq.h
+ *
+ * Userspace RCU library grace-period sequence counter
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+#include <urcu/arch.h>
+#include <urcu/system.h>
+
+/*
+ * The grace-period sequence counter is incremented once when a grace
+ * period starts and once when it completes. An odd value therefore
+ * means a grace period is in progress. It is only written by the
+ * thread performing the grace period, with rcu_gp_lock held.
+ *
+ * Cookies returned by urcu_gp_seq_snap() are compared with wrap-around
+ * safe arithmetic.
+ */
+#define URCU_GP_SEQ_STATE_MASK	1UL
+
+#define URCU_GP_SEQ_GE(a, b)	((long) ((a) - (b)) >= 0)
+
+/*
+ * Mark the beginning of a grace period. The sequence update is ordered
+ * before the accesses to reader state done to detect quiescence.
+ */
+static inline
+void urcu_gp_seq_start(unsigned long *seq)
+{
+	CMM_STORE_SHARED(*seq, *seq + 1);
+	cmm_smp_mb();
+}
+
+/*
+ * Mark the end of a grace period. The accesses to reader state done to
+ * detect quiescence are ordered before the sequence update.
+ */
+static inline
+void urcu_gp_seq_end(unsigned long *seq)
+{
+	cmm_smp_mb();
+	CMM_STORE_SHARED(*seq, *seq + 1);
+}
+
+/*
+ * Return the sequence value that will be reached once a full grace
+ * period, starting after this call, has completed. Prior memory
+ * accesses are ordered before the snapshot.
+ */
+static inline
+unsigned long urcu_gp_seq_snap(unsigned long *seq)
+{
+	unsigned long s;
+
+	cmm_smp_mb();
+	s = CMM_LOAD_SHARED(*seq);
+	return (s + 2 * URCU_GP_SEQ_STATE_MASK + 1) & ~URCU_GP_SEQ_STATE_MASK;
+}
+
+/*
+ * Return non-zero if the grace period identified by cookie has
+ * completed. On success, following memory accesses are ordered after
+ * the end of that grace period.
+ */
+static inline
+int urcu_gp_seq_done(unsigned long *seq, unsigned long cookie)
+{
+	if (!URCU_GP_SEQ_GE(CMM_LOAD_SHARED(*seq), cookie))
+		return 0;
+	cmm_smp_mb();
+	return 1;
+}
+
+#endif /* _URCU_GP_SEQ_H */
@@ -0,0 +1,220 @@
+#ifndef _URCU_GP_THREAD_IMPL_H
+#define _URCU_GP_THREAD_IMPL_H
+
+/*
+ * urcu-gp-thread.h
+ *
+ * Userspace RCU library - dedicated grace-period thread
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+/*
+ * While the grace-period thread runs, synchronize_rcu() callers only
+ * queue their wait node and park on it: the first caller to find the
+ * queue empty wakes the thread, which runs grace periods back to back
+ * for as long as callers queue, each one for all the callers queued
+ * before it starts.
+ *
+ * Parked callers are woken by whichever thread moves them out of the
+ * queue. Callers which find the thread stopped perform the grace
+ * period themselves, and the thread being stopped leaves the callers
+ * it has not moved yet to rcu_gp_thread_stop(), so no caller is left
+ * behind.
+ */
+
+#include <errno.h>
+#include <limits.h>
+#include <pthread.h>
+#include <sched.h>
+#include <urcu/uatomic.h>
+#include <urcu/futex.h>
+#include "urcu-die.h"
+#include "urcu-wait.h"
+
+struct urcu_gp_thread {
+	pthread_mutex_t lock;		/* Serializes start and stop. */
+	pthread_t tid;
+	int cpu_affinity;		/* -1 if not pinned. */
+	int enabled;			/* Read by synchronize_rcu(). */
+	int stop;
+	int32_t futex;			/* -1 while the thread waits. */
+	struct urcu_wait_queue *queue;
+	/* Grace period for all waiters of queue, waking them. */
+	void (*synchronize_waiters)(void);
+};
+
+#define URCU_GP_THREAD_INIT(_queue, _synchronize_waiters)	\
+	{							\
+		.lock = PTHREAD_MUTEX_INITIALIZER,		\
+		.cpu_affinity = -1,				\
+		.queue = (_queue),				\
+		.synchronize_waiters = (_synchronize_waiters),	\
+	}
+
+static inline
+bool urcu_gp_thread_has_waiters(struct urcu_gp_thread *gp_thread)
+{
+	return !cds_wfs_empty(&gp_thread->queue->stack);
+}
+
+/*
+ * Called by the first waiter, after adding itself to the queue.
+ * Returns true if the grace-period thread will move it out of the
+ * queue, false if the caller has to perform the grace period.
+ */
+static inline
+bool urcu_gp_thread_kick(struct urcu_gp_thread *gp_thread)
+{
+	/* The queue push is a full barrier: read enabled after it. */
+	if (caa_likely(!uatomic_read(&gp_thread->enabled)))
+		return false;
+	if (uatomic_read(&gp_thread->futex) == -1) {
+		uatomic_set(&gp_thread->futex, 0);
+		if (futex_async(&gp_thread->futex, FUTEX_WAKE_PRIVATE, 1,
+				NULL, NULL, 0) < 0)
+			urcu_die(errno);
+	}
+	return true;
+}
+
+static inline
+void urcu_gp_thread_wait(struct urcu_gp_thread *gp_thread)
+{
+	uatomic_set(&gp_thread->futex, -1);
+	/* Write futex before reading the queue and stop. */
+	cmm_smp_mb();
+	if (!urcu_gp_thread_has_waiters(gp_thread)
+			&& !uatomic_read(&gp_thread->stop)) {
+		if (futex_async(&gp_thread->futex, FUTEX_WAIT_PRIVATE, -1,
+				NULL, NULL, 0)) {
+			switch (errno) {
+			case EWOULDBLOCK:
+				/* Value already changed. */
+			case EINTR:
+				/* Retry if interrupted by signal. */
+				break;	/* Get out of switch. */
+			default:
+				/* Unexpected error. */
+				urcu_die(errno);
+			}
+		}
+	}
+	uatomic_set(&gp_thread->futex, 0);
+}
+
+static inline
+void urcu_gp_thread_set_affinity(struct urcu_gp_thread *gp_thread)
+{
+#if HAVE_SCHED_SETAFFINITY
+	cpu_set_t mask;
+	int ret;
+
+	if (gp_thread->cpu_affinity < 0)
+		return;
+	CPU_ZERO(&mask);
+	CPU_SET(gp_thread->cpu_affinity, &mask);
+#if SCHED_SETAFFINITY_ARGS == 2
+	ret = sched_setaffinity(0, &mask);
+#else
+	ret = sched_setaffinity(0, sizeof(mask), &mask);
+#endif
+	/* EINVAL is fine: the CPU may be offline or outside our cpuset. */
+	if (ret && errno != EINVAL)
+		urcu_die(errno);
+#endif
+}
+
+static inline
+void *urcu_gp_thread_fn(void *arg)
+{
+	struct urcu_gp_thread *gp_thread = arg;
+
+	urcu_gp_thread_set_affinity(gp_thread);
+	for (;;) {
+		urcu_gp_thread_wait(gp_thread);
+		if (uatomic_read(&gp_thread->stop))
+			break;
+		while (urcu_gp_thread_has_waiters(gp_thread))
+			gp_thread->synchronize_waiters();
+	}
+	return NULL;
+}
+
+static inline
+int urcu_gp_thread_start(struct urcu_gp_thread *gp_thread, int cpu_affinity)
+{
+	int ret, err;
+
+	ret = pthread_mutex_lock(&gp_thread->lock);
+	if (ret)
+		urcu_die(ret);
+	if (gp_thread->enabled) {
+		ret = -EBUSY;
+		goto end;
+	}
+	gp_thread->cpu_affinity = cpu_affinity;
+	gp_thread->stop = 0;
+	ret = pthread_create(&gp_thread->tid, NULL, urcu_gp_thread_fn,
+			gp_thread);
+	if (ret) {
+		ret = -ret;
+		goto end;
+	}
+	uatomic_set(&gp_thread->enabled, 1);
+end:
+	err = pthread_mutex_unlock(&gp_thread->lock);
+	if (err)
+		urcu_die(err);
+	return ret;
+}
+
+static inline
+int urcu_gp_thread_stop(struct urcu_gp_thread *gp_thread)
+{
+	int ret, err;
+
+	ret = pthread_mutex_lock(&gp_thread->lock);
+	if (ret)
+		urcu_die(ret);
+	if (!gp_thread->enabled) {
+		ret = -EINVAL;
+		goto end;
+	}
+	uatomic_set(&gp_thread->enabled, 0);
+	/* Write enabled before stop, and before reading the queue. */
+	cmm_smp_mb();
+	uatomic_set(&gp_thread->stop, 1);
+	cmm_smp_mb();
+	if (uatomic_read(&gp_thread->futex) == -1) {
+		uatomic_set(&gp_thread->futex, 0);
+		if (futex_async(&gp_thread->futex, FUTEX_WAKE_PRIVATE, 1,
+				NULL, NULL, 0) < 0)
+			urcu_die(errno);
+	}
+	ret = pthread_join(gp_thread->tid, NULL);
+	if (ret)
+		urcu_die(ret);
+	/* Callers which saw the thread enabled but were not moved. */
+	while (urcu_gp_thread_has_waiters(gp_thread))
+		gp_thread->synchronize_waiters();
+end:
+	err = pthread_mutex_unlock(&gp_thread->lock);
+	if (err)
+		urcu_die(err);
+	return ret;
+}
+
+#endif /* _URCU_GP_THREAD_IMPL_H */
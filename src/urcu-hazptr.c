@@ -0,0 +1,294 @@
+/*
+ * urcu-hazptr.c
+ *
+ * Userspace RCU library - Hazard-pointer memory reclamation
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+/*
+ * Records are pushed on a list of the domain, and only freed with the
+ * domain: scans traverse the list without locking. A scan orders the
+ * unlinking of the objects it may reclaim before its reads of the
+ * hazard slots, with a memory barrier or a membarrier system call. A
+ * reader publishing a slot after the scan read it then sees the object
+ * unlinked when it checks its pointer again.
+ */
+
+#define _LGPL_SOURCE
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <pthread.h>
+
+#include <urcu/compiler.h>
+#include <urcu/arch.h>
+#include <urcu/uatomic.h>
+#include <urcu/syscall-compat.h>
+#include <urcu/hazptr.h>
+#include <urcu/cache-line.h>
+
+#include "urcu-die.h"
+
+/* If the headers do not support membarrier system call, fall back smp_mb. */
+#ifdef __NR_membarrier
+# define membarrier(...)		syscall(__NR_membarrier, __VA_ARGS__)
+#else
+# define membarrier(...)		-ENOSYS
+#endif
+
+enum membarrier_cmd {
+	MEMBARRIER_CMD_QUERY				= 0,
+	MEMBARRIER_CMD_SHARED				= (1 << 0),
+	/* reserved for MEMBARRIER_CMD_SHARED_EXPEDITED (1 << 1) */
+	/* reserved for MEMBARRIER_CMD_PRIVATE (1 << 2) */
+	MEMBARRIER_CMD_PRIVATE_EXPEDITED		= (1 << 3),
+	MEMBARRIER_CMD_REGISTER_PRIVATE_EXPEDITED	= (1 << 4),
+};
+
+#define HAZPTR_DEFAULT_SCAN_THRESHOLD	64
+
+struct hazptr_rec {
+	struct urcu_hazptr_rec pub;
+	struct hazptr_rec *next;	/* Domain list. */
+	int active;			/* ATOMIC: owned by a thread. */
+	int scanning;
+	struct urcu_hazptr_head *retired;
+	unsigned long nr_retired;
+	void **hazards;			/* Scan buffer. */
+	unsigned long hazards_len;
+} __attribute__((aligned(CAA_CACHE_LINE_SIZE)));
+
+struct urcu_hazptr_domain {
+	struct hazptr_rec *recs;	/* ATOMIC: push only. */
+	unsigned long nr_recs;		/* ATOMIC */
+	unsigned long scan_threshold;
+	int sys_membarrier;
+	pthread_key_t key;
+};
+
+static struct hazptr_rec *to_rec(struct urcu_hazptr_rec *pub)
+{
+	return caa_container_of(pub, struct hazptr_rec, pub);
+}
+
+static void smp_mb_master(struct urcu_hazptr_domain *domain)
+{
+	if (caa_likely(domain->sys_membarrier)) {
+		if (membarrier(MEMBARRIER_CMD_PRIVATE_EXPEDITED, 0))
+			urcu_die(errno);
+	} else {
+		cmm_smp_mb();
+	}
+}
+
+static int hazard_cmp(const void *a, const void *b)
+{
+	const void *pa = *(void * const *) a, *pb = *(void * const *) b;
+
+	if (pa < pb)
+		return -1;
+	return pa > pb;
+}
+
+/* Copy all non-NULL hazard slots of the domain into the scan buffer. */
+static unsigned long read_hazards(struct hazptr_rec *rec)
+{
+	struct urcu_hazptr_domain *domain = rec->pub.domain;
+	unsigned long nr = 0;
+	struct hazptr_rec *r;
+	unsigned int i;
+
+	for (r = CMM_LOAD_SHARED(domain->recs); r; r = CMM_LOAD_SHARED(r->next)) {
+		cmm_smp_read_barrier_depends();
+		if (rec->hazards_len - nr < URCU_HAZPTR_NR_SLOTS) {
+			unsigned long len = 2 * rec->hazards_len
+				+ URCU_HAZPTR_NR_SLOTS;
+			void **hazards;
+
+			hazards = realloc(rec->hazards, len * sizeof(*hazards));
+			if (!hazards)
+				urcu_die(ENOMEM);
+			rec->hazards = hazards;
+			rec->hazards_len = len;
+		}
+		for (i = 0; i < URCU_HAZPTR_NR_SLOTS; i++) {
+			void *p = CMM_LOAD_SHARED(r->pub.slots[i]);
+
+			if (p)
+				rec->hazards[nr++] = p;
+		}
+	}
+	return nr;
+}
+
+/*
+ * Reclaim the retired objects of @rec which no hazard slot holds.
+ * Reclaim callbacks may retire objects: they are queued for the next
+ * scan.
+ */
+static void hazptr_scan(struct hazptr_rec *rec)
+{
+	struct urcu_hazptr_head *head, *next;
+	unsigned long nr_hazards;
+
+	rec->scanning = 1;
+	head = rec->retired;
+	rec->retired = NULL;
+	rec->nr_retired = 0;
+	/* Order the unlinking of retired objects before reading slots. */
+	smp_mb_master(rec->pub.domain);
+	nr_hazards = read_hazards(rec);
+	qsort(rec->hazards, nr_hazards, sizeof(*rec->hazards), hazard_cmp);
+	for (; head; head = next) {
+		next = head->next;
+		if (nr_hazards && bsearch(&head->ptr, rec->hazards, nr_hazards,
+				sizeof(*rec->hazards), hazard_cmp)) {
+			head->next = rec->retired;
+			rec->retired = head;
+			rec->nr_retired++;
+		} else {
+			head->func(head);
+		}
+	}
+	rec->scanning = 0;
+}
+
+static void thread_release(void *arg)
+{
+	struct hazptr_rec *rec = arg;
+	unsigned int i;
+
+	for (i = 0; i < URCU_HAZPTR_NR_SLOTS; i++)
+		urcu_hazptr_clear(&rec->pub, i);
+	if (rec->nr_retired)
+		hazptr_scan(rec);
+	/* The next owner inherits the objects still retired. */
+	uatomic_store_release(&rec->active, 0);
+}
+
+struct urcu_hazptr_domain *urcu_hazptr_domain_create(
+		unsigned long scan_threshold, unsigned int flags)
+{
+	struct urcu_hazptr_domain *domain;
+	int mask;
+
+	domain = calloc(1, sizeof(*domain));
+	if (!domain)
+		return NULL;
+	if (pthread_key_create(&domain->key, thread_release)) {
+		free(domain);
+		return NULL;
+	}
+	domain->scan_threshold = scan_threshold ? :
+		HAZPTR_DEFAULT_SCAN_THRESHOLD;
+	if (flags & URCU_HAZPTR_SYS_MEMBARRIER) {
+		mask = membarrier(MEMBARRIER_CMD_QUERY, 0);
+		if (mask >= 0 && (mask & MEMBARRIER_CMD_PRIVATE_EXPEDITED)
+				&& !membarrier(MEMBARRIER_CMD_REGISTER_PRIVATE_EXPEDITED, 0))
+			domain->sys_membarrier = 1;
+	}
+	return domain;
+}
+
+void urcu_hazptr_domain_destroy(struct urcu_hazptr_domain *domain)
+{
+	struct urcu_hazptr_head *head, *next;
+	struct hazptr_rec *rec, *rec_next;
+	int ret;
+
+	ret = pthread_key_delete(domain->key);
+	if (ret)
+		urcu_die(ret);
+	for (rec = domain->recs; rec; rec = rec_next) {
+		rec_next = rec->next;
+		for (head = rec->retired; head; head = next) {
+			next = head->next;
+			head->func(head);
+		}
+		free(rec->hazards);
+		free(rec);
+	}
+	free(domain);
+}
+
+struct urcu_hazptr_rec *urcu_hazptr_rec_get(struct urcu_hazptr_domain *domain)
+{
+	struct hazptr_rec *rec, *head, *old;
+	int ret;
+
+	rec = pthread_getspecific(domain->key);
+	if (caa_likely(rec))
+		return &rec->pub;
+	/* Reuse the record of an exited thread. */
+	for (rec = CMM_LOAD_SHARED(domain->recs); rec; rec = rec->next) {
+		if (!uatomic_read(&rec->active)
+				&& !uatomic_cmpxchg(&rec->active, 0, 1))
+			goto found;
+	}
+	rec = caa_cache_line_alloc(sizeof(*rec));
+	if (!rec)
+		urcu_die(errno);
+	memset(rec, 0, sizeof(*rec));
+	rec->pub.sys_membarrier = domain->sys_membarrier;
+	rec->pub.domain = domain;
+	rec->active = 1;
+	uatomic_inc(&domain->nr_recs);
+	head = CMM_LOAD_SHARED(domain->recs);
+	for (;;) {
+		rec->next = head;
+		old = uatomic_cmpxchg(&domain->recs, head, rec);
+		if (old == head)
+			break;
+		head = old;
+	}
+found:
+	ret = pthread_setspecific(domain->key, rec);
+	if (ret)
+		urcu_die(ret);
+	return &rec->pub;
+}
+
+void urcu_hazptr_retire(struct urcu_hazptr_rec *pub,
+		struct urcu_hazptr_head *head, void *ptr,
+		void (*func)(struct urcu_hazptr_head *head))
+{
+	struct hazptr_rec *rec = to_rec(pub);
+	struct urcu_hazptr_domain *domain = pub->domain;
+
+	head->ptr = ptr;
+	head->func = func;
+	head->next = rec->retired;
+	rec->retired = head;
+	rec->nr_retired++;
+	/*
+	 * Each scan keeps at most one object per hazard slot, and
+	 * reclaims at least scan_threshold objects.
+	 */
+	if (rec->nr_retired >= domain->scan_threshold
+			+ uatomic_read(&domain->nr_recs) * URCU_HAZPTR_NR_SLOTS
+			&& !rec->scanning)
+		hazptr_scan(rec);
+}
+
+unsigned long urcu_hazptr_reclaim(struct urcu_hazptr_rec *pub)
+{
+	struct hazptr_rec *rec = to_rec(pub);
+
+	if (!rec->scanning)
+		hazptr_scan(rec);
+	return rec->nr_retired;
+}
@@ -0,0 +1,55 @@
+#ifndef _URCU_HUGEPAGE_H
+#define _URCU_HUGEPAGE_H
+
+/*
+ * urcu-hugepage.h
+ *
+ * Userspace RCU library - transparent huge page size
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+#include <stdio.h>
+#include <stddef.h>
+
+#define URCU_HUGEPAGE_DEFAULT_SIZE	(2UL << 20)
+
+/*
+ * Return the size of the huge pages backing transparent huge pages, or
+ * URCU_HUGEPAGE_DEFAULT_SIZE if unknown. Read once from sysfs: racing
+ * first callers read the same value.
+ */
+static inline
+size_t urcu_hugepage_size(void)
+{
+	static size_t hugepage_size;
+	unsigned long size = 0;
+	FILE *fp;
+
+	if (hugepage_size)
+		return hugepage_size;
+	fp = fopen("/sys/kernel/mm/transparent_hugepage/hpage_pmd_size", "r");
+	if (fp) {
+		if (fscanf(fp, "%lu", &size) != 1)
+			size = 0;
+		(void) fclose(fp);
+	}
+	if (!size || (size & (size - 1)))
+		size = URCU_HUGEPAGE_DEFAULT_SIZE;
+	hugepage_size = size;
+	return size;
+}
+
+#endif /* _URCU_HUGEPAGE_H */
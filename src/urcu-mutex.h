@@ -0,0 +1,136 @@
+#ifndef _URCU_MUTEX_H
+#define _URCU_MUTEX_H
+
+/*
+ * urcu-mutex.h
+ *
+ * Userspace RCU library - internal mutexes with contention statistics
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+#include <errno.h>
+#include <pthread.h>
+#include <stdint.h>
+#include <time.h>
+
+#include <urcu/compiler.h>
+#include <urcu/arch.h>
+#include <urcu/system.h>
+#include <urcu/stats.h>
+
+#include "urcu-die.h"
+#include "urcu-stats.h"
+
+/*
+ * Lock statistics are only written with their mutex held, so plain
+ * increments published with CMM_STORE_SHARED() are enough. The clock
+ * is only read on contention: an uncontended acquisition costs a
+ * trylock and an increment.
+ */
+static inline
+void urcu_mutex_acquired(struct urcu_lock_stats *stats, int contended,
+		uint64_t start)
+{
+	uint64_t wait;
+
+	if (!stats)
+		return;
+	CMM_STORE_SHARED(stats->acquisitions, stats->acquisitions + 1);
+	if (caa_likely(!contended))
+		return;
+	wait = urcu_stats_now_ns() - start;
+	CMM_STORE_SHARED(stats->contended, stats->contended + 1);
+	CMM_STORE_SHARED(stats->wait_ns, stats->wait_ns + wait);
+	if (wait > stats->wait_max_ns)
+		CMM_STORE_SHARED(stats->wait_max_ns, wait);
+}
+
+static inline
+int urcu_mutex_trylock(pthread_mutex_t *mutex)
+{
+	int ret;
+
+	ret = pthread_mutex_trylock(mutex);
+	if (ret && ret != EBUSY && ret != EINTR)
+		urcu_die(ret);
+	return ret;
+}
+
+/*
+ * urcu_mutex_lock - lock mutex, accounting to stats if not NULL.
+ */
+static inline
+void urcu_mutex_lock(pthread_mutex_t *mutex, struct urcu_lock_stats *stats)
+{
+	uint64_t start;
+	int ret;
+
+	if (caa_likely(!urcu_mutex_trylock(mutex))) {
+		urcu_mutex_acquired(stats, 0, 0);
+		return;
+	}
+	start = urcu_stats_now_ns();
+	ret = pthread_mutex_lock(mutex);
+	if (ret)
+		urcu_die(ret);
+	urcu_mutex_acquired(stats, 1, start);
+}
+
+/*
+ * Adaptive polling of a contended mutex: spin on trylock a few times,
+ * then sleep for delays doubling from 1us up to
+ * URCU_MUTEX_POLL_MAX_US, so that short critical sections are not
+ * waited for a full scheduler tick.
+ */
+#define URCU_MUTEX_SPIN_TRIES		100
+#define URCU_MUTEX_POLL_MAX_US		1000
+
+/*
+ * urcu_mutex_lock_poll - lock mutex without blocking in
+ * pthread_mutex_lock(), calling poll_fct between attempts if not NULL,
+ * e.g. to answer the memory barrier requests of a grace period the
+ * owner waits for.
+ */
+static inline
+void urcu_mutex_lock_poll(pthread_mutex_t *mutex,
+		struct urcu_lock_stats *stats, void (*poll_fct)(void))
+{
+	struct timespec delay = { 0, 1000 };
+	unsigned int i;
+	uint64_t start;
+
+	if (caa_likely(!urcu_mutex_trylock(mutex))) {
+		urcu_mutex_acquired(stats, 0, 0);
+		return;
+	}
+	start = urcu_stats_now_ns();
+	for (i = 0; ; i++) {
+		if (poll_fct)
+			poll_fct();
+		if (!urcu_mutex_trylock(mutex))
+			break;
+		if (i < URCU_MUTEX_SPIN_TRIES) {
+			caa_cpu_relax();
+			continue;
+		}
+		(void) nanosleep(&delay, NULL);
+		if (delay.tv_nsec < URCU_MUTEX_POLL_MAX_US * 1000L)
+			delay.tv_nsec <<= 1;
+	}
+	urcu_mutex_acquired(stats, 1, start);
+}
+
+#endif /* _URCU_MUTEX_H */
@@ -0,0 +1,246 @@
+/*
+ * urcu-percpu-ref.c
+ *
+ * Userspace RCU library - Per-CPU reference counter
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+/*
+ * While the reference is alive, the atomic counter holds the initial
+ * reference plus PERCPU_REF_BIAS, so that puts switching over to it
+ * during the kill grace period never bring it to zero. The per-CPU
+ * counters are unsigned: a get on one CPU and a put on another wrap
+ * around, and only their sum is meaningful. Once no reader can see the
+ * per-CPU mode anymore, that sum replaces the bias.
+ */
+
+#define _LGPL_SOURCE
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <assert.h>
+#include <unistd.h>
+#include <pthread.h>
+
+#include <urcu/compiler.h>
+#include <urcu/uatomic.h>
+#include <urcu/call-rcu.h>
+#include <urcu/flavor.h>
+#include <urcu/percpu-ref.h>
+
+#include "compat-getcpu.h"
+
+#define PERCPU_REF_DEAD		1UL
+#define PERCPU_REF_BIAS		(1UL << (CAA_BITS_PER_LONG - 1))
+
+struct percpu_ref_cpu {
+	unsigned long count;
+} __attribute__((aligned(CAA_CACHE_LINE_SIZE)));
+
+struct urcu_percpu_ref_data {
+	unsigned long count;		/* ATOMIC */
+	void (*release)(struct urcu_percpu_ref *ref);
+	const struct rcu_flavor_struct *flavor;
+	struct urcu_percpu_ref *ref;
+	struct percpu_ref_cpu *percpu;
+	struct rcu_head head;
+};
+
+static long percpu_ref_nr_cpus;
+static pthread_once_t percpu_ref_init_once = PTHREAD_ONCE_INIT;
+
+static void percpu_ref_init_nr_cpus(void)
+{
+	percpu_ref_nr_cpus = sysconf(_SC_NPROCESSORS_CONF);
+	if (percpu_ref_nr_cpus <= 0)
+		percpu_ref_nr_cpus = 1;
+}
+
+/*
+ * The CPU number only selects which counter is updated: a thread
+ * migrated after reading it still updates a valid counter.
+ */
+static struct percpu_ref_cpu *this_cpu(unsigned long percpu_ptr)
+{
+	struct percpu_ref_cpu *percpu = (struct percpu_ref_cpu *) percpu_ptr;
+	int cpu;
+
+	cpu = urcu_sched_getcpu();
+	if (caa_unlikely(cpu < 0))
+		cpu = 0;
+	return &percpu[cpu % percpu_ref_nr_cpus];
+}
+
+int urcu_percpu_ref_init_flavor(struct urcu_percpu_ref *ref,
+		void (*release)(struct urcu_percpu_ref *ref),
+		const struct rcu_flavor_struct *flavor)
+{
+	struct urcu_percpu_ref_data *data;
+	struct percpu_ref_cpu *percpu;
+
+	(void) pthread_once(&percpu_ref_init_once, percpu_ref_init_nr_cpus);
+	data = calloc(1, sizeof(*data));
+	if (!data)
+		return -ENOMEM;
+	if (posix_memalign((void **) &percpu, CAA_CACHE_LINE_SIZE,
+			percpu_ref_nr_cpus * sizeof(*percpu))) {
+		free(data);
+		return -ENOMEM;
+	}
+	memset(percpu, 0, percpu_ref_nr_cpus * sizeof(*percpu));
+	data->count = 1 + PERCPU_REF_BIAS;
+	data->release = release;
+	data->flavor = flavor;
+	data->ref = ref;
+	data->percpu = percpu;
+	ref->data = data;
+	ref->percpu_ptr = (unsigned long) percpu;
+	return 0;
+}
+
+void urcu_percpu_ref_exit(struct urcu_percpu_ref *ref)
+{
+	struct urcu_percpu_ref_data *data = ref->data;
+
+	if (!data)
+		return;
+	/* The kill callback already freed the per-CPU counters. */
+	if (!(ref->percpu_ptr & PERCPU_REF_DEAD))
+		free(data->percpu);
+	free(data);
+	ref->data = NULL;
+	ref->percpu_ptr = PERCPU_REF_DEAD;
+}
+
+void urcu_percpu_ref_get(struct urcu_percpu_ref *ref)
+{
+	struct urcu_percpu_ref_data *data = ref->data;
+	unsigned long percpu_ptr;
+
+	data->flavor->read_lock();
+	percpu_ptr = CMM_LOAD_SHARED(ref->percpu_ptr);
+	if (caa_likely(!(percpu_ptr & PERCPU_REF_DEAD)))
+		uatomic_inc(&this_cpu(percpu_ptr)->count);
+	else
+		uatomic_inc(&data->count);
+	data->flavor->read_unlock();
+}
+
+/* Take a reference in atomic mode, unless the count is zero. */
+static bool atomic_tryget(struct urcu_percpu_ref_data *data)
+{
+	unsigned long old, res;
+
+	old = uatomic_read(&data->count);
+	for (;;) {
+		if (!old)
+			return false;
+		res = uatomic_cmpxchg(&data->count, old, old + 1);
+		if (res == old)
+			return true;
+		old = res;
+	}
+}
+
+bool urcu_percpu_ref_tryget(struct urcu_percpu_ref *ref)
+{
+	struct urcu_percpu_ref_data *data = ref->data;
+	unsigned long percpu_ptr;
+	bool ret = true;
+
+	data->flavor->read_lock();
+	percpu_ptr = CMM_LOAD_SHARED(ref->percpu_ptr);
+	if (caa_likely(!(percpu_ptr & PERCPU_REF_DEAD)))
+		uatomic_inc(&this_cpu(percpu_ptr)->count);
+	else
+		ret = atomic_tryget(data);
+	data->flavor->read_unlock();
+	return ret;
+}
+
+bool urcu_percpu_ref_tryget_live(struct urcu_percpu_ref *ref)
+{
+	struct urcu_percpu_ref_data *data = ref->data;
+	unsigned long percpu_ptr;
+	bool ret = false;
+
+	data->flavor->read_lock();
+	percpu_ptr = CMM_LOAD_SHARED(ref->percpu_ptr);
+	if (caa_likely(!(percpu_ptr & PERCPU_REF_DEAD))) {
+		uatomic_inc(&this_cpu(percpu_ptr)->count);
+		ret = true;
+	}
+	data->flavor->read_unlock();
+	return ret;
+}
+
+void urcu_percpu_ref_put(struct urcu_percpu_ref *ref)
+{
+	struct urcu_percpu_ref_data *data = ref->data;
+	unsigned long percpu_ptr;
+	bool release = false;
+
+	data->flavor->read_lock();
+	percpu_ptr = CMM_LOAD_SHARED(ref->percpu_ptr);
+	if (caa_likely(!(percpu_ptr & PERCPU_REF_DEAD)))
+		uatomic_dec(&this_cpu(percpu_ptr)->count);
+	else
+		release = !uatomic_sub_return(&data->count, 1);
+	data->flavor->read_unlock();
+	if (release)
+		data->release(ref);
+}
+
+/*
+ * After the grace period, all gets and puts use the atomic counter:
+ * fold the per-CPU counters into it. The counters are freed first, as
+ * the release callback may free the reference as soon as the count
+ * reaches zero.
+ */
+static void percpu_ref_switch_rcu(struct rcu_head *head)
+{
+	struct urcu_percpu_ref_data *data =
+		caa_container_of(head, struct urcu_percpu_ref_data, head);
+	struct urcu_percpu_ref *ref = data->ref;
+	unsigned long sum = 0;
+	long cpu;
+
+	for (cpu = 0; cpu < percpu_ref_nr_cpus; cpu++)
+		sum += CMM_LOAD_SHARED(data->percpu[cpu].count);
+	free(data->percpu);
+	data->percpu = NULL;
+	if (!uatomic_add_return(&data->count, sum - PERCPU_REF_BIAS))
+		data->release(ref);
+}
+
+void urcu_percpu_ref_kill(struct urcu_percpu_ref *ref)
+{
+	struct urcu_percpu_ref_data *data = ref->data;
+
+	assert(!(ref->percpu_ptr & PERCPU_REF_DEAD));
+	/* Order prior per-CPU updates before the switch. */
+	cmm_smp_mb();
+	CMM_STORE_SHARED(ref->percpu_ptr, ref->percpu_ptr | PERCPU_REF_DEAD);
+	urcu_percpu_ref_put(ref);
+	data->flavor->update_call_rcu(&data->head, percpu_ref_switch_rcu);
+}
+
+bool urcu_percpu_ref_is_zero(struct urcu_percpu_ref *ref)
+{
+	if (!(CMM_LOAD_SHARED(ref->percpu_ptr) & PERCPU_REF_DEAD))
+		return false;
+	return !uatomic_read(&ref->data->count);
+}
@@ -0,0 +1,331 @@
+/*
+ * urcu-percpu.c
+ *
+ * Userspace RCU library, per-CPU counters version
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+#define URCU_NO_COMPAT_IDENTIFIERS
+#define _BSD_SOURCE
+#define _LGPL_SOURCE
+#define _DEFAULT_SOURCE
+#include <stdio.h>
+#include <pthread.h>
+#include <assert.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <errno.h>
+#include <stdbool.h>
+#include <poll.h>
+#include <unistd.h>
+
+#include <urcu/arch.h>
+#include <urcu/wfcqueue.h>
+#include <urcu/map/urcu-percpu.h>
+#include <urcu/static/urcu-percpu.h>
+#include <urcu/pointer.h>
+#include <urcu/tls-compat.h>
+
+#include "urcu-die.h"
+#include "urcu-wait.h"
+#include "urcu-gp-seq.h"
+#include "urcu-utils.h"
+#include "urcu-stats.h"
+#include "urcu-mutex.h"
+#include "compat-getcpu.h"
+
+#define URCU_API_MAP
+/* Do not #define _LGPL_SOURCE to ensure we can emit the wrapper symbols */
+#undef _LGPL_SOURCE
+#include <urcu/urcu-percpu.h>
+#define _LGPL_SOURCE
+
+/*
+ * This flavor has no prior ABI to be compatible with: do not emit the
+ * alias symbols declared by the call_rcu and defer implementations.
+ */
+#undef URCU_ATTR_ALIAS
+#define URCU_ATTR_ALIAS(x)
+
+/*
+ * Active attempts to check for reader Q.S. before calling futex().
+ */
+#define RCU_QS_ACTIVE_ATTEMPTS 100
+
+void URCU_ATTR_CONSTRUCTOR rcu_init(void);
+
+/*
+ * rcu_gp_lock ensures mutual exclusion between threads calling
+ * synchronize_rcu().
+ */
+static pthread_mutex_t rcu_gp_lock = PTHREAD_MUTEX_INITIALIZER;
+
+struct urcu_gp rcu_gp;
+
+/*
+ * Grace-period statistics. Written with rcu_gp_lock held.
+ */
+static struct urcu_gp_stats gp_stats;
+
+/*
+ * Contention on the internal mutexes, see rcu_get_stats().
+ */
+static struct urcu_flavor_lock_stats lock_stats;
+
+/*
+ * Per-thread nesting count and counter index. Written to only by each
+ * individual reader.
+ */
+DEFINE_URCU_TLS_IE(unsigned long, rcu_reader);
+
+/*
+ * Per-CPU counters, allocated once by rcu_init() for all configured CPUs.
+ */
+struct urcu_percpu_ctr *urcu_percpu_ctrs;
+unsigned int urcu_percpu_nr_cpus;
+
+DEFINE_URCU_TLS_IE(uint32_t *, urcu_percpu_cpu_id);
+static pthread_once_t percpu_init_once = PTHREAD_ONCE_INIT;
+
+static void mutex_lock(pthread_mutex_t *mutex)
+{
+	urcu_mutex_lock(mutex, mutex == &rcu_gp_lock ? &lock_stats.gp : NULL);
+}
+
+static void mutex_unlock(pthread_mutex_t *mutex)
+{
+	int ret;
+
+	ret = pthread_mutex_unlock(mutex);
+	if (ret)
+		urcu_die(ret);
+}
+
+static void percpu_init(void)
+{
+	long nr_cpus;
+	int ret;
+
+	nr_cpus = sysconf(_SC_NPROCESSORS_CONF);
+	if (nr_cpus <= 0)
+		nr_cpus = 1;
+	ret = posix_memalign((void **) &urcu_percpu_ctrs, CAA_CACHE_LINE_SIZE,
+			nr_cpus * sizeof(*urcu_percpu_ctrs));
+	if (ret)
+		urcu_die(ret);
+	memset(urcu_percpu_ctrs, 0, nr_cpus * sizeof(*urcu_percpu_ctrs));
+	urcu_percpu_nr_cpus = nr_cpus;
+}
+
+void rcu_init(void)
+{
+	(void) pthread_once(&percpu_init_once, percpu_init);
+}
+
+/*
+ * Slow path of _urcu_percpu_this_cpu_ctr(): first call of the thread,
+ * CPU number out of range, or no rseq. Readers which cannot get their
+ * CPU number share the counters of CPU 0.
+ */
+struct urcu_percpu_ctr *urcu_percpu_this_cpu_ctr(void)
+{
+	int cpu;
+
+	rcu_init();	/* In case gcc does not support constructor attribute */
+#ifdef URCU_HAVE_RSEQ
+	if (!URCU_TLS(urcu_percpu_cpu_id)) {
+		struct rseq *rs = urcu_rseq_area();
+
+		if (rs)
+			URCU_TLS(urcu_percpu_cpu_id) = (uint32_t *) &rs->cpu_id;
+	}
+#endif
+	cpu = urcu_sched_getcpu();
+	if (caa_unlikely(cpu < 0))
+		cpu = 0;
+	return &urcu_percpu_ctrs[cpu % urcu_percpu_nr_cpus];
+}
+
+/*
+ * Returns whether readers hold a critical section entered with index
+ * idx. The unlock counters are summed before the lock counters, so a
+ * reader can never be accounted as unlocked without being accounted as
+ * locked.
+ */
+static bool readers_active(unsigned long idx)
+{
+	unsigned long locks = 0, unlocks = 0;
+	unsigned int cpu;
+
+	for (cpu = 0; cpu < urcu_percpu_nr_cpus; cpu++)
+		unlocks += CMM_LOAD_SHARED(urcu_percpu_ctrs[cpu].unlock[idx]);
+	cmm_smp_mb();
+	for (cpu = 0; cpu < urcu_percpu_nr_cpus; cpu++)
+		locks += CMM_LOAD_SHARED(urcu_percpu_ctrs[cpu].lock[idx]);
+	return locks != unlocks;
+}
+
+/*
+ * synchronize_rcu() waiting. Single thread.
+ */
+static void wait_gp(void)
+{
+	/* Read reader counters before read futex */
+	cmm_smp_mb();
+	if (uatomic_read(&rcu_gp.futex) != -1)
+		return;
+	urcu_stats_futex_wait(&gp_stats);
+	while (futex_async(&rcu_gp.futex, FUTEX_WAIT, -1,
+			NULL, NULL, 0)) {
+		switch (errno) {
+		case EWOULDBLOCK:
+			/* Value already changed. */
+			return;
+		case EINTR:
+			/* Retry if interrupted by signal. */
+			break;	/* Get out of switch. */
+		default:
+			/* Unexpected error. */
+			urcu_die(errno);
+		}
+	}
+}
+
+static void wait_for_readers(unsigned long idx)
+{
+	unsigned int wait_loops = 0;
+
+	for (;;) {
+		if (wait_loops < RCU_QS_ACTIVE_ATTEMPTS)
+			wait_loops++;
+		if (wait_loops >= RCU_QS_ACTIVE_ATTEMPTS) {
+			uatomic_dec(&rcu_gp.futex);
+			/* Write futex before read reader counters */
+			cmm_smp_mb();
+		}
+		if (!readers_active(idx)) {
+			if (wait_loops >= RCU_QS_ACTIVE_ATTEMPTS) {
+				/* Read reader counters before write futex */
+				cmm_smp_mb();
+				uatomic_set(&rcu_gp.futex, 0);
+			}
+			break;
+		}
+		if (wait_loops >= RCU_QS_ACTIVE_ATTEMPTS)
+			wait_gp();
+		else
+			caa_cpu_relax();
+	}
+}
+
+void synchronize_rcu(void)
+{
+	unsigned long idx;
+	uint64_t gp_start;
+
+	rcu_init();
+	mutex_lock(&rcu_gp_lock);
+
+	gp_start = urcu_stats_gp_start();
+
+	/* Orders prior updates before reading reader counters. */
+	urcu_gp_seq_start(&rcu_gp.seq);
+
+	idx = rcu_gp.ctr & URCU_PERCPU_IDX_MASK;
+
+	/*
+	 * Readers which loaded the other index before the previous flip,
+	 * but updated the lock counter after that grace period completed,
+	 * would not be waited for by the flip below: wait for them first.
+	 */
+	wait_for_readers(idx ^ URCU_PERCPU_IDX_MASK);
+
+	cmm_smp_mb();
+
+	/* Switch index: 0 -> 1, 1 -> 0 */
+	CMM_STORE_SHARED(rcu_gp.ctr, rcu_gp.ctr + 1);
+
+	cmm_smp_mb();
+
+	/* Wait for readers holding the old index. */
+	wait_for_readers(idx);
+
+	/* Orders reading reader counters before following updates. */
+	urcu_gp_seq_end(&rcu_gp.seq);
+	urcu_stats_gp_end(&gp_stats, gp_start);
+
+	mutex_unlock(&rcu_gp_lock);
+}
+
+/*
+ * Grace-period polling. The cookie returned by
+ * get_state_synchronize_rcu() is reached once a full grace period has
+ * elapsed after the call.
+ */
+unsigned long get_state_synchronize_rcu(void)
+{
+	return urcu_gp_seq_snap(&rcu_gp.seq);
+}
+
+int poll_state_synchronize_rcu(unsigned long cookie)
+{
+	return urcu_gp_seq_done(&rcu_gp.seq, cookie);
+}
+
+void cond_synchronize_rcu(unsigned long cookie)
+{
+	if (!poll_state_synchronize_rcu(cookie))
+		synchronize_rcu();
+}
+
+/*
+ * library wrappers to be used by non-LGPL compatible source code.
+ */
+
+void rcu_read_lock(void)
+{
+	_rcu_read_lock();
+}
+
+void rcu_read_unlock(void)
+{
+	_rcu_read_unlock();
+}
+
+int rcu_read_ongoing(void)
+{
+	return _rcu_read_ongoing();
+}
+
+/* Readers do not register: there is no registry to walk. */
+int rcu_for_each_reader(void (*func)(const struct urcu_reader_info *info,
+			void *priv),
+		void *priv)
+{
+	return -ENOSYS;
+}
+
+DEFINE_RCU_FLAVOR(rcu_flavor);
+
+/* Readers are in TLS, for rcu_get_mem_stats(). */
+static size_t rcu_registry_mem_bytes(void)
+{
+	return 0;
+}
+
+#include "urcu-call-rcu-impl.h"
+#include "urcu-defer-impl.h"
@@ -0,0 +1,139 @@
+/*
+ * urcu-qsbr-dq.c
+ *
+ * Userspace RCU library - QSBR inline reclamation defer queue
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+#define _LGPL_SOURCE
+#include <stdlib.h>
+#include <errno.h>
+
+#include <urcu/urcu-qsbr.h>
+#include <urcu/qsbr-dq.h>
+
+struct urcu_qsbr_dq_entry {
+	unsigned long token;
+	void *ptr;
+};
+
+struct urcu_qsbr_dq {
+	/* Free-running indexes of the oldest and next queued objects. */
+	unsigned long head, tail;
+	unsigned long size;
+	unsigned long trigger_reclaim_limit;
+	unsigned long max_reclaim_size;
+	/*
+	 * Last token reached, and tail when it was: a later token may have
+	 * the same value, for objects removed after the check.
+	 */
+	unsigned long reached_token, reached_tail;
+	void (*free_func)(void *ptr, void *priv);
+	void *priv;
+	struct urcu_qsbr_dq_entry entries[];
+};
+
+struct urcu_qsbr_dq *urcu_qsbr_dq_create(unsigned long size,
+		unsigned long trigger_reclaim_limit,
+		unsigned long max_reclaim_size,
+		void (*free_func)(void *ptr, void *priv), void *priv)
+{
+	struct urcu_qsbr_dq *dq;
+
+	if (!size)
+		return NULL;
+	dq = calloc(1, sizeof(*dq) + size * sizeof(dq->entries[0]));
+	if (!dq)
+		return NULL;
+	dq->size = size;
+	/* A full queue reclaims before failing. */
+	if (trigger_reclaim_limit > size)
+		trigger_reclaim_limit = size;
+	dq->trigger_reclaim_limit = trigger_reclaim_limit;
+	dq->max_reclaim_size = max_reclaim_size;
+	dq->free_func = free_func;
+	dq->priv = priv;
+	return dq;
+}
+
+int urcu_qsbr_dq_destroy(struct urcu_qsbr_dq *dq)
+{
+	unsigned long pending;
+
+	(void) urcu_qsbr_dq_reclaim(dq, 0, &pending);
+	if (pending)
+		return -EAGAIN;
+	free(dq);
+	return 0;
+}
+
+static
+int dq_entry_reached(struct urcu_qsbr_dq *dq, unsigned long index)
+{
+	unsigned long token = dq->entries[index % dq->size].token;
+
+	if ((long) (dq->reached_tail - index) > 0
+			&& (long) (dq->reached_token - token) >= 0)
+		return 1;
+	if (!urcu_qsbr_token_check(token))
+		return 0;
+	dq->reached_token = token;
+	dq->reached_tail = dq->tail;
+	return 1;
+}
+
+unsigned long urcu_qsbr_dq_reclaim(struct urcu_qsbr_dq *dq,
+		unsigned long max, unsigned long *pending)
+{
+	struct urcu_qsbr_dq_entry *entry;
+	unsigned long nr = 0;
+
+	/*
+	 * The newest token covers the whole queue: check it first, so
+	 * that a queue of objects all safe to free costs a single scan of
+	 * the readers.
+	 */
+	if (dq->head != dq->tail)
+		(void) dq_entry_reached(dq, dq->tail - 1);
+	while (dq->head != dq->tail && (!max || nr < max)) {
+		if (!dq_entry_reached(dq, dq->head))
+			break;
+		entry = &dq->entries[dq->head % dq->size];
+		dq->head++;
+		dq->free_func(entry->ptr, dq->priv);
+		nr++;
+	}
+	if (pending)
+		*pending = dq->tail - dq->head;
+	return nr;
+}
+
+int urcu_qsbr_dq_enqueue(struct urcu_qsbr_dq *dq, void *ptr)
+{
+	struct urcu_qsbr_dq_entry *entry;
+	unsigned long token;
+
+	token = urcu_qsbr_token_start();
+	if (dq->tail - dq->head >= dq->trigger_reclaim_limit)
+		(void) urcu_qsbr_dq_reclaim(dq, dq->max_reclaim_size, NULL);
+	if (dq->tail - dq->head == dq->size)
+		return -ENOSPC;
+	entry = &dq->entries[dq->tail % dq->size];
+	entry->token = token;
+	entry->ptr = ptr;
+	dq->tail++;
+	return 0;
+}
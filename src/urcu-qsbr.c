@@ -34,6 +34,7 @@
 #include <string.h>
 #include <errno.h>
 #include <poll.h>
+#include <unistd.h>
 
 #include <urcu/wfcqueue.h>
 #include <urcu/map/urcu-qsbr.h>
@@ -44,7 +45,14 @@
 
 #include "urcu-die.h"
 #include "urcu-wait.h"
+#include "urcu-gp-seq.h"
+#include "urcu-registry.h"
 #include "urcu-utils.h"
+#include "urcu-stats.h"
+#include "urcu-mutex.h"
+#include "urcu-stall.h"
+#include "urcu-gp-thread.h"
+#include "urcu-gp-coalesce.h"
 
 #define URCU_API_MAP
 /* Do not #define _LGPL_SOURCE to ensure we can emit the wrapper symbols */
@@ -54,6 +62,28 @@
 
 void __attribute__((destructor)) urcu_qsbr_exit(void);
 
+/* If the headers do not support membarrier system call, fall back smp_mb. */
+#ifdef __NR_membarrier
+# define membarrier(...)		syscall(__NR_membarrier, __VA_ARGS__)
+#else
+# define membarrier(...)		-ENOSYS
+#endif
+
+enum membarrier_cmd {
+	MEMBARRIER_CMD_QUERY				= 0,
+	MEMBARRIER_CMD_SHARED				= (1 << 0),
+	/* reserved for MEMBARRIER_CMD_SHARED_EXPEDITED (1 << 1) */
+	/* reserved for MEMBARRIER_CMD_PRIVATE (1 << 2) */
+	MEMBARRIER_CMD_PRIVATE_EXPEDITED		= (1 << 3),
+	MEMBARRIER_CMD_REGISTER_PRIVATE_EXPEDITED	= (1 << 4),
+};
+
+/*
+ * Written with rcu_gp_lock held, only from 0 to 1: grace periods, which
+ * hold that lock, see the same value from start to end.
+ */
+int urcu_qsbr_has_sys_membarrier;
+
 /*
  * rcu_gp_lock ensures mutual exclusion between threads calling
  * synchronize_rcu().
@@ -81,10 +111,10 @@ URCU_ATTR_ALIAS("urcu_qsbr_gp") extern struct urcu_gp rcu_gp_qsbr;
  * Written to only by each individual reader. Read by both the reader and the
  * writers.
  */
-DEFINE_URCU_TLS(struct urcu_qsbr_reader, urcu_qsbr_reader);
+DEFINE_URCU_TLS_IE(struct urcu_qsbr_reader, urcu_qsbr_reader);
 DEFINE_URCU_TLS_ALIAS(struct urcu_qsbr_reader, urcu_qsbr_reader, rcu_reader_qsbr);
 
-static CDS_LIST_HEAD(registry);
+static DEFINE_URCU_REGISTRY(registry);
 
 /*
  * Queue keeping threads awaiting to wait for a grace period. Contains
@@ -92,20 +122,39 @@ static CDS_LIST_HEAD(registry);
  */
 static DEFINE_URCU_WAIT_QUEUE(gp_waiters);
 
-static void mutex_lock(pthread_mutex_t *mutex)
+/* Window for more callers to join gp_waiters before a grace period. */
+static struct urcu_gp_coalesce gp_coalesce;
+
+/*
+ * Grace-period statistics. Written with rcu_gp_lock held.
+ */
+static struct urcu_gp_stats gp_stats;
+
+/*
+ * Contention on the internal mutexes, see rcu_get_stats().
+ */
+static struct urcu_flavor_lock_stats lock_stats;
+
+/*
+ * Reader stall watchdog. Accessed with rcu_gp_lock held.
+ */
+static struct urcu_stall_watchdog stall_watchdog;
+
+static struct urcu_lock_stats *mutex_lock_stats(pthread_mutex_t *mutex)
 {
-	int ret;
+	if (mutex == &rcu_gp_lock)
+		return &lock_stats.gp;
+	if (mutex == &rcu_registry_lock)
+		return &lock_stats.registry;
+	return NULL;
+}
 
+static void mutex_lock(pthread_mutex_t *mutex)
+{
 #ifndef DISTRUST_SIGNALS_EXTREME
-	ret = pthread_mutex_lock(mutex);
-	if (ret)
-		urcu_die(ret);
+	urcu_mutex_lock(mutex, mutex_lock_stats(mutex));
 #else /* #ifndef DISTRUST_SIGNALS_EXTREME */
-	while ((ret = pthread_mutex_trylock(mutex)) != 0) {
-		if (ret != EBUSY && ret != EINTR)
-			urcu_die(ret);
-		poll(NULL,0,10);
-	}
+	urcu_mutex_lock_poll(mutex, mutex_lock_stats(mutex), NULL);
 #endif /* #else #ifndef DISTRUST_SIGNALS_EXTREME */
 }
 
@@ -118,21 +167,38 @@ static void mutex_unlock(pthread_mutex_t *mutex)
 		urcu_die(ret);
 }
 
+static void smp_mb_master(void)
+{
+	if (caa_likely(urcu_qsbr_has_sys_membarrier)) {
+		if (membarrier(MEMBARRIER_CMD_PRIVATE_EXPEDITED, 0))
+			urcu_die(errno);
+	} else {
+		cmm_smp_mb();
+	}
+}
+
 /*
  * synchronize_rcu() waiting. Single thread.
  */
 static void wait_gp(void)
 {
+	struct timespec timeout;
+
 	/* Read reader_gp before read futex */
 	cmm_smp_rmb();
 	if (uatomic_read(&urcu_qsbr_gp.futex) != -1)
 		return;
+	urcu_stats_futex_wait(&gp_stats);
 	while (futex_noasync(&urcu_qsbr_gp.futex, FUTEX_WAIT, -1,
-			NULL, NULL, 0)) {
+			urcu_stall_timeout(&stall_watchdog, &timeout),
+			NULL, 0)) {
 		switch (errno) {
 		case EWOULDBLOCK:
 			/* Value already changed. */
 			return;
+		case ETIMEDOUT:
+			/* Stall report due. */
+			return;
 		case EINTR:
 			/* Retry if interrupted by signal. */
 			break;	/* Get out of switch. */
@@ -143,17 +209,113 @@ static void wait_gp(void)
 	}
 }
 
+#ifdef CONFIG_RCU_READER_ARRAY
+/* Flag the readers still awaited as having the writer waiting on them. */
+static void set_readers_waiting(struct urcu_reader_array *array)
+{
+	struct urcu_reader_array_chunk *chunk;
+	struct urcu_reader_slot *slot;
+	unsigned long bit, bits;
+	size_t i;
+
+	urcu_reader_array_for_each_pending(array, chunk, i, bit, bits, slot)
+		_CMM_STORE_SHARED(slot->waiting, 1);
+}
+
+/*
+ * Check the readers of a registry group array once. In the first phase,
+ * urcu_reader_array_prepare() marks all of them pending, and the second
+ * phase waits for those seen with the current snapshot in the first one.
+ * Returns whether some readers are still active with an old snapshot.
+ */
+static bool check_readers(struct urcu_reader_array *array, bool first_phase)
+{
+	return urcu_reader_array_check(array, first_phase,
+			urcu_qsbr_reader_state, &stall_watchdog,
+			urcu_stall_report_due(&stall_watchdog));
+}
+#else
+/* Flag the readers still awaited as having the writer waiting on them. */
+static void set_readers_waiting(struct cds_list_head *input_readers)
+{
+	struct urcu_qsbr_reader *index;
+
+	cds_list_for_each_entry(index, input_readers, node) {
+		_CMM_STORE_SHARED(index->waiting, 1);
+	}
+}
+
+/*
+ * Check the readers of input_readers once, moving them to qsreaders when
+ * quiescent, and to cur_snap_readers when active with the current
+ * snapshot if non-NULL. Returns whether some readers are still active
+ * with an old snapshot.
+ */
+static bool check_readers(struct cds_list_head *input_readers,
+			struct cds_list_head *cur_snap_readers,
+			struct cds_list_head *qsreaders)
+{
+	struct urcu_qsbr_reader *index, *tmp;
+
+	cds_list_for_each_entry_safe(index, tmp, input_readers, node) {
+		switch (urcu_qsbr_reader_state(&index->ctr)) {
+		case URCU_READER_ACTIVE_CURRENT:
+			if (cur_snap_readers) {
+				cds_list_move(&index->node,
+					cur_snap_readers);
+				break;
+			}
+			/* Fall-through */
+		case URCU_READER_INACTIVE:
+			cds_list_move(&index->node, qsreaders);
+			break;
+		case URCU_READER_ACTIVE_OLD:
+			/*
+			 * Old snapshot. Leaving node in
+			 * input_readers will make us busy-loop
+			 * until the snapshot becomes current or
+			 * the reader becomes inactive.
+			 */
+			break;
+		}
+	}
+
+	if (!cds_list_empty(input_readers)) {
+		uint64_t active_ns;
+
+		active_ns = urcu_stall_report_due(&stall_watchdog);
+		if (caa_unlikely(active_ns)) {
+			cds_list_for_each_entry(index, input_readers, node) {
+				urcu_stall_report(&stall_watchdog,
+					index->tid, active_ns);
+				urcu_stall_boost(&stall_watchdog, index->tid);
+			}
+		}
+		return true;
+	}
+	return false;
+}
+#endif
+
 /*
  * Always called with rcu_registry lock held. Releases this lock between
  * iterations and grabs it again. Holds the lock when it returns.
  */
+#ifdef CONFIG_RCU_READER_ARRAY
+static void wait_for_readers(struct urcu_reader_array *array,
+			bool first_phase)
+#else
 static void wait_for_readers(struct cds_list_head *input_readers,
 			struct cds_list_head *cur_snap_readers,
 			struct cds_list_head *qsreaders)
+#endif
 {
 	unsigned int wait_loops = 0;
-	struct urcu_qsbr_reader *index, *tmp;
+	bool pending;
 
+#ifdef CONFIG_RCU_READER_ARRAY
+	urcu_reader_array_prepare(array, first_phase);
+#endif
 	/*
 	 * Wait for each thread URCU_TLS(urcu_qsbr_reader).ctr to either
 	 * indicate quiescence (offline), or for them to observe the
@@ -169,36 +331,22 @@ static void wait_for_readers(struct cds_list_head *input_readers,
 			 * reads them in the opposite order).
 			 */
 			cmm_smp_wmb();
-			cds_list_for_each_entry(index, input_readers, node) {
-				_CMM_STORE_SHARED(index->waiting, 1);
-			}
+#ifdef CONFIG_RCU_READER_ARRAY
+			set_readers_waiting(array);
+#else
+			set_readers_waiting(input_readers);
+#endif
 			/* Write futex before read reader_gp */
-			cmm_smp_mb();
+			smp_mb_master();
 		}
-		cds_list_for_each_entry_safe(index, tmp, input_readers, node) {
-			switch (urcu_qsbr_reader_state(&index->ctr)) {
-			case URCU_READER_ACTIVE_CURRENT:
-				if (cur_snap_readers) {
-					cds_list_move(&index->node,
-						cur_snap_readers);
-					break;
-				}
-				/* Fall-through */
-			case URCU_READER_INACTIVE:
-				cds_list_move(&index->node, qsreaders);
-				break;
-			case URCU_READER_ACTIVE_OLD:
-				/*
-				 * Old snapshot. Leaving node in
-				 * input_readers will make us busy-loop
-				 * until the snapshot becomes current or
-				 * the reader becomes inactive.
-				 */
-				break;
-			}
-		}
-
-		if (cds_list_empty(input_readers)) {
+#ifdef CONFIG_RCU_READER_ARRAY
+		pending = check_readers(array, first_phase);
+#else
+		pending = check_readers(input_readers, cur_snap_readers,
+				qsreaders);
+#endif
+
+		if (!pending) {
 			if (wait_loops >= RCU_QS_ACTIVE_ATTEMPTS) {
 				/* Read reader_gp before write futex */
 				cmm_smp_mb();
@@ -226,45 +374,23 @@ static void wait_for_readers(struct cds_list_head *input_readers,
 /*
  * Using a two-subphases algorithm for architectures with smaller than 64-bit
  * long-size to ensure we do not encounter an overflow bug.
+ *
+ * synchronize_waiters() performs a grace period for all threads queued
+ * in gp_waiters, and wakes them once it has completed.
  */
 
 #if (CAA_BITS_PER_LONG < 64)
-void urcu_qsbr_synchronize_rcu(void)
+static void synchronize_waiters(void)
 {
-	CDS_LIST_HEAD(cur_snap_readers);
-	CDS_LIST_HEAD(qsreaders);
-	unsigned long was_online;
-	DEFINE_URCU_WAIT_NODE(wait, URCU_WAIT_WAITING);
+#ifndef CONFIG_RCU_READER_ARRAY
+	struct cds_list_head cur_snap_readers[URCU_REGISTRY_GROUPS];
+	struct cds_list_head qsreaders[URCU_REGISTRY_GROUPS];
+#endif
+	unsigned int i;
+	uint64_t gp_start;
 	struct urcu_waiters waiters;
 
-	was_online = urcu_qsbr_read_ongoing();
-
-	/* All threads should read qparity before accessing data structure
-	 * where new ptr points to.  In the "then" case, rcu_thread_offline
-	 * includes a memory barrier.
-	 *
-	 * Mark the writer thread offline to make sure we don't wait for
-	 * our own quiescent state. This allows using synchronize_rcu()
-	 * in threads registered as readers.
-	 */
-	if (was_online)
-		urcu_qsbr_thread_offline();
-	else
-		cmm_smp_mb();
-
-	/*
-	 * Add ourself to gp_waiters queue of threads awaiting to wait
-	 * for a grace period. Proceed to perform the grace period only
-	 * if we are the first thread added into the queue.
-	 */
-	if (urcu_wait_add(&gp_waiters, &wait) != 0) {
-		/* Not first in queue: will be awakened by another thread. */
-		urcu_adaptative_busy_wait(&wait);
-		goto gp_end;
-	}
-	/* We won't need to wake ourself up */
-	urcu_wait_set_state(&wait, URCU_WAIT_RUNNING);
-
+	urcu_gp_coalesce_wait(&gp_coalesce);
 	mutex_lock(&rcu_gp_lock);
 
 	/*
@@ -272,17 +398,38 @@ void urcu_qsbr_synchronize_rcu(void)
 	 */
 	urcu_move_waiters(&waiters, &gp_waiters);
 
+	gp_start = urcu_stats_gp_start();
+	urcu_gp_seq_start(&urcu_qsbr_gp.seq);
+
 	mutex_lock(&rcu_registry_lock);
 
-	if (cds_list_empty(&registry))
+	if (urcu_registry_empty(&registry))
 		goto out;
 
 	/*
-	 * Wait for readers to observe original parity or be quiescent.
+	 * Write new ptr before reading the reader counters. Needed by
+	 * readers which only use compiler barriers, once sys_membarrier
+	 * is enabled.
+	 */
+	smp_mb_master();
+
+	/*
+	 * Wait for readers to observe original parity or be quiescent,
+	 * one registry group at a time.
 	 * wait_for_readers() can release and grab again rcu_registry_lock
 	 * interally.
 	 */
-	wait_for_readers(&registry, &cur_snap_readers, &qsreaders);
+	urcu_stall_wait_start(&stall_watchdog);
+	urcu_registry_for_each_group(&registry, i) {
+#ifdef CONFIG_RCU_READER_ARRAY
+		wait_for_readers(&registry.array[i], true);
+#else
+		CDS_INIT_LIST_HEAD(&cur_snap_readers[i]);
+		CDS_INIT_LIST_HEAD(&qsreaders[i]);
+		wait_for_readers(&registry.group[i], &cur_snap_readers[i],
+				&qsreaders[i]);
+#endif
+	}
 
 	/*
 	 * Must finish waiting for quiescent state for original parity
@@ -325,59 +472,47 @@ void urcu_qsbr_synchronize_rcu(void)
 	 * wait_for_readers() can release and grab again rcu_registry_lock
 	 * interally.
 	 */
-	wait_for_readers(&cur_snap_readers, NULL, &qsreaders);
+	urcu_stall_wait_start(&stall_watchdog);
+	urcu_registry_for_each_group(&registry, i) {
+#ifdef CONFIG_RCU_READER_ARRAY
+		wait_for_readers(&registry.array[i], false);
+#else
+		wait_for_readers(&cur_snap_readers[i], NULL, &qsreaders[i]);
+#endif
+	}
 
+#ifndef CONFIG_RCU_READER_ARRAY
 	/*
-	 * Put quiescent reader list back into registry.
+	 * Put quiescent reader lists back into their registry group.
 	 */
-	cds_list_splice(&qsreaders, &registry);
+	urcu_registry_for_each_group(&registry, i)
+		cds_list_splice(&qsreaders[i], &registry.group[i]);
+#endif
+
+	/*
+	 * Finish waiting for reader threads before letting the old ptr
+	 * being freed.
+	 */
+	smp_mb_master();
+	urcu_stall_wait_end(&stall_watchdog);
 out:
+	urcu_gp_seq_end(&urcu_qsbr_gp.seq);
+	urcu_stats_gp_end(&gp_stats, gp_start);
 	mutex_unlock(&rcu_registry_lock);
 	mutex_unlock(&rcu_gp_lock);
 	urcu_wake_all_waiters(&waiters);
-gp_end:
-	/*
-	 * Finish waiting for reader threads before letting the old ptr being
-	 * freed.
-	 */
-	if (was_online)
-		urcu_qsbr_thread_online();
-	else
-		cmm_smp_mb();
 }
 #else /* !(CAA_BITS_PER_LONG < 64) */
-void urcu_qsbr_synchronize_rcu(void)
+static void synchronize_waiters(void)
 {
-	CDS_LIST_HEAD(qsreaders);
-	unsigned long was_online;
-	DEFINE_URCU_WAIT_NODE(wait, URCU_WAIT_WAITING);
+#ifndef CONFIG_RCU_READER_ARRAY
+	struct cds_list_head qsreaders[URCU_REGISTRY_GROUPS];
+#endif
+	unsigned int i;
+	uint64_t gp_start;
 	struct urcu_waiters waiters;
 
-	was_online = urcu_qsbr_read_ongoing();
-
-	/*
-	 * Mark the writer thread offline to make sure we don't wait for
-	 * our own quiescent state. This allows using synchronize_rcu()
-	 * in threads registered as readers.
-	 */
-	if (was_online)
-		urcu_qsbr_thread_offline();
-	else
-		cmm_smp_mb();
-
-	/*
-	 * Add ourself to gp_waiters queue of threads awaiting to wait
-	 * for a grace period. Proceed to perform the grace period only
-	 * if we are the first thread added into the queue.
-	 */
-	if (urcu_wait_add(&gp_waiters, &wait) != 0) {
-		/* Not first in queue: will be awakened by another thread. */
-		urcu_adaptative_busy_wait(&wait);
-		goto gp_end;
-	}
-	/* We won't need to wake ourself up */
-	urcu_wait_set_state(&wait, URCU_WAIT_RUNNING);
-
+	urcu_gp_coalesce_wait(&gp_coalesce);
 	mutex_lock(&rcu_gp_lock);
 
 	/*
@@ -385,11 +520,22 @@ void urcu_qsbr_synchronize_rcu(void)
 	 */
 	urcu_move_waiters(&waiters, &gp_waiters);
 
+	gp_start = urcu_stats_gp_start();
+	urcu_gp_seq_start(&urcu_qsbr_gp.seq);
+
 	mutex_lock(&rcu_registry_lock);
 
-	if (cds_list_empty(&registry))
+	if (urcu_registry_empty(&registry))
 		goto out;
 
+	/*
+	 * Write new ptr before the new urcu_qsbr_gp.ctr, which readers
+	 * read before accessing data structure where new ptr points to.
+	 * Needed by readers which only use compiler barriers, once
+	 * sys_membarrier is enabled.
+	 */
+	smp_mb_master();
+
 	/* Increment current G.P. */
 	CMM_STORE_SHARED(urcu_qsbr_gp.ctr, urcu_qsbr_gp.ctr + URCU_QSBR_GP_CTR);
 
@@ -410,30 +556,311 @@ void urcu_qsbr_synchronize_rcu(void)
 	cmm_smp_mb();
 
 	/*
-	 * Wait for readers to observe new count of be quiescent.
+	 * Wait for readers to observe new count of be quiescent, one
+	 * registry group at a time.
 	 * wait_for_readers() can release and grab again rcu_registry_lock
 	 * interally.
 	 */
-	wait_for_readers(&registry, NULL, &qsreaders);
+	urcu_stall_wait_start(&stall_watchdog);
+	urcu_registry_for_each_group(&registry, i) {
+#ifdef CONFIG_RCU_READER_ARRAY
+		/* A single phase: no snapshot to record. */
+		wait_for_readers(&registry.array[i], true);
+#else
+		CDS_INIT_LIST_HEAD(&qsreaders[i]);
+		wait_for_readers(&registry.group[i], NULL, &qsreaders[i]);
+#endif
+	}
 
+#ifndef CONFIG_RCU_READER_ARRAY
 	/*
-	 * Put quiescent reader list back into registry.
+	 * Put quiescent reader lists back into their registry group.
 	 */
-	cds_list_splice(&qsreaders, &registry);
+	urcu_registry_for_each_group(&registry, i)
+		cds_list_splice(&qsreaders[i], &registry.group[i]);
+#endif
+
+	/*
+	 * Finish waiting for reader threads before letting the old ptr
+	 * being freed.
+	 */
+	smp_mb_master();
+	urcu_stall_wait_end(&stall_watchdog);
 out:
+	urcu_gp_seq_end(&urcu_qsbr_gp.seq);
+	urcu_stats_gp_end(&gp_stats, gp_start);
 	mutex_unlock(&rcu_registry_lock);
 	mutex_unlock(&rcu_gp_lock);
 	urcu_wake_all_waiters(&waiters);
-gp_end:
+}
+#endif  /* !(CAA_BITS_PER_LONG < 64) */
+
+static struct urcu_gp_thread gp_thread =
+	URCU_GP_THREAD_INIT(&gp_waiters, synchronize_waiters);
+
+void urcu_qsbr_synchronize_rcu(void)
+{
+	DEFINE_URCU_WAIT_NODE(wait, URCU_WAIT_WAITING);
+	unsigned long was_online;
+	bool leader;
+
+	was_online = urcu_qsbr_read_ongoing();
+
+	/* All threads should read qparity before accessing data structure
+	 * where new ptr points to.  In the "then" case, rcu_thread_offline
+	 * includes a memory barrier.
+	 *
+	 * Mark the writer thread offline to make sure we don't wait for
+	 * our own quiescent state. This allows using synchronize_rcu()
+	 * in threads registered as readers.
+	 */
+	if (was_online)
+		urcu_qsbr_thread_offline();
+	else
+		cmm_smp_mb();
+
+	/*
+	 * Add ourself to gp_waiters queue of threads awaiting to wait
+	 * for a grace period. Proceed to perform the grace period only
+	 * if we are the first thread added into the queue, and there is
+	 * no grace-period thread to do it.
+	 */
+	leader = urcu_wait_add(&gp_waiters, &wait) == 0;
+	urcu_gp_coalesce_arrive(&gp_coalesce);
+	if (leader && !urcu_gp_thread_kick(&gp_thread))
+		synchronize_waiters();
+	/*
+	 * Wait for the thread which moved us out of gp_waiters, us
+	 * included, to wake us. A grace-period thread being stopped
+	 * may have moved us before we performed the grace period.
+	 */
+	if (uatomic_read(&wait.state) == URCU_WAIT_WAITING)
+		urcu_adaptative_busy_wait(&wait);
+
+	/*
+	 * Finish waiting for reader threads before letting the old ptr being
+	 * freed.
+	 */
 	if (was_online)
 		urcu_qsbr_thread_online();
 	else
 		cmm_smp_mb();
 }
-#endif  /* !(CAA_BITS_PER_LONG < 64) */
 URCU_ATTR_ALIAS("urcu_qsbr_synchronize_rcu")
 void synchronize_rcu_qsbr();
 
+int urcu_qsbr_gp_thread_start(int cpu_affinity)
+{
+	return urcu_gp_thread_start(&gp_thread, cpu_affinity);
+}
+
+int urcu_qsbr_gp_thread_stop(void)
+{
+	return urcu_gp_thread_stop(&gp_thread);
+}
+
+int urcu_qsbr_set_gp_coalesce(unsigned long delay_us, unsigned long nr_waiters)
+{
+	return urcu_gp_coalesce_set(&gp_coalesce, delay_us, nr_waiters);
+}
+
+void urcu_qsbr_set_stall_watchdog(unsigned long threshold_ms,
+		void (*func)(pthread_t tid, uint64_t active_ns, void *priv),
+		void *priv)
+{
+	mutex_lock(&rcu_gp_lock);
+	urcu_stall_set(&stall_watchdog, threshold_ms, func, priv);
+	mutex_unlock(&rcu_gp_lock);
+}
+
+int urcu_qsbr_set_reader_boost(unsigned long threshold_ms, int policy,
+		int priority)
+{
+	int ret;
+
+	mutex_lock(&rcu_gp_lock);
+	ret = urcu_stall_set_boost(&stall_watchdog, threshold_ms, policy,
+			priority);
+	mutex_unlock(&rcu_gp_lock);
+	return ret;
+}
+
+int urcu_qsbr_for_each_reader(void (*func)(const struct urcu_reader_info *info,
+			void *priv),
+		void *priv)
+{
+	struct urcu_qsbr_reader *index;
+	struct urcu_reader_info info;
+	unsigned long *ctr;
+	unsigned int i;
+
+	mutex_lock(&rcu_registry_lock);
+	urcu_registry_for_each_group(&registry, i) {
+		cds_list_for_each_entry(index, &registry.group[i], node) {
+#ifdef CONFIG_RCU_READER_ARRAY
+			ctr = &index->slot->ctr;
+#else
+			ctr = &index->ctr;
+#endif
+			switch (urcu_qsbr_reader_state(ctr)) {
+			case URCU_READER_ACTIVE_CURRENT:
+				info.state = URCU_READER_INFO_ACTIVE_CURRENT;
+				break;
+			case URCU_READER_ACTIVE_OLD:
+				info.state = URCU_READER_INFO_ACTIVE_OLD;
+				break;
+			default:
+				info.state = URCU_READER_INFO_INACTIVE;
+				break;
+			}
+			info.tid = index->tid;
+			info.detached = 0;
+			func(&info, priv);
+		}
+	}
+	mutex_unlock(&rcu_registry_lock);
+	return 0;
+}
+
+/*
+ * Grace-period polling. The cookie returned by
+ * urcu_qsbr_get_state_synchronize_rcu() is reached once a full grace
+ * period has elapsed after the call.
+ */
+unsigned long urcu_qsbr_get_state_synchronize_rcu(void)
+{
+	return urcu_gp_seq_snap(&urcu_qsbr_gp.seq);
+}
+
+int urcu_qsbr_poll_state_synchronize_rcu(unsigned long cookie)
+{
+	return urcu_gp_seq_done(&urcu_qsbr_gp.seq, cookie);
+}
+
+void urcu_qsbr_cond_synchronize_rcu(unsigned long cookie)
+{
+	if (!urcu_qsbr_poll_state_synchronize_rcu(cookie))
+		urcu_qsbr_synchronize_rcu();
+}
+
+#if (CAA_BITS_PER_LONG < 64)
+/*
+ * The counter only holds a phase: tokens are grace-period cookies,
+ * reached by the grace periods of synchronize_rcu() and call_rcu().
+ */
+unsigned long urcu_qsbr_token_start(void)
+{
+	return urcu_qsbr_get_state_synchronize_rcu();
+}
+
+int urcu_qsbr_token_check(unsigned long token)
+{
+	return urcu_qsbr_poll_state_synchronize_rcu(token);
+}
+#else /* !(CAA_BITS_PER_LONG < 64) */
+/*
+ * urcu_qsbr_gp.ctr never wraps: a token is a counter value, reached
+ * once each reader is offline or reported a quiescent state with a
+ * counter at least as large. The memory barrier of the grace period
+ * storing the first counter value after the token was taken may have
+ * executed before the caller removed its objects: the token is the
+ * second value.
+ */
+unsigned long urcu_qsbr_token_start(void)
+{
+	cmm_smp_mb();
+	return CMM_LOAD_SHARED(urcu_qsbr_gp.ctr) + 2 * URCU_QSBR_GP_CTR;
+}
+
+/*
+ * Called with rcu_registry_lock held. The caller is outside of
+ * read-side critical sections, as synchronize_rcu() callers.
+ */
+static bool readers_reached_token(unsigned long token)
+{
+	struct urcu_qsbr_reader *index;
+	unsigned long *ctr, v;
+	unsigned int i;
+
+	urcu_registry_for_each_group(&registry, i) {
+		cds_list_for_each_entry(index, &registry.group[i], node) {
+			if (index == &URCU_TLS(urcu_qsbr_reader))
+				continue;
+#ifdef CONFIG_RCU_READER_ARRAY
+			ctr = &index->slot->ctr;
+#else
+			ctr = &index->ctr;
+#endif
+			v = CMM_LOAD_SHARED(*ctr);
+			if (v && !URCU_GP_SEQ_GE(v, token))
+				return false;
+		}
+	}
+	return true;
+}
+
+/*
+ * Advance the counter up to the token, unless a grace period is in
+ * progress: the counter is only stored under rcu_gp_lock, and the grace
+ * period advances it, or a later check does.
+ */
+static void advance_to_token(unsigned long token)
+{
+	if (URCU_GP_SEQ_GE(CMM_LOAD_SHARED(urcu_qsbr_gp.ctr), token))
+		return;
+	if (urcu_mutex_trylock(&rcu_gp_lock))
+		return;
+	urcu_mutex_acquired(&lock_stats.gp, 0, 0);
+	while (!URCU_GP_SEQ_GE(urcu_qsbr_gp.ctr, token)) {
+		smp_mb_master();
+		CMM_STORE_SHARED(urcu_qsbr_gp.ctr,
+				urcu_qsbr_gp.ctr + URCU_QSBR_GP_CTR);
+	}
+	cmm_smp_mb();
+	mutex_unlock(&rcu_gp_lock);
+}
+
+int urcu_qsbr_token_check(unsigned long token)
+{
+	bool reached;
+
+	if (urcu_mutex_trylock(&rcu_registry_lock))
+		return 0;
+	urcu_mutex_acquired(&lock_stats.registry, 0, 0);
+	reached = readers_reached_token(token);
+	mutex_unlock(&rcu_registry_lock);
+	if (!reached) {
+		advance_to_token(token);
+		return 0;
+	}
+	/* Finish waiting for readers before the objects are freed. */
+	smp_mb_master();
+	return 1;
+}
+#endif /* !(CAA_BITS_PER_LONG < 64) */
+
+int urcu_qsbr_enable_sys_membarrier(void)
+{
+	int mask, ret = 0;
+
+	mutex_lock(&rcu_gp_lock);
+	if (urcu_qsbr_has_sys_membarrier)
+		goto end;
+	mask = membarrier(MEMBARRIER_CMD_QUERY, 0);
+	if (mask < 0 || !(mask & MEMBARRIER_CMD_PRIVATE_EXPEDITED)) {
+		ret = -ENOSYS;
+		goto end;
+	}
+	if (membarrier(MEMBARRIER_CMD_REGISTER_PRIVATE_EXPEDITED, 0)) {
+		ret = -errno;
+		goto end;
+	}
+	CMM_STORE_SHARED(urcu_qsbr_has_sys_membarrier, 1);
+end:
+	mutex_unlock(&rcu_gp_lock);
+	return ret;
+}
+
 /*
  * library wrappers to be used by non-LGPL compatible source code.
  */
@@ -483,16 +910,35 @@ void urcu_qsbr_register_thread(void)
 	URCU_TLS(urcu_qsbr_reader).tid = pthread_self();
 	assert(URCU_TLS(urcu_qsbr_reader).ctr == 0);
 
+	urcu_registry_init();
 	mutex_lock(&rcu_registry_lock);
 	assert(!URCU_TLS(urcu_qsbr_reader).registered);
 	URCU_TLS(urcu_qsbr_reader).registered = 1;
-	cds_list_add(&URCU_TLS(urcu_qsbr_reader).node, &registry);
+#ifdef CONFIG_RCU_READER_ARRAY
+	URCU_TLS(urcu_qsbr_reader).slot = urcu_registry_add_slot(&registry,
+			&URCU_TLS(urcu_qsbr_reader).node,
+			URCU_TLS(urcu_qsbr_reader).tid);
+#else
+	urcu_registry_add(&registry, &URCU_TLS(urcu_qsbr_reader).node);
+#endif
 	mutex_unlock(&rcu_registry_lock);
 	_urcu_qsbr_thread_online();
 }
 URCU_ATTR_ALIAS("urcu_qsbr_register_thread")
 void rcu_register_thread_qsbr();
 
+/*
+ * Without sys_membarrier, grace periods wait for the quiescent states
+ * readers report themselves, without ever interrupting them.
+ */
+int urcu_qsbr_register_thread_isolated(void)
+{
+	if (CMM_LOAD_SHARED(urcu_qsbr_has_sys_membarrier))
+		return -ENOSYS;
+	urcu_qsbr_register_thread();
+	return 0;
+}
+
 void urcu_qsbr_unregister_thread(void)
 {
 	/*
@@ -503,7 +949,14 @@ void urcu_qsbr_unregister_thread(void)
 	assert(URCU_TLS(urcu_qsbr_reader).registered);
 	URCU_TLS(urcu_qsbr_reader).registered = 0;
 	mutex_lock(&rcu_registry_lock);
+	urcu_stall_unregister(&stall_watchdog);
+#ifdef CONFIG_RCU_READER_ARRAY
+	urcu_registry_del_slot(&registry, &URCU_TLS(urcu_qsbr_reader).node,
+			URCU_TLS(urcu_qsbr_reader).slot);
+	URCU_TLS(urcu_qsbr_reader).slot = NULL;
+#else
 	cds_list_del(&URCU_TLS(urcu_qsbr_reader).node);
+#endif
 	mutex_unlock(&rcu_registry_lock);
 }
 URCU_ATTR_ALIAS("urcu_qsbr_unregister_thread")
@@ -522,5 +975,11 @@ URCU_ATTR_ALIAS("urcu_qsbr_exit") void rcu_exit_qsbr();
 DEFINE_RCU_FLAVOR(rcu_flavor);
 DEFINE_RCU_FLAVOR_ALIAS(rcu_flavor, alias_rcu_flavor);
 
+/* Readers are in TLS, for rcu_get_mem_stats(). */
+static size_t rcu_registry_mem_bytes(void)
+{
+	return 0;
+}
+
 #include "urcu-call-rcu-impl.h"
 #include "urcu-defer-impl.h"
@@ -0,0 +1,238 @@
+#ifndef _URCU_READER_ARRAY_H
+#define _URCU_READER_ARRAY_H
+
+/*
+ * urcu-reader-array.h
+ *
+ * Userspace RCU library - library-owned reader state arrays
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <limits.h>
+#include <sys/mman.h>
+#include <urcu/static/urcu-common.h>
+#include "urcu-stall.h"
+
+#ifdef CONFIG_RCU_READER_ARRAY
+
+/*
+ * Reader slots are allocated from chunks which never move nor are freed,
+ * the first one holding URCU_READER_ARRAY_INIT_SLOTS slots and each
+ * following one twice as many as the previous one. Chunks are mapped
+ * when the first reader needing them registers, so their memory is
+ * local to its NUMA node.
+ *
+ * Each chunk has three bitmaps: used slots, then the readers awaited by
+ * synchronize_rcu() and those seen active with the current snapshot in
+ * its first phase. All accesses are done with the registry lock of the
+ * flavor held, except readers updating their own slot.
+ */
+#define URCU_READER_ARRAY_INIT_SLOTS	64
+#define URCU_READER_ARRAY_WORD_BITS	(sizeof(unsigned long) * CHAR_BIT)
+
+struct urcu_reader_array_chunk {
+	struct urcu_reader_array_chunk *next;
+	size_t nr_slots;
+	unsigned long *used;
+	unsigned long *pending;
+	unsigned long *snap;
+	struct urcu_reader_slot slots[];
+};
+
+struct urcu_reader_array {
+	struct urcu_reader_array_chunk *chunks;
+};
+
+/* Returns the reader state held in a slot. */
+typedef enum urcu_state (*urcu_reader_array_state_fn)(unsigned long *ctr);
+
+static inline
+size_t urcu_reader_array_nr_words(struct urcu_reader_array_chunk *chunk)
+{
+	return (chunk->nr_slots + URCU_READER_ARRAY_WORD_BITS - 1)
+		/ URCU_READER_ARRAY_WORD_BITS;
+}
+
+static inline
+size_t urcu_reader_array_chunk_len(size_t nr_slots)
+{
+	size_t nr_words = (nr_slots + URCU_READER_ARRAY_WORD_BITS - 1)
+		/ URCU_READER_ARRAY_WORD_BITS;
+
+	return sizeof(struct urcu_reader_array_chunk)
+		+ nr_slots * sizeof(struct urcu_reader_slot)
+		+ 3 * nr_words * sizeof(unsigned long);
+}
+
+static inline
+struct urcu_reader_array_chunk *urcu_reader_array_expand(
+		struct urcu_reader_array *array)
+{
+	struct urcu_reader_array_chunk *chunk, **last;
+	size_t nr_slots = URCU_READER_ARRAY_INIT_SLOTS, nr_words;
+	unsigned long *bitmaps;
+
+	for (last = &array->chunks; *last; last = &(*last)->next)
+		nr_slots = (*last)->nr_slots << 1;
+	chunk = mmap(NULL, urcu_reader_array_chunk_len(nr_slots),
+		PROT_READ | PROT_WRITE, MAP_ANONYMOUS | MAP_PRIVATE, -1, 0);
+	if (chunk == MAP_FAILED)
+		return NULL;
+	chunk->nr_slots = nr_slots;
+	nr_words = urcu_reader_array_nr_words(chunk);
+	bitmaps = (unsigned long *) &chunk->slots[nr_slots];
+	chunk->used = bitmaps;
+	chunk->pending = bitmaps + nr_words;
+	chunk->snap = bitmaps + 2 * nr_words;
+	*last = chunk;
+	return chunk;
+}
+
+/* Allocate a zeroed reader slot, or return NULL if out of memory. */
+static inline
+struct urcu_reader_slot *urcu_reader_array_alloc(
+		struct urcu_reader_array *array)
+{
+	struct urcu_reader_array_chunk *chunk;
+	size_t i, slot;
+
+	for (chunk = array->chunks; ; chunk = chunk->next) {
+		if (!chunk && !(chunk = urcu_reader_array_expand(array)))
+			return NULL;
+		for (i = 0; i < urcu_reader_array_nr_words(chunk); i++) {
+			if (!~chunk->used[i])
+				continue;
+			slot = i * URCU_READER_ARRAY_WORD_BITS
+				+ __builtin_ctzl(~chunk->used[i]);
+			if (slot >= chunk->nr_slots)
+				break;
+			chunk->used[i] |= 1UL << (slot % URCU_READER_ARRAY_WORD_BITS);
+			memset(&chunk->slots[slot], 0, sizeof(chunk->slots[slot]));
+			return &chunk->slots[slot];
+		}
+	}
+}
+
+/* Free a slot. Returns whether it belongs to this array. */
+static inline
+bool urcu_reader_array_free(struct urcu_reader_array *array,
+		struct urcu_reader_slot *reader)
+{
+	struct urcu_reader_array_chunk *chunk;
+	size_t slot;
+
+	for (chunk = array->chunks; chunk; chunk = chunk->next) {
+		if (reader < &chunk->slots[0]
+				|| reader >= &chunk->slots[chunk->nr_slots])
+			continue;
+		slot = reader - &chunk->slots[0];
+		chunk->used[slot / URCU_READER_ARRAY_WORD_BITS] &=
+			~(1UL << (slot % URCU_READER_ARRAY_WORD_BITS));
+		return true;
+	}
+	return false;
+}
+
+/*
+ * Mark the readers to wait for: in the first phase all registered
+ * readers, in the second one those seen active with the current snapshot
+ * in the first phase.
+ */
+static inline
+void urcu_reader_array_prepare(struct urcu_reader_array *array,
+		bool first_phase)
+{
+	struct urcu_reader_array_chunk *chunk;
+	size_t i;
+
+	for (chunk = array->chunks; chunk; chunk = chunk->next) {
+		for (i = 0; i < urcu_reader_array_nr_words(chunk); i++) {
+			if (first_phase) {
+				chunk->pending[i] = chunk->used[i];
+				chunk->snap[i] = 0;
+			} else {
+				chunk->pending[i] = chunk->snap[i];
+			}
+		}
+	}
+}
+
+/*
+ * Iterate on the slots of a chunk array with their bit set in the
+ * pending bitmaps, in increasing address order.
+ */
+#define urcu_reader_array_for_each_pending(array, chunk, i, bit, bits, slot) \
+	for ((chunk) = (array)->chunks; (chunk); (chunk) = (chunk)->next) \
+		for ((i) = 0; (i) < urcu_reader_array_nr_words(chunk); (i)++) \
+			for ((bits) = (chunk)->pending[i];		\
+				(bits) && ((bit) = (bits) & -(bits),	\
+					(slot) = &(chunk)->slots[(i)	\
+						* URCU_READER_ARRAY_WORD_BITS \
+						+ __builtin_ctzl(bits)], 1); \
+				(bits) &= ~(bit))
+
+/*
+ * Check the pending readers once, in a sequential scan of each chunk. In
+ * the first phase, record those active with the current snapshot for the
+ * second phase. Report stalled readers if active_ns is nonzero. Return
+ * whether some readers are still active with an old snapshot.
+ */
+static inline
+bool urcu_reader_array_check(struct urcu_reader_array *array,
+		bool first_phase, urcu_reader_array_state_fn reader_state,
+		struct urcu_stall_watchdog *watchdog, uint64_t active_ns)
+{
+	struct urcu_reader_array_chunk *chunk;
+	struct urcu_reader_slot *slot;
+	unsigned long bit, bits;
+	bool pending = false;
+	size_t i;
+
+	urcu_reader_array_for_each_pending(array, chunk, i, bit, bits, slot) {
+		switch (reader_state(&slot->ctr)) {
+		case URCU_READER_ACTIVE_CURRENT:
+			if (first_phase)
+				chunk->snap[i] |= bit;
+			/* Fall-through */
+		case URCU_READER_INACTIVE:
+			chunk->pending[i] &= ~bit;
+			break;
+		case URCU_READER_ACTIVE_OLD:
+			/*
+			 * Old snapshot. Leaving the reader pending will make
+			 * us busy-loop until the snapshot becomes current or
+			 * the reader becomes inactive.
+			 */
+			pending = true;
+			if (caa_unlikely(active_ns)) {
+				urcu_stall_report(watchdog, slot->tid,
+					active_ns);
+				if (!slot->detached)
+					urcu_stall_boost(watchdog, slot->tid);
+			}
+			break;
+		}
+	}
+	return pending;
+}
+
+#endif /* CONFIG_RCU_READER_ARRAY */
+
+#endif /* _URCU_READER_ARRAY_H */
@@ -0,0 +1,177 @@
+#ifndef _URCU_REGISTRY_H
+#define _URCU_REGISTRY_H
+
+/*
+ * urcu-registry.h
+ *
+ * Userspace RCU library - reader registry grouped by NUMA node
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+#include <pthread.h>
+#include <unistd.h>
+#include <urcu/list.h>
+#include "compat-numa.h"
+#include "urcu-reader-array.h"
+#include "urcu-utils.h"
+
+/*
+ * Registered readers are kept in one list per NUMA node they registered
+ * from (nodes beyond URCU_REGISTRY_GROUPS share groups). Grace-period
+ * detection still walks and waits on each group in turn, from the thread
+ * performing the grace period: grouping keeps the readers of a node
+ * together, but grace-period latency grows with the number of readers.
+ * All accesses are done with the registry lock of the flavor held.
+ *
+ * With CONFIG_RCU_READER_ARRAY, each group also owns the array holding
+ * the reader state of its readers, which grace-period detection scans
+ * instead of the lists.
+ */
+#define URCU_REGISTRY_GROUPS	8
+
+/*
+ * NUMA node of the first URCU_REGISTRY_MAX_CPUS CPUs, or -1 if unknown,
+ * read from sysfs once at initialization, so that registration does not
+ * walk sysfs with the registry lock held.
+ */
+#define URCU_REGISTRY_MAX_CPUS	1024
+
+static short urcu_registry_cpu_node[URCU_REGISTRY_MAX_CPUS];
+static pthread_once_t urcu_registry_once = PTHREAD_ONCE_INIT;
+
+static void urcu_registry_cpu_node_init(void)
+{
+	long cpu, nr_cpus = sysconf(_SC_NPROCESSORS_CONF);
+
+	for (cpu = 0; cpu < URCU_REGISTRY_MAX_CPUS; cpu++)
+		urcu_registry_cpu_node[cpu] =
+			cpu < nr_cpus ? urcu_numa_node_of_cpu(cpu) : -1;
+}
+
+/*
+ * Constructor, also called by registration before taking the registry
+ * lock, in case it did not run.
+ */
+static void URCU_ATTR_CONSTRUCTOR urcu_registry_init(void)
+{
+	(void) pthread_once(&urcu_registry_once, urcu_registry_cpu_node_init);
+}
+
+/* NUMA node of a CPU, or -1 if unknown. Requires urcu_registry_init(). */
+static inline
+int urcu_registry_node_of_cpu(int cpu)
+{
+	if (cpu < 0 || cpu >= URCU_REGISTRY_MAX_CPUS)
+		return -1;
+	return urcu_registry_cpu_node[cpu];
+}
+
+struct urcu_registry {
+	struct cds_list_head group[URCU_REGISTRY_GROUPS];
+#ifdef CONFIG_RCU_READER_ARRAY
+	struct urcu_reader_array array[URCU_REGISTRY_GROUPS];
+#endif
+};
+
+#define URCU_REGISTRY_INIT(name)				\
+	{							\
+		.group = {					\
+			CDS_LIST_HEAD_INIT((name).group[0]),	\
+			CDS_LIST_HEAD_INIT((name).group[1]),	\
+			CDS_LIST_HEAD_INIT((name).group[2]),	\
+			CDS_LIST_HEAD_INIT((name).group[3]),	\
+			CDS_LIST_HEAD_INIT((name).group[4]),	\
+			CDS_LIST_HEAD_INIT((name).group[5]),	\
+			CDS_LIST_HEAD_INIT((name).group[6]),	\
+			CDS_LIST_HEAD_INIT((name).group[7]),	\
+		},						\
+	}
+
+#define DEFINE_URCU_REGISTRY(name)				\
+	struct urcu_registry name = URCU_REGISTRY_INIT(name)
+
+/* Iterate on the reader lists of the registry groups. */
+#define urcu_registry_for_each_group(registry, i)		\
+	for ((i) = 0; (i) < URCU_REGISTRY_GROUPS; (i)++)
+
+static inline
+int urcu_registry_empty(struct urcu_registry *registry)
+{
+	unsigned int i;
+
+	urcu_registry_for_each_group(registry, i) {
+		if (!cds_list_empty(&registry->group[i]))
+			return 0;
+	}
+	return 1;
+}
+
+/*
+ * Add a reader node to the group of the NUMA node the caller runs on.
+ * Returns the group index. Requires urcu_registry_init().
+ */
+static inline
+unsigned int urcu_registry_add(struct urcu_registry *registry,
+		struct cds_list_head *node)
+{
+	unsigned int i;
+	int numa_node;
+
+	numa_node = urcu_registry_node_of_cpu(urcu_sched_getcpu());
+	if (numa_node < 0)
+		numa_node = 0;
+	i = numa_node % URCU_REGISTRY_GROUPS;
+	cds_list_add(node, &registry->group[i]);
+	return i;
+}
+
+#ifdef CONFIG_RCU_READER_ARRAY
+/*
+ * Add a reader to the registry, and allocate its slot from the array
+ * of its group. Aborts if out of memory.
+ */
+static inline
+struct urcu_reader_slot *urcu_registry_add_slot(struct urcu_registry *registry,
+		struct cds_list_head *node, pthread_t tid)
+{
+	struct urcu_reader_slot *slot;
+
+	slot = urcu_reader_array_alloc(
+		&registry->array[urcu_registry_add(registry, node)]);
+	if (!slot)
+		abort();
+	slot->detached = 0;
+	slot->tid = tid;
+	return slot;
+}
+
+/* Remove a reader from the registry, freeing its slot. */
+static inline
+void urcu_registry_del_slot(struct urcu_registry *registry,
+		struct cds_list_head *node, struct urcu_reader_slot *slot)
+{
+	unsigned int i;
+
+	cds_list_del(node);
+	urcu_registry_for_each_group(registry, i) {
+		if (urcu_reader_array_free(&registry->array[i], slot))
+			return;
+	}
+	abort();
+}
+#endif
+
+#endif /* _URCU_REGISTRY_H */
@@ -0,0 +1,121 @@
+/*
+ * urcu-rseq.c
+ *
+ * Userspace RCU library - Restartable sequences
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+#include <pthread.h>
+#include <unistd.h>
+#include <sys/syscall.h>
+
+#include <urcu/tls-compat.h>
+
+#include "urcu-die.h"
+#include "urcu-rseq.h"
+
+#ifdef URCU_HAVE_RSEQ
+
+/*
+ * The area must be at a fixed address for the lifetime of the thread,
+ * which only compiler TLS guarantees.
+ */
+#if defined(CONFIG_RCU_TLS) && defined(__NR_rseq)
+
+#ifndef RSEQ_FLAG_UNREGISTER
+#define RSEQ_FLAG_UNREGISTER	(1 << 0)
+#endif
+
+enum rseq_state {
+	RSEQ_STATE_UNREGISTERED = 0,
+	RSEQ_STATE_REGISTERED,
+	RSEQ_STATE_FAILED,
+};
+
+static CONFIG_RCU_TLS struct rseq rseq_area
+	__attribute__((aligned(4 * sizeof(uint64_t))));
+static CONFIG_RCU_TLS int rseq_state;
+
+static pthread_key_t rseq_key;
+static pthread_once_t rseq_key_once = PTHREAD_ONCE_INIT;
+
+static
+int sys_rseq(struct rseq *rs, int flags)
+{
+	return syscall(__NR_rseq, rs, sizeof(*rs), flags, URCU_RSEQ_SIG);
+}
+
+/* The kernel must not write to the area once the thread frees it. */
+static
+void rseq_thread_exit(void *arg)
+{
+	(void) sys_rseq(&rseq_area, RSEQ_FLAG_UNREGISTER);
+	rseq_state = RSEQ_STATE_FAILED;
+}
+
+static
+void rseq_key_init(void)
+{
+	int ret;
+
+	ret = pthread_key_create(&rseq_key, rseq_thread_exit);
+	if (ret)
+		urcu_die(ret);
+}
+
+static
+struct rseq *rseq_register_thread(void)
+{
+	int ret;
+
+	ret = pthread_once(&rseq_key_once, rseq_key_init);
+	if (ret)
+		urcu_die(ret);
+	rseq_area.cpu_id = (uint32_t) -1;
+	if (sys_rseq(&rseq_area, 0)) {
+		rseq_state = RSEQ_STATE_FAILED;
+		return NULL;
+	}
+	/* Any non-NULL value, for the destructor to be called. */
+	ret = pthread_setspecific(rseq_key, &rseq_area);
+	if (ret)
+		urcu_die(ret);
+	rseq_state = RSEQ_STATE_REGISTERED;
+	return &rseq_area;
+}
+
+struct rseq *urcu_rseq_thread_area(void)
+{
+	switch (rseq_state) {
+	case RSEQ_STATE_REGISTERED:
+		return &rseq_area;
+	case RSEQ_STATE_UNREGISTERED:
+		return rseq_register_thread();
+	default:
+		return NULL;
+	}
+}
+
+#else /* #if defined(CONFIG_RCU_TLS) && defined(__NR_rseq) */
+
+struct rseq *urcu_rseq_thread_area(void)
+{
+	return NULL;
+}
+
+#endif /* #else #if defined(CONFIG_RCU_TLS) && defined(__NR_rseq) */
+
+#endif /* #ifdef URCU_HAVE_RSEQ */
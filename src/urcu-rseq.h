@@ -0,0 +1,214 @@
+#ifndef _URCU_RSEQ_H
+#define _URCU_RSEQ_H
+
+/*
+ * urcu-rseq.h
+ *
+ * Userspace RCU library - Restartable sequences
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+/*
+ * Each thread registers one rseq area to the kernel, which keeps its
+ * cpu_id field current, so that the current CPU number is a TLS load.
+ * glibc 2.35 and later register an area for each thread: it is used
+ * when present. Otherwise, the library registers its own area on the
+ * first use by each thread, and unregisters it on thread exit.
+ *
+ * The per-CPU commit primitives perform a store on the per-CPU data of
+ * the current CPU, without atomic instruction, and fail if the thread
+ * is not running on that CPU anymore: the kernel aborts the sequence
+ * when it preempts or migrates the thread, or delivers it a signal.
+ * Without rseq support, they fall back on atomic operations, and never
+ * fail. Threads of a process all use one or the other, as long as no
+ * per-CPU data is indexed by a CPU number not returned by
+ * urcu_rseq_current_cpu().
+ */
+
+#include <stdint.h>
+#include <urcu/compiler.h>
+#include <urcu/system.h>
+#include <urcu/uatomic.h>
+
+#if defined(HAVE_RSEQ_CPU_ID)
+#include <sys/rseq.h>
+#define URCU_HAVE_RSEQ
+#elif defined(HAVE_LINUX_RSEQ_H)
+#include <linux/rseq.h>
+#define URCU_HAVE_RSEQ
+#endif
+
+#ifdef URCU_HAVE_RSEQ
+
+#ifdef RSEQ_SIG
+#define URCU_RSEQ_SIG		RSEQ_SIG
+#else
+#define URCU_RSEQ_SIG		0x53053053
+#endif
+
+/*
+ * Register the rseq area of the library for the current thread if glibc
+ * did not, and return the current area, or NULL if rseq is unavailable.
+ */
+extern
+struct rseq *urcu_rseq_thread_area(void);
+
+static inline
+struct rseq *urcu_rseq_area(void)
+{
+#ifdef HAVE_RSEQ_CPU_ID
+	if (caa_likely(__rseq_size > 0))
+		return (struct rseq *) ((char *) __builtin_thread_pointer()
+				+ __rseq_offset);
+#endif
+	return urcu_rseq_thread_area();
+}
+
+/*
+ * Return the CPU the current thread runs on, or a negative value if
+ * rseq is unavailable.
+ */
+static inline
+int urcu_rseq_current_cpu(void)
+{
+	struct rseq *rs = urcu_rseq_area();
+
+	if (caa_unlikely(!rs))
+		return -1;
+	return (int) CMM_LOAD_SHARED(rs->cpu_id);
+}
+
+#else /* #ifdef URCU_HAVE_RSEQ */
+
+static inline
+int urcu_rseq_current_cpu(void)
+{
+	return -1;
+}
+
+#endif /* #else #ifdef URCU_HAVE_RSEQ */
+
+#if defined(URCU_HAVE_RSEQ) && defined(__x86_64__) && defined(__GNUC__)
+#define URCU_RSEQ_COMMIT
+
+#define __urcu_rseq_str_1(x)	#x
+#define __urcu_rseq_str(x)	__urcu_rseq_str_1(x)
+
+/*
+ * Critical section descriptor: version, flags, start address, length,
+ * and abort address, which follows the signature the kernel checks.
+ * The sequence publishes its descriptor, checks the CPU, and ends with
+ * the commit store.
+ */
+#define __URCU_RSEQ_CS_BEGIN						\
+	".pushsection __rseq_cs, \"aw\"\n\t"				\
+	".balign 32\n\t"						\
+	"3:\n\t"							\
+	".long 0x0, 0x0\n\t"						\
+	".quad 1f, (2f - 1f), 4f\n\t"					\
+	".popsection\n\t"						\
+	"leaq 3b(%%rip), %%rax\n\t"					\
+	"movq %%rax, %[rseq_cs]\n\t"					\
+	"1:\n\t"							\
+	"cmpl %[cpu_id], %[current_cpu_id]\n\t"				\
+	"jnz %l[abort]\n\t"
+
+#define __URCU_RSEQ_CS_END						\
+	"2:\n\t"							\
+	".pushsection __rseq_failure, \"ax\"\n\t"			\
+	".byte 0x0f, 0xb9, 0x3d\n\t"					\
+	".long " __urcu_rseq_str(URCU_RSEQ_SIG) "\n\t"			\
+	"4:\n\t"							\
+	"jmp %l[abort]\n\t"						\
+	".popsection\n\t"
+#endif
+
+/*
+ * urcu_rseq_addv - add @count to the per-CPU variable @v of @cpu.
+ *
+ * Return 0 on success, or -1 if the current thread does not run on @cpu.
+ */
+static inline
+int urcu_rseq_addv(intptr_t *v, intptr_t count, int cpu)
+{
+#ifdef URCU_RSEQ_COMMIT
+	struct rseq *rs = urcu_rseq_area();
+
+	if (caa_likely(rs)) {
+		__asm__ __volatile__ goto (
+			__URCU_RSEQ_CS_BEGIN
+			"addq %[count], %[v]\n\t"
+			__URCU_RSEQ_CS_END
+			: /* no outputs */
+			: [cpu_id] "r" (cpu),
+			  [current_cpu_id] "m" (rs->cpu_id),
+			  [rseq_cs] "m" (rs->rseq_cs),
+			  [v] "m" (*v),
+			  [count] "er" (count)
+			: "memory", "cc", "rax"
+			: abort);
+		return 0;
+	abort:
+		return -1;
+	}
+#endif
+	(void) cpu;
+	uatomic_add(v, count);
+	return 0;
+}
+
+/*
+ * urcu_rseq_cmpeqv_storev - store @newv into the per-CPU variable @v of
+ * @cpu if it contains @expect.
+ *
+ * Return 0 on success, 1 if @v does not contain @expect, or -1 if the
+ * current thread does not run on @cpu.
+ */
+static inline
+int urcu_rseq_cmpeqv_storev(intptr_t *v, intptr_t expect, intptr_t newv,
+		int cpu)
+{
+#ifdef URCU_RSEQ_COMMIT
+	struct rseq *rs = urcu_rseq_area();
+
+	if (caa_likely(rs)) {
+		__asm__ __volatile__ goto (
+			__URCU_RSEQ_CS_BEGIN
+			"cmpq %[v], %[expect]\n\t"
+			"jnz %l[cmpfail]\n\t"
+			"movq %[newv], %[v]\n\t"
+			__URCU_RSEQ_CS_END
+			: /* no outputs */
+			: [cpu_id] "r" (cpu),
+			  [current_cpu_id] "m" (rs->cpu_id),
+			  [rseq_cs] "m" (rs->rseq_cs),
+			  [v] "m" (*v),
+			  [expect] "r" (expect),
+			  [newv] "r" (newv)
+			: "memory", "cc", "rax"
+			: abort, cmpfail);
+		return 0;
+	abort:
+		return -1;
+	cmpfail:
+		return 1;
+	}
+#endif
+	(void) cpu;
+	return uatomic_cmpxchg(v, expect, newv) == expect ? 0 : 1;
+}
+
+#endif /* _URCU_RSEQ_H */
@@ -0,0 +1,278 @@
+/*
+ * urcu-shm-domain.c
+ *
+ * Userspace RCU library - RCU domain shared between processes
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+/*
+ * A slot is owned by the process whose pid it holds. A slot of a dead
+ * process is reclaimed by first swapping its pid for SLOT_RECLAIMING,
+ * so that a single thread clears its counter before handing it over:
+ * grace periods free it, registrations take it over.
+ *
+ * A grace period stuck on a slot checks, every LIVENESS_PERIOD_MS,
+ * whether its owner is still alive, sleeping on a pidfd of the owner
+ * when the kernel supports them, so that it notices the death as soon
+ * as it happens. Without pidfds, a dead owner is only noticed once its
+ * parent reaped it.
+ */
+
+#define _LGPL_SOURCE
+#include <stdbool.h>
+#include <stdint.h>
+#include <errno.h>
+#include <poll.h>
+#include <signal.h>
+#include <string.h>
+#include <unistd.h>
+#include <pthread.h>
+
+#include <urcu/compiler.h>
+#include <urcu/arch.h>
+#include <urcu/uatomic.h>
+#include <urcu/syscall-compat.h>
+#include <urcu/shm-domain.h>
+
+#include "urcu-die.h"
+
+#ifdef __NR_pidfd_open
+# define pidfd_open(pid)	syscall(__NR_pidfd_open, pid, 0)
+#else
+# define pidfd_open(pid)	(errno = ENOSYS, -1)
+#endif
+
+#define SHM_DOMAIN_MAGIC	0x75726373	/* "urcs" */
+#define SLOT_RECLAIMING		-1
+#define SPIN_ATTEMPTS		1000
+#define PIDFD_NONE		-1
+#define PIDFD_UNSUPPORTED	-2
+#define LIVENESS_PERIOD_MS	10
+
+static void gp_lock(struct urcu_shm_domain *domain)
+{
+	int ret;
+
+	ret = pthread_mutex_lock(&domain->gp_lock);
+	if (ret == EOWNERDEAD) {
+		/*
+		 * A process died in a grace period: it may only have
+		 * advanced the counter, which the next one advances
+		 * again.
+		 */
+		ret = pthread_mutex_consistent(&domain->gp_lock);
+	}
+	if (ret)
+		urcu_die(ret);
+}
+
+static void gp_unlock(struct urcu_shm_domain *domain)
+{
+	int ret;
+
+	ret = pthread_mutex_unlock(&domain->gp_lock);
+	if (ret)
+		urcu_die(ret);
+}
+
+static bool pid_alive(pid_t pid)
+{
+	return kill(pid, 0) == 0 || errno != ESRCH;
+}
+
+/*
+ * Take over the slot of the dead process @pid. Return false if another
+ * thread reclaimed it first.
+ */
+static bool slot_reclaim(struct urcu_shm_slot *slot, int32_t pid)
+{
+	if (uatomic_cmpxchg(&slot->pid, pid, SLOT_RECLAIMING) != pid)
+		return false;
+	uatomic_set(&slot->ctr, 0);
+	return true;
+}
+
+size_t urcu_shm_domain_size(unsigned int nr_slots)
+{
+	return sizeof(struct urcu_shm_domain)
+		+ (size_t) nr_slots * sizeof(struct urcu_shm_slot);
+}
+
+struct urcu_shm_domain *urcu_shm_domain_init(void *mem, size_t len,
+		unsigned int nr_slots)
+{
+	struct urcu_shm_domain *domain = mem;
+	pthread_mutexattr_t attr;
+	int ret;
+
+	if (!nr_slots || len < urcu_shm_domain_size(nr_slots)
+			|| ((uintptr_t) mem & (CAA_CACHE_LINE_SIZE - 1)))
+		return NULL;
+	memset(domain, 0, urcu_shm_domain_size(nr_slots));
+	domain->header_size = sizeof(struct urcu_shm_domain);
+	domain->slot_size = sizeof(struct urcu_shm_slot);
+	domain->nr_slots = nr_slots;
+	domain->gp_ctr = 1;
+	ret = pthread_mutexattr_init(&attr);
+	if (!ret)
+		ret = pthread_mutexattr_setpshared(&attr,
+				PTHREAD_PROCESS_SHARED);
+	if (!ret)
+		ret = pthread_mutexattr_setrobust(&attr, PTHREAD_MUTEX_ROBUST);
+	if (!ret)
+		ret = pthread_mutex_init(&domain->gp_lock, &attr);
+	if (ret)
+		urcu_die(ret);
+	(void) pthread_mutexattr_destroy(&attr);
+	/* Lay out the domain before attaching processes see it. */
+	uatomic_store_release(&domain->magic, SHM_DOMAIN_MAGIC);
+	return domain;
+}
+
+struct urcu_shm_domain *urcu_shm_domain_attach(void *mem, size_t len)
+{
+	struct urcu_shm_domain *domain = mem;
+
+	if (len < sizeof(*domain)
+			|| ((uintptr_t) mem & (CAA_CACHE_LINE_SIZE - 1))
+			|| uatomic_load_acquire(&domain->magic) != SHM_DOMAIN_MAGIC
+			|| domain->header_size != sizeof(struct urcu_shm_domain)
+			|| domain->slot_size != sizeof(struct urcu_shm_slot)
+			|| len < urcu_shm_domain_size(domain->nr_slots))
+		return NULL;
+	return domain;
+}
+
+int urcu_shm_register_reader(struct urcu_shm_domain *domain,
+		struct urcu_shm_reader *reader)
+{
+	int32_t self = getpid(), pid;
+	struct urcu_shm_slot *slot;
+	unsigned int i;
+
+	/* Free slots first, to leave dead readers to grace periods. */
+	for (i = 0; i < domain->nr_slots; i++) {
+		slot = &domain->slots[i];
+		if (!uatomic_read(&slot->pid)
+				&& !uatomic_cmpxchg(&slot->pid, 0, self))
+			goto found;
+	}
+	for (i = 0; i < domain->nr_slots; i++) {
+		slot = &domain->slots[i];
+		pid = uatomic_read(&slot->pid);
+		if (pid > 0 && !pid_alive(pid) && slot_reclaim(slot, pid)) {
+			uatomic_set(&slot->pid, self);
+			goto found;
+		}
+	}
+	return -ENOSPC;
+found:
+	reader->domain = domain;
+	reader->slot = slot;
+	reader->nesting = 0;
+	return 0;
+}
+
+void urcu_shm_unregister_reader(struct urcu_shm_reader *reader)
+{
+	uatomic_store_release(&reader->slot->pid, 0);
+	reader->slot = NULL;
+}
+
+/*
+ * Sleep for up to LIVENESS_PERIOD_MS, and return whether the owner of
+ * a slot is dead. *pidfd is a pidfd of the owner, PIDFD_NONE if not
+ * open yet, or PIDFD_UNSUPPORTED.
+ */
+static bool wait_owner(int32_t pid, int *pidfd)
+{
+	struct pollfd pfd;
+
+	if (*pidfd == PIDFD_NONE) {
+		*pidfd = pidfd_open(pid);
+		if (*pidfd < 0) {
+			if (errno == ESRCH)
+				return true;
+			*pidfd = PIDFD_UNSUPPORTED;
+		}
+	}
+	if (*pidfd == PIDFD_UNSUPPORTED) {
+		(void) poll(NULL, 0, LIVENESS_PERIOD_MS);
+		return !pid_alive(pid);
+	}
+	pfd.fd = *pidfd;
+	pfd.events = POLLIN;
+	/* A pidfd becomes readable when its process exits. */
+	return poll(&pfd, 1, LIVENESS_PERIOD_MS) > 0;
+}
+
+/* Wait for a slot to leave the read-side critical section it was in. */
+static void wait_for_slot(struct urcu_shm_slot *slot, unsigned long gp_ctr)
+{
+	int pidfd = PIDFD_NONE, attempts = 0;
+	int32_t pid, owner = 0;
+	unsigned long ctr;
+
+	for (;;) {
+		ctr = CMM_LOAD_SHARED(slot->ctr);
+		if (!ctr || ctr == gp_ctr)
+			break;
+		if (attempts < SPIN_ATTEMPTS) {
+			attempts++;
+			caa_cpu_relax();
+			continue;
+		}
+		pid = uatomic_read(&slot->pid);
+		if (pid <= 0) {
+			/* Being reclaimed. */
+			caa_cpu_relax();
+			continue;
+		}
+		if (pid != owner) {
+			/* The slot changed hands: watch its new owner. */
+			if (pidfd >= 0)
+				(void) close(pidfd);
+			if (pidfd != PIDFD_UNSUPPORTED)
+				pidfd = PIDFD_NONE;
+			owner = pid;
+		}
+		if (wait_owner(pid, &pidfd) && slot_reclaim(slot, pid))
+			uatomic_store_release(&slot->pid, 0);
+	}
+	if (pidfd >= 0)
+		(void) close(pidfd);
+}
+
+void urcu_shm_synchronize(struct urcu_shm_domain *domain)
+{
+	unsigned long gp_ctr;
+	unsigned int i;
+
+	gp_lock(domain);
+	/* Order prior unlinking before advancing the counter. */
+	cmm_smp_mb();
+	gp_ctr = domain->gp_ctr + 1;
+	if (caa_unlikely(!gp_ctr))
+		gp_ctr = 1;
+	CMM_STORE_SHARED(domain->gp_ctr, gp_ctr);
+	/* Advance the counter before reading the slots. */
+	cmm_smp_mb();
+	for (i = 0; i < domain->nr_slots; i++)
+		wait_for_slot(&domain->slots[i], gp_ctr);
+	/* Order the slot reads before reclamation. */
+	cmm_smp_mb();
+	gp_unlock(domain);
+}
@@ -0,0 +1,114 @@
+#ifndef _URCU_SPIN_H
+#define _URCU_SPIN_H
+
+/*
+ * urcu-spin.h
+ *
+ * Userspace RCU library - adaptive busy-waiting before futex waits
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <unistd.h>
+#include <urcu/uatomic.h>
+#include "urcu-utils.h"
+
+/*
+ * Number of busy-loop attempts before waiting on futex, and bounds of
+ * the adaptive busy-loop length.
+ */
+#define URCU_SPIN_ATTEMPTS	1000
+#define URCU_SPIN_ATTEMPTS_MIN	16
+#define URCU_SPIN_ATTEMPTS_MAX	(16 * URCU_SPIN_ATTEMPTS)
+
+/*
+ * The busy-loop length is a moving average of the number of attempts
+ * recent waits took, reduced each time the waiter has to sleep on the
+ * futex anyway. Waits are then short when the waker is not running,
+ * e.g. on oversubscribed systems, and cover the usual wake-up latency
+ * otherwise. Updated racily by concurrent waiters, which only affects
+ * the heuristic.
+ */
+
+/*
+ * Spin up to twice the average, so the average can also grow when
+ * wake-ups get slower.
+ */
+static inline
+unsigned int urcu_spin_max_attempts(unsigned int attempts)
+{
+	return min_t(unsigned int, attempts << 1, URCU_SPIN_ATTEMPTS_MAX);
+}
+
+/* New average after a wait of i attempts, which ended in sleep if !met. */
+static inline
+unsigned int urcu_spin_update(unsigned int attempts, unsigned int i, bool met)
+{
+	if (met)
+		attempts += ((int) i - (int) attempts) / 8;
+	else
+		attempts -= attempts / 8;
+	return max_t(unsigned int, attempts, URCU_SPIN_ATTEMPTS_MIN);
+}
+
+/*
+ * Initial average of a consumer spin: spinning is useless when no other
+ * CPU can run the producers.
+ */
+static inline
+unsigned int urcu_consumer_spin_init(void)
+{
+	return sysconf(_SC_NPROCESSORS_ONLN) > 1 ? URCU_SPIN_ATTEMPTS : 0;
+}
+
+/*
+ * Busy-wait for ready(priv) before a consumer sleeps on futex, which is
+ * -1 while producers must wake the consumer. The futex is cleared while
+ * spinning, so that producers skip the FUTEX_WAKE system call, and set
+ * back to -1 before a last check of ready(priv), ordered after it.
+ *
+ * Returns true if ready(priv), in which case the consumer does not
+ * sleep. Otherwise it can sleep on the futex with the usual protocol.
+ * *attempts_p is the average of the consumer, 0 disabling the spin.
+ */
+static inline
+bool urcu_consumer_spin(int32_t *futex, unsigned int *attempts_p,
+		bool (*ready)(void *priv), void *priv)
+{
+	unsigned int i, attempts = CMM_LOAD_SHARED(*attempts_p);
+	unsigned int max_attempts;
+	bool met = false;
+
+	if (!attempts)
+		return false;
+	max_attempts = urcu_spin_max_attempts(attempts);
+	uatomic_set(futex, 0);
+	for (i = 0; i < max_attempts; i++) {
+		if (ready(priv)) {
+			met = true;
+			break;
+		}
+		caa_cpu_relax();
+	}
+	CMM_STORE_SHARED(*attempts_p, urcu_spin_update(attempts, i, met));
+	uatomic_set(futex, -1);
+	/* Write futex before reading the condition. */
+	cmm_smp_mb();
+	return met || ready(priv);
+}
+
+#endif /* _URCU_SPIN_H */
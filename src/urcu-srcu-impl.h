@@ -0,0 +1,652 @@
+#ifndef _URCU_SRCU_IMPL_H
+#define _URCU_SRCU_IMPL_H
+
+/*
+ * urcu-srcu-impl.h
+ *
+ * Userspace RCU library - RCU domains with independent grace periods
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+/*
+ * Domains use the same two-phase grace-period counter as the flavor
+ * (see urcu/static/urcu-common.h), with their own urcu_gp and their own
+ * reader registry. Per-thread reader state is found through a pthread
+ * key, because a thread can be a reader of any number of domains.
+ *
+ * The flavor memory barriers are reused: the read-side barriers are the
+ * flavor slave barriers, and the grace period uses smp_mb_master(). In
+ * the signal flavor, smp_mb_master() only reaches threads registered
+ * with the flavor, which is why domain readers must also be registered
+ * with the flavor.
+ *
+ * Lock ordering: domain gp_lock, then domain registry_lock, then
+ * rcu_registry_lock.
+ */
+
+#include <urcu/srcu.h>
+
+#define SRCU_WORKER_RUNNING	(1U << 0)
+#define SRCU_WORKER_STOP	(1U << 1)
+
+struct srcu_domain {
+	struct urcu_gp gp;
+	pthread_mutex_t gp_lock;
+	pthread_mutex_t registry_lock;
+	struct cds_list_head registry;
+	pthread_key_t reader_key;
+	struct urcu_gp_stats stats;	/* Written with gp_lock held. */
+
+	/*
+	 * Callbacks of call_srcu(), invoked by the worker thread of the
+	 * domain after a grace period of the domain. The worker is created
+	 * by the first call_srcu(), with worker_lock held.
+	 */
+	struct cds_wfcq_head cbs_head;
+	struct cds_wfcq_tail cbs_tail;
+	int32_t futex;			/* -1 while the worker sleeps */
+	int32_t barrier_seq;		/* Futex of srcu_barrier() waiters */
+	unsigned int flags;		/* SRCU_WORKER_* */
+	pthread_mutex_t worker_lock;
+	pthread_t worker;
+	unsigned long qlen;
+	struct urcu_call_rcu_stats cb_stats;	/* Written by the worker. */
+};
+
+struct srcu_barrier {
+	struct rcu_head head;
+	struct srcu_domain *domain;
+	int done;
+};
+
+struct srcu_defer {
+	struct rcu_head head;
+	void (*fct)(void *p);
+	void *p;
+};
+
+struct srcu_reader {
+	struct urcu_reader reader;
+	struct srcu_domain *domain;
+};
+
+static inline void srcu_smp_mb_slave(void)
+{
+#ifdef RCU_MEMBARRIER
+	urcu_memb_smp_mb_slave();
+#elif defined(RCU_MB)
+	cmm_smp_mb();
+#else
+	cmm_barrier();
+#endif
+}
+
+/*
+ * smp_mb_master() iterates on the flavor registry: to signal readers
+ * without sys_membarrier, or to find the CPUs of isolated readers.
+ */
+static void srcu_smp_mb_master(void)
+{
+	mutex_lock(&rcu_registry_lock);
+	smp_mb_master();
+	mutex_unlock(&rcu_registry_lock);
+}
+
+static void srcu_reader_free(struct srcu_reader *sr)
+{
+	struct srcu_domain *domain = sr->domain;
+
+	mutex_lock(&domain->registry_lock);
+	cds_list_del(&sr->reader.node);
+	mutex_unlock(&domain->registry_lock);
+	free(sr);
+}
+
+/* Threads exiting without srcu_unregister_thread(). */
+static void srcu_reader_destroy(void *arg)
+{
+	srcu_reader_free(arg);
+}
+
+struct srcu_domain *srcu_domain_create(void)
+{
+	struct srcu_domain *domain;
+	int ret;
+
+	ret = posix_memalign((void **) &domain, CAA_CACHE_LINE_SIZE,
+			sizeof(*domain));
+	if (ret)
+		return NULL;
+	memset(domain, 0, sizeof(*domain));
+	domain->gp.ctr = URCU_GP_COUNT;
+	ret = pthread_key_create(&domain->reader_key, srcu_reader_destroy);
+	if (ret) {
+		free(domain);
+		return NULL;
+	}
+	pthread_mutex_init(&domain->gp_lock, NULL);
+	pthread_mutex_init(&domain->registry_lock, NULL);
+	pthread_mutex_init(&domain->worker_lock, NULL);
+	CDS_INIT_LIST_HEAD(&domain->registry);
+	cds_wfcq_init(&domain->cbs_head, &domain->cbs_tail);
+	rcu_init();	/* In case gcc does not support constructor attribute */
+#ifdef RCU_ISOLATED_READERS
+	/* Domain readers need not be registered with the flavor. */
+	mutex_lock(&rcu_registry_lock);
+	nr_unbound_readers++;
+	mutex_unlock(&rcu_registry_lock);
+#endif
+	return domain;
+}
+
+static void srcu_worker_stop(struct srcu_domain *domain);
+
+/*
+ * All readers must have been unregistered from the domain. Pending
+ * call_srcu() callbacks are invoked first.
+ */
+void srcu_domain_destroy(struct srcu_domain *domain)
+{
+	int ret;
+
+	if (!domain)
+		return;
+	srcu_worker_stop(domain);
+	assert(cds_list_empty(&domain->registry));
+#ifdef RCU_ISOLATED_READERS
+	mutex_lock(&rcu_registry_lock);
+	nr_unbound_readers--;
+	mutex_unlock(&rcu_registry_lock);
+#endif
+	ret = pthread_key_delete(domain->reader_key);
+	if (ret)
+		urcu_die(ret);
+	(void) pthread_mutex_destroy(&domain->gp_lock);
+	(void) pthread_mutex_destroy(&domain->registry_lock);
+	(void) pthread_mutex_destroy(&domain->worker_lock);
+	cds_wfcq_destroy(&domain->cbs_head, &domain->cbs_tail);
+	free(domain);
+}
+
+void srcu_register_thread(struct srcu_domain *domain)
+{
+	struct srcu_reader *sr;
+	int ret;
+
+	assert(!pthread_getspecific(domain->reader_key));
+	sr = caa_cache_line_alloc(sizeof(*sr));
+	if (!sr)
+		urcu_die(errno);
+	memset(sr, 0, sizeof(*sr));
+	sr->reader.tid = pthread_self();
+	sr->reader.registered = 1;
+	sr->domain = domain;
+
+	mutex_lock(&domain->registry_lock);
+	cds_list_add(&sr->reader.node, &domain->registry);
+	mutex_unlock(&domain->registry_lock);
+
+	ret = pthread_setspecific(domain->reader_key, sr);
+	if (ret)
+		urcu_die(ret);
+}
+
+void srcu_unregister_thread(struct srcu_domain *domain)
+{
+	struct srcu_reader *sr;
+	int ret;
+
+	sr = pthread_getspecific(domain->reader_key);
+	assert(sr);
+	assert(!(sr->reader.ctr & URCU_GP_CTR_NEST_MASK));
+	ret = pthread_setspecific(domain->reader_key, NULL);
+	if (ret)
+		urcu_die(ret);
+	srcu_reader_free(sr);
+}
+
+/*
+ * Same as _rcu_read_lock() and _rcu_read_unlock(), on the reader state
+ * of the current thread for this domain.
+ */
+void srcu_read_lock(struct srcu_domain *domain)
+{
+	struct srcu_reader *sr = pthread_getspecific(domain->reader_key);
+	unsigned long tmp;
+
+	urcu_assert(sr);
+	cmm_barrier();
+	tmp = sr->reader.ctr;
+	urcu_assert((tmp & URCU_GP_CTR_NEST_MASK) != URCU_GP_CTR_NEST_MASK);
+	if (caa_likely(!(tmp & URCU_GP_CTR_NEST_MASK))) {
+		_CMM_STORE_SHARED(sr->reader.ctr,
+			_CMM_LOAD_SHARED(domain->gp.ctr));
+		srcu_smp_mb_slave();
+	} else
+		_CMM_STORE_SHARED(sr->reader.ctr, tmp + URCU_GP_COUNT);
+}
+
+void srcu_read_unlock(struct srcu_domain *domain)
+{
+	struct srcu_reader *sr = pthread_getspecific(domain->reader_key);
+	unsigned long tmp;
+
+	urcu_assert(sr);
+	tmp = sr->reader.ctr;
+	urcu_assert(tmp & URCU_GP_CTR_NEST_MASK);
+	if (caa_likely((tmp & URCU_GP_CTR_NEST_MASK) == URCU_GP_COUNT)) {
+		srcu_smp_mb_slave();
+		_CMM_STORE_SHARED(sr->reader.ctr, tmp - URCU_GP_COUNT);
+		srcu_smp_mb_slave();
+		urcu_common_wake_up_gp(&domain->gp);
+	} else
+		_CMM_STORE_SHARED(sr->reader.ctr, tmp - URCU_GP_COUNT);
+	cmm_barrier();
+}
+
+int srcu_read_ongoing(struct srcu_domain *domain)
+{
+	struct srcu_reader *sr = pthread_getspecific(domain->reader_key);
+
+	return sr && (sr->reader.ctr & URCU_GP_CTR_NEST_MASK);
+}
+
+/*
+ * Always called with the domain registry lock held. Releases this lock
+ * and grabs it again. Holds the lock when it returns.
+ */
+static void srcu_wait_gp(struct srcu_domain *domain)
+{
+	/* Read reader_gp before read futex. */
+	srcu_smp_mb_master();
+	mutex_unlock(&domain->registry_lock);
+	if (uatomic_read(&domain->gp.futex) != -1)
+		goto end;
+	urcu_stats_futex_wait(&domain->stats);
+	while (futex_async(&domain->gp.futex, FUTEX_WAIT, -1,
+			NULL, NULL, 0)) {
+		switch (errno) {
+		case EWOULDBLOCK:
+			/* Value already changed. */
+			goto end;
+		case EINTR:
+			/* Retry if interrupted by signal. */
+			break;	/* Get out of switch. */
+		default:
+			/* Unexpected error. */
+			urcu_die(errno);
+		}
+	}
+end:
+	mutex_lock(&domain->registry_lock);
+}
+
+/*
+ * Same as wait_for_readers(), on the domain registry. Always called
+ * with the domain registry lock held.
+ */
+static void srcu_wait_for_readers(struct srcu_domain *domain,
+			struct cds_list_head *input_readers,
+			struct cds_list_head *cur_snap_readers,
+			struct cds_list_head *qsreaders)
+{
+	unsigned int wait_loops = 0;
+	struct urcu_reader *index, *tmp;
+#ifdef HAS_INCOHERENT_CACHES
+	unsigned int wait_gp_loops = 0;
+#endif /* HAS_INCOHERENT_CACHES */
+
+	for (;;) {
+		if (wait_loops < RCU_QS_ACTIVE_ATTEMPTS)
+			wait_loops++;
+		if (wait_loops >= RCU_QS_ACTIVE_ATTEMPTS) {
+			uatomic_dec(&domain->gp.futex);
+			/* Write futex before read reader_gp */
+			srcu_smp_mb_master();
+		}
+
+		cds_list_for_each_entry_safe(index, tmp, input_readers, node) {
+			switch (urcu_common_reader_state(&domain->gp,
+					&index->ctr)) {
+			case URCU_READER_ACTIVE_CURRENT:
+				if (cur_snap_readers) {
+					cds_list_move(&index->node,
+						cur_snap_readers);
+					break;
+				}
+				/* Fall-through */
+			case URCU_READER_INACTIVE:
+				cds_list_move(&index->node, qsreaders);
+				break;
+			case URCU_READER_ACTIVE_OLD:
+				break;
+			}
+		}
+
+		if (cds_list_empty(input_readers)) {
+			if (wait_loops >= RCU_QS_ACTIVE_ATTEMPTS) {
+				/* Read reader_gp before write futex */
+				srcu_smp_mb_master();
+				uatomic_set(&domain->gp.futex, 0);
+			}
+			break;
+		}
+#ifdef HAS_INCOHERENT_CACHES
+		/* Force readers to commit their ctr update to memory. */
+		if (++wait_gp_loops == KICK_READER_LOOPS) {
+			srcu_smp_mb_master();
+			wait_gp_loops = 0;
+		}
+#endif /* HAS_INCOHERENT_CACHES */
+		if (wait_loops >= RCU_QS_ACTIVE_ATTEMPTS) {
+			srcu_wait_gp(domain);
+		} else {
+			mutex_unlock(&domain->registry_lock);
+			caa_cpu_relax();
+			mutex_lock(&domain->registry_lock);
+		}
+	}
+}
+
+/*
+ * Wait for the pre-existing read-side critical sections of domain. The
+ * grace period follows the same steps as do_synchronize_rcu().
+ */
+void synchronize_srcu(struct srcu_domain *domain)
+{
+	CDS_LIST_HEAD(cur_snap_readers);
+	CDS_LIST_HEAD(qsreaders);
+	uint64_t gp_start;
+
+	mutex_lock(&domain->gp_lock);
+	gp_start = urcu_stats_gp_start();
+	urcu_gp_seq_start(&domain->gp.seq);
+	mutex_lock(&domain->registry_lock);
+
+	if (cds_list_empty(&domain->registry))
+		goto out;
+
+	/* Write new ptr before changing the qparity */
+	srcu_smp_mb_master();
+
+	srcu_wait_for_readers(domain, &domain->registry, &cur_snap_readers,
+			&qsreaders);
+
+	cmm_smp_mb();
+	/* Switch parity: 0 -> 1, 1 -> 0 */
+	CMM_STORE_SHARED(domain->gp.ctr, domain->gp.ctr ^ URCU_GP_CTR_PHASE);
+	cmm_smp_mb();
+
+	srcu_wait_for_readers(domain, &cur_snap_readers, NULL, &qsreaders);
+
+	cds_list_splice(&qsreaders, &domain->registry);
+
+	/* Finish waiting for readers before letting the old ptr be freed. */
+	srcu_smp_mb_master();
+out:
+	urcu_gp_seq_end(&domain->gp.seq);
+	urcu_stats_gp_end(&domain->stats, gp_start);
+	mutex_unlock(&domain->registry_lock);
+	mutex_unlock(&domain->gp_lock);
+}
+
+unsigned long get_state_synchronize_srcu(struct srcu_domain *domain)
+{
+	return urcu_gp_seq_snap(&domain->gp.seq);
+}
+
+int poll_state_synchronize_srcu(struct srcu_domain *domain,
+		unsigned long cookie)
+{
+	return urcu_gp_seq_done(&domain->gp.seq, cookie);
+}
+
+void cond_synchronize_srcu(struct srcu_domain *domain, unsigned long cookie)
+{
+	if (!poll_state_synchronize_srcu(domain, cookie))
+		synchronize_srcu(domain);
+}
+
+/* Wait for callbacks to be queued, or for the worker to be stopped. */
+static void srcu_worker_wait(struct srcu_domain *domain)
+{
+	/* Read callback queue before read futex */
+	cmm_smp_mb();
+	if (uatomic_read(&domain->futex) != -1)
+		return;
+	while (futex_async(&domain->futex, FUTEX_WAIT_PRIVATE, -1,
+			NULL, NULL, 0)) {
+		switch (errno) {
+		case EWOULDBLOCK:
+			/* Value already changed. */
+			return;
+		case EINTR:
+			/* Retry if interrupted by signal. */
+			break;	/* Get out of switch. */
+		default:
+			/* Unexpected error. */
+			urcu_die(errno);
+		}
+	}
+}
+
+static void srcu_worker_wake_up(struct srcu_domain *domain)
+{
+	/* Write to callback queue or flags before reading/writing futex */
+	cmm_smp_mb();
+	if (caa_unlikely(uatomic_read(&domain->futex) == -1)) {
+		uatomic_set(&domain->futex, 0);
+		if (futex_async(&domain->futex, FUTEX_WAKE_PRIVATE, 1,
+				NULL, NULL, 0) < 0)
+			urcu_die(errno);
+	}
+}
+
+/*
+ * Invoke the callbacks queued by call_srcu() in batches, each after a
+ * grace period of the domain started once the batch is taken. The worker
+ * is a reader of the flavor and of the domain, so that callbacks may
+ * enter read-side critical sections of both.
+ */
+static void *srcu_worker_thread(void *arg)
+{
+	struct srcu_domain *domain = arg;
+
+	rcu_register_thread();
+	srcu_register_thread(domain);
+	for (;;) {
+		struct cds_wfcq_head cbs_head;
+		struct cds_wfcq_tail cbs_tail;
+		struct cds_wfcq_node *cbs, *cbs_tmp_n;
+		enum cds_wfcq_ret splice_ret;
+		unsigned long count = 0;
+
+		cds_wfcq_init(&cbs_head, &cbs_tail);
+		splice_ret = __cds_wfcq_splice_blocking(&cbs_head, &cbs_tail,
+				&domain->cbs_head, &domain->cbs_tail);
+		assert(splice_ret != CDS_WFCQ_RET_WOULDBLOCK);
+		assert(splice_ret != CDS_WFCQ_RET_DEST_NON_EMPTY);
+		if (splice_ret != CDS_WFCQ_RET_SRC_EMPTY) {
+			synchronize_srcu(domain);
+			__cds_wfcq_for_each_blocking_safe(&cbs_head, &cbs_tail,
+					cbs, cbs_tmp_n) {
+				struct rcu_head *rhp;
+
+				rhp = caa_container_of(cbs,
+					struct rcu_head, next);
+				rhp->func(rhp);
+				count++;
+			}
+			uatomic_sub(&domain->qlen, count);
+			CMM_STORE_SHARED(domain->cb_stats.invoked,
+				domain->cb_stats.invoked + count);
+			CMM_STORE_SHARED(domain->cb_stats.batches,
+				domain->cb_stats.batches + 1);
+			if (count > domain->cb_stats.batch_max)
+				CMM_STORE_SHARED(domain->cb_stats.batch_max,
+					count);
+			continue;
+		}
+		if (uatomic_read(&domain->flags) & SRCU_WORKER_STOP)
+			break;
+		uatomic_dec(&domain->futex);
+		/* Write futex before reading callback queue and flags */
+		cmm_smp_mb();
+		if (cds_wfcq_empty(&domain->cbs_head, &domain->cbs_tail)
+				&& !(uatomic_read(&domain->flags)
+					& SRCU_WORKER_STOP))
+			srcu_worker_wait(domain);
+		uatomic_set(&domain->futex, 0);
+	}
+	srcu_unregister_thread(domain);
+	rcu_unregister_thread();
+	return NULL;
+}
+
+static void srcu_worker_start(struct srcu_domain *domain)
+{
+	int ret;
+
+	mutex_lock(&domain->worker_lock);
+	if (!(uatomic_read(&domain->flags) & SRCU_WORKER_RUNNING)) {
+		ret = pthread_create(&domain->worker, NULL,
+				srcu_worker_thread, domain);
+		if (ret)
+			urcu_die(ret);
+		uatomic_or(&domain->flags, SRCU_WORKER_RUNNING);
+	}
+	mutex_unlock(&domain->worker_lock);
+}
+
+/* Invoke the pending callbacks and join the worker, if any. */
+static void srcu_worker_stop(struct srcu_domain *domain)
+{
+	int ret;
+
+	if (!(uatomic_read(&domain->flags) & SRCU_WORKER_RUNNING))
+		return;
+	uatomic_or(&domain->flags, SRCU_WORKER_STOP);
+	srcu_worker_wake_up(domain);
+	ret = pthread_join(domain->worker, NULL);
+	if (ret)
+		urcu_die(ret);
+}
+
+/*
+ * Queue func(head) to be invoked by the worker of the domain after a
+ * grace period of the domain. Never waits for the grace period, so it
+ * can be called from within a read-side critical section of the domain.
+ */
+void call_srcu(struct srcu_domain *domain, struct rcu_head *head,
+		void (*func)(struct rcu_head *head))
+{
+	cds_wfcq_node_init(&head->next);
+	head->func = func;
+	if (caa_unlikely(!(uatomic_read(&domain->flags)
+			& SRCU_WORKER_RUNNING)))
+		srcu_worker_start(domain);
+	uatomic_inc(&domain->qlen);
+	cds_wfcq_enqueue(&domain->cbs_head, &domain->cbs_tail, &head->next);
+	srcu_worker_wake_up(domain);
+}
+
+static void srcu_defer_cb(struct rcu_head *head)
+{
+	struct srcu_defer *work = caa_container_of(head,
+			struct srcu_defer, head);
+
+	work->fct(work->p);
+	free(work);
+}
+
+/*
+ * Same as call_srcu(), for a function taking a pointer. Out of memory,
+ * waits for a grace period of the domain and calls fct(p) directly, so,
+ * as defer_rcu(), it must not be used within a read-side critical
+ * section of the domain.
+ */
+void defer_srcu(struct srcu_domain *domain, void (*fct)(void *p), void *p)
+{
+	struct srcu_defer *work;
+
+	work = malloc(sizeof(*work));
+	if (caa_unlikely(!work)) {
+		synchronize_srcu(domain);
+		fct(p);
+		return;
+	}
+	work->fct = fct;
+	work->p = p;
+	call_srcu(domain, &work->head, srcu_defer_cb);
+}
+
+static void srcu_barrier_cb(struct rcu_head *head)
+{
+	struct srcu_barrier *barrier = caa_container_of(head,
+			struct srcu_barrier, head);
+	struct srcu_domain *domain = barrier->domain;
+
+	/* The waiter may return as soon as done is set. */
+	uatomic_set(&barrier->done, 1);
+	cmm_smp_mb();
+	uatomic_inc(&domain->barrier_seq);
+	cmm_smp_mb();
+	if (futex_async(&domain->barrier_seq, FUTEX_WAKE_PRIVATE, INT_MAX,
+			NULL, NULL, 0) < 0)
+		urcu_die(errno);
+}
+
+/*
+ * Wait for the call_srcu() callbacks queued on the domain prior to this
+ * call to be invoked. Must not be called from within a read-side
+ * critical section of the domain, nor from a callback.
+ */
+void srcu_barrier(struct srcu_domain *domain)
+{
+	struct srcu_barrier barrier = { .domain = domain };
+	int32_t seq;
+
+	call_srcu(domain, &barrier.head, srcu_barrier_cb);
+	for (;;) {
+		seq = uatomic_read(&domain->barrier_seq);
+		/* Read barrier_seq before done */
+		cmm_smp_mb();
+		if (uatomic_read(&barrier.done))
+			break;
+		if (futex_async(&domain->barrier_seq, FUTEX_WAIT_PRIVATE, seq,
+				NULL, NULL, 0)) {
+			switch (errno) {
+			case EWOULDBLOCK:
+			case EINTR:
+				break;
+			default:
+				urcu_die(errno);
+			}
+		}
+	}
+}
+
+void srcu_get_stats(struct srcu_domain *domain, struct urcu_stats *stats)
+{
+	urcu_stats_snapshot(&domain->stats, stats);
+	stats->call_rcu.qlen = uatomic_read(&domain->qlen);
+	stats->call_rcu.invoked = CMM_LOAD_SHARED(domain->cb_stats.invoked);
+	stats->call_rcu.batches = CMM_LOAD_SHARED(domain->cb_stats.batches);
+	stats->call_rcu.batch_max =
+		CMM_LOAD_SHARED(domain->cb_stats.batch_max);
+}
+
+#endif /* _URCU_SRCU_IMPL_H */
@@ -0,0 +1,245 @@
+#ifndef _URCU_STALL_IMPL_H
+#define _URCU_STALL_IMPL_H
+
+/*
+ * urcu-stall.h
+ *
+ * Userspace RCU library reader stall watchdog
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+#include <errno.h>
+#include <pthread.h>
+#include <sched.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <time.h>
+
+#include <urcu/config.h>
+#include <urcu/compiler.h>
+
+#include "urcu-stats.h"
+
+/* Readers boosted at once, the others keep their priority. */
+#define URCU_STALL_MAX_BOOSTED	32
+
+struct urcu_stall_boosted {
+	pthread_t tid;
+	int policy;			/* to restore */
+	struct sched_param param;	/* to restore */
+};
+
+/*
+ * All fields are accessed with the flavor grace-period lock held, so
+ * the configuration cannot change during a wait. The boosted readers
+ * are also accessed with the reader registry lock held, by readers
+ * unregistering while boosted.
+ */
+struct urcu_stall_watchdog {
+	unsigned long threshold_ms;
+	void (*func)(pthread_t tid, uint64_t active_ns, void *priv);
+	void *priv;
+	/* Reader boost, see rcu_set_reader_boost(). */
+	unsigned long boost_ms;
+	int boost_policy;
+	struct sched_param boost_param;
+	/* Current wait for readers. */
+	uint64_t wait_start_ns;
+	uint64_t next_report_ns;	/* UINT64_MAX without reports */
+	uint64_t next_boost_ns;		/* UINT64_MAX without boost */
+	bool report_due, boost_due;	/* in the current check */
+	unsigned int nr_boosted;
+	struct urcu_stall_boosted boosted[URCU_STALL_MAX_BOOSTED];
+};
+
+static inline
+void urcu_stall_set(struct urcu_stall_watchdog *wd, unsigned long threshold_ms,
+		void (*func)(pthread_t tid, uint64_t active_ns, void *priv),
+		void *priv)
+{
+	if (!func)
+		threshold_ms = 0;
+	wd->threshold_ms = threshold_ms;
+	wd->func = func;
+	wd->priv = priv;
+}
+
+static inline
+int urcu_stall_set_boost(struct urcu_stall_watchdog *wd,
+		unsigned long boost_ms, int policy, int priority)
+{
+	int min, max;
+
+	if (boost_ms) {
+		min = sched_get_priority_min(policy);
+		max = sched_get_priority_max(policy);
+		if (min < 0 || max < 0 || priority < min || priority > max)
+			return -EINVAL;
+	}
+	wd->boost_ms = boost_ms;
+	wd->boost_policy = policy;
+	wd->boost_param.sched_priority = priority;
+	return 0;
+}
+
+static inline
+bool urcu_stall_enabled(struct urcu_stall_watchdog *wd)
+{
+	return wd->threshold_ms || wd->boost_ms;
+}
+
+/*
+ * Start a wait for pre-existing readers. Readers still blocking the
+ * wait later on were within their critical section when it started.
+ */
+static inline
+void urcu_stall_wait_start(struct urcu_stall_watchdog *wd)
+{
+	if (!urcu_stall_enabled(wd))
+		return;
+	wd->wait_start_ns = urcu_stats_now_ns();
+	wd->next_report_ns = wd->threshold_ms ? wd->wait_start_ns
+		+ (uint64_t) wd->threshold_ms * 1000000ULL : UINT64_MAX;
+	wd->next_boost_ns = wd->boost_ms ? wd->wait_start_ns
+		+ (uint64_t) wd->boost_ms * 1000000ULL : UINT64_MAX;
+}
+
+/*
+ * Returns the duration of the current wait if a report or a boost is
+ * due, in which case the next one is scheduled threshold_ms or boost_ms
+ * later, or 0.
+ */
+static inline
+uint64_t urcu_stall_report_due(struct urcu_stall_watchdog *wd)
+{
+	uint64_t now;
+
+	if (caa_likely(!urcu_stall_enabled(wd)))
+		return 0;
+	now = urcu_stats_now_ns();
+	wd->report_due = now >= wd->next_report_ns;
+	wd->boost_due = now >= wd->next_boost_ns;
+	if (!wd->report_due && !wd->boost_due)
+		return 0;
+	if (wd->report_due)
+		wd->next_report_ns = now
+			+ (uint64_t) wd->threshold_ms * 1000000ULL;
+	if (wd->boost_due)
+		wd->next_boost_ns = now + (uint64_t) wd->boost_ms * 1000000ULL;
+	return now - wd->wait_start_ns;
+}
+
+static inline
+void urcu_stall_report(struct urcu_stall_watchdog *wd, pthread_t tid,
+		uint64_t active_ns)
+{
+	if (wd->report_due)
+		wd->func(tid, active_ns, wd->priv);
+}
+
+/*
+ * Boost a reader reported as stalled, if due. The reader must be kept
+ * registered by the reader registry lock, and must be a thread rather
+ * than a reader context, whose creator may have exited. Readers which
+ * cannot be boosted, for lack of privilege, keep their priority.
+ */
+static inline
+void urcu_stall_boost(struct urcu_stall_watchdog *wd, pthread_t tid)
+{
+	struct urcu_stall_boosted *b;
+	unsigned int i;
+
+	if (!wd->boost_due || wd->nr_boosted == URCU_STALL_MAX_BOOSTED)
+		return;
+	for (i = 0; i < wd->nr_boosted; i++) {
+		if (pthread_equal(wd->boosted[i].tid, tid))
+			return;
+	}
+	b = &wd->boosted[wd->nr_boosted];
+	if (pthread_getschedparam(tid, &b->policy, &b->param))
+		return;
+	if (b->policy == wd->boost_policy && b->param.sched_priority
+			>= wd->boost_param.sched_priority)
+		return;
+	if (pthread_setschedparam(tid, wd->boost_policy, &wd->boost_param))
+		return;
+	b->tid = tid;
+	wd->nr_boosted++;
+}
+
+/*
+ * End a grace period wait for readers, restoring the priority of the
+ * readers boosted. Called with the reader registry lock held.
+ */
+static inline
+void urcu_stall_wait_end(struct urcu_stall_watchdog *wd)
+{
+	struct urcu_stall_boosted *b;
+
+	for (; wd->nr_boosted; wd->nr_boosted--) {
+		b = &wd->boosted[wd->nr_boosted - 1];
+		(void) pthread_setschedparam(b->tid, b->policy, &b->param);
+	}
+}
+
+/*
+ * Restore the priority of the current thread if it was boosted, as it
+ * unregisters. Called with the reader registry lock held.
+ */
+static inline
+void urcu_stall_unregister(struct urcu_stall_watchdog *wd)
+{
+	pthread_t self = pthread_self();
+	unsigned int i;
+
+	for (i = 0; i < wd->nr_boosted; i++) {
+		if (!pthread_equal(wd->boosted[i].tid, self))
+			continue;
+		(void) pthread_setschedparam(self, wd->boosted[i].policy,
+			&wd->boosted[i].param);
+		wd->boosted[i] = wd->boosted[--wd->nr_boosted];
+		return;
+	}
+}
+
+/*
+ * Timeout for a futex wait of the current wait, so that it wakes up
+ * when the next report or boost is due. Returns NULL when the watchdog
+ * is disabled, and with the futex compatibility layer, which does not
+ * support timeouts: reports are then only issued on wake-ups.
+ */
+static inline
+const struct timespec *urcu_stall_timeout(struct urcu_stall_watchdog *wd,
+		struct timespec *ts)
+{
+#ifdef CONFIG_RCU_HAVE_FUTEX
+	uint64_t now, next, delay;
+
+	if (!urcu_stall_enabled(wd))
+		return NULL;
+	now = urcu_stats_now_ns();
+	next = wd->next_report_ns < wd->next_boost_ns ?
+		wd->next_report_ns : wd->next_boost_ns;
+	delay = next > now ? next - now : 0;
+	ts->tv_sec = delay / 1000000000ULL;
+	ts->tv_nsec = delay % 1000000000ULL;
+	return ts;
+#else
+	return NULL;
+#endif
+}
+
+#endif /* _URCU_STALL_IMPL_H */
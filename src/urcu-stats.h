@@ -0,0 +1,141 @@
+#ifndef _URCU_STATS_IMPL_H
+#define _URCU_STATS_IMPL_H
+
+/*
+ * urcu-stats.h
+ *
+ * Userspace RCU library grace-period statistics
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+#include <stdint.h>
+#include <string.h>
+#include <time.h>
+
+#include <urcu/system.h>
+#include <urcu/stats.h>
+
+#include "urcu-tp.h"
+
+/*
+ * Grace-period statistics are only written by the thread performing the
+ * grace period, with the flavor grace-period lock held, so plain
+ * increments published with CMM_STORE_SHARED() are enough. Readers of
+ * a snapshot may observe counters from different grace periods.
+ */
+struct urcu_gp_stats {
+	unsigned long gp_count;
+	unsigned long expedited_count;
+	unsigned long futex_wait_count;
+	unsigned long duration_hist[URCU_STATS_GP_HIST_BUCKETS];
+	uint64_t reader_wait_max_ns;
+};
+
+/*
+ * Contention statistics of the internal mutexes of a flavor, each only
+ * written with its mutex held.
+ */
+struct urcu_flavor_lock_stats {
+	struct urcu_lock_stats gp;
+	struct urcu_lock_stats registry;
+	struct urcu_lock_stats call_rcu;
+	struct urcu_lock_stats defer;
+};
+
+static inline
+uint64_t urcu_stats_now_ns(void)
+{
+	struct timespec ts;
+
+	if (clock_gettime(CLOCK_MONOTONIC, &ts))
+		return 0;
+	return (uint64_t) ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+/*
+ * Returns the start time of a grace period, to be passed to
+ * urcu_stats_gp_end(). The grace-period statistics hooks of every
+ * flavor also emit the gp_start, gp_end and gp_futex_wait probes.
+ */
+static inline
+uint64_t urcu_stats_gp_start(void)
+{
+	urcu_tp(gp_start);
+	return urcu_stats_now_ns();
+}
+
+static inline
+void urcu_stats_gp_end(struct urcu_gp_stats *stats, uint64_t start)
+{
+	uint64_t duration = urcu_stats_now_ns() - start;
+	uint64_t us = duration / 1000;
+	unsigned int bucket = 0;
+
+	while (us && bucket < URCU_STATS_GP_HIST_BUCKETS - 1) {
+		us >>= 1;
+		bucket++;
+	}
+	CMM_STORE_SHARED(stats->duration_hist[bucket],
+		stats->duration_hist[bucket] + 1);
+	if (duration > stats->reader_wait_max_ns)
+		CMM_STORE_SHARED(stats->reader_wait_max_ns, duration);
+	CMM_STORE_SHARED(stats->gp_count, stats->gp_count + 1);
+	urcu_tp2(gp_end, duration, stats->gp_count);
+}
+
+static inline
+void urcu_stats_expedited(struct urcu_gp_stats *stats)
+{
+	CMM_STORE_SHARED(stats->expedited_count, stats->expedited_count + 1);
+}
+
+static inline
+void urcu_stats_futex_wait(struct urcu_gp_stats *stats)
+{
+	CMM_STORE_SHARED(stats->futex_wait_count, stats->futex_wait_count + 1);
+	urcu_tp(gp_futex_wait);
+}
+
+/*
+ * Fill the grace-period part of a snapshot. The call_rcu part is left
+ * zeroed.
+ */
+static inline
+void urcu_stats_snapshot(struct urcu_gp_stats *stats, struct urcu_stats *out)
+{
+	unsigned int i;
+
+	memset(out, 0, sizeof(*out));
+	out->gp_count = CMM_LOAD_SHARED(stats->gp_count);
+	out->gp_expedited_count = CMM_LOAD_SHARED(stats->expedited_count);
+	out->gp_futex_wait_count = CMM_LOAD_SHARED(stats->futex_wait_count);
+	for (i = 0; i < URCU_STATS_GP_HIST_BUCKETS; i++)
+		out->gp_duration_hist[i] =
+			CMM_LOAD_SHARED(stats->duration_hist[i]);
+	out->reader_wait_max_ns = CMM_LOAD_SHARED(stats->reader_wait_max_ns);
+}
+
+static inline
+void urcu_stats_lock_snapshot(struct urcu_lock_stats *stats,
+		struct urcu_lock_stats *out)
+{
+	out->acquisitions = CMM_LOAD_SHARED(stats->acquisitions);
+	out->contended = CMM_LOAD_SHARED(stats->contended);
+	out->wait_ns = CMM_LOAD_SHARED(stats->wait_ns);
+	out->wait_max_ns = CMM_LOAD_SHARED(stats->wait_max_ns);
+}
+
+#endif /* _URCU_STATS_IMPL_H */
@@ -0,0 +1,56 @@
+#ifndef _URCU_TP_H
+#define _URCU_TP_H
+
+/*
+ * urcu-tp.h
+ *
+ * Userspace RCU library static tracepoints
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+/*
+ * USDT probes of the "urcu" provider, built when configure finds
+ * <sys/sdt.h>. An unattached probe is a single nop: its arguments must
+ * be values already at hand. Each flavor library carries its own
+ * probes, so tracers select the flavor with the library path, e.g.:
+ *
+ *	bpftrace -e 'usdt:/usr/lib/liburcu-qsbr.so:urcu:gp_end
+ *		{ @ns = hist(arg0); }'
+ *
+ * Without CONFIG_RCU_SDT, the probes compile to nothing.
+ */
+
+#ifdef CONFIG_RCU_SDT
+
+#include <sys/sdt.h>
+
+#define urcu_tp(name)			STAP_PROBE(urcu, name)
+#define urcu_tp1(name, a)		STAP_PROBE1(urcu, name, a)
+#define urcu_tp2(name, a, b)		STAP_PROBE2(urcu, name, a, b)
+#define urcu_tp3(name, a, b, c)		STAP_PROBE3(urcu, name, a, b, c)
+#define urcu_tp4(name, a, b, c, d)	STAP_PROBE4(urcu, name, a, b, c, d)
+
+#else /* #ifdef CONFIG_RCU_SDT */
+
+#define urcu_tp(name)			do { } while (0)
+#define urcu_tp1(name, a)		do { } while (0)
+#define urcu_tp2(name, a, b)		do { } while (0)
+#define urcu_tp3(name, a, b, c)		do { } while (0)
+#define urcu_tp4(name, a, b, c, d)	do { } while (0)
+
+#endif /* #else #ifdef CONFIG_RCU_SDT */
+
+#endif /* _URCU_TP_H */
@@ -40,6 +40,16 @@
 		__min1 <= __min2 ? __min1: __min2;	\
 	})
 
+/*
+ * Library constructors, unless they run on first use of the library
+ * (--enable-lazy-init).
+ */
+#ifdef CONFIG_RCU_LAZY_INIT
+#define URCU_ATTR_CONSTRUCTOR
+#else
+#define URCU_ATTR_CONSTRUCTOR __attribute__((constructor))
+#endif
+
 /* There is no concept of symbol aliases on MacOS */
 #ifdef __APPLE__
 #define URCU_ATTR_ALIAS(x)
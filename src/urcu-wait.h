@@ -23,15 +23,18 @@
  * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
  */
 
+#include <limits.h>
 #include <urcu/uatomic.h>
 #include <urcu/wfstack.h>
 #include "urcu-die.h"
+#include "urcu-utils.h"
+#include "urcu-spin.h"
 
 /*
- * Number of busy-loop attempts before waiting on futex for grace period
- * batching.
+ * Busy-loop length of urcu_adaptative_busy_wait() for grace period
+ * batching, see urcu-spin.h.
  */
-#define URCU_WAIT_ATTEMPTS 1000
+static unsigned int urcu_wait_attempts = URCU_SPIN_ATTEMPTS;
 
 enum urcu_wait_state {
 	/* URCU_WAIT_WAITING is compared directly (futex compares it). */
@@ -42,9 +45,12 @@ enum urcu_wait_state {
 	URCU_WAIT_TEARDOWN =	(1 << 2),
 };
 
+struct urcu_wait_queue;
+
 struct urcu_wait_node {
 	struct cds_wfs_node node;
 	int32_t state;	/* enum urcu_wait_state */
+	struct urcu_wait_queue *queue;
 };
 
 #define URCU_WAIT_NODE_INIT(name, _state)		\
@@ -56,8 +62,16 @@ struct urcu_wait_node {
 #define DECLARE_URCU_WAIT_NODE(name)			\
 	struct urcu_wait_node name
 
+/*
+ * Waiters which stop busy-looping sleep on the wake_seq futex of their
+ * queue, shared by all of them: a waker sets the state of each waiter
+ * it pops, then increments wake_seq and wakes all sleepers with a
+ * single system call.
+ */
 struct urcu_wait_queue {
 	struct cds_wfs_stack stack;
+	int32_t wake_seq;
+	int32_t nr_sleepers;
 };
 
 #define URCU_WAIT_QUEUE_HEAD_INIT(name)				\
@@ -76,6 +90,7 @@ struct urcu_wait_queue {
 
 struct urcu_waiters {
 	struct cds_wfs_head *head;
+	struct urcu_wait_queue *queue;
 };
 
 /*
@@ -87,6 +102,7 @@ static inline
 bool urcu_wait_add(struct urcu_wait_queue *queue,
 		struct urcu_wait_node *node)
 {
+	node->queue = queue;
 	return cds_wfs_push(&queue->stack, &node->node);
 }
 
@@ -99,6 +115,7 @@ void urcu_move_waiters(struct urcu_waiters *waiters,
 		struct urcu_wait_queue *queue)
 {
 	waiters->head = __cds_wfs_pop_all(&queue->stack);
+	waiters->queue = queue;
 }
 
 static inline
@@ -117,24 +134,62 @@ void urcu_wait_node_init(struct urcu_wait_node *node,
 }
 
 /*
- * Note: urcu_adaptative_wake_up needs "value" to stay allocated
- * throughout its execution. In this scheme, the waiter owns the node
- * memory, and we only allow it to free this memory when it receives the
- * URCU_WAIT_TEARDOWN flag.
+ * Wake up all sleepers of the queue, after the state of the waiters
+ * they are waiting for was set.
  */
 static inline
-void urcu_adaptative_wake_up(struct urcu_wait_node *wait)
+void urcu_wait_queue_wake(struct urcu_wait_queue *queue)
 {
+	/* Order waiter states stores before wake_seq update. */
+	cmm_smp_mb();
+	uatomic_inc(&queue->wake_seq);
+	/* Order wake_seq update before nr_sleepers read. */
 	cmm_smp_mb();
-	assert(uatomic_read(&wait->state) == URCU_WAIT_WAITING);
-	uatomic_set(&wait->state, URCU_WAIT_WAKEUP);
-	if (!(uatomic_read(&wait->state) & URCU_WAIT_RUNNING)) {
-		if (futex_noasync(&wait->state, FUTEX_WAKE, 1,
-				NULL, NULL, 0) < 0)
-			urcu_die(errno);
+	if (!uatomic_read(&queue->nr_sleepers))
+		return;
+	if (futex_noasync(&queue->wake_seq, FUTEX_WAKE_PRIVATE, INT_MAX,
+			NULL, NULL, 0) < 0)
+		urcu_die(errno);
+}
+
+/*
+ * Sleep on the futex of the queue until the waker sets the state of
+ * "wait". Wake-ups of other waiters of the queue are retried.
+ */
+static inline
+void urcu_wait_queue_sleep(struct urcu_wait_node *wait)
+{
+	struct urcu_wait_queue *queue = wait->queue;
+	int32_t seq;
+
+	uatomic_inc(&queue->nr_sleepers);
+	for (;;) {
+		/*
+		 * Order nr_sleepers update before the wake_seq read, and
+		 * the wake_seq read before the state read: either the
+		 * waker sees the sleeper, or we see the state set, or the
+		 * wake_seq increment makes the futex wait fail.
+		 */
+		cmm_smp_mb();
+		seq = uatomic_read(&queue->wake_seq);
+		cmm_smp_mb();
+		if (uatomic_read(&wait->state) != URCU_WAIT_WAITING)
+			break;
+		if (futex_noasync(&queue->wake_seq, FUTEX_WAIT_PRIVATE,
+				seq, NULL, NULL, 0)) {
+			switch (errno) {
+			case EWOULDBLOCK:
+				/* wake_seq already changed. */
+			case EINTR:
+				/* Retry if interrupted by signal. */
+				break;	/* Get out of switch. */
+			default:
+				/* Unexpected error. */
+				urcu_die(errno);
+			}
+		}
 	}
-	/* Allow teardown of struct urcu_wait memory. */
-	uatomic_or(&wait->state, URCU_WAIT_TEARDOWN);
+	uatomic_dec(&queue->nr_sleepers);
 }
 
 /*
@@ -144,45 +199,28 @@ void urcu_adaptative_wake_up(struct urcu_wait_node *wait)
 static inline
 void urcu_adaptative_busy_wait(struct urcu_wait_node *wait)
 {
-	unsigned int i;
+	unsigned int i, attempts = CMM_LOAD_SHARED(urcu_wait_attempts);
+	unsigned int max_attempts = urcu_spin_max_attempts(attempts);
 
 	/* Load and test condition before read state */
 	cmm_smp_rmb();
-	for (i = 0; i < URCU_WAIT_ATTEMPTS; i++) {
-		if (uatomic_read(&wait->state) != URCU_WAIT_WAITING)
-			goto skip_futex_wait;
-		caa_cpu_relax();
-	}
-	while (futex_noasync(&wait->state, FUTEX_WAIT, URCU_WAIT_WAITING,
-			NULL, NULL, 0)) {
-		switch (errno) {
-		case EWOULDBLOCK:
-			/* Value already changed. */
+	for (i = 0; i < max_attempts; i++) {
+		if (uatomic_read(&wait->state) != URCU_WAIT_WAITING) {
+			CMM_STORE_SHARED(urcu_wait_attempts,
+				urcu_spin_update(attempts, i, true));
 			goto skip_futex_wait;
-		case EINTR:
-			/* Retry if interrupted by signal. */
-			break;	/* Get out of switch. */
-		default:
-			/* Unexpected error. */
-			urcu_die(errno);
 		}
+		caa_cpu_relax();
 	}
+	CMM_STORE_SHARED(urcu_wait_attempts,
+		urcu_spin_update(attempts, i, false));
+	urcu_wait_queue_sleep(wait);
 skip_futex_wait:
 
-	/* Tell waker thread than we are running. */
-	uatomic_or(&wait->state, URCU_WAIT_RUNNING);
-
 	/*
-	 * Wait until waker thread lets us know it's ok to tear down
-	 * memory allocated for struct urcu_wait.
+	 * The waker sets URCU_WAIT_TEARDOWN along with URCU_WAIT_WAKEUP,
+	 * and does not access struct urcu_wait afterwards.
 	 */
-	for (i = 0; i < URCU_WAIT_ATTEMPTS; i++) {
-		if (uatomic_read(&wait->state) & URCU_WAIT_TEARDOWN)
-			break;
-		caa_cpu_relax();
-	}
-	while (!(uatomic_read(&wait->state) & URCU_WAIT_TEARDOWN))
-		poll(NULL, 0, 10);
 	assert(uatomic_read(&wait->state) & URCU_WAIT_TEARDOWN);
 }
 
@@ -191,16 +229,24 @@ void urcu_wake_all_waiters(struct urcu_waiters *waiters)
 {
 	struct cds_wfs_node *iter, *iter_n;
 
-	/* Wake all waiters in our stack head */
-	cds_wfs_for_each_blocking_safe(waiters->head, iter, iter_n) {
+	/*
+	 * Set the state of all waiters in our stack head, then wake the
+	 * sleeping ones at once: the state store is the last access to
+	 * each node, which its waiter may free as soon as it sees it.
+	 */
+	cmm_smp_mb();
+	cds_wfs_for_each_blocking_prefetch_safe(waiters->head, iter, iter_n) {
 		struct urcu_wait_node *wait_node =
 			caa_container_of(iter, struct urcu_wait_node, node);
 
 		/* Don't wake already running threads */
 		if (wait_node->state & URCU_WAIT_RUNNING)
 			continue;
-		urcu_adaptative_wake_up(wait_node);
+		assert(uatomic_read(&wait_node->state) == URCU_WAIT_WAITING);
+		uatomic_set(&wait_node->state,
+			URCU_WAIT_WAKEUP | URCU_WAIT_TEARDOWN);
 	}
+	urcu_wait_queue_wake(waiters->queue);
 }
 
 #endif /* _URCU_WAIT_H */
@@ -36,7 +36,10 @@
 #include <string.h>
 #include <errno.h>
 #include <stdbool.h>
+#include <limits.h>
 #include <poll.h>
+#include <sched.h>
+#include <unistd.h>
 
 #include <urcu/arch.h>
 #include <urcu/wfcqueue.h>
@@ -44,10 +47,18 @@
 #include <urcu/static/urcu.h>
 #include <urcu/pointer.h>
 #include <urcu/tls-compat.h>
+#include <urcu/cache-line.h>
 
 #include "urcu-die.h"
 #include "urcu-wait.h"
+#include "urcu-gp-seq.h"
+#include "urcu-registry.h"
 #include "urcu-utils.h"
+#include "urcu-stats.h"
+#include "urcu-mutex.h"
+#include "urcu-stall.h"
+#include "urcu-gp-thread.h"
+#include "urcu-gp-coalesce.h"
 
 #define URCU_API_MAP
 /* Do not #define _LGPL_SOURCE to ensure we can emit the wrapper symbols */
@@ -55,6 +66,14 @@
 #include <urcu/urcu.h>
 #define _LGPL_SOURCE
 
+/*
+ * The signal flavor keeps its reader state in thread-local storage, where
+ * its signal handler updates it.
+ */
+#if defined(CONFIG_RCU_READER_ARRAY) && !defined(RCU_SIGNAL)
+#define RCU_READER_ARRAY
+#endif
+
 /*
  * If a reader is really non-cooperative and refuses to commit its
  * rcu_active_readers count to memory (there is no barrier in the reader
@@ -81,10 +100,18 @@ enum membarrier_cmd {
 	/* reserved for MEMBARRIER_CMD_PRIVATE (1 << 2) */
 	MEMBARRIER_CMD_PRIVATE_EXPEDITED		= (1 << 3),
 	MEMBARRIER_CMD_REGISTER_PRIVATE_EXPEDITED	= (1 << 4),
+	/* reserved for MEMBARRIER_CMD_PRIVATE_EXPEDITED_SYNC_CORE (1 << 5) */
+	/* reserved for MEMBARRIER_CMD_REGISTER_PRIVATE_EXPEDITED_SYNC_CORE (1 << 6) */
+	MEMBARRIER_CMD_PRIVATE_EXPEDITED_RSEQ		= (1 << 7),
+	MEMBARRIER_CMD_REGISTER_PRIVATE_EXPEDITED_RSEQ	= (1 << 8),
+};
+
+enum membarrier_cmd_flag {
+	MEMBARRIER_CMD_FLAG_CPU				= (1 << 0),
 };
 
 #ifdef RCU_MEMBARRIER
-static int init_done;
+static pthread_once_t init_once = PTHREAD_ONCE_INIT;
 static int urcu_memb_has_sys_membarrier_private_expedited;
 
 #ifndef CONFIG_RCU_FORCE_SYS_MEMBARRIER
@@ -97,7 +124,7 @@ URCU_ATTR_ALIAS("urcu_memb_has_sys_membarrier")
 extern int rcu_has_sys_membarrier_memb;
 #endif
 
-void __attribute__((constructor)) rcu_init(void);
+void URCU_ATTR_CONSTRUCTOR rcu_init(void);
 #endif
 
 #ifdef RCU_MB
@@ -109,9 +136,14 @@ void alias_rcu_init(void);
 #endif
 
 #ifdef RCU_SIGNAL
-static int init_done;
+static pthread_once_t init_once = PTHREAD_ONCE_INIT;
+/*
+ * Set at initialization when grace periods issue barriers on the readers
+ * with membarrier private expedited, instead of sending them SIGRCU.
+ */
+static int urcu_signal_has_sys_membarrier;
 
-void __attribute__((constructor)) rcu_init(void);
+void URCU_ATTR_CONSTRUCTOR rcu_init(void);
 void __attribute__((destructor)) rcu_exit(void);
 #endif
 
@@ -138,10 +170,10 @@ extern struct urcu_gp alias_rcu_gp;
  * Written to only by each individual reader. Read by both the reader and the
  * writers.
  */
-DEFINE_URCU_TLS(struct urcu_reader, rcu_reader);
+DEFINE_URCU_TLS_IE(struct urcu_reader, rcu_reader);
 DEFINE_URCU_TLS_ALIAS(struct urcu_reader, rcu_reader, alias_rcu_reader);
 
-static CDS_LIST_HEAD(registry);
+static DEFINE_URCU_REGISTRY(registry);
 
 /*
  * Queue keeping threads awaiting to wait for a grace period. Contains
@@ -149,25 +181,81 @@ static CDS_LIST_HEAD(registry);
  */
 static DEFINE_URCU_WAIT_QUEUE(gp_waiters);
 
-static void mutex_lock(pthread_mutex_t *mutex)
+/* Window for more callers to join gp_waiters before a grace period. */
+static struct urcu_gp_coalesce gp_coalesce;
+
+/*
+ * Grace-period statistics. Written with rcu_gp_lock held.
+ */
+static struct urcu_gp_stats gp_stats;
+
+#if defined(HAVE_SCHED_SETAFFINITY) && SCHED_SETAFFINITY_ARGS == 3
+#define RCU_ISOLATED_READERS
+#endif
+
+#ifdef RCU_ISOLATED_READERS
+/*
+ * Readers registered with rcu_register_thread_isolated() on each CPU,
+ * which membarrier skips when it can target CPUs one by one. Accessed
+ * with rcu_registry_lock held.
+ */
+static unsigned int isolated_cpu_readers[CPU_SETSIZE];
+static unsigned int nr_isolated_readers;
+/*
+ * Registered threads not isolated, linked by shared_cpu_node. Kept apart
+ * from the registry groups, whose readers grace periods move to private
+ * lists while waiting. Accessed with rcu_registry_lock held.
+ */
+static CDS_LIST_HEAD(shared_cpu_readers);
+/*
+ * Reader contexts and SRCU domains. Their readers need not be registered
+ * threads, so they may run on the CPU of an isolated reader: membarrier
+ * skips no CPU while any exists. Accessed with rcu_registry_lock held.
+ */
+static unsigned int nr_unbound_readers;
+#if defined(RCU_MEMBARRIER) || defined(RCU_SIGNAL)
+static int membarrier_cpu_checked, has_sys_membarrier_cpu;
+static int nr_cpus_conf;
+#endif
+#endif
+
+/*
+ * Contention on the internal mutexes, see rcu_get_stats().
+ */
+static struct urcu_flavor_lock_stats lock_stats;
+
+/*
+ * Reader stall watchdog. Accessed with rcu_gp_lock held.
+ */
+static struct urcu_stall_watchdog stall_watchdog;
+
+static struct urcu_lock_stats *mutex_lock_stats(pthread_mutex_t *mutex)
 {
-	int ret;
+	if (mutex == &rcu_gp_lock)
+		return &lock_stats.gp;
+	if (mutex == &rcu_registry_lock)
+		return &lock_stats.registry;
+	return NULL;
+}
+
+#ifdef DISTRUST_SIGNALS_EXTREME
+/* Answer the grace period the owner of the mutex may wait for. */
+static void mutex_lock_poll(void)
+{
+	if (CMM_LOAD_SHARED(URCU_TLS(rcu_reader).need_mb)) {
+		cmm_smp_mb();
+		_CMM_STORE_SHARED(URCU_TLS(rcu_reader).need_mb, 0);
+		cmm_smp_mb();
+	}
+}
+#endif
 
+static void mutex_lock(pthread_mutex_t *mutex)
+{
 #ifndef DISTRUST_SIGNALS_EXTREME
-	ret = pthread_mutex_lock(mutex);
-	if (ret)
-		urcu_die(ret);
+	urcu_mutex_lock(mutex, mutex_lock_stats(mutex));
 #else /* #ifndef DISTRUST_SIGNALS_EXTREME */
-	while ((ret = pthread_mutex_trylock(mutex)) != 0) {
-		if (ret != EBUSY && ret != EINTR)
-			urcu_die(ret);
-		if (CMM_LOAD_SHARED(URCU_TLS(rcu_reader).need_mb)) {
-			cmm_smp_mb();
-			_CMM_STORE_SHARED(URCU_TLS(rcu_reader).need_mb, 0);
-			cmm_smp_mb();
-		}
-		(void) poll(NULL, 0, 10);
-	}
+	urcu_mutex_lock_poll(mutex, mutex_lock_stats(mutex), mutex_lock_poll);
 #endif /* #else #ifndef DISTRUST_SIGNALS_EXTREME */
 }
 
@@ -180,10 +268,76 @@ static void mutex_unlock(pthread_mutex_t *mutex)
 		urcu_die(ret);
 }
 
+#if defined(RCU_MEMBARRIER) || defined(RCU_SIGNAL)
+#ifdef RCU_ISOLATED_READERS
+/*
+ * Fill skip with the CPUs of isolated readers on which no other
+ * registered reader may run: the read side of those other readers only
+ * has compiler barriers, and relies on membarrier. Return false if no
+ * CPU can be skipped. Called with rcu_registry_lock held.
+ */
+static bool isolated_cpus_to_skip(cpu_set_t *skip)
+{
+	struct urcu_reader *index;
+	cpu_set_t mask;
+	int cpu;
+
+	CPU_ZERO(skip);
+	for (cpu = 0; cpu < nr_cpus_conf; cpu++) {
+		if (isolated_cpu_readers[cpu])
+			CPU_SET(cpu, skip);
+	}
+	cds_list_for_each_entry(index, &shared_cpu_readers, shared_cpu_node) {
+		if (pthread_getaffinity_np(index->tid, sizeof(mask), &mask))
+			return false;
+		/* Remove the CPUs the reader may run on. */
+		CPU_AND(&mask, &mask, skip);
+		CPU_XOR(skip, skip, &mask);
+		if (!CPU_COUNT(skip))
+			return false;
+	}
+	return true;
+}
+
+/*
+ * Issue a memory barrier on the CPUs running threads of the process,
+ * one CPU at a time to skip those of isolated readers, if any. Return
+ * false if membarrier cannot target CPUs, or no CPU can be skipped.
+ * Called with rcu_registry_lock held.
+ */
+static bool membarrier_skip_isolated(void)
+{
+	cpu_set_t skip;
+	int cpu;
+
+	if (caa_likely(!nr_isolated_readers) || nr_unbound_readers
+			|| !has_sys_membarrier_cpu)
+		return false;
+	if (!isolated_cpus_to_skip(&skip))
+		return false;
+	for (cpu = 0; cpu < nr_cpus_conf; cpu++) {
+		if (CPU_ISSET(cpu, &skip))
+			continue;
+		if (membarrier(MEMBARRIER_CMD_PRIVATE_EXPEDITED_RSEQ,
+				MEMBARRIER_CMD_FLAG_CPU, cpu))
+			urcu_die(errno);
+	}
+	return true;
+}
+#else
+static bool membarrier_skip_isolated(void)
+{
+	return false;
+}
+#endif
+#endif /* #if defined(RCU_MEMBARRIER) || defined(RCU_SIGNAL) */
+
 #ifdef RCU_MEMBARRIER
 static void smp_mb_master(void)
 {
 	if (caa_likely(urcu_memb_has_sys_membarrier)) {
+		if (membarrier_skip_isolated())
+			return;
 		if (membarrier(urcu_memb_has_sys_membarrier_private_expedited ?
 				MEMBARRIER_CMD_PRIVATE_EXPEDITED :
 				MEMBARRIER_CMD_SHARED, 0))
@@ -202,15 +356,38 @@ static void smp_mb_master(void)
 #endif
 
 #ifdef RCU_SIGNAL
+/*
+ * Return whether some readers have not yet executed the barrier requested
+ * with need_mb. Send SIGRCU again to those readers if kick is true.
+ */
+static bool readers_need_mb(bool kick)
+{
+	struct urcu_reader *index;
+	bool pending = false;
+	unsigned int i;
+
+	urcu_registry_for_each_group(&registry, i) {
+		cds_list_for_each_entry(index, &registry.group[i], node) {
+			if (!CMM_LOAD_SHARED(index->need_mb))
+				continue;
+			pending = true;
+			if (kick)
+				pthread_kill(index->tid, SIGRCU);
+		}
+	}
+	return pending;
+}
+
 static void force_mb_all_readers(void)
 {
 	struct urcu_reader *index;
+	unsigned int i;
 
 	/*
 	 * Ask for each threads to execute a cmm_smp_mb() so we can consider the
 	 * compiler barriers around rcu read lock as real memory barriers.
 	 */
-	if (cds_list_empty(&registry))
+	if (urcu_registry_empty(&registry))
 		return;
 	/*
 	 * pthread_kill has a cmm_smp_mb(). But beware, we assume it performs
@@ -218,12 +395,19 @@ static void force_mb_all_readers(void)
 	 * safe and don't assume anything : we use cmm_smp_mc() to make sure the
 	 * cache flush is enforced.
 	 */
-	cds_list_for_each_entry(index, &registry, node) {
-		CMM_STORE_SHARED(index->need_mb, 1);
-		pthread_kill(index->tid, SIGRCU);
+	urcu_registry_for_each_group(&registry, i) {
+		cds_list_for_each_entry(index, &registry.group[i], node) {
+			/* Reader contexts issue full barriers instead. */
+			if (index->detached || index->isolated)
+				continue;
+			CMM_STORE_SHARED(index->need_mb, 1);
+			pthread_kill(index->tid, SIGRCU);
+		}
 	}
 	/*
 	 * Wait for sighandler (and thus mb()) to execute on every thread.
+	 * Readers still pending after a sleep get the signal again, all in
+	 * one pass, so a batch of slow readers costs a single sleep.
 	 *
 	 * Note that the pthread_kill() will never be executed on systems
 	 * that correctly deliver signals in a timely manner.  However, it
@@ -235,18 +419,24 @@ static void force_mb_all_readers(void)
 	 * relevant bug report.  For Linux kernels, we recommend getting
 	 * the Linux Test Project (LTP).
 	 */
-	cds_list_for_each_entry(index, &registry, node) {
-		while (CMM_LOAD_SHARED(index->need_mb)) {
-			pthread_kill(index->tid, SIGRCU);
+	if (readers_need_mb(false)) {
+		do {
 			(void) poll(NULL, 0, 1);
-		}
+		} while (readers_need_mb(true));
 	}
 	cmm_smp_mb();	/* read ->need_mb before ending the barrier */
 }
 
 static void smp_mb_master(void)
 {
-	force_mb_all_readers();
+	if (caa_likely(urcu_signal_has_sys_membarrier)) {
+		if (membarrier_skip_isolated())
+			return;
+		if (membarrier(MEMBARRIER_CMD_PRIVATE_EXPEDITED, 0))
+			urcu_die(errno);
+	} else {
+		force_mb_all_readers();
+	}
 }
 #endif /* #ifdef RCU_SIGNAL */
 
@@ -257,6 +447,8 @@ static void smp_mb_master(void)
  */
 static void wait_gp(void)
 {
+	struct timespec timeout;
+
 	/*
 	 * Read reader_gp before read futex. smp_mb_master() needs to
 	 * be called with the rcu registry lock held in RCU_SIGNAL
@@ -267,12 +459,21 @@ static void wait_gp(void)
 	mutex_unlock(&rcu_registry_lock);
 	if (uatomic_read(&rcu_gp.futex) != -1)
 		goto end;
+	urcu_stats_futex_wait(&gp_stats);
 	while (futex_async(&rcu_gp.futex, FUTEX_WAIT, -1,
-			NULL, NULL, 0)) {
+			urcu_stall_timeout(&stall_watchdog, &timeout),
+			NULL, 0)) {
 		switch (errno) {
 		case EWOULDBLOCK:
 			/* Value already changed. */
 			goto end;
+		case ETIMEDOUT:
+			/*
+			 * Stall report due. Reset the futex as a wake-up
+			 * would, wait_for_readers() decrements it again.
+			 */
+			uatomic_set(&rcu_gp.futex, 0);
+			goto end;
 		case EINTR:
 			/* Retry if interrupted by signal. */
 			break;	/* Get out of switch. */
@@ -288,27 +489,110 @@ end:
 	mutex_lock(&rcu_registry_lock);
 }
 
+#ifdef RCU_READER_ARRAY
+static enum urcu_state reader_state(unsigned long *ctr)
+{
+	return urcu_common_reader_state(&rcu_gp, ctr);
+}
+
+/*
+ * Check the readers of a registry group array once. In the first phase,
+ * urcu_reader_array_prepare() marks all of them pending, and the second
+ * phase waits for those seen with the current snapshot in the first one.
+ * Returns whether some readers are still active with an old snapshot.
+ */
+static bool check_readers(struct urcu_reader_array *array, bool first_phase)
+{
+	return urcu_reader_array_check(array, first_phase, reader_state,
+			&stall_watchdog, urcu_stall_report_due(&stall_watchdog));
+}
+#else
+/*
+ * Check the readers of input_readers once, moving them to qsreaders when
+ * quiescent, and to cur_snap_readers when active with the current
+ * snapshot if non-NULL. Returns whether some readers are still active
+ * with an old snapshot.
+ */
+static bool check_readers(struct cds_list_head *input_readers,
+			struct cds_list_head *cur_snap_readers,
+			struct cds_list_head *qsreaders)
+{
+	struct urcu_reader *index, *tmp;
+
+	cds_list_for_each_entry_safe(index, tmp, input_readers, node) {
+		switch (urcu_common_reader_state(&rcu_gp, &index->ctr)) {
+		case URCU_READER_ACTIVE_CURRENT:
+			if (cur_snap_readers) {
+				cds_list_move(&index->node,
+					cur_snap_readers);
+				break;
+			}
+			/* Fall-through */
+		case URCU_READER_INACTIVE:
+			cds_list_move(&index->node, qsreaders);
+			break;
+		case URCU_READER_ACTIVE_OLD:
+			/*
+			 * Old snapshot. Leaving node in
+			 * input_readers will make us busy-loop
+			 * until the snapshot becomes current or
+			 * the reader becomes inactive.
+			 */
+			break;
+		}
+	}
+
+	if (!cds_list_empty(input_readers)) {
+		uint64_t active_ns;
+
+		active_ns = urcu_stall_report_due(&stall_watchdog);
+		if (caa_unlikely(active_ns)) {
+			cds_list_for_each_entry(index, input_readers, node) {
+				urcu_stall_report(&stall_watchdog,
+					index->tid, active_ns);
+				if (!index->detached)
+					urcu_stall_boost(&stall_watchdog,
+						index->tid);
+			}
+		}
+		return true;
+	}
+	return false;
+}
+#endif
+
 /*
  * Always called with rcu_registry lock held. Releases this lock between
  * iterations and grabs it again. Holds the lock when it returns.
  */
+#ifdef RCU_READER_ARRAY
+static void wait_for_readers(struct urcu_reader_array *array,
+			bool first_phase,
+			bool expedited)
+#else
 static void wait_for_readers(struct cds_list_head *input_readers,
 			struct cds_list_head *cur_snap_readers,
-			struct cds_list_head *qsreaders)
+			struct cds_list_head *qsreaders,
+			bool expedited)
+#endif
 {
 	unsigned int wait_loops = 0;
-	struct urcu_reader *index, *tmp;
+	bool pending;
 #ifdef HAS_INCOHERENT_CACHES
 	unsigned int wait_gp_loops = 0;
 #endif /* HAS_INCOHERENT_CACHES */
 
+#ifdef RCU_READER_ARRAY
+	urcu_reader_array_prepare(array, first_phase);
+#endif
 	/*
 	 * Wait for each thread URCU_TLS(rcu_reader).ctr to either
 	 * indicate quiescence (not nested), or observe the current
 	 * rcu_gp.ctr value.
 	 */
 	for (;;) {
-		if (wait_loops < RCU_QS_ACTIVE_ATTEMPTS)
+		/* Expedited grace periods never wait on the futex. */
+		if (!expedited && wait_loops < RCU_QS_ACTIVE_ATTEMPTS)
 			wait_loops++;
 		if (wait_loops >= RCU_QS_ACTIVE_ATTEMPTS) {
 			uatomic_dec(&rcu_gp.futex);
@@ -316,31 +600,15 @@ static void wait_for_readers(struct cds_list_head *input_readers,
 			smp_mb_master();
 		}
 
-		cds_list_for_each_entry_safe(index, tmp, input_readers, node) {
-			switch (urcu_common_reader_state(&rcu_gp, &index->ctr)) {
-			case URCU_READER_ACTIVE_CURRENT:
-				if (cur_snap_readers) {
-					cds_list_move(&index->node,
-						cur_snap_readers);
-					break;
-				}
-				/* Fall-through */
-			case URCU_READER_INACTIVE:
-				cds_list_move(&index->node, qsreaders);
-				break;
-			case URCU_READER_ACTIVE_OLD:
-				/*
-				 * Old snapshot. Leaving node in
-				 * input_readers will make us busy-loop
-				 * until the snapshot becomes current or
-				 * the reader becomes inactive.
-				 */
-				break;
-			}
-		}
+#ifdef RCU_READER_ARRAY
+		pending = check_readers(array, first_phase);
+#else
+		pending = check_readers(input_readers, cur_snap_readers,
+				qsreaders);
+#endif
 
 #ifndef HAS_INCOHERENT_CACHES
-		if (cds_list_empty(input_readers)) {
+		if (!pending) {
 			if (wait_loops >= RCU_QS_ACTIVE_ATTEMPTS) {
 				/* Read reader_gp before write futex */
 				smp_mb_master();
@@ -368,7 +636,7 @@ static void wait_for_readers(struct cds_list_head *input_readers,
 		 * URCU_TLS(rcu_reader).ctr update to memory if we wait
 		 * for too long.
 		 */
-		if (cds_list_empty(input_readers)) {
+		if (!pending) {
 			if (wait_loops >= RCU_QS_ACTIVE_ATTEMPTS) {
 				/* Read reader_gp before write futex */
 				smp_mb_master();
@@ -385,6 +653,8 @@ static void wait_for_readers(struct cds_list_head *input_readers,
 				wait_gp();
 				wait_gp_loops++;
 			} else {
+				if (expedited)
+					wait_gp_loops++;
 				/* Temporarily unlock the registry lock. */
 				mutex_unlock(&rcu_registry_lock);
 				caa_cpu_relax();
@@ -399,41 +669,31 @@ static void wait_for_readers(struct cds_list_head *input_readers,
 	}
 }
 
-void synchronize_rcu(void)
+/*
+ * Perform a grace period. Called with rcu_gp_lock held.
+ */
+static void do_synchronize_rcu(bool expedited)
 {
-	CDS_LIST_HEAD(cur_snap_readers);
-	CDS_LIST_HEAD(qsreaders);
-	DEFINE_URCU_WAIT_NODE(wait, URCU_WAIT_WAITING);
-	struct urcu_waiters waiters;
+#ifndef RCU_READER_ARRAY
+	struct cds_list_head cur_snap_readers[URCU_REGISTRY_GROUPS];
+	struct cds_list_head qsreaders[URCU_REGISTRY_GROUPS];
+#endif
+	unsigned int i;
+	uint64_t gp_start;
 
-	/*
-	 * Add ourself to gp_waiters queue of threads awaiting to wait
-	 * for a grace period. Proceed to perform the grace period only
-	 * if we are the first thread added into the queue.
-	 * The implicit memory barrier before urcu_wait_add()
-	 * orders prior memory accesses of threads put into the wait
-	 * queue before their insertion into the wait queue.
-	 */
-	if (urcu_wait_add(&gp_waiters, &wait) != 0) {
-		/* Not first in queue: will be awakened by another thread. */
-		urcu_adaptative_busy_wait(&wait);
-		/* Order following memory accesses after grace period. */
-		cmm_smp_mb();
-		return;
+#ifndef RCU_READER_ARRAY
+	urcu_registry_for_each_group(&registry, i) {
+		CDS_INIT_LIST_HEAD(&cur_snap_readers[i]);
+		CDS_INIT_LIST_HEAD(&qsreaders[i]);
 	}
-	/* We won't need to wake ourself up */
-	urcu_wait_set_state(&wait, URCU_WAIT_RUNNING);
-
-	mutex_lock(&rcu_gp_lock);
+#endif
 
-	/*
-	 * Move all waiters into our local queue.
-	 */
-	urcu_move_waiters(&waiters, &gp_waiters);
+	gp_start = urcu_stats_gp_start();
+	urcu_gp_seq_start(&rcu_gp.seq);
 
 	mutex_lock(&rcu_registry_lock);
 
-	if (cds_list_empty(&registry))
+	if (urcu_registry_empty(&registry))
 		goto out;
 
 	/*
@@ -445,11 +705,20 @@ void synchronize_rcu(void)
 	smp_mb_master();
 
 	/*
-	 * Wait for readers to observe original parity or be quiescent.
+	 * Wait for readers to observe original parity or be quiescent,
+	 * one registry group at a time.
 	 * wait_for_readers() can release and grab again rcu_registry_lock
 	 * interally.
 	 */
-	wait_for_readers(&registry, &cur_snap_readers, &qsreaders);
+	urcu_stall_wait_start(&stall_watchdog);
+	urcu_registry_for_each_group(&registry, i) {
+#ifdef RCU_READER_ARRAY
+		wait_for_readers(&registry.array[i], true, expedited);
+#else
+		wait_for_readers(&registry.group[i], &cur_snap_readers[i],
+				&qsreaders[i], expedited);
+#endif
+	}
 
 	/*
 	 * Must finish waiting for quiescent state for original parity before
@@ -491,12 +760,23 @@ void synchronize_rcu(void)
 	 * wait_for_readers() can release and grab again rcu_registry_lock
 	 * interally.
 	 */
-	wait_for_readers(&cur_snap_readers, NULL, &qsreaders);
+	urcu_stall_wait_start(&stall_watchdog);
+	urcu_registry_for_each_group(&registry, i) {
+#ifdef RCU_READER_ARRAY
+		wait_for_readers(&registry.array[i], false, expedited);
+#else
+		wait_for_readers(&cur_snap_readers[i], NULL, &qsreaders[i],
+				expedited);
+#endif
+	}
 
+#ifndef RCU_READER_ARRAY
 	/*
-	 * Put quiescent reader list back into registry.
+	 * Put quiescent reader lists back into their registry group.
 	 */
-	cds_list_splice(&qsreaders, &registry);
+	urcu_registry_for_each_group(&registry, i)
+		cds_list_splice(&qsreaders[i], &registry.group[i]);
+#endif
 
 	/*
 	 * Finish waiting for reader threads before letting the old ptr
@@ -504,8 +784,31 @@ void synchronize_rcu(void)
 	 * iterates on reader threads.
 	 */
 	smp_mb_master();
+	urcu_stall_wait_end(&stall_watchdog);
 out:
+	urcu_gp_seq_end(&rcu_gp.seq);
+	urcu_stats_gp_end(&gp_stats, gp_start);
 	mutex_unlock(&rcu_registry_lock);
+}
+
+/*
+ * Perform a grace period for all threads queued in gp_waiters, and wake
+ * them once it has completed.
+ */
+static void synchronize_waiters(void)
+{
+	struct urcu_waiters waiters;
+
+	urcu_gp_coalesce_wait(&gp_coalesce);
+	mutex_lock(&rcu_gp_lock);
+
+	/*
+	 * Move all waiters into our local queue.
+	 */
+	urcu_move_waiters(&waiters, &gp_waiters);
+
+	do_synchronize_rcu(false);
+
 	mutex_unlock(&rcu_gp_lock);
 
 	/*
@@ -515,9 +818,393 @@ out:
 	 */
 	urcu_wake_all_waiters(&waiters);
 }
+
+static struct urcu_gp_thread gp_thread =
+	URCU_GP_THREAD_INIT(&gp_waiters, synchronize_waiters);
+
+void synchronize_rcu(void)
+{
+	DEFINE_URCU_WAIT_NODE(wait, URCU_WAIT_WAITING);
+	bool leader;
+
+	/*
+	 * Add ourself to gp_waiters queue of threads awaiting to wait
+	 * for a grace period. Proceed to perform the grace period only
+	 * if we are the first thread added into the queue, and there is
+	 * no grace-period thread to do it.
+	 * The implicit memory barrier before urcu_wait_add()
+	 * orders prior memory accesses of threads put into the wait
+	 * queue before their insertion into the wait queue.
+	 */
+	leader = urcu_wait_add(&gp_waiters, &wait) == 0;
+	urcu_gp_coalesce_arrive(&gp_coalesce);
+	if (leader && !urcu_gp_thread_kick(&gp_thread))
+		synchronize_waiters();
+	/*
+	 * Wait for the thread which moved us out of gp_waiters, us
+	 * included, to wake us. A grace-period thread being stopped
+	 * may have moved us before we performed the grace period.
+	 */
+	if (uatomic_read(&wait.state) == URCU_WAIT_WAITING)
+		urcu_adaptative_busy_wait(&wait);
+	/* Order following memory accesses after grace period. */
+	cmm_smp_mb();
+}
 URCU_ATTR_ALIAS(urcu_stringify(synchronize_rcu))
 void alias_synchronize_rcu();
 
+int rcu_gp_thread_start(int cpu_affinity)
+{
+	return urcu_gp_thread_start(&gp_thread, cpu_affinity);
+}
+
+int rcu_gp_thread_stop(void)
+{
+	return urcu_gp_thread_stop(&gp_thread);
+}
+
+int rcu_set_gp_coalesce(unsigned long delay_us, unsigned long nr_waiters)
+{
+	return urcu_gp_coalesce_set(&gp_coalesce, delay_us, nr_waiters);
+}
+
+/*
+ * Expedited grace period: busy-wait on reader state without ever
+ * sleeping on the futex. It does not join the gp_waiters batching, and
+ * is meant for rare latency-sensitive updates.
+ */
+void synchronize_rcu_expedited(void)
+{
+	/* Order prior memory accesses before the grace period. */
+	cmm_smp_mb();
+	mutex_lock(&rcu_gp_lock);
+	urcu_stats_expedited(&gp_stats);
+	do_synchronize_rcu(true);
+	mutex_unlock(&rcu_gp_lock);
+	/* Order following memory accesses after grace period. */
+	cmm_smp_mb();
+}
+
+/*
+ * Grace period driven in steps by the application, performing the
+ * sequence of do_synchronize_rcu() a bit at a time: the thread which
+ * started it holds rcu_gp_lock until the step completing it, and the
+ * registry lock during each step only.
+ */
+enum gp_step_phase {
+	GP_STEP_IDLE = 0,
+	GP_STEP_FIRST_PHASE,
+	GP_STEP_SECOND_PHASE,
+};
+
+static struct {
+	enum gp_step_phase phase;
+	pthread_t owner;
+	/* Registry group being waited for. */
+	unsigned int group;
+	uint64_t gp_start;
+#ifdef RCU_READER_ARRAY
+	bool prepared;
+#else
+	struct cds_list_head cur_snap_readers[URCU_REGISTRY_GROUPS];
+	struct cds_list_head qsreaders[URCU_REGISTRY_GROUPS];
+#endif
+} gp_step;
+
+#ifndef RCU_READER_ARRAY
+/*
+ * check_readers() checking at most *budget readers. When the budget is
+ * exhausted, input_readers is rotated for the next step to resume from
+ * the first reader left unchecked.
+ */
+static bool step_check_readers(struct cds_list_head *input_readers,
+			struct cds_list_head *cur_snap_readers,
+			struct cds_list_head *qsreaders,
+			unsigned int *budget)
+{
+	struct urcu_reader *index, *tmp;
+	uint64_t active_ns;
+
+	active_ns = urcu_stall_report_due(&stall_watchdog);
+	cds_list_for_each_entry_safe(index, tmp, input_readers, node) {
+		if (!*budget) {
+			cds_list_del(input_readers);
+			cds_list_add_tail(input_readers, &index->node);
+			return true;
+		}
+		(*budget)--;
+		switch (urcu_common_reader_state(&rcu_gp, &index->ctr)) {
+		case URCU_READER_ACTIVE_CURRENT:
+			if (cur_snap_readers) {
+				cds_list_move(&index->node,
+					cur_snap_readers);
+				break;
+			}
+			/* Fall-through */
+		case URCU_READER_INACTIVE:
+			cds_list_move(&index->node, qsreaders);
+			break;
+		case URCU_READER_ACTIVE_OLD:
+			if (caa_unlikely(active_ns)) {
+				urcu_stall_report(&stall_watchdog,
+					index->tid, active_ns);
+				if (!index->detached)
+					urcu_stall_boost(&stall_watchdog,
+						index->tid);
+			}
+			break;
+		}
+	}
+	return !cds_list_empty(input_readers);
+}
+#endif
+
+/* Called with both locks held, releases them. */
+static void gp_step_end(void)
+{
+	CMM_STORE_SHARED(gp_step.phase, GP_STEP_IDLE);
+	urcu_gp_seq_end(&rcu_gp.seq);
+	urcu_stats_gp_end(&gp_stats, gp_step.gp_start);
+	mutex_unlock(&rcu_registry_lock);
+	mutex_unlock(&rcu_gp_lock);
+	/* Order following memory accesses after grace period. */
+	cmm_smp_mb();
+}
+
+int rcu_gp_step_start(void)
+{
+#ifndef RCU_READER_ARRAY
+	unsigned int i;
+#endif
+
+	/* Order prior memory accesses before the grace period. */
+	cmm_smp_mb();
+	if (urcu_mutex_trylock(&rcu_gp_lock))
+		return -EBUSY;
+	urcu_mutex_acquired(&lock_stats.gp, 0, 0);
+	gp_step.owner = pthread_self();
+	gp_step.gp_start = urcu_stats_gp_start();
+	urcu_gp_seq_start(&rcu_gp.seq);
+
+	mutex_lock(&rcu_registry_lock);
+	if (urcu_registry_empty(&registry)) {
+		gp_step_end();
+		return 1;
+	}
+	/* Write new ptr before changing the qparity */
+	smp_mb_master();
+	urcu_stall_wait_start(&stall_watchdog);
+	gp_step.group = 0;
+#ifdef RCU_READER_ARRAY
+	gp_step.prepared = false;
+#else
+	urcu_registry_for_each_group(&registry, i) {
+		CDS_INIT_LIST_HEAD(&gp_step.cur_snap_readers[i]);
+		CDS_INIT_LIST_HEAD(&gp_step.qsreaders[i]);
+	}
+#endif
+	CMM_STORE_SHARED(gp_step.phase, GP_STEP_FIRST_PHASE);
+	mutex_unlock(&rcu_registry_lock);
+	return 0;
+}
+
+int rcu_gp_step(unsigned int max_readers)
+{
+	unsigned int budget = max_readers ? max_readers : UINT_MAX;
+	unsigned int i;
+	bool pending;
+
+	if (CMM_LOAD_SHARED(gp_step.phase) == GP_STEP_IDLE
+			|| !pthread_equal(gp_step.owner, pthread_self()))
+		return -EPERM;
+
+	mutex_lock(&rcu_registry_lock);
+	for (; gp_step.group < URCU_REGISTRY_GROUPS; gp_step.group++) {
+		i = gp_step.group;
+#ifdef RCU_READER_ARRAY
+		(void) budget;
+		if (!gp_step.prepared) {
+			urcu_reader_array_prepare(&registry.array[i],
+				gp_step.phase == GP_STEP_FIRST_PHASE);
+			gp_step.prepared = true;
+		}
+		pending = check_readers(&registry.array[i],
+				gp_step.phase == GP_STEP_FIRST_PHASE);
+		if (!pending)
+			gp_step.prepared = false;
+#else
+		if (gp_step.phase == GP_STEP_FIRST_PHASE)
+			pending = step_check_readers(&registry.group[i],
+					&gp_step.cur_snap_readers[i],
+					&gp_step.qsreaders[i], &budget);
+		else
+			pending = step_check_readers(
+					&gp_step.cur_snap_readers[i], NULL,
+					&gp_step.qsreaders[i], &budget);
+#endif
+		if (pending) {
+#ifdef HAS_INCOHERENT_CACHES
+			/* Force the readers to commit their state. */
+			smp_mb_master();
+#endif
+			mutex_unlock(&rcu_registry_lock);
+			return 0;
+		}
+	}
+
+	if (gp_step.phase == GP_STEP_FIRST_PHASE) {
+		/*
+		 * Same ordering as do_synchronize_rcu() around the parity
+		 * switch, which ends the step.
+		 */
+		cmm_barrier();
+		cmm_smp_mb();
+		CMM_STORE_SHARED(rcu_gp.ctr, rcu_gp.ctr ^ URCU_GP_CTR_PHASE);
+		cmm_barrier();
+		cmm_smp_mb();
+		urcu_stall_wait_start(&stall_watchdog);
+		gp_step.group = 0;
+		gp_step.phase = GP_STEP_SECOND_PHASE;
+		mutex_unlock(&rcu_registry_lock);
+		return 0;
+	}
+
+#ifndef RCU_READER_ARRAY
+	urcu_registry_for_each_group(&registry, i)
+		cds_list_splice(&gp_step.qsreaders[i], &registry.group[i]);
+#endif
+	/* Finish waiting for reader threads before freeing the old ptr. */
+	smp_mb_master();
+	urcu_stall_wait_end(&stall_watchdog);
+	gp_step_end();
+	return 1;
+}
+
+void rcu_set_stall_watchdog(unsigned long threshold_ms,
+		void (*func)(pthread_t tid, uint64_t active_ns, void *priv),
+		void *priv)
+{
+	mutex_lock(&rcu_gp_lock);
+	urcu_stall_set(&stall_watchdog, threshold_ms, func, priv);
+	mutex_unlock(&rcu_gp_lock);
+}
+
+int rcu_set_reader_boost(unsigned long threshold_ms, int policy, int priority)
+{
+	int ret;
+
+	mutex_lock(&rcu_gp_lock);
+	ret = urcu_stall_set_boost(&stall_watchdog, threshold_ms, policy,
+			priority);
+	mutex_unlock(&rcu_gp_lock);
+	return ret;
+}
+
+#ifdef CONFIG_RCU_CS_SAMPLING
+/* Read by the outermost read lock of each reader. */
+unsigned long rcu_cs_sample_period;
+
+int rcu_set_cs_sample_period(unsigned long period)
+{
+	CMM_STORE_SHARED(rcu_cs_sample_period, period);
+	return 0;
+}
+
+int rcu_for_each_reader_cs_stats(void (*func)(pthread_t tid,
+			const struct urcu_cs_stats *stats, void *priv),
+		void *priv)
+{
+	struct urcu_reader *index;
+	struct urcu_cs_stats stats;
+	unsigned int i, j;
+
+	mutex_lock(&rcu_registry_lock);
+	urcu_registry_for_each_group(&registry, i) {
+		cds_list_for_each_entry(index, &registry.group[i], node) {
+			stats.samples = CMM_LOAD_SHARED(index->cs_stats.samples);
+			for (j = 0; j < URCU_STATS_CS_HIST_BUCKETS; j++)
+				stats.duration_hist[j] = CMM_LOAD_SHARED(
+					index->cs_stats.duration_hist[j]);
+			stats.duration_max_ns = CMM_LOAD_SHARED(
+				index->cs_stats.duration_max_ns);
+			func(index->tid, &stats, priv);
+		}
+	}
+	mutex_unlock(&rcu_registry_lock);
+	return 0;
+}
+#else
+int rcu_set_cs_sample_period(unsigned long period)
+{
+	return -ENOSYS;
+}
+
+int rcu_for_each_reader_cs_stats(void (*func)(pthread_t tid,
+			const struct urcu_cs_stats *stats, void *priv),
+		void *priv)
+{
+	return -ENOSYS;
+}
+#endif
+
+int rcu_for_each_reader(void (*func)(const struct urcu_reader_info *info,
+			void *priv),
+		void *priv)
+{
+	struct urcu_reader *index;
+	struct urcu_reader_info info;
+	unsigned long *ctr;
+	unsigned int i;
+
+	mutex_lock(&rcu_registry_lock);
+	urcu_registry_for_each_group(&registry, i) {
+		cds_list_for_each_entry(index, &registry.group[i], node) {
+#ifdef RCU_READER_ARRAY
+			ctr = &index->slot->ctr;
+#else
+			ctr = &index->ctr;
+#endif
+			switch (urcu_common_reader_state(&rcu_gp, ctr)) {
+			case URCU_READER_ACTIVE_CURRENT:
+				info.state = URCU_READER_INFO_ACTIVE_CURRENT;
+				break;
+			case URCU_READER_ACTIVE_OLD:
+				info.state = URCU_READER_INFO_ACTIVE_OLD;
+				break;
+			default:
+				info.state = URCU_READER_INFO_INACTIVE;
+				break;
+			}
+			info.tid = index->tid;
+			info.detached = index->detached;
+			func(&info, priv);
+		}
+	}
+	mutex_unlock(&rcu_registry_lock);
+	return 0;
+}
+
+/*
+ * Grace-period polling. The cookie returned by
+ * get_state_synchronize_rcu() is reached once a full grace period has
+ * elapsed after the call.
+ */
+unsigned long get_state_synchronize_rcu(void)
+{
+	return urcu_gp_seq_snap(&rcu_gp.seq);
+}
+
+int poll_state_synchronize_rcu(unsigned long cookie)
+{
+	return urcu_gp_seq_done(&rcu_gp.seq, cookie);
+}
+
+void cond_synchronize_rcu(unsigned long cookie)
+{
+	if (!poll_state_synchronize_rcu(cookie))
+		synchronize_rcu();
+}
+
 /*
  * library wrappers to be used by non-LGPL compatible source code.
  */
@@ -543,33 +1230,215 @@ int rcu_read_ongoing(void)
 URCU_ATTR_ALIAS(urcu_stringify(rcu_read_ongoing))
 void alias_rcu_read_ongoing();
 
-void rcu_register_thread(void)
+#ifdef RCU_ISOLATED_READERS
+/*
+ * Check once whether membarrier can target CPUs one by one, which
+ * needs its own registration. Called with rcu_registry_lock held.
+ */
+static void membarrier_cpu_init(void)
+{
+#if defined(RCU_MEMBARRIER) || defined(RCU_SIGNAL)
+	int mask;
+
+	if (membarrier_cpu_checked)
+		return;
+	membarrier_cpu_checked = 1;
+	mask = membarrier(MEMBARRIER_CMD_QUERY, 0);
+	if (mask < 0 || !(mask & MEMBARRIER_CMD_PRIVATE_EXPEDITED_RSEQ))
+		return;
+	if (membarrier(MEMBARRIER_CMD_REGISTER_PRIVATE_EXPEDITED_RSEQ, 0))
+		return;
+	nr_cpus_conf = sysconf(_SC_NPROCESSORS_CONF);
+	if (nr_cpus_conf <= 0 || nr_cpus_conf > CPU_SETSIZE)
+		nr_cpus_conf = CPU_SETSIZE;
+	has_sys_membarrier_cpu = 1;
+#endif
+}
+
+/* Return the only CPU the calling thread may run on, or -1. */
+static int thread_pinned_cpu(void)
+{
+	cpu_set_t mask;
+	int cpu;
+
+	if (sched_getaffinity(0, sizeof(mask), &mask) || CPU_COUNT(&mask) != 1)
+		return -1;
+	for (cpu = 0; !CPU_ISSET(cpu, &mask); cpu++)
+		;
+	return cpu;
+}
+#endif
+
+/*
+ * Register the calling thread, as isolated on cpu if not negative.
+ */
+static void register_thread(int cpu)
 {
 	URCU_TLS(rcu_reader).tid = pthread_self();
 	assert(URCU_TLS(rcu_reader).need_mb == 0);
 	assert(!(URCU_TLS(rcu_reader).ctr & URCU_GP_CTR_NEST_MASK));
 
+	urcu_registry_init();
 	mutex_lock(&rcu_registry_lock);
 	assert(!URCU_TLS(rcu_reader).registered);
 	URCU_TLS(rcu_reader).registered = 1;
 	rcu_init();	/* In case gcc does not support constructor attribute */
-	cds_list_add(&URCU_TLS(rcu_reader).node, &registry);
+#ifdef RCU_ISOLATED_READERS
+	if (cpu >= 0) {
+		/* Full barriers on the read side before membarrier skips it. */
+		URCU_TLS(rcu_reader).isolated = cpu + 1;
+		membarrier_cpu_init();
+		isolated_cpu_readers[cpu]++;
+		nr_isolated_readers++;
+	} else {
+		cds_list_add(&URCU_TLS(rcu_reader).shared_cpu_node,
+				&shared_cpu_readers);
+	}
+#endif
+#ifdef RCU_READER_ARRAY
+	URCU_TLS(rcu_reader).slot = urcu_registry_add_slot(&registry,
+			&URCU_TLS(rcu_reader).node, URCU_TLS(rcu_reader).tid);
+#else
+	urcu_registry_add(&registry, &URCU_TLS(rcu_reader).node);
+#endif
 	mutex_unlock(&rcu_registry_lock);
 }
+
+void rcu_register_thread(void)
+{
+	register_thread(-1);
+}
 URCU_ATTR_ALIAS(urcu_stringify(rcu_register_thread))
 void alias_rcu_register_thread();
 
+int rcu_register_thread_isolated(void)
+{
+#ifdef RCU_ISOLATED_READERS
+	int cpu;
+
+	cpu = thread_pinned_cpu();
+	if (cpu < 0 || cpu >= CPU_SETSIZE)
+		return -EINVAL;
+	register_thread(cpu);
+	return 0;
+#else
+	return -ENOSYS;
+#endif
+}
+
 void rcu_unregister_thread(void)
 {
 	mutex_lock(&rcu_registry_lock);
 	assert(URCU_TLS(rcu_reader).registered);
 	URCU_TLS(rcu_reader).registered = 0;
+	urcu_stall_unregister(&stall_watchdog);
+#ifdef RCU_ISOLATED_READERS
+	if (URCU_TLS(rcu_reader).isolated) {
+		isolated_cpu_readers[URCU_TLS(rcu_reader).isolated - 1]--;
+		nr_isolated_readers--;
+		URCU_TLS(rcu_reader).isolated = 0;
+	} else {
+		cds_list_del(&URCU_TLS(rcu_reader).shared_cpu_node);
+	}
+#endif
+#ifdef RCU_READER_ARRAY
+	urcu_registry_del_slot(&registry, &URCU_TLS(rcu_reader).node,
+			URCU_TLS(rcu_reader).slot);
+	URCU_TLS(rcu_reader).slot = NULL;
+#else
 	cds_list_del(&URCU_TLS(rcu_reader).node);
+#endif
 	mutex_unlock(&rcu_registry_lock);
 }
 URCU_ATTR_ALIAS(urcu_stringify(rcu_unregister_thread))
 void alias_rcu_unregister_thread();
 
+/*
+ * Reader contexts follow the read-side algorithm of threads on their own
+ * reader structure, but issue full memory barriers: grace periods do not
+ * signal them, as they are not bound to a thread. With sys_membarrier,
+ * the barriers of the memb flavor reach whichever thread runs the
+ * context, which leaves them as compiler barriers.
+ */
+#ifdef RCU_MEMBARRIER
+#define reader_ctx_smp_mb()	urcu_memb_smp_mb_slave()
+#else
+#define reader_ctx_smp_mb()	cmm_smp_mb()
+#endif
+
+struct urcu_reader *rcu_reader_ctx_create(void)
+{
+	struct urcu_reader *ctx;
+
+	ctx = caa_cache_line_alloc(sizeof(*ctx));
+	if (!ctx)
+		return NULL;
+	memset(ctx, 0, sizeof(*ctx));
+	ctx->tid = pthread_self();
+	ctx->detached = 1;
+
+	urcu_registry_init();
+	mutex_lock(&rcu_registry_lock);
+	ctx->registered = 1;
+	rcu_init();	/* In case gcc does not support constructor attribute */
+#ifdef RCU_READER_ARRAY
+	ctx->slot = urcu_registry_add_slot(&registry, &ctx->node, ctx->tid);
+	ctx->slot->detached = 1;
+#else
+	urcu_registry_add(&registry, &ctx->node);
+#endif
+#ifdef RCU_ISOLATED_READERS
+	nr_unbound_readers++;
+#endif
+	mutex_unlock(&rcu_registry_lock);
+	return ctx;
+}
+
+void rcu_reader_ctx_destroy(struct urcu_reader *ctx)
+{
+	assert(!ctx->nesting);
+
+	mutex_lock(&rcu_registry_lock);
+	assert(ctx->registered && ctx->detached);
+	ctx->registered = 0;
+#ifdef RCU_READER_ARRAY
+	urcu_registry_del_slot(&registry, &ctx->node, ctx->slot);
+#else
+	cds_list_del(&ctx->node);
+#endif
+#ifdef RCU_ISOLATED_READERS
+	nr_unbound_readers--;
+#endif
+	mutex_unlock(&rcu_registry_lock);
+	free(ctx);
+}
+
+void rcu_read_lock_ctx(struct urcu_reader *ctx)
+{
+	urcu_assert(ctx->registered);
+	if (ctx->nesting++)
+		return;
+	CMM_STORE_SHARED(URCU_READER_SHARED(*ctx).ctr,
+		CMM_LOAD_SHARED(rcu_gp.ctr));
+	reader_ctx_smp_mb();
+}
+
+void rcu_read_unlock_ctx(struct urcu_reader *ctx)
+{
+	urcu_assert(ctx->registered && ctx->nesting);
+	if (--ctx->nesting)
+		return;
+	reader_ctx_smp_mb();
+	CMM_STORE_SHARED(URCU_READER_SHARED(*ctx).ctr, 0);
+	reader_ctx_smp_mb();
+	urcu_common_wake_up_gp(&rcu_gp);
+}
+
+int rcu_read_ongoing_ctx(struct urcu_reader *ctx)
+{
+	return ctx->nesting != 0;
+}
+
 #ifdef RCU_MEMBARRIER
 
 #ifdef CONFIG_RCU_FORCE_SYS_MEMBARRIER
@@ -611,10 +1480,7 @@ void rcu_sys_membarrier_init(void)
 
 void rcu_init(void)
 {
-	if (init_done)
-		return;
-	init_done = 1;
-	rcu_sys_membarrier_init();
+	(void) pthread_once(&init_once, rcu_sys_membarrier_init);
 }
 URCU_ATTR_ALIAS(urcu_stringify(rcu_init))
 void alias_rcu_init(void);
@@ -633,23 +1499,34 @@ static void sigrcu_handler(int signo, siginfo_t *siginfo, void *context)
 	cmm_smp_mb();
 }
 
-/*
- * rcu_init constructor. Called when the library is linked, but also when
- * reader threads are calling rcu_register_thread().
- * Should only be called by a single thread at a given time. This is ensured by
- * holing the rcu_registry_lock from rcu_register_thread() or by running
- * at library load time, which should not be executed by multiple
- * threads nor concurrently with rcu_register_thread() anyway.
- */
-void rcu_init(void)
+static
+bool rcu_sys_membarrier_init(void)
+{
+	int mask;
+
+	/*
+	 * Only the private expedited command is faster than signals: the
+	 * shared command waits for a scheduler grace period.
+	 */
+	mask = membarrier(MEMBARRIER_CMD_QUERY, 0);
+	if (mask < 0 || !(mask & MEMBARRIER_CMD_PRIVATE_EXPEDITED))
+		return false;
+	return !membarrier(MEMBARRIER_CMD_REGISTER_PRIVATE_EXPEDITED, 0);
+}
+
+static
+void rcu_signal_init(void)
 {
 	struct sigaction act;
 	int ret;
 
-	if (init_done)
+	/*
+	 * Leave SIGRCU to the application when membarrier can replace it.
+	 */
+	if (rcu_sys_membarrier_init()) {
+		urcu_signal_has_sys_membarrier = 1;
 		return;
-	init_done = 1;
-
+	}
 	act.sa_sigaction = sigrcu_handler;
 	act.sa_flags = SA_SIGINFO | SA_RESTART;
 	sigemptyset(&act.sa_mask);
@@ -657,6 +1534,16 @@ void rcu_init(void)
 	if (ret)
 		urcu_die(errno);
 }
+
+/*
+ * rcu_init constructor. Called when the library is linked, unless built
+ * with --enable-lazy-init, but also when reader threads are calling
+ * rcu_register_thread(). Runs the initialization once.
+ */
+void rcu_init(void)
+{
+	(void) pthread_once(&init_once, rcu_signal_init);
+}
 URCU_ATTR_ALIAS(urcu_stringify(rcu_init))
 void alias_rcu_init(void);
 
@@ -679,5 +1566,29 @@ void alias_rcu_exit(void);
 DEFINE_RCU_FLAVOR(rcu_flavor);
 DEFINE_RCU_FLAVOR_ALIAS(rcu_flavor, alias_rcu_flavor);
 
+/*
+ * Heap memory of the reader registry, for rcu_get_mem_stats(). Readers
+ * are in TLS, unless they are allocated from reader arrays.
+ */
+static size_t rcu_registry_mem_bytes(void)
+{
+#ifdef RCU_READER_ARRAY
+	struct urcu_reader_array_chunk *chunk;
+	size_t bytes = 0;
+	unsigned int i;
+
+	mutex_lock(&rcu_registry_lock);
+	urcu_registry_for_each_group(&registry, i) {
+		for (chunk = registry.array[i].chunks; chunk; chunk = chunk->next)
+			bytes += urcu_reader_array_chunk_len(chunk->nr_slots);
+	}
+	mutex_unlock(&rcu_registry_lock);
+	return bytes;
+#else
+	return 0;
+#endif
+}
+
 #include "urcu-call-rcu-impl.h"
 #include "urcu-defer-impl.h"
+#include "urcu-srcu-impl.h"
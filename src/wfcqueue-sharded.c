@@ -0,0 +1,188 @@
+/*
+ * wfcqueue-sharded.c
+ *
+ * Userspace RCU library - Per-CPU Sharded Concurrent Queue with Wait-Free
+ * Enqueue/Blocking Dequeue
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+#define _LGPL_SOURCE
+#include <stdlib.h>
+#include <unistd.h>
+#include <assert.h>
+
+#include <urcu/arch.h>
+#include <urcu/compiler.h>
+#include <urcu/uatomic.h>
+#include <urcu/tls-compat.h>
+#include <urcu/wfcqueue.h>
+#include <urcu/wfcqueue-sharded.h>
+
+#include "compat-getcpu.h"
+
+/*
+ * Head and tail of a shard are on separate cache-lines, so consumers
+ * checking a shard do not bounce the line its producers enqueue on.
+ */
+struct wfcq_shard {
+	struct cds_wfcq_head head __attribute__((aligned(CAA_CACHE_LINE_SIZE)));
+	struct cds_wfcq_tail tail __attribute__((aligned(CAA_CACHE_LINE_SIZE)));
+} __attribute__((aligned(CAA_CACHE_LINE_SIZE)));
+
+struct cds_wfcq_sharded {
+	unsigned long mask;		/* Number of shards - 1. */
+	unsigned long next_dequeue;	/* Round-robin hint for consumers. */
+	struct wfcq_shard *shards;
+};
+
+/*
+ * Shard of threads for which the current CPU is unknown: each thread
+ * picks one on first enqueue, spreading threads over the shards.
+ */
+static DEFINE_URCU_TLS(unsigned long, thread_shard);
+static unsigned long next_thread_shard;
+
+static struct wfcq_shard *get_enqueue_shard(struct cds_wfcq_sharded *q)
+{
+	int cpu;
+
+	cpu = urcu_sched_getcpu();
+	if (caa_likely(cpu >= 0))
+		return &q->shards[cpu & q->mask];
+	if (caa_unlikely(!URCU_TLS(thread_shard)))
+		URCU_TLS(thread_shard) =
+			uatomic_add_return(&next_thread_shard, 1);
+	return &q->shards[URCU_TLS(thread_shard) & q->mask];
+}
+
+struct cds_wfcq_sharded *cds_wfcq_sharded_new(unsigned long nr_shards)
+{
+	struct cds_wfcq_sharded *q;
+	unsigned long i, nr = 1;
+	long nr_cpus;
+
+	if (!nr_shards) {
+		nr_cpus = sysconf(_SC_NPROCESSORS_CONF);
+		nr_shards = nr_cpus > 0 ? nr_cpus : 1;
+	}
+	while (nr < nr_shards)
+		nr <<= 1;
+
+	q = calloc(1, sizeof(*q));
+	if (!q)
+		return NULL;
+	if (posix_memalign((void **) &q->shards, CAA_CACHE_LINE_SIZE,
+			nr * sizeof(*q->shards))) {
+		free(q);
+		return NULL;
+	}
+	for (i = 0; i < nr; i++)
+		cds_wfcq_init(&q->shards[i].head, &q->shards[i].tail);
+	q->mask = nr - 1;
+	return q;
+}
+
+void cds_wfcq_sharded_destroy(struct cds_wfcq_sharded *q)
+{
+	unsigned long i;
+
+	for (i = 0; i <= q->mask; i++) {
+		assert(cds_wfcq_empty(&q->shards[i].head, &q->shards[i].tail));
+		cds_wfcq_destroy(&q->shards[i].head, &q->shards[i].tail);
+	}
+	free(q->shards);
+	free(q);
+}
+
+unsigned long cds_wfcq_sharded_nr_shards(struct cds_wfcq_sharded *q)
+{
+	return q->mask + 1;
+}
+
+bool cds_wfcq_sharded_empty(struct cds_wfcq_sharded *q)
+{
+	unsigned long i;
+
+	for (i = 0; i <= q->mask; i++) {
+		if (!cds_wfcq_empty(&q->shards[i].head, &q->shards[i].tail))
+			return false;
+	}
+	return true;
+}
+
+bool cds_wfcq_sharded_enqueue(struct cds_wfcq_sharded *q,
+		struct cds_wfcq_node *node)
+{
+	struct wfcq_shard *shard = get_enqueue_shard(q);
+
+	return cds_wfcq_enqueue(&shard->head, &shard->tail, node);
+}
+
+bool cds_wfcq_sharded_enqueue_batch(struct cds_wfcq_sharded *q,
+		struct cds_wfcq_node *first,
+		struct cds_wfcq_node *last)
+{
+	struct wfcq_shard *shard = get_enqueue_shard(q);
+
+	return cds_wfcq_enqueue_batch(&shard->head, &shard->tail,
+			first, last);
+}
+
+struct cds_wfcq_node *cds_wfcq_sharded_dequeue_blocking(
+		struct cds_wfcq_sharded *q)
+{
+	unsigned long start, i, index;
+	struct cds_wfcq_node *node;
+	struct wfcq_shard *shard;
+
+	start = CMM_LOAD_SHARED(q->next_dequeue);
+	for (i = 0; i <= q->mask; i++) {
+		index = (start + i) & q->mask;
+		shard = &q->shards[index];
+		if (cds_wfcq_empty(&shard->head, &shard->tail))
+			continue;
+		node = cds_wfcq_dequeue_blocking(&shard->head, &shard->tail);
+		if (!node)
+			continue;
+		/* Racy hint, only used to spread dequeues over shards. */
+		CMM_STORE_SHARED(q->next_dequeue, index + 1);
+		return node;
+	}
+	return NULL;
+}
+
+enum cds_wfcq_ret cds_wfcq_sharded_splice_blocking(
+		struct cds_wfcq_head *dest_q_head,
+		struct cds_wfcq_tail *dest_q_tail,
+		struct cds_wfcq_sharded *q)
+{
+	enum cds_wfcq_ret ret, state = CDS_WFCQ_RET_SRC_EMPTY;
+	unsigned long start, i;
+	struct wfcq_shard *shard;
+
+	start = CMM_LOAD_SHARED(q->next_dequeue);
+	for (i = 0; i <= q->mask; i++) {
+		shard = &q->shards[(start + i) & q->mask];
+		if (cds_wfcq_empty(&shard->head, &shard->tail))
+			continue;
+		ret = cds_wfcq_splice_blocking(dest_q_head, dest_q_tail,
+				&shard->head, &shard->tail);
+		if (state == CDS_WFCQ_RET_SRC_EMPTY)
+			state = ret;
+	}
+	CMM_STORE_SHARED(q->next_dequeue, start + 1);
+	return state;
+}
@@ -66,6 +66,51 @@ bool cds_wfcq_enqueue(cds_wfcq_head_ptr_t head,
 	return _cds_wfcq_enqueue(head, tail, node);
 }
 
+bool cds_wfcq_enqueue_batch(cds_wfcq_head_ptr_t head,
+		struct cds_wfcq_tail *tail,
+		struct cds_wfcq_node *first,
+		struct cds_wfcq_node *last)
+{
+	return _cds_wfcq_enqueue_batch(head, tail, first, last);
+}
+
+void cds_wfcq_waiter_init(struct cds_wfcq_waiter *waiter)
+{
+	_cds_wfcq_waiter_init(waiter);
+}
+
+void cds_wfcq_waiter_get_stats(struct cds_wfcq_waiter *waiter,
+		struct cds_wfcq_wait_stats *stats)
+{
+	_cds_wfcq_waiter_get_stats(waiter, stats);
+}
+
+bool cds_wfcq_enqueue_wake(cds_wfcq_head_ptr_t head,
+		struct cds_wfcq_tail *tail,
+		struct cds_wfcq_waiter *waiter,
+		struct cds_wfcq_node *node)
+{
+	return _cds_wfcq_enqueue_wake(head, tail, waiter, node);
+}
+
+bool cds_wfcq_enqueue_batch_wake(cds_wfcq_head_ptr_t head,
+		struct cds_wfcq_tail *tail,
+		struct cds_wfcq_waiter *waiter,
+		struct cds_wfcq_node *first,
+		struct cds_wfcq_node *last)
+{
+	return _cds_wfcq_enqueue_batch_wake(head, tail, waiter, first, last);
+}
+
+struct cds_wfcq_node *cds_wfcq_dequeue_timeout(
+		struct cds_wfcq_head *head,
+		struct cds_wfcq_tail *tail,
+		struct cds_wfcq_waiter *waiter,
+		int timeout_ms)
+{
+	return _cds_wfcq_dequeue_timeout(head, tail, waiter, timeout_ms);
+}
+
 void cds_wfcq_dequeue_lock(struct cds_wfcq_head *head,
 		struct cds_wfcq_tail *tail)
 {
@@ -93,6 +138,15 @@ struct cds_wfcq_node *cds_wfcq_dequeue_with_state_blocking(
 	return _cds_wfcq_dequeue_with_state_blocking(head, tail, state);
 }
 
+unsigned long cds_wfcq_dequeue_batch_blocking(
+		struct cds_wfcq_head *head,
+		struct cds_wfcq_tail *tail,
+		struct cds_wfcq_node **nodes,
+		unsigned long max)
+{
+	return _cds_wfcq_dequeue_batch_blocking(head, tail, nodes, max);
+}
+
 enum cds_wfcq_ret cds_wfcq_splice_blocking(
 		struct cds_wfcq_head *dest_q_head,
 		struct cds_wfcq_tail *dest_q_tail,
@@ -118,6 +172,15 @@ struct cds_wfcq_node *__cds_wfcq_dequeue_with_state_blocking(
 	return ___cds_wfcq_dequeue_with_state_blocking(head, tail, state);
 }
 
+unsigned long __cds_wfcq_dequeue_batch_blocking(
+		cds_wfcq_head_ptr_t head,
+		struct cds_wfcq_tail *tail,
+		struct cds_wfcq_node **nodes,
+		unsigned long max)
+{
+	return ___cds_wfcq_dequeue_batch_blocking(head, tail, nodes, max);
+}
+
 struct cds_wfcq_node *__cds_wfcq_dequeue_nonblocking(
 		cds_wfcq_head_ptr_t head,
 		struct cds_wfcq_tail *tail)
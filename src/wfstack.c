@@ -58,6 +58,12 @@ int cds_wfs_push(cds_wfs_stack_ptr_t u_stack, struct cds_wfs_node *node)
 	return _cds_wfs_push(u_stack, node);
 }
 
+int cds_wfs_push_batch(cds_wfs_stack_ptr_t u_stack,
+		struct cds_wfs_node *first, struct cds_wfs_node *last)
+{
+	return _cds_wfs_push_batch(u_stack, first, last);
+}
+
 struct cds_wfs_node *cds_wfs_pop_blocking(struct cds_wfs_stack *s)
 {
 	return _cds_wfs_pop_blocking(s);
@@ -34,38 +34,78 @@
 #include <sys/time.h>
 #include <unistd.h>
 #include <sched.h>
+#include <time.h>
 
 #include "compat-getcpu.h"
 #include <urcu/wfcqueue.h>
+#include <urcu/wfcqueue-prio.h>
 #include <urcu/pointer.h>
 #include <urcu/list.h>
 #include <urcu/futex.h>
 #include <urcu/tls-compat.h>
 #include <urcu/ref.h>
+#include <urcu/flavor.h>
+#include <urcu/cache-line.h>
+#include <urcu/asymmetric-fence.h>
 #include "urcu-die.h"
+#include "urcu-spin.h"
 
 #include "workqueue.h"
 
 #define SET_AFFINITY_CHECK_PERIOD		(1U << 8)	/* 256 */
 #define SET_AFFINITY_CHECK_PERIOD_MASK		(SET_AFFINITY_CHECK_PERIOD - 1)
 
+/*
+ * Timer wheel of delayed work: one list per tick of 1 ms, where work due
+ * in a later round of the wheel waits for its round.
+ */
+#define WORKQUEUE_WHEEL_ORDER			6
+#define WORKQUEUE_WHEEL_SIZE			(1UL << WORKQUEUE_WHEEL_ORDER)
+#define WORKQUEUE_WHEEL_MASK			(WORKQUEUE_WHEEL_SIZE - 1)
+
+/*
+ * URCU_WORKQUEUE_RT workers finding their queue empty for this long stop
+ * polling, and sleep until work is queued, see workqueue_park().
+ */
+#define WORKQUEUE_RT_PARK_MS			100
+
+/*
+ * Data structure that identifies a worker thread. Work is queued to the
+ * workers in turn. Each worker dequeues one work item at a time from its
+ * queue, highest priority first, and steals work from the queues of the
+ * other workers when its own is empty.
+ */
+
+struct urcu_workqueue_worker {
+	struct cds_wfcq_prio cbs;
+	int32_t futex;
+	unsigned int spin_attempts;	/* see urcu_consumer_spin() */
+	unsigned long nr_running;	/* work dequeued and not done yet */
+	pthread_t tid;
+	unsigned long loop_count;
+	unsigned int index;
+	struct urcu_workqueue *workqueue;
+} __attribute__((aligned(CAA_CACHE_LINE_SIZE)));
+
 /* Data structure that identifies a workqueue. */
 
 struct urcu_workqueue {
-	/*
-	 * We do not align head on a different cache-line than tail
-	 * mainly because workqueue threads use batching ("splice") to
-	 * get an entire list of callbacks, which effectively empties
-	 * the queue, and requires to touch the tail anyway.
-	 */
-	struct cds_wfcq_tail cbs_tail;
-	struct cds_wfcq_head cbs_head;
 	unsigned long flags;
-	int32_t futex;
 	unsigned long qlen; /* maintained for debugging. */
-	pthread_t tid;
 	int cpu_affinity;
-	unsigned long loop_count;
+	unsigned int nr_workers;
+	unsigned int nr_paused;
+	unsigned long next_worker;	/* for round-robin queueing */
+	struct urcu_workqueue_worker *workers;
+	size_t worker_stride;		/* padded to the running machine */
+	/* Delayed work, expired by the first worker. */
+	pthread_mutex_t timer_mutex;
+	struct cds_list_head wheel[WORKQUEUE_WHEEL_SIZE];
+	unsigned long wheel_time;	/* next tick to expire */
+	unsigned long nr_delayed;
+	/* Completions of urcu_workqueue_flush_queued_work(), kept for reuse. */
+	pthread_mutex_t completion_mutex;
+	struct cds_list_head completion_pool;
 	void *priv;
 	void (*grace_period_fct)(struct urcu_workqueue *workqueue, void *priv);
 	void (*initialize_worker_fct)(struct urcu_workqueue *workqueue, void *priv);
@@ -74,18 +114,43 @@ struct urcu_workqueue {
 	void (*worker_after_resume_fct)(struct urcu_workqueue *workqueue, void *priv);
 	void (*worker_before_wait_fct)(struct urcu_workqueue *workqueue, void *priv);
 	void (*worker_after_wake_up_fct)(struct urcu_workqueue *workqueue, void *priv);
-} __attribute__((aligned(CAA_CACHE_LINE_SIZE)));
+};
 
+struct urcu_workqueue_completion_work {
+	struct urcu_work work;
+	struct urcu_workqueue_completion *completion;
+	int embedded;			/* in the works of the completion */
+};
+
+/*
+ * Completions from the pool of a workqueue embed one work item for each
+ * of its workers, and return to the pool when released, so that flushing
+ * the workqueue does not allocate memory once the pool holds one
+ * completion for each concurrent flush. A pool holds two completions
+ * from the creation of the workqueue: one for a flush, and one for the
+ * previous flush, which workers may still hold for a moment after it
+ * returns.
+ */
 struct urcu_workqueue_completion {
 	int barrier_count;
 	int32_t futex;
 	struct urcu_ref ref;
+	struct urcu_workqueue *workqueue;	/* pool owner, or NULL */
+	struct cds_list_head node;		/* in the completion pool */
+	struct urcu_workqueue_completion_work works[];
 };
 
-struct urcu_workqueue_completion_work {
-	struct urcu_work work;
-	struct urcu_workqueue_completion *completion;
-};
+/*
+ * Workers are padded to the cache line size of the running machine, which
+ * may be larger than the one their type is aligned on.
+ */
+static
+struct urcu_workqueue_worker *workqueue_worker(
+		struct urcu_workqueue *workqueue, unsigned long i)
+{
+	return (struct urcu_workqueue_worker *)
+		((char *) workqueue->workers + i * workqueue->worker_stride);
+}
 
 /*
  * Periodically retry setting CPU affinity if we migrate.
@@ -93,14 +158,15 @@ struct urcu_workqueue_completion_work {
  * cpuset(7).
  */
 #if HAVE_SCHED_SETAFFINITY
-static int set_thread_cpu_affinity(struct urcu_workqueue *workqueue)
+static int set_thread_cpu_affinity(struct urcu_workqueue_worker *worker)
 {
+	struct urcu_workqueue *workqueue = worker->workqueue;
 	cpu_set_t mask;
 	int ret;
 
 	if (workqueue->cpu_affinity < 0)
 		return 0;
-	if (++workqueue->loop_count & SET_AFFINITY_CHECK_PERIOD_MASK)
+	if (++worker->loop_count & SET_AFFINITY_CHECK_PERIOD_MASK)
 		return 0;
 	if (urcu_sched_getcpu() == workqueue->cpu_affinity)
 		return 0;
@@ -124,23 +190,62 @@ static int set_thread_cpu_affinity(struct urcu_workqueue *workqueue)
 	return ret;
 }
 #else
-static int set_thread_cpu_affinity(struct urcu_workqueue *workqueue)
+static int set_thread_cpu_affinity(struct urcu_workqueue_worker *worker)
 {
 	return 0;
 }
 #endif
 
-static void futex_wait(int32_t *futex)
+static void mutex_lock(pthread_mutex_t *mutex)
+{
+	int ret;
+
+	ret = pthread_mutex_lock(mutex);
+	if (ret)
+		urcu_die(ret);
+}
+
+static void mutex_unlock(pthread_mutex_t *mutex)
+{
+	int ret;
+
+	ret = pthread_mutex_unlock(mutex);
+	if (ret)
+		urcu_die(ret);
+}
+
+static unsigned long workqueue_now_ms(void)
 {
+	struct timespec ts;
+
+	if (clock_gettime(CLOCK_MONOTONIC, &ts))
+		urcu_die(errno);
+	return (unsigned long) ts.tv_sec * 1000UL + ts.tv_nsec / 1000000L;
+}
+
+/* Wait for a wake up, or until timeout_ms elapsed if not negative. */
+static void futex_wait(int32_t *futex, long timeout_ms)
+{
+	struct timespec timeout, *ptimeout = NULL;
+
+	if (timeout_ms >= 0) {
+		timeout.tv_sec = timeout_ms / 1000;
+		timeout.tv_nsec = (timeout_ms % 1000) * 1000000L;
+		ptimeout = &timeout;
+	}
 	/* Read condition before read futex */
 	cmm_smp_mb();
 	if (uatomic_read(futex) != -1)
 		return;
-	while (futex_async(futex, FUTEX_WAIT, -1, NULL, NULL, 0)) {
+	while (futex_async(futex, FUTEX_WAIT_PRIVATE, -1, ptimeout, NULL, 0)) {
 		switch (errno) {
 		case EWOULDBLOCK:
 			/* Value already changed. */
 			return;
+		case ETIMEDOUT:
+			/* As if woken up: the worker decrements it again. */
+			uatomic_set(futex, 0);
+			return;
 		case EINTR:
 			/* Retry if interrupted by signal. */
 			break;	/* Get out of switch. */
@@ -151,44 +256,239 @@ static void futex_wait(int32_t *futex)
 	}
 }
 
-static void futex_wake_up(int32_t *futex)
+/* Called after the write to the condition is ordered before. */
+static void futex_wake_up_sleeping(int32_t *futex)
 {
-	/* Write to condition before reading/writing futex */
-	cmm_smp_mb();
 	if (caa_unlikely(uatomic_read(futex) == -1)) {
 		uatomic_set(futex, 0);
-		if (futex_async(futex, FUTEX_WAKE, 1,
+		if (futex_async(futex, FUTEX_WAKE_PRIVATE, 1,
 				NULL, NULL, 0) < 0)
 			urcu_die(errno);
 	}
 }
 
+static void futex_wake_up(int32_t *futex)
+{
+	/* Write to condition before reading/writing futex */
+	cmm_smp_mb();
+	futex_wake_up_sleeping(futex);
+}
+
+/*
+ * Sleep until work is queued, or for timeout_ms if not negative, once a
+ * URCU_WORKQUEUE_RT worker has been idle for WORKQUEUE_RT_PARK_MS.
+ * Producers only issue a compiler barrier on their side, paired with
+ * the heavy fence, and a FUTEX_WAKE for the first work queued after
+ * the worker has parked.
+ */
+static void workqueue_park(struct urcu_workqueue_worker *worker,
+		long timeout_ms)
+{
+	uatomic_set(&worker->futex, -1);
+	/* Write futex before reading workqueue and flags */
+	cmm_asymmetric_fence_heavy();
+	if (cds_wfcq_prio_empty(&worker->cbs)
+			&& !(uatomic_read(&worker->workqueue->flags)
+				& (URCU_WORKQUEUE_STOP | URCU_WORKQUEUE_PAUSE)))
+		futex_wait(&worker->futex, timeout_ms);
+	uatomic_set(&worker->futex, 0);
+}
+
+static void _urcu_workqueue_wait_complete(struct urcu_work *work);
+
+static void wake_worker_thread(struct urcu_workqueue_worker *worker)
+{
+	if (!(_CMM_LOAD_SHARED(worker->workqueue->flags) & URCU_WORKQUEUE_RT)) {
+		futex_wake_up(&worker->futex);
+	} else {
+		/* Paired with the heavy fence of workqueue_park(). */
+		cmm_asymmetric_fence_light();
+		futex_wake_up_sleeping(&worker->futex);
+	}
+}
+
+/* Wake a worker waiting for work, to steal some of ours. */
+static void wake_sibling_worker(struct urcu_workqueue_worker *self)
+{
+	struct urcu_workqueue *workqueue = self->workqueue;
+	struct urcu_workqueue_worker *worker;
+	unsigned int i;
+
+	for (i = 0; i < workqueue->nr_workers; i++) {
+		worker = workqueue_worker(workqueue, i);
+		if (worker != self && uatomic_read(&worker->futex) == -1) {
+			wake_worker_thread(worker);
+			break;
+		}
+	}
+}
+
+static bool worker_has_work(void *priv)
+{
+	struct urcu_workqueue_worker *worker = priv;
+
+	return !cds_wfcq_prio_empty(&worker->cbs);
+}
+
+/*
+ * Dequeue a work item of worker, and count it as running until
+ * workqueue_run() is done with it. Returns NULL if the queue is empty.
+ */
+static struct urcu_work *workqueue_take(struct urcu_workqueue_worker *worker)
+{
+	struct cds_wfcq_node *node;
+
+	cds_wfcq_prio_dequeue_lock(&worker->cbs);
+	node = __cds_wfcq_prio_dequeue_blocking(&worker->cbs);
+	if (node)
+		uatomic_inc(&worker->nr_running);
+	cds_wfcq_prio_dequeue_unlock(&worker->cbs);
+	if (!node)
+		return NULL;
+	return caa_container_of(node, struct urcu_work, next);
+}
+
+/* Run a work item taken from the queue of worker. */
+static void workqueue_run(struct urcu_workqueue_worker *worker,
+		struct urcu_work *work)
+{
+	struct urcu_workqueue *workqueue = worker->workqueue;
+
+	if (work->func == _urcu_workqueue_wait_complete) {
+		/*
+		 * Wait for the work dequeued before the completion, which
+		 * may run in other workers.
+		 */
+		while (uatomic_read(&worker->nr_running) > 1)
+			(void) poll(NULL, 0, 1);
+		/* Read nr_running before running the completion. */
+		cmm_smp_mb();
+	}
+	if (workqueue->grace_period_fct)
+		workqueue->grace_period_fct(workqueue, workqueue->priv);
+	/* Started: queueing work again now queues another instance. */
+	uatomic_set(&work->pending, 0);
+	work->func(work);
+	uatomic_dec(&workqueue->qlen);
+	/* Run work before decrementing nr_running. */
+	cmm_smp_mb();
+	uatomic_dec(&worker->nr_running);
+}
+
+/*
+ * Run a work item of another worker. Returns 0 if all other queues are
+ * empty.
+ */
+static int workqueue_steal(struct urcu_workqueue_worker *self)
+{
+	struct urcu_workqueue *workqueue = self->workqueue;
+	struct urcu_workqueue_worker *worker;
+	struct urcu_work *work;
+	unsigned int i;
+
+	for (i = 1; i < workqueue->nr_workers; i++) {
+		worker = workqueue_worker(workqueue,
+				(self->index + i) % workqueue->nr_workers);
+		if (cds_wfcq_prio_empty(&worker->cbs))
+			continue;
+		work = workqueue_take(worker);
+		if (work) {
+			workqueue_run(worker, work);
+			return 1;
+		}
+	}
+	return 0;
+}
+
+static void workqueue_queue(struct urcu_workqueue *workqueue,
+		struct urcu_work *work, void (*func)(struct urcu_work *work),
+		unsigned int prio);
+
+/*
+ * Queue the delayed work which is due, or all delayed work if flush is
+ * set. Returns the delay in ms until the next tick with work due, or -1
+ * if no work is delayed.
+ */
+static long workqueue_run_timers(struct urcu_workqueue *workqueue, int flush)
+{
+	struct urcu_work *work, *tmp;
+	unsigned long now, nr_ticks, i;
+	struct cds_list_head *slot;
+	long timeout = -1;
+
+	if (!uatomic_read(&workqueue->nr_delayed))
+		return -1;
+	mutex_lock(&workqueue->timer_mutex);
+	now = workqueue_now_ms();
+	nr_ticks = WORKQUEUE_WHEEL_SIZE;
+	if (!flush) {
+		/* The current tick may already have been run. */
+		if ((long) (now - workqueue->wheel_time) < 0)
+			nr_ticks = 0;
+		else if (now - workqueue->wheel_time < WORKQUEUE_WHEEL_SIZE)
+			nr_ticks = now - workqueue->wheel_time + 1;
+	}
+	for (i = 0; i < nr_ticks; i++) {
+		slot = &workqueue->wheel[(workqueue->wheel_time + i)
+				& WORKQUEUE_WHEEL_MASK];
+		cds_list_for_each_entry_safe(work, tmp, slot, timer_node) {
+			if (!flush && (long) (work->expires - now) > 0)
+				continue;
+			cds_list_del(&work->timer_node);
+			workqueue->nr_delayed--;
+			workqueue_queue(workqueue, work, work->func,
+				URCU_WORK_PRIO_NORMAL);
+		}
+	}
+	if (nr_ticks)
+		workqueue->wheel_time = now + 1;
+	/* Find the first tick with work due in this round. */
+	for (i = 0; workqueue->nr_delayed && i < WORKQUEUE_WHEEL_SIZE; i++) {
+		slot = &workqueue->wheel[(workqueue->wheel_time + i)
+				& WORKQUEUE_WHEEL_MASK];
+		cds_list_for_each_entry(work, slot, timer_node) {
+			if (work->expires - workqueue->wheel_time
+					< WORKQUEUE_WHEEL_SIZE) {
+				timeout = work->expires - now;
+				break;
+			}
+		}
+		if (timeout >= 0)
+			break;
+	}
+	if (workqueue->nr_delayed && timeout < 0)
+		timeout = WORKQUEUE_WHEEL_SIZE;
+	mutex_unlock(&workqueue->timer_mutex);
+	return timeout;
+}
+
 /* This is the code run by each worker thread. */
 
 static void *workqueue_thread(void *arg)
 {
-	unsigned long cbcount;
-	struct urcu_workqueue *workqueue = (struct urcu_workqueue *) arg;
+	struct urcu_workqueue_worker *worker =
+		(struct urcu_workqueue_worker *) arg;
+	struct urcu_workqueue *workqueue = worker->workqueue;
 	int rt = !!(uatomic_read(&workqueue->flags) & URCU_WORKQUEUE_RT);
+	unsigned long idle_start_ms = 0;
 
-	if (set_thread_cpu_affinity(workqueue))
+	if (set_thread_cpu_affinity(worker))
 		urcu_die(errno);
 
 	if (workqueue->initialize_worker_fct)
 		workqueue->initialize_worker_fct(workqueue, workqueue->priv);
 
 	if (!rt) {
-		uatomic_dec(&workqueue->futex);
+		uatomic_dec(&worker->futex);
 		/* Decrement futex before reading workqueue */
 		cmm_smp_mb();
 	}
 	for (;;) {
-		struct cds_wfcq_head cbs_tmp_head;
-		struct cds_wfcq_tail cbs_tmp_tail;
-		struct cds_wfcq_node *cbs, *cbs_tmp_n;
-		enum cds_wfcq_ret splice_ret;
+		struct urcu_work *work;
+		long timeout = -1;
+		int woken = 0;
 
-		if (set_thread_cpu_affinity(workqueue))
+		if (set_thread_cpu_affinity(worker))
 			urcu_die(errno);
 
 		if (uatomic_read(&workqueue->flags) & URCU_WORKQUEUE_PAUSE) {
@@ -200,54 +500,59 @@ static void *workqueue_thread(void *arg)
 			 */
 			if (workqueue->worker_before_pause_fct)
 				workqueue->worker_before_pause_fct(workqueue, workqueue->priv);
-			cmm_smp_mb__before_uatomic_or();
-			uatomic_or(&workqueue->flags, URCU_WORKQUEUE_PAUSED);
+			cmm_smp_mb__before_uatomic_inc();
+			uatomic_inc(&workqueue->nr_paused);
 			while ((uatomic_read(&workqueue->flags) & URCU_WORKQUEUE_PAUSE) != 0)
 				(void) poll(NULL, 0, 1);
-			uatomic_and(&workqueue->flags, ~URCU_WORKQUEUE_PAUSED);
-			cmm_smp_mb__after_uatomic_and();
+			uatomic_dec(&workqueue->nr_paused);
+			cmm_smp_mb__after_uatomic_dec();
 			if (workqueue->worker_after_resume_fct)
 				workqueue->worker_after_resume_fct(workqueue, workqueue->priv);
 		}
 
-		cds_wfcq_init(&cbs_tmp_head, &cbs_tmp_tail);
-		splice_ret = __cds_wfcq_splice_blocking(&cbs_tmp_head,
-			&cbs_tmp_tail, &workqueue->cbs_head, &workqueue->cbs_tail);
-		assert(splice_ret != CDS_WFCQ_RET_WOULDBLOCK);
-		assert(splice_ret != CDS_WFCQ_RET_DEST_NON_EMPTY);
-		if (splice_ret != CDS_WFCQ_RET_SRC_EMPTY) {
-			if (workqueue->grace_period_fct)
-				workqueue->grace_period_fct(workqueue, workqueue->priv);
-			cbcount = 0;
-			__cds_wfcq_for_each_blocking_safe(&cbs_tmp_head,
-					&cbs_tmp_tail, cbs, cbs_tmp_n) {
-				struct urcu_work *uwp;
-
-				uwp = caa_container_of(cbs,
-					struct urcu_work, next);
-				uwp->func(uwp);
-				cbcount++;
+		while ((work = workqueue_take(worker)) != NULL) {
+			if (!woken && !cds_wfcq_prio_empty(&worker->cbs)) {
+				wake_sibling_worker(worker);
+				woken = 1;
 			}
-			uatomic_sub(&workqueue->qlen, cbcount);
+			workqueue_run(worker, work);
+			idle_start_ms = 0;
 		}
 		if (uatomic_read(&workqueue->flags) & URCU_WORKQUEUE_STOP)
 			break;
+		while (workqueue_steal(worker))
+			;
+		if (!worker->index)
+			timeout = workqueue_run_timers(workqueue, 0);
 		if (workqueue->worker_before_wait_fct)
 			workqueue->worker_before_wait_fct(workqueue, workqueue->priv);
 		if (!rt) {
-			if (cds_wfcq_empty(&workqueue->cbs_head,
-					&workqueue->cbs_tail)) {
-				futex_wait(&workqueue->futex);
-				uatomic_dec(&workqueue->futex);
+			/*
+			 * Work queued while spinning is taken without a
+			 * wake-up: not sleeping under steady traffic saves
+			 * the FUTEX_WAKE of producers and the FUTEX_WAIT.
+			 */
+			if (cds_wfcq_prio_empty(&worker->cbs)
+					&& !urcu_consumer_spin(&worker->futex,
+						&worker->spin_attempts,
+						worker_has_work, worker)) {
+				futex_wait(&worker->futex, timeout);
+				uatomic_dec(&worker->futex);
 				/*
 				 * Decrement futex before reading
 				 * urcu_work list.
 				 */
 				cmm_smp_mb();
 			}
-		} else {
-			if (cds_wfcq_empty(&workqueue->cbs_head,
-					&workqueue->cbs_tail)) {
+		} else if (cds_wfcq_prio_empty(&worker->cbs)) {
+			unsigned long now = workqueue_now_ms();
+
+			if (!idle_start_ms)
+				idle_start_ms = now | 1;
+			if (now - idle_start_ms >= WORKQUEUE_RT_PARK_MS) {
+				workqueue_park(worker, timeout);
+				idle_start_ms = 0;
+			} else {
 				(void) poll(NULL, 0, 10);
 			}
 		}
@@ -259,15 +564,49 @@ static void *workqueue_thread(void *arg)
 		 * Read urcu_work list before write futex.
 		 */
 		cmm_smp_mb();
-		uatomic_set(&workqueue->futex, 0);
+		uatomic_set(&worker->futex, 0);
 	}
 	if (workqueue->finalize_worker_fct)
 		workqueue->finalize_worker_fct(workqueue, workqueue->priv);
 	return NULL;
 }
 
-struct urcu_workqueue *urcu_workqueue_create(unsigned long flags,
-		int cpu_affinity, void *priv,
+static void create_worker_thread(struct urcu_workqueue_worker *worker)
+{
+	int ret;
+
+	worker->tid = 0;
+	ret = pthread_create(&worker->tid, NULL, workqueue_thread, worker);
+	if (ret) {
+		urcu_die(ret);
+	}
+}
+
+/*
+ * Allocate a completion for the pool of workqueue, with one embedded
+ * work item for each worker.
+ */
+static
+struct urcu_workqueue_completion *workqueue_completion_alloc(
+		struct urcu_workqueue *workqueue)
+{
+	struct urcu_workqueue_completion *completion;
+	unsigned int i;
+
+	completion = calloc(sizeof(*completion) + workqueue->nr_workers
+			* sizeof(completion->works[0]), 1);
+	if (!completion)
+		urcu_die(errno);
+	completion->workqueue = workqueue;
+	for (i = 0; i < workqueue->nr_workers; i++) {
+		completion->works[i].completion = completion;
+		completion->works[i].embedded = 1;
+	}
+	return completion;
+}
+
+struct urcu_workqueue *urcu_workqueue_create_nr(unsigned long flags,
+		int cpu_affinity, unsigned int nr_workers, void *priv,
 		void (*grace_period_fct)(struct urcu_workqueue *workqueue, void *priv),
 		void (*initialize_worker_fct)(struct urcu_workqueue *workqueue, void *priv),
 		void (*finalize_worker_fct)(struct urcu_workqueue *workqueue, void *priv),
@@ -277,15 +616,47 @@ struct urcu_workqueue *urcu_workqueue_create(unsigned long flags,
 		void (*worker_after_resume_fct)(struct urcu_workqueue *workqueue, void *priv))
 {
 	struct urcu_workqueue *workqueue;
+	struct urcu_workqueue_worker *worker;
+	unsigned long i;
+	size_t line;
 	int ret;
 
+	if (!nr_workers)
+		nr_workers = 1;
 	workqueue = malloc(sizeof(*workqueue));
 	if (workqueue == NULL)
 		urcu_die(errno);
 	memset(workqueue, '\0', sizeof(*workqueue));
-	cds_wfcq_init(&workqueue->cbs_head, &workqueue->cbs_tail);
+	line = caa_get_cache_line_size();
+	workqueue->worker_stride = (sizeof(*workqueue->workers) + line - 1)
+			& ~(line - 1);
+	workqueue->workers = caa_cache_line_alloc(nr_workers
+			* workqueue->worker_stride);
+	if (workqueue->workers == NULL)
+		urcu_die(errno);
+	memset(workqueue->workers, 0, nr_workers * workqueue->worker_stride);
+	workqueue->nr_workers = nr_workers;
+	ret = pthread_mutex_init(&workqueue->timer_mutex, NULL);
+	if (ret)
+		urcu_die(ret);
+	for (i = 0; i < WORKQUEUE_WHEEL_SIZE; i++)
+		CDS_INIT_LIST_HEAD(&workqueue->wheel[i]);
+	workqueue->wheel_time = workqueue_now_ms();
+	ret = pthread_mutex_init(&workqueue->completion_mutex, NULL);
+	if (ret)
+		urcu_die(ret);
+	CDS_INIT_LIST_HEAD(&workqueue->completion_pool);
+	for (i = 0; i < 2; i++)
+		cds_list_add(&workqueue_completion_alloc(workqueue)->node,
+			&workqueue->completion_pool);
+	for (i = 0; i < nr_workers; i++) {
+		worker = workqueue_worker(workqueue, i);
+		cds_wfcq_prio_init(&worker->cbs);
+		worker->index = i;
+		worker->workqueue = workqueue;
+		worker->spin_attempts = urcu_consumer_spin_init();
+	}
 	workqueue->qlen = 0;
-	workqueue->futex = 0;
 	workqueue->flags = flags;
 	workqueue->priv = priv;
 	workqueue->grace_period_fct = grace_period_fct;
@@ -296,71 +667,179 @@ struct urcu_workqueue *urcu_workqueue_create(unsigned long flags,
 	workqueue->worker_before_pause_fct = worker_before_pause_fct;
 	workqueue->worker_after_resume_fct = worker_after_resume_fct;
 	workqueue->cpu_affinity = cpu_affinity;
-	workqueue->loop_count = 0;
 	cmm_smp_mb();  /* Structure initialized before pointer is planted. */
-	ret = pthread_create(&workqueue->tid, NULL, workqueue_thread, workqueue);
-	if (ret) {
-		urcu_die(ret);
-	}
+	for (i = 0; i < nr_workers; i++)
+		create_worker_thread(workqueue_worker(workqueue, i));
 	return workqueue;
 }
 
-static void wake_worker_thread(struct urcu_workqueue *workqueue)
+struct urcu_workqueue *urcu_workqueue_create(unsigned long flags,
+		int cpu_affinity, void *priv,
+		void (*grace_period_fct)(struct urcu_workqueue *workqueue, void *priv),
+		void (*initialize_worker_fct)(struct urcu_workqueue *workqueue, void *priv),
+		void (*finalize_worker_fct)(struct urcu_workqueue *workqueue, void *priv),
+		void (*worker_before_wait_fct)(struct urcu_workqueue *workqueue, void *priv),
+		void (*worker_after_wake_up_fct)(struct urcu_workqueue *workqueue, void *priv),
+		void (*worker_before_pause_fct)(struct urcu_workqueue *workqueue, void *priv),
+		void (*worker_after_resume_fct)(struct urcu_workqueue *workqueue, void *priv))
 {
-	if (!(_CMM_LOAD_SHARED(workqueue->flags) & URCU_WORKQUEUE_RT))
-		futex_wake_up(&workqueue->futex);
+	return urcu_workqueue_create_nr(flags, cpu_affinity, 1, priv,
+		grace_period_fct, initialize_worker_fct, finalize_worker_fct,
+		worker_before_wait_fct, worker_after_wake_up_fct,
+		worker_before_pause_fct, worker_after_resume_fct);
 }
 
 static int urcu_workqueue_destroy_worker(struct urcu_workqueue *workqueue)
 {
+	unsigned int i;
 	int ret;
 	void *retval;
 
 	uatomic_or(&workqueue->flags, URCU_WORKQUEUE_STOP);
-	wake_worker_thread(workqueue);
+	for (i = 0; i < workqueue->nr_workers; i++)
+		wake_worker_thread(workqueue_worker(workqueue, i));
 
-	ret = pthread_join(workqueue->tid, &retval);
-	if (ret) {
-		urcu_die(ret);
-	}
-	if (retval != NULL) {
-		urcu_die(EINVAL);
+	for (i = 0; i < workqueue->nr_workers; i++) {
+		ret = pthread_join(workqueue_worker(workqueue, i)->tid, &retval);
+		if (ret) {
+			urcu_die(ret);
+		}
+		if (retval != NULL) {
+			urcu_die(EINVAL);
+		}
+		workqueue_worker(workqueue, i)->tid = 0;
 	}
 	workqueue->flags &= ~URCU_WORKQUEUE_STOP;
-	workqueue->tid = 0;
 	return 0;
 }
 
 void urcu_workqueue_destroy(struct urcu_workqueue *workqueue)
 {
+	struct urcu_workqueue_completion *completion, *tmp;
+	struct urcu_workqueue_worker *worker;
+	unsigned int i;
+
 	if (workqueue == NULL) {
 		return;
 	}
 	if (urcu_workqueue_destroy_worker(workqueue)) {
 		urcu_die(errno);
 	}
-	assert(cds_wfcq_empty(&workqueue->cbs_head, &workqueue->cbs_tail));
+	for (i = 0; i < workqueue->nr_workers; i++) {
+		worker = workqueue_worker(workqueue, i);
+		assert(cds_wfcq_prio_empty(&worker->cbs));
+		cds_wfcq_prio_destroy(&worker->cbs);
+	}
+	assert(!workqueue->nr_delayed);
+	(void) pthread_mutex_destroy(&workqueue->timer_mutex);
+	cds_list_for_each_entry_safe(completion, tmp,
+			&workqueue->completion_pool, node)
+		free(completion);
+	(void) pthread_mutex_destroy(&workqueue->completion_mutex);
+	free(workqueue->workers);
 	free(workqueue);
 }
 
-void urcu_workqueue_queue_work(struct urcu_workqueue *workqueue,
-		      struct urcu_work *work,
-		      void (*func)(struct urcu_work *work))
+static void workqueue_enqueue(struct urcu_workqueue_worker *worker,
+		struct urcu_work *work,
+		void (*func)(struct urcu_work *work), unsigned int prio)
 {
 	cds_wfcq_node_init(&work->next);
 	work->func = func;
-	cds_wfcq_enqueue(&workqueue->cbs_head, &workqueue->cbs_tail, &work->next);
-	uatomic_inc(&workqueue->qlen);
-	wake_worker_thread(workqueue);
+	cds_wfcq_prio_enqueue(&worker->cbs, &work->next, prio);
+	uatomic_inc(&worker->workqueue->qlen);
+	wake_worker_thread(worker);
+}
+
+static void workqueue_queue(struct urcu_workqueue *workqueue,
+		struct urcu_work *work, void (*func)(struct urcu_work *work),
+		unsigned int prio)
+{
+	unsigned long i = 0;
+
+	if (workqueue->nr_workers > 1)
+		i = uatomic_add_return(&workqueue->next_worker, 1)
+			% workqueue->nr_workers;
+	workqueue_enqueue(workqueue_worker(workqueue, i), work, func, prio);
+}
+
+void urcu_workqueue_queue_work(struct urcu_workqueue *workqueue,
+			      struct urcu_work *work,
+			      void (*func)(struct urcu_work *work))
+{
+	workqueue_queue(workqueue, work, func, URCU_WORK_PRIO_NORMAL);
+}
+
+void urcu_workqueue_queue_work_prio(struct urcu_workqueue *workqueue,
+		struct urcu_work *work,
+		void (*func)(struct urcu_work *work), unsigned int prio)
+{
+	workqueue_queue(workqueue, work, func, prio);
+}
+
+int urcu_workqueue_queue_delayed_work(struct urcu_workqueue *workqueue,
+		struct urcu_work *work,
+		void (*func)(struct urcu_work *work),
+		unsigned int delay_ms, unsigned int flags)
+{
+	if (flags & URCU_WORK_COALESCE) {
+		if (uatomic_cmpxchg(&work->pending, 0, 1))
+			return -EBUSY;
+	} else {
+		work->pending = 0;
+	}
+	if (!delay_ms) {
+		workqueue_queue(workqueue, work, func, URCU_WORK_PRIO_NORMAL);
+		return 0;
+	}
+	work->func = func;
+	mutex_lock(&workqueue->timer_mutex);
+	work->expires = workqueue_now_ms() + delay_ms;
+	cds_list_add_tail(&work->timer_node,
+		&workqueue->wheel[work->expires & WORKQUEUE_WHEEL_MASK]);
+	workqueue->nr_delayed++;
+	mutex_unlock(&workqueue->timer_mutex);
+	/* Have the first worker wait for the new timer. */
+	wake_worker_thread(workqueue_worker(workqueue, 0));
+	return 0;
+}
+
+/* Runs from call_rcu() context: hands the work over to a worker. */
+static
+void queue_rcu_work_cb(struct rcu_head *head)
+{
+	struct urcu_rcu_work *rwork =
+		caa_container_of(head, struct urcu_rcu_work, head);
+
+	workqueue_queue(rwork->workqueue, &rwork->work, rwork->work.func,
+		URCU_WORK_PRIO_NORMAL);
+}
+
+void urcu_workqueue_queue_rcu_work(struct urcu_workqueue *workqueue,
+		struct urcu_rcu_work *rwork,
+		void (*func)(struct urcu_work *work),
+		const struct rcu_flavor_struct *flavor)
+{
+	rwork->workqueue = workqueue;
+	rwork->work.func = func;
+	flavor->update_call_rcu(&rwork->head, queue_rcu_work_cb);
 }
 
 static
 void free_completion(struct urcu_ref *ref)
 {
 	struct urcu_workqueue_completion *completion;
+	struct urcu_workqueue *workqueue;
 
 	completion = caa_container_of(ref, struct urcu_workqueue_completion, ref);
-	free(completion);
+	workqueue = completion->workqueue;
+	if (!workqueue) {
+		free(completion);
+		return;
+	}
+	mutex_lock(&workqueue->completion_mutex);
+	cds_list_add(&completion->node, &workqueue->completion_pool);
+	mutex_unlock(&workqueue->completion_mutex);
 }
 
 static
@@ -368,13 +847,17 @@ void _urcu_workqueue_wait_complete(struct urcu_work *work)
 {
 	struct urcu_workqueue_completion_work *completion_work;
 	struct urcu_workqueue_completion *completion;
+	int embedded;
 
 	completion_work = caa_container_of(work, struct urcu_workqueue_completion_work, work);
 	completion = completion_work->completion;
+	/* An embedded work item is reused once the completion is released. */
+	embedded = completion_work->embedded;
 	if (!uatomic_sub_return(&completion->barrier_count, 1))
 		futex_wake_up(&completion->futex);
 	urcu_ref_put(&completion->ref, free_completion);
-	free(completion_work);
+	if (!embedded)
+		free(completion_work);
 }
 
 struct urcu_workqueue_completion *urcu_workqueue_create_completion(void)
@@ -389,6 +872,31 @@ struct urcu_workqueue_completion *urcu_workqueue_create_completion(void)
 	return completion;
 }
 
+/*
+ * Take a completion from the pool of workqueue, or allocate one if all
+ * are in use by concurrent flushes. Queued once, on workqueue.
+ */
+static
+struct urcu_workqueue_completion *workqueue_completion_get(
+		struct urcu_workqueue *workqueue)
+{
+	struct urcu_workqueue_completion *completion = NULL;
+
+	mutex_lock(&workqueue->completion_mutex);
+	if (!cds_list_empty(&workqueue->completion_pool)) {
+		completion = cds_list_first_entry(&workqueue->completion_pool,
+				struct urcu_workqueue_completion, node);
+		cds_list_del(&completion->node);
+	}
+	mutex_unlock(&workqueue->completion_mutex);
+	if (!completion)
+		completion = workqueue_completion_alloc(workqueue);
+	urcu_ref_set(&completion->ref, 1);
+	completion->barrier_count = 0;
+	completion->futex = 0;
+	return completion;
+}
+
 void urcu_workqueue_destroy_completion(struct urcu_workqueue_completion *completion)
 {
 	urcu_ref_put(&completion->ref, free_completion);
@@ -403,22 +911,36 @@ void urcu_workqueue_wait_completion(struct urcu_workqueue_completion *completion
 		cmm_smp_mb();
 		if (!uatomic_read(&completion->barrier_count))
 			break;
-		futex_wait(&completion->futex);
+		futex_wait(&completion->futex, -1);
 	}
 }
 
+/*
+ * Queue a completion work item on each worker, completed once the work
+ * queued to that worker before it is done. Queued with the normal
+ * priority, it is only dequeued after the work of higher priorities
+ * queued before it.
+ */
 void urcu_workqueue_queue_completion(struct urcu_workqueue *workqueue,
 		struct urcu_workqueue_completion *completion)
 {
 	struct urcu_workqueue_completion_work *work;
+	unsigned int i;
 
-	work = calloc(sizeof(*work), 1);
-	if (!work)
-		urcu_die(errno);
-	work->completion = completion;
-	urcu_ref_get(&completion->ref);
-	uatomic_inc(&completion->barrier_count);
-	urcu_workqueue_queue_work(workqueue, &work->work, _urcu_workqueue_wait_complete);
+	for (i = 0; i < workqueue->nr_workers; i++) {
+		if (completion->workqueue == workqueue) {
+			work = &completion->works[i];
+		} else {
+			work = calloc(sizeof(*work), 1);
+			if (!work)
+				urcu_die(errno);
+			work->completion = completion;
+		}
+		urcu_ref_get(&completion->ref);
+		uatomic_inc(&completion->barrier_count);
+		workqueue_enqueue(workqueue_worker(workqueue, i), &work->work,
+			_urcu_workqueue_wait_complete, URCU_WORK_PRIO_NORMAL);
+	}
 }
 
 /*
@@ -428,9 +950,8 @@ void urcu_workqueue_flush_queued_work(struct urcu_workqueue *workqueue)
 {
 	struct urcu_workqueue_completion *completion;
 
-	completion = urcu_workqueue_create_completion();
-	if (!completion)
-		urcu_die(ENOMEM);
+	(void) workqueue_run_timers(workqueue, 1);
+	completion = workqueue_completion_get(workqueue);
 	urcu_workqueue_queue_completion(workqueue, completion);
 	urcu_workqueue_wait_completion(completion);
 	urcu_workqueue_destroy_completion(completion);
@@ -439,32 +960,39 @@ void urcu_workqueue_flush_queued_work(struct urcu_workqueue *workqueue)
 /* To be used in before fork handler. */
 void urcu_workqueue_pause_worker(struct urcu_workqueue *workqueue)
 {
+	unsigned int i;
+
 	uatomic_or(&workqueue->flags, URCU_WORKQUEUE_PAUSE);
 	cmm_smp_mb__after_uatomic_or();
-	wake_worker_thread(workqueue);
+	for (i = 0; i < workqueue->nr_workers; i++)
+		wake_worker_thread(workqueue_worker(workqueue, i));
 
-	while ((uatomic_read(&workqueue->flags) & URCU_WORKQUEUE_PAUSED) == 0)
+	while (uatomic_read(&workqueue->nr_paused) != workqueue->nr_workers)
 		(void) poll(NULL, 0, 1);
+	/* Keep the timer wheel and completion pool consistent across fork. */
+	mutex_lock(&workqueue->timer_mutex);
+	mutex_lock(&workqueue->completion_mutex);
 }
 
 /* To be used in after fork parent handler. */
 void urcu_workqueue_resume_worker(struct urcu_workqueue *workqueue)
 {
+	mutex_unlock(&workqueue->completion_mutex);
+	mutex_unlock(&workqueue->timer_mutex);
 	uatomic_and(&workqueue->flags, ~URCU_WORKQUEUE_PAUSE);
-	while ((uatomic_read(&workqueue->flags) & URCU_WORKQUEUE_PAUSED) != 0)
+	while (uatomic_read(&workqueue->nr_paused) != 0)
 		(void) poll(NULL, 0, 1);
 }
 
 void urcu_workqueue_create_worker(struct urcu_workqueue *workqueue)
 {
-	int ret;
+	unsigned int i;
 
 	/* Clear workqueue state from parent. */
-	workqueue->flags &= ~URCU_WORKQUEUE_PAUSED;
+	mutex_unlock(&workqueue->completion_mutex);
+	mutex_unlock(&workqueue->timer_mutex);
 	workqueue->flags &= ~URCU_WORKQUEUE_PAUSE;
-	workqueue->tid = 0;
-	ret = pthread_create(&workqueue->tid, NULL, workqueue_thread, workqueue);
-	if (ret) {
-		urcu_die(ret);
-	}
+	workqueue->nr_paused = 0;
+	for (i = 0; i < workqueue->nr_workers; i++)
+		create_worker_thread(workqueue_worker(workqueue, i));
 }
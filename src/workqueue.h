@@ -28,6 +28,9 @@
 #include <pthread.h>
 
 #include <urcu/wfcqueue.h>
+#include <urcu/wfcqueue-prio.h>
+#include <urcu/list.h>
+#include <urcu/call-rcu.h>
 
 #ifdef __cplusplus
 extern "C" {
@@ -43,7 +46,15 @@ struct urcu_workqueue_completion;
 #define URCU_WORKQUEUE_RT	(1U << 0)
 #define URCU_WORKQUEUE_STOP	(1U << 1)
 #define URCU_WORKQUEUE_PAUSE	(1U << 2)
-#define URCU_WORKQUEUE_PAUSED	(1U << 3)
+
+/* Flag values of urcu_workqueue_queue_delayed_work(). */
+
+#define URCU_WORK_COALESCE	(1U << 0)
+
+/* Priorities of urcu_workqueue_queue_work_prio(). */
+
+#define URCU_WORK_PRIO_NORMAL	CDS_WFCQ_PRIO_NORMAL
+#define URCU_WORK_PRIO_HIGH	CDS_WFCQ_PRIO_HIGH
 
 /*
  * The urcu_work data structure is placed in the structure to be acted
@@ -53,8 +64,25 @@ struct urcu_workqueue_completion;
 struct urcu_work {
 	struct cds_wfcq_node next;
 	void (*func)(struct urcu_work *head);
+	/* Delayed and coalesced work. */
+	struct cds_list_head timer_node;
+	unsigned long expires;
+	int pending;
 };
 
+/*
+ * The urcu_rcu_work data structure is placed in the structure to be
+ * acted upon via urcu_workqueue_queue_rcu_work().
+ */
+
+struct urcu_rcu_work {
+	struct urcu_work work;
+	struct rcu_head head;
+	struct urcu_workqueue *workqueue;
+};
+
+struct rcu_flavor_struct;
+
 /*
  * Exported functions
  */
@@ -68,6 +96,22 @@ struct urcu_workqueue *urcu_workqueue_create(unsigned long flags,
 		void (*worker_after_wake_up_fct)(struct urcu_workqueue *workqueue, void *priv),
 		void (*worker_before_pause_fct)(struct urcu_workqueue *workqueue, void *priv),
 		void (*worker_after_resume_fct)(struct urcu_workqueue *workqueue, void *priv));
+
+/*
+ * Create a workqueue served by nr_workers threads. Work is queued to the
+ * workers in turn, and idle workers steal the work queued to busy ones,
+ * so independent work items run in parallel. The grace period function
+ * is called before each work item.
+ */
+struct urcu_workqueue *urcu_workqueue_create_nr(unsigned long flags,
+		int cpu_affinity, unsigned int nr_workers, void *priv,
+		void (*grace_period_fct)(struct urcu_workqueue *workqueue, void *priv),
+		void (*initialize_worker_fct)(struct urcu_workqueue *workqueue, void *priv),
+		void (*finalize_worker_fct)(struct urcu_workqueue *workqueue, void *priv),
+		void (*worker_before_wait_fct)(struct urcu_workqueue *workqueue, void *priv),
+		void (*worker_after_wake_up_fct)(struct urcu_workqueue *workqueue, void *priv),
+		void (*worker_before_pause_fct)(struct urcu_workqueue *workqueue, void *priv),
+		void (*worker_after_resume_fct)(struct urcu_workqueue *workqueue, void *priv));
 void urcu_workqueue_destroy(struct urcu_workqueue *workqueue);
 
 /*
@@ -78,6 +122,53 @@ void urcu_workqueue_queue_work(struct urcu_workqueue *workqueue,
 		struct urcu_work *work,
 		void (*func)(struct urcu_work *work));
 
+/*
+ * Queue work with a priority, from URCU_WORK_PRIO_NORMAL, the priority
+ * of urcu_workqueue_queue_work(), to URCU_WORK_PRIO_HIGH. Each worker
+ * runs the work queued to it with the highest priority first, FIFO
+ * within a priority. Completions and flushes still wait for all work
+ * queued before them, whatever its priority.
+ */
+void urcu_workqueue_queue_work_prio(struct urcu_workqueue *workqueue,
+		struct urcu_work *work,
+		void (*func)(struct urcu_work *work), unsigned int prio);
+
+/*
+ * Queue work to run once delay_ms milliseconds have elapsed, or right
+ * away if delay_ms is 0. The delay is measured in ticks of the timer
+ * wheel of the first worker, which must be done with its current work
+ * item to queue the work when due.
+ *
+ * With URCU_WORK_COALESCE, work already pending, i.e. queued with
+ * URCU_WORK_COALESCE and not started yet, is not queued again: the
+ * pending instance keeps its delay. Work may be queued again from its
+ * own function.
+ *
+ * Returns 0 if work is queued, -EBUSY if coalesced. Flushing the
+ * workqueue runs delayed work without waiting for its delay, and
+ * delayed work must be flushed before destroying the workqueue.
+ */
+int urcu_workqueue_queue_delayed_work(struct urcu_workqueue *workqueue,
+		struct urcu_work *work,
+		void (*func)(struct urcu_work *work),
+		unsigned int delay_ms, unsigned int flags);
+
+/*
+ * Queue work to run on a worker after a grace period of flavor. Unlike
+ * a call_rcu() callback, the work function may block, take locks or do
+ * I/O without delaying other callbacks. The grace period is waited for
+ * by call_rcu(), and thus shared with all the callbacks and rcu work
+ * queued meanwhile: its callback only queues the work, which never
+ * blocks. The work function gets &rwork->work.
+ *
+ * Pending rcu work is waited for by the flavor rcu_barrier(), then
+ * urcu_workqueue_flush_queued_work().
+ */
+void urcu_workqueue_queue_rcu_work(struct urcu_workqueue *workqueue,
+		struct urcu_rcu_work *rwork,
+		void (*func)(struct urcu_work *work),
+		const struct rcu_flavor_struct *flavor);
+
 struct urcu_workqueue_completion *urcu_workqueue_create_completion(void);
 void urcu_workqueue_destroy_completion(struct urcu_workqueue_completion *completion);
 
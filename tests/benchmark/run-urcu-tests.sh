@@ -27,10 +27,10 @@ if [[ ${NUM_CPUS} -lt 4 ]]; then
 fi
 
 # batch: 19 * 1 = 19
-# fraction: 15 * 29 =
-# scalabilit NUM_CPUS * 15
-# reader 15 * 23 =
-NUM_TESTS=$(( 19 + 435 + ( NUM_CPUS * 15 ) + 345 ))
+# fraction: 16 * 29 =
+# scalabilit NUM_CPUS * 16
+# reader 16 * 23 =
+NUM_TESTS=$(( 19 + 464 + ( NUM_CPUS * 16 ) + 368 ))
 
 plan_tests	${NUM_TESTS}
 
@@ -79,7 +79,7 @@ done
 
 TEST_ARRAY="test_urcu_gc test_urcu_signal_gc test_urcu_mb_gc test_urcu_qsbr_gc
             test_urcu_lgc test_urcu_signal_lgc test_urcu_mb_lgc test_urcu_qsbr_lgc
-            test_urcu test_urcu_signal test_urcu_mb test_urcu_qsbr
+            test_urcu test_urcu_signal test_urcu_mb test_urcu_qsbr test_urcu_percpu
             test_rwlock test_perthreadlock test_mutex"
 
 #setting gc each 32768. ** UPDATE FOR YOUR ARCHITECTURE BASED ON TEST ABOVE **
@@ -0,0 +1,56 @@
+#!/bin/bash
+#
+# Run a benchmark program several times, after warmup runs, appending its
+# JSON or CSV report for each measured run to an output file.
+#
+# usage: runbench.sh [-n runs] [-w warmup_runs] [-f json|csv] [-o file] \
+#		program [program arguments]
+#
+
+RUNS=5
+WARMUP=1
+FORMAT=json
+OUTPUT=/dev/stdout
+
+usage() {
+	echo "usage: $0 [-n runs] [-w warmup_runs] [-f json|csv] [-o file] program [args]"
+	exit 1
+}
+
+while getopts "n:w:f:o:" opt; do
+	case "$opt" in
+	n) RUNS=$OPTARG ;;
+	w) WARMUP=$OPTARG ;;
+	f) FORMAT=$OPTARG ;;
+	o) OUTPUT=$OPTARG ;;
+	*) usage ;;
+	esac
+done
+shift $((OPTIND - 1))
+
+if [ "$#" -lt 1 ] || { [ "$FORMAT" != "json" ] && [ "$FORMAT" != "csv" ]; }; then
+	usage
+fi
+
+REPORT=$(mktemp)
+trap 'rm -f "$REPORT"' EXIT
+
+i=0
+while [ "$i" -lt "$WARMUP" ]; do
+	"$@" >/dev/null || exit 1
+	i=$((i + 1))
+done
+
+i=0
+while [ "$i" -lt "$RUNS" ]; do
+	"$@" --format="$FORMAT" --output="$REPORT" >/dev/null || exit 1
+	i=$((i + 1))
+done
+
+# Keep a single CSV header line.
+if [ "$FORMAT" = "csv" ]; then
+	awk 'NR == 1 || $0 != header { print } NR == 1 { header = $0 }' \
+		"$REPORT" >>"$OUTPUT"
+else
+	cat "$REPORT" >>"$OUTPUT"
+fi
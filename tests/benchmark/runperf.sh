@@ -0,0 +1,208 @@
+#!/bin/bash
+#
+# Performance regression suite: run a fixed set of benchmarks several
+# times, and compare their throughput, and the p99 latencies they
+# report, with a stored baseline. A metric regresses when the difference
+# of the means is significant (Welch t-test, 95% confidence) and larger
+# than the tolerance. Each metric is a TAP test.
+#
+# usage: runperf.sh [-b baseline] [-s file] [-l benchmarks] [-d duration]
+#		[-n runs] [-w warmup_runs] [-t tolerance_pct]
+#
+# The baseline, perf_baseline.txt or $URCU_PERF_BASELINE by default, has
+# one "benchmark metric runs mean stddev" line per metric. -s writes the
+# results of this run to a file in the same format, to record a new
+# baseline. Metrics missing from the baseline are skipped.
+#
+
+BASELINE=${URCU_PERF_BASELINE:-perf_baseline.txt}
+SAVE=""
+BENCHMARKS="urcu-memb urcu-mb urcu-signal urcu-qsbr urcu-bp urcu-percpu gp-memb gp-qsbr oversub bp-churn call-rcu hash lfq lfq-hazptr wfcq spsc-ring split-counter"
+DURATION=3
+RUNS=5
+WARMUP=1
+TOLERANCE=5
+
+usage() {
+	echo "usage: $0 [-b baseline] [-s file] [-l benchmarks] [-d duration]"
+	echo "		[-n runs] [-w warmup_runs] [-t tolerance_pct]"
+	exit 1
+}
+
+while getopts "b:s:l:d:n:w:t:" opt; do
+	case "$opt" in
+	b) BASELINE=$OPTARG ;;
+	s) SAVE=$OPTARG ;;
+	l) BENCHMARKS=$OPTARG ;;
+	d) DURATION=$OPTARG ;;
+	n) RUNS=$OPTARG ;;
+	w) WARMUP=$OPTARG ;;
+	t) TOLERANCE=$OPTARG ;;
+	*) usage ;;
+	esac
+done
+shift $((OPTIND - 1))
+OPTIND=1
+
+. ../utils/tap.sh
+
+BENCHDIR=$(dirname "$0")
+
+# Program and arguments of a benchmark.
+perf_program() {
+	case "$1" in
+	urcu-memb) echo "test_urcu 1 1 $DURATION" ;;
+	urcu-mb) echo "test_urcu_mb 1 1 $DURATION" ;;
+	urcu-signal) echo "test_urcu_signal 1 1 $DURATION" ;;
+	urcu-qsbr) echo "test_urcu_qsbr 1 1 $DURATION" ;;
+	urcu-bp) echo "test_urcu_bp 1 1 $DURATION" ;;
+	urcu-percpu) echo "test_urcu_percpu 1 1 $DURATION" ;;
+	gp-memb) echo "test_urcu_gp 1 1 $DURATION" ;;
+	gp-qsbr) echo "test_urcu_gp_qsbr 1 1 $DURATION" ;;
+	oversub) echo "test_urcu_oversub 0 1 $DURATION -o 2 -h 1 -Q 1" ;;
+	bp-churn) echo "test_urcu_bp_churn 1 1 $DURATION -l 1" ;;
+	call-rcu) echo "test_urcu_call_rcu 1 $DURATION" ;;
+	hash) echo "test_urcu_hash 1 1 $DURATION" ;;
+	lfq) echo "test_urcu_lfq 1 1 $DURATION" ;;
+	lfq-hazptr) echo "test_urcu_lfq 1 1 $DURATION -H" ;;
+	wfcq) echo "test_urcu_wfcq 1 1 $DURATION" ;;
+	spsc-ring) echo "test_urcu_spsc_ring 1 1 $DURATION" ;;
+	split-counter) echo "test_urcu_split_counter 1 2 $DURATION" ;;
+	*) return 1 ;;
+	esac
+}
+
+# Turn the JSON reports of the runs into "metric runs mean stddev"
+# lines: ops_per_sec, and each *_p99 latency parameter.
+summarize() {
+	awk '{
+		if (match($0, /"ops_per_sec":[0-9.]+}$/)) {
+			v = substr($0, RSTART, RLENGTH - 1)
+			sub(/.*:/, "", v)
+			add("ops_per_sec", v)
+		}
+		s = $0
+		while (match(s, /"[a-z0-9_]+_p99":[0-9.]+/)) {
+			m = substr(s, RSTART + 1, RLENGTH - 1)
+			s = substr(s, RSTART + RLENGTH)
+			v = m
+			sub(/.*:/, "", v)
+			sub(/":.*/, "", m)
+			add(m, v)
+		}
+	}
+	function add(m, v) {
+		if (!(m in n))
+			order[nr++] = m
+		n[m]++
+		sum[m] += v
+		sq[m] += v * v
+	}
+	END {
+		for (i = 0; i < nr; i++) {
+			m = order[i]
+			mean = sum[m] / n[m]
+			var = n[m] > 1 ? (sq[m] - n[m] * mean * mean) / (n[m] - 1) : 0
+			printf "%s %d %.6g %.6g\n", m, n[m], mean,
+				(var > 0 ? sqrt(var) : 0)
+		}
+	}' "$1"
+}
+
+# Compare "benchmark metric runs mean stddev" lines with the baseline.
+# Outputs "status benchmark metric mean base_mean change_pct", status
+# being ok, regress, improve or missing.
+compare() {
+	awk -v tol="$TOLERANCE" '
+	BEGIN {
+		split("12.706 4.303 3.182 2.776 2.571 2.447 2.365 2.306 2.262 " \
+			"2.228 2.201 2.179 2.160 2.145 2.131 2.120 2.110 2.101 " \
+			"2.093 2.086 2.080 2.074 2.069 2.064 2.060 2.056 2.052 " \
+			"2.048 2.045 2.042", t95, " ")
+	}
+	FILENAME == ARGV[1] {
+		key = $1 " " $2
+		bn[key] = $3; bmean[key] = $4; bsd[key] = $5
+		next
+	}
+	{
+		key = $1 " " $2
+		if (!(key in bn)) {
+			print "missing", $1, $2, $4, 0, 0
+			next
+		}
+		n = $3; mean = $4; sd = $5
+		change = bmean[key] ? (mean - bmean[key]) * 100 / bmean[key] : 0
+		# Throughput is better higher, latencies lower.
+		worse = ($2 == "ops_per_sec") ? -change : change
+		significant = 1
+		a = n > 1 ? sd * sd / n : 0
+		b = bn[key] > 1 ? bsd[key] * bsd[key] / bn[key] : 0
+		if (n > 1 && bn[key] > 1 && a + b > 0) {
+			df = (a + b) * (a + b)
+			df /= (a > 0 ? a * a / (n - 1) : 0) \
+				+ (b > 0 ? b * b / (bn[key] - 1) : 0)
+			df = int(df)
+			t = df < 1 ? t95[1] : (df <= 30 ? t95[df] : 1.96)
+			diff = mean - bmean[key]
+			if (diff < 0)
+				diff = -diff
+			significant = diff > t * sqrt(a + b)
+		}
+		if (significant && worse > tol)
+			status = "regress"
+		else if (significant && -worse > tol)
+			status = "improve"
+		else
+			status = "ok"
+		printf "%s %s %s %.6g %.6g %.1f\n", status, $1, $2, mean,
+			bmean[key], change
+	}' "$BASELINE" "$1"
+}
+
+REPORT=$(mktemp)
+RESULTS=$(mktemp)
+trap 'rm -f "$REPORT" "$RESULTS"; _exit' EXIT
+
+plan_no_plan
+
+if [ ! -r "$BASELINE" ]; then
+	diag "No baseline $BASELINE: metrics are skipped"
+	BASELINE=/dev/null
+fi
+
+for bench in $BENCHMARKS; do
+	if ! prog=$(perf_program "$bench"); then
+		fail "$bench: unknown benchmark"
+		continue
+	fi
+	: >"$REPORT"
+	if ! "$BENCHDIR/runbench.sh" -n "$RUNS" -w "$WARMUP" -f json \
+			-o "$REPORT" $BENCHDIR/$prog; then
+		fail "$bench: benchmark run"
+		continue
+	fi
+	summarize "$REPORT" | sed "s/^/$bench /" >>"$RESULTS"
+done
+
+while read -r status bench metric mean base change; do
+	case "$status" in
+	missing)
+		skip 0 "$bench $metric: $mean, not in baseline"
+		;;
+	regress)
+		fail "$bench $metric: $mean, baseline $base ($change%)"
+		diag "Regression of $bench $metric beyond $TOLERANCE%"
+		;;
+	*)
+		pass "$bench $metric: $mean, baseline $base ($change%)"
+		[ "$status" = "improve" ] &&
+			diag "Improvement of $bench $metric beyond $TOLERANCE%"
+		;;
+	esac
+done < <(compare "$RESULTS")
+
+if [ -n "$SAVE" ]; then
+	cp "$RESULTS" "$SAVE"
+	diag "Baseline written to $SAVE"
+fi
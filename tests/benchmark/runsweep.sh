@@ -0,0 +1,202 @@
+#!/bin/bash
+#
+# Scalability sweep: run the benchmarks over a matrix of reader counts,
+# writer counts and CPU sets, and write the mean throughput of each
+# configuration to a scaling table, with its speedup over the smallest
+# reader count of the same benchmark, CPU set and writer count.
+#
+# usage: runsweep.sh [-b benchmarks] [-t topologies] [-r readers]
+#		[-W writers] [-d duration] [-n runs] [-w warmup_runs]
+#		[-o directory] [-- extra program arguments]
+#
+# Benchmarks: urcu-memb, urcu-mb, urcu-signal, urcu-qsbr and urcu-bp for
+# test_urcu and its flavors, hash (test_urcu_hash, QSBR flavor), lfq
+# (test_urcu_lfq, memb flavor) and wfcq (test_urcu_wfcq, no RCU), and
+# gp-memb, gp-mb, gp-signal, gp-qsbr and gp-bp for test_urcu_gp, whose
+# writers are synchronize_rcu() callers.
+#
+# Topologies: all (every online CPU), nosmt (one hardware thread per
+# core) and socket (the CPUs of the first socket). Threads are pinned
+# round-robin on the CPUs of the set, readers first.
+#
+# Reader counts default to 1, 2, 4... up to the number of CPUs of each
+# set. The directory receives raw.json, with the report of each run, and
+# scaling.csv.
+#
+
+BENCHMARKS="urcu-memb urcu-mb urcu-signal urcu-qsbr urcu-bp hash lfq wfcq"
+TOPOLOGIES="all nosmt socket"
+READERS=""
+WRITERS="1"
+DURATION=5
+RUNS=3
+WARMUP=1
+OUTDIR=sweep-$(date +%Y%m%d-%H%M%S)
+
+usage() {
+	echo "usage: $0 [-b benchmarks] [-t topologies] [-r readers] [-W writers]"
+	echo "		[-d duration] [-n runs] [-w warmup_runs] [-o directory]"
+	echo "		[-- extra program arguments]"
+	exit 1
+}
+
+while getopts "b:t:r:W:d:n:w:o:" opt; do
+	case "$opt" in
+	b) BENCHMARKS=$OPTARG ;;
+	t) TOPOLOGIES=$OPTARG ;;
+	r) READERS=$OPTARG ;;
+	W) WRITERS=$OPTARG ;;
+	d) DURATION=$OPTARG ;;
+	n) RUNS=$OPTARG ;;
+	w) WARMUP=$OPTARG ;;
+	o) OUTDIR=$OPTARG ;;
+	*) usage ;;
+	esac
+done
+shift $((OPTIND - 1))
+
+BENCHDIR=$(dirname "$0")
+
+# Program of a benchmark, and its flavor.
+bench_program() {
+	case "$1" in
+	urcu-memb) echo "test_urcu memb" ;;
+	urcu-mb) echo "test_urcu_mb mb" ;;
+	urcu-signal) echo "test_urcu_signal signal" ;;
+	urcu-qsbr) echo "test_urcu_qsbr qsbr" ;;
+	urcu-bp) echo "test_urcu_bp bp" ;;
+	hash) echo "test_urcu_hash qsbr" ;;
+	lfq) echo "test_urcu_lfq memb" ;;
+	wfcq) echo "test_urcu_wfcq none" ;;
+	gp-memb) echo "test_urcu_gp memb" ;;
+	gp-mb|gp-signal|gp-qsbr|gp-bp) echo "test_urcu_gp_${1#gp-} ${1#gp-}" ;;
+	*) return 1 ;;
+	esac
+}
+
+# Expand a CPU list such as "0-3,8,10-11".
+expand_cpus() {
+	local range
+
+	for range in ${1//,/ }; do
+		if [ "${range%-*}" != "$range" ]; then
+			seq "${range%-*}" "${range#*-}"
+		else
+			echo "$range"
+		fi
+	done
+}
+
+# CPUs of a topology, one per line.
+topology_cpus() {
+	local sysfs=/sys/devices/system/cpu cpu first_socket
+
+	if [ ! -r "$sysfs/online" ]; then
+		seq 0 $(($(getconf _NPROCESSORS_ONLN) - 1))
+		return
+	fi
+	for cpu in $(expand_cpus "$(cat "$sysfs/online")"); do
+		case "$1" in
+		all)
+			echo "$cpu"
+			;;
+		nosmt)
+			# Keep the first hardware thread of each core.
+			if [ ! -r "$sysfs/cpu$cpu/topology/thread_siblings_list" ] ||
+				[ "$(expand_cpus "$(cat "$sysfs/cpu$cpu/topology/thread_siblings_list")" | head -n 1)" = "$cpu" ]; then
+				echo "$cpu"
+			fi
+			;;
+		socket)
+			if [ -z "$first_socket" ]; then
+				first_socket=$(cat "$sysfs/cpu$cpu/topology/physical_package_id" 2>/dev/null || echo 0)
+			fi
+			if [ "$(cat "$sysfs/cpu$cpu/topology/physical_package_id" 2>/dev/null || echo 0)" = "$first_socket" ]; then
+				echo "$cpu"
+			fi
+			;;
+		*)
+			return 1
+			;;
+		esac
+	done
+}
+
+# Reader counts of a set of nr_cpus CPUs: powers of two, then nr_cpus.
+reader_counts() {
+	local n=1
+
+	if [ -n "$READERS" ]; then
+		echo "$READERS"
+		return
+	fi
+	while [ "$n" -lt "$1" ]; do
+		echo "$n"
+		n=$((n * 2))
+	done
+	echo "$1"
+}
+
+# Affinity options pinning nr_threads threads round-robin on the CPUs.
+affinity_args() {
+	local nr_threads=$1 i=0
+
+	shift
+	while [ "$i" -lt "$nr_threads" ]; do
+		eval "echo -a \${$((i % $# + 1))}"
+		i=$((i + 1))
+	done
+}
+
+mkdir -p "$OUTDIR" || exit 1
+RAW="$OUTDIR/raw.json"
+SCALING="$OUTDIR/scaling.csv"
+REPORT=$(mktemp)
+trap 'rm -f "$REPORT"' EXIT
+
+echo "benchmark,program,flavor,topology,nr_cpus,nr_readers,nr_writers,runs,ops_per_sec_mean,ops_per_sec_min,ops_per_sec_max,speedup" >"$SCALING"
+
+for bench in $BENCHMARKS; do
+	if ! prog=$(bench_program "$bench"); then
+		echo "Unknown benchmark $bench" >&2
+		exit 1
+	fi
+	program=${prog% *}
+	flavor=${prog#* }
+	for topo in $TOPOLOGIES; do
+		cpus=$(topology_cpus "$topo" | tr '\n' ' ')
+		if [ -z "$cpus" ]; then
+			echo "Unknown or empty topology $topo" >&2
+			exit 1
+		fi
+		nr_cpus=$(echo $cpus | wc -w)
+		for writers in $WRITERS; do
+			base=""
+			for readers in $(reader_counts "$nr_cpus"); do
+				: >"$REPORT"
+				"$BENCHDIR/runbench.sh" -n "$RUNS" -w "$WARMUP" -f json \
+					-o "$REPORT" "$BENCHDIR/$program" \
+					"$readers" "$writers" "$DURATION" \
+					$(affinity_args $((readers + writers)) $cpus) \
+					"$@" || exit 1
+				cat "$REPORT" >>"$RAW"
+				read -r runs mean min max <<EOF
+$(sed -n 's/.*"ops_per_sec":\([0-9.]*\)}$/\1/p' "$REPORT" |
+					awk 'NR == 1 || $1 < min { min = $1 }
+						NR == 1 || $1 > max { max = $1 }
+						{ sum += $1 }
+						END { if (NR) printf "%d %.1f %.1f %.1f", NR, sum / NR, min, max }')
+EOF
+				if [ -z "$runs" ]; then
+					echo "No report from $program" >&2
+					exit 1
+				fi
+				[ -z "$base" ] && base=$mean
+				speedup=$(awk -v m="$mean" -v b="$base" 'BEGIN { printf "%.2f", (b > 0 ? m / b : 0) }')
+				echo "$bench,$program,$flavor,$topo,$nr_cpus,$readers,$writers,$runs,$mean,$min,$max,$speedup" >>"$SCALING"
+				printf "%-12s %-7s readers %4d writers %4d: %14.1f ops/s speedup %6.2f\n" \
+					"$bench" "$topo" "$readers" "$writers" "$mean" "$speedup"
+			done
+		done
+	done
+done
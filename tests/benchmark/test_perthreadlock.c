@@ -34,6 +34,7 @@
 #include <urcu/arch.h>
 #include <urcu/tls-compat.h>
 #include "cpuset.h"
+#include "bench.h"
 #include "thread-id.h"
 
 /* hardcoded number of CPUs */
@@ -91,7 +92,6 @@ pthread_mutex_t affinity_mutex = PTHREAD_MUTEX_INITIALIZER;
 static void set_affinity(void)
 {
 #if HAVE_SCHED_SETAFFINITY
-	cpu_set_t mask;
 	int cpu, ret;
 #endif /* HAVE_SCHED_SETAFFINITY */
 
@@ -112,13 +112,7 @@ static void set_affinity(void)
 		perror("Error in pthread mutex unlock");
 		abort();
 	}
-	CPU_ZERO(&mask);
-	CPU_SET(cpu, &mask);
-#if SCHED_SETAFFINITY_ARGS == 2
-	sched_setaffinity(0, &mask);
-#else
-	sched_setaffinity(0, sizeof(mask), &mask);
-#endif
+	bench_pin_cpu(cpu);
 #endif /* HAVE_SCHED_SETAFFINITY */
 }
 
@@ -253,6 +247,7 @@ void show_usage(int argc, char **argv)
 	printf("	[-e duration] (writer C.S. duration (in loops))\n");
 	printf("	[-v] (verbose output)\n");
 	printf("	[-a cpu#] [-a cpu#]... (affinity)\n");
+	printf("	[--format=json|csv] [--output=file] (report format)\n");
 	printf("\n");
 }
 
@@ -261,6 +256,7 @@ int main(int argc, char **argv)
 	int err;
 	pthread_t *tid_reader, *tid_writer;
 	void *tret;
+	struct bench_report *report;
 	unsigned long long tot_reads = 0, tot_writes = 0;
 	int i, a;
 	unsigned int i_thr;
@@ -346,6 +342,7 @@ int main(int argc, char **argv)
 		pthread_mutex_init(&per_thread_lock[i_thr].lock, NULL);
 	}
 
+	report = bench_report_create(argc, argv);
 	next_aff = 0;
 
 	for (i_thr = 0; i_thr < nr_readers; i_thr++) {
@@ -363,10 +360,12 @@ int main(int argc, char **argv)
 
 	cmm_smp_mb();
 
+	bench_report_start(report);
 	test_go = 1;
 
 	sleep(duration);
 
+	bench_report_stop(report);
 	test_stop = 1;
 
 	for (i_thr = 0; i_thr < nr_readers; i_thr++) {
@@ -374,12 +373,14 @@ int main(int argc, char **argv)
 		if (err != 0)
 			exit(1);
 		tot_reads += tot_nr_reads[i_thr];
+		bench_report_thread(report, "reader", tot_nr_reads[i_thr]);
 	}
 	for (i_thr = 0; i_thr < nr_writers; i_thr++) {
 		err = pthread_join(tid_writer[i_thr], &tret);
 		if (err != 0)
 			exit(1);
 		tot_writes += tot_nr_writes[i_thr];
+		bench_report_thread(report, "writer", tot_nr_writes[i_thr]);
 	}
 
 	printf_verbose("total number of reads : %llu, writes %llu\n", tot_reads,
@@ -390,6 +391,15 @@ int main(int argc, char **argv)
 		argv[0], duration, nr_readers, rduration, wduration,
 		nr_writers, wdelay, tot_reads, tot_writes,
 		tot_reads + tot_writes);
+	bench_report_param(report, "duration", duration);
+	bench_report_param(report, "nr_readers", nr_readers);
+	bench_report_param(report, "rduration", rduration);
+	bench_report_param(report, "wduration", wduration);
+	bench_report_param(report, "nr_writers", nr_writers);
+	bench_report_param(report, "wdelay", wdelay);
+	bench_report_param(report, "nr_reads", tot_reads);
+	bench_report_param(report, "nr_writes", tot_writes);
+	bench_report_destroy(report);
 
 	free(tid_reader);
 	free(tid_writer);
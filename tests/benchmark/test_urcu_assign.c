@@ -34,6 +34,7 @@
 #include <urcu/arch.h>
 #include <urcu/tls-compat.h>
 #include "cpuset.h"
+#include "bench.h"
 #include "thread-id.h"
 #include "../common/debug-yield.h"
 
@@ -86,7 +87,6 @@ pthread_mutex_t affinity_mutex = PTHREAD_MUTEX_INITIALIZER;
 static void set_affinity(void)
 {
 #if HAVE_SCHED_SETAFFINITY
-	cpu_set_t mask;
 	int cpu, ret;
 #endif /* HAVE_SCHED_SETAFFINITY */
 
@@ -106,13 +106,7 @@ static void set_affinity(void)
 		exit(-1);
 	}
 
-	CPU_ZERO(&mask);
-	CPU_SET(cpu, &mask);
-#if SCHED_SETAFFINITY_ARGS == 2
-	sched_setaffinity(0, &mask);
-#else
-	sched_setaffinity(0, sizeof(mask), &mask);
-#endif
+	bench_pin_cpu(cpu);
 #endif /* HAVE_SCHED_SETAFFINITY */
 }
 
@@ -283,6 +277,7 @@ void show_usage(int argc, char **argv)
 	printf("	[-e duration] (writer C.S. duration (in loops))\n");
 	printf("	[-v] (verbose output)\n");
 	printf("	[-a cpu#] [-a cpu#]... (affinity)\n");
+	printf("	[--format=json|csv] [--output=file] (report format)\n");
 	printf("\n");
 }
 
@@ -291,6 +286,7 @@ int main(int argc, char **argv)
 	int err;
 	pthread_t *tid_reader, *tid_writer;
 	void *tret;
+	struct bench_report *report;
 	unsigned long long *count_reader, *count_writer;
 	unsigned long long tot_reads = 0, tot_writes = 0;
 	int i, a;
@@ -379,6 +375,7 @@ int main(int argc, char **argv)
 	count_reader = calloc(nr_readers, sizeof(*count_reader));
 	count_writer = calloc(nr_writers, sizeof(*count_writer));
 
+	report = bench_report_create(argc, argv);
 	next_aff = 0;
 
 	for (i_thr = 0; i_thr < nr_readers; i_thr++) {
@@ -396,10 +393,12 @@ int main(int argc, char **argv)
 
 	cmm_smp_mb();
 
+	bench_report_start(report);
 	test_go = 1;
 
 	sleep(duration);
 
+	bench_report_stop(report);
 	test_stop = 1;
 
 	for (i_thr = 0; i_thr < nr_readers; i_thr++) {
@@ -407,12 +406,14 @@ int main(int argc, char **argv)
 		if (err != 0)
 			exit(1);
 		tot_reads += count_reader[i_thr];
+		bench_report_thread(report, "reader", count_reader[i_thr]);
 	}
 	for (i_thr = 0; i_thr < nr_writers; i_thr++) {
 		err = pthread_join(tid_writer[i_thr], &tret);
 		if (err != 0)
 			exit(1);
 		tot_writes += count_writer[i_thr];
+		bench_report_thread(report, "writer", count_writer[i_thr]);
 	}
 
 	printf_verbose("total number of reads : %llu, writes %llu\n", tot_reads,
@@ -423,6 +424,15 @@ int main(int argc, char **argv)
 		argv[0], duration, nr_readers, rduration, wduration,
 		nr_writers, wdelay, tot_reads, tot_writes,
 		tot_reads + tot_writes);
+	bench_report_param(report, "duration", duration);
+	bench_report_param(report, "nr_readers", nr_readers);
+	bench_report_param(report, "rduration", rduration);
+	bench_report_param(report, "wduration", wduration);
+	bench_report_param(report, "nr_writers", nr_writers);
+	bench_report_param(report, "wdelay", wdelay);
+	bench_report_param(report, "nr_reads", tot_reads);
+	bench_report_param(report, "nr_writes", tot_writes);
+	bench_report_destroy(report);
 
 	test_array_free(test_rcu_pointer);
 	free(test_array);
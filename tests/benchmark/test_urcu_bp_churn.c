@@ -0,0 +1,519 @@
+/*
+ * test_urcu_bp_churn.c
+ *
+ * Userspace RCU library - urcu-bp reader thread churn benchmark
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+/*
+ * Spawner threads create short-lived reader threads back to back, each
+ * running a given number of read-side critical sections before it
+ * exits, and join them. The first read-side critical section of each
+ * reader registers it lazily, growing the registry arena when it is
+ * full, and its exit unregisters it from the thread exit notifier, so
+ * that the thread lifetime measures the registry costs of urcu-bp.
+ * Long-lived readers keep registry slots occupied in between, and
+ * updater threads call synchronize_rcu() back to back, whose latency
+ * is reported for each half of the run, to show how it evolves as the
+ * registry fragments.
+ */
+
+#include <stdio.h>
+#include <pthread.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/types.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#include <assert.h>
+#include <errno.h>
+
+#include <urcu/arch.h>
+#include <urcu/tls-compat.h>
+#include "cpuset.h"
+#include "bench.h"
+#include "thread-id.h"
+
+/* hardcoded number of CPUs */
+#define NR_CPUS 16384
+
+#ifndef DYNAMIC_LINK_TEST
+#define _LGPL_SOURCE
+#endif
+#include <urcu-bp.h>
+
+struct thr_count {
+	unsigned long long ops;
+	unsigned long long reads;
+	struct bench_hist lat[2];	/* Per half of the run, in ns */
+	struct bench_hist first_read;	/* First read of a reader, in ns */
+};
+
+/* Short-lived reader, created by a spawner. */
+struct churn_reader {
+	unsigned long long reads;
+	uint64_t first_read_ns;
+};
+
+static volatile int test_go, test_stop;
+
+static double half_time;
+
+static unsigned long wdelay;
+
+static unsigned long sdelay;
+
+static unsigned long duration;
+
+/* read-side C.S. duration, in loops */
+static unsigned long rduration;
+
+/* read-side C.S. per short-lived reader */
+static unsigned long reads_per_thread = 100;
+
+static inline void loop_sleep(unsigned long loops)
+{
+	while (loops-- != 0)
+		caa_cpu_relax();
+}
+
+static int verbose_mode;
+
+#define printf_verbose(fmt, args...)		\
+	do {					\
+		if (verbose_mode)		\
+			printf(fmt, args);	\
+	} while (0)
+
+static unsigned int cpu_affinities[NR_CPUS];
+static unsigned int next_aff = 0;
+static int use_affinity = 0;
+
+pthread_mutex_t affinity_mutex = PTHREAD_MUTEX_INITIALIZER;
+
+static void set_affinity(void)
+{
+#if HAVE_SCHED_SETAFFINITY
+	int cpu, ret;
+#endif /* HAVE_SCHED_SETAFFINITY */
+
+	if (!use_affinity)
+		return;
+
+#if HAVE_SCHED_SETAFFINITY
+	ret = pthread_mutex_lock(&affinity_mutex);
+	if (ret) {
+		perror("Error in pthread mutex lock");
+		exit(-1);
+	}
+	cpu = cpu_affinities[next_aff++];
+	ret = pthread_mutex_unlock(&affinity_mutex);
+	if (ret) {
+		perror("Error in pthread mutex unlock");
+		exit(-1);
+	}
+
+	bench_pin_cpu(cpu);
+#endif /* HAVE_SCHED_SETAFFINITY */
+}
+
+/*
+ * returns 0 if test should end.
+ */
+static int test_duration_write(void)
+{
+	return !test_stop;
+}
+
+static int test_duration_read(void)
+{
+	return !test_stop;
+}
+
+static DEFINE_URCU_TLS(unsigned long long, nr_syncs);
+static DEFINE_URCU_TLS(unsigned long long, nr_reads);
+static DEFINE_URCU_TLS(unsigned long long, nr_spawns);
+
+static unsigned int nr_spawners;
+static unsigned int nr_updaters;
+static unsigned int nr_readers;
+
+static void *thr_churn_reader(void *_reader)
+{
+	struct churn_reader *reader = _reader;
+	unsigned long i;
+	double start;
+
+	/* Registers the thread. */
+	start = bench_now();
+	rcu_read_lock();
+	rcu_read_unlock();
+	reader->first_read_ns = (uint64_t) ((bench_now() - start) * 1e9);
+
+	for (i = 1; i < reads_per_thread; i++) {
+		rcu_read_lock();
+		if (caa_unlikely(rduration))
+			loop_sleep(rduration);
+		rcu_read_unlock();
+	}
+	reader->reads = reads_per_thread ? reads_per_thread : 1;
+	/* Unregistered by the thread exit notifier. */
+	return NULL;
+}
+
+static void *thr_spawner(void *_count)
+{
+	struct thr_count *count = _count;
+	struct churn_reader reader;
+	pthread_t tid;
+	double start;
+	int err;
+
+	printf_verbose("thread_begin %s, tid %lu\n",
+			"spawner", urcu_get_thread_id());
+
+	set_affinity();
+
+	while (!test_go)
+	{
+	}
+	cmm_smp_mb();
+
+	for (;;) {
+		start = bench_now();
+		err = pthread_create(&tid, NULL, thr_churn_reader, &reader);
+		if (err != 0)
+			exit(1);
+		err = pthread_join(tid, NULL);
+		if (err != 0)
+			exit(1);
+		bench_hist_record(&count->lat[start >= half_time],
+			(uint64_t) ((bench_now() - start) * 1e9));
+		bench_hist_record(&count->first_read, reader.first_read_ns);
+		count->reads += reader.reads;
+		URCU_TLS(nr_spawns)++;
+		if (caa_unlikely(!test_duration_write()))
+			break;
+		if (caa_unlikely(sdelay))
+			loop_sleep(sdelay);
+	}
+
+	count->ops = URCU_TLS(nr_spawns);
+	printf_verbose("thread_end %s, tid %lu\n",
+			"spawner", urcu_get_thread_id());
+	return ((void*)3);
+}
+
+static void *thr_reader(void *_count)
+{
+	struct thr_count *count = _count;
+
+	printf_verbose("thread_begin %s, tid %lu\n",
+			"reader", urcu_get_thread_id());
+
+	set_affinity();
+
+	rcu_register_thread();
+
+	while (!test_go)
+	{
+	}
+	cmm_smp_mb();
+
+	for (;;) {
+		rcu_read_lock();
+		if (caa_unlikely(rduration))
+			loop_sleep(rduration);
+		rcu_read_unlock();
+		URCU_TLS(nr_reads)++;
+		if (caa_unlikely(!test_duration_read()))
+			break;
+	}
+
+	rcu_unregister_thread();
+
+	count->ops = URCU_TLS(nr_reads);
+	printf_verbose("thread_end %s, tid %lu\n",
+			"reader", urcu_get_thread_id());
+	return ((void*)1);
+}
+
+static void *thr_updater(void *_count)
+{
+	struct thr_count *count = _count;
+	double start;
+
+	printf_verbose("thread_begin %s, tid %lu\n",
+			"updater", urcu_get_thread_id());
+
+	set_affinity();
+
+	while (!test_go)
+	{
+	}
+	cmm_smp_mb();
+
+	for (;;) {
+		start = bench_now();
+		synchronize_rcu();
+		bench_hist_record(&count->lat[start >= half_time],
+			(uint64_t) ((bench_now() - start) * 1e9));
+		URCU_TLS(nr_syncs)++;
+		if (caa_unlikely(!test_duration_write()))
+			break;
+		if (caa_unlikely(wdelay))
+			loop_sleep(wdelay);
+	}
+
+	count->ops = URCU_TLS(nr_syncs);
+	printf_verbose("thread_end %s, tid %lu\n",
+			"updater", urcu_get_thread_id());
+	return ((void*)2);
+}
+
+static void show_usage(int argc, char **argv)
+{
+	printf("Usage : %s nr_spawners nr_updaters duration (s) <OPTIONS>\n",
+		argv[0]);
+	printf("OPTIONS:\n");
+	printf("	[-r reads] (read-side C.S. per short-lived reader, default 100)\n");
+	printf("	[-l nr] (long-lived readers)\n");
+	printf("	[-s delay] (spawner period between readers (in loops))\n");
+	printf("	[-d delay] (updater period between grace periods (in loops))\n");
+	printf("	[-c duration] (reader C.S. duration (in loops))\n");
+	printf("	[-v] (verbose output)\n");
+	printf("	[-a cpu#] [-a cpu#]... (affinity)\n");
+	printf("	[--format=json|csv] [--output=file] (report format)\n");
+	printf("\n");
+}
+
+int main(int argc, char **argv)
+{
+	int err;
+	pthread_t *tid_spawner, *tid_updater, *tid_reader;
+	void *tret;
+	struct bench_report *report;
+	struct thr_count *count_spawner, *count_updater, *count_reader;
+	unsigned long long tot_spawns = 0, tot_syncs = 0, tot_reads = 0;
+	struct urcu_stats stats_before, stats_after;
+	unsigned long nr_gps;
+	static struct bench_hist life_lat[2], life_all, first_read_lat, sync_lat[2];
+	int i, a;
+	unsigned int i_thr;
+
+	if (argc < 4) {
+		show_usage(argc, argv);
+		return -1;
+	}
+
+	err = sscanf(argv[1], "%u", &nr_spawners);
+	if (err != 1) {
+		show_usage(argc, argv);
+		return -1;
+	}
+
+	err = sscanf(argv[2], "%u", &nr_updaters);
+	if (err != 1) {
+		show_usage(argc, argv);
+		return -1;
+	}
+
+	err = sscanf(argv[3], "%lu", &duration);
+	if (err != 1) {
+		show_usage(argc, argv);
+		return -1;
+	}
+
+	for (i = 4; i < argc; i++) {
+		if (argv[i][0] != '-')
+			continue;
+		switch (argv[i][1]) {
+		case 'a':
+			if (argc < i + 2) {
+				show_usage(argc, argv);
+				return -1;
+			}
+			a = atoi(argv[++i]);
+			cpu_affinities[next_aff++] = a;
+			use_affinity = 1;
+			printf_verbose("Adding CPU %d affinity\n", a);
+			break;
+		case 'c':
+			if (argc < i + 2) {
+				show_usage(argc, argv);
+				return -1;
+			}
+			rduration = atol(argv[++i]);
+			break;
+		case 'd':
+			if (argc < i + 2) {
+				show_usage(argc, argv);
+				return -1;
+			}
+			wdelay = atol(argv[++i]);
+			break;
+		case 's':
+			if (argc < i + 2) {
+				show_usage(argc, argv);
+				return -1;
+			}
+			sdelay = atol(argv[++i]);
+			break;
+		case 'r':
+			if (argc < i + 2) {
+				show_usage(argc, argv);
+				return -1;
+			}
+			reads_per_thread = atol(argv[++i]);
+			break;
+		case 'l':
+			if (argc < i + 2) {
+				show_usage(argc, argv);
+				return -1;
+			}
+			nr_readers = atoi(argv[++i]);
+			break;
+		case 'v':
+			verbose_mode = 1;
+			break;
+		}
+	}
+
+	printf_verbose("running test for %lu seconds, %u spawners, %u updaters, "
+		"%u long-lived readers.\n",
+		duration, nr_spawners, nr_updaters, nr_readers);
+	printf_verbose("Reads per short-lived reader : %lu.\n",
+		reads_per_thread);
+	printf_verbose("Spawner delay : %lu loops.\n", sdelay);
+	printf_verbose("Updater delay : %lu loops.\n", wdelay);
+	printf_verbose("Reader duration : %lu loops.\n", rduration);
+	printf_verbose("thread %-6s, tid %lu\n",
+			"main", urcu_get_thread_id());
+
+	tid_spawner = calloc(nr_spawners, sizeof(*tid_spawner));
+	tid_updater = calloc(nr_updaters, sizeof(*tid_updater));
+	tid_reader = calloc(nr_readers, sizeof(*tid_reader));
+	count_spawner = calloc(nr_spawners, sizeof(*count_spawner));
+	count_updater = calloc(nr_updaters, sizeof(*count_updater));
+	count_reader = calloc(nr_readers, sizeof(*count_reader));
+
+	report = bench_report_create(argc, argv);
+	next_aff = 0;
+
+	for (i_thr = 0; i_thr < nr_readers; i_thr++) {
+		err = pthread_create(&tid_reader[i_thr], NULL, thr_reader,
+				     &count_reader[i_thr]);
+		if (err != 0)
+			exit(1);
+	}
+	for (i_thr = 0; i_thr < nr_spawners; i_thr++) {
+		err = pthread_create(&tid_spawner[i_thr], NULL, thr_spawner,
+				     &count_spawner[i_thr]);
+		if (err != 0)
+			exit(1);
+	}
+	for (i_thr = 0; i_thr < nr_updaters; i_thr++) {
+		err = pthread_create(&tid_updater[i_thr], NULL, thr_updater,
+				     &count_updater[i_thr]);
+		if (err != 0)
+			exit(1);
+	}
+
+	cmm_smp_mb();
+
+	rcu_get_stats(&stats_before);
+	bench_report_start(report);
+	half_time = bench_now() + duration / 2.0;
+	cmm_smp_mb();
+	test_go = 1;
+
+	sleep(duration);
+
+	bench_report_stop(report);
+	test_stop = 1;
+
+	for (i_thr = 0; i_thr < nr_readers; i_thr++) {
+		err = pthread_join(tid_reader[i_thr], &tret);
+		if (err != 0)
+			exit(1);
+		tot_reads += count_reader[i_thr].ops;
+		bench_report_thread(report, "reader", count_reader[i_thr].ops);
+	}
+	for (i_thr = 0; i_thr < nr_spawners; i_thr++) {
+		err = pthread_join(tid_spawner[i_thr], &tret);
+		if (err != 0)
+			exit(1);
+		tot_spawns += count_spawner[i_thr].ops;
+		tot_reads += count_spawner[i_thr].reads;
+		bench_report_thread(report, "spawner", count_spawner[i_thr].ops);
+		bench_hist_merge(&life_lat[0], &count_spawner[i_thr].lat[0]);
+		bench_hist_merge(&life_lat[1], &count_spawner[i_thr].lat[1]);
+		bench_hist_merge(&first_read_lat,
+			&count_spawner[i_thr].first_read);
+	}
+	for (i_thr = 0; i_thr < nr_updaters; i_thr++) {
+		err = pthread_join(tid_updater[i_thr], &tret);
+		if (err != 0)
+			exit(1);
+		tot_syncs += count_updater[i_thr].ops;
+		bench_report_thread(report, "updater", count_updater[i_thr].ops);
+		bench_hist_merge(&sync_lat[0], &count_updater[i_thr].lat[0]);
+		bench_hist_merge(&sync_lat[1], &count_updater[i_thr].lat[1]);
+	}
+	rcu_get_stats(&stats_after);
+	nr_gps = stats_after.gp_count - stats_before.gp_count;
+
+	printf_verbose("total number of spawns : %llu, reads %llu, "
+		"synchronize_rcu %llu\n", tot_spawns, tot_reads, tot_syncs);
+	printf("SUMMARY %-25s testdur %4lu nr_spawners %3u nr_updaters %3u "
+		"nr_readers %3u reads_per_thread %6lu sdelay %6lu "
+		"wdelay %6lu rdur %6lu nr_spawns %10llu spawns_per_sec %10.1f "
+		"nr_reads %12llu nr_syncs %10llu nr_gps %10lu\n",
+		argv[0], duration, nr_spawners, nr_updaters, nr_readers,
+		reads_per_thread, sdelay, wdelay, rduration, tot_spawns,
+		bench_rate(report, tot_spawns), tot_reads, tot_syncs, nr_gps);
+	bench_hist_print("thread_lifetime_1st_half", &life_lat[0], "ns");
+	bench_hist_print("thread_lifetime_2nd_half", &life_lat[1], "ns");
+	bench_hist_print("first_read", &first_read_lat, "ns");
+	bench_hist_print("synchronize_rcu_1st_half", &sync_lat[0], "ns");
+	bench_hist_print("synchronize_rcu_2nd_half", &sync_lat[1], "ns");
+	bench_report_param(report, "duration", duration);
+	bench_report_param(report, "nr_spawners", nr_spawners);
+	bench_report_param(report, "nr_updaters", nr_updaters);
+	bench_report_param(report, "nr_readers", nr_readers);
+	bench_report_param(report, "reads_per_thread", reads_per_thread);
+	bench_report_param(report, "sdelay", sdelay);
+	bench_report_param(report, "wdelay", wdelay);
+	bench_report_param(report, "rduration", rduration);
+	bench_report_param(report, "nr_spawns", tot_spawns);
+	bench_report_param(report, "nr_reads", tot_reads);
+	bench_report_param(report, "nr_syncs", tot_syncs);
+	bench_report_param(report, "nr_gps", nr_gps);
+	bench_hist_merge(&life_all, &life_lat[0]);
+	bench_hist_merge(&life_all, &life_lat[1]);
+	bench_report_hist(report, "lifetime_ns", &life_all);
+	bench_report_hist(report, "first_read_ns", &first_read_lat);
+	bench_report_hist(report, "sync1_ns", &sync_lat[0]);
+	bench_report_hist(report, "sync2_ns", &sync_lat[1]);
+	bench_report_destroy(report);
+	free(tid_spawner);
+	free(tid_updater);
+	free(tid_reader);
+	free(count_spawner);
+	free(count_updater);
+	free(count_reader);
+	return 0;
+}
@@ -0,0 +1,452 @@
+/*
+ * test_urcu_call_rcu.c
+ *
+ * Userspace RCU library - call_rcu throughput and backlog benchmark
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+/*
+ * Threads flood call_rcu() with freshly allocated objects while the main
+ * thread samples the pending callbacks of all call_rcu_data and the
+ * resident memory of the process. The run reports the enqueue cost, the
+ * sustained reclaim rate, and the worst backlog, then the time taken by
+ * rcu_barrier() to drain what is left.
+ */
+
+#include <stdio.h>
+#include <pthread.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/types.h>
+#include <unistd.h>
+#include <assert.h>
+#include <errno.h>
+#include <poll.h>
+
+#include <urcu/arch.h>
+#include <urcu/tls-compat.h>
+#include "cpuset.h"
+#include "bench.h"
+#include "thread-id.h"
+
+/* hardcoded number of CPUs */
+#define NR_CPUS 16384
+
+#ifndef DYNAMIC_LINK_TEST
+#define _LGPL_SOURCE
+#endif
+#include <urcu.h>
+
+enum crdp_mode {
+	CRDP_DEFAULT,		/* Default call_rcu_data */
+	CRDP_CPU,		/* create_all_cpu_call_rcu_data() */
+	CRDP_CPU_STEAL,		/* Per-CPU, with URCU_CALL_RCU_STEAL */
+	CRDP_THREAD,		/* One call_rcu_data per flooding thread */
+};
+
+struct obj {
+	struct rcu_head head;
+	char data[];
+};
+
+struct thr_count {
+	unsigned long long ops;
+	unsigned long invoked;		/* by the private call_rcu_data */
+	struct bench_hist lat;		/* call_rcu() cost, in cycles */
+};
+
+static volatile int test_go, test_stop;
+
+static unsigned long wdelay;
+
+static unsigned long duration;
+
+static size_t obj_size = 64;
+
+static unsigned long sample_ms = 100;
+
+static enum crdp_mode crdp_mode = CRDP_DEFAULT;
+
+static struct call_rcu_attr thread_attr;
+
+static inline void loop_sleep(unsigned long loops)
+{
+	while (loops-- != 0)
+		caa_cpu_relax();
+}
+
+static int verbose_mode;
+
+#define printf_verbose(fmt, args...)		\
+	do {					\
+		if (verbose_mode)		\
+			printf(fmt, args);	\
+	} while (0)
+
+static unsigned int cpu_affinities[NR_CPUS];
+static unsigned int next_aff = 0;
+static int use_affinity = 0;
+
+pthread_mutex_t affinity_mutex = PTHREAD_MUTEX_INITIALIZER;
+
+static void set_affinity(void)
+{
+#if HAVE_SCHED_SETAFFINITY
+	int cpu, ret;
+#endif /* HAVE_SCHED_SETAFFINITY */
+
+	if (!use_affinity)
+		return;
+
+#if HAVE_SCHED_SETAFFINITY
+	ret = pthread_mutex_lock(&affinity_mutex);
+	if (ret) {
+		perror("Error in pthread mutex lock");
+		exit(-1);
+	}
+	cpu = cpu_affinities[next_aff++];
+	ret = pthread_mutex_unlock(&affinity_mutex);
+	if (ret) {
+		perror("Error in pthread mutex unlock");
+		exit(-1);
+	}
+
+	bench_pin_cpu(cpu);
+#endif /* HAVE_SCHED_SETAFFINITY */
+}
+
+/*
+ * returns 0 if test should end.
+ */
+static int test_duration_write(void)
+{
+	return !test_stop;
+}
+
+static DEFINE_URCU_TLS(unsigned long long, nr_calls);
+
+static unsigned int nr_flooders;
+
+static void free_obj_cb(struct rcu_head *head)
+{
+	free(caa_container_of(head, struct obj, head));
+}
+
+/* Resident memory of the process, in kB, or 0 if unknown. */
+static unsigned long rss_kb(void)
+{
+	unsigned long size, resident = 0;
+	FILE *file;
+
+	file = fopen("/proc/self/statm", "r");
+	if (!file)
+		return 0;
+	if (fscanf(file, "%lu %lu", &size, &resident) != 2)
+		resident = 0;
+	fclose(file);
+	return resident * (sysconf(_SC_PAGESIZE) / 1024);
+}
+
+static void *thr_flooder(void *_count)
+{
+	struct thr_count *count = _count;
+	struct call_rcu_data *crdp = NULL;
+	caa_cycles_t start;
+	struct obj *obj;
+
+	printf_verbose("thread_begin %s, tid %lu\n",
+			"flooder", urcu_get_thread_id());
+
+	set_affinity();
+
+	rcu_register_thread();
+	if (crdp_mode == CRDP_THREAD) {
+		crdp = create_call_rcu_data_attr(0, -1, &thread_attr);
+		if (!crdp) {
+			perror("create_call_rcu_data_attr");
+			exit(-1);
+		}
+		set_thread_call_rcu_data(crdp);
+	}
+
+	while (!test_go)
+	{
+	}
+	cmm_smp_mb();
+
+	for (;;) {
+		obj = malloc(sizeof(*obj) + obj_size);
+		if (!obj) {
+			perror("malloc");
+			exit(-1);
+		}
+		/* Touch the object, so it counts in the resident memory. */
+		memset(obj->data, 0x42, obj_size);
+		start = caa_get_cycles();
+		call_rcu(&obj->head, free_obj_cb);
+		bench_hist_record(&count->lat, caa_get_cycles() - start);
+		URCU_TLS(nr_calls)++;
+		if (caa_unlikely(!test_duration_write()))
+			break;
+		if (caa_unlikely(wdelay))
+			loop_sleep(wdelay);
+	}
+
+	if (crdp) {
+		struct urcu_call_rcu_stats crdp_stats;
+
+		/*
+		 * The statistics of a freed call_rcu_data are lost: keep its
+		 * invoked count. Pending callbacks move to the default
+		 * call_rcu_data.
+		 */
+		set_thread_call_rcu_data(NULL);
+		call_rcu_data_get_stats(crdp, &crdp_stats);
+		count->invoked = crdp_stats.invoked;
+		call_rcu_data_free(crdp);
+	}
+	rcu_unregister_thread();
+
+	count->ops = URCU_TLS(nr_calls);
+	printf_verbose("thread_end %s, tid %lu\n",
+			"flooder", urcu_get_thread_id());
+	return ((void*)1);
+}
+
+static void show_usage(int argc, char **argv)
+{
+	printf("Usage : %s nr_threads duration (s) <OPTIONS>\n",
+		argv[0]);
+	printf("OPTIONS:\n");
+	printf("	[-s size] (object payload size in bytes, default 64)\n");
+	printf("	[-m default|cpu|cpu-steal|thread] (call_rcu_data used by the threads)\n");
+	printf("	[-H qlen] (thread mode: start a grace period at this backlog)\n");
+	printf("	[-i ms] (sampling interval, default 100)\n");
+	printf("	[-d delay] (period between call_rcu (in loops))\n");
+	printf("	[-v] (verbose output, with the samples)\n");
+	printf("	[-a cpu#] [-a cpu#]... (affinity)\n");
+	printf("	[--format=json|csv] [--output=file] (report format)\n");
+	printf("\n");
+}
+
+int main(int argc, char **argv)
+{
+	int err;
+	pthread_t *tid_flooder;
+	void *tret;
+	struct bench_report *report;
+	struct thr_count *count_flooder;
+	unsigned long long tot_calls = 0;
+	struct urcu_stats stats_before, stats, stats_stop;
+	unsigned long qlen_max = 0, rss, rss_max = 0, rss_start, rss_stop;
+	unsigned long nr_samples = 0, invoked, tot_private_invoked = 0;
+	static struct bench_hist enqueue_lat;
+	double stop, barrier_start, barrier_s;
+	int i, a;
+	unsigned int i_thr;
+
+	if (argc < 3) {
+		show_usage(argc, argv);
+		return -1;
+	}
+
+	err = sscanf(argv[1], "%u", &nr_flooders);
+	if (err != 1) {
+		show_usage(argc, argv);
+		return -1;
+	}
+
+	err = sscanf(argv[2], "%lu", &duration);
+	if (err != 1) {
+		show_usage(argc, argv);
+		return -1;
+	}
+
+	for (i = 3; i < argc; i++) {
+		if (argv[i][0] != '-')
+			continue;
+		switch (argv[i][1]) {
+		case 'a':
+			if (argc < i + 2) {
+				show_usage(argc, argv);
+				return -1;
+			}
+			a = atoi(argv[++i]);
+			cpu_affinities[next_aff++] = a;
+			use_affinity = 1;
+			printf_verbose("Adding CPU %d affinity\n", a);
+			break;
+		case 's':
+			if (argc < i + 2) {
+				show_usage(argc, argv);
+				return -1;
+			}
+			obj_size = atol(argv[++i]);
+			break;
+		case 'm':
+			if (argc < i + 2) {
+				show_usage(argc, argv);
+				return -1;
+			}
+			i++;
+			if (!strcmp(argv[i], "default"))
+				crdp_mode = CRDP_DEFAULT;
+			else if (!strcmp(argv[i], "cpu"))
+				crdp_mode = CRDP_CPU;
+			else if (!strcmp(argv[i], "cpu-steal"))
+				crdp_mode = CRDP_CPU_STEAL;
+			else if (!strcmp(argv[i], "thread"))
+				crdp_mode = CRDP_THREAD;
+			else {
+				show_usage(argc, argv);
+				return -1;
+			}
+			break;
+		case 'H':
+			if (argc < i + 2) {
+				show_usage(argc, argv);
+				return -1;
+			}
+			thread_attr.qlen_high_watermark = atol(argv[++i]);
+			break;
+		case 'i':
+			if (argc < i + 2) {
+				show_usage(argc, argv);
+				return -1;
+			}
+			sample_ms = atol(argv[++i]);
+			if (!sample_ms) {
+				show_usage(argc, argv);
+				return -1;
+			}
+			break;
+		case 'd':
+			if (argc < i + 2) {
+				show_usage(argc, argv);
+				return -1;
+			}
+			wdelay = atol(argv[++i]);
+			break;
+		case 'v':
+			verbose_mode = 1;
+			break;
+		}
+	}
+
+	printf_verbose("running test for %lu seconds, %u threads, "
+		"%zu bytes objects.\n", duration, nr_flooders, obj_size);
+	printf_verbose("thread %-6s, tid %lu\n",
+			"main", urcu_get_thread_id());
+
+	if (crdp_mode == CRDP_CPU || crdp_mode == CRDP_CPU_STEAL) {
+		err = create_all_cpu_call_rcu_data(crdp_mode == CRDP_CPU_STEAL ?
+			URCU_CALL_RCU_STEAL : 0);
+		if (err) {
+			printf("Per-CPU call_rcu() worker threads unavailable. Using default global worker thread.\n");
+			crdp_mode = CRDP_DEFAULT;
+		}
+	}
+
+	tid_flooder = calloc(nr_flooders, sizeof(*tid_flooder));
+	count_flooder = calloc(nr_flooders, sizeof(*count_flooder));
+
+	report = bench_report_create(argc, argv);
+	next_aff = 0;
+
+	for (i_thr = 0; i_thr < nr_flooders; i_thr++) {
+		err = pthread_create(&tid_flooder[i_thr], NULL, thr_flooder,
+				     &count_flooder[i_thr]);
+		if (err != 0)
+			exit(1);
+	}
+
+	cmm_smp_mb();
+
+	rcu_get_stats(&stats_before);
+	rss_start = rss_kb();
+	bench_report_start(report);
+	stop = report->start + duration;
+	test_go = 1;
+
+	while (bench_now() < stop) {
+		(void) poll(NULL, 0, sample_ms);
+		rcu_get_stats(&stats);
+		if (stats.call_rcu.qlen > qlen_max)
+			qlen_max = stats.call_rcu.qlen;
+		rss = rss_kb();
+		if (rss > rss_max)
+			rss_max = rss;
+		nr_samples++;
+		printf_verbose("SAMPLE t %8.3f s qlen %10lu rss %10lu kB invoked %12lu\n",
+			bench_now() - report->start, stats.call_rcu.qlen,
+			rss, stats.call_rcu.invoked
+				- stats_before.call_rcu.invoked);
+	}
+
+	bench_report_stop(report);
+	test_stop = 1;
+
+	for (i_thr = 0; i_thr < nr_flooders; i_thr++) {
+		err = pthread_join(tid_flooder[i_thr], &tret);
+		if (err != 0)
+			exit(1);
+		tot_calls += count_flooder[i_thr].ops;
+		tot_private_invoked += count_flooder[i_thr].invoked;
+		bench_report_thread(report, "flooder", count_flooder[i_thr].ops);
+		bench_hist_merge(&enqueue_lat, &count_flooder[i_thr].lat);
+	}
+	rcu_get_stats(&stats_stop);
+	rss_stop = rss_kb();
+	invoked = stats_stop.call_rcu.invoked - stats_before.call_rcu.invoked
+		+ tot_private_invoked;
+
+	barrier_start = bench_now();
+	rcu_barrier();
+	barrier_s = bench_now() - barrier_start;
+
+	printf("SUMMARY %-25s testdur %4lu nr_threads %3u size %6zu "
+		"nr_calls %12llu nr_reclaimed %12lu reclaim_per_sec %12.1f "
+		"qlen_max %10lu qlen_end %10lu rss_start_kb %8lu "
+		"rss_max_kb %8lu rss_end_kb %8lu barrier_ms %8.1f\n",
+		argv[0], duration, nr_flooders, obj_size, tot_calls,
+		invoked, bench_rate(report, invoked), qlen_max,
+		stats_stop.call_rcu.qlen, rss_start, rss_max, rss_stop,
+		barrier_s * 1e3);
+	bench_hist_print("call_rcu", &enqueue_lat, "cycles");
+	bench_report_param(report, "duration", duration);
+	bench_report_param(report, "nr_threads", nr_flooders);
+	bench_report_param(report, "size", obj_size);
+	bench_report_param(report, "crdp_mode", crdp_mode);
+	bench_report_param(report, "nr_calls", tot_calls);
+	bench_report_param(report, "nr_reclaimed", invoked);
+	bench_report_param(report, "batches",
+		stats_stop.call_rcu.batches - stats_before.call_rcu.batches);
+	bench_report_param(report, "qlen_max", qlen_max);
+	bench_report_param(report, "qlen_end", stats_stop.call_rcu.qlen);
+	bench_report_param(report, "rss_start_kb", rss_start);
+	bench_report_param(report, "rss_max_kb", rss_max);
+	bench_report_param(report, "rss_end_kb", rss_stop);
+	bench_report_param(report, "barrier_us", barrier_s * 1e6);
+	bench_report_param(report, "nr_samples", nr_samples);
+	bench_report_hist(report, "call_rcu_cycles", &enqueue_lat);
+	bench_report_destroy(report);
+
+	if (crdp_mode == CRDP_CPU || crdp_mode == CRDP_CPU_STEAL)
+		free_all_cpu_call_rcu_data();
+	free(tid_flooder);
+	free(count_flooder);
+	return 0;
+}
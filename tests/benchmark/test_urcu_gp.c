@@ -0,0 +1,405 @@
+/*
+ * test_urcu_gp.c
+ *
+ * Userspace RCU library - grace-period latency benchmark
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+/*
+ * Updater threads call synchronize_rcu() back to back while reader
+ * threads run read-side critical sections of a given length. The
+ * latency of each synchronize_rcu() call is recorded, and the grace
+ * periods completed by the flavor are compared with the calls: with
+ * several updaters, concurrent callers share grace periods through the
+ * gp_waiters queue, so there are fewer grace periods than calls.
+ */
+
+#include <stdio.h>
+#include <pthread.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/types.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#include <assert.h>
+#include <errno.h>
+
+#include <urcu/arch.h>
+#include <urcu/tls-compat.h>
+#include "cpuset.h"
+#include "bench.h"
+#include "thread-id.h"
+
+/* hardcoded number of CPUs */
+#define NR_CPUS 16384
+
+#ifndef DYNAMIC_LINK_TEST
+#define _LGPL_SOURCE
+#endif
+#if defined(RCU_QSBR)
+#include <urcu-qsbr.h>
+#elif defined(RCU_BP)
+#include <urcu-bp.h>
+#elif defined(RCU_PERCPU)
+#include <urcu-percpu.h>
+#else
+#include <urcu.h>
+#endif
+
+struct thr_count {
+	unsigned long long ops;
+	struct bench_hist lat;		/* synchronize_rcu() latency, in ns */
+};
+
+static volatile int test_go, test_stop;
+
+static unsigned long wdelay;
+
+static unsigned long duration;
+
+/* read-side C.S. duration, in loops */
+static unsigned long rduration;
+
+/* read-side C.S. between quiescent states (QSBR) */
+static unsigned long qs_period = 1024;
+
+static inline void loop_sleep(unsigned long loops)
+{
+	while (loops-- != 0)
+		caa_cpu_relax();
+}
+
+static int verbose_mode;
+
+#define printf_verbose(fmt, args...)		\
+	do {					\
+		if (verbose_mode)		\
+			printf(fmt, args);	\
+	} while (0)
+
+static unsigned int cpu_affinities[NR_CPUS];
+static unsigned int next_aff = 0;
+static int use_affinity = 0;
+
+pthread_mutex_t affinity_mutex = PTHREAD_MUTEX_INITIALIZER;
+
+static void set_affinity(void)
+{
+#if HAVE_SCHED_SETAFFINITY
+	int cpu, ret;
+#endif /* HAVE_SCHED_SETAFFINITY */
+
+	if (!use_affinity)
+		return;
+
+#if HAVE_SCHED_SETAFFINITY
+	ret = pthread_mutex_lock(&affinity_mutex);
+	if (ret) {
+		perror("Error in pthread mutex lock");
+		exit(-1);
+	}
+	cpu = cpu_affinities[next_aff++];
+	ret = pthread_mutex_unlock(&affinity_mutex);
+	if (ret) {
+		perror("Error in pthread mutex unlock");
+		exit(-1);
+	}
+
+	bench_pin_cpu(cpu);
+#endif /* HAVE_SCHED_SETAFFINITY */
+}
+
+/*
+ * returns 0 if test should end.
+ */
+static int test_duration_write(void)
+{
+	return !test_stop;
+}
+
+static int test_duration_read(void)
+{
+	return !test_stop;
+}
+
+static DEFINE_URCU_TLS(unsigned long long, nr_syncs);
+static DEFINE_URCU_TLS(unsigned long long, nr_reads);
+
+static unsigned int nr_readers;
+static unsigned int nr_updaters;
+
+static void *thr_reader(void *_count)
+{
+	struct thr_count *count = _count;
+
+	printf_verbose("thread_begin %s, tid %lu\n",
+			"reader", urcu_get_thread_id());
+
+	set_affinity();
+
+	rcu_register_thread();
+#ifdef RCU_QSBR
+	rcu_thread_offline();
+#endif
+
+	while (!test_go)
+	{
+	}
+	cmm_smp_mb();
+
+#ifdef RCU_QSBR
+	rcu_thread_online();
+#endif
+	for (;;) {
+		rcu_read_lock();
+		if (caa_unlikely(rduration))
+			loop_sleep(rduration);
+		rcu_read_unlock();
+		URCU_TLS(nr_reads)++;
+		if (caa_unlikely(!test_duration_read()))
+			break;
+#ifdef RCU_QSBR
+		if (caa_unlikely(URCU_TLS(nr_reads) % qs_period == 0))
+			rcu_quiescent_state();
+#endif
+	}
+
+	rcu_unregister_thread();
+
+	count->ops = URCU_TLS(nr_reads);
+	printf_verbose("thread_end %s, tid %lu\n",
+			"reader", urcu_get_thread_id());
+	return ((void*)1);
+}
+
+static void *thr_updater(void *_count)
+{
+	struct thr_count *count = _count;
+	double start;
+
+	printf_verbose("thread_begin %s, tid %lu\n",
+			"updater", urcu_get_thread_id());
+
+	set_affinity();
+
+	while (!test_go)
+	{
+	}
+	cmm_smp_mb();
+
+	for (;;) {
+		start = bench_now();
+		synchronize_rcu();
+		bench_hist_record(&count->lat,
+			(uint64_t) ((bench_now() - start) * 1e9));
+		URCU_TLS(nr_syncs)++;
+		if (caa_unlikely(!test_duration_write()))
+			break;
+		if (caa_unlikely(wdelay))
+			loop_sleep(wdelay);
+	}
+
+	count->ops = URCU_TLS(nr_syncs);
+	printf_verbose("thread_end %s, tid %lu\n",
+			"updater", urcu_get_thread_id());
+	return ((void*)2);
+}
+
+static void show_usage(int argc, char **argv)
+{
+	printf("Usage : %s nr_readers nr_updaters duration (s) <OPTIONS>\n",
+		argv[0]);
+	printf("OPTIONS:\n");
+	printf("	[-d delay] (updater period between grace periods (in loops))\n");
+	printf("	[-c duration] (reader C.S. duration (in loops))\n");
+#ifdef RCU_QSBR
+	printf("	[-q period] (reader C.S. between quiescent states, default 1024)\n");
+#endif
+	printf("	[-v] (verbose output)\n");
+	printf("	[-a cpu#] [-a cpu#]... (affinity)\n");
+	printf("	[--format=json|csv] [--output=file] (report format)\n");
+	printf("\n");
+}
+
+int main(int argc, char **argv)
+{
+	int err;
+	pthread_t *tid_reader, *tid_updater;
+	void *tret;
+	struct bench_report *report;
+	struct thr_count *count_reader, *count_updater;
+	unsigned long long tot_reads = 0, tot_syncs = 0;
+	struct urcu_stats stats_before, stats_after;
+	unsigned long nr_gps, nr_futex_waits;
+	static struct bench_hist sync_lat;
+	int i, a;
+	unsigned int i_thr;
+
+	if (argc < 4) {
+		show_usage(argc, argv);
+		return -1;
+	}
+
+	err = sscanf(argv[1], "%u", &nr_readers);
+	if (err != 1) {
+		show_usage(argc, argv);
+		return -1;
+	}
+
+	err = sscanf(argv[2], "%u", &nr_updaters);
+	if (err != 1) {
+		show_usage(argc, argv);
+		return -1;
+	}
+
+	err = sscanf(argv[3], "%lu", &duration);
+	if (err != 1) {
+		show_usage(argc, argv);
+		return -1;
+	}
+
+	for (i = 4; i < argc; i++) {
+		if (argv[i][0] != '-')
+			continue;
+		switch (argv[i][1]) {
+		case 'a':
+			if (argc < i + 2) {
+				show_usage(argc, argv);
+				return -1;
+			}
+			a = atoi(argv[++i]);
+			cpu_affinities[next_aff++] = a;
+			use_affinity = 1;
+			printf_verbose("Adding CPU %d affinity\n", a);
+			break;
+		case 'c':
+			if (argc < i + 2) {
+				show_usage(argc, argv);
+				return -1;
+			}
+			rduration = atol(argv[++i]);
+			break;
+		case 'd':
+			if (argc < i + 2) {
+				show_usage(argc, argv);
+				return -1;
+			}
+			wdelay = atol(argv[++i]);
+			break;
+		case 'q':
+			if (argc < i + 2) {
+				show_usage(argc, argv);
+				return -1;
+			}
+			qs_period = atol(argv[++i]);
+			if (!qs_period) {
+				show_usage(argc, argv);
+				return -1;
+			}
+			break;
+		case 'v':
+			verbose_mode = 1;
+			break;
+		}
+	}
+
+	printf_verbose("running test for %lu seconds, %u readers, %u updaters.\n",
+		duration, nr_readers, nr_updaters);
+	printf_verbose("Updater delay : %lu loops.\n", wdelay);
+	printf_verbose("Reader duration : %lu loops.\n", rduration);
+	printf_verbose("thread %-6s, tid %lu\n",
+			"main", urcu_get_thread_id());
+
+	tid_reader = calloc(nr_readers, sizeof(*tid_reader));
+	tid_updater = calloc(nr_updaters, sizeof(*tid_updater));
+	count_reader = calloc(nr_readers, sizeof(*count_reader));
+	count_updater = calloc(nr_updaters, sizeof(*count_updater));
+
+	report = bench_report_create(argc, argv);
+	next_aff = 0;
+
+	for (i_thr = 0; i_thr < nr_readers; i_thr++) {
+		err = pthread_create(&tid_reader[i_thr], NULL, thr_reader,
+				     &count_reader[i_thr]);
+		if (err != 0)
+			exit(1);
+	}
+	for (i_thr = 0; i_thr < nr_updaters; i_thr++) {
+		err = pthread_create(&tid_updater[i_thr], NULL, thr_updater,
+				     &count_updater[i_thr]);
+		if (err != 0)
+			exit(1);
+	}
+
+	cmm_smp_mb();
+
+	rcu_get_stats(&stats_before);
+	bench_report_start(report);
+	test_go = 1;
+
+	sleep(duration);
+
+	bench_report_stop(report);
+	test_stop = 1;
+
+	for (i_thr = 0; i_thr < nr_readers; i_thr++) {
+		err = pthread_join(tid_reader[i_thr], &tret);
+		if (err != 0)
+			exit(1);
+		tot_reads += count_reader[i_thr].ops;
+		bench_report_thread(report, "reader", count_reader[i_thr].ops);
+	}
+	for (i_thr = 0; i_thr < nr_updaters; i_thr++) {
+		err = pthread_join(tid_updater[i_thr], &tret);
+		if (err != 0)
+			exit(1);
+		tot_syncs += count_updater[i_thr].ops;
+		bench_report_thread(report, "updater", count_updater[i_thr].ops);
+		bench_hist_merge(&sync_lat, &count_updater[i_thr].lat);
+	}
+	rcu_get_stats(&stats_after);
+	nr_gps = stats_after.gp_count - stats_before.gp_count;
+	nr_futex_waits = stats_after.gp_futex_wait_count
+		- stats_before.gp_futex_wait_count;
+
+	printf_verbose("total number of reads : %llu, synchronize_rcu %llu\n",
+		tot_reads, tot_syncs);
+	printf("SUMMARY %-25s testdur %4lu nr_readers %3u rdur %6lu "
+		"nr_updaters %3u wdelay %6lu nr_reads %12llu nr_syncs %10llu "
+		"nr_gps %10lu syncs_per_gp %6.2f gps_per_sec %10.1f "
+		"futex_waits %8lu\n",
+		argv[0], duration, nr_readers, rduration, nr_updaters, wdelay,
+		tot_reads, tot_syncs, nr_gps,
+		nr_gps ? (double) tot_syncs / nr_gps : 0,
+		bench_rate(report, nr_gps), nr_futex_waits);
+	bench_hist_print("synchronize_rcu", &sync_lat, "ns");
+	bench_report_param(report, "duration", duration);
+	bench_report_param(report, "nr_readers", nr_readers);
+	bench_report_param(report, "rduration", rduration);
+	bench_report_param(report, "nr_updaters", nr_updaters);
+	bench_report_param(report, "wdelay", wdelay);
+	bench_report_param(report, "nr_reads", tot_reads);
+	bench_report_param(report, "nr_syncs", tot_syncs);
+	bench_report_param(report, "nr_gps", nr_gps);
+	bench_report_param(report, "gp_futex_waits", nr_futex_waits);
+	bench_report_hist(report, "sync_ns", &sync_lat);
+	bench_report_destroy(report);
+	free(tid_reader);
+	free(tid_updater);
+	free(count_reader);
+	free(count_updater);
+	return 0;
+}
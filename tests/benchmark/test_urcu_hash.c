@@ -20,6 +20,7 @@
  * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
  */
 
+#include <math.h>
 #include "test_urcu_hash.h"
 
 enum test_hash {
@@ -88,6 +89,8 @@ DEFINE_URCU_TLS(unsigned long, nr_del);
 DEFINE_URCU_TLS(unsigned long, nr_delnoent);
 DEFINE_URCU_TLS(unsigned long, lookup_fail);
 DEFINE_URCU_TLS(unsigned long, lookup_ok);
+DEFINE_URCU_TLS(unsigned long, key_seq);
+DEFINE_URCU_TLS(unsigned long, trace_pos);
 
 struct cds_lfht *test_ht;
 
@@ -113,6 +116,15 @@ unsigned long init_pool_size = DEFAULT_RAND_POOL,
 	lookup_pool_size = DEFAULT_RAND_POOL,
 	write_pool_size = DEFAULT_RAND_POOL;
 int validate_lookup;
+
+enum test_key_dist key_dist = KEY_DIST_UNIFORM;
+double zipf_theta = 0.99;
+static unsigned int hotspot_keys_pct = 20;
+unsigned int hotspot_ops_pct = 80;
+unsigned long key_min_len, key_max_len;
+struct test_key_pool lookup_keys, write_keys;
+static const char *trace_file;
+int measure_latency;
 unsigned long nr_hash_chains;	/* 0: normal table, other: number of hash chains */
 
 int count_pipe[2];
@@ -136,7 +148,6 @@ static pthread_mutex_t rcu_copy_mutex = PTHREAD_MUTEX_INITIALIZER;
 void set_affinity(void)
 {
 #if HAVE_SCHED_SETAFFINITY
-	cpu_set_t mask;
 	int cpu, ret;
 #endif /* HAVE_SCHED_SETAFFINITY */
 
@@ -155,13 +166,7 @@ void set_affinity(void)
 		perror("Error in pthread mutex unlock");
 		exit(-1);
 	}
-	CPU_ZERO(&mask);
-	CPU_SET(cpu, &mask);
-#if SCHED_SETAFFINITY_ARGS == 2
-	sched_setaffinity(0, &mask);
-#else
-	sched_setaffinity(0, sizeof(mask), &mask);
-#endif
+	bench_pin_cpu(cpu);
 #endif /* HAVE_SCHED_SETAFFINITY */
 }
 
@@ -191,6 +196,8 @@ unsigned long test_compare(const void *key1, size_t key1_len,
 {
 	if (caa_unlikely(key1_len != key2_len))
 		return -1;
+	if (key_max_len)
+		return memcmp(key1, key2, key1_len) != 0;
 	assert(key1_len == sizeof(unsigned long));
 	if (key1 == key2)
 		return 0;
@@ -198,6 +205,265 @@ unsigned long test_compare(const void *key1, size_t key1_len,
 		return 1;
 }
 
+static
+double zeta(unsigned long n, double theta)
+{
+	double sum = 0;
+	unsigned long i;
+
+	for (i = 1; i <= n; i++)
+		sum += 1.0 / pow((double) i, theta);
+	return sum;
+}
+
+static
+void test_key_pool_init(struct test_key_pool *pool, unsigned long size,
+		unsigned long offset)
+{
+	pool->size = size;
+	pool->offset = offset;
+	switch (key_dist) {
+	case KEY_DIST_ZIPF:
+		/*
+		 * Gray et al., "Quickly generating billion-record synthetic
+		 * databases", as used by YCSB. Rank 0 is the hottest key.
+		 */
+		pool->zipf_zetan = zeta(size, zipf_theta);
+		pool->zipf_alpha = 1.0 / (1.0 - zipf_theta);
+		pool->zipf_eta = (1.0 - pow(2.0 / size, 1.0 - zipf_theta))
+			/ (1.0 - zeta(2, zipf_theta) / pool->zipf_zetan);
+		break;
+	case KEY_DIST_HOTSPOT:
+		pool->hot_size = size * hotspot_keys_pct / 100;
+		if (!pool->hot_size)
+			pool->hot_size = 1;
+		break;
+	default:
+		break;
+	}
+}
+
+unsigned long test_draw_key_skewed(struct test_key_pool *pool)
+{
+	unsigned long v;
+	double u;
+
+	switch (key_dist) {
+	case KEY_DIST_ZIPF:
+		u = (double) rand_r(&URCU_TLS(rand_lookup))
+			/ ((double) RAND_MAX + 1.0);
+		if (u * pool->zipf_zetan < 1.0)
+			v = 0;
+		else if (u * pool->zipf_zetan < 1.0 + pow(0.5, zipf_theta))
+			v = 1;
+		else
+			v = (unsigned long) (pool->size * pow(pool->zipf_eta * u
+				- pool->zipf_eta + 1.0, pool->zipf_alpha));
+		if (v >= pool->size)
+			v = pool->size - 1;
+		break;
+	case KEY_DIST_HOTSPOT:
+		v = rand_r(&URCU_TLS(rand_lookup));
+		if (v % 100 < hotspot_ops_pct || pool->hot_size == pool->size)
+			v = (unsigned long) rand_r(&URCU_TLS(rand_lookup))
+				% pool->hot_size;
+		else
+			v = pool->hot_size + (unsigned long)
+				rand_r(&URCU_TLS(rand_lookup))
+				% (pool->size - pool->hot_size);
+		break;
+	case KEY_DIST_SEQUENTIAL:
+		v = URCU_TLS(key_seq)++ % pool->size;
+		break;
+	case KEY_DIST_TRACE:
+		if (!pool->trace_nr) {
+			v = (unsigned long) rand_r(&URCU_TLS(rand_lookup))
+				% pool->size;
+			break;
+		}
+		if (URCU_TLS(trace_pos) >= pool->trace_nr)
+			URCU_TLS(trace_pos) = 0;
+		return pool->trace_keys[URCU_TLS(trace_pos)++];
+	default:
+		v = (unsigned long) rand_r(&URCU_TLS(rand_lookup)) % pool->size;
+		break;
+	}
+	return v + pool->offset;
+}
+
+/*
+ * Start each thread at its own position of the sequence or trace, so
+ * threads do not work on the same keys in lockstep.
+ */
+void test_key_thread_init(void)
+{
+	URCU_TLS(key_seq) = rand_r(&URCU_TLS(rand_lookup));
+	URCU_TLS(trace_pos) = rand_r(&URCU_TLS(rand_lookup));
+}
+
+static
+int test_trace_append(struct test_key_pool *pool, unsigned long key, int add)
+{
+	if (!(pool->trace_nr & (pool->trace_nr + 1))) {
+		unsigned long *keys;
+		unsigned char *adds;
+		size_t len = (pool->trace_nr + 1) << 1;
+
+		keys = realloc(pool->trace_keys, len * sizeof(*keys));
+		if (!keys)
+			return -1;
+		pool->trace_keys = keys;
+		adds = realloc(pool->trace_add, len * sizeof(*adds));
+		if (!adds)
+			return -1;
+		pool->trace_add = adds;
+	}
+	pool->trace_keys[pool->trace_nr] = key;
+	pool->trace_add[pool->trace_nr] = add;
+	pool->trace_nr++;
+	return 0;
+}
+
+/*
+ * Load a trace of "<op> <key>" lines, op being l (lookup), a (add) or
+ * d (delete). Lookups are replayed by the readers, adds and deletes by
+ * the writers.
+ */
+static
+int test_trace_load(const char *path)
+{
+	unsigned long key, line = 0;
+	char op, buf[128];
+	FILE *file;
+	int ret = 0;
+
+	file = fopen(path, "r");
+	if (!file) {
+		perror("fopen");
+		return -1;
+	}
+	while (fgets(buf, sizeof(buf), file)) {
+		line++;
+		if (buf[0] == '#' || buf[0] == '\n')
+			continue;
+		if (sscanf(buf, " %c %lu", &op, &key) != 2
+				|| (op != 'l' && op != 'a' && op != 'd')) {
+			printf("Error: %s:%lu: expecting \"<l|a|d> <key>\".\n",
+				path, line);
+			ret = -1;
+			break;
+		}
+		if (op == 'l')
+			ret = test_trace_append(&lookup_keys, key, 0);
+		else
+			ret = test_trace_append(&write_keys, key, op == 'a');
+		if (ret) {
+			perror("realloc");
+			break;
+		}
+	}
+	fclose(file);
+	if (!ret && !lookup_keys.trace_nr && !write_keys.trace_nr) {
+		printf("Error: %s: empty trace.\n", path);
+		ret = -1;
+	}
+	return ret;
+}
+
+static
+void test_trace_free(struct test_key_pool *pool)
+{
+	free(pool->trace_keys);
+	free(pool->trace_add);
+}
+
+/*
+ * String keys hold the decimal value, padded with a filler derived from
+ * it up to a length between key_min_len and key_max_len, so a given
+ * value always formats to the same key.
+ */
+size_t test_key_format(char *buf, unsigned long v)
+{
+	size_t len, target;
+
+	len = sprintf(buf, "%lu", v);
+	target = key_min_len + (v * 2654435761UL) % (key_max_len - key_min_len + 1);
+	if (len < target) {
+		buf[len++] = ':';
+		while (len < target) {
+			buf[len] = 'a' + (v + len) % 26;
+			len++;
+		}
+		buf[len] = '\0';
+	}
+	return len;
+}
+
+struct lfht_test_node *test_node_alloc(unsigned long v)
+{
+	struct lfht_test_node *node;
+	char buf[TEST_KEY_MAX_LEN + 1];
+	size_t len;
+
+	if (!key_max_len) {
+		node = malloc(sizeof(struct lfht_test_node));
+		lfht_test_node_init(node, (void *) v, sizeof(void *));
+		return node;
+	}
+	len = test_key_format(buf, v);
+	node = malloc(sizeof(struct lfht_test_node) + len + 1);
+	memcpy(node->key_data, buf, len + 1);
+	lfht_test_node_init(node, node->key_data, len);
+	return node;
+}
+
+static
+int parse_key_dist(const char *arg)
+{
+	if (!strcmp(arg, "uniform")) {
+		key_dist = KEY_DIST_UNIFORM;
+	} else if (!strncmp(arg, "zipf", 4)
+			&& (arg[4] == '\0' || arg[4] == ':')) {
+		key_dist = KEY_DIST_ZIPF;
+		if (arg[4] == ':')
+			zipf_theta = atof(arg + 5);
+		if (!(zipf_theta > 0.0 && zipf_theta < 1.0))
+			return -1;
+	} else if (!strncmp(arg, "hotspot", 7)
+			&& (arg[7] == '\0' || arg[7] == ':')) {
+		key_dist = KEY_DIST_HOTSPOT;
+		if (arg[7] == ':' && sscanf(arg + 8, "%u:%u",
+				&hotspot_keys_pct, &hotspot_ops_pct) != 2)
+			return -1;
+		if (!hotspot_keys_pct || hotspot_keys_pct > 100
+				|| hotspot_ops_pct > 100)
+			return -1;
+	} else if (!strcmp(arg, "sequential")) {
+		key_dist = KEY_DIST_SEQUENTIAL;
+	} else {
+		return -1;
+	}
+	return 0;
+}
+
+static
+const char *key_dist_name(void)
+{
+	switch (key_dist) {
+	case KEY_DIST_UNIFORM:
+		return "uniform";
+	case KEY_DIST_ZIPF:
+		return "zipf";
+	case KEY_DIST_HOTSPOT:
+		return "hotspot";
+	case KEY_DIST_SEQUENTIAL:
+		return "sequential";
+	case KEY_DIST_TRACE:
+		return "trace";
+	}
+	return "unknown";
+}
+
 void *thr_count(void *arg)
 {
 	printf_verbose("thread_begin %s, tid %lu\n",
@@ -282,7 +548,7 @@ printf("        [not -u nor -s] Add entries (supports redundant keys).\n");
 	printf("        [-i] Add only (no removal).\n");
 	printf("        [-k nr_nodes] Number of nodes to insert initially.\n");
 	printf("        [-A] Automatically resize hash table.\n");
-	printf("        [-B order|chunk|mmap] Specify the memory backend.\n");
+	printf("        [-B order|chunk|mmap|hugepage|hugepage_interleave] Specify the memory backend.\n");
 	printf("        [-R offset] Lookup pool offset.\n");
 	printf("        [-S offset] Write pool offset.\n");
 	printf("        [-T offset] Init pool offset.\n");
@@ -294,6 +560,15 @@ printf("        [not -u nor -s] Add entries (supports redundant keys).\n");
 	printf("		with different write range)\n");
 	printf("	[-U] Uniqueness test.\n");
 	printf("	[-C] Number of hash chains.\n");
+	printf("	[-L] Measure writer operation latencies.\n");
+	printf("	[-D uniform|zipf[:theta]|hotspot[:keys%%:ops%%]|sequential]\n");
+	printf("		Lookup and update key distribution (default uniform,\n");
+	printf("		zipf theta 0.99, hotspot 20%% of keys for 80%% of ops).\n");
+	printf("	[-K min:max] String keys of min to max bytes (max %d).\n",
+		TEST_KEY_MAX_LEN);
+	printf("	[-F file] Replay a trace of \"<l|a|d> <key>\" lines (rw test).\n");
+	printf("	[--format=json|csv] [--output=file] (report format)\n");
+	printf("	[--perf] (hardware counters per operation)\n");
 	printf("\n");
 }
 
@@ -302,7 +577,8 @@ int main(int argc, char **argv)
 	pthread_t *tid_reader, *tid_writer;
 	pthread_t tid_count;
 	void *tret;
-	unsigned long long *count_reader;
+	struct bench_report *report;
+	struct rd_count *count_reader;
 	struct wr_count *count_writer;
 	unsigned long long tot_reads = 0, tot_writes = 0,
 		tot_add = 0, tot_add_exist = 0, tot_remove = 0;
@@ -314,6 +590,7 @@ int main(int argc, char **argv)
 	unsigned int remain;
 	unsigned int nr_readers_created = 0, nr_writers_created = 0;
 	long long nr_leaked;
+	static struct bench_hist add_lat, del_lat, call_rcu_lat;
 
 	if (argc < 4) {
 		show_usage(argc, argv);
@@ -442,8 +719,12 @@ int main(int argc, char **argv)
 				memory_backend = &cds_lfht_mm_chunk;
 			else if (!strcmp("mmap", argv[i]))
 				memory_backend = &cds_lfht_mm_mmap;
+			else if (!strcmp("hugepage", argv[i]))
+				memory_backend = &cds_lfht_mm_hugepage;
+			else if (!strcmp("hugepage_interleave", argv[i]))
+				memory_backend = &cds_lfht_mm_hugepage_interleave;
 			else {
-				printf("Please specify memory backend with order|chunk|mmap.\n");
+				printf("Please specify memory backend with order|chunk|mmap|hugepage|hugepage_interleave.\n");
 				mainret = 1;
 				goto end;
 			}
@@ -472,11 +753,59 @@ int main(int argc, char **argv)
 		case 'U':
 			test_choice = TEST_HASH_UNIQUE;
 			break;
+		case 'L':
+			measure_latency = 1;
+			break;
 		case 'C':
 			nr_hash_chains = atol(argv[++i]);
 			break;
+		case 'D':
+			if (argc < i + 2 || parse_key_dist(argv[++i])) {
+				show_usage(argc, argv);
+				mainret = 1;
+				goto end;
+			}
+			break;
+		case 'K':
+			if (argc < i + 2 || sscanf(argv[++i], "%lu:%lu",
+					&key_min_len, &key_max_len) != 2
+					|| !key_min_len || key_min_len > key_max_len
+					|| key_max_len > TEST_KEY_MAX_LEN) {
+				show_usage(argc, argv);
+				mainret = 1;
+				goto end;
+			}
+			break;
+		case 'F':
+			if (argc < i + 2) {
+				show_usage(argc, argv);
+				mainret = 1;
+				goto end;
+			}
+			trace_file = argv[++i];
+			break;
+		}
+	}
+
+	if (trace_file) {
+		if (test_choice == TEST_HASH_UNIQUE) {
+			printf("Error: trace replay (-F) is not supported by the uniqueness test.\n");
+			mainret = 1;
+			goto end;
 		}
+		key_dist = KEY_DIST_TRACE;
+		if (test_trace_load(trace_file)) {
+			mainret = 1;
+			goto end;
+		}
+	}
+	if (!lookup_pool_size || !write_pool_size || !init_pool_size) {
+		printf("Error: Key pool sizes must be nonzero.\n");
+		mainret = 1;
+		goto end;
 	}
+	test_key_pool_init(&lookup_keys, lookup_pool_size, lookup_pool_offset);
+	test_key_pool_init(&write_keys, write_pool_size, write_pool_offset);
 
 	/* Check if hash size is power of 2 */
 	if (init_hash_size && init_hash_size & (init_hash_size - 1)) {
@@ -543,6 +872,19 @@ int main(int argc, char **argv)
 		write_pool_offset, write_pool_size);
 	printf_verbose("Number of hash chains: %lu.\n",
 		nr_hash_chains);
+	printf_verbose("Key distribution: %s", key_dist_name());
+	if (key_dist == KEY_DIST_ZIPF)
+		printf_verbose(" theta %g", zipf_theta);
+	else if (key_dist == KEY_DIST_HOTSPOT)
+		printf_verbose(" %u%% of keys for %u%% of ops",
+			hotspot_keys_pct, hotspot_ops_pct);
+	else if (key_dist == KEY_DIST_TRACE)
+		printf_verbose(" %s, %lu lookups, %lu updates", trace_file,
+			lookup_keys.trace_nr, write_keys.trace_nr);
+	printf_verbose(".\n");
+	if (key_max_len)
+		printf_verbose("String keys: %lu to %lu bytes.\n",
+			key_min_len, key_max_len);
 	printf_verbose("thread %-6s, tid %lu\n",
 			"main", urcu_get_thread_id());
 
@@ -600,6 +942,7 @@ int main(int argc, char **argv)
 
 	rcu_thread_offline();
 
+	report = bench_report_create(argc, argv);
 	next_aff = 0;
 
 	ret = pipe(count_pipe);
@@ -620,6 +963,7 @@ int main(int argc, char **argv)
 	}
 
 	for (i_thr = 0; i_thr < nr_readers; i_thr++) {
+		bench_perf_init(report, &count_reader[i_thr].perf);
 		err = pthread_create(&tid_reader[i_thr],
 				     NULL, get_thr_reader_cb(),
 				     &count_reader[i_thr]);
@@ -632,6 +976,7 @@ int main(int argc, char **argv)
 		nr_readers_created++;
 	}
 	for (i_thr = 0; i_thr < nr_writers; i_thr++) {
+		bench_perf_init(report, &count_writer[i_thr].perf);
 		err = pthread_create(&tid_writer[i_thr],
 				     NULL, get_thr_writer_cb(),
 				     &count_writer[i_thr]);
@@ -646,6 +991,7 @@ int main(int argc, char **argv)
 
 	cmm_smp_mb();
 
+	bench_report_start(report);
 	test_go = 1;
 
 	remain = duration;
@@ -653,6 +999,7 @@ int main(int argc, char **argv)
 		remain = sleep(remain);
 	} while (remain > 0);
 
+	bench_report_stop(report);
 	test_stop = 1;
 
 end_pthread_join:
@@ -663,7 +1010,10 @@ end_pthread_join:
 			mainret = 1;
 			perror("pthread_join");
 		}
-		tot_reads += count_reader[i_thr];
+		tot_reads += count_reader[i_thr].nr_reads;
+		bench_report_thread(report, "reader", count_reader[i_thr].nr_reads);
+		bench_report_perf(report, "reader", &count_reader[i_thr].perf,
+			count_reader[i_thr].nr_reads);
 	}
 	for (i_thr = 0; i_thr < nr_writers_created; i_thr++) {
 		err = pthread_join(tid_writer[i_thr], &tret);
@@ -673,9 +1023,16 @@ end_pthread_join:
 			perror("pthread_join");
 		}
 		tot_writes += count_writer[i_thr].update_ops;
+		bench_report_thread(report, "writer", count_writer[i_thr].update_ops);
+		bench_report_perf(report, "writer", &count_writer[i_thr].perf,
+			count_writer[i_thr].update_ops);
 		tot_add += count_writer[i_thr].add;
 		tot_add_exist += count_writer[i_thr].add_exist;
 		tot_remove += count_writer[i_thr].remove;
+		bench_hist_merge(&add_lat, &count_writer[i_thr].add_lat);
+		bench_hist_merge(&del_lat, &count_writer[i_thr].del_lat);
+		bench_hist_merge(&call_rcu_lat,
+			&count_writer[i_thr].call_rcu_lat);
 	}
 
 	/* teardown counter thread */
@@ -747,6 +1104,29 @@ end_online:
 		nr_writers, wdelay, tot_reads, tot_writes,
 		tot_reads + tot_writes, tot_add, tot_add_exist, tot_remove,
 		nr_leaked);
+	bench_report_param(report, "duration", duration);
+	bench_report_param(report, "nr_readers", nr_readers);
+	bench_report_param(report, "rduration", rduration);
+	bench_report_param(report, "nr_writers", nr_writers);
+	bench_report_param(report, "wdelay", wdelay);
+	bench_report_param(report, "key_dist", key_dist);
+	bench_report_param(report, "key_min_len", key_min_len);
+	bench_report_param(report, "key_max_len", key_max_len);
+	bench_report_param(report, "nr_reads", tot_reads);
+	bench_report_param(report, "nr_writes", tot_writes);
+	bench_report_param(report, "nr_add", tot_add);
+	bench_report_param(report, "nr_add_exist", tot_add_exist);
+	bench_report_param(report, "nr_remove", tot_remove);
+	bench_report_param(report, "nr_leaked", nr_leaked);
+	if (measure_latency) {
+		bench_hist_print("add", &add_lat, "cycles");
+		bench_hist_print("del", &del_lat, "cycles");
+		bench_hist_print("call_rcu", &call_rcu_lat, "cycles");
+		bench_report_hist(report, "add_cycles", &add_lat);
+		bench_report_hist(report, "del_cycles", &del_lat);
+		bench_report_hist(report, "call_rcu_cycles", &call_rcu_lat);
+	}
+	bench_report_destroy(report);
 	if (nr_leaked != 0) {
 		mainret = 1;
 		printf("WARNING: %lld nodes were leaked!\n", nr_leaked);
@@ -763,6 +1143,8 @@ end_free_tid_writer:
 end_free_tid_reader:
 	free(tid_reader);
 end:
+	test_trace_free(&lookup_keys);
+	test_trace_free(&write_keys);
 	if (!mainret)
 		exit(EXIT_SUCCESS);
 	else
@@ -38,6 +38,7 @@
 #include <urcu/tls-compat.h>
 #include <compat-rand.h>
 #include "cpuset.h"
+#include "bench.h"
 #include "thread-id.h"
 #include "../common/debug-yield.h"
 
@@ -75,11 +76,56 @@
 #include <urcu/rculfhash.h>
 #include <urcu-call-rcu.h>
 
+#ifdef TEST_HASH_RHT
+/*
+ * Benchmark the relativistic hash table with the code of cds_lfht, for
+ * A/B comparisons: map the cds_lfht API used by the tests to cds_rht.
+ * Flags other than CDS_LFHT_AUTO_RESIZE, and memory backends, are
+ * ignored.
+ */
+#include <urcu/rcurht.h>
+
+#undef cds_lfht_for_each_entry
+#undef cds_lfht_lookup
+#undef cds_lfht_next_duplicate
+
+#define cds_lfht			cds_rht
+#define cds_lfht_node			cds_rht_node
+#define cds_lfht_iter			cds_rht_iter
+#define cds_lfht_node_init		cds_rht_node_init
+#define cds_lfht_iter_get_node		cds_rht_iter_get_node
+#define cds_lfht_count_nodes		cds_rht_count_nodes
+#define cds_lfht_lookup			cds_rht_lookup
+#define cds_lfht_next_duplicate		cds_rht_next_duplicate
+#define cds_lfht_add			cds_rht_add
+#define cds_lfht_add_unique		cds_rht_add_unique
+#define cds_lfht_add_replace		cds_rht_add_replace
+#define cds_lfht_del			cds_rht_del
+#define cds_lfht_for_each_entry		cds_rht_for_each_entry
+#define cds_lfht_new(init_size, min_nr_alloc_buckets, max_nr_buckets,	\
+		flags, attr)						\
+	cds_rht_new(init_size, min_nr_alloc_buckets, max_nr_buckets,	\
+		((flags) & CDS_LFHT_AUTO_RESIZE) ? CDS_RHT_AUTO_RESIZE : 0)
+#define _cds_lfht_new(init_size, min_nr_alloc_buckets, max_nr_buckets,	\
+		flags, mm, flavor, attr)				\
+	cds_lfht_new(init_size, min_nr_alloc_buckets, max_nr_buckets,	\
+		flags, attr)
+#define cds_lfht_destroy(ht, attr)	cds_rht_destroy(ht)
+#endif /* TEST_HASH_RHT */
+
+struct rd_count {
+	unsigned long long nr_reads;
+	struct bench_perf perf;
+};
+
 struct wr_count {
 	unsigned long update_ops;
 	unsigned long add;
 	unsigned long add_exist;
 	unsigned long remove;
+	/* Latencies in cycles, recorded with -L. */
+	struct bench_hist add_lat, del_lat, call_rcu_lat;
+	struct bench_perf perf;
 };
 
 extern DECLARE_URCU_TLS(unsigned int, rand_lookup);
@@ -103,6 +149,7 @@ struct lfht_test_node {
 	unsigned int key_len;
 	/* cache-cold for iteration */
 	struct rcu_head head;
+	char key_data[];	/* String keys (-K) */
 };
 
 static inline struct lfht_test_node *
@@ -149,6 +196,96 @@ extern unsigned long init_pool_size,
 	write_pool_size;
 extern int validate_lookup;
 
+/* Distribution of the lookup and update keys, selected with -D or -F. */
+enum test_key_dist {
+	KEY_DIST_UNIFORM,
+	KEY_DIST_ZIPF,
+	KEY_DIST_HOTSPOT,
+	KEY_DIST_SEQUENTIAL,
+	KEY_DIST_TRACE,
+};
+
+/*
+ * Keys drawn by the lookup or update threads. The Zipfian parameters
+ * are precomputed for the pool size, and trace replay keeps its lookup
+ * and update operations in separate pools.
+ */
+struct test_key_pool {
+	unsigned long size, offset;
+	double zipf_zetan, zipf_alpha, zipf_eta;
+	unsigned long hot_size;
+	unsigned long trace_nr;
+	unsigned long *trace_keys;
+	unsigned char *trace_add;	/* Updates: add, or else delete */
+};
+
+/* Maximum length of the string keys, selected with -K. */
+#define TEST_KEY_MAX_LEN	255
+
+extern enum test_key_dist key_dist;
+extern double zipf_theta;
+extern unsigned int hotspot_ops_pct;
+extern unsigned long key_min_len, key_max_len;	/* 0: integer keys */
+extern struct test_key_pool lookup_keys, write_keys;
+
+extern DECLARE_URCU_TLS(unsigned long, key_seq);
+extern DECLARE_URCU_TLS(unsigned long, trace_pos);
+
+unsigned long test_draw_key_skewed(struct test_key_pool *pool);
+void test_key_thread_init(void);
+size_t test_key_format(char *buf, unsigned long v);
+struct lfht_test_node *test_node_alloc(unsigned long v);
+
+static inline
+unsigned long test_draw_key(struct test_key_pool *pool)
+{
+	if (caa_likely(key_dist == KEY_DIST_UNIFORM))
+		return ((unsigned long) rand_r(&URCU_TLS(rand_lookup)) % pool->size)
+			+ pool->offset;
+	return test_draw_key_skewed(pool);
+}
+
+/* Whether the next update of the trace adds its key. */
+static inline
+int test_trace_next_add(struct test_key_pool *pool)
+{
+	if (URCU_TLS(trace_pos) >= pool->trace_nr)
+		URCU_TLS(trace_pos) = 0;
+	return pool->trace_add[URCU_TLS(trace_pos)];
+}
+
+/*
+ * Return the key of value v, formatted into buf, which must hold
+ * TEST_KEY_MAX_LEN + 1 bytes, with string keys.
+ */
+static inline
+void *test_key(char *buf, unsigned long v)
+{
+	if (!key_max_len)
+		return (void *) v;
+	test_key_format(buf, v);
+	return buf;
+}
+
+static inline
+size_t test_key_len(const void *key)
+{
+	return key_max_len ? strlen(key) : sizeof(unsigned long);
+}
+
+extern int measure_latency;
+
+static inline caa_cycles_t latency_start(void)
+{
+	return caa_unlikely(measure_latency) ? caa_get_cycles() : 0;
+}
+
+static inline void latency_record(struct bench_hist *hist, caa_cycles_t start)
+{
+	if (caa_unlikely(measure_latency))
+		bench_hist_record(hist, caa_get_cycles() - start);
+}
+
 extern unsigned long nr_hash_chains;
 
 extern int count_pipe[2];
@@ -329,6 +466,32 @@ unsigned long test_hash_mix(const void *_key, size_t length, unsigned long seed)
 }
 #endif
 
+static inline
+unsigned long test_hash_str(const char *key, size_t length,
+			unsigned long seed)
+{
+	uint32_t words[(TEST_KEY_MAX_LEN + 3) / 4];
+	size_t nr_words = (length + 3) / 4;
+
+	assert(length && length <= TEST_KEY_MAX_LEN);
+	words[nr_words - 1] = 0;
+	memcpy(words, key, length);
+#if (CAA_BITS_PER_LONG == 32)
+	return hash_u32(words, nr_words, seed);
+#else
+	{
+		union {
+			uint64_t v64;
+			uint32_t v32[2];
+		} v;
+
+		v.v64 = (uint64_t) seed;
+		hashword2(words, nr_words, &v.v32[0], &v.v32[1]);
+		return v.v64;
+	}
+#endif
+}
+
 /*
  * Hash function with nr_hash_chains != 0 for testing purpose only!
  * Creates very long hash chains, deteriorating the hash table into a
@@ -341,6 +504,11 @@ static inline
 unsigned long test_hash(const void *_key, size_t length,
 			unsigned long seed)
 {
+	if (caa_unlikely(key_max_len)) {
+		unsigned long v = test_hash_str(_key, length, seed);
+
+		return nr_hash_chains ? v % nr_hash_chains : v;
+	}
 	if (nr_hash_chains == 0) {
 		return test_hash_mix(_key, length, seed);
 	} else {
@@ -361,14 +529,14 @@ int test_match(struct cds_lfht_node *node, const void *key)
 	struct lfht_test_node *test_node = to_test_node(node);
 
 	return !test_compare(test_node->key, test_node->key_len,
-			key, sizeof(unsigned long));
+			key, test_key_len(key));
 }
 
 static inline
 void cds_lfht_test_lookup(struct cds_lfht *ht, void *key, size_t key_len,
 		struct cds_lfht_iter *iter)
 {
-	assert(key_len == sizeof(unsigned long));
+	assert(key_max_len || key_len == sizeof(unsigned long));
 
 	cds_lfht_lookup(ht, test_hash(key, key_len, TEST_HASH_SEED),
 			test_match, key, iter);
@@ -0,0 +1,689 @@
+/*
+ * test_urcu_hash_resize.c
+ *
+ * Userspace RCU library - hash table resize latency benchmark
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+/*
+ * Readers look up random keys of a cds_lfht while writers add and
+ * delete them, and the table goes through grow and shrink cycles:
+ * either a resizer thread steps it between two sizes with
+ * cds_lfht_resize() (mode 0), or, with CDS_LFHT_AUTO_RESIZE, the writers
+ * alternately fill the key range and drain it (mode 1). A resize hook
+ * marks the resize windows, the latency of each operation is recorded
+ * in a histogram for the operations overlapping a window and another
+ * for the others, and the duration, partition thread count and grace
+ * period waits of the resize passes are accumulated per order: the
+ * base 2 logarithm of the larger of the two sizes of the pass.
+ */
+
+#include <stdio.h>
+#include <pthread.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/types.h>
+#include <unistd.h>
+#include <errno.h>
+#include <poll.h>
+
+#include <urcu/arch.h>
+#include <urcu/tls-compat.h>
+#include <urcu/hash.h>
+#include "cpuset.h"
+#include "bench.h"
+#include "thread-id.h"
+
+/* hardcoded number of CPUs */
+#define NR_CPUS 16384
+
+#ifndef DYNAMIC_LINK_TEST
+#define _LGPL_SOURCE
+#endif
+#if defined(RCU_QSBR)
+#include <urcu-qsbr.h>
+#elif defined(RCU_BP)
+#include <urcu-bp.h>
+#else
+#include <urcu.h>
+#endif
+#include <urcu/rculfhash.h>
+
+#define MAX_ORDER	(CAA_BITS_PER_LONG)
+
+enum resize_mode {
+	RESIZE_EXPLICIT,	/* cds_lfht_resize() cycles */
+	RESIZE_AUTO,		/* CDS_LFHT_AUTO_RESIZE, fill and drain */
+};
+
+enum fill_phase {
+	PHASE_TOGGLE,		/* Delete present keys, add absent ones. */
+	PHASE_FILL,
+	PHASE_DRAIN,
+};
+
+struct test_node {
+	struct cds_lfht_node node;
+	unsigned long key;
+	struct rcu_head head;
+};
+
+struct thr_count {
+	unsigned long long ops;
+	struct bench_hist lat_in;	/* Overlapping a resize, in ns */
+	struct bench_hist lat_out;
+};
+
+/* Resize passes of an order, updated by the resize hook. */
+struct order_stats {
+	unsigned long nr_grow, nr_shrink;
+	uint64_t grow_ns, shrink_ns, max_grow_ns, max_shrink_ns;
+	unsigned long nr_threads, max_threads;
+	unsigned long nr_gp_waits;
+};
+
+static volatile int test_go, test_stop;
+
+static unsigned long duration;
+static enum resize_mode mode = RESIZE_EXPLICIT;
+static unsigned long nr_keys = 1UL << 16;
+static unsigned long min_order = 10, max_order = 16, step_orders = 1;
+static unsigned long resize_delay_ms = 10;
+
+/* read-side C.S. between quiescent states (QSBR) */
+static unsigned long qs_period = 1024;
+
+static struct cds_lfht *test_ht;
+static uint64_t hash_seed = 0x9e3779b97f4a7c15ULL;
+
+static int resize_active;
+static enum fill_phase phase = PHASE_TOGGLE;
+static long nr_present;
+static struct order_stats order_stats[MAX_ORDER + 1];
+static uint64_t resize_window_ns;
+
+static int verbose_mode;
+
+#define printf_verbose(fmt, args...)		\
+	do {					\
+		if (verbose_mode)		\
+			printf(fmt, args);	\
+	} while (0)
+
+static unsigned int cpu_affinities[NR_CPUS];
+static unsigned int next_aff = 0;
+static int use_affinity = 0;
+
+pthread_mutex_t affinity_mutex = PTHREAD_MUTEX_INITIALIZER;
+
+static void set_affinity(void)
+{
+#if HAVE_SCHED_SETAFFINITY
+	int cpu, ret;
+#endif /* HAVE_SCHED_SETAFFINITY */
+
+	if (!use_affinity)
+		return;
+
+#if HAVE_SCHED_SETAFFINITY
+	ret = pthread_mutex_lock(&affinity_mutex);
+	if (ret) {
+		perror("Error in pthread mutex lock");
+		exit(-1);
+	}
+	cpu = cpu_affinities[next_aff++];
+	ret = pthread_mutex_unlock(&affinity_mutex);
+	if (ret) {
+		perror("Error in pthread mutex unlock");
+		exit(-1);
+	}
+
+	bench_pin_cpu(cpu);
+#endif /* HAVE_SCHED_SETAFFINITY */
+}
+
+static DEFINE_URCU_TLS(unsigned int, rand_seed);
+
+static unsigned int nr_readers;
+static unsigned int nr_writers;
+
+static unsigned long test_hash(unsigned long key)
+{
+	return (unsigned long) urcu_hash_u64(key, hash_seed);
+}
+
+static int test_match(struct cds_lfht_node *node, const void *key)
+{
+	struct test_node *n = caa_container_of(node, struct test_node, node);
+
+	return n->key == *(const unsigned long *) key;
+}
+
+static void free_node(struct rcu_head *head)
+{
+	free(caa_container_of(head, struct test_node, head));
+}
+
+static unsigned long random_key(void)
+{
+	return (unsigned long) rand_r(&URCU_TLS(rand_seed)) % nr_keys;
+}
+
+static unsigned int get_order(unsigned long size)
+{
+	return CAA_BITS_PER_LONG - 1 - __builtin_clzl(size);
+}
+
+static void resize_hook(struct cds_lfht *ht,
+		enum cds_lfht_resize_event_type type,
+		const struct cds_lfht_resize_event *event, void *priv)
+{
+	struct order_stats *s;
+	int grow;
+
+	if (type == CDS_LFHT_RESIZE_START) {
+		uatomic_set(&resize_active, 1);
+		return;
+	}
+	uatomic_set(&resize_active, 0);
+	if (event->new_size == event->old_size)
+		return;
+	grow = event->new_size > event->old_size;
+	s = &order_stats[get_order(grow ? event->new_size : event->old_size)];
+	if (grow) {
+		s->nr_grow++;
+		s->grow_ns += event->duration_ns;
+		if (event->duration_ns > s->max_grow_ns)
+			s->max_grow_ns = event->duration_ns;
+	} else {
+		s->nr_shrink++;
+		s->shrink_ns += event->duration_ns;
+		if (event->duration_ns > s->max_shrink_ns)
+			s->max_shrink_ns = event->duration_ns;
+	}
+	s->nr_threads += event->nr_threads;
+	if (event->nr_threads > s->max_threads)
+		s->max_threads = event->nr_threads;
+	s->nr_gp_waits += event->nr_gp_waits;
+	resize_window_ns += event->duration_ns;
+}
+
+/* Record the latency of an operation started at start, in seconds. */
+static void record_lat(struct thr_count *count, double start,
+		int active_start)
+{
+	uint64_t lat = (uint64_t) ((bench_now() - start) * 1e9);
+
+	if (active_start || uatomic_read(&resize_active))
+		bench_hist_record(&count->lat_in, lat);
+	else
+		bench_hist_record(&count->lat_out, lat);
+}
+
+static void *thr_reader(void *_count)
+{
+	struct thr_count *count = _count;
+	struct cds_lfht_iter iter;
+	unsigned long key;
+	int active;
+	double start;
+
+	printf_verbose("thread_begin %s, tid %lu\n",
+			"reader", urcu_get_thread_id());
+
+	set_affinity();
+	URCU_TLS(rand_seed) = (unsigned int) urcu_get_thread_id();
+
+	rcu_register_thread();
+
+	while (!test_go)
+	{
+	}
+	cmm_smp_mb();
+
+	while (!test_stop) {
+		key = random_key();
+		active = uatomic_read(&resize_active);
+		start = bench_now();
+		rcu_read_lock();
+		cds_lfht_lookup(test_ht, test_hash(key), test_match, &key,
+				&iter);
+		rcu_read_unlock();
+		record_lat(count, start, active);
+		count->ops++;
+#ifdef RCU_QSBR
+		if (caa_unlikely(count->ops % qs_period == 0))
+			rcu_quiescent_state();
+#endif
+	}
+
+	rcu_unregister_thread();
+
+	printf_verbose("thread_end %s, tid %lu\n",
+			"reader", urcu_get_thread_id());
+	return ((void*)1);
+}
+
+/* Add or delete a key, as the phase requires. */
+static void write_key(unsigned long key)
+{
+	enum fill_phase p = uatomic_read(&phase);
+	struct cds_lfht_node *ret_node;
+	struct cds_lfht_iter iter;
+	struct test_node *node;
+
+	rcu_read_lock();
+	cds_lfht_lookup(test_ht, test_hash(key), test_match, &key, &iter);
+	ret_node = cds_lfht_iter_get_node(&iter);
+	if (ret_node && p != PHASE_FILL) {
+		if (!cds_lfht_del(test_ht, ret_node)) {
+			uatomic_dec(&nr_present);
+			call_rcu(&caa_container_of(ret_node,
+				struct test_node, node)->head, free_node);
+		}
+	} else if (!ret_node && p != PHASE_DRAIN) {
+		node = malloc(sizeof(*node));
+		if (!node) {
+			perror("malloc");
+			exit(-1);
+		}
+		cds_lfht_node_init(&node->node);
+		node->key = key;
+		ret_node = cds_lfht_add_unique(test_ht, test_hash(key),
+				test_match, &key, &node->node);
+		if (ret_node == &node->node)
+			uatomic_inc(&nr_present);
+		else
+			free(node);
+	}
+	rcu_read_unlock();
+}
+
+static void *thr_writer(void *_count)
+{
+	struct thr_count *count = _count;
+	int active;
+	double start;
+
+	printf_verbose("thread_begin %s, tid %lu\n",
+			"writer", urcu_get_thread_id());
+
+	set_affinity();
+	URCU_TLS(rand_seed) = (unsigned int) urcu_get_thread_id();
+
+	rcu_register_thread();
+
+	while (!test_go)
+	{
+	}
+	cmm_smp_mb();
+
+	while (!test_stop) {
+		active = uatomic_read(&resize_active);
+		start = bench_now();
+		write_key(random_key());
+		record_lat(count, start, active);
+		count->ops++;
+#ifdef RCU_QSBR
+		if (caa_unlikely(count->ops % qs_period == 0))
+			rcu_quiescent_state();
+#endif
+	}
+
+	rcu_unregister_thread();
+
+	printf_verbose("thread_end %s, tid %lu\n",
+			"writer", urcu_get_thread_id());
+	return ((void*)2);
+}
+
+/*
+ * Mode 0: step the table from the minimum to the maximum order and back.
+ * Mode 1: switch the writers between filling and draining the keys.
+ */
+static void *thr_resizer(void *arg)
+{
+	unsigned long order = min_order;
+	int up = 1;
+
+	printf_verbose("thread_begin %s, tid %lu\n",
+			"resizer", urcu_get_thread_id());
+
+	set_affinity();
+	rcu_register_thread();
+#ifdef RCU_QSBR
+	rcu_thread_offline();
+#endif
+
+	while (!test_go)
+	{
+	}
+	cmm_smp_mb();
+
+	while (!test_stop) {
+		(void) poll(NULL, 0, resize_delay_ms);
+		if (mode == RESIZE_AUTO) {
+			if (uatomic_read(&nr_present) >= (long) nr_keys * 15 / 16)
+				uatomic_set(&phase, PHASE_DRAIN);
+			else if (uatomic_read(&nr_present) <= (long) nr_keys / 16)
+				uatomic_set(&phase, PHASE_FILL);
+			continue;
+		}
+		if (up)
+			order = caa_min(order + step_orders, max_order);
+		else
+			order = order > min_order + step_orders ?
+				order - step_orders : min_order;
+		if (order == max_order || order == min_order)
+			up = !up;
+#ifdef RCU_QSBR
+		rcu_thread_online();
+#endif
+		cds_lfht_resize(test_ht, 1UL << order);
+#ifdef RCU_QSBR
+		rcu_thread_offline();
+#endif
+	}
+
+	rcu_unregister_thread();
+	printf_verbose("thread_end %s, tid %lu\n",
+			"resizer", urcu_get_thread_id());
+	return ((void*)3);
+}
+
+static void populate(void)
+{
+	unsigned long key;
+
+	rcu_register_thread();
+	/* Half the keys, so that the writers add and delete as many. */
+	for (key = 0; key < nr_keys; key += 2)
+		write_key(key);
+	rcu_unregister_thread();
+}
+
+static void destroy_table(void)
+{
+	struct cds_lfht_iter iter;
+	struct cds_lfht_node *node;
+
+	rcu_register_thread();
+	rcu_read_lock();
+	cds_lfht_for_each(test_ht, &iter, node) {
+		if (!cds_lfht_del(test_ht, node))
+			call_rcu(&caa_container_of(node, struct test_node,
+				node)->head, free_node);
+	}
+	rcu_read_unlock();
+#ifdef RCU_QSBR
+	rcu_thread_offline();
+#endif
+	if (cds_lfht_destroy(test_ht, NULL))
+		fprintf(stderr, "Error destroying hash table\n");
+	rcu_barrier();
+	rcu_unregister_thread();
+}
+
+static void show_usage(int argc, char **argv)
+{
+	printf("Usage : %s nr_readers nr_writers duration (s) <OPTIONS>\n",
+		argv[0]);
+	printf("OPTIONS:\n");
+	printf("	[-m mode] (0: cds_lfht_resize() cycles (default), 1: auto-resize with fill and drain cycles)\n");
+	printf("	[-k nr_keys] (key range, default %lu)\n", nr_keys);
+	printf("	[-s order] [-S order] (mode 0: minimum and maximum size orders, default %lu and %lu)\n",
+		min_order, max_order);
+	printf("	[-o orders] (mode 0: orders per resize, default %lu)\n",
+		step_orders);
+	printf("	[-d delay] (ms between resizes, or phase checks, default %lu)\n",
+		resize_delay_ms);
+#ifdef RCU_QSBR
+	printf("	[-q period] (operations between quiescent states, default 1024)\n");
+#endif
+	printf("	[-v] (verbose output)\n");
+	printf("	[-a cpu#] [-a cpu#]... (affinity)\n");
+	printf("	[--format=json|csv] [--output=file] (report format)\n");
+	printf("\n");
+}
+
+static void print_orders(struct bench_report *report)
+{
+	static char keys[MAX_ORDER + 1][3][32];
+	struct order_stats *s;
+	unsigned int i;
+
+	for (i = 0; i <= MAX_ORDER; i++) {
+		s = &order_stats[i];
+		if (!s->nr_grow && !s->nr_shrink)
+			continue;
+		printf("RESIZE order %2u nr_grow %6lu grow_avg_ns %10llu "
+			"grow_max_ns %10llu nr_shrink %6lu shrink_avg_ns %10llu "
+			"shrink_max_ns %10llu threads_avg %5.2f threads_max %3lu "
+			"gp_waits %6lu\n", i,
+			s->nr_grow, (unsigned long long)
+				(s->nr_grow ? s->grow_ns / s->nr_grow : 0),
+			(unsigned long long) s->max_grow_ns,
+			s->nr_shrink, (unsigned long long)
+				(s->nr_shrink ? s->shrink_ns / s->nr_shrink : 0),
+			(unsigned long long) s->max_shrink_ns,
+			(double) s->nr_threads / (s->nr_grow + s->nr_shrink),
+			s->max_threads, s->nr_gp_waits);
+		snprintf(keys[i][0], sizeof(keys[i][0]), "o%u_grow_avg_ns", i);
+		snprintf(keys[i][1], sizeof(keys[i][1]), "o%u_shrink_avg_ns",
+			i);
+		snprintf(keys[i][2], sizeof(keys[i][2]), "o%u_threads_max", i);
+		bench_report_param(report, keys[i][0],
+			s->nr_grow ? s->grow_ns / s->nr_grow : 0);
+		bench_report_param(report, keys[i][1],
+			s->nr_shrink ? s->shrink_ns / s->nr_shrink : 0);
+		bench_report_param(report, keys[i][2], s->max_threads);
+	}
+}
+
+int main(int argc, char **argv)
+{
+	int err;
+	pthread_t *tid_reader, *tid_writer, tid_resizer;
+	void *tret;
+	struct bench_report *report;
+	struct thr_count *count_reader, *count_writer;
+	struct cds_lfht_resize_stats stats;
+	static struct bench_hist read_in, read_out, write_in, write_out;
+	unsigned long long tot_reads = 0, tot_writes = 0;
+	int i, a, flags;
+	unsigned int i_thr;
+
+	if (argc < 4) {
+		show_usage(argc, argv);
+		return -1;
+	}
+
+	err = sscanf(argv[1], "%u", &nr_readers);
+	if (err != 1) {
+		show_usage(argc, argv);
+		return -1;
+	}
+
+	err = sscanf(argv[2], "%u", &nr_writers);
+	if (err != 1) {
+		show_usage(argc, argv);
+		return -1;
+	}
+
+	err = sscanf(argv[3], "%lu", &duration);
+	if (err != 1) {
+		show_usage(argc, argv);
+		return -1;
+	}
+
+	for (i = 4; i < argc; i++) {
+		if (argv[i][0] != '-' || argv[i][1] == '-')
+			continue;
+		if (argv[i][1] != 'v' && argc < i + 2) {
+			show_usage(argc, argv);
+			return -1;
+		}
+		switch (argv[i][1]) {
+		case 'a':
+			a = atoi(argv[++i]);
+			cpu_affinities[next_aff++] = a;
+			use_affinity = 1;
+			printf_verbose("Adding CPU %d affinity\n", a);
+			break;
+		case 'm':
+			mode = atoi(argv[++i]) ? RESIZE_AUTO : RESIZE_EXPLICIT;
+			break;
+		case 'k':
+			nr_keys = atol(argv[++i]);
+			break;
+		case 's':
+			min_order = atol(argv[++i]);
+			break;
+		case 'S':
+			max_order = atol(argv[++i]);
+			break;
+		case 'o':
+			step_orders = atol(argv[++i]);
+			break;
+		case 'd':
+			resize_delay_ms = atol(argv[++i]);
+			break;
+		case 'q':
+			qs_period = atol(argv[++i]);
+			break;
+		case 'v':
+			verbose_mode = 1;
+			break;
+		}
+	}
+	if (!nr_keys || !qs_period || !step_orders || min_order > max_order
+			|| max_order >= CAA_BITS_PER_LONG) {
+		show_usage(argc, argv);
+		return -1;
+	}
+
+	printf_verbose("running test for %lu seconds, %u readers, %u writers, "
+		"mode %d.\n", duration, nr_readers, nr_writers, mode);
+	printf_verbose("thread %-6s, tid %lu\n",
+			"main", urcu_get_thread_id());
+
+	tid_reader = calloc(nr_readers, sizeof(*tid_reader));
+	tid_writer = calloc(nr_writers, sizeof(*tid_writer));
+	count_reader = calloc(nr_readers, sizeof(*count_reader));
+	count_writer = calloc(nr_writers, sizeof(*count_writer));
+
+	flags = CDS_LFHT_ACCOUNTING;
+	if (mode == RESIZE_AUTO)
+		flags |= CDS_LFHT_AUTO_RESIZE;
+	test_ht = cds_lfht_new(1UL << min_order, 1, 0, flags, NULL);
+	if (!test_ht) {
+		fprintf(stderr, "Error allocating hash table\n");
+		return -1;
+	}
+	if (mode == RESIZE_AUTO)
+		uatomic_set(&phase, PHASE_FILL);
+	else
+		populate();
+	cds_lfht_set_resize_hook(test_ht, resize_hook, NULL);
+
+	report = bench_report_create(argc, argv);
+	next_aff = 0;
+
+	for (i_thr = 0; i_thr < nr_readers; i_thr++) {
+		err = pthread_create(&tid_reader[i_thr], NULL, thr_reader,
+				     &count_reader[i_thr]);
+		if (err != 0)
+			exit(1);
+	}
+	for (i_thr = 0; i_thr < nr_writers; i_thr++) {
+		err = pthread_create(&tid_writer[i_thr], NULL, thr_writer,
+				     &count_writer[i_thr]);
+		if (err != 0)
+			exit(1);
+	}
+	err = pthread_create(&tid_resizer, NULL, thr_resizer, NULL);
+	if (err != 0)
+		exit(1);
+
+	cmm_smp_mb();
+
+	bench_report_start(report);
+	test_go = 1;
+
+	sleep(duration);
+
+	bench_report_stop(report);
+	test_stop = 1;
+
+	for (i_thr = 0; i_thr < nr_readers; i_thr++) {
+		err = pthread_join(tid_reader[i_thr], &tret);
+		if (err != 0)
+			exit(1);
+		tot_reads += count_reader[i_thr].ops;
+		bench_report_thread(report, "reader", count_reader[i_thr].ops);
+		bench_hist_merge(&read_in, &count_reader[i_thr].lat_in);
+		bench_hist_merge(&read_out, &count_reader[i_thr].lat_out);
+	}
+	for (i_thr = 0; i_thr < nr_writers; i_thr++) {
+		err = pthread_join(tid_writer[i_thr], &tret);
+		if (err != 0)
+			exit(1);
+		tot_writes += count_writer[i_thr].ops;
+		bench_report_thread(report, "writer", count_writer[i_thr].ops);
+		bench_hist_merge(&write_in, &count_writer[i_thr].lat_in);
+		bench_hist_merge(&write_out, &count_writer[i_thr].lat_out);
+	}
+	err = pthread_join(tid_resizer, &tret);
+	if (err != 0)
+		exit(1);
+	/* The hook is called with the resize mutex held. */
+	cds_lfht_set_resize_hook(test_ht, NULL, NULL);
+	cds_lfht_get_resize_stats(test_ht, &stats);
+
+	printf("SUMMARY %-25s testdur %4lu nr_readers %3u nr_writers %3u "
+		"mode %d nr_keys %10lu nr_reads %12llu nr_writes %12llu "
+		"nr_grow %6lu nr_shrink %6lu resize_pct %5.1f "
+		"resize_lock_contended %8llu\n",
+		argv[0], duration, nr_readers, nr_writers, mode, nr_keys,
+		tot_reads, tot_writes, stats.nr_grow, stats.nr_shrink,
+		resize_window_ns / 1e7 / bench_report_duration(report),
+		(unsigned long long) stats.resize_lock.contended);
+	bench_hist_print("read_in_resize", &read_in, "ns");
+	bench_hist_print("read_out_resize", &read_out, "ns");
+	bench_hist_print("write_in_resize", &write_in, "ns");
+	bench_hist_print("write_out_resize", &write_out, "ns");
+	bench_report_param(report, "duration", duration);
+	bench_report_param(report, "nr_readers", nr_readers);
+	bench_report_param(report, "nr_writers", nr_writers);
+	bench_report_param(report, "mode", mode);
+	bench_report_param(report, "nr_keys", nr_keys);
+	bench_report_param(report, "nr_grow", stats.nr_grow);
+	bench_report_param(report, "nr_shrink", stats.nr_shrink);
+	bench_report_param(report, "resize_window_ns", resize_window_ns);
+	bench_report_hist(report, "read_in_ns", &read_in);
+	bench_report_hist(report, "read_out_ns", &read_out);
+	bench_report_hist(report, "write_in_ns", &write_in);
+	bench_report_hist(report, "write_out_ns", &write_out);
+	print_orders(report);
+	bench_report_destroy(report);
+
+	destroy_table();
+	free(tid_reader);
+	free(tid_writer);
+	free(count_reader);
+	free(count_writer);
+	return 0;
+}
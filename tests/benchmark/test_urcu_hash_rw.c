@@ -60,14 +60,17 @@ void test_hash_rw_sigusr2_handler(int signo)
 
 void *test_hash_rw_thr_reader(void *_count)
 {
-	unsigned long long *count = _count;
+	struct rd_count *count = _count;
 	struct lfht_test_node *node;
 	struct cds_lfht_iter iter;
+	char key_buf[TEST_KEY_MAX_LEN + 1];
+	void *key;
 
 	printf_verbose("thread_begin %s, tid %lu\n",
 			"reader", urcu_get_thread_id());
 
 	URCU_TLS(rand_lookup) = urcu_get_thread_id() ^ time(NULL);
+	test_key_thread_init();
 
 	set_affinity();
 
@@ -77,12 +80,12 @@ void *test_hash_rw_thr_reader(void *_count)
 	{
 	}
 	cmm_smp_mb();
+	bench_perf_start(&count->perf);
 
 	for (;;) {
 		rcu_read_lock();
-		cds_lfht_test_lookup(test_ht,
-			(void *)(((unsigned long) rand_r(&URCU_TLS(rand_lookup)) % lookup_pool_size) + lookup_pool_offset),
-			sizeof(void *), &iter);
+		key = test_key(key_buf, test_draw_key(&lookup_keys));
+		cds_lfht_test_lookup(test_ht, key, test_key_len(key), &iter);
 		node = cds_lfht_iter_get_test_node(&iter);
 		if (node == NULL) {
 			if (validate_lookup) {
@@ -103,10 +106,11 @@ void *test_hash_rw_thr_reader(void *_count)
 		if (caa_unlikely((URCU_TLS(nr_reads) & ((1 << 10) - 1)) == 0))
 			rcu_quiescent_state();
 	}
+	bench_perf_stop(&count->perf);
 
 	rcu_unregister_thread();
 
-	*count = URCU_TLS(nr_reads);
+	count->nr_reads = URCU_TLS(nr_reads);
 	printf_verbose("thread_end %s, tid %lu\n",
 			"reader", urcu_get_thread_id());
 	printf_verbose("read tid : %lx, lookupfail %lu, lookupok %lu\n",
@@ -122,12 +126,16 @@ void *test_hash_rw_thr_writer(void *_count)
 	struct lfht_test_node *node;
 	struct cds_lfht_iter iter;
 	struct wr_count *count = _count;
+	char key_buf[TEST_KEY_MAX_LEN + 1];
+	caa_cycles_t start;
+	void *key;
 	int ret;
 
 	printf_verbose("thread_begin %s, tid %lu\n",
 			"writer", urcu_get_thread_id());
 
 	URCU_TLS(rand_lookup) = urcu_get_thread_id() ^ time(NULL);
+	test_key_thread_init();
 
 	set_affinity();
 
@@ -137,17 +145,17 @@ void *test_hash_rw_thr_writer(void *_count)
 	{
 	}
 	cmm_smp_mb();
+	bench_perf_start(&count->perf);
 
 	for (;;) {
 		struct cds_lfht_node *ret_node = NULL;
 
-		if ((addremove == AR_ADD || add_only)
-				|| (addremove == AR_RANDOM && rand_r(&URCU_TLS(rand_lookup)) & 1)) {
-			node = malloc(sizeof(struct lfht_test_node));
-			lfht_test_node_init(node,
-				(void *)(((unsigned long) rand_r(&URCU_TLS(rand_lookup)) % write_pool_size) + write_pool_offset),
-				sizeof(void *));
+		if (write_keys.trace_nr ? test_trace_next_add(&write_keys)
+				: ((addremove == AR_ADD || add_only)
+				|| (addremove == AR_RANDOM && rand_r(&URCU_TLS(rand_lookup)) & 1))) {
+			node = test_node_alloc(test_draw_key(&write_keys));
 			rcu_read_lock();
+			start = latency_start();
 			if (add_unique) {
 				ret_node = cds_lfht_add_unique(test_ht,
 					test_hash(node->key, node->key_len, TEST_HASH_SEED),
@@ -162,14 +170,17 @@ void *test_hash_rw_thr_writer(void *_count)
 						test_hash(node->key, node->key_len, TEST_HASH_SEED),
 						&node->node);
 			}
+			latency_record(&count->add_lat, start);
 			rcu_read_unlock();
 			if (add_unique && ret_node != &node->node) {
 				free(node);
 				URCU_TLS(nr_addexist)++;
 			} else {
 				if (add_replace && ret_node) {
+					start = latency_start();
 					call_rcu(&to_test_node(ret_node)->head,
 							free_node_cb);
+					latency_record(&count->call_rcu_lat, start);
 					URCU_TLS(nr_addexist)++;
 				} else {
 					URCU_TLS(nr_add)++;
@@ -178,14 +189,18 @@ void *test_hash_rw_thr_writer(void *_count)
 		} else {
 			/* May delete */
 			rcu_read_lock();
-			cds_lfht_test_lookup(test_ht,
-				(void *)(((unsigned long) rand_r(&URCU_TLS(rand_lookup)) % write_pool_size) + write_pool_offset),
-				sizeof(void *), &iter);
+			key = test_key(key_buf, test_draw_key(&write_keys));
+			cds_lfht_test_lookup(test_ht, key, test_key_len(key),
+				&iter);
+			start = latency_start();
 			ret = cds_lfht_del(test_ht, cds_lfht_iter_get_node(&iter));
+			latency_record(&count->del_lat, start);
 			rcu_read_unlock();
 			if (ret == 0) {
 				node = cds_lfht_iter_get_test_node(&iter);
+				start = latency_start();
 				call_rcu(&node->head, free_node_cb);
+				latency_record(&count->call_rcu_lat, start);
 				URCU_TLS(nr_del)++;
 			} else
 				URCU_TLS(nr_delnoent)++;
@@ -210,6 +225,7 @@ void *test_hash_rw_thr_writer(void *_count)
 		if (caa_unlikely((URCU_TLS(nr_writes) & ((1 << 10) - 1)) == 0))
 			rcu_quiescent_state();
 	}
+	bench_perf_stop(&count->perf);
 
 	rcu_unregister_thread();
 
@@ -248,10 +264,7 @@ int test_hash_rw_populate_hash(void)
 	while (URCU_TLS(nr_add) < init_populate) {
 		struct cds_lfht_node *ret_node = NULL;
 
-		node = malloc(sizeof(struct lfht_test_node));
-		lfht_test_node_init(node,
-			(void *)(((unsigned long) rand_r(&URCU_TLS(rand_lookup)) % init_pool_size) + init_pool_offset),
-			sizeof(void *));
+		node = test_node_alloc(((unsigned long) rand_r(&URCU_TLS(rand_lookup)) % init_pool_size) + init_pool_offset);
 		rcu_read_lock();
 		if (add_unique) {
 			ret_node = cds_lfht_add_unique(test_ht,
@@ -60,12 +60,13 @@ void test_hash_unique_sigusr2_handler(int signo)
 
 void *test_hash_unique_thr_reader(void *_count)
 {
-	unsigned long long *count = _count;
+	struct rd_count *count = _count;
 
 	printf_verbose("thread_begin %s, tid %lu\n",
 			"reader", urcu_get_thread_id());
 
 	URCU_TLS(rand_lookup) = urcu_get_thread_id() ^ time(NULL);
+	test_key_thread_init();
 
 	set_affinity();
 
@@ -75,6 +76,7 @@ void *test_hash_unique_thr_reader(void *_count)
 	{
 	}
 	cmm_smp_mb();
+	bench_perf_start(&count->perf);
 
 	for (;;) {
 		struct lfht_test_node *node;
@@ -105,10 +107,11 @@ void *test_hash_unique_thr_reader(void *_count)
 		if (caa_unlikely((URCU_TLS(nr_reads) & ((1 << 10) - 1)) == 0))
 			rcu_quiescent_state();
 	}
+	bench_perf_stop(&count->perf);
 
 	rcu_unregister_thread();
 
-	*count = URCU_TLS(nr_reads);
+	count->nr_reads = URCU_TLS(nr_reads);
 	printf_verbose("thread_end %s, tid %lu\n",
 			"reader", urcu_get_thread_id());
 	printf_verbose("read tid : %lu, lookupfail %lu, lookupok %lu\n",
@@ -124,6 +127,9 @@ void *test_hash_unique_thr_writer(void *_count)
 	struct cds_lfht_node *ret_node;
 	struct cds_lfht_iter iter;
 	struct wr_count *count = _count;
+	char key_buf[TEST_KEY_MAX_LEN + 1];
+	caa_cycles_t start;
+	void *key;
 	int ret;
 	int loc_add_unique;
 
@@ -131,6 +137,7 @@ void *test_hash_unique_thr_writer(void *_count)
 			"writer", urcu_get_thread_id());
 
 	URCU_TLS(rand_lookup) = urcu_get_thread_id() ^ time(NULL);
+	test_key_thread_init();
 
 	set_affinity();
 
@@ -140,6 +147,7 @@ void *test_hash_unique_thr_writer(void *_count)
 	{
 	}
 	cmm_smp_mb();
+	bench_perf_start(&count->perf);
 
 	for (;;) {
 		/*
@@ -147,12 +155,10 @@ void *test_hash_unique_thr_writer(void *_count)
 		 */
 		if (1 || (addremove == AR_ADD || add_only)
 				|| (addremove == AR_RANDOM && rand_r(&URCU_TLS(rand_lookup)) & 1)) {
-			node = malloc(sizeof(struct lfht_test_node));
-			lfht_test_node_init(node,
-				(void *)(((unsigned long) rand_r(&URCU_TLS(rand_lookup)) % write_pool_size) + write_pool_offset),
-				sizeof(void *));
+			node = test_node_alloc(test_draw_key(&write_keys));
 			rcu_read_lock();
 			loc_add_unique = rand_r(&URCU_TLS(rand_lookup)) & 1;
+			start = latency_start();
 			if (loc_add_unique) {
 				ret_node = cds_lfht_add_unique(test_ht,
 					test_hash(node->key, node->key_len, TEST_HASH_SEED),
@@ -168,6 +174,7 @@ void *test_hash_unique_thr_writer(void *_count)
 				ret_node = NULL;
 #endif //0
 			}
+			latency_record(&count->add_lat, start);
 			rcu_read_unlock();
 			if (loc_add_unique) {
 				if (ret_node != &node->node) {
@@ -178,8 +185,10 @@ void *test_hash_unique_thr_writer(void *_count)
 				}
 			} else {
 				if (ret_node) {
+					start = latency_start();
 					call_rcu(&to_test_node(ret_node)->head,
 							free_node_cb);
+					latency_record(&count->call_rcu_lat, start);
 					URCU_TLS(nr_addexist)++;
 				} else {
 					URCU_TLS(nr_add)++;
@@ -188,14 +197,18 @@ void *test_hash_unique_thr_writer(void *_count)
 		} else {
 			/* May delete */
 			rcu_read_lock();
-			cds_lfht_test_lookup(test_ht,
-				(void *)(((unsigned long) rand_r(&URCU_TLS(rand_lookup)) % write_pool_size) + write_pool_offset),
-				sizeof(void *), &iter);
+			key = test_key(key_buf, test_draw_key(&write_keys));
+			cds_lfht_test_lookup(test_ht, key, test_key_len(key),
+				&iter);
+			start = latency_start();
 			ret = cds_lfht_del(test_ht, cds_lfht_iter_get_node(&iter));
+			latency_record(&count->del_lat, start);
 			rcu_read_unlock();
 			if (ret == 0) {
 				node = cds_lfht_iter_get_test_node(&iter);
+				start = latency_start();
 				call_rcu(&node->head, free_node_cb);
+				latency_record(&count->call_rcu_lat, start);
 				URCU_TLS(nr_del)++;
 			} else
 				URCU_TLS(nr_delnoent)++;
@@ -220,6 +233,7 @@ void *test_hash_unique_thr_writer(void *_count)
 		if (caa_unlikely((URCU_TLS(nr_writes) & ((1 << 10) - 1)) == 0))
 			rcu_quiescent_state();
 	}
+	bench_perf_stop(&count->perf);
 
 	rcu_unregister_thread();
 
@@ -257,10 +271,7 @@ int test_hash_unique_populate_hash(void)
 	}
 
 	while (URCU_TLS(nr_add) < init_populate) {
-		node = malloc(sizeof(struct lfht_test_node));
-		lfht_test_node_init(node,
-			(void *)(((unsigned long) rand_r(&URCU_TLS(rand_lookup)) % init_pool_size) + init_pool_offset),
-			sizeof(void *));
+		node = test_node_alloc(((unsigned long) rand_r(&URCU_TLS(rand_lookup)) % init_pool_size) + init_pool_offset);
 		rcu_read_lock();
 		ret_node = cds_lfht_add_replace(test_ht,
 				test_hash(node->key, node->key_len, TEST_HASH_SEED),
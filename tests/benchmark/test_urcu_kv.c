@@ -0,0 +1,822 @@
+/*
+ * test_urcu_kv.c
+ *
+ * Userspace RCU library - in-memory key-value service benchmark
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+/*
+ * Worker threads serve a mix of get, set and delete requests on an
+ * in-memory key-value store: a cds_lfht index of items, each pointing to
+ * its value. Sets replace the value of an existing item with
+ * rcu_xchg_pointer() and reclaim the old one with call_rcu(); deletes
+ * reclaim the item and its value with call_rcu(). Keys are drawn
+ * uniformly or from a Zipf distribution. Optionally, a thread resizes
+ * the table back and forth, and items expire after a time to live,
+ * through an expiry index advanced by another thread. The run reports
+ * the throughput, the latency percentiles of each request type, and the
+ * resident memory per item after the initial population.
+ */
+
+#include <stdio.h>
+#include <pthread.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/types.h>
+#include <unistd.h>
+#include <assert.h>
+#include <errno.h>
+#include <math.h>
+#include <poll.h>
+
+#include <urcu/arch.h>
+#include <urcu/tls-compat.h>
+#include <urcu/hash.h>
+#include "cpuset.h"
+#include "bench.h"
+#include "thread-id.h"
+
+/* hardcoded number of CPUs */
+#define NR_CPUS 16384
+
+#ifndef DYNAMIC_LINK_TEST
+#define _LGPL_SOURCE
+#endif
+#if defined(RCU_QSBR)
+#include <urcu-qsbr.h>
+#elif defined(RCU_BP)
+#include <urcu-bp.h>
+#elif defined(RCU_PERCPU)
+#include <urcu-percpu.h>
+#else
+#include <urcu.h>
+#endif
+#include <urcu/rculfhash.h>
+#include <urcu/rculfhash-expiry.h>
+
+#define KV_MAX_BATCH	64
+
+struct kv_value {
+	struct rcu_head head;
+	size_t len;
+	char data[];
+};
+
+struct kv_item {
+	struct cds_lfht_expiry_node exp;	/* exp.node is in the table */
+	unsigned long key;
+	struct kv_value *value;			/* RCU-protected */
+};
+
+struct thr_count {
+	unsigned long long gets, hits, sets, dels;
+	unsigned long sum;			/* of the values read */
+	struct bench_hist get_lat, set_lat, del_lat;	/* in cycles */
+};
+
+static volatile int test_go, test_stop;
+
+static unsigned long wdelay;
+
+static unsigned long duration;
+
+static unsigned long nr_keys = 1UL << 16;
+static unsigned long nr_prefill = -1UL;	/* default: half of the keys */
+static unsigned int get_pct = 90, set_pct = 9;
+static double zipf_theta;		/* 0: uniform keys */
+static size_t value_size = 64;
+static unsigned long resize_ms;		/* 0: no resize thread */
+static unsigned long ttl_ms;		/* 0: no expiry */
+static unsigned int lookup_batch = 1;
+static int auto_resize;
+static const struct cds_lfht_mm_type *memory_backend;
+
+/* read-side C.S. between quiescent states (QSBR) */
+static unsigned long qs_period = 1024;
+
+static struct cds_lfht *ht;
+static struct cds_lfht_expiry *expiry;
+static uint64_t expiry_tick;		/* milliseconds, written by thr_expiry */
+static unsigned long nr_expired;
+
+/* Zipf parameters, see key_draw(). */
+static double zipf_zetan, zipf_alpha, zipf_eta;
+
+static uint64_t hash_seed = 0x9e3779b97f4a7c15ULL;
+
+static inline void loop_sleep(unsigned long loops)
+{
+	while (loops-- != 0)
+		caa_cpu_relax();
+}
+
+static int verbose_mode;
+
+#define printf_verbose(fmt, args...)		\
+	do {					\
+		if (verbose_mode)		\
+			printf(fmt, args);	\
+	} while (0)
+
+static unsigned int cpu_affinities[NR_CPUS];
+static unsigned int next_aff = 0;
+static int use_affinity = 0;
+
+pthread_mutex_t affinity_mutex = PTHREAD_MUTEX_INITIALIZER;
+
+static void set_affinity(void)
+{
+#if HAVE_SCHED_SETAFFINITY
+	int cpu, ret;
+#endif /* HAVE_SCHED_SETAFFINITY */
+
+	if (!use_affinity)
+		return;
+
+#if HAVE_SCHED_SETAFFINITY
+	ret = pthread_mutex_lock(&affinity_mutex);
+	if (ret) {
+		perror("Error in pthread mutex lock");
+		exit(-1);
+	}
+	cpu = cpu_affinities[next_aff++];
+	ret = pthread_mutex_unlock(&affinity_mutex);
+	if (ret) {
+		perror("Error in pthread mutex unlock");
+		exit(-1);
+	}
+
+	bench_pin_cpu(cpu);
+#endif /* HAVE_SCHED_SETAFFINITY */
+}
+
+/*
+ * returns 0 if test should end.
+ */
+static int test_duration_write(void)
+{
+	return !test_stop;
+}
+
+static DEFINE_URCU_TLS(unsigned int, rand_seed);
+static DEFINE_URCU_TLS(unsigned long long, nr_ops);
+
+static unsigned int nr_workers;
+
+static double zeta(unsigned long n, double theta)
+{
+	double sum = 0;
+	unsigned long i;
+
+	for (i = 1; i <= n; i++)
+		sum += 1.0 / pow((double) i, theta);
+	return sum;
+}
+
+static void key_dist_init(void)
+{
+	if (!zipf_theta)
+		return;
+	/*
+	 * Gray et al., "Quickly generating billion-record synthetic
+	 * databases", as used by YCSB. Key 0 is the hottest.
+	 */
+	zipf_zetan = zeta(nr_keys, zipf_theta);
+	zipf_alpha = 1.0 / (1.0 - zipf_theta);
+	zipf_eta = (1.0 - pow(2.0 / nr_keys, 1.0 - zipf_theta))
+		/ (1.0 - zeta(2, zipf_theta) / zipf_zetan);
+}
+
+static unsigned long key_draw(void)
+{
+	unsigned long v;
+	double u;
+
+	if (!zipf_theta)
+		return (unsigned long) rand_r(&URCU_TLS(rand_seed)) % nr_keys;
+	u = (double) rand_r(&URCU_TLS(rand_seed)) / ((double) RAND_MAX + 1.0);
+	if (u * zipf_zetan < 1.0)
+		v = 0;
+	else if (u * zipf_zetan < 1.0 + pow(0.5, zipf_theta))
+		v = 1;
+	else
+		v = (unsigned long) (nr_keys * pow(zipf_eta * u - zipf_eta
+			+ 1.0, zipf_alpha));
+	return v < nr_keys ? v : nr_keys - 1;
+}
+
+static unsigned long key_hash(unsigned long key)
+{
+	return (unsigned long) urcu_hash_u64(key, hash_seed);
+}
+
+static int kv_match(struct cds_lfht_node *node, const void *key)
+{
+	struct kv_item *item = caa_container_of(node, struct kv_item,
+			exp.node);
+
+	return item->key == *(const unsigned long *) key;
+}
+
+static struct kv_value *value_alloc(unsigned long key)
+{
+	struct kv_value *value;
+
+	value = malloc(sizeof(*value) + value_size);
+	if (!value) {
+		perror("malloc");
+		exit(-1);
+	}
+	value->len = value_size;
+	memset(value->data, (int) key, value_size);
+	return value;
+}
+
+static void free_value_cb(struct rcu_head *head)
+{
+	free(caa_container_of(head, struct kv_value, head));
+}
+
+/* Invoked after a grace period for deleted and expired items. */
+static void free_item_cb(struct rcu_head *head)
+{
+	struct kv_item *item = caa_container_of(head, struct kv_item,
+			exp.rcu_head);
+
+	free(item->value);
+	free(item);
+}
+
+static unsigned long kv_read(struct cds_lfht_node *node)
+{
+	struct kv_item *item = caa_container_of(node, struct kv_item,
+			exp.node);
+	struct kv_value *value = rcu_dereference(item->value);
+
+	return (unsigned char) value->data[0]
+		+ (unsigned char) value->data[value->len - 1];
+}
+
+static void kv_get(struct thr_count *count)
+{
+	unsigned long keys[KV_MAX_BATCH], hashes[KV_MAX_BATCH];
+	const void *key_ptrs[KV_MAX_BATCH];
+	struct cds_lfht_iter iters[KV_MAX_BATCH];
+	struct cds_lfht_node *node;
+	caa_cycles_t start, cycles;
+	unsigned int i;
+
+	for (i = 0; i < lookup_batch; i++) {
+		keys[i] = key_draw();
+		hashes[i] = key_hash(keys[i]);
+		key_ptrs[i] = &keys[i];
+	}
+	start = caa_get_cycles();
+	rcu_read_lock();
+	if (lookup_batch == 1)
+		cds_lfht_lookup(ht, hashes[0], kv_match, key_ptrs[0],
+				&iters[0]);
+	else
+		cds_lfht_lookup_batch(ht, lookup_batch, hashes, kv_match,
+				key_ptrs, iters);
+	for (i = 0; i < lookup_batch; i++) {
+		node = cds_lfht_iter_get_node(&iters[i]);
+		if (node) {
+			count->sum += kv_read(node);
+			count->hits++;
+		}
+	}
+	rcu_read_unlock();
+	cycles = (caa_get_cycles() - start) / lookup_batch;
+	for (i = 0; i < lookup_batch; i++)
+		bench_hist_record(&count->get_lat, cycles);
+	count->gets += lookup_batch;
+}
+
+static void kv_set(unsigned long key)
+{
+	unsigned long hash = key_hash(key);
+	struct kv_value *value = value_alloc(key), *old;
+	struct cds_lfht_iter iter;
+	struct cds_lfht_node *node;
+	struct kv_item *item;
+
+	rcu_read_lock();
+	cds_lfht_lookup(ht, hash, kv_match, &key, &iter);
+	node = cds_lfht_iter_get_node(&iter);
+	if (!node) {
+		item = malloc(sizeof(*item));
+		if (!item) {
+			perror("malloc");
+			exit(-1);
+		}
+		cds_lfht_node_init(&item->exp.node);
+		cds_lfht_expiry_node_init(&item->exp);
+		item->key = key;
+		item->value = value;
+		node = cds_lfht_add_unique(ht, hash, kv_match, &key,
+				&item->exp.node);
+		if (node == &item->exp.node)
+			goto arm;
+		/* Added concurrently: replace its value instead. */
+		free(item);
+	}
+	item = caa_container_of(node, struct kv_item, exp.node);
+	/*
+	 * If the item is being deleted, the new value is freed with it,
+	 * after readers of the old value are done.
+	 */
+	old = rcu_xchg_pointer(&item->value, value);
+	call_rcu(&old->head, free_value_cb);
+arm:
+	if (expiry)
+		(void) cds_lfht_expiry_arm(expiry, &item->exp,
+			CMM_LOAD_SHARED(expiry_tick) + ttl_ms);
+	rcu_read_unlock();
+}
+
+static void kv_del(unsigned long key)
+{
+	struct cds_lfht_iter iter;
+	struct cds_lfht_node *node;
+	struct kv_item *item;
+
+	rcu_read_lock();
+	cds_lfht_lookup(ht, key_hash(key), kv_match, &key, &iter);
+	node = cds_lfht_iter_get_node(&iter);
+	if (node) {
+		item = caa_container_of(node, struct kv_item, exp.node);
+		if (expiry)
+			(void) cds_lfht_expiry_del(expiry, &item->exp);
+		else if (!cds_lfht_del(ht, node))
+			call_rcu(&item->exp.rcu_head, free_item_cb);
+	}
+	rcu_read_unlock();
+}
+
+static void *thr_worker(void *_count)
+{
+	struct thr_count *count = _count;
+	caa_cycles_t start;
+	unsigned int r;
+
+	printf_verbose("thread_begin %s, tid %lu\n",
+			"worker", urcu_get_thread_id());
+
+	set_affinity();
+	URCU_TLS(rand_seed) = (unsigned int) urcu_get_thread_id();
+
+	rcu_register_thread();
+#ifdef RCU_QSBR
+	rcu_thread_offline();
+#endif
+
+	while (!test_go)
+	{
+	}
+	cmm_smp_mb();
+
+#ifdef RCU_QSBR
+	rcu_thread_online();
+#endif
+	for (;;) {
+		r = rand_r(&URCU_TLS(rand_seed)) % 100;
+		if (r < get_pct) {
+			kv_get(count);
+		} else if (r < get_pct + set_pct) {
+			start = caa_get_cycles();
+			kv_set(key_draw());
+			bench_hist_record(&count->set_lat,
+				caa_get_cycles() - start);
+			count->sets++;
+		} else {
+			start = caa_get_cycles();
+			kv_del(key_draw());
+			bench_hist_record(&count->del_lat,
+				caa_get_cycles() - start);
+			count->dels++;
+		}
+		URCU_TLS(nr_ops)++;
+		if (caa_unlikely(!test_duration_write()))
+			break;
+#ifdef RCU_QSBR
+		if (caa_unlikely(URCU_TLS(nr_ops) % qs_period == 0))
+			rcu_quiescent_state();
+#endif
+		if (caa_unlikely(wdelay))
+			loop_sleep(wdelay);
+	}
+
+	rcu_unregister_thread();
+
+	printf_verbose("thread_end %s, tid %lu\n",
+			"worker", urcu_get_thread_id());
+	return ((void*)1);
+}
+
+/* Grow the table to four times the key space, then shrink it back. */
+static void *thr_resize(void *arg)
+{
+	unsigned long *nr_resizes = arg, size = 1;
+
+	printf_verbose("thread_begin %s, tid %lu\n",
+			"resize", urcu_get_thread_id());
+
+	rcu_register_thread();
+#ifdef RCU_QSBR
+	rcu_thread_offline();
+#endif
+	while (!test_go)
+	{
+	}
+	cmm_smp_mb();
+
+	while (test_duration_write()) {
+		(void) poll(NULL, 0, resize_ms);
+		size = size == 1 ? 4 * nr_keys : 1;
+#ifdef RCU_QSBR
+		rcu_thread_online();
+#endif
+		cds_lfht_resize(ht, size);
+#ifdef RCU_QSBR
+		rcu_thread_offline();
+#endif
+		(*nr_resizes)++;
+	}
+
+	rcu_unregister_thread();
+	printf_verbose("thread_end %s, tid %lu\n",
+			"resize", urcu_get_thread_id());
+	return ((void*)2);
+}
+
+/* Advance the expiry index every millisecond. */
+static void *thr_expiry(void *arg)
+{
+	double start;
+	uint64_t now;
+
+	printf_verbose("thread_begin %s, tid %lu\n",
+			"expiry", urcu_get_thread_id());
+
+	rcu_register_thread();
+	start = bench_now();
+	while (test_duration_write()) {
+		(void) poll(NULL, 0, 1);
+		now = (uint64_t) ((bench_now() - start) * 1e3);
+		CMM_STORE_SHARED(expiry_tick, now);
+		rcu_read_lock();
+		nr_expired += cds_lfht_expiry_advance(expiry, now);
+		rcu_read_unlock();
+#ifdef RCU_QSBR
+		rcu_quiescent_state();
+#endif
+	}
+
+	rcu_unregister_thread();
+	printf_verbose("thread_end %s, tid %lu\n",
+			"expiry", urcu_get_thread_id());
+	return ((void*)3);
+}
+
+/* Resident memory of the process, in kB, or 0 if unknown. */
+static unsigned long rss_kb(void)
+{
+	unsigned long size, resident = 0;
+	FILE *file;
+
+	file = fopen("/proc/self/statm", "r");
+	if (!file)
+		return 0;
+	if (fscanf(file, "%lu %lu", &size, &resident) != 2)
+		resident = 0;
+	fclose(file);
+	return resident * (sysconf(_SC_PAGESIZE) / 1024);
+}
+
+/* Delete the remaining items, by the main thread, once alone. */
+static unsigned long kv_clear(void)
+{
+	struct cds_lfht_iter iter;
+	struct cds_lfht_node *node;
+	unsigned long nr = 0;
+
+	rcu_read_lock();
+	cds_lfht_for_each(ht, &iter, node) {
+		struct kv_item *item = caa_container_of(node, struct kv_item,
+				exp.node);
+
+		if (expiry) {
+			if (!cds_lfht_expiry_del(expiry, &item->exp))
+				nr++;
+		} else if (!cds_lfht_del(ht, node)) {
+			call_rcu(&item->exp.rcu_head, free_item_cb);
+			nr++;
+		}
+	}
+	rcu_read_unlock();
+	return nr;
+}
+
+static void show_usage(int argc, char **argv)
+{
+	printf("Usage : %s nr_workers duration (s) <OPTIONS>\n",
+		argv[0]);
+	printf("OPTIONS:\n");
+	printf("	[-k nr_keys] (key space, default 65536)\n");
+	printf("	[-p nr_items] (initial population, default half of the keys)\n");
+	printf("	[-g get%%] [-s set%%] (request mix, default 90 and 9, deletes for the rest)\n");
+	printf("	[-z theta] (Zipf key distribution, e.g. 0.99, default uniform)\n");
+	printf("	[-l size] (value size in bytes, default 64)\n");
+	printf("	[-b nr] (gets looked up in batches of nr, up to %d)\n",
+		KV_MAX_BATCH);
+	printf("	[-r ms] (resize the table back and forth every ms)\n");
+	printf("	[-A] (automatic table resize)\n");
+	printf("	[-e ms] (expire items ms after their last set)\n");
+	printf("	[-M order|chunk|mmap|hugepage] (bucket table memory backend)\n");
+#ifdef RCU_QSBR
+	printf("	[-q period] (requests between quiescent states, default 1024)\n");
+#endif
+	printf("	[-d delay] (period between requests (in loops))\n");
+	printf("	[-v] (verbose output)\n");
+	printf("	[-a cpu#] [-a cpu#]... (affinity)\n");
+	printf("	[--format=json|csv] [--output=file] (report format)\n");
+	printf("\n");
+}
+
+int main(int argc, char **argv)
+{
+	int err;
+	pthread_t *tid_worker, tid_resize, tid_expiry;
+	void *tret;
+	struct bench_report *report;
+	struct thr_count *count_worker;
+	unsigned long long tot_ops = 0, tot_gets = 0, tot_hits = 0,
+		tot_sets = 0, tot_dels = 0;
+	unsigned long nr_resizes = 0, rss_start, rss_populated, key, stride;
+	unsigned long init_size = 1;
+	unsigned long sum = 0;
+	long nr_items_start, nr_items_end;
+	double bytes_per_item;
+	static struct bench_hist get_lat, set_lat, del_lat;
+	int i, a;
+	unsigned int i_thr;
+
+	if (argc < 3) {
+		show_usage(argc, argv);
+		return -1;
+	}
+
+	err = sscanf(argv[1], "%u", &nr_workers);
+	if (err != 1) {
+		show_usage(argc, argv);
+		return -1;
+	}
+
+	err = sscanf(argv[2], "%lu", &duration);
+	if (err != 1) {
+		show_usage(argc, argv);
+		return -1;
+	}
+
+	for (i = 3; i < argc; i++) {
+		if (argv[i][0] != '-' || argv[i][1] == '-')
+			continue;
+		if (argv[i][1] != 'A' && argv[i][1] != 'v' && argc < i + 2) {
+			show_usage(argc, argv);
+			return -1;
+		}
+		switch (argv[i][1]) {
+		case 'a':
+			a = atoi(argv[++i]);
+			cpu_affinities[next_aff++] = a;
+			use_affinity = 1;
+			printf_verbose("Adding CPU %d affinity\n", a);
+			break;
+		case 'k':
+			nr_keys = atol(argv[++i]);
+			break;
+		case 'p':
+			nr_prefill = atol(argv[++i]);
+			break;
+		case 'g':
+			get_pct = atoi(argv[++i]);
+			break;
+		case 's':
+			set_pct = atoi(argv[++i]);
+			break;
+		case 'z':
+			zipf_theta = atof(argv[++i]);
+			break;
+		case 'l':
+			value_size = atol(argv[++i]);
+			break;
+		case 'b':
+			lookup_batch = atoi(argv[++i]);
+			break;
+		case 'r':
+			resize_ms = atol(argv[++i]);
+			break;
+		case 'A':
+			auto_resize = 1;
+			break;
+		case 'e':
+			ttl_ms = atol(argv[++i]);
+			break;
+		case 'M':
+			i++;
+			if (!strcmp(argv[i], "order"))
+				memory_backend = &cds_lfht_mm_order;
+			else if (!strcmp(argv[i], "chunk"))
+				memory_backend = &cds_lfht_mm_chunk;
+			else if (!strcmp(argv[i], "mmap"))
+				memory_backend = &cds_lfht_mm_mmap;
+			else if (!strcmp(argv[i], "hugepage"))
+				memory_backend = &cds_lfht_mm_hugepage;
+			else {
+				show_usage(argc, argv);
+				return -1;
+			}
+			break;
+		case 'q':
+			qs_period = atol(argv[++i]);
+			break;
+		case 'd':
+			wdelay = atol(argv[++i]);
+			break;
+		case 'v':
+			verbose_mode = 1;
+			break;
+		}
+	}
+	if (!nr_keys || get_pct + set_pct > 100 || !value_size
+			|| !lookup_batch || lookup_batch > KV_MAX_BATCH
+			|| !qs_period || zipf_theta < 0 || zipf_theta == 1.0) {
+		show_usage(argc, argv);
+		return -1;
+	}
+	if (nr_prefill == -1UL)
+		nr_prefill = nr_keys / 2;
+
+	printf_verbose("running test for %lu seconds, %u workers, %lu keys, "
+		"%zu bytes values.\n", duration, nr_workers, nr_keys,
+		value_size);
+	printf_verbose("thread %-6s, tid %lu\n",
+			"main", urcu_get_thread_id());
+
+	key_dist_init();
+	/* One bucket per key, unless resized automatically. */
+	while (!auto_resize && init_size < nr_keys)
+		init_size <<= 1;
+	rss_start = rss_kb();
+	ht = _cds_lfht_new(init_size, 1, 1UL << 26, CDS_LFHT_ACCOUNTING
+			| (auto_resize ? CDS_LFHT_AUTO_RESIZE : 0),
+			memory_backend, &rcu_flavor, NULL);
+	if (!ht) {
+		printf("Error allocating hash table.\n");
+		return -1;
+	}
+	if (ttl_ms) {
+		expiry = cds_lfht_expiry_new(ht, 64, 0, free_item_cb);
+		if (!expiry) {
+			printf("Error allocating expiry index.\n");
+			return -1;
+		}
+	}
+
+	/* Populate distinct keys, spread over the key space. */
+	rcu_register_thread();
+	stride = nr_prefill < nr_keys ? nr_keys / nr_prefill : 1;
+	for (key = 0; key < nr_prefill && key < nr_keys; key++)
+		kv_set(key * stride);
+	(void) cds_lfht_count_split(ht, &nr_items_start);
+	rss_populated = rss_kb();
+	bytes_per_item = nr_items_start > 0 ? (double) (rss_populated
+		- rss_start) * 1024 / nr_items_start : 0;
+#ifdef RCU_QSBR
+	rcu_thread_offline();
+#endif
+
+	tid_worker = calloc(nr_workers, sizeof(*tid_worker));
+	count_worker = calloc(nr_workers, sizeof(*count_worker));
+
+	report = bench_report_create(argc, argv);
+	next_aff = 0;
+
+	for (i_thr = 0; i_thr < nr_workers; i_thr++) {
+		err = pthread_create(&tid_worker[i_thr], NULL, thr_worker,
+				     &count_worker[i_thr]);
+		if (err != 0)
+			exit(1);
+	}
+	if (resize_ms) {
+		err = pthread_create(&tid_resize, NULL, thr_resize,
+				&nr_resizes);
+		if (err != 0)
+			exit(1);
+	}
+	if (ttl_ms) {
+		err = pthread_create(&tid_expiry, NULL, thr_expiry, NULL);
+		if (err != 0)
+			exit(1);
+	}
+
+	cmm_smp_mb();
+
+	bench_report_start(report);
+	test_go = 1;
+
+	sleep(duration);
+
+	bench_report_stop(report);
+	test_stop = 1;
+
+	for (i_thr = 0; i_thr < nr_workers; i_thr++) {
+		struct thr_count *count = &count_worker[i_thr];
+
+		err = pthread_join(tid_worker[i_thr], &tret);
+		if (err != 0)
+			exit(1);
+		tot_gets += count->gets;
+		tot_hits += count->hits;
+		tot_sets += count->sets;
+		tot_dels += count->dels;
+		sum += count->sum;
+		bench_report_thread(report, "worker",
+			count->gets + count->sets + count->dels);
+		bench_hist_merge(&get_lat, &count->get_lat);
+		bench_hist_merge(&set_lat, &count->set_lat);
+		bench_hist_merge(&del_lat, &count->del_lat);
+	}
+	tot_ops = tot_gets + tot_sets + tot_dels;
+	if (resize_ms) {
+		err = pthread_join(tid_resize, &tret);
+		if (err != 0)
+			exit(1);
+	}
+	if (ttl_ms) {
+		err = pthread_join(tid_expiry, &tret);
+		if (err != 0)
+			exit(1);
+	}
+	(void) cds_lfht_count_split(ht, &nr_items_end);
+
+	printf_verbose("checksum of the values read: %lu\n", sum);
+	printf("SUMMARY %-25s testdur %4lu nr_workers %3u nr_keys %10lu "
+		"value_size %6zu nr_ops %12llu ops_per_sec %12.1f "
+		"hit_ratio %5.3f nr_sets %12llu nr_dels %12llu "
+		"nr_expired %10lu nr_resizes %6lu items_start %10ld "
+		"items_end %10ld bytes_per_item %8.1f overhead_per_item %8.1f\n",
+		argv[0], duration, nr_workers, nr_keys, value_size, tot_ops,
+		bench_rate(report, tot_ops),
+		tot_gets ? (double) tot_hits / tot_gets : 0, tot_sets,
+		tot_dels, nr_expired, nr_resizes, nr_items_start,
+		nr_items_end, bytes_per_item,
+		bytes_per_item ? bytes_per_item - value_size
+			- sizeof(unsigned long) : 0);
+	bench_hist_print("get", &get_lat, "cycles");
+	bench_hist_print("set", &set_lat, "cycles");
+	bench_hist_print("delete", &del_lat, "cycles");
+	bench_report_param(report, "duration", duration);
+	bench_report_param(report, "nr_workers", nr_workers);
+	bench_report_param(report, "nr_keys", nr_keys);
+	bench_report_param(report, "value_size", value_size);
+	bench_report_param(report, "nr_ops", tot_ops);
+	bench_report_param(report, "nr_hits", tot_hits);
+	bench_report_param(report, "nr_expired", nr_expired);
+	bench_report_param(report, "nr_resizes", nr_resizes);
+	bench_report_param(report, "items_start", nr_items_start);
+	bench_report_param(report, "items_end", nr_items_end);
+	bench_report_param(report, "bytes_per_item", (long long) bytes_per_item);
+	bench_report_hist(report, "get_cycles", &get_lat);
+	bench_report_hist(report, "set_cycles", &set_lat);
+	bench_report_hist(report, "del_cycles", &del_lat);
+	bench_report_destroy(report);
+
+#ifdef RCU_QSBR
+	rcu_thread_online();
+#endif
+	(void) kv_clear();
+	rcu_unregister_thread();
+	rcu_barrier();
+	if (expiry)
+		cds_lfht_expiry_destroy(expiry);
+	if (cds_lfht_destroy(ht, NULL))
+		printf("Error destroying hash table.\n");
+	free(tid_worker);
+	free(count_worker);
+	return 0;
+}
@@ -37,6 +37,7 @@
 #include <urcu/arch.h>
 #include <urcu/tls-compat.h>
 #include "cpuset.h"
+#include "bench.h"
 #include "thread-id.h"
 
 /* hardcoded number of CPUs */
@@ -80,7 +81,6 @@ pthread_mutex_t affinity_mutex = PTHREAD_MUTEX_INITIALIZER;
 static void set_affinity(void)
 {
 #if HAVE_SCHED_SETAFFINITY
-	cpu_set_t mask;
 	int cpu, ret;
 #endif /* HAVE_SCHED_SETAFFINITY */
 
@@ -100,13 +100,7 @@ static void set_affinity(void)
 		exit(-1);
 	}
 
-	CPU_ZERO(&mask);
-	CPU_SET(cpu, &mask);
-#if SCHED_SETAFFINITY_ARGS == 2
-	sched_setaffinity(0, &mask);
-#else
-	sched_setaffinity(0, sizeof(mask), &mask);
-#endif
+	bench_pin_cpu(cpu);
 #endif /* HAVE_SCHED_SETAFFINITY */
 }
 
@@ -132,9 +126,18 @@ static DEFINE_URCU_TLS(unsigned long long, nr_successful_enqueues);
 static unsigned int nr_enqueuers;
 static unsigned int nr_dequeuers;
 
+/*
+ * Use the hazard-pointer variants of the queue: threads are not
+ * registered to RCU, and dequeued nodes are reclaimed through the
+ * hazard-pointer domain rather than call_rcu().
+ */
+static int use_hazptr;
+static struct urcu_hazptr_domain *domain;
+
 struct test {
 	struct cds_lfq_node_rcu list;
 	struct rcu_head rcu;
+	struct urcu_hazptr_head hp;
 };
 
 static struct cds_lfq_queue_rcu q;
@@ -142,13 +145,17 @@ static struct cds_lfq_queue_rcu q;
 void *thr_enqueuer(void *_count)
 {
 	unsigned long long *count = _count;
+	struct urcu_hazptr_rec *rec = NULL;
 
 	printf_verbose("thread_begin %s, tid %lu\n",
 			"enqueuer", urcu_get_thread_id());
 
 	set_affinity();
 
-	rcu_register_thread();
+	if (use_hazptr)
+		rec = urcu_hazptr_rec_get(domain);
+	else
+		rcu_register_thread();
 
 	while (!test_go)
 	{
@@ -160,9 +167,13 @@ void *thr_enqueuer(void *_count)
 		if (!node)
 			goto fail;
 		cds_lfq_node_init_rcu(&node->list);
-		rcu_read_lock();
-		cds_lfq_enqueue_rcu(&q, &node->list);
-		rcu_read_unlock();
+		if (use_hazptr) {
+			cds_lfq_enqueue_hazptr(&q, &node->list, rec);
+		} else {
+			rcu_read_lock();
+			cds_lfq_enqueue_rcu(&q, &node->list);
+			rcu_read_unlock();
+		}
 		URCU_TLS(nr_successful_enqueues)++;
 
 		if (caa_unlikely(wdelay))
@@ -173,7 +184,8 @@ fail:
 			break;
 	}
 
-	rcu_unregister_thread();
+	if (!use_hazptr)
+		rcu_unregister_thread();
 
 	count[0] = URCU_TLS(nr_enqueues);
 	count[1] = URCU_TLS(nr_successful_enqueues);
@@ -194,16 +206,28 @@ void free_node_cb(struct rcu_head *head)
 	free(node);
 }
 
+static
+void free_node_hp(struct urcu_hazptr_head *head)
+{
+	struct test *node =
+		caa_container_of(head, struct test, hp);
+	free(node);
+}
+
 void *thr_dequeuer(void *_count)
 {
 	unsigned long long *count = _count;
+	struct urcu_hazptr_rec *rec = NULL;
 
 	printf_verbose("thread_begin %s, tid %lu\n",
 			"dequeuer", urcu_get_thread_id());
 
 	set_affinity();
 
-	rcu_register_thread();
+	if (use_hazptr)
+		rec = urcu_hazptr_rec_get(domain);
+	else
+		rcu_register_thread();
 
 	while (!test_go)
 	{
@@ -213,15 +237,23 @@ void *thr_dequeuer(void *_count)
 	for (;;) {
 		struct cds_lfq_node_rcu *qnode;
 
-		rcu_read_lock();
-		qnode = cds_lfq_dequeue_rcu(&q);
-		rcu_read_unlock();
+		if (use_hazptr) {
+			qnode = cds_lfq_dequeue_hazptr(&q, rec);
+		} else {
+			rcu_read_lock();
+			qnode = cds_lfq_dequeue_rcu(&q);
+			rcu_read_unlock();
+		}
 
 		if (qnode) {
 			struct test *node;
 
 			node = caa_container_of(qnode, struct test, list);
-			call_rcu(&node->rcu, free_node_cb);
+			if (use_hazptr)
+				urcu_hazptr_retire(rec, &node->hp, node,
+						free_node_hp);
+			else
+				call_rcu(&node->rcu, free_node_cb);
 			URCU_TLS(nr_successful_dequeues)++;
 		}
 
@@ -232,7 +264,8 @@ void *thr_dequeuer(void *_count)
 			loop_sleep(rduration);
 	}
 
-	rcu_unregister_thread();
+	if (!use_hazptr)
+		rcu_unregister_thread();
 	printf_verbose("dequeuer thread_end, tid %lu, "
 			"dequeues %llu, successful_dequeues %llu\n",
 			urcu_get_thread_id(),
@@ -248,7 +281,11 @@ void test_end(struct cds_lfq_queue_rcu *q, unsigned long long *nr_dequeues)
 	struct cds_lfq_node_rcu *snode;
 
 	do {
-		snode = cds_lfq_dequeue_rcu(q);
+		if (use_hazptr)
+			snode = cds_lfq_dequeue_hazptr(q,
+					urcu_hazptr_rec_get(domain));
+		else
+			snode = cds_lfq_dequeue_rcu(q);
 		if (snode) {
 			struct test *node;
 
@@ -267,7 +304,9 @@ void show_usage(int argc, char **argv)
 	printf("	[-d delay] (enqueuer period (in loops))\n");
 	printf("	[-c duration] (dequeuer period (in loops))\n");
 	printf("	[-v] (verbose output)\n");
+	printf("	[-H] (hazard pointers instead of RCU)\n");
 	printf("	[-a cpu#] [-a cpu#]... (affinity)\n");
+	printf("	[--format=json|csv] [--output=file] (report format)\n");
 	printf("\n");
 }
 
@@ -276,6 +315,7 @@ int main(int argc, char **argv)
 	int err;
 	pthread_t *tid_enqueuer, *tid_dequeuer;
 	void *tret;
+	struct bench_report *report;
 	unsigned long long *count_enqueuer, *count_dequeuer;
 	unsigned long long tot_enqueues = 0, tot_dequeues = 0;
 	unsigned long long tot_successful_enqueues = 0,
@@ -338,6 +378,9 @@ int main(int argc, char **argv)
 		case 'v':
 			verbose_mode = 1;
 			break;
+		case 'H':
+			use_hazptr = 1;
+			break;
 		}
 	}
 
@@ -353,12 +396,21 @@ int main(int argc, char **argv)
 	tid_dequeuer = calloc(nr_dequeuers, sizeof(*tid_dequeuer));
 	count_enqueuer = calloc(nr_enqueuers, 2 * sizeof(*count_enqueuer));
 	count_dequeuer = calloc(nr_dequeuers, 2 * sizeof(*count_dequeuer));
-	cds_lfq_init_rcu(&q, call_rcu);
-	err = create_all_cpu_call_rcu_data(0);
-	if (err) {
-		printf("Per-CPU call_rcu() worker threads unavailable. Using default global worker thread.\n");
+	if (use_hazptr) {
+		domain = urcu_hazptr_domain_create(0,
+				URCU_HAZPTR_SYS_MEMBARRIER);
+		if (!domain)
+			exit(1);
+		cds_lfq_init_hazptr(&q);
+	} else {
+		cds_lfq_init_rcu(&q, call_rcu);
+		err = create_all_cpu_call_rcu_data(0);
+		if (err) {
+			printf("Per-CPU call_rcu() worker threads unavailable. Using default global worker thread.\n");
+		}
 	}
 
+	report = bench_report_create(argc, argv);
 	next_aff = 0;
 
 	for (i_thr = 0; i_thr < nr_enqueuers; i_thr++) {
@@ -376,6 +428,7 @@ int main(int argc, char **argv)
 
 	cmm_smp_mb();
 
+	bench_report_start(report);
 	test_go = 1;
 
 	for (i_thr = 0; i_thr < duration; i_thr++) {
@@ -386,6 +439,7 @@ int main(int argc, char **argv)
 		}
 	}
 
+	bench_report_stop(report);
 	test_stop = 1;
 
 	for (i_thr = 0; i_thr < nr_enqueuers; i_thr++) {
@@ -393,6 +447,7 @@ int main(int argc, char **argv)
 		if (err != 0)
 			exit(1);
 		tot_enqueues += count_enqueuer[2 * i_thr];
+		bench_report_thread(report, "enqueuer", count_enqueuer[2 * i_thr]);
 		tot_successful_enqueues += count_enqueuer[2 * i_thr + 1];
 	}
 	for (i_thr = 0; i_thr < nr_dequeuers; i_thr++) {
@@ -400,6 +455,7 @@ int main(int argc, char **argv)
 		if (err != 0)
 			exit(1);
 		tot_dequeues += count_dequeuer[2 * i_thr];
+		bench_report_thread(report, "dequeuer", count_dequeuer[2 * i_thr]);
 		tot_successful_dequeues += count_dequeuer[2 * i_thr + 1];
 	}
 
@@ -422,13 +478,28 @@ int main(int argc, char **argv)
 		tot_successful_enqueues,
 		tot_successful_dequeues, end_dequeues,
 		tot_enqueues + tot_dequeues);
+	bench_report_param(report, "duration", duration);
+	bench_report_param(report, "nr_enqueuers", nr_enqueuers);
+	bench_report_param(report, "wdelay", wdelay);
+	bench_report_param(report, "nr_dequeuers", nr_dequeuers);
+	bench_report_param(report, "rduration", rduration);
+	bench_report_param(report, "hazptr", use_hazptr);
+	bench_report_param(report, "nr_enqueues", tot_enqueues);
+	bench_report_param(report, "nr_dequeues", tot_dequeues);
+	bench_report_param(report, "nr_successful_enqueues", tot_successful_enqueues);
+	bench_report_param(report, "nr_successful_dequeues", tot_successful_dequeues);
+	bench_report_param(report, "end_dequeues", end_dequeues);
+	bench_report_destroy(report);
 	if (tot_successful_enqueues != tot_successful_dequeues + end_dequeues)
 		printf("WARNING! Discrepancy between nr succ. enqueues %llu vs "
 		       "succ. dequeues + end dequeues %llu.\n",
 		       tot_successful_enqueues,
 		       tot_successful_dequeues + end_dequeues);
 
-	free_all_cpu_call_rcu_data();
+	if (use_hazptr)
+		urcu_hazptr_domain_destroy(domain);
+	else
+		free_all_cpu_call_rcu_data();
 	free(count_enqueuer);
 	free(count_dequeuer);
 	free(tid_enqueuer);
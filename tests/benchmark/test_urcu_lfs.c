@@ -37,6 +37,7 @@
 #include <urcu/arch.h>
 #include <urcu/tls-compat.h>
 #include "cpuset.h"
+#include "bench.h"
 #include "thread-id.h"
 
 /* hardcoded number of CPUs */
@@ -77,7 +78,7 @@ static inline void loop_sleep(unsigned long loops)
 
 static int verbose_mode;
 
-static int test_pop, test_pop_all;
+static int test_pop, test_pop_all, test_elim;
 
 #define printf_verbose(fmt, args...)		\
 	do {					\
@@ -94,7 +95,6 @@ pthread_mutex_t affinity_mutex = PTHREAD_MUTEX_INITIALIZER;
 static void set_affinity(void)
 {
 #if HAVE_SCHED_SETAFFINITY
-	cpu_set_t mask;
 	int cpu, ret;
 #endif /* HAVE_SCHED_SETAFFINITY */
 
@@ -114,13 +114,7 @@ static void set_affinity(void)
 		exit(-1);
 	}
 
-	CPU_ZERO(&mask);
-	CPU_SET(cpu, &mask);
-#if SCHED_SETAFFINITY_ARGS == 2
-	sched_setaffinity(0, &mask);
-#else
-	sched_setaffinity(0, sizeof(mask), &mask);
-#endif
+	bench_pin_cpu(cpu);
 #endif /* HAVE_SCHED_SETAFFINITY */
 }
 
@@ -152,6 +146,7 @@ struct test {
 };
 
 static struct cds_lfs_stack s;
+static struct cds_lfs_elim elim;
 
 static void *thr_enqueuer(void *_count)
 {
@@ -174,7 +169,10 @@ static void *thr_enqueuer(void *_count)
 		if (!node)
 			goto fail;
 		cds_lfs_node_init(&node->list);
-		cds_lfs_push(&s, &node->list);
+		if (test_elim)
+			cds_lfs_push_elim(&s, &elim, &node->list);
+		else
+			cds_lfs_push(&s, &node->list);
 		URCU_TLS(nr_successful_enqueues)++;
 
 		if (caa_unlikely(wdelay))
@@ -213,7 +211,10 @@ void do_test_pop(enum test_sync sync)
 
 	if (sync == TEST_SYNC_RCU)
 		rcu_read_lock();
-	snode = __cds_lfs_pop(&s);
+	if (test_elim)
+		snode = __cds_lfs_pop_elim(&s, &elim);
+	else
+		snode = __cds_lfs_pop(&s);
 	if (sync == TEST_SYNC_RCU)
 		rcu_read_unlock();
 	if (snode) {
@@ -334,7 +335,9 @@ static void show_usage(int argc, char **argv)
 	printf("	[-p] (test pop)\n");
 	printf("	[-P] (test pop_all, enabled by default)\n");
 	printf("	[-R] (use RCU external synchronization)\n");
+	printf("	[-e] (use an elimination array for push and pop)\n");
 	printf("		Note: default: no external synchronization used.\n");
+	printf("	[--format=json|csv] [--output=file] (report format)\n");
 	printf("\n");
 }
 
@@ -343,6 +346,7 @@ int main(int argc, char **argv)
 	int err;
 	pthread_t *tid_enqueuer, *tid_dequeuer;
 	void *tret;
+	struct bench_report *report;
 	unsigned long long *count_enqueuer, *count_dequeuer;
 	unsigned long long tot_enqueues = 0, tot_dequeues = 0;
 	unsigned long long tot_successful_enqueues = 0,
@@ -411,6 +415,9 @@ int main(int argc, char **argv)
 		case 'P':
 			test_pop_all = 1;
 			break;
+		case 'e':
+			test_elim = 1;
+			break;
 		case 'R':
 			test_sync = TEST_SYNC_RCU;
 			break;
@@ -442,11 +449,13 @@ int main(int argc, char **argv)
 	count_enqueuer = calloc(nr_enqueuers, 2 * sizeof(*count_enqueuer));
 	count_dequeuer = calloc(nr_dequeuers, 2 * sizeof(*count_dequeuer));
 	cds_lfs_init(&s);
+	cds_lfs_elim_init(&elim);
 	err = create_all_cpu_call_rcu_data(0);
 	if (err) {
 		printf("Per-CPU call_rcu() worker threads unavailable. Using default global worker thread.\n");
 	}
 
+	report = bench_report_create(argc, argv);
 	next_aff = 0;
 
 	for (i_thr = 0; i_thr < nr_enqueuers; i_thr++) {
@@ -464,6 +473,7 @@ int main(int argc, char **argv)
 
 	cmm_smp_mb();
 
+	bench_report_start(report);
 	test_go = 1;
 
 	for (i_thr = 0; i_thr < duration; i_thr++) {
@@ -474,6 +484,7 @@ int main(int argc, char **argv)
 		}
 	}
 
+	bench_report_stop(report);
 	test_stop = 1;
 
 	for (i_thr = 0; i_thr < nr_enqueuers; i_thr++) {
@@ -481,6 +492,7 @@ int main(int argc, char **argv)
 		if (err != 0)
 			exit(1);
 		tot_enqueues += count_enqueuer[2 * i_thr];
+		bench_report_thread(report, "enqueuer", count_enqueuer[2 * i_thr]);
 		tot_successful_enqueues += count_enqueuer[2 * i_thr + 1];
 	}
 	for (i_thr = 0; i_thr < nr_dequeuers; i_thr++) {
@@ -488,6 +500,7 @@ int main(int argc, char **argv)
 		if (err != 0)
 			exit(1);
 		tot_dequeues += count_dequeuer[2 * i_thr];
+		bench_report_thread(report, "dequeuer", count_dequeuer[2 * i_thr]);
 		tot_successful_dequeues += count_dequeuer[2 * i_thr + 1];
 	}
 
@@ -508,6 +521,17 @@ int main(int argc, char **argv)
 		tot_successful_enqueues,
 		tot_successful_dequeues, end_dequeues,
 		tot_enqueues + tot_dequeues);
+	bench_report_param(report, "duration", duration);
+	bench_report_param(report, "nr_enqueuers", nr_enqueuers);
+	bench_report_param(report, "wdelay", wdelay);
+	bench_report_param(report, "nr_dequeuers", nr_dequeuers);
+	bench_report_param(report, "rduration", rduration);
+	bench_report_param(report, "nr_enqueues", tot_enqueues);
+	bench_report_param(report, "nr_dequeues", tot_dequeues);
+	bench_report_param(report, "nr_successful_enqueues", tot_successful_enqueues);
+	bench_report_param(report, "nr_successful_dequeues", tot_successful_dequeues);
+	bench_report_param(report, "end_dequeues", end_dequeues);
+	bench_report_destroy(report);
 	if (tot_successful_enqueues != tot_successful_dequeues + end_dequeues)
 		printf("WARNING! Discrepancy between nr succ. enqueues %llu vs "
 		       "succ. dequeues + end dequeues %llu.\n",
@@ -37,6 +37,7 @@
 #include <urcu/arch.h>
 #include <urcu/tls-compat.h>
 #include "cpuset.h"
+#include "bench.h"
 #include "thread-id.h"
 
 /* hardcoded number of CPUs */
@@ -84,7 +85,6 @@ pthread_mutex_t affinity_mutex = PTHREAD_MUTEX_INITIALIZER;
 static void set_affinity(void)
 {
 #if HAVE_SCHED_SETAFFINITY
-	cpu_set_t mask;
 	int cpu, ret;
 #endif /* HAVE_SCHED_SETAFFINITY */
 
@@ -104,13 +104,7 @@ static void set_affinity(void)
 		exit(-1);
 	}
 
-	CPU_ZERO(&mask);
-	CPU_SET(cpu, &mask);
-#if SCHED_SETAFFINITY_ARGS == 2
-	sched_setaffinity(0, &mask);
-#else
-	sched_setaffinity(0, sizeof(mask), &mask);
-#endif
+	bench_pin_cpu(cpu);
 #endif /* HAVE_SCHED_SETAFFINITY */
 }
 
@@ -270,6 +264,7 @@ void show_usage(int argc, char **argv)
 	printf("	[-c duration] (dequeuer period (in loops))\n");
 	printf("	[-v] (verbose output)\n");
 	printf("	[-a cpu#] [-a cpu#]... (affinity)\n");
+	printf("	[--format=json|csv] [--output=file] (report format)\n");
 	printf("\n");
 }
 
@@ -278,6 +273,7 @@ int main(int argc, char **argv)
 	int err;
 	pthread_t *tid_enqueuer, *tid_dequeuer;
 	void *tret;
+	struct bench_report *report;
 	unsigned long long *count_enqueuer, *count_dequeuer;
 	unsigned long long tot_enqueues = 0, tot_dequeues = 0;
 	unsigned long long tot_successful_enqueues = 0,
@@ -361,6 +357,7 @@ int main(int argc, char **argv)
 		printf("Per-CPU call_rcu() worker threads unavailable. Using default global worker thread.\n");
 	}
 
+	report = bench_report_create(argc, argv);
 	next_aff = 0;
 
 	for (i_thr = 0; i_thr < nr_enqueuers; i_thr++) {
@@ -378,6 +375,7 @@ int main(int argc, char **argv)
 
 	cmm_smp_mb();
 
+	bench_report_start(report);
 	test_go = 1;
 
 	for (i_thr = 0; i_thr < duration; i_thr++) {
@@ -388,6 +386,7 @@ int main(int argc, char **argv)
 		}
 	}
 
+	bench_report_stop(report);
 	test_stop = 1;
 
 	for (i_thr = 0; i_thr < nr_enqueuers; i_thr++) {
@@ -395,6 +394,7 @@ int main(int argc, char **argv)
 		if (err != 0)
 			exit(1);
 		tot_enqueues += count_enqueuer[2 * i_thr];
+		bench_report_thread(report, "enqueuer", count_enqueuer[2 * i_thr]);
 		tot_successful_enqueues += count_enqueuer[2 * i_thr + 1];
 	}
 	for (i_thr = 0; i_thr < nr_dequeuers; i_thr++) {
@@ -402,6 +402,7 @@ int main(int argc, char **argv)
 		if (err != 0)
 			exit(1);
 		tot_dequeues += count_dequeuer[2 * i_thr];
+		bench_report_thread(report, "dequeuer", count_dequeuer[2 * i_thr]);
 		tot_successful_dequeues += count_dequeuer[2 * i_thr + 1];
 	}
 
@@ -422,6 +423,17 @@ int main(int argc, char **argv)
 		tot_successful_enqueues,
 		tot_successful_dequeues, end_dequeues,
 		tot_enqueues + tot_dequeues);
+	bench_report_param(report, "duration", duration);
+	bench_report_param(report, "nr_enqueuers", nr_enqueuers);
+	bench_report_param(report, "wdelay", wdelay);
+	bench_report_param(report, "nr_dequeuers", nr_dequeuers);
+	bench_report_param(report, "rduration", rduration);
+	bench_report_param(report, "nr_enqueues", tot_enqueues);
+	bench_report_param(report, "nr_dequeues", tot_dequeues);
+	bench_report_param(report, "nr_successful_enqueues", tot_successful_enqueues);
+	bench_report_param(report, "nr_successful_dequeues", tot_successful_dequeues);
+	bench_report_param(report, "end_dequeues", end_dequeues);
+	bench_report_destroy(report);
 	if (tot_successful_enqueues != tot_successful_dequeues + end_dequeues)
 		printf("WARNING! Discrepancy between nr succ. enqueues %llu vs "
 		       "succ. dequeues + end dequeues %llu.\n",
@@ -0,0 +1,397 @@
+/*
+ * test_urcu_micro.c
+ *
+ * Userspace RCU library - primitive microbenchmarks
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+/*
+ * Cost of the single-threaded fast path of each hot primitive, in
+ * timestamp counter cycles and nanoseconds: read-side critical
+ * sections, inlined (LGPL) and called through the library, and the
+ * QSBR quiescent states and offline periods, for the flavor the program
+ * is built with, and the uatomic operations of the architecture, queue
+ * and stack operations and hash table lookups.
+ *
+ * Each primitive runs in batches of MICRO_BATCH executions between two
+ * serialized timestamps, with untimed setup and teardown around each
+ * batch. The cost of the empty loop is subtracted, and the minimum and
+ * median over the batches are reported: the minimum is the cost of
+ * the primitive with warm caches and no interruption, and tracks
+ * regressions of a few cycles that throughput benchmarks hide. Both
+ * depend on the CPU the program runs on: pin it with -a.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+
+#include <urcu/arch.h>
+#include "cpuset.h"
+#include "bench.h"
+
+#define _LGPL_SOURCE
+#if defined(RCU_QSBR)
+#include <urcu-qsbr.h>
+#elif defined(RCU_BP)
+#include <urcu-bp.h>
+#elif defined(RCU_PERCPU)
+#include <urcu-percpu.h>
+#else
+#include <urcu.h>
+#endif
+#include <urcu/wfcqueue.h>
+#include <urcu/lfstack.h>
+#include <urcu/rculfhash.h>
+
+#define MICRO_BATCH		1024
+#define MICRO_DEFAULT_RUNS	201
+#define MICRO_MAX_RESULTS	32
+#define MICRO_HT_NODES		MICRO_BATCH
+#define MICRO_CALIBRATE_S	0.05
+
+struct micro_result {
+	const char *name;
+	double min, median;	/* Cycles per execution. */
+	char key_ps[64], key_mcycles[64];
+};
+
+struct micro_ht_node {
+	struct cds_lfht_node node;
+	unsigned long key;
+};
+
+static unsigned long nr_runs = MICRO_DEFAULT_RUNS;
+static caa_cycles_t *samples;
+static double loop_min, loop_median, cycles_per_ns;
+static struct micro_result results[MICRO_MAX_RESULTS];
+static unsigned int nr_results;
+
+/* Keep the results of the measured operations alive. */
+static volatile unsigned long sink;
+static unsigned long counter;
+static void *ptr = &counter;
+
+static struct __cds_wfcq_head wfcq_head;
+static struct cds_wfcq_tail wfcq_tail;
+static struct cds_wfcq_node wfcq_nodes[MICRO_BATCH];
+static struct __cds_lfs_stack lfs_stack;
+static struct cds_lfs_node lfs_nodes[MICRO_BATCH];
+static struct cds_lfht *ht;
+static struct micro_ht_node ht_nodes[MICRO_HT_NODES];
+
+/*
+ * Timestamps ordered with the instructions around them, so that a batch
+ * is not measured before it starts nor after it ends.
+ */
+static inline caa_cycles_t micro_cycles(void)
+{
+#if defined(__x86_64__) || (defined(__i386__) && defined(__SSE2__))
+	unsigned int a, d;
+
+	__asm__ __volatile__ ("lfence\n\trdtsc\n\tlfence"
+			: "=a" (a), "=d" (d) : : "memory");
+	return ((caa_cycles_t) d << 32) | a;
+#else
+	caa_cycles_t t;
+
+	cmm_smp_mb();
+	t = caa_get_cycles();
+	cmm_smp_mb();
+	return t;
+#endif
+}
+
+/*
+ * Run nr_runs batches of MICRO_BATCH executions of op, which may use
+ * the index micro_i of the execution in the batch, and record the cycles
+ * of each batch. setup and teardown run around each batch, untimed.
+ */
+#define MICRO_MEASURE(name, setup, op, teardown)			\
+	do {								\
+		caa_cycles_t _start;					\
+		unsigned long _run, micro_i;				\
+									\
+		for (_run = 0; _run < nr_runs; _run++) {		\
+			setup;						\
+			_start = micro_cycles();			\
+			for (micro_i = 0; micro_i < MICRO_BATCH;	\
+					micro_i++) {			\
+				op;					\
+				cmm_barrier();				\
+			}						\
+			samples[_run] = micro_cycles() - _start;	\
+			teardown;					\
+		}							\
+		micro_record(name);					\
+	} while (0)
+
+static int cmp_cycles(const void *a, const void *b)
+{
+	caa_cycles_t ca = *(const caa_cycles_t *) a;
+	caa_cycles_t cb = *(const caa_cycles_t *) b;
+
+	return (ca > cb) - (ca < cb);
+}
+
+static void micro_record(const char *name)
+{
+	struct micro_result *r;
+	double min, median;
+
+	qsort(samples, nr_runs, sizeof(*samples), cmp_cycles);
+	min = (double) samples[0] / MICRO_BATCH;
+	median = (double) samples[nr_runs / 2] / MICRO_BATCH;
+	if (!name) {
+		loop_min = min;
+		loop_median = median;
+		return;
+	}
+	if (nr_results == MICRO_MAX_RESULTS)
+		abort();
+	r = &results[nr_results++];
+	r->name = name;
+	r->min = min > loop_min ? min - loop_min : 0;
+	r->median = median > loop_median ? median - loop_median : 0;
+}
+
+/* Timestamp counter cycles per nanosecond. */
+static double micro_calibrate(void)
+{
+	caa_cycles_t c0, c1;
+	double t0, t1;
+
+	t0 = bench_now();
+	c0 = micro_cycles();
+	do {
+		t1 = bench_now();
+	} while (t1 - t0 < MICRO_CALIBRATE_S);
+	c1 = micro_cycles();
+	return (double) (c1 - c0) / ((t1 - t0) * 1e9);
+}
+
+static unsigned long micro_hash(unsigned long key)
+{
+	return key * 2654435761UL ^ (key << (CAA_BITS_PER_LONG - 8));
+}
+
+static int micro_match(struct cds_lfht_node *node, const void *key)
+{
+	struct micro_ht_node *n = caa_container_of(node,
+			struct micro_ht_node, node);
+
+	return n->key == *(const unsigned long *) key;
+}
+
+static struct cds_lfht_node *micro_lookup(unsigned long key)
+{
+	struct cds_lfht_iter iter;
+
+	cds_lfht_lookup(ht, micro_hash(key), micro_match, &key, &iter);
+	return cds_lfht_iter_get_node(&iter);
+}
+
+static void micro_ht_init(void)
+{
+	unsigned long i;
+
+	ht = cds_lfht_new(MICRO_HT_NODES, 1, 0, 0, NULL);
+	if (!ht)
+		abort();
+	rcu_read_lock();
+	for (i = 0; i < MICRO_HT_NODES; i++) {
+		cds_lfht_node_init(&ht_nodes[i].node);
+		ht_nodes[i].key = i;
+		cds_lfht_add(ht, micro_hash(i), &ht_nodes[i].node);
+	}
+	rcu_read_unlock();
+}
+
+static void micro_ht_fini(void)
+{
+	unsigned long i;
+
+	rcu_read_lock();
+	for (i = 0; i < MICRO_HT_NODES; i++)
+		(void) cds_lfht_del(ht, &ht_nodes[i].node);
+	rcu_read_unlock();
+	if (cds_lfht_destroy(ht, NULL))
+		abort();
+}
+
+static void micro_wfcq_init(void)
+{
+	unsigned long i;
+
+	__cds_wfcq_init(&wfcq_head, &wfcq_tail);
+	for (i = 0; i < MICRO_BATCH; i++)
+		cds_wfcq_node_init(&wfcq_nodes[i]);
+}
+
+static void micro_lfs_fill(void)
+{
+	unsigned long i;
+
+	__cds_lfs_init(&lfs_stack);
+	for (i = 0; i < MICRO_BATCH; i++)
+		(void) cds_lfs_push(&lfs_stack, &lfs_nodes[i]);
+}
+
+static void micro_run(void)
+{
+	/* Empty loop, subtracted from the others. */
+	MICRO_MEASURE(NULL, , , );
+
+	MICRO_MEASURE("read_lock_unlock", ,
+		rcu_read_lock(); rcu_read_unlock(), );
+	MICRO_MEASURE("read_lock_unlock_call", ,
+		rcu_flavor.read_lock(); rcu_flavor.read_unlock(), );
+	MICRO_MEASURE("read_lock_unlock_nested", rcu_read_lock(),
+		rcu_read_lock(); rcu_read_unlock(), rcu_read_unlock());
+	MICRO_MEASURE("rcu_dereference", rcu_read_lock(),
+		sink = (unsigned long) rcu_dereference(ptr),
+		rcu_read_unlock());
+#ifdef RCU_QSBR
+	MICRO_MEASURE("quiescent_state", , rcu_quiescent_state(), );
+	MICRO_MEASURE("quiescent_state_call", ,
+		rcu_flavor.read_quiescent_state(), );
+	MICRO_MEASURE("thread_offline_online", ,
+		rcu_thread_offline(); rcu_thread_online(), );
+	MICRO_MEASURE("thread_offline_online_call", ,
+		rcu_flavor.thread_offline(); rcu_flavor.thread_online(), );
+#endif
+
+	MICRO_MEASURE("uatomic_read", , sink = uatomic_read(&counter), );
+	MICRO_MEASURE("uatomic_set", , uatomic_set(&counter, micro_i), );
+	MICRO_MEASURE("uatomic_add", , uatomic_add(&counter, 2), );
+	MICRO_MEASURE("uatomic_inc", , uatomic_inc(&counter), );
+	MICRO_MEASURE("uatomic_add_return", ,
+		sink = uatomic_add_return(&counter, 2), );
+	MICRO_MEASURE("uatomic_xchg", ,
+		sink = uatomic_xchg(&counter, micro_i), );
+	MICRO_MEASURE("uatomic_cmpxchg", uatomic_set(&counter, 0),
+		sink = uatomic_cmpxchg(&counter, micro_i, micro_i + 1), );
+	MICRO_MEASURE("cmm_smp_mb", , cmm_smp_mb(), );
+
+	MICRO_MEASURE("wfcq_enqueue", micro_wfcq_init(),
+		(void) cds_wfcq_enqueue(&wfcq_head, &wfcq_tail,
+			&wfcq_nodes[micro_i]), );
+	MICRO_MEASURE("lfs_push", __cds_lfs_init(&lfs_stack),
+		(void) cds_lfs_push(&lfs_stack, &lfs_nodes[micro_i]), );
+	MICRO_MEASURE("lfs_pop", micro_lfs_fill(),
+		sink = (unsigned long) __cds_lfs_pop(&lfs_stack), );
+
+	micro_ht_init();
+	MICRO_MEASURE("lfht_lookup_hit", rcu_read_lock(),
+		sink = (unsigned long) micro_lookup(micro_i),
+		rcu_read_unlock());
+	MICRO_MEASURE("lfht_lookup_miss", rcu_read_lock(),
+		sink = (unsigned long) micro_lookup(micro_i + MICRO_HT_NODES),
+		rcu_read_unlock());
+	micro_ht_fini();
+}
+
+static void show_usage(int argc, char **argv)
+{
+	printf("Usage : %s <OPTIONS>\n", argv[0]);
+	printf("OPTIONS:\n");
+	printf("	[-r runs] (batches per primitive, default %d)\n",
+		MICRO_DEFAULT_RUNS);
+	printf("	[-a cpu#] (affinity)\n");
+	printf("	[--format=json|csv] [--output=file] (report format)\n");
+	printf("\n");
+}
+
+int main(int argc, char **argv)
+{
+	struct bench_report *report;
+	struct micro_result *r;
+	unsigned int i;
+	int a;
+
+	for (i = 1; i < (unsigned int) argc; i++) {
+		if (argv[i][0] != '-' || argv[i][1] == '-')
+			continue;
+		switch (argv[i][1]) {
+		case 'a':
+			if ((unsigned int) argc < i + 2) {
+				show_usage(argc, argv);
+				return -1;
+			}
+			a = atoi(argv[++i]);
+			bench_pin_cpu(a);
+			break;
+		case 'r':
+			if ((unsigned int) argc < i + 2) {
+				show_usage(argc, argv);
+				return -1;
+			}
+			nr_runs = atol(argv[++i]);
+			if (!nr_runs) {
+				show_usage(argc, argv);
+				return -1;
+			}
+			break;
+		default:
+			show_usage(argc, argv);
+			return -1;
+		}
+	}
+
+	samples = calloc(nr_runs, sizeof(*samples));
+	if (!samples) {
+		perror("calloc");
+		return -1;
+	}
+	report = bench_report_create(argc, argv);
+	rcu_register_thread();
+	cycles_per_ns = micro_calibrate();
+	bench_report_start(report);
+	micro_run();
+	bench_report_stop(report);
+	rcu_unregister_thread();
+
+	if (report->format == BENCH_FORMAT_SUMMARY) {
+		printf("%-28s %12s %12s %10s %10s\n", "primitive",
+			"cycles_min", "cycles_p50", "ns_min", "ns_p50");
+		for (i = 0; i < nr_results; i++) {
+			r = &results[i];
+			printf("%-28s %12.2f %12.2f %10.2f %10.2f\n", r->name,
+				r->min, r->median, r->min / cycles_per_ns,
+				r->median / cycles_per_ns);
+		}
+		printf("(%lu batches of %d, %.3f cycles per ns, "
+			"empty loop %.2f cycles)\n", nr_runs, MICRO_BATCH,
+			cycles_per_ns, loop_min);
+	}
+	/* Parameters are integers: median picoseconds and millicycles. */
+	bench_report_param(report, "nr_runs", nr_runs);
+	bench_report_param(report, "batch", MICRO_BATCH);
+	for (i = 0; i < nr_results; i++) {
+		r = &results[i];
+		snprintf(r->key_ps, sizeof(r->key_ps), "%s_ps", r->name);
+		snprintf(r->key_mcycles, sizeof(r->key_mcycles),
+			"%s_mcycles", r->name);
+		bench_report_param(report, r->key_ps,
+			(long long) (r->median * 1000 / cycles_per_ns));
+		bench_report_param(report, r->key_mcycles,
+			(long long) (r->median * 1000));
+	}
+	bench_report_destroy(report);
+	free(samples);
+	return 0;
+}
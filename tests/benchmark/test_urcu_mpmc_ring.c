@@ -0,0 +1,471 @@
+/*
+ * test_urcu_mpmc_ring.c
+ *
+ * Userspace RCU library - bounded lock-free MPMC ring benchmark
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#include <stdio.h>
+#include <pthread.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+#include <sys/types.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#include <stdio.h>
+#include <assert.h>
+#include <errno.h>
+
+#include <urcu/arch.h>
+#include <urcu/tls-compat.h>
+#include <urcu/uatomic.h>
+#include "cpuset.h"
+#include "bench.h"
+#include "thread-id.h"
+
+/* hardcoded number of CPUs */
+#define NR_CPUS 16384
+
+#ifndef DYNAMIC_LINK_TEST
+#define _LGPL_SOURCE
+#endif
+#include <urcu/mpmcring.h>
+
+/* Default ring capacity is 2^DEFAULT_RING_ORDER slots. */
+#define DEFAULT_RING_ORDER	10
+#define MAX_BATCH		64
+
+static volatile int test_go, test_stop_enqueue, test_stop_dequeue;
+
+static unsigned long rduration;
+
+static unsigned long duration;
+
+/* read-side C.S. duration, in loops */
+static unsigned long wdelay;
+
+static inline void loop_sleep(unsigned long loops)
+{
+	while (loops-- != 0)
+		caa_cpu_relax();
+}
+
+static int verbose_mode;
+
+static int test_wait_empty;
+static unsigned long batch = 1, ring_order = DEFAULT_RING_ORDER;
+static unsigned int test_enqueue_stopped;
+
+#define printf_verbose(fmt, args...)		\
+	do {					\
+		if (verbose_mode)		\
+			printf(fmt, ## args);	\
+	} while (0)
+
+static unsigned int cpu_affinities[NR_CPUS];
+static unsigned int next_aff = 0;
+static int use_affinity = 0;
+
+pthread_mutex_t affinity_mutex = PTHREAD_MUTEX_INITIALIZER;
+
+static void set_affinity(void)
+{
+#if HAVE_SCHED_SETAFFINITY
+	int cpu, ret;
+#endif /* HAVE_SCHED_SETAFFINITY */
+
+	if (!use_affinity)
+		return;
+
+#if HAVE_SCHED_SETAFFINITY
+	ret = pthread_mutex_lock(&affinity_mutex);
+	if (ret) {
+		perror("Error in pthread mutex lock");
+		exit(-1);
+	}
+	cpu = cpu_affinities[next_aff++];
+	ret = pthread_mutex_unlock(&affinity_mutex);
+	if (ret) {
+		perror("Error in pthread mutex unlock");
+		exit(-1);
+	}
+
+	bench_pin_cpu(cpu);
+#endif /* HAVE_SCHED_SETAFFINITY */
+}
+
+/*
+ * returns 0 if test should end.
+ */
+static int test_duration_dequeue(void)
+{
+	return !test_stop_dequeue;
+}
+
+static int test_duration_enqueue(void)
+{
+	return !test_stop_enqueue;
+}
+
+static DEFINE_URCU_TLS(unsigned long long, nr_dequeues);
+static DEFINE_URCU_TLS(unsigned long long, nr_enqueues);
+
+static DEFINE_URCU_TLS(unsigned long long, nr_successful_dequeues);
+static DEFINE_URCU_TLS(unsigned long long, nr_successful_enqueues);
+
+static unsigned int nr_enqueuers;
+static unsigned int nr_dequeuers;
+
+static struct cds_mpmc_ring ring;
+static struct cds_mpmc_ring_slot *slots;
+
+/*
+ * Elements are tokens rather than allocated nodes: the ring stores
+ * pointers, and needs no per-element allocation.
+ */
+static void *thr_enqueuer(void *_count)
+{
+	unsigned long long *count = _count;
+	void *data[MAX_BATCH];
+	unsigned long i, n;
+
+	printf_verbose("thread_begin %s, tid %lu\n",
+			"enqueuer", urcu_get_thread_id());
+
+	set_affinity();
+
+	for (i = 0; i < batch; i++)
+		data[i] = (void *) (i + 1);
+
+	while (!test_go)
+	{
+	}
+	cmm_smp_mb();
+
+	for (;;) {
+		if (batch == 1)
+			n = cds_mpmc_ring_try_enqueue(&ring, data[0]);
+		else
+			n = cds_mpmc_ring_enqueue_bulk(&ring, data, batch);
+		URCU_TLS(nr_successful_enqueues) += n;
+
+		if (caa_unlikely(wdelay))
+			loop_sleep(wdelay);
+		URCU_TLS(nr_enqueues)++;
+		if (caa_unlikely(!test_duration_enqueue()))
+			break;
+	}
+
+	uatomic_inc(&test_enqueue_stopped);
+	count[0] = URCU_TLS(nr_enqueues);
+	count[1] = URCU_TLS(nr_successful_enqueues);
+	printf_verbose("enqueuer thread_end, tid %lu, "
+			"enqueues %llu successful_enqueues %llu\n",
+			urcu_get_thread_id(),
+			URCU_TLS(nr_enqueues),
+			URCU_TLS(nr_successful_enqueues));
+	return ((void*)1);
+
+}
+
+static void *thr_dequeuer(void *_count)
+{
+	unsigned long long *count = _count;
+	void *data[MAX_BATCH];
+	unsigned long n;
+
+	printf_verbose("thread_begin %s, tid %lu\n",
+			"dequeuer", urcu_get_thread_id());
+
+	set_affinity();
+
+	while (!test_go)
+	{
+	}
+	cmm_smp_mb();
+
+	for (;;) {
+		if (batch == 1)
+			n = cds_mpmc_ring_try_dequeue(&ring, &data[0]);
+		else
+			n = cds_mpmc_ring_dequeue_bulk(&ring, data, batch);
+		URCU_TLS(nr_successful_dequeues) += n;
+		URCU_TLS(nr_dequeues)++;
+		if (caa_unlikely(!test_duration_dequeue()))
+			break;
+		if (caa_unlikely(rduration))
+			loop_sleep(rduration);
+	}
+
+	printf_verbose("dequeuer thread_end, tid %lu, "
+			"dequeues %llu, successful_dequeues %llu\n",
+			urcu_get_thread_id(),
+			URCU_TLS(nr_dequeues), URCU_TLS(nr_successful_dequeues));
+	count[0] = URCU_TLS(nr_dequeues);
+	count[1] = URCU_TLS(nr_successful_dequeues);
+	return ((void*)2);
+}
+
+static void test_end(unsigned long long *nr_dequeues)
+{
+	void *data;
+
+	while (cds_mpmc_ring_try_dequeue(&ring, &data))
+		(*nr_dequeues)++;
+}
+
+static void show_usage(int argc, char **argv)
+{
+	printf("Usage : %s nr_dequeuers nr_enqueuers duration (s) <OPTIONS>\n",
+		argv[0]);
+	printf("OPTIONS:\n");
+	printf("	[-d delay] (enqueuer period (in loops))\n");
+	printf("	[-c duration] (dequeuer period (in loops))\n");
+	printf("	[-v] (verbose output)\n");
+	printf("	[-a cpu#] [-a cpu#]... (affinity)\n");
+	printf("	[-b size] (batch size, 1 to %d, default 1)\n",
+		MAX_BATCH);
+	printf("	[-r order] (ring capacity is 2^order, default %d)\n",
+		DEFAULT_RING_ORDER);
+	printf("	[-w] Wait for dequeuer to empty queue\n");
+	printf("	[--format=json|csv] [--output=file] (report format)\n");
+	printf("\n");
+}
+
+int main(int argc, char **argv)
+{
+	int err;
+	pthread_t *tid_enqueuer, *tid_dequeuer;
+	void *tret;
+	struct bench_report *report;
+	unsigned long long *count_enqueuer, *count_dequeuer;
+	unsigned long long tot_enqueues = 0, tot_dequeues = 0;
+	unsigned long long tot_successful_enqueues = 0,
+			   tot_successful_dequeues = 0;
+	unsigned long long end_dequeues = 0;
+	int i, a, retval = 0;
+	unsigned int i_thr;
+
+	if (argc < 4) {
+		show_usage(argc, argv);
+		return -1;
+	}
+
+	err = sscanf(argv[1], "%u", &nr_dequeuers);
+	if (err != 1) {
+		show_usage(argc, argv);
+		return -1;
+	}
+
+	err = sscanf(argv[2], "%u", &nr_enqueuers);
+	if (err != 1) {
+		show_usage(argc, argv);
+		return -1;
+	}
+
+	err = sscanf(argv[3], "%lu", &duration);
+	if (err != 1) {
+		show_usage(argc, argv);
+		return -1;
+	}
+
+	for (i = 4; i < argc; i++) {
+		if (argv[i][0] != '-')
+			continue;
+		switch (argv[i][1]) {
+		case 'a':
+			if (argc < i + 2) {
+				show_usage(argc, argv);
+				return -1;
+			}
+			a = atoi(argv[++i]);
+			cpu_affinities[next_aff++] = a;
+			use_affinity = 1;
+			printf_verbose("Adding CPU %d affinity\n", a);
+			break;
+		case 'c':
+			if (argc < i + 2) {
+				show_usage(argc, argv);
+				return -1;
+			}
+			rduration = atol(argv[++i]);
+			break;
+		case 'd':
+			if (argc < i + 2) {
+				show_usage(argc, argv);
+				return -1;
+			}
+			wdelay = atol(argv[++i]);
+			break;
+		case 'b':
+			if (argc < i + 2) {
+				show_usage(argc, argv);
+				return -1;
+			}
+			batch = atol(argv[++i]);
+			break;
+		case 'r':
+			if (argc < i + 2) {
+				show_usage(argc, argv);
+				return -1;
+			}
+			ring_order = atol(argv[++i]);
+			break;
+		case 'v':
+			verbose_mode = 1;
+			break;
+		case 'w':
+			test_wait_empty = 1;
+			break;
+		}
+	}
+
+	if (batch < 1 || batch > MAX_BATCH || ring_order < 1
+			|| ring_order >= CAA_BITS_PER_LONG) {
+		show_usage(argc, argv);
+		return -1;
+	}
+
+	printf_verbose("running test for %lu seconds, %u enqueuers, "
+		       "%u dequeuers.\n",
+		       duration, nr_enqueuers, nr_dequeuers);
+	printf_verbose("Ring capacity : %lu, batch : %lu.\n",
+		       1UL << ring_order, batch);
+	if (test_wait_empty)
+		printf_verbose("Wait for dequeuers to empty queue.\n");
+	printf_verbose("Writer delay : %lu loops.\n", rduration);
+	printf_verbose("Reader duration : %lu loops.\n", wdelay);
+	printf_verbose("thread %-6s, tid %lu\n",
+			"main", urcu_get_thread_id());
+
+	tid_enqueuer = calloc(nr_enqueuers, sizeof(*tid_enqueuer));
+	tid_dequeuer = calloc(nr_dequeuers, sizeof(*tid_dequeuer));
+	count_enqueuer = calloc(nr_enqueuers, 2 * sizeof(*count_enqueuer));
+	count_dequeuer = calloc(nr_dequeuers, 2 * sizeof(*count_dequeuer));
+	slots = calloc(1UL << ring_order, sizeof(*slots));
+	if (!slots || cds_mpmc_ring_init(&ring, slots, 1UL << ring_order))
+		exit(1);
+
+	report = bench_report_create(argc, argv);
+	next_aff = 0;
+
+	for (i_thr = 0; i_thr < nr_enqueuers; i_thr++) {
+		err = pthread_create(&tid_enqueuer[i_thr], NULL, thr_enqueuer,
+				     &count_enqueuer[2 * i_thr]);
+		if (err != 0)
+			exit(1);
+	}
+	for (i_thr = 0; i_thr < nr_dequeuers; i_thr++) {
+		err = pthread_create(&tid_dequeuer[i_thr], NULL, thr_dequeuer,
+				     &count_dequeuer[2 * i_thr]);
+		if (err != 0)
+			exit(1);
+	}
+
+	cmm_smp_mb();
+
+	bench_report_start(report);
+	test_go = 1;
+
+	for (i_thr = 0; i_thr < duration; i_thr++) {
+		sleep(1);
+		if (verbose_mode) {
+			fwrite(".", sizeof(char), 1, stdout);
+			fflush(stdout);
+		}
+	}
+
+	bench_report_stop(report);
+	test_stop_enqueue = 1;
+
+	if (test_wait_empty) {
+		while (nr_enqueuers != uatomic_read(&test_enqueue_stopped)) {
+			sleep(1);
+		}
+		while (uatomic_read(&ring.dequeue_pos)
+				!= uatomic_read(&ring.enqueue_pos)) {
+			sleep(1);
+		}
+	}
+
+	test_stop_dequeue = 1;
+
+	for (i_thr = 0; i_thr < nr_enqueuers; i_thr++) {
+		err = pthread_join(tid_enqueuer[i_thr], &tret);
+		if (err != 0)
+			exit(1);
+		tot_enqueues += count_enqueuer[2 * i_thr];
+		bench_report_thread(report, "enqueuer", count_enqueuer[2 * i_thr]);
+		tot_successful_enqueues += count_enqueuer[2 * i_thr + 1];
+	}
+	for (i_thr = 0; i_thr < nr_dequeuers; i_thr++) {
+		err = pthread_join(tid_dequeuer[i_thr], &tret);
+		if (err != 0)
+			exit(1);
+		tot_dequeues += count_dequeuer[2 * i_thr];
+		bench_report_thread(report, "dequeuer", count_dequeuer[2 * i_thr]);
+		tot_successful_dequeues += count_dequeuer[2 * i_thr + 1];
+	}
+
+	test_end(&end_dequeues);
+
+	printf_verbose("total number of enqueues : %llu, dequeues %llu\n",
+		       tot_enqueues, tot_dequeues);
+	printf_verbose("total number of successful enqueues : %llu, "
+		       "successful dequeues %llu\n",
+		       tot_successful_enqueues,
+		       tot_successful_dequeues);
+	printf("SUMMARY %-25s testdur %4lu nr_enqueuers %3u wdelay %6lu "
+		"nr_dequeuers %3u "
+		"rdur %6lu nr_enqueues %12llu nr_dequeues %12llu "
+		"successful enqueues %12llu "
+		"successful dequeues %12llu "
+		"end_dequeues %llu nr_ops %12llu\n",
+		argv[0], duration, nr_enqueuers, wdelay,
+		nr_dequeuers, rduration, tot_enqueues, tot_dequeues,
+		tot_successful_enqueues,
+		tot_successful_dequeues,
+		end_dequeues,
+		tot_enqueues + tot_dequeues);
+	bench_report_param(report, "duration", duration);
+	bench_report_param(report, "nr_enqueuers", nr_enqueuers);
+	bench_report_param(report, "wdelay", wdelay);
+	bench_report_param(report, "nr_dequeuers", nr_dequeuers);
+	bench_report_param(report, "rduration", rduration);
+	bench_report_param(report, "nr_enqueues", tot_enqueues);
+	bench_report_param(report, "nr_dequeues", tot_dequeues);
+	bench_report_param(report, "nr_successful_enqueues", tot_successful_enqueues);
+	bench_report_param(report, "nr_successful_dequeues", tot_successful_dequeues);
+	bench_report_param(report, "end_dequeues", end_dequeues);
+	bench_report_destroy(report);
+
+	if (tot_successful_enqueues != tot_successful_dequeues + end_dequeues) {
+		printf("WARNING! Discrepancy between nr succ. enqueues %llu vs "
+		       "succ. dequeues + end dequeues %llu.\n",
+		       tot_successful_enqueues,
+		       tot_successful_dequeues + end_dequeues);
+		retval = 1;
+	}
+	free(slots);
+	free(count_enqueuer);
+	free(count_dequeuer);
+	free(tid_enqueuer);
+	free(tid_dequeuer);
+
+	return retval;
+}
@@ -0,0 +1,792 @@
+/*
+ * test_urcu_oversub.c
+ *
+ * Userspace RCU library - oversubscription and preemption benchmark
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+/*
+ * Readers and updaters run as in test_urcu_gp, with more runnable
+ * threads than CPUs: -o sets the number of readers to a multiple of the
+ * CPUs the process may run on, which -n restricts, and -h adds CPU hogs
+ * running without RCU, optionally under SCHED_IDLE or SCHED_BATCH (-p).
+ * Preempted readers delay grace periods, and -Q adds wfcqueue and
+ * wfstack producers along with a consumer for each: a producer preempted
+ * within an enqueue or push leaves the consumer waiting for its node to
+ * be linked. Each operation lasting at least the stall threshold (-t,
+ * 10 ms by default) counts as a stall incident.
+ */
+
+#include <stdio.h>
+#include <pthread.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sched.h>
+#include <sys/types.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#include <assert.h>
+#include <errno.h>
+
+#include <urcu/arch.h>
+#include <urcu/tls-compat.h>
+#include <urcu/uatomic.h>
+#include <urcu/wfcqueue.h>
+#include <urcu/wfstack.h>
+#include "cpuset.h"
+#include "bench.h"
+#include "thread-id.h"
+
+/* hardcoded number of CPUs */
+#define NR_CPUS 16384
+
+#ifndef DYNAMIC_LINK_TEST
+#define _LGPL_SOURCE
+#endif
+#if defined(RCU_QSBR)
+#include <urcu-qsbr.h>
+#elif defined(RCU_BP)
+#include <urcu-bp.h>
+#elif defined(RCU_PERCPU)
+#include <urcu-percpu.h>
+#else
+#include <urcu.h>
+#endif
+
+/* Nodes queued and not yet consumed, above which producers back off. */
+#define QUEUE_BACKLOG_MAX	4096
+
+struct thr_count {
+	unsigned long long ops;
+	unsigned long long stalls;	/* Operations above stall_ns */
+	struct bench_hist lat;		/* Operation latency, in ns */
+};
+
+struct test_node {
+	struct cds_wfcq_node cq_node;
+	struct cds_wfs_node s_node;
+};
+
+static volatile int test_go, test_stop;
+
+static unsigned long wdelay;
+
+static unsigned long duration;
+
+/* read-side C.S. duration, in loops */
+static unsigned long rduration;
+
+/* read-side C.S. between quiescent states (QSBR) */
+static unsigned long qs_period = 1024;
+
+/* Operations lasting at least stall_ns are stall incidents. */
+static uint64_t stall_ns = 10000000;
+
+static int hog_policy = SCHED_OTHER;
+static const char *hog_policy_name = "other";
+
+static struct cds_wfcq_head cq_head;
+static struct cds_wfcq_tail cq_tail;
+static struct cds_wfs_stack stack;
+static unsigned long cq_backlog, stack_backlog;
+
+static inline void loop_sleep(unsigned long loops)
+{
+	while (loops-- != 0)
+		caa_cpu_relax();
+}
+
+static int verbose_mode;
+
+#define printf_verbose(fmt, args...)		\
+	do {					\
+		if (verbose_mode)		\
+			printf(fmt, args);	\
+	} while (0)
+
+static unsigned int cpu_affinities[NR_CPUS];
+static unsigned int next_aff = 0;
+static int use_affinity = 0;
+
+pthread_mutex_t affinity_mutex = PTHREAD_MUTEX_INITIALIZER;
+
+static void set_affinity(void)
+{
+#if HAVE_SCHED_SETAFFINITY
+	int cpu, ret;
+#endif /* HAVE_SCHED_SETAFFINITY */
+
+	if (!use_affinity)
+		return;
+
+#if HAVE_SCHED_SETAFFINITY
+	ret = pthread_mutex_lock(&affinity_mutex);
+	if (ret) {
+		perror("Error in pthread mutex lock");
+		exit(-1);
+	}
+	cpu = cpu_affinities[next_aff++ % NR_CPUS];
+	ret = pthread_mutex_unlock(&affinity_mutex);
+	if (ret) {
+		perror("Error in pthread mutex unlock");
+		exit(-1);
+	}
+
+	bench_pin_cpu(cpu);
+#endif /* HAVE_SCHED_SETAFFINITY */
+}
+
+/*
+ * Restrict the process to the first nr_cpus CPUs it may run on, if non
+ * zero, before any thread is created. Return the number of CPUs the
+ * process may run on.
+ */
+static unsigned int restrict_cpus(unsigned int nr_cpus)
+{
+#if HAVE_SCHED_SETAFFINITY && SCHED_SETAFFINITY_ARGS == 3 && defined(CPU_COUNT)
+	cpu_set_t mask, restricted;
+	unsigned int cpu, nr = 0;
+
+	if (sched_getaffinity(0, sizeof(mask), &mask))
+		return 1;
+	if (!nr_cpus)
+		return CPU_COUNT(&mask);
+	CPU_ZERO(&restricted);
+	for (cpu = 0; cpu < CPU_SETSIZE && nr < nr_cpus; cpu++) {
+		if (CPU_ISSET(cpu, &mask)) {
+			CPU_SET(cpu, &restricted);
+			nr++;
+		}
+	}
+	if (sched_setaffinity(0, sizeof(restricted), &restricted)) {
+		perror("sched_setaffinity");
+		exit(-1);
+	}
+	return nr;
+#else
+	long nr = sysconf(_SC_NPROCESSORS_ONLN);
+
+	if (nr_cpus)
+		fprintf(stderr, "CPU restriction not supported\n");
+	return nr > 0 ? nr : 1;
+#endif
+}
+
+static uint64_t elapsed_ns(double start)
+{
+	return (uint64_t) ((bench_now() - start) * 1e9);
+}
+
+/* Record the latency of an operation, and whether it stalled. */
+static void record_op(struct thr_count *count, double start)
+{
+	uint64_t ns = elapsed_ns(start);
+
+	bench_hist_record(&count->lat, ns);
+	if (caa_unlikely(ns >= stall_ns))
+		count->stalls++;
+	count->ops++;
+}
+
+/*
+ * returns 0 if test should end.
+ */
+static int test_duration_write(void)
+{
+	return !test_stop;
+}
+
+static int test_duration_read(void)
+{
+	return !test_stop;
+}
+
+static DEFINE_URCU_TLS(unsigned long long, nr_syncs);
+static DEFINE_URCU_TLS(unsigned long long, nr_reads);
+
+static unsigned int nr_readers;
+static unsigned int nr_updaters;
+static unsigned int nr_hogs;
+static unsigned int nr_producers;
+
+static void *thr_reader(void *_count)
+{
+	struct thr_count *count = _count;
+
+	printf_verbose("thread_begin %s, tid %lu\n",
+			"reader", urcu_get_thread_id());
+
+	set_affinity();
+
+	rcu_register_thread();
+#ifdef RCU_QSBR
+	rcu_thread_offline();
+#endif
+
+	while (!test_go)
+	{
+	}
+	cmm_smp_mb();
+
+#ifdef RCU_QSBR
+	rcu_thread_online();
+#endif
+	for (;;) {
+		rcu_read_lock();
+		if (caa_unlikely(rduration))
+			loop_sleep(rduration);
+		rcu_read_unlock();
+		URCU_TLS(nr_reads)++;
+		if (caa_unlikely(!test_duration_read()))
+			break;
+#ifdef RCU_QSBR
+		if (caa_unlikely(URCU_TLS(nr_reads) % qs_period == 0))
+			rcu_quiescent_state();
+#endif
+	}
+
+	rcu_unregister_thread();
+
+	count->ops = URCU_TLS(nr_reads);
+	printf_verbose("thread_end %s, tid %lu\n",
+			"reader", urcu_get_thread_id());
+	return ((void*)1);
+}
+
+static void *thr_updater(void *_count)
+{
+	struct thr_count *count = _count;
+	double start;
+
+	printf_verbose("thread_begin %s, tid %lu\n",
+			"updater", urcu_get_thread_id());
+
+	set_affinity();
+
+	while (!test_go)
+	{
+	}
+	cmm_smp_mb();
+
+	for (;;) {
+		start = bench_now();
+		synchronize_rcu();
+		record_op(count, start);
+		URCU_TLS(nr_syncs)++;
+		if (caa_unlikely(!test_duration_write()))
+			break;
+		if (caa_unlikely(wdelay))
+			loop_sleep(wdelay);
+	}
+
+	printf_verbose("thread_end %s, tid %lu\n",
+			"updater", urcu_get_thread_id());
+	return ((void*)2);
+}
+
+/* Competing load, without RCU, under hog_policy. */
+static void *thr_hog(void *_count)
+{
+	struct thr_count *count = _count;
+	struct sched_param param;
+	int err;
+
+	printf_verbose("thread_begin %s, tid %lu\n",
+			"hog", urcu_get_thread_id());
+
+	set_affinity();
+
+	if (hog_policy != SCHED_OTHER) {
+		memset(&param, 0, sizeof(param));
+		err = pthread_setschedparam(pthread_self(), hog_policy, &param);
+		if (err) {
+			fprintf(stderr, "pthread_setschedparam: %s\n",
+				strerror(err));
+			exit(-1);
+		}
+	}
+
+	while (!test_go)
+	{
+	}
+	cmm_smp_mb();
+
+	while (!test_stop) {
+		loop_sleep(1000);
+		count->ops++;
+	}
+
+	printf_verbose("thread_end %s, tid %lu\n",
+			"hog", urcu_get_thread_id());
+	return ((void*)3);
+}
+
+/* Back off while the consumer is behind, to bound memory use. */
+static int wait_backlog(unsigned long *backlog)
+{
+	while (uatomic_read(backlog) >= QUEUE_BACKLOG_MAX) {
+		if (test_stop)
+			return 0;
+		caa_cpu_relax();
+	}
+	return 1;
+}
+
+static void *thr_cq_producer(void *_count)
+{
+	struct thr_count *count = _count;
+	struct test_node *node;
+	double start;
+
+	set_affinity();
+
+	while (!test_go)
+	{
+	}
+	cmm_smp_mb();
+
+	while (!test_stop && wait_backlog(&cq_backlog)) {
+		node = malloc(sizeof(*node));
+		if (!node)
+			abort();
+		cds_wfcq_node_init(&node->cq_node);
+		uatomic_inc(&cq_backlog);
+		start = bench_now();
+		cds_wfcq_enqueue(&cq_head, &cq_tail, &node->cq_node);
+		record_op(count, start);
+	}
+	return ((void*)4);
+}
+
+/*
+ * Dequeue operations wait for a node being enqueued to be linked: their
+ * latency includes the time its producer is preempted.
+ */
+static void *thr_cq_consumer(void *_count)
+{
+	struct thr_count *count = _count;
+	struct cds_wfcq_node *node;
+	double start;
+
+	set_affinity();
+
+	while (!test_go)
+	{
+	}
+	cmm_smp_mb();
+
+	while (!test_stop) {
+		start = bench_now();
+		node = cds_wfcq_dequeue_blocking(&cq_head, &cq_tail);
+		if (!node)
+			continue;
+		record_op(count, start);
+		uatomic_dec(&cq_backlog);
+		free(caa_container_of(node, struct test_node, cq_node));
+	}
+	return ((void*)5);
+}
+
+static void *thr_stack_producer(void *_count)
+{
+	struct thr_count *count = _count;
+	struct test_node *node;
+	double start;
+
+	set_affinity();
+
+	while (!test_go)
+	{
+	}
+	cmm_smp_mb();
+
+	while (!test_stop && wait_backlog(&stack_backlog)) {
+		node = malloc(sizeof(*node));
+		if (!node)
+			abort();
+		cds_wfs_node_init(&node->s_node);
+		uatomic_inc(&stack_backlog);
+		start = bench_now();
+		cds_wfs_push(&stack, &node->s_node);
+		record_op(count, start);
+	}
+	return ((void*)6);
+}
+
+static void *thr_stack_consumer(void *_count)
+{
+	struct thr_count *count = _count;
+	struct cds_wfs_node *node;
+	double start;
+
+	set_affinity();
+
+	while (!test_go)
+	{
+	}
+	cmm_smp_mb();
+
+	while (!test_stop) {
+		start = bench_now();
+		node = cds_wfs_pop_blocking(&stack);
+		if (!node)
+			continue;
+		record_op(count, start);
+		uatomic_dec(&stack_backlog);
+		free(caa_container_of(node, struct test_node, s_node));
+	}
+	return ((void*)7);
+}
+
+static void show_usage(int argc, char **argv)
+{
+	printf("Usage : %s nr_readers nr_updaters duration (s) <OPTIONS>\n",
+		argv[0]);
+	printf("OPTIONS:\n");
+	printf("	[-o ratio] (readers per CPU, overrides nr_readers)\n");
+	printf("	[-n nr] (restrict the process to nr CPUs)\n");
+	printf("	[-h nr] (CPU hogs)\n");
+	printf("	[-p other|batch|idle] (scheduling policy of the hogs)\n");
+	printf("	[-Q nr] (wfcqueue and wfstack producers, each)\n");
+	printf("	[-t ms] (stall threshold, default 10)\n");
+	printf("	[-d delay] (updater period between grace periods (in loops))\n");
+	printf("	[-c duration] (reader C.S. duration (in loops))\n");
+#ifdef RCU_QSBR
+	printf("	[-q period] (reader C.S. between quiescent states, default 1024)\n");
+#endif
+	printf("	[-v] (verbose output)\n");
+	printf("	[-a cpu#] [-a cpu#]... (affinity)\n");
+	printf("	[--format=json|csv] [--output=file] (report format)\n");
+	printf("\n");
+}
+
+static int parse_policy(const char *name)
+{
+	if (!strcmp(name, "other")) {
+		hog_policy = SCHED_OTHER;
+#ifdef SCHED_BATCH
+	} else if (!strcmp(name, "batch")) {
+		hog_policy = SCHED_BATCH;
+#endif
+#ifdef SCHED_IDLE
+	} else if (!strcmp(name, "idle")) {
+		hog_policy = SCHED_IDLE;
+#endif
+	} else {
+		return -1;
+	}
+	hog_policy_name = name;
+	return 0;
+}
+
+static void create_threads(pthread_t *tid, struct thr_count *count,
+		unsigned int nr, void *(*func)(void *))
+{
+	unsigned int i_thr;
+	int err;
+
+	for (i_thr = 0; i_thr < nr; i_thr++) {
+		err = pthread_create(&tid[i_thr], NULL, func, &count[i_thr]);
+		if (err != 0)
+			exit(1);
+	}
+}
+
+/* Join the threads, and sum their operations, stalls and latencies. */
+static unsigned long long join_threads(struct bench_report *report,
+		const char *role, pthread_t *tid, struct thr_count *count,
+		unsigned int nr, unsigned long long *stalls,
+		struct bench_hist *lat)
+{
+	unsigned long long ops = 0;
+	unsigned int i_thr;
+	void *tret;
+	int err;
+
+	for (i_thr = 0; i_thr < nr; i_thr++) {
+		err = pthread_join(tid[i_thr], &tret);
+		if (err != 0)
+			exit(1);
+		ops += count[i_thr].ops;
+		if (stalls)
+			*stalls += count[i_thr].stalls;
+		if (lat)
+			bench_hist_merge(lat, &count[i_thr].lat);
+		bench_report_thread(report, role, count[i_thr].ops);
+	}
+	return ops;
+}
+
+int main(int argc, char **argv)
+{
+	int err;
+	pthread_t *tid_reader, *tid_updater, *tid_hog, *tid_cq, *tid_stack;
+	struct bench_report *report;
+	struct thr_count *count_reader, *count_updater, *count_hog;
+	struct thr_count *count_cq, *count_stack;
+	unsigned long long tot_reads, tot_syncs, tot_hog_loops;
+	unsigned long long tot_cq_ops, tot_stack_ops;
+	unsigned long long sync_stalls = 0, cq_stalls = 0, stack_stalls = 0;
+	unsigned long long cq_put_stalls = 0, stack_put_stalls = 0;
+	struct urcu_stats stats_before, stats_after;
+	unsigned long nr_gps;
+	unsigned int nr_cpus, restrict_nr = 0, oversub_ratio = 0;
+	static struct bench_hist sync_lat, cq_put_lat, cq_get_lat;
+	static struct bench_hist stack_put_lat, stack_get_lat;
+	int i, a;
+
+	if (argc < 4) {
+		show_usage(argc, argv);
+		return -1;
+	}
+
+	err = sscanf(argv[1], "%u", &nr_readers);
+	if (err != 1) {
+		show_usage(argc, argv);
+		return -1;
+	}
+
+	err = sscanf(argv[2], "%u", &nr_updaters);
+	if (err != 1) {
+		show_usage(argc, argv);
+		return -1;
+	}
+
+	err = sscanf(argv[3], "%lu", &duration);
+	if (err != 1) {
+		show_usage(argc, argv);
+		return -1;
+	}
+
+	for (i = 4; i < argc; i++) {
+		if (argv[i][0] != '-')
+			continue;
+		switch (argv[i][1]) {
+		case 'a':
+			if (argc < i + 2) {
+				show_usage(argc, argv);
+				return -1;
+			}
+			a = atoi(argv[++i]);
+			cpu_affinities[next_aff++] = a;
+			use_affinity = 1;
+			printf_verbose("Adding CPU %d affinity\n", a);
+			break;
+		case 'c':
+			if (argc < i + 2) {
+				show_usage(argc, argv);
+				return -1;
+			}
+			rduration = atol(argv[++i]);
+			break;
+		case 'd':
+			if (argc < i + 2) {
+				show_usage(argc, argv);
+				return -1;
+			}
+			wdelay = atol(argv[++i]);
+			break;
+		case 'o':
+			if (argc < i + 2) {
+				show_usage(argc, argv);
+				return -1;
+			}
+			oversub_ratio = atoi(argv[++i]);
+			break;
+		case 'n':
+			if (argc < i + 2) {
+				show_usage(argc, argv);
+				return -1;
+			}
+			restrict_nr = atoi(argv[++i]);
+			break;
+		case 'h':
+			if (argc < i + 2) {
+				show_usage(argc, argv);
+				return -1;
+			}
+			nr_hogs = atoi(argv[++i]);
+			break;
+		case 'p':
+			if (argc < i + 2 || parse_policy(argv[i + 1])) {
+				show_usage(argc, argv);
+				return -1;
+			}
+			i++;
+			break;
+		case 'Q':
+			if (argc < i + 2) {
+				show_usage(argc, argv);
+				return -1;
+			}
+			nr_producers = atoi(argv[++i]);
+			break;
+		case 't':
+			if (argc < i + 2) {
+				show_usage(argc, argv);
+				return -1;
+			}
+			stall_ns = (uint64_t) atol(argv[++i]) * 1000000;
+			break;
+		case 'q':
+			if (argc < i + 2) {
+				show_usage(argc, argv);
+				return -1;
+			}
+			qs_period = atol(argv[++i]);
+			if (!qs_period) {
+				show_usage(argc, argv);
+				return -1;
+			}
+			break;
+		case 'v':
+			verbose_mode = 1;
+			break;
+		}
+	}
+
+	nr_cpus = restrict_cpus(restrict_nr);
+	if (oversub_ratio)
+		nr_readers = oversub_ratio * nr_cpus;
+
+	printf_verbose("running test for %lu seconds, %u readers, %u updaters, "
+		"%u hogs (%s), %u queue producers on %u CPUs.\n",
+		duration, nr_readers, nr_updaters, nr_hogs, hog_policy_name,
+		nr_producers, nr_cpus);
+	printf_verbose("Updater delay : %lu loops.\n", wdelay);
+	printf_verbose("Reader duration : %lu loops.\n", rduration);
+	printf_verbose("thread %-6s, tid %lu\n",
+			"main", urcu_get_thread_id());
+
+	cds_wfcq_init(&cq_head, &cq_tail);
+	cds_wfs_init(&stack);
+
+	tid_reader = calloc(nr_readers, sizeof(*tid_reader));
+	tid_updater = calloc(nr_updaters, sizeof(*tid_updater));
+	tid_hog = calloc(nr_hogs, sizeof(*tid_hog));
+	tid_cq = calloc(nr_producers + 1, sizeof(*tid_cq));
+	tid_stack = calloc(nr_producers + 1, sizeof(*tid_stack));
+	count_reader = calloc(nr_readers, sizeof(*count_reader));
+	count_updater = calloc(nr_updaters, sizeof(*count_updater));
+	count_hog = calloc(nr_hogs, sizeof(*count_hog));
+	count_cq = calloc(nr_producers + 1, sizeof(*count_cq));
+	count_stack = calloc(nr_producers + 1, sizeof(*count_stack));
+
+	report = bench_report_create(argc, argv);
+	next_aff = 0;
+
+	create_threads(tid_reader, count_reader, nr_readers, thr_reader);
+	create_threads(tid_updater, count_updater, nr_updaters, thr_updater);
+	create_threads(tid_hog, count_hog, nr_hogs, thr_hog);
+	if (nr_producers) {
+		/* The consumer follows the producers. */
+		create_threads(tid_cq, count_cq, nr_producers, thr_cq_producer);
+		create_threads(&tid_cq[nr_producers], &count_cq[nr_producers],
+			1, thr_cq_consumer);
+		create_threads(tid_stack, count_stack, nr_producers,
+			thr_stack_producer);
+		create_threads(&tid_stack[nr_producers],
+			&count_stack[nr_producers], 1, thr_stack_consumer);
+	}
+
+	cmm_smp_mb();
+
+	rcu_get_stats(&stats_before);
+	bench_report_start(report);
+	test_go = 1;
+
+	sleep(duration);
+
+	bench_report_stop(report);
+	test_stop = 1;
+
+	tot_reads = join_threads(report, "reader", tid_reader, count_reader,
+		nr_readers, NULL, NULL);
+	tot_syncs = join_threads(report, "updater", tid_updater,
+		count_updater, nr_updaters, &sync_stalls, &sync_lat);
+	tot_hog_loops = join_threads(report, "hog", tid_hog, count_hog,
+		nr_hogs, NULL, NULL);
+	tot_cq_ops = tot_stack_ops = 0;
+	if (nr_producers) {
+		(void) join_threads(report, "queue", tid_cq, count_cq,
+			nr_producers, &cq_put_stalls, &cq_put_lat);
+		tot_cq_ops = join_threads(report, "queue",
+			&tid_cq[nr_producers], &count_cq[nr_producers], 1,
+			&cq_stalls, &cq_get_lat);
+		(void) join_threads(report, "queue", tid_stack, count_stack,
+			nr_producers, &stack_put_stalls, &stack_put_lat);
+		tot_stack_ops = join_threads(report, "queue",
+			&tid_stack[nr_producers], &count_stack[nr_producers],
+			1, &stack_stalls, &stack_get_lat);
+	}
+	rcu_get_stats(&stats_after);
+	nr_gps = stats_after.gp_count - stats_before.gp_count;
+
+	printf_verbose("total number of reads : %llu, synchronize_rcu %llu\n",
+		tot_reads, tot_syncs);
+	printf("SUMMARY %-25s testdur %4lu nr_cpus %3u nr_readers %4u "
+		"rdur %6lu nr_updaters %3u wdelay %6lu nr_hogs %3u policy %s "
+		"nr_producers %3u nr_reads %12llu reads_per_sec %12.1f "
+		"nr_syncs %10llu nr_gps %10lu sync_stalls %6llu "
+		"wfcq_ops %10llu wfcq_stalls %6llu wfs_ops %10llu "
+		"wfs_stalls %6llu\n",
+		argv[0], duration, nr_cpus, nr_readers, rduration,
+		nr_updaters, wdelay, nr_hogs, hog_policy_name, nr_producers,
+		tot_reads, bench_rate(report, tot_reads), tot_syncs, nr_gps,
+		sync_stalls, tot_cq_ops, cq_put_stalls + cq_stalls,
+		tot_stack_ops, stack_put_stalls + stack_stalls);
+	bench_hist_print("synchronize_rcu", &sync_lat, "ns");
+	if (nr_producers) {
+		bench_hist_print("wfcq_enqueue", &cq_put_lat, "ns");
+		bench_hist_print("wfcq_dequeue", &cq_get_lat, "ns");
+		bench_hist_print("wfs_push", &stack_put_lat, "ns");
+		bench_hist_print("wfs_pop", &stack_get_lat, "ns");
+	}
+	bench_report_param(report, "duration", duration);
+	bench_report_param(report, "nr_cpus", nr_cpus);
+	bench_report_param(report, "nr_readers", nr_readers);
+	bench_report_param(report, "rduration", rduration);
+	bench_report_param(report, "nr_updaters", nr_updaters);
+	bench_report_param(report, "wdelay", wdelay);
+	bench_report_param(report, "nr_hogs", nr_hogs);
+	bench_report_param(report, "nr_producers", nr_producers);
+	bench_report_param(report, "stall_ms", stall_ns / 1000000);
+	bench_report_param(report, "nr_reads", tot_reads);
+	bench_report_param(report, "nr_syncs", tot_syncs);
+	bench_report_param(report, "nr_gps", nr_gps);
+	bench_report_param(report, "nr_hog_loops", tot_hog_loops);
+	bench_report_param(report, "sync_stalls", sync_stalls);
+	bench_report_param(report, "wfcq_stalls", cq_put_stalls + cq_stalls);
+	bench_report_param(report, "wfs_stalls",
+		stack_put_stalls + stack_stalls);
+	bench_report_hist(report, "sync_ns", &sync_lat);
+	if (nr_producers) {
+		bench_report_hist(report, "wfcq_dequeue_ns", &cq_get_lat);
+		bench_report_hist(report, "wfs_pop_ns", &stack_get_lat);
+	}
+	bench_report_destroy(report);
+	free(tid_reader);
+	free(tid_updater);
+	free(tid_hog);
+	free(tid_cq);
+	free(tid_stack);
+	free(count_reader);
+	free(count_updater);
+	free(count_hog);
+	free(count_cq);
+	free(count_stack);
+	return 0;
+}
@@ -33,6 +33,7 @@
 
 #include <urcu/arch.h>
 #include "thread-id.h"
+#include "bench.h"
 
 #define _LGPL_SOURCE
 #include <urcu-qsbr.h>
@@ -74,6 +75,12 @@ static struct test_array *test_rcu_pointer;
 #define INNER_WRITE_LOOP 200U
 #define WRITE_LOOP ((unsigned long long)OUTER_WRITE_LOOP * INNER_WRITE_LOOP)
 
+/*
+ * Read-side critical sections timed one by one for the latency histogram,
+ * which includes the cost of reading the cycle counter.
+ */
+#define SAMPLE_READ_LOOP 1000000U
+
 static int num_read;
 static int num_write;
 
@@ -83,11 +90,14 @@ static int num_write;
 static caa_cycles_t __attribute__((aligned(CAA_CACHE_LINE_SIZE))) *reader_time;
 static caa_cycles_t __attribute__((aligned(CAA_CACHE_LINE_SIZE))) *writer_time;
 
+/* Per-thread latency histograms, in cycles. */
+static struct bench_hist *reader_hist, *writer_hist, *sync_hist;
+
 void *thr_reader(void *arg)
 {
 	unsigned int i, j;
 	struct test_array *local_ptr;
-	caa_cycles_t time1, time2;
+	caa_cycles_t time1, time2, sample;
 
 	printf("thread_begin %s, tid %lu\n",
 		"reader", urcu_get_thread_id());
@@ -109,6 +119,20 @@ void *thr_reader(void *arg)
 	}
 	time2 = caa_get_cycles();
 
+	for (i = 0; i < SAMPLE_READ_LOOP; i++) {
+		sample = caa_get_cycles();
+		_rcu_read_lock();
+		local_ptr = _rcu_dereference(test_rcu_pointer);
+		if (local_ptr) {
+			assert(local_ptr->a == 8);
+		}
+		_rcu_read_unlock();
+		bench_hist_record(&reader_hist[(unsigned long)arg],
+			caa_get_cycles() - sample);
+		if (!((i + 1) % INNER_READ_LOOP))
+			_rcu_quiescent_state();
+	}
+
 	rcu_unregister_thread();
 
 	reader_time[(unsigned long)arg] = time2 - time1;
@@ -124,7 +148,7 @@ void *thr_writer(void *arg)
 {
 	unsigned int i, j;
 	struct test_array *new, *old;
-	caa_cycles_t time1, time2;
+	caa_cycles_t time1, time2, sync_start;
 
 	printf("thread_begin %s, tid %lu\n",
 		"writer", urcu_get_thread_id());
@@ -142,7 +166,10 @@ void *thr_writer(void *arg)
 			new->a = 8;
 			old = rcu_xchg_pointer(&test_rcu_pointer, new);
 			rcu_copy_mutex_unlock();
+			sync_start = caa_get_cycles();
 			synchronize_rcu();
+			bench_hist_record(&sync_hist[(unsigned long)arg],
+				caa_get_cycles() - sync_start);
 			/* can be done after unlock */
 			if (old) {
 				old->a = 0;
@@ -150,6 +177,8 @@ void *thr_writer(void *arg)
 			free(old);
 			time2 = caa_get_cycles();
 			writer_time[(unsigned long)arg] += time2 - time1;
+			bench_hist_record(&writer_hist[(unsigned long)arg],
+				time2 - time1);
 			usleep(1);
 		}
 	}
@@ -167,6 +196,7 @@ int main(int argc, char **argv)
 	int i;
 	caa_cycles_t tot_rtime = 0;
 	caa_cycles_t tot_wtime = 0;
+	struct bench_hist *read_lat, *write_lat, *sync_lat;
 
 	if (argc < 2) {
 		printf("Usage : %s nr_readers nr_writers\n", argv[0]);
@@ -179,6 +209,13 @@ int main(int argc, char **argv)
 	writer_time = calloc(num_write, sizeof(*writer_time));
 	tid_reader = calloc(num_read, sizeof(*tid_reader));
 	tid_writer = calloc(num_write, sizeof(*tid_writer));
+	reader_hist = calloc(num_read + 1, sizeof(*reader_hist));
+	writer_hist = calloc(num_write + 1, sizeof(*writer_hist));
+	sync_hist = calloc(num_write + 1, sizeof(*sync_hist));
+	/* The last histogram of each array holds the merged ones. */
+	read_lat = &reader_hist[num_read];
+	write_lat = &writer_hist[num_write];
+	sync_lat = &sync_hist[num_write];
 
 	printf("thread %-6s, tid %lu\n",
 		"main", urcu_get_thread_id());
@@ -203,21 +240,30 @@ int main(int argc, char **argv)
 		if (err != 0)
 			exit(1);
 		tot_rtime += reader_time[i];
+		bench_hist_merge(read_lat, &reader_hist[i]);
 	}
 	for (i = 0; i < NR_WRITE; i++) {
 		err = pthread_join(tid_writer[i], &tret);
 		if (err != 0)
 			exit(1);
 		tot_wtime += writer_time[i];
+		bench_hist_merge(write_lat, &writer_hist[i]);
+		bench_hist_merge(sync_lat, &sync_hist[i]);
 	}
 	free(test_rcu_pointer);
 	printf("Time per read : %g cycles\n",
 	       (double)tot_rtime / ((double)NR_READ * (double)READ_LOOP));
 	printf("Time per write : %g cycles\n",
 	       (double)tot_wtime / ((double)NR_WRITE * (double)WRITE_LOOP));
+	bench_hist_print("read", read_lat, "cycles");
+	bench_hist_print("write", write_lat, "cycles");
+	bench_hist_print("synchronize_rcu", sync_lat, "cycles");
 
 	free(reader_time);
 	free(writer_time);
+	free(reader_hist);
+	free(writer_hist);
+	free(sync_hist);
 	free(tid_reader);
 	free(tid_writer);
 
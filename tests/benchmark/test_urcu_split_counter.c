@@ -0,0 +1,360 @@
+/*
+ * test_urcu_split_counter.c
+ *
+ * Userspace RCU library - split counter benchmark
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+/*
+ * Threads increment a counter as fast as they can, while readers read
+ * its approximate (or exact) value. The counter is either a split
+ * counter, or a single shared atomic counter for comparison.
+ */
+
+#include <stdio.h>
+#include <pthread.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/types.h>
+#include <unistd.h>
+
+#include <urcu/arch.h>
+#include <urcu/uatomic.h>
+#include <urcu/tls-compat.h>
+#include <urcu/split-counter.h>
+#include "cpuset.h"
+#include "bench.h"
+#include "thread-id.h"
+
+/* hardcoded number of CPUs */
+#define NR_CPUS 16384
+
+static volatile int test_go, test_stop;
+
+static unsigned long wdelay;
+
+static unsigned long duration;
+
+static unsigned int commit_order = 10;
+
+static int use_atomic, read_exact;
+
+static struct cds_split_counter *counter;
+
+static unsigned long shared_count __attribute__((aligned(CAA_CACHE_LINE_SIZE)));
+
+static inline void loop_sleep(unsigned long loops)
+{
+	while (loops-- != 0)
+		caa_cpu_relax();
+}
+
+static int verbose_mode;
+
+#define printf_verbose(fmt, args...)		\
+	do {					\
+		if (verbose_mode)		\
+			printf(fmt, args);	\
+	} while (0)
+
+static unsigned int cpu_affinities[NR_CPUS];
+static unsigned int next_aff = 0;
+static int use_affinity = 0;
+
+pthread_mutex_t affinity_mutex = PTHREAD_MUTEX_INITIALIZER;
+
+static void set_affinity(void)
+{
+#if HAVE_SCHED_SETAFFINITY
+	int cpu, ret;
+#endif /* HAVE_SCHED_SETAFFINITY */
+
+	if (!use_affinity)
+		return;
+
+#if HAVE_SCHED_SETAFFINITY
+	ret = pthread_mutex_lock(&affinity_mutex);
+	if (ret) {
+		perror("Error in pthread mutex lock");
+		exit(-1);
+	}
+	cpu = cpu_affinities[next_aff++];
+	ret = pthread_mutex_unlock(&affinity_mutex);
+	if (ret) {
+		perror("Error in pthread mutex unlock");
+		exit(-1);
+	}
+
+	bench_pin_cpu(cpu);
+#endif /* HAVE_SCHED_SETAFFINITY */
+}
+
+/*
+ * returns 0 if test should end.
+ */
+static int test_duration(void)
+{
+	return !test_stop;
+}
+
+static DEFINE_URCU_TLS(unsigned long long, nr_ops);
+
+static unsigned int nr_readers;
+static unsigned int nr_writers;
+
+static void *thr_reader(void *_count)
+{
+	unsigned long long *count = _count;
+	long v = 0;
+
+	printf_verbose("thread_begin %s, tid %lu\n",
+			"reader", urcu_get_thread_id());
+
+	set_affinity();
+
+	while (!test_go)
+	{
+	}
+	cmm_smp_mb();
+
+	for (;;) {
+		if (use_atomic)
+			v += (long) uatomic_read(&shared_count);
+		else if (read_exact)
+			v += cds_split_counter_read_exact(counter);
+		else
+			v += cds_split_counter_read(counter);
+		URCU_TLS(nr_ops)++;
+		if (caa_unlikely(!test_duration()))
+			break;
+	}
+
+	*count = URCU_TLS(nr_ops);
+	printf_verbose("thread_end %s, tid %lu (%ld)\n",
+			"reader", urcu_get_thread_id(), v);
+	return ((void*)1);
+}
+
+static void *thr_writer(void *_count)
+{
+	unsigned long long *count = _count;
+
+	printf_verbose("thread_begin %s, tid %lu\n",
+			"writer", urcu_get_thread_id());
+
+	set_affinity();
+
+	while (!test_go)
+	{
+	}
+	cmm_smp_mb();
+
+	for (;;) {
+		if (use_atomic)
+			uatomic_inc(&shared_count);
+		else
+			cds_split_counter_inc(counter);
+		URCU_TLS(nr_ops)++;
+		if (caa_unlikely(!test_duration()))
+			break;
+		if (caa_unlikely(wdelay))
+			loop_sleep(wdelay);
+	}
+
+	*count = URCU_TLS(nr_ops);
+	printf_verbose("thread_end %s, tid %lu\n",
+			"writer", urcu_get_thread_id());
+	return ((void*)1);
+}
+
+static void show_usage(int argc, char **argv)
+{
+	printf("Usage : %s nr_readers nr_writers duration (s) <OPTIONS>\n",
+		argv[0]);
+	printf("OPTIONS:\n");
+	printf("	[-o order] (commit order, default 10)\n");
+	printf("	[-A] (shared atomic counter instead of a split counter)\n");
+	printf("	[-e] (readers read the exact value)\n");
+	printf("	[-d delay] (writer period (in loops))\n");
+	printf("	[-v] (verbose output)\n");
+	printf("	[-a cpu#] [-a cpu#]... (affinity)\n");
+	printf("	[--format=json|csv] [--output=file] (report format)\n");
+	printf("\n");
+}
+
+int main(int argc, char **argv)
+{
+	int err;
+	pthread_t *tid_reader, *tid_writer;
+	void *tret;
+	struct bench_report *report;
+	unsigned long long *count_reader, *count_writer;
+	unsigned long long tot_reads = 0, tot_writes = 0;
+	long final;
+	int i, a;
+	unsigned int i_thr;
+
+	if (argc < 4) {
+		show_usage(argc, argv);
+		return -1;
+	}
+
+	err = sscanf(argv[1], "%u", &nr_readers);
+	if (err != 1) {
+		show_usage(argc, argv);
+		return -1;
+	}
+
+	err = sscanf(argv[2], "%u", &nr_writers);
+	if (err != 1) {
+		show_usage(argc, argv);
+		return -1;
+	}
+
+	err = sscanf(argv[3], "%lu", &duration);
+	if (err != 1) {
+		show_usage(argc, argv);
+		return -1;
+	}
+
+	for (i = 4; i < argc; i++) {
+		if (argv[i][0] != '-')
+			continue;
+		switch (argv[i][1]) {
+		case 'a':
+			if (argc < i + 2) {
+				show_usage(argc, argv);
+				return -1;
+			}
+			a = atoi(argv[++i]);
+			cpu_affinities[next_aff++] = a;
+			use_affinity = 1;
+			printf_verbose("Adding CPU %d affinity\n", a);
+			break;
+		case 'o':
+			if (argc < i + 2) {
+				show_usage(argc, argv);
+				return -1;
+			}
+			commit_order = atoi(argv[++i]);
+			break;
+		case 'A':
+			use_atomic = 1;
+			break;
+		case 'e':
+			read_exact = 1;
+			break;
+		case 'd':
+			if (argc < i + 2) {
+				show_usage(argc, argv);
+				return -1;
+			}
+			wdelay = atol(argv[++i]);
+			break;
+		case 'v':
+			verbose_mode = 1;
+			break;
+		}
+	}
+
+	printf_verbose("running test for %lu seconds, %u readers, "
+		"%u writers.\n", duration, nr_readers, nr_writers);
+	printf_verbose("thread %-6s, tid %lu\n",
+			"main", urcu_get_thread_id());
+
+	counter = cds_split_counter_new(commit_order, 0);
+	if (!counter) {
+		printf("Invalid commit order %u.\n", commit_order);
+		return -1;
+	}
+
+	tid_reader = calloc(nr_readers, sizeof(*tid_reader));
+	tid_writer = calloc(nr_writers, sizeof(*tid_writer));
+	count_reader = calloc(nr_readers, sizeof(*count_reader));
+	count_writer = calloc(nr_writers, sizeof(*count_writer));
+
+	report = bench_report_create(argc, argv);
+	next_aff = 0;
+
+	for (i_thr = 0; i_thr < nr_readers; i_thr++) {
+		err = pthread_create(&tid_reader[i_thr], NULL, thr_reader,
+				     &count_reader[i_thr]);
+		if (err != 0)
+			exit(1);
+	}
+	for (i_thr = 0; i_thr < nr_writers; i_thr++) {
+		err = pthread_create(&tid_writer[i_thr], NULL, thr_writer,
+				     &count_writer[i_thr]);
+		if (err != 0)
+			exit(1);
+	}
+
+	cmm_smp_mb();
+
+	bench_report_start(report);
+	test_go = 1;
+
+	sleep(duration);
+
+	bench_report_stop(report);
+	test_stop = 1;
+
+	for (i_thr = 0; i_thr < nr_readers; i_thr++) {
+		err = pthread_join(tid_reader[i_thr], &tret);
+		if (err != 0)
+			exit(1);
+		tot_reads += count_reader[i_thr];
+		bench_report_thread(report, "reader", count_reader[i_thr]);
+	}
+	for (i_thr = 0; i_thr < nr_writers; i_thr++) {
+		err = pthread_join(tid_writer[i_thr], &tret);
+		if (err != 0)
+			exit(1);
+		tot_writes += count_writer[i_thr];
+		bench_report_thread(report, "writer", count_writer[i_thr]);
+	}
+
+	final = use_atomic ? (long) shared_count :
+		cds_split_counter_read_exact(counter);
+	if ((unsigned long long) final != tot_writes)
+		printf("WARNING! Counter %ld, expected %llu increments.\n",
+			final, tot_writes);
+
+	printf_verbose("total number of reads : %llu, writes %llu\n",
+		tot_reads, tot_writes);
+	printf("SUMMARY %-25s testdur %4lu nr_readers %3u nr_writers %3u "
+		"order %2u atomic %d exact %d nr_reads %12llu nr_writes %12llu "
+		"writes_per_sec %14.1f\n",
+		argv[0], duration, nr_readers, nr_writers, commit_order,
+		use_atomic, read_exact, tot_reads, tot_writes,
+		bench_rate(report, tot_writes));
+	bench_report_param(report, "duration", duration);
+	bench_report_param(report, "nr_readers", nr_readers);
+	bench_report_param(report, "nr_writers", nr_writers);
+	bench_report_param(report, "commit_order", commit_order);
+	bench_report_param(report, "atomic", use_atomic);
+	bench_report_param(report, "exact", read_exact);
+	bench_report_param(report, "nr_reads", tot_reads);
+	bench_report_param(report, "nr_writes", tot_writes);
+	bench_report_destroy(report);
+
+	cds_split_counter_destroy(counter);
+	free(tid_reader);
+	free(tid_writer);
+	free(count_reader);
+	free(count_writer);
+	return 0;
+}
@@ -38,6 +38,7 @@
 #include <urcu/tls-compat.h>
 #include <urcu/uatomic.h>
 #include "cpuset.h"
+#include "bench.h"
 #include "thread-id.h"
 
 /* hardcoded number of CPUs */
@@ -61,6 +62,9 @@ static volatile int test_go, test_stop_enqueue, test_stop_dequeue;
 
 static unsigned long rduration;
 
+/* number of nodes per enqueue */
+static unsigned long enqueue_batch = 1;
+
 static unsigned long duration;
 
 /* read-side C.S. duration, in loops */
@@ -92,7 +96,6 @@ pthread_mutex_t affinity_mutex = PTHREAD_MUTEX_INITIALIZER;
 static void set_affinity(void)
 {
 #if HAVE_SCHED_SETAFFINITY
-	cpu_set_t mask;
 	int cpu, ret;
 #endif /* HAVE_SCHED_SETAFFINITY */
 
@@ -112,13 +115,7 @@ static void set_affinity(void)
 		exit(-1);
 	}
 
-	CPU_ZERO(&mask);
-	CPU_SET(cpu, &mask);
-#if SCHED_SETAFFINITY_ARGS == 2
-	sched_setaffinity(0, &mask);
-#else
-	sched_setaffinity(0, sizeof(mask), &mask);
-#endif
+	bench_pin_cpu(cpu);
 #endif /* HAVE_SCHED_SETAFFINITY */
 }
 
@@ -147,12 +144,19 @@ static DEFINE_URCU_TLS(unsigned long long, nr_dequeue_last);
 static unsigned int nr_enqueuers;
 static unsigned int nr_dequeuers;
 
+/* Counts of a thread, and its hardware counters. */
+struct thr_count {
+	unsigned long long count[4];
+	struct bench_perf perf;
+};
+
 static struct cds_wfcq_head __attribute__((aligned(CAA_CACHE_LINE_SIZE))) head;
 static struct cds_wfcq_tail __attribute__((aligned(CAA_CACHE_LINE_SIZE))) tail;
 
 static void *thr_enqueuer(void *_count)
 {
-	unsigned long long *count = _count;
+	struct thr_count *thr = _count;
+	unsigned long long *count = thr->count;
 	bool was_nonempty;
 
 	printf_verbose("thread_begin %s, tid %lu\n",
@@ -164,14 +168,31 @@ static void *thr_enqueuer(void *_count)
 	{
 	}
 	cmm_smp_mb();
+	bench_perf_start(&thr->perf);
 
 	for (;;) {
-		struct cds_wfcq_node *node = malloc(sizeof(*node));
-		if (!node)
+		struct cds_wfcq_node *first = NULL, *last = NULL, *node;
+		unsigned long i;
+
+		for (i = 0; i < enqueue_batch; i++) {
+			node = malloc(sizeof(*node));
+			if (!node)
+				break;
+			cds_wfcq_node_init(node);
+			if (last)
+				last->next = node;
+			else
+				first = node;
+			last = node;
+		}
+		if (!first)
 			goto fail;
-		cds_wfcq_node_init(node);
-		was_nonempty = cds_wfcq_enqueue(&head, &tail, node);
-		URCU_TLS(nr_successful_enqueues)++;
+		if (first == last)
+			was_nonempty = cds_wfcq_enqueue(&head, &tail, first);
+		else
+			was_nonempty = cds_wfcq_enqueue_batch(&head, &tail,
+					first, last);
+		URCU_TLS(nr_successful_enqueues) += i;
 		if (!was_nonempty)
 			URCU_TLS(nr_empty_dest_enqueues)++;
 
@@ -183,6 +204,7 @@ fail:
 			break;
 	}
 
+	bench_perf_stop(&thr->perf);
 	uatomic_inc(&test_enqueue_stopped);
 	count[0] = URCU_TLS(nr_enqueues);
 	count[1] = URCU_TLS(nr_successful_enqueues);
@@ -263,7 +285,8 @@ static void do_test_splice(enum test_sync sync)
 
 static void *thr_dequeuer(void *_count)
 {
-	unsigned long long *count = _count;
+	struct thr_count *thr = _count;
+	unsigned long long *count = thr->count;
 	unsigned int counter = 0;
 
 	printf_verbose("thread_begin %s, tid %lu\n",
@@ -275,6 +298,7 @@ static void *thr_dequeuer(void *_count)
 	{
 	}
 	cmm_smp_mb();
+	bench_perf_start(&thr->perf);
 
 	for (;;) {
 		if (test_dequeue && test_splice) {
@@ -294,6 +318,7 @@ static void *thr_dequeuer(void *_count)
 		if (caa_unlikely(rduration))
 			loop_sleep(rduration);
 	}
+	bench_perf_stop(&thr->perf);
 
 	printf_verbose("dequeuer thread_end, tid %lu, "
 			"dequeues %llu, successful_dequeues %llu, "
@@ -341,6 +366,9 @@ static void show_usage(int argc, char **argv)
 	printf("		Note: default: no external synchronization used.\n");
 	printf("	[-f] (force user-provided synchronization)\n");
 	printf("	[-w] Wait for dequeuer to empty queue\n");
+	printf("	[-b size] (nodes per enqueue, default 1)\n");
+	printf("	[--format=json|csv] [--output=file] (report format)\n");
+	printf("	[--perf] (hardware counters per operation)\n");
 	printf("\n");
 }
 
@@ -349,7 +377,8 @@ int main(int argc, char **argv)
 	int err;
 	pthread_t *tid_enqueuer, *tid_dequeuer;
 	void *tret;
-	unsigned long long *count_enqueuer, *count_dequeuer;
+	struct bench_report *report;
+	struct thr_count *count_enqueuer, *count_dequeuer;
 	unsigned long long tot_enqueues = 0, tot_dequeues = 0;
 	unsigned long long tot_successful_enqueues = 0,
 			   tot_successful_dequeues = 0,
@@ -425,6 +454,13 @@ int main(int argc, char **argv)
 		case 'w':
 			test_wait_empty = 1;
 			break;
+		case 'b':
+			if (argc < i + 2) {
+				show_usage(argc, argv);
+				return -1;
+			}
+			enqueue_batch = atol(argv[++i]);
+			break;
 		case 'f':
 			test_force_sync = 1;
 			break;
@@ -435,6 +471,11 @@ int main(int argc, char **argv)
 	if (!test_dequeue && !test_splice)
 		test_splice = 1;
 
+	if (!enqueue_batch) {
+		show_usage(argc, argv);
+		return -1;
+	}
+
 	if (test_sync == TEST_SYNC_NONE && nr_dequeuers > 1 && test_dequeue) {
 		if (test_force_sync) {
 			fprintf(stderr, "[WARNING] Using dequeue concurrently "
@@ -459,6 +500,7 @@ int main(int argc, char **argv)
 		printf_verbose("External sync: none.\n");
 	if (test_wait_empty)
 		printf_verbose("Wait for dequeuers to empty queue.\n");
+	printf_verbose("Enqueue batch : %lu nodes.\n", enqueue_batch);
 	printf_verbose("Writer delay : %lu loops.\n", rduration);
 	printf_verbose("Reader duration : %lu loops.\n", wdelay);
 	printf_verbose("thread %-6s, tid %lu\n",
@@ -466,27 +508,31 @@ int main(int argc, char **argv)
 
 	tid_enqueuer = calloc(nr_enqueuers, sizeof(*tid_enqueuer));
 	tid_dequeuer = calloc(nr_dequeuers, sizeof(*tid_dequeuer));
-	count_enqueuer = calloc(nr_enqueuers, 3 * sizeof(*count_enqueuer));
-	count_dequeuer = calloc(nr_dequeuers, 4 * sizeof(*count_dequeuer));
+	count_enqueuer = calloc(nr_enqueuers, sizeof(*count_enqueuer));
+	count_dequeuer = calloc(nr_dequeuers, sizeof(*count_dequeuer));
 	cds_wfcq_init(&head, &tail);
 
+	report = bench_report_create(argc, argv);
 	next_aff = 0;
 
 	for (i_thr = 0; i_thr < nr_enqueuers; i_thr++) {
+		bench_perf_init(report, &count_enqueuer[i_thr].perf);
 		err = pthread_create(&tid_enqueuer[i_thr], NULL, thr_enqueuer,
-				     &count_enqueuer[3 * i_thr]);
+				     &count_enqueuer[i_thr]);
 		if (err != 0)
 			exit(1);
 	}
 	for (i_thr = 0; i_thr < nr_dequeuers; i_thr++) {
+		bench_perf_init(report, &count_dequeuer[i_thr].perf);
 		err = pthread_create(&tid_dequeuer[i_thr], NULL, thr_dequeuer,
-				     &count_dequeuer[4 * i_thr]);
+				     &count_dequeuer[i_thr]);
 		if (err != 0)
 			exit(1);
 	}
 
 	cmm_smp_mb();
 
+	bench_report_start(report);
 	test_go = 1;
 
 	for (i_thr = 0; i_thr < duration; i_thr++) {
@@ -497,6 +543,7 @@ int main(int argc, char **argv)
 		}
 	}
 
+	bench_report_stop(report);
 	test_stop_enqueue = 1;
 
 	if (test_wait_empty) {
@@ -514,18 +561,24 @@ int main(int argc, char **argv)
 		err = pthread_join(tid_enqueuer[i_thr], &tret);
 		if (err != 0)
 			exit(1);
-		tot_enqueues += count_enqueuer[3 * i_thr];
-		tot_successful_enqueues += count_enqueuer[3 * i_thr + 1];
-		tot_empty_dest_enqueues += count_enqueuer[3 * i_thr + 2];
+		tot_enqueues += count_enqueuer[i_thr].count[0];
+		bench_report_thread(report, "enqueuer", count_enqueuer[i_thr].count[0]);
+		bench_report_perf(report, "enqueuer", &count_enqueuer[i_thr].perf,
+			count_enqueuer[i_thr].count[0]);
+		tot_successful_enqueues += count_enqueuer[i_thr].count[1];
+		tot_empty_dest_enqueues += count_enqueuer[i_thr].count[2];
 	}
 	for (i_thr = 0; i_thr < nr_dequeuers; i_thr++) {
 		err = pthread_join(tid_dequeuer[i_thr], &tret);
 		if (err != 0)
 			exit(1);
-		tot_dequeues += count_dequeuer[4 * i_thr];
-		tot_successful_dequeues += count_dequeuer[4 * i_thr + 1];
-		tot_splice += count_dequeuer[4 * i_thr + 2];
-		tot_dequeue_last += count_dequeuer[4 * i_thr + 3];
+		tot_dequeues += count_dequeuer[i_thr].count[0];
+		bench_report_thread(report, "dequeuer", count_dequeuer[i_thr].count[0]);
+		bench_report_perf(report, "dequeuer", &count_dequeuer[i_thr].perf,
+			count_dequeuer[i_thr].count[0]);
+		tot_successful_dequeues += count_dequeuer[i_thr].count[1];
+		tot_splice += count_dequeuer[i_thr].count[2];
+		tot_dequeue_last += count_dequeuer[i_thr].count[3];
 	}
 
 	test_end(&end_dequeues, &tot_dequeue_last);
@@ -554,6 +607,20 @@ int main(int argc, char **argv)
 		tot_successful_dequeues, tot_splice, tot_dequeue_last,
 		end_dequeues,
 		tot_enqueues + tot_dequeues);
+	bench_report_param(report, "duration", duration);
+	bench_report_param(report, "nr_enqueuers", nr_enqueuers);
+	bench_report_param(report, "wdelay", wdelay);
+	bench_report_param(report, "nr_dequeuers", nr_dequeuers);
+	bench_report_param(report, "rduration", rduration);
+	bench_report_param(report, "nr_enqueues", tot_enqueues);
+	bench_report_param(report, "nr_dequeues", tot_dequeues);
+	bench_report_param(report, "nr_successful_enqueues", tot_successful_enqueues);
+	bench_report_param(report, "nr_empty_dest_enqueues", tot_empty_dest_enqueues);
+	bench_report_param(report, "nr_successful_dequeues", tot_successful_dequeues);
+	bench_report_param(report, "nr_splice", tot_splice);
+	bench_report_param(report, "nr_dequeue_last", tot_dequeue_last);
+	bench_report_param(report, "end_dequeues", end_dequeues);
+	bench_report_destroy(report);
 
 	if (tot_successful_enqueues != tot_successful_dequeues + end_dequeues) {
 		printf("WARNING! Discrepancy between nr succ. enqueues %llu vs "
@@ -38,6 +38,7 @@
 #include <urcu/tls-compat.h>
 #include <urcu/uatomic.h>
 #include "cpuset.h"
+#include "bench.h"
 #include "thread-id.h"
 
 /* hardcoded number of CPUs */
@@ -95,7 +96,6 @@ pthread_mutex_t affinity_mutex = PTHREAD_MUTEX_INITIALIZER;
 static void set_affinity(void)
 {
 #if HAVE_SCHED_SETAFFINITY
-	cpu_set_t mask;
 	int cpu, ret;
 #endif /* HAVE_SCHED_SETAFFINITY */
 
@@ -115,13 +115,7 @@ static void set_affinity(void)
 		exit(-1);
 	}
 
-	CPU_ZERO(&mask);
-	CPU_SET(cpu, &mask);
-#if SCHED_SETAFFINITY_ARGS == 2
-	sched_setaffinity(0, &mask);
-#else
-	sched_setaffinity(0, sizeof(mask), &mask);
-#endif
+	bench_pin_cpu(cpu);
 #endif /* HAVE_SCHED_SETAFFINITY */
 }
 
@@ -328,6 +322,7 @@ static void show_usage(int argc, char **argv)
 	printf("		Note: default: no external synchronization used.\n");
 	printf("	[-f] (force user-provided synchronization)\n");
 	printf("	[-w] Wait for dequeuer to empty stack\n");
+	printf("	[--format=json|csv] [--output=file] (report format)\n");
 	printf("\n");
 }
 
@@ -336,6 +331,7 @@ int main(int argc, char **argv)
 	int err;
 	pthread_t *tid_enqueuer, *tid_dequeuer;
 	void *tret;
+	struct bench_report *report;
 	unsigned long long *count_enqueuer, *count_dequeuer;
 	unsigned long long tot_enqueues = 0, tot_dequeues = 0;
 	unsigned long long tot_successful_enqueues = 0,
@@ -457,6 +453,7 @@ int main(int argc, char **argv)
 	count_dequeuer = calloc(nr_dequeuers, 4 * sizeof(*count_dequeuer));
 	cds_wfs_init(&s);
 
+	report = bench_report_create(argc, argv);
 	next_aff = 0;
 
 	for (i_thr = 0; i_thr < nr_enqueuers; i_thr++) {
@@ -474,6 +471,7 @@ int main(int argc, char **argv)
 
 	cmm_smp_mb();
 
+	bench_report_start(report);
 	test_go = 1;
 
 	for (i_thr = 0; i_thr < duration; i_thr++) {
@@ -484,6 +482,7 @@ int main(int argc, char **argv)
 		}
 	}
 
+	bench_report_stop(report);
 	test_stop_enqueue = 1;
 
 	if (test_wait_empty) {
@@ -502,6 +501,7 @@ int main(int argc, char **argv)
 		if (err != 0)
 			exit(1);
 		tot_enqueues += count_enqueuer[3 * i_thr];
+		bench_report_thread(report, "enqueuer", count_enqueuer[3 * i_thr]);
 		tot_successful_enqueues += count_enqueuer[3 * i_thr + 1];
 		tot_empty_dest_enqueues += count_enqueuer[3 * i_thr + 2];
 	}
@@ -510,6 +510,7 @@ int main(int argc, char **argv)
 		if (err != 0)
 			exit(1);
 		tot_dequeues += count_dequeuer[4 * i_thr];
+		bench_report_thread(report, "dequeuer", count_dequeuer[4 * i_thr]);
 		tot_successful_dequeues += count_dequeuer[4 * i_thr + 1];
 		tot_pop_all += count_dequeuer[4 * i_thr + 2];
 		tot_pop_last += count_dequeuer[4 * i_thr + 3];
@@ -540,6 +541,20 @@ int main(int argc, char **argv)
 		tot_successful_dequeues, tot_pop_all, tot_pop_last,
 		end_dequeues,
 		tot_enqueues + tot_dequeues);
+	bench_report_param(report, "duration", duration);
+	bench_report_param(report, "nr_enqueuers", nr_enqueuers);
+	bench_report_param(report, "wdelay", wdelay);
+	bench_report_param(report, "nr_dequeuers", nr_dequeuers);
+	bench_report_param(report, "rduration", rduration);
+	bench_report_param(report, "nr_enqueues", tot_enqueues);
+	bench_report_param(report, "nr_dequeues", tot_dequeues);
+	bench_report_param(report, "nr_successful_enqueues", tot_successful_enqueues);
+	bench_report_param(report, "nr_empty_dest_enqueues", tot_empty_dest_enqueues);
+	bench_report_param(report, "nr_successful_dequeues", tot_successful_dequeues);
+	bench_report_param(report, "nr_pop_all", tot_pop_all);
+	bench_report_param(report, "nr_pop_last", tot_pop_last);
+	bench_report_param(report, "end_dequeues", end_dequeues);
+	bench_report_destroy(report);
 	if (tot_successful_enqueues != tot_successful_dequeues + end_dequeues) {
 		printf("WARNING! Discrepancy between nr succ. enqueues %llu vs "
 		       "succ. dequeues + end dequeues %llu.\n",
@@ -0,0 +1,671 @@
+#ifndef _URCU_TESTS_BENCH_H
+#define _URCU_TESTS_BENCH_H
+
+/*
+ * bench.h
+ *
+ * Userspace RCU library - benchmark harness
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+/*
+ * Common code of the benchmark programs: CPU pinning, and a report of
+ * the operations done by each thread, printed in JSON or CSV in addition
+ * to the SUMMARY line of the program when it is given the
+ * --format=json|csv option, to stdout or to the file given with
+ * --output=FILE. Warmup and repeated runs are done by runbench.sh.
+ *
+ * Latency histograms have log-sized buckets: 16 per power of two, which
+ * bounds the error on a reported value to 1/16. Each thread records in
+ * its own histogram, merged when the run ends.
+ *
+ * With --perf, the threads count hardware events of their own run with
+ * perf_event_open(), user space only, reported per operation of their
+ * role. Events the processor or the kernel do not provide are reported
+ * as unavailable.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/time.h>
+#ifdef __linux__
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <linux/perf_event.h>
+#endif
+#include "cpuset.h"
+
+#define BENCH_MAX_PARAMS	128
+#define BENCH_MAX_ROLES		4
+
+#define BENCH_HIST_SUB_BITS	4
+#define BENCH_HIST_SUB		(1U << BENCH_HIST_SUB_BITS)
+#define BENCH_HIST_BUCKETS	((64 - BENCH_HIST_SUB_BITS + 1) * BENCH_HIST_SUB)
+
+enum bench_perf_event {
+	BENCH_PERF_CYCLES,
+	BENCH_PERF_INSTRUCTIONS,
+	BENCH_PERF_LLC_MISSES,
+	BENCH_PERF_DTLB_MISSES,
+	BENCH_PERF_NODE_MISSES,	/* Accesses missing the local NUMA node */
+	BENCH_PERF_NR,
+};
+
+static const char * const bench_perf_names[BENCH_PERF_NR] = {
+	"cycles",
+	"instructions",
+	"llc_misses",
+	"dtlb_misses",
+	"remote_node_misses",
+};
+
+/* Counters of a thread, enabled by bench_perf_init(). */
+struct bench_perf {
+	int enabled;
+	int fd[BENCH_PERF_NR];
+	uint64_t value[BENCH_PERF_NR];
+	int valid[BENCH_PERF_NR];
+};
+
+enum bench_format {
+	BENCH_FORMAT_SUMMARY = 0,
+	BENCH_FORMAT_JSON,
+	BENCH_FORMAT_CSV,
+};
+
+struct bench_param {
+	const char *key;
+	long long value;
+};
+
+struct bench_role {
+	const char *name;
+	unsigned int nr_threads, alloc_threads;
+	unsigned long long *ops;
+	/* Sums of the threads counters, and of their operations. */
+	unsigned int nr_perf;
+	uint64_t perf[BENCH_PERF_NR];
+	unsigned long long perf_ops;
+	int perf_invalid[BENCH_PERF_NR];
+};
+
+struct bench_report {
+	const char *name;
+	enum bench_format format;
+	int perf;
+	FILE *output;
+	double start, stop;
+	unsigned int nr_params;
+	struct bench_param params[BENCH_MAX_PARAMS];
+	unsigned int nr_roles;
+	struct bench_role roles[BENCH_MAX_ROLES];
+};
+
+struct bench_hist {
+	uint64_t count, max;
+	uint64_t buckets[BENCH_HIST_BUCKETS];
+};
+
+static inline unsigned int bench_hist_index(uint64_t value)
+{
+	unsigned int order;
+
+	if (value < BENCH_HIST_SUB)
+		return value;
+	order = 63 - __builtin_clzll(value);
+	return (order - BENCH_HIST_SUB_BITS + 1) * BENCH_HIST_SUB
+		+ ((value >> (order - BENCH_HIST_SUB_BITS))
+			& (BENCH_HIST_SUB - 1));
+}
+
+/* Highest value counted in a bucket. */
+static inline uint64_t bench_hist_bucket_max(unsigned int index)
+{
+	unsigned int shift;
+
+	if (index < BENCH_HIST_SUB)
+		return index;
+	shift = index / BENCH_HIST_SUB - 1;
+	return ((((uint64_t) BENCH_HIST_SUB + index % BENCH_HIST_SUB + 1))
+		<< shift) - 1;
+}
+
+static inline void bench_hist_record(struct bench_hist *hist, uint64_t value)
+{
+	hist->buckets[bench_hist_index(value)]++;
+	hist->count++;
+	if (value > hist->max)
+		hist->max = value;
+}
+
+static inline void bench_hist_merge(struct bench_hist *dst,
+		const struct bench_hist *src)
+{
+	unsigned int i;
+
+	for (i = 0; i < BENCH_HIST_BUCKETS; i++)
+		dst->buckets[i] += src->buckets[i];
+	dst->count += src->count;
+	if (src->max > dst->max)
+		dst->max = src->max;
+}
+
+/* Value below which a fraction of the recorded values are, from 0 to 1. */
+static inline uint64_t bench_hist_percentile(const struct bench_hist *hist,
+		double fraction)
+{
+	uint64_t rank, seen = 0;
+	unsigned int i;
+
+	if (!hist->count)
+		return 0;
+	rank = (uint64_t) (fraction * hist->count);
+	if (rank >= hist->count)
+		rank = hist->count - 1;
+	for (i = 0; i < BENCH_HIST_BUCKETS; i++) {
+		seen += hist->buckets[i];
+		if (seen > rank)
+			break;
+	}
+	return bench_hist_bucket_max(i) < hist->max ?
+		bench_hist_bucket_max(i) : hist->max;
+}
+
+static inline void bench_hist_print(const char *name,
+		const struct bench_hist *hist, const char *unit)
+{
+	printf("LATENCY %-25s count %12llu p50 %10llu p99 %10llu "
+		"p99.9 %10llu max %10llu (%s)\n", name,
+		(unsigned long long) hist->count,
+		(unsigned long long) bench_hist_percentile(hist, 0.5),
+		(unsigned long long) bench_hist_percentile(hist, 0.99),
+		(unsigned long long) bench_hist_percentile(hist, 0.999),
+		(unsigned long long) hist->max, unit);
+}
+
+/* Pin the calling thread on a CPU. */
+static inline void bench_pin_cpu(int cpu)
+{
+#if HAVE_SCHED_SETAFFINITY
+	cpu_set_t mask;
+
+	CPU_ZERO(&mask);
+	CPU_SET(cpu, &mask);
+#if SCHED_SETAFFINITY_ARGS == 2
+	sched_setaffinity(0, &mask);
+#else
+	sched_setaffinity(0, sizeof(mask), &mask);
+#endif
+#endif /* HAVE_SCHED_SETAFFINITY */
+}
+
+static inline double bench_now(void)
+{
+	struct timespec ts;
+
+#ifdef CLOCK_MONOTONIC
+	if (!clock_gettime(CLOCK_MONOTONIC, &ts))
+		return ts.tv_sec + ts.tv_nsec / 1e9;
+#endif
+	{
+		struct timeval tv;
+
+		gettimeofday(&tv, NULL);
+		return tv.tv_sec + tv.tv_usec / 1e6;
+	}
+}
+
+/*
+ * Create the report of the program, parsing the harness options in its
+ * arguments. The programs ignore options starting with "--".
+ */
+static inline struct bench_report *bench_report_create(int argc, char **argv)
+{
+	struct bench_report *report;
+	const char *name;
+	int i;
+
+	report = calloc(1, sizeof(*report));
+	if (!report) {
+		perror("calloc");
+		exit(-1);
+	}
+	name = strrchr(argv[0], '/');
+	name = name ? name + 1 : argv[0];
+	/* libtool runs the uninstalled programs as lt-<name>. */
+	if (!strncmp(name, "lt-", 3))
+		name += 3;
+	report->name = name;
+	report->output = stdout;
+	for (i = 1; i < argc; i++) {
+		if (!strcmp(argv[i], "--format=json")) {
+			report->format = BENCH_FORMAT_JSON;
+		} else if (!strcmp(argv[i], "--format=csv")) {
+			report->format = BENCH_FORMAT_CSV;
+		} else if (!strcmp(argv[i], "--perf")) {
+			report->perf = 1;
+		} else if (!strncmp(argv[i], "--output=", 9)) {
+			report->output = fopen(argv[i] + 9, "a");
+			if (!report->output) {
+				perror("fopen");
+				exit(-1);
+			}
+		}
+	}
+	return report;
+}
+
+/* Mark the start and the end of the measured run. */
+static inline void bench_report_start(struct bench_report *report)
+{
+	report->start = bench_now();
+}
+
+static inline void bench_report_stop(struct bench_report *report)
+{
+	report->stop = bench_now();
+}
+
+static inline void bench_report_param(struct bench_report *report,
+		const char *key, long long value)
+{
+	if (report->nr_params == BENCH_MAX_PARAMS)
+		abort();
+	report->params[report->nr_params].key = key;
+	report->params[report->nr_params++].value = value;
+}
+
+/* Add the percentiles of a latency histogram to the parameters. */
+#define bench_report_hist(report, name, hist)				\
+	do {								\
+		bench_report_param(report, name "_count", (hist)->count); \
+		bench_report_param(report, name "_p50",			\
+			bench_hist_percentile(hist, 0.5));		\
+		bench_report_param(report, name "_p99",			\
+			bench_hist_percentile(hist, 0.99));		\
+		bench_report_param(report, name "_p999",		\
+			bench_hist_percentile(hist, 0.999));		\
+		bench_report_param(report, name "_max", (hist)->max);	\
+	} while (0)
+
+static inline struct bench_role *bench_report_role(
+		struct bench_report *report, const char *role)
+{
+	unsigned int i;
+
+	for (i = 0; i < report->nr_roles; i++) {
+		if (!strcmp(report->roles[i].name, role))
+			break;
+	}
+	if (i == report->nr_roles) {
+		if (i == BENCH_MAX_ROLES)
+			abort();
+		report->roles[report->nr_roles++].name = role;
+	}
+	return &report->roles[i];
+}
+
+/* Add the number of operations done by a thread of a given role. */
+static inline void bench_report_thread(struct bench_report *report,
+		const char *role, unsigned long long ops)
+{
+	struct bench_role *r = bench_report_role(report, role);
+
+	if (r->nr_threads == r->alloc_threads) {
+		r->alloc_threads = r->alloc_threads ? 2 * r->alloc_threads : 16;
+		r->ops = realloc(r->ops, r->alloc_threads * sizeof(*r->ops));
+		if (!r->ops) {
+			perror("realloc");
+			exit(-1);
+		}
+	}
+	r->ops[r->nr_threads++] = ops;
+}
+
+/* Enable the counters of a thread if requested, before creating it. */
+static inline void bench_perf_init(struct bench_report *report,
+		struct bench_perf *perf)
+{
+	int i;
+
+	memset(perf, 0, sizeof(*perf));
+	perf->enabled = report->perf;
+	for (i = 0; i < BENCH_PERF_NR; i++)
+		perf->fd[i] = -1;
+}
+
+#ifdef __linux__
+static inline void bench_perf_attr(struct perf_event_attr *attr,
+		enum bench_perf_event event)
+{
+	memset(attr, 0, sizeof(*attr));
+	attr->size = sizeof(*attr);
+	attr->disabled = 1;
+	attr->exclude_kernel = 1;
+	attr->exclude_hv = 1;
+	attr->read_format = PERF_FORMAT_TOTAL_TIME_ENABLED
+		| PERF_FORMAT_TOTAL_TIME_RUNNING;
+	switch (event) {
+	case BENCH_PERF_CYCLES:
+		attr->type = PERF_TYPE_HARDWARE;
+		attr->config = PERF_COUNT_HW_CPU_CYCLES;
+		break;
+	case BENCH_PERF_INSTRUCTIONS:
+		attr->type = PERF_TYPE_HARDWARE;
+		attr->config = PERF_COUNT_HW_INSTRUCTIONS;
+		break;
+	case BENCH_PERF_LLC_MISSES:
+		attr->type = PERF_TYPE_HARDWARE;
+		attr->config = PERF_COUNT_HW_CACHE_MISSES;
+		break;
+	case BENCH_PERF_DTLB_MISSES:
+		attr->type = PERF_TYPE_HW_CACHE;
+		attr->config = PERF_COUNT_HW_CACHE_DTLB
+			| (PERF_COUNT_HW_CACHE_OP_READ << 8)
+			| (PERF_COUNT_HW_CACHE_RESULT_MISS << 16);
+		break;
+	case BENCH_PERF_NODE_MISSES:
+		attr->type = PERF_TYPE_HW_CACHE;
+		attr->config = PERF_COUNT_HW_CACHE_NODE
+			| (PERF_COUNT_HW_CACHE_OP_READ << 8)
+			| (PERF_COUNT_HW_CACHE_RESULT_MISS << 16);
+		break;
+	default:
+		abort();
+	}
+}
+#endif /* __linux__ */
+
+/*
+ * Open and start the counters of the calling thread, once it is about to
+ * run its first operation.
+ */
+static inline void bench_perf_start(struct bench_perf *perf)
+{
+#ifdef __linux__
+	struct perf_event_attr attr;
+	int i;
+
+	if (!perf->enabled)
+		return;
+	for (i = 0; i < BENCH_PERF_NR; i++) {
+		bench_perf_attr(&attr, (enum bench_perf_event) i);
+		perf->fd[i] = syscall(__NR_perf_event_open, &attr, 0, -1, -1, 0);
+	}
+	for (i = 0; i < BENCH_PERF_NR; i++) {
+		if (perf->fd[i] >= 0)
+			(void) ioctl(perf->fd[i], PERF_EVENT_IOC_ENABLE, 0);
+	}
+#else
+	(void) perf;
+#endif
+}
+
+/*
+ * Stop the counters of the calling thread and read them, scaled up when
+ * the kernel multiplexed them.
+ */
+static inline void bench_perf_stop(struct bench_perf *perf)
+{
+#ifdef __linux__
+	uint64_t buf[3];	/* value, time enabled, time running */
+	int i;
+
+	if (!perf->enabled)
+		return;
+	for (i = 0; i < BENCH_PERF_NR; i++) {
+		if (perf->fd[i] >= 0)
+			(void) ioctl(perf->fd[i], PERF_EVENT_IOC_DISABLE, 0);
+	}
+	for (i = 0; i < BENCH_PERF_NR; i++) {
+		if (perf->fd[i] < 0)
+			continue;
+		if (read(perf->fd[i], buf, sizeof(buf)) == sizeof(buf)
+				&& buf[2]) {
+			perf->value[i] = buf[2] < buf[1] ?
+				(uint64_t) ((double) buf[0] * buf[1] / buf[2])
+				: buf[0];
+			perf->valid[i] = 1;
+		}
+		close(perf->fd[i]);
+		perf->fd[i] = -1;
+	}
+#else
+	(void) perf;
+#endif
+}
+
+/* Add the counters of a thread of a given role, which did ops operations. */
+static inline void bench_report_perf(struct bench_report *report,
+		const char *role, struct bench_perf *perf,
+		unsigned long long ops)
+{
+	struct bench_role *r;
+	int i;
+
+	if (!report->perf)
+		return;
+	r = bench_report_role(report, role);
+	r->nr_perf++;
+	r->perf_ops += ops;
+	for (i = 0; i < BENCH_PERF_NR; i++) {
+		if (perf->valid[i])
+			r->perf[i] += perf->value[i];
+		else
+			r->perf_invalid[i] = 1;
+	}
+}
+
+/* Events of a role per operation, or a negative value if unavailable. */
+static inline double bench_role_perf(struct bench_role *r, int event)
+{
+	if (!r->nr_perf || r->perf_invalid[event])
+		return -1;
+	return r->perf_ops ? (double) r->perf[event] / r->perf_ops : 0;
+}
+
+static inline void bench_report_print_perf(struct bench_report *report)
+{
+	unsigned int i;
+	int j;
+
+	for (i = 0; i < report->nr_roles; i++) {
+		struct bench_role *r = &report->roles[i];
+
+		if (!r->nr_perf)
+			continue;
+		printf("PERF %-10s ops %12llu", r->name, r->perf_ops);
+		for (j = 0; j < BENCH_PERF_NR; j++) {
+			if (bench_role_perf(r, j) < 0)
+				printf(" %s/op n/a", bench_perf_names[j]);
+			else
+				printf(" %s/op %.3f", bench_perf_names[j],
+					bench_role_perf(r, j));
+		}
+		printf("\n");
+	}
+}
+
+static inline double bench_report_duration(struct bench_report *report)
+{
+	return report->stop > report->start ?
+		report->stop - report->start : 0;
+}
+
+static inline double bench_rate(struct bench_report *report,
+		unsigned long long ops)
+{
+	double duration = bench_report_duration(report);
+
+	return duration ? ops / duration : 0;
+}
+
+/* Square root by Newton's method, sparing the programs a link on libm. */
+static inline double bench_sqrt(double x)
+{
+	double r = x > 1 ? x : 1;
+	int i;
+
+	if (x <= 0)
+		return 0;
+	for (i = 0; i < 64; i++)
+		r = (r + x / r) / 2;
+	return r;
+}
+
+/* Sum, mean and standard deviation of the operations of the role threads. */
+static inline unsigned long long bench_role_stats(struct bench_role *r,
+		double *mean, double *stddev)
+{
+	unsigned long long sum = 0;
+	double var = 0;
+	unsigned int i;
+
+	for (i = 0; i < r->nr_threads; i++)
+		sum += r->ops[i];
+	*mean = r->nr_threads ? (double) sum / r->nr_threads : 0;
+	for (i = 0; i < r->nr_threads; i++)
+		var += (r->ops[i] - *mean) * (r->ops[i] - *mean);
+	*stddev = r->nr_threads ? bench_sqrt(var / r->nr_threads) : 0;
+	return sum;
+}
+
+static inline void bench_report_print_json(struct bench_report *report)
+{
+	FILE *out = report->output;
+	unsigned long long sum, total = 0;
+	double mean, stddev;
+	unsigned int i, j;
+
+	fprintf(out, "{\"name\":\"%s\",\"duration_s\":%.6f,\"params\":{",
+		report->name, bench_report_duration(report));
+	for (i = 0; i < report->nr_params; i++)
+		fprintf(out, "%s\"%s\":%lld", i ? "," : "",
+			report->params[i].key, report->params[i].value);
+	fprintf(out, "},\"roles\":[");
+	for (i = 0; i < report->nr_roles; i++) {
+		struct bench_role *r = &report->roles[i];
+
+		sum = bench_role_stats(r, &mean, &stddev);
+		total += sum;
+		fprintf(out, "%s{\"role\":\"%s\",\"nr_threads\":%u,"
+			"\"ops\":%llu,\"ops_per_sec\":%.1f,"
+			"\"thread_ops_mean\":%.1f,\"thread_ops_stddev\":%.1f,"
+			"\"thread_ops\":[",
+			i ? "," : "", r->name, r->nr_threads, sum,
+			bench_rate(report, sum), mean, stddev);
+		for (j = 0; j < r->nr_threads; j++)
+			fprintf(out, "%s%llu", j ? "," : "", r->ops[j]);
+		fprintf(out, "]");
+		if (r->nr_perf) {
+			fprintf(out, ",\"perf\":{");
+			for (j = 0; j < BENCH_PERF_NR; j++) {
+				if (bench_role_perf(r, j) < 0)
+					fprintf(out, "%s\"%s_per_op\":null",
+						j ? "," : "", bench_perf_names[j]);
+				else
+					fprintf(out, "%s\"%s_per_op\":%.3f",
+						j ? "," : "", bench_perf_names[j],
+						bench_role_perf(r, j));
+			}
+			fprintf(out, "}");
+		}
+		fprintf(out, "}");
+	}
+	fprintf(out, "],\"ops\":%llu,\"ops_per_sec\":%.1f}\n",
+		total, bench_rate(report, total));
+}
+
+/*
+ * One line per thread, and a line per role with the total, the mean and
+ * the standard deviation over its threads, identified by an empty thread
+ * index.
+ */
+static inline void bench_report_print_csv(struct bench_report *report)
+{
+	FILE *out = report->output;
+	double mean, stddev;
+	unsigned long long sum;
+	unsigned int i, j, k;
+
+	fprintf(out, "name,role,thread,ops,ops_per_sec,"
+		"thread_ops_mean,thread_ops_stddev,duration_s");
+	for (k = 0; report->perf && k < BENCH_PERF_NR; k++)
+		fprintf(out, ",%s_per_op", bench_perf_names[k]);
+	for (i = 0; i < report->nr_params; i++)
+		fprintf(out, ",%s", report->params[i].key);
+	fprintf(out, "\n");
+	for (i = 0; i < report->nr_roles; i++) {
+		struct bench_role *r = &report->roles[i];
+
+		sum = bench_role_stats(r, &mean, &stddev);
+		for (j = 0; j <= r->nr_threads; j++) {
+			if (j < r->nr_threads)
+				fprintf(out, "%s,%s,%u,%llu,%.1f,,,%.6f",
+					report->name, r->name, j, r->ops[j],
+					bench_rate(report, r->ops[j]),
+					bench_report_duration(report));
+			else
+				fprintf(out, "%s,%s,,%llu,%.1f,%.1f,%.1f,%.6f",
+					report->name, r->name, sum,
+					bench_rate(report, sum), mean, stddev,
+					bench_report_duration(report));
+			/* Counters are summed per role only. */
+			for (k = 0; report->perf && k < BENCH_PERF_NR; k++) {
+				if (j < r->nr_threads
+						|| bench_role_perf(r, k) < 0)
+					fprintf(out, ",");
+				else
+					fprintf(out, ",%.3f",
+						bench_role_perf(r, k));
+			}
+			for (k = 0; k < report->nr_params; k++)
+				fprintf(out, ",%lld", report->params[k].value);
+			fprintf(out, "\n");
+		}
+	}
+}
+
+/* Print the report in the format requested, and free it. */
+static inline void bench_report_destroy(struct bench_report *report)
+{
+	unsigned int i;
+
+	switch (report->format) {
+	case BENCH_FORMAT_JSON:
+		bench_report_print_json(report);
+		break;
+	case BENCH_FORMAT_CSV:
+		bench_report_print_csv(report);
+		break;
+	case BENCH_FORMAT_SUMMARY:
+		bench_report_print_perf(report);
+		break;
+	}
+	if (report->output != stdout)
+		fclose(report->output);
+	else
+		fflush(stdout);
+	for (i = 0; i < report->nr_roles; i++)
+		free(report->roles[i].ops);
+	free(report);
+}
+
+#endif /* _URCU_TESTS_BENCH_H */
@@ -0,0 +1,241 @@
+/*
+ * test_aht.c
+ *
+ * Userspace RCU library - test RCU hash table of arena nodes
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#include <stdlib.h>
+#include <stdint.h>
+#include <stddef.h>
+#include <errno.h>
+#include <poll.h>
+#include <pthread.h>
+#include <urcu.h>
+#include <urcu/rcuaht.h>
+
+#include "tap.h"
+
+#define NR_KEYS		5000
+#define MAX_NODES	8192
+#define NR_READERS	2
+#define NR_STABLE	256
+#define NR_CHURN	20000
+
+struct item {
+	uint32_t key;
+	uint32_t value;
+	struct cds_aht_node node;
+};
+
+static struct cds_aht *ht;
+static int stop;
+static unsigned long nr_bad_read, nr_reads;
+
+/* Multiplicative hash, spreading consecutive keys over the buckets. */
+static unsigned long hash_key(uint32_t key)
+{
+	return key * 2654435761UL;
+}
+
+static int match(struct cds_aht_node *node, const void *key)
+{
+	return caa_container_of(node, struct item, node)->key
+		== *(const uint32_t *) key;
+}
+
+static struct item *lookup(uint32_t key)
+{
+	struct cds_aht_node *node;
+
+	node = cds_aht_lookup(ht, hash_key(key), match, &key);
+	return node ? caa_container_of(node, struct item, node) : NULL;
+}
+
+static int add(uint32_t key, uint32_t value, int replace)
+{
+	struct item *item = cds_aht_alloc(ht);
+
+	if (!item)
+		abort();
+	item->key = key;
+	item->value = value;
+	if (replace)
+		return cds_aht_add_replace(ht, hash_key(key), &item->node,
+			match, &key);
+	return cds_aht_add_unique(ht, hash_key(key), &item->node, match, &key);
+}
+
+static int del(uint32_t key)
+{
+	struct item *item;
+	int ret;
+
+	rcu_read_lock();
+	item = lookup(key);
+	ret = item ? cds_aht_del(ht, &item->node) : -ENOENT;
+	rcu_read_unlock();
+	return ret;
+}
+
+/* Stable keys are never removed: readers must always find them. */
+static void *thr_reader(void *arg)
+{
+	struct item *item;
+	uint32_t key;
+
+	rcu_register_thread();
+	while (!uatomic_read(&stop)) {
+		rcu_read_lock();
+		for (key = 0; key < NR_STABLE; key++) {
+			item = lookup(key);
+			if (!item || item->value != key)
+				uatomic_inc(&nr_bad_read);
+		}
+		rcu_read_unlock();
+		uatomic_inc(&nr_reads);
+	}
+	rcu_unregister_thread();
+	return NULL;
+}
+
+int main(int argc, char **argv)
+{
+	pthread_t tid[NR_READERS];
+	struct cds_aht_node *node;
+	struct cds_aht *small;
+	unsigned long i, nr_bad = 0, nr_seen = 0, sum = 0;
+	uint32_t key;
+	void *obj[4];
+
+	plan_tests(8);
+
+	rcu_register_thread();
+	ok(sizeof(struct cds_aht_node) == 8
+			&& !cds_aht_new(sizeof(struct item), sizeof(struct item),
+				MAX_NODES, 1)
+			&& !cds_aht_new(sizeof(struct item),
+				offsetof(struct item, node), 0, 1)
+			&& !cds_aht_new(sizeof(struct item),
+				offsetof(struct item, node),
+				CDS_AHT_MAX_NODES + 1, 1),
+		"8-byte nodes, invalid layouts and sizes rejected");
+
+	ht = cds_aht_new(sizeof(struct item), offsetof(struct item, node),
+		MAX_NODES, 1);
+	if (!ht)
+		abort();
+	for (key = 0; key < NR_KEYS; key++) {
+		if (add(key, key, 0))
+			nr_bad++;
+	}
+	rcu_read_lock();
+	for (key = 0; key < NR_KEYS; key++) {
+		if (!lookup(key) || lookup(key)->value != key)
+			nr_bad++;
+	}
+	ok(nr_bad == 0 && cds_aht_count(ht) == NR_KEYS && !lookup(NR_KEYS),
+		"adds, growing from one bucket");
+	rcu_read_unlock();
+
+	nr_bad = 0;
+	if (add(1, 0, 0) != -EEXIST)
+		nr_bad++;
+	if (add(2, 20, 1) != 1)
+		nr_bad++;
+	rcu_read_lock();
+	ok(nr_bad == 0 && lookup(1)->value == 1 && lookup(2)->value == 20
+			&& cds_aht_count(ht) == NR_KEYS,
+		"add unique and add replace");
+	rcu_read_unlock();
+
+	nr_bad = 0;
+	for (key = 1; key < NR_KEYS; key += 2) {
+		if (del(key))
+			nr_bad++;
+	}
+	if (del(1) != -ENOENT)
+		nr_bad++;
+	rcu_read_lock();
+	for (key = 0; key < NR_KEYS; key++) {
+		if ((lookup(key) == NULL) != (key & 1))
+			nr_bad++;
+	}
+	cds_aht_for_each(ht, node) {
+		nr_seen++;
+		sum += caa_container_of(node, struct item, node)->key;
+	}
+	rcu_read_unlock();
+	ok(nr_bad == 0 && cds_aht_count(ht) == NR_KEYS / 2
+			&& nr_seen == NR_KEYS / 2
+			&& sum == (unsigned long) (NR_KEYS / 2) * (NR_KEYS / 2 - 1),
+		"removals, iteration visits each node once");
+
+	/* A full arena reclaims the removed objects. */
+	small = cds_aht_new(sizeof(struct item), offsetof(struct item, node),
+		3, 1);
+	for (i = 0; i < 3; i++)
+		obj[i] = cds_aht_alloc(small);
+	obj[3] = cds_aht_alloc(small);
+	key = 7;
+	((struct item *) obj[0])->key = key;
+	if (cds_aht_add_unique(small, hash_key(key),
+			&((struct item *) obj[0])->node, match, &key))
+		abort();
+	if (cds_aht_del(small, &((struct item *) obj[0])->node))
+		abort();
+	cds_aht_free(small, obj[1]);
+	ok(obj[2] && !obj[3] && cds_aht_alloc(small) == obj[1]
+			&& cds_aht_alloc(small) == obj[0]
+			&& !cds_aht_alloc(small),
+		"arena exhaustion, freed and removed objects reused");
+	cds_aht_destroy(small);
+
+	/* Readers look up stable keys while the others churn. */
+	for (key = 0; key < NR_KEYS; key += 2) {
+		if (del(key))
+			abort();
+	}
+	for (key = 0; key < NR_STABLE; key++) {
+		if (add(key, key, 0))
+			abort();
+	}
+	for (i = 0; i < NR_READERS; i++) {
+		if (pthread_create(&tid[i], NULL, thr_reader, NULL))
+			abort();
+	}
+	nr_bad = 0;
+	for (i = 0; i < NR_CHURN; i++) {
+		key = NR_STABLE + i % (MAX_NODES / 2);
+		if (add(key, key, 1) < 0 || (i % 3 == 0 && del(key)))
+			nr_bad++;
+		if (uatomic_read(&nr_reads) < i / 64)
+			(void) poll(NULL, 0, 1);
+	}
+	uatomic_set(&stop, 1);
+	for (i = 0; i < NR_READERS; i++) {
+		if (pthread_join(tid[i], NULL))
+			abort();
+	}
+	ok(nr_bad == 0, "concurrent updates");
+	ok(nr_bad_read == 0, "concurrent readers find stable keys "
+		"(%lu reads)", nr_reads);
+
+	cds_aht_destroy(ht);
+	ok(1, "table destroyed");
+	rcu_unregister_thread();
+	return exit_status();
+}
@@ -0,0 +1,105 @@
+/*
+ * test_asymmetric_fence.c
+ *
+ * Userspace RCU library - test asymmetric memory fences
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#include <stdlib.h>
+#include <poll.h>
+#include <pthread.h>
+#include <urcu/uatomic.h>
+#include <urcu/asymmetric-fence.h>
+
+#include "tap.h"
+
+#define NR_ROUNDS	2000
+
+/*
+ * Biased lock: the owner side takes it with a store and a light fence,
+ * the other side with a store and a heavy fence, and each backs off
+ * when it sees the flag of the other. Both sides must never hold it at
+ * once.
+ */
+static int owner_flag, other_flag;
+static int nr_holders, nr_overlaps;
+static int stop_owner;
+static unsigned long nr_owner_runs;
+
+static void hold(void)
+{
+	if (uatomic_add_return(&nr_holders, 1) != 1)
+		uatomic_inc(&nr_overlaps);
+	caa_cpu_relax();
+	uatomic_dec(&nr_holders);
+}
+
+static void *thr_owner(void *arg)
+{
+	while (!uatomic_read(&stop_owner)) {
+		CMM_STORE_SHARED(owner_flag, 1);
+		cmm_asymmetric_fence_light();
+		if (!CMM_LOAD_SHARED(other_flag))
+			hold();
+		cmm_barrier();
+		CMM_STORE_SHARED(owner_flag, 0);
+		if (uatomic_add_return(&nr_owner_runs, 1) % 64 == 0)
+			(void) poll(NULL, 0, 0);
+	}
+	return NULL;
+}
+
+int main(int argc, char **argv)
+{
+	pthread_t tid;
+	unsigned long i, nr_held = 0;
+	bool available;
+
+	plan_tests(4);
+
+	cmm_asymmetric_fence_light();
+	available = cmm_asymmetric_fence_init();
+	ok(available == !!cmm_asymmetric_fence_sys_membarrier,
+		"init reports whether the light fence is a compiler barrier (%s)",
+		available ? "membarrier" : "fallback");
+	ok(cmm_asymmetric_fence_init() == available, "init is idempotent");
+	cmm_asymmetric_fence_heavy();
+	ok(1, "heavy fence");
+
+	if (pthread_create(&tid, NULL, thr_owner, NULL))
+		abort();
+	while (uatomic_read(&nr_owner_runs) < 1)
+		(void) poll(NULL, 0, 1);
+	for (i = 0; i < NR_ROUNDS; i++) {
+		CMM_STORE_SHARED(other_flag, 1);
+		cmm_asymmetric_fence_heavy();
+		if (!CMM_LOAD_SHARED(owner_flag)) {
+			hold();
+			nr_held++;
+		}
+		cmm_smp_mb();
+		CMM_STORE_SHARED(other_flag, 0);
+		if (i % 64 == 0)
+			(void) poll(NULL, 0, 0);
+	}
+	uatomic_set(&stop_owner, 1);
+	if (pthread_join(tid, NULL))
+		abort();
+	ok(!nr_overlaps, "biased lock excludes (%lu held, %lu owner rounds)",
+		nr_held, nr_owner_runs);
+
+	return exit_status();
+}
@@ -0,0 +1,130 @@
+/*
+ * test_brlock.c
+ *
+ * Userspace RCU library - test per-CPU reader-writer lock
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#include <stdlib.h>
+#include <poll.h>
+#include <pthread.h>
+#include <urcu/uatomic.h>
+#include <urcu/brlock.h>
+
+#include "tap.h"
+
+#define NR_READERS	3
+#define NR_WRITERS	2
+#define NR_WRITES	2000
+
+static struct cds_brlock *lock;
+
+/* Updated in place by writers, always equal for readers. */
+static struct {
+	unsigned long a, b;
+} shared;
+
+static int stop, writer_locked;
+static unsigned long nr_reads, nr_bad_reads;
+
+static void *thr_reader(void *arg)
+{
+	unsigned long a, reads = 0, bad = 0;
+
+	while (!uatomic_read(&stop)) {
+		cds_brlock_read_lock(lock);
+		a = CMM_LOAD_SHARED(shared.a);
+		caa_cpu_relax();
+		if (CMM_LOAD_SHARED(shared.b) != a)
+			bad++;
+		cds_brlock_read_unlock(lock);
+		if (++reads % 256 == 0)
+			(void) poll(NULL, 0, 0);
+	}
+	uatomic_add(&nr_reads, reads);
+	uatomic_add(&nr_bad_reads, bad);
+	return NULL;
+}
+
+static void *thr_writer(void *arg)
+{
+	unsigned long i;
+
+	for (i = 0; i < NR_WRITES; i++) {
+		cds_brlock_write_lock(lock);
+		/* Not atomic: writers must exclude each other. */
+		CMM_STORE_SHARED(shared.a, shared.a + 1);
+		(void) poll(NULL, 0, 0);
+		CMM_STORE_SHARED(shared.b, shared.b + 1);
+		cds_brlock_write_unlock(lock);
+	}
+	return NULL;
+}
+
+static void *thr_write_once(void *arg)
+{
+	cds_brlock_write_lock(lock);
+	uatomic_set(&writer_locked, 1);
+	cds_brlock_write_unlock(lock);
+	return NULL;
+}
+
+int main(int argc, char **argv)
+{
+	pthread_t readers[NR_READERS], writers[NR_WRITERS], tid;
+	int i;
+
+	plan_tests(4);
+
+	lock = cds_brlock_new(0);
+	ok(lock != NULL, "create lock");
+
+	cds_brlock_read_lock(lock);
+	if (pthread_create(&tid, NULL, thr_write_once, NULL))
+		abort();
+	(void) poll(NULL, 0, 50);
+	ok(!uatomic_read(&writer_locked), "writer waits for the reader");
+	cds_brlock_read_unlock(lock);
+	if (pthread_join(tid, NULL))
+		abort();
+	ok(uatomic_read(&writer_locked), "writer locks once the reader "
+		"unlocked");
+
+	for (i = 0; i < NR_READERS; i++) {
+		if (pthread_create(&readers[i], NULL, thr_reader, NULL))
+			abort();
+	}
+	for (i = 0; i < NR_WRITERS; i++) {
+		if (pthread_create(&writers[i], NULL, thr_writer, NULL))
+			abort();
+	}
+	for (i = 0; i < NR_WRITERS; i++) {
+		if (pthread_join(writers[i], NULL))
+			abort();
+	}
+	uatomic_set(&stop, 1);
+	for (i = 0; i < NR_READERS; i++) {
+		if (pthread_join(readers[i], NULL))
+			abort();
+	}
+	ok(!nr_bad_reads && shared.a == NR_WRITERS * NR_WRITES
+		&& shared.b == shared.a,
+		"readers and writers exclude each other (%lu reads)",
+		nr_reads);
+
+	cds_brlock_destroy(lock);
+	return exit_status();
+}
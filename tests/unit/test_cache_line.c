@@ -0,0 +1,60 @@
+/*
+ * test_cache_line.c
+ *
+ * Userspace RCU library - test runtime cache line size
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <urcu/cache-line.h>
+
+#include "tap.h"
+
+int main(int argc, char **argv)
+{
+	unsigned int size = caa_get_cache_line_size();
+	size_t align = caa_max((size_t) size, (size_t) CAA_CACHE_LINE_SIZE);
+	char *p, *q;
+
+	plan_tests(5);
+
+	ok(size >= 16 && size <= 4096 && !(size & (size - 1)),
+		"cache line size is a power of two (%u bytes, %u at build time)",
+		size, (unsigned int) CAA_CACHE_LINE_SIZE);
+	ok(caa_get_cache_line_size() == size, "cache line size is stable");
+
+	p = caa_cache_line_alloc(1);
+	q = caa_cache_line_alloc(align + 1);
+	ok(p && q && !((uintptr_t) p % align) && !((uintptr_t) q % align),
+		"allocations are aligned");
+	if (!p || !q)
+		abort();
+	/* Rounded up to whole lines. */
+	memset(p, 0, align);
+	memset(q, 0, 2 * align);
+	free(p);
+	free(q);
+	ok(1, "allocations are rounded up to whole lines");
+
+	errno = 0;
+	ok(!caa_cache_line_alloc(SIZE_MAX) && errno == ENOMEM,
+		"oversized allocation fails");
+
+	return exit_status();
+}
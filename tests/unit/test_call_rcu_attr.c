@@ -0,0 +1,121 @@
+/*
+ * test_call_rcu_attr.c
+ *
+ * Userspace RCU library - test call_rcu thread attributes
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#include <stdlib.h>
+#include <errno.h>
+#include <sched.h>
+#include <pthread.h>
+#include <urcu.h>
+
+#include "tap.h"
+
+#define NR_CBS		100
+#define STACK_SIZE	(1024 * 1024)
+
+static struct rcu_head heads[NR_CBS];
+static unsigned long nr_invoked;
+
+static void count_cb(struct rcu_head *head)
+{
+	uatomic_inc(&nr_invoked);
+}
+
+/* Queue callbacks on crdp, and wait for them. */
+static int run_cbs(struct call_rcu_data *crdp)
+{
+	int i;
+
+	nr_invoked = 0;
+	set_thread_call_rcu_data(crdp);
+	for (i = 0; i < NR_CBS; i++)
+		call_rcu(&heads[i], count_cb);
+	rcu_barrier_crdp(crdp);
+	set_thread_call_rcu_data(NULL);
+	return uatomic_read(&nr_invoked) == NR_CBS;
+}
+
+int main(int argc, char **argv)
+{
+	struct call_rcu_attr attr = { 0 };
+	struct call_rcu_data *crdp;
+	struct sched_param param;
+	pthread_attr_t thread_attr;
+	cpu_set_t cpuset, thread_cpuset;
+	size_t stack_size = 0;
+	int policy = -1;
+
+	plan_tests(6);
+
+	rcu_register_thread();
+
+	attr.poll_interval_us = 100;
+	crdp = create_call_rcu_data_attr(URCU_CALL_RCU_RT, -1, &attr);
+	ok(crdp && run_cbs(crdp), "RT thread busy-polling its queue");
+	call_rcu_data_free(crdp);
+
+	attr.poll_interval_us = 2000;
+	crdp = create_call_rcu_data_attr(URCU_CALL_RCU_RT, -1, &attr);
+	ok(crdp && run_cbs(crdp), "RT thread sleeping between polls");
+	call_rcu_data_free(crdp);
+
+	attr.poll_interval_us = 0;
+	CPU_ZERO(&cpuset);
+	CPU_SET(0, &cpuset);
+	attr.cpuset = &cpuset;
+	attr.cpuset_size = sizeof(cpuset);
+	attr.stack_size = STACK_SIZE;
+	crdp = create_call_rcu_data_attr(0, -1, &attr);
+	if (!crdp || !run_cbs(crdp))
+		abort();
+	if (pthread_getaffinity_np(get_call_rcu_thread(crdp),
+			sizeof(thread_cpuset), &thread_cpuset))
+		abort();
+	ok(CPU_EQUAL(&cpuset, &thread_cpuset), "thread runs on the cpuset");
+	if (!pthread_getattr_np(get_call_rcu_thread(crdp), &thread_attr)) {
+		(void) pthread_attr_getstacksize(&thread_attr, &stack_size);
+		(void) pthread_attr_destroy(&thread_attr);
+	}
+	ok(stack_size >= STACK_SIZE, "thread stack size (%zu)", stack_size);
+	call_rcu_data_free(crdp);
+
+	attr.cpuset = NULL;
+	attr.stack_size = 0;
+	attr.sched_policy = SCHED_FIFO;
+	attr.sched_priority = sched_get_priority_min(SCHED_FIFO);
+	crdp = create_call_rcu_data_attr(URCU_CALL_RCU_RT, -1, &attr);
+	if (crdp) {
+		if (pthread_getschedparam(get_call_rcu_thread(crdp), &policy,
+				&param))
+			abort();
+		ok(policy == SCHED_FIFO && run_cbs(crdp),
+			"SCHED_FIFO call_rcu thread");
+		call_rcu_data_free(crdp);
+	} else {
+		ok(errno == EPERM, "SCHED_FIFO refused without privilege");
+	}
+
+	attr.sched_policy = SCHED_FIFO;
+	attr.sched_priority = -1;
+	crdp = create_call_rcu_data_attr(0, -1, &attr);
+	ok(!crdp && errno == EINVAL, "invalid priority fails creation");
+
+	rcu_unregister_thread();
+	return exit_status();
+}
@@ -0,0 +1,100 @@
+/*
+ * test_call_rcu_batch.c
+ *
+ * Userspace RCU library - test per-thread call_rcu batches
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#include <stdlib.h>
+#include <pthread.h>
+#include <urcu.h>
+
+#include "tap.h"
+
+#define BATCH_SIZE	32
+#define NR_CBS		100
+
+static struct rcu_head heads[2 * NR_CBS];
+static unsigned long nr_invoked;
+
+static void count_cb(struct rcu_head *head)
+{
+	uatomic_inc(&nr_invoked);
+}
+
+static void queue_cbs(struct rcu_head *first, int nr)
+{
+	int i;
+
+	for (i = 0; i < nr; i++)
+		call_rcu(&first[i], count_cb);
+}
+
+static void *thread_fn(void *arg)
+{
+	rcu_register_thread();
+	if (set_thread_call_rcu_batch(BATCH_SIZE))
+		abort();
+	/* Left partially batched at exit. */
+	queue_cbs(&heads[NR_CBS], 5);
+	rcu_unregister_thread();
+	return NULL;
+}
+
+int main(int argc, char **argv)
+{
+	struct call_rcu_data *crdp;
+	pthread_t thread;
+
+	plan_tests(6);
+
+	rcu_register_thread();
+	crdp = create_call_rcu_data(0, -1);
+	if (!crdp)
+		abort();
+	set_thread_call_rcu_data(crdp);
+
+	ok(!set_thread_call_rcu_batch(BATCH_SIZE), "enable batching");
+	queue_cbs(heads, NR_CBS);
+	rcu_barrier();
+	ok(uatomic_read(&nr_invoked) == NR_CBS,
+		"rcu_barrier flushes the partial batch");
+
+	queue_cbs(heads, 10);
+	call_rcu_flush();
+	rcu_barrier_crdp(crdp);
+	ok(uatomic_read(&nr_invoked) == NR_CBS + 10,
+		"call_rcu_flush hands the batch over");
+
+	if (pthread_create(&thread, NULL, thread_fn, NULL))
+		abort();
+	if (pthread_join(thread, NULL))
+		abort();
+	rcu_barrier();
+	ok(uatomic_read(&nr_invoked) == NR_CBS + 15,
+		"thread exit flushes its batch");
+
+	ok(!set_thread_call_rcu_batch(0), "disable batching");
+	queue_cbs(heads, 3);
+	set_thread_call_rcu_data(NULL);
+	call_rcu_data_free(crdp);
+	rcu_barrier();
+	ok(uatomic_read(&nr_invoked) == NR_CBS + 18,
+		"unbatched callbacks after disabling");
+
+	rcu_unregister_thread();
+	return exit_status();
+}
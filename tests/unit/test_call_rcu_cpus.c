@@ -0,0 +1,101 @@
+/*
+ * test_call_rcu_cpus.c
+ *
+ * Userspace RCU library - test per-CPU call_rcu threads of allowed CPUs
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#include <stdlib.h>
+#include <unistd.h>
+#include <sched.h>
+#include <urcu.h>
+
+#include "tap.h"
+
+#define NR_CBS		100
+
+static struct rcu_head heads[NR_CBS];
+static unsigned long nr_invoked;
+
+static void count_cb(struct rcu_head *head)
+{
+	uatomic_inc(&nr_invoked);
+}
+
+/* Number of per-CPU call_rcu threads, all on CPUs of set. */
+static int nr_cpu_threads(cpu_set_t *set, int *nr_bad)
+{
+	long cpu, nr_cpus = sysconf(_SC_NPROCESSORS_CONF);
+	int nr = 0;
+
+	*nr_bad = 0;
+	rcu_read_lock();
+	for (cpu = 0; cpu < nr_cpus && cpu < CPU_SETSIZE; cpu++) {
+		if (!get_cpu_call_rcu_data(cpu))
+			continue;
+		nr++;
+		if (!CPU_ISSET(cpu, set))
+			(*nr_bad)++;
+	}
+	rcu_read_unlock();
+	return nr;
+}
+
+int main(int argc, char **argv)
+{
+	cpu_set_t all, one;
+	int i, cpu, nr, nr_bad;
+
+	plan_tests(4);
+
+	rcu_register_thread();
+	if (sched_getaffinity(0, sizeof(all), &all))
+		abort();
+	for (cpu = 0; !CPU_ISSET(cpu, &all); cpu++)
+		;
+	CPU_ZERO(&one);
+	CPU_SET(cpu, &one);
+
+	if (sched_setaffinity(0, sizeof(one), &one))
+		abort();
+	ok(!create_all_cpu_call_rcu_data(0)
+			&& nr_cpu_threads(&one, &nr_bad) == 1 && !nr_bad,
+		"threads only on allowed CPUs");
+
+	if (sched_setaffinity(0, sizeof(all), &all))
+		abort();
+	nr = -1;
+	ok(!create_all_cpu_call_rcu_data(0)
+			&& (nr = nr_cpu_threads(&all, &nr_bad)) == CPU_COUNT(&all)
+			&& !nr_bad,
+		"threads added for new allowed CPUs (%d of %d)",
+		nr, CPU_COUNT(&all));
+
+	/* Callbacks of freed threads move to the default one. */
+	for (i = 0; i < NR_CBS; i++)
+		call_rcu(&heads[i], count_cb);
+	if (sched_setaffinity(0, sizeof(one), &one))
+		abort();
+	ok(!create_all_cpu_call_rcu_data(0)
+			&& nr_cpu_threads(&one, &nr_bad) == 1 && !nr_bad,
+		"threads of disallowed CPUs freed");
+	rcu_barrier();
+	ok(uatomic_read(&nr_invoked) == NR_CBS, "callbacks invoked");
+
+	free_all_cpu_call_rcu_data();
+	rcu_unregister_thread();
+	return exit_status();
+}
@@ -0,0 +1,185 @@
+/*
+ * test_call_rcu_fork.c
+ *
+ * Userspace RCU library - test lazy creation of worker threads after fork
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#include <stdlib.h>
+#include <unistd.h>
+#include <dirent.h>
+#include <pthread.h>
+#include <sys/wait.h>
+#include <urcu.h>
+#include <urcu/rculfhash.h>
+
+#include "tap.h"
+
+#define NR_INHERITED	100
+#define NR_NODES	1000
+
+struct test_node {
+	struct cds_lfht_node node;
+	struct rcu_head rcu;
+};
+
+static struct rcu_head heads[NR_INHERITED + 1];
+static unsigned long nr_invoked;
+static struct cds_lfht *ht;
+
+static void count_cb(struct rcu_head *head)
+{
+	uatomic_inc(&nr_invoked);
+}
+
+static void node_free_rcu(struct rcu_head *head)
+{
+	free(caa_container_of(head, struct test_node, rcu));
+}
+
+static int nr_threads(void)
+{
+	struct dirent *entry;
+	int nr = 0;
+	DIR *dir;
+
+	dir = opendir("/proc/self/task");
+	if (!dir)
+		abort();
+	while ((entry = readdir(dir)) != NULL) {
+		if (entry->d_name[0] != '.')
+			nr++;
+	}
+	closedir(dir);
+	return nr;
+}
+
+/* Run fn in a fork child, returning its exit status or -1. */
+static int run_child(int (*fn)(void))
+{
+	int status;
+	pid_t pid;
+
+	pid = fork();
+	if (pid < 0)
+		abort();
+	if (!pid)
+		_exit(fn());
+	if (waitpid(pid, &status, 0) != pid)
+		abort();
+	return WIFEXITED(status) ? WEXITSTATUS(status) : -1;
+}
+
+static int child_eager(void)
+{
+	return nr_threads() == 2 ? 0 : 1;
+}
+
+/* Inherited callbacks run once the first rcu_barrier() creates the thread. */
+static int child_lazy_barrier(void)
+{
+	if (nr_threads() != 1)
+		return 1;
+	if (uatomic_read(&nr_invoked))
+		return 2;
+	rcu_barrier();
+	if (uatomic_read(&nr_invoked) != NR_INHERITED)
+		return 3;
+	if (nr_threads() != 2)
+		return 4;
+	return 0;
+}
+
+static int child_lazy_call_rcu(void)
+{
+	call_rcu(&heads[NR_INHERITED], count_cb);
+	if (nr_threads() != 2)
+		return 1;
+	rcu_barrier();
+	return uatomic_read(&nr_invoked) == NR_INHERITED + 1 ? 0 : 2;
+}
+
+/* The hash table workers are only created by the first lazy resize. */
+static int child_lfht(void)
+{
+	struct cds_lfht_iter iter;
+	struct test_node *tn;
+	unsigned long i;
+	int before;
+
+	before = nr_threads();
+	rcu_register_thread();
+	for (i = 0; i < NR_NODES; i++) {
+		tn = calloc(1, sizeof(*tn));
+		if (!tn)
+			abort();
+		rcu_read_lock();
+		cds_lfht_add(ht, i, &tn->node);
+		rcu_read_unlock();
+	}
+	if (nr_threads() <= before)
+		return 1;
+	rcu_read_lock();
+	cds_lfht_for_each_entry(ht, &iter, tn, node) {
+		if (cds_lfht_del(ht, &tn->node))
+			abort();
+		call_rcu(&tn->rcu, node_free_rcu);
+	}
+	rcu_read_unlock();
+	rcu_unregister_thread();
+	if (cds_lfht_destroy(ht, NULL))
+		return 2;
+	rcu_barrier();
+	return 0;
+}
+
+int main(int argc, char **argv)
+{
+	int i;
+
+	plan_tests(5);
+
+	if (pthread_atfork(call_rcu_before_fork, call_rcu_after_fork_parent,
+			call_rcu_after_fork_child))
+		abort();
+
+	/* Create the default call_rcu thread. */
+	call_rcu(&heads[0], count_cb);
+	rcu_barrier();
+	nr_invoked = 0;
+	ok(run_child(child_eager) == 0,
+		"default mode: call_rcu thread created at fork");
+
+	call_rcu_set_fork_lazy(1);
+	for (i = 0; i < NR_INHERITED; i++)
+		call_rcu_lazy(&heads[i], count_cb);
+	ok(run_child(child_lazy_barrier) == 0,
+		"lazy mode: inherited callbacks run on first rcu_barrier");
+	ok(run_child(child_lazy_call_rcu) == 0,
+		"lazy mode: thread created on first call_rcu");
+	rcu_barrier();
+	ok(uatomic_read(&nr_invoked) == NR_INHERITED,
+		"parent callbacks invoked once");
+
+	ht = cds_lfht_new(1, 1, 0, CDS_LFHT_AUTO_RESIZE, NULL);
+	if (!ht)
+		abort();
+	ok(run_child(child_lfht) == 0,
+		"hash table workers created on first lazy resize");
+	if (cds_lfht_destroy(ht, NULL))
+		abort();
+	return exit_status();
+}
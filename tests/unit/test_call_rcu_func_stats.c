@@ -0,0 +1,119 @@
+/*
+ * test_call_rcu_func_stats.c
+ *
+ * Userspace RCU library - test call_rcu callback function statistics
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#include <stdlib.h>
+#include <poll.h>
+#include <urcu.h>
+
+#include "tap.h"
+
+#define NR_FAST		40
+#define NR_SLOW		5
+#define SLOW_MS		2
+
+static struct rcu_head fast_heads[NR_FAST], slow_heads[NR_SLOW];
+
+static void fast_cb(struct rcu_head *head)
+{
+}
+
+static void slow_cb(struct rcu_head *head)
+{
+	(void) poll(NULL, 0, SLOW_MS);
+}
+
+struct func_snapshot {
+	unsigned long nr_funcs;
+	struct urcu_call_rcu_func_stats fast, slow;
+};
+
+static void get_func_stats(void (*cb)(struct rcu_head *head),
+		const struct urcu_call_rcu_func_stats *stats, void *priv)
+{
+	struct func_snapshot *snap = priv;
+
+	snap->nr_funcs++;
+	if (cb == fast_cb)
+		snap->fast = *stats;
+	else if (cb == slow_cb)
+		snap->slow = *stats;
+}
+
+static void snapshot(struct func_snapshot *snap)
+{
+	snap->nr_funcs = 0;
+	snap->fast.samples = snap->slow.samples = 0;
+	call_rcu_for_each_func_stats(get_func_stats, snap);
+}
+
+static void queue_and_wait(int nr_fast, int nr_slow)
+{
+	int i;
+
+	rcu_register_thread();
+	for (i = 0; i < nr_fast; i++)
+		call_rcu(&fast_heads[i], fast_cb);
+	for (i = 0; i < nr_slow; i++)
+		call_rcu(&slow_heads[i], slow_cb);
+	rcu_unregister_thread();
+	rcu_barrier();
+}
+
+int main(int argc, char **argv)
+{
+	struct func_snapshot snap;
+	unsigned long prev;
+
+	plan_tests(6);
+
+	queue_and_wait(NR_FAST, NR_SLOW);
+	snapshot(&snap);
+	ok(!snap.nr_funcs, "no statistics without sampling");
+
+	call_rcu_set_func_sample_period(1);
+	queue_and_wait(NR_FAST, NR_SLOW);
+	snapshot(&snap);
+	ok(snap.fast.samples == NR_FAST && snap.slow.samples == NR_SLOW,
+		"all callbacks sampled with period 1");
+	ok(snap.slow.max_ns >= SLOW_MS * 1000000ULL
+			&& snap.slow.total_ns >= NR_SLOW * snap.slow.max_ns / 2
+			&& snap.slow.max_ns <= snap.slow.total_ns,
+		"slow callback durations (max %llu ns)",
+		(unsigned long long) snap.slow.max_ns);
+	ok(snap.fast.total_ns < snap.slow.total_ns,
+		"fast callback found cheaper");
+
+	call_rcu_set_func_sample_period(4);
+	prev = snap.fast.samples;
+	queue_and_wait(NR_FAST, 0);
+	snapshot(&snap);
+	ok(snap.fast.samples - prev >= NR_FAST / 4 - 1
+			&& snap.fast.samples - prev <= NR_FAST / 4 + 1,
+		"one callback sampled every period (%lu)",
+		snap.fast.samples - prev);
+
+	call_rcu_set_func_sample_period(0);
+	prev = snap.fast.samples;
+	queue_and_wait(NR_FAST, 0);
+	snapshot(&snap);
+	ok(snap.fast.samples == prev, "sampling disabled");
+
+	return exit_status();
+}
@@ -0,0 +1,100 @@
+/*
+ * test_call_rcu_gp_skip.c
+ *
+ * Userspace RCU library - test call_rcu batches skipping their grace period
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#include <stdlib.h>
+#include <poll.h>
+#include <urcu.h>
+
+#include "tap.h"
+
+static struct rcu_head first, second;
+static int first_running, first_release, second_invoked;
+
+/* Hold the call_rcu thread in the first batch until released. */
+static void first_cb(struct rcu_head *head)
+{
+	uatomic_set(&first_running, 1);
+	while (!uatomic_read(&first_release))
+		(void) poll(NULL, 0, 1);
+}
+
+static void second_cb(struct rcu_head *head)
+{
+	uatomic_set(&second_invoked, 1);
+}
+
+static void wait_set(int *flag)
+{
+	while (!uatomic_read(flag))
+		(void) poll(NULL, 0, 1);
+}
+
+int main(int argc, char **argv)
+{
+	struct urcu_call_rcu_stats stats;
+	struct call_rcu_data *crdp;
+	unsigned long cookie;
+
+	plan_tests(3);
+
+	rcu_register_thread();
+	crdp = create_call_rcu_data(0, -1);
+	if (!crdp)
+		abort();
+	set_thread_call_rcu_data(crdp);
+
+	/*
+	 * Keep the grace period of the first batch waiting on this
+	 * reader while the second callback is queued.
+	 */
+	cookie = get_state_synchronize_rcu();
+	rcu_read_lock();
+	call_rcu(&first, first_cb);
+	while (get_state_synchronize_rcu() == cookie)
+		(void) poll(NULL, 0, 1);
+	call_rcu(&second, second_cb);
+	rcu_read_unlock();
+
+	/*
+	 * The second batch is taken once the first grace period ends.
+	 * Complete another grace period while the first batch is being
+	 * invoked.
+	 */
+	wait_set(&first_running);
+	synchronize_rcu();
+	uatomic_set(&first_release, 1);
+	wait_set(&second_invoked);
+
+	call_rcu_data_get_stats(crdp, &stats);
+	ok(stats.batches == 2, "two batches invoked (%lu)", stats.batches);
+	ok(stats.gp_skipped == 1,
+		"batch whose grace period elapsed skips its own (%lu skipped)",
+		stats.gp_skipped);
+
+	/* Nothing elapses for a batch queued now. */
+	rcu_barrier();
+	call_rcu_data_get_stats(crdp, &stats);
+	ok(stats.gp_skipped == 1, "rcu_barrier batch waits for its grace period");
+
+	set_thread_call_rcu_data(NULL);
+	call_rcu_data_free(crdp);
+	rcu_unregister_thread();
+	return exit_status();
+}
@@ -0,0 +1,127 @@
+/*
+ * test_call_rcu_lazy.c
+ *
+ * Userspace RCU library - test lazy call_rcu callbacks
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#include <stdlib.h>
+#include <poll.h>
+#include <time.h>
+#include <urcu.h>
+
+#include "tap.h"
+
+#define LAZY_DELAY_MS	2000
+#define LAZY_QLEN_MAX	16
+
+static struct rcu_head heads[LAZY_QLEN_MAX + 1];
+static unsigned long nr_invoked;
+
+static void count_cb(struct rcu_head *head)
+{
+	uatomic_inc(&nr_invoked);
+}
+
+static void queue_lazy(int nr)
+{
+	int i;
+
+	for (i = 0; i < nr; i++)
+		call_rcu_lazy(&heads[i], count_cb);
+}
+
+static unsigned long now_ms(void)
+{
+	struct timespec ts;
+
+	if (clock_gettime(CLOCK_MONOTONIC, &ts))
+		abort();
+	return ts.tv_sec * 1000 + ts.tv_nsec / 1000000;
+}
+
+/* Wait at most timeout_ms for nr callbacks to be invoked in total. */
+static int wait_invoked(unsigned long nr, unsigned long timeout_ms)
+{
+	unsigned long start = now_ms();
+
+	while (uatomic_read(&nr_invoked) < nr) {
+		if (now_ms() - start > timeout_ms)
+			return 0;
+		(void) poll(NULL, 0, 1);
+	}
+	return 1;
+}
+
+static unsigned long nr_batches(struct call_rcu_data *crdp)
+{
+	struct urcu_call_rcu_stats stats;
+
+	call_rcu_data_get_stats(crdp, &stats);
+	return stats.batches;
+}
+
+int main(int argc, char **argv)
+{
+	struct call_rcu_attr attr = {
+		.lazy_delay_ms = LAZY_DELAY_MS,
+		.lazy_qlen_max = LAZY_QLEN_MAX,
+	};
+	struct call_rcu_data *crdp;
+	unsigned long batches, start;
+
+	plan_tests(6);
+
+	rcu_register_thread();
+	crdp = create_call_rcu_data_attr(0, -1, &attr);
+	if (!crdp)
+		abort();
+	set_thread_call_rcu_data(crdp);
+
+	queue_lazy(5);
+	(void) poll(NULL, 0, 100);
+	ok(uatomic_read(&nr_invoked) == 0, "lazy callbacks are delayed");
+	batches = nr_batches(crdp);
+	call_rcu(&heads[LAZY_QLEN_MAX], count_cb);
+	ok(wait_invoked(6, LAZY_DELAY_MS / 2)
+			&& nr_batches(crdp) == batches + 1,
+		"lazy callbacks join the next batch");
+
+	queue_lazy(LAZY_QLEN_MAX);
+	ok(wait_invoked(6 + LAZY_QLEN_MAX, LAZY_DELAY_MS / 2),
+		"lazy_qlen_max callbacks start a grace period");
+
+	queue_lazy(5);
+	rcu_barrier();
+	ok(uatomic_read(&nr_invoked) == 11 + LAZY_QLEN_MAX,
+		"rcu_barrier waits for lazy callbacks");
+
+	start = now_ms();
+	queue_lazy(3);
+	ok(wait_invoked(14 + LAZY_QLEN_MAX, 4 * LAZY_DELAY_MS)
+			&& now_ms() - start >= LAZY_DELAY_MS / 2,
+		"lazy callbacks invoked after lazy_delay_ms");
+
+	queue_lazy(2);
+	set_thread_call_rcu_data(NULL);
+	call_rcu_data_free(crdp);
+	rcu_barrier();
+	ok(uatomic_read(&nr_invoked) == 16 + LAZY_QLEN_MAX,
+		"call_rcu_data_free moves lazy callbacks");
+
+	rcu_unregister_thread();
+	return exit_status();
+}
@@ -0,0 +1,137 @@
+/*
+ * test_call_rcu_limit.c
+ *
+ * Userspace RCU library - test call_rcu producer backpressure
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#include <stdlib.h>
+#include <errno.h>
+#include <poll.h>
+#include <pthread.h>
+#include <time.h>
+#include <urcu.h>
+
+#include "tap.h"
+
+#define LIMIT		100
+#define WAIT_MS		5000
+#define STALL_MS	100
+
+static struct rcu_head heads[LIMIT], blocked, nested, extra;
+static struct call_rcu_data *crdp;
+static unsigned long nr_invoked;
+static int gate_open, gate_entered, producer_done;
+
+static void count_cb(struct rcu_head *head)
+{
+	uatomic_inc(&nr_invoked);
+}
+
+/* Hold the call_rcu thread, and thus its backlog, until the gate opens. */
+static void gate_cb(struct rcu_head *head)
+{
+	uatomic_set(&gate_entered, 1);
+	while (!uatomic_read(&gate_open))
+		(void) poll(NULL, 0, 1);
+}
+
+static unsigned long now_ms(void)
+{
+	struct timespec ts;
+
+	if (clock_gettime(CLOCK_MONOTONIC, &ts))
+		abort();
+	return ts.tv_sec * 1000 + ts.tv_nsec / 1000000;
+}
+
+static void *producer_fn(void *arg)
+{
+	rcu_register_thread();
+	set_thread_call_rcu_data(crdp);
+	call_rcu(&blocked, count_cb);
+	uatomic_set(&producer_done, 1);
+	set_thread_call_rcu_data(NULL);
+	rcu_unregister_thread();
+	return NULL;
+}
+
+int main(int argc, char **argv)
+{
+	struct call_rcu_attr attr = {
+		.qlen_limit = LIMIT,
+		.limit_wait_ms = WAIT_MS,
+	};
+	struct urcu_call_rcu_stats stats;
+	unsigned long start;
+	pthread_t tid;
+	int i;
+
+	plan_tests(8);
+
+	rcu_register_thread();
+	crdp = create_call_rcu_data_attr(0, -1, &attr);
+	if (!crdp)
+		abort();
+	set_thread_call_rcu_data(crdp);
+
+	call_rcu(&heads[0], gate_cb);
+	for (i = 1; i < LIMIT; i++)
+		call_rcu(&heads[i], count_cb);
+	while (!uatomic_read(&gate_entered))
+		(void) poll(NULL, 0, 1);
+	ok(call_rcu_try(&extra, count_cb) == -EAGAIN,
+		"call_rcu_try refuses callbacks over the limit");
+
+	if (pthread_create(&tid, NULL, producer_fn, NULL))
+		abort();
+	(void) poll(NULL, 0, STALL_MS);
+	ok(!uatomic_read(&producer_done), "producer waits at the limit");
+
+	rcu_read_lock();
+	start = now_ms();
+	call_rcu(&nested, count_cb);
+	rcu_read_unlock();
+	ok(now_ms() - start < STALL_MS,
+		"producer within a read-side critical section does not wait");
+
+	uatomic_set(&gate_open, 1);
+	if (pthread_join(tid, NULL))
+		abort();
+	ok(producer_done, "producer resumes once the backlog drains");
+
+	call_rcu_data_get_stats(crdp, &stats);
+	ok(stats.throttled == 1 && stats.rejected == 1,
+		"waits and refusals are accounted (%lu throttled, %lu rejected)",
+		stats.throttled, stats.rejected);
+
+	call_rcu_data_set_qlen_limit(crdp, 0, 0);
+	ok(call_rcu_try(&extra, count_cb) == 0, "no limit once disabled");
+	rcu_barrier();
+	ok(nr_invoked == LIMIT - 1 + 3, "every queued callback is invoked");
+	/* The batch of the barrier is accounted once all are invoked. */
+	start = now_ms();
+	do {
+		call_rcu_data_get_stats(crdp, &stats);
+	} while (stats.qlen && now_ms() - start < WAIT_MS
+			&& !poll(NULL, 0, 1));
+	ok(stats.qlen == 0, "backlog is empty");
+
+	set_thread_call_rcu_data(NULL);
+	call_rcu_data_free(crdp);
+	rcu_unregister_thread();
+	return exit_status();
+}
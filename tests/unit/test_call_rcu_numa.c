@@ -0,0 +1,92 @@
+/*
+ * test_call_rcu_numa.c
+ *
+ * Userspace RCU library - test call_rcu routing by NUMA node
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#include <stdlib.h>
+#include <errno.h>
+#include <urcu.h>
+
+#include "compat-numa.h"
+#include "tap.h"
+
+#define NR_CBS		10000
+
+struct obj {
+	struct rcu_head head;
+	char payload[100];
+};
+
+static unsigned long nr_freed;
+
+static void free_cb(struct rcu_head *head)
+{
+	free(caa_container_of(head, struct obj, head));
+	uatomic_inc(&nr_freed);
+}
+
+static struct obj *obj_new(void)
+{
+	struct obj *obj = malloc(sizeof(*obj));
+
+	if (!obj)
+		abort();
+	return obj;
+}
+
+int main(int argc, char **argv)
+{
+	int i, ret, node;
+
+	plan_tests(4);
+
+	rcu_register_thread();
+	ret = create_all_cpu_call_rcu_data(URCU_CALL_RCU_NUMA);
+	if (ret == -EINVAL) {
+		/* No per-CPU call_rcu_data on this platform. */
+		skip(4, "per-CPU call_rcu_data not available");
+		goto end;
+	}
+	ok(!ret, "create per-CPU call_rcu_data in NUMA mode");
+
+	for (i = 0; i < NR_CBS; i++)
+		call_rcu(&obj_new()->head, free_cb);
+	rcu_barrier();
+	ok(uatomic_read(&nr_freed) == NR_CBS,
+		"callbacks routed by node of the object are invoked");
+
+	uatomic_set(&nr_freed, 0);
+	node = urcu_numa_node_of_cpu(0);
+	for (i = 0; i < NR_CBS; i++)
+		call_rcu_node(&obj_new()->head, free_cb, node);
+	rcu_barrier();
+	ok(uatomic_read(&nr_freed) == NR_CBS,
+		"callbacks queued to node %d are invoked", node);
+
+	uatomic_set(&nr_freed, 0);
+	call_rcu_node(&obj_new()->head, free_cb, -1);
+	call_rcu_node(&obj_new()->head, free_cb, 1 << 20);
+	rcu_barrier();
+	ok(uatomic_read(&nr_freed) == 2,
+		"unknown nodes fall back on call_rcu()");
+
+	free_all_cpu_call_rcu_data();
+end:
+	rcu_unregister_thread();
+	return exit_status();
+}
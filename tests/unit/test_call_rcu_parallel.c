@@ -0,0 +1,109 @@
+/*
+ * test_call_rcu_parallel.c
+ *
+ * Userspace RCU library - test parallel invocation of large batches
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#include <stdlib.h>
+#include <sched.h>
+#include <poll.h>
+#include <pthread.h>
+#include <urcu.h>
+
+#include "tap.h"
+
+#define NR_CBS		20000
+#define THRESHOLD	1000
+#define NR_HELPERS	3
+#define MAX_THREADS	16
+
+static struct rcu_head heads[NR_CBS];
+static unsigned long nr_invoked;
+
+/* Threads which invoked callbacks. */
+static pthread_t threads[MAX_THREADS];
+static unsigned int nr_threads;
+static pthread_mutex_t threads_lock = PTHREAD_MUTEX_INITIALIZER;
+
+static void record_thread(void)
+{
+	pthread_t self = pthread_self();
+	unsigned int i;
+
+	pthread_mutex_lock(&threads_lock);
+	for (i = 0; i < nr_threads; i++) {
+		if (pthread_equal(threads[i], self))
+			break;
+	}
+	if (i == nr_threads && nr_threads < MAX_THREADS)
+		threads[nr_threads++] = self;
+	pthread_mutex_unlock(&threads_lock);
+}
+
+static void count_cb(struct rcu_head *head)
+{
+	/* Leave some time to the helpers on a single CPU. */
+	if (!(uatomic_add_return(&nr_invoked, 1) % 256)) {
+		record_thread();
+		sched_yield();
+	}
+}
+
+int main(int argc, char **argv)
+{
+	struct call_rcu_attr attr = {
+		/* Gather the callbacks into one batch. */
+		.min_delay_ms = 100,
+		.max_delay_ms = 100,
+		.parallel_threshold = THRESHOLD,
+		.nr_helpers = NR_HELPERS,
+	};
+	struct urcu_call_rcu_stats stats;
+	struct call_rcu_data *crdp;
+	int i;
+
+	plan_tests(4);
+
+	rcu_register_thread();
+	crdp = create_call_rcu_data_attr(0, -1, &attr);
+	ok(crdp != NULL, "create call_rcu_data with helpers");
+	if (!crdp)
+		abort();
+	set_thread_call_rcu_data(crdp);
+
+	for (i = 0; i < NR_CBS; i++)
+		call_rcu(&heads[i], count_cb);
+	rcu_barrier();
+	ok(uatomic_read(&nr_invoked) == NR_CBS,
+		"rcu_barrier waits for the callbacks of the helpers");
+	/* Statistics are updated once the batch is invoked. */
+	for (i = 0; i < 5000; i++) {
+		call_rcu_data_get_stats(crdp, &stats);
+		if (stats.invoked >= NR_CBS)
+			break;
+		(void) poll(NULL, 0, 1);
+	}
+	ok(stats.invoked >= NR_CBS && stats.batch_max > THRESHOLD,
+		"callbacks of a large batch accounted (%lu, largest batch %lu)",
+		stats.invoked, stats.batch_max);
+	ok(nr_threads > 1, "large batch invoked by %u threads", nr_threads);
+
+	set_thread_call_rcu_data(NULL);
+	call_rcu_data_free(crdp);
+	rcu_unregister_thread();
+	return exit_status();
+}
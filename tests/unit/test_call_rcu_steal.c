@@ -0,0 +1,68 @@
+/*
+ * test_call_rcu_steal.c
+ *
+ * Userspace RCU library - test call_rcu work stealing between CPUs
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#include <stdlib.h>
+#include <errno.h>
+#include <urcu.h>
+
+#include "tap.h"
+
+#define NR_CBS		10000
+
+static struct rcu_head heads[NR_CBS];
+static unsigned long nr_invoked;
+
+static void count_cb(struct rcu_head *head)
+{
+	uatomic_inc(&nr_invoked);
+}
+
+int main(int argc, char **argv)
+{
+	struct urcu_stats stats;
+	int i, ret;
+
+	plan_tests(3);
+
+	rcu_register_thread();
+	ret = create_all_cpu_call_rcu_data(URCU_CALL_RCU_STEAL);
+	if (ret == -EINVAL) {
+		/* No per-CPU call_rcu_data on this platform. */
+		skip(3, "per-CPU call_rcu_data not available");
+		goto end;
+	}
+	ok(!ret, "create per-CPU call_rcu_data in steal mode");
+
+	for (i = 0; i < NR_CBS; i++)
+		call_rcu(&heads[i], count_cb);
+	rcu_barrier();
+	ok(uatomic_read(&nr_invoked) == NR_CBS,
+		"rcu_barrier waits for all callbacks");
+
+	rcu_get_stats(&stats);
+	ok(stats.call_rcu.stolen <= stats.call_rcu.invoked
+		&& stats.call_rcu.invoked >= NR_CBS,
+		"stolen callbacks accounted as invoked");
+
+	free_all_cpu_call_rcu_data();
+end:
+	rcu_unregister_thread();
+	return exit_status();
+}
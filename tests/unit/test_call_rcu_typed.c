@@ -0,0 +1,131 @@
+/*
+ * test_call_rcu_typed.c
+ *
+ * Userspace RCU library - test reclaim classes of compact rcu heads
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#include <stdlib.h>
+#include <poll.h>
+#include <pthread.h>
+#include <urcu.h>
+
+#include "tap.h"
+
+#define NR_THREADS	4
+#define NR_OBJS		10000
+
+struct obj {
+	unsigned long key;
+	struct rcu_head_compact rcu;
+};
+
+static struct call_rcu_class obj_class;
+static unsigned long nr_freed, nr_batches;
+static int reader_in_cs, reader_exit;
+
+static void obj_free_list(struct rcu_head_compact *list)
+{
+	struct rcu_head_compact *pos, *p;
+
+	rcu_head_compact_for_each_safe(list, pos, p) {
+		free(caa_container_of(pos, struct obj, rcu));
+		uatomic_inc(&nr_freed);
+	}
+	uatomic_inc(&nr_batches);
+}
+
+static void obj_queue(unsigned long key)
+{
+	struct obj *obj;
+
+	obj = malloc(sizeof(*obj));
+	if (!obj)
+		abort();
+	obj->key = key;
+	call_rcu_typed(&obj_class, &obj->rcu);
+}
+
+static void *thr_reader(void *arg)
+{
+	rcu_register_thread();
+	rcu_read_lock();
+	uatomic_set(&reader_in_cs, 1);
+	while (!uatomic_read(&reader_exit))
+		(void) poll(NULL, 0, 1);
+	rcu_read_unlock();
+	rcu_unregister_thread();
+	return NULL;
+}
+
+static void *thr_update(void *arg)
+{
+	unsigned long i;
+
+	rcu_register_thread();
+	for (i = 0; i < NR_OBJS; i++)
+		obj_queue(i);
+	rcu_unregister_thread();
+	return NULL;
+}
+
+int main(int argc, char **argv)
+{
+	pthread_t tid[NR_THREADS], reader;
+	int i;
+
+	plan_tests(5);
+
+	rcu_register_thread();
+	call_rcu_class_init(&obj_class, obj_free_list);
+	ok(sizeof(struct rcu_head_compact) == sizeof(void *),
+		"compact head is a single pointer");
+
+	obj_queue(0);
+	rcu_barrier_class(&obj_class);
+	ok(nr_freed == 1 && nr_batches == 1, "object reclaimed");
+
+	if (pthread_create(&reader, NULL, thr_reader, NULL))
+		abort();
+	while (!uatomic_read(&reader_in_cs))
+		(void) poll(NULL, 0, 1);
+	obj_queue(1);
+	(void) poll(NULL, 0, 100);
+	ok(uatomic_read(&nr_freed) == 1,
+		"object not reclaimed during a read-side critical section");
+	uatomic_set(&reader_exit, 1);
+	if (pthread_join(reader, NULL))
+		abort();
+	rcu_barrier_class(&obj_class);
+	ok(nr_freed == 2, "object reclaimed after the grace period");
+
+	nr_freed = nr_batches = 0;
+	for (i = 0; i < NR_THREADS; i++) {
+		if (pthread_create(&tid[i], NULL, thr_update, NULL))
+			abort();
+	}
+	for (i = 0; i < NR_THREADS; i++) {
+		if (pthread_join(tid[i], NULL))
+			abort();
+	}
+	rcu_barrier_class(&obj_class);
+	ok(nr_freed == NR_THREADS * NR_OBJS && nr_batches < nr_freed,
+		"concurrent queueing reclaimed in batches (%lu objects, "
+		"%lu batches)", nr_freed, nr_batches);
+
+	rcu_unregister_thread();
+	return exit_status();
+}
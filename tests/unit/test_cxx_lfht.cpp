@@ -0,0 +1,108 @@
+/*
+ * test_cxx_lfht.cpp
+ *
+ * Userspace RCU library - test C++ rcu_ptr and lfht wrappers
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#define _LGPL_SOURCE
+#include <string>
+#include <urcu.h>
+#include <urcu/rculfhash.hpp>
+
+extern "C" {
+#include "tap.h"
+}
+
+#define NR_KEYS		1000
+
+URCU_DEFINE_FLAVOR_TRAITS(memb_flavor, urcu_memb);
+
+typedef urcu::lfht<std::string, int> string_table;
+
+int main(int argc, char **argv)
+{
+	urcu::rcu_ptr<int> ptr;
+	int a = 1, b = 2, *expected;
+	int i, nr_found = 0, sum = 0;
+
+	plan_tests(12);
+
+	rcu_register_thread();
+
+	ptr.store(&a);
+	ok(ptr.load() == &a && ptr.exchange(&b) == &a && ptr.load() == &b,
+		"rcu_ptr store, load and exchange");
+	expected = &a;
+	ok(!ptr.compare_exchange(expected, &a) && expected == &b
+		&& ptr.compare_exchange(expected, &a) && ptr.load() == &a,
+		"rcu_ptr compare_exchange");
+
+	{
+		string_table table;
+		bool added = true;
+
+		for (i = 0; i < NR_KEYS; i++)
+			added &= table.insert(std::to_string(i), i);
+		ok(added, "insert distinct keys");
+		ok(!table.insert("1", 42), "insert existing key fails");
+		{
+			urcu::read_guard<> guard;
+
+			for (i = 0; i < NR_KEYS; i++) {
+				int *value = table.find(std::to_string(i));
+
+				if (value && *value == i)
+					nr_found++;
+			}
+			ok(nr_found == NR_KEYS, "find all keys");
+			ok(!table.find("none"), "find missing key");
+		}
+		ok(!table.insert_or_assign("1", 42), "insert_or_assign replaces");
+		ok(table.insert_or_assign("new", 7), "insert_or_assign adds");
+		ok(table.erase("2") && !table.erase("2"), "erase once");
+		{
+			urcu::read_guard<> guard;
+
+			ok(*table.find("1") == 42 && !table.find("2")
+				&& *table.find("new") == 7,
+				"find after updates");
+			nr_found = 0;
+			table.for_each([&](const std::string &key, int value) {
+				nr_found++;
+				sum += value;
+			});
+			ok(nr_found == NR_KEYS && sum == NR_KEYS * (NR_KEYS - 1) / 2
+					- 1 - 2 + 42 + 7,
+				"for_each visits all nodes");
+		}
+	}
+
+	{
+		urcu::lfht<unsigned long, unsigned long,
+			std::hash<unsigned long>, std::equal_to<unsigned long>,
+			memb_flavor> table(16);
+
+		table.insert(3, 9);
+		urcu::read_guard<memb_flavor> guard;
+
+		ok(*table.find(3) == 9, "table with explicit flavor traits");
+	}
+
+	rcu_barrier();
+	rcu_unregister_thread();
+	return exit_status();
+}
@@ -0,0 +1,130 @@
+/*
+ * test_defer_flavors.c
+ *
+ * Userspace RCU library - test defer_rcu with the QSBR and bp flavors
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#include <stdlib.h>
+#include <poll.h>
+#include <pthread.h>
+#include <urcu/urcu-qsbr.h>
+#include <urcu/urcu-bp.h>
+
+#include "tap.h"
+
+#define NR_CALLBACKS	10000
+
+struct defer_flavor {
+	const char *name;
+	const struct rcu_flavor_struct *flavor;
+	int (*defer_register_thread)(void);
+	void (*defer_unregister_thread)(void);
+	void (*defer_barrier)(void);
+};
+
+static const struct defer_flavor flavors[] = {
+	{
+		"qsbr", &urcu_qsbr_flavor,
+		urcu_qsbr_defer_register_thread,
+		urcu_qsbr_defer_unregister_thread,
+		urcu_qsbr_defer_barrier,
+	},
+	{
+		"bp", &urcu_bp_flavor,
+		urcu_bp_defer_register_thread,
+		urcu_bp_defer_unregister_thread,
+		urcu_bp_defer_barrier,
+	},
+};
+#define NR_FLAVORS	(sizeof(flavors) / sizeof(flavors[0]))
+
+static unsigned long nr_done;
+static int reader_in_cs, reader_release;
+
+static void defer_cb(void *p)
+{
+	uatomic_inc(&nr_done);
+}
+
+/* Hold a read-side critical section until released. */
+static void *thr_reader(void *arg)
+{
+	const struct rcu_flavor_struct *flavor = arg;
+
+	flavor->register_thread();
+	flavor->read_lock();
+	uatomic_set(&reader_in_cs, 1);
+	while (!uatomic_read(&reader_release))
+		(void) poll(NULL, 0, 1);
+	flavor->read_unlock();
+	flavor->unregister_thread();
+	return NULL;
+}
+
+int main(int argc, char **argv)
+{
+	const struct defer_flavor *df;
+	pthread_t tid;
+	unsigned long i, j;
+
+	plan_tests(3 * NR_FLAVORS);
+
+	for (i = 0; i < NR_FLAVORS; i++) {
+		df = &flavors[i];
+		uatomic_set(&nr_done, 0);
+		uatomic_set(&reader_in_cs, 0);
+		uatomic_set(&reader_release, 0);
+
+		df->flavor->register_thread();
+		if (df->defer_register_thread())
+			abort();
+		if (pthread_create(&tid, NULL, thr_reader,
+				(void *) df->flavor))
+			abort();
+		while (!uatomic_read(&reader_in_cs))
+			(void) poll(NULL, 0, 1);
+
+		df->flavor->update_defer_rcu(defer_cb, NULL);
+		/* Let the defer thread try to execute it. */
+		for (j = 0; j < 20; j++) {
+			df->flavor->read_quiescent_state();
+			(void) poll(NULL, 0, 5);
+		}
+		ok(!uatomic_read(&nr_done),
+			"%s: callback waits for the reader", df->name);
+
+		uatomic_set(&reader_release, 1);
+		if (pthread_join(tid, NULL))
+			abort();
+		df->defer_barrier();
+		ok(uatomic_read(&nr_done) == 1,
+			"%s: callback executed once the reader is done",
+			df->name);
+
+		/* Same function: one queue entry per callback. */
+		for (j = 0; j < NR_CALLBACKS; j++)
+			df->flavor->update_defer_rcu(defer_cb, (void *) j);
+		df->defer_barrier();
+		ok(uatomic_read(&nr_done) == NR_CALLBACKS + 1,
+			"%s: barrier executes the queued callbacks",
+			df->name);
+
+		df->defer_unregister_thread();
+		df->flavor->unregister_thread();
+	}
+	return exit_status();
+}
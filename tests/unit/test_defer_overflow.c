@@ -0,0 +1,72 @@
+/*
+ * test_defer_overflow.c
+ *
+ * Userspace RCU library - test defer_rcu queue overflow
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#include <errno.h>
+#include <pthread.h>
+#include <urcu.h>
+
+#include "tap.h"
+
+#define QUEUE_SIZE	8
+#define NR_CALLBACKS	1000
+
+static pthread_t caller;
+static unsigned long nr_done, nr_inline;
+
+static void defer_cb(void *p)
+{
+	uatomic_inc(&nr_done);
+	if (pthread_equal(pthread_self(), caller))
+		uatomic_inc(&nr_inline);
+}
+
+static void other_cb(void *p)
+{
+	defer_cb(p);
+}
+
+int main(int argc, char **argv)
+{
+	int i;
+
+	plan_tests(4);
+
+	caller = pthread_self();
+	rcu_register_thread();
+	ok(rcu_defer_register_thread_size(QUEUE_SIZE + 1) == -EINVAL
+		&& rcu_defer_register_thread_size(2) == -EINVAL,
+		"reject invalid queue sizes");
+	ok(!rcu_defer_register_thread_size(QUEUE_SIZE),
+		"register with a small queue");
+
+	/* Alternate functions to use three entries per callback. */
+	for (i = 0; i < NR_CALLBACKS; i++)
+		defer_rcu(i & 1 ? defer_cb : other_cb, NULL);
+	ok(!uatomic_read(&nr_inline),
+		"full queue does not execute callbacks in defer_rcu");
+
+	rcu_defer_barrier();
+	ok(uatomic_read(&nr_done) == NR_CALLBACKS,
+		"barrier waits for queued and spilled callbacks");
+
+	rcu_defer_unregister_thread();
+	rcu_unregister_thread();
+	return exit_status();
+}
@@ -0,0 +1,81 @@
+/*
+ * test_defer_wakeup.c
+ *
+ * Userspace RCU library - test defer_rcu watermark wakeup
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#include <poll.h>
+#include <urcu.h>
+
+#include "tap.h"
+
+#define DELAY_MS	10000
+#define WATERMARK	16
+#define NR_CALLBACKS	(2 * WATERMARK)
+#define TIMEOUT_MS	3000
+
+static unsigned long nr_done;
+
+static void defer_cb(void *p)
+{
+	uatomic_inc(&nr_done);
+}
+
+/* Wait up to TIMEOUT_MS for nr callbacks to complete. */
+static int wait_done(unsigned long nr)
+{
+	int ms;
+
+	for (ms = 0; ms < TIMEOUT_MS; ms += 10) {
+		if (uatomic_read(&nr_done) >= nr)
+			return 1;
+		(void) poll(NULL, 0, 10);
+	}
+	return 0;
+}
+
+int main(int argc, char **argv)
+{
+	struct call_rcu_attr attr = {
+		.min_delay_ms = DELAY_MS,
+		.max_delay_ms = DELAY_MS,
+		.qlen_high_watermark = WATERMARK,
+	};
+	int i;
+
+	plan_tests(2);
+
+	rcu_register_thread();
+	rcu_defer_set_attr(&attr);
+	if (rcu_defer_register_thread())
+		abort();
+	/* Let the call_rcu thread start and wait for callbacks. */
+	(void) poll(NULL, 0, 100);
+
+	defer_rcu(defer_cb, NULL);
+	(void) poll(NULL, 0, 100);
+	ok(!uatomic_read(&nr_done), "callbacks accumulate during the delay");
+
+	for (i = 1; i < NR_CALLBACKS; i++)
+		defer_rcu(defer_cb, NULL);
+	ok(wait_done(WATERMARK), "high watermark ends the delay");
+
+	rcu_defer_unregister_thread();
+	rcu_defer_set_attr(NULL);
+	rcu_unregister_thread();
+	return exit_status();
+}
@@ -0,0 +1,197 @@
+/*
+ * test_dequeue_batch.c
+ *
+ * Userspace RCU library - test batch dequeue of rculfqueue and wfcqueue
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#define _LGPL_SOURCE
+#include <stdlib.h>
+#include <pthread.h>
+#include <urcu.h>
+#include <urcu/rculfqueue.h>
+#include <urcu/wfcqueue.h>
+
+#include "tap.h"
+
+#define BATCH		16
+#define NR_THREADS	2
+#define NR_LOOPS	50000UL
+
+struct test_node {
+	struct cds_lfq_node_rcu lfq_node;
+	struct cds_wfcq_node wfcq_node;
+	unsigned long thread, seq;
+};
+
+static struct test_node nodes[NR_THREADS][NR_LOOPS];
+static struct cds_lfq_queue_rcu lfq;
+static struct cds_wfcq_head wfcq_head;
+static struct cds_wfcq_tail wfcq_tail;
+static int use_lfq, enqueue_done;
+static unsigned long nr_dequeued, nr_batches, nr_bad;
+
+static void enqueue(struct test_node *tn)
+{
+	if (use_lfq) {
+		cds_lfq_node_init_rcu(&tn->lfq_node);
+		rcu_read_lock();
+		cds_lfq_enqueue_rcu(&lfq, &tn->lfq_node);
+		rcu_read_unlock();
+	} else {
+		cds_wfcq_node_init(&tn->wfcq_node);
+		(void) cds_wfcq_enqueue(&wfcq_head, &wfcq_tail, &tn->wfcq_node);
+	}
+}
+
+/* Dequeue up to BATCH nodes into tns[]. */
+static unsigned long dequeue_batch(struct test_node **tns)
+{
+	struct cds_lfq_node_rcu *lfq_nodes[BATCH];
+	struct cds_wfcq_node *wfcq_nodes[BATCH];
+	unsigned long i, nr;
+
+	if (use_lfq) {
+		rcu_read_lock();
+		nr = cds_lfq_dequeue_batch_rcu(&lfq, lfq_nodes, BATCH);
+		rcu_read_unlock();
+		for (i = 0; i < nr; i++)
+			tns[i] = caa_container_of(lfq_nodes[i],
+					struct test_node, lfq_node);
+	} else {
+		nr = cds_wfcq_dequeue_batch_blocking(&wfcq_head, &wfcq_tail,
+				wfcq_nodes, BATCH);
+		for (i = 0; i < nr; i++)
+			tns[i] = caa_container_of(wfcq_nodes[i],
+					struct test_node, wfcq_node);
+	}
+	return nr;
+}
+
+static void *thr_enqueuer(void *arg)
+{
+	struct test_node *tns = arg;
+	unsigned long i;
+
+	rcu_register_thread();
+	for (i = 0; i < NR_LOOPS; i++)
+		enqueue(&tns[i]);
+	rcu_unregister_thread();
+	return NULL;
+}
+
+/* Each batch holds the nodes of each enqueuer in order. */
+static void *thr_dequeuer(void *arg)
+{
+	unsigned long last[NR_THREADS], i, nr;
+	struct test_node *tns[BATCH];
+	int done;
+
+	rcu_register_thread();
+	for (;;) {
+		done = uatomic_read(&enqueue_done);
+		nr = dequeue_batch(tns);
+		if (!nr) {
+			if (done)
+				break;
+			continue;
+		}
+		for (i = 0; i < NR_THREADS; i++)
+			last[i] = -1UL;
+		for (i = 0; i < nr; i++) {
+			if (last[tns[i]->thread] != -1UL
+					&& tns[i]->seq <= last[tns[i]->thread])
+				uatomic_inc(&nr_bad);
+			last[tns[i]->thread] = tns[i]->seq;
+		}
+		uatomic_add(&nr_dequeued, nr);
+		uatomic_inc(&nr_batches);
+	}
+	rcu_unregister_thread();
+	return NULL;
+}
+
+static void test_queue(const char *name)
+{
+	pthread_t enqueuers[NR_THREADS], dequeuers[NR_THREADS];
+	struct test_node *tns[BATCH];
+	unsigned long i, nr, bad = 0;
+
+	/* Single thread: 20 nodes come out as 16, then 4, then none. */
+	for (i = 0; i < 20; i++) {
+		nodes[0][i].seq = i;
+		enqueue(&nodes[0][i]);
+	}
+	nr = dequeue_batch(tns);
+	for (i = 0; i < nr; i++) {
+		if (tns[i] != &nodes[0][i])
+			bad++;
+	}
+	ok(nr == BATCH && !bad, "%s: full batch dequeued in order", name);
+	nr = dequeue_batch(tns);
+	ok(nr == 4 && tns[0] == &nodes[0][BATCH] && tns[3] == &nodes[0][19],
+		"%s: partial batch up to the last node", name);
+	ok(dequeue_batch(tns) == 0, "%s: empty queue", name);
+	enqueue(&nodes[0][20]);
+	ok(dequeue_batch(tns) == 1 && tns[0] == &nodes[0][20],
+		"%s: enqueue after draining", name);
+
+	nr_dequeued = nr_batches = nr_bad = 0;
+	uatomic_set(&enqueue_done, 0);
+	for (i = 0; i < NR_THREADS; i++) {
+		for (nr = 0; nr < NR_LOOPS; nr++) {
+			nodes[i][nr].thread = i;
+			nodes[i][nr].seq = nr;
+		}
+	}
+	for (i = 0; i < NR_THREADS; i++) {
+		if (pthread_create(&enqueuers[i], NULL, thr_enqueuer, nodes[i]))
+			abort();
+		if (pthread_create(&dequeuers[i], NULL, thr_dequeuer, NULL))
+			abort();
+	}
+	for (i = 0; i < NR_THREADS; i++) {
+		if (pthread_join(enqueuers[i], NULL))
+			abort();
+	}
+	uatomic_set(&enqueue_done, 1);
+	for (i = 0; i < NR_THREADS; i++) {
+		if (pthread_join(dequeuers[i], NULL))
+			abort();
+	}
+	ok(nr_dequeued == NR_THREADS * NR_LOOPS && !nr_bad,
+		"%s: concurrent batches (%lu batches)", name, nr_batches);
+}
+
+int main(int argc, char **argv)
+{
+	plan_tests(10);
+
+	rcu_register_thread();
+	use_lfq = 1;
+	cds_lfq_init_rcu(&lfq, call_rcu);
+	test_queue("lfq");
+	rcu_barrier();
+	if (cds_lfq_destroy_rcu(&lfq))
+		abort();
+
+	use_lfq = 0;
+	cds_wfcq_init(&wfcq_head, &wfcq_tail);
+	test_queue("wfcq");
+	cds_wfcq_destroy(&wfcq_head, &wfcq_tail);
+	rcu_unregister_thread();
+	return exit_status();
+}
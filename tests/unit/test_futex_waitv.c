@@ -0,0 +1,79 @@
+/*
+ * test_futex_waitv.c
+ *
+ * Userspace RCU library - test futex_waitv_async()
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#include <errno.h>
+#include <poll.h>
+#include <pthread.h>
+#include <stdlib.h>
+#include <urcu/uatomic.h>
+#include <urcu/futex.h>
+
+#include "tap.h"
+
+static int32_t futexes[3];
+
+static void *waker_fn(void *arg)
+{
+	int32_t *futex = arg;
+
+	(void) poll(NULL, 0, 100);
+	uatomic_set(futex, 0);
+	(void) futex_async(futex, FUTEX_WAKE_PRIVATE, 1, NULL, NULL, 0);
+	return NULL;
+}
+
+int main(int argc, char **argv)
+{
+	struct urcu_futex_waiter waiters[3];
+	struct timespec timeout = { .tv_sec = 0, .tv_nsec = 50000000 };
+	pthread_t waker;
+	int i, ret;
+
+	plan_tests(4);
+
+	for (i = 0; i < 3; i++) {
+		futexes[i] = -1;
+		waiters[i].uaddr = &futexes[i];
+		waiters[i].val = -1;
+	}
+
+	ret = futex_waitv_async(waiters, 3, FUTEX_WAIT_PRIVATE, &timeout);
+	ok(ret == -1 && errno == ETIMEDOUT, "wait times out");
+
+	futexes[2] = 0;
+	ret = futex_waitv_async(waiters, 3, FUTEX_WAIT_PRIVATE, NULL);
+	ok(ret == -1 && errno == EWOULDBLOCK,
+		"changed value fails the wait");
+	futexes[2] = -1;
+
+	if (pthread_create(&waker, NULL, waker_fn, &futexes[1]))
+		abort();
+	do {
+		ret = futex_waitv_async(waiters, 3, FUTEX_WAIT_PRIVATE, NULL);
+	} while (ret == -1 && errno == EINTR);
+	if (pthread_join(waker, NULL))
+		abort();
+	ok(ret == 1 || (ret == -1 && errno == EWOULDBLOCK),
+		"wake-up of one futex ends the wait");
+	ok(futexes[1] == 0 && futexes[0] == -1 && futexes[2] == -1,
+		"only the woken futex changed");
+
+	return exit_status();
+}
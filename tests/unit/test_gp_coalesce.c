@@ -0,0 +1,125 @@
+/*
+ * test_gp_coalesce.c
+ *
+ * Userspace RCU library - test grace-period coalescing window
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#define _LGPL_SOURCE
+#include <stdlib.h>
+#include <errno.h>
+#include <inttypes.h>
+#include <time.h>
+#include <pthread.h>
+#include <urcu.h>
+
+#include "tap.h"
+
+#define NR_UPDATERS	4
+#define LONG_DELAY_US	500000UL
+#define SHORT_DELAY_US	20000UL
+
+static pthread_barrier_t start_barrier;
+
+static uint64_t now_ns(void)
+{
+	struct timespec ts;
+
+	if (clock_gettime(CLOCK_MONOTONIC, &ts))
+		abort();
+	return (uint64_t) ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+static unsigned long gp_count(void)
+{
+	struct urcu_stats stats;
+
+	rcu_get_stats(&stats);
+	return stats.gp_count;
+}
+
+static void *thr_updater(void *arg)
+{
+	pthread_barrier_wait(&start_barrier);
+	synchronize_rcu();
+	return NULL;
+}
+
+/* Returns the number of grace periods for one concurrent burst. */
+static unsigned long burst(void)
+{
+	pthread_t tid[NR_UPDATERS];
+	unsigned long before = gp_count();
+	int i;
+
+	for (i = 0; i < NR_UPDATERS; i++) {
+		if (pthread_create(&tid[i], NULL, thr_updater, NULL))
+			abort();
+	}
+	for (i = 0; i < NR_UPDATERS; i++) {
+		if (pthread_join(tid[i], NULL))
+			abort();
+	}
+	return gp_count() - before;
+}
+
+static uint64_t timed_synchronize_us(void)
+{
+	uint64_t start = now_ns();
+
+	synchronize_rcu();
+	return (now_ns() - start) / 1000;
+}
+
+int main(int argc, char **argv)
+{
+	unsigned long nr_gp = 0;
+	uint64_t us;
+
+	plan_tests(6);
+
+	if (pthread_barrier_init(&start_barrier, NULL, NR_UPDATERS))
+		abort();
+
+	ok(rcu_set_gp_coalesce(2000000, 0) == -EINVAL,
+		"delay above one second is rejected");
+
+	ok(rcu_set_gp_coalesce(LONG_DELAY_US, NR_UPDATERS) == 0
+			&& (nr_gp = burst()) == 1,
+		"burst of callers shares one grace period (%lu)", nr_gp);
+
+	if (rcu_set_gp_coalesce(SHORT_DELAY_US, NR_UPDATERS))
+		abort();
+	us = timed_synchronize_us();
+	ok(us >= SHORT_DELAY_US && us < LONG_DELAY_US,
+		"lone caller waits for the window (%" PRIu64 " us)", us);
+
+	if (rcu_gp_thread_start(-1))
+		abort();
+	if (rcu_set_gp_coalesce(LONG_DELAY_US, NR_UPDATERS))
+		abort();
+	nr_gp = burst();
+	ok(nr_gp == 1, "grace-period thread coalesces callers (%lu)", nr_gp);
+	if (rcu_gp_thread_stop())
+		abort();
+
+	ok(rcu_set_gp_coalesce(0, 0) == 0, "disable");
+	us = timed_synchronize_us();
+	ok(us < LONG_DELAY_US, "no window once disabled (%" PRIu64 " us)", us);
+
+	pthread_barrier_destroy(&start_barrier);
+	return exit_status();
+}
@@ -0,0 +1,60 @@
+/*
+ * test_gp_notify_fd.c
+ *
+ * Userspace RCU library - test grace-period completion notification
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#include <stdlib.h>
+#include <stdint.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <urcu.h>
+
+#include "tap.h"
+
+#define POLL_TIMEOUT_MS		10000
+
+int main(int argc, char **argv)
+{
+	struct pollfd pfd;
+	unsigned long cookie;
+	uint64_t value;
+	int fds[2];
+
+	plan_tests(4);
+
+	rcu_register_thread();
+	if (pipe(fds) || fcntl(fds[1], F_SETFL, O_NONBLOCK))
+		abort();
+
+	ok(!start_poll_synchronize_rcu_fd(fds[1], &cookie),
+		"start grace period with fd notification");
+
+	pfd.fd = fds[0];
+	pfd.events = POLLIN;
+	ok(poll(&pfd, 1, POLL_TIMEOUT_MS) == 1 && (pfd.revents & POLLIN),
+		"fd readable once the grace period elapsed");
+	ok(read(fds[0], &value, sizeof(value)) == sizeof(value) && value == 1,
+		"notification value");
+	ok(poll_state_synchronize_rcu(cookie), "cookie reached");
+
+	(void) close(fds[0]);
+	(void) close(fds[1]);
+	rcu_unregister_thread();
+	return exit_status();
+}
@@ -0,0 +1,200 @@
+/*
+ * test_gp_step.c
+ *
+ * Userspace RCU library - test grace periods driven in steps
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+#define _LGPL_SOURCE
+#include <stdlib.h>
+#include <errno.h>
+#include <poll.h>
+#include <pthread.h>
+#include <urcu.h>
+
+#include "tap.h"
+
+#define NR_READERS	4
+#define NR_GP		500
+#define MAX_STEPS	1000000
+
+static int *shared;
+static int reader_state, stop_readers, sync_done;
+static unsigned long nr_bad;
+
+/* Hold a read-side critical section until told to leave it. */
+static void *thr_holder(void *arg)
+{
+	rcu_register_thread();
+	rcu_read_lock();
+	CMM_STORE_SHARED(reader_state, 1);
+	while (CMM_LOAD_SHARED(reader_state) == 1)
+		(void) poll(NULL, 0, 1);
+	rcu_read_unlock();
+	while (!CMM_LOAD_SHARED(stop_readers))
+		(void) poll(NULL, 0, 1);
+	rcu_unregister_thread();
+	return NULL;
+}
+
+static void *thr_idle(void *arg)
+{
+	rcu_register_thread();
+	uatomic_inc(&reader_state);
+	while (!CMM_LOAD_SHARED(stop_readers))
+		(void) poll(NULL, 0, 1);
+	rcu_unregister_thread();
+	return NULL;
+}
+
+static void *thr_reader(void *arg)
+{
+	int *p;
+
+	rcu_register_thread();
+	while (!uatomic_read(&stop_readers)) {
+		rcu_read_lock();
+		p = rcu_dereference(shared);
+		if (p && *p != 42)
+			uatomic_inc(&nr_bad);
+		rcu_read_unlock();
+	}
+	rcu_unregister_thread();
+	return NULL;
+}
+
+static void *thr_sync(void *arg)
+{
+	synchronize_rcu();
+	CMM_STORE_SHARED(sync_done, 1);
+	return NULL;
+}
+
+/* Step until the grace period elapses, returning the number of steps. */
+static unsigned long run_steps(unsigned int max_readers)
+{
+	unsigned long nr;
+	int ret;
+
+	for (nr = 1; nr < MAX_STEPS; nr++) {
+		ret = rcu_gp_step(max_readers);
+		if (ret < 0)
+			abort();
+		if (ret)
+			return nr;
+	}
+	abort();
+}
+
+int main(int argc, char **argv)
+{
+	pthread_t tid[NR_READERS], sync_tid;
+	unsigned long cookie, nr, i;
+	int ret, *p, *old;
+
+	plan_tests(9);
+
+	ok(rcu_gp_step(0) == -EPERM, "step refused without grace period");
+	ok(rcu_gp_step_start() == 1, "grace period without reader elapses");
+
+	rcu_register_thread();
+	cookie = get_state_synchronize_rcu();
+	ret = rcu_gp_step_start();
+	ok(!ret && rcu_gp_step_start() == -EBUSY,
+		"one grace period at a time");
+	nr = run_steps(0);
+	ok(!ret && nr == 2 && poll_state_synchronize_rcu(cookie),
+		"quiescent readers: phase switch, then completion");
+
+	if (pthread_create(&tid[0], NULL, thr_holder, NULL))
+		abort();
+	while (!CMM_LOAD_SHARED(reader_state))
+		(void) poll(NULL, 0, 1);
+	ret = rcu_gp_step_start();
+	if (pthread_create(&sync_tid, NULL, thr_sync, NULL))
+		abort();
+	for (i = 0; i < 20; i++) {
+		if (rcu_gp_step(0))
+			break;
+		(void) poll(NULL, 0, 1);
+	}
+	ok(!ret && i == 20 && !CMM_LOAD_SHARED(sync_done),
+		"reader holds the grace period, and synchronize_rcu() waits");
+	CMM_STORE_SHARED(reader_state, 2);
+	nr = run_steps(0);
+	if (pthread_join(sync_tid, NULL))
+		abort();
+	ok(sync_done, "grace period elapses once the reader leaves");
+	CMM_STORE_SHARED(stop_readers, 1);
+	if (pthread_join(tid[0], NULL))
+		abort();
+
+	CMM_STORE_SHARED(stop_readers, 0);
+	CMM_STORE_SHARED(reader_state, 0);
+	for (i = 0; i < NR_READERS; i++) {
+		if (pthread_create(&tid[i], NULL, thr_idle, NULL))
+			abort();
+	}
+	while (uatomic_read(&reader_state) < NR_READERS)
+		(void) poll(NULL, 0, 1);
+	ret = rcu_gp_step_start();
+	nr = run_steps(1);
+#ifdef CONFIG_RCU_READER_ARRAY
+	ok(!ret && nr >= 2, "bounded steps (%lu)", nr);
+#else
+	ok(!ret && nr >= NR_READERS + 2, "bounded steps (%lu)", nr);
+#endif
+	CMM_STORE_SHARED(stop_readers, 1);
+	for (i = 0; i < NR_READERS; i++) {
+		if (pthread_join(tid[i], NULL))
+			abort();
+	}
+
+	/* Stepped grace periods protect readers. */
+	CMM_STORE_SHARED(stop_readers, 0);
+	shared = malloc(sizeof(*shared));
+	if (!shared)
+		abort();
+	*shared = 42;
+	for (i = 0; i < NR_READERS; i++) {
+		if (pthread_create(&tid[i], NULL, thr_reader, NULL))
+			abort();
+	}
+	for (i = 0; i < NR_GP; i++) {
+		p = malloc(sizeof(*p));
+		if (!p)
+			abort();
+		*p = 42;
+		old = rcu_xchg_pointer(&shared, p);
+		ret = rcu_gp_step_start();
+		if (ret < 0)
+			abort();
+		if (!ret)
+			(void) run_steps(i % 3);
+		*old = 0;
+		free(old);
+	}
+	CMM_STORE_SHARED(stop_readers, 1);
+	for (i = 0; i < NR_READERS; i++) {
+		if (pthread_join(tid[i], NULL))
+			abort();
+	}
+	ok(!nr_bad, "readers never see freed objects");
+	free(shared);
+
+	rcu_unregister_thread();
+	ok(rcu_gp_step(0) == -EPERM, "step refused once elapsed");
+	return exit_status();
+}
@@ -0,0 +1,134 @@
+/*
+ * test_gp_thread.c
+ *
+ * Userspace RCU library - test dedicated grace-period thread
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#define _LGPL_SOURCE
+#include <stdlib.h>
+#include <errno.h>
+#include <pthread.h>
+#include <urcu.h>
+
+#include "tap.h"
+
+#define NR_READERS	2
+#define NR_UPDATERS	4
+#define NR_GP		200
+
+static int *shared;
+static int stop_readers;
+static unsigned long nr_bad, nr_gp;
+
+static void *thr_reader(void *arg)
+{
+	int *p;
+
+	rcu_register_thread();
+	while (!uatomic_read(&stop_readers)) {
+		rcu_read_lock();
+		p = rcu_dereference(shared);
+		if (p && *p != 42)
+			uatomic_inc(&nr_bad);
+		rcu_read_unlock();
+	}
+	rcu_unregister_thread();
+	return NULL;
+}
+
+/* Replace the shared object, and poison the old one after a grace period. */
+static void *thr_updater(void *arg)
+{
+	int i, *old, *p;
+
+	for (i = 0; i < NR_GP; i++) {
+		p = malloc(sizeof(*p));
+		if (!p)
+			abort();
+		*p = 42;
+		old = rcu_xchg_pointer(&shared, p);
+		synchronize_rcu();
+		if (old)
+			*old = 0;
+		free(old);
+		uatomic_inc(&nr_gp);
+	}
+	return NULL;
+}
+
+static void run_updaters(int stop_gp_thread)
+{
+	pthread_t tid[NR_UPDATERS];
+	int i, ret = 0;
+
+	for (i = 0; i < NR_UPDATERS; i++) {
+		if (pthread_create(&tid[i], NULL, thr_updater, NULL))
+			abort();
+	}
+	/* Stop the thread while callers queue for it. */
+	while (stop_gp_thread && uatomic_read(&nr_gp) < NR_GP)
+		caa_cpu_relax();
+	if (stop_gp_thread)
+		ret = rcu_gp_thread_stop();
+	for (i = 0; i < NR_UPDATERS; i++) {
+		if (pthread_join(tid[i], NULL))
+			abort();
+	}
+	if (ret)
+		abort();
+}
+
+int main(int argc, char **argv)
+{
+	pthread_t tid[NR_READERS];
+	unsigned long cookie;
+	int i;
+
+	plan_tests(6);
+
+	ok(rcu_gp_thread_stop() == -EINVAL, "stop fails when not started");
+	ok(rcu_gp_thread_start(0) == 0 && rcu_gp_thread_start(0) == -EBUSY,
+		"start once");
+
+	for (i = 0; i < NR_READERS; i++) {
+		if (pthread_create(&tid[i], NULL, thr_reader, NULL))
+			abort();
+	}
+	run_updaters(0);
+	ok(nr_gp == NR_UPDATERS * NR_GP && !nr_bad,
+		"grace periods performed by the thread wait for readers");
+
+	cookie = get_state_synchronize_rcu();
+	synchronize_rcu();
+	ok(poll_state_synchronize_rcu(cookie),
+		"synchronize_rcu() waits for a full grace period");
+
+	run_updaters(1);
+	ok(nr_gp == 2 * NR_UPDATERS * NR_GP && !nr_bad,
+		"stopping the thread wakes queued callers");
+
+	ok(rcu_gp_thread_start(-1) == 0 && rcu_gp_thread_stop() == 0,
+		"restart unpinned");
+
+	uatomic_set(&stop_readers, 1);
+	for (i = 0; i < NR_READERS; i++) {
+		if (pthread_join(tid[i], NULL))
+			abort();
+	}
+	free(shared);
+	return exit_status();
+}
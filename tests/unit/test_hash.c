@@ -0,0 +1,169 @@
+/*
+ * test_hash.c
+ *
+ * Userspace RCU library - test the urcu/hash.h hash functions
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include <urcu/hash.h>
+
+#include "tap.h"
+
+#define NR_BUCKETS	1024
+#define NR_KEYS		4096
+#define BUF_LEN		300
+
+static uint8_t buf[BUF_LEN + 8];
+
+/* Bitwise CRC32C, as reference. */
+static uint32_t ref_crc32c(const uint8_t *p, size_t len)
+{
+	uint32_t crc = ~0U;
+	int i;
+
+	while (len--) {
+		crc ^= *p++;
+		for (i = 0; i < 8; i++)
+			crc = (crc >> 1) ^ (0x82f63b78 & -(crc & 1));
+	}
+	return ~crc;
+}
+
+static int popcount64(uint64_t v)
+{
+	int n = 0;
+
+	for (; v; v &= v - 1)
+		n++;
+	return n;
+}
+
+/* Number of empty buckets among NR_BUCKETS, indexed by low bits. */
+static unsigned long nr_empty(uint64_t (*hash)(uint64_t key))
+{
+	static unsigned char used[NR_BUCKETS];
+	unsigned long i, empty = 0;
+
+	memset(used, 0, sizeof(used));
+	for (i = 0; i < NR_KEYS; i++)
+		used[hash(i) & (NR_BUCKETS - 1)] = 1;
+	for (i = 0; i < NR_BUCKETS; i++)
+		empty += !used[i];
+	return empty;
+}
+
+static uint64_t hash_u64(uint64_t key)
+{
+	return urcu_hash_u64(key, 0);
+}
+
+static uint64_t hash_bytes(uint64_t key)
+{
+	return urcu_hash_bytes(&key, sizeof(key), 0);
+}
+
+int main(int argc, char **argv)
+{
+	static const uint64_t sip_vectors[][2] = {
+		/* length, SipHash-2-4 of bytes 0..length-1, key 0..15 */
+		{ 0, 0x726fdb47dd0e0e31ULL },
+		{ 1, 0x74f839c593dc67fdULL },
+		{ 8, 0x93f5f5799a932462ULL },
+		{ 15, 0xa129ca6149be45e5ULL },
+		{ 63, 0x958a324ceb064572ULL },
+	};
+	uint8_t secret[16];
+	uint64_t h, hashes[BUF_LEN + 1];
+	unsigned long i, j, nr_bad, nr_bits, nr_flips;
+
+	plan_tests(9);
+
+	for (i = 0; i < sizeof(buf); i++)
+		buf[i] = i;
+	for (i = 0; i < sizeof(secret); i++)
+		secret[i] = i;
+
+	nr_bad = 0;
+	for (i = 0; i < CAA_ARRAY_SIZE(sip_vectors); i++) {
+		h = urcu_hash_siphash24(buf, sip_vectors[i][0], secret);
+		if (h != sip_vectors[i][1]) {
+			diag("siphash length %lu: %016llx", (unsigned long)
+				sip_vectors[i][0], (unsigned long long) h);
+			nr_bad++;
+		}
+	}
+	ok(nr_bad == 0, "siphash24 test vectors");
+
+	ok(urcu_hash_crc32c(0, "123456789", 9) == 0xe3069283
+		&& urcu_hash_crc32c(0, NULL, 0) == 0,
+		"crc32c check value");
+	nr_bad = 0;
+	for (i = 0; i <= BUF_LEN; i++) {
+		/* Odd offset, for unaligned words. */
+		if (urcu_hash_crc32c(0, buf + 3, i) != ref_crc32c(buf + 3, i))
+			nr_bad++;
+	}
+	ok(nr_bad == 0, "crc32c matches the reference on all lengths");
+	ok(urcu_hash_crc32c(urcu_hash_crc32c(0, buf, 13), buf + 13, 100)
+		== urcu_hash_crc32c(0, buf, 113),
+		"crc32c can be computed piecewise");
+
+	/* Each length of the prefix of buf gets its own hash. */
+	nr_bad = 0;
+	for (i = 0; i <= BUF_LEN; i++) {
+		hashes[i] = urcu_hash_bytes(buf, i, 0);
+		if (hashes[i] != urcu_hash_bytes(buf, i, 0))
+			nr_bad++;
+		for (j = 0; j < i; j++)
+			nr_bad += hashes[j] == hashes[i];
+	}
+	ok(nr_bad == 0, "hash of every prefix length is distinct");
+	ok(urcu_hash_bytes(buf, 32, 0) != urcu_hash_bytes(buf, 32, 1)
+		&& urcu_hash_u64(42, 0) != urcu_hash_u64(42, 1),
+		"seed changes the hash");
+
+	/* Flipping one input bit flips about half the output bits. */
+	nr_bits = 0;
+	nr_flips = 0;
+	for (i = 0; i < 4 * 8; i++) {
+		h = urcu_hash_bytes(buf, 4, 0);
+		buf[i / 8] ^= 1U << (i % 8);
+		nr_bits += popcount64(h ^ urcu_hash_bytes(buf, 4, 0));
+		buf[i / 8] ^= 1U << (i % 8);
+		h = urcu_hash_bytes(buf, 40, 0);
+		buf[i] ^= 1;
+		nr_bits += popcount64(h ^ urcu_hash_bytes(buf, 40, 0));
+		buf[i] ^= 1;
+		h = urcu_hash_u64(i, 0);
+		nr_bits += popcount64(h ^ urcu_hash_u64(i ^ (1UL << (i % 64)), 0));
+		nr_flips += 3;
+	}
+	ok(nr_bits > 28 * nr_flips && nr_bits < 36 * nr_flips,
+		"avalanche (%lu bits flipped on average over %lu flips)",
+		nr_bits / nr_flips, nr_flips);
+
+	/* Sequential keys spread over the buckets. */
+	ok(nr_empty(hash_u64) < NR_BUCKETS / 16,
+		"integer hash spreads sequential keys (%lu empty buckets)",
+		nr_empty(hash_u64));
+	ok(nr_empty(hash_bytes) < NR_BUCKETS / 16,
+		"byte hash spreads sequential keys (%lu empty buckets)",
+		nr_empty(hash_bytes));
+
+	return exit_status();
+}
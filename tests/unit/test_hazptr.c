@@ -0,0 +1,268 @@
+/*
+ * test_hazptr.c
+ *
+ * Userspace RCU library - test hazard-pointer reclamation
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#define _LGPL_SOURCE
+#include <stdlib.h>
+#include <pthread.h>
+#include <sched.h>
+#include <urcu/hazptr.h>
+#include <urcu/lfstack.h>
+#include <urcu/rculfqueue.h>
+
+#include "tap.h"
+
+#define THRESHOLD	32
+#define NR_RETIRE	10000
+#define NR_THREADS	4
+#define NR_LOOPS	20000
+
+struct obj {
+	struct urcu_hazptr_head hp;
+	struct cds_lfs_node lfs_node;
+	struct cds_lfq_node_rcu lfq_node;
+	unsigned long value;
+	int taken;
+};
+
+static struct urcu_hazptr_domain *domain;
+static unsigned long nr_alloc, nr_freed, max_pending;
+static struct obj *shared, *stalled_obj;
+static int stalled, stall_done;
+static unsigned long nr_twice, sum_in, sum_out;
+static struct cds_lfs_stack stack;
+static struct cds_lfq_queue_rcu queue;
+
+static struct obj *obj_new(unsigned long value)
+{
+	struct obj *obj;
+
+	obj = calloc(1, sizeof(*obj));
+	if (!obj)
+		abort();
+	obj->value = value;
+	cds_lfs_node_init(&obj->lfs_node);
+	cds_lfq_node_init_rcu(&obj->lfq_node);
+	uatomic_inc(&nr_alloc);
+	return obj;
+}
+
+static void obj_free(struct urcu_hazptr_head *head)
+{
+	struct obj *obj = caa_container_of(head, struct obj, hp);
+
+	if (obj == CMM_LOAD_SHARED(stalled_obj) && CMM_LOAD_SHARED(stalled))
+		uatomic_inc(&nr_twice);
+	free(obj);
+	uatomic_inc(&nr_freed);
+}
+
+static void obj_retire(struct urcu_hazptr_rec *rec, struct obj *obj)
+{
+	unsigned long pending;
+
+	urcu_hazptr_retire(rec, &obj->hp, obj, obj_free);
+	pending = uatomic_read(&nr_alloc) - uatomic_read(&nr_freed);
+	if (pending > max_pending)
+		max_pending = pending;
+}
+
+/* Protect the shared object, and keep it until told to stop. */
+static void *thr_stall(void *arg)
+{
+	struct urcu_hazptr_rec *rec = urcu_hazptr_rec_get(domain);
+
+	stalled_obj = urcu_hazptr_protect(rec, 1, (void **) &shared);
+	uatomic_set(&stalled, 1);
+	while (!uatomic_read(&stall_done))
+		sched_yield();
+	/* The object is still valid. */
+	if (stalled_obj->value != 42)
+		uatomic_inc(&nr_twice);
+	uatomic_set(&stalled, 0);
+	urcu_hazptr_clear(rec, 1);
+	return NULL;
+}
+
+static void *thr_rec(void *arg)
+{
+	return urcu_hazptr_rec_get(domain);
+}
+
+static void *thr_stack(void *arg)
+{
+	struct urcu_hazptr_rec *rec = urcu_hazptr_rec_get(domain);
+	struct cds_lfs_node *node;
+	struct obj *obj;
+	unsigned long i;
+
+	for (i = 0; i < NR_LOOPS; i++) {
+		cds_lfs_push(&stack, &obj_new(i)->lfs_node);
+		node = __cds_lfs_pop_hazptr(&stack, rec);
+		if (!node)
+			continue;
+		obj = caa_container_of(node, struct obj, lfs_node);
+		if (uatomic_xchg(&obj->taken, 1))
+			uatomic_inc(&nr_twice);
+		obj_retire(rec, obj);
+	}
+	return NULL;
+}
+
+static void *thr_enqueue(void *arg)
+{
+	struct urcu_hazptr_rec *rec = urcu_hazptr_rec_get(domain);
+	unsigned long i;
+
+	for (i = 1; i <= NR_LOOPS; i++) {
+		cds_lfq_enqueue_hazptr(&queue, &obj_new(i)->lfq_node, rec);
+		uatomic_add(&sum_in, i);
+	}
+	return NULL;
+}
+
+static void *thr_dequeue(void *arg)
+{
+	struct urcu_hazptr_rec *rec = urcu_hazptr_rec_get(domain);
+	struct cds_lfq_node_rcu *node;
+	unsigned long nr = 0;
+	struct obj *obj;
+
+	while (nr < NR_LOOPS) {
+		node = cds_lfq_dequeue_hazptr(&queue, rec);
+		if (!node) {
+			sched_yield();
+			continue;
+		}
+		obj = caa_container_of(node, struct obj, lfq_node);
+		if (uatomic_xchg(&obj->taken, 1))
+			uatomic_inc(&nr_twice);
+		uatomic_add(&sum_out, obj->value);
+		obj_retire(rec, obj);
+		nr++;
+	}
+	return NULL;
+}
+
+static void run_threads(void *(*fn1)(void *), void *(*fn2)(void *))
+{
+	pthread_t tid[NR_THREADS];
+	unsigned long i;
+
+	for (i = 0; i < NR_THREADS; i++) {
+		if (pthread_create(&tid[i], NULL, (i & 1) ? fn2 : fn1, NULL))
+			abort();
+	}
+	for (i = 0; i < NR_THREADS; i++) {
+		if (pthread_join(tid[i], NULL))
+			abort();
+	}
+}
+
+static void test_domain(unsigned int flags, const char *name)
+{
+	struct urcu_hazptr_rec *rec;
+	struct cds_lfs_node *node;
+	struct obj *obj;
+	unsigned long i, bound;
+	pthread_t tid;
+	void *other[2];
+
+	nr_alloc = nr_freed = max_pending = nr_twice = 0;
+	domain = urcu_hazptr_domain_create(THRESHOLD, flags);
+	if (!domain)
+		abort();
+	rec = urcu_hazptr_rec_get(domain);
+	diag("%s: sys_membarrier %d", name, rec->sys_membarrier);
+
+	/* Protected objects survive scans until their slot is cleared. */
+	shared = obj_new(42);
+	obj = urcu_hazptr_protect(rec, 0, (void **) &shared);
+	shared = NULL;
+	obj_retire(rec, obj);
+	ok(urcu_hazptr_reclaim(rec) == 1 && nr_freed == 0
+			&& obj->value == 42,
+		"%s: protected object not reclaimed", name);
+	urcu_hazptr_clear(rec, 0);
+	ok(urcu_hazptr_reclaim(rec) == 0 && nr_freed == 1,
+		"%s: object reclaimed once its slot is cleared", name);
+
+	/* A stalled reader only keeps the object it protects. */
+	shared = obj_new(42);
+	if (pthread_create(&tid, NULL, thr_stall, NULL))
+		abort();
+	while (!uatomic_read(&stalled))
+		sched_yield();
+	obj = shared;
+	shared = NULL;
+	obj_retire(rec, obj);
+	for (i = 0; i < NR_RETIRE; i++)
+		obj_retire(rec, obj_new(i));
+	/* Two records: the main and the stalled threads. */
+	bound = THRESHOLD + 2 * URCU_HAZPTR_NR_SLOTS;
+	ok(max_pending <= bound && nr_twice == 0,
+		"%s: retired objects bounded with a stalled reader (%lu <= %lu)",
+		name, max_pending, bound);
+	uatomic_set(&stall_done, 1);
+	if (pthread_join(tid, NULL))
+		abort();
+	stall_done = 0;
+	ok(urcu_hazptr_reclaim(rec) == 0 && nr_twice == 0
+			&& nr_freed == nr_alloc,
+		"%s: stalled object reclaimed after the reader", name);
+
+	/* Records of exited threads are reused. */
+	for (i = 0; i < 2; i++) {
+		if (pthread_create(&tid, NULL, thr_rec, NULL))
+			abort();
+		if (pthread_join(tid, &other[i]))
+			abort();
+	}
+	ok(other[0] != rec && other[0] == other[1],
+		"%s: record of exited thread reused", name);
+
+	cds_lfs_init(&stack);
+	run_threads(thr_stack, thr_stack);
+	while ((node = __cds_lfs_pop_hazptr(&stack, rec)) != NULL)
+		obj_retire(rec, caa_container_of(node, struct obj, lfs_node));
+	ok(nr_twice == 0, "%s: concurrent lfstack push and pop", name);
+	cds_lfs_destroy(&stack);
+
+	cds_lfq_init_hazptr(&queue);
+	sum_in = sum_out = 0;
+	run_threads(thr_enqueue, thr_dequeue);
+	ok(cds_lfq_dequeue_hazptr(&queue, rec) == NULL && nr_twice == 0
+			&& sum_in == sum_out,
+		"%s: concurrent lfq enqueue and dequeue", name);
+	ok(cds_lfq_destroy_rcu(&queue) == 0, "%s: lfq destroyed", name);
+
+	/* Destroying the domain reclaims what is left. */
+	obj_retire(rec, obj_new(0));
+	urcu_hazptr_domain_destroy(domain);
+	ok(nr_freed == nr_alloc, "%s: domain destroy reclaims objects", name);
+}
+
+int main(int argc, char **argv)
+{
+	plan_tests(18);
+
+	test_domain(0, "mb");
+	test_domain(URCU_HAZPTR_SYS_MEMBARRIER, "membarrier");
+	return exit_status();
+}
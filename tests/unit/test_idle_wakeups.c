@@ -0,0 +1,162 @@
+/*
+ * test_idle_wakeups.c
+ *
+ * Userspace RCU library - test that idle helper threads sleep
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <dirent.h>
+#include <poll.h>
+#include <unistd.h>
+#include <sys/syscall.h>
+#include <urcu.h>
+#include <urcu/uatomic.h>
+
+#include "workqueue.h"
+#include "tap.h"
+
+#define NR_CBS		64
+#define NR_WORKERS	2
+#define IDLE_MS		500
+#define SAMPLE_MS	300
+#define TIMEOUT_MS	3000
+
+static struct rcu_head heads[NR_CBS];
+static struct urcu_work works[NR_WORKERS];
+static unsigned long nr_invoked, nr_done;
+
+static void count_cb(struct rcu_head *head)
+{
+	uatomic_inc(&nr_invoked);
+}
+
+static void count_work(struct urcu_work *work)
+{
+	uatomic_inc(&nr_done);
+}
+
+/* Queue callbacks on crdp, and wait for them. */
+static int run_cbs(struct call_rcu_data *crdp)
+{
+	int i;
+
+	nr_invoked = 0;
+	set_thread_call_rcu_data(crdp);
+	for (i = 0; i < NR_CBS; i++)
+		call_rcu(&heads[i], count_cb);
+	rcu_barrier_crdp(crdp);
+	set_thread_call_rcu_data(NULL);
+	return uatomic_read(&nr_invoked) == NR_CBS;
+}
+
+/* Queue one work item per worker, and wait up to TIMEOUT_MS for them. */
+static int run_work(struct urcu_workqueue *workqueue)
+{
+	int i, ms;
+
+	nr_done = 0;
+	for (i = 0; i < NR_WORKERS; i++)
+		urcu_workqueue_queue_work(workqueue, &works[i], count_work);
+	for (ms = 0; ms < TIMEOUT_MS; ms++) {
+		if (uatomic_read(&nr_done) == NR_WORKERS)
+			return 1;
+		(void) poll(NULL, 0, 1);
+	}
+	return 0;
+}
+
+/*
+ * Sum of the context switches of all threads of the process but the
+ * calling one, which are the helper threads.
+ */
+static unsigned long helper_ctxt_switches(void)
+{
+	char path[320], line[128];
+	unsigned long sum = 0, nr;
+	long self = syscall(SYS_gettid);
+	struct dirent *entry;
+	DIR *dir;
+	FILE *fp;
+
+	dir = opendir("/proc/self/task");
+	if (!dir)
+		return 0;
+	while ((entry = readdir(dir)) != NULL) {
+		if (entry->d_name[0] == '.' || atol(entry->d_name) == self)
+			continue;
+		snprintf(path, sizeof(path), "/proc/self/task/%s/status",
+			entry->d_name);
+		fp = fopen(path, "r");
+		if (!fp)
+			continue;
+		while (fgets(line, sizeof(line), fp)) {
+			if (sscanf(line, "voluntary_ctxt_switches: %lu", &nr) == 1
+					|| sscanf(line, "nonvoluntary_ctxt_switches: %lu",
+						&nr) == 1)
+				sum += nr;
+		}
+		fclose(fp);
+	}
+	closedir(dir);
+	return sum;
+}
+
+int main(int argc, char **argv)
+{
+	struct call_rcu_data *crdp, *rt_crdp;
+	struct urcu_workqueue *workqueue;
+	unsigned long before, after;
+
+	plan_tests(6);
+
+	if (access("/proc/self/task", R_OK)) {
+		skip(6, "/proc/self/task is not available");
+		return exit_status();
+	}
+
+	crdp = create_call_rcu_data(0, -1);
+	rt_crdp = create_call_rcu_data(URCU_CALL_RCU_RT, -1);
+	workqueue = urcu_workqueue_create_nr(URCU_WORKQUEUE_RT, -1,
+		NR_WORKERS, NULL, NULL, NULL, NULL, NULL, NULL, NULL, NULL);
+	if (!crdp || !rt_crdp || !workqueue)
+		abort();
+
+	ok(run_cbs(crdp) && run_cbs(rt_crdp),
+		"callbacks are invoked by both helpers");
+	ok(run_work(workqueue), "real-time workers run work");
+
+	/* Leave the helpers the time to stop polling. */
+	(void) poll(NULL, 0, IDLE_MS);
+	before = helper_ctxt_switches();
+	(void) poll(NULL, 0, SAMPLE_MS);
+	after = helper_ctxt_switches();
+	ok(after == before,
+		"idle helpers are not woken up (%lu context switches in %d ms)",
+		after - before, SAMPLE_MS);
+
+	ok(run_cbs(rt_crdp), "call_rcu() wakes up a parked real-time helper");
+	ok(run_work(workqueue), "queued work wakes up parked real-time workers");
+	ok(run_cbs(crdp), "call_rcu() wakes up a sleeping helper");
+
+	urcu_workqueue_destroy(workqueue);
+	call_rcu_data_free(rt_crdp);
+	call_rcu_data_free(crdp);
+
+	return exit_status();
+}
@@ -0,0 +1,256 @@
+/*
+ * test_introspect.c
+ *
+ * Userspace RCU library - test runtime introspection
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <signal.h>
+#include <poll.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <urcu.h>
+#include <urcu/rculfhash.h>
+
+#include "tap.h"
+
+#define NR_DEFERRED	16
+
+struct reader_count {
+	pthread_t tid;
+	unsigned long nr_readers, nr_found;
+	enum urcu_reader_info_state state;
+};
+
+static void count_reader(const struct urcu_reader_info *info, void *priv)
+{
+	struct reader_count *count = priv;
+
+	count->nr_readers++;
+	if (pthread_equal(info->tid, count->tid)) {
+		count->nr_found++;
+		count->state = info->state;
+	}
+}
+
+static void count_readers(struct reader_count *count)
+{
+	count->tid = pthread_self();
+	count->nr_readers = count->nr_found = 0;
+	if (rcu_for_each_reader(count_reader, count))
+		abort();
+}
+
+struct call_rcu_count {
+	struct call_rcu_data *crdp;
+	unsigned long nr_found;
+	struct urcu_call_rcu_info info;
+};
+
+static void count_call_rcu_data(struct call_rcu_data *crdp,
+		const struct urcu_call_rcu_info *info, void *priv)
+{
+	struct call_rcu_count *count = priv;
+
+	if (crdp == count->crdp) {
+		count->nr_found++;
+		count->info = *info;
+	}
+}
+
+struct defer_count {
+	unsigned long nr_found;
+	struct urcu_defer_queue_info info;
+};
+
+static void count_defer_queue(const struct urcu_defer_queue_info *info,
+		void *priv)
+{
+	struct defer_count *count = priv;
+
+	if (pthread_equal(info->tid, pthread_self())) {
+		count->nr_found++;
+		count->info = *info;
+	}
+}
+
+struct table_count {
+	struct cds_lfht *ht;
+	unsigned long nr_found;
+	struct cds_lfht_info info;
+};
+
+static void count_table(struct cds_lfht *ht, const struct cds_lfht_info *info,
+		void *priv)
+{
+	struct table_count *count = priv;
+
+	if (ht == count->ht) {
+		count->nr_found++;
+		count->info = *info;
+	}
+}
+
+static int reader_ready, reader_stop;
+
+static void *thr_reader(void *arg)
+{
+	rcu_register_thread();
+	uatomic_set(&reader_ready, 1);
+	while (!uatomic_read(&reader_stop))
+		(void) poll(NULL, 0, 1);
+	rcu_unregister_thread();
+	return NULL;
+}
+
+static void deferred(void *p)
+{
+}
+
+/* Read what was dumped to the pipe, waiting up to timeout_ms for it. */
+static ssize_t read_dump(int fd, char *buf, size_t len, int timeout_ms)
+{
+	struct pollfd pfd = { .fd = fd, .events = POLLIN };
+	ssize_t ret, done = 0;
+
+	if (poll(&pfd, 1, timeout_ms) <= 0)
+		return 0;
+	/* Let the dump thread complete its write. */
+	(void) poll(NULL, 0, 10);
+	while (done < (ssize_t) len - 1) {
+		ret = read(fd, buf + done, len - 1 - done);
+		if (ret <= 0)
+			break;
+		done += ret;
+		if (poll(&pfd, 1, 0) <= 0)
+			break;
+	}
+	buf[done] = '\0';
+	return done;
+}
+
+int main(int argc, char **argv)
+{
+	struct reader_count readers;
+	struct call_rcu_count crdps;
+	struct defer_count defers;
+	struct table_count tables;
+	struct cds_lfht_node node;
+	struct cds_lfht *ht;
+	char buf[65536];
+	pthread_t tid;
+	int fds[2], i;
+
+	plan_tests(13);
+
+	if (pipe(fds))
+		abort();
+
+	rcu_register_thread();
+	count_readers(&readers);
+	ok(readers.nr_found == 1
+			&& readers.state == URCU_READER_INFO_INACTIVE,
+		"registered reader found, inactive");
+	rcu_read_lock();
+	count_readers(&readers);
+	rcu_read_unlock();
+	ok(readers.nr_found == 1
+			&& readers.state == URCU_READER_INFO_ACTIVE_CURRENT,
+		"reader in a critical section is active");
+
+	if (pthread_create(&tid, NULL, thr_reader, NULL))
+		abort();
+	while (!uatomic_read(&reader_ready))
+		(void) poll(NULL, 0, 1);
+	count_readers(&readers);
+	ok(readers.nr_readers == 2, "other registered thread found");
+	uatomic_set(&reader_stop, 1);
+	if (pthread_join(tid, NULL))
+		abort();
+	count_readers(&readers);
+	ok(readers.nr_readers == 1, "unregistered thread no longer found");
+
+	memset(&crdps, 0, sizeof(crdps));
+	crdps.crdp = create_call_rcu_data(0, -1);
+	rcu_for_each_call_rcu_data(count_call_rcu_data, &crdps);
+	ok(crdps.nr_found == 1 && crdps.info.cpu_affinity == -1
+			&& pthread_equal(crdps.info.tid,
+				get_call_rcu_thread(crdps.crdp)),
+		"call_rcu_data found with its thread");
+
+	memset(&defers, 0, sizeof(defers));
+	rcu_for_each_defer_queue(count_defer_queue, &defers);
+	ok(!defers.nr_found, "unregistered thread has no defer queue");
+	if (rcu_defer_register_thread())
+		abort();
+	for (i = 0; i < NR_DEFERRED; i++)
+		defer_rcu(deferred, NULL);
+	rcu_for_each_defer_queue(count_defer_queue, &defers);
+	ok(defers.nr_found == 1 && defers.info.size == 4096
+			&& defers.info.fill <= defers.info.size,
+		"defer queue found (%lu of %lu entries)",
+		defers.info.fill, defers.info.size);
+
+	ok(!rcu_introspect_dump(fds[1])
+			&& read_dump(fds[0], buf, sizeof(buf), 0) > 0
+			&& strstr(buf, "reader tid=")
+			&& strstr(buf, "call_rcu tid=")
+			&& strstr(buf, "defer tid="),
+		"dump lists readers, call_rcu_data and defer queues");
+
+	ok(!rcu_introspect_signal_start(SIGUSR2, fds[1]),
+		"signal-triggered dump started");
+	ok(rcu_introspect_signal_start(SIGUSR2, fds[1]) == -EBUSY,
+		"a single signal-triggered dump");
+	if (raise(SIGUSR2))
+		abort();
+	ok(read_dump(fds[0], buf, sizeof(buf), 5000) > 0
+			&& strstr(buf, "reader tid="),
+		"signal dumps");
+	rcu_introspect_signal_stop();
+
+	rcu_defer_unregister_thread();
+	call_rcu_data_free(crdps.crdp);
+
+	ht = cds_lfht_new(1024, 1, 0, CDS_LFHT_ACCOUNTING, NULL);
+	cds_lfht_node_init(&node);
+	rcu_read_lock();
+	cds_lfht_add(ht, 0, &node);
+	rcu_read_unlock();
+	memset(&tables, 0, sizeof(tables));
+	tables.ht = ht;
+	cds_lfht_for_each_table(count_table, &tables);
+	ok(tables.nr_found == 1 && tables.info.size == 1024
+			&& tables.info.count == 1
+			&& !cds_lfht_introspect_dump(fds[1])
+			&& read_dump(fds[0], buf, sizeof(buf), 0) > 0
+			&& strstr(buf, "cds_lfht ht="),
+		"live table found and dumped");
+	rcu_read_lock();
+	(void) cds_lfht_del(ht, &node);
+	rcu_read_unlock();
+	if (cds_lfht_destroy(ht, NULL))
+		abort();
+	tables.nr_found = 0;
+	cds_lfht_for_each_table(count_table, &tables);
+	ok(!tables.nr_found, "destroyed table no longer found");
+
+	rcu_unregister_thread();
+	return exit_status();
+}
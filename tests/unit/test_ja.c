@@ -0,0 +1,163 @@
+/*
+ * test_ja.c
+ *
+ * Userspace RCU library - test RCU Judy array
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#include <stdlib.h>
+#include <errno.h>
+#include <pthread.h>
+#include <urcu.h>
+#include <urcu/rcuja.h>
+
+#include "tap.h"
+
+#define NR_KEYS		100000
+#define NR_SPARSE	1000
+#define NR_ROUNDS	10
+
+struct test_node {
+	struct cds_ja_node node;
+	struct rcu_head head;
+};
+
+static struct cds_ja *ja;
+static struct test_node dense[NR_KEYS], sparse[NR_SPARSE];
+static int stop, nr_bad;
+
+/* Sparse keys are above dense keys, and use the high key bytes. */
+static unsigned long sparse_key(unsigned long i)
+{
+	return (i + 1) << (sizeof(long) > 4 ? 40 : 20);
+}
+
+static void free_node(struct rcu_head *head)
+{
+	free(caa_container_of(head, struct test_node, head));
+}
+
+/* The node of a key found holds that key. */
+static void *reader_fn(void *arg)
+{
+	unsigned long key = 0;
+	struct cds_ja_node *node;
+
+	rcu_register_thread();
+	while (!CMM_LOAD_SHARED(stop)) {
+		rcu_read_lock();
+		node = cds_ja_lookup(ja, key);
+		if (node && node->key != key)
+			nr_bad++;
+		if (!(key & 1) && !node)
+			nr_bad++;
+		rcu_read_unlock();
+		key = (key + 1) % NR_KEYS;
+	}
+	rcu_unregister_thread();
+	return NULL;
+}
+
+int main(int argc, char **argv)
+{
+	struct cds_ja_node *node;
+	struct test_node *tn;
+	pthread_t reader;
+	unsigned long i, count;
+	int i_round, ret;
+
+	plan_tests(9);
+
+	rcu_register_thread();
+	ja = cds_ja_new();
+	if (!ja)
+		abort();
+
+	ret = 0;
+	rcu_read_lock();
+	for (i = 0; i < NR_KEYS; i++)
+		ret |= cds_ja_add(ja, i, &dense[i].node);
+	for (i = 0; i < NR_SPARSE; i++)
+		ret |= cds_ja_add(ja, sparse_key(i), &sparse[i].node);
+	ok(!ret, "add dense and sparse keys");
+	ok(cds_ja_add(ja, 1, &sparse[0].node) == -EEXIST,
+		"add existing key fails");
+
+	count = 0;
+	for (i = 0; i < NR_KEYS; i++)
+		count += cds_ja_lookup(ja, i) == &dense[i].node;
+	for (i = 0; i < NR_SPARSE; i++)
+		count += cds_ja_lookup(ja, sparse_key(i)) == &sparse[i].node;
+	ok(count == NR_KEYS + NR_SPARSE, "lookup all keys");
+	ok(!cds_ja_lookup(ja, NR_KEYS) && !cds_ja_lookup(ja, ~0UL),
+		"lookup missing keys");
+	rcu_read_unlock();
+
+	ok(cds_ja_destroy(ja) == -EPERM, "destroy non-empty array fails");
+
+	/* Remove odd and sparse keys, to empty and shrink nodes. */
+	count = 0;
+	rcu_read_lock();
+	for (i = 1; i < NR_KEYS; i += 2)
+		count += cds_ja_del(ja, i) == &dense[i].node;
+	for (i = 0; i < NR_SPARSE; i++)
+		count += cds_ja_del(ja, sparse_key(i)) == &sparse[i].node;
+	count += !cds_ja_del(ja, 1);
+	for (i = 0; i < NR_KEYS; i++)
+		count += (cds_ja_lookup(ja, i) == NULL) == (i & 1);
+	rcu_read_unlock();
+	ok(count == NR_KEYS / 2 + NR_SPARSE + 1 + NR_KEYS, "del once");
+
+	/* Odd keys come and go while a reader looks up all keys. */
+	if (pthread_create(&reader, NULL, reader_fn, NULL))
+		abort();
+	ret = 0;
+	for (i_round = 0; i_round < NR_ROUNDS; i_round++) {
+		for (i = 1; i < NR_KEYS; i += 2) {
+			tn = malloc(sizeof(*tn));
+			if (!tn)
+				abort();
+			rcu_read_lock();
+			ret |= cds_ja_add(ja, i, &tn->node);
+			rcu_read_unlock();
+		}
+		for (i = 1; i < NR_KEYS; i += 2) {
+			rcu_read_lock();
+			node = cds_ja_del(ja, i);
+			rcu_read_unlock();
+			if (!node) {
+				ret = 1;
+				continue;
+			}
+			call_rcu(&caa_container_of(node, struct test_node,
+				node)->head, free_node);
+		}
+	}
+	CMM_STORE_SHARED(stop, 1);
+	if (pthread_join(reader, NULL))
+		abort();
+	ok(!ret, "add and del during lookups");
+	ok(!nr_bad, "lookups see consistent nodes");
+
+	rcu_read_lock();
+	for (i = 0; i < NR_KEYS; i += 2)
+		(void) cds_ja_del(ja, i);
+	rcu_read_unlock();
+	ok(!cds_ja_destroy(ja), "destroy empty array");
+	rcu_barrier();
+	rcu_unregister_thread();
+	return exit_status();
+}
@@ -0,0 +1,71 @@
+/*
+ * test_lfht_bit_reverse.c
+ *
+ * Userspace RCU library - test hash table bit reversal
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#define _LGPL_SOURCE
+#include <urcu.h>
+#include <urcu/rculfhash.h>
+
+#include "tap.h"
+
+#define NR_VALUES	100000
+
+static uint64_t naive_reverse(uint64_t v, unsigned int bits)
+{
+	uint64_t r = 0;
+	unsigned int i;
+
+	for (i = 0; i < bits; i++)
+		if (v & (1ULL << i))
+			r |= 1ULL << (bits - 1 - i);
+	return r;
+}
+
+int main(int argc, char **argv)
+{
+	uint64_t v = 0x0123456789abcdefULL;
+	unsigned long i, nr_u8 = 0, nr_u32 = 0, nr_u64 = 0, nr_ulong = 0;
+
+	plan_tests(4);
+
+	for (i = 0; i < 256; i++)
+		if (_cds_lfht_bit_reverse_u8(i) != naive_reverse(i, 8))
+			nr_u8++;
+	for (i = 0; i < NR_VALUES; i++) {
+		/* xorshift */
+		v ^= v << 13;
+		v ^= v >> 7;
+		v ^= v << 17;
+		if (_cds_lfht_bit_reverse_u32((uint32_t) v)
+				!= naive_reverse((uint32_t) v, 32))
+			nr_u32++;
+		if (_cds_lfht_bit_reverse_u64(v) != naive_reverse(v, 64))
+			nr_u64++;
+		if (_cds_lfht_bit_reverse_ulong((unsigned long) v)
+				!= naive_reverse((unsigned long) v,
+					CAA_BITS_PER_LONG))
+			nr_ulong++;
+	}
+	ok(!nr_u8, "bytes reversed");
+	ok(!nr_u32, "32-bit words reversed");
+	ok(!nr_u64, "64-bit words reversed");
+	ok(!nr_ulong, "longs reversed");
+
+	return exit_status();
+}
@@ -0,0 +1,128 @@
+/*
+ * test_lfht_bulk.c
+ *
+ * Userspace RCU library - test cds_lfht_add_bulk and cds_lfht_del_bulk
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#include <stdlib.h>
+#include <urcu.h>
+#include <urcu/rculfhash.h>
+
+#include "tap.h"
+
+#define NR_NODES	10000
+
+struct test_node {
+	unsigned long key;
+	struct cds_lfht_node node;
+};
+
+static struct test_node nodes[NR_NODES];
+static struct cds_lfht_node *node_ptrs[NR_NODES + 1];
+static unsigned long hashes[NR_NODES];
+
+/* Keys are added twice: check duplicates are kept. */
+static unsigned long test_hash(unsigned long key)
+{
+	return key * 2654435761UL;
+}
+
+static int test_match(struct cds_lfht_node *node, const void *key)
+{
+	return caa_container_of(node, struct test_node, node)->key
+		== *(const unsigned long *) key;
+}
+
+static unsigned long count_nodes(struct cds_lfht *ht)
+{
+	unsigned long count;
+	long before, after;
+
+	rcu_read_lock();
+	cds_lfht_count_nodes(ht, &before, &count, &after);
+	rcu_read_unlock();
+	return count;
+}
+
+int main(int argc, char **argv)
+{
+	struct cds_lfht *ht;
+	struct cds_lfht_iter iter;
+	unsigned long i, key, nr_missing = 0, nr_removed = 0, ret;
+
+	plan_tests(6);
+
+	rcu_register_thread();
+	ht = cds_lfht_new(1, 1, 0,
+		CDS_LFHT_AUTO_RESIZE | CDS_LFHT_ACCOUNTING, NULL);
+	if (!ht)
+		abort();
+
+	for (i = 0; i < NR_NODES; i++) {
+		nodes[i].key = i / 2;
+		cds_lfht_node_init(&nodes[i].node);
+		node_ptrs[i] = &nodes[i].node;
+		hashes[i] = test_hash(nodes[i].key);
+	}
+	cds_lfht_add_bulk(ht, node_ptrs, hashes, NR_NODES);
+	ok(count_nodes(ht) == NR_NODES, "bulk add adds all nodes");
+
+	rcu_read_lock();
+	for (key = 0; key < NR_NODES / 2; key++) {
+		cds_lfht_lookup(ht, test_hash(key), test_match, &key, &iter);
+		if (!cds_lfht_iter_get_node(&iter)) {
+			nr_missing++;
+			continue;
+		}
+		cds_lfht_next_duplicate(ht, test_match, &key, &iter);
+		if (!cds_lfht_iter_get_node(&iter))
+			nr_missing++;
+	}
+	rcu_read_unlock();
+	ok(!nr_missing, "bulk added nodes can be looked up");
+
+	/* Remove the nodes of even keys, once twice, plus a NULL entry. */
+	for (i = 0; i < NR_NODES; i++) {
+		if ((nodes[i].key & 1))
+			continue;
+		node_ptrs[nr_removed++] = &nodes[i].node;
+	}
+	node_ptrs[nr_removed++] = &nodes[0].node;
+	node_ptrs[nr_removed++] = NULL;
+	rcu_read_lock();
+	ret = cds_lfht_del_bulk(ht, node_ptrs, nr_removed);
+	rcu_read_unlock();
+	ok(ret == nr_removed - 2, "bulk delete removes each node once");
+	for (i = 0, nr_missing = 0; i < nr_removed; i++) {
+		if (node_ptrs[i])
+			nr_missing++;
+	}
+	ok(nr_missing == ret, "bulk delete reports removed nodes");
+	ok(count_nodes(ht) == NR_NODES - ret, "bulk deleted nodes are unlinked");
+
+	rcu_read_lock();
+	for (key = 0, nr_missing = 0; key < NR_NODES / 2; key++) {
+		cds_lfht_lookup(ht, test_hash(key), test_match, &key, &iter);
+		if (!cds_lfht_iter_get_node(&iter) != !(key & 1))
+			nr_missing++;
+	}
+	rcu_read_unlock();
+	ok(!nr_missing, "only deleted keys are gone");
+
+	rcu_unregister_thread();
+	return exit_status();
+}
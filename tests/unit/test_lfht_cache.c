@@ -0,0 +1,246 @@
+/*
+ * test_lfht_cache.c
+ *
+ * Userspace RCU library - test RCU cache with CLOCK eviction
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#include <stdlib.h>
+#include <errno.h>
+#include <poll.h>
+#include <pthread.h>
+#include <urcu.h>
+#include <urcu/rculfhash-cache.h>
+
+#include "tap.h"
+
+#define NR_ENTRIES	64
+#define ENTRY_SIZE	100
+#define NR_SHARDS	4
+#define NR_READERS	2
+#define NR_WRITES	20000
+#define NR_KEYS		256
+
+struct test_entry {
+	struct cds_lfht_cache_node cnode;
+	unsigned long key;
+	unsigned long value;
+};
+
+static unsigned long nr_freed;
+static int stop_readers;
+static unsigned long nr_bad, nr_hits;
+
+static unsigned long test_hash(unsigned long key)
+{
+	return key * 2654435761UL ^ (key << (CAA_BITS_PER_LONG - 8));
+}
+
+static int test_match(struct cds_lfht_node *node, const void *key)
+{
+	struct test_entry *e = caa_container_of(node, struct test_entry,
+			cnode.node);
+
+	return e->key == *(const unsigned long *) key;
+}
+
+static void free_entry(struct rcu_head *head)
+{
+	struct test_entry *e = caa_container_of(head, struct test_entry,
+			cnode.rcu_head);
+
+	e->value = 0;
+	free(e);
+	uatomic_inc(&nr_freed);
+}
+
+static struct test_entry *new_entry(unsigned long key)
+{
+	struct test_entry *e = malloc(sizeof(*e));
+
+	if (!e)
+		abort();
+	e->key = key;
+	e->value = key + 1;
+	return e;
+}
+
+/* Add key, returning whether it was not cached yet. */
+static int add(struct cds_lfht_cache *cache, unsigned long key)
+{
+	struct test_entry *e = new_entry(key);
+	struct cds_lfht_cache_node *ret;
+
+	rcu_read_lock();
+	ret = cds_lfht_cache_add(cache, test_hash(key), test_match, &key,
+			&e->cnode, ENTRY_SIZE);
+	rcu_read_unlock();
+	if (ret != &e->cnode) {
+		free(e);
+		return 0;
+	}
+	return 1;
+}
+
+static struct test_entry *lookup(struct cds_lfht_cache *cache,
+		unsigned long key)
+{
+	struct cds_lfht_cache_node *node;
+
+	node = cds_lfht_cache_lookup(cache, test_hash(key), test_match, &key);
+	return node ? caa_container_of(node, struct test_entry, cnode) : NULL;
+}
+
+/* Count the entries without referencing them. */
+static unsigned long count(struct cds_lfht_cache *cache)
+{
+	long before, after;
+	unsigned long nr;
+
+	rcu_read_lock();
+	cds_lfht_count_nodes(cds_lfht_cache_ht(cache), &before, &nr, &after);
+	rcu_read_unlock();
+	return nr;
+}
+
+static int cached(struct cds_lfht_cache *cache, unsigned long key)
+{
+	int ret;
+
+	rcu_read_lock();
+	ret = lookup(cache, key) != NULL;
+	rcu_read_unlock();
+	return ret;
+}
+
+static void *thr_reader(void *arg)
+{
+	struct cds_lfht_cache *cache = arg;
+	struct test_entry *e;
+	unsigned long key = 0;
+
+	rcu_register_thread();
+	while (!uatomic_read(&stop_readers)) {
+		rcu_read_lock();
+		e = lookup(cache, key);
+		if (e) {
+			if (CMM_LOAD_SHARED(e->value) != key + 1)
+				uatomic_inc(&nr_bad);
+			uatomic_inc(&nr_hits);
+		}
+		rcu_read_unlock();
+		key = (key + 1) % NR_KEYS;
+	}
+	rcu_unregister_thread();
+	return NULL;
+}
+
+static void test_concurrent(void)
+{
+	struct cds_lfht_cache *cache;
+	pthread_t tid[NR_READERS];
+	unsigned long i, nr_added = 0;
+	int ret;
+
+	cache = cds_lfht_cache_new(NR_ENTRIES * ENTRY_SIZE, NR_SHARDS,
+			free_entry);
+	if (!cache)
+		abort();
+	for (i = 0; i < NR_READERS; i++) {
+		if (pthread_create(&tid[i], NULL, thr_reader, cache))
+			abort();
+	}
+	for (i = 0; i < NR_WRITES; i++) {
+		nr_added += add(cache, i % NR_KEYS);
+		if (i % 64 == 0)
+			(void) poll(NULL, 0, 0);
+	}
+	uatomic_set(&stop_readers, 1);
+	for (i = 0; i < NR_READERS; i++) {
+		if (pthread_join(tid[i], NULL))
+			abort();
+	}
+	ok(!nr_bad && cds_lfht_cache_used(cache) <= NR_ENTRIES * ENTRY_SIZE,
+		"concurrent hits see live entries only (%lu hits)", nr_hits);
+	ret = cds_lfht_cache_destroy(cache);
+	rcu_barrier();
+	ok(!ret && nr_freed == nr_added,
+		"destroy frees the remaining entries");
+}
+
+int main(int argc, char **argv)
+{
+	struct cds_lfht_cache *cache;
+	struct test_entry *e;
+	unsigned long i, key, nr_kept = 0;
+
+	plan_tests(9);
+
+	rcu_register_thread();
+
+	ok(!cds_lfht_cache_new(ENTRY_SIZE, 3, free_entry),
+		"reject a number of shards not a power of two");
+	/* A single shard, for an exact eviction order. */
+	cache = cds_lfht_cache_new(NR_ENTRIES * ENTRY_SIZE, 1, free_entry);
+	if (!cache)
+		abort();
+
+	for (key = 0; key < NR_ENTRIES; key++)
+		(void) add(cache, key);
+	ok(count(cache) == NR_ENTRIES
+			&& cds_lfht_cache_used(cache) == NR_ENTRIES * ENTRY_SIZE,
+		"entries fit in the capacity");
+	ok(!add(cache, 0), "adding a cached key keeps the cached entry");
+
+	/* Reference the even keys, and make room for as many entries. */
+	for (key = 0; key < NR_ENTRIES; key += 2)
+		(void) cached(cache, key);
+	for (key = NR_ENTRIES; key < NR_ENTRIES + NR_ENTRIES / 2; key++)
+		(void) add(cache, key);
+	rcu_barrier();
+	for (key = 0; key < NR_ENTRIES; key++)
+		nr_kept += cached(cache, key) == !(key & 1);
+	ok(nr_kept == NR_ENTRIES && nr_freed == NR_ENTRIES / 2
+			&& cds_lfht_cache_used(cache) == NR_ENTRIES * ENTRY_SIZE,
+		"eviction gives referenced entries a second chance");
+
+	key = 0;
+	rcu_read_lock();
+	e = lookup(cache, key);
+	ok(e && !cds_lfht_cache_del(cache, &e->cnode)
+			&& cds_lfht_cache_del(cache, &e->cnode) == -ENOENT
+			&& !lookup(cache, key),
+		"delete an entry once");
+	rcu_read_unlock();
+	rcu_barrier();
+	ok(nr_freed == NR_ENTRIES / 2 + 1
+			&& cds_lfht_cache_used(cache) == (NR_ENTRIES - 1) * ENTRY_SIZE,
+		"deleted entry freed after a grace period");
+
+	for (i = 0; i < 4 * NR_ENTRIES; i++)
+		(void) add(cache, 1000 + i);
+	ok(cds_lfht_cache_used(cache) == NR_ENTRIES * ENTRY_SIZE,
+		"capacity holds under churn");
+	if (cds_lfht_cache_destroy(cache))
+		abort();
+	rcu_barrier();
+	nr_freed = 0;
+
+	test_concurrent();
+
+	rcu_unregister_thread();
+	return exit_status();
+}
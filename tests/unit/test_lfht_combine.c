@@ -0,0 +1,266 @@
+/*
+ * test_lfht_combine.c
+ *
+ * Userspace RCU library - test flat-combining updates of cds_lfht entries
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#include <stdlib.h>
+#include <errno.h>
+#include <poll.h>
+#include <pthread.h>
+#include <urcu.h>
+#include <urcu/rculfhash.h>
+#include <urcu/rculfhash-combine.h>
+
+#include "tap.h"
+
+#define NR_SLOTS	4
+#define NR_WAITERS	3
+#define NR_THREADS	4
+#define NR_UPDATES	5000
+#define NR_KEYS		2
+
+struct test_entry {
+	struct cds_lfht_combine_node cnode;
+	unsigned long key;
+	unsigned long value;
+};
+
+struct test_update {
+	unsigned long add;
+	int block;		/* Wait for the waiters to queue up. */
+};
+
+static unsigned long nr_alloc, nr_freed, nr_waiting;
+static int fail_copy;
+
+static unsigned long test_hash(unsigned long key)
+{
+	return key * 2654435761UL ^ (key << (CAA_BITS_PER_LONG - 8));
+}
+
+static int test_match(struct cds_lfht_node *node, const void *key)
+{
+	struct test_entry *e = caa_container_of(node, struct test_entry,
+			cnode.node);
+
+	return e->key == *(const unsigned long *) key;
+}
+
+static struct cds_lfht_combine_node *copy_entry(
+		struct cds_lfht_combine_node *node, const void *key, void *priv)
+{
+	struct test_entry *e;
+
+	if (fail_copy)
+		return NULL;
+	e = malloc(sizeof(*e));
+	if (!e)
+		abort();
+	if (node) {
+		*e = *caa_container_of(node, struct test_entry, cnode);
+	} else {
+		e->key = *(const unsigned long *) key;
+		e->value = 0;
+	}
+	cds_lfht_node_init(&e->cnode.node);
+	uatomic_inc(&nr_alloc);
+	return &e->cnode;
+}
+
+static void apply_update(struct cds_lfht_combine_node *node, void *arg,
+		void *priv)
+{
+	struct test_entry *e = caa_container_of(node, struct test_entry,
+			cnode);
+	struct test_update *update = arg;
+
+	if (update->block) {
+		while (uatomic_read(&nr_waiting) < NR_WAITERS)
+			(void) poll(NULL, 0, 1);
+		/* Let the waiters publish their request. */
+		(void) poll(NULL, 0, 100);
+	}
+	e->value += update->add;
+}
+
+static void free_entry(struct rcu_head *head)
+{
+	struct test_entry *e = caa_container_of(head, struct test_entry,
+			cnode.rcu_head);
+
+	free(e);
+	uatomic_inc(&nr_freed);
+}
+
+static const struct cds_lfht_combine_ops test_ops = {
+	.copy = copy_entry,
+	.apply = apply_update,
+	.free_node = free_entry,
+};
+
+static struct cds_lfht *ht;
+static struct cds_lfht_combine *comb;
+
+static int upsert(unsigned long key, unsigned long add, int block)
+{
+	struct test_update update = { .add = add, .block = block };
+	int ret;
+
+	rcu_read_lock();
+	ret = cds_lfht_combine_upsert(comb, test_hash(key), test_match, &key,
+			&update);
+	rcu_read_unlock();
+	return ret;
+}
+
+static int update(unsigned long key, unsigned long add)
+{
+	struct test_update update = { .add = add };
+	int ret;
+
+	rcu_read_lock();
+	ret = cds_lfht_combine_update(comb, test_hash(key), test_match, &key,
+			&update);
+	rcu_read_unlock();
+	return ret;
+}
+
+/* Value of key, or 0 if it is not present. */
+static unsigned long value(unsigned long key)
+{
+	struct cds_lfht_iter iter;
+	struct cds_lfht_node *node;
+	unsigned long v = 0;
+
+	rcu_read_lock();
+	cds_lfht_lookup(ht, test_hash(key), test_match, &key, &iter);
+	node = cds_lfht_iter_get_node(&iter);
+	if (node)
+		v = caa_container_of(node, struct test_entry,
+				cnode.node)->value;
+	rcu_read_unlock();
+	return v;
+}
+
+static void *thr_waiter(void *arg)
+{
+	rcu_register_thread();
+	uatomic_inc(&nr_waiting);
+	if (upsert(0, 1, 0))
+		abort();
+	rcu_unregister_thread();
+	return NULL;
+}
+
+static void *thr_updater(void *arg)
+{
+	unsigned long i, id = (unsigned long) arg;
+
+	rcu_register_thread();
+	for (i = 0; i < NR_UPDATES; i++) {
+		if (upsert(NR_KEYS + (i + id) % NR_KEYS, 1, 0))
+			abort();
+		if (i % 64 == 0)
+			(void) poll(NULL, 0, 0);
+	}
+	rcu_unregister_thread();
+	return NULL;
+}
+
+int main(int argc, char **argv)
+{
+	struct cds_lfht_combine_stats before, after;
+	pthread_t tid[NR_THREADS];
+	struct cds_lfht_iter iter;
+	struct cds_lfht_node *node;
+	unsigned long i;
+
+	plan_tests(9);
+
+	rcu_register_thread();
+
+	ht = cds_lfht_new(1, 1, 0, CDS_LFHT_AUTO_RESIZE, NULL);
+	if (!ht)
+		abort();
+	ok(!cds_lfht_combine_new(ht, 3, &test_ops, NULL),
+		"reject a number of slots not a power of two");
+	comb = cds_lfht_combine_new(ht, NR_SLOTS, &test_ops, NULL);
+	if (!comb)
+		abort();
+
+	ok(update(0, 1) == -ENOENT && !value(0),
+		"update of a missing key fails");
+	ok(!upsert(0, 5, 0) && value(0) == 5, "upsert adds a missing key");
+	ok(!update(0, 7) && value(0) == 12, "update of a present key");
+	fail_copy = 1;
+	ok(upsert(0, 1, 0) == -ENOMEM && value(0) == 12,
+		"a failed copy leaves the entry");
+	fail_copy = 0;
+	rcu_barrier();
+	ok(nr_freed == 1, "the replaced entry is freed after a grace period");
+
+	/* Waiters queue up while the main thread combines. */
+	cds_lfht_combine_get_stats(comb, &before);
+	for (i = 0; i < NR_WAITERS; i++) {
+		if (pthread_create(&tid[i], NULL, thr_waiter, NULL))
+			abort();
+	}
+	if (upsert(0, 1, 1))
+		abort();
+	for (i = 0; i < NR_WAITERS; i++) {
+		if (pthread_join(tid[i], NULL))
+			abort();
+	}
+	cds_lfht_combine_get_stats(comb, &after);
+	ok(value(0) == 12 + 1 + NR_WAITERS
+		&& after.requests - before.requests == 1 + NR_WAITERS
+		&& after.publications - before.publications == 2,
+		"waiting updates are combined into one publication");
+
+	for (i = 0; i < NR_THREADS; i++) {
+		if (pthread_create(&tid[i], NULL, thr_updater,
+				(void *) (unsigned long) i))
+			abort();
+	}
+	for (i = 0; i < NR_THREADS; i++) {
+		if (pthread_join(tid[i], NULL))
+			abort();
+	}
+	cds_lfht_combine_get_stats(comb, &after);
+	ok(value(NR_KEYS) + value(NR_KEYS + 1) == NR_THREADS * NR_UPDATES
+		&& after.publications <= after.requests,
+		"concurrent upserts are all applied (%lu requests, %lu publications, %lu batches)",
+		after.requests, after.publications, after.batches);
+
+	cds_lfht_combine_destroy(comb);
+	rcu_read_lock();
+	cds_lfht_for_each(ht, &iter, node) {
+		if (cds_lfht_del(ht, node))
+			abort();
+		call_rcu(&caa_container_of(node, struct test_entry,
+				cnode.node)->cnode.rcu_head, free_entry);
+	}
+	rcu_read_unlock();
+	rcu_barrier();
+	ok(nr_freed == nr_alloc, "every copy is freed once");
+	if (cds_lfht_destroy(ht, NULL))
+		abort();
+
+	rcu_unregister_thread();
+	return exit_status();
+}
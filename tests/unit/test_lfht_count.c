@@ -0,0 +1,91 @@
+/*
+ * test_lfht_count.c
+ *
+ * Userspace RCU library - test cds_lfht node count counters
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#include <stdlib.h>
+#include <errno.h>
+#include <urcu.h>
+#include <urcu/rculfhash.h>
+
+#include "tap.h"
+
+#define NR_NODES	5000
+
+static struct cds_lfht_node nodes[NR_NODES];
+
+static int count_within(struct cds_lfht *ht, long expected)
+{
+	long split, global;
+	unsigned long max_error;
+
+	if (cds_lfht_count_split(ht, &split) || split != expected)
+		return 0;
+	if (cds_lfht_count_global(ht, &global, &max_error))
+		return 0;
+	return labs(global - split) <= (long) max_error;
+}
+
+int main(int argc, char **argv)
+{
+	struct cds_lfht *ht;
+	long count;
+	unsigned long i;
+
+	plan_tests(4);
+
+	rcu_register_thread();
+	ht = cds_lfht_new(1, 1, 0, CDS_LFHT_ACCOUNTING, NULL);
+	if (!ht)
+		abort();
+	ok(count_within(ht, 0), "empty table counts");
+
+	for (i = 0; i < NR_NODES; i++) {
+		cds_lfht_node_init(&nodes[i]);
+		rcu_read_lock();
+		cds_lfht_add(ht, i, &nodes[i]);
+		rcu_read_unlock();
+	}
+	ok(count_within(ht, NR_NODES), "counts after adds");
+
+	for (i = 0; i < NR_NODES / 2; i++) {
+		rcu_read_lock();
+		(void) cds_lfht_del(ht, &nodes[i]);
+		rcu_read_unlock();
+	}
+	ok(count_within(ht, NR_NODES - NR_NODES / 2), "counts after removals");
+
+	rcu_read_lock();
+	for (i = NR_NODES / 2; i < NR_NODES; i++)
+		(void) cds_lfht_del(ht, &nodes[i]);
+	rcu_read_unlock();
+	if (cds_lfht_destroy(ht, NULL))
+		abort();
+
+	ht = cds_lfht_new(1, 1, 0, 0, NULL);
+	if (!ht)
+		abort();
+	ok(cds_lfht_count_split(ht, &count) == -EINVAL
+		&& cds_lfht_count_global(ht, &count, NULL) == -EINVAL,
+		"no counts without accounting");
+	if (cds_lfht_destroy(ht, NULL))
+		abort();
+
+	rcu_unregister_thread();
+	return exit_status();
+}
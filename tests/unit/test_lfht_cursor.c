@@ -0,0 +1,203 @@
+/*
+ * test_lfht_cursor.c
+ *
+ * Userspace RCU library - test cds_lfht traversals resumed by a cursor
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#include <stdlib.h>
+#include <urcu.h>
+#include <urcu/rculfhash.h>
+
+#include "tap.h"
+
+#define NR_NODES	4096
+#define NR_DUP		16
+#define BUDGET		7
+
+struct test_node {
+	unsigned long key;
+	unsigned int visited;
+	struct cds_lfht_node node;
+};
+
+static struct test_node nodes[NR_NODES + NR_DUP];
+
+static unsigned long test_hash(unsigned long key)
+{
+	return key * 2654435761UL;
+}
+
+/*
+ * Traverse the table BUDGET nodes per read-side critical section,
+ * calling between() outside of them. Returns the number of nodes seen
+ * out of reverse hash order.
+ */
+static unsigned long scan(struct cds_lfht *ht,
+		void (*between)(struct cds_lfht *ht, struct test_node *last))
+{
+	struct cds_lfht_cursor cursor;
+	struct cds_lfht_iter iter;
+	struct cds_lfht_node *node;
+	struct test_node *last;
+	unsigned long prev = 0, nr_bad_order = 0, n;
+
+	for (n = 0; n < NR_NODES + NR_DUP; n++)
+		nodes[n].visited = 0;
+	cds_lfht_cursor_init(&cursor);
+	while (!cds_lfht_cursor_done(&cursor)) {
+		rcu_read_lock();
+		n = 0;
+		last = NULL;
+		cds_lfht_for_each_resume(ht, &cursor, &iter, node) {
+			last = caa_container_of(node, struct test_node, node);
+			if (node->reverse_hash < prev)
+				nr_bad_order++;
+			prev = node->reverse_hash;
+			last->visited++;
+			if (++n == BUDGET)
+				break;
+		}
+		cds_lfht_cursor_save(ht, &cursor, &iter);
+		rcu_read_unlock();
+		if (between && last && !cds_lfht_cursor_done(&cursor))
+			between(ht, last);
+	}
+	return nr_bad_order;
+}
+
+static unsigned long nr_visits_not(unsigned int expect, unsigned long nr)
+{
+	unsigned long i, nr_bad = 0;
+
+	for (i = 0; i < nr; i++)
+		if (nodes[i].visited != expect)
+			nr_bad++;
+	return nr_bad;
+}
+
+/* Grow and shrink the table while the scan is released. */
+static void resize_between(struct cds_lfht *ht, struct test_node *last)
+{
+	static unsigned long nr_calls;
+
+	cds_lfht_resize(ht, (nr_calls++ & 1) ? 1 : NR_NODES * 4);
+}
+
+/*
+ * Remove the last node visited, and add it back in the same bucket.
+ * A duplicate is moved once only: the scan restarts the duplicates
+ * each time.
+ */
+static void readd_between(struct cds_lfht *ht, struct test_node *last)
+{
+	static int nr_dup_moves;
+
+	if (last->key == NR_NODES && nr_dup_moves++)
+		return;
+	rcu_read_lock();
+	if (cds_lfht_del(ht, &last->node))
+		abort();
+	rcu_read_unlock();
+	synchronize_rcu();
+	cds_lfht_node_init(&last->node);
+	rcu_read_lock();
+	cds_lfht_add(ht, test_hash(last->key), &last->node);
+	rcu_read_unlock();
+}
+
+int main(int argc, char **argv)
+{
+	struct cds_lfht_cursor cursor;
+	struct cds_lfht_iter iter;
+	struct cds_lfht_node *node;
+	struct cds_lfht *ht;
+	unsigned long i, nr_bad_order;
+
+	plan_tests(7);
+
+	rcu_register_thread();
+	ht = cds_lfht_new(1, 1, 0, CDS_LFHT_AUTO_RESIZE, NULL);
+	if (!ht)
+		abort();
+
+	cds_lfht_cursor_init(&cursor);
+	rcu_read_lock();
+	cds_lfht_cursor_resume(ht, &cursor, &iter);
+	cds_lfht_cursor_save(ht, &cursor, &iter);
+	rcu_read_unlock();
+	ok(cds_lfht_cursor_done(&cursor), "empty table traversal ends");
+
+	rcu_read_lock();
+	for (i = 0; i < NR_NODES; i++) {
+		nodes[i].key = i;
+		cds_lfht_node_init(&nodes[i].node);
+		cds_lfht_add(ht, test_hash(i), &nodes[i].node);
+	}
+	/* Duplicates share a reverse hash, and are resumed within. */
+	for (i = NR_NODES; i < NR_NODES + NR_DUP; i++) {
+		nodes[i].key = NR_NODES;
+		cds_lfht_node_init(&nodes[i].node);
+		cds_lfht_add(ht, test_hash(NR_NODES), &nodes[i].node);
+	}
+	rcu_read_unlock();
+
+	nr_bad_order = scan(ht, NULL);
+	ok(!nr_bad_order && !nr_visits_not(1, NR_NODES + NR_DUP),
+		"each node visited once across critical sections");
+
+	nr_bad_order = scan(ht, resize_between);
+	ok(!nr_bad_order && !nr_visits_not(1, NR_NODES + NR_DUP),
+		"each node visited once across resizes");
+
+	/*
+	 * A node re-added with the same hash may land before or after
+	 * its duplicates: the scan goes on from the first of them, and
+	 * visits some of them again.
+	 */
+	nr_bad_order = scan(ht, readd_between);
+	ok(!nr_visits_not(1, NR_NODES),
+		"nodes removed after their visit are not visited again");
+	for (i = NR_NODES; i < NR_NODES + NR_DUP; i++)
+		if (!nodes[i].visited)
+			break;
+	ok(i == NR_NODES + NR_DUP,
+		"duplicates of a removed node are visited at least once");
+	diag("%lu nodes out of order", nr_bad_order);
+
+	rcu_read_lock();
+	cds_lfht_cursor_resume(ht, &cursor, &iter);
+	ok(!cds_lfht_iter_get_node(&iter), "ended cursor has no next node");
+	rcu_read_unlock();
+
+	cds_lfht_cursor_init(&cursor);
+	rcu_read_lock();
+	cds_lfht_for_each_resume(ht, &cursor, &iter, node)
+		cds_lfht_cursor_save(ht, &cursor, &iter);
+	cds_lfht_cursor_save(ht, &cursor, &iter);
+	rcu_read_unlock();
+	ok(cds_lfht_cursor_done(&cursor), "single section traversal ends");
+
+	rcu_read_lock();
+	cds_lfht_for_each(ht, &iter, node) {
+		(void) cds_lfht_del(ht, node);
+	}
+	rcu_read_unlock();
+	if (cds_lfht_destroy(ht, NULL))
+		abort();
+	rcu_unregister_thread();
+	return exit_status();
+}
@@ -0,0 +1,134 @@
+/*
+ * test_lfht_destroy_async.c
+ *
+ * Userspace RCU library - test cds_lfht_destroy_async
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include <poll.h>
+#include <pthread.h>
+#include <urcu.h>
+#include <urcu/rculfhash.h>
+
+#include "tap.h"
+
+#define NR_NODES	(1UL << 14)
+
+struct test_node {
+	unsigned long key;
+	struct cds_lfht_node node;
+};
+
+struct destroy_state {
+	unsigned long nr_freed;
+	int done;
+	int ret;
+	pthread_attr_t *attr;
+};
+
+static unsigned long test_hash(unsigned long key)
+{
+	return key * 2654435761UL;
+}
+
+static void free_node(struct cds_lfht_node *node, void *priv)
+{
+	struct destroy_state *state = priv;
+
+	free(caa_container_of(node, struct test_node, node));
+	state->nr_freed++;
+}
+
+static void done(int ret, pthread_attr_t *attr, void *priv)
+{
+	struct destroy_state *state = priv;
+
+	state->ret = ret;
+	state->attr = attr;
+	uatomic_set(&state->done, 1);
+}
+
+static struct cds_lfht *create_table(int flags, pthread_attr_t *attr,
+		unsigned long nr_nodes)
+{
+	struct cds_lfht *ht;
+	struct test_node *tn;
+	unsigned long i;
+
+	ht = cds_lfht_new_flavor(1, 1, 0, flags, &rcu_flavor, attr);
+	if (!ht)
+		abort();
+	rcu_read_lock();
+	for (i = 0; i < nr_nodes; i++) {
+		tn = malloc(sizeof(*tn));
+		if (!tn)
+			abort();
+		tn->key = i;
+		cds_lfht_node_init(&tn->node);
+		cds_lfht_add(ht, test_hash(i), &tn->node);
+	}
+	rcu_read_unlock();
+	return ht;
+}
+
+/* Wait for done, up to 10 seconds. */
+static int wait_done(struct destroy_state *state)
+{
+	int i;
+
+	for (i = 0; i < 1000; i++) {
+		if (uatomic_read(&state->done))
+			return 1;
+		(void) poll(NULL, 0, 10);
+	}
+	return 0;
+}
+
+int main(int argc, char **argv)
+{
+	struct destroy_state state = { 0 };
+	pthread_attr_t attr;
+	struct cds_lfht *ht;
+
+	plan_tests(7);
+
+	rcu_register_thread();
+	pthread_attr_init(&attr);
+
+	/* Auto-resize table, grown while filled. */
+	ht = create_table(CDS_LFHT_AUTO_RESIZE, &attr, NR_NODES);
+	ok(cds_lfht_destroy_async(ht, free_node, done, &state) == 0,
+		"destroy_async returns");
+	ok(wait_done(&state), "done callback invoked");
+	ok(state.nr_freed == NR_NODES, "all nodes freed (%lu)",
+		state.nr_freed);
+	ok(state.ret == 0, "table destroyed");
+	ok(state.attr == &attr, "resize attributes passed to done");
+
+	/* Empty table, without free_node callback. */
+	memset(&state, 0, sizeof(state));
+	ht = create_table(0, NULL, 0);
+	ok(cds_lfht_destroy_async(ht, NULL, done, &state) == 0,
+		"destroy_async without free_node");
+	ok(wait_done(&state) && state.ret == 0 && !state.attr,
+		"empty table destroyed");
+
+	pthread_attr_destroy(&attr);
+	rcu_unregister_thread();
+	return exit_status();
+}
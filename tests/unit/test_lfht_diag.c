@@ -0,0 +1,150 @@
+/*
+ * test_lfht_diag.c
+ *
+ * Userspace RCU library - test cds_lfht hash quality diagnostics
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include <urcu.h>
+#include <urcu/rculfhash.h>
+
+#include "tap.h"
+
+#define NR_BUCKETS	1024
+#define NR_NODES	4096
+#define NR_BAD_HASHES	8
+
+static struct cds_lfht_node nodes[NR_NODES];
+
+static unsigned long good_hash(unsigned long key)
+{
+	return key * 2654435761UL;
+}
+
+static unsigned long bad_hash(unsigned long key)
+{
+	return key % NR_BAD_HASHES;
+}
+
+static struct cds_lfht *create_table(unsigned long (*hash)(unsigned long))
+{
+	struct cds_lfht *ht;
+	unsigned long i;
+
+	ht = cds_lfht_new(NR_BUCKETS, NR_BUCKETS, NR_BUCKETS, 0, NULL);
+	if (!ht)
+		abort();
+	rcu_read_lock();
+	for (i = 0; i < NR_NODES; i++) {
+		cds_lfht_node_init(&nodes[i]);
+		cds_lfht_add(ht, hash(i), &nodes[i]);
+	}
+	rcu_read_unlock();
+	return ht;
+}
+
+static void destroy_table(struct cds_lfht *ht)
+{
+	struct cds_lfht_iter iter;
+	struct cds_lfht_node *node;
+
+	rcu_read_lock();
+	cds_lfht_for_each(ht, &iter, node)
+		(void) cds_lfht_del(ht, node);
+	rcu_read_unlock();
+	synchronize_rcu();
+	if (cds_lfht_destroy(ht, NULL))
+		abort();
+}
+
+static unsigned long hist_sum(struct cds_lfht_diag *diag)
+{
+	unsigned long i, sum = 0;
+
+	for (i = 0; i < CDS_LFHT_DIAG_HIST_LEN; i++)
+		sum += diag->chain_len_hist[i];
+	return sum;
+}
+
+int main(int argc, char **argv)
+{
+	struct cds_lfht_diag diag, step_diag;
+	struct cds_lfht *ht;
+	unsigned long next, nr_scans;
+
+	plan_tests(9);
+
+	rcu_register_thread();
+
+	ht = create_table(good_hash);
+	memset(&diag, 0, sizeof(diag));
+	rcu_read_lock();
+	next = cds_lfht_diag_scan(ht, 0, NR_BUCKETS, &diag);
+	rcu_read_unlock();
+	ok(next == 0 && diag.nr_buckets_scanned == NR_BUCKETS
+		&& diag.nr_nodes == NR_NODES,
+		"full scan covers all buckets and nodes");
+	ok(hist_sum(&diag) == NR_BUCKETS
+		&& diag.chain_len_hist[0] == diag.nr_empty_buckets,
+		"histogram covers all buckets");
+	ok(diag.nr_dup_reverse_hash == 0 && diag.nr_removed == 0,
+		"no collision nor removed node with a good hash");
+	ok(diag.nr_empty_buckets < NR_BUCKETS / 8
+		&& diag.max_chain_len < CDS_LFHT_DIAG_HIST_LEN,
+		"good hash fills the buckets (%lu empty, longest chain %lu)",
+		diag.nr_empty_buckets, diag.max_chain_len);
+
+	/* Incremental scan in uneven steps. */
+	memset(&step_diag, 0, sizeof(step_diag));
+	next = 0;
+	nr_scans = 0;
+	do {
+		rcu_read_lock();
+		next = cds_lfht_diag_scan(ht, next, 100, &step_diag);
+		rcu_read_unlock();
+		nr_scans++;
+	} while (next);
+	ok(nr_scans == (NR_BUCKETS + 99) / 100
+		&& !memcmp(&diag, &step_diag, sizeof(diag)),
+		"incremental scan matches full scan");
+
+	rcu_read_lock();
+	next = cds_lfht_diag_scan(ht, NR_BUCKETS, 1, &step_diag);
+	rcu_read_unlock();
+	ok(next == 0 && step_diag.nr_buckets_scanned == NR_BUCKETS,
+		"scan past the last bucket does nothing");
+	destroy_table(ht);
+
+	ht = create_table(bad_hash);
+	memset(&diag, 0, sizeof(diag));
+	rcu_read_lock();
+	(void) cds_lfht_diag_scan(ht, 0, NR_BUCKETS, &diag);
+	rcu_read_unlock();
+	ok(diag.nr_empty_buckets == NR_BUCKETS - NR_BAD_HASHES,
+		"bad hash leaves buckets empty");
+	ok(diag.max_chain_len == NR_NODES / NR_BAD_HASHES
+		&& diag.chain_len_hist[CDS_LFHT_DIAG_HIST_LEN - 1]
+			== NR_BAD_HASHES,
+		"bad hash makes long chains");
+	ok(diag.nr_dup_reverse_hash == NR_NODES - NR_BAD_HASHES,
+		"bad hash collisions counted (%lu)", diag.nr_dup_reverse_hash);
+	destroy_table(ht);
+
+	rcu_unregister_thread();
+	return exit_status();
+}
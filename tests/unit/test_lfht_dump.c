@@ -0,0 +1,292 @@
+/*
+ * test_lfht_dump.c
+ *
+ * Userspace RCU library - test warm-restart dumps of cds_lfht tables
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <urcu.h>
+#include <urcu/rculfhash.h>
+#include <urcu/rculfhash-dump.h>
+
+#include "tap.h"
+
+#define NR_KEYS		10000
+#define LONG_KEY_EVERY	97	/* Records larger than the dump buffer. */
+
+struct test_entry {
+	struct cds_lfht_node node;
+	unsigned long key;
+	size_t name_len;
+	char name[];
+};
+
+static unsigned long nr_restored, nr_disordered, last_reverse_hash;
+static int fail_dump, skip_odd;
+
+static unsigned long test_hash(unsigned long key)
+{
+	return key * 2654435761UL ^ (key << (CAA_BITS_PER_LONG - 8));
+}
+
+static unsigned long bit_reverse(unsigned long v)
+{
+	unsigned long r = 0;
+	int i;
+
+	for (i = 0; i < CAA_BITS_PER_LONG; i++, v >>= 1)
+		r = (r << 1) | (v & 1);
+	return r;
+}
+
+static int test_match(struct cds_lfht_node *node, const void *key)
+{
+	struct test_entry *e = caa_container_of(node, struct test_entry, node);
+
+	return e->key == *(const unsigned long *) key;
+}
+
+static size_t name_len(unsigned long key)
+{
+	return key % LONG_KEY_EVERY ? 1 + key % 13 : 1000 + key % 7;
+}
+
+static struct test_entry *new_entry(unsigned long key, size_t len)
+{
+	struct test_entry *e;
+
+	e = malloc(sizeof(*e) + len);
+	if (!e)
+		abort();
+	cds_lfht_node_init(&e->node);
+	e->key = key;
+	e->name_len = len;
+	return e;
+}
+
+static ssize_t dump_entry(struct cds_lfht_node *node, void *buf, size_t len,
+		void *priv)
+{
+	struct test_entry *e = caa_container_of(node, struct test_entry, node);
+	size_t rec_len = sizeof(e->key) + e->name_len;
+
+	if (fail_dump && e->key == NR_KEYS / 2)
+		return -EIO;
+	if (rec_len > len)
+		return rec_len;
+	memcpy(buf, &e->key, sizeof(e->key));
+	memcpy((char *) buf + sizeof(e->key), e->name, e->name_len);
+	return rec_len;
+}
+
+static struct cds_lfht_node *restore_entry(const void *data, size_t len,
+		unsigned long hash, void *priv)
+{
+	struct test_entry *e;
+	unsigned long key;
+
+	if (bit_reverse(hash) < last_reverse_hash)
+		nr_disordered++;
+	last_reverse_hash = bit_reverse(hash);
+	memcpy(&key, data, sizeof(key));
+	if (skip_odd && key & 1)
+		return NULL;
+	e = new_entry(key, len - sizeof(key));
+	memcpy(e->name, (const char *) data + sizeof(key), e->name_len);
+	nr_restored++;
+	return &e->node;
+}
+
+static struct cds_lfht *restore(const char *path)
+{
+	nr_restored = nr_disordered = last_reverse_hash = 0;
+	return cds_lfht_restore(path, restore_entry, NULL, NULL);
+}
+
+static unsigned long count_nodes(struct cds_lfht *ht)
+{
+	long before, after;
+	unsigned long count;
+
+	rcu_read_lock();
+	cds_lfht_count_nodes(ht, &before, &count, &after);
+	rcu_read_unlock();
+	return count;
+}
+
+struct table_info {
+	struct cds_lfht *ht;
+	struct cds_lfht_info info;
+};
+
+static void get_info(struct cds_lfht *ht, const struct cds_lfht_info *info,
+		void *priv)
+{
+	struct table_info *found = priv;
+
+	if (ht == found->ht)
+		found->info = *info;
+}
+
+static struct cds_lfht_info table_info(struct cds_lfht *ht)
+{
+	struct table_info found = { .ht = ht };
+
+	cds_lfht_for_each_table(get_info, &found);
+	return found.info;
+}
+
+static int check_entries(struct cds_lfht *ht, unsigned long step)
+{
+	struct cds_lfht_iter iter;
+	struct cds_lfht_node *node;
+	struct test_entry *e;
+	unsigned long key;
+	size_t i;
+	int ret = 1;
+
+	rcu_read_lock();
+	for (key = 0; key < NR_KEYS; key += step) {
+		cds_lfht_lookup(ht, test_hash(key), test_match, &key, &iter);
+		node = cds_lfht_iter_get_node(&iter);
+		if (!node) {
+			ret = 0;
+			break;
+		}
+		e = caa_container_of(node, struct test_entry, node);
+		if (e->name_len != name_len(key))
+			ret = 0;
+		for (i = 0; i < e->name_len; i++) {
+			if (e->name[i] != (char) (key + i))
+				ret = 0;
+		}
+	}
+	rcu_read_unlock();
+	return ret;
+}
+
+static void destroy(struct cds_lfht *ht)
+{
+	struct cds_lfht_iter iter;
+	struct cds_lfht_node *node;
+
+	rcu_read_lock();
+	cds_lfht_for_each(ht, &iter, node) {
+		if (!cds_lfht_del(ht, node))
+			free(caa_container_of(node, struct test_entry, node));
+	}
+	rcu_read_unlock();
+	if (cds_lfht_destroy(ht, NULL))
+		abort();
+}
+
+int main(int argc, char **argv)
+{
+	char path[] = "/tmp/test_lfht_dump.XXXXXX";
+	struct cds_lfht *ht, *restored;
+	struct test_entry *e;
+	unsigned long key;
+	size_t i;
+	FILE *f;
+	long ret;
+	int fd;
+
+	plan_tests(14);
+
+	fd = mkstemp(path);
+	if (fd < 0)
+		abort();
+	(void) close(fd);
+	rcu_register_thread();
+
+	ht = cds_lfht_new(1024, 1, 0, CDS_LFHT_ACCOUNTING, NULL);
+	rcu_read_lock();
+	for (key = 0; key < NR_KEYS; key++) {
+		e = new_entry(key, name_len(key));
+		for (i = 0; i < e->name_len; i++)
+			e->name[i] = (char) (key + i);
+		cds_lfht_add(ht, test_hash(key), &e->node);
+	}
+	rcu_read_unlock();
+	cds_lfht_resize(ht, 8192);
+
+	ret = cds_lfht_dump(ht, path, dump_entry, NULL);
+	ok(ret == NR_KEYS, "dump writes all nodes (%ld)", ret);
+
+	restored = restore(path);
+	ok(restored != NULL, "restore");
+	ok(nr_restored == NR_KEYS && count_nodes(restored) == NR_KEYS,
+		"restore adds all nodes");
+	ok(!nr_disordered, "records come in reverse hash order");
+	ok(table_info(restored).size == 8192
+			&& table_info(restored).flags == CDS_LFHT_ACCOUNTING,
+		"restored table has the buckets and flags of the dumped one");
+	ok(check_entries(restored, 1), "restored nodes hold their records");
+	destroy(restored);
+
+	skip_odd = 1;
+	restored = restore(path);
+	skip_odd = 0;
+	ok(restored && count_nodes(restored) == NR_KEYS / 2
+			&& check_entries(restored, 2),
+		"restore skips the records without node");
+	destroy(restored);
+
+	if (truncate(path, 4096))
+		abort();
+	restored = restore(path);
+	ok(!restored && errno == EINVAL && !nr_restored,
+		"truncated dump is rejected before restoring nodes");
+
+	fail_dump = 1;
+	ret = cds_lfht_dump(ht, path, dump_entry, NULL);
+	fail_dump = 0;
+	ok(ret == -EIO, "dump fails with the error of the dump function");
+	restored = restore(path);
+	ok(!restored && errno == EINVAL && !nr_restored,
+		"incomplete dump is rejected");
+
+	f = fopen(path, "w");
+	if (!f || fputs("not a dump", f) == EOF || fclose(f))
+		abort();
+	restored = restore(path);
+	ok(!restored && errno == EINVAL, "invalid dump is rejected");
+
+	destroy(ht);
+	ht = cds_lfht_new(1, 1, 0, 0, NULL);
+	ret = cds_lfht_dump(ht, path, dump_entry, NULL);
+	restored = restore(path);
+	ok(!ret && restored && !count_nodes(restored),
+		"empty table dump and restore");
+	destroy(restored);
+	destroy(ht);
+
+	(void) unlink(path);
+	restored = restore(path);
+	ok(!restored && errno == ENOENT, "missing dump");
+	ht = cds_lfht_new(1, 1, 0, 0, NULL);
+	ok(cds_lfht_dump(ht, "/nonexistent/dump", dump_entry, NULL) == -ENOENT,
+		"dump to an invalid path fails");
+	destroy(ht);
+
+	rcu_unregister_thread();
+	return exit_status();
+}
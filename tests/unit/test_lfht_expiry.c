@@ -0,0 +1,211 @@
+/*
+ * test_lfht_expiry.c
+ *
+ * Userspace RCU library - test timer wheel expiring cds_lfht entries
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#include <stdlib.h>
+#include <errno.h>
+#include <urcu.h>
+#include <urcu/rculfhash-expiry.h>
+
+#include "tap.h"
+
+#define NR_ENTRIES	256
+#define NR_SHARDS	4
+
+struct test_entry {
+	struct cds_lfht_expiry_node enode;
+	unsigned long key;
+};
+
+static unsigned long nr_freed;
+
+static unsigned long test_hash(unsigned long key)
+{
+	return key * 2654435761UL ^ (key << (CAA_BITS_PER_LONG - 8));
+}
+
+static void free_entry(struct rcu_head *head)
+{
+	struct test_entry *e = caa_container_of(head, struct test_entry,
+			enode.rcu_head);
+
+	free(e);
+	uatomic_inc(&nr_freed);
+}
+
+static struct test_entry *add(struct cds_lfht *ht, unsigned long key)
+{
+	struct test_entry *e = malloc(sizeof(*e));
+
+	if (!e)
+		abort();
+	e->key = key;
+	cds_lfht_node_init(&e->enode.node);
+	cds_lfht_expiry_node_init(&e->enode);
+	rcu_read_lock();
+	cds_lfht_add(ht, test_hash(key), &e->enode.node);
+	rcu_read_unlock();
+	return e;
+}
+
+static unsigned long count(struct cds_lfht *ht)
+{
+	long before, after;
+	unsigned long nr;
+
+	rcu_read_lock();
+	cds_lfht_count_nodes(ht, &before, &nr, &after);
+	rcu_read_unlock();
+	return nr;
+}
+
+static int arm(struct cds_lfht_expiry *exp, struct test_entry *e,
+		uint64_t deadline)
+{
+	int ret;
+
+	rcu_read_lock();
+	ret = cds_lfht_expiry_arm(exp, &e->enode, deadline);
+	rcu_read_unlock();
+	return ret;
+}
+
+static unsigned long advance(struct cds_lfht_expiry *exp, uint64_t now)
+{
+	unsigned long nr;
+
+	rcu_read_lock();
+	nr = cds_lfht_expiry_advance(exp, now);
+	rcu_read_unlock();
+	return nr;
+}
+
+/* Advance one tick at a time, checking nothing expires too early. */
+static int advance_each(struct cds_lfht_expiry *exp, uint64_t from,
+		uint64_t to, uint64_t first, unsigned long nr)
+{
+	unsigned long total = 0, expired;
+	uint64_t now;
+
+	for (now = from; now <= to; now++) {
+		expired = advance(exp, now);
+		if (expired && now < first)
+			return 0;
+		total += expired;
+	}
+	return total == nr;
+}
+
+int main(int argc, char **argv)
+{
+	struct cds_lfht_expiry *exp;
+	struct test_entry *e[NR_ENTRIES];
+	struct cds_lfht *ht;
+	unsigned long i, nr_ok;
+
+	plan_tests(10);
+
+	rcu_register_thread();
+
+	ht = cds_lfht_new(1, 1, 0, CDS_LFHT_AUTO_RESIZE, NULL);
+	if (!ht)
+		abort();
+	ok(!cds_lfht_expiry_new(ht, 3, 0, free_entry),
+		"reject a number of shards not a power of two");
+	exp = cds_lfht_expiry_new(ht, NR_SHARDS, 0, free_entry);
+	if (!exp)
+		abort();
+
+	/* Deadlines 1..NR_ENTRIES, each expiring on its own tick. */
+	for (i = 0; i < NR_ENTRIES; i++) {
+		e[i] = add(ht, i);
+		if (arm(exp, e[i], i + 1))
+			abort();
+	}
+	nr_ok = 0;
+	for (i = 1; i <= NR_ENTRIES; i++)
+		nr_ok += advance(exp, i) == 1
+			&& count(ht) == NR_ENTRIES - i;
+	ok(nr_ok == NR_ENTRIES, "entries expire on their deadline tick");
+	rcu_barrier();
+	ok(nr_freed == NR_ENTRIES, "expired entries freed after a grace period");
+
+	/* Re-arm and disarm. */
+	e[0] = add(ht, 0);
+	e[1] = add(ht, 1);
+	e[2] = add(ht, 2);
+	(void) arm(exp, e[0], 300);
+	(void) arm(exp, e[0], 2000);
+	(void) arm(exp, e[1], 300);
+	rcu_read_lock();
+	nr_ok = !cds_lfht_expiry_disarm(exp, &e[1]->enode)
+		&& cds_lfht_expiry_disarm(exp, &e[1]->enode) == -ENOENT
+		&& cds_lfht_expiry_disarm(exp, &e[2]->enode) == -ENOENT;
+	rcu_read_unlock();
+	ok(nr_ok && advance_each(exp, NR_ENTRIES + 1, 1999, 2000, 0)
+			&& count(ht) == 3,
+		"re-armed and disarmed entries do not expire");
+	ok(advance(exp, 2000) == 1 && count(ht) == 2,
+		"re-armed entry expires on its new deadline");
+
+	/* Delete before expiry. */
+	(void) arm(exp, e[1], 2100);
+	rcu_read_lock();
+	nr_ok = !cds_lfht_expiry_del(exp, &e[1]->enode)
+		&& cds_lfht_expiry_del(exp, &e[1]->enode) == -ENOENT
+		&& !cds_lfht_expiry_del(exp, &e[2]->enode);
+	rcu_read_unlock();
+	ok(nr_ok && advance(exp, 2200) == 0 && count(ht) == 0,
+		"deleted entries are deleted once and do not expire");
+	rcu_barrier();
+	ok(nr_freed == NR_ENTRIES + 3, "deleted entries freed");
+
+	/* Far deadlines cascade down the levels of the wheel. */
+	for (i = 0; i < 8; i++) {
+		e[i] = add(ht, i);
+		(void) arm(exp, e[i], 2200 + (64ULL << (6 * (i % 4))) + i);
+	}
+	ok(advance_each(exp, 2201, 2200 + 64, 2200 + 64, 1)
+			&& advance_each(exp, 2200 + 65, 2200 + 64 * 64 + 1,
+				2200 + 68, 2)
+			&& advance_each(exp, 2200 + 64 * 64 + 2,
+				2200 + (1ULL << 18) + 2, 2200 + 64 * 64 + 5, 2),
+		"far deadlines expire on time");
+
+	/* A jump past the span of the wheel expires what is due only. */
+	(void) arm(exp, e[7], 1ULL << 40);
+	ok(advance(exp, (1ULL << 30)) == 2 && count(ht) == 1
+			&& advance(exp, (1ULL << 40) - 1) == 0
+			&& advance(exp, 1ULL << 40) == 1,
+		"time jumps expire due entries");
+
+	/* Passed deadlines expire on the next advance. */
+	e[0] = add(ht, 0);
+	(void) arm(exp, e[0], 5);
+	ok(advance(exp, (1ULL << 40) + 1) == 1 && count(ht) == 0,
+		"passed deadline expires on the next advance");
+
+	cds_lfht_expiry_destroy(exp);
+	rcu_barrier();
+	if (cds_lfht_destroy(ht, NULL))
+		abort();
+
+	rcu_unregister_thread();
+	return exit_status();
+}
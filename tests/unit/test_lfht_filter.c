@@ -0,0 +1,231 @@
+/*
+ * test_lfht_filter.c
+ *
+ * Userspace RCU library - test Bloom filter front for cds_lfht lookups
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#include <stdlib.h>
+#include <errno.h>
+#include <poll.h>
+#include <pthread.h>
+#include <urcu.h>
+#include <urcu/rculfhash-filter.h>
+
+#include "tap.h"
+
+#define NR_KEYS		4096
+#define NR_ABSENT	100000
+#define NR_STABLE	256
+#define NR_UPDATES	100000
+
+struct test_entry {
+	struct cds_lfht_node node;
+	struct rcu_head rcu_head;
+	unsigned long key;
+};
+
+static struct test_entry *entries[2 * NR_KEYS];
+static int stop_reader;
+static unsigned long nr_runs, nr_missed;
+
+static int test_match(struct cds_lfht_node *node, const void *key)
+{
+	struct test_entry *e = caa_container_of(node, struct test_entry, node);
+
+	return e->key == *(const unsigned long *) key;
+}
+
+static void free_entry(struct rcu_head *head)
+{
+	free(caa_container_of(head, struct test_entry, rcu_head));
+}
+
+static void add(struct cds_lfht_filter *filter, unsigned long key)
+{
+	struct test_entry *e = malloc(sizeof(*e));
+
+	if (!e)
+		abort();
+	e->key = key;
+	cds_lfht_node_init(&e->node);
+	rcu_read_lock();
+	cds_lfht_filter_add(filter, key, &e->node);
+	rcu_read_unlock();
+	entries[key] = e;
+}
+
+static void del(struct cds_lfht_filter *filter, unsigned long key)
+{
+	rcu_read_lock();
+	if (cds_lfht_filter_del(filter, &entries[key]->node))
+		abort();
+	rcu_read_unlock();
+	call_rcu(&entries[key]->rcu_head, free_entry);
+	entries[key] = NULL;
+}
+
+static int found(struct cds_lfht_filter *filter, unsigned long key)
+{
+	struct cds_lfht_iter iter;
+	int ret;
+
+	rcu_read_lock();
+	cds_lfht_filter_lookup(filter, key, test_match, &key, &iter);
+	ret = cds_lfht_iter_get_node(&iter) != NULL;
+	rcu_read_unlock();
+	return ret;
+}
+
+/* Number of keys in [from, to[ the filter may contain. */
+static unsigned long nr_contained(struct cds_lfht_filter *filter,
+		unsigned long from, unsigned long to)
+{
+	unsigned long key, nr = 0;
+
+	rcu_read_lock();
+	for (key = from; key < to; key++)
+		nr += cds_lfht_filter_may_contain(filter, key);
+	rcu_read_unlock();
+	return nr;
+}
+
+static unsigned long capacity(struct cds_lfht_filter *filter)
+{
+	unsigned long ret;
+
+	rcu_read_lock();
+	ret = cds_lfht_filter_capacity(filter);
+	rcu_read_unlock();
+	return ret;
+}
+
+static void *thr_reader(void *arg)
+{
+	struct cds_lfht_filter *filter = arg;
+	unsigned long key = 0;
+
+	rcu_register_thread();
+	while (!uatomic_read(&stop_reader)) {
+		if (!found(filter, key))
+			uatomic_inc(&nr_missed);
+		key = (key + 1) % NR_STABLE;
+		uatomic_inc(&nr_runs);
+	}
+	rcu_unregister_thread();
+	return NULL;
+}
+
+/* Stable keys stay found while the filter is rebuilt. */
+static void test_concurrent(struct cds_lfht *ht)
+{
+	struct cds_lfht_filter *filter;
+	pthread_t tid;
+	unsigned long i, key;
+
+	filter = cds_lfht_filter_new(ht, NR_STABLE);
+	if (!filter)
+		abort();
+	for (key = 0; key < NR_STABLE; key++)
+		add(filter, key);
+	if (pthread_create(&tid, NULL, thr_reader, filter))
+		abort();
+	while (uatomic_read(&nr_runs) < NR_STABLE)
+		(void) poll(NULL, 0, 1);
+	for (i = 0; i < NR_UPDATES; i++) {
+		key = NR_STABLE + i % (NR_KEYS - NR_STABLE);
+		if (entries[key])
+			del(filter, key);
+		else
+			add(filter, key);
+		if (i % 256 == 0)
+			(void) poll(NULL, 0, 0);
+	}
+	uatomic_set(&stop_reader, 1);
+	if (pthread_join(tid, NULL))
+		abort();
+	ok(!nr_missed, "keys found while the filter is rebuilt (%lu lookups)",
+		nr_runs);
+	for (key = 0; key < NR_KEYS; key++) {
+		if (entries[key])
+			del(filter, key);
+	}
+	rcu_barrier();
+	cds_lfht_filter_destroy(filter);
+}
+
+int main(int argc, char **argv)
+{
+	struct cds_lfht_filter *filter;
+	struct cds_lfht *ht;
+	unsigned long key, nr_found = 0, initial;
+
+	plan_tests(8);
+
+	rcu_register_thread();
+
+	ht = cds_lfht_new(1, 1, 0, CDS_LFHT_AUTO_RESIZE, NULL);
+	if (!ht)
+		abort();
+	filter = cds_lfht_filter_new(ht, NR_KEYS);
+	if (!filter)
+		abort();
+	initial = capacity(filter);
+
+	for (key = 0; key < NR_KEYS; key++)
+		add(filter, key);
+	ok(nr_contained(filter, 0, NR_KEYS) == NR_KEYS,
+		"filter contains all added keys");
+	ok(nr_contained(filter, NR_KEYS, NR_KEYS + NR_ABSENT) < NR_ABSENT / 100,
+		"filter rejects most absent keys");
+	for (key = 0; key < 2 * NR_KEYS; key++)
+		nr_found += found(filter, key);
+	ok(nr_found == NR_KEYS, "filtered lookups find the added keys only");
+
+	/* Deletions rebuild the filter without the deleted keys. */
+	for (key = NR_KEYS / 2; key < NR_KEYS; key++)
+		del(filter, key);
+	rcu_barrier();
+	ok(nr_contained(filter, 0, NR_KEYS / 2) == NR_KEYS / 2,
+		"rebuilt filter contains the remaining keys");
+	ok(nr_contained(filter, NR_KEYS / 2, NR_KEYS) < NR_KEYS / 100,
+		"rebuilt filter rejects most deleted keys");
+	ok(capacity(filter) == initial, "rebuild keeps the capacity");
+
+	/* Growth past the capacity. */
+	for (key = NR_KEYS / 2; key < NR_KEYS; key++)
+		add(filter, key);
+	for (key = 0; key < NR_KEYS; key++)
+		add(filter, NR_KEYS + key);
+	rcu_barrier();
+	ok(capacity(filter) > initial
+			&& nr_contained(filter, 0, 2 * NR_KEYS) == 2 * NR_KEYS,
+		"filter grows with the table");
+	for (key = 0; key < NR_KEYS; key++) {
+		del(filter, key);
+		del(filter, NR_KEYS + key);
+	}
+	rcu_barrier();
+	cds_lfht_filter_destroy(filter);
+
+	test_concurrent(ht);
+
+	if (cds_lfht_destroy(ht, NULL))
+		abort();
+
+	rcu_unregister_thread();
+	return exit_status();
+}
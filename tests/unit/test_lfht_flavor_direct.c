@@ -0,0 +1,111 @@
+/*
+ * test_lfht_flavor_direct.c
+ *
+ * Userspace RCU library - test the flavor-specialized hash table build
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#include <stdlib.h>
+#include <urcu-qsbr.h>
+#include <urcu/rculfhash.h>
+
+#include "tap.h"
+
+#define NR_NODES	(1UL << 15)
+
+/* Declared by urcu/urcu-memb.h, whose names clash with those of qsbr. */
+extern const struct rcu_flavor_struct urcu_memb_flavor;
+
+struct test_node {
+	unsigned long key;
+	struct cds_lfht_node node;
+};
+
+static struct test_node nodes[NR_NODES];
+
+static unsigned long test_hash(unsigned long key)
+{
+	return key * 2654435761UL;
+}
+
+static int test_match(struct cds_lfht_node *node, const void *key)
+{
+	return caa_container_of(node, struct test_node, node)->key
+		== *(const unsigned long *) key;
+}
+
+static unsigned long nr_missing(struct cds_lfht *ht)
+{
+	struct cds_lfht_iter iter;
+	unsigned long i, nr = 0;
+
+	rcu_read_lock();
+	for (i = 0; i < NR_NODES; i++) {
+		cds_lfht_lookup(ht, test_hash(i), test_match, &i, &iter);
+		if (cds_lfht_iter_get_node(&iter) != &nodes[i].node)
+			nr++;
+	}
+	rcu_read_unlock();
+	return nr;
+}
+
+int main(int argc, char **argv)
+{
+	struct cds_lfht_iter iter;
+	struct cds_lfht_node *node;
+	struct cds_lfht *ht;
+	unsigned long i;
+	long before, after;
+	unsigned long count;
+
+	plan_tests(5);
+
+	rcu_register_thread();
+
+	ht = cds_lfht_new_flavor(1, 1, 0, 0, &urcu_memb_flavor, NULL);
+	ok(!ht, "tables of another flavor are refused");
+
+	ht = cds_lfht_new(1, 1, 0, CDS_LFHT_AUTO_RESIZE, NULL);
+	if (!ht)
+		abort();
+	rcu_read_lock();
+	for (i = 0; i < NR_NODES; i++) {
+		nodes[i].key = i;
+		cds_lfht_node_init(&nodes[i].node);
+		cds_lfht_add(ht, test_hash(i), &nodes[i].node);
+	}
+	rcu_read_unlock();
+	ok(!nr_missing(ht), "nodes found");
+
+	/* Large enough to partition the resize among the pool threads. */
+	cds_lfht_resize(ht, NR_NODES * 4);
+	ok(!nr_missing(ht), "nodes found after growing");
+	cds_lfht_resize(ht, 1);
+	rcu_read_lock();
+	cds_lfht_count_nodes(ht, &before, &count, &after);
+	rcu_read_unlock();
+	ok(!nr_missing(ht) && count == NR_NODES, "nodes found after shrinking");
+
+	rcu_read_lock();
+	cds_lfht_for_each(ht, &iter, node) {
+		(void) cds_lfht_del(ht, node);
+	}
+	rcu_read_unlock();
+	ok(!cds_lfht_destroy(ht, NULL), "destroy");
+
+	rcu_unregister_thread();
+	return exit_status();
+}
@@ -0,0 +1,103 @@
+/*
+ * test_lfht_for_each_parallel.c
+ *
+ * Userspace RCU library - test cds_lfht_for_each_parallel
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#include <stdlib.h>
+#include <urcu.h>
+#include <urcu/rculfhash.h>
+
+#include "tap.h"
+
+#define NR_NODES	(1UL << 16)
+
+struct test_node {
+	unsigned long key;
+	unsigned long visited;
+	struct cds_lfht_node node;
+};
+
+static struct test_node nodes[NR_NODES];
+static unsigned long nr_visits;
+
+static unsigned long test_hash(unsigned long key)
+{
+	return key * 2654435761UL;
+}
+
+static void visit(struct cds_lfht *ht, struct cds_lfht_node *node, void *arg)
+{
+	struct test_node *tn = caa_container_of(node, struct test_node, node);
+
+	uatomic_inc(&tn->visited);
+	uatomic_inc((unsigned long *) arg);
+}
+
+static unsigned long check_visited(unsigned long expected)
+{
+	unsigned long i, nr_bad = 0;
+
+	for (i = 0; i < NR_NODES; i++) {
+		if (nodes[i].visited != expected)
+			nr_bad++;
+	}
+	return nr_bad;
+}
+
+int main(int argc, char **argv)
+{
+	struct cds_lfht *ht;
+	struct cds_lfht_iter iter;
+	struct cds_lfht_node *node;
+	unsigned long i;
+
+	plan_tests(4);
+
+	rcu_register_thread();
+	ht = cds_lfht_new(NR_NODES, 1, 0, CDS_LFHT_AUTO_RESIZE, NULL);
+	if (!ht)
+		abort();
+
+	rcu_read_lock();
+	for (i = 0; i < NR_NODES; i++) {
+		nodes[i].key = i;
+		cds_lfht_node_init(&nodes[i].node);
+		cds_lfht_add(ht, test_hash(i), &nodes[i].node);
+	}
+	rcu_read_unlock();
+
+	cds_lfht_for_each_parallel(ht, 4, visit, &nr_visits);
+	ok(nr_visits == NR_NODES, "4 threads: all nodes visited");
+	ok(check_visited(1) == 0, "4 threads: each node visited once");
+
+	/* Default thread count. */
+	nr_visits = 0;
+	cds_lfht_for_each_parallel(ht, 0, visit, &nr_visits);
+	ok(nr_visits == NR_NODES, "default threads: all nodes visited");
+	ok(check_visited(2) == 0, "default threads: each node visited once");
+
+	rcu_read_lock();
+	cds_lfht_for_each(ht, &iter, node) {
+		(void) cds_lfht_del(ht, node);
+	}
+	rcu_read_unlock();
+	if (cds_lfht_destroy(ht, NULL))
+		abort();
+	rcu_unregister_thread();
+	return exit_status();
+}
@@ -0,0 +1,189 @@
+/*
+ * test_lfht_intern.c
+ *
+ * Userspace RCU library - test string interning on top of cds_lfht
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+#include <pthread.h>
+#include <urcu.h>
+#include <urcu/rculfhash-intern.h>
+
+#include "tap.h"
+
+#define NR_STRINGS	20000
+#define LONG_LEN	(CDS_LFHT_INTERN_ARENA_LEN / 2)
+#define NR_THREADS	4
+#define NR_KEYS		64
+#define NR_ROUNDS	20000
+
+static struct cds_lfht_intern *intern;
+static unsigned long nr_mismatch;
+
+static size_t key_str(char *buf, size_t len, unsigned long key)
+{
+	return snprintf(buf, len, "metric.%lu.name", key);
+}
+
+static void *thr_intern(void *arg)
+{
+	unsigned int seed = (unsigned int) (unsigned long) arg;
+	struct cds_lfht_intern_str *s, *found;
+	unsigned long i, mismatch = 0;
+	char buf[64];
+	size_t len;
+
+	rcu_register_thread();
+	for (i = 0; i < NR_ROUNDS; i++) {
+		len = key_str(buf, sizeof(buf), rand_r(&seed) % NR_KEYS);
+		s = cds_lfht_intern(intern, buf, len);
+		if (!s)
+			abort();
+		if (cds_lfht_intern_len(s) != len
+				|| strcmp(cds_lfht_intern_str(s), buf))
+			mismatch++;
+		/* While a handle is held, it is the only copy. */
+		found = cds_lfht_intern_find(intern, buf, len);
+		if (found != s)
+			mismatch++;
+		if (found)
+			cds_lfht_intern_put(found);
+		cds_lfht_intern_put(s);
+	}
+	rcu_unregister_thread();
+	uatomic_add(&nr_mismatch, mismatch);
+	return NULL;
+}
+
+/* Wait for the reclamation of the released strings and arenas. */
+static void reclaim(void)
+{
+	rcu_barrier();
+	rcu_barrier();
+}
+
+int main(int argc, char **argv)
+{
+	static struct cds_lfht_intern_str *handles[NR_STRINGS];
+	struct cds_lfht_intern_str *a, *b, *c, *d, *l;
+	struct cds_lfht_intern_stats stats;
+	pthread_t tid[NR_THREADS];
+	char buf[64], *long_str;
+	unsigned long i, nr_bad = 0;
+	size_t len;
+
+	plan_tests(15);
+
+	rcu_register_thread();
+	intern = cds_lfht_intern_create(64);
+	ok(intern != NULL, "create");
+
+	a = cds_lfht_intern(intern, "foo", 3);
+	b = cds_lfht_intern(intern, "foo", 3);
+	ok(a && a == b && cds_lfht_intern_len(a) == 3
+			&& !strcmp(cds_lfht_intern_str(a), "foo"),
+		"equal strings share a handle");
+	c = cds_lfht_intern(intern, "a\0b", 3);
+	d = cds_lfht_intern(intern, "a", 1);
+	ok(c && d && c != d && c != a && !memcmp(cds_lfht_intern_str(c),
+			"a\0b", 4),
+		"strings differing by length or embedded NUL are distinct");
+	ok(cds_lfht_intern_find(intern, "foo", 3) == a
+			&& !cds_lfht_intern_find(intern, "bar", 3),
+		"find takes a reference on present strings only");
+	cds_lfht_intern_put(a);
+	ok(cds_lfht_intern_destroy(intern) == -EBUSY,
+		"destroy fails while handles are held");
+
+	cds_lfht_intern_put(a);
+	cds_lfht_intern_put(b);
+	ok(cds_lfht_intern_find(intern, "foo", 3) == NULL,
+		"last release removes the string");
+	a = cds_lfht_intern(intern, "foo", 3);
+	ok(a && !strcmp(cds_lfht_intern_str(a), "foo"),
+		"released string is interned again");
+	cds_lfht_intern_put(a);
+	cds_lfht_intern_put(c);
+	cds_lfht_intern_put(d);
+
+	for (i = 0; i < NR_STRINGS; i++) {
+		len = key_str(buf, sizeof(buf), i);
+		handles[i] = cds_lfht_intern(intern, buf, len);
+		if (!handles[i])
+			abort();
+	}
+	for (i = 0; i < NR_STRINGS; i++) {
+		len = key_str(buf, sizeof(buf), i);
+		if (cds_lfht_intern_len(handles[i]) != len
+				|| strcmp(cds_lfht_intern_str(handles[i]), buf))
+			nr_bad++;
+	}
+	cds_lfht_intern_get_stats(intern, &stats);
+	ok(!nr_bad && stats.nr_strings == NR_STRINGS,
+		"many strings interned (%lu)", stats.nr_strings);
+	ok(stats.nr_arenas > 1 && stats.arena_bytes < NR_STRINGS * 128
+			&& stats.nr_arenas <= stats.arena_bytes
+				/ CDS_LFHT_INTERN_ARENA_LEN + 1,
+		"strings are packed in arenas (%lu arenas, %zu bytes)",
+		stats.nr_arenas, stats.arena_bytes);
+
+	long_str = malloc(LONG_LEN);
+	if (!long_str)
+		abort();
+	memset(long_str, 'x', LONG_LEN);
+	l = cds_lfht_intern(intern, long_str, LONG_LEN);
+	ok(l && cds_lfht_intern_len(l) == LONG_LEN
+			&& !memcmp(cds_lfht_intern_str(l), long_str, LONG_LEN)
+			&& cds_lfht_intern(intern, long_str, LONG_LEN) == l,
+		"long string");
+	cds_lfht_intern_put(l);
+	cds_lfht_intern_put(l);
+
+	for (i = 0; i < NR_STRINGS; i++)
+		cds_lfht_intern_put(handles[i]);
+	reclaim();
+	cds_lfht_intern_get_stats(intern, &stats);
+	ok(!stats.nr_strings && stats.nr_arenas == 1,
+		"released strings and their arenas are reclaimed (%lu arenas)",
+		stats.nr_arenas);
+
+	for (i = 0; i < NR_THREADS; i++) {
+		if (pthread_create(&tid[i], NULL, thr_intern,
+				(void *) (i + 1)))
+			abort();
+	}
+	for (i = 0; i < NR_THREADS; i++) {
+		if (pthread_join(tid[i], NULL))
+			abort();
+	}
+	ok(!nr_mismatch, "concurrent interning keeps one copy per string");
+	cds_lfht_intern_get_stats(intern, &stats);
+	ok(!stats.nr_strings, "concurrent releases remove all strings");
+
+	a = cds_lfht_intern(intern, "foo", 3);
+	cds_lfht_intern_put(a);
+	ok(a && !cds_lfht_intern_find(intern, "foo", 3),
+		"interning after concurrent use");
+	ok(!cds_lfht_intern_destroy(intern), "destroy");
+	free(long_str);
+
+	rcu_unregister_thread();
+	return exit_status();
+}
@@ -0,0 +1,131 @@
+/*
+ * test_lfht_lookup_batch.c
+ *
+ * Userspace RCU library - test cds_lfht_lookup_batch against
+ * cds_lfht_lookup
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#include <stdlib.h>
+#include <urcu.h>
+#include <urcu/rculfhash.h>
+
+#include "tap.h"
+
+#define NR_NODES	1000
+/* Not a multiple of the batch size, half of the keys are absent. */
+#define NR_LOOKUPS	(2 * NR_NODES + 7)
+
+struct test_node {
+	unsigned long key;
+	struct cds_lfht_node node;
+};
+
+static struct test_node nodes[NR_NODES];
+
+/* Few distinct hashes, so that chains hold several keys. */
+static unsigned long test_hash(unsigned long key)
+{
+	return key % 97;
+}
+
+/* Hashes using all bits, for the reversal of whole batches. */
+static unsigned long test_hash_wide(unsigned long key)
+{
+	return (key + 1) * 0x9e3779b97f4a7c15ULL;
+}
+
+static int test_match(struct cds_lfht_node *node, const void *key)
+{
+	return caa_container_of(node, struct test_node, node)->key
+		== *(const unsigned long *) key;
+}
+
+int main(int argc, char **argv)
+{
+	static unsigned long keys[NR_LOOKUPS], hashes[NR_LOOKUPS];
+	static const void *key_ptrs[NR_LOOKUPS];
+	static struct cds_lfht_iter iters[NR_LOOKUPS];
+	struct cds_lfht *ht;
+	unsigned long i, nr_found = 0, nr_mismatch = 0;
+
+	plan_tests(4);
+
+	rcu_register_thread();
+	ht = cds_lfht_new(1, 1, 0, CDS_LFHT_AUTO_RESIZE, NULL);
+	if (!ht)
+		abort();
+
+	rcu_read_lock();
+	for (i = 0; i < NR_NODES; i++) {
+		nodes[i].key = 2 * i;
+		cds_lfht_node_init(&nodes[i].node);
+		cds_lfht_add(ht, test_hash(nodes[i].key), &nodes[i].node);
+	}
+	for (i = 0; i < NR_LOOKUPS; i++) {
+		keys[i] = i;
+		hashes[i] = test_hash(i);
+		key_ptrs[i] = &keys[i];
+	}
+	cds_lfht_lookup_batch(ht, NR_LOOKUPS, hashes, test_match, key_ptrs,
+		iters);
+	for (i = 0; i < NR_LOOKUPS; i++) {
+		struct cds_lfht_iter iter;
+
+		cds_lfht_lookup(ht, hashes[i], test_match, key_ptrs[i], &iter);
+		if (cds_lfht_iter_get_node(&iter)
+				!= cds_lfht_iter_get_node(&iters[i]))
+			nr_mismatch++;
+		if (cds_lfht_iter_get_node(&iters[i]))
+			nr_found++;
+	}
+	ok(!nr_mismatch, "batch lookup matches single lookups");
+	ok(nr_found == NR_NODES, "batch lookup finds all present keys");
+	cds_lfht_lookup_batch(ht, 0, NULL, test_match, NULL, NULL);
+	ok(1, "empty batch lookup");
+	rcu_read_unlock();
+
+	/* Remove the nodes and add them again with wide hashes. */
+	rcu_read_lock();
+	for (i = 0; i < NR_NODES; i++)
+		(void) cds_lfht_del(ht, &nodes[i].node);
+	rcu_read_unlock();
+	synchronize_rcu();
+	rcu_read_lock();
+	for (i = 0; i < NR_NODES; i++) {
+		cds_lfht_node_init(&nodes[i].node);
+		cds_lfht_add(ht, test_hash_wide(nodes[i].key), &nodes[i].node);
+	}
+	for (i = 0; i < NR_LOOKUPS; i++)
+		hashes[i] = test_hash_wide(i);
+	cds_lfht_lookup_batch(ht, NR_LOOKUPS, hashes, test_match, key_ptrs,
+		iters);
+	nr_found = nr_mismatch = 0;
+	for (i = 0; i < NR_LOOKUPS; i++) {
+		struct cds_lfht_node *node = cds_lfht_iter_get_node(&iters[i]);
+
+		if (node)
+			nr_found++;
+		if (!!node != (!(i & 1) && i < 2 * NR_NODES))
+			nr_mismatch++;
+	}
+	ok(!nr_mismatch && nr_found == NR_NODES,
+		"batch lookup with full-width hashes");
+	rcu_read_unlock();
+
+	rcu_unregister_thread();
+	return exit_status();
+}
@@ -0,0 +1,201 @@
+/*
+ * test_lfht_lookup_or_add.c
+ *
+ * Userspace RCU library - test cds_lfht_lookup_or_add
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#include <stdlib.h>
+#include <pthread.h>
+#include <urcu.h>
+#include <urcu/rculfhash.h>
+
+#include "tap.h"
+
+#define NR_KEYS		1024
+#define NR_THREADS	4
+
+struct test_node {
+	unsigned long key;
+	struct cds_lfht_node node;
+};
+
+static unsigned long nr_ctor, nr_dtor;
+static int ctor_fail;
+static struct cds_lfht *ht;
+static struct cds_lfht_node *found[NR_THREADS][NR_KEYS];
+
+static unsigned long test_hash(unsigned long key)
+{
+	/* Few distinct hashes, so that keys share reverse hashes. */
+	return (key % (NR_KEYS / 4)) * 2654435761UL;
+}
+
+static int test_match(struct cds_lfht_node *node, const void *key)
+{
+	struct test_node *tn = caa_container_of(node, struct test_node, node);
+
+	return tn->key == *(const unsigned long *) key;
+}
+
+static struct cds_lfht_node *test_ctor(void *arg)
+{
+	struct test_node *tn;
+
+	if (ctor_fail)
+		return NULL;
+	tn = malloc(sizeof(*tn));
+	if (!tn)
+		abort();
+	tn->key = *(unsigned long *) arg;
+	cds_lfht_node_init(&tn->node);
+	uatomic_inc(&nr_ctor);
+	return &tn->node;
+}
+
+static void test_dtor(struct cds_lfht_node *node, void *arg)
+{
+	free(caa_container_of(node, struct test_node, node));
+	uatomic_inc(&nr_dtor);
+}
+
+static struct cds_lfht_node *get(unsigned long key)
+{
+	struct cds_lfht_node *node;
+
+	rcu_read_lock();
+	node = cds_lfht_lookup_or_add(ht, test_hash(key), test_match, &key,
+			test_ctor, test_dtor, &key);
+	rcu_read_unlock();
+	return node;
+}
+
+static void *thr_get(void *arg)
+{
+	unsigned long i, id = (unsigned long) arg;
+
+	rcu_register_thread();
+	for (i = 0; i < NR_KEYS; i++)
+		found[id][(i + id * 97) % NR_KEYS] = get((i + id * 97) % NR_KEYS);
+	rcu_unregister_thread();
+	return NULL;
+}
+
+static unsigned long count(void)
+{
+	long before, after;
+	unsigned long nr;
+
+	rcu_read_lock();
+	cds_lfht_count_nodes(ht, &before, &nr, &after);
+	rcu_read_unlock();
+	return nr;
+}
+
+static void empty_table(void)
+{
+	static struct cds_lfht_node *removed[NR_KEYS];
+	struct cds_lfht_iter iter;
+	struct cds_lfht_node *node;
+	unsigned long i, nr = 0;
+
+	rcu_read_lock();
+	cds_lfht_for_each(ht, &iter, node) {
+		if (!cds_lfht_del(ht, node))
+			removed[nr++] = node;
+	}
+	rcu_read_unlock();
+	synchronize_rcu();
+	for (i = 0; i < nr; i++)
+		free(caa_container_of(removed[i], struct test_node, node));
+}
+
+int main(int argc, char **argv)
+{
+	struct cds_lfht_node *node;
+	pthread_t tid[NR_THREADS];
+	unsigned long i, j, nr_bad;
+	struct test_node *tn;
+
+	plan_tests(9);
+
+	rcu_register_thread();
+	ht = cds_lfht_new(1, 1, 0, CDS_LFHT_AUTO_RESIZE, NULL);
+	if (!ht)
+		abort();
+
+	node = get(7);
+	tn = caa_container_of(node, struct test_node, node);
+	ok(node && tn->key == 7 && nr_ctor == 1 && count() == 1,
+		"missing key constructed and added");
+	ok(get(7) == node && nr_ctor == 1,
+		"present key found without construction");
+
+	ctor_fail = 1;
+	ok(get(8) == NULL && count() == 1,
+		"constructor failure adds nothing");
+	ctor_fail = 0;
+
+	empty_table();
+	nr_ctor = 0;
+
+	for (i = 0; i < NR_THREADS; i++) {
+		if (pthread_create(&tid[i], NULL, thr_get, (void *) i))
+			abort();
+	}
+	for (i = 0; i < NR_THREADS; i++) {
+		if (pthread_join(tid[i], NULL))
+			abort();
+	}
+	ok(count() == NR_KEYS, "concurrent: each key added once");
+	ok(nr_ctor - nr_dtor == NR_KEYS,
+		"concurrent: lost constructions destroyed (%lu ctor, %lu dtor)",
+		nr_ctor, nr_dtor);
+	nr_bad = 0;
+	for (j = 0; j < NR_KEYS; j++) {
+		tn = caa_container_of(found[0][j], struct test_node, node);
+		if (tn->key != j)
+			nr_bad++;
+		for (i = 1; i < NR_THREADS; i++) {
+			if (found[i][j] != found[0][j])
+				nr_bad++;
+		}
+	}
+	ok(nr_bad == 0, "concurrent: all threads got the same node");
+
+	nr_bad = 0;
+	for (j = 0; j < NR_KEYS; j++) {
+		if (get(j) != found[0][j])
+			nr_bad++;
+	}
+	ok(nr_bad == 0 && nr_ctor - nr_dtor == NR_KEYS,
+		"all keys found afterwards");
+
+	empty_table();
+	ok(cds_lfht_destroy(ht, NULL) == 0, "table destroyed");
+
+	/* Tag tables are not supported. */
+	ht = cds_lfht_new(1, 1, 0, CDS_LFHT_NODE_TAG, NULL);
+	if (!ht)
+		abort();
+	ok(get(1) == NULL && nr_ctor - nr_dtor == NR_KEYS,
+		"tag tables not supported");
+	if (cds_lfht_destroy(ht, NULL))
+		abort();
+
+	rcu_unregister_thread();
+	return exit_status();
+}
@@ -0,0 +1,167 @@
+/*
+ * test_lfht_mm_compact.c
+ *
+ * Userspace RCU library - test cds_lfht compact bucket memory management
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#include <stdlib.h>
+#include <errno.h>
+#include <pthread.h>
+#include <urcu.h>
+#include <urcu/rculfhash.h>
+
+#include "tap.h"
+
+#define NR_NODES	(1UL << 15)
+#define MAX_BUCKETS	(1UL << 20)
+
+struct test_node {
+	unsigned long key;
+	struct cds_lfht_node node;
+};
+
+static struct test_node nodes[NR_NODES];
+static struct test_node dup_node;
+static struct cds_lfht *ht;
+static int stop_reader;
+static unsigned long reader_missing;
+
+static unsigned long test_hash(unsigned long key)
+{
+	return key * 2654435761UL;
+}
+
+static int test_match(struct cds_lfht_node *node, const void *key)
+{
+	return caa_container_of(node, struct test_node, node)->key
+		== *(const unsigned long *) key;
+}
+
+/* Look up the even keys, never removed, while the table resizes. */
+static void *thr_reader(void *arg)
+{
+	struct cds_lfht_iter iter;
+	unsigned long key = 0;
+
+	rcu_register_thread();
+	while (!CMM_LOAD_SHARED(stop_reader)) {
+		rcu_read_lock();
+		cds_lfht_lookup(ht, test_hash(key), test_match, &key, &iter);
+		if (cds_lfht_iter_get_node(&iter) != &nodes[key].node)
+			reader_missing++;
+		rcu_read_unlock();
+		key = (key + 2) % NR_NODES;
+	}
+	rcu_unregister_thread();
+	return NULL;
+}
+
+static unsigned long count(void)
+{
+	long before, after;
+	unsigned long nr;
+
+	rcu_read_lock();
+	cds_lfht_count_nodes(ht, &before, &nr, &after);
+	rcu_read_unlock();
+	return nr;
+}
+
+int main(int argc, char **argv)
+{
+	struct cds_lfht_iter iter;
+	struct cds_lfht_node *node;
+	struct cds_lfht_diag diag = { 0 };
+	pthread_t tid;
+	unsigned long i, key, nr_bad;
+
+	plan_tests(8);
+
+	rcu_register_thread();
+	ht = _cds_lfht_new(1, 1, MAX_BUCKETS,
+		CDS_LFHT_AUTO_RESIZE | CDS_LFHT_ACCOUNTING,
+		&cds_lfht_mm_mmap_compact, &rcu_flavor, NULL);
+	if (!ht)
+		abort();
+
+	rcu_read_lock();
+	nr_bad = 0;
+	for (i = 0; i < NR_NODES; i++) {
+		nodes[i].key = i;
+		cds_lfht_node_init(&nodes[i].node);
+		if (cds_lfht_add_unique(ht, test_hash(i), test_match, &i,
+				&nodes[i].node) != &nodes[i].node)
+			nr_bad++;
+	}
+	key = 7;
+	dup_node.key = key;
+	cds_lfht_node_init(&dup_node.node);
+	node = cds_lfht_add_unique(ht, test_hash(key), test_match, &key,
+		&dup_node.node);
+	rcu_read_unlock();
+	ok(nr_bad == 0 && count() == NR_NODES, "all nodes added");
+	ok(node == &nodes[7].node, "add_unique returns the existing node");
+
+	if (pthread_create(&tid, NULL, thr_reader, NULL))
+		abort();
+
+	/* Remove the odd keys, then grow and shrink under the reader. */
+	rcu_read_lock();
+	for (i = 1; i < NR_NODES; i += 2)
+		(void) cds_lfht_del(ht, &nodes[i].node);
+	rcu_read_unlock();
+	cds_lfht_resize(ht, MAX_BUCKETS);
+	cds_lfht_resize(ht, 1);
+	cds_lfht_resize(ht, NR_NODES);
+
+	CMM_STORE_SHARED(stop_reader, 1);
+	if (pthread_join(tid, NULL))
+		abort();
+	ok(reader_missing == 0, "concurrent lookups during resizes");
+	ok(count() == NR_NODES / 2, "odd keys removed");
+
+	rcu_read_lock();
+	nr_bad = 0;
+	for (i = 0; i < NR_NODES; i++) {
+		cds_lfht_lookup(ht, test_hash(i), test_match, &i, &iter);
+		node = cds_lfht_iter_get_node(&iter);
+		if (node != ((i & 1) ? NULL : &nodes[i].node))
+			nr_bad++;
+	}
+	rcu_read_unlock();
+	ok(nr_bad == 0, "lookups after resizes");
+
+	rcu_read_lock();
+	i = 0;
+	do {
+		i = cds_lfht_diag_scan(ht, i, 1024, &diag);
+	} while (i);
+	rcu_read_unlock();
+	ok(diag.nr_nodes == NR_NODES / 2 && diag.nr_dup_reverse_hash == 0,
+		"diag scan sees bucket order");
+
+	ok(cds_lfht_destroy(ht, NULL) == -EPERM,
+		"destroy fails on non-empty table");
+	rcu_read_lock();
+	cds_lfht_for_each(ht, &iter, node)
+		(void) cds_lfht_del(ht, node);
+	rcu_read_unlock();
+	ok(cds_lfht_destroy(ht, NULL) == 0, "destroy once emptied");
+
+	rcu_unregister_thread();
+	return exit_status();
+}
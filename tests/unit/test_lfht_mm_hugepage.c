@@ -0,0 +1,105 @@
+/*
+ * test_lfht_mm_hugepage.c
+ *
+ * Userspace RCU library - test cds_lfht huge page memory management
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#include <stdlib.h>
+#include <urcu.h>
+#include <urcu/rculfhash.h>
+
+#include "tap.h"
+
+#define NR_NODES	(1UL << 16)
+#define MAX_BUCKETS	(1UL << 20)
+
+struct test_node {
+	unsigned long key;
+	struct cds_lfht_node node;
+};
+
+static struct test_node nodes[NR_NODES];
+
+static unsigned long test_hash(unsigned long key)
+{
+	return key * 2654435761UL;
+}
+
+static int test_match(struct cds_lfht_node *node, const void *key)
+{
+	return caa_container_of(node, struct test_node, node)->key
+		== *(const unsigned long *) key;
+}
+
+static void test_mm(const struct cds_lfht_mm_type *mm, const char *name)
+{
+	struct cds_lfht *ht;
+	struct cds_lfht_iter iter;
+	struct cds_lfht_node *node;
+	unsigned long i, key, nr_found = 0, count;
+	long before, after;
+
+	ht = _cds_lfht_new(1, 1, MAX_BUCKETS,
+		CDS_LFHT_AUTO_RESIZE | CDS_LFHT_ACCOUNTING, mm,
+		&rcu_flavor, NULL);
+	if (!ht)
+		abort();
+
+	rcu_read_lock();
+	for (i = 0; i < NR_NODES; i++) {
+		nodes[i].key = i;
+		cds_lfht_node_init(&nodes[i].node);
+		cds_lfht_add(ht, test_hash(i), &nodes[i].node);
+	}
+	rcu_read_unlock();
+
+	/* Grow the table to populate several huge pages worth of buckets. */
+	cds_lfht_resize(ht, MAX_BUCKETS);
+
+	rcu_read_lock();
+	for (i = 0; i < NR_NODES; i++) {
+		key = i;
+		cds_lfht_lookup(ht, test_hash(key), test_match, &key, &iter);
+		if (cds_lfht_iter_get_node(&iter) == &nodes[i].node)
+			nr_found++;
+	}
+	rcu_read_unlock();
+	ok(nr_found == NR_NODES, "%s: lookups after resize", name);
+
+	/* Shrink the table, discarding bucket memory. */
+	cds_lfht_resize(ht, 1);
+	rcu_read_lock();
+	cds_lfht_count_nodes(ht, &before, &count, &after);
+	cds_lfht_for_each(ht, &iter, node) {
+		(void) cds_lfht_del(ht, node);
+	}
+	rcu_read_unlock();
+	ok(count == NR_NODES, "%s: count after shrink", name);
+
+	ok(cds_lfht_destroy(ht, NULL) == 0, "%s: destroy", name);
+}
+
+int main(int argc, char **argv)
+{
+	plan_tests(6);
+
+	rcu_register_thread();
+	test_mm(&cds_lfht_mm_hugepage, "hugepage");
+	test_mm(&cds_lfht_mm_hugepage_interleave, "hugepage_interleave");
+	rcu_unregister_thread();
+	return exit_status();
+}
@@ -0,0 +1,192 @@
+/*
+ * test_lfht_mm_retention.c
+ *
+ * Userspace RCU library - test bucket table memory retention
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#define _LGPL_SOURCE
+#include <stdlib.h>
+#include <poll.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <urcu.h>
+#include <urcu/rculfhash.h>
+
+#include "tap.h"
+
+#define NR_NODES	(1UL << 12)
+#define MAX_ORDER	16
+#define MAX_BUCKETS	(1UL << MAX_ORDER)
+#define MIN_ORDER	10
+
+struct test_node {
+	unsigned long key;
+	struct cds_lfht_node node;
+};
+
+static struct test_node nodes[NR_NODES];
+
+static unsigned long test_hash(unsigned long key)
+{
+	return key * 2654435761UL;
+}
+
+static int test_match(struct cds_lfht_node *node, const void *key)
+{
+	return caa_container_of(node, struct test_node, node)->key
+		== *(const unsigned long *) key;
+}
+
+static struct cds_lfht *new_table(const struct cds_lfht_mm_type *mm)
+{
+	struct cds_lfht *ht;
+	unsigned long i;
+
+	ht = _cds_lfht_new(1, 1, MAX_BUCKETS, 0, mm, &rcu_flavor, NULL);
+	if (!ht)
+		abort();
+	rcu_read_lock();
+	for (i = 0; i < NR_NODES; i++) {
+		nodes[i].key = i;
+		cds_lfht_node_init(&nodes[i].node);
+		cds_lfht_add(ht, test_hash(i), &nodes[i].node);
+	}
+	rcu_read_unlock();
+	return ht;
+}
+
+static void destroy_table(struct cds_lfht *ht)
+{
+	struct cds_lfht_iter iter;
+	struct cds_lfht_node *node;
+
+	rcu_read_lock();
+	cds_lfht_for_each(ht, &iter, node)
+		(void) cds_lfht_del(ht, node);
+	rcu_read_unlock();
+	if (cds_lfht_destroy(ht, NULL))
+		abort();
+}
+
+static unsigned long nr_missing(struct cds_lfht *ht)
+{
+	struct cds_lfht_iter iter;
+	unsigned long i, nr = 0;
+
+	rcu_read_lock();
+	for (i = 0; i < NR_NODES; i++) {
+		cds_lfht_lookup(ht, test_hash(i), test_match, &i, &iter);
+		if (cds_lfht_iter_get_node(&iter) != &nodes[i].node)
+			nr++;
+	}
+	rcu_read_unlock();
+	return nr;
+}
+
+/* Whether the first page of the top order of a mmap table is resident. */
+static int top_order_resident(struct cds_lfht *ht, size_t bucket_size)
+{
+	char *tbl = (char *) ht->tbl_mmap;
+	unsigned char vec;
+
+	if (mincore(tbl + (MAX_BUCKETS / 2) * bucket_size, getpagesize(), &vec))
+		abort();
+	return vec & 1;
+}
+
+/* First chunk of an order of a chunk table. */
+static struct cds_lfht_node *order_chunk(struct cds_lfht *ht,
+		unsigned long order)
+{
+	return ht->tbl_chunk[(1UL << (order - 1)) >> ht->min_alloc_buckets_order];
+}
+
+static void test_mmap(const struct cds_lfht_mm_type *mm, size_t bucket_size,
+		const char *name)
+{
+	struct cds_lfht *ht;
+
+	ht = new_table(mm);
+	cds_lfht_resize(ht, MAX_BUCKETS);
+	cds_lfht_resize(ht, 1UL << MIN_ORDER);
+	ok(!top_order_resident(ht, bucket_size),
+		"%s: shrink discards memory by default", name);
+
+	cds_lfht_set_mm_retention(ht, MAX_BUCKETS * bucket_size, 0);
+	cds_lfht_resize(ht, MAX_BUCKETS);
+	cds_lfht_resize(ht, 1UL << MIN_ORDER);
+	ok(top_order_resident(ht, bucket_size),
+		"%s: shrink retains memory", name);
+	cds_lfht_resize(ht, MAX_BUCKETS);
+	ok(nr_missing(ht) == 0, "%s: grow reuses retained memory", name);
+
+	cds_lfht_set_mm_retention(ht, 0, 0);
+	cds_lfht_resize(ht, 1UL << MIN_ORDER);
+	ok(!top_order_resident(ht, bucket_size) && nr_missing(ht) == 0,
+		"%s: retention disabled discards memory again", name);
+	destroy_table(ht);
+}
+
+static void test_chunk(void)
+{
+	struct cds_lfht_node *chunk;
+	struct cds_lfht *ht;
+
+	ht = new_table(&cds_lfht_mm_chunk);
+	cds_lfht_set_mm_retention(ht, MAX_BUCKETS * sizeof(struct cds_lfht_node),
+		0);
+	cds_lfht_resize(ht, MAX_BUCKETS);
+	chunk = order_chunk(ht, MAX_ORDER);
+	cds_lfht_resize(ht, 1UL << MIN_ORDER);
+	ok(order_chunk(ht, MAX_ORDER) == chunk, "chunk: shrink retains chunks");
+	cds_lfht_resize(ht, MAX_BUCKETS);
+	ok(order_chunk(ht, MAX_ORDER) == chunk && nr_missing(ht) == 0,
+		"chunk: grow reuses retained chunks");
+
+	/* Keep orders MIN_ORDER + 1 and MIN_ORDER + 2 only. */
+	cds_lfht_set_mm_retention(ht, ((1UL << (MIN_ORDER + 2))
+		- (1UL << MIN_ORDER)) * sizeof(struct cds_lfht_node), 0);
+	cds_lfht_resize(ht, 1UL << MIN_ORDER);
+	ok(order_chunk(ht, MIN_ORDER + 2) && !order_chunk(ht, MIN_ORDER + 3)
+			&& !order_chunk(ht, MAX_ORDER),
+		"chunk: retention bounded in size");
+
+	/* The next shrink releases what was retained for too long. */
+	cds_lfht_set_mm_retention(ht, MAX_BUCKETS * sizeof(struct cds_lfht_node),
+		1);
+	cds_lfht_resize(ht, MAX_BUCKETS);
+	cds_lfht_resize(ht, 1UL << (MAX_ORDER - 2));
+	(void) poll(NULL, 0, 10);
+	cds_lfht_resize(ht, 1UL << (MAX_ORDER - 4));
+	ok(!order_chunk(ht, MAX_ORDER) && order_chunk(ht, MAX_ORDER - 3)
+			&& nr_missing(ht) == 0,
+		"chunk: retention bounded in time");
+	destroy_table(ht);
+}
+
+int main(int argc, char **argv)
+{
+	plan_tests(12);
+
+	rcu_register_thread();
+	test_mmap(&cds_lfht_mm_mmap, sizeof(struct cds_lfht_node), "mmap");
+	test_mmap(&cds_lfht_mm_mmap_compact,
+		sizeof(struct cds_lfht_compact_bucket), "compact");
+	test_chunk();
+	rcu_unregister_thread();
+	return exit_status();
+}
@@ -0,0 +1,158 @@
+/*
+ * test_lfht_mm_unbounded.c
+ *
+ * Userspace RCU library - test unbounded mmap tables
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#define _LGPL_SOURCE
+#include <stdlib.h>
+#include <sys/resource.h>
+#include <urcu.h>
+#include <urcu/rculfhash.h>
+
+#include "tap.h"
+
+#define NR_NODES	(1UL << 14)
+#define UNBOUNDED	(1UL << 36)
+
+struct test_node {
+	unsigned long key;
+	struct cds_lfht_node node;
+};
+
+static struct test_node nodes[NR_NODES];
+
+static unsigned long test_hash(unsigned long key)
+{
+	return key * 2654435761UL;
+}
+
+static int test_match(struct cds_lfht_node *node, const void *key)
+{
+	return caa_container_of(node, struct test_node, node)->key
+		== *(const unsigned long *) key;
+}
+
+/* Fill the table, grow it past the nodes, and look them all up. */
+static unsigned long nr_missing(struct cds_lfht *ht)
+{
+	struct cds_lfht_iter iter;
+	unsigned long i, nr = 0;
+
+	rcu_read_lock();
+	for (i = 0; i < NR_NODES; i++) {
+		nodes[i].key = i;
+		cds_lfht_node_init(&nodes[i].node);
+		cds_lfht_add(ht, test_hash(i), &nodes[i].node);
+	}
+	rcu_read_unlock();
+	cds_lfht_resize(ht, NR_NODES);
+	rcu_read_lock();
+	for (i = 0; i < NR_NODES; i++) {
+		cds_lfht_lookup(ht, test_hash(i), test_match, &i, &iter);
+		if (cds_lfht_iter_get_node(&iter) != &nodes[i].node)
+			nr++;
+	}
+	rcu_read_unlock();
+	return nr;
+}
+
+static void destroy_table(struct cds_lfht *ht)
+{
+	struct cds_lfht_iter iter;
+	struct cds_lfht_node *node;
+
+	rcu_read_lock();
+	cds_lfht_for_each(ht, &iter, node)
+		(void) cds_lfht_del(ht, node);
+	rcu_read_unlock();
+	if (cds_lfht_destroy(ht, NULL))
+		abort();
+}
+
+int main(int argc, char **argv)
+{
+	struct cds_lfht_mem_stats stats;
+	struct cds_lfht *ht;
+	struct rlimit limit;
+
+	plan_tests(7);
+
+	rcu_register_thread();
+
+#if (CAA_BITS_PER_LONG > 32)
+	ht = cds_lfht_new(1, 1, 0, 0, NULL);
+	if (!ht)
+		abort();
+	ok(ht->mm == &cds_lfht_mm_mmap && ht->max_nr_buckets == UNBOUNDED,
+		"unbounded table uses the mmap plugin (%lu buckets)",
+		ht->max_nr_buckets);
+	ok(nr_missing(ht) == 0, "unbounded table grows");
+	cds_lfht_get_mem_stats(ht, &stats);
+	ok(stats.bucket_bytes == NR_NODES * sizeof(struct cds_lfht_node),
+		"only the buckets in use are populated (%zu bytes)",
+		stats.bucket_bytes);
+	destroy_table(ht);
+
+	ht = cds_lfht_new(1, 1, 1UL << 38, 0, NULL);
+	if (!ht)
+		abort();
+	ok(ht->mm == &cds_lfht_mm_mmap && ht->max_nr_buckets == 1UL << 38,
+		"table above 2^32 buckets uses the mmap plugin");
+	destroy_table(ht);
+
+	ht = _cds_lfht_new(1, 1, 0, 0, &cds_lfht_mm_mmap_compact,
+			&rcu_flavor, NULL);
+	if (!ht)
+		abort();
+	ok(ht->max_nr_buckets == UNBOUNDED && nr_missing(ht) == 0,
+		"unbounded compact table");
+	destroy_table(ht);
+
+	/* Leave room for 2^33 buckets only. */
+	if (getrlimit(RLIMIT_AS, &limit))
+		abort();
+	limit.rlim_cur = (1UL << 33) * sizeof(struct cds_lfht_node)
+		+ (1UL << 32);
+	if (setrlimit(RLIMIT_AS, &limit))
+		abort();
+	ht = cds_lfht_new(1, 1, 0, 0, NULL);
+	if (!ht)
+		abort();
+	ok(ht->mm == &cds_lfht_mm_mmap && ht->max_nr_buckets < UNBOUNDED
+			&& ht->max_nr_buckets >= 1UL << 32
+			&& nr_missing(ht) == 0,
+		"reservation fits the address space (%lu buckets)",
+		ht->max_nr_buckets);
+	destroy_table(ht);
+
+	limit.rlim_cur = 1UL << 31;
+	if (setrlimit(RLIMIT_AS, &limit))
+		abort();
+	ht = cds_lfht_new(1, 1, 0, 0, NULL);
+	if (!ht)
+		abort();
+	ok(ht->mm == &cds_lfht_mm_order && nr_missing(ht) == 0,
+		"falls back on the order plugin without address space");
+	destroy_table(ht);
+#else
+	skip(7, "64-bit architectures only");
+#endif
+
+	rcu_unregister_thread();
+	return exit_status();
+}
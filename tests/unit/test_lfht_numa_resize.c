@@ -0,0 +1,167 @@
+/*
+ * test_lfht_numa_resize.c
+ *
+ * Userspace RCU library - test NUMA pinning of hash table resize threads
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#include <stdlib.h>
+#include <pthread.h>
+#include <sched.h>
+#include <urcu.h>
+#include <urcu/rculfhash.h>
+#include "compat-numa.h"
+
+#include "tap.h"
+
+#define NR_NODES	(1UL << 16)
+#define CHECK_MASK	1023
+
+struct test_node {
+	unsigned long key;
+	struct cds_lfht_node node;
+};
+
+static struct test_node nodes[2][NR_NODES];
+static pthread_t main_thread;
+static int nr_allowed;
+
+/* Affinity of the pool threads seen while visiting nodes. */
+static unsigned long nr_pool_checks, nr_multi_node, nr_restricted;
+
+static unsigned long test_hash(unsigned long key)
+{
+	return key * 2654435761UL;
+}
+
+/*
+ * Number of CPUs of the calling thread. Sets multi_node if they belong
+ * to more than one node.
+ */
+static int thread_cpus(int *multi_node)
+{
+	cpu_set_t mask;
+	int cpu, node, first = -2, nr = 0;
+
+	*multi_node = 0;
+	if (sched_getaffinity(0, sizeof(mask), &mask))
+		return -1;
+	for (cpu = 0; cpu < CPU_SETSIZE; cpu++) {
+		if (!CPU_ISSET(cpu, &mask))
+			continue;
+		nr++;
+		node = urcu_numa_node_of_cpu(cpu);
+		if (first == -2)
+			first = node;
+		else if (node != first)
+			*multi_node = 1;
+	}
+	return nr;
+}
+
+static void visit(struct cds_lfht *ht, struct cds_lfht_node *node, void *arg)
+{
+	struct test_node *tn = caa_container_of(node, struct test_node, node);
+	int nr_cpus, multi_node;
+
+	uatomic_inc((unsigned long *) arg);
+	if (pthread_equal(pthread_self(), main_thread)
+			|| (tn->key & CHECK_MASK))
+		return;
+	uatomic_inc(&nr_pool_checks);
+	nr_cpus = thread_cpus(&multi_node);
+	if (multi_node)
+		uatomic_inc(&nr_multi_node);
+	if (nr_cpus != nr_allowed)
+		uatomic_inc(&nr_restricted);
+}
+
+static struct cds_lfht *create_table(struct test_node *tnodes,
+		const struct cds_lfht_mm_type *mm)
+{
+	struct cds_lfht *ht;
+	unsigned long i;
+
+	ht = _cds_lfht_new(NR_NODES, 1, NR_NODES, 0, mm, &rcu_flavor, NULL);
+	if (!ht)
+		abort();
+	rcu_read_lock();
+	for (i = 0; i < NR_NODES; i++) {
+		tnodes[i].key = i;
+		cds_lfht_node_init(&tnodes[i].node);
+		cds_lfht_add(ht, test_hash(i), &tnodes[i].node);
+	}
+	rcu_read_unlock();
+	return ht;
+}
+
+static void destroy_table(struct cds_lfht *ht)
+{
+	struct cds_lfht_iter iter;
+	struct cds_lfht_node *node;
+
+	rcu_read_lock();
+	cds_lfht_for_each(ht, &iter, node)
+		(void) cds_lfht_del(ht, node);
+	rcu_read_unlock();
+	if (cds_lfht_destroy(ht, NULL))
+		abort();
+}
+
+static unsigned long traverse(struct cds_lfht *ht)
+{
+	unsigned long nr_visits = 0;
+
+	nr_pool_checks = nr_multi_node = nr_restricted = 0;
+	cds_lfht_for_each_parallel(ht, 4, visit, &nr_visits);
+	return nr_visits;
+}
+
+int main(int argc, char **argv)
+{
+	struct cds_lfht *numa_ht, *ht;
+	int multi_node;
+
+	plan_tests(4);
+
+	main_thread = pthread_self();
+	nr_allowed = thread_cpus(&multi_node);
+	rcu_register_thread();
+	numa_ht = create_table(nodes[0], &cds_lfht_mm_hugepage_interleave);
+	ht = create_table(nodes[1], &cds_lfht_mm_mmap);
+
+	ok(traverse(numa_ht) == NR_NODES,
+		"traversal of a NUMA table visits all nodes");
+	if (!nr_pool_checks)
+		skip(1, "no partition processed by pool threads");
+	else
+		ok(!nr_multi_node,
+			"pool threads pinned to a single node (%lu checks)",
+			nr_pool_checks);
+
+	/* The same pool threads then process partitions of a plain table. */
+	ok(traverse(ht) == NR_NODES,
+		"traversal of a plain table visits all nodes");
+	if (!nr_pool_checks)
+		skip(1, "no partition processed by pool threads");
+	else
+		ok(!nr_restricted, "pool threads unpinned for other tables");
+
+	destroy_table(ht);
+	destroy_table(numa_ht);
+	rcu_unregister_thread();
+	return exit_status();
+}
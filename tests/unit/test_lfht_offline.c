@@ -0,0 +1,206 @@
+/*
+ * test_lfht_offline.c
+ *
+ * Userspace RCU library - test building a cds_lfht offline and publishing it
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include <poll.h>
+#include <urcu.h>
+#include <urcu/rculfhash.h>
+
+#include "tap.h"
+
+#define NR_NODES	(1UL << 14)
+
+struct test_node {
+	unsigned long key;
+	struct cds_lfht_node node;
+};
+
+struct destroy_state {
+	unsigned long nr_freed;
+	int done;
+	int ret;
+};
+
+static struct cds_lfht *live_ht;
+
+static unsigned long test_hash(unsigned long key)
+{
+	/* Few distinct hashes, so that keys share reverse hashes. */
+	return (key % (NR_NODES / 4)) * 2654435761UL;
+}
+
+static int test_match(struct cds_lfht_node *node, const void *key)
+{
+	struct test_node *tn = caa_container_of(node, struct test_node, node);
+
+	return tn->key == *(const unsigned long *) key;
+}
+
+static struct test_node *alloc_node(unsigned long key)
+{
+	struct test_node *tn;
+
+	tn = malloc(sizeof(*tn));
+	if (!tn)
+		abort();
+	tn->key = key;
+	cds_lfht_node_init(&tn->node);
+	return tn;
+}
+
+static void free_node(struct cds_lfht_node *node, void *priv)
+{
+	struct destroy_state *state = priv;
+
+	free(caa_container_of(node, struct test_node, node));
+	state->nr_freed++;
+}
+
+static void done(int ret, pthread_attr_t *attr, void *priv)
+{
+	struct destroy_state *state = priv;
+
+	state->ret = ret;
+	uatomic_set(&state->done, 1);
+}
+
+/* Wait for done, up to 10 seconds. */
+static int wait_done(struct destroy_state *state)
+{
+	int i;
+
+	for (i = 0; i < 1000; i++) {
+		if (uatomic_read(&state->done))
+			return 1;
+		(void) poll(NULL, 0, 10);
+	}
+	return 0;
+}
+
+/* Number of keys of [0, nr) found in the live table. */
+static unsigned long nr_found(unsigned long nr)
+{
+	struct cds_lfht_iter iter;
+	struct cds_lfht *ht;
+	unsigned long i, found = 0;
+
+	rcu_read_lock();
+	ht = rcu_dereference(live_ht);
+	for (i = 0; i < nr; i++) {
+		cds_lfht_lookup(ht, test_hash(i), test_match, &i, &iter);
+		found += !!cds_lfht_iter_get_node(&iter);
+	}
+	rcu_read_unlock();
+	return found;
+}
+
+int main(int argc, char **argv)
+{
+	struct destroy_state state = { 0 };
+	struct cds_lfht *ht;
+	struct cds_lfht_node *node;
+	struct test_node *tn, *dup;
+	unsigned long i, nr, nr_bad;
+	long before, after, global;
+
+	plan_tests(9);
+
+	rcu_register_thread();
+
+	/* Live table, with half the keys. */
+	live_ht = cds_lfht_new(1, 1, 0,
+			CDS_LFHT_AUTO_RESIZE | CDS_LFHT_ACCOUNTING, NULL);
+	if (!live_ht)
+		abort();
+	rcu_read_lock();
+	for (i = 0; i < NR_NODES / 2; i++)
+		cds_lfht_add(live_ht, test_hash(i), &alloc_node(i)->node);
+	rcu_read_unlock();
+
+	/* Rebuild with all keys, offline. */
+	ht = cds_lfht_new(NR_NODES, 1, 0,
+			CDS_LFHT_AUTO_RESIZE | CDS_LFHT_ACCOUNTING, NULL);
+	if (!ht)
+		abort();
+	nr_bad = 0;
+	for (i = 0; i < NR_NODES; i++) {
+		tn = alloc_node(i);
+		if (cds_lfht_add_unique_offline(ht, test_hash(i), test_match,
+				&i, &tn->node) != &tn->node)
+			nr_bad++;
+	}
+	ok(nr_bad == 0, "offline unique adds");
+
+	nr_bad = 0;
+	for (i = 0; i < NR_NODES; i += 64) {
+		dup = alloc_node(i);
+		node = cds_lfht_add_unique_offline(ht, test_hash(i), test_match,
+				&i, &dup->node);
+		tn = caa_container_of(node, struct test_node, node);
+		if (node == &dup->node || tn->key != i)
+			nr_bad++;
+		free(dup);
+	}
+	ok(nr_bad == 0, "offline unique add returns the present key");
+
+	/* Duplicate keys, added as a plain add. */
+	i = 7;
+	cds_lfht_add_offline(ht, test_hash(i), &alloc_node(i)->node);
+
+	rcu_read_lock();
+	cds_lfht_count_nodes(ht, &before, &nr, &after);
+	rcu_read_unlock();
+	ok(nr == NR_NODES + 1 && before == NR_NODES + 1,
+		"offline adds counted (%lu nodes, split count %ld)", nr, before);
+	ok(!cds_lfht_count_global(ht, &global, NULL)
+		&& global == (long) ((NR_NODES + 1) & ~((1UL << 10) - 1)),
+		"global count committed (%ld)", global);
+
+	ok(cds_lfht_publish(&live_ht, ht, free_node, done, &state) == 0,
+		"table published");
+	ok(live_ht == ht, "published table is live");
+	ok(wait_done(&state) && state.ret == 0
+		&& state.nr_freed == NR_NODES / 2,
+		"previous table destroyed (%lu nodes freed)", state.nr_freed);
+	ok(nr_found(NR_NODES) == NR_NODES, "all keys found in published table");
+
+	/* The published table is a regular table, which can grow. */
+	rcu_read_lock();
+	for (i = NR_NODES; i < 4 * NR_NODES; i++)
+		cds_lfht_add(live_ht, test_hash(i) ^ (i << 20),
+				&alloc_node(i)->node);
+	rcu_read_unlock();
+
+	memset(&state, 0, sizeof(state));
+	ht = cds_lfht_new(1, 1, 0, 0, NULL);
+	if (!ht)
+		abort();
+	ok(cds_lfht_publish(&live_ht, ht, free_node, done, &state) == 0
+		&& wait_done(&state) && state.ret == 0
+		&& state.nr_freed == 4 * NR_NODES + 1,
+		"published table destroyed in turn (%lu nodes freed)",
+		state.nr_freed);
+
+	if (cds_lfht_destroy(live_ht, NULL))
+		abort();
+	rcu_unregister_thread();
+	return exit_status();
+}
@@ -0,0 +1,129 @@
+/*
+ * test_lfht_range.c
+ *
+ * Userspace RCU library - test cds_lfht range traversals
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#include <stdlib.h>
+#include <urcu.h>
+#include <urcu/rculfhash.h>
+
+#include "tap.h"
+
+#define NR_NODES	10000
+#define NR_RANGES	7
+
+struct test_node {
+	unsigned long key;
+	unsigned int visited;
+	struct cds_lfht_node node;
+};
+
+static struct test_node nodes[NR_NODES];
+
+static unsigned long test_hash(unsigned long key)
+{
+	return key * 2654435761UL;
+}
+
+int main(int argc, char **argv)
+{
+	struct cds_lfht *ht;
+	struct cds_lfht_iter iter;
+	struct cds_lfht_node *node;
+	struct test_node *pos;
+	unsigned long i, r, first, last, prev_last = 0;
+	unsigned long nr_bad_order = 0, nr_bad_range = 0, nr_bad_visit = 0;
+	unsigned long nr_bad_split = 0, nr_bad_from = 0, nr_from = 0;
+	unsigned long mid;
+
+	plan_tests(5);
+
+	rcu_register_thread();
+	ht = cds_lfht_new(1, 1, 0, CDS_LFHT_AUTO_RESIZE, NULL);
+	if (!ht)
+		abort();
+
+	rcu_read_lock();
+	for (i = 0; i < NR_NODES; i++) {
+		nodes[i].key = i;
+		cds_lfht_node_init(&nodes[i].node);
+		cds_lfht_add(ht, test_hash(i), &nodes[i].node);
+	}
+	rcu_read_unlock();
+
+	rcu_read_lock();
+	for (r = 0; r < NR_RANGES; r++) {
+		unsigned long prev = 0;
+
+		cds_lfht_range_split(NR_RANGES, r, &first, &last);
+		if ((r == 0 && first != 0) || (r && first != prev_last + 1)
+				|| last < first)
+			nr_bad_split++;
+		prev_last = last;
+		cds_lfht_for_each_entry_range(ht, first, last, &iter,
+				pos, node) {
+			if (pos->node.reverse_hash < prev)
+				nr_bad_order++;
+			if (pos->node.reverse_hash < first
+					|| pos->node.reverse_hash > last)
+				nr_bad_range++;
+			prev = pos->node.reverse_hash;
+			pos->visited++;
+		}
+	}
+	rcu_read_unlock();
+	if (prev_last != ~0UL)
+		nr_bad_split++;
+	for (i = 0; i < NR_NODES; i++) {
+		if (nodes[i].visited != 1)
+			nr_bad_visit++;
+	}
+	ok(nr_bad_split == 0, "ranges cover the reverse hash space");
+	ok(nr_bad_order == 0, "range traversal in reverse hash order");
+	ok(nr_bad_range == 0, "range traversal within bounds");
+	ok(nr_bad_visit == 0, "each node visited once over all ranges");
+
+	/* Traversal from the middle of the table reaches its end. */
+	mid = nodes[NR_NODES / 2].node.reverse_hash;
+	rcu_read_lock();
+	for (cds_lfht_iter_from(ht, mid, &iter),
+			node = cds_lfht_iter_get_node(&iter);
+			node != NULL;
+			cds_lfht_next(ht, &iter),
+			node = cds_lfht_iter_get_node(&iter)) {
+		if (node->reverse_hash < mid)
+			nr_bad_from++;
+		nr_from++;
+	}
+	rcu_read_unlock();
+	for (i = 0; i < NR_NODES; i++) {
+		if (nodes[i].node.reverse_hash >= mid)
+			nr_from--;
+	}
+	ok(nr_bad_from == 0 && nr_from == 0, "iteration from reverse hash");
+
+	rcu_read_lock();
+	cds_lfht_for_each(ht, &iter, node) {
+		(void) cds_lfht_del(ht, node);
+	}
+	rcu_read_unlock();
+	if (cds_lfht_destroy(ht, NULL))
+		abort();
+	rcu_unregister_thread();
+	return exit_status();
+}
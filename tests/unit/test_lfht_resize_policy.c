@@ -0,0 +1,131 @@
+/*
+ * test_lfht_resize_policy.c
+ *
+ * Userspace RCU library - test cds_lfht resize policies
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#include <stdlib.h>
+#include <urcu.h>
+#include <urcu/rculfhash.h>
+
+#include "tap.h"
+
+#define NR_NODES	(1UL << 18)
+
+struct test_node {
+	struct cds_lfht_node node;
+};
+
+static struct test_node nodes[NR_NODES];
+
+struct resize_calls {
+	unsigned long nr_grow, nr_shrink;
+};
+
+static unsigned long test_hash(unsigned long key)
+{
+	return key * 2654435761UL;
+}
+
+static int count_resize(struct cds_lfht *ht, unsigned long size,
+		unsigned long new_size, void *priv)
+{
+	struct resize_calls *calls = priv;
+
+	if (new_size > size)
+		uatomic_inc(&calls->nr_grow);
+	else
+		uatomic_inc(&calls->nr_shrink);
+	return 1;
+}
+
+/*
+ * Fill a table, grow it to hold all nodes, then empty it, counting the
+ * automatic resizes allowed by the policy.
+ */
+static void fill_and_empty(struct cds_lfht_resize_policy *policy,
+		struct resize_calls *calls)
+{
+	struct cds_lfht *ht;
+	struct cds_lfht_iter iter;
+	struct cds_lfht_node *node;
+	unsigned long i;
+
+	policy->allow_resize = count_resize;
+	policy->priv = calls;
+	ht = cds_lfht_new_policy(1, 1, 0,
+		CDS_LFHT_AUTO_RESIZE | CDS_LFHT_ACCOUNTING, policy, NULL);
+	if (!ht)
+		abort();
+
+	/*
+	 * Short read-side critical sections let the lazy resizes,
+	 * which wait for grace periods, keep up with the adds.
+	 */
+	for (i = 0; i < NR_NODES; i++) {
+		cds_lfht_node_init(&nodes[i].node);
+		rcu_read_lock();
+		cds_lfht_add(ht, test_hash(i), &nodes[i].node);
+		rcu_read_unlock();
+	}
+	cds_lfht_resize(ht, NR_NODES);
+
+	rcu_read_lock();
+	cds_lfht_for_each(ht, &iter, node) {
+		(void) cds_lfht_del(ht, node);
+	}
+	rcu_read_unlock();
+	if (cds_lfht_destroy(ht, NULL))
+		abort();
+}
+
+int main(int argc, char **argv)
+{
+	struct cds_lfht_resize_policy policy = {
+		.target_load = 2,
+		.grow_load = 1,
+		.grow_chain_len = 3,
+	};
+	struct resize_calls calls = { 0 };
+
+	plan_tests(5);
+
+	rcu_register_thread();
+
+	ok(!cds_lfht_new_policy(1, 1, 0, CDS_LFHT_AUTO_RESIZE, &policy, NULL),
+		"grow_load below target_load rejected");
+
+	policy.grow_load = 8;
+	policy.shrink_div = 1;
+	fill_and_empty(&policy, &calls);
+	ok(calls.nr_grow > 0, "automatic grow reported to callback");
+	ok(calls.nr_shrink > 0, "automatic shrink reported to callback");
+
+	calls.nr_shrink = 0;
+	policy.shrink_div = 0;
+	fill_and_empty(&policy, &calls);
+	ok(calls.nr_shrink == 0, "shrink_div 0 never shrinks");
+
+	calls.nr_shrink = 0;
+	policy.shrink_div = 1;
+	policy.min_shrink_interval_ms = 3600 * 1000;
+	fill_and_empty(&policy, &calls);
+	ok(calls.nr_shrink == 0, "no shrink within minimum interval");
+
+	rcu_unregister_thread();
+	return exit_status();
+}
@@ -0,0 +1,166 @@
+/*
+ * test_lfht_resize_pool.c
+ *
+ * Userspace RCU library - test the cds_lfht resize thread pool
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#include <stdlib.h>
+#include <dirent.h>
+#include <pthread.h>
+#include <urcu.h>
+#include <urcu/rculfhash.h>
+
+#include "tap.h"
+
+#define NR_NODES	(1UL << 16)
+#define NR_TABLES	3
+#define NR_PASSES	10
+
+struct test_node {
+	unsigned long key;
+	struct cds_lfht_node node;
+};
+
+static struct test_node nodes[NR_TABLES][NR_NODES];
+
+static unsigned long test_hash(unsigned long key)
+{
+	return key * 2654435761UL;
+}
+
+static void visit(struct cds_lfht *ht, struct cds_lfht_node *node, void *arg)
+{
+	uatomic_inc((unsigned long *) arg);
+}
+
+/* Number of threads of the process, -1 if unknown. */
+static long nr_process_threads(void)
+{
+	struct dirent *entry;
+	long nr = 0;
+	DIR *dir;
+
+	dir = opendir("/proc/self/task");
+	if (!dir)
+		return -1;
+	while ((entry = readdir(dir)) != NULL) {
+		if (entry->d_name[0] != '.')
+			nr++;
+	}
+	closedir(dir);
+	return nr;
+}
+
+static struct cds_lfht *create_table(struct test_node *tnodes,
+		pthread_attr_t *attr)
+{
+	struct cds_lfht *ht;
+	unsigned long i;
+
+	ht = cds_lfht_new_flavor(NR_NODES, 1, 0, 0, &rcu_flavor, attr);
+	if (!ht)
+		abort();
+	rcu_read_lock();
+	for (i = 0; i < NR_NODES; i++) {
+		tnodes[i].key = i;
+		cds_lfht_node_init(&tnodes[i].node);
+		cds_lfht_add(ht, test_hash(i), &tnodes[i].node);
+	}
+	rcu_read_unlock();
+	return ht;
+}
+
+static void destroy_table(struct cds_lfht *ht)
+{
+	struct cds_lfht_iter iter;
+	struct cds_lfht_node *node;
+
+	rcu_read_lock();
+	cds_lfht_for_each(ht, &iter, node) {
+		(void) cds_lfht_del(ht, node);
+	}
+	rcu_read_unlock();
+	if (cds_lfht_destroy(ht, NULL))
+		abort();
+}
+
+/* Traverse with 4 threads, returns the number of nodes visited. */
+static unsigned long traverse(struct cds_lfht *ht, int nr_passes)
+{
+	unsigned long nr_visits = 0;
+	int i;
+
+	for (i = 0; i < nr_passes; i++)
+		cds_lfht_for_each_parallel(ht, 4, visit, &nr_visits);
+	return nr_visits;
+}
+
+int main(int argc, char **argv)
+{
+	struct cds_lfht *ht[NR_TABLES];
+	long nr_threads, nr_pool;
+	pthread_attr_t attr;
+
+	plan_tests(8);
+
+	rcu_register_thread();
+	nr_threads = nr_process_threads();
+
+	ht[0] = create_table(nodes[0], NULL);
+	ht[1] = create_table(nodes[1], NULL);
+
+	ok(traverse(ht[0], 1) == NR_NODES, "first traversal visits all nodes");
+	nr_pool = nr_process_threads() - nr_threads;
+	if (nr_threads < 0) {
+		skip(4, "/proc/self/task unavailable");
+	} else {
+		ok(nr_pool > 0 && nr_pool <= 3,
+			"pool threads created on demand (%ld)", nr_pool);
+		ok(traverse(ht[0], NR_PASSES) == NR_PASSES * NR_NODES
+			&& nr_process_threads() - nr_threads == nr_pool,
+			"pool threads reused across traversals");
+		ok(traverse(ht[1], NR_PASSES) == NR_PASSES * NR_NODES
+			&& nr_process_threads() - nr_threads == nr_pool,
+			"pool shared by tables with the same attributes");
+
+		pthread_attr_init(&attr);
+		ht[2] = create_table(nodes[2], &attr);
+		(void) traverse(ht[2], 1);
+		ok(nr_process_threads() - nr_threads > nr_pool,
+			"separate pool for other attributes");
+		destroy_table(ht[2]);
+		pthread_attr_destroy(&attr);
+	}
+	destroy_table(ht[1]);
+	ok(traverse(ht[0], 1) == NR_NODES,
+		"traversal after destroying a table sharing the pool");
+	destroy_table(ht[0]);
+	if (nr_threads < 0) {
+		skip(1, "/proc/self/task unavailable");
+	} else {
+		ok(nr_process_threads() == nr_threads,
+			"pool threads joined with the last table");
+	}
+
+	/* A new table gets a new pool. */
+	ht[0] = create_table(nodes[0], NULL);
+	ok(traverse(ht[0], 1) == NR_NODES, "traversal with a new pool");
+	destroy_table(ht[0]);
+
+	rcu_unregister_thread();
+	return exit_status();
+}
@@ -0,0 +1,91 @@
+/*
+ * test_lfht_resize_stats.c
+ *
+ * Userspace RCU library - test cds_lfht resize instrumentation
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#include <stdlib.h>
+#include <urcu.h>
+#include <urcu/rculfhash.h>
+
+#include "tap.h"
+
+#define GROW_SIZE	(1UL << 12)
+
+struct hook_calls {
+	unsigned long nr_start, nr_end;
+	struct cds_lfht_resize_event last_end;
+};
+
+static void resize_hook(struct cds_lfht *ht,
+		enum cds_lfht_resize_event_type type,
+		const struct cds_lfht_resize_event *event, void *priv)
+{
+	struct hook_calls *calls = priv;
+
+	if (type == CDS_LFHT_RESIZE_START) {
+		calls->nr_start++;
+	} else {
+		calls->nr_end++;
+		calls->last_end = *event;
+	}
+}
+
+int main(int argc, char **argv)
+{
+	struct cds_lfht *ht;
+	struct cds_lfht_resize_stats stats;
+	struct hook_calls calls = { 0 };
+
+	plan_tests(8);
+
+	rcu_register_thread();
+	ht = cds_lfht_new(1, 1, 0, 0, NULL);
+	if (!ht)
+		abort();
+	cds_lfht_set_resize_hook(ht, resize_hook, &calls);
+
+	cds_lfht_resize(ht, GROW_SIZE);
+	cds_lfht_get_resize_stats(ht, &stats);
+	ok(stats.nr_grow == 1 && stats.nr_shrink == 0 && !stats.in_progress,
+		"grow counted");
+	ok(stats.last.old_size == 1 && stats.last.new_size == GROW_SIZE,
+		"grow sizes");
+	ok(stats.last.nr_buckets == GROW_SIZE - 1,
+		"grow links %lu bucket nodes", stats.last.nr_buckets);
+
+	cds_lfht_resize(ht, 1);
+	cds_lfht_get_resize_stats(ht, &stats);
+	ok(stats.nr_shrink == 1 && stats.last.new_size == 1,
+		"shrink counted");
+	ok(stats.last.nr_gp_waits > 0, "shrink waits for grace periods");
+	ok(stats.nr_buckets == 2 * (GROW_SIZE - 1)
+		&& stats.total_duration_ns >= stats.max_duration_ns,
+		"cumulative stats");
+	ok(calls.nr_start == 2 && calls.nr_end == 2
+		&& calls.last_end.new_size == 1,
+		"hook called at start and end");
+	ok(stats.resize_lock.acquisitions >= 2
+		&& stats.resize_lock.contended <= stats.resize_lock.acquisitions,
+		"resize lock acquisitions counted (%lu)",
+		stats.resize_lock.acquisitions);
+
+	if (cds_lfht_destroy(ht, NULL))
+		abort();
+	rcu_unregister_thread();
+	return exit_status();
+}
@@ -0,0 +1,168 @@
+/*
+ * test_lfht_sharded.c
+ *
+ * Userspace RCU library - test the sharded cds_lfht
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#include <stdlib.h>
+#include <errno.h>
+#include <urcu.h>
+#include <urcu/rculfhash-sharded.h>
+
+#include "tap.h"
+
+#define NR_SHARDS	8
+#define NR_NODES	4096
+
+struct test_node {
+	unsigned long key;
+	unsigned long visited;
+	struct cds_lfht_node node;
+};
+
+static struct test_node nodes[NR_NODES];
+static struct test_node dup_node;
+
+static unsigned long test_hash(unsigned long key)
+{
+	return key * 2654435761UL ^ (key << (CAA_BITS_PER_LONG - 8));
+}
+
+static int test_match(struct cds_lfht_node *node, const void *key)
+{
+	struct test_node *tn = caa_container_of(node, struct test_node, node);
+
+	return tn->key == *(const unsigned long *) key;
+}
+
+static unsigned long count(struct cds_lfht_sharded *sht)
+{
+	long before, after;
+	unsigned long nr;
+
+	cds_lfht_sharded_count_nodes(sht, &before, &nr, &after);
+	return nr;
+}
+
+int main(int argc, char **argv)
+{
+	struct cds_lfht_sharded *sht;
+	struct cds_lfht_sharded_iter siter;
+	struct cds_lfht_iter iter;
+	struct cds_lfht_node *node;
+	struct test_node *tn;
+	unsigned long i, nr_bad, nr_shards_used, nr_visits;
+	unsigned long shard_nodes[NR_SHARDS] = { 0 };
+	struct cds_lfht *ht;
+
+	plan_tests(11);
+
+	rcu_register_thread();
+
+	ok(!cds_lfht_sharded_new(3, 1, 1, 0, CDS_LFHT_AUTO_RESIZE, NULL),
+		"number of shards must be a power of two");
+	sht = cds_lfht_sharded_new(NR_SHARDS, 1, 1, 0,
+			CDS_LFHT_AUTO_RESIZE | CDS_LFHT_ACCOUNTING, NULL);
+	if (!sht)
+		abort();
+	ok(cds_lfht_sharded_nr_shards(sht) == NR_SHARDS, "number of shards");
+
+	rcu_read_lock();
+	nr_bad = 0;
+	for (i = 0; i < NR_NODES; i++) {
+		nodes[i].key = i;
+		cds_lfht_node_init(&nodes[i].node);
+		if (cds_lfht_sharded_add_unique(sht, test_hash(i), test_match,
+				&i, &nodes[i].node) != &nodes[i].node)
+			nr_bad++;
+	}
+	rcu_read_unlock();
+	ok(nr_bad == 0 && count(sht) == NR_NODES, "all nodes added");
+
+	/* Each node is in the shard of the top bits of its hash. */
+	rcu_read_lock();
+	nr_bad = 0;
+	for (i = 0; i < NR_SHARDS; i++) {
+		ht = cds_lfht_sharded_shard_at(sht, i);
+		cds_lfht_for_each(ht, &iter, node) {
+			tn = caa_container_of(node, struct test_node, node);
+			if (cds_lfht_sharded_shard(sht, test_hash(tn->key)) != ht
+					|| cds_lfht_sharded_node_shard(sht, node) != ht)
+				nr_bad++;
+			shard_nodes[i]++;
+		}
+	}
+	rcu_read_unlock();
+	nr_shards_used = 0;
+	for (i = 0; i < NR_SHARDS; i++)
+		nr_shards_used += !!shard_nodes[i];
+	ok(nr_bad == 0, "nodes are in the shard of their hash");
+	ok(nr_shards_used == NR_SHARDS, "keys spread over all shards");
+
+	rcu_read_lock();
+	nr_bad = 0;
+	for (i = 0; i < NR_NODES; i++) {
+		cds_lfht_sharded_lookup(sht, test_hash(i), test_match, &i,
+				&iter);
+		if (cds_lfht_iter_get_node(&iter) != &nodes[i].node)
+			nr_bad++;
+	}
+	i = 42;
+	cds_lfht_node_init(&dup_node.node);
+	dup_node.key = i;
+	node = cds_lfht_sharded_add_unique(sht, test_hash(i), test_match, &i,
+			&dup_node.node);
+	rcu_read_unlock();
+	ok(nr_bad == 0, "all nodes found");
+	ok(node == &nodes[42].node, "add_unique returns the existing node");
+
+	rcu_read_lock();
+	nr_visits = 0;
+	cds_lfht_sharded_for_each_entry(sht, &siter, tn, node) {
+		tn->visited++;
+		nr_visits++;
+	}
+	rcu_read_unlock();
+	nr_bad = 0;
+	for (i = 0; i < NR_NODES; i++)
+		nr_bad += nodes[i].visited != 1;
+	ok(nr_visits == NR_NODES && nr_bad == 0,
+		"iteration visits each node once");
+
+	/* Remove the odd keys. */
+	rcu_read_lock();
+	nr_bad = 0;
+	for (i = 1; i < NR_NODES; i += 2) {
+		if (cds_lfht_sharded_del(sht, &nodes[i].node))
+			nr_bad++;
+	}
+	rcu_read_unlock();
+	ok(nr_bad == 0 && count(sht) == NR_NODES / 2, "odd keys removed");
+
+	ok(cds_lfht_sharded_destroy(sht, NULL) == -EPERM,
+		"destroy fails on non-empty shards");
+
+	rcu_read_lock();
+	cds_lfht_sharded_for_each(sht, &siter, node)
+		(void) cds_lfht_sharded_del(sht, node);
+	rcu_read_unlock();
+	ok(cds_lfht_sharded_destroy(sht, NULL) == 0,
+		"destroy once emptied");
+
+	rcu_unregister_thread();
+	return exit_status();
+}
@@ -0,0 +1,213 @@
+/*
+ * test_lfht_single_writer.c
+ *
+ * Userspace RCU library - test single writer hash tables
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#include <stdlib.h>
+#include <poll.h>
+#include <pthread.h>
+#include <urcu.h>
+#include <urcu/rculfhash.h>
+
+#include "tap.h"
+
+#define NR_READERS	2
+#define NR_STABLE	4096
+#define NR_CHURN	1024
+#define NR_ROUNDS	50
+
+struct test_node {
+	unsigned long key;
+	struct cds_lfht_node node;
+	struct rcu_head head;
+};
+
+static struct cds_lfht *ht;
+static struct test_node stable[NR_STABLE];
+static int stop_readers, writer_done;
+static unsigned long nr_misses, nr_lookups;
+static unsigned long nr_del_failed, nr_replace_failed;
+
+static unsigned long test_hash(unsigned long key)
+{
+	return key * 2654435761UL;
+}
+
+static int test_match(struct cds_lfht_node *node, const void *key)
+{
+	return caa_container_of(node, struct test_node, node)->key
+		== *(const unsigned long *) key;
+}
+
+static struct test_node *lookup(unsigned long key)
+{
+	struct cds_lfht_iter iter;
+	struct cds_lfht_node *node;
+
+	cds_lfht_lookup(ht, test_hash(key), test_match, &key, &iter);
+	node = cds_lfht_iter_get_node(&iter);
+	return node ? caa_container_of(node, struct test_node, node) : NULL;
+}
+
+static void free_node(struct rcu_head *head)
+{
+	free(caa_container_of(head, struct test_node, head));
+}
+
+static struct test_node *new_node(unsigned long key)
+{
+	struct test_node *node = malloc(sizeof(*node));
+
+	if (!node)
+		abort();
+	node->key = key;
+	cds_lfht_node_init(&node->node);
+	return node;
+}
+
+static void *thr_reader(void *arg)
+{
+	unsigned long i, misses = 0, lookups = 0;
+
+	rcu_register_thread();
+	while (!uatomic_read(&stop_readers)) {
+		rcu_read_lock();
+		for (i = 0; i < NR_STABLE; i++) {
+			if (lookup(i) != &stable[i])
+				misses++;
+		}
+		rcu_read_unlock();
+		lookups += NR_STABLE;
+	}
+	rcu_unregister_thread();
+	uatomic_add(&nr_misses, misses);
+	uatomic_add(&nr_lookups, lookups);
+	return NULL;
+}
+
+/*
+ * Only updater of the table: adds the churn keys, replaces half of
+ * them, and removes them all, each round.
+ */
+static void *thr_writer(void *arg)
+{
+	struct test_node *node, *old;
+	unsigned long r, k;
+
+	rcu_register_thread();
+	for (r = 0; r < NR_ROUNDS; r++) {
+		rcu_read_lock();
+		for (k = NR_STABLE; k < NR_STABLE + NR_CHURN; k++) {
+			node = new_node(k);
+			cds_lfht_add(ht, test_hash(k), &node->node);
+		}
+		for (k = NR_STABLE; k < NR_STABLE + NR_CHURN; k += 2) {
+			old = lookup(k);
+			node = new_node(k);
+			if (!old || cds_lfht_add_replace(ht, test_hash(k),
+					test_match, &k, &node->node)
+					!= &old->node) {
+				nr_replace_failed++;
+				continue;
+			}
+			call_rcu(&old->head, free_node);
+		}
+		for (k = NR_STABLE; k < NR_STABLE + NR_CHURN; k++) {
+			old = lookup(k);
+			if (!old || cds_lfht_del(ht, &old->node)) {
+				nr_del_failed++;
+				continue;
+			}
+			call_rcu(&old->head, free_node);
+		}
+		rcu_read_unlock();
+	}
+	rcu_barrier();
+	rcu_unregister_thread();
+	uatomic_set(&writer_done, 1);
+	return NULL;
+}
+
+int main(int argc, char **argv)
+{
+	pthread_t readers[NR_READERS], writer;
+	struct cds_lfht_iter iter;
+	struct cds_lfht_node *node;
+	unsigned long i, nr_found = 0, nr_resizes = 0, count;
+	long before, after;
+
+	plan_tests(5);
+
+	rcu_register_thread();
+	ht = cds_lfht_new(1, 1, 0, CDS_LFHT_AUTO_RESIZE | CDS_LFHT_SINGLE_WRITER,
+			NULL);
+	if (!ht)
+		abort();
+
+	rcu_read_lock();
+	for (i = 0; i < NR_STABLE; i++) {
+		stable[i].key = i;
+		cds_lfht_node_init(&stable[i].node);
+		cds_lfht_add(ht, test_hash(i), &stable[i].node);
+	}
+	rcu_read_unlock();
+
+	for (i = 0; i < NR_READERS; i++) {
+		if (pthread_create(&readers[i], NULL, thr_reader, NULL))
+			abort();
+	}
+	if (pthread_create(&writer, NULL, thr_writer, NULL))
+		abort();
+	/* Resizes link bucket nodes concurrently with the writer. */
+	while (!uatomic_read(&writer_done)) {
+		cds_lfht_resize(ht, (nr_resizes++ & 1) ? 1 : NR_STABLE * 4);
+		(void) poll(NULL, 0, 1);
+	}
+	if (pthread_join(writer, NULL))
+		abort();
+	uatomic_set(&stop_readers, 1);
+	for (i = 0; i < NR_READERS; i++) {
+		if (pthread_join(readers[i], NULL))
+			abort();
+	}
+
+	ok(!nr_misses, "readers find the stable keys (%lu lookups, %lu resizes)",
+		nr_lookups, nr_resizes);
+	ok(!nr_replace_failed, "replaces succeed");
+	ok(!nr_del_failed, "deletions own their node");
+
+	rcu_read_lock();
+	cds_lfht_count_nodes(ht, &before, &count, &after);
+	for (i = 0; i < NR_STABLE + NR_CHURN; i++) {
+		if (lookup(i) == (i < NR_STABLE ? &stable[i] : NULL))
+			nr_found++;
+	}
+	rcu_read_unlock();
+	ok(count == NR_STABLE, "node count");
+	ok(nr_found == NR_STABLE + NR_CHURN, "only the stable keys remain");
+
+	rcu_read_lock();
+	cds_lfht_for_each(ht, &iter, node) {
+		(void) cds_lfht_del(ht, node);
+	}
+	rcu_read_unlock();
+	if (cds_lfht_destroy(ht, NULL))
+		abort();
+	rcu_unregister_thread();
+	return exit_status();
+}
@@ -0,0 +1,284 @@
+/*
+ * test_lfht_snapshot.c
+ *
+ * Userspace RCU library - test point-in-time snapshots of cds_lfht
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#include <stdlib.h>
+#include <errno.h>
+#include <poll.h>
+#include <pthread.h>
+#include <urcu.h>
+#include <urcu/rculfhash-snapshot.h>
+
+#include "tap.h"
+
+#define NR_ENTRIES	100
+#define NR_KEYS		64
+#define NR_ROUNDS	50
+
+struct test_entry {
+	struct cds_lfht_snap_node snode;
+	unsigned long key;
+	unsigned long value;
+};
+
+static unsigned long nr_freed;
+static int stop_updater;
+
+static unsigned long test_hash(unsigned long key)
+{
+	return key * 2654435761UL ^ (key << (CAA_BITS_PER_LONG - 8));
+}
+
+static int test_match(struct cds_lfht_node *node, const void *key)
+{
+	struct test_entry *e = caa_container_of(node, struct test_entry,
+			snode.node);
+
+	return e->key == *(const unsigned long *) key;
+}
+
+static void free_entry(struct rcu_head *head)
+{
+	struct test_entry *e = caa_container_of(head, struct test_entry,
+			snode.rcu_head);
+
+	free(e);
+	uatomic_inc(&nr_freed);
+}
+
+static struct test_entry *new_entry(unsigned long key, unsigned long value)
+{
+	struct test_entry *e = malloc(sizeof(*e));
+
+	if (!e)
+		abort();
+	e->key = key;
+	e->value = value;
+	cds_lfht_node_init(&e->snode.node);
+	return e;
+}
+
+static void add(struct cds_lfht_snap *snap, unsigned long key,
+		unsigned long value)
+{
+	rcu_read_lock();
+	cds_lfht_snap_add(snap, test_hash(key), &new_entry(key, value)->snode);
+	rcu_read_unlock();
+}
+
+static struct test_entry *lookup(struct cds_lfht_snap *snap,
+		unsigned long epoch, unsigned long key)
+{
+	struct cds_lfht_snap_node *node;
+
+	node = cds_lfht_snap_lookup(snap, epoch, test_hash(key), test_match,
+			&key);
+	return node ? caa_container_of(node, struct test_entry, snode) : NULL;
+}
+
+/* Replace the live entry of key by one of value, or delete it if 0. */
+static int update(struct cds_lfht_snap *snap, unsigned long key,
+		unsigned long value)
+{
+	struct test_entry *e;
+	int ret = -ENOENT;
+
+	rcu_read_lock();
+	e = lookup(snap, CDS_LFHT_SNAP_LIVE, key);
+	if (e && value)
+		ret = cds_lfht_snap_replace(snap, test_hash(key), &e->snode,
+				&new_entry(key, value)->snode);
+	else if (e)
+		ret = cds_lfht_snap_del(snap, &e->snode);
+	rcu_read_unlock();
+	return ret;
+}
+
+/* Number and sum of the values of the entries seen at epoch. */
+static unsigned long scan(struct cds_lfht *ht, unsigned long epoch,
+		unsigned long *sum)
+{
+	struct cds_lfht_iter iter;
+	struct test_entry *e;
+	unsigned long nr = 0;
+
+	*sum = 0;
+	rcu_read_lock();
+	cds_lfht_snap_for_each_entry(ht, epoch, &iter, e, snode) {
+		nr++;
+		*sum += e->value;
+	}
+	rcu_read_unlock();
+	return nr;
+}
+
+static unsigned long close_snapshot(struct cds_lfht_snap *snap,
+		struct cds_lfht_snapshot *snapshot)
+{
+	unsigned long nr;
+
+	rcu_read_lock();
+	nr = cds_lfht_snap_close(snap, snapshot);
+	rcu_read_unlock();
+	return nr;
+}
+
+static void *thr_updater(void *arg)
+{
+	struct cds_lfht_snap *snap = arg;
+	unsigned long key = 0;
+
+	rcu_register_thread();
+	while (!uatomic_read(&stop_updater)) {
+		rcu_read_lock();
+		/* Values of a key grow by NR_KEYS. */
+		if (update(snap, key, lookup(snap, CDS_LFHT_SNAP_LIVE,
+				key)->value + NR_KEYS))
+			abort();
+		rcu_read_unlock();
+		key = (key + 1) % NR_KEYS;
+	}
+	rcu_unregister_thread();
+	return NULL;
+}
+
+int main(int argc, char **argv)
+{
+	struct cds_lfht_snapshot s1, s2;
+	struct cds_lfht_snap *snap;
+	struct cds_lfht_snap_node *node;
+	struct cds_lfht *ht;
+	struct test_entry *e;
+	unsigned long i, nr, sum, sum2, nr_reclaimed, nr_bad = 0;
+	long before, after;
+	pthread_t tid;
+
+	plan_tests(14);
+
+	rcu_register_thread();
+	ht = cds_lfht_new(16, 16, 0, CDS_LFHT_AUTO_RESIZE, NULL);
+	snap = cds_lfht_snap_new(ht, free_entry);
+	if (!ht || !snap)
+		abort();
+
+	for (i = 0; i < NR_ENTRIES; i++)
+		add(snap, i, i);
+	cds_lfht_snap_take(snap, &s1);
+	nr = scan(ht, s1.epoch, &sum);
+	ok(nr == NR_ENTRIES && sum == NR_ENTRIES * (NR_ENTRIES - 1) / 2,
+		"snapshot sees the entries added before");
+
+	/* Update 0-49, delete 50-59, add 100-109. */
+	for (i = 0; i < 50; i++)
+		update(snap, i, i + 1000);
+	for (i = 50; i < 60; i++)
+		update(snap, i, 0);
+	for (i = 100; i < 110; i++)
+		add(snap, i, i);
+	nr = scan(ht, s1.epoch, &sum);
+	ok(nr == NR_ENTRIES && sum == NR_ENTRIES * (NR_ENTRIES - 1) / 2,
+		"snapshot ignores later updates");
+	nr = scan(ht, CDS_LFHT_SNAP_LIVE, &sum);
+	ok(nr == NR_ENTRIES && sum == NR_ENTRIES * (NR_ENTRIES - 1) / 2
+			+ 50 * 1000 - (50 + 59) * 5 + (100 + 109) * 5,
+		"live view sees the updates");
+
+	rcu_read_lock();
+	ok((e = lookup(snap, s1.epoch, 5)) && e->value == 5
+			&& (e = lookup(snap, CDS_LFHT_SNAP_LIVE, 5))
+			&& e->value == 1005,
+		"lookup finds the version of the epoch");
+	ok(lookup(snap, s1.epoch, 55) && !lookup(snap, CDS_LFHT_SNAP_LIVE, 55)
+			&& !lookup(snap, s1.epoch, 105)
+			&& lookup(snap, CDS_LFHT_SNAP_LIVE, 105),
+		"deletions and additions are per epoch");
+	e = lookup(snap, s1.epoch, 55);
+	ok(cds_lfht_snap_del(snap, &e->snode) == -ENOENT,
+		"deleting twice fails");
+	cds_lfht_count_nodes(ht, &before, &nr, &after);
+	rcu_read_unlock();
+	rcu_barrier();
+	ok(nr == NR_ENTRIES + 60 && !nr_freed,
+		"entries seen by the snapshot stay in the table (%lu)", nr);
+
+	cds_lfht_snap_take(snap, &s2);
+	nr = scan(ht, s2.epoch, &sum);
+	ok(nr == NR_ENTRIES && sum == NR_ENTRIES * (NR_ENTRIES - 1) / 2
+			+ 50 * 1000 - (50 + 59) * 5 + (100 + 109) * 5
+			&& cds_lfht_snap_destroy(snap) == -EBUSY,
+		"second snapshot sees the live view");
+
+	nr_reclaimed = close_snapshot(snap, &s1);
+	rcu_barrier();
+	ok(nr_reclaimed == 60 && nr_freed == 60,
+		"closing the oldest snapshot reclaims what it saw (%lu)",
+		nr_reclaimed);
+
+	update(snap, 0, 0);
+	nr_reclaimed = close_snapshot(snap, &s2);
+	update(snap, 1, 0);
+	rcu_barrier();
+	ok(nr_reclaimed == 1 && nr_freed == 62,
+		"deletions without snapshot are reclaimed at once");
+
+	rcu_read_lock();
+	e = new_entry(1, 1);
+	node = cds_lfht_snap_add_unique(snap, test_hash(1), test_match,
+			&(unsigned long) { 1 }, &e->snode);
+	ok(node == &e->snode, "add unique ignores deleted entries");
+	e = new_entry(2, 2);
+	node = cds_lfht_snap_add_unique(snap, test_hash(2), test_match,
+			&(unsigned long) { 2 }, &e->snode);
+	ok(node != &e->snode, "add unique finds live entries");
+	free(e);
+	rcu_read_unlock();
+
+	/* Reset to keys 0 to NR_KEYS - 1, of value their key. */
+	for (i = 0; i < 110; i++)
+		update(snap, i, 0);
+	for (i = 0; i < NR_KEYS; i++)
+		add(snap, i, i);
+
+	if (pthread_create(&tid, NULL, thr_updater, snap))
+		abort();
+	for (i = 0; i < NR_ROUNDS; i++) {
+		cds_lfht_snap_take(snap, &s1);
+		nr = scan(ht, s1.epoch, &sum);
+		(void) poll(NULL, 0, 1);
+		if (scan(ht, s1.epoch, &sum2) != nr || sum2 != sum
+				|| nr != NR_KEYS
+				|| sum % NR_KEYS != NR_KEYS * (NR_KEYS - 1) / 2
+					% NR_KEYS)
+			nr_bad++;
+		close_snapshot(snap, &s1);
+	}
+	uatomic_set(&stop_updater, 1);
+	if (pthread_join(tid, NULL))
+		abort();
+	ok(!nr_bad, "snapshots are stable under concurrent updates");
+
+	for (i = 0; i < NR_KEYS; i++)
+		update(snap, i, 0);
+	rcu_barrier();
+	ok(cds_lfht_snap_destroy(snap) == 0 && cds_lfht_destroy(ht, NULL) == 0,
+		"destroy");
+
+	rcu_unregister_thread();
+	return exit_status();
+}
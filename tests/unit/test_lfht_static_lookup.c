@@ -0,0 +1,120 @@
+/*
+ * test_lfht_static_lookup.c
+ *
+ * Userspace RCU library - test cds_lfht inline lookup fast path
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#define _LGPL_SOURCE
+#include <stdlib.h>
+#include <urcu.h>
+#include <urcu/rculfhash.h>
+
+#include "tap.h"
+
+#define NR_NODES	(1UL << 14)
+#define NR_DUP		3
+#define MAX_BUCKETS	(1UL << 16)
+
+struct test_node {
+	unsigned long key;
+	struct cds_lfht_node node;
+};
+
+static struct test_node nodes[NR_NODES];
+
+static unsigned long test_hash(unsigned long key)
+{
+	return key * 2654435761UL;
+}
+
+static int test_match(struct cds_lfht_node *node, const void *key)
+{
+	return caa_container_of(node, struct test_node, node)->key
+		== *(const unsigned long *) key;
+}
+
+/*
+ * Keys i / NR_DUP have NR_DUP nodes each. Look them up once the table
+ * grew to index buckets of several orders, or chunks.
+ */
+static void test_mm(const struct cds_lfht_mm_type *mm, const char *name)
+{
+	struct cds_lfht *ht;
+	struct cds_lfht_iter iter;
+	unsigned long i, key, nr_keys = 0, nr_dup = 0;
+	int missing = 0;
+
+	ht = _cds_lfht_new(1, 4, MAX_BUCKETS, CDS_LFHT_AUTO_RESIZE, mm,
+		&rcu_flavor, NULL);
+	if (!ht)
+		abort();
+
+	rcu_read_lock();
+	for (i = 0; i < NR_NODES; i++) {
+		nodes[i].key = i / NR_DUP;
+		cds_lfht_node_init(&nodes[i].node);
+		cds_lfht_add(ht, test_hash(nodes[i].key), &nodes[i].node);
+	}
+	rcu_read_unlock();
+	cds_lfht_resize(ht, MAX_BUCKETS / 4);
+
+	rcu_read_lock();
+	for (key = 0; key < NR_NODES / NR_DUP; key++) {
+		unsigned long count = 0;
+
+		/* Mapped to the inline _cds_lfht_lookup. */
+		cds_lfht_lookup(ht, test_hash(key), test_match, &key, &iter);
+		if (cds_lfht_iter_get_node(&iter))
+			nr_keys++;
+		while (cds_lfht_iter_get_node(&iter)) {
+			count++;
+			cds_lfht_next_duplicate(ht, test_match, &key, &iter);
+		}
+		if (count == NR_DUP)
+			nr_dup++;
+	}
+	key = NR_NODES;
+	_cds_lfht_lookup(ht, test_hash(key), test_match, &key, &iter);
+	missing = !cds_lfht_iter_get_node(&iter);
+	rcu_read_unlock();
+
+	ok(nr_keys == NR_NODES / NR_DUP && nr_dup == NR_NODES / NR_DUP,
+		"%s: inline lookup finds all keys and duplicates", name);
+	ok(missing, "%s: inline lookup of missing key", name);
+
+	rcu_read_lock();
+	for (i = 0; i < NR_NODES; i++)
+		(void) cds_lfht_del(ht, &nodes[i].node);
+	rcu_read_unlock();
+	synchronize_rcu();
+	if (cds_lfht_destroy(ht, NULL))
+		abort();
+}
+
+int main(int argc, char **argv)
+{
+	plan_tests(10);
+
+	rcu_register_thread();
+	test_mm(&cds_lfht_mm_order, "order");
+	test_mm(&cds_lfht_mm_chunk, "chunk");
+	test_mm(&cds_lfht_mm_mmap, "mmap");
+	test_mm(&cds_lfht_mm_hugepage, "hugepage");
+	test_mm(&cds_lfht_mm_mmap_compact, "mmap_compact");
+	rcu_unregister_thread();
+	return exit_status();
+}
@@ -0,0 +1,140 @@
+/*
+ * test_lfht_tag.c
+ *
+ * Userspace RCU library - test cds_lfht tagged nodes
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#include <stdlib.h>
+#include <urcu.h>
+#include <urcu/rculfhash.h>
+
+#include "tap.h"
+
+#define NR_KEYS		1000
+/* All keys collide on a few hashes: lookups rely on the tags. */
+#define NR_HASHES	4
+
+struct test_node {
+	unsigned long key;
+	struct cds_lfht_tag_node tnode;
+};
+
+static struct test_node nodes[NR_KEYS];
+static struct test_node dups[NR_KEYS];
+static unsigned long nr_match_calls;
+
+static unsigned long test_hash(unsigned long key)
+{
+	return key % NR_HASHES;
+}
+
+static unsigned long test_tag(unsigned long key)
+{
+	return key;
+}
+
+static int test_match(struct cds_lfht_node *node, const void *key)
+{
+	struct test_node *tn = caa_container_of(node, struct test_node,
+			tnode.node);
+
+	nr_match_calls++;
+	return tn->key == *(const unsigned long *) key;
+}
+
+int main(int argc, char **argv)
+{
+	struct cds_lfht *ht;
+	struct cds_lfht_iter iter;
+	struct cds_lfht_node *ret;
+	unsigned long i, key, nr_found = 0, nr_bad = 0, nr_dup = 0;
+
+	plan_tests(5);
+
+	rcu_register_thread();
+	ht = cds_lfht_new(1, 1, 0, CDS_LFHT_NODE_TAG, NULL);
+	if (!ht)
+		abort();
+
+	rcu_read_lock();
+	for (i = 0; i < NR_KEYS; i++) {
+		nodes[i].key = i;
+		cds_lfht_tag_node_init(&nodes[i].tnode, test_tag(i));
+		ret = cds_lfht_add_unique(ht, test_hash(i), test_match,
+				&nodes[i].key, &nodes[i].tnode.node);
+		if (ret != &nodes[i].tnode.node)
+			nr_bad++;
+	}
+	rcu_read_unlock();
+	ok(nr_bad == 0, "add_unique of distinct keys with colliding hashes");
+
+	nr_match_calls = 0;
+	rcu_read_lock();
+	for (i = 0; i < NR_KEYS; i++) {
+		key = i;
+		cds_lfht_lookup_tag(ht, test_hash(key), test_tag(key),
+				test_match, &key, &iter);
+		if (cds_lfht_iter_get_node(&iter) == &nodes[i].tnode.node)
+			nr_found++;
+	}
+	rcu_read_unlock();
+	ok(nr_found == NR_KEYS, "lookup_tag finds all keys");
+	ok(nr_match_calls == NR_KEYS,
+		"match called only for nodes with the same tag (%lu calls)",
+		nr_match_calls);
+
+	/* Same key and tag: rejected by add_unique. */
+	nr_bad = 0;
+	rcu_read_lock();
+	for (i = 0; i < NR_KEYS; i++) {
+		dups[i].key = i;
+		cds_lfht_tag_node_init(&dups[i].tnode, test_tag(i));
+		ret = cds_lfht_add_unique(ht, test_hash(i), test_match,
+				&dups[i].key, &dups[i].tnode.node);
+		if (ret != &nodes[i].tnode.node)
+			nr_bad++;
+	}
+	rcu_read_unlock();
+	ok(nr_bad == 0, "add_unique rejects existing keys");
+
+	/* Duplicates added with cds_lfht_add are found by next_duplicate_tag. */
+	rcu_read_lock();
+	for (i = 0; i < NR_KEYS; i++)
+		cds_lfht_add(ht, test_hash(i), &dups[i].tnode.node);
+	for (i = 0; i < NR_KEYS; i++) {
+		key = i;
+		cds_lfht_lookup_tag(ht, test_hash(key), test_tag(key),
+				test_match, &key, &iter);
+		while (cds_lfht_iter_get_node(&iter)) {
+			nr_dup++;
+			cds_lfht_next_duplicate_tag(ht, test_tag(key),
+					test_match, &key, &iter);
+		}
+	}
+	rcu_read_unlock();
+	ok(nr_dup == 2 * NR_KEYS, "next_duplicate_tag finds duplicates");
+
+	rcu_read_lock();
+	cds_lfht_for_each(ht, &iter, ret) {
+		(void) cds_lfht_del(ht, ret);
+	}
+	rcu_read_unlock();
+	if (cds_lfht_destroy(ht, NULL))
+		abort();
+	rcu_unregister_thread();
+	return exit_status();
+}
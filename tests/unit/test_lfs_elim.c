@@ -0,0 +1,121 @@
+/*
+ * test_lfs_elim.c
+ *
+ * Userspace RCU library - test lfstack elimination array
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#include <stdlib.h>
+#include <pthread.h>
+
+#define _LGPL_SOURCE
+#include <urcu/uatomic.h>
+#include <urcu/lfstack.h>
+
+#include "tap.h"
+
+#define NR_THREADS	4
+#define NR_PER_THREAD	100000
+
+struct test_node {
+	struct cds_lfs_node node;
+	int popped;
+};
+
+static struct cds_lfs_stack s;
+static struct cds_lfs_elim elim;
+static struct test_node nodes[NR_THREADS][NR_PER_THREAD];
+static unsigned long nr_popped;
+static int nr_bad;
+
+static void *pusher_fn(void *arg)
+{
+	struct test_node *tn = nodes[(unsigned long) arg];
+	unsigned long i;
+
+	for (i = 0; i < NR_PER_THREAD; i++) {
+		cds_lfs_node_init(&tn[i].node);
+		(void) cds_lfs_push_elim(&s, &elim, &tn[i].node);
+	}
+	return NULL;
+}
+
+static void *popper_fn(void *arg)
+{
+	struct cds_lfs_node *node;
+	struct test_node *tn;
+
+	while (uatomic_read(&nr_popped) < NR_THREADS * NR_PER_THREAD) {
+		node = cds_lfs_pop_elim_blocking(&s, &elim);
+		if (!node)
+			continue;
+		tn = caa_container_of(node, struct test_node, node);
+		if (tn->popped++)
+			uatomic_inc(&nr_bad);
+		uatomic_inc(&nr_popped);
+	}
+	return NULL;
+}
+
+int main(int argc, char **argv)
+{
+	pthread_t pushers[NR_THREADS], poppers[NR_THREADS];
+	struct test_node a, b, offered;
+	unsigned long i;
+	int empty = 1;
+
+	plan_tests(5);
+
+	cds_lfs_init(&s);
+	cds_lfs_elim_init(&elim);
+	for (i = 0; i < CDS_LFS_ELIM_SLOTS; i++)
+		empty &= !elim.slots[i].node;
+	ok(empty, "elimination array starts empty");
+
+	cds_lfs_node_init(&a.node);
+	cds_lfs_node_init(&b.node);
+	ok(!cds_lfs_push_elim(&s, &elim, &a.node)
+		&& cds_lfs_push_elim(&s, &elim, &b.node)
+		&& cds_lfs_pop_elim_blocking(&s, &elim) == &b.node
+		&& cds_lfs_pop_elim_blocking(&s, &elim) == &a.node
+		&& !cds_lfs_pop_elim_blocking(&s, &elim),
+		"uncontended push and pop use the stack");
+
+	/* A node offered in a slot is taken once. */
+	elim.slots[CDS_LFS_ELIM_SLOTS - 1].node = &offered.node;
+	ok(___cds_lfs_elim_pop(&elim) == &offered.node
+		&& !___cds_lfs_elim_pop(&elim),
+		"pop takes an offered node once");
+
+	for (i = 0; i < NR_THREADS; i++) {
+		if (pthread_create(&poppers[i], NULL, popper_fn, NULL))
+			abort();
+		if (pthread_create(&pushers[i], NULL, pusher_fn, (void *) i))
+			abort();
+	}
+	for (i = 0; i < NR_THREADS; i++) {
+		if (pthread_join(pushers[i], NULL))
+			abort();
+		if (pthread_join(poppers[i], NULL))
+			abort();
+	}
+	ok(nr_popped == NR_THREADS * NR_PER_THREAD && cds_lfs_empty(&s),
+		"every pushed node is popped");
+	ok(!nr_bad, "no node is popped twice");
+
+	cds_lfs_destroy(&s);
+	return exit_status();
+}
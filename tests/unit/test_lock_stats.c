@@ -0,0 +1,113 @@
+/*
+ * test_lock_stats.c
+ *
+ * Userspace RCU library - test internal mutex contention statistics
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#include <stdlib.h>
+#include <poll.h>
+#include <pthread.h>
+#include <urcu.h>
+
+#include "urcu-mutex.h"
+#include "tap.h"
+
+#define HOLD_MS		20
+
+static pthread_mutex_t mutex = PTHREAD_MUTEX_INITIALIZER;
+static struct urcu_lock_stats stats;
+static int nr_polls;
+
+static void count_poll(void)
+{
+	nr_polls++;
+}
+
+static void *thr_lock(void *arg)
+{
+	urcu_mutex_lock(&mutex, &stats);
+	if (pthread_mutex_unlock(&mutex))
+		abort();
+	return NULL;
+}
+
+static void *thr_lock_poll(void *arg)
+{
+	urcu_mutex_lock_poll(&mutex, &stats, count_poll);
+	if (pthread_mutex_unlock(&mutex))
+		abort();
+	return NULL;
+}
+
+/* Have a thread wait for the mutex held for HOLD_MS. */
+static void contend(void *(*fct)(void *))
+{
+	pthread_t tid;
+
+	if (pthread_mutex_lock(&mutex))
+		abort();
+	if (pthread_create(&tid, NULL, fct, NULL))
+		abort();
+	(void) poll(NULL, 0, HOLD_MS);
+	if (pthread_mutex_unlock(&mutex))
+		abort();
+	if (pthread_join(tid, NULL))
+		abort();
+}
+
+int main(int argc, char **argv)
+{
+	struct urcu_stats before, after;
+
+	plan_tests(5);
+
+	urcu_mutex_lock(&mutex, &stats);
+	if (pthread_mutex_unlock(&mutex))
+		abort();
+	ok(stats.acquisitions == 1 && !stats.contended && !stats.wait_ns,
+		"uncontended acquisition");
+
+	contend(thr_lock);
+	ok(stats.acquisitions == 2 && stats.contended == 1
+		&& stats.wait_ns >= HOLD_MS * 1000000ULL / 2
+		&& stats.wait_max_ns == stats.wait_ns,
+		"contended acquisition waits (%llu ns)",
+		(unsigned long long) stats.wait_ns);
+
+	contend(thr_lock_poll);
+	ok(stats.acquisitions == 3 && stats.contended == 2 && nr_polls > 0
+		&& stats.wait_ns >= stats.wait_max_ns,
+		"adaptive polling acquisition (%d polls)", nr_polls);
+
+	rcu_get_stats(&before);
+	rcu_register_thread();
+	synchronize_rcu();
+	rcu_barrier();
+	rcu_get_stats(&after);
+	ok(after.gp_lock.acquisitions > before.gp_lock.acquisitions
+		&& after.registry_lock.acquisitions
+			> before.registry_lock.acquisitions,
+		"grace-period and registry locks counted");
+	ok(after.call_rcu_lock.acquisitions
+			> before.call_rcu_lock.acquisitions
+		&& after.call_rcu_lock.contended
+			<= after.call_rcu_lock.acquisitions,
+		"call_rcu lock counted");
+	rcu_unregister_thread();
+
+	return exit_status();
+}
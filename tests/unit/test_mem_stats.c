@@ -0,0 +1,179 @@
+/*
+ * test_mem_stats.c
+ *
+ * Userspace RCU library - test memory-footprint accounting
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#include <stdlib.h>
+#include <poll.h>
+#include <pthread.h>
+#include <urcu.h>
+#include <urcu-defer.h>
+#include <urcu/rculfhash.h>
+
+#include "tap.h"
+
+#define NR_OBJS		100
+#define OBJ_SIZE	1000
+#define NR_DEFER	10
+#define GROW_SIZE	(1UL << 12)
+#define MAX_BUCKETS	(1UL << 16)
+
+struct test_obj {
+	struct rcu_head_sized head;
+	char payload[OBJ_SIZE - sizeof(struct rcu_head_sized)];
+};
+
+static unsigned long nr_freed;
+static int reader_locked, reader_release;
+
+static void free_obj(struct rcu_head *head)
+{
+	free(caa_container_of(head, struct test_obj, head.head));
+	uatomic_inc(&nr_freed);
+}
+
+/* Holds a read-side critical section, delaying grace periods. */
+static void *thr_reader(void *arg)
+{
+	rcu_register_thread();
+	rcu_read_lock();
+	uatomic_set(&reader_locked, 1);
+	while (!uatomic_read(&reader_release))
+		(void) poll(NULL, 0, 1);
+	rcu_read_unlock();
+	rcu_unregister_thread();
+	return NULL;
+}
+
+static void test_call_rcu(void)
+{
+	struct urcu_mem_stats stats;
+	pthread_t tid;
+	int i;
+
+	if (pthread_create(&tid, NULL, thr_reader, NULL))
+		abort();
+	while (!uatomic_read(&reader_locked))
+		(void) poll(NULL, 0, 1);
+	for (i = 0; i < NR_OBJS; i++) {
+		struct test_obj *obj = malloc(sizeof(*obj));
+
+		if (!obj)
+			abort();
+		call_rcu_sized(&obj->head, free_obj, sizeof(*obj));
+	}
+	for (i = 0; i < NR_DEFER; i++)
+		defer_rcu(free, malloc(OBJ_SIZE));
+	rcu_get_mem_stats(&stats);
+	ok(stats.call_rcu_pending >= NR_OBJS && stats.call_rcu_bytes > 0
+			&& stats.call_rcu_pending_bytes
+				== NR_OBJS * sizeof(struct test_obj),
+		"pending callbacks and their sizes accounted (%lu, %zu bytes)",
+		stats.call_rcu_pending, stats.call_rcu_pending_bytes);
+	ok(stats.defer_bytes > 0 && stats.defer_pending >= NR_DEFER,
+		"defer queue accounted (%zu bytes, %lu entries)",
+		stats.defer_bytes, stats.defer_pending);
+
+	uatomic_set(&reader_release, 1);
+	if (pthread_join(tid, NULL))
+		abort();
+	rcu_barrier();
+	rcu_defer_barrier();
+	rcu_get_mem_stats(&stats);
+	ok(uatomic_read(&nr_freed) == NR_OBJS && !stats.call_rcu_pending_bytes
+			&& !stats.defer_pending,
+		"callbacks invoked and sizes released");
+}
+
+static void test_lfht(const struct cds_lfht_mm_type *mm, int retention,
+		const char *name)
+{
+	struct cds_lfht_mem_stats stats;
+	struct cds_lfht *ht;
+	size_t initial;
+
+	ht = _cds_lfht_new(1, 1, MAX_BUCKETS, 0, mm, &rcu_flavor, NULL);
+	if (!ht)
+		abort();
+	cds_lfht_get_mem_stats(ht, &stats);
+	initial = stats.bucket_bytes;
+
+	cds_lfht_resize(ht, GROW_SIZE);
+	cds_lfht_get_mem_stats(ht, &stats);
+	ok(stats.bucket_bytes == GROW_SIZE * sizeof(struct cds_lfht_node),
+		"%s: grow accounted (%zu bytes)", name, stats.bucket_bytes);
+	cds_lfht_resize(ht, 1);
+	cds_lfht_get_mem_stats(ht, &stats);
+	ok(initial > 0 && stats.bucket_bytes == initial,
+		"%s: shrink accounted (%zu bytes)", name, stats.bucket_bytes);
+
+	if (retention) {
+		size_t retained;
+
+		cds_lfht_set_mm_retention(ht, GROW_SIZE
+				* sizeof(struct cds_lfht_node), 0);
+		cds_lfht_resize(ht, GROW_SIZE);
+		cds_lfht_resize(ht, 1);
+		cds_lfht_get_mem_stats(ht, &stats);
+		retained = stats.bucket_bytes;
+		cds_lfht_set_mm_retention(ht, 0, 0);
+		cds_lfht_resize(ht, GROW_SIZE);
+		cds_lfht_resize(ht, 1);
+		cds_lfht_get_mem_stats(ht, &stats);
+		ok(retained == GROW_SIZE * sizeof(struct cds_lfht_node)
+				&& stats.bucket_bytes == initial,
+			"%s: retained memory accounted until released",
+			name);
+	} else {
+		ok(1, "%s: retained memory accounted (no retention)", name);
+	}
+
+	if (cds_lfht_destroy(ht, NULL))
+		abort();
+}
+
+int main(int argc, char **argv)
+{
+	struct cds_lfht_mem_stats stats;
+	struct cds_lfht *ht;
+
+	plan_tests(13);
+
+	rcu_register_thread();
+	if (rcu_defer_register_thread())
+		abort();
+	test_call_rcu();
+	rcu_defer_unregister_thread();
+
+	test_lfht(&cds_lfht_mm_order, 0, "order");
+	test_lfht(&cds_lfht_mm_chunk, 1, "chunk");
+	test_lfht(&cds_lfht_mm_mmap, 1, "mmap");
+
+	ht = cds_lfht_new(1, 1, 0, CDS_LFHT_ACCOUNTING, NULL);
+	if (!ht)
+		abort();
+	cds_lfht_get_mem_stats(ht, &stats);
+	ok(stats.table_bytes > 0 && stats.split_count_bytes > 0,
+		"table and split counters accounted (%zu, %zu bytes)",
+		stats.table_bytes, stats.split_count_bytes);
+	if (cds_lfht_destroy(ht, NULL))
+		abort();
+
+	rcu_unregister_thread();
+	return exit_status();
+}
@@ -0,0 +1,142 @@
+/*
+ * test_mpmc_ring.c
+ *
+ * Userspace RCU library - test bounded MPMC ring
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#include <errno.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <pthread.h>
+#include <sched.h>
+#include <urcu/uatomic.h>
+
+#define _LGPL_SOURCE
+#include <urcu/mpmcring.h>
+
+#include "tap.h"
+
+#define CAPACITY	64
+#define BATCH		5
+#define NR_THREADS	4
+#define NR_PER_THREAD	100000
+
+static struct cds_mpmc_ring ring;
+static struct cds_mpmc_ring_slot slots[CAPACITY];
+static unsigned long sum_in, sum_out, nr_out;
+static unsigned char seen[NR_THREADS * NR_PER_THREAD];
+static int nr_bad;
+
+static void *producer_fn(void *arg)
+{
+	uintptr_t base = (uintptr_t) arg * NR_PER_THREAD, i = 0, k;
+	void *batch[BATCH];
+	unsigned long n;
+
+	while (i < NR_PER_THREAD) {
+		if (i & 1) {
+			if (cds_mpmc_ring_try_enqueue(&ring,
+					(void *) (base + i + 1)))
+				i++;
+			else
+				sched_yield();
+			continue;
+		}
+		for (k = 0; k < BATCH && i + k < NR_PER_THREAD; k++)
+			batch[k] = (void *) (base + i + k + 1);
+		n = cds_mpmc_ring_enqueue_bulk(&ring, batch, k);
+		if (!n)
+			sched_yield();	/* Let consumers run on small systems. */
+		i += n;
+	}
+	return NULL;
+}
+
+static void *consumer_fn(void *arg)
+{
+	void *batch[BATCH];
+	unsigned long n, k, v;
+
+	while (uatomic_read(&nr_out) < NR_THREADS * NR_PER_THREAD) {
+		n = cds_mpmc_ring_dequeue_bulk(&ring, batch, BATCH);
+		if (!n)
+			sched_yield();
+		for (k = 0; k < n; k++) {
+			v = (uintptr_t) batch[k];
+			if (!v || v > NR_THREADS * NR_PER_THREAD
+					|| seen[v - 1]++)
+				uatomic_inc(&nr_bad);
+			uatomic_add(&sum_out, v);
+		}
+		uatomic_add(&nr_out, n);
+	}
+	return NULL;
+}
+
+int main(int argc, char **argv)
+{
+	struct cds_mpmc_ring_slot small[4];
+	pthread_t producers[NR_THREADS], consumers[NR_THREADS];
+	void *batch[6], *p;
+	unsigned long i;
+	int ok_order;
+
+	plan_tests(7);
+
+	ok(cds_mpmc_ring_init(&ring, small, 3) == -EINVAL
+		&& cds_mpmc_ring_init(&ring, small, 1) == -EINVAL,
+		"reject capacities which are not a power of two");
+	ok(!cds_mpmc_ring_init(&ring, small, 4)
+		&& !cds_mpmc_ring_try_dequeue(&ring, &p),
+		"new ring is empty");
+
+	for (i = 0; i < 6; i++)
+		batch[i] = (void *) (i + 1);
+	ok(cds_mpmc_ring_enqueue_bulk(&ring, batch, 3) == 3
+		&& cds_mpmc_ring_enqueue_bulk(&ring, batch + 3, 3) == 1
+		&& !cds_mpmc_ring_try_enqueue(&ring, batch[5]),
+		"enqueue stops when the ring is full");
+
+	ok_order = cds_mpmc_ring_try_dequeue(&ring, &p) && p == batch[0];
+	ok_order &= cds_mpmc_ring_dequeue_bulk(&ring, batch, 6) == 3
+		&& batch[0] == (void *) 2 && batch[2] == (void *) 4;
+	ok(ok_order, "dequeue in FIFO order");
+	ok(!cds_mpmc_ring_try_dequeue(&ring, &p),
+		"dequeue stops when the ring is empty");
+
+	/* Several laps of producers and consumers racing on the ring. */
+	cds_mpmc_ring_init(&ring, slots, CAPACITY);
+	for (i = 0; i < NR_THREADS * NR_PER_THREAD; i++)
+		sum_in += i + 1;
+	for (i = 0; i < NR_THREADS; i++) {
+		if (pthread_create(&consumers[i], NULL, consumer_fn, NULL))
+			abort();
+		if (pthread_create(&producers[i], NULL, producer_fn,
+				(void *) i))
+			abort();
+	}
+	for (i = 0; i < NR_THREADS; i++) {
+		if (pthread_join(producers[i], NULL))
+			abort();
+		if (pthread_join(consumers[i], NULL))
+			abort();
+	}
+	ok(sum_out == sum_in && nr_out == NR_THREADS * NR_PER_THREAD,
+		"concurrent consumers get every element");
+	ok(!nr_bad, "no element is lost or duplicated");
+	return exit_status();
+}
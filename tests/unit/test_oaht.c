@@ -0,0 +1,126 @@
+/*
+ * test_oaht.c
+ *
+ * Userspace RCU library - test open-addressing RCU hash table
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#include <stdlib.h>
+#include <stdint.h>
+#include <errno.h>
+#include <pthread.h>
+#include <urcu.h>
+#include <urcu/rcuoaht.h>
+
+#include "tap.h"
+
+#define NR_KEYS		10000
+#define NR_ROUNDS	20
+
+static struct cds_oaht *ht;
+static int stop, nr_bad;
+
+/* Values of key are always 2 * key, whatever updates are going on. */
+static void *reader_fn(void *arg)
+{
+	uint64_t key = 0, value;
+
+	rcu_register_thread();
+	while (!CMM_LOAD_SHARED(stop)) {
+		rcu_read_lock();
+		if (!cds_oaht_lookup(ht, key, &value) && value != 2 * key)
+			nr_bad++;
+		rcu_read_unlock();
+		key = (key + 1) % NR_KEYS;
+	}
+	rcu_unregister_thread();
+	return NULL;
+}
+
+int main(int argc, char **argv)
+{
+	pthread_t reader;
+	uint64_t key, value;
+	int i, nr_found, ret;
+
+	plan_tests(9);
+
+	rcu_register_thread();
+	ht = cds_oaht_new(16);
+	if (!ht)
+		abort();
+
+	ret = 0;
+	for (key = 0; key < NR_KEYS; key++)
+		ret |= cds_oaht_add(ht, key, 2 * key);
+	ok(!ret && cds_oaht_count(ht) == NR_KEYS, "add grows past init_size");
+	ok(cds_oaht_add(ht, 1, 0) == -EEXIST, "add existing key fails");
+
+	nr_found = 0;
+	rcu_read_lock();
+	for (key = 0; key < NR_KEYS; key++) {
+		if (!cds_oaht_lookup(ht, key, &value) && value == 2 * key)
+			nr_found++;
+	}
+	ok(nr_found == NR_KEYS, "lookup all keys");
+	ok(cds_oaht_lookup(ht, NR_KEYS, &value) == -ENOENT,
+		"lookup missing key");
+	rcu_read_unlock();
+
+	ok(cds_oaht_add_replace(ht, 1, 3) == 1
+		&& cds_oaht_add_replace(ht, NR_KEYS, 4) == 0,
+		"add_replace replaces or adds");
+	rcu_read_lock();
+	ok(!cds_oaht_lookup(ht, 1, &value) && value == 3
+		&& !cds_oaht_lookup(ht, NR_KEYS, &value) && value == 4,
+		"lookup after add_replace");
+	rcu_read_unlock();
+	ok(!cds_oaht_del(ht, NR_KEYS) && cds_oaht_del(ht, NR_KEYS) == -ENOENT
+		&& cds_oaht_add_replace(ht, 1, 2) == 1,
+		"del once");
+
+	/* Churn with tombstones and rebuilds under a concurrent reader. */
+	if (pthread_create(&reader, NULL, reader_fn, NULL))
+		abort();
+	ret = 0;
+	for (i = 0; i < NR_ROUNDS; i++) {
+		for (key = i & 1; key < NR_KEYS; key += 2)
+			ret |= cds_oaht_del(ht, key);
+		for (key = i & 1; key < NR_KEYS; key += 2)
+			ret |= cds_oaht_add(ht, key, 2 * key);
+		for (key = 0; key < NR_KEYS; key += 3)
+			ret |= cds_oaht_add_replace(ht, key, 2 * key) != 1;
+	}
+	CMM_STORE_SHARED(stop, 1);
+	if (pthread_join(reader, NULL))
+		abort();
+	ok(!ret && !nr_bad, "reader sees consistent values during updates");
+
+	nr_found = 0;
+	rcu_read_lock();
+	for (key = 0; key < NR_KEYS; key++) {
+		if (!cds_oaht_lookup(ht, key, &value) && value == 2 * key)
+			nr_found++;
+	}
+	rcu_read_unlock();
+	ok(nr_found == NR_KEYS && cds_oaht_count(ht) == NR_KEYS,
+		"lookup all keys after updates");
+
+	cds_oaht_destroy(ht);
+	rcu_barrier();
+	rcu_unregister_thread();
+	return exit_status();
+}
@@ -0,0 +1,133 @@
+/*
+ * test_percpu_ref.c
+ *
+ * Userspace RCU library - test the per-CPU reference counter
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#include <stdlib.h>
+#include <pthread.h>
+#include <urcu.h>
+#include <urcu/percpu-ref.h>
+
+#include "tap.h"
+
+#define NR_THREADS	4
+#define NR_LOOPS	100000
+#define NR_HELD		16
+
+static struct urcu_percpu_ref ref;
+static int nr_release, released_early, killed, held_back;
+static unsigned long nr_live_after_kill;
+
+static void test_release(struct urcu_percpu_ref *r)
+{
+	uatomic_inc(&nr_release);
+	if (CMM_LOAD_SHARED(held_back))
+		uatomic_inc(&released_early);
+}
+
+/*
+ * Take and release references, keeping NR_HELD of them until the main
+ * thread has checked that the count did not reach zero.
+ */
+static void *thr_getput(void *arg)
+{
+	unsigned long i;
+	int saw_kill = 0;
+
+	rcu_register_thread();
+	for (i = 0; i < NR_HELD; i++)
+		urcu_percpu_ref_get(&ref);
+	for (i = 0; i < NR_LOOPS; i++) {
+		if (urcu_percpu_ref_tryget_live(&ref)) {
+			if (saw_kill)
+				uatomic_inc(&nr_live_after_kill);
+			urcu_percpu_ref_put(&ref);
+		} else {
+			saw_kill = 1;
+		}
+		urcu_percpu_ref_get(&ref);
+		if (!(i % 3))
+			(void) urcu_percpu_ref_tryget(&ref);
+		else
+			urcu_percpu_ref_get(&ref);
+		urcu_percpu_ref_put(&ref);
+		urcu_percpu_ref_put(&ref);
+		if (i == NR_LOOPS / 2)
+			uatomic_inc(&killed);
+	}
+	while (CMM_LOAD_SHARED(held_back))
+		caa_cpu_relax();
+	for (i = 0; i < NR_HELD; i++)
+		urcu_percpu_ref_put(&ref);
+	rcu_unregister_thread();
+	return NULL;
+}
+
+int main(int argc, char **argv)
+{
+	pthread_t tid[NR_THREADS];
+	struct urcu_percpu_ref ref2;
+	int i;
+
+	plan_tests(8);
+
+	rcu_register_thread();
+	if (urcu_percpu_ref_init(&ref, test_release))
+		abort();
+	CMM_STORE_SHARED(held_back, 1);
+	for (i = 0; i < NR_THREADS; i++) {
+		if (pthread_create(&tid[i], NULL, thr_getput, NULL))
+			abort();
+	}
+	/* Kill while the threads take and release references. */
+	while (uatomic_read(&killed) < 1)
+		caa_cpu_relax();
+	urcu_percpu_ref_kill(&ref);
+	ok(!urcu_percpu_ref_tryget_live(&ref), "tryget_live fails once killed");
+
+	rcu_barrier();
+	ok(!urcu_percpu_ref_is_zero(&ref) && !uatomic_read(&nr_release),
+		"held references keep the count above zero after the switch");
+	ok(urcu_percpu_ref_tryget(&ref), "tryget of a killed, non-zero count");
+	urcu_percpu_ref_put(&ref);
+
+	CMM_STORE_SHARED(held_back, 0);
+	for (i = 0; i < NR_THREADS; i++) {
+		if (pthread_join(tid[i], NULL))
+			abort();
+	}
+	ok(uatomic_read(&nr_release) == 1 && !released_early,
+		"released once, by the last put");
+	ok(urcu_percpu_ref_is_zero(&ref), "count is zero");
+	ok(!nr_live_after_kill, "no live reference once seen killed");
+	urcu_percpu_ref_exit(&ref);
+
+	/* References never used by other threads. */
+	nr_release = 0;
+	if (urcu_percpu_ref_init(&ref2, test_release))
+		abort();
+	urcu_percpu_ref_kill(&ref2);
+	ok(!nr_release, "no release before the grace period");
+	rcu_barrier();
+	ok(nr_release == 1 && urcu_percpu_ref_is_zero(&ref2),
+		"kill of the last reference releases after the grace period");
+	urcu_percpu_ref_exit(&ref2);
+
+	rcu_unregister_thread();
+	return exit_status();
+}
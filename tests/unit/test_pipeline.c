@@ -0,0 +1,176 @@
+/*
+ * test_pipeline.c
+ *
+ * Userspace RCU library - test multi-stage pipeline
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#include <stdlib.h>
+#include <errno.h>
+#include <poll.h>
+#include <urcu/uatomic.h>
+#include <urcu/pipeline.h>
+
+#include "tap.h"
+
+#define NR_NODES	10000
+#define MAX_IN_FLIGHT	8
+#define NR_GATED	4
+
+struct test_node {
+	struct cds_pipeline_node pnode;
+	unsigned long id;
+	unsigned long value;
+};
+
+static struct test_node nodes[NR_NODES];
+static unsigned long nr_done, nr_bad, next_id;
+static long live, live_max;
+static int gate;
+
+static struct test_node *to_test_node(struct cds_pipeline_node *pnode)
+{
+	return caa_container_of(pnode, struct test_node, pnode);
+}
+
+static void leave(void)
+{
+	uatomic_dec(&live);
+	uatomic_inc(&nr_done);
+}
+
+/* Add 1, and consume odd nodes. */
+static int stage_add(struct cds_pipeline_node *pnode, void *priv)
+{
+	struct test_node *node = to_test_node(pnode);
+
+	node->value++;
+	if (node->id & 1) {
+		leave();
+		return CDS_PIPELINE_CONSUMED;
+	}
+	return CDS_PIPELINE_FORWARD;
+}
+
+static int stage_mul(struct cds_pipeline_node *pnode, void *priv)
+{
+	to_test_node(pnode)->value *= 2;
+	return CDS_PIPELINE_FORWARD;
+}
+
+static int stage_check(struct cds_pipeline_node *pnode, void *priv)
+{
+	struct test_node *node = to_test_node(pnode);
+
+	if (node->value != (node->id + 1) * 2)
+		uatomic_inc(&nr_bad);
+	leave();
+	return CDS_PIPELINE_FORWARD;
+}
+
+/* With a single worker per stage, nodes leave in submission order. */
+static int stage_order(struct cds_pipeline_node *pnode, void *priv)
+{
+	if (to_test_node(pnode)->id != next_id++)
+		nr_bad++;
+	return CDS_PIPELINE_FORWARD;
+}
+
+static int stage_gate(struct cds_pipeline_node *pnode, void *priv)
+{
+	while (!uatomic_read(&gate))
+		(void) poll(NULL, 0, 1);
+	return CDS_PIPELINE_FORWARD;
+}
+
+static void submit_all(struct cds_pipeline *pipeline)
+{
+	long v, old;
+	int i;
+
+	for (i = 0; i < NR_NODES; i++) {
+		nodes[i].id = i;
+		nodes[i].value = i;
+		v = uatomic_add_return(&live, 1);
+		while ((old = uatomic_read(&live_max)) < v)
+			(void) uatomic_cmpxchg(&live_max, old, v);
+		cds_pipeline_submit(pipeline, &nodes[i].pnode);
+	}
+	cds_pipeline_drain(pipeline);
+}
+
+int main(int argc, char **argv)
+{
+	struct cds_pipeline_stage_stats stats[3];
+	struct cds_pipeline *pipeline;
+	int i, ret = 0;
+
+	plan_tests(7);
+
+	pipeline = cds_pipeline_create(MAX_IN_FLIGHT);
+	if (!pipeline)
+		abort();
+	ok(cds_pipeline_add_stage(pipeline, 0, stage_add, NULL) == -EINVAL,
+		"reject stage without workers");
+	if (cds_pipeline_add_stage(pipeline, 2, stage_add, NULL) != 0
+			|| cds_pipeline_add_stage(pipeline, 2, stage_mul, NULL) != 1
+			|| cds_pipeline_add_stage(pipeline, 1, stage_check, NULL) != 2)
+		abort();
+	submit_all(pipeline);
+	ok(nr_done == NR_NODES && !nr_bad,
+		"nodes pass through the stages they are forwarded to");
+	ok(live_max <= MAX_IN_FLIGHT + 1,
+		"in-flight nodes bounded (max %ld)", live_max);
+	for (i = 0; i < 3; i++)
+		ret |= cds_pipeline_get_stage_stats(pipeline, i, &stats[i]);
+	ok(!ret && stats[0].nodes == NR_NODES && stats[1].nodes == NR_NODES / 2
+			&& stats[2].nodes == NR_NODES / 2
+			&& stats[0].batches && stats[0].batches <= NR_NODES
+			&& stats[0].wait_max_ns * NR_NODES >= stats[0].wait_sum_ns,
+		"stage statistics");
+	cds_pipeline_destroy(pipeline);
+
+	pipeline = cds_pipeline_create(0);
+	if (!pipeline)
+		abort();
+	for (i = 0; i < 3; i++) {
+		if (cds_pipeline_add_stage(pipeline, 1, i == 2 ? stage_order
+				: stage_mul, NULL) < 0)
+			abort();
+	}
+	nr_bad = 0;
+	submit_all(pipeline);
+	ok(next_id == NR_NODES && !nr_bad, "single workers keep order");
+	cds_pipeline_destroy(pipeline);
+
+	pipeline = cds_pipeline_create(NR_GATED);
+	if (!pipeline)
+		abort();
+	if (cds_pipeline_add_stage(pipeline, 1, stage_gate, NULL) < 0)
+		abort();
+	for (i = 0; i < NR_GATED; i++) {
+		if (cds_pipeline_try_submit(pipeline, &nodes[i].pnode))
+			abort();
+	}
+	ok(cds_pipeline_try_submit(pipeline, &nodes[i].pnode) == -EAGAIN,
+		"submission fails when the pipeline is full");
+	uatomic_set(&gate, 1);
+	cds_pipeline_drain(pipeline);
+	ok(cds_pipeline_try_submit(pipeline, &nodes[i].pnode) == 0,
+		"submission succeeds once drained");
+	cds_pipeline_destroy(pipeline);
+	return exit_status();
+}
@@ -0,0 +1,125 @@
+/*
+ * test_prefetch_iter.c
+ *
+ * Userspace RCU library - test prefetching iterations
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#include <stdlib.h>
+#include <urcu.h>
+#include <urcu/rculist.h>
+#include <urcu/rcuhlist.h>
+#include <urcu/rculfhash.h>
+
+#include "tap.h"
+
+#define NR_NODES	1000
+
+struct test_node {
+	unsigned long key;
+	unsigned int visited;
+	struct cds_list_head list;
+	struct cds_hlist_node hlist;
+	struct cds_lfht_node node;
+};
+
+static struct test_node nodes[NR_NODES];
+
+/* Number of nodes not visited exactly once since the last call. */
+static unsigned long nr_bad_visits(void)
+{
+	unsigned long i, bad = 0;
+
+	for (i = 0; i < NR_NODES; i++) {
+		if (nodes[i].visited != 1)
+			bad++;
+		nodes[i].visited = 0;
+	}
+	return bad;
+}
+
+int main(int argc, char **argv)
+{
+	CDS_LIST_HEAD(list);
+	struct cds_hlist_head hlist = { NULL };
+	struct cds_lfht *ht;
+	struct cds_lfht_iter iter;
+	struct cds_hlist_node *hpos;
+	struct test_node *pos;
+	unsigned long i, prev;
+	int bad_order = 0;
+
+	plan_tests(5);
+
+	rcu_register_thread();
+	ht = cds_lfht_new(1, 1, 0, CDS_LFHT_AUTO_RESIZE, NULL);
+	if (!ht)
+		abort();
+
+	for (i = 0; i < NR_NODES; i++) {
+		nodes[i].key = i;
+		cds_list_add_tail_rcu(&nodes[i].list, &list);
+		cds_hlist_add_head_rcu(&nodes[i].hlist, &hlist);
+		cds_lfht_node_init(&nodes[i].node);
+		rcu_read_lock();
+		cds_lfht_add(ht, i * 2654435761UL, &nodes[i].node);
+		rcu_read_unlock();
+	}
+
+	rcu_read_lock();
+	prev = 0;
+	cds_list_for_each_entry_rcu_prefetch(pos, &list, list) {
+		if (pos->key != prev++)
+			bad_order = 1;
+		pos->visited++;
+	}
+	ok(!nr_bad_visits() && !bad_order,
+		"list iteration visits each element in order");
+
+	prev = NR_NODES;
+	cds_hlist_for_each_entry_rcu_prefetch(pos, hpos, &hlist, hlist) {
+		if (pos->key != --prev)
+			bad_order = 1;
+		pos->visited++;
+	}
+	ok(!nr_bad_visits() && !bad_order,
+		"hlist iteration visits each element in order");
+
+	cds_lfht_for_each_entry_prefetch(ht, &iter, pos, node)
+		pos->visited++;
+	ok(!nr_bad_visits(), "hash table iteration visits each node once");
+
+	cds_lfht_for_each_entry_prefetch(ht, &iter, pos, node) {
+		if (!(pos->key & 1) && cds_lfht_del(ht, &pos->node))
+			abort();
+		pos->visited++;
+	}
+	ok(!nr_bad_visits(), "hash table iteration with removals");
+	cds_lfht_for_each_entry_prefetch(ht, &iter, pos, node) {
+		if (!(pos->key & 1))
+			bad_order = 1;
+		if (cds_lfht_del(ht, &pos->node))
+			abort();
+	}
+	ok(!bad_order, "removed nodes are not visited");
+	rcu_read_unlock();
+
+	synchronize_rcu();
+	if (cds_lfht_destroy(ht, NULL))
+		abort();
+	rcu_unregister_thread();
+	return exit_status();
+}
@@ -0,0 +1,179 @@
+/*
+ * test_rcu_array.c
+ *
+ * Userspace RCU library - test RCU copy-on-write array
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#include <stdlib.h>
+#include <poll.h>
+#include <pthread.h>
+#include <urcu.h>
+#include <urcu/rcuarray.h>
+
+#include "tap.h"
+
+#define NR_READERS	2
+#define NR_UPDATES	2000
+#define MAX_LEN		64
+
+static struct cds_rcu_array array;
+static int stop;
+static unsigned long nr_bad_read, nr_reads;
+
+static unsigned long get(const struct cds_rcu_array_data *data, size_t i)
+{
+	return *(const unsigned long *) cds_rcu_array_entry(data, i);
+}
+
+static const struct cds_rcu_array_data *version(void)
+{
+	const struct cds_rcu_array_data *data;
+
+	rcu_read_lock();
+	data = cds_rcu_array_read(&array);
+	rcu_read_unlock();
+	return data;
+}
+
+/* All elements of a version hold its generation: check consistency. */
+static void *thr_reader(void *arg)
+{
+	const struct cds_rcu_array_data *data;
+	size_t i, len;
+
+	rcu_register_thread();
+	while (!uatomic_read(&stop)) {
+		rcu_read_lock();
+		data = cds_rcu_array_read(&array);
+		len = cds_rcu_array_len(data);
+		for (i = 1; i < len; i++) {
+			if (get(data, i) != get(data, 0))
+				uatomic_inc(&nr_bad_read);
+		}
+		rcu_read_unlock();
+		uatomic_inc(&nr_reads);
+	}
+	rcu_unregister_thread();
+	return NULL;
+}
+
+int main(int argc, char **argv)
+{
+	const struct cds_rcu_array_data *data, *old;
+	pthread_t tid[NR_READERS];
+	unsigned long i, v, nr_bad = 0;
+	size_t j, len;
+
+	plan_tests(9);
+
+	rcu_register_thread();
+	ok(cds_rcu_array_init(&array, sizeof(unsigned long)) == 0
+			&& cds_rcu_array_len(version()) == 0,
+		"empty array");
+
+	old = version();
+	for (v = 0; v < 4; v++) {
+		if (cds_rcu_array_append(&array, &v))
+			abort();
+	}
+	ok(version() == old && cds_rcu_array_len(old) == 4
+			&& get(old, 3) == 3,
+		"append fills spare capacity in place");
+	if (cds_rcu_array_append(&array, &v))
+		abort();
+	data = version();
+	ok(data != old && cds_rcu_array_len(data) == 5 && get(data, 4) == 4,
+		"append beyond capacity copies");
+
+	/* Batch: 0 1 2 3 4 -> 9 1 2 3 -> 9 1 2 3 0 0 */
+	old = data;
+	if (cds_rcu_array_update_begin(&array))
+		abort();
+	v = 9;
+	if (cds_rcu_array_update_insert(&array, 0, &v))
+		abort();
+	cds_rcu_array_update_remove(&array, 1);
+	cds_rcu_array_update_remove(&array, 4);
+	if (cds_rcu_array_update_resize(&array, 6))
+		abort();
+	ok(version() == old && cds_rcu_array_len(old) == 5 && get(old, 0) == 0,
+		"batch not visible before commit");
+	cds_rcu_array_update_commit(&array);
+	data = version();
+	ok(data != old && cds_rcu_array_len(data) == 6 && get(data, 0) == 9
+			&& get(data, 1) == 1 && get(data, 3) == 3
+			&& get(data, 4) == 0 && get(data, 5) == 0,
+		"batch published at once");
+
+	old = data;
+	if (cds_rcu_array_update_begin(&array))
+		abort();
+	if (cds_rcu_array_update_resize(&array, 0))
+		abort();
+	cds_rcu_array_update_abort(&array);
+	ok(version() == old && cds_rcu_array_len(old) == 6,
+		"aborted batch discarded");
+
+	/* Readers check that each version is consistent. */
+	if (cds_rcu_array_update_begin(&array))
+		abort();
+	if (cds_rcu_array_update_resize(&array, 0))
+		abort();
+	cds_rcu_array_update_commit(&array);
+	for (i = 0; i < NR_READERS; i++) {
+		if (pthread_create(&tid[i], NULL, thr_reader, NULL))
+			abort();
+	}
+	for (v = 1; v <= NR_UPDATES; v++) {
+		if (cds_rcu_array_update_begin(&array))
+			abort();
+		len = cds_rcu_array_update_len(&array);
+		for (j = 0; j < len; j++)
+			*(unsigned long *) cds_rcu_array_update_entry(&array, j) = v;
+		if (len >= MAX_LEN) {
+			cds_rcu_array_update_remove(&array, 0);
+			cds_rcu_array_update_remove(&array, 0);
+		}
+		cds_rcu_array_update_commit(&array);
+		/* Appends in place, or copies when full. */
+		if (cds_rcu_array_append(&array, &v))
+			abort();
+		if (uatomic_read(&nr_reads) < v / 4)
+			(void) poll(NULL, 0, 1);
+	}
+	uatomic_set(&stop, 1);
+	for (i = 0; i < NR_READERS; i++) {
+		if (pthread_join(tid[i], NULL))
+			abort();
+	}
+	ok(nr_bad_read == 0, "concurrent readers see consistent versions "
+		"(%lu reads)", nr_reads);
+
+	data = version();
+	len = cds_rcu_array_len(data);
+	for (j = 0; j < len; j++) {
+		if (get(data, j) != NR_UPDATES)
+			nr_bad++;
+	}
+	ok(nr_bad == 0 && len > 0 && len <= MAX_LEN, "final version");
+
+	rcu_barrier();
+	cds_rcu_array_destroy(&array);
+	ok(array.data == NULL, "array destroyed");
+	rcu_unregister_thread();
+	return exit_status();
+}
@@ -0,0 +1,101 @@
+/*
+ * test_rcu_barrier_shared.c
+ *
+ * Userspace RCU library - test concurrent rcu_barrier callers
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#include <stdlib.h>
+#include <sched.h>
+#include <pthread.h>
+#include <urcu.h>
+
+#include "tap.h"
+
+#define NR_THREADS	32
+#define NR_LOOPS	10
+
+struct thread_cb {
+	struct rcu_head head;
+	int invoked;
+};
+
+static int go;
+static unsigned long nr_missed;
+
+static void set_invoked(struct rcu_head *head)
+{
+	uatomic_set(&caa_container_of(head, struct thread_cb, head)->invoked, 1);
+}
+
+/* Each rcu_barrier() waits for the callback queued just before it. */
+static void *thr_barrier(void *arg)
+{
+	struct thread_cb cb;
+	int i;
+
+	rcu_register_thread();
+	while (!uatomic_read(&go))
+		sched_yield();
+	for (i = 0; i < NR_LOOPS; i++) {
+		cb.invoked = 0;
+		call_rcu(&cb.head, set_invoked);
+		rcu_barrier();
+		if (!uatomic_read(&cb.invoked))
+			uatomic_inc(&nr_missed);
+	}
+	rcu_unregister_thread();
+	return NULL;
+}
+
+static unsigned long nr_invoked(void)
+{
+	struct urcu_stats stats;
+
+	rcu_get_stats(&stats);
+	return stats.call_rcu.invoked;
+}
+
+int main(int argc, char **argv)
+{
+	pthread_t tid[NR_THREADS];
+	unsigned long invoked, nr_passes;
+	int i;
+
+	plan_tests(2);
+
+	rcu_register_thread();
+	/* Single default call_rcu thread: one barrier callback per pass. */
+	rcu_barrier();
+	invoked = nr_invoked();
+	for (i = 0; i < NR_THREADS; i++) {
+		if (pthread_create(&tid[i], NULL, thr_barrier, NULL))
+			abort();
+	}
+	uatomic_set(&go, 1);
+	for (i = 0; i < NR_THREADS; i++) {
+		if (pthread_join(tid[i], NULL))
+			abort();
+	}
+	nr_passes = nr_invoked() - invoked - NR_THREADS * NR_LOOPS;
+	ok(nr_missed == 0, "each caller waits for its prior callbacks");
+	ok(nr_passes < NR_THREADS * NR_LOOPS,
+		"concurrent callers share passes (%lu passes for %d calls)",
+		nr_passes, NR_THREADS * NR_LOOPS);
+
+	rcu_unregister_thread();
+	return exit_status();
+}
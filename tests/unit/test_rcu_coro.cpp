@@ -0,0 +1,152 @@
+/*
+ * test_rcu_coro.cpp
+ *
+ * Userspace RCU library - test C++20 grace period awaitables
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#include <stdlib.h>
+#include <unistd.h>
+#include <poll.h>
+#include <pthread.h>
+#include <urcu.h>
+#include <urcu/coro.hpp>
+
+extern "C" {
+#include "tap.h"
+}
+
+/* Coroutine running eagerly, and freeing itself once done. */
+struct task {
+	struct promise_type {
+		task get_return_object() { return task(); }
+		std::suspend_never initial_suspend() { return {}; }
+		std::suspend_never final_suspend() noexcept { return {}; }
+		void return_void() {}
+		void unhandled_exception() { abort(); }
+	};
+};
+
+static int done;
+static int gp_reached;
+static pthread_t resumed_on;
+static int callback_invoked;
+static void *posted;
+
+/*
+ * uatomic_set() uses the value of a volatile assignment, which C++20
+ * deprecates.
+ */
+template<typename T>
+static void store_shared(T *p, T v)
+{
+	CMM_ACCESS_ONCE(*p) = v;
+	cmm_smp_wmc();
+}
+
+static void wait_done(void)
+{
+	while (!uatomic_read(&done))
+		(void) poll(NULL, 0, 1);
+	store_shared(&done, 0);
+}
+
+static task await_grace_period(void)
+{
+	unsigned long cookie = get_state_synchronize_rcu();
+
+	co_await urcu::grace_period();
+	gp_reached = poll_state_synchronize_rcu(cookie);
+	resumed_on = pthread_self();
+	store_shared(&done, 1);
+}
+
+static task await_cookie(unsigned long cookie, urcu::resumer resume)
+{
+	co_await urcu::grace_period(cookie, resume);
+	resumed_on = pthread_self();
+	store_shared(&done, 1);
+}
+
+static void post(std::coroutine_handle<> handle, void *arg)
+{
+	store_shared(&posted, handle.address());
+}
+
+static void set_invoked(struct rcu_head *head)
+{
+	store_shared(&callback_invoked, 1);
+}
+
+static task await_barrier(struct rcu_head *head)
+{
+	call_rcu(head, set_invoked);
+	co_await urcu::barrier();
+	gp_reached = uatomic_read(&callback_invoked);
+	store_shared(&done, 1);
+}
+
+int main(int argc, char **argv)
+{
+	struct rcu_head head;
+	unsigned long cookie;
+	urcu::resumer resume;
+
+	plan_tests(8);
+
+	rcu_register_thread();
+
+	{
+		urcu::read_guard guard;
+
+		ok(rcu_read_ongoing(), "read_guard enters critical section");
+	}
+	ok(!rcu_read_ongoing(), "read_guard leaves critical section");
+	{
+		urcu::flavor_read_guard guard(rcu_flavor);
+
+		ok(rcu_read_ongoing(), "flavor_read_guard enters critical section");
+	}
+
+	await_grace_period();
+	wait_done();
+	ok(gp_reached && !pthread_equal(resumed_on, pthread_self()),
+		"grace period awaited, resumed by call_rcu worker");
+
+	cookie = start_poll_synchronize_rcu();
+	synchronize_rcu();
+	await_cookie(cookie, resume);
+	ok(uatomic_read(&done) && pthread_equal(resumed_on, pthread_self()),
+		"past cookie does not suspend");
+	store_shared(&done, 0);
+
+	resume.fn = post;
+	await_cookie(get_state_synchronize_rcu(), resume);
+	while (!uatomic_read(&posted))
+		(void) poll(NULL, 0, 1);
+	ok(!uatomic_read(&done), "resumer schedules the coroutine");
+	std::coroutine_handle<>::from_address(posted).resume();
+	ok(uatomic_read(&done) && pthread_equal(resumed_on, pthread_self()),
+		"coroutine resumed by its scheduler");
+	store_shared(&done, 0);
+
+	await_barrier(&head);
+	wait_done();
+	ok(gp_reached, "barrier awaited after prior callbacks");
+
+	rcu_unregister_thread();
+	return exit_status();
+}
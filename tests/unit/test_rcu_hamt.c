@@ -0,0 +1,279 @@
+/*
+ * test_rcu_hamt.c
+ *
+ * Userspace RCU library - test RCU persistent hash array mapped trie
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#include <stdlib.h>
+#include <errno.h>
+#include <poll.h>
+#include <pthread.h>
+#include <urcu.h>
+#include <urcu/rcuhamt.h>
+
+#include "tap.h"
+
+#define NR_KEYS		2000
+#define NR_COLLIDING	10
+#define COLLIDING_KEY	100000UL
+#define NR_READERS	2
+#define NR_SNAP_KEYS	64
+#define NR_UPDATES	500
+
+struct item {
+	unsigned long key;
+	unsigned long value;
+	struct cds_hamt_node node;
+};
+
+static struct cds_hamt hamt;
+static unsigned long nr_allocated, nr_freed;
+static int stop;
+static unsigned long nr_bad_read, nr_reads;
+
+/* Colliding keys share their whole hash. */
+static unsigned long hash_key(unsigned long key)
+{
+	if (key >= COLLIDING_KEY)
+		return 0x5a5a5a5aUL;
+	return key * 2654435761UL;
+}
+
+static int match(struct cds_hamt_node *node, const void *key)
+{
+	return caa_container_of(node, struct item, node)->key
+		== *(const unsigned long *) key;
+}
+
+static void free_item(struct cds_hamt_node *node)
+{
+	uatomic_inc(&nr_freed);
+	free(caa_container_of(node, struct item, node));
+}
+
+static struct item *new_item(unsigned long key, unsigned long value)
+{
+	struct item *item = malloc(sizeof(*item));
+
+	if (!item)
+		abort();
+	item->key = key;
+	item->value = value;
+	item->node.hash = hash_key(key);
+	uatomic_inc(&nr_allocated);
+	return item;
+}
+
+static struct item *lookup(const struct cds_hamt_inode *root,
+		unsigned long key)
+{
+	struct cds_hamt_node *node;
+
+	node = cds_hamt_lookup(root, hash_key(key), match, &key);
+	return node ? caa_container_of(node, struct item, node) : NULL;
+}
+
+static const struct cds_hamt_inode *version(void)
+{
+	const struct cds_hamt_inode *root;
+
+	rcu_read_lock();
+	root = cds_hamt_read(&hamt);
+	rcu_read_unlock();
+	return root;
+}
+
+static void add(unsigned long key, unsigned long value)
+{
+	int ret;
+
+	ret = cds_hamt_update_add_replace(&hamt, &new_item(key, value)->node,
+		match, &key);
+	if (ret)
+		abort();
+}
+
+/* Keys of a version hold values of the same update: check consistency. */
+static void *thr_reader(void *arg)
+{
+	const struct cds_hamt_inode *root;
+	struct item *item;
+	unsigned long key, value;
+
+	rcu_register_thread();
+	while (!uatomic_read(&stop)) {
+		rcu_read_lock();
+		root = cds_hamt_read(&hamt);
+		value = lookup(root, 0)->value;
+		for (key = 1; key < NR_SNAP_KEYS; key++) {
+			item = lookup(root, key);
+			if (!item || item->value != value)
+				uatomic_inc(&nr_bad_read);
+		}
+		rcu_read_unlock();
+		uatomic_inc(&nr_reads);
+	}
+	rcu_unregister_thread();
+	return NULL;
+}
+
+int main(int argc, char **argv)
+{
+	const struct cds_hamt_inode *root, *old;
+	struct cds_hamt_iter iter;
+	struct cds_hamt_node *node;
+	pthread_t tid[NR_READERS];
+	unsigned long i, key, nr_bad = 0, nr_seen = 0, sum = 0;
+	struct item *item;
+
+	plan_tests(9);
+
+	rcu_register_thread();
+	ok(cds_hamt_init(&hamt, free_item) == 0
+			&& cds_hamt_count(version()) == 0
+			&& !lookup(version(), 1),
+		"empty trie");
+
+	/* One batch adds all the keys, colliding ones included. */
+	old = version();
+	if (cds_hamt_update_begin(&hamt))
+		abort();
+	for (key = 0; key < NR_KEYS; key++)
+		add(key, key);
+	for (key = COLLIDING_KEY; key < COLLIDING_KEY + NR_COLLIDING; key++)
+		add(key, key);
+	key = 0;
+	item = new_item(0, 0);
+	ok(cds_hamt_update_add_unique(&hamt, &item->node, match, &key)
+				== -EEXIST
+			&& cds_hamt_update_lookup(&hamt, hash_key(1), match,
+				&(unsigned long) { 1 }),
+		"batch sees its own modifications");
+	free_item(&item->node);
+	cds_hamt_update_commit(&hamt);
+	root = version();
+	for (key = 0; key < NR_KEYS; key++) {
+		item = lookup(root, key);
+		if (!item || item->value != key)
+			nr_bad++;
+	}
+	for (key = COLLIDING_KEY; key < COLLIDING_KEY + NR_COLLIDING; key++) {
+		item = lookup(root, key);
+		if (!item || item->value != key)
+			nr_bad++;
+	}
+	ok(nr_bad == 0 && cds_hamt_count(root) == NR_KEYS + NR_COLLIDING
+			&& !lookup(root, NR_KEYS)
+			&& !lookup(root, COLLIDING_KEY + NR_COLLIDING)
+			&& cds_hamt_count(old) == 0,
+		"batch published at once, previous version unchanged");
+
+	cds_hamt_for_each(root, &iter, node) {
+		nr_seen++;
+		sum += caa_container_of(node, struct item, node)->key;
+	}
+	ok(nr_seen == NR_KEYS + NR_COLLIDING
+			&& sum == NR_KEYS * (NR_KEYS - 1) / 2
+				+ NR_COLLIDING * COLLIDING_KEY
+				+ NR_COLLIDING * (NR_COLLIDING - 1) / 2,
+		"iteration visits each node once");
+
+	/* Remove odd keys and all colliding keys but one. */
+	old = root;
+	if (cds_hamt_update_begin(&hamt))
+		abort();
+	nr_bad = 0;
+	for (key = 1; key < NR_KEYS; key += 2) {
+		if (cds_hamt_update_del(&hamt, hash_key(key), match, &key))
+			nr_bad++;
+	}
+	for (key = COLLIDING_KEY + 1; key < COLLIDING_KEY + NR_COLLIDING;
+			key++) {
+		if (cds_hamt_update_del(&hamt, hash_key(key), match, &key))
+			nr_bad++;
+	}
+	key = 1;
+	if (cds_hamt_update_del(&hamt, hash_key(key), match, &key) != -ENOENT)
+		nr_bad++;
+	cds_hamt_update_commit(&hamt);
+	root = version();
+	for (key = 0; key < NR_KEYS; key++) {
+		if ((lookup(root, key) == NULL) != (key & 1))
+			nr_bad++;
+		if (!lookup(old, key))
+			nr_bad++;
+	}
+	ok(nr_bad == 0 && cds_hamt_count(root) == NR_KEYS / 2 + 1
+			&& lookup(root, COLLIDING_KEY)
+			&& !lookup(root, COLLIDING_KEY + 1)
+			&& lookup(old, COLLIDING_KEY + 1)
+			&& cds_hamt_count(old) == NR_KEYS + NR_COLLIDING,
+		"removals, readers of the previous version unaffected");
+
+	rcu_barrier();
+	ok(uatomic_read(&nr_freed) == NR_KEYS / 2 + NR_COLLIDING,
+		"removed nodes freed after a grace period");
+
+	old = root;
+	if (cds_hamt_update_begin(&hamt))
+		abort();
+	add(NR_KEYS, 0);
+	key = 0;
+	if (cds_hamt_update_del(&hamt, hash_key(key), match, &key))
+		abort();
+	item = caa_container_of(cds_hamt_update_lookup(&hamt, hash_key(NR_KEYS),
+		match, &(unsigned long) { NR_KEYS }), struct item, node);
+	cds_hamt_update_abort(&hamt);
+	free_item(&item->node);
+	ok(version() == old && lookup(old, 0) && !lookup(old, NR_KEYS)
+			&& cds_hamt_count(old) == NR_KEYS / 2 + 1,
+		"aborted batch discarded");
+
+	/* Readers check that each version is a consistent snapshot. */
+	if (cds_hamt_update_begin(&hamt))
+		abort();
+	for (key = 0; key < NR_SNAP_KEYS; key++)
+		add(key, 0);
+	cds_hamt_update_commit(&hamt);
+	for (i = 0; i < NR_READERS; i++) {
+		if (pthread_create(&tid[i], NULL, thr_reader, NULL))
+			abort();
+	}
+	for (i = 1; i <= NR_UPDATES; i++) {
+		if (cds_hamt_update_begin(&hamt))
+			abort();
+		for (key = 0; key < NR_SNAP_KEYS; key++)
+			add(key, i);
+		cds_hamt_update_commit(&hamt);
+		if (uatomic_read(&nr_reads) < i / 4)
+			(void) poll(NULL, 0, 1);
+	}
+	uatomic_set(&stop, 1);
+	for (i = 0; i < NR_READERS; i++) {
+		if (pthread_join(tid[i], NULL))
+			abort();
+	}
+	ok(nr_bad_read == 0, "concurrent readers see consistent snapshots "
+		"(%lu reads)", nr_reads);
+
+	rcu_barrier();
+	cds_hamt_destroy(&hamt);
+	ok(hamt.root == NULL && nr_freed == nr_allocated,
+		"trie destroyed, all nodes freed");
+	rcu_unregister_thread();
+	return exit_status();
+}
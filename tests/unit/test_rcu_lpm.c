@@ -0,0 +1,412 @@
+/*
+ * test_rcu_lpm.c
+ *
+ * Userspace RCU library - test RCU longest prefix match trie
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <errno.h>
+#include <poll.h>
+#include <pthread.h>
+#include <urcu.h>
+#include <urcu/rculpm.h>
+
+#include "tap.h"
+
+#define NR_ROUTES	600
+#define NR_LOOKUPS	20000
+#define NR_FLAPS	2000
+#define ROUTE_MAGIC	0x726f757465UL
+
+struct route {
+	struct cds_lpm_node node;
+	unsigned long magic;
+	unsigned long id;
+};
+
+static struct cds_lpm lpm;
+static unsigned long nr_allocated, nr_freed;
+static int stop;
+static unsigned long nr_bad_read, nr_reads;
+static struct route *stable, *flapping;
+
+static void free_route(struct cds_lpm_node *node)
+{
+	struct route *r = caa_container_of(node, struct route, node);
+
+	r->magic = 0;
+	free(r);
+	uatomic_inc(&nr_freed);
+}
+
+static struct route *new_route(const void *key, unsigned int len,
+		unsigned long id)
+{
+	struct route *r = malloc(sizeof(*r));
+
+	if (!r)
+		abort();
+	cds_lpm_node_init(&r->node, key, len);
+	r->magic = ROUTE_MAGIC;
+	r->id = id;
+	uatomic_inc(&nr_allocated);
+	return r;
+}
+
+static uint32_t ipv4(unsigned int a, unsigned int b, unsigned int c,
+		unsigned int d)
+{
+	uint8_t bytes[4] = { a, b, c, d };
+	uint32_t addr;
+
+	/* Network byte order. */
+	memcpy(&addr, bytes, sizeof(addr));
+	return addr;
+}
+
+static int add(struct cds_lpm *trie, uint32_t addr, unsigned int len,
+		unsigned long id)
+{
+	struct route *r = new_route(&addr, len, id);
+	int ret;
+
+	if (cds_lpm_update_begin(trie))
+		abort();
+	ret = cds_lpm_update_add_unique(trie, &r->node);
+	cds_lpm_update_commit(trie);
+	if (ret) {
+		free(r);
+		uatomic_dec(&nr_allocated);
+	}
+	return ret;
+}
+
+static int del(struct cds_lpm *trie, const void *key, unsigned int len)
+{
+	int ret;
+
+	if (cds_lpm_update_begin(trie))
+		abort();
+	ret = cds_lpm_update_del(trie, key, len);
+	cds_lpm_update_commit(trie);
+	return ret;
+}
+
+/* Id of the longest prefix of addr, or -1. */
+static long lookup(uint32_t addr)
+{
+	struct cds_lpm_node *node;
+	long id = -1;
+
+	rcu_read_lock();
+	node = cds_lpm_lookup(cds_lpm_read(&lpm), &addr);
+	if (node)
+		id = caa_container_of(node, struct route, node)->id;
+	rcu_read_unlock();
+	return id;
+}
+
+/* Whether the first len bits of a and b are equal. */
+static int prefix_match(const uint8_t *a, const uint8_t *b, unsigned int len)
+{
+	unsigned int i;
+
+	for (i = 0; i < len; i++) {
+		if ((a[i / 8] ^ b[i / 8]) & (0x80 >> (i % 8)))
+			return 0;
+	}
+	return 1;
+}
+
+/*
+ * Compare the trie with a linear scan of the prefixes added, of which
+ * those with a zero live flag were deleted. Return the number of
+ * mismatching lookups.
+ */
+static unsigned long check_random(struct cds_lpm *trie,
+		unsigned int key_bytes, struct route **routes, const int *live, unsigned int nr_routes,
+		unsigned int nr_lookups, unsigned int *seed)
+{
+	const struct cds_lpm_inode *root;
+	struct cds_lpm_node *node;
+	uint8_t key[CDS_LPM_MAX_KEY_BITS / 8];
+	unsigned long nr_bad = 0;
+	unsigned int i, j;
+	long best, best_len;
+
+	rcu_read_lock();
+	root = cds_lpm_read(trie);
+	for (i = 0; i < nr_lookups; i++) {
+		/* Half of the keys start with the prefix of a route. */
+		for (j = 0; j < key_bytes; j++)
+			key[j] = rand_r(seed);
+		if (i & 1) {
+			struct route *r = routes[rand_r(seed) % nr_routes];
+
+			for (j = 0; j < r->node.len; j++) {
+				key[j / 8] &= ~(0x80 >> (j % 8));
+				key[j / 8] |= r->node.key[j / 8] & (0x80 >> (j % 8));
+			}
+		}
+		best = -1;
+		best_len = -1;
+		for (j = 0; j < nr_routes; j++) {
+			if (live[j] && (long) routes[j]->node.len > best_len
+			    && prefix_match(routes[j]->node.key, key,
+					routes[j]->node.len)) {
+				best = j;
+				best_len = routes[j]->node.len;
+			}
+		}
+		node = cds_lpm_lookup(root, key);
+		if (node != (best < 0 ? NULL : &routes[best]->node))
+			nr_bad++;
+	}
+	rcu_read_unlock();
+	return nr_bad;
+}
+
+/*
+ * Add random prefixes of random lengths, check, delete every other one
+ * in a single batch, check again. Return the number of mismatches.
+ */
+static unsigned long test_random(unsigned int key_bits, unsigned int *seed)
+{
+	struct route *routes[NR_ROUTES];
+	int live[NR_ROUTES];
+	struct cds_lpm trie;
+	uint8_t key[CDS_LPM_MAX_KEY_BITS / 8];
+	unsigned long nr_bad;
+	unsigned int i, j, nr = 0;
+
+	if (cds_lpm_init(&trie, key_bits, free_route))
+		abort();
+	if (cds_lpm_update_begin(&trie))
+		abort();
+	for (i = 0; i < NR_ROUTES; i++) {
+		struct route *r;
+
+		for (j = 0; j < (key_bits + 7) / 8; j++)
+			key[j] = rand_r(seed);
+		/* Favour short prefixes, which cover more keys. */
+		r = new_route(key, rand_r(seed) % (1 + key_bits / (1 + i % 4)),
+				nr);
+		if (cds_lpm_update_add_unique(&trie, &r->node)) {
+			free(r);
+			uatomic_dec(&nr_allocated);
+			continue;
+		}
+		routes[nr] = r;
+		live[nr++] = 1;
+	}
+	cds_lpm_update_commit(&trie);
+	nr_bad = check_random(&trie, (key_bits + 7) / 8, routes, live, nr,
+			NR_LOOKUPS, seed);
+	nr_bad += cds_lpm_count(trie.root) != nr;
+
+	if (cds_lpm_update_begin(&trie))
+		abort();
+	for (i = 0; i < nr; i += 2) {
+		if (cds_lpm_update_del(&trie, routes[i]->node.key,
+				routes[i]->node.len))
+			nr_bad++;
+		live[i] = 0;
+	}
+	cds_lpm_update_commit(&trie);
+	nr_bad += check_random(&trie, (key_bits + 7) / 8, routes, live, nr,
+			NR_LOOKUPS, seed);
+	nr_bad += cds_lpm_count(trie.root) != nr / 2;
+
+	rcu_barrier();
+	cds_lpm_destroy(&trie);
+	return nr_bad;
+}
+
+static void *thr_reader(void *arg)
+{
+	uint32_t addr = ipv4(10, 1, 2, 3);
+	struct cds_lpm_node *node;
+	struct route *r;
+
+	rcu_register_thread();
+	while (!uatomic_read(&stop)) {
+		rcu_read_lock();
+		node = cds_lpm_lookup(cds_lpm_read(&lpm), &addr);
+		r = node ? caa_container_of(node, struct route, node) : NULL;
+		if (!r || r->magic != ROUTE_MAGIC
+		    || (r != stable && r->id != 24))
+			uatomic_inc(&nr_bad_read);
+		rcu_read_unlock();
+		uatomic_inc(&nr_reads);
+	}
+	rcu_unregister_thread();
+	return NULL;
+}
+
+static void test_concurrent(void)
+{
+	uint32_t prefix = ipv4(10, 1, 2, 0);
+	pthread_t tid;
+	unsigned long i;
+
+	if (pthread_create(&tid, NULL, thr_reader, NULL))
+		abort();
+	for (i = 0; i < NR_FLAPS; i++) {
+		flapping = new_route(&prefix, 24, 24);
+		if (cds_lpm_update_begin(&lpm))
+			abort();
+		if (cds_lpm_update_add_unique(&lpm, &flapping->node))
+			abort();
+		cds_lpm_update_commit(&lpm);
+		if (del(&lpm, &prefix, 24))
+			abort();
+		if (i % 64 == 0)
+			(void) poll(NULL, 0, 0);
+	}
+	uatomic_set(&stop, 1);
+	if (pthread_join(tid, NULL))
+		abort();
+	ok(!nr_bad_read,
+		"readers see the covering route during flaps (%lu reads)",
+		nr_reads);
+}
+
+int main(int argc, char **argv)
+{
+	const struct cds_lpm_inode *old;
+	struct cds_lpm_node *node;
+	struct route *r;
+	unsigned int seed = 42;
+	uint32_t addr;
+
+	plan_tests(17);
+
+	rcu_register_thread();
+
+	ok(cds_lpm_init(&lpm, 0, free_route) == -EINVAL
+		&& cds_lpm_init(&lpm, CDS_LPM_MAX_KEY_BITS + 1, free_route)
+			== -EINVAL,
+		"reject invalid key lengths");
+	if (cds_lpm_init(&lpm, 32, free_route))
+		abort();
+	ok(lookup(ipv4(10, 1, 2, 3)) == -1 && !cds_lpm_count(lpm.root),
+		"empty trie matches nothing");
+
+	if (add(&lpm, ipv4(0, 0, 0, 0), 0, 0)
+	    || add(&lpm, ipv4(10, 0, 0, 0), 8, 8)
+	    || add(&lpm, ipv4(10, 1, 0, 0), 16, 16)
+	    || add(&lpm, ipv4(10, 1, 2, 0), 24, 24)
+	    || add(&lpm, ipv4(10, 1, 2, 3), 32, 32)
+	    || add(&lpm, ipv4(10, 1, 2, 128), 25, 25)
+	    || add(&lpm, ipv4(192, 168, 0, 0), 17, 17))
+		abort();
+	ok(lookup(ipv4(10, 1, 2, 3)) == 32 && lookup(ipv4(10, 1, 2, 4)) == 24
+		&& lookup(ipv4(10, 1, 2, 200)) == 25
+		&& lookup(ipv4(10, 1, 3, 1)) == 16
+		&& lookup(ipv4(10, 2, 0, 1)) == 8
+		&& lookup(ipv4(11, 0, 0, 1)) == 0
+		&& lookup(ipv4(192, 168, 127, 1)) == 17
+		&& lookup(ipv4(192, 168, 128, 1)) == 0,
+		"longest prefix match");
+	ok(cds_lpm_count(lpm.root) == 7, "count");
+
+	addr = ipv4(10, 1, 2, 77);
+	r = new_route(&addr, 24, 99);
+	rcu_read_lock();
+	ok(cds_lpm_lookup_exact(cds_lpm_read(&lpm), &addr, 24)
+		&& !cds_lpm_lookup_exact(cds_lpm_read(&lpm), &addr, 23),
+		"exact lookup ignores the bits beyond the prefix");
+	rcu_read_unlock();
+	if (cds_lpm_update_begin(&lpm))
+		abort();
+	ok(cds_lpm_update_add_unique(&lpm, &r->node) == -EEXIST,
+		"add of a present prefix fails");
+	cds_lpm_update_abort(&lpm);
+	free(r);
+	uatomic_dec(&nr_allocated);
+	addr = ipv4(10, 0, 0, 0);
+	r = new_route(&addr, 33, 33);
+	if (cds_lpm_update_begin(&lpm))
+		abort();
+	ok(cds_lpm_update_add_unique(&lpm, &r->node) == -EINVAL,
+		"add of a prefix longer than the key fails");
+	cds_lpm_update_abort(&lpm);
+	free(r);
+	uatomic_dec(&nr_allocated);
+
+	/* A version read before an update keeps its routes. */
+	addr = ipv4(10, 1, 0, 0);
+	rcu_read_lock();
+	old = cds_lpm_read(&lpm);
+	ok(!del(&lpm, &addr, 16) && del(&lpm, &addr, 16) == -ENOENT,
+		"delete");
+	node = cds_lpm_lookup(old, &(uint32_t) { ipv4(10, 1, 3, 1) });
+	ok(node && caa_container_of(node, struct route, node)->id == 16
+		&& lookup(ipv4(10, 1, 3, 1)) == 8
+		&& lookup(ipv4(10, 1, 2, 4)) == 24,
+		"a version is a snapshot");
+	rcu_read_unlock();
+
+	addr = ipv4(10, 1, 2, 0);
+	r = new_route(&addr, 24, 124);
+	if (cds_lpm_update_begin(&lpm))
+		abort();
+	ok(!cds_lpm_update_add_replace(&lpm, &r->node)
+		&& cds_lpm_update_lookup_exact(&lpm, &addr, 24) == &r->node,
+		"replace");
+	cds_lpm_update_commit(&lpm);
+	ok(lookup(ipv4(10, 1, 2, 4)) == 124 && cds_lpm_count(lpm.root) == 6,
+		"replace keeps the count");
+
+	if (cds_lpm_update_begin(&lpm))
+		abort();
+	addr = ipv4(10, 1, 2, 3);
+	if (cds_lpm_update_del(&lpm, &addr, 32))
+		abort();
+	addr = ipv4(10, 0, 0, 0);
+	if (cds_lpm_update_del(&lpm, &addr, 8))
+		abort();
+	cds_lpm_update_abort(&lpm);
+	ok(lookup(ipv4(10, 1, 2, 3)) == 32 && lookup(ipv4(10, 2, 0, 1)) == 8,
+		"abort leaves the trie unchanged");
+
+	addr = ipv4(10, 1, 2, 0);
+	if (del(&lpm, &addr, 24))
+		abort();
+	addr = ipv4(10, 0, 0, 0);
+	rcu_read_lock();
+	stable = caa_container_of(cds_lpm_lookup_exact(cds_lpm_read(&lpm),
+			&addr, 8), struct route, node);
+	rcu_read_unlock();
+	addr = ipv4(10, 1, 2, 3);
+	if (del(&lpm, &addr, 32))
+		abort();
+	test_concurrent();
+
+	ok(!test_random(32, &seed), "random IPv4 prefixes");
+	ok(!test_random(128, &seed), "random IPv6 prefixes");
+	ok(!test_random(20, &seed), "random prefixes of a 20-bit key");
+
+	rcu_barrier();
+	cds_lpm_destroy(&lpm);
+	ok(nr_freed == nr_allocated, "every route is freed once");
+
+	rcu_unregister_thread();
+	return exit_status();
+}
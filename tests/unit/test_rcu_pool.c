@@ -0,0 +1,192 @@
+/*
+ * test_rcu_pool.c
+ *
+ * Userspace RCU library - test object pool with deferred reuse
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#include <stdlib.h>
+#include <stdint.h>
+#include <pthread.h>
+#include <urcu.h>
+#include <urcu/rculfhash.h>
+#include <urcu/rcupool.h>
+
+#include "tap.h"
+
+#define NR_OBJS		1000
+#define OBJ_ALIGN	64
+#define NR_THREADS	4
+#define NR_LOOPS	200
+#define NR_HELD		100
+
+struct test_obj {
+	struct cds_lfht_node node;
+	unsigned long key;
+};
+
+static void *freed[NR_OBJS];
+static unsigned long nr_dup;
+
+static int cmp_ptr(const void *a, const void *b)
+{
+	uintptr_t pa = (uintptr_t) *(void * const *) a;
+	uintptr_t pb = (uintptr_t) *(void * const *) b;
+
+	return pa < pb ? -1 : pa > pb;
+}
+
+static int was_freed(void *obj)
+{
+	return bsearch(&obj, freed, NR_OBJS, sizeof(*freed), cmp_ptr) != NULL;
+}
+
+static void *thread_fn(void *arg)
+{
+	struct cds_rcu_pool *pool = arg;
+	void *objs[NR_OBJS];
+	int i;
+
+	rcu_register_thread();
+	for (i = 0; i < NR_OBJS; i++)
+		objs[i] = cds_rcu_pool_alloc(pool);
+	for (i = 0; i < NR_OBJS; i++)
+		cds_rcu_pool_free(pool, objs[i]);
+	rcu_unregister_thread();
+	return NULL;
+}
+
+/* Objects held by a thread keep its tag: check none is handed out twice. */
+static void *thread_stress(void *arg)
+{
+	struct cds_rcu_pool *pool = arg;
+	struct test_obj *objs[NR_HELD];
+	unsigned long tag = (unsigned long) pthread_self();
+	int i, j;
+
+	rcu_register_thread();
+	for (i = 0; i < NR_LOOPS; i++) {
+		for (j = 0; j < NR_HELD; j++) {
+			objs[j] = cds_rcu_pool_alloc(pool);
+			if (!objs[j])
+				abort();
+			objs[j]->key = tag;
+		}
+		for (j = 0; j < NR_HELD; j++) {
+			if (CMM_LOAD_SHARED(objs[j]->key) != tag)
+				uatomic_inc(&nr_dup);
+			cds_rcu_pool_free(pool, objs[j]);
+		}
+	}
+	rcu_unregister_thread();
+	return NULL;
+}
+
+int main(int argc, char **argv)
+{
+	struct cds_rcu_pool *pool;
+	struct cds_lfht *ht;
+	struct cds_lfht_iter iter;
+	struct test_obj *obj;
+	void *objs[NR_OBJS];
+	pthread_t thread, threads[NR_THREADS];
+	int i, nr_bad;
+
+	plan_tests(7);
+
+	rcu_register_thread();
+	ok(!cds_rcu_pool_create(sizeof(struct test_obj), 3),
+		"reject alignment not a power of 2");
+	pool = cds_rcu_pool_create(sizeof(struct test_obj), OBJ_ALIGN);
+	if (!pool)
+		abort();
+
+	nr_bad = 0;
+	for (i = 0; i < NR_OBJS; i++) {
+		objs[i] = cds_rcu_pool_alloc(pool);
+		if (!objs[i] || ((uintptr_t) objs[i] & (OBJ_ALIGN - 1)))
+			nr_bad++;
+	}
+	ok(!nr_bad, "allocated aligned objects");
+
+	/* No grace period can elapse within the read-side critical section. */
+	rcu_read_lock();
+	for (i = 0; i < NR_OBJS; i++) {
+		cds_rcu_pool_free(pool, objs[i]);
+		freed[i] = objs[i];
+	}
+	qsort(freed, NR_OBJS, sizeof(*freed), cmp_ptr);
+	nr_bad = 0;
+	for (i = 0; i < NR_OBJS; i++) {
+		objs[i] = cds_rcu_pool_alloc(pool);
+		if (was_freed(objs[i]))
+			nr_bad++;
+	}
+	rcu_read_unlock();
+	ok(!nr_bad, "no reuse before a grace period");
+
+	synchronize_rcu();
+	nr_bad = 0;
+	for (i = 0; i < NR_OBJS; i++) {
+		if (!was_freed(cds_rcu_pool_alloc(pool)))
+			nr_bad++;
+	}
+	ok(!nr_bad, "freed objects reused after a grace period");
+
+	ht = cds_lfht_new(1, 1, 0, CDS_LFHT_AUTO_RESIZE, NULL);
+	if (!ht)
+		abort();
+	for (i = 0; i < NR_OBJS; i++) {
+		obj = cds_rcu_pool_alloc(pool);
+		cds_lfht_node_init(&obj->node);
+		obj->key = i;
+		rcu_read_lock();
+		cds_lfht_add(ht, i, &obj->node);
+		rcu_read_unlock();
+	}
+	nr_bad = 0;
+	rcu_read_lock();
+	cds_lfht_for_each_entry(ht, &iter, obj, node) {
+		if (cds_lfht_del(ht, &obj->node))
+			nr_bad++;
+		else
+			cds_rcu_pool_free(pool, obj);
+	}
+	rcu_read_unlock();
+	ok(!nr_bad, "free hash table nodes from read-side");
+	if (cds_lfht_destroy(ht, NULL))
+		abort();
+
+	if (pthread_create(&thread, NULL, thread_fn, pool))
+		abort();
+	if (pthread_join(thread, NULL))
+		abort();
+	ok(cds_rcu_pool_alloc(pool) != NULL, "alloc after thread exit");
+
+	for (i = 0; i < NR_THREADS; i++) {
+		if (pthread_create(&threads[i], NULL, thread_stress, pool))
+			abort();
+	}
+	for (i = 0; i < NR_THREADS; i++) {
+		if (pthread_join(threads[i], NULL))
+			abort();
+	}
+	ok(!nr_dup, "concurrent alloc and free hand out objects once");
+
+	cds_rcu_pool_destroy(pool);
+	rcu_unregister_thread();
+	return exit_status();
+}
@@ -0,0 +1,130 @@
+/*
+ * test_rcu_reclaim.c
+ *
+ * Userspace RCU library - test urgent reclamation on memory pressure
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <unistd.h>
+#include <errno.h>
+#include <poll.h>
+#include <time.h>
+#include <urcu.h>
+
+#include "tap.h"
+
+#define DELAY_MS	1000
+#define NR_CBS		200
+#define NR_LAZY		10
+
+static struct rcu_head heads[NR_CBS + NR_LAZY];
+static unsigned long nr_invoked;
+
+static void count_cb(struct rcu_head *head)
+{
+	uatomic_inc(&nr_invoked);
+}
+
+static unsigned long now_ms(void)
+{
+	struct timespec ts;
+
+	if (clock_gettime(CLOCK_MONOTONIC, &ts))
+		abort();
+	return ts.tv_sec * 1000 + ts.tv_nsec / 1000000;
+}
+
+/* Wait at most timeout_ms for nr callbacks to be invoked in total. */
+static int wait_invoked(unsigned long nr, unsigned long timeout_ms)
+{
+	unsigned long start = now_ms();
+
+	while (uatomic_read(&nr_invoked) < nr) {
+		if (now_ms() - start > timeout_ms)
+			return 0;
+		(void) poll(NULL, 0, 1);
+	}
+	return 1;
+}
+
+int main(int argc, char **argv)
+{
+	struct call_rcu_attr attr = {
+		.min_delay_ms = DELAY_MS,
+		.max_delay_ms = DELAY_MS,
+		.lazy_delay_ms = 10 * DELAY_MS,
+	};
+	char path[] = "/tmp/test_rcu_reclaim.XXXXXX";
+	struct call_rcu_data *crdp;
+	int i, fd, ret;
+
+	plan_tests(7);
+
+	rcu_register_thread();
+	crdp = create_call_rcu_data_attr(0, -1, &attr);
+	if (!crdp)
+		abort();
+	set_thread_call_rcu_data(crdp);
+	/* Let the first batch start, the next ones wait DELAY_MS. */
+	call_rcu(&heads[0], count_cb);
+	if (!wait_invoked(1, 10 * DELAY_MS))
+		abort();
+	nr_invoked = 0;
+
+	for (i = 0; i < NR_LAZY; i++)
+		call_rcu_lazy(&heads[NR_CBS + i], count_cb);
+	for (i = 0; i < NR_CBS; i++)
+		call_rcu(&heads[i], count_cb);
+	(void) poll(NULL, 0, DELAY_MS / 10);
+	ok(uatomic_read(&nr_invoked) == 0, "callbacks delayed by the policy");
+	rcu_reclaim_urgent();
+	ok(wait_invoked(NR_CBS + NR_LAZY, DELAY_MS / 2),
+		"rcu_reclaim_urgent drains lazy and regular callbacks");
+
+	/* Below the low watermark: back to the normal policy. */
+	call_rcu_lazy(&heads[0], count_cb);
+	(void) poll(NULL, 0, DELAY_MS / 10);
+	ok(uatomic_read(&nr_invoked) == NR_CBS + NR_LAZY,
+		"normal policy after the backlog is drained");
+	rcu_barrier();
+
+	fd = mkstemp(path);
+	if (fd < 0)
+		abort();
+	ok(rcu_reclaim_monitor_start(path, 0, 0) == 0,
+		"monitor changes of a file");
+	ok(rcu_reclaim_monitor_start(path, 0, 0) == -EBUSY,
+		"single monitor");
+	rcu_reclaim_monitor_stop();
+	ok(rcu_reclaim_monitor_start("/nonexistent/memory.events", 0, 0)
+			== -ENOENT,
+		"monitor of missing file fails");
+	ret = rcu_reclaim_monitor_start(NULL, 150000, 2000000);
+	diag("PSI memory trigger: %d", ret);
+	rcu_reclaim_monitor_stop();
+	ok(ret == 0 || ret == -ENOENT || ret == -EACCES || ret == -EINVAL
+			|| ret == -EPERM || ret == -EOPNOTSUPP,
+		"PSI monitor started or unsupported");
+	(void) close(fd);
+	(void) unlink(path);
+
+	set_thread_call_rcu_data(NULL);
+	call_rcu_data_free(crdp);
+	rcu_unregister_thread();
+	return exit_status();
+}
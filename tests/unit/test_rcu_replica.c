@@ -0,0 +1,170 @@
+/*
+ * test_rcu_replica.c
+ *
+ * Userspace RCU library - test RCU NUMA node replicas
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#include <stdlib.h>
+#include <errno.h>
+#include <poll.h>
+#include <pthread.h>
+#include <urcu.h>
+#include <urcu/rcureplica.h>
+
+#include "tap.h"
+
+#define NR_READERS	2
+#define NR_UPDATES	2000
+#define NR_FIELDS	16
+
+struct config {
+	int node;
+	unsigned long field[NR_FIELDS];
+};
+
+static struct cds_rcu_replica replica;
+static int fail_copy;
+static unsigned long nr_copies, nr_frees;
+static int stop;
+static unsigned long nr_bad_read, nr_reads;
+
+static void *copy_config(const void *obj, int node, void *priv)
+{
+	struct config *copy;
+
+	if (fail_copy)
+		return NULL;
+	copy = malloc(sizeof(*copy));
+	if (!copy)
+		abort();
+	*copy = *(const struct config *) obj;
+	copy->node = node;
+	nr_copies++;
+	return copy;
+}
+
+static void free_config(void *obj, int node, void *priv)
+{
+	if (((struct config *) obj)->node != node)
+		abort();
+	uatomic_inc(&nr_frees);
+	free(obj);
+}
+
+static void set_config(struct config *config, unsigned long v)
+{
+	int i;
+
+	for (i = 0; i < NR_FIELDS; i++)
+		config->field[i] = v;
+}
+
+static struct config *version(void)
+{
+	struct config *config;
+
+	rcu_read_lock();
+	config = rcu_dereference_replica(&replica);
+	rcu_read_unlock();
+	return config;
+}
+
+/* All fields of a version hold its generation: check consistency. */
+static void *thr_reader(void *arg)
+{
+	struct config *config;
+	int i;
+
+	rcu_register_thread();
+	while (!uatomic_read(&stop)) {
+		rcu_read_lock();
+		config = rcu_dereference_replica(&replica);
+		for (i = 1; i < NR_FIELDS; i++) {
+			if (config->field[i] != config->field[0])
+				uatomic_inc(&nr_bad_read);
+		}
+		if (config->node < 0
+				|| config->node >= cds_rcu_replica_nr_nodes())
+			uatomic_inc(&nr_bad_read);
+		rcu_read_unlock();
+		uatomic_inc(&nr_reads);
+	}
+	rcu_unregister_thread();
+	return NULL;
+}
+
+int main(int argc, char **argv)
+{
+	pthread_t tid[NR_READERS];
+	struct config config, *current;
+	unsigned long i;
+	int node, nr_nodes;
+
+	plan_tests(7);
+
+	rcu_register_thread();
+	cds_rcu_replica_init(&replica, copy_config, free_config, NULL);
+	ok(version() == NULL, "no replica before update");
+
+	nr_nodes = cds_rcu_replica_nr_nodes();
+	node = cds_rcu_replica_current_node();
+	ok(nr_nodes >= 1 && node >= 0 && node < nr_nodes,
+		"current node %d of %d", node, nr_nodes);
+
+	set_config(&config, 1);
+	ok(cds_rcu_replica_update(&replica, &config) == 0
+			&& nr_copies == (unsigned long) nr_nodes,
+		"update copies to each node");
+	current = version();
+	ok(current && current != &config && current->field[0] == 1
+			&& current->node == cds_rcu_replica_current_node(),
+		"readers get the replica of their node");
+
+	fail_copy = 1;
+	set_config(&config, 2);
+	ok(cds_rcu_replica_update(&replica, &config) == -ENOMEM
+			&& current == version(),
+		"failed copy keeps the previous version");
+	fail_copy = 0;
+
+	for (i = 0; i < NR_READERS; i++) {
+		if (pthread_create(&tid[i], NULL, thr_reader, NULL))
+			abort();
+	}
+	for (i = 2; i <= NR_UPDATES; i++) {
+		set_config(&config, i);
+		if (cds_rcu_replica_update(&replica, &config))
+			abort();
+		if (uatomic_read(&nr_reads) < i / 4)
+			(void) poll(NULL, 0, 1);
+	}
+	uatomic_set(&stop, 1);
+	for (i = 0; i < NR_READERS; i++) {
+		if (pthread_join(tid[i], NULL))
+			abort();
+	}
+	ok(nr_bad_read == 0, "concurrent readers see consistent replicas "
+		"(%lu reads)", nr_reads);
+
+	rcu_barrier();
+	cds_rcu_replica_destroy(&replica);
+	ok(nr_frees == nr_copies
+			&& nr_copies == (unsigned long) NR_UPDATES * nr_nodes,
+		"replicas of each version freed");
+	rcu_unregister_thread();
+	return exit_status();
+}
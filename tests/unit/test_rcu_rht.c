@@ -0,0 +1,318 @@
+/*
+ * test_rcu_rht.c
+ *
+ * Userspace RCU library - test relativistic hash table
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#include <stdlib.h>
+#include <errno.h>
+#include <poll.h>
+#include <pthread.h>
+#include <urcu.h>
+#include <urcu/hash.h>
+#include <urcu/rcurht.h>
+
+#include "tap.h"
+
+#define NR_KEYS		4096
+#define NR_STABLE	2048
+#define NR_RESIZES	12
+#define NR_READERS	2
+#define ITEM_MAGIC	0x6974656dUL
+
+struct item {
+	struct cds_rht_node node;
+	unsigned long magic;
+	unsigned long key;
+	unsigned long value;
+	struct rcu_head rcu_head;
+};
+
+static struct cds_rht *ht;
+static int stop;
+static unsigned long nr_missed, nr_bad_iter, nr_reads, nr_iters;
+
+static unsigned long hash_key(unsigned long key)
+{
+	return (unsigned long) urcu_hash_u64(key, 0);
+}
+
+static int match(struct cds_rht_node *node, const void *key)
+{
+	return caa_container_of(node, struct item, node)->key
+		== *(const unsigned long *) key;
+}
+
+static struct item *new_item(unsigned long key, unsigned long value)
+{
+	struct item *item = malloc(sizeof(*item));
+
+	if (!item)
+		abort();
+	cds_rht_node_init(&item->node);
+	item->magic = ITEM_MAGIC;
+	item->key = key;
+	item->value = value;
+	return item;
+}
+
+static void free_item_rcu(struct rcu_head *head)
+{
+	struct item *item = caa_container_of(head, struct item, rcu_head);
+
+	item->magic = 0;
+	free(item);
+}
+
+static struct item *lookup(unsigned long key)
+{
+	struct cds_rht_iter iter;
+	struct cds_rht_node *node;
+
+	cds_rht_lookup(ht, hash_key(key), match, &key, &iter);
+	node = cds_rht_iter_get_node(&iter);
+	return node ? caa_container_of(node, struct item, node) : NULL;
+}
+
+static unsigned long count_nodes(void)
+{
+	unsigned long count;
+	long before, after;
+
+	rcu_read_lock();
+	cds_rht_count_nodes(ht, &before, &count, &after);
+	rcu_read_unlock();
+	return count;
+}
+
+/* Number of keys below NR_KEYS missing from the table or iterated twice. */
+static unsigned long check_all(void)
+{
+	static unsigned char seen[NR_KEYS];
+	struct cds_rht_iter iter;
+	struct item *item;
+	unsigned long key, bad = 0;
+
+	for (key = 0; key < NR_KEYS; key++)
+		seen[key] = 0;
+	rcu_read_lock();
+	cds_rht_for_each_entry(ht, &iter, item, node) {
+		if (item->key < NR_KEYS && seen[item->key]++)
+			bad++;
+	}
+	for (key = 0; key < NR_KEYS; key++) {
+		if (!seen[key] || !lookup(key))
+			bad++;
+	}
+	rcu_read_unlock();
+	return bad;
+}
+
+static void *thr_reader(void *arg)
+{
+	unsigned int seed = (unsigned int) (unsigned long) arg;
+	struct cds_rht_iter iter;
+	struct item *item;
+	unsigned long key, nr_stable;
+
+	rcu_register_thread();
+	while (!uatomic_read(&stop)) {
+		rcu_read_lock();
+		key = rand_r(&seed) % NR_STABLE;
+		item = lookup(key);
+		if (!item || item->magic != ITEM_MAGIC || item->key != key)
+			uatomic_inc(&nr_missed);
+		if (uatomic_add_return(&nr_reads, 1) % 512 == 0) {
+			nr_stable = 0;
+			cds_rht_for_each_entry(ht, &iter, item, node) {
+				if (item->key < NR_STABLE)
+					nr_stable++;
+			}
+			if (nr_stable != NR_STABLE)
+				uatomic_inc(&nr_bad_iter);
+			uatomic_inc(&nr_iters);
+		}
+		rcu_read_unlock();
+	}
+	rcu_unregister_thread();
+	return NULL;
+}
+
+static void *thr_writer(void *arg)
+{
+	unsigned int seed = 1;
+	struct item *item;
+	unsigned long key;
+
+	rcu_register_thread();
+	while (!uatomic_read(&stop)) {
+		key = NR_STABLE + rand_r(&seed) % (NR_KEYS - NR_STABLE);
+		rcu_read_lock();
+		item = lookup(key);
+		if (item) {
+			if (!cds_rht_del(ht, &item->node))
+				call_rcu(&item->rcu_head, free_item_rcu);
+		} else {
+			cds_rht_add(ht, hash_key(key), &new_item(key, 0)->node);
+		}
+		rcu_read_unlock();
+	}
+	rcu_unregister_thread();
+	return NULL;
+}
+
+static void test_concurrent(void)
+{
+	pthread_t reader[NR_READERS], writer;
+	unsigned long i;
+
+	for (i = 0; i < NR_READERS; i++) {
+		if (pthread_create(&reader[i], NULL, thr_reader,
+				(void *) (i + 1)))
+			abort();
+	}
+	if (pthread_create(&writer, NULL, thr_writer, NULL))
+		abort();
+	for (i = 0; i < NR_RESIZES; i++) {
+		cds_rht_resize(ht, NR_KEYS);
+		(void) poll(NULL, 0, 1);
+		cds_rht_resize(ht, 1);
+		(void) poll(NULL, 0, 1);
+	}
+	uatomic_set(&stop, 1);
+	for (i = 0; i < NR_READERS; i++) {
+		if (pthread_join(reader[i], NULL))
+			abort();
+	}
+	if (pthread_join(writer, NULL))
+		abort();
+	ok(!nr_missed, "lookups never miss during resizes (%lu reads)",
+		nr_reads);
+	ok(!nr_bad_iter,
+		"iterations return each node once during resizes (%lu)",
+		nr_iters);
+}
+
+/* Delete all the nodes of the table. */
+static void del_all(void)
+{
+	struct cds_rht_iter iter;
+	struct item *item;
+
+	rcu_read_lock();
+	cds_rht_for_each_entry(ht, &iter, item, node) {
+		if (cds_rht_del(ht, &item->node))
+			abort();
+		call_rcu(&item->rcu_head, free_item_rcu);
+	}
+	rcu_read_unlock();
+}
+
+int main(int argc, char **argv)
+{
+	struct cds_rht_iter iter;
+	struct cds_rht_node *node;
+	struct item *a, *b, *c, *item;
+	unsigned long key, nr;
+
+	plan_tests(15);
+
+	rcu_register_thread();
+
+	ok(!cds_rht_new(3, 1, 0, 0) && !cds_rht_new(1, 1, 32, 0)
+		&& !cds_rht_new(1, 128, 64, 0),
+		"reject invalid sizes");
+	ht = cds_rht_new(1, 1, 0, 0);
+	if (!ht)
+		abort();
+
+	key = 7;
+	a = new_item(key, 1);
+	b = new_item(key, 2);
+	c = new_item(key, 3);
+	rcu_read_lock();
+	ok(!lookup(key), "lookup in an empty table");
+	ok(cds_rht_add_unique(ht, hash_key(key), match, &key, &a->node)
+			== &a->node
+		&& cds_rht_add_unique(ht, hash_key(key), match, &key,
+			&b->node) == &a->node
+		&& lookup(key) == a,
+		"add unique returns the node of the key");
+	ok(cds_rht_add_replace(ht, hash_key(key), match, &key, &b->node)
+			== &a->node && lookup(key) == b
+		&& cds_rht_del(ht, &a->node) == -ENOENT,
+		"add replace returns the replaced node");
+	cds_rht_add(ht, hash_key(key), &c->node);
+	nr = 0;
+	cds_rht_for_each_duplicate(ht, hash_key(key), match, &key, &iter,
+			node)
+		nr++;
+	ok(nr == 2 && count_nodes() == 2, "add of a duplicate key");
+	ok(!cds_rht_del(ht, &b->node) && lookup(key) == c
+		&& !cds_rht_del(ht, &c->node) && !lookup(key)
+		&& cds_rht_del(ht, &c->node) == -ENOENT,
+		"delete");
+	rcu_read_unlock();
+	synchronize_rcu();
+	free(a);
+	free(b);
+	free(c);
+
+	rcu_read_lock();
+	for (key = 0; key < NR_KEYS; key++)
+		cds_rht_add(ht, hash_key(key), &new_item(key, key)->node);
+	rcu_read_unlock();
+	ok(!check_all() && count_nodes() == NR_KEYS,
+		"all nodes are found in 64 buckets");
+	cds_rht_resize(ht, NR_KEYS);
+	ok(!check_all() && count_nodes() == NR_KEYS,
+		"all nodes are found once after unzipping");
+	cds_rht_resize(ht, 1);
+	ok(!check_all() && count_nodes() == NR_KEYS,
+		"all nodes are found once after shrinking");
+	ok(cds_rht_destroy(ht) == -EPERM, "destroy of a non-empty table fails");
+
+	rcu_read_lock();
+	for (key = NR_STABLE; key < NR_KEYS; key++) {
+		item = lookup(key);
+		if (cds_rht_del(ht, &item->node))
+			abort();
+		call_rcu(&item->rcu_head, free_item_rcu);
+	}
+	rcu_read_unlock();
+	test_concurrent();
+	del_all();
+	ok(!count_nodes() && !cds_rht_destroy(ht), "destroy");
+
+	/* Automatic resizes are lazy: wait for their outcome. */
+	ht = cds_rht_new(1, 1, 0, CDS_RHT_AUTO_RESIZE);
+	if (!ht)
+		abort();
+	rcu_read_lock();
+	for (key = 0; key < NR_KEYS; key++)
+		cds_rht_add(ht, hash_key(key), &new_item(key, key)->node);
+	rcu_read_unlock();
+	(void) poll(NULL, 0, 50);
+	ok(!check_all(), "all nodes are found with automatic resizes");
+	del_all();
+	ok(!count_nodes() && !cds_rht_destroy(ht),
+		"destroy with automatic resizes");
+
+	rcu_barrier();
+	rcu_unregister_thread();
+	return exit_status();
+}
@@ -0,0 +1,138 @@
+/*
+ * test_rcu_seqcount.c
+ *
+ * Userspace RCU library - test RCU sequence counter
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#include <stdlib.h>
+#include <sched.h>
+#include <pthread.h>
+#include <urcu.h>
+
+#include "tap.h"
+
+#define NR_READERS	2
+#define NR_WRITES	20000
+
+struct obj {
+	unsigned long gen;
+	struct rcu_head head;
+};
+
+static struct rcu_seqcount seq = RCU_SEQCOUNT_INIT;
+static struct obj *a, *b;
+static int stop;
+static unsigned long nr_bad_read, nr_reads, nr_retries;
+
+static struct obj *obj_new(unsigned long gen)
+{
+	struct obj *obj;
+
+	obj = malloc(sizeof(*obj));
+	if (!obj)
+		abort();
+	obj->gen = gen;
+	return obj;
+}
+
+static void obj_free(struct rcu_head *head)
+{
+	free(caa_container_of(head, struct obj, head));
+}
+
+/* Both objects and the sequence must belong to the same write. */
+static void *thr_reader(void *arg)
+{
+	struct obj *ra, *rb;
+	unsigned long s;
+
+	rcu_register_thread();
+	while (!uatomic_read(&stop)) {
+		rcu_read_lock();
+		for (;;) {
+			s = rcu_seqcount_read_begin(&seq);
+			ra = rcu_dereference(a);
+			rb = rcu_dereference(b);
+			if (!rcu_seqcount_read_retry(&seq, s))
+				break;
+			uatomic_inc(&nr_retries);
+		}
+		if (ra->gen != rb->gen || ra->gen != s / 2)
+			uatomic_inc(&nr_bad_read);
+		rcu_read_unlock();
+		uatomic_inc(&nr_reads);
+	}
+	rcu_unregister_thread();
+	return NULL;
+}
+
+static void write_gen(unsigned long gen)
+{
+	struct obj *old_a = a, *old_b = b;
+
+	rcu_seqcount_write_begin(&seq);
+	rcu_assign_pointer(a, obj_new(gen));
+	/* Let readers see the intermediate state. */
+	if (!(gen % 64))
+		sched_yield();
+	rcu_assign_pointer(b, obj_new(gen));
+	rcu_seqcount_write_end(&seq);
+	call_rcu(&old_a->head, obj_free);
+	call_rcu(&old_b->head, obj_free);
+}
+
+int main(int argc, char **argv)
+{
+	pthread_t tid[NR_READERS];
+	unsigned long i, s;
+
+	plan_tests(5);
+
+	rcu_register_thread();
+	a = obj_new(0);
+	b = obj_new(0);
+	s = rcu_seqcount_read_begin(&seq);
+	ok(s == 0 && !rcu_seqcount_read_retry(&seq, s),
+		"no retry without write");
+	write_gen(1);
+	ok(rcu_seqcount_read_retry(&seq, s), "retry after write");
+	s = rcu_seqcount_read_begin(&seq);
+	ok(s == 2 && !(s & 1), "sequence even, increased by 2 per write");
+
+	for (i = 0; i < NR_READERS; i++) {
+		if (pthread_create(&tid[i], NULL, thr_reader, NULL))
+			abort();
+	}
+	for (i = 2; i <= NR_WRITES; i++)
+		write_gen(i);
+	uatomic_set(&stop, 1);
+	for (i = 0; i < NR_READERS; i++) {
+		if (pthread_join(tid[i], NULL))
+			abort();
+	}
+	ok(nr_bad_read == 0, "concurrent reads consistent (%lu reads, "
+		"%lu retries)", nr_reads, nr_retries);
+	ok(rcu_seqcount_read_begin(&seq) == 2 * NR_WRITES,
+		"final generation");
+
+	synchronize_rcu();
+	free(a);
+	free(b);
+	rcu_barrier();
+	rcu_unregister_thread();
+	return exit_status();
+}
@@ -0,0 +1,219 @@
+/*
+ * test_rcuhlist_lf.c
+ *
+ * Userspace RCU library - test lock-free RCU hlist updates
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#include <stdlib.h>
+#include <pthread.h>
+#include <urcu.h>
+#include <urcu/rcuhlist.h>
+
+#include "tap.h"
+
+#define NR_THREADS	4
+#define NR_KEYS		2000
+
+struct test_node {
+	unsigned long key;
+	int freed;
+	struct cds_hlist_node node;
+	struct rcu_head rcu;
+};
+
+static CDS_HLIST_HEAD(list);
+static int stop;
+static unsigned long nr_bad_read;
+
+static struct test_node *node_new(unsigned long key)
+{
+	struct test_node *tn;
+
+	tn = calloc(1, sizeof(*tn));
+	if (!tn)
+		abort();
+	tn->key = key;
+	return tn;
+}
+
+static void node_free_rcu(struct rcu_head *head)
+{
+	struct test_node *tn = caa_container_of(head, struct test_node, rcu);
+
+	tn->freed = 1;
+	free(tn);
+}
+
+static int del(struct test_node *tn)
+{
+	int ret;
+
+	rcu_read_lock();
+	ret = cds_hlist_del_lf_rcu(&tn->node, &list);
+	rcu_read_unlock();
+	if (!ret)
+		call_rcu(&tn->rcu, node_free_rcu);
+	return ret;
+}
+
+static unsigned long count(unsigned long *nr_odd)
+{
+	struct cds_hlist_node *pos;
+	struct test_node *tn;
+	unsigned long nr = 0;
+
+	*nr_odd = 0;
+	rcu_read_lock();
+	cds_hlist_for_each_entry_lf_rcu(tn, pos, &list, node) {
+		nr++;
+		if (tn->key & 1)
+			(*nr_odd)++;
+	}
+	rcu_read_unlock();
+	return nr;
+}
+
+static void *thr_reader(void *arg)
+{
+	struct cds_hlist_node *pos;
+	struct test_node *tn;
+
+	rcu_register_thread();
+	while (!uatomic_read(&stop)) {
+		rcu_read_lock();
+		cds_hlist_for_each_entry_lf_rcu(tn, pos, &list, node) {
+			if (CMM_LOAD_SHARED(tn->freed))
+				uatomic_inc(&nr_bad_read);
+		}
+		rcu_read_unlock();
+	}
+	rcu_unregister_thread();
+	return NULL;
+}
+
+/*
+ * Insert even keys at the head and odd keys after them, then remove
+ * the even keys.
+ */
+static void *thr_update(void *arg)
+{
+	static __thread struct test_node *even[NR_KEYS / 2];
+	unsigned long i, id = (unsigned long) arg;
+	struct test_node *tn;
+	unsigned long nr_err = 0;
+
+	rcu_register_thread();
+	for (i = 0; i < NR_KEYS / 2; i++) {
+		even[i] = node_new(id * NR_KEYS + 2 * i);
+		tn = node_new(id * NR_KEYS + 2 * i + 1);
+		rcu_read_lock();
+		cds_hlist_add_head_lf_rcu(&even[i]->node, &list);
+		if (cds_hlist_add_after_lf_rcu(&tn->node, &even[i]->node))
+			nr_err++;
+		rcu_read_unlock();
+		/* Remove while neighbours are inserted and removed. */
+		if (i > 0 && del(even[i - 1]))
+			nr_err++;
+	}
+	if (del(even[NR_KEYS / 2 - 1]))
+		nr_err++;
+	rcu_unregister_thread();
+	return (void *) nr_err;
+}
+
+int main(int argc, char **argv)
+{
+	struct test_node *a, *b, *c, *d;
+	pthread_t tid[NR_THREADS], reader;
+	unsigned long i, nr, nr_odd, nr_err = 0;
+	struct cds_hlist_node *pos;
+	void *ret;
+
+	plan_tests(8);
+
+	rcu_register_thread();
+	a = node_new(0);
+	b = node_new(1);
+	c = node_new(2);
+	d = node_new(3);
+	rcu_read_lock();
+	cds_hlist_add_head_lf_rcu(&c->node, &list);
+	cds_hlist_add_head_lf_rcu(&a->node, &list);
+	ok(cds_hlist_add_after_lf_rcu(&b->node, &a->node) == 0,
+		"insert after node");
+	rcu_read_unlock();
+	i = 0;
+	nr = 0;
+	rcu_read_lock();
+	cds_hlist_for_each_lf_rcu(pos, &list) {
+		if (cds_hlist_entry(pos, struct test_node, node)->key != i++)
+			nr++;
+	}
+	rcu_read_unlock();
+	ok(nr == 0 && i == 3, "nodes in insertion order");
+
+	ok(del(b) == 0 && count(&nr_odd) == 2 && nr_odd == 0,
+		"node removed");
+	rcu_read_lock();
+	/* Removal started, but not unlinked yet: insertion after it fails. */
+	uatomic_set(&a->node.next, (struct cds_hlist_node *)
+		((unsigned long) &c->node | CDS_HLIST_REMOVED_FLAG));
+	ok(cds_hlist_is_removed_lf_rcu(&a->node)
+			&& cds_hlist_add_after_lf_rcu(&d->node, &a->node) == -ENOENT
+			&& cds_hlist_del_lf_rcu(&a->node, &list) == -ENOENT,
+		"insertion after and removal of a node being removed fail");
+	rcu_read_unlock();
+	ok(count(&nr_odd) == 1, "iteration skips node being removed");
+	/* Removing the next node unlinks it. */
+	ok(del(c) == 0 && list.next == NULL, "removal unlinks flagged nodes");
+	synchronize_rcu();
+	free(a);
+	free(d);
+
+	if (pthread_create(&reader, NULL, thr_reader, NULL))
+		abort();
+	for (i = 0; i < NR_THREADS; i++) {
+		if (pthread_create(&tid[i], NULL, thr_update, (void *) i))
+			abort();
+	}
+	for (i = 0; i < NR_THREADS; i++) {
+		if (pthread_join(tid[i], &ret))
+			abort();
+		nr_err += (unsigned long) ret;
+	}
+	uatomic_set(&stop, 1);
+	if (pthread_join(reader, NULL))
+		abort();
+	nr = count(&nr_odd);
+	ok(nr_err == 0 && nr == NR_THREADS * NR_KEYS / 2 && nr_odd == nr,
+		"concurrent: odd keys left (%lu, %lu errors)", nr, nr_err);
+	ok(nr_bad_read == 0, "concurrent: readers see no freed node");
+
+	rcu_read_lock();
+	while (list.next) {
+		struct test_node *tn = cds_hlist_entry(list.next,
+				struct test_node, node);
+
+		if (cds_hlist_del_lf_rcu(&tn->node, &list))
+			abort();
+		call_rcu(&tn->rcu, node_free_rcu);
+	}
+	rcu_read_unlock();
+	rcu_barrier();
+	rcu_unregister_thread();
+	return exit_status();
+}
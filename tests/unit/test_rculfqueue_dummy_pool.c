@@ -0,0 +1,168 @@
+/*
+ * test_rculfqueue_dummy_pool.c
+ *
+ * Userspace RCU library - test recycling of RCU queue dummy nodes
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#define _LGPL_SOURCE
+#include <stdlib.h>
+#include <pthread.h>
+#include <urcu.h>
+#include <urcu/rculfqueue.h>
+
+#include "tap.h"
+
+#define POOL_SIZE	16
+#define NR_PINGPONG	10000
+#define GP_PERIOD	8
+#define NR_THREADS	2
+#define NR_LOOPS	100000UL
+
+struct obj {
+	struct cds_lfq_node_rcu node;
+	unsigned long value;
+};
+
+static struct rcu_flavor_struct counting_flavor;
+static unsigned long nr_call_rcu;
+static struct cds_lfq_queue_rcu queue;
+static struct obj objs[NR_THREADS][NR_LOOPS];
+static unsigned long nr_dequeued, sum_out;
+static int enqueue_done;
+
+static void counting_call_rcu(struct rcu_head *head,
+		void (*func)(struct rcu_head *head))
+{
+	uatomic_inc(&nr_call_rcu);
+	call_rcu(head, func);
+}
+
+/*
+ * Enqueue and dequeue a node NR_PINGPONG times, waiting for a grace
+ * period every GP_PERIOD times. Return the number of errors.
+ */
+static unsigned long pingpong(void)
+{
+	struct cds_lfq_node_rcu *node;
+	struct obj obj;
+	unsigned long i, nr_bad = 0;
+
+	for (i = 0; i < NR_PINGPONG; i++) {
+		cds_lfq_node_init_rcu(&obj.node);
+		rcu_read_lock();
+		cds_lfq_enqueue_rcu(&queue, &obj.node);
+		node = cds_lfq_dequeue_rcu(&queue);
+		if (node != &obj.node || cds_lfq_dequeue_rcu(&queue))
+			nr_bad++;
+		rcu_read_unlock();
+		if (!(i % GP_PERIOD))
+			synchronize_rcu();
+	}
+	return nr_bad;
+}
+
+static void *thr_enqueuer(void *arg)
+{
+	struct obj *tobjs = arg;
+	unsigned long i;
+
+	rcu_register_thread();
+	for (i = 0; i < NR_LOOPS; i++) {
+		tobjs[i].value = i;
+		cds_lfq_node_init_rcu(&tobjs[i].node);
+		rcu_read_lock();
+		cds_lfq_enqueue_rcu(&queue, &tobjs[i].node);
+		rcu_read_unlock();
+	}
+	rcu_unregister_thread();
+	return NULL;
+}
+
+static void *thr_dequeuer(void *arg)
+{
+	struct cds_lfq_node_rcu *node;
+	int done;
+
+	rcu_register_thread();
+	for (;;) {
+		done = uatomic_read(&enqueue_done);
+		rcu_read_lock();
+		node = cds_lfq_dequeue_rcu(&queue);
+		rcu_read_unlock();
+		if (node) {
+			uatomic_inc(&nr_dequeued);
+			uatomic_add(&sum_out,
+				caa_container_of(node, struct obj, node)->value);
+		} else if (done) {
+			break;
+		}
+	}
+	rcu_unregister_thread();
+	return NULL;
+}
+
+int main(int argc, char **argv)
+{
+	pthread_t enqueuers[NR_THREADS], dequeuers[NR_THREADS];
+	unsigned long i, nr_bad;
+
+	plan_tests(6);
+
+	counting_flavor = rcu_flavor;
+	counting_flavor.update_call_rcu = counting_call_rcu;
+	rcu_register_thread();
+
+	/* Without pool: one call_rcu() per drain. */
+	cds_lfq_init_rcu(&queue, counting_call_rcu);
+	nr_bad = pingpong();
+	ok(nr_bad == 0 && nr_call_rcu >= NR_PINGPONG,
+		"queue without pool frees dummy nodes with call_rcu (%lu)",
+		nr_call_rcu);
+	ok(cds_lfq_destroy_rcu(&queue) == 0, "queue without pool destroyed");
+
+	nr_call_rcu = 0;
+	ok(cds_lfq_init_rcu_flavor(&queue, &counting_flavor, POOL_SIZE) == 0,
+		"queue with pool initialized");
+	nr_bad = pingpong();
+	ok(nr_bad == 0 && nr_call_rcu == 0,
+		"dummy nodes recycled without call_rcu (%lu)", nr_call_rcu);
+
+	/* Concurrent drains, exhausting the pool. */
+	for (i = 0; i < NR_THREADS; i++) {
+		if (pthread_create(&enqueuers[i], NULL, thr_enqueuer, objs[i]))
+			abort();
+		if (pthread_create(&dequeuers[i], NULL, thr_dequeuer, NULL))
+			abort();
+	}
+	for (i = 0; i < NR_THREADS; i++) {
+		if (pthread_join(enqueuers[i], NULL))
+			abort();
+	}
+	uatomic_set(&enqueue_done, 1);
+	for (i = 0; i < NR_THREADS; i++) {
+		if (pthread_join(dequeuers[i], NULL))
+			abort();
+	}
+	ok(nr_dequeued == NR_THREADS * NR_LOOPS
+			&& sum_out == NR_THREADS * (NR_LOOPS * (NR_LOOPS - 1) / 2),
+		"concurrent enqueue and dequeue with pool");
+
+	rcu_barrier();
+	ok(cds_lfq_destroy_rcu(&queue) == 0, "queue with pool destroyed");
+	rcu_unregister_thread();
+	return exit_status();
+}
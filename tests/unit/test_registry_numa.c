@@ -0,0 +1,104 @@
+/*
+ * test_registry_numa.c
+ *
+ * Userspace RCU library - test the NUMA grouping of the reader registry
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#include <stdlib.h>
+#include <pthread.h>
+#include <sched.h>
+#include <urcu.h>
+
+#include "urcu-registry.h"
+#include "tap.h"
+
+#define NR_READERS	64
+
+static DEFINE_URCU_REGISTRY(test_registry);
+
+static int expected_group(int cpu)
+{
+	int node = urcu_numa_node_of_cpu(cpu);
+
+	if (node < 0)
+		node = 0;
+	return node % URCU_REGISTRY_GROUPS;
+}
+
+static void *thr_reader(void *arg)
+{
+	rcu_register_thread();
+	rcu_read_lock();
+	rcu_read_unlock();
+	rcu_unregister_thread();
+	return NULL;
+}
+
+int main(int argc, char **argv)
+{
+	struct cds_list_head nodes[CPU_SETSIZE];
+	pthread_t readers[NR_READERS];
+	cpu_set_t allowed, one;
+	int cpu, nr_cpus, mismatch = 0, misplaced = 0, nr_tested = 0;
+	unsigned int i;
+
+	plan_tests(3);
+
+	nr_cpus = sysconf(_SC_NPROCESSORS_CONF);
+	urcu_registry_init();
+	for (cpu = 0; cpu < nr_cpus && cpu < URCU_REGISTRY_MAX_CPUS; cpu++) {
+		if (urcu_registry_node_of_cpu(cpu) != urcu_numa_node_of_cpu(cpu))
+			mismatch++;
+	}
+	ok(!mismatch, "cached node of %d CPUs matches sysfs", nr_cpus);
+
+	/* Register from each allowed CPU in turn. */
+	if (sched_getaffinity(0, sizeof(allowed), &allowed))
+		abort();
+	for (cpu = 0; cpu < CPU_SETSIZE && cpu < URCU_REGISTRY_MAX_CPUS; cpu++) {
+		if (!CPU_ISSET(cpu, &allowed))
+			continue;
+		CPU_ZERO(&one);
+		CPU_SET(cpu, &one);
+		if (sched_setaffinity(0, sizeof(one), &one))
+			continue;
+		i = urcu_registry_add(&test_registry, &nodes[cpu]);
+		if (i != (unsigned int) expected_group(cpu)
+				|| nodes[cpu].prev != &test_registry.group[i])
+			misplaced++;
+		nr_tested++;
+	}
+	(void) sched_setaffinity(0, sizeof(allowed), &allowed);
+	ok(nr_tested && !misplaced,
+		"readers join the group of their node (%d CPUs, %d misplaced)",
+		nr_tested, misplaced);
+
+	/* Registrations concurrent with grace periods. */
+	for (i = 0; i < NR_READERS; i++) {
+		if (pthread_create(&readers[i], NULL, thr_reader, NULL))
+			abort();
+	}
+	for (i = 0; i < NR_READERS; i++) {
+		synchronize_rcu();
+		if (pthread_join(readers[i], NULL))
+			abort();
+	}
+	synchronize_rcu();
+	ok(1, "%d readers registered during grace periods", NR_READERS);
+
+	return exit_status();
+}
@@ -0,0 +1,184 @@
+/*
+ * test_rt_prealloc.c
+ *
+ * Userspace RCU library - test allocation-free barriers, flushes and queues
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#define _LGPL_SOURCE
+#include <stdlib.h>
+#include <dirent.h>
+#include <urcu.h>
+#include <urcu/rculfqueue.h>
+#include <urcu/rculfhash.h>
+
+#include "workqueue.h"
+#include "tap.h"
+
+#define NR_CRDPS	3
+#define NR_ROUNDS	20
+#define POOL_SIZE	16
+
+/*
+ * Count the allocations of all threads while counting is set, through
+ * the glibc allocator entry points.
+ */
+extern void *__libc_malloc(size_t size);
+extern void *__libc_calloc(size_t nmemb, size_t size);
+extern void *__libc_realloc(void *ptr, size_t size);
+
+static int counting;
+static unsigned long nr_allocs;
+
+void *malloc(size_t size)
+{
+	if (uatomic_read(&counting))
+		uatomic_inc(&nr_allocs);
+	return __libc_malloc(size);
+}
+
+void *calloc(size_t nmemb, size_t size)
+{
+	if (uatomic_read(&counting))
+		uatomic_inc(&nr_allocs);
+	return __libc_calloc(nmemb, size);
+}
+
+void *realloc(void *ptr, size_t size)
+{
+	if (uatomic_read(&counting))
+		uatomic_inc(&nr_allocs);
+	return __libc_realloc(ptr, size);
+}
+
+static void count_begin(void)
+{
+	uatomic_set(&nr_allocs, 0);
+	uatomic_set(&counting, 1);
+}
+
+static unsigned long count_end(void)
+{
+	uatomic_set(&counting, 0);
+	return uatomic_read(&nr_allocs);
+}
+
+static unsigned long nr_tasks(void)
+{
+	struct dirent *entry;
+	unsigned long nr = 0;
+	DIR *dir;
+
+	dir = opendir("/proc/self/task");
+	if (!dir)
+		return 0;
+	while ((entry = readdir(dir)) != NULL) {
+		if (entry->d_name[0] != '.')
+			nr++;
+	}
+	closedir(dir);
+	return nr;
+}
+
+static void noop_cb(struct rcu_head *head)
+{
+}
+
+int main(int argc, char **argv)
+{
+	struct call_rcu_data *crdps[NR_CRDPS];
+	struct rcu_head heads[NR_CRDPS];
+	struct urcu_workqueue *workqueue;
+	struct cds_lfq_queue_rcu queue;
+	struct cds_lfq_node_rcu nodes[POOL_SIZE], *node;
+	struct cds_lfht *ht;
+	unsigned long i, nr, nr_bad = 0, tasks;
+
+	plan_tests(6);
+
+	rcu_register_thread();
+
+	for (i = 0; i < NR_CRDPS; i++)
+		crdps[i] = create_call_rcu_data(0, -1);
+	(void) get_default_call_rcu_data();
+	/* Wait for the call_rcu threads to start. */
+	for (i = 0; i < 2 * NR_ROUNDS; i++) {
+		if (i == NR_ROUNDS)
+			count_begin();
+		rcu_barrier();
+	}
+	nr = count_end();
+	ok(nr == 0, "rcu_barrier() does not allocate (%lu allocations)", nr);
+
+	/* The first call_rcu() of the thread sets up its batching. */
+	for (i = 0; i < 2 * NR_ROUNDS; i++) {
+		if (i == NR_ROUNDS)
+			count_begin();
+		set_thread_call_rcu_data(crdps[i % NR_CRDPS]);
+		call_rcu(&heads[i % NR_CRDPS], noop_cb);
+		rcu_barrier_crdp_set(crdps, NR_CRDPS);
+	}
+	nr = count_end();
+	set_thread_call_rcu_data(NULL);
+	ok(nr == 0, "rcu_barrier_crdp_set() does not allocate (%lu allocations)",
+		nr);
+	for (i = 0; i < NR_CRDPS; i++)
+		call_rcu_data_free(crdps[i]);
+
+	workqueue = urcu_workqueue_create_nr(0, -1, 2, NULL,
+		NULL, NULL, NULL, NULL, NULL, NULL, NULL);
+	for (i = 0; i < 2 * NR_ROUNDS; i++) {
+		if (i == NR_ROUNDS)
+			count_begin();
+		urcu_workqueue_flush_queued_work(workqueue);
+	}
+	nr = count_end();
+	ok(nr == 0, "workqueue flush does not allocate (%lu allocations)", nr);
+	urcu_workqueue_destroy(workqueue);
+
+	ok(!cds_lfq_init_rcu_flavor(&queue, &rcu_flavor, POOL_SIZE),
+		"queue with dummy node pool");
+	/*
+	 * Each drain takes a fresh dummy node from the pool, without grace
+	 * period: the pool holds one for each slot but the one of the
+	 * initial dummy node.
+	 */
+	count_begin();
+	for (i = 0; i < POOL_SIZE - 1; i++) {
+		cds_lfq_node_init_rcu(&nodes[i]);
+		rcu_read_lock();
+		cds_lfq_enqueue_rcu(&queue, &nodes[i]);
+		node = cds_lfq_dequeue_rcu(&queue);
+		rcu_read_unlock();
+		if (node != &nodes[i])
+			nr_bad++;
+	}
+	nr = count_end();
+	ok(nr == 0 && !nr_bad,
+		"draining the queue uses the prefilled pool (%lu allocations)", nr);
+	synchronize_rcu();
+	(void) cds_lfq_destroy_rcu(&queue);
+
+	ht = cds_lfht_new(1, 1, 0, CDS_LFHT_PREALLOC, NULL);
+	tasks = nr_tasks();
+	cds_lfht_resize(ht, 1UL << 16);
+	ok(ht && nr_tasks() == tasks,
+		"resizes of a preallocated table create no thread");
+	(void) cds_lfht_destroy(ht, NULL);
+
+	rcu_unregister_thread();
+	return exit_status();
+}
@@ -0,0 +1,239 @@
+/*
+ * test_shm_domain.c
+ *
+ * Userspace RCU library - test RCU domain shared between processes
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#include <stdlib.h>
+#include <errno.h>
+#include <poll.h>
+#include <pthread.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/wait.h>
+#include <urcu/uatomic.h>
+#include <urcu/shm-domain.h>
+
+#include "tap.h"
+
+#define NR_SLOTS	4
+#define NR_CHILDREN	2
+#define NR_UPDATES	2000
+
+/* Test state shared with the child processes. */
+struct shared {
+	int in_cs;
+	int release;
+	int stop;
+	unsigned long nr_reads, nr_bad;
+	unsigned long cur;		/* Index of the published value. */
+	int values[2];
+};
+
+static struct urcu_shm_domain *domain;
+static struct shared *shared;
+static int gp_done;
+
+static void *map_shared(size_t len)
+{
+	void *p;
+
+	p = mmap(NULL, len, PROT_READ | PROT_WRITE,
+		MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+	if (p == MAP_FAILED)
+		abort();
+	return p;
+}
+
+static void child_wait_release(void)
+{
+	struct urcu_shm_reader reader;
+
+	if (urcu_shm_register_reader(domain, &reader))
+		_exit(1);
+	urcu_shm_read_lock(&reader);
+	uatomic_set(&shared->in_cs, 1);
+	while (!uatomic_read(&shared->release))
+		(void) poll(NULL, 0, 1);
+	urcu_shm_read_unlock(&reader);
+	urcu_shm_unregister_reader(&reader);
+	_exit(0);
+}
+
+/* Dies within a read-side critical section. */
+static void child_crash(void)
+{
+	struct urcu_shm_reader reader;
+
+	if (urcu_shm_register_reader(domain, &reader))
+		_exit(1);
+	urcu_shm_read_lock(&reader);
+	_exit(0);
+}
+
+/* Takes all slots and exits without releasing them. */
+static void child_take_all(void)
+{
+	struct urcu_shm_reader reader;
+	int i;
+
+	for (i = 0; i < NR_SLOTS; i++) {
+		if (urcu_shm_register_reader(domain, &reader))
+			_exit(1);
+	}
+	_exit(0);
+}
+
+static void child_reader(void)
+{
+	struct urcu_shm_reader reader;
+	int v;
+
+	if (urcu_shm_register_reader(domain, &reader))
+		_exit(1);
+	while (!uatomic_read(&shared->stop)) {
+		urcu_shm_read_lock(&reader);
+		v = CMM_LOAD_SHARED(shared->values[
+			CMM_LOAD_SHARED(shared->cur)]);
+		if (v != 42)
+			uatomic_inc(&shared->nr_bad);
+		urcu_shm_read_unlock(&reader);
+		uatomic_inc(&shared->nr_reads);
+	}
+	urcu_shm_unregister_reader(&reader);
+	_exit(0);
+}
+
+static pid_t spawn(void (*fn)(void))
+{
+	pid_t pid;
+
+	pid = fork();
+	if (pid < 0)
+		abort();
+	if (!pid)
+		fn();
+	return pid;
+}
+
+static int reap(pid_t pid)
+{
+	int status;
+
+	if (waitpid(pid, &status, 0) != pid)
+		abort();
+	return WIFEXITED(status) && !WEXITSTATUS(status);
+}
+
+static void *thr_synchronize(void *arg)
+{
+	urcu_shm_synchronize(domain);
+	uatomic_set(&gp_done, 1);
+	return NULL;
+}
+
+static void test_wait_reader(void)
+{
+	pthread_t tid;
+	pid_t pid;
+	int waited;
+
+	pid = spawn(child_wait_release);
+	while (!uatomic_read(&shared->in_cs))
+		(void) poll(NULL, 0, 1);
+	if (pthread_create(&tid, NULL, thr_synchronize, NULL))
+		abort();
+	(void) poll(NULL, 0, 50);
+	waited = !uatomic_read(&gp_done);
+	uatomic_set(&shared->release, 1);
+	if (pthread_join(tid, NULL))
+		abort();
+	ok(reap(pid) && waited && gp_done,
+		"grace period waits for a reader of another process");
+}
+
+static void test_updates(void)
+{
+	pid_t pids[NR_CHILDREN];
+	unsigned long i, old;
+	int ret = 1;
+
+	shared->values[0] = 42;
+	for (i = 0; i < NR_CHILDREN; i++)
+		pids[i] = spawn(child_reader);
+	while (uatomic_read(&shared->nr_reads) < NR_CHILDREN)
+		(void) poll(NULL, 0, 1);
+	for (i = 0; i < NR_UPDATES; i++) {
+		old = shared->cur;
+		CMM_STORE_SHARED(shared->values[!old], 42);
+		/* Publish the new value before its index. */
+		cmm_smp_wmb();
+		CMM_STORE_SHARED(shared->cur, !old);
+		urcu_shm_synchronize(domain);
+		CMM_STORE_SHARED(shared->values[old], 0);
+	}
+	uatomic_set(&shared->stop, 1);
+	for (i = 0; i < NR_CHILDREN; i++)
+		ret &= reap(pids[i]);
+	ok(ret && !shared->nr_bad,
+		"readers of other processes never see reclaimed values (%lu reads)",
+		shared->nr_reads);
+}
+
+int main(int argc, char **argv)
+{
+	struct urcu_shm_reader readers[NR_SLOTS + 1];
+	size_t len = urcu_shm_domain_size(NR_SLOTS);
+	void *mem;
+	int i, ret = 0;
+
+	plan_tests(7);
+
+	mem = map_shared(len);
+	shared = map_shared(sizeof(*shared));
+	ok(!urcu_shm_domain_attach(mem, len)
+			&& !urcu_shm_domain_init(mem, len, 0)
+			&& !urcu_shm_domain_init(mem, len - 1, NR_SLOTS),
+		"reject uninitialized memory and invalid layouts");
+	domain = urcu_shm_domain_init(mem, len, NR_SLOTS);
+	ok(domain && urcu_shm_domain_attach(mem, len) == domain,
+		"attach to an initialized domain");
+
+	for (i = 0; i < NR_SLOTS; i++)
+		ret |= urcu_shm_register_reader(domain, &readers[i]);
+	ok(!ret && urcu_shm_register_reader(domain, &readers[i]) == -ENOSPC,
+		"registration fails once all slots are used");
+	for (i = 0; i < NR_SLOTS; i++)
+		urcu_shm_unregister_reader(&readers[i]);
+
+	test_wait_reader();
+
+	(void) reap(spawn(child_crash));
+	urcu_shm_synchronize(domain);
+	pass("grace period reclaims the slot of a dead reader");
+
+	(void) reap(spawn(child_take_all));
+	ret = 0;
+	for (i = 0; i < NR_SLOTS; i++)
+		ret |= urcu_shm_register_reader(domain, &readers[i]);
+	ok(!ret, "registration reclaims slots of dead processes");
+	for (i = 0; i < NR_SLOTS; i++)
+		urcu_shm_unregister_reader(&readers[i]);
+
+	test_updates();
+	return exit_status();
+}
@@ -0,0 +1,219 @@
+/*
+ * test_shm_hash.c
+ *
+ * Userspace RCU library - test position-independent shared-memory hash table
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#include <stdlib.h>
+#include <errno.h>
+#include <poll.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/wait.h>
+#include <urcu/uatomic.h>
+#include <urcu/shm-domain.h>
+#include <urcu/shm-hash.h>
+
+#include "tap.h"
+
+#define NR_BUCKETS	64
+#define NR_KEYS		256
+#define NR_NODES	(2 * NR_KEYS)
+#define NR_CHILDREN	2
+#define NR_UPDATES	5000
+#define NR_SLOTS	4
+#define POISON		0xdeadUL
+
+struct test_node {
+	struct urcu_shm_ht_node node;
+	unsigned long key;
+	unsigned long value;
+};
+
+/* Test state shared with the child processes. */
+struct shared {
+	int stop;
+	unsigned long nr_lookups, nr_bad;
+};
+
+static struct shared *shared;
+static struct urcu_shm_domain *domain;
+static size_t ht_len;
+static int memfd;
+
+static unsigned long test_hash(unsigned long key)
+{
+	return key * 2654435761UL;
+}
+
+static int test_match(struct urcu_shm_ht_node *node, const void *key)
+{
+	return caa_container_of(node, struct test_node, node)->key
+		== *(const unsigned long *) key;
+}
+
+static void *map_table(void)
+{
+	void *p;
+
+	p = mmap(NULL, ht_len, PROT_READ | PROT_WRITE, MAP_SHARED, memfd, 0);
+	if (p == MAP_FAILED)
+		abort();
+	return p;
+}
+
+static struct test_node *lookup(struct urcu_shm_ht *ht, unsigned long key)
+{
+	struct urcu_shm_ht_node *node;
+
+	node = urcu_shm_ht_lookup(ht, test_hash(key), test_match, &key);
+	return node ? caa_container_of(node, struct test_node, node) : NULL;
+}
+
+static struct test_node *add_key(struct urcu_shm_ht *ht, unsigned long key)
+{
+	struct urcu_shm_ht_node *node;
+	struct test_node *tnode;
+
+	node = urcu_shm_ht_alloc_node(ht);
+	if (!node)
+		abort();
+	tnode = caa_container_of(node, struct test_node, node);
+	tnode->key = key;
+	tnode->value = key + 1;
+	urcu_shm_ht_add(ht, test_hash(key), node);
+	return tnode;
+}
+
+/* Maps the table at its own address, and looks up all keys. */
+static void child_reader(void)
+{
+	struct urcu_shm_reader reader;
+	struct urcu_shm_ht *ht;
+	struct test_node *node;
+	unsigned long key = 0;
+
+	ht = urcu_shm_ht_attach(map_table(), ht_len);
+	if (!ht || urcu_shm_register_reader(domain, &reader))
+		_exit(1);
+	while (!uatomic_read(&shared->stop)) {
+		urcu_shm_read_lock(&reader);
+		node = lookup(ht, key);
+		if (!node || CMM_LOAD_SHARED(node->value) != key + 1)
+			uatomic_inc(&shared->nr_bad);
+		urcu_shm_read_unlock(&reader);
+		uatomic_inc(&shared->nr_lookups);
+		key = (key + 1) % NR_KEYS;
+	}
+	urcu_shm_unregister_reader(&reader);
+	_exit(0);
+}
+
+static void test_replace(struct urcu_shm_ht *ht)
+{
+	struct test_node *nodes[NR_KEYS], *old;
+	pid_t pids[NR_CHILDREN];
+	unsigned long i, key;
+	int status, ret = 1;
+
+	for (key = 0; key < NR_KEYS; key++)
+		nodes[key] = add_key(ht, key);
+	for (i = 0; i < NR_CHILDREN; i++) {
+		pids[i] = fork();
+		if (pids[i] < 0)
+			abort();
+		if (!pids[i])
+			child_reader();
+	}
+	while (uatomic_read(&shared->nr_lookups) < NR_CHILDREN)
+		(void) poll(NULL, 0, 1);
+	for (i = 0; i < NR_UPDATES; i++) {
+		key = i % NR_KEYS;
+		old = nodes[key];
+		nodes[key] = add_key(ht, key);
+		if (urcu_shm_ht_del(ht, &old->node))
+			abort();
+		urcu_shm_synchronize(domain);
+		old->value = POISON;
+		urcu_shm_ht_free_node(ht, &old->node);
+	}
+	uatomic_set(&shared->stop, 1);
+	for (i = 0; i < NR_CHILDREN; i++) {
+		if (waitpid(pids[i], &status, 0) != pids[i])
+			abort();
+		ret &= WIFEXITED(status) && !WEXITSTATUS(status);
+	}
+	ok(ret && !shared->nr_bad && ht->count == NR_KEYS,
+		"lookups from other processes concurrent with replacements"
+		" (%lu lookups)", shared->nr_lookups);
+}
+
+int main(int argc, char **argv)
+{
+	struct urcu_shm_ht *ht, *ht2;
+	struct test_node *node, *node2;
+	size_t domain_len = urcu_shm_domain_size(NR_SLOTS);
+	unsigned long i;
+	void *mem;
+
+	plan_tests(6);
+
+	shared = mmap(NULL, sizeof(*shared), PROT_READ | PROT_WRITE,
+		MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+	mem = mmap(NULL, domain_len, PROT_READ | PROT_WRITE,
+		MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+	if (shared == MAP_FAILED || mem == MAP_FAILED)
+		abort();
+	domain = urcu_shm_domain_init(mem, domain_len, NR_SLOTS);
+	ht_len = urcu_shm_ht_size(NR_BUCKETS, NR_NODES,
+		sizeof(struct test_node));
+	memfd = memfd_create("test_shm_hash", 0);
+	if (!domain || memfd < 0 || ftruncate(memfd, ht_len))
+		abort();
+
+	mem = map_table();
+	ok(!urcu_shm_ht_init(mem, ht_len, NR_BUCKETS - 1,
+				sizeof(struct test_node))
+			&& !urcu_shm_ht_init(mem, ht_len, NR_BUCKETS, 1)
+			&& !urcu_shm_ht_attach(mem, ht_len),
+		"reject invalid layouts and uninitialized memory");
+	ht = urcu_shm_ht_init(mem, ht_len, NR_BUCKETS, sizeof(struct test_node));
+	ht2 = urcu_shm_ht_attach(map_table(), ht_len);
+	if (!ht || !ht2 || ht == ht2)
+		abort();
+
+	node = add_key(ht, 42);
+	node2 = lookup(ht2, 42);
+	ok(node2 && (char *) node2 - (char *) ht2 == (char *) node - (char *) ht
+			&& node2->value == 43 && !lookup(ht2, 43),
+		"lookup through another mapping of the table");
+	ok(!urcu_shm_ht_del(ht2, &node2->node) && !lookup(ht, 42)
+			&& urcu_shm_ht_del(ht, &node->node) == -ENOENT,
+		"delete through another mapping of the table");
+	urcu_shm_ht_free_node(ht, &node->node);
+
+	for (i = 0; urcu_shm_ht_alloc_node(ht); i++)
+		;
+	ok(i == NR_NODES, "arena holds the requested number of nodes");
+	/* Start over with an empty arena. */
+	ht = urcu_shm_ht_init(mem, ht_len, NR_BUCKETS, sizeof(struct test_node));
+	ok(ht && !ht->count && !lookup(ht2, 42),
+		"reinitialization empties the table");
+
+	test_replace(ht);
+	return exit_status();
+}
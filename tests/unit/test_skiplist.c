@@ -0,0 +1,190 @@
+/*
+ * test_skiplist.c
+ *
+ * Userspace RCU library - test RCU ordered map
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#include <stdlib.h>
+#include <pthread.h>
+#include <urcu.h>
+#include <urcu/rcuskiplist.h>
+
+#include "tap.h"
+
+#define NR_KEYS		10000		/* Even keys below 2 * NR_KEYS. */
+#define NR_ROUNDS	20
+
+struct test_node {
+	unsigned long key;
+	struct cds_skiplist_node node;
+	struct rcu_head head;
+};
+
+static struct cds_skiplist *sl;
+static int stop;
+
+static int test_cmp(struct cds_skiplist_node *node, const void *key)
+{
+	unsigned long a = caa_container_of(node, struct test_node, node)->key;
+	unsigned long b = *(const unsigned long *) key;
+
+	return a < b ? -1 : a > b;
+}
+
+static struct test_node *test_add(unsigned long key)
+{
+	struct test_node *tn = malloc(sizeof(*tn));
+	struct cds_skiplist_node *ret;
+
+	if (!tn)
+		abort();
+	tn->key = key;
+	rcu_read_lock();
+	ret = cds_skiplist_add_unique(sl, &tn->key, &tn->node);
+	rcu_read_unlock();
+	if (ret != &tn->node) {
+		free(tn);
+		return caa_container_of(ret, struct test_node, node);
+	}
+	return tn;
+}
+
+static void free_node(struct rcu_head *head)
+{
+	free(caa_container_of(head, struct test_node, head));
+}
+
+static int test_del(unsigned long key)
+{
+	struct cds_skiplist_node *node;
+
+	rcu_read_lock();
+	node = cds_skiplist_del(sl, &key);
+	rcu_read_unlock();
+	if (!node)
+		return 0;
+	call_rcu(&caa_container_of(node, struct test_node, node)->head,
+		free_node);
+	return 1;
+}
+
+/* Add and remove odd keys, while the main thread iterates. */
+static void *writer_fn(void *arg)
+{
+	unsigned long key;
+	int i;
+
+	rcu_register_thread();
+	for (i = 0; i < NR_ROUNDS && !CMM_LOAD_SHARED(stop); i++) {
+		for (key = 1; key < 2 * NR_KEYS; key += 2)
+			(void) test_add(key);
+		for (key = 1; key < 2 * NR_KEYS; key += 2)
+			(void) test_del(key);
+	}
+	rcu_unregister_thread();
+	return NULL;
+}
+
+int main(int argc, char **argv)
+{
+	struct cds_skiplist_node *node;
+	struct test_node *tn;
+	pthread_t writer;
+	unsigned long i, key, prev, count, seen;
+	int bad, ret;
+
+	plan_tests(9);
+
+	rcu_register_thread();
+	sl = cds_skiplist_new(test_cmp);
+	if (!sl)
+		abort();
+
+	/* Add even keys in a scrambled order. */
+	bad = 0;
+	for (i = 0; i < NR_KEYS; i++) {
+		key = 2 * ((i * 7919) % NR_KEYS);
+		if (test_add(key)->key != key)
+			bad = 1;
+	}
+	ok(!bad, "add keys in any order");
+	tn = test_add(42);
+	ok(tn->key == 42 && tn != test_add(43), "add existing key returns it");
+	ok(test_del(43) && !test_del(43), "del once");
+
+	rcu_read_lock();
+	count = 0;
+	for (key = 0; key < 2 * NR_KEYS; key += 2) {
+		node = cds_skiplist_lookup(sl, &key);
+		if (node && caa_container_of(node, struct test_node, node)->key
+				== key)
+			count++;
+	}
+	ok(count == NR_KEYS, "lookup all keys");
+	key = 41;
+	ok(!cds_skiplist_lookup(sl, &key), "lookup missing key");
+	node = cds_skiplist_lower_bound(sl, &key);
+	ok(node && caa_container_of(node, struct test_node, node)->key == 42,
+		"lower_bound of missing key");
+	key = 2 * NR_KEYS;
+	ok(!cds_skiplist_lower_bound(sl, &key), "lower_bound past last key");
+
+	key = 100;
+	count = 0;
+	prev = 98;
+	bad = 0;
+	cds_skiplist_for_each_entry_from(sl, &key, node, tn, node) {
+		if (tn->key != prev + 2)
+			bad = 1;
+		prev = tn->key;
+		count++;
+	}
+	rcu_read_unlock();
+	ok(!bad && count == NR_KEYS - 50, "range iteration in key order");
+
+	/* Iterate in increasing order while odd keys come and go. */
+	if (pthread_create(&writer, NULL, writer_fn, NULL))
+		abort();
+	bad = 0;
+	for (i = 0; i < NR_ROUNDS; i++) {
+		count = seen = 0;
+		rcu_read_lock();
+		cds_skiplist_for_each_entry(sl, node, tn, node) {
+			if (seen++ && tn->key <= prev)
+				bad = 1;
+			if (!(tn->key & 1))
+				count++;
+			prev = tn->key;
+		}
+		rcu_read_unlock();
+		if (count != NR_KEYS)
+			bad = 1;
+	}
+	CMM_STORE_SHARED(stop, 1);
+	if (pthread_join(writer, NULL))
+		abort();
+	ok(!bad, "iteration during updates sees all stable keys in order");
+
+	for (key = 0; key < 2 * NR_KEYS; key++)
+		(void) test_del(key);
+	ret = cds_skiplist_destroy(sl);
+	if (ret)
+		abort();
+	rcu_barrier();
+	rcu_unregister_thread();
+	return exit_status();
+}
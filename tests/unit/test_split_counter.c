@@ -0,0 +1,109 @@
+/*
+ * test_split_counter.c
+ *
+ * Userspace RCU library - test per-CPU split counter
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#include <stdlib.h>
+#include <pthread.h>
+#include <urcu/arch.h>
+#include <urcu/split-counter.h>
+
+#include "tap.h"
+
+#define COMMIT_ORDER	6
+#define NR_THREADS	4
+#define NR_ADDS		100000
+
+static struct cds_split_counter *counter;
+
+/* Whether the approximate value is within the bound of the exact one. */
+static int approx_ok(long exact)
+{
+	long approx = cds_split_counter_read(counter);
+
+	return approx <= exact && (unsigned long) (exact - approx)
+		< cds_split_counter_max_error(counter);
+}
+
+static void *thr_adder(void *arg)
+{
+	long i;
+
+	for (i = 0; i < NR_ADDS; i++) {
+		cds_split_counter_inc(counter);
+		if (i & 1)
+			cds_split_counter_add(counter, 3);
+		else
+			cds_split_counter_dec(counter);
+	}
+	return NULL;
+}
+
+int main(int argc, char **argv)
+{
+	pthread_t tid[NR_THREADS];
+	long i, expected;
+
+	plan_tests(8);
+
+	ok(!cds_split_counter_new(CAA_BITS_PER_LONG, 0),
+		"reject a commit order of the width of a long");
+	counter = cds_split_counter_new(COMMIT_ORDER, 3);
+	if (!counter)
+		abort();
+	ok(cds_split_counter_max_error(counter) == 4UL << COMMIT_ORDER,
+		"per-CPU counters rounded up to a power of two");
+
+	for (i = 0; i < (1L << COMMIT_ORDER) - 1; i++)
+		cds_split_counter_inc(counter);
+	ok(cds_split_counter_read_exact(counter) == i
+			&& cds_split_counter_read(counter) == 0,
+		"additions below the commit order stay per-CPU");
+	cds_split_counter_add(counter, 10L << COMMIT_ORDER);
+	expected = i + (10L << COMMIT_ORDER);
+	ok(cds_split_counter_read_exact(counter) == expected
+			&& approx_ok(expected)
+			&& cds_split_counter_read(counter) > 0,
+		"large additions commit");
+	cds_split_counter_add(counter, -expected - 1000);
+	ok(cds_split_counter_read_exact(counter) == -1000 && approx_ok(-1000),
+		"counter goes negative");
+	cds_split_counter_add(counter, 1000);
+	ok(cds_split_counter_read_exact(counter) == 0 && approx_ok(0),
+		"counter back to zero");
+	cds_split_counter_destroy(counter);
+
+	counter = cds_split_counter_new(COMMIT_ORDER, 0);
+	if (!counter)
+		abort();
+	for (i = 0; i < NR_THREADS; i++) {
+		if (pthread_create(&tid[i], NULL, thr_adder, NULL))
+			abort();
+	}
+	for (i = 0; i < NR_THREADS; i++) {
+		if (pthread_join(tid[i], NULL))
+			abort();
+	}
+	expected = (long) NR_THREADS * (NR_ADDS + NR_ADDS / 2 * 2);
+	ok(cds_split_counter_read_exact(counter) == expected,
+		"concurrent additions counted exactly");
+	ok(approx_ok(expected), "approximate value within the error bound");
+	cds_split_counter_destroy(counter);
+
+	return exit_status();
+}
@@ -0,0 +1,120 @@
+/*
+ * test_spsc_ring.c
+ *
+ * Userspace RCU library - test bounded SPSC ring
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#include <errno.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <pthread.h>
+#include <sched.h>
+#include <urcu/uatomic.h>
+
+#define _LGPL_SOURCE
+#include <urcu/spscring.h>
+
+#include "tap.h"
+
+#define CAPACITY	16
+#define BATCH		5
+#define NR_ELEMS	1000000
+
+static struct cds_spsc_ring ring;
+static void *slots[CAPACITY];
+static unsigned long nr_bad;
+
+/* Alternate single and batched enqueues of 1..NR_ELEMS. */
+static void *producer_fn(void *arg)
+{
+	uintptr_t i = 0, k;
+	void *batch[BATCH];
+	unsigned long n;
+
+	while (i < NR_ELEMS) {
+		if (i & 1) {
+			if (cds_spsc_ring_try_enqueue(&ring, (void *) (i + 1)))
+				i++;
+			else
+				sched_yield();
+			continue;
+		}
+		for (k = 0; k < BATCH && i + k < NR_ELEMS; k++)
+			batch[k] = (void *) (i + k + 1);
+		n = cds_spsc_ring_enqueue_bulk(&ring, batch, k);
+		if (!n)
+			sched_yield();	/* Let the consumer run on small systems. */
+		i += n;
+	}
+	return NULL;
+}
+
+int main(int argc, char **argv)
+{
+	void *small[4], *batch[BATCH], *p;
+	uintptr_t expect = 1;
+	pthread_t producer;
+	unsigned long i, n;
+	int ok_order;
+
+	plan_tests(7);
+
+	ok(cds_spsc_ring_init(&ring, small, 3) == -EINVAL
+		&& cds_spsc_ring_init(&ring, small, 1) == -EINVAL,
+		"reject capacities which are not a power of two");
+	ok(!cds_spsc_ring_init(&ring, small, 4)
+		&& !cds_spsc_ring_try_dequeue(&ring, &p),
+		"new ring is empty");
+
+	for (i = 0; i < BATCH; i++)
+		batch[i] = (void *) (i + 1);
+	ok(cds_spsc_ring_enqueue_bulk(&ring, batch, 3) == 3
+		&& cds_spsc_ring_enqueue_bulk(&ring, batch + 3, 2) == 1
+		&& !cds_spsc_ring_try_enqueue(&ring, batch[4]),
+		"enqueue stops when the ring is full");
+
+	ok_order = cds_spsc_ring_try_dequeue(&ring, &p) && p == batch[0];
+	ok_order &= cds_spsc_ring_dequeue_bulk(&ring, batch, BATCH) == 3
+		&& batch[0] == (void *) 2 && batch[2] == (void *) 4;
+	ok(ok_order, "dequeue in FIFO order");
+	ok(!cds_spsc_ring_try_dequeue(&ring, &p),
+		"dequeue stops when the ring is empty");
+
+	/* Positions wrap around the ring many times. */
+	cds_spsc_ring_init(&ring, slots, CAPACITY);
+	if (pthread_create(&producer, NULL, producer_fn, NULL))
+		abort();
+	while (expect <= NR_ELEMS) {
+		if (expect & 1)
+			n = cds_spsc_ring_dequeue_bulk(&ring, batch, BATCH);
+		else
+			n = cds_spsc_ring_try_dequeue(&ring, &batch[0]);
+		if (!n)
+			sched_yield();
+		for (i = 0; i < n; i++) {
+			if ((uintptr_t) batch[i] != expect++)
+				nr_bad++;
+		}
+	}
+	if (pthread_join(producer, NULL))
+		abort();
+	ok(!nr_bad, "consumer gets every element in order");
+	ok(!cds_spsc_ring_try_dequeue(&ring, &p)
+		&& ring.enqueue_pos == NR_ELEMS && ring.dequeue_pos == NR_ELEMS,
+		"ring empty after the last element");
+	return exit_status();
+}
@@ -0,0 +1,119 @@
+/*
+ * test_srcu_domains.c
+ *
+ * Userspace RCU library - test grace periods and callbacks of RCU domains
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#include <stdlib.h>
+#include <poll.h>
+#include <pthread.h>
+#include <urcu.h>
+
+#include "tap.h"
+
+static struct srcu_domain *domain_a, *domain_b;
+static int reader_in_cs, reader_release, sync_a_done;
+static int cb_invoked;
+static struct rcu_head cb_head;
+
+static void wait_set(int *flag)
+{
+	while (!uatomic_read(flag))
+		(void) poll(NULL, 0, 1);
+}
+
+/* Stay in a read-side critical section of domain A until released. */
+static void *thr_reader_a(void *arg)
+{
+	rcu_register_thread();
+	srcu_register_thread(domain_a);
+	srcu_read_lock(domain_a);
+	uatomic_set(&reader_in_cs, 1);
+	wait_set(&reader_release);
+	srcu_read_unlock(domain_a);
+	srcu_unregister_thread(domain_a);
+	rcu_unregister_thread();
+	return NULL;
+}
+
+static void *thr_sync_a(void *arg)
+{
+	synchronize_srcu(domain_a);
+	uatomic_set(&sync_a_done, 1);
+	return NULL;
+}
+
+static void cb(struct rcu_head *head)
+{
+	uatomic_set(&cb_invoked, 1);
+}
+
+int main(int argc, char **argv)
+{
+	pthread_t reader, sync_a;
+	struct urcu_stats stats;
+
+	plan_tests(6);
+
+	domain_a = srcu_domain_create();
+	domain_b = srcu_domain_create();
+	if (!domain_a || !domain_b)
+		abort();
+
+	if (pthread_create(&reader, NULL, thr_reader_a, NULL))
+		abort();
+	wait_set(&reader_in_cs);
+	if (pthread_create(&sync_a, NULL, thr_sync_a, NULL))
+		abort();
+
+	synchronize_srcu(domain_b);
+	ok(1, "reader of domain A does not block synchronize_srcu(B)");
+	(void) poll(NULL, 0, 100);
+	ok(!uatomic_read(&sync_a_done),
+		"reader of domain A blocks synchronize_srcu(A)");
+
+	uatomic_set(&reader_release, 1);
+	if (pthread_join(sync_a, NULL) || pthread_join(reader, NULL))
+		abort();
+	ok(uatomic_read(&sync_a_done),
+		"synchronize_srcu(A) completes once the reader leaves");
+
+	/* call_srcu() from within a read-side critical section. */
+	rcu_register_thread();
+	srcu_register_thread(domain_a);
+	srcu_read_lock(domain_a);
+	call_srcu(domain_a, &cb_head, cb);
+	(void) poll(NULL, 0, 100);
+	ok(!uatomic_read(&cb_invoked),
+		"call_srcu() within a critical section returns, callback waits");
+	srcu_read_unlock(domain_a);
+	srcu_barrier(domain_a);
+	ok(uatomic_read(&cb_invoked),
+		"callback invoked after the critical section");
+	/* The worker accounts for a batch once it is invoked. */
+	srcu_barrier(domain_a);
+	srcu_get_stats(domain_a, &stats);
+	ok(stats.call_rcu.invoked >= 2 && stats.call_rcu.batches >= 1,
+		"domain worker statistics (%lu invoked)",
+		stats.call_rcu.invoked);
+	srcu_unregister_thread(domain_a);
+	rcu_unregister_thread();
+
+	srcu_domain_destroy(domain_a);
+	srcu_domain_destroy(domain_b);
+	return exit_status();
+}
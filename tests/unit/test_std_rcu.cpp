@@ -0,0 +1,179 @@
+/*
+ * test_std_rcu.cpp
+ *
+ * Userspace RCU library - test C++ interface of the standard RCU
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#define _LGPL_SOURCE
+#include <atomic>
+#include <mutex>
+#include <stdlib.h>
+#include <poll.h>
+#include <pthread.h>
+#include <urcu.h>
+#include <urcu/std-rcu.hpp>
+
+extern "C" {
+#include "tap.h"
+}
+
+#define NR_OBJS		1000
+#define NR_READERS	2
+#define NR_UPDATES	2000
+
+static int nr_destroyed, nr_deleted;
+
+struct obj : urcu::rcu_obj_base<obj> {
+	~obj()
+	{
+		nr_destroyed++;
+	}
+};
+
+struct plain {
+	~plain()
+	{
+		nr_destroyed++;
+	}
+};
+
+/* Deleter with state, stored in the retired object. */
+struct counting_deleter {
+	int *count;
+
+	template<class T>
+	void operator()(T *p)
+	{
+		(*count)++;
+		delete p;
+	}
+};
+
+struct counted : urcu::rcu_obj_base<counted, counting_deleter> {
+};
+
+/*
+ * Objects replaced by the update test are poisoned rather than freed,
+ * so that readers which see them after their grace period notice it.
+ */
+struct value : urcu::rcu_obj_base<value, void (*)(value *)> {
+	int v;
+};
+
+static value values[NR_UPDATES + 1];
+static std::atomic<value *> shared;
+static int stop_readers;
+static unsigned long nr_bad, nr_reads;
+
+static void poison(value *p)
+{
+	p->v = 0;
+}
+
+static void *thr_reader(void *arg)
+{
+	rcu_register_thread();
+	while (!uatomic_read(&stop_readers)) {
+		std::lock_guard<urcu::rcu_domain> guard(urcu::rcu_default_domain());
+
+		if (shared.load(std::memory_order_consume)->v != 42)
+			uatomic_inc(&nr_bad);
+		uatomic_inc(&nr_reads);
+	}
+	rcu_unregister_thread();
+	return NULL;
+}
+
+static void test_updates(void)
+{
+	pthread_t tid[NR_READERS];
+	value *old;
+	int i;
+
+	values[0].v = 42;
+	shared.store(&values[0]);
+	for (i = 0; i < NR_READERS; i++) {
+		if (pthread_create(&tid[i], NULL, thr_reader, NULL))
+			abort();
+	}
+	while (uatomic_read(&nr_reads) < NR_READERS)
+		(void) poll(NULL, 0, 1);
+	for (i = 1; i <= NR_UPDATES; i++) {
+		values[i].v = 42;
+		old = shared.exchange(&values[i]);
+		old->retire(poison);
+	}
+	urcu::rcu_barrier();
+	uatomic_set(&stop_readers, 1);
+	for (i = 0; i < NR_READERS; i++) {
+		if (pthread_join(tid[i], NULL))
+			abort();
+	}
+	ok(!nr_bad && !values[NR_UPDATES / 2].v && values[NR_UPDATES].v == 42,
+		"readers never see objects once retired (%lu reads)", nr_reads);
+}
+
+int main(int argc, char **argv)
+{
+	unsigned long cookie;
+	int i;
+
+	plan_tests(7);
+
+	rcu_register_thread();
+
+	ok(sizeof(urcu::rcu_obj_base<obj>) == sizeof(struct rcu_head_compact)
+			&& sizeof(counted) == 2 * sizeof(void *),
+		"retired objects hold a single pointer, and a stateful deleter");
+
+	for (i = 0; i < NR_OBJS; i++)
+		(new obj)->retire();
+	urcu::rcu_barrier();
+	ok(nr_destroyed == NR_OBJS, "rcu_obj_base::retire() with default deleter");
+
+	for (i = 0; i < NR_OBJS; i++)
+		(new counted)->retire(counting_deleter{ &nr_deleted });
+	urcu::rcu_barrier();
+	ok(nr_deleted == NR_OBJS, "rcu_obj_base::retire() with stateful deleter");
+
+	nr_destroyed = 0;
+	nr_deleted = 0;
+	for (i = 0; i < NR_OBJS; i++) {
+		urcu::rcu_retire(new plain);
+		urcu::rcu_retire(new plain, counting_deleter{ &nr_deleted },
+			urcu::rcu_default_domain());
+	}
+	urcu::rcu_barrier();
+	ok(nr_destroyed == 2 * NR_OBJS && nr_deleted == NR_OBJS,
+		"rcu_retire() of objects not deriving from rcu_obj_base");
+
+	{
+		std::lock_guard<urcu::rcu_domain> guard(urcu::rcu_default_domain());
+
+		ok(rcu_read_ongoing(), "domain lock enters a critical section");
+	}
+
+	cookie = get_state_synchronize_rcu();
+	urcu::rcu_synchronize();
+	ok(poll_state_synchronize_rcu(cookie) && !rcu_read_ongoing(),
+		"rcu_synchronize() waits for a grace period");
+
+	test_updates();
+
+	rcu_unregister_thread();
+	return exit_status();
+}
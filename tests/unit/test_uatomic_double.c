@@ -0,0 +1,104 @@
+/*
+ * test_uatomic_double.c
+ *
+ * Userspace RCU library - test double-word cmpxchg
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+#include <stdlib.h>
+#include <pthread.h>
+#include <urcu/uatomic.h>
+
+#include "tap.h"
+
+#define NR_THREADS	4
+#define NR_PER_THREAD	100000
+
+static struct uatomic_double arch_val, compat_val;
+static int nr_torn;
+
+/* Both words move together: hi always holds the complement of lo. */
+static void *thread_fn(void *arg)
+{
+	struct uatomic_double old, _new;
+	int i;
+
+	for (i = 0; i < NR_PER_THREAD; i++) {
+		old.lo = CMM_LOAD_SHARED(arch_val.lo);
+		old.hi = ~old.lo;
+		do {
+			if (old.hi != ~old.lo)
+				uatomic_inc(&nr_torn);
+			_new.lo = old.lo + 1;
+			_new.hi = ~_new.lo;
+		} while (!uatomic_cmpxchg_double(&arch_val, &old, &_new));
+
+		old.lo = CMM_LOAD_SHARED(compat_val.lo);
+		old.hi = ~old.lo;
+		do {
+			if (old.hi != ~old.lo)
+				uatomic_inc(&nr_torn);
+			_new.lo = old.lo + 1;
+			_new.hi = ~_new.lo;
+		} while (!_compat_uatomic_cmpxchg_double(&compat_val.lo,
+				&old.lo, _new.lo, _new.hi));
+	}
+	return NULL;
+}
+
+int main(int argc, char **argv)
+{
+	struct uatomic_double old = { 1, 2 }, _new = { 3, 4 };
+	pthread_t threads[NR_THREADS];
+	int i;
+
+	plan_tests(5);
+
+	arch_val.lo = 1;
+	arch_val.hi = 2;
+	ok(uatomic_cmpxchg_double(&arch_val, &old, &_new)
+		&& arch_val.lo == 3 && arch_val.hi == 4,
+		"cmpxchg_double replaces matching words");
+	old.lo = 3;
+	old.hi = 5;
+	ok(!uatomic_cmpxchg_double(&arch_val, &old, &_new)
+		&& old.lo == 3 && old.hi == 4
+		&& arch_val.lo == 3 && arch_val.hi == 4,
+		"cmpxchg_double returns current words on a mismatch");
+
+	old.lo = 1;
+	old.hi = 1;
+	ok(!_compat_uatomic_cmpxchg_double(&compat_val.lo, &old.lo, 1, 2)
+		&& _compat_uatomic_cmpxchg_double(&compat_val.lo, &old.lo, 1, 2)
+		&& compat_val.lo == 1 && compat_val.hi == 2,
+		"lock-based cmpxchg_double");
+
+	arch_val.lo = compat_val.lo = 0;
+	arch_val.hi = compat_val.hi = ~0UL;
+	for (i = 0; i < NR_THREADS; i++)
+		if (pthread_create(&threads[i], NULL, thread_fn, NULL))
+			abort();
+	for (i = 0; i < NR_THREADS; i++)
+		if (pthread_join(threads[i], NULL))
+			abort();
+	ok(arch_val.lo == NR_THREADS * NR_PER_THREAD
+		&& compat_val.lo == NR_THREADS * NR_PER_THREAD
+		&& arch_val.hi == ~arch_val.lo
+		&& compat_val.hi == ~compat_val.lo,
+		"concurrent cmpxchg_double loses no update");
+	ok(!nr_torn, "cmpxchg_double returns untorn words");
+	return exit_status();
+}
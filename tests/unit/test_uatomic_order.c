@@ -0,0 +1,125 @@
+/*
+ * test_uatomic_order.c
+ *
+ * Userspace RCU library - test uatomic memory-order variants
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#include <stdlib.h>
+#include <sched.h>
+#include <pthread.h>
+#include <urcu/uatomic.h>
+
+#include "tap.h"
+
+#define NR_MESSAGES	100000
+
+static unsigned int ival;
+static unsigned long lval;
+
+static unsigned long payload, seq;
+static int nr_bad;
+
+#define do_test(ptr)						\
+do {								\
+	__typeof__(*(ptr)) v;					\
+	int pass = 1;						\
+								\
+	uatomic_store_release(ptr, 10);			\
+	pass &= uatomic_load_acquire(ptr) == 10;		\
+	v = uatomic_cmpxchg_relaxed(ptr, 10, 11);		\
+	pass &= v == 10;					\
+	v = uatomic_cmpxchg_acquire(ptr, 10, 12);		\
+	pass &= v == 11 && uatomic_read(ptr) == 11;		\
+	v = uatomic_cmpxchg_release(ptr, 11, 12);		\
+	pass &= v == 11 && uatomic_read(ptr) == 12;		\
+	ok(pass, "cmpxchg variants on " #ptr);			\
+								\
+	pass = 1;						\
+	v = uatomic_xchg_relaxed(ptr, 20);			\
+	pass &= v == 12;					\
+	v = uatomic_xchg_acquire(ptr, 21);			\
+	pass &= v == 20;					\
+	v = uatomic_xchg_release(ptr, 22);			\
+	pass &= v == 21 && uatomic_read(ptr) == 22;		\
+	ok(pass, "xchg variants on " #ptr);			\
+								\
+	pass = 1;						\
+	pass &= uatomic_add_return_relaxed(ptr, 1) == 23;	\
+	pass &= uatomic_add_return_acquire(ptr, 1) == 24;	\
+	pass &= uatomic_add_return_release(ptr, 1) == 25;	\
+	pass &= uatomic_sub_return_relaxed(ptr, 1) == 24;	\
+	pass &= uatomic_sub_return_acquire(ptr, 1) == 23;	\
+	pass &= uatomic_sub_return_release(ptr, 1) == 22;	\
+	ok(pass, "add_return and sub_return variants on " #ptr);	\
+								\
+	uatomic_add_acquire(ptr, 10);				\
+	uatomic_add_release(ptr, 10);				\
+	uatomic_sub_acquire(ptr, 1);				\
+	uatomic_sub_release(ptr, 1);				\
+	uatomic_inc_acquire(ptr);				\
+	uatomic_inc_release(ptr);				\
+	uatomic_dec_acquire(ptr);				\
+	ok(uatomic_read(ptr) == 41, "add, sub, inc and dec variants on " #ptr); \
+								\
+	uatomic_and_acquire(ptr, 0x0f);				\
+	uatomic_or_release(ptr, 0x30);				\
+	uatomic_or_acquire(ptr, 0x40);				\
+	uatomic_and_release(ptr, 0x79);				\
+	ok(uatomic_read(ptr) == 0x79, "and and or variants on " #ptr); \
+} while (0)
+
+/* Each payload published with a release is seen after its acquire. */
+static void *consumer_fn(void *arg)
+{
+	unsigned long i, s;
+
+	for (i = 1; i <= NR_MESSAGES; i++) {
+		while ((s = uatomic_load_acquire(&seq)) != 2 * i - 1)
+			(void) sched_yield();
+		if (CMM_LOAD_SHARED(payload) != i)
+			nr_bad++;
+		uatomic_inc_release(&seq);
+	}
+	return NULL;
+}
+
+int main(int argc, char **argv)
+{
+	pthread_t consumer;
+	unsigned long i;
+	int nr_late = 0;
+
+	plan_tests(11);
+
+	do_test(&ival);
+	do_test(&lval);
+
+	if (pthread_create(&consumer, NULL, consumer_fn, NULL))
+		abort();
+	for (i = 1; i <= NR_MESSAGES; i++) {
+		CMM_STORE_SHARED(payload, i);
+		uatomic_store_release(&seq, 2 * i - 1);
+		while (uatomic_load_acquire(&seq) != 2 * i)
+			(void) sched_yield();
+		if (CMM_LOAD_SHARED(payload) != i)
+			nr_late++;
+	}
+	if (pthread_join(consumer, NULL))
+		abort();
+	ok(!nr_bad && !nr_late, "release and acquire order message passing");
+	return exit_status();
+}
@@ -0,0 +1,178 @@
+/*
+ * test_urcu_bp_register.c
+ *
+ * Userspace RCU library - test urcu-bp lazy registration
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include <sched.h>
+#include <poll.h>
+#include <pthread.h>
+#include <signal.h>
+#include <urcu-bp.h>
+
+#include "tap.h"
+
+#define NR_ROUNDS	50
+#define NR_THREADS	40
+
+struct test_data {
+	int valid;
+};
+
+static struct test_data *gp_data;
+static int stop, nr_bad, reader_locked, reader_release, gp_done;
+static int handler_ran;
+
+/* Register on first use, check the data, and exit. */
+static void *reader_fn(void *arg)
+{
+	struct test_data *data;
+
+	rcu_read_lock();
+	data = rcu_dereference(gp_data);
+	if (!data || !CMM_LOAD_SHARED(data->valid))
+		uatomic_inc(&nr_bad);
+	rcu_read_unlock();
+	return NULL;
+}
+
+static void *updater_fn(void *arg)
+{
+	struct test_data *data, *old;
+
+	while (!CMM_LOAD_SHARED(stop)) {
+		data = malloc(sizeof(*data));
+		if (!data)
+			abort();
+		data->valid = 1;
+		old = rcu_xchg_pointer(&gp_data, data);
+		synchronize_rcu();
+		CMM_STORE_SHARED(old->valid, 0);
+		free(old);
+		(void) sched_yield();
+	}
+	return NULL;
+}
+
+static void *holder_fn(void *arg)
+{
+	rcu_read_lock();
+	uatomic_set(&reader_locked, 1);
+	while (!uatomic_read(&reader_release))
+		(void) sched_yield();
+	rcu_read_unlock();
+	return NULL;
+}
+
+/* Nest a read-side critical section within the one interrupted. */
+static void nested_reader_handler(int signo)
+{
+	rcu_read_lock();
+	rcu_read_unlock();
+	uatomic_set(&handler_ran, 1);
+}
+
+static void *signal_holder_fn(void *arg)
+{
+	rcu_read_lock();
+	if (pthread_kill(pthread_self(), SIGUSR1))
+		abort();
+	uatomic_set(&reader_locked, 1);
+	while (!uatomic_read(&reader_release))
+		(void) sched_yield();
+	rcu_read_unlock();
+	return NULL;
+}
+
+static void *sync_fn(void *arg)
+{
+	synchronize_rcu();
+	uatomic_set(&gp_done, 1);
+	return NULL;
+}
+
+int main(int argc, char **argv)
+{
+	pthread_t updater, holder, sync, threads[NR_THREADS];
+	struct sigaction act;
+	int i, j, gp_early;
+
+	plan_tests(5);
+
+	gp_data = malloc(sizeof(*gp_data));
+	if (!gp_data)
+		abort();
+	gp_data->valid = 1;
+
+	if (pthread_create(&updater, NULL, updater_fn, NULL))
+		abort();
+	for (i = 0; i < NR_ROUNDS; i++) {
+		for (j = 0; j < NR_THREADS; j++)
+			if (pthread_create(&threads[j], NULL, reader_fn, NULL))
+				abort();
+		for (j = 0; j < NR_THREADS; j++)
+			if (pthread_join(threads[j], NULL))
+				abort();
+	}
+	CMM_STORE_SHARED(stop, 1);
+	if (pthread_join(updater, NULL))
+		abort();
+	ok(!nr_bad, "short-lived readers never see reclaimed data");
+
+	/* A reader registered during the grace period of another thread. */
+	if (pthread_create(&holder, NULL, holder_fn, NULL))
+		abort();
+	while (!uatomic_read(&reader_locked))
+		(void) sched_yield();
+	if (pthread_create(&sync, NULL, sync_fn, NULL))
+		abort();
+	(void) poll(NULL, 0, 100);
+	gp_early = uatomic_read(&gp_done);
+	uatomic_set(&reader_release, 1);
+	if (pthread_join(holder, NULL) || pthread_join(sync, NULL))
+		abort();
+	ok(!gp_early, "grace period waits for a lazily registered reader");
+	ok(uatomic_read(&gp_done), "grace period ends after the reader");
+
+	/* A reader nesting a critical section within a signal handler. */
+	memset(&act, 0, sizeof(act));
+	act.sa_handler = nested_reader_handler;
+	if (sigemptyset(&act.sa_mask) || sigaction(SIGUSR1, &act, NULL))
+		abort();
+	uatomic_set(&reader_locked, 0);
+	uatomic_set(&reader_release, 0);
+	uatomic_set(&gp_done, 0);
+	if (pthread_create(&holder, NULL, signal_holder_fn, NULL))
+		abort();
+	while (!uatomic_read(&reader_locked))
+		(void) sched_yield();
+	if (pthread_create(&sync, NULL, sync_fn, NULL))
+		abort();
+	(void) poll(NULL, 0, 100);
+	gp_early = uatomic_read(&gp_done);
+	uatomic_set(&reader_release, 1);
+	if (pthread_join(holder, NULL) || pthread_join(sync, NULL))
+		abort();
+	ok(uatomic_read(&handler_ran) && !gp_early,
+		"grace period waits for a reader after a nested handler reader");
+	ok(uatomic_read(&gp_done), "grace period ends after the outer reader");
+
+	free(gp_data);
+	return exit_status();
+}
@@ -0,0 +1,142 @@
+/*
+ * test_urcu_cs_sample.c
+ *
+ * Userspace RCU library - test read-side critical-section sampling
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#include <stdlib.h>
+#include <stdint.h>
+#include <errno.h>
+#include <pthread.h>
+#include <poll.h>
+#include <urcu.h>
+
+#include "tap.h"
+
+#define NR_SHORT	100
+#define LONG_CS_MS	20
+
+static pthread_t reader_tid;
+static int reader_step, reader_done;
+
+/* Filled by cs_stats_cb() for the reader thread. */
+static int nr_found;
+static struct urcu_cs_stats reader_stats;
+
+static void cs_stats_cb(pthread_t tid, const struct urcu_cs_stats *stats,
+		void *priv)
+{
+	if (!pthread_equal(tid, reader_tid) || priv != &reader_tid)
+		return;
+	nr_found++;
+	reader_stats = *stats;
+}
+
+static void collect(void)
+{
+	nr_found = 0;
+	if (rcu_for_each_reader_cs_stats(cs_stats_cb, &reader_tid))
+		abort();
+}
+
+static void wait_reader(int step)
+{
+	while (CMM_LOAD_SHARED(reader_done) != step)
+		(void) poll(NULL, 0, 1);
+}
+
+/*
+ * Step 1: short critical sections with a nested one each, then a long
+ * one. Step 2: more critical sections, meant to run with sampling
+ * disabled.
+ */
+static void *cs_reader(void *arg)
+{
+	int i;
+
+	rcu_register_thread();
+	for (i = 0; i < NR_SHORT; i++) {
+		rcu_read_lock();
+		rcu_read_lock();
+		rcu_read_unlock();
+		rcu_read_unlock();
+	}
+	rcu_read_lock();
+	(void) poll(NULL, 0, LONG_CS_MS);
+	rcu_read_unlock();
+	CMM_STORE_SHARED(reader_done, 1);
+
+	while (CMM_LOAD_SHARED(reader_step) != 2)
+		(void) poll(NULL, 0, 1);
+	for (i = 0; i < NR_SHORT; i++) {
+		rcu_read_lock();
+		rcu_read_unlock();
+	}
+	CMM_STORE_SHARED(reader_done, 2);
+
+	while (CMM_LOAD_SHARED(reader_step) != 3)
+		(void) poll(NULL, 0, 1);
+	rcu_unregister_thread();
+	return NULL;
+}
+
+int main(int argc, char **argv)
+{
+	unsigned long sum = 0;
+	unsigned int i;
+	int ret;
+
+	plan_tests(6);
+
+	if (rcu_set_cs_sample_period(1) == -ENOSYS) {
+		ok(rcu_for_each_reader_cs_stats(cs_stats_cb, NULL) == -ENOSYS,
+			"collection unsupported without sampling");
+		skip(5, "built without --enable-rcu-cs-sampling");
+		return exit_status();
+	}
+
+	ret = pthread_create(&reader_tid, NULL, cs_reader, NULL);
+	if (ret)
+		abort();
+	wait_reader(1);
+
+	collect();
+	ok(nr_found == 1, "reader reported once");
+	ok(reader_stats.samples == NR_SHORT + 1,
+		"one sample per outermost critical section");
+	for (i = 0; i < URCU_STATS_CS_HIST_BUCKETS; i++)
+		sum += reader_stats.duration_hist[i];
+	ok(sum == reader_stats.samples, "histogram accounts for all samples");
+	ok(reader_stats.duration_max_ns >= LONG_CS_MS * 1000000ULL,
+		"longest critical section measured");
+
+	if (rcu_set_cs_sample_period(0))
+		abort();
+	CMM_STORE_SHARED(reader_step, 2);
+	wait_reader(2);
+	collect();
+	ok(reader_stats.samples == NR_SHORT + 1, "no sample once disabled");
+
+	CMM_STORE_SHARED(reader_step, 3);
+	ret = pthread_join(reader_tid, NULL);
+	if (ret)
+		abort();
+	collect();
+	ok(!nr_found, "unregistered reader not reported");
+
+	return exit_status();
+}
@@ -0,0 +1,224 @@
+/*
+ * test_urcu_isolated.c
+ *
+ * Userspace RCU library - test readers registered as isolated
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#define _LGPL_SOURCE
+#include <stdlib.h>
+#include <errno.h>
+#include <poll.h>
+#include <sched.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <urcu.h>
+
+#include "tap.h"
+
+#define NR_GP		300
+#define POISON		0xdead
+
+static int *shared;
+static int stop, nr_bad, reader_ret = -1, reader_started;
+static int isolated_cpu = -1, nr_bad_shared, shared_started;
+static int nr_bad_ctx, ctx_started, stop_shared;
+
+/* Pin the calling thread to cpu, or to the CPU it runs on if negative. */
+static int pin_thread(int cpu)
+{
+	cpu_set_t mask;
+
+	if (cpu < 0)
+		cpu = sched_getcpu();
+	if (cpu < 0)
+		cpu = 0;
+	CPU_ZERO(&mask);
+	CPU_SET(cpu, &mask);
+	return sched_setaffinity(0, sizeof(mask), &mask) ? -1 : cpu;
+}
+
+/* Busy-polling reader, as on an isolated CPU. */
+static void *thr_isolated_reader(void *arg)
+{
+	int *p;
+
+	int cpu;
+
+	cpu = pin_thread(-1);
+	if (cpu < 0)
+		abort();
+	reader_ret = rcu_register_thread_isolated();
+	uatomic_set(&isolated_cpu, cpu);
+	uatomic_set(&reader_started, 1);
+	if (reader_ret)
+		return NULL;
+	while (!uatomic_read(&stop)) {
+		rcu_read_lock();
+		p = rcu_dereference(shared);
+		if (p && *p == POISON)
+			uatomic_inc(&nr_bad);
+		rcu_read_unlock();
+		caa_cpu_relax();
+	}
+	rcu_unregister_thread();
+	return NULL;
+}
+
+/*
+ * Reader registered as usual, with compiler barriers only, allowed on
+ * the CPU of the isolated reader: that CPU must not be skipped.
+ */
+static void *thr_shared_reader(void *arg)
+{
+	int *p;
+
+	if (pin_thread(uatomic_read(&isolated_cpu)) < 0)
+		abort();
+	rcu_register_thread();
+	uatomic_set(&shared_started, 1);
+	while (!uatomic_read(&stop_shared)) {
+		rcu_read_lock();
+		p = rcu_dereference(shared);
+		if (p && *p == POISON)
+			uatomic_inc(&nr_bad_shared);
+		rcu_read_unlock();
+		(void) sched_yield();
+	}
+	rcu_unregister_thread();
+	return NULL;
+}
+
+/*
+ * Reader context on the CPU of the isolated reader, from a thread not
+ * registered with the flavor, once no registered reader shares that CPU:
+ * it must not be skipped either.
+ */
+static void *thr_ctx_reader(void *arg)
+{
+	struct urcu_reader *ctx;
+	int *p;
+
+	if (pin_thread(uatomic_read(&isolated_cpu)) < 0)
+		abort();
+	ctx = rcu_reader_ctx_create();
+	if (!ctx)
+		abort();
+	uatomic_set(&ctx_started, 1);
+	while (!uatomic_read(&stop)) {
+		rcu_read_lock_ctx(ctx);
+		p = rcu_dereference(shared);
+		if (p && *p == POISON)
+			uatomic_inc(&nr_bad_ctx);
+		rcu_read_unlock_ctx(ctx);
+		(void) sched_yield();
+	}
+	rcu_reader_ctx_destroy(ctx);
+	return NULL;
+}
+
+/* Replace the shared data NR_GP times, poisoning the old data. */
+static void run_grace_periods(void)
+{
+	int i, *p, *old;
+
+	for (i = 0; i < NR_GP; i++) {
+		p = malloc(sizeof(*p));
+		if (!p)
+			abort();
+		*p = i;
+		old = rcu_xchg_pointer(&shared, p);
+		synchronize_rcu();
+		if (old) {
+			*old = POISON;
+			free(old);
+		}
+		if (i % 16 == 0)
+			(void) poll(NULL, 0, 1);
+	}
+}
+
+int main(int argc, char **argv)
+{
+	pthread_t tid, shared_tid, ctx_tid;
+	cpu_set_t mask;
+
+	plan_tests(8);
+
+	ok(rcu_flavor.register_thread_isolated == rcu_register_thread_isolated,
+		"registration available through the flavor");
+
+	if (sched_getaffinity(0, sizeof(mask), &mask))
+		abort();
+	if (CPU_COUNT(&mask) > 1)
+		ok(rcu_register_thread_isolated() == -EINVAL,
+			"threads allowed on several CPUs are refused");
+	else
+		ok(1, "threads allowed on several CPUs are refused (single CPU)");
+
+	rcu_register_thread();
+	if (pthread_create(&tid, NULL, thr_isolated_reader, NULL))
+		abort();
+	while (!uatomic_read(&reader_started))
+		(void) poll(NULL, 0, 1);
+	ok(reader_ret == 0, "pinned reader registers as isolated");
+	if (pthread_create(&shared_tid, NULL, thr_shared_reader, NULL))
+		abort();
+	while (!uatomic_read(&shared_started))
+		(void) poll(NULL, 0, 1);
+
+	/* The updater is not a reader of its own grace periods. */
+	rcu_unregister_thread();
+	run_grace_periods();
+	uatomic_set(&stop_shared, 1);
+	if (pthread_join(shared_tid, NULL))
+		abort();
+	ok(!nr_bad_shared,
+		"grace periods wait for readers sharing an isolated CPU (%d bad reads)",
+		nr_bad_shared);
+
+	if (pthread_create(&ctx_tid, NULL, thr_ctx_reader, NULL))
+		abort();
+	while (!uatomic_read(&ctx_started))
+		(void) poll(NULL, 0, 1);
+	run_grace_periods();
+	uatomic_set(&stop, 1);
+	if (pthread_join(tid, NULL))
+		abort();
+	if (pthread_join(ctx_tid, NULL))
+		abort();
+	ok(!nr_bad, "grace periods wait for isolated readers (%d bad reads)",
+		nr_bad);
+	ok(!nr_bad_ctx,
+		"grace periods wait for reader contexts on an isolated CPU (%d bad reads)",
+		nr_bad_ctx);
+	free(shared);
+
+	/* The CPU of the isolated reader is not skipped anymore. */
+	rcu_register_thread();
+	synchronize_rcu();
+	rcu_unregister_thread();
+	ok(1, "grace period after the isolated reader unregistered");
+
+	if (pin_thread(-1) < 0)
+		abort();
+	ok(rcu_register_thread_isolated() == 0, "main thread registers as isolated");
+	rcu_read_lock();
+	rcu_read_unlock();
+	rcu_unregister_thread();
+
+	return exit_status();
+}
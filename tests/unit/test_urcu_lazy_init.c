@@ -0,0 +1,113 @@
+/*
+ * test_urcu_lazy_init.c
+ *
+ * Userspace RCU library - test initialization on first registration
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#define _LGPL_SOURCE
+#include <stdlib.h>
+#include <unistd.h>
+#include <sched.h>
+#include <pthread.h>
+#include <urcu/syscall-compat.h>
+#include <urcu.h>
+
+#include "tap.h"
+
+#define NR_THREADS	8
+#define NR_GP		100
+
+#define MEMBARRIER_CMD_QUERY		0
+#define MEMBARRIER_CMD_SHARED		(1 << 0)
+#define MEMBARRIER_CMD_PRIVATE_EXPEDITED	(1 << 3)
+
+static int go;
+static unsigned long nr_done, nr_bad;
+static int *shared;
+
+static int membarrier_available(void)
+{
+#ifdef __NR_membarrier
+	int mask = syscall(__NR_membarrier, MEMBARRIER_CMD_QUERY, 0);
+
+	return mask >= 0 && (mask & (MEMBARRIER_CMD_PRIVATE_EXPEDITED
+			| MEMBARRIER_CMD_SHARED));
+#else
+	return 0;
+#endif
+}
+
+/* All threads register at once: one of them initializes the library. */
+static void *thr_reader(void *arg)
+{
+	int *p;
+
+	while (!uatomic_read(&go))
+		sched_yield();
+	rcu_register_thread();
+	rcu_read_lock();
+	p = rcu_dereference(shared);
+	if (p && *p != 42)
+		uatomic_inc(&nr_bad);
+	rcu_read_unlock();
+	uatomic_inc(&nr_done);
+	rcu_unregister_thread();
+	return NULL;
+}
+
+int main(int argc, char **argv)
+{
+	pthread_t tid[NR_THREADS];
+	int i, *old, *p;
+
+	plan_tests(3);
+
+#if defined(CONFIG_RCU_LAZY_INIT) && !defined(CONFIG_RCU_FORCE_SYS_MEMBARRIER)
+	ok(!urcu_memb_has_sys_membarrier,
+		"library not initialized before first use");
+#else
+	skip(1, "library initialized by its constructor");
+#endif
+
+	for (i = 0; i < NR_THREADS; i++) {
+		if (pthread_create(&tid[i], NULL, thr_reader, NULL))
+			abort();
+	}
+	uatomic_set(&go, 1);
+	/* Grace periods concurrent with the first registrations. */
+	for (i = 0; i < NR_GP; i++) {
+		p = malloc(sizeof(*p));
+		if (!p)
+			abort();
+		*p = 42;
+		old = rcu_xchg_pointer(&shared, p);
+		synchronize_rcu();
+		if (old)
+			*old = 0;
+		free(old);
+	}
+	for (i = 0; i < NR_THREADS; i++) {
+		if (pthread_join(tid[i], NULL))
+			abort();
+	}
+	ok(nr_done == NR_THREADS && nr_bad == 0,
+		"concurrent first registrations and grace periods");
+	ok(!!urcu_memb_has_sys_membarrier == membarrier_available(),
+		"membarrier registered once the library is used");
+	free(shared);
+	return exit_status();
+}
@@ -20,6 +20,8 @@
  * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
  */
 
+#include <stdlib.h>
+
 #ifndef DYNAMIC_LINK_TEST
 #define _LGPL_SOURCE
 #endif
@@ -28,12 +30,72 @@
 #include <urcu.h>
 #include "test_urcu_multiflavor.h"
 
+static struct srcu_domain *test_domain;
+
+DEFINE_SRCU_FLAVOR(test_srcu_flavor_mb, urcu_mb, test_domain);
+
+static struct rcu_head test_srcu_head;
+static int test_srcu_invoked;
+
+static void test_srcu_cb(struct rcu_head *head)
+{
+	test_srcu_invoked = 1;
+}
+
+static int test_srcu(void)
+{
+	const struct rcu_flavor_struct *flavor = &test_srcu_flavor_mb;
+	struct urcu_stats stats;
+	unsigned long cookie;
+
+	test_domain = srcu_domain_create();
+	if (!test_domain)
+		return -1;
+	flavor->register_thread();
+	flavor->read_lock();
+	if (!srcu_read_ongoing(test_domain))
+		return -1;
+	flavor->update_call_rcu(&test_srcu_head, test_srcu_cb);
+	flavor->read_unlock();
+	flavor->barrier();
+	if (!test_srcu_invoked)
+		return -1;
+	cookie = get_state_synchronize_srcu(test_domain);
+	flavor->update_synchronize_rcu();
+	if (!poll_state_synchronize_srcu(test_domain, cookie))
+		return -1;
+	cond_synchronize_srcu(test_domain, cookie);
+	flavor->get_stats(&stats);
+	if (!stats.gp_count)
+		return -1;
+	flavor->unregister_thread();
+	srcu_domain_destroy(test_domain);
+	return 0;
+}
+
 int test_mf_mb(void)
 {
+	struct urcu_stats stats;
+	unsigned long cookie;
+
 	rcu_register_thread();
 	rcu_read_lock();
 	rcu_read_unlock();
+	cookie = get_state_synchronize_rcu();
 	synchronize_rcu();
+	if (!poll_state_synchronize_rcu(cookie))
+		return -1;
+	cond_synchronize_rcu(cookie);
+	free_rcu(malloc(16));
+	free_rcu_flush();
+	rcu_barrier();
+	rcu_barrier_crdp(get_default_call_rcu_data());
+	rcu_get_stats(&stats);
+	if (!stats.gp_count || !stats.call_rcu.invoked)
+		return -1;
+	synchronize_rcu_expedited();
 	rcu_unregister_thread();
+	if (test_srcu())
+		return -1;
 	return 0;
 }
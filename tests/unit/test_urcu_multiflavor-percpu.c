@@ -0,0 +1,59 @@
+/*
+ * test_urcu_multiflavor-percpu.c
+ *
+ * Userspace RCU library - test multiple RCU flavors into one program
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#include <stdlib.h>
+
+#ifndef DYNAMIC_LINK_TEST
+#define _LGPL_SOURCE
+#endif
+
+#define URCU_API_MAP
+#include <urcu/urcu-percpu.h>
+#include "test_urcu_multiflavor.h"
+
+int test_mf_percpu(void)
+{
+	struct urcu_stats stats;
+	unsigned long cookie;
+
+	rcu_read_lock();
+	rcu_read_lock();
+	rcu_read_unlock();
+	if (!rcu_read_ongoing())
+		return -1;
+	rcu_read_unlock();
+	if (rcu_read_ongoing())
+		return -1;
+	cookie = get_state_synchronize_rcu();
+	synchronize_rcu();
+	if (!poll_state_synchronize_rcu(cookie))
+		return -1;
+	cond_synchronize_rcu(cookie);
+	rcu_flavor.read_lock();
+	rcu_flavor.read_unlock();
+	free_rcu(malloc(16));
+	free_rcu_flush();
+	rcu_barrier();
+	rcu_barrier_crdp(get_default_call_rcu_data());
+	rcu_get_stats(&stats);
+	if (!stats.gp_count || !stats.call_rcu.invoked)
+		return -1;
+	return 0;
+}
@@ -20,6 +20,8 @@
  * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
  */
 
+#include <stdlib.h>
+
 #ifndef DYNAMIC_LINK_TEST
 #define _LGPL_SOURCE
 #endif
@@ -29,10 +31,24 @@
 
 int test_mf_qsbr(void)
 {
+	struct urcu_stats stats;
+	unsigned long cookie;
+
 	rcu_register_thread();
 	rcu_read_lock();
 	rcu_read_unlock();
+	cookie = get_state_synchronize_rcu();
 	synchronize_rcu();
+	if (!poll_state_synchronize_rcu(cookie))
+		return -1;
+	cond_synchronize_rcu(cookie);
+	free_rcu(malloc(16));
+	free_rcu_flush();
+	rcu_barrier();
+	rcu_barrier_crdp(get_default_call_rcu_data());
+	rcu_get_stats(&stats);
+	if (!stats.gp_count || !stats.call_rcu.invoked)
+		return -1;
 	rcu_unregister_thread();
 	return 0;
 }
@@ -26,4 +26,5 @@ extern int test_mf_mb(void);
 extern int test_mf_signal(void);
 extern int test_mf_qsbr(void);
 extern int test_mf_bp(void);
+extern int test_mf_percpu(void);
 
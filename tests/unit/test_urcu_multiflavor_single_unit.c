@@ -29,6 +29,7 @@
 #include <urcu/urcu-memb.h>
 #include <urcu/urcu-signal.h>
 #include <urcu/urcu-qsbr.h>
+#include <urcu/urcu-percpu.h>
 
 #include <stdlib.h>
 #include "tap.h"
@@ -83,15 +84,26 @@ static int test_mf_qsbr(void)
 	return 0;
 }
 
+static int test_mf_percpu(void)
+{
+	urcu_percpu_register_thread();
+	urcu_percpu_read_lock();
+	urcu_percpu_read_unlock();
+	urcu_percpu_synchronize_rcu();
+	urcu_percpu_unregister_thread();
+	return 0;
+}
+
 int main(int argc, char **argv)
 {
-	plan_tests(5);
+	plan_tests(6);
 
 	ok1(!test_mf_mb());
 	ok1(!test_mf_bp());
 	ok1(!test_mf_memb());
 	ok1(!test_mf_signal());
 	ok1(!test_mf_qsbr());
+	ok1(!test_mf_percpu());
 
 	return exit_status();
 }
@@ -0,0 +1,170 @@
+/*
+ * test_urcu_nesting.c
+ *
+ * Userspace RCU library - test nested and signal handler read-side
+ * critical sections
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#define _LGPL_SOURCE
+#include <stdlib.h>
+#include <signal.h>
+#include <pthread.h>
+#include <poll.h>
+#include <urcu.h>
+
+#include "tap.h"
+
+#define NESTING		5
+#define NR_UPDATES	200
+
+struct obj {
+	int valid;
+};
+
+static struct obj *shared;
+static int reader_ready, reader_release, gp_done, stop;
+static unsigned long nr_bad_read, nr_handler_reads;
+
+static void check_shared(void)
+{
+	struct obj *obj = rcu_dereference(shared);
+
+	if (!CMM_LOAD_SHARED(obj->valid))
+		uatomic_inc(&nr_bad_read);
+}
+
+/* Holds its outermost critical section until released. */
+static void *thr_nested_reader(void *arg)
+{
+	rcu_register_thread();
+	rcu_read_lock();
+	rcu_read_lock();
+	rcu_read_unlock();
+	rcu_read_lock();
+	CMM_STORE_SHARED(reader_ready, 1);
+	while (!CMM_LOAD_SHARED(reader_release))
+		(void) poll(NULL, 0, 1);
+	rcu_read_unlock();
+	rcu_read_unlock();
+	rcu_unregister_thread();
+	return NULL;
+}
+
+static void *thr_synchronize(void *arg)
+{
+	rcu_register_thread();
+	synchronize_rcu();
+	CMM_STORE_SHARED(gp_done, 1);
+	rcu_unregister_thread();
+	return NULL;
+}
+
+static void handler(int sig)
+{
+	rcu_read_lock();
+	check_shared();
+	rcu_read_unlock();
+	CMM_STORE_SHARED(nr_handler_reads, nr_handler_reads + 1);
+}
+
+/* Nests critical sections, interrupted by signal handlers. */
+static void *thr_signal_reader(void *arg)
+{
+	rcu_register_thread();
+	CMM_STORE_SHARED(reader_ready, 1);
+	while (!uatomic_read(&stop)) {
+		rcu_read_lock();
+		rcu_read_lock();
+		check_shared();
+		rcu_read_unlock();
+		rcu_read_unlock();
+	}
+	rcu_unregister_thread();
+	return NULL;
+}
+
+static struct obj *obj_new(void)
+{
+	struct obj *obj;
+
+	obj = malloc(sizeof(*obj));
+	if (!obj)
+		abort();
+	obj->valid = 1;
+	return obj;
+}
+
+int main(int argc, char **argv)
+{
+	pthread_t reader, updater;
+	struct obj *old;
+	unsigned long i;
+	int depth;
+
+	plan_tests(5);
+
+	rcu_register_thread();
+	for (depth = 0; depth < NESTING; depth++)
+		rcu_read_lock();
+	ok(rcu_read_ongoing(), "nested read-side critical section");
+	for (depth = 0; depth < NESTING - 1; depth++)
+		rcu_read_unlock();
+	ok(rcu_read_ongoing(), "outermost critical section still ongoing");
+	rcu_read_unlock();
+	ok(!rcu_read_ongoing(), "outermost unlock ends critical section");
+
+	if (pthread_create(&reader, NULL, thr_nested_reader, NULL))
+		abort();
+	while (!CMM_LOAD_SHARED(reader_ready))
+		(void) poll(NULL, 0, 1);
+	if (pthread_create(&updater, NULL, thr_synchronize, NULL))
+		abort();
+	(void) poll(NULL, 0, 50);
+	ok(!CMM_LOAD_SHARED(gp_done), "grace period waits for nested reader");
+	CMM_STORE_SHARED(reader_release, 1);
+	if (pthread_join(reader, NULL) || pthread_join(updater, NULL))
+		abort();
+
+	shared = obj_new();
+	reader_ready = 0;
+	if (signal(SIGUSR1, handler) == SIG_ERR)
+		abort();
+	if (pthread_create(&reader, NULL, thr_signal_reader, NULL))
+		abort();
+	while (!CMM_LOAD_SHARED(reader_ready))
+		(void) poll(NULL, 0, 1);
+	for (i = 0; i < NR_UPDATES; i++) {
+		if (pthread_kill(reader, SIGUSR1))
+			abort();
+		/* Let the handler run before the next update. */
+		while (CMM_LOAD_SHARED(nr_handler_reads) == i)
+			(void) poll(NULL, 0, 0);
+		old = rcu_xchg_pointer(&shared, obj_new());
+		synchronize_rcu();
+		CMM_STORE_SHARED(old->valid, 0);
+		synchronize_rcu();
+		free(old);
+	}
+	uatomic_set(&stop, 1);
+	if (pthread_join(reader, NULL))
+		abort();
+	ok(nr_bad_read == 0, "nested and signal handler readers see valid "
+		"objects (%lu handler reads)", nr_handler_reads);
+	free(shared);
+	rcu_unregister_thread();
+	return exit_status();
+}
@@ -0,0 +1,105 @@
+/*
+ * test_urcu_qsbr_block.c
+ *
+ * Userspace RCU library - test QSBR blocking calls
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#include <stdlib.h>
+#include <errno.h>
+#include <unistd.h>
+#include <poll.h>
+#include <pthread.h>
+#include <sys/epoll.h>
+#include <urcu-qsbr.h>
+#include <urcu/qsbr-block.h>
+
+#include "tap.h"
+
+#define NR_GP	10
+
+static int pipefd[2], epfd;
+static int blocked, nr_events, nested_online;
+
+/* Block in epoll_wait() until the main thread writes to the pipe. */
+static void *thr_loop(void *arg)
+{
+	struct epoll_event ev;
+	int was_online;
+
+	rcu_register_thread();
+	CMM_STORE_SHARED(blocked, 1);
+	nr_events = urcu_qsbr_epoll_wait(epfd, &ev, 1, -1);
+
+	/* Offline threads stay offline. */
+	rcu_thread_offline();
+	was_online = urcu_qsbr_blocking_begin();
+	urcu_qsbr_blocking_end(was_online);
+	nested_online = was_online || rcu_read_ongoing();
+	rcu_thread_online();
+	rcu_unregister_thread();
+	return NULL;
+}
+
+int main(int argc, char **argv)
+{
+	struct epoll_event ev = { .events = EPOLLIN };
+	pthread_t tid;
+	char c = 0;
+	ssize_t ret;
+	int i;
+
+	plan_tests(6);
+
+	if (pipe(pipefd))
+		abort();
+	epfd = epoll_create1(0);
+	if (epfd < 0 || epoll_ctl(epfd, EPOLL_CTL_ADD, pipefd[0], &ev))
+		abort();
+
+	if (pthread_create(&tid, NULL, thr_loop, NULL))
+		abort();
+	while (!CMM_LOAD_SHARED(blocked))
+		(void) poll(NULL, 0, 1);
+	(void) poll(NULL, 0, 10);
+	/* The loop thread blocks: it must not delay grace periods. */
+	for (i = 0; i < NR_GP; i++)
+		synchronize_rcu();
+	ok(1, "grace periods complete while a thread blocks in epoll_wait");
+
+	if (write(pipefd[1], &c, 1) != 1)
+		abort();
+	if (pthread_join(tid, NULL))
+		abort();
+	ok(nr_events == 1, "epoll_wait returns the event");
+	ok(!nested_online, "offline thread stays offline");
+
+	rcu_register_thread();
+	ok(urcu_qsbr_epoll_wait(epfd, &ev, 1, 0) == 1 && rcu_read_ongoing(),
+		"zero timeout stays online");
+	ret = URCU_QSBR_BLOCKING_CALL(read(pipefd[0], &c, 1));
+	ok(ret == 1 && rcu_read_ongoing(), "blocking call returns online");
+
+	close(pipefd[1]);
+	close(pipefd[0]);
+	errno = 0;
+	ret = URCU_QSBR_BLOCKING_CALL(read(pipefd[0], &c, 1));
+	ok(ret == -1 && errno == EBADF, "errno of the blocking call preserved");
+	rcu_unregister_thread();
+
+	close(epfd);
+	return exit_status();
+}
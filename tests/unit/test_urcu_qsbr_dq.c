@@ -0,0 +1,221 @@
+/*
+ * test_urcu_qsbr_dq.c
+ *
+ * Userspace RCU library - test QSBR inline reclamation defer queue
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#include <stdlib.h>
+#include <errno.h>
+#include <poll.h>
+#include <pthread.h>
+#include <urcu-qsbr.h>
+#include <urcu/qsbr-dq.h>
+
+#include "tap.h"
+
+#define DQ_SIZE		8
+#define NR_READERS	4
+#define NR_UPDATES	10000
+#define OBJ_MAGIC	0x5a5aUL
+#define OBJ_POISON	0xdeadUL
+
+struct obj {
+	unsigned long magic;
+};
+
+static int reader_state, release_reader;
+static unsigned long nr_freed, last_freed;
+
+static void free_index(void *ptr, void *priv)
+{
+	unsigned long *freed = priv;
+
+	/* Objects are freed oldest first. */
+	if ((unsigned long) ptr != *freed + 1)
+		abort();
+	*freed = (unsigned long) ptr;
+	nr_freed++;
+}
+
+/* Stay online without quiescent state until released. */
+static void *thr_held(void *arg)
+{
+	rcu_register_thread();
+	CMM_STORE_SHARED(reader_state, 1);
+	while (!CMM_LOAD_SHARED(release_reader))
+		(void) poll(NULL, 0, 1);
+	while (CMM_LOAD_SHARED(release_reader) == 1) {
+		rcu_quiescent_state();
+		(void) poll(NULL, 0, 1);
+	}
+	rcu_unregister_thread();
+	return NULL;
+}
+
+static struct obj *shared_obj;
+static int stop_stress, nr_started;
+static unsigned long nr_poisoned;
+
+static void free_obj(void *ptr, void *priv)
+{
+	struct obj *obj = ptr;
+
+	obj->magic = OBJ_POISON;
+	free(obj);
+	uatomic_inc((unsigned long *) priv);
+}
+
+static void *thr_reader(void *arg)
+{
+	struct obj *obj;
+	unsigned long i = 0;
+
+	rcu_register_thread();
+	uatomic_inc(&nr_started);
+	while (!CMM_LOAD_SHARED(stop_stress)) {
+		obj = rcu_dereference(shared_obj);
+		if (CMM_LOAD_SHARED(obj->magic) != OBJ_MAGIC)
+			uatomic_inc(&nr_poisoned);
+		if (!(++i % 64))
+			rcu_quiescent_state();
+		if (!(i % 4096)) {
+			rcu_thread_offline();
+			rcu_thread_online();
+		}
+	}
+	rcu_unregister_thread();
+	return NULL;
+}
+
+static void *thr_sync(void *arg)
+{
+	rcu_register_thread();
+	while (!CMM_LOAD_SHARED(stop_stress)) {
+		synchronize_rcu();
+		(void) poll(NULL, 0, 1);
+	}
+	rcu_unregister_thread();
+	return NULL;
+}
+
+static struct obj *new_obj(void)
+{
+	struct obj *obj = malloc(sizeof(*obj));
+
+	if (!obj)
+		abort();
+	obj->magic = OBJ_MAGIC;
+	return obj;
+}
+
+int main(int argc, char **argv)
+{
+	pthread_t tid[NR_READERS + 1];
+	struct urcu_qsbr_dq *dq;
+	unsigned long i, pending, token, nr_full = 0, obj_freed = 0;
+	struct obj *old;
+	int ret, waited;
+
+	plan_tests(10);
+
+	rcu_register_thread();
+	ok(!urcu_qsbr_dq_create(0, 0, 0, free_index, &last_freed),
+		"empty queue refused");
+	dq = urcu_qsbr_dq_create(DQ_SIZE, DQ_SIZE, 0, free_index,
+			&last_freed);
+	if (!dq)
+		abort();
+	ret = urcu_qsbr_dq_enqueue(dq, (void *) 1UL);
+	ok(!ret && urcu_qsbr_dq_reclaim(dq, 0, &pending) == 1 && !pending,
+		"reclaimed right away without other reader");
+
+	if (pthread_create(&tid[0], NULL, thr_held, NULL))
+		abort();
+	while (!CMM_LOAD_SHARED(reader_state))
+		(void) poll(NULL, 0, 1);
+	token = urcu_qsbr_token_start();
+	for (i = 2; i < DQ_SIZE + 2; i++) {
+		if (urcu_qsbr_dq_enqueue(dq, (void *) i))
+			abort();
+	}
+	(void) poll(NULL, 0, 10);
+	ok(!urcu_qsbr_token_check(token)
+			&& !urcu_qsbr_dq_reclaim(dq, 0, &pending)
+			&& pending == DQ_SIZE,
+		"reader without quiescent state holds the queue");
+	ok(urcu_qsbr_dq_enqueue(dq, (void *) i) == -ENOSPC,
+		"full queue refuses objects");
+	ok(urcu_qsbr_dq_destroy(dq) == -EAGAIN, "destroy waits for objects");
+
+	CMM_STORE_SHARED(release_reader, 1);
+	for (waited = 0; !urcu_qsbr_token_check(token) && waited < 10000;
+			waited++)
+		(void) poll(NULL, 0, 1);
+	ok(urcu_qsbr_token_check(token), "quiescent state reaches token");
+	ok(urcu_qsbr_dq_reclaim(dq, 3, &pending) == 3
+			&& pending == DQ_SIZE - 3 && last_freed == 4,
+		"reclaim bounded, oldest first");
+	for (ret = 0; i < 2 * DQ_SIZE - 2; i++)
+		ret |= urcu_qsbr_dq_enqueue(dq, (void *) i);
+	ok(!ret && last_freed >= DQ_SIZE + 1,
+		"enqueue reclaims from the trigger limit");
+	CMM_STORE_SHARED(release_reader, 2);
+	if (pthread_join(tid[0], NULL))
+		abort();
+	ok(!urcu_qsbr_dq_destroy(dq) && nr_freed == 2 * DQ_SIZE - 3,
+		"destroy reclaims objects of offline readers");
+
+	/* Readers, writer and synchronize_rcu() concurrently. */
+	dq = urcu_qsbr_dq_create(64, 32, 16, free_obj, &obj_freed);
+	if (!dq)
+		abort();
+	shared_obj = new_obj();
+	for (i = 0; i < NR_READERS; i++) {
+		if (pthread_create(&tid[i], NULL, thr_reader, NULL))
+			abort();
+	}
+	if (pthread_create(&tid[NR_READERS], NULL, thr_sync, NULL))
+		abort();
+	while (uatomic_read(&nr_started) < NR_READERS)
+		(void) poll(NULL, 0, 1);
+	for (i = 0; i < NR_UPDATES; i++) {
+		old = rcu_xchg_pointer(&shared_obj, new_obj());
+		if (urcu_qsbr_dq_enqueue(dq, old)) {
+			nr_full++;
+			synchronize_rcu();
+			free_obj(old, &obj_freed);
+		}
+		if (!(i % 128))
+			(void) urcu_qsbr_dq_reclaim(dq, 0, NULL);
+	}
+	CMM_STORE_SHARED(stop_stress, 1);
+	/* Do not hold back a synchronize_rcu() of thr_sync. */
+	rcu_thread_offline();
+	for (i = 0; i < NR_READERS + 1; i++) {
+		if (pthread_join(tid[i], NULL))
+			abort();
+	}
+	rcu_thread_online();
+	while (urcu_qsbr_dq_destroy(dq))
+		(void) poll(NULL, 0, 1);
+	ok(!nr_poisoned && obj_freed == NR_UPDATES,
+		"objects freed once readers are done (%lu full)", nr_full);
+	free(shared_obj);
+	rcu_unregister_thread();
+
+	return exit_status();
+}
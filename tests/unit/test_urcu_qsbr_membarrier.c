@@ -0,0 +1,141 @@
+/*
+ * test_urcu_qsbr_membarrier.c
+ *
+ * Userspace RCU library - test the QSBR flavor with sys_membarrier
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#define _LGPL_SOURCE
+#include <stdbool.h>
+#include <stdlib.h>
+#include <errno.h>
+#include <sched.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <sys/syscall.h>
+#include <urcu-qsbr.h>
+
+#include "tap.h"
+
+#define NR_ROUNDS	200
+#define NR_READERS	4
+
+/* Commands of membarrier(2). */
+#define TEST_MEMBARRIER_CMD_QUERY		0
+#define TEST_MEMBARRIER_CMD_PRIVATE_EXPEDITED	(1 << 3)
+
+struct test_data {
+	int valid;
+};
+
+static struct test_data *gp_data;
+static int stop, nr_bad;
+
+static bool membarrier_available(void)
+{
+#ifdef __NR_membarrier
+	long mask = syscall(__NR_membarrier, TEST_MEMBARRIER_CMD_QUERY, 0);
+
+	return mask >= 0 && (mask & TEST_MEMBARRIER_CMD_PRIVATE_EXPEDITED);
+#else
+	return false;
+#endif
+}
+
+/* Report quiescent states, and go offline now and then. */
+static void *reader_fn(void *arg)
+{
+	struct test_data *data;
+	unsigned long i = 0;
+
+	rcu_register_thread();
+	while (!CMM_LOAD_SHARED(stop)) {
+		rcu_read_lock();
+		data = rcu_dereference(gp_data);
+		if (data && !CMM_LOAD_SHARED(data->valid))
+			uatomic_inc(&nr_bad);
+		rcu_read_unlock();
+		rcu_quiescent_state();
+		if (!(++i % 64)) {
+			rcu_thread_offline();
+			(void) sched_yield();
+			rcu_thread_online();
+		}
+	}
+	rcu_unregister_thread();
+	return NULL;
+}
+
+static void test_updates(void)
+{
+	pthread_t readers[NR_READERS];
+	struct test_data *data, *old;
+	int i;
+
+	CMM_STORE_SHARED(stop, 0);
+	for (i = 0; i < NR_READERS; i++) {
+		if (pthread_create(&readers[i], NULL, reader_fn, NULL))
+			abort();
+	}
+	for (i = 0; i < NR_ROUNDS; i++) {
+		data = malloc(sizeof(*data));
+		if (!data)
+			abort();
+		data->valid = 1;
+		old = rcu_xchg_pointer(&gp_data, data);
+		synchronize_rcu();
+		if (old) {
+			CMM_STORE_SHARED(old->valid, 0);
+			free(old);
+		}
+	}
+	CMM_STORE_SHARED(stop, 1);
+	for (i = 0; i < NR_READERS; i++) {
+		if (pthread_join(readers[i], NULL))
+			abort();
+	}
+}
+
+int main(int argc, char **argv)
+{
+	int ret;
+
+	plan_tests(5);
+
+	test_updates();
+	ok(!nr_bad, "readers never see reclaimed data with memory barriers");
+
+	ret = urcu_qsbr_enable_sys_membarrier();
+	if (!membarrier_available()) {
+		ok(ret == -ENOSYS, "enable fails without membarrier");
+		skip(2, "membarrier private expedited not available");
+	} else {
+		ok(ret == 0 && urcu_qsbr_has_sys_membarrier, "enable");
+		ok(urcu_qsbr_enable_sys_membarrier() == 0, "enable twice");
+		test_updates();
+		ok(!nr_bad, "readers never see reclaimed data with membarrier");
+	}
+
+	/* Registered writer thread, online while waiting. */
+	rcu_register_thread();
+	synchronize_rcu();
+	rcu_quiescent_state();
+	ok(urcu_qsbr_read_ongoing(), "online writer thread");
+	rcu_unregister_thread();
+	free(gp_data);
+
+	return exit_status();
+}
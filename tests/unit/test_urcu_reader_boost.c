@@ -0,0 +1,125 @@
+/*
+ * test_urcu_reader_boost.c
+ *
+ * Userspace RCU library - test the boost of readers blocking grace periods
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#include <stdlib.h>
+#include <errno.h>
+#include <pthread.h>
+#include <poll.h>
+#include <sched.h>
+#include <urcu.h>
+
+#include "tap.h"
+
+#define BOOST_THRESHOLD_MS	10
+#define BOOST_WAIT_MS		5000
+
+static int reader_ready, reader_boosted, reader_done;
+
+static int current_policy(pthread_t tid)
+{
+	struct sched_param param;
+	int policy;
+
+	if (pthread_getschedparam(tid, &policy, &param))
+		abort();
+	return policy;
+}
+
+/*
+ * Leaves its critical section once boosted, so that the grace period
+ * waits for it until the boost, or for BOOST_WAIT_MS.
+ */
+static void *boost_reader(void *arg)
+{
+	int i;
+
+	rcu_register_thread();
+	rcu_read_lock();
+	CMM_STORE_SHARED(reader_ready, 1);
+	for (i = 0; i < BOOST_WAIT_MS; i++) {
+		if (current_policy(pthread_self()) == SCHED_FIFO) {
+			CMM_STORE_SHARED(reader_boosted, 1);
+			break;
+		}
+		(void) poll(NULL, 0, 1);
+	}
+	rcu_read_unlock();
+	while (!CMM_LOAD_SHARED(reader_done))
+		(void) poll(NULL, 0, 1);
+	rcu_unregister_thread();
+	return NULL;
+}
+
+/* Whether this process may switch a thread to SCHED_FIFO. */
+static int boost_permitted(void)
+{
+	struct sched_param param = { .sched_priority = 1 }, old;
+	int policy;
+
+	if (pthread_getschedparam(pthread_self(), &policy, &old))
+		abort();
+	if (pthread_setschedparam(pthread_self(), SCHED_FIFO, &param))
+		return 0;
+	if (pthread_setschedparam(pthread_self(), policy, &old))
+		abort();
+	return 1;
+}
+
+int main(int argc, char **argv)
+{
+	pthread_t reader_tid;
+	int policy;
+
+	plan_tests(5);
+
+	ok(rcu_set_reader_boost(BOOST_THRESHOLD_MS, SCHED_FIFO,
+			sched_get_priority_max(SCHED_FIFO) + 1) == -EINVAL,
+		"invalid priority refused");
+	ok(!rcu_set_reader_boost(BOOST_THRESHOLD_MS, SCHED_FIFO, 1),
+		"boost enabled");
+
+	rcu_register_thread();
+	policy = current_policy(pthread_self());
+	rcu_unregister_thread();
+	if (pthread_create(&reader_tid, NULL, boost_reader, NULL))
+		abort();
+	while (!CMM_LOAD_SHARED(reader_ready))
+		(void) poll(NULL, 0, 1);
+
+	synchronize_rcu();
+	if (boost_permitted()) {
+		ok(CMM_LOAD_SHARED(reader_boosted),
+			"reader blocking the grace period boosted");
+		ok(current_policy(reader_tid) == policy,
+			"reader policy restored after the grace period");
+	} else {
+		ok(!CMM_LOAD_SHARED(reader_boosted),
+			"reader boost not permitted");
+		ok(current_policy(reader_tid) == policy,
+			"reader policy unchanged");
+	}
+	CMM_STORE_SHARED(reader_done, 1);
+	if (pthread_join(reader_tid, NULL))
+		abort();
+
+	ok(!rcu_set_reader_boost(0, SCHED_OTHER, 0), "boost disabled");
+
+	return exit_status();
+}
@@ -0,0 +1,182 @@
+/*
+ * test_urcu_reader_ctx.c
+ *
+ * Userspace RCU library - test reader contexts detached from threads
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#define _LGPL_SOURCE
+#include <stdlib.h>
+#include <poll.h>
+#include <pthread.h>
+#include <urcu.h>
+
+#include "tap.h"
+
+#define NR_FIBERS	8
+#define NR_WORKERS	2
+#define NR_GP		500
+
+/*
+ * A fiber holds a read-side critical section from one run to the next,
+ * possibly on another worker thread.
+ */
+struct fiber {
+	struct urcu_reader *ctx;
+	int *p;		/* Read in the critical section in progress. */
+};
+
+static struct fiber fibers[NR_FIBERS];
+static unsigned int next_fiber;
+static pthread_mutex_t run_queue = PTHREAD_MUTEX_INITIALIZER;
+
+static int *shared;
+static int stop_workers, gp_done;
+static unsigned long nr_bad, nr_runs;
+
+static struct urcu_reader *test_ctx;
+
+/* Unregistered worker thread, running fibers in turn. */
+static void *thr_worker(void *arg)
+{
+	struct fiber *fiber;
+
+	while (!uatomic_read(&stop_workers)) {
+		pthread_mutex_lock(&run_queue);
+		fiber = &fibers[next_fiber++ % NR_FIBERS];
+		if (!fiber->p) {
+			rcu_read_lock_ctx(fiber->ctx);
+			fiber->p = rcu_dereference(shared);
+		} else {
+			if (*fiber->p != 42)
+				nr_bad++;
+			fiber->p = NULL;
+			rcu_read_unlock_ctx(fiber->ctx);
+		}
+		nr_runs++;
+		pthread_mutex_unlock(&run_queue);
+	}
+	return NULL;
+}
+
+static void *thr_lock(void *arg)
+{
+	rcu_read_lock_ctx(test_ctx);
+	return NULL;
+}
+
+static void *thr_synchronize(void *arg)
+{
+	synchronize_rcu();
+	uatomic_set(&gp_done, 1);
+	return NULL;
+}
+
+static void join(pthread_t tid)
+{
+	if (pthread_join(tid, NULL))
+		abort();
+}
+
+static void test_migration(void)
+{
+	pthread_t tid;
+	int waited;
+
+	/* Enter the critical section from a thread which then exits. */
+	if (pthread_create(&tid, NULL, thr_lock, NULL))
+		abort();
+	join(tid);
+	if (pthread_create(&tid, NULL, thr_synchronize, NULL))
+		abort();
+	(void) poll(NULL, 0, 50);
+	waited = !uatomic_read(&gp_done);
+	rcu_read_unlock_ctx(test_ctx);
+	join(tid);
+	ok(waited && gp_done,
+		"grace period waits for a context left by its thread");
+}
+
+static void test_fibers(void)
+{
+	pthread_t tid[NR_WORKERS];
+	int i, *old, *p;
+
+	for (i = 0; i < NR_FIBERS; i++) {
+		fibers[i].ctx = rcu_reader_ctx_create();
+		if (!fibers[i].ctx)
+			abort();
+	}
+	p = malloc(sizeof(*p));
+	if (!p)
+		abort();
+	*p = 42;
+	rcu_assign_pointer(shared, p);
+	for (i = 0; i < NR_WORKERS; i++) {
+		if (pthread_create(&tid[i], NULL, thr_worker, NULL))
+			abort();
+	}
+	/* Let all fibers enter a critical section first. */
+	while (uatomic_read(&nr_runs) < NR_FIBERS)
+		(void) poll(NULL, 0, 1);
+	for (i = 0; i < NR_GP; i++) {
+		p = malloc(sizeof(*p));
+		if (!p)
+			abort();
+		*p = 42;
+		old = rcu_xchg_pointer(&shared, p);
+		synchronize_rcu();
+		*old = 0;
+		free(old);
+	}
+	uatomic_set(&stop_workers, 1);
+	for (i = 0; i < NR_WORKERS; i++)
+		join(tid[i]);
+	ok(!nr_bad, "fibers migrating within critical sections never see"
+		" reclaimed data (%lu runs)", nr_runs);
+
+	for (i = 0; i < NR_FIBERS; i++) {
+		if (fibers[i].p)
+			rcu_read_unlock_ctx(fibers[i].ctx);
+		rcu_reader_ctx_destroy(fibers[i].ctx);
+	}
+	synchronize_rcu();
+	pass("grace periods complete once contexts are destroyed");
+	free(shared);
+}
+
+int main(int argc, char **argv)
+{
+	plan_tests(5);
+
+	test_ctx = rcu_reader_ctx_create();
+	if (!test_ctx)
+		abort();
+	ok(!rcu_read_ongoing_ctx(test_ctx) && !rcu_read_ongoing(),
+		"a new context is outside of critical sections");
+	rcu_read_lock_ctx(test_ctx);
+	rcu_read_lock_ctx(test_ctx);
+	rcu_read_unlock_ctx(test_ctx);
+	ok(rcu_read_ongoing_ctx(test_ctx) && !rcu_read_ongoing(),
+		"contexts nest independently of the thread");
+	rcu_read_unlock_ctx(test_ctx);
+
+	test_migration();
+	rcu_reader_ctx_destroy(test_ctx);
+
+	test_fibers();
+	return exit_status();
+}
@@ -0,0 +1,114 @@
+/*
+ * test_urcu_rseq.c
+ *
+ * Userspace RCU library - test restartable sequences
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#include <stdlib.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <urcu/arch.h>
+
+#include "compat-getcpu.h"
+#include "urcu-rseq.h"
+#include "tap.h"
+
+#define NR_THREADS	4
+#define NR_ADDS		200000
+#define MAX_CPUS	4096
+
+struct percpu_count {
+	intptr_t count;
+} __attribute__((aligned(CAA_CACHE_LINE_SIZE)));
+
+static struct percpu_count counts[MAX_CPUS];
+static unsigned long nr_aborts;
+
+static void *thr_adder(void *arg)
+{
+	unsigned long i, aborts = 0;
+	intptr_t old;
+	int cpu;
+
+	for (i = 0; i < NR_ADDS; i++) {
+		for (;;) {
+			cpu = urcu_rseq_current_cpu();
+			if (cpu < 0 || cpu >= MAX_CPUS)
+				cpu = 0;
+			if (i & 1) {
+				if (!urcu_rseq_addv(&counts[cpu].count, 1, cpu))
+					break;
+			} else {
+				old = CMM_LOAD_SHARED(counts[cpu].count);
+				if (!urcu_rseq_cmpeqv_storev(&counts[cpu].count,
+						old, old + 1, cpu))
+					break;
+			}
+			aborts++;
+		}
+	}
+	uatomic_add(&nr_aborts, aborts);
+	return NULL;
+}
+
+int main(int argc, char **argv)
+{
+	pthread_t tid[NR_THREADS];
+	intptr_t v = 5, sum = 0;
+	int cpu, i;
+
+	plan_tests(6);
+
+	cpu = urcu_rseq_current_cpu();
+	ok(cpu < 0 || cpu < sysconf(_SC_NPROCESSORS_CONF),
+		"current CPU is valid (%d)", cpu);
+	ok(cpu < 0 || urcu_sched_getcpu() == cpu,
+		"urcu_sched_getcpu() reads the rseq area");
+
+	/* Retry until the thread stays on the same CPU. */
+	do {
+		cpu = urcu_rseq_current_cpu();
+	} while (urcu_rseq_addv(&v, 2, cpu));
+	ok(v == 7, "add");
+	ok(urcu_rseq_cmpeqv_storev(&v, 6, 10, cpu) != 0 && v == 7,
+		"compare-and-store leaves a mismatching value");
+
+#ifdef URCU_RSEQ_COMMIT
+	if (urcu_rseq_current_cpu() >= 0)
+		ok(urcu_rseq_addv(&v, 1, urcu_rseq_current_cpu() + 1) == -1
+				&& v == 7,
+			"commit on another CPU fails");
+	else
+#endif
+		ok(1, "commit on another CPU fails (not supported)");
+
+	for (i = 0; i < NR_THREADS; i++) {
+		if (pthread_create(&tid[i], NULL, thr_adder, NULL))
+			abort();
+	}
+	for (i = 0; i < NR_THREADS; i++) {
+		if (pthread_join(tid[i], NULL))
+			abort();
+	}
+	for (i = 0; i < MAX_CPUS; i++)
+		sum += counts[i].count;
+	ok(sum == (intptr_t) NR_THREADS * NR_ADDS,
+		"concurrent per-CPU commits counted exactly (%lu retries)",
+		nr_aborts);
+
+	return exit_status();
+}
@@ -0,0 +1,142 @@
+/*
+ * test_urcu_signal_membarrier.c
+ *
+ * Userspace RCU library - test urcu-signal barrier selection
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#include <stdbool.h>
+#include <stdlib.h>
+#include <signal.h>
+#include <sched.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <sys/syscall.h>
+#include <urcu/urcu-signal.h>
+
+#include "tap.h"
+
+/* Default signal of the library, only exported to LGPL users. */
+#ifndef SIGRCU
+#define SIGRCU	SIGUSR1
+#endif
+
+#define NR_ROUNDS	200
+#define NR_READERS	4
+
+/* Commands of membarrier(2). */
+#define TEST_MEMBARRIER_CMD_QUERY		0
+#define TEST_MEMBARRIER_CMD_PRIVATE_EXPEDITED	(1 << 3)
+
+struct test_data {
+	int valid;
+};
+
+static struct test_data *gp_data;
+static int stop, nr_bad, nr_app_signals;
+
+static void app_handler(int signo)
+{
+	uatomic_inc(&nr_app_signals);
+}
+
+static bool membarrier_available(void)
+{
+#ifdef __NR_membarrier
+	long mask = syscall(__NR_membarrier, TEST_MEMBARRIER_CMD_QUERY, 0);
+
+	return mask >= 0 && (mask & TEST_MEMBARRIER_CMD_PRIVATE_EXPEDITED);
+#else
+	return false;
+#endif
+}
+
+static void *reader_fn(void *arg)
+{
+	struct test_data *data;
+
+	urcu_signal_register_thread();
+	while (!CMM_LOAD_SHARED(stop)) {
+		urcu_signal_read_lock();
+		data = rcu_dereference(gp_data);
+		if (data && !CMM_LOAD_SHARED(data->valid))
+			uatomic_inc(&nr_bad);
+		urcu_signal_read_unlock();
+		(void) sched_yield();
+	}
+	urcu_signal_unregister_thread();
+	return NULL;
+}
+
+int main(int argc, char **argv)
+{
+	pthread_t readers[NR_READERS];
+	struct test_data *data, *old;
+	struct sigaction act;
+	int i;
+
+	plan_tests(3);
+
+	if (sigaction(SIGRCU, NULL, &act))
+		abort();
+	if (membarrier_available())
+		ok(act.sa_handler == SIG_DFL,
+			"no SIGRCU handler with membarrier");
+	else
+		ok(act.sa_handler != SIG_DFL,
+			"SIGRCU handler without membarrier");
+
+	for (i = 0; i < NR_READERS; i++) {
+		if (pthread_create(&readers[i], NULL, reader_fn, NULL))
+			abort();
+	}
+	for (i = 0; i < NR_ROUNDS; i++) {
+		data = malloc(sizeof(*data));
+		if (!data)
+			abort();
+		data->valid = 1;
+		old = rcu_xchg_pointer(&gp_data, data);
+		urcu_signal_synchronize_rcu();
+		if (old) {
+			CMM_STORE_SHARED(old->valid, 0);
+			free(old);
+		}
+	}
+	CMM_STORE_SHARED(stop, 1);
+	for (i = 0; i < NR_READERS; i++) {
+		if (pthread_join(readers[i], NULL))
+			abort();
+	}
+	ok(!nr_bad, "readers never see reclaimed data");
+
+	if (!membarrier_available()) {
+		skip(1, "membarrier private expedited not available");
+	} else {
+		act.sa_handler = app_handler;
+		act.sa_flags = 0;
+		sigemptyset(&act.sa_mask);
+		if (sigaction(SIGRCU, &act, NULL))
+			abort();
+		urcu_signal_register_thread();
+		urcu_signal_synchronize_rcu();
+		urcu_signal_unregister_thread();
+		ok(!uatomic_read(&nr_app_signals),
+			"grace periods leave SIGRCU to the application");
+	}
+	free(gp_data);
+
+	return exit_status();
+}
@@ -0,0 +1,91 @@
+/*
+ * test_urcu_stall.c
+ *
+ * Userspace RCU library - test the reader stall watchdog
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#include <stdlib.h>
+#include <stdint.h>
+#include <pthread.h>
+#include <poll.h>
+#include <urcu.h>
+
+#include "tap.h"
+
+#define STALL_THRESHOLD_MS	10
+
+static pthread_t reader_tid;
+static int reader_ready, reader_release;
+static int nr_reports, nr_foreign_reports;
+static uint64_t report_active_ns;
+
+/*
+ * Releases the stalled reader on its first report, so the grace period
+ * only completes if the watchdog fired.
+ */
+static void stall_report(pthread_t tid, uint64_t active_ns, void *priv)
+{
+	if (!pthread_equal(tid, reader_tid) || priv != &reader_tid) {
+		nr_foreign_reports++;
+		return;
+	}
+	nr_reports++;
+	report_active_ns = active_ns;
+	CMM_STORE_SHARED(reader_release, 1);
+}
+
+static void *stall_reader(void *arg)
+{
+	rcu_register_thread();
+	rcu_read_lock();
+	CMM_STORE_SHARED(reader_ready, 1);
+	while (!CMM_LOAD_SHARED(reader_release))
+		(void) poll(NULL, 0, 1);
+	rcu_read_unlock();
+	rcu_unregister_thread();
+	return NULL;
+}
+
+int main(int argc, char **argv)
+{
+	int ret, reports;
+
+	plan_tests(4);
+
+	rcu_set_stall_watchdog(STALL_THRESHOLD_MS, stall_report, &reader_tid);
+	ret = pthread_create(&reader_tid, NULL, stall_reader, NULL);
+	if (ret)
+		abort();
+	while (!CMM_LOAD_SHARED(reader_ready))
+		(void) poll(NULL, 0, 1);
+
+	synchronize_rcu();
+	ok(nr_reports >= 1, "stalled reader reported");
+	ok(!nr_foreign_reports, "only the stalled reader is reported");
+	ok(report_active_ns >= STALL_THRESHOLD_MS * 1000000ULL,
+		"reported duration reaches the threshold");
+
+	ret = pthread_join(reader_tid, NULL);
+	if (ret)
+		abort();
+	rcu_set_stall_watchdog(0, NULL, NULL);
+	reports = nr_reports;
+	synchronize_rcu();
+	ok(nr_reports == reports, "no report once disabled");
+
+	return exit_status();
+}
@@ -0,0 +1,124 @@
+/*
+ * test_urcu_sync_flavors.c
+ *
+ * Userspace RCU library - test grace periods across several flavors
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#include <stdlib.h>
+#include <pthread.h>
+#include <urcu/urcu-memb.h>
+#include <urcu/urcu-qsbr.h>
+#include <urcu/urcu-bp.h>
+
+#include "tap.h"
+
+#define NR_UPDATES	100
+
+struct obj {
+	int valid;
+};
+
+static const struct rcu_flavor_struct *flavors[] = {
+	&urcu_memb_flavor,
+	&urcu_qsbr_flavor,
+	&urcu_bp_flavor,
+};
+#define NR_FLAVORS	(sizeof(flavors) / sizeof(flavors[0]))
+
+static struct obj *shared;
+static int stop;
+static unsigned long nr_bad_read, nr_reads;
+
+/* Readers of each flavor share the object. */
+static void *thr_reader(void *arg)
+{
+	const struct rcu_flavor_struct *flavor = arg;
+	struct obj *obj;
+
+	flavor->register_thread();
+	while (!uatomic_read(&stop)) {
+		flavor->read_lock();
+		obj = rcu_dereference(shared);
+		caa_cpu_relax();
+		if (!CMM_LOAD_SHARED(obj->valid))
+			uatomic_inc(&nr_bad_read);
+		flavor->read_unlock();
+		flavor->read_quiescent_state();
+		uatomic_inc(&nr_reads);
+	}
+	flavor->unregister_thread();
+	return NULL;
+}
+
+static struct obj *obj_new(void)
+{
+	struct obj *obj;
+
+	obj = malloc(sizeof(*obj));
+	if (!obj)
+		abort();
+	obj->valid = 1;
+	return obj;
+}
+
+int main(int argc, char **argv)
+{
+	pthread_t tid[NR_FLAVORS];
+	struct obj *old;
+	unsigned long i;
+
+	plan_tests(4);
+
+	for (i = 0; i < NR_FLAVORS; i++)
+		flavors[i]->register_thread();
+	shared = obj_new();
+	for (i = 0; i < NR_FLAVORS; i++) {
+		if (pthread_create(&tid[i], NULL, thr_reader,
+				(void *) flavors[i]))
+			abort();
+	}
+
+	urcu_synchronize_rcu_flavors(flavors, 0);
+	ok(1, "no flavor");
+	for (i = 0; i < NR_UPDATES; i++) {
+		old = rcu_xchg_pointer(&shared, obj_new());
+		urcu_synchronize_rcu_flavors(flavors, NR_FLAVORS);
+		/* Readers of every flavor are done with the old object. */
+		CMM_STORE_SHARED(old->valid, 0);
+		urcu_memb_synchronize_rcu();
+		urcu_qsbr_synchronize_rcu();
+		urcu_bp_synchronize_rcu();
+		free(old);
+	}
+	ok(urcu_qsbr_read_ongoing(), "thread back online for QSBR");
+	uatomic_set(&stop, 1);
+	for (i = 0; i < NR_FLAVORS; i++) {
+		if (pthread_join(tid[i], NULL))
+			abort();
+	}
+	ok(nr_bad_read == 0, "readers of every flavor see valid objects "
+		"(%lu reads)", nr_reads);
+
+	urcu_qsbr_thread_offline();
+	urcu_synchronize_rcu_flavors(flavors, NR_FLAVORS);
+	ok(!urcu_qsbr_read_ongoing(), "offline thread stays offline");
+	urcu_qsbr_thread_online();
+	free(shared);
+	for (i = 0; i < NR_FLAVORS; i++)
+		flavors[i]->unregister_thread();
+	return exit_status();
+}
@@ -0,0 +1,120 @@
+/*
+ * test_wfcq_batch.c
+ *
+ * Userspace RCU library - test wfcqueue batched enqueue
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#include <stdlib.h>
+#include <pthread.h>
+#include <urcu/wfcqueue.h>
+
+#include "tap.h"
+
+#define BATCH		16
+#define NR_THREADS	4
+#define NR_BATCHES	10000
+
+struct test_node {
+	struct cds_wfcq_node node;
+	unsigned long thread, seq;
+};
+
+static struct cds_wfcq_head head;
+static struct cds_wfcq_tail tail;
+static struct test_node nodes[NR_THREADS][NR_BATCHES * BATCH];
+
+/* Link the n nodes starting at tn into a chain. */
+static void link_chain(struct test_node *tn, unsigned long n)
+{
+	unsigned long i;
+
+	for (i = 0; i < n; i++) {
+		cds_wfcq_node_init(&tn[i].node);
+		if (i)
+			tn[i - 1].node.next = &tn[i].node;
+	}
+}
+
+static void *producer_fn(void *arg)
+{
+	unsigned long thread = (unsigned long) arg, i;
+	struct test_node *tn;
+
+	for (i = 0; i < NR_BATCHES; i++) {
+		tn = &nodes[thread][i * BATCH];
+		link_chain(tn, BATCH);
+		(void) cds_wfcq_enqueue_batch(&head, &tail, &tn[0].node,
+				&tn[BATCH - 1].node);
+	}
+	return NULL;
+}
+
+int main(int argc, char **argv)
+{
+	unsigned long next[NR_THREADS] = { 0 }, i, nr = 0;
+	pthread_t producers[NR_THREADS];
+	struct cds_wfcq_node *node;
+	struct test_node *tn, single;
+	int bad = 0;
+
+	plan_tests(5);
+
+	for (i = 0; i < NR_THREADS; i++)
+		for (nr = 0; nr < NR_BATCHES * BATCH; nr++) {
+			nodes[i][nr].thread = i;
+			nodes[i][nr].seq = nr;
+		}
+
+	cds_wfcq_init(&head, &tail);
+	link_chain(nodes[0], 3);
+	ok(!cds_wfcq_enqueue_batch(&head, &tail, &nodes[0][0].node,
+			&nodes[0][2].node),
+		"batch into empty queue returns false");
+	cds_wfcq_node_init(&single.node);
+	ok(cds_wfcq_enqueue_batch(&head, &tail, &single.node, &single.node),
+		"single-node batch into non-empty queue returns true");
+	nr = 0;
+	while ((node = cds_wfcq_dequeue_blocking(&head, &tail)) != NULL) {
+		tn = caa_container_of(node, struct test_node, node);
+		if (nr < 3 ? tn != &nodes[0][nr] : tn != &single)
+			bad = 1;
+		nr++;
+	}
+	ok(!bad && nr == 4, "chain is dequeued in order");
+
+	for (i = 0; i < NR_THREADS; i++)
+		if (pthread_create(&producers[i], NULL, producer_fn,
+				(void *) i))
+			abort();
+	for (i = 0; i < NR_THREADS; i++)
+		if (pthread_join(producers[i], NULL))
+			abort();
+
+	/* Each thread's nodes come out in order, even across batches. */
+	nr = 0;
+	while ((node = cds_wfcq_dequeue_blocking(&head, &tail)) != NULL) {
+		tn = caa_container_of(node, struct test_node, node);
+		if (tn->seq != next[tn->thread]++)
+			bad = 1;
+		nr++;
+	}
+	ok(nr == NR_THREADS * NR_BATCHES * BATCH,
+		"concurrent batches enqueue every node");
+	ok(!bad, "concurrent batches keep their order");
+	cds_wfcq_destroy(&head, &tail);
+	return exit_status();
+}
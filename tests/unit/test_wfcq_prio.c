@@ -0,0 +1,205 @@
+/*
+ * test_wfcq_prio.c
+ *
+ * Userspace RCU library - test multi-level priority wfcqueue
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#define _LGPL_SOURCE
+#include <stdlib.h>
+#include <poll.h>
+#include <urcu.h>
+#include <urcu/wfcqueue-prio.h>
+
+#include "workqueue.h"
+#include "tap.h"
+
+#define NR_NODES	8
+#define NR_WORK		16
+#define TIMEOUT_MS	3000
+
+struct test_node {
+	struct cds_wfcq_node node;
+	unsigned int prio;
+	unsigned int seq;
+};
+
+static struct test_node nodes[NR_NODES];
+static struct cds_wfcq_prio q;
+
+static struct urcu_work works[NR_WORK];
+static struct rcu_head heads[NR_WORK];
+static int started, released;
+static unsigned long nr_done;
+static unsigned int order[NR_WORK];
+
+/* Nodes 0..7 with priorities 0 2 1 2 0 9 1 0: 9 is clamped. */
+static void enqueue_all(void)
+{
+	static const unsigned int prio[NR_NODES] = { 0, 2, 1, 2, 0, 9, 1, 0 };
+	unsigned int i;
+
+	for (i = 0; i < NR_NODES; i++) {
+		cds_wfcq_node_init(&nodes[i].node);
+		nodes[i].prio = prio[i];
+		nodes[i].seq = i;
+		cds_wfcq_prio_enqueue(&q, &nodes[i].node, prio[i]);
+	}
+}
+
+/* Highest priority first, FIFO within a priority. */
+static int check_order(struct test_node **seen, unsigned int nr)
+{
+	static const unsigned int expect[NR_NODES] = { 5, 1, 3, 2, 6, 0, 4, 7 };
+	unsigned int i;
+
+	if (nr != NR_NODES)
+		return 0;
+	for (i = 0; i < nr; i++) {
+		if (seen[i]->seq != expect[i])
+			return 0;
+	}
+	return 1;
+}
+
+static int wait_for(unsigned long *value, unsigned long nr)
+{
+	int ms;
+
+	for (ms = 0; ms < TIMEOUT_MS; ms++) {
+		if (uatomic_read(value) >= nr)
+			return 1;
+		(void) poll(NULL, 0, 1);
+	}
+	return 0;
+}
+
+/* Runs until released, while the work is queued behind it. */
+static void blocking_work(struct urcu_work *work)
+{
+	uatomic_set(&started, 1);
+	while (!uatomic_read(&released))
+		(void) poll(NULL, 0, 1);
+}
+
+static void record_work(struct urcu_work *work)
+{
+	order[uatomic_add_return(&nr_done, 1) - 1] = work - works;
+}
+
+static void blocking_cb(struct rcu_head *head)
+{
+	uatomic_set(&started, 1);
+	while (!uatomic_read(&released))
+		(void) poll(NULL, 0, 1);
+}
+
+static void record_cb(struct rcu_head *head)
+{
+	order[uatomic_add_return(&nr_done, 1) - 1] = head - heads;
+}
+
+/* Odd items are urgent: 1 3 5 ... 15, then 2 4 6 ... 14. */
+static int order_ok(void)
+{
+	unsigned int i;
+
+	for (i = 0; i < NR_WORK - 1; i++) {
+		if (order[i] != (i < NR_WORK / 2 ? 2 * i + 1
+				: 2 * (i - NR_WORK / 2 + 1)))
+			return 0;
+	}
+	return 1;
+}
+
+static void wait_started(void)
+{
+	while (!uatomic_read(&started))
+		(void) poll(NULL, 0, 1);
+}
+
+int main(int argc, char **argv)
+{
+	struct test_node *seen[NR_NODES + 1];
+	struct cds_wfcq_head head;
+	struct cds_wfcq_tail tail;
+	struct cds_wfcq_node *node;
+	struct urcu_workqueue *workqueue;
+	struct call_rcu_data *crdp;
+	unsigned int i, nr;
+
+	plan_tests(7);
+
+	cds_wfcq_prio_init(&q);
+	ok(cds_wfcq_prio_empty(&q) && !cds_wfcq_prio_dequeue_blocking(&q),
+		"new queue is empty");
+
+	enqueue_all();
+	for (nr = 0; (node = cds_wfcq_prio_dequeue_blocking(&q)) != NULL; nr++)
+		seen[nr] = caa_container_of(node, struct test_node, node);
+	ok(check_order(seen, nr) && cds_wfcq_prio_empty(&q),
+		"dequeue by priority");
+
+	enqueue_all();
+	cds_wfcq_init(&head, &tail);
+	ok(cds_wfcq_prio_splice_blocking(&head, &tail, &q)
+			== CDS_WFCQ_RET_DEST_EMPTY
+		&& cds_wfcq_prio_splice_blocking(&head, &tail, &q)
+			== CDS_WFCQ_RET_SRC_EMPTY,
+		"splice all bands");
+	nr = 0;
+	while ((node = cds_wfcq_dequeue_blocking(&head, &tail)) != NULL)
+		seen[nr++] = caa_container_of(node, struct test_node, node);
+	ok(check_order(seen, nr), "splice by priority");
+	cds_wfcq_destroy(&head, &tail);
+	cds_wfcq_prio_destroy(&q);
+
+	/* Work queued behind a blocked worker: half of it urgent. */
+	workqueue = urcu_workqueue_create(0, -1, NULL, NULL, NULL, NULL,
+			NULL, NULL, NULL, NULL);
+	urcu_workqueue_queue_work(workqueue, &works[0], blocking_work);
+	wait_started();
+	for (i = 1; i < NR_WORK; i++)
+		urcu_workqueue_queue_work_prio(workqueue, &works[i],
+			record_work, i & 1 ? URCU_WORK_PRIO_HIGH :
+			URCU_WORK_PRIO_NORMAL);
+	uatomic_set(&released, 1);
+	urcu_workqueue_flush_queued_work(workqueue);
+	ok(nr_done == NR_WORK - 1 && order_ok(),
+		"urgent work runs first, flush waits for all");
+	urcu_workqueue_destroy(workqueue);
+
+	/* Callbacks of one batch, behind a blocked call_rcu thread. */
+	rcu_register_thread();
+	crdp = create_call_rcu_data(0, -1);
+	set_thread_call_rcu_data(crdp);
+	uatomic_set(&started, 0);
+	uatomic_set(&released, 0);
+	nr_done = 0;
+	call_rcu(&heads[0], blocking_cb);
+	wait_started();
+	for (i = 1; i < NR_WORK; i++)
+		call_rcu_prio(&heads[i], record_cb,
+			i & 1 ? CALL_RCU_PRIO_HIGH : CALL_RCU_PRIO_NORMAL);
+	uatomic_set(&released, 1);
+	ok(wait_for(&nr_done, NR_WORK - 1), "callbacks invoked");
+	ok(order_ok(), "urgent callbacks invoked first in their batch");
+	rcu_barrier();
+	set_thread_call_rcu_data(NULL);
+	call_rcu_data_free(crdp);
+	rcu_unregister_thread();
+	return exit_status();
+}
@@ -0,0 +1,149 @@
+/*
+ * test_wfcq_sharded.c
+ *
+ * Userspace RCU library - test per-CPU sharded wfcqueue
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#include <stdlib.h>
+#include <pthread.h>
+#include <urcu/uatomic.h>
+#include <urcu/wfcqueue.h>
+#include <urcu/wfcqueue-sharded.h>
+
+#include "tap.h"
+
+#define NR_THREADS	4
+#define NR_PER_THREAD	50000
+#define BATCH		4
+
+struct test_node {
+	struct cds_wfcq_node node;
+	unsigned long thread, seq;
+	int seen;
+};
+
+static struct cds_wfcq_sharded *q;
+static struct test_node nodes[NR_THREADS][NR_PER_THREAD];
+
+/* Alternate single and batched enqueues. */
+static void *producer_fn(void *arg)
+{
+	unsigned long thread = (unsigned long) arg, i, k;
+	struct test_node *tn = nodes[thread];
+
+	for (i = 0; i < NR_PER_THREAD; i += BATCH) {
+		for (k = 0; k < BATCH; k++) {
+			tn[i + k].thread = thread;
+			tn[i + k].seq = i + k;
+			cds_wfcq_node_init(&tn[i + k].node);
+		}
+		if (i & BATCH) {
+			for (k = 0; k < BATCH; k++)
+				(void) cds_wfcq_sharded_enqueue(q,
+					&tn[i + k].node);
+		} else {
+			for (k = 1; k < BATCH; k++)
+				tn[i + k - 1].node.next = &tn[i + k].node;
+			(void) cds_wfcq_sharded_enqueue_batch(q,
+				&tn[i].node, &tn[i + BATCH - 1].node);
+		}
+	}
+	return NULL;
+}
+
+int main(int argc, char **argv)
+{
+	unsigned long i, nr = 0, nr_splice = 0;
+	struct cds_wfcq_head head;
+	struct cds_wfcq_tail tail;
+	struct cds_wfcq_node *node, *n;
+	pthread_t producers[NR_THREADS];
+	struct test_node *tn;
+	int bad = 0;
+
+	plan_tests(7);
+
+	q = cds_wfcq_sharded_new(3);
+	ok(q && cds_wfcq_sharded_nr_shards(q) == 4,
+		"shard count is rounded up to a power of two");
+	cds_wfcq_sharded_destroy(q);
+
+	q = cds_wfcq_sharded_new(0);
+	ok(q && cds_wfcq_sharded_nr_shards(q) >= 1
+		&& cds_wfcq_sharded_empty(q)
+		&& !cds_wfcq_sharded_dequeue_blocking(q),
+		"new queue has one shard per CPU and is empty");
+
+	cds_wfcq_init(&head, &tail);
+	ok(cds_wfcq_sharded_splice_blocking(&head, &tail, q)
+			== CDS_WFCQ_RET_SRC_EMPTY,
+		"splice from empty queue");
+
+	for (i = 0; i < NR_THREADS; i++)
+		if (pthread_create(&producers[i], NULL, producer_fn,
+				(void *) i))
+			abort();
+
+	/* Consume while producers run, alternating dequeue and splice. */
+	while (nr < NR_THREADS * NR_PER_THREAD) {
+		if (nr_splice++ & 1) {
+			node = cds_wfcq_sharded_dequeue_blocking(q);
+			if (!node)
+				continue;
+			cds_wfcq_node_init(node);
+			cds_wfcq_enqueue(&head, &tail, node);
+		} else {
+			(void) cds_wfcq_sharded_splice_blocking(&head, &tail, q);
+		}
+		__cds_wfcq_for_each_blocking_safe(&head, &tail, node, n) {
+			tn = caa_container_of(node, struct test_node, node);
+			if (tn->seen++)
+				bad = 1;
+			nr++;
+		}
+		cds_wfcq_init(&head, &tail);
+	}
+	for (i = 0; i < NR_THREADS; i++)
+		if (pthread_join(producers[i], NULL))
+			abort();
+
+	ok(nr == NR_THREADS * NR_PER_THREAD, "every node is consumed");
+	ok(!bad, "no node is consumed twice");
+	ok(cds_wfcq_sharded_empty(q), "queue is empty after consumption");
+	cds_wfcq_sharded_destroy(q);
+
+	/*
+	 * Threads may migrate between CPUs, so only a single shard keeps
+	 * the order of all nodes of a thread.
+	 */
+	q = cds_wfcq_sharded_new(1);
+	for (i = 0; i < NR_PER_THREAD; i++) {
+		nodes[0][i].seq = i;
+		cds_wfcq_node_init(&nodes[0][i].node);
+		(void) cds_wfcq_sharded_enqueue(q, &nodes[0][i].node);
+	}
+	for (i = 0; i < NR_PER_THREAD; i++) {
+		node = cds_wfcq_sharded_dequeue_blocking(q);
+		tn = caa_container_of(node, struct test_node, node);
+		if (!node || tn->seq != i)
+			bad = 1;
+	}
+	ok(!bad, "single shard dequeues in FIFO order");
+	cds_wfcq_destroy(&head, &tail);
+	cds_wfcq_sharded_destroy(q);
+	return exit_status();
+}
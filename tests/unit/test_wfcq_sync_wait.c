@@ -0,0 +1,126 @@
+/*
+ * test_wfcq_sync_wait.c
+ *
+ * Userspace RCU library - test consumer waits for enqueues in progress
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+/* Sleep stages long enough that only the enqueuer can end them early. */
+#define _LGPL_SOURCE
+#define CDS_WFCQ_SLEEP_MIN_NS	2000000000L
+#define CDS_WFCQ_SLEEP_MAX_NS	2000000000L
+
+#include <stdlib.h>
+#include <poll.h>
+#include <pthread.h>
+#include <time.h>
+#include <urcu/uatomic.h>
+#include <urcu/wfcqueue.h>
+#include <urcu/wfstack.h>
+
+#include "tap.h"
+
+#define STALL_MS	50
+
+static struct cds_wfcq_head head;
+static struct cds_wfcq_tail tail;
+static struct cds_wfcq_waiter waiter;
+static struct cds_wfs_stack stack;
+
+static unsigned long now_ms(void)
+{
+	struct timespec ts;
+
+	if (clock_gettime(CLOCK_MONOTONIC, &ts))
+		abort();
+	return ts.tv_sec * 1000UL + ts.tv_nsec / 1000000;
+}
+
+static void *dequeue_fn(void *arg)
+{
+	return cds_wfcq_dequeue_timeout(&head, &tail, &waiter, -1);
+}
+
+static void *pop_fn(void *arg)
+{
+	return cds_wfs_pop_blocking(&stack);
+}
+
+int main(int argc, char **argv)
+{
+	struct cds_wfcq_wait_stats stats;
+	struct cds_wfcq_node a, b, *old_tail;
+	struct cds_wfs_node n;
+	struct cds_wfs_head *old_head;
+	pthread_t tid;
+	unsigned long start, i;
+	void *ret;
+
+	plan_tests(6);
+
+	cds_wfcq_init(&head, &tail);
+	cds_wfcq_waiter_init(&waiter);
+	cds_wfcq_waiter_get_stats(&waiter, &stats);
+	ok(!stats.busy_waits && !stats.yields && !stats.futex_waits
+			&& !stats.wakeups, "stats start at zero");
+
+	/* Stop an enqueue between the tail xchg and the next store. */
+	cds_wfcq_node_init(&a);
+	old_tail = uatomic_xchg(&tail.p, &a);
+	if (pthread_create(&tid, NULL, dequeue_fn, NULL))
+		abort();
+	for (i = 0; i < 5000 && !uatomic_read(&waiter.nr_sync_waiters); i++)
+		(void) poll(NULL, 0, 1);
+	ok(uatomic_read(&waiter.nr_sync_waiters) == 1,
+		"consumer sleeps while the enqueue is in progress");
+
+	/* Complete it, and let the next enqueue wake up the consumer. */
+	start = now_ms();
+	CMM_STORE_SHARED(old_tail->next, &a);
+	cds_wfcq_node_init(&b);
+	(void) cds_wfcq_enqueue_wake(&head, &tail, &waiter, &b);
+	if (pthread_join(tid, &ret))
+		abort();
+	ok(ret == &a && now_ms() - start < 1000,
+		"enqueuer wakes up the consumer (%lu ms)", now_ms() - start);
+	ok(cds_wfcq_dequeue_timeout(&head, &tail, &waiter, 0) == &b,
+		"next node is dequeued");
+
+	cds_wfcq_waiter_get_stats(&waiter, &stats);
+	ok(stats.busy_waits == 1 && stats.yields == CDS_WFCQ_YIELD_ATTEMPTS
+			&& stats.futex_waits >= 1 && stats.wakeups >= 1,
+		"waits are accounted (%lu busy, %lu yields, %lu futex, %lu wakeups)",
+		stats.busy_waits, stats.yields, stats.futex_waits,
+		stats.wakeups);
+
+	/* Stop a push between the head xchg and the next store. */
+	cds_wfs_init(&stack);
+	cds_wfs_node_init(&n);
+	old_head = uatomic_xchg(&stack.head,
+			caa_container_of(&n, struct cds_wfs_head, node));
+	if (pthread_create(&tid, NULL, pop_fn, NULL))
+		abort();
+	(void) poll(NULL, 0, STALL_MS);
+	CMM_STORE_SHARED(n.next, &old_head->node);
+	if (pthread_join(tid, &ret))
+		abort();
+	ok(ret == &n && cds_wfs_empty(&stack),
+		"pop waits for the push in progress");
+
+	cds_wfs_destroy(&stack);
+	cds_wfcq_destroy(&head, &tail);
+	return exit_status();
+}
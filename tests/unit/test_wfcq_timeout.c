@@ -0,0 +1,138 @@
+/*
+ * test_wfcq_timeout.c
+ *
+ * Userspace RCU library - test wfcqueue dequeue with timeout
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#include <stdlib.h>
+#include <poll.h>
+#include <pthread.h>
+#include <time.h>
+#include <urcu/uatomic.h>
+#include <urcu/wfcqueue.h>
+
+#include "tap.h"
+
+#define TIMEOUT_MS	50
+#define NR_CONSUMERS	4
+#define NR_NODES	100000
+#define BATCH		8
+#define STALL_MS	10000
+
+static struct cds_wfcq_head head;
+static struct cds_wfcq_tail tail;
+static struct cds_wfcq_waiter waiter;
+static struct cds_wfcq_node nodes[NR_NODES], stop_nodes[NR_CONSUMERS];
+static unsigned long nr_dequeued, nr_stalls;
+
+static unsigned long now_ms(void)
+{
+	struct timespec ts;
+
+	if (clock_gettime(CLOCK_MONOTONIC, &ts))
+		abort();
+	return ts.tv_sec * 1000UL + ts.tv_nsec / 1000000;
+}
+
+static void *wait_one_fn(void *arg)
+{
+	return cds_wfcq_dequeue_timeout(&head, &tail, &waiter, -1);
+}
+
+/* Dequeue until a stop node, counting waits which time out. */
+static void *consumer_fn(void *arg)
+{
+	struct cds_wfcq_node *node;
+
+	for (;;) {
+		node = cds_wfcq_dequeue_timeout(&head, &tail, &waiter,
+				STALL_MS);
+		if (!node) {
+			uatomic_inc(&nr_stalls);
+			continue;
+		}
+		if (node >= stop_nodes && node < stop_nodes + NR_CONSUMERS)
+			break;
+		uatomic_inc(&nr_dequeued);
+	}
+	return NULL;
+}
+
+int main(int argc, char **argv)
+{
+	pthread_t consumers[NR_CONSUMERS], waiting;
+	struct cds_wfcq_node single;
+	unsigned long start, i, k;
+	void *ret;
+
+	plan_tests(6);
+
+	cds_wfcq_init(&head, &tail);
+	cds_wfcq_waiter_init(&waiter);
+
+	ok(!cds_wfcq_dequeue_timeout(&head, &tail, &waiter, 0),
+		"zero timeout does not wait");
+	start = now_ms();
+	ok(!cds_wfcq_dequeue_timeout(&head, &tail, &waiter, TIMEOUT_MS)
+		&& now_ms() - start >= TIMEOUT_MS - 1,
+		"empty queue times out");
+
+	if (pthread_create(&waiting, NULL, wait_one_fn, NULL))
+		abort();
+	(void) poll(NULL, 0, 100);
+	ok(uatomic_read(&waiter.nr_waiters) == 1, "consumer waits");
+	cds_wfcq_node_init(&single);
+	(void) cds_wfcq_enqueue_wake(&head, &tail, &waiter, &single);
+	if (pthread_join(waiting, &ret))
+		abort();
+	ok(ret == &single && !uatomic_read(&waiter.nr_waiters),
+		"enqueue wakes up the consumer");
+
+	/* Consumers go to sleep and wake up as producers trickle nodes. */
+	for (i = 0; i < NR_CONSUMERS; i++)
+		if (pthread_create(&consumers[i], NULL, consumer_fn, NULL))
+			abort();
+	for (i = 0; i < NR_NODES; i += BATCH) {
+		for (k = 0; k < BATCH; k++) {
+			cds_wfcq_node_init(&nodes[i + k]);
+			if (k)
+				nodes[i + k - 1].next = &nodes[i + k];
+		}
+		if (i & BATCH)
+			(void) cds_wfcq_enqueue_batch_wake(&head, &tail,
+				&waiter, &nodes[i], &nodes[i + BATCH - 1]);
+		else
+			for (k = 0; k < BATCH; k++) {
+				nodes[i + k].next = NULL;
+				(void) cds_wfcq_enqueue_wake(&head, &tail,
+					&waiter, &nodes[i + k]);
+			}
+	}
+	for (i = 0; i < NR_CONSUMERS; i++) {
+		cds_wfcq_node_init(&stop_nodes[i]);
+		(void) cds_wfcq_enqueue_wake(&head, &tail, &waiter,
+			&stop_nodes[i]);
+	}
+	for (i = 0; i < NR_CONSUMERS; i++)
+		if (pthread_join(consumers[i], NULL))
+			abort();
+	ok(nr_dequeued == NR_NODES, "consumers dequeue every node");
+	ok(!nr_stalls, "no wakeup is lost");
+
+	cds_wfcq_destroy(&head, &tail);
+	return exit_status();
+}
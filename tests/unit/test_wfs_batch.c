@@ -0,0 +1,131 @@
+/*
+ * test_wfs_batch.c
+ *
+ * Userspace RCU library - test wfstack batched push
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#include <stdlib.h>
+#include <pthread.h>
+#include <urcu/wfstack.h>
+
+#include "tap.h"
+
+#define BATCH		16
+#define NR_THREADS	4
+#define NR_BATCHES	10000
+
+struct test_node {
+	struct cds_wfs_node node;
+	unsigned long thread, seq;
+};
+
+static struct cds_wfs_stack stack;
+static struct test_node nodes[NR_THREADS][NR_BATCHES * BATCH];
+
+/* Link the n nodes starting at tn into a chain. */
+static void link_chain(struct test_node *tn, unsigned long n)
+{
+	unsigned long i;
+
+	for (i = 0; i < n; i++) {
+		cds_wfs_node_init(&tn[i].node);
+		if (i)
+			tn[i - 1].node.next = &tn[i].node;
+	}
+}
+
+static void *producer_fn(void *arg)
+{
+	unsigned long thread = (unsigned long) arg, i;
+	struct test_node *tn;
+
+	for (i = 0; i < NR_BATCHES; i++) {
+		tn = &nodes[thread][i * BATCH];
+		link_chain(tn, BATCH);
+		(void) cds_wfs_push_batch(&stack, &tn[0].node,
+				&tn[BATCH - 1].node);
+	}
+	return NULL;
+}
+
+int main(int argc, char **argv)
+{
+	unsigned long i, nr = 0, nr_run = 0;
+	unsigned long last[NR_THREADS] = { 0 };
+	pthread_t producers[NR_THREADS];
+	struct cds_wfs_node *node, *n;
+	struct cds_wfs_head *head;
+	struct test_node *tn, single;
+	int bad = 0;
+
+	plan_tests(6);
+
+	for (i = 0; i < NR_THREADS; i++)
+		for (nr = 0; nr < NR_BATCHES * BATCH; nr++) {
+			nodes[i][nr].thread = i;
+			nodes[i][nr].seq = nr;
+		}
+
+	cds_wfs_init(&stack);
+	link_chain(nodes[0], 3);
+	ok(!cds_wfs_push_batch(&stack, &nodes[0][0].node, &nodes[0][2].node),
+		"batch into empty stack returns 0");
+	cds_wfs_node_init(&single.node);
+	ok(cds_wfs_push_batch(&stack, &single.node, &single.node),
+		"single-node batch into non-empty stack returns non-zero");
+	nr = 0;
+	while ((node = cds_wfs_pop_blocking(&stack)) != NULL) {
+		tn = caa_container_of(node, struct test_node, node);
+		if (nr ? tn != &nodes[0][nr - 1] : tn != &single)
+			bad = 1;
+		nr++;
+	}
+	ok(!bad && nr == 4, "chain is popped in order, on top of the stack");
+
+	for (i = 0; i < NR_THREADS; i++)
+		if (pthread_create(&producers[i], NULL, producer_fn,
+				(void *) i))
+			abort();
+	for (i = 0; i < NR_THREADS; i++)
+		if (pthread_join(producers[i], NULL))
+			abort();
+
+	/*
+	 * Batches are pushed whole: each one comes out as a run of BATCH
+	 * consecutive nodes of a thread, in increasing order within it.
+	 */
+	nr = 0;
+	head = cds_wfs_pop_all_blocking(&stack);
+	cds_wfs_for_each_blocking_prefetch_safe(head, node, n) {
+		tn = caa_container_of(node, struct test_node, node);
+		if (tn->seq % BATCH) {
+			if (tn->seq != last[tn->thread] + 1)
+				bad = 1;
+		} else {
+			nr_run++;
+		}
+		last[tn->thread] = tn->seq;
+		nr++;
+	}
+	ok(nr == NR_THREADS * NR_BATCHES * BATCH,
+		"concurrent batches push every node");
+	ok(!bad && nr_run == NR_THREADS * NR_BATCHES,
+		"concurrent batches stay contiguous");
+	ok(cds_wfs_empty(&stack), "pop all empties the stack");
+	cds_wfs_destroy(&stack);
+	return exit_status();
+}
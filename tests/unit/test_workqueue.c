@@ -0,0 +1,213 @@
+/*
+ * test_workqueue.c
+ *
+ * Userspace RCU library - test multi-worker and delayed workqueues
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#include <errno.h>
+#include <poll.h>
+#include <sched.h>
+#include <pthread.h>
+#include <urcu.h>
+#include <urcu/uatomic.h>
+
+#include "workqueue.h"
+#include "tap.h"
+
+#define NR_WORKERS	4
+#define NR_WORK		32
+#define TIMEOUT_MS	3000
+#define DELAY_MS	200
+
+static struct urcu_work works[NR_WORK];
+static unsigned long nr_running, nr_done;
+static int blocked;
+
+/* Wait up to TIMEOUT_MS for *value to reach nr. */
+static int wait_for(unsigned long *value, unsigned long nr)
+{
+	int ms;
+
+	for (ms = 0; ms < TIMEOUT_MS; ms += 1) {
+		if (uatomic_read(value) >= nr)
+			return 1;
+		(void) poll(NULL, 0, 1);
+	}
+	return 0;
+}
+
+/* Done once all workers run such a work item at the same time. */
+static void parallel_work(struct urcu_work *work)
+{
+	uatomic_inc(&nr_running);
+	if (wait_for(&nr_running, NR_WORKERS))
+		uatomic_inc(&nr_done);
+}
+
+/* Blocks its worker until the other work items are done. */
+static void blocking_work(struct urcu_work *work)
+{
+	if (!wait_for(&nr_done, NR_WORK - 1))
+		uatomic_set(&blocked, 1);
+	uatomic_inc(&nr_done);
+}
+
+static void slow_work(struct urcu_work *work)
+{
+	(void) poll(NULL, 0, 100);
+	uatomic_inc(&nr_done);
+}
+
+static void count_work(struct urcu_work *work)
+{
+	uatomic_inc(&nr_done);
+}
+
+static struct urcu_rcu_work rcu_works[NR_WORK];
+static int reader_quit;
+static unsigned long reader_in, nr_callbacks, work_released;
+
+static void *thr_reader(void *arg)
+{
+	rcu_register_thread();
+	rcu_read_lock();
+	uatomic_set(&reader_in, 1);
+	while (!uatomic_read(&reader_quit))
+		(void) poll(NULL, 0, 1);
+	rcu_read_unlock();
+	rcu_unregister_thread();
+	return NULL;
+}
+
+/* Blocks its worker until released. */
+static void gated_work(struct urcu_work *work)
+{
+	(void) wait_for(&work_released, 1);
+	uatomic_inc(&nr_done);
+}
+
+static void count_callback(struct rcu_head *head)
+{
+	uatomic_inc(&nr_callbacks);
+}
+
+int main(int argc, char **argv)
+{
+	struct urcu_workqueue *workqueue;
+	struct rcu_head rcu_head;
+	pthread_t reader;
+	int i, ret;
+
+	plan_tests(12);
+
+	workqueue = urcu_workqueue_create_nr(0, -1, NR_WORKERS, NULL,
+		NULL, NULL, NULL, NULL, NULL, NULL, NULL);
+
+	for (i = 0; i < NR_WORKERS; i++)
+		urcu_workqueue_queue_work(workqueue, &works[i], parallel_work);
+	urcu_workqueue_flush_queued_work(workqueue);
+	ok(nr_done == NR_WORKERS, "workers run work in parallel");
+
+	nr_done = 0;
+	urcu_workqueue_queue_work(workqueue, &works[0], blocking_work);
+	for (i = 1; i < NR_WORK; i++)
+		urcu_workqueue_queue_work(workqueue, &works[i], count_work);
+	urcu_workqueue_flush_queued_work(workqueue);
+	ok(!blocked && nr_done == NR_WORK,
+		"work queued behind a busy worker is stolen");
+
+	nr_done = 0;
+	for (i = 0; i < NR_WORKERS; i++)
+		urcu_workqueue_queue_work(workqueue, &works[i], slow_work);
+	urcu_workqueue_flush_queued_work(workqueue);
+	ok(nr_done == NR_WORKERS, "flush waits for running work");
+
+	nr_done = 0;
+	urcu_workqueue_pause_worker(workqueue);
+	for (i = 0; i < NR_WORK; i++)
+		urcu_workqueue_queue_work(workqueue, &works[i], count_work);
+	(void) poll(NULL, 0, 50);
+	ok(!uatomic_read(&nr_done), "paused workers run no work");
+	urcu_workqueue_resume_worker(workqueue);
+	urcu_workqueue_flush_queued_work(workqueue);
+	ok(nr_done == NR_WORK, "resumed workers run queued work");
+
+	nr_done = 0;
+	ret = 0;
+	for (i = 0; i < NR_WORK; i++)
+		ret |= urcu_workqueue_queue_delayed_work(workqueue, &works[0],
+			count_work, DELAY_MS, URCU_WORK_COALESCE) != (i ? -EBUSY : 0);
+	(void) poll(NULL, 0, DELAY_MS / 2);
+	ok(!ret && !uatomic_read(&nr_done),
+		"delayed work waits for its delay");
+	ret = !wait_for(&nr_done, 1);
+	(void) poll(NULL, 0, DELAY_MS);
+	ok(!ret && uatomic_read(&nr_done) == 1, "coalesced work runs once");
+
+	nr_done = 0;
+	for (i = 0; i < NR_WORK; i++)
+		(void) urcu_workqueue_queue_delayed_work(workqueue, &works[i],
+			count_work, 10 * TIMEOUT_MS, 0);
+	urcu_workqueue_flush_queued_work(workqueue);
+	ok(nr_done == NR_WORK, "flush runs delayed work");
+
+	/* Flush right after the worker ran the timers of the current tick. */
+	nr_done = 0;
+	for (i = 0; i < NR_WORK; i++) {
+		(void) urcu_workqueue_queue_delayed_work(workqueue, &works[i],
+			count_work, 10 * TIMEOUT_MS, 0);
+		(void) sched_yield();
+		urcu_workqueue_flush_queued_work(workqueue);
+	}
+	ok(nr_done == NR_WORK, "flush runs delayed work of the current tick");
+
+	/* rcu work waits for the readers which started before it. */
+	rcu_register_thread();
+	nr_done = 0;
+	if (pthread_create(&reader, NULL, thr_reader, NULL))
+		abort();
+	(void) wait_for(&reader_in, 1);
+	for (i = 0; i < NR_WORK; i++)
+		urcu_workqueue_queue_rcu_work(workqueue, &rcu_works[i],
+			count_work, &rcu_flavor);
+	(void) poll(NULL, 0, 50);
+	ok(!uatomic_read(&nr_done), "rcu work waits for a grace period");
+	uatomic_set(&reader_quit, 1);
+	if (pthread_join(reader, NULL))
+		abort();
+	rcu_barrier();
+	urcu_workqueue_flush_queued_work(workqueue);
+	ok(nr_done == NR_WORK, "rcu work runs after the grace period");
+
+	/* Blocking rcu work does not delay the call_rcu() callbacks. */
+	nr_done = 0;
+	for (i = 0; i < NR_WORKERS; i++)
+		urcu_workqueue_queue_rcu_work(workqueue, &rcu_works[i],
+			gated_work, &rcu_flavor);
+	rcu_barrier();
+	call_rcu(&rcu_head, count_callback);
+	rcu_barrier();
+	ret = uatomic_read(&nr_callbacks) == 1 && !uatomic_read(&nr_done);
+	uatomic_set(&work_released, 1);
+	urcu_workqueue_flush_queued_work(workqueue);
+	ok(ret && nr_done == NR_WORKERS,
+		"blocking rcu work runs apart from the callbacks");
+	rcu_unregister_thread();
+
+	urcu_workqueue_destroy(workqueue);
+	return exit_status();
+}